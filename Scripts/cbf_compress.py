@@ -0,0 +1,267 @@
+#!/usr/bin/env python
+# ==============================================================================
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE.md file in the project root
+# for full license information.
+# ==============================================================================
+
+# Re-encodes a CNTK binary format (CBF) file for the CNTKBinaryReader with compressed chunks: the data of every
+# chunk is split into blocks that are compressed in the LZ4 block format, which the reader decompresses in
+# parallel on its prefetch thread. The chunk table of the output (version 2) records the compression and the
+# uncompressed size of each chunk. See Source/Readers/CNTKBinaryReader/ChunkCompression.h for the format.
+#
+# Input files of version 1 or 2 are accepted; with '--compression none' a compressed file is converted back.
+# The lz4 module (pip install lz4) is used if it is installed, otherwise a (much slower) compressor in
+# Python, which is spread over several processes.
+#
+# Example:
+#   python cbf_compress.py -i train.bin -o train.lz4.bin
+#
+# The reader config does not change, the compression is detected from the file.
+
+import argparse
+import multiprocessing
+import os
+import struct
+import sys
+
+try:
+    import lz4.block as lz4_block
+except ImportError:
+    lz4_block = None
+
+MAGIC_NUMBER = 0x636e746b5f62696e
+CURRENT_VERSION = 2
+
+COMPRESSION_NONE = 0
+COMPRESSION_LZ4 = 1
+
+CHUNK_INFO_V1 = struct.Struct('<qII')     # offset, numSequences, numSamples
+CHUNK_INFO_V2 = struct.Struct('<qIIQII')  # offset, numSequences, numSamples, dataSize, compression, reserved
+BLOCK_INFO = struct.Struct('<II')         # compressedSize, size
+
+MIN_MATCH = 4
+LAST_LITERALS = 5      # the last 5 bytes of a block are always literals
+MATCH_SEARCH_END = 12  # the last match has to start 12 bytes before the end of the block
+MAX_OFFSET = 65535
+
+def lz4_compress_block(data):
+    if lz4_block is not None:
+        return lz4_block.compress(bytes(data), store_size=False)
+
+    # greedy matching with a table of the last position of every 4 byte sequence
+    data = bytearray(data)
+    out = bytearray()
+    table = {}
+    size = len(data)
+    anchor = 0
+    i = 0
+
+    def write_length(length):
+        while length >= 255:
+            out.append(255)
+            length -= 255
+        out.append(length)
+
+    def write_sequence(literals_end, offset, match_length):
+        literal_length = literals_end - anchor
+        token_literals = min(literal_length, 15)
+        token_match = 0 if offset is None else min(match_length - MIN_MATCH, 15)
+        out.append((token_literals << 4) | token_match)
+        if literal_length >= 15:
+            write_length(literal_length - 15)
+        out.extend(data[anchor:literals_end])
+        if offset is not None:
+            out.extend(struct.pack('<H', offset))
+            if match_length - MIN_MATCH >= 15:
+                write_length(match_length - MIN_MATCH - 15)
+
+    while i + MATCH_SEARCH_END <= size:
+        sequence = bytes(data[i:i + MIN_MATCH])
+        candidate = table.get(sequence)
+        table[sequence] = i
+        if candidate is None or i - candidate > MAX_OFFSET:
+            i += 1
+            continue
+
+        match_end = i + MIN_MATCH
+        source = candidate + MIN_MATCH
+        while match_end < size - LAST_LITERALS and data[match_end] == data[source]:
+            match_end += 1
+            source += 1
+
+        write_sequence(i, i - candidate, match_end - i)
+        i = anchor = match_end
+
+    write_sequence(size, None, 0)
+    return bytes(out)
+
+def read_length(data, i, length):
+    # a saturated length is extended by the following bytes, up to one that is not 255
+    if length == 15:
+        while True:
+            extension = data[i]
+            i += 1
+            length += extension
+            if extension != 255:
+                break
+    return length, i
+
+def lz4_decompress_block(data, size):
+    if lz4_block is not None:
+        return lz4_block.decompress(bytes(data), uncompressed_size=size)
+
+    data = bytearray(data)
+    out = bytearray()
+    i = 0
+
+    while i < len(data):
+        token = data[i]
+        i += 1
+        literal_length, i = read_length(data, i, token >> 4)
+        out.extend(data[i:i + literal_length])
+        i += literal_length
+        if i >= len(data):
+            break
+        offset = data[i] | (data[i + 1] << 8)
+        i += 2
+        match_length, i = read_length(data, i, token & 15)
+        match_length += MIN_MATCH
+        start = len(out) - offset
+        for k in range(match_length):
+            out.append(out[start + k])
+
+    if len(out) != size:
+        raise ValueError('Corrupt LZ4 block: %d bytes instead of %d.' % (len(out), size))
+    return bytes(out)
+
+def compress_data(data, block_size):
+    blocks = []
+    for start in range(0, len(data), block_size):
+        block = data[start:start + block_size]
+        compressed = lz4_compress_block(block)
+        # blocks that do not get smaller are stored as is
+        blocks.append((compressed if len(compressed) < len(block) else bytes(block), len(block)))
+
+    header = struct.pack('<I', len(blocks)) + b''.join(BLOCK_INFO.pack(len(b), size) for b, size in blocks)
+    return header + b''.join(b for b, _ in blocks)
+
+def decompress_data(data, compression, size):
+    if compression == COMPRESSION_NONE:
+        return data[:size]
+    if compression != COMPRESSION_LZ4:
+        raise ValueError('Unknown chunk compression %d.' % compression)
+
+    num_blocks, = struct.unpack_from('<I', data, 0)
+    position = 4 + num_blocks * BLOCK_INFO.size
+    out = []
+    for i in range(num_blocks):
+        compressed_size, block_size = BLOCK_INFO.unpack_from(data, 4 + i * BLOCK_INFO.size)
+        block = data[position:position + compressed_size]
+        out.append(bytes(block) if compressed_size == block_size else lz4_decompress_block(block, block_size))
+        position += compressed_size
+    return b''.join(out)
+
+def encode_chunk(arguments):
+    data, compression, size, target_compression, block_size = arguments
+    data = decompress_data(data, compression, size)
+    if target_compression == COMPRESSION_LZ4:
+        return compress_data(data, block_size), len(data)
+    return data, len(data)
+
+class CbfFile(object):
+    def __init__(self, path):
+        self.file = open(path, 'rb')
+        magic, self.version = struct.unpack('<QI', self.file.read(12))
+        if magic != MAGIC_NUMBER:
+            raise ValueError('The input (%s) is not a valid CNTK binary format file.' % path)
+        if self.version < 1 or self.version > CURRENT_VERSION:
+            raise ValueError('Unsupported version %d of the input (%s).' % (self.version, path))
+
+        file_size = os.path.getsize(path)
+        self.file.seek(file_size - 8)
+        self.header_offset, = struct.unpack('<q', self.file.read(8))
+        self.file.seek(self.header_offset)
+        magic, self.num_chunks, self.num_inputs = struct.unpack('<QII', self.file.read(16))
+        if magic != MAGIC_NUMBER:
+            raise ValueError('The header of the input (%s) is corrupt.' % path)
+
+        # the chunk table is at the end of the file, right before the header offset
+        entry = CHUNK_INFO_V1 if self.version == 1 else CHUNK_INFO_V2
+        table_offset = file_size - 8 - self.num_chunks * entry.size
+        self.inputs = self.file.read(table_offset - self.header_offset - 16)
+        table = self.file.read(self.num_chunks * entry.size)
+
+        self.chunks = []
+        for i in range(self.num_chunks):
+            fields = entry.unpack_from(table, i * entry.size)
+            if self.version == 1:
+                fields = fields + (None, COMPRESSION_NONE, 0)
+            self.chunks.append(fields)
+
+    def read_chunk(self, index):
+        offset, num_sequences, _, data_size, compression, _ = self.chunks[index]
+        end = self.chunks[index + 1][0] if index + 1 < self.num_chunks else self.header_offset
+        self.file.seek(offset)
+        lengths = self.file.read(4 * num_sequences)
+        data = self.file.read(end - offset - len(lengths))
+        return lengths, data, compression, data_size if data_size is not None else len(data)
+
+def convert(input_path, output_path, compression, block_size, processes):
+    source = CbfFile(input_path)
+
+    def chunks():
+        for i in range(source.num_chunks):
+            lengths, data, chunk_compression, data_size = source.read_chunk(i)
+            yield lengths, (data, chunk_compression, data_size, compression, block_size)
+
+    pool = multiprocessing.Pool(processes) if processes > 1 and lz4_block is None else None
+    with open(output_path, 'wb') as output:
+        output.write(struct.pack('<QI', MAGIC_NUMBER, CURRENT_VERSION))
+
+        # keep the sequence lengths of the chunks in the main process, the data is encoded by the pool
+        all_lengths = []
+        def arguments():
+            for lengths, argument in chunks():
+                all_lengths.append(lengths)
+                yield argument
+        encoded = pool.imap(encode_chunk, arguments()) if pool else (encode_chunk(a) for a in arguments())
+
+        table = []
+        stored_bytes = data_bytes = 0
+        for i, (data, data_size) in enumerate(encoded):
+            _, num_sequences, num_samples, _, _, _ = source.chunks[i]
+            table.append(CHUNK_INFO_V2.pack(output.tell(), num_sequences, num_samples, data_size, compression, 0))
+            output.write(all_lengths[i])
+            output.write(data)
+            stored_bytes += len(data)
+            data_bytes += data_size
+
+        if pool:
+            pool.close()
+            pool.join()
+
+        header_offset = output.tell()
+        output.write(struct.pack('<QII', MAGIC_NUMBER, source.num_chunks, source.num_inputs))
+        output.write(source.inputs)
+        output.write(b''.join(table))
+        output.write(struct.pack('<q', header_offset))
+
+    print('Wrote %d chunks, %d bytes of data stored in %d bytes (%.2fx).' %
+          (source.num_chunks, data_bytes, stored_bytes, float(data_bytes) / max(stored_bytes, 1)))
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Compresses the chunks of a CNTK binary format file.')
+    parser.add_argument('-i', '--input', required=True, help='the CBF file to convert')
+    parser.add_argument('-o', '--output', required=True, help='the CBF file to write (version 2)')
+    parser.add_argument('--compression', choices=['lz4', 'none'], default='lz4', help='compression of the chunks')
+    parser.add_argument('--block-size', type=int, default=1024 * 1024,
+                        help='uncompressed bytes per block, the unit of parallel decompression in the reader')
+    parser.add_argument('--processes', type=int, default=multiprocessing.cpu_count(),
+                        help='processes to compress with, if the lz4 module is not installed')
+    args = parser.parse_args()
+
+    if args.block_size <= 0 or args.block_size >= 2 ** 32:
+        sys.exit('The block size has to be between 1 and 2^32 - 1 bytes.')
+    convert(args.input, args.output, COMPRESSION_LZ4 if args.compression == 'lz4' else COMPRESSION_NONE,
+            args.block_size, args.processes)
@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+# ==============================================================================
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE.md file in the project root
+# for full license information.
+# ==============================================================================
+
+# Converts the map file of an ImageDeserializer into an image shard for the ImageShardDeserializer:
+# all images are decoded and resized to the same size once, so that the reader does not have to decode them
+# in every sweep. See Source/Readers/ImageReader/ImageShardDeserializer.h for the format.
+#
+# The map file has a line per image, either 'key<TAB>path<TAB>label' or 'path<TAB>label' (the line number is the key).
+# Paths may start with '...' (the directory of the map file) and refer to zip containers as 'container.zip@/item'.
+#
+# Example:
+#   python img2shard.py -m train_map.txt -o train.shard --width 256 --height 256 --scale-mode crop
+#
+# and in the reader config:
+#   deserializers = [{ type = "ImageShardDeserializer" ; module = "ImageReader" ; file = "train.shard"
+#                      input = [ features = [ transforms = (...) ] ; labels = [ labelDim = 1000 ] ] }]
+
+import argparse
+import os
+import struct
+import sys
+import zipfile
+
+import cv2
+import numpy as np
+
+MAGIC = b'CNTKIMGS'
+VERSION = 1
+HEADER_FORMAT = '<8sIIIIQQ'
+
+def read_map_file(map_path):
+    map_dir = os.path.dirname(map_path)
+    entries = []
+    with open(map_path, 'r') as f:
+        for line_index, line in enumerate(f):
+            line = line.rstrip('\r\n')
+            if not line:
+                continue
+            columns = line.split('\t')
+            if len(columns) >= 3:
+                key, path, label = columns[0], columns[1], columns[2]
+            elif len(columns) == 2:
+                key, path, label = str(line_index), columns[0], columns[1]
+            else:
+                raise ValueError('Invalid map file format, must contain 2 or 3 tab-delimited columns, line %d in file %s.' % (line_index, map_path))
+            if path.startswith('...'):
+                path = map_dir + path[3:]
+            entries.append((key, path, int(label)))
+    return entries
+
+class ImageSource(object):
+    def __init__(self):
+        self.zips = {}
+
+    def read(self, path):
+        at = path.find('@')
+        if at < 0:
+            with open(path, 'rb') as f:
+                return f.read()
+        container, item = path[:at], path[at + 2:].replace('\\', '/')
+        if container not in self.zips:
+            self.zips[container] = zipfile.ZipFile(container, 'r')
+        return self.zips[container].read(item)
+
+def resize(image, width, height, scale_mode, interpolation):
+    if scale_mode == 'fill':
+        return cv2.resize(image, (width, height), interpolation=interpolation)
+
+    # 'crop': resize the shorter side to the target size and crop the center, as the Scale transform does.
+    rows, cols = image.shape[:2]
+    if cols < rows:
+        target_w, target_h = width, int(round(rows * width / float(cols)))
+    else:
+        target_w, target_h = int(round(cols * height / float(rows))), height
+    image = cv2.resize(image, (target_w, target_h), interpolation=interpolation)
+    x = max(0, (target_w - width) // 2)
+    y = max(0, (target_h - height) // 2)
+    return image[y:y + height, x:x + width]
+
+def convert(args):
+    entries = read_map_file(args.map)
+    source = ImageSource()
+    channels = 1 if args.grayscale else 3
+    flags = cv2.IMREAD_GRAYSCALE if args.grayscale else cv2.IMREAD_COLOR
+    interpolation = {'nearest': cv2.INTER_NEAREST, 'linear': cv2.INTER_LINEAR,
+                     'cubic': cv2.INTER_CUBIC, 'area': cv2.INTER_AREA}[args.interpolation]
+    record_size = 4 + args.width * args.height * channels
+    keys_offset = struct.calcsize(HEADER_FORMAT) + len(entries) * record_size
+
+    with open(args.output, 'wb') as out:
+        out.write(struct.pack(HEADER_FORMAT, MAGIC, VERSION, args.width, args.height, channels, len(entries), keys_offset))
+        for i, (key, path, label) in enumerate(entries):
+            data = np.frombuffer(source.read(path), dtype=np.uint8)
+            image = cv2.imdecode(data, flags)
+            if image is None:
+                raise ValueError('Cannot decode image %s (key %s).' % (path, key))
+            image = resize(image, args.width, args.height, args.scale_mode, interpolation)
+            out.write(struct.pack('<I', label))
+            out.write(np.ascontiguousarray(image, dtype=np.uint8).tobytes())
+            if args.verbose and (i + 1) % 10000 == 0:
+                print('%d of %d images converted' % (i + 1, len(entries)))
+
+        assert out.tell() == keys_offset
+        for key, _, _ in entries:
+            out.write(key.encode('utf-8') + b'\0')
+
+    print('Wrote %d images of %dx%dx%d to %s.' % (len(entries), args.width, args.height, channels, args.output))
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Converts an image map file into an image shard for the ImageShardDeserializer.')
+    parser.add_argument('-m', '--map', required=True, help='map file of the ImageDeserializer')
+    parser.add_argument('-o', '--output', required=True, help='image shard to write')
+    parser.add_argument('--width', type=int, required=True, help='width of the stored images')
+    parser.add_argument('--height', type=int, required=True, help='height of the stored images')
+    parser.add_argument('--scale-mode', choices=['fill', 'crop'], default='crop',
+                        help='fill: warp to the size, crop: resize the shorter side and crop the center (default)')
+    parser.add_argument('--interpolation', choices=['nearest', 'linear', 'cubic', 'area'], default='area')
+    parser.add_argument('--grayscale', action='store_true', help='store single channel images')
+    parser.add_argument('-v', '--verbose', action='store_true')
+    convert(parser.parse_args())
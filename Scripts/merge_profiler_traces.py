@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+# ==============================================================================
+# Copyright (c) Microsoft. All rights reserved.
+# Licensed under the MIT license. See LICENSE.md file in the project root
+# for full license information.
+# ==============================================================================
+
+# Merges the trace files of the performance profiler (<profilerDir>/*_trace_<rank>.json) of the workers of a
+# distributed job into one trace in the Chrome trace event format, which can be opened in chrome://tracing or
+# https://ui.perfetto.dev. Each rank is a process of its own, each thread a track within it. For parallel training
+# with the cntk executable, the time stamps of all ranks are already on the clock of rank 0; the merged trace
+# starts at 0 unless --keep-time-stamps is given.
+#
+# Example:
+#   python merge_profiler_traces.py -o job_trace.json profiler/*_trace_*.json
+
+import argparse
+import json
+import sys
+
+def merge(input_paths, output_path, keep_time_stamps):
+    events = []
+    ranks = set()
+    for path in input_paths:
+        with open(path) as f:
+            trace = json.load(f)
+        file_events = trace['traceEvents'] if isinstance(trace, dict) else trace
+        file_ranks = set(e['pid'] for e in file_events if 'pid' in e)
+        if file_ranks & ranks:
+            print('Warning: rank %s of %s is in more than one input.' % (sorted(file_ranks & ranks), path))
+        ranks |= file_ranks
+        events.extend(file_events)
+
+    timed = [e for e in events if 'ts' in e]
+    if timed and not keep_time_stamps:
+        start = min(e['ts'] for e in timed)
+        for e in timed:
+            e['ts'] = round(e['ts'] - start, 3)
+
+    with open(output_path, 'w') as f:
+        json.dump({'displayTimeUnit': 'ms', 'traceEvents': events}, f, separators=(',', ':'))
+
+    print('Merged %d events of %d ranks into %s.' % (len(timed), len(ranks), output_path))
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Merges the trace files of the CNTK performance profiler.')
+    parser.add_argument('inputs', nargs='+', help='the trace files (*_trace_*.json) of the ranks')
+    parser.add_argument('-o', '--output', required=True, help='the merged trace file')
+    parser.add_argument('--keep-time-stamps', action='store_true',
+                        help='keep the time stamps of the profiler instead of starting the trace at 0')
+    args = parser.parse_args()
+
+    if args.output in args.inputs:
+        sys.exit('The output must not be one of the inputs.')
+    merge(args.inputs, args.output, args.keep_time_stamps)
@@ -57,6 +57,10 @@ void DoWriteOutput(const ConfigParameters& config);
 template <typename ElemType>
 void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
+void DoReaderBenchmark(const ConfigParameters& config);
+template <typename ElemType>
+void DoConvertToCNTKBinary(const ConfigParameters& config);
+template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
@@ -69,6 +69,7 @@ static void DoEvalBase(const ConfigParameters& config, IDataReader& reader)
     size_t numSubminiBatches = config(L"numSubminibatches", (size_t)1);
 
     bool enableDistributedMBReading = config(L"distributedMBReading", GetDistributedMBReadingDefaultValue(config, reader));
+    bool shardedEvaluation = config(L"shardedEvaluation", false);
 
     vector<wstring> evalNodeNamesVector;
 
@@ -80,7 +81,7 @@ static void DoEvalBase(const ConfigParameters& config, IDataReader& reader)
                            config(L"traceNodeNamesSparse",   ConfigParameters::Array(stringargvector())));
 
     SimpleEvaluator<ElemType> eval(net, MPIWrapper::GetInstance(), enableDistributedMBReading, numMBsToShowResult, 
-                                   firstMBsToShowResult, traceLevel, maxSamplesInRAM, numSubminiBatches);
+                                   firstMBsToShowResult, traceLevel, maxSamplesInRAM, numSubminiBatches, shardedEvaluation);
     eval.Evaluate(&reader, evalNodeNamesVector, mbSize[0], epochSize);
 }
 
@@ -147,6 +148,7 @@ void DoCrossValidate(const ConfigParameters& config)
     DataReader cvDataReader(readerConfig);
 
     bool enableDistributedMBReading = config(L"distributedMBReading", GetDistributedMBReadingDefaultValue(config, cvDataReader));
+    bool shardedEvaluation = config(L"shardedEvaluation", false);
 
     bool finalModelEvaluated = false;
     for (size_t i = cvInterval[0]; i <= cvInterval[2]; i += cvInterval[1])
@@ -170,7 +172,7 @@ void DoCrossValidate(const ConfigParameters& config)
         // BUGBUG: ^^ Should use GetModelFromConfig()
 
         SimpleEvaluator<ElemType> eval(net, MPIWrapper::GetInstance(), enableDistributedMBReading, numMBsToShowResult,
-            firstMBsToShowResult, traceLevel, maxSamplesInRAM, numSubminiBatches);
+            firstMBsToShowResult, traceLevel, maxSamplesInRAM, numSubminiBatches, shardedEvaluation);
 
         fprintf(stderr, "Model %ls --> \n", cvModelPath.c_str());
         auto evalErrors = eval.Evaluate(&cvDataReader, evalNodeNamesVector, mbSize[0], epochSize);
@@ -257,9 +259,40 @@ void DoWriteOutput(const ConfigParameters& config)
     {
         wstring outputPath = config(L"outputPath");
         bool writeSequenceKey = config(L"writeSequenceKey", false);
-        WriteFormattingOptions formattingOptions(config);
-        bool nodeUnitTest = config(L"nodeUnitTest", "false");
-        writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, formattingOptions, epochSize, nodeUnitTest, writeSequenceKey);
+        wstring outputFormat = config(L"outputFormat", L"text");
+        // with MPI each worker writes its part of the data, optionally merged in the order of the ranks at the end
+        bool mergeShards = config(L"mergeShards", false);
+        if (AreEqualIgnoreCase(outputFormat, L"text"))
+        {
+            WriteFormattingOptions formattingOptions(config);
+            bool nodeUnitTest = config(L"nodeUnitTest", "false");
+            writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, formattingOptions, epochSize, nodeUnitTest, writeSequenceKey, MPIWrapper::GetInstance(), mergeShards);
+        }
+        else
+        {
+            // binary output: outputFormat = "binary" (raw values and an index per node) or "cbf" (CNTK binary format),
+            // outputElementType = "float", "float16" (binary only) or "double"
+            BinaryOutputOptions options;
+            if (AreEqualIgnoreCase(outputFormat, L"binary"))
+                options.format = BinaryOutputFormat::raw;
+            else if (AreEqualIgnoreCase(outputFormat, L"cbf"))
+                options.format = BinaryOutputFormat::cbf;
+            else
+                InvalidArgument("write command: unknown outputFormat '%ls', expected 'text', 'binary' or 'cbf'.", outputFormat.c_str());
+
+            wstring elementType = config(L"outputElementType", L"float");
+            if (AreEqualIgnoreCase(elementType, L"float"))
+                options.elementType = BinaryOutputElementType::float32;
+            else if (AreEqualIgnoreCase(elementType, L"float16"))
+                options.elementType = BinaryOutputElementType::float16;
+            else if (AreEqualIgnoreCase(elementType, L"double"))
+                options.elementType = BinaryOutputElementType::float64;
+            else
+                InvalidArgument("write command: unknown outputElementType '%ls', expected 'float', 'float16' or 'double'.", elementType.c_str());
+
+            options.bufferSize = (size_t)config(L"outputBufferSizeInMB", (size_t)32) * 1024 * 1024;
+            writer.WriteBinaryOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, options, epochSize, writeSequenceKey, MPIWrapper::GetInstance(), mergeShards);
+        }
     }
     else
         InvalidArgument("write command: You must specify either 'writer'or 'outputPath'");
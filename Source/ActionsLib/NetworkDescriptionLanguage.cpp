@@ -155,9 +155,7 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
          if (EqualInsensitive(nodeType, OperationNameOf(AbsNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(AveragePoolingNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(BatchNormalizationNode))) ret = true;
-#ifdef COMING_SOON
     else if (EqualInsensitive(nodeType, OperationNameOf(CRFNode), L"CRF")) ret = true;
-#endif
     else if (EqualInsensitive(nodeType, OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode), L"CBCEWithSM")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(ClassificationErrorNode), L"ErrorPrediction")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(EditDistanceErrorNode))) ret = true;
@@ -166,6 +164,7 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     else if (EqualInsensitive(nodeType, OperationNameOf(GreaterNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(ForwardBackwardNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LabelsToGraphNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(LatticeFreeMMINode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LessEqualNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LessNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(NotEqualNode))) ret = true;
@@ -174,6 +173,7 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     else if (EqualInsensitive(nodeType, OperationNameOf(CropNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(PassNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(PoolingNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(ContextExpansionNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(CosDistanceNode), L"CosDist")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(CosDistanceWithNegativeSamplesNode), L"CosWithNegSamples")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(CosineNode), L"Cos")) ret = true;
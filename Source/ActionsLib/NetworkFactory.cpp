@@ -12,6 +12,8 @@
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
 #include "BrainScriptParser.h"
+#include "PerformanceProfiler.h"
+#include "TimerUtility.h"
 
 function<ComputationNetworkPtr(DEVICEID_TYPE)> GetCreateNetworkFn(const ScriptableObjects::IConfigRecord& config)
 {
@@ -96,18 +98,30 @@ bool TryGetNetworkFactory(const ConfigRecordType& config, function<ComputationNe
             L"precision = '%ls'\n"        // 'float' or 'double'
             L"network = %ls",             // source code of expression that evaluates to a ComputationNetwork
             (int)deviceId, traceLevel, ElemTypeName<ElemType>(), sourceOfNetwork.c_str());
+        Timer timer;
+        timer.Start();
+        auto profConfig = ProfilerTimeBegin();
         let expr = BS::ParseConfigDictFromString(sourceOfBS, L"BrainScriptNetworkBuilder", move(includePaths));
+        ProfilerTimeEnd(profConfig, profilerEvtLoadConfig);
+        timer.Stop();
+        if (traceLevel > 0)
+            fprintf(stderr, "BrainScriptNetworkBuilder: Parsing took %.3f seconds.\n", timer.ElapsedSeconds());
 
         // the rest is done in a lambda that is only evaluated when a virgin network is needed
         // Note that evaluating the BrainScript *is* instantiating the network, so the evaluate call must be inside the lambda.
-        createNetworkFn = [expr](DEVICEID_TYPE /*deviceId*/)
+        createNetworkFn = [expr, traceLevel](DEVICEID_TYPE /*deviceId*/)
         {
             // evaluate the parse tree, particularly the top-level field 'network'
             // Evaluating it will create the network.
+            Timer timer;
+            timer.Start();
             let object = EvaluateField(expr, L"network");                   // this comes back as a BS::Object
             let network = dynamic_pointer_cast<ComputationNetwork>(object); // cast it
             if (!network)
                 LogicError("BuildNetworkFromDescription: ComputationNetwork not what it was meant to be");
+            timer.Stop();
+            if (traceLevel > 0)
+                fprintf(stderr, "BrainScriptNetworkBuilder: Evaluation took %.3f seconds, including the post-processing of the network.\n", timer.ElapsedSeconds());
             return network;
         };
         return true;
@@ -162,7 +176,9 @@ ComputationNetworkPtr GetModelFromConfig(const ConfigRecordType& config, const w
     if (gotIt)
     {
         // We have several ways to create a network.
+        auto profBuild = ProfilerTimeBegin();
         net = createNetworkFn(deviceId);
+        ProfilerTimeEnd(profBuild, profilerEvtLoadBuild);
         if (outputNodeNames.size() > 0)
         {
             net->InvalidateCompiledNetwork();
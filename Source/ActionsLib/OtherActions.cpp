@@ -14,6 +14,8 @@
 #include "ComputationNetwork.h"
 #include "ComputationNode.h"
 #include "Config.h"
+#include "BestGpu.h"
+#include "CPUMatrix.h" // used for SetNumThreads()
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
 
@@ -112,6 +114,136 @@ void DoCreateLabelMap(const ConfigParameters& config)
 template void DoCreateLabelMap<float>(const ConfigParameters& config);
 template void DoCreateLabelMap<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoReaderBenchmark() - implements CNTK "benchmarkReader" command
+// Reads numMinibatches minibatches with the given reader, without a network,
+// once for each of the given numbers of CPU threads, and reports the throughput
+// in total and by stream. Set traceLevel=1 in the reader section for the
+// breakdown of the time by stage (chunk load, deserialize, transform, pack, copy).
+// ===========================================================================
+
+template <typename ElemType>
+void DoReaderBenchmark(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    size_t minibatchSize = config(L"minibatchSize", (size_t)256);
+    size_t numMinibatches = config(L"numMinibatches", (size_t)100);
+    ConfigArray numThreadsConfig = config(L"numCPUThreads", "0");
+    intargvector numThreads = numThreadsConfig;
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    if (minibatchSize == 0 || numMinibatches == 0)
+        InvalidArgument("BenchmarkReader: 'minibatchSize' and 'numMinibatches' must be greater than zero.");
+
+    // The streams to read, by default all the inputs the reader section defines.
+    vector<wstring> inputNames;
+    if (config.Exists(L"inputs"))
+    {
+        stringargvector inputs = config(L"inputs");
+        inputNames.assign(inputs.begin(), inputs.end());
+    }
+    else
+    {
+        vector<wstring> labelNames;
+        GetFileConfigNames(readerConfig, inputNames, labelNames);
+        inputNames.insert(inputNames.end(), labelNames.begin(), labelNames.end());
+    }
+    if (inputNames.empty())
+        InvalidArgument("BenchmarkReader: no inputs found, specify them in 'inputs'.");
+
+    // Sparse inputs are read into sparse matrices, all others are read as dense.
+    stringargvector sparseInputs = config(L"sparseInputs", ConfigParameters::Array(stringargvector()));
+    set<wstring> sparseInputNames(sparseInputs.begin(), sparseInputs.end());
+
+    StreamMinibatchInputs matrices;
+    for (const auto& name : inputNames)
+    {
+        bool isSparse = sparseInputNames.find(name) != sparseInputNames.end();
+        auto matrix = make_shared<Matrix<ElemType>>(0, 0, deviceId, isSparse ? SPARSE : DENSE, isSparse ? matrixFormatSparseCSC : matrixFormatDense);
+        matrices.AddInput(name, matrix, make_shared<MBLayout>(), TensorShape());
+    }
+
+    // One epoch of exactly numMinibatches minibatches, so that the reader reports its statistics at its end.
+    size_t epochSize = minibatchSize * numMinibatches;
+    for (int threads : numThreads)
+    {
+        int actualThreads = CPUMatrix<ElemType>::SetNumThreads(threads);
+        fprintf(stderr, "\nBenchmarkReader: reading %d minibatches of %d samples with %d CPU threads.\n",
+                (int)numMinibatches, (int)minibatchSize, actualThreads);
+
+        // A new reader for each run, so that all runs start with the same state, e.g. no chunks in memory.
+        DataReader dataReader(readerConfig);
+        map<wstring, size_t> bytesPerStream;
+        size_t numSamples = 0, numMinibatchesRead = 0;
+        double readTime = 0;
+
+        auto start = chrono::steady_clock::now();
+        dataReader.StartMinibatchLoop(minibatchSize, 0, matrices.GetStreamDescriptions(), epochSize);
+        double startTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        for (;;)
+        {
+            auto readStart = chrono::steady_clock::now();
+            if (!dataReader.GetMinibatch(matrices))
+                break;
+            readTime += chrono::duration<double>(chrono::steady_clock::now() - readStart).count();
+
+            numMinibatchesRead++;
+            numSamples += matrices.begin()->second.pMBLayout->GetActualNumSamples();
+            for (const auto& input : matrices)
+            {
+                const auto& matrix = matrices.GetInputMatrix<ElemType>(input.first);
+                size_t bytes = matrix.NzCount() * sizeof(ElemType);
+                if (matrix.GetMatrixType() == SPARSE) // CSC row indices and column offsets
+                    bytes += (matrix.NzCount() + matrix.GetNumCols() + 1) * sizeof(CPUSPARSE_INDEX_TYPE);
+                bytesPerStream[input.first] += bytes;
+            }
+        }
+
+        size_t totalBytes = 0;
+        for (const auto& b : bytesPerStream)
+            totalBytes += b.second;
+
+        double seconds = max(readTime, 1e-9);
+        fprintf(stderr, "BenchmarkReader: %d CPU threads: %d minibatches, %d samples in %.3fs (%.3fs to start the epoch): %.1f samples/s, %.2f MB/s.\n",
+                actualThreads, (int)numMinibatchesRead, (int)numSamples, readTime, startTime,
+                numSamples / seconds, totalBytes / seconds / (1024 * 1024));
+        for (const auto& b : bytesPerStream)
+            fprintf(stderr, "BenchmarkReader: %d CPU threads: stream '%ls': %.2f MB, %.2f MB/s.\n",
+                    actualThreads, b.first.c_str(), b.second / (1024.0 * 1024), b.second / seconds / (1024 * 1024));
+    }
+}
+
+template void DoReaderBenchmark<float>(const ConfigParameters& config);
+template void DoReaderBenchmark<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoConvertToCNTKBinary() - implements CNTK "convertToCNTKBinary" command
+// Reads one sweep of the data of the reader section (which has to use
+// deserializers) and writes it in the CNTK binary format, e.g.
+//   convert = [ action = "convertToCNTKBinary" ; outputFile = "train.bin"
+//               numShards = 4 ; sortByLength = true ; reader = [ ... ] ]
+// See Source/Readers/CompositeDataReader/CNTKBinaryWriter.h for the options.
+// ===========================================================================
+
+template <typename ElemType>
+void DoConvertToCNTKBinary(const ConfigParameters& config)
+{
+    typedef size_t (*ConvertProc)(const ConfigParameters* config, const ConfigParameters* readerConfig);
+
+    ConfigParameters readerConfig(config(L"reader"));
+    if (!readerConfig.Exists(L"deserializers"))
+        InvalidArgument("ConvertToCNTKBinary: the reader section has to define 'deserializers'.");
+    readerConfig.Insert("precision", sizeof(ElemType) == sizeof(double) ? "double" : "float");
+
+    Plugin plugin;
+    wstring readerType = readerConfig(L"readerType", L"Cntk.Composite");
+    ConvertProc convert = (ConvertProc) plugin.Load(readerType, "ConvertToCNTKBinary");
+    size_t numSequences = convert(&config, &readerConfig);
+    fprintf(stderr, "ConvertToCNTKBinary: converted %d sequences.\n", (int)numSequences);
+}
+
+template void DoConvertToCNTKBinary<float>(const ConfigParameters& config);
+template void DoConvertToCNTKBinary<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoParameterSVD() - implements CNTK "SVD" command
 // ===========================================================================
@@ -248,8 +248,9 @@ void DoEdit(const ConfigParameters& config)
         }
         DEVICEID_TYPE deviceId = DeviceFromConfig(config);
         let createNetworkFn = GetNetworkFactory<ConfigParameters, ElemType>(config);
+        wstring parameterValueFormat = config(L"parameterValueFormat", L"full"); // "float16" or "int8" compress the parameters, e.g. for distributing a model
         let net = createNetworkFn(deviceId);
-        net->Save(outputPathname);
+        net->Save(outputPathname, FileOptions::fileOptionsBinary, ParseParameterValueFormat(parameterValueFormat));
         LOGPRINTF(stderr, "\nModel with %d nodes saved as '%ls'.\n", (int)net->GetTotalNumberOfNodes(), outputPathname.c_str());
         return;
     }
@@ -282,11 +283,15 @@ void DoBatchNormalizationStat(const ConfigParameters& config)
 
     int traceLevel = config(L"traceLevel", "0");
     int itersPerNode = config(L"itersPerNode", 30);
+    bool singleSweep = config(L"singleSweep", false); // estimate all nodes in the same itersPerNode minibatches
 
     ConfigArray minibatchSize = config(L"minibatchSize", "40960");
     intargvector mbSize = minibatchSize;
     
-    bool enableDistributedMBReading = config(L"enableDistributedMBReading", false);
+    // as in training, parallel runs with a V2 reader partition the minibatches over the workers unless specified otherwise
+    auto mpi = MPIWrapper::GetInstance();
+    bool enableDistributedMBReading = config.Exists(L"enableDistributedMBReading") ? (bool)config(L"enableDistributedMBReading")
+                                                                                    : (mpi != nullptr && !dataReader->IsLegacyReader());
 
     wstring curModelPath = config(L"modelPath", L"");
     wstring newModelPath = config(L"newModelPath", L"");
@@ -302,9 +307,9 @@ void DoBatchNormalizationStat(const ConfigParameters& config)
                            config(L"traceNodeNamesCategory", ConfigParameters::Array(stringargvector())),
                            config(L"traceNodeNamesSparse",   ConfigParameters::Array(stringargvector())));
 
-    PostComputingActions<ElemType> postComputingActions(net, MPIWrapper::GetInstance(), enableDistributedMBReading, traceLevel);
+    PostComputingActions<ElemType> postComputingActions(net, mpi, enableDistributedMBReading, traceLevel);
 
-    postComputingActions.BatchNormalizationStatistics(dataReader.get(), evalNodeNames, newModelPath, mbSize[0], itersPerNode);
+    postComputingActions.BatchNormalizationStatistics(dataReader.get(), evalNodeNames, newModelPath, mbSize[0], itersPerNode, singleSweep);
 }
 
 template void DoBatchNormalizationStat<double>(const ConfigParameters& config);
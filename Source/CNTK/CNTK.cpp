@@ -23,7 +23,11 @@
 #include "NDLNetworkBuilder.h"
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
+#include "CPUBlas.h"
+#include "CPUNuma.h"
+#include "CPUHugePageAllocator.h"
 #include "CommonMatrix.h"
+#include "ConvolutionAlgorithmCache.h"
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "Config.h"
@@ -36,6 +40,8 @@
 #include "BrainScriptEvaluator.h"
 #include "BrainScriptParser.h"
 #include "PerformanceProfiler.h"
+#include "TrainingMetrics.h"
+#include "ThreadPool.h"
 #include "CNTKLibrary.h"
 
 #include <string>
@@ -72,18 +78,34 @@ void TestCn(const ConfigParameters& config);
 
 // Setup profiling
 template <typename ConfigParamType>
-void SetupProfiling(ProfilerContext& profilerContext, const ConfigParamType& config, int nodeRank)
+void SetupProfiling(ProfilerContext& profilerContext, const ConfigParamType& config, const MPIWrapperPtr& mpi)
 {
     if (config(L"profilerEnabled", false))
     {
+        int nodeRank = mpi ? (int)mpi->CurrentNodeRank() : 0;
         wstring workDir = config(L"WorkDir", L".");
         profilerContext.Init(workDir + L"/profiler",
                              config(L"profilerBufferSize", static_cast<uint64_t>(32 * 1024 * 1024)),
                              std::to_wstring(nodeRank),
                              config(L"profilerSyncGpu", true));
+        ProfilerEnableNodeTiming(config(L"profilerNodeTiming", false));
+        ProfilerSetRoofline(config(L"profilerPeakGFlops", 0.0), config(L"profilerPeakGBps", 0.0), config(L"profilerRooflineMinibatches", 0));
+
+        // the traces of all ranks on the timeline of rank 0
+        if (mpi && mpi->NumNodesInUse() > 1)
+            ProfilerSetRank(nodeRank, EstimateClockOffsetToMainNode(*mpi));
     }
 }
 
+// Setup the always-on training metrics, served on trainingMetricsPort + rank (0 to not serve them)
+template <typename ConfigParamType>
+void SetupTrainingMetrics(TrainingMetricsContext& trainingMetricsContext, const ConfigParamType& config, const MPIWrapperPtr& mpi)
+{
+    int port = config(L"trainingMetricsPort", 0);
+    if (config(L"trainingMetrics", port > 0))
+        trainingMetricsContext.Init(port > 0 ? port + (mpi ? (int)mpi->CurrentNodeRank() : 0) : 0);
+}
+
 void RedirectStdErr(wstring logpath)
 {
     // TODO: if there is already a file, rename it
@@ -177,12 +199,38 @@ static void DisableLegacyUsage(const ConfigParameters& TopLevelConfig, const Con
 // be run in parallel across multiple ranks. Others should only run on rank 0
 const std::set<std::string> commandstoRunOnAllRanks = { "train", "trainRNN", "adapt", "test", "eval", "cv", "devtest", "bnstat" };
 
+// Reserves CPUs for the background threads of the readers and of the gradient aggregation (see ThreadPool.h), before the
+// compute threads are set up. With pinCPUThreads, the background and the compute threads are pinned to their CPUs.
+template <class ConfigRecordType>
+static void ReserveBackgroundCpus(const ConfigRecordType& config)
+{
+    int numBackgroundCPUThreads = config(L"numBackgroundCPUThreads", 0);
+    if (numBackgroundCPUThreads <= 0)
+        return;
+    bool pin = config(L"pinCPUThreads", false);
+    ThreadPool::Instance().ReserveBackgroundCpus(numBackgroundCPUThreads, pin);
+    LOGPRINTF(stderr, "Reserved %d of %d CPUs for background threads%s.\n", ThreadPool::Instance().NumBackgroundCpus(),
+              ThreadPool::Instance().NumAvailableCpus(), pin ? " (pinned)" : "");
+}
+
 // process the command
 template <typename ElemType>
 void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mpi)
 {
     ConfigArray command = config(L"command", "train");
 
+    // BLAS library for the CPU; by default the one CNTK was built with
+    wstring cpuBlasLibrary = config(L"cpuBlasLibrary", L"");
+    if (!cpuBlasLibrary.empty())
+    {
+        CPUBlas::LoadBackend(cpuBlasLibrary);
+        LOGPRINTF(stderr, "Using CPU BLAS %ls.\n", CPUBlas::GetBackendName().c_str());
+    }
+    if (config(L"cpuBlasStatistics", false))
+        CPUBlas::EnableStatistics(true);
+
+    ReserveBackgroundCpus(config);
+
     if (Globals::ShouldForceDeterministicAlgorithms())
         ForceDeterministicAlgorithmsOnCPU();
     else
@@ -196,6 +244,20 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
         }
     }
 
+    if (config(L"numaMode", false))
+    {
+        CPUNuma::EnableNumaMode(true);
+        LOGPRINTF(stderr, "NUMA mode: %d nodes.\n", (int) CPUNuma::GetNumNodes());
+    }
+
+    auto hugePageMode = CPUHugePageAllocator::ModeFromConfig(config(L"hugePages", false), config(L"hugeTlbPages", false));
+    if (hugePageMode != CPUHugePageAllocator::Mode::none)
+    {
+        CPUHugePageAllocator::SetMode(hugePageMode);
+        LOGPRINTF(stderr, "Using %s huge pages for CPU buffers of %d MB and more.\n",
+                  hugePageMode == CPUHugePageAllocator::Mode::hugetlb ? "hugetlbfs" : "transparent", (int) (CPUHugePageAllocator::GetMinBytes() >> 20));
+    }
+
     bool progressTracing = config(L"progressTracing", false);
 
     // temporary hack to prevent users from failing due to a small breaking change related to the "truncated" flag (will be redone bigger and better some day)
@@ -327,6 +389,14 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoCreateLabelMap<ElemType>(commandParams);
                 }
+                else if (thisAction == "benchmarkReader")
+                {
+                    DoReaderBenchmark<ElemType>(commandParams);
+                }
+                else if (thisAction == "convertToCNTKBinary")
+                {
+                    DoConvertToCNTKBinary<ElemType>(commandParams);
+                }
                 else if (thisAction == "writeWordAndClass")
                 {
                     DoWriteWordAndClassInfo<ElemType>(commandParams);
@@ -534,8 +604,33 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
-
+    Globals::SetQuantizedInference(config(L"quantizedInference", false));
+    Globals::SetFloat16Products(config(L"float16Products", false));
+    Globals::SetNumComputeStreams(config(L"numComputeStreams", (size_t) 0));
+    Globals::SetCudaGraphCapture(config(L"cudaGraphs", false));
+    Globals::SetForwardPlans(config(L"forwardPlans", false));
+    Globals::SetMemoryPlans(config(L"memoryPlans", false));
+    Globals::SetNetworkSimplification(config(L"simplifyNetwork", false));
+    Globals::SetElementwiseFusion(config(L"fuseElementwiseOps", false));
+    Globals::SetBatchNormActivationFusion(config(L"fuseBatchNormActivations", false));
+    Globals::SetLoopInvariantProductHoisting(config(L"hoistLoopInvariantProducts", false));
+    Globals::SetGapFrameCompaction(config(L"compactGapFrames", false));
+    Globals::SetRecomputeSegmentBytesPerSample(config(L"recomputeSegmentBytesPerSample", (size_t) 0));
+    Globals::SetOffloadLoopValues(config(L"offloadLoopValues", false));
+    Globals::SetOffloadPrefetchDistance(config(L"offloadPrefetchDistance", (size_t) 2));
+    Globals::SetCounterBasedDropout(config(L"counterBasedDropout", false));
+    Globals::SetPoolingArgmax(config(L"poolingArgmax", false));
+
+    MatrixTransferAudit::SetMode(MatrixTransferAudit::ParseMode(config(L"matrixTransferAudit", wstring(L"none"))));
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    TracingGPUMemoryAllocator::SetCachingEnabled(config(L"cacheGPUMemory", true));
+    MemoryReport::SetOutputPath(config(L"memoryReport", L""));
+
+    wstring cudnnAlgorithmCache = config(L"cudnnAlgorithmCache", L"");
+    if (!cudnnAlgorithmCache.empty())
+        ConvolutionAlgorithmCache::SetPath(cudnnAlgorithmCache);
+    intargvector cudnnAutotuneBatchSizes = config(L"cudnnAutotuneBatchSizes", ScriptableObjects::IConfigRecord::Array(intargvector(vector<int>())));
+    ConvolutionAlgorithmCache::SetAutotuneBatchSizes(vector<size_t>(cudnnAutotuneBatchSizes.begin(), cudnnAutotuneBatchSizes.end()));
 
     // logging
     wstring logpath = config(L"stderr", L"");
@@ -554,10 +649,23 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     // Setup profiling
     ProfilerContext profilerContext;
-    SetupProfiling(profilerContext, config, paralleltrain ? (int)mpi->CurrentNodeRank() : 0);
+    SetupProfiling(profilerContext, config, paralleltrain ? mpi : nullptr);
+    TrainingMetricsContext trainingMetricsContext;
+    SetupTrainingMetrics(trainingMetricsContext, config, paralleltrain ? mpi : nullptr);
 
     // execute the actions
     // std::string type = config(L"precision", "float");
+    wstring cpuBlasLibrary = config(L"cpuBlasLibrary", L"");
+    if (!cpuBlasLibrary.empty())
+    {
+        CPUBlas::LoadBackend(cpuBlasLibrary);
+        LOGPRINTF(stderr, "Using CPU BLAS %ls.\n", CPUBlas::GetBackendName().c_str());
+    }
+    if (config(L"cpuBlasStatistics", false))
+        CPUBlas::EnableStatistics(true);
+
+    ReserveBackgroundCpus(config);
+
     if (Globals::ShouldForceDeterministicAlgorithms())
         ForceDeterministicAlgorithmsOnCPU();
     else
@@ -568,6 +676,20 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
     }
 
+    if (config(L"numaMode", false))
+    {
+        CPUNuma::EnableNumaMode(true);
+        LOGPRINTF(stderr, "NUMA mode: %d nodes.\n", (int) CPUNuma::GetNumNodes());
+    }
+
+    auto hugePageMode = CPUHugePageAllocator::ModeFromConfig(config(L"hugePages", false), config(L"hugeTlbPages", false));
+    if (hugePageMode != CPUHugePageAllocator::Mode::none)
+    {
+        CPUHugePageAllocator::SetMode(hugePageMode);
+        LOGPRINTF(stderr, "Using %s huge pages for CPU buffers of %d MB and more.\n",
+                  hugePageMode == CPUHugePageAllocator::Mode::hugetlb ? "hugetlbfs" : "transparent", (int) (CPUHugePageAllocator::GetMinBytes() >> 20));
+    }
+
     bool progressTracing = config(L"progressTracing", false);
     size_t fullTotalMaxEpochs = 1; // BUGBUG: BS does not allow me to read out the max epochs parameters, as that would instantiate and thus execute the objects
 
@@ -593,6 +715,11 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     }
     // else action has already been executed, see comment above
 
+    if (TracingGPUMemoryAllocator::IsTraceEnabled())
+        TracingGPUMemoryAllocator::PrintMemoryStatistics();
+    if (MatrixTransferAudit::GetMode() != MatrixTransferAudit::Mode::Off)
+        MatrixTransferAudit::PrintStatistics();
+
     // write a doneFile if requested
     wstring doneFile = config(L"doneFile", L"");
     if (doneFile != L"")
@@ -677,8 +804,33 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
-
+    Globals::SetQuantizedInference(config(L"quantizedInference", false));
+    Globals::SetFloat16Products(config(L"float16Products", false));
+    Globals::SetNumComputeStreams(config(L"numComputeStreams", (size_t) 0));
+    Globals::SetCudaGraphCapture(config(L"cudaGraphs", false));
+    Globals::SetForwardPlans(config(L"forwardPlans", false));
+    Globals::SetMemoryPlans(config(L"memoryPlans", false));
+    Globals::SetNetworkSimplification(config(L"simplifyNetwork", false));
+    Globals::SetElementwiseFusion(config(L"fuseElementwiseOps", false));
+    Globals::SetBatchNormActivationFusion(config(L"fuseBatchNormActivations", false));
+    Globals::SetLoopInvariantProductHoisting(config(L"hoistLoopInvariantProducts", false));
+    Globals::SetGapFrameCompaction(config(L"compactGapFrames", false));
+    Globals::SetRecomputeSegmentBytesPerSample(config(L"recomputeSegmentBytesPerSample", (size_t) 0));
+    Globals::SetOffloadLoopValues(config(L"offloadLoopValues", false));
+    Globals::SetOffloadPrefetchDistance(config(L"offloadPrefetchDistance", (size_t) 2));
+    Globals::SetCounterBasedDropout(config(L"counterBasedDropout", false));
+    Globals::SetPoolingArgmax(config(L"poolingArgmax", false));
+
+    MatrixTransferAudit::SetMode(MatrixTransferAudit::ParseMode(config(L"matrixTransferAudit", wstring(L"none"))));
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    TracingGPUMemoryAllocator::SetCachingEnabled(config(L"cacheGPUMemory", true));
+    MemoryReport::SetOutputPath(config(L"memoryReport", L""));
+
+    wstring cudnnAlgorithmCache = config(L"cudnnAlgorithmCache", L"");
+    if (!cudnnAlgorithmCache.empty())
+        ConvolutionAlgorithmCache::SetPath(cudnnAlgorithmCache);
+    intargvector cudnnAutotuneBatchSizes = config(L"cudnnAutotuneBatchSizes", ConfigParameters::Array(intargvector(vector<int>())));
+    ConvolutionAlgorithmCache::SetAutotuneBatchSizes(vector<size_t>(cudnnAutotuneBatchSizes.begin(), cudnnAutotuneBatchSizes.end()));
 
     if (logpath != L"")
     {
@@ -746,7 +898,9 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     // Setup profiling
     ProfilerContext profilerContext;
-    SetupProfiling(profilerContext, config, paralleltrain ? (int)mpi->CurrentNodeRank() : 0);
+    SetupProfiling(profilerContext, config, paralleltrain ? mpi : nullptr);
+    TrainingMetricsContext trainingMetricsContext;
+    SetupTrainingMetrics(trainingMetricsContext, config, paralleltrain ? mpi : nullptr);
 
     // run commands
     std::string type = config(L"precision", "float");
@@ -766,6 +920,11 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
     else
         RuntimeError("CNTK: Invalid precision string: \"%s\", must be \"float\" or \"double\"", type.c_str());
 
+    if (TracingGPUMemoryAllocator::IsTraceEnabled())
+        TracingGPUMemoryAllocator::PrintMemoryStatistics();
+    if (MatrixTransferAudit::GetMode() != MatrixTransferAudit::Mode::Off)
+        MatrixTransferAudit::PrintStatistics();
+
     // if completed then write a doneFile if requested
     if (!doneFile.empty())
     {
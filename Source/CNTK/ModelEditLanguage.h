@@ -399,6 +399,8 @@ public:
             found->second.Clear();
         }
 
+        // edits are compiled when the model is saved, which then only validates what they affect
+        cn->BeginEdits();
         m_mapNameToNetNdl[modelName] = NetNdl<ElemType>(cn); // newly loaded model will be the new default if none has been set yet
         if (m_netNdlDefault == nullptr)
         {
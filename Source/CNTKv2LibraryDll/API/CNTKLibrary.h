@@ -21,6 +21,11 @@
 #include <algorithm>
 #include <mutex>
 #include <future>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <functional>
 #include <cstddef>
 
 #ifdef SWIG
@@ -543,6 +548,7 @@ namespace CNTK
         friend class BlockMomentumDistributedLearner;
         friend class Internal::VariableResolver;
         friend class Trainer;
+        friend class BeamSearchDecoder;
 
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
@@ -555,6 +561,16 @@ namespace CNTK
         ///
         CNTK_API NDArrayView(::CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const DeviceDescriptor& device, bool readOnly = false);
 
+        ///
+        /// Construct a NDArrayView with the specified externally owned 'dataBuffer' as the backing storage, without copying it.
+        /// The 'dataBuffer' must have been allocated on the specified 'device' (host memory for the CPU, a device pointer for a GPU),
+        /// must be aligned to the element type and at least as large as the total size of the specified 'viewShape'.
+        /// 'releaseBuffer' is called exactly once, when neither this NDArrayView nor any view or Value sharing its storage
+        /// (Alias(), SliceView(), AsShape(), Values created over it) uses the buffer any more. It may be called on any thread and must not throw.
+        /// If construction fails, 'releaseBuffer' is not called and the buffer remains with the caller.
+        ///
+        CNTK_API NDArrayView(::CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const DeviceDescriptor& device, bool readOnly, const std::function<void()>& releaseBuffer);
+
         /// Construct a read-only NDArrayView with the specified 'dataBuffer' as the backing storage.
         /// The 'dataBuffer' must have been allocated on the specified 'device', must be at least
         /// as large as the total size of the specified 'viewShape' and must outlive the created NDArrayView object.
@@ -602,6 +618,15 @@ namespace CNTK
             : NDArrayView(AsDataType<ElementType>(), viewShape, dataBuffer, numBufferElements * sizeof(ElementType), device)
         {}
 
+        ///
+        /// Construct a NDArrayView with the specified externally owned 'dataBuffer' as the backing storage, without copying it.
+        /// 'releaseBuffer' is called once the buffer is no longer used; see the constructor taking a DataType above.
+        ///
+        template <typename ElementType>
+        NDArrayView(const NDShape& viewShape, ElementType* dataBuffer, size_t numBufferElements, const DeviceDescriptor& device, bool readOnly, const std::function<void()>& releaseBuffer)
+            : NDArrayView(AsDataType<ElementType>(), viewShape, dataBuffer, numBufferElements * sizeof(ElementType), device, readOnly, releaseBuffer)
+        {}
+
         ///
         /// Construct a NDArrayView with the buffer underlying the specified std::vector or std::array being the underlying storage.
         /// The container must be at least as large as the total size of the specified 'viewShape' and should outlive the created NDArrayView object.
@@ -712,6 +737,12 @@ namespace CNTK
         ///
         bool IsReadOnly() const { return m_isReadOnly; }
 
+        ///
+        /// Returns a boolean indicating if the elements of 'this' view are contiguous in memory; a slice of a non-trailing
+        /// axis is not. Views that are not contiguous have no DataBuffer(), and cannot be reshaped or moved to another device.
+        ///
+        CNTK_API bool IsContiguous() const;
+
         // TODO: The set methods should be offered in template from
         ///
         /// Fill 'this' NDArrayView with the specified value. The underlying DataType of 'this' view should be DataType::Float.
@@ -751,7 +782,8 @@ namespace CNTK
 
         ///
         /// Creates a new NDArrayView which is an alias of a slice of 'this' view; i.e. a new view over the underlying data
-        /// corresponding to the specified slice of 'this' view.
+        /// corresponding to the specified slice of 'this' view. Slices of dense views that are not contiguous in memory
+        /// are strided views over the same data.
         ///
         CNTK_API NDArrayViewPtr SliceView(const std::vector<size_t>& startOffset, const std::vector<size_t>& extent, bool readOnly = false) const;
 
@@ -766,6 +798,17 @@ namespace CNTK
         ///
         CNTK_API void CopyFrom(const NDArrayView& source);
 
+        ///
+        /// Starts copying the contents of the 'source' NDArrayView, which may be on another device, to 'this' view, and
+        /// returns a future that becomes ready when the copy is complete. Neither view may be accessed before.
+        ///
+        CNTK_API std::future<void> CopyFromAsync(const NDArrayViewPtr& source);
+
+        ///
+        /// Like DeepClone(), but returns at once with a future of the new NDArrayView. 'this' view may not be modified before it is ready.
+        ///
+        CNTK_API std::future<NDArrayViewPtr> DeepCloneAsync(const DeviceDescriptor& device, bool readOnly = false) const;
+
         ///
         /// Change the device of 'this' NDArrayView to the specified device
         ///
@@ -814,6 +857,9 @@ namespace CNTK
         template <typename ElementType>
         Microsoft::MSR::CNTK::TensorView<ElementType>* GetWritableTensorView();
 
+        template <typename ElementType>
+        void CopyStridedFrom(const NDArrayView& source);
+
     private:
         ::CNTK::DataType m_dataType;
         DeviceDescriptor m_device;
@@ -2330,6 +2376,14 @@ namespace CNTK
         template <typename ElementType>
         CNTK_API static ValuePtr CreateBatch(const NDShape& sampleShape, const std::vector<ElementType>& batchData, const DeviceDescriptor& device, bool readOnly = false);
 
+        ///
+        /// Creates a new Value object containing a batch of samples, over the dense data of the specified 'batchData'.
+        /// The shape of 'batchData' is the 'sampleShape', optionally followed by one axis with the number of samples.
+        /// If 'batchData' is located on the specified 'device', the Value shares its storage and no data is copied; together with a
+        /// NDArrayView over an externally owned buffer, this feeds inputs without a copy. Otherwise the data is copied to the 'device'.
+        ///
+        CNTK_API static ValuePtr CreateBatch(const NDShape& sampleShape, const NDArrayViewPtr& batchData, const DeviceDescriptor& device, bool readOnly = false);
+
         ///
         /// Creates a new Value object containing a sequence of samples.
         /// The created Value object contains a copy of the specified sequence data.
@@ -2845,6 +2899,15 @@ namespace CNTK
         ///
         Freeze,
 
+        ///
+        /// New learnable Parameters are created that share the values of the corresponding Parameters of the Function being cloned
+        /// until either of them is written; a Parameter gets a copy of its own when it is handed to a Learner, set with SetValue()
+        /// or restored from a checkpoint. Cloning thus costs no parameter memory, and only the Parameters that are trained
+        /// after cloning (e.g. the top layers being fine-tuned) are copied.
+        /// Note: writes through the NDArrayView returned by Value() are not tracked and affect all sharers.
+        ///
+        CopyOnWrite,
+
         ///
         /// Internal use only
         ///
@@ -2868,6 +2931,9 @@ namespace CNTK
         friend class Trainer;
 
         friend Variable GetCorrespondingOutputVariableFromClone(const Variable&, const FunctionPtr&, const FunctionPtr&);
+        friend CNTK_API void Internal::MarkForRecomputation(const FunctionPtr& function);
+        friend CNTK_API void Internal::MarkForOffloading(const FunctionPtr& function);
+        friend CNTK_API void Internal::PlaceOnDevice(const FunctionPtr& function, const DeviceDescriptor& device);
 
     public:
 
@@ -3001,6 +3067,19 @@ namespace CNTK
                                std::unordered_map<Variable, ValuePtr>& outputs,
                                const DeviceDescriptor& computeDevice = DeviceDescriptor::UseDefaultDevice());
 
+        ///
+        /// Same as Evaluate, but the values computed by a call stay valid across calls for as long as the 'arguments' are the same Value
+        /// objects and the parameters are unchanged, so that a later call for other outputs only computes what no earlier call did,
+        /// e.g. first the features and then the scores of an n-best list over the same input. The first Forward/Evaluate call on the
+        /// Function builds its network; when it is an EvaluateCached call, the values of the nodes shared by several outputs of the
+        /// Function are kept apart from memory sharing if they take at most 'maxCachedBytesPerSample' bytes per sample (0: no limit).
+        /// Otherwise every call computes its outputs from scratch, as Evaluate does. Values modified in place count as unchanged.
+        ///
+        CNTK_API void EvaluateCached(const std::unordered_map<Variable, ValuePtr>& arguments,
+                                     std::unordered_map<Variable, ValuePtr>& outputs,
+                                     const DeviceDescriptor& computeDevice = DeviceDescriptor::UseDefaultDevice(),
+                                     size_t maxCachedBytesPerSample = 0);
+
         ///
         /// Clones 'this' Function. The parameters of the Function are either cloned, shared or frozen as specified by the parameterCloneMethod argument and
         /// any variable replacements requested are applied in the cloned Function instance.
@@ -3911,6 +3990,13 @@ namespace CNTK
     ///
     CNTK_API FunctionPtr Clip(const Variable& operand, const Variable& min, const Variable& max, const std::wstring& name = L"");
 
+    ///
+    /// Create an instance of the CNTK built-in scaled dot-product attention of each element of the query sequence over
+    /// the elements of the corresponding sequence of keys and values: sum_j softmax_j(scale * keys_j . query_i) * values_j.
+    /// Keys and values may be on a different sequence axis than the query. A scale of 0 stands for 1/sqrt(dimension of the keys).
+    ///
+    CNTK_API FunctionPtr ScaledDotProductAttention(const Variable& query, const Variable& keys, const Variable& values, double scale = 0, const std::wstring& name = L"");
+
     ///
     /// Create an instance of the CNTK built-in elementwise choice operation using a condition tensor for specified tensor operands.
     ///
@@ -4259,6 +4345,29 @@ namespace CNTK
         // This option results in the mean value of the gradients across the samples in the minibatch to be used by the learner.
         // The mean gradient is computed by dividing the gradient values accumulated across all samples by the actual number of samples (labels) in the minibatch.
         bool useMeanGradient = false;
+
+        // Loss scaling, for products computed in fp16 (Internal::EnableFloat16Products()), whose small gradients would
+        // otherwise underflow: the Trainer multiplies the gradient of the loss by lossScale, and the learner divides the
+        // parameter gradients by it again before using them. A lossScale of 1 disables loss scaling.
+        // With dynamicLossScaling, a minibatch with Inf/NaN gradients is skipped and the scale is halved; after
+        // lossScaleGrowthInterval consecutive good minibatches the scale is doubled again.
+        double lossScale = 1.0;
+        bool dynamicLossScaling = false;
+        size_t lossScaleGrowthInterval = 2000;
+
+        // Updates the dense parameters of one device and data type together, in one kernel launch per 32 parameters
+        // instead of several launches per parameter (SGD, momentum SGD, Nesterov and Adam learners). The gradient norms
+        // for clipping and the Inf/NaN check of dynamic loss scaling are computed in one launch as well.
+        // Parameters with sparse gradients, and all parameters when clipping with truncation, are updated one by one.
+        bool multiTensorUpdate = false;
+
+        // Lazy updates of block-sparse gradients, e.g. of an embedding (Adam and FSAdaGrad learners): only the columns
+        // present in the gradient are updated, instead of the moments of all columns decaying on every minibatch.
+        // With lazyDecayCatchUp, a column first decays its moments by the minibatches that did not touch it; the
+        // parameter itself does not replay them. The AdaGrad learner, which has no decay, updates sparse gradients
+        // this way already.
+        bool lazySparseUpdate = false;
+        bool lazyDecayCatchUp = false;
     };
 
     ///  
@@ -4346,6 +4455,12 @@ namespace CNTK
             return m_sampleCount;
         }
 
+        ///
+        /// Returns the factor the gradient of the loss is multiplied with before backpropagation
+        /// (see AdditionalLearningOptions::lossScale); the learner removes it from the parameter gradients.
+        ///
+        virtual double LossScale() const { return 1.0; }
+
         ///
         /// Specifies progress writers that should be used to report any relevant stats.
         ///
@@ -4428,6 +4543,31 @@ namespace CNTK
                                     const MomentumSchedule& varianceMomentumSchedule = DefaultVarianceMomentum,
                                     AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
 
+    ///
+    /// Create an instance of the LARS learner (layer-wise adaptive rate scaling) for training with large minibatches:
+    /// momentum SGD whose learning rate for each parameter is scaled by trustCoefficient * ||w|| / ||g||, where the
+    /// gradient g includes the L2 regularization of additionalOptions, i.e. the weight decay.
+    /// Parameters that should not be scaled, such as biases, can be given to a learner of their own.
+    ///
+    CNTK_API LearnerPtr LARSLearner(const std::vector<Parameter>& parameters,
+                                    const LearningRateSchedule& learningRateSchedule,
+                                    const MomentumSchedule& momentumSchedule,
+                                    bool unitGain = DefaultUnitGainValue(),
+                                    double trustCoefficient = 0.001,
+                                    AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
+
+    ///
+    /// Create an instance of the LAMB learner for training with large minibatches: Adam whose update r of each
+    /// parameter, including the decoupled weight decay weightDecay * w, is scaled by ||w|| / ||r||.
+    ///
+    CNTK_API LearnerPtr LAMBLearner(const std::vector<Parameter>& parameters,
+                                    const LearningRateSchedule& learningRateSchedule,
+                                    const MomentumSchedule& momentumSchedule,
+                                    bool unitGain = DefaultUnitGainValue(),
+                                    const MomentumSchedule& varianceMomentumSchedule = DefaultVarianceMomentum,
+                                    double weightDecay = 0.0,
+                                    AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
+
     ///
     /// Create an instance of the CNTK built-in AdaGrad learner.
     ///
@@ -4493,6 +4633,11 @@ namespace CNTK
             m_learner->ResetSmoothedGradients();
         }
 
+        double LossScale() const override
+        {
+            return m_learner->LossScale();
+        }
+
         //
         // Returns the total number of samples needed for warmup.
         // After reaching this number of samples the learner switches to the distributed mode.
@@ -4679,6 +4824,144 @@ namespace CNTK
     ///
     CNTK_API EvaluatorPtr CreateEvaluator(const FunctionPtr& evaluationFunction, const std::vector<ProgressWriterPtr>& progressWriters = {});
 
+    ///
+    /// Statistics of a BatchingEvaluator since its creation.
+    ///
+    struct BatchingEvaluatorStatistics
+    {
+        size_t numRequests = 0;
+        size_t numBatches = 0;
+        size_t queueDepth = 0;    // requests waiting for a batch at the time of the query
+        size_t maxQueueDepth = 0;
+
+        // [i] = number of requests that took less than 2^i microseconds from Evaluate() until their result was available
+        // (and at least 2^(i-1)); the last bucket collects all slower ones
+        std::vector<size_t> latencyHistogram;
+
+        // [n] = number of batches of n requests
+        std::vector<size_t> batchSizeHistogram;
+    };
+
+    ///
+    /// BatchingEvaluator serves concurrent evaluation requests of single sequences (or samples) from many threads.
+    /// The queued requests are combined into minibatches of up to maxBatchSize sequences, which are evaluated with one
+    /// Forward() of the function on a background thread. A batch is formed as soon as it is full or the oldest queued
+    /// request has waited for maxLatency, whichever comes first.
+    ///
+    class BatchingEvaluator final : public std::enable_shared_from_this<BatchingEvaluator>
+    {
+    public:
+        ///
+        /// Queues the evaluation of the function for one sequence: the value of each argument of the function has
+        /// the argument's shape, followed by the sequence axis if the argument has one. The future returns the value
+        /// of each output of the function for this sequence, on the CPU.
+        ///
+        CNTK_API std::future<std::unordered_map<Variable, ValuePtr>> Evaluate(const std::unordered_map<Variable, NDArrayViewPtr>& arguments);
+
+        CNTK_API BatchingEvaluatorStatistics Statistics() const;
+
+        ///
+        /// Evaluates the requests that are still queued, then stops the background thread.
+        ///
+        CNTK_API ~BatchingEvaluator();
+
+    private:
+        template <typename T1, typename ...CtorArgTypes>
+        friend std::shared_ptr<T1> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+        BatchingEvaluator(const FunctionPtr& function, size_t maxBatchSize, std::chrono::microseconds maxLatency, const DeviceDescriptor& device);
+
+        struct Request
+        {
+            std::unordered_map<Variable, NDArrayViewPtr> arguments;
+            std::promise<std::unordered_map<Variable, ValuePtr>> result;
+            std::chrono::steady_clock::time_point queued;
+        };
+
+        void Run();
+        void EvaluateBatch(std::vector<Request>& batch);
+
+        const FunctionPtr m_function;
+        const std::vector<Variable> m_arguments;
+        const size_t m_maxBatchSize;
+        const std::chrono::microseconds m_maxLatency;
+        const DeviceDescriptor m_device;
+
+        mutable std::mutex m_mutex;                 // for the queue, the statistics and m_stop
+        std::condition_variable m_requestQueued;
+        std::deque<Request> m_queue;
+        BatchingEvaluatorStatistics m_statistics;
+        bool m_stop;
+        std::thread m_thread;
+    };
+
+    ///
+    /// Construct a BatchingEvaluator for the specified function, see BatchingEvaluator.
+    ///
+    CNTK_API BatchingEvaluatorPtr CreateBatchingEvaluator(const FunctionPtr& function, size_t maxBatchSize, size_t maxLatencyInMicroseconds,
+                                                          const DeviceDescriptor& device = DeviceDescriptor::UseDefaultDevice());
+
+    ///
+    /// A hypothesis found by a BeamSearchDecoder: the tokens after the start token, ending with the end token unless the
+    /// maximum length was reached, and the sum of their log-probabilities.
+    ///
+    struct BeamSearchHypothesis
+    {
+        std::vector<size_t> tokens;
+        double score;
+    };
+
+    ///
+    /// BeamSearchDecoder runs beam search over a step function of a sequence-to-sequence model. Each call of the step
+    /// function computes the log-probabilities of the next token (e.g. a LogSoftmax()) from the previous token, given as
+    /// one-hot vector, and from state inputs, for which it computes the next states. All its arguments have the batch axis
+    /// only, and each beam is one sample of the batch. Arguments that are neither the token nor a state (e.g. the encoding
+    /// of the source sentence) keep their value over all steps.
+    /// The beams, their scores and states stay on the device: the best beamWidth continuations of all beams are selected
+    /// with one top-k over the scores of the beams plus the log-probabilities, and the states are reordered by the beams the
+    /// continuations came from with a gather. A beam that emitted the end token is continued with the end token at no cost.
+    /// Only the final hypotheses are copied to the CPU.
+    ///
+    class BeamSearchDecoder final : public std::enable_shared_from_this<BeamSearchDecoder>
+    {
+    public:
+        ///
+        /// Decodes one input. 'inputs' has the value of each argument of the step function except the token: the initial
+        /// value of the states, and the value of the other arguments, each for one sample. Returns up to beamWidth
+        /// hypotheses, best first, after the end token was emitted on all beams or after 'maxLength' steps.
+        ///
+        CNTK_API std::vector<BeamSearchHypothesis> Decode(const std::unordered_map<Variable, NDArrayViewPtr>& inputs, size_t maxLength);
+
+    private:
+        template <typename T1, typename ...CtorArgTypes>
+        friend std::shared_ptr<T1> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+        BeamSearchDecoder(const FunctionPtr& stepFunction, const Variable& tokenInput, const Variable& logProbabilities,
+                          const std::unordered_map<Variable, Variable>& states, size_t startToken, size_t endToken, size_t beamWidth,
+                          const DeviceDescriptor& device);
+
+        template <typename ElementType>
+        std::vector<BeamSearchHypothesis> DecodeImpl(const std::unordered_map<Variable, NDArrayViewPtr>& inputs, size_t maxLength);
+
+        const FunctionPtr m_stepFunction;
+        const Variable m_tokenInput;
+        const Variable m_logProbabilities;
+        const std::unordered_map<Variable, Variable> m_states; // output of the step function -> the argument it is fed back to
+        const size_t m_vocabularySize;
+        const size_t m_startToken;
+        const size_t m_endToken;
+        const size_t m_beamWidth;
+        const DeviceDescriptor m_device;
+    };
+
+    ///
+    /// Construct a BeamSearchDecoder for the specified step function, see BeamSearchDecoder. 'states' maps each output of
+    /// the step function that is a next state to the argument that receives it in the next step.
+    ///
+    CNTK_API BeamSearchDecoderPtr CreateBeamSearchDecoder(const FunctionPtr& stepFunction, const Variable& tokenInput, const Variable& logProbabilities,
+                                                          const std::unordered_map<Variable, Variable>& states, size_t startToken, size_t endToken,
+                                                          size_t beamWidth, const DeviceDescriptor& device = DeviceDescriptor::UseDefaultDevice());
+
     ///
     /// Trainer is the top-level abstraction responsible for the orchestration of the training of a model
     /// using the specified learners and training data either explicitly supplied as Value objects or from
@@ -4712,11 +4995,37 @@ namespace CNTK
         ///
         CNTK_API bool TrainMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice = DeviceDescriptor::UseDefaultDevice());
 
+        ///
+        /// Accumulate the gradients of 'numSteps' consecutive TrainMinibatch calls in place in the parameter gradients, and update
+        /// the parameters only in the last of them (or at the end of a sweep) with the sum of the gradients and of the sample counts.
+        /// This trains with minibatches 'numSteps' times larger than those that fit into memory. The default 1 updates in every call.
+        /// Not supported with distributed learners.
+        ///
+        CNTK_API void SetGradientAccumulationSteps(size_t numSteps);
+
+        ///
+        /// Returns the number of TrainMinibatch calls whose gradients are accumulated for each update, see SetGradientAccumulationSteps().
+        ///
+        size_t GradientAccumulationSteps() const { return m_gradientAccumulationSteps; }
+
         ///
         /// Checkpoint the model and other Trainer state at the specified file location
         ///
         CNTK_API void SaveCheckpoint(const std::wstring& filePath, Dictionary externalState = Dictionary());
 
+        ///
+        /// Like SaveCheckpoint(), but the files are written on a background thread: the model and Trainer state are copied
+        /// to host memory before this returns, and training can go on while they are written and synced to disk.
+        /// A subsequent save or restore waits for the write to complete; WaitForCheckpoint() waits for it explicitly.
+        ///
+        CNTK_API void SaveCheckpointAsync(const std::wstring& filePath, Dictionary externalState = Dictionary());
+
+        ///
+        /// Wait until the checkpoint files of the last SaveCheckpointAsync() are written; rethrows an error of the write.
+        /// In distributed training, where only the main worker writes, all workers must call this, as for SaveCheckpoint().
+        ///
+        CNTK_API void WaitForCheckpoint();
+
         ///
         /// Restore the model and trainer state from a previously saved model and checkpoint from the specified file location
         ///
@@ -4777,13 +5086,15 @@ namespace CNTK
             const std::unordered_map<Variable, ValuePtr>& arguments,
             std::unordered_map<Variable, ValuePtr>& outputsToFetch,
             const DeviceDescriptor& computeDevice,
-            std::unordered_map<Variable, ValuePtr>& parameterGradients);
+            std::unordered_map<Variable, ValuePtr>& parameterGradients,
+            bool keepParameterGradients = false);
 
         bool TrainLocalMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, bool sweepEnd, const DeviceDescriptor& computeDevice);
         bool TrainDistributedMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, bool sweepEnd, const DeviceDescriptor& computeDevice);
 
+        void SaveCheckpointImpl(const std::wstring& modelFilePath, Dictionary externalState, bool inBackground);
         void Save(const std::wstring& modelFilePath, const std::vector<DictionaryValue>& learnerState, 
-            const Dictionary& externalState, const Dictionary& distributedState = {});
+            const Dictionary& externalState, const Dictionary& distributedState = {}, bool inBackground = false);
 
         void UpdateTrainingProgress(size_t numSamples, const ValuePtr& loss, const ValuePtr& evalCriterion, const DeviceDescriptor& computeDevice);
         void AddProgressWriters(const std::vector<ProgressWriterPtr>& progressWriters);
@@ -4807,6 +5118,13 @@ namespace CNTK
         AccumulatorPtr m_aggregatedTrainingEvalCriterionValue;
 
         size_t m_prevDistributedTotalNumSamples;
+
+        // gradient accumulation, see SetGradientAccumulationSteps()
+        size_t m_gradientAccumulationSteps;
+        size_t m_numAccumulatedMinibatches; // TrainMinibatch calls whose gradients are not applied yet
+        size_t m_numAccumulatedSamples;
+
+        std::future<void> m_pendingCheckpoint; // the background write of SaveCheckpointAsync()
     };
 
     ///
@@ -5133,6 +5451,19 @@ namespace CNTK
         std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndVariances,
         const DeviceDescriptor& device = DeviceDescriptor::CPUDevice());
 
+    ///
+    /// Same as above, but each worker of the specified communicator, which must comprise all workers, reads a different
+    /// partition of the data, and the means and variances of the workers are combined at the end.
+    /// If a cache file is specified, the results are saved to it, and taken from it instead of reading the data when the
+    /// minibatch source has the configuration that they were computed with. Only sources created by
+    /// CreateCompositeMinibatchSource() can be cached.
+    ///
+    CNTK_API void ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
+        std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndVariances,
+        const DistributedCommunicatorPtr& communicator,
+        const std::wstring& cacheFilePath = L"",
+        const DeviceDescriptor& device = DeviceDescriptor::CPUDevice());
+
     ///
     /// Set the process-wide setting for maximum number of CPU threads to be used by any individual compute operation
     /// Note that this is a per compute operation limit and if the user performs multiple compute operations concurrently
@@ -5146,6 +5477,14 @@ namespace CNTK
     ///
     CNTK_API size_t GetMaxNumCPUThreads();
 
+    ///
+    /// Reserve numCPUs of the CPUs of the process for the background threads of the readers and of the distributed gradient
+    /// aggregation, and set the maximum number of CPU threads of compute operations to the CPUs left. If 'pin' is true,
+    /// the background threads, and the compute threads of the calling thread, are pinned to their CPUs.
+    /// Call this before the first compute operation; SetMaxNumCPUThreads() afterwards is still limited to the CPUs left.
+    ///
+    CNTK_API void ReserveBackgroundCPUThreads(size_t numCPUs, bool pin = false);
+
     struct DistributedWorkerDescriptor
     {
         size_t m_globalRank;
@@ -5245,8 +5584,11 @@ namespace CNTK
 
     ///
     /// Built-in MPI-based communicator.
+    /// With useHierarchicalAggregation, the values are aggregated in the topology of the hosts when the workers run on multiple hosts:
+    /// reduce-scattered among the workers of each host (over NCCL if available), the shards all-reduced across hosts, one worker
+    /// per host for each shard, and finally all-gathered within each host again.
     ///
-    CNTK_API DistributedCommunicatorPtr MPICommunicator(size_t packThresholdSizeInBytes = Internal::DefaultPackThresholdSizeInBytes());
+    CNTK_API DistributedCommunicatorPtr MPICommunicator(size_t packThresholdSizeInBytes = Internal::DefaultPackThresholdSizeInBytes(), bool useHierarchicalAggregation = false);
 
     ///
     /// Distributed communicator that allows quantized aggregations.
@@ -5263,16 +5605,23 @@ namespace CNTK
         /// crossValidationSource: a minibatch source that will be used for cross validation.
         /// crossValidationSchedule : a minibatch size schedule for cross validation.
         /// crossValidationFrequencyInSamples: frequency in samples when to perform cross validation.
+        /// runInBackground: if flag is set, cross validation runs on a snapshot of the evaluation function on a background thread while training goes on.
+        ///                  Its result is passed to OnCrossValidationEnd() and the progress writers when it is ready, at the latest before the next one starts.
+        /// backgroundDevice: the device to run the background cross validation on, e.g. a spare GPU or the CPU.
         ///
         CNTK_API CrossValidationConfig(const MinibatchSourcePtr& crossValidationSource,
             const MinibatchSizeSchedule& crossValidationSchedule = MinibatchSizeSchedule(64),
-            size_t crossValidationFrequencyInSamples = std::numeric_limits<size_t>::max());
+            size_t crossValidationFrequencyInSamples = std::numeric_limits<size_t>::max(),
+            bool runInBackground = false,
+            const DeviceDescriptor& backgroundDevice = DeviceDescriptor::UseDefaultDevice());
 
     private:
         friend class TrainingSession;
         const MinibatchSourcePtr m_source;
         const MinibatchSizeSchedule m_mbSize;
         const size_t m_frequency;
+        const bool m_background;
+        const DeviceDescriptor m_backgroundDevice;
     };
 
     ///
@@ -5287,12 +5636,14 @@ namespace CNTK
         /// checkpointFrequencyInSamples: frequency in samples when to perform checkpointing.
         /// restoreFromCheckpointIfExists: if flag is set, the training session will try to restore before training.
         /// preserveAllCheckpoints: if flag is set, all checkpoints will be preserved.
+        /// asyncCheckpointing: if flag is set, checkpoints are written in the background while training goes on (see Trainer::SaveCheckpointAsync()).
         ///
         CNTK_API CheckpointConfig(
             const std::wstring& checkPointFileName,
             size_t checkpointFrequencyInSamples = std::numeric_limits<size_t>::max(),
             bool restoreFromCheckpointIfExists = true,
-            bool preserveAllCheckpoints = false);
+            bool preserveAllCheckpoints = false,
+            bool asyncCheckpointing = false);
 
     private:
         friend class TrainingSession;
@@ -5300,6 +5651,7 @@ namespace CNTK
         const bool m_restore;
         const bool m_preserveAll;
         const size_t m_frequency;
+        const bool m_async;
     };
 
     ///
@@ -5433,6 +5785,8 @@ namespace CNTK
         void SaveFinalCheckpoint();
 
         bool CrossValidate(size_t currentIndex, const DeviceDescriptor& computeDevice);
+        bool StartBackgroundCrossValidation(size_t currentIndex);
+        bool FinishBackgroundCrossValidation(bool wait);
         void ReportProgress(size_t currentIndex);
         void Test(const DeviceDescriptor& computeDevice);
 
@@ -5454,6 +5808,18 @@ namespace CNTK
         CheckpointConfig m_checkpoint;
         CrossValidationConfig m_cv;
         TestConfig m_test;
+
+        // The cross validation that runs in the background (CrossValidationConfig::runInBackground), if any.
+        // Declared last, so that it is waited for before the members it uses are destroyed.
+        struct BackgroundCrossValidationResult
+        {
+            size_t index;
+            EvaluatorPtr evaluator; // holds the accumulated error for the progress writers
+            double accumulatedError;
+            size_t numberOfSamples;
+            size_t numberOfMinibatches;
+        };
+        std::future<BackgroundCrossValidationResult> m_backgroundCrossValidation;
     };
 
     CNTK_API void PrintBuiltInfo();
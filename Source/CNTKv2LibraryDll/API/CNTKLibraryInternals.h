@@ -203,6 +203,12 @@ namespace CNTK
     class Evaluator;
     typedef std::shared_ptr<Evaluator> EvaluatorPtr;
 
+    class BatchingEvaluator;
+    typedef std::shared_ptr<BatchingEvaluator> BatchingEvaluatorPtr;
+
+    class BeamSearchDecoder;
+    typedef std::shared_ptr<BeamSearchDecoder> BeamSearchDecoderPtr;
+
     class Trainer;
     typedef std::shared_ptr<Trainer> TrainerPtr;
 
@@ -241,7 +247,8 @@ namespace CNTK
                                          bool transpose, const NDShape& outputShape, size_t maxTempMemSizeInSamples, const std::wstring& name = L"");
 
         // This is meant for debugging purposes only and is very likely to be deprecated in the future.
-        CNTK_API void SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile);
+        // parameterValueFormat is "full", or "float16" or "int8" to compress the values of the parameters.
+        CNTK_API void SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile, const std::wstring& parameterValueFormat = L"full");
 
         CNTK_API size_t NewUniqueId();
 
@@ -266,6 +273,79 @@ namespace CNTK
 
         CNTK_API void SetGPUMemoryAllocationTraceLevel(int traceLevel);
 
+        // Freed GPU memory is cached for reuse (on by default). EmptyGPUMemoryCache() releases the cached blocks of all GPUs
+        // to the device, e.g. for other processes or libraries; PrintGPUMemoryStatistics() reports peak, cached and fragmented bytes.
+        CNTK_API void EnableGPUMemoryCaching(bool enable);
+        CNTK_API void EmptyGPUMemoryCache();
+        CNTK_API void PrintGPUMemoryStatistics();
+
+        // Peak bytes of GPU memory in use by matrices since the start or since the last ResetPeakGPUMemory()
+        // (0 for the CPU, or with the caching turned off).
+        CNTK_API size_t GetPeakGPUMemory(const DeviceDescriptor& device);
+        CNTK_API void ResetPeakGPUMemory(const DeviceDescriptor& device);
+
+        // Count and time the transfers of matrices between the CPU and the GPUs per node ("count"), or fail on those within
+        // nodes ("fail"); "none" (the default) turns it off. PrintMatrixTransferAudit() reports and clears the counts.
+        CNTK_API void SetMatrixTransferAudit(const std::wstring& mode);
+        CNTK_API void PrintMatrixTransferAudit();
+
+        // Run independent nodes of networks concurrently on this many CUDA streams on the GPU, or on this many threads on
+        // the CPU (0 or 1: off, the default).
+        // Takes effect for networks whose matrices are allocated afterwards.
+        CNTK_API void SetNumComputeStreams(size_t numStreams);
+
+        // Record the forward pass of networks on the GPU as CUDA graphs per minibatch layout and replay them (off by default).
+        // Needs GPU memory caching. Networks with recurrent loops, random or stateful nodes, or sparse values run as before.
+        CNTK_API void EnableCudaGraphs(bool enable);
+
+        // Run repeated forward passes of networks in inference mode from a precompiled list of the nodes to run (off by default).
+        CNTK_API void EnableForwardPlans(bool enable);
+
+        // Place the shared matrices of networks in inference mode into one arena per minibatch shape (off by default).
+        CNTK_API void EnableMemoryPlans(bool enable);
+
+        // Eliminate common subexpressions and operations without effect when networks are compiled (off by default).
+        CNTK_API void EnableNetworkSimplification(bool enable);
+
+        // Evaluate chains of elementwise operations in networks as single fused tensor operations (off by default).
+        CNTK_API void EnableElementwiseFusion(bool enable);
+
+        // Evaluate batch normalizations followed by a ReLU, directly or after adding a residual, as one operation with an in-place activation (off by default).
+        CNTK_API void EnableBatchNormActivationFusion(bool enable);
+
+        // In recurrent loops, compute the input projection W_x * x of products W * RowStack(x, h) for all time steps at once (off by default).
+        CNTK_API void EnableLoopInvariantProductHoisting(bool enable);
+
+        // Compute products and elementwise operations on the valid frames of a minibatch only, skipping the gaps (off by default).
+        CNTK_API void EnableGapFrameCompaction(bool enable);
+
+        // Write a JSON-lines report of how the matrices of each network are shared to this file when they are allocated (empty: off).
+        CNTK_API void SetMemoryReportPath(const std::wstring& path);
+
+        // Gradient checkpointing: drop the values of marked functions after the forward pass and recompute them in the backward pass.
+        // MarkForRecomputation() marks a primitive function, or all functions inside a block function. With a nonzero segment size,
+        // functions are also picked automatically, in segments whose values take at most that many bytes per sample.
+        CNTK_API void MarkForRecomputation(const FunctionPtr& function);
+        CNTK_API void SetRecomputeSegmentBytesPerSample(size_t bytes);
+
+        // Host-memory offloading, on the GPU: copy the values of marked functions to host memory after the forward pass, and back
+        // 'prefetchDistance' nodes before the backward pass reads them. MarkForOffloading() marks a primitive function, or all
+        // functions inside a block function; EnableLoopValueOffloading() offloads the values of all recurrent loops.
+        CNTK_API void MarkForOffloading(const FunctionPtr& function);
+        CNTK_API void EnableLoopValueOffloading(bool enable);
+        CNTK_API void SetOffloadPrefetchDistance(size_t prefetchDistance);
+
+        // Model parallelism within one process: run a primitive function, or all functions inside a block function, on another
+        // device than the rest of the network. Parameters read only by functions on that device move there as well, and values
+        // are copied where a function reads one on another device.
+        CNTK_API void PlaceOnDevice(const FunctionPtr& function, const DeviceDescriptor& device);
+
+        // Dropout masks drawn from a counter-based generator and regenerated in the backward pass rather than stored.
+        CNTK_API void EnableCounterBasedDropout(bool enable);
+
+        // Max pooling stores the argmax of each window and backpropagates from it, without its input and output values.
+        CNTK_API void EnablePoolingArgmax(bool enable);
+
         CNTK_API void SetMathLibTraceLevel(int traceLevel);
 
         CNTK_API void ForceDeterministicAlgorithms();
@@ -286,12 +366,24 @@ namespace CNTK
         CNTK_API void EnableGradientAccumulationOptimization();
         CNTK_API void DisableGradientAccumulationOptimization();
 
+        // Computes Times() with a constant left operand in fixed point, 16 bit on the CPU and 8 bit on the GPU, for inference only.
+        CNTK_API void EnableQuantizedInference();
+        CNTK_API void DisableQuantizedInference();
+        CNTK_API void EnableFloat16Products();
+        CNTK_API void DisableFloat16Products();
+
         static const uint64_t DefaultProfilerBufferSize = 32 * 1024 * 1024;
         CNTK_API void StartProfiler(const std::wstring& profilerDir = L"profiler", bool profilerSyncGpu = false, size_t profilerBufferSize = DefaultProfilerBufferSize);
         CNTK_API void EnableProfiler();
         CNTK_API void DisableProfiler();
         CNTK_API void StopProfiler();
 
+        // Always-on training metrics (samples/s and the time of each phase of a minibatch) for monitoring, served
+        // in the Prometheus text format over HTTP on the port unless it is 0.
+        CNTK_API void StartTrainingMetrics(int port = 0);
+        CNTK_API void StopTrainingMetrics();
+        CNTK_API std::string GetTrainingMetrics();
+
         CNTK_API bool AreEquivalent(const ::CNTK::FunctionPtr& f1, const ::CNTK::FunctionPtr& f2);
         CNTK_API bool AreEquivalent(const ::CNTK::Variable& v1, const ::CNTK::Variable& v2, bool allowParameterAndConstantsEquivalence = false);
 
@@ -314,6 +406,8 @@ namespace CNTK
         /// TensorBoardFileWriter allows collecting various metrics (e.g. loss/error etc.) as the training progresses,
         /// so that they can be analyzed in TensorBoard.
         /// It also provides an option to serialize the model being trained, so that it can also be visualized.
+        /// Events are serialized and written to the file by a background thread, which flushes the file at a fixed interval,
+        /// so that logging does not hold up training.
         /// The class is NOT thread-safe: it is assumed that only one thread is using each instance.
         ///
         class TensorBoardFileWriter final
@@ -335,7 +429,7 @@ namespace CNTK
             ///
             /// Destruct the TensorBoardFileWriter and close any open files.
             ///
-            CNTK_API ~TensorBoardFileWriter() { Close(); }
+            CNTK_API ~TensorBoardFileWriter();
 
             ///
             /// Record a value of some metric at a particular step.
@@ -344,8 +438,15 @@ namespace CNTK
             ///
             CNTK_API void WriteValue(const std::wstring& name, float value, uint64_t step);
 
+            ///
+            /// Record a histogram of the values of a dense NDArrayView (e.g. the value of a parameter) at a particular step.
+            /// Only the copy of the values to the CPU happens on the calling thread.
+            ///
+            CNTK_API void WriteHistogram(const std::wstring& name, const NDArrayViewPtr& values, uint64_t step);
+
             ///
             /// Flushes any outstanding records to disk. Returns true on success, false otherwise.
+            /// Errors of earlier asynchronous writes are rethrown by this method, by Close(), and by subsequent writes.
             ///
             CNTK_API bool Flush();
 
@@ -356,10 +457,13 @@ namespace CNTK
             CNTK_API bool Close();
 
         private:
+            // These run on the background thread.
             void Init();
             void WriteModel();
             void WriteRecord(const std::string& data);
             void WriteVersion(time_t time);
+            bool FlushFile();
+            bool CloseFile();
 
             // Disable copy-construction and assignment.
             TensorBoardFileWriter(const TensorBoardFileWriter& other) = delete;
@@ -369,6 +473,9 @@ namespace CNTK
             const std::wstring m_dir;
             FILE* m_file;
             std::wstring m_fileName;
+
+            class BackgroundWriter;
+            std::unique_ptr<BackgroundWriter> m_backgroundWriter;
         };
 
         ///
@@ -24,6 +24,7 @@
 #include "DeprecatedNodes.h"
 #include "SpecialPurposeNodes.h"
 #include "SequenceReshapeNodes.h"
+#include "PerformanceProfiler.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -482,6 +483,12 @@ namespace CNTK
 
                     opType = PrimitiveOpType::ForwardBackward;
                 }
+                else if (node->OperationName() == OperationNameOf(ScaledDotProductAttentionNode))
+                {
+                    primitiveFunctionConfigParameters[PrimitiveFunction::AttributeNameAttentionScale] = node->As<ScaledDotProductAttentionNode<ElementType>>()->Scale();
+
+                    opType = PrimitiveOpType::ScaledDotProductAttention;
+                }
                 else if (node->OperationName() == OperationNameOf(CosDistanceWithNegativeSamplesNode))
                 {
                     opType = PrimitiveOpType::CosDistanceWithNegativeSamples;
@@ -570,11 +577,14 @@ namespace CNTK
                 NOT_IMPLEMENTED;
             }
 
+            Microsoft::MSR::CNTK::ScopeProfile profBuild(Microsoft::MSR::CNTK::profilerEvtLoadBuild);
             return ConvertFromLegacyModel(net);
         }
 
         FunctionPtr ConvertFromLegacyModel(const ComputationNetworkPtr& net)
         {
+            net->MaterializeParameters(); // the Parameters take over the values
+
             // Traverse the model and construct the Function graph
             std::unordered_map<ComputationNodeBasePtr, Variable> nodeToVariableMap;
             std::unordered_map<Variable, Variable> placeholderReplacements;
@@ -605,7 +615,7 @@ namespace CNTK
             return rootComposite;
         }
 
-        void SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile)
+        void SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile, const std::wstring& parameterValueFormat)
         {
             CompositeFunction* compositeFunction = dynamic_cast<CompositeFunction*>(rootFunction.get());
             if (compositeFunction == nullptr)
@@ -635,7 +645,7 @@ namespace CNTK
                 LogicError("SaveAsLegacyModel: Function '%S' has unknown DataType %s.", rootFunction->AsString().c_str(), DataTypeName(dataType));
             }
 
-            computationNetwork->Save(modelFile);
+            computationNetwork->Save(modelFile, FileOptions::fileOptionsBinary, ParseParameterValueFormat(parameterValueFormat));
         }
 
         LegacyModelDataType DetectLegacyModelDataType(const std::wstring& modelFile)
@@ -0,0 +1,184 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Utils.h"
+
+namespace CNTK
+{
+    // buckets of the latency histogram: [i] < 2^i microseconds, the last one for everything slower (> 1 minute)
+    static const size_t numLatencyBuckets = 27;
+
+    BatchingEvaluatorPtr CreateBatchingEvaluator(const FunctionPtr& function, size_t maxBatchSize, size_t maxLatencyInMicroseconds, const DeviceDescriptor& device)
+    {
+        return MakeSharedObject<BatchingEvaluator>(function, maxBatchSize, std::chrono::microseconds(maxLatencyInMicroseconds), device);
+    }
+
+    BatchingEvaluator::BatchingEvaluator(const FunctionPtr& function, size_t maxBatchSize, std::chrono::microseconds maxLatency, const DeviceDescriptor& device)
+        : m_function(function),
+          m_arguments(function ? function->Arguments() : std::vector<Variable>()),
+          m_maxBatchSize(maxBatchSize),
+          m_maxLatency(maxLatency),
+          m_device(device),
+          m_stop(false)
+    {
+        if (!m_function)
+            InvalidArgument("BatchingEvaluator: The function must not be null.");
+        if (m_maxBatchSize == 0)
+            InvalidArgument("BatchingEvaluator: The maximum batch size must be at least 1.");
+
+        m_statistics.latencyHistogram.resize(numLatencyBuckets, 0);
+        m_statistics.batchSizeHistogram.resize(m_maxBatchSize + 1, 0);
+
+        // The function is evaluated on this thread only, since Forward() is not reentrant.
+        m_thread = std::thread([this] { Run(); });
+    }
+
+    BatchingEvaluator::~BatchingEvaluator()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_requestQueued.notify_one();
+        m_thread.join();
+    }
+
+    std::future<std::unordered_map<Variable, ValuePtr>> BatchingEvaluator::Evaluate(const std::unordered_map<Variable, NDArrayViewPtr>& arguments)
+    {
+        // Invalid requests are rejected here, so that they do not fail the batch they would have been part of.
+        for (const auto& argument : m_arguments)
+        {
+            auto iter = arguments.find(argument);
+            if (iter == arguments.end() || !iter->second)
+                InvalidArgument("BatchingEvaluator::Evaluate: No value specified for the argument '%S'.", argument.AsString().c_str());
+
+            const auto& shape = iter->second->Shape();
+            const auto& sampleShape = argument.Shape();
+            size_t numSequenceAxes = argument.DynamicAxes().size() > 1 ? 1 : 0;
+            if (shape.Rank() < sampleShape.Rank() || shape.Rank() > sampleShape.Rank() + numSequenceAxes ||
+                shape.SubShape(0, sampleShape.Rank()) != sampleShape)
+                InvalidArgument("BatchingEvaluator::Evaluate: The shape '%S' of the value of the argument '%S' does not match its sample shape '%S'.",
+                                shape.AsString().c_str(), argument.AsString().c_str(), sampleShape.AsString().c_str());
+            if (iter->second->GetDataType() != argument.GetDataType())
+                InvalidArgument("BatchingEvaluator::Evaluate: The data type of the value of the argument '%S' does not match.", argument.AsString().c_str());
+        }
+        if (arguments.size() != m_arguments.size())
+            InvalidArgument("BatchingEvaluator::Evaluate: %d values specified for the %d arguments of the function.", (int)arguments.size(), (int)m_arguments.size());
+
+        Request request;
+        request.arguments = arguments;
+        request.queued = std::chrono::steady_clock::now();
+        auto result = request.result.get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop)
+                LogicError("BatchingEvaluator::Evaluate: The evaluator is being destroyed.");
+            m_queue.push_back(std::move(request));
+            m_statistics.numRequests++;
+            m_statistics.maxQueueDepth = std::max(m_statistics.maxQueueDepth, m_queue.size());
+        }
+        m_requestQueued.notify_one();
+        return result;
+    }
+
+    BatchingEvaluatorStatistics BatchingEvaluator::Statistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        BatchingEvaluatorStatistics statistics = m_statistics;
+        statistics.queueDepth = m_queue.size();
+        return statistics;
+    }
+
+    void BatchingEvaluator::Run()
+    {
+        std::vector<Request> batch;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_requestQueued.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+                if (m_queue.empty())
+                    return; // stopped
+
+                // Wait for more requests until the batch is full or the oldest request is due.
+                auto deadline = m_queue.front().queued + m_maxLatency;
+                m_requestQueued.wait_until(lock, deadline, [this] { return m_stop || m_queue.size() >= m_maxBatchSize; });
+
+                size_t batchSize = std::min(m_queue.size(), m_maxBatchSize);
+                for (size_t i = 0; i < batchSize; i++)
+                {
+                    batch.push_back(std::move(m_queue.front()));
+                    m_queue.pop_front();
+                }
+                m_statistics.numBatches++;
+                m_statistics.batchSizeHistogram[batchSize]++;
+            }
+
+            EvaluateBatch(batch);
+
+            auto now = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (const auto& request : batch)
+                {
+                    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - request.queued).count();
+                    size_t bucket = 0;
+                    while (bucket + 1 < numLatencyBuckets && latency >= (1LL << bucket))
+                        bucket++;
+                    m_statistics.latencyHistogram[bucket]++;
+                }
+            }
+            batch.clear();
+        }
+    }
+
+    // Packs the sequences of the requests into one minibatch (Value::Create() masks the gaps of the shorter ones),
+    // evaluates it, and unpacks the outputs into the results of the requests.
+    void BatchingEvaluator::EvaluateBatch(std::vector<Request>& batch)
+    {
+        std::vector<std::unordered_map<Variable, ValuePtr>> results(batch.size());
+        try
+        {
+            std::unordered_map<Variable, ValuePtr> arguments;
+            for (const auto& argument : m_arguments)
+            {
+                std::vector<NDArrayViewPtr> sequences;
+                sequences.reserve(batch.size());
+                for (const auto& request : batch)
+                    sequences.push_back(request.arguments.at(argument));
+                arguments[argument] = Value::Create(argument.Shape(), sequences, m_device, /*readOnly =*/ true);
+            }
+
+            std::unordered_map<Variable, ValuePtr> outputs;
+            for (const auto& output : m_function->Outputs())
+                outputs[output] = nullptr;
+
+            m_function->Forward(arguments, outputs, m_device);
+
+            for (const auto& output : outputs)
+            {
+                auto sequences = output.second->UnpackVariableValue(output.first, DeviceDescriptor::CPUDevice());
+                if (sequences.size() != batch.size())
+                    LogicError("BatchingEvaluator: The output '%S' has %d sequences for a batch of %d requests.",
+                               output.first.AsString().c_str(), (int)sequences.size(), (int)batch.size());
+
+                // The results must not refer to the storage of the output, it is reused for the next batch.
+                for (size_t i = 0; i < batch.size(); i++)
+                    results[i][output.first] = MakeSharedObject<Value>(sequences[i]->DeepClone(DeviceDescriptor::CPUDevice(), /*readOnly =*/ true));
+            }
+        }
+        catch (...)
+        {
+            for (auto& request : batch)
+                request.result.set_exception(std::current_exception());
+            return;
+        }
+
+        for (size_t i = 0; i < batch.size(); i++)
+            batch[i].result.set_value(std::move(results[i]));
+    }
+}
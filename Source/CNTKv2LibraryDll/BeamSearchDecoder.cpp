@@ -0,0 +1,233 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Utils.h"
+#include "Matrix.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace CNTK
+{
+    BeamSearchDecoderPtr CreateBeamSearchDecoder(const FunctionPtr& stepFunction, const Variable& tokenInput, const Variable& logProbabilities,
+                                                 const std::unordered_map<Variable, Variable>& states, size_t startToken, size_t endToken,
+                                                 size_t beamWidth, const DeviceDescriptor& device)
+    {
+        return MakeSharedObject<BeamSearchDecoder>(stepFunction, tokenInput, logProbabilities, states, startToken, endToken, beamWidth, device);
+    }
+
+    BeamSearchDecoder::BeamSearchDecoder(const FunctionPtr& stepFunction, const Variable& tokenInput, const Variable& logProbabilities,
+                                         const std::unordered_map<Variable, Variable>& states, size_t startToken, size_t endToken, size_t beamWidth,
+                                         const DeviceDescriptor& device)
+        : m_stepFunction(stepFunction),
+          m_tokenInput(tokenInput),
+          m_logProbabilities(logProbabilities),
+          m_states(states),
+          m_vocabularySize(logProbabilities.Shape().TotalSize()),
+          m_startToken(startToken),
+          m_endToken(endToken),
+          m_beamWidth(beamWidth),
+          m_device(device)
+    {
+        if (!m_stepFunction)
+            InvalidArgument("BeamSearchDecoder: The step function must not be null.");
+        if (m_beamWidth == 0)
+            InvalidArgument("BeamSearchDecoder: The beam width must be at least 1.");
+
+        const auto arguments = m_stepFunction->Arguments();
+        const auto outputs = m_stepFunction->Outputs();
+        auto isArgument = [&arguments](const Variable& var) { return std::find(arguments.begin(), arguments.end(), var) != arguments.end(); };
+        auto isOutput = [&outputs](const Variable& var) { return std::find(outputs.begin(), outputs.end(), var) != outputs.end(); };
+        for (const auto& argument : arguments)
+        {
+            if (argument.DynamicAxes().size() != 1)
+                InvalidArgument("BeamSearchDecoder: The argument '%S' of the step function must have the batch axis only.", argument.AsString().c_str());
+        }
+
+        if (!isArgument(m_tokenInput))
+            InvalidArgument("BeamSearchDecoder: The token input '%S' is not an argument of the step function.", m_tokenInput.AsString().c_str());
+        if (!isOutput(m_logProbabilities))
+            InvalidArgument("BeamSearchDecoder: The log-probabilities '%S' are not an output of the step function.", m_logProbabilities.AsString().c_str());
+        if (m_logProbabilities.GetDataType() != DataType::Float && m_logProbabilities.GetDataType() != DataType::Double)
+            InvalidArgument("BeamSearchDecoder: The log-probabilities must be of type float or double.");
+        if (m_tokenInput.Shape().TotalSize() != m_vocabularySize || m_tokenInput.GetDataType() != m_logProbabilities.GetDataType())
+            InvalidArgument("BeamSearchDecoder: The token input '%S' must be a one-hot vector of the size and type of the log-probabilities '%S'.",
+                            m_tokenInput.AsString().c_str(), m_logProbabilities.AsString().c_str());
+        if (m_startToken >= m_vocabularySize || m_endToken >= m_vocabularySize)
+            InvalidArgument("BeamSearchDecoder: The start and end tokens must be less than the vocabulary size %d.", (int)m_vocabularySize);
+        // The selected continuations are indexed by token and beam, as element type.
+        if (m_logProbabilities.GetDataType() == DataType::Float && m_vocabularySize * m_beamWidth > (1 << 24))
+            InvalidArgument("BeamSearchDecoder: %d tokens times %d beams cannot be indexed exactly in float.", (int)m_vocabularySize, (int)m_beamWidth);
+
+        for (const auto& state : m_states)
+        {
+            if (!isOutput(state.first) || !isArgument(state.second))
+                InvalidArgument("BeamSearchDecoder: The state '%S' -> '%S' must map an output of the step function to an argument.",
+                                state.first.AsString().c_str(), state.second.AsString().c_str());
+            if (state.first.Shape() != state.second.Shape() || state.first.GetDataType() != state.second.GetDataType())
+                InvalidArgument("BeamSearchDecoder: The state output '%S' does not match the shape and type of its argument '%S'.",
+                                state.first.AsString().c_str(), state.second.AsString().c_str());
+            if (state.first.GetDataType() != m_logProbabilities.GetDataType())
+                InvalidArgument("BeamSearchDecoder: The state '%S' must have the data type of the log-probabilities.", state.first.AsString().c_str());
+        }
+    }
+
+    std::vector<BeamSearchHypothesis> BeamSearchDecoder::Decode(const std::unordered_map<Variable, NDArrayViewPtr>& inputs, size_t maxLength)
+    {
+        if (m_logProbabilities.GetDataType() == DataType::Float)
+            return DecodeImpl<float>(inputs, maxLength);
+        else
+            return DecodeImpl<double>(inputs, maxLength);
+    }
+
+    template <typename ElementType>
+    std::vector<BeamSearchHypothesis> BeamSearchDecoder::DecodeImpl(const std::unordered_map<Variable, NDArrayViewPtr>& inputs, size_t maxLength)
+    {
+        const size_t V = m_vocabularySize;
+        const size_t B = m_beamWidth;
+        const auto deviceId = AsCNTKImplDeviceId(m_device);
+        const DataType dataType = AsDataType<ElementType>();
+        const ElementType impossible = (ElementType)-1e30; // the score of beams that do not exist (yet), and of continuations of ended ones
+
+        // The values of the arguments: each input is replicated to all beams.
+        std::unordered_map<Variable, NDArrayViewPtr> argumentValues;
+        Matrix<ElementType> firstBeam(1, B, deviceId);
+        firstBeam.SetValue(0);
+        for (const auto& argument : m_stepFunction->Arguments())
+        {
+            const auto rank = argument.Shape().Rank();
+            NDArrayViewPtr value = MakeSharedObject<NDArrayView>(dataType, argument.Shape().AppendShape({ B }), m_device);
+            argumentValues[argument] = value;
+            if (argument == m_tokenInput)
+                continue;
+
+            auto iter = inputs.find(argument);
+            if (iter == inputs.end() || !iter->second)
+                InvalidArgument("BeamSearchDecoder::Decode: No value specified for the argument '%S'.", argument.AsString().c_str());
+            if (iter->second->Shape() != argument.Shape() || iter->second->GetDataType() != dataType)
+                InvalidArgument("BeamSearchDecoder::Decode: The value of the argument '%S' must be one sample of shape '%S'.",
+                                argument.AsString().c_str(), argument.Shape().AsString().c_str());
+            NDArrayViewPtr input = iter->second->Device() == m_device ? iter->second : iter->second->DeepClone(m_device, /*readOnly =*/ true);
+            value->GetWritableMatrix<ElementType>(rank)->DoGatherColumnsOf(0, firstBeam, *input->GetMatrix<ElementType>(rank), 1);
+        }
+        if (inputs.size() + 1 != argumentValues.size())
+            InvalidArgument("BeamSearchDecoder::Decode: %d values specified for the %d arguments of the step function other than the token.",
+                            (int)inputs.size(), (int)argumentValues.size() - 1);
+
+        // The continuations are numbered beam * V + token. What these numbers stand for, as a row vector to gather from.
+        std::vector<ElementType> beamOf(V * B), tokenOf(V * B), endsOf(V * B), continuesOf(V * B);
+        for (size_t i = 0; i < V * B; i++)
+        {
+            beamOf[i] = (ElementType)(i / V);
+            tokenOf[i] = (ElementType)(i % V);
+            endsOf[i] = (ElementType)(i % V == m_endToken ? 1 : 0);
+            continuesOf[i] = 1 - endsOf[i];
+        }
+        Matrix<ElementType> beamOfContinuation(1, V * B, beamOf.data(), deviceId);
+        Matrix<ElementType> tokenOfContinuation(1, V * B, tokenOf.data(), deviceId);
+        Matrix<ElementType> endsOfContinuation(1, V * B, endsOf.data(), deviceId);
+        Matrix<ElementType> continuesOfContinuation(1, V * B, continuesOf.data(), deviceId);
+
+        // ended beams can only continue with the end token
+        std::vector<ElementType> endedLogProbabilities(V, impossible);
+        endedLogProbabilities[m_endToken] = 0;
+        Matrix<ElementType> endedLogP(V, 1, endedLogProbabilities.data(), deviceId);
+        Matrix<ElementType> ones(V, 1, deviceId);
+        ones.SetValue(1);
+
+        // the state of the beams
+        std::vector<ElementType> initialScores(B, impossible);
+        initialScores[0] = 0;
+        Matrix<ElementType> scores(1, B, initialScores.data(), deviceId);
+        Matrix<ElementType> tokens(1, B, deviceId);
+        tokens.SetValue((ElementType)m_startToken);
+        Matrix<ElementType> ended(1, B, deviceId);
+        ended.SetValue(0);
+        Matrix<ElementType> continues(1, B, deviceId);
+        continues.SetValue(1);
+        Matrix<ElementType> sourceBeams(1, B, deviceId);
+        Matrix<ElementType> tokenHistory(B, maxLength, deviceId);
+        Matrix<ElementType> sourceBeamHistory(B, maxLength, deviceId);
+
+        Matrix<ElementType> candidateScores(V, B, deviceId);
+        Matrix<ElementType> selected(B, 1, deviceId);
+        Matrix<ElementType> selectedScores(B, 1, deviceId);
+        std::vector<size_t> oneHotShape = { V };
+        size_t length = 0;
+        while (length < maxLength)
+        {
+            argumentValues[m_tokenInput]->GetWritableMatrix<ElementType>(m_tokenInput.Shape().Rank())->AssignOneHot(tokens, oneHotShape, 0, /*is_sparse =*/ false);
+
+            // new Values each step, since a cached evaluation keeps the results of the same Values
+            std::unordered_map<Variable, ValuePtr> arguments;
+            for (const auto& argumentValue : argumentValues)
+                arguments[argumentValue.first] = MakeSharedObject<Value>(argumentValue.second);
+            std::unordered_map<Variable, ValuePtr> outputs = { { m_logProbabilities, nullptr } };
+            for (const auto& state : m_states)
+                outputs[state.first] = nullptr;
+            m_stepFunction->Forward(arguments, outputs, m_device);
+
+            // score of beam b continued with token v = scores[b] + logP[v, b], or only the end token at no cost if b ended
+            candidateScores.SetValue(*outputs[m_logProbabilities]->Data()->GetMatrix<ElementType>(m_logProbabilities.Shape().Rank()));
+            candidateScores.RowElementMultiplyWith(continues);
+            Matrix<ElementType>::MultiplyAndAdd(endedLogP, false, ended, false, candidateScores);
+            Matrix<ElementType>::MultiplyAndAdd(ones, false, scores, false, candidateScores);
+
+            // the best B continuations of all beams
+            candidateScores.Reshape(V * B, 1);
+            candidateScores.TopK(selectedScores, selected, B);
+            candidateScores.Reshape(V, B);
+            selected.Reshape(1, B);
+            sourceBeams.DoGatherColumnsOf(0, selected, beamOfContinuation, 1);
+            tokens.DoGatherColumnsOf(0, selected, tokenOfContinuation, 1);
+            ended.DoGatherColumnsOf(0, selected, endsOfContinuation, 1);
+            continues.DoGatherColumnsOf(0, selected, continuesOfContinuation, 1);
+            scores.SetValue(selectedScores.Reshaped(1, B));
+            selected.Reshape(B, 1);
+            tokenHistory.SetColumnSlice(tokens.Reshaped(B, 1), length, 1);
+            sourceBeamHistory.SetColumnSlice(sourceBeams.Reshaped(B, 1), length, 1);
+            length++;
+
+            for (const auto& state : m_states)
+            {
+                const auto rank = state.second.Shape().Rank();
+                argumentValues[state.second]->GetWritableMatrix<ElementType>(rank)->DoGatherColumnsOf(0, sourceBeams, *outputs[state.first]->Data()->GetMatrix<ElementType>(rank), 1);
+            }
+
+            if (continues.SumOfElements() == 0) // all beams ended
+                break;
+        }
+
+        // Trace the beams back on the CPU.
+        if (length == 0)
+            return std::vector<BeamSearchHypothesis>();
+        std::vector<ElementType> finalScores(B), tokenTrace(B * length), sourceBeamTrace(B * length);
+        scores.CopySection(1, B, finalScores.data(), 1);
+        tokenHistory.CopySection(B, length, tokenTrace.data(), B);
+        sourceBeamHistory.CopySection(B, length, sourceBeamTrace.data(), B);
+
+        std::vector<BeamSearchHypothesis> hypotheses;
+        for (size_t b = 0; b < B; b++)
+        {
+            if (finalScores[b] <= impossible / 2) // not a real beam, e.g. if there are fewer continuations than beams
+                continue;
+            BeamSearchHypothesis hypothesis;
+            hypothesis.score = finalScores[b];
+            for (size_t t = length, beam = b; t-- > 0;)
+            {
+                hypothesis.tokens.push_back((size_t)tokenTrace[t * B + beam]);
+                beam = (size_t)sourceBeamTrace[t * B + beam];
+            }
+            std::reverse(hypothesis.tokens.begin(), hypothesis.tokens.end());
+            auto end = std::find(hypothesis.tokens.begin(), hypothesis.tokens.end(), m_endToken);
+            if (end != hypothesis.tokens.end())
+                hypothesis.tokens.erase(end + 1, hypothesis.tokens.end());
+            hypotheses.push_back(std::move(hypothesis));
+        }
+        std::stable_sort(hypotheses.begin(), hypotheses.end(), [](const BeamSearchHypothesis& a, const BeamSearchHypothesis& b) { return a.score > b.score; });
+        return hypotheses;
+    }
+}
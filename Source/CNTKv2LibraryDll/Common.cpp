@@ -14,7 +14,10 @@
 #include <thread>
 #include "GPUMatrix.h"
 #include "Globals.h"
+#include "MemoryReport.h"
 #include "PerformanceProfiler.h"
+#include "TrainingMetrics.h"
+#include "ThreadPool.h"
 #include "MPIWrapper.h"
 #include "Basics.h"
 #include "ProgressTracing.h"
@@ -168,6 +171,26 @@ namespace CNTK
             Microsoft::MSR::CNTK::Globals::SetGradientAccumulationOptimization(/* enable = */ false);
         }
 
+        void EnableQuantizedInference()
+        {
+            Microsoft::MSR::CNTK::Globals::SetQuantizedInference(/* enable = */ true);
+        }
+
+        void DisableQuantizedInference()
+        {
+            Microsoft::MSR::CNTK::Globals::SetQuantizedInference(/* enable = */ false);
+        }
+
+        void EnableFloat16Products()
+        {
+            Microsoft::MSR::CNTK::Globals::SetFloat16Products(/* enable = */ true);
+        }
+
+        void DisableFloat16Products()
+        {
+            Microsoft::MSR::CNTK::Globals::SetFloat16Products(/* enable = */ false);
+        }
+
         void StartProfiler(const wstring& profilerDir, bool profilerSyncGpu, size_t profilerBufferSize)
         {
             std::wstring logSuffix = L"";
@@ -182,6 +205,10 @@ namespace CNTK
                 profilerBufferSize,
                 logSuffix,
                 profilerSyncGpu);
+
+            // No clock synchronization here, it would hang if not all workers start the profiler.
+            if (mpi)
+                Microsoft::MSR::CNTK::ProfilerSetRank((int)mpi->CurrentNodeRank(), 0);
         }
 
         void EnableProfiler()
@@ -199,6 +226,24 @@ namespace CNTK
             Microsoft::MSR::CNTK::ProfilerClose();
         }
 
+        void StartTrainingMetrics(int port)
+        {
+            Microsoft::MSR::CNTK::TrainingMetricsEnable(true);
+            if (port > 0 && !Microsoft::MSR::CNTK::TrainingMetricsStartServer(port))
+                RuntimeError("StartTrainingMetrics: Cannot serve the training metrics on port %d.", port);
+        }
+
+        void StopTrainingMetrics()
+        {
+            Microsoft::MSR::CNTK::TrainingMetricsStopServer();
+            Microsoft::MSR::CNTK::TrainingMetricsEnable(false);
+        }
+
+        std::string GetTrainingMetrics()
+        {
+            return Microsoft::MSR::CNTK::TrainingMetricsGetText();
+        }
+
         bool AreEquivalent(const Variable& var1, const Variable& var2, bool allowParameterAndConstantsEquivalence)
         {
             bool areDynamicAxesCompatible = (var1.DynamicAxes().size() == var2.DynamicAxes().size());
@@ -461,6 +506,119 @@ namespace CNTK
             Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::SetTraceLevel(traceLevel);
         }
 
+        void EnableGPUMemoryCaching(bool enable)
+        {
+            Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::SetCachingEnabled(enable);
+        }
+
+        void EmptyGPUMemoryCache()
+        {
+            Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::EmptyCache();
+        }
+
+        void PrintGPUMemoryStatistics()
+        {
+            Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::PrintMemoryStatistics();
+        }
+
+        size_t GetPeakGPUMemory(const DeviceDescriptor& device)
+        {
+            if (device.Type() != DeviceKind::GPU)
+                return 0;
+            return Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::GetMemoryStatistics((int)device.Id()).peakAllocatedBytes;
+        }
+
+        void ResetPeakGPUMemory(const DeviceDescriptor& device)
+        {
+            if (device.Type() == DeviceKind::GPU)
+                Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::ResetPeakMemoryStatistics((int)device.Id());
+        }
+
+        void SetMatrixTransferAudit(const std::wstring& mode)
+        {
+            Microsoft::MSR::CNTK::MatrixTransferAudit::SetMode(Microsoft::MSR::CNTK::MatrixTransferAudit::ParseMode(mode));
+        }
+
+        void PrintMatrixTransferAudit()
+        {
+            Microsoft::MSR::CNTK::MatrixTransferAudit::PrintStatistics();
+        }
+
+        void SetNumComputeStreams(size_t numStreams)
+        {
+            Microsoft::MSR::CNTK::Globals::SetNumComputeStreams(numStreams);
+        }
+
+        void EnableCudaGraphs(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetCudaGraphCapture(enable);
+        }
+
+        void EnableForwardPlans(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetForwardPlans(enable);
+        }
+
+        void EnableMemoryPlans(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetMemoryPlans(enable);
+        }
+
+        void EnableNetworkSimplification(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetNetworkSimplification(enable);
+        }
+
+        void EnableElementwiseFusion(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetElementwiseFusion(enable);
+        }
+
+        void EnableBatchNormActivationFusion(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetBatchNormActivationFusion(enable);
+        }
+
+        void EnableLoopInvariantProductHoisting(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetLoopInvariantProductHoisting(enable);
+        }
+
+        void EnableGapFrameCompaction(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetGapFrameCompaction(enable);
+        }
+
+        void SetMemoryReportPath(const std::wstring& path)
+        {
+            Microsoft::MSR::CNTK::MemoryReport::SetOutputPath(path);
+        }
+
+        void SetRecomputeSegmentBytesPerSample(size_t bytes)
+        {
+            Microsoft::MSR::CNTK::Globals::SetRecomputeSegmentBytesPerSample(bytes);
+        }
+
+        void EnableLoopValueOffloading(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetOffloadLoopValues(enable);
+        }
+
+        void SetOffloadPrefetchDistance(size_t prefetchDistance)
+        {
+            Microsoft::MSR::CNTK::Globals::SetOffloadPrefetchDistance(prefetchDistance);
+        }
+
+        void EnableCounterBasedDropout(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetCounterBasedDropout(enable);
+        }
+
+        void EnablePoolingArgmax(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetPoolingArgmax(enable);
+        }
+
         void SetMathLibTraceLevel(int traceLevel)
         {
             Microsoft::MSR::CNTK::SetMathLibTraceLevel(traceLevel);
@@ -783,6 +941,12 @@ namespace CNTK
         return Microsoft::MSR::CNTK::CPUMatrix<float>::GetMaxNumThreads();
     }
 
+    void ReserveBackgroundCPUThreads(size_t numCPUs, bool pin)
+    {
+        Microsoft::MSR::CNTK::ThreadPool::Instance().ReserveBackgroundCpus((int)numCPUs, pin);
+        SetMaxNumCPUThreads(0); // the CPUs left
+    }
+
     static std::atomic<bool> s_defaultUnitGainValue(true);
 
     bool DefaultUnitGainValue() 
@@ -391,17 +391,20 @@ namespace CNTK
             
             primitiveFunction->SetState(functionState);
 
-            if (!m_computationNetwork)
+            if (!m_computationNetwork && m_inactiveEvaluationPlans.empty())
                 continue;
 
             auto seed = functionState[PrimitiveFunction::AttributeNameRngSeed].Value<size_t>();
             auto offset = functionState[PrimitiveFunction::AttributeNameRngOffset].Value<size_t>();
 
-            // copy the state directly into the network
+            // copy the state directly into the networks
             for (const auto& output : function->RawOutputs())
             {
-                auto node = m_variableToNodeMap.at(output);
-                node->As<RngUser>()->SetRngState(seed, offset);
+                if (m_computationNetwork)
+                    m_variableToNodeMap.at(output)->As<RngUser>()->SetRngState(seed, offset);
+
+                for (auto& plan : m_inactiveEvaluationPlans)
+                    plan.variableToNodeMap.at(output)->As<RngUser>()->SetRngState(seed, offset);
             }
         }
     }
@@ -1000,6 +1003,12 @@ namespace CNTK
                 case PrimitiveOpType::Assign:
                     computationNodePtr = New<AssignNode<ElementType>>(network->GetDeviceId(), internalNodeName);
                     break;
+                case PrimitiveOpType::ScaledDotProductAttention:
+                {
+                    auto scale = functionConfig[PrimitiveFunction::AttributeNameAttentionScale].Value<double>();
+                    computationNodePtr = New<ScaledDotProductAttentionNode<ElementType>>(network->GetDeviceId(), internalNodeName, scale);
+                    break;
+                }
                 default:
                     CNTK::LogicError("Specified op %S not yet supported", PrimitiveOpTypeName(op).c_str());
                     break;
@@ -1024,6 +1033,15 @@ namespace CNTK
                     auto offset = functionConfig[PrimitiveFunction::AttributeNameRngOffset].Value<size_t>();
                     computationNodePtr->As<RngUser>()->SetRngState(seed, offset);
                 }
+
+                if (functionConfig.Contains(PrimitiveFunction::AttributeNameRecompute) && functionConfig[PrimitiveFunction::AttributeNameRecompute].Value<bool>())
+                    computationNodePtr->MarkForRecomputation();
+
+                if (functionConfig.Contains(PrimitiveFunction::AttributeNameOffload) && functionConfig[PrimitiveFunction::AttributeNameOffload].Value<bool>())
+                    computationNodePtr->MarkForOffloading();
+
+                if (functionConfig.Contains(PrimitiveFunction::AttributeNamePlacementDeviceId))
+                    computationNodePtr->PlaceOnDevice((DEVICEID_TYPE)functionConfig[PrimitiveFunction::AttributeNamePlacementDeviceId].Value<int>());
             }
             else
             {
@@ -1098,6 +1116,9 @@ namespace CNTK
             // For block function, map each argument placeholder of the underlying composite to
             // the computation node corresponding to the block input that the argument placeholder
             // of the composite is mapped to.
+            // Blocks are thus inlined: the network has no nodes at block boundaries, and its passes
+            // (elementwise fusion, gap compaction, memory sharing) see a single graph. The block
+            // structure only remains in the Function graph, for serialization and FindByName().
             auto compositeArguments = blockFunction->Composite()->Arguments();
             for (auto compositeArgument : compositeArguments)
                 variableToNodeMap[compositeArgument] = variableToNodeMap.at(compositeArgument.BlockFunctionVariableMapping());
@@ -1129,6 +1150,17 @@ namespace CNTK
         return result;
     }
 
+    // The value of a copy-on-write clone's Parameter (ParameterCloningMethod::CopyOnWrite) is replaced by a copy when it is
+    // first written, which may happen after the network was compiled over the shared value; this points the node at the copy.
+    template <typename ElementType>
+    /*static*/ void CompositeFunction::BindParameterNodeValue(const Parameter& parameter, const ComputationNodeBasePtr& node)
+    {
+        auto valueMatrix = parameter.Value()->GetWritableMatrix<ElementType>();
+        auto& nodeValue = std::dynamic_pointer_cast<ComputationNode<ElementType>>(node)->Value();
+        if (nodeValue.Data() != valueMatrix->Data())
+            nodeValue = valueMatrix->AsReference();
+    }
+
     static bool VariableShapeMatchesNodeShape(const NDShape& varShape, const TensorShape& nodeShape) 
     {
         if (varShape.Rank() == 0)
@@ -1154,6 +1186,74 @@ namespace CNTK
         return true;
     }
 
+    /*static*/ bool CompositeFunction::IsEvaluationPlanCompatible(const ComputationNetworkPtr& computationNetwork,
+                                                                  const std::unordered_set<Variable>& planBackpropRoots,
+                                                                  const std::unordered_set<Variable>& planInputsExcludedFromGradientComputation,
+                                                                  bool planNetworkMatricesAllocated,
+                                                                  const std::unordered_set<Variable>& planNetworkRoots,
+                                                                  const DeviceDescriptor& device,
+                                                                  const std::unordered_set<Variable>& backpropRoots,
+                                                                  const std::unordered_set<Variable>& outputs,
+                                                                  const std::unordered_set<Variable>& inputsToExcludeGradientsFor)
+    {
+        if (!computationNetwork || (AsDeviceDescriptor(computationNetwork->GetDeviceId()) != device))
+            return false;
+
+        // A plan for backpropagation serves calls without backprop roots as well.
+        if (!backpropRoots.empty() && ((planBackpropRoots != backpropRoots) || (planInputsExcludedFromGradientComputation != inputsToExcludeGradientsFor)))
+            return false;
+
+        // The matrices are allocated for the roots of the network.
+        if (planNetworkMatricesAllocated)
+        {
+            for (const auto& output : outputs)
+            {
+                if (planNetworkRoots.find(output) == planNetworkRoots.end())
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    void CompositeFunction::SwapEvaluationPlan(EvaluationPlan& plan)
+    {
+        std::swap(m_computationNetwork, plan.computationNetwork);
+        std::swap(m_variableToNodeMap, plan.variableToNodeMap);
+        std::swap(m_currentBackpropRoots, plan.currentBackpropRoots);
+        std::swap(m_currentOutputsToEvaluate, plan.currentOutputsToEvaluate);
+        std::swap(m_networkMatricesAllocated, plan.networkMatricesAllocated);
+        std::swap(m_allNetworkRoots, plan.allNetworkRoots);
+        std::swap(m_lastRecordedParameterValueTimeStamps, plan.lastRecordedParameterValueTimeStamps);
+        std::swap(m_inputsExcludedFromGradientComputation, plan.inputsExcludedFromGradientComputation);
+        std::swap(m_retainsSharedValues, plan.retainsSharedValues);
+        std::swap(m_cachedArguments, plan.cachedArguments);
+    }
+
+    bool CompositeFunction::SwitchEvaluationPlan(const std::function<bool(const EvaluationPlan&)>& isSuitable, bool newIfNoneIsSuitable)
+    {
+        auto suitablePlan = std::find_if(m_inactiveEvaluationPlans.rbegin(), m_inactiveEvaluationPlans.rend(), isSuitable);
+        if ((suitablePlan == m_inactiveEvaluationPlans.rend()) && !newIfNoneIsSuitable)
+            return false;
+
+        EvaluationPlan previousPlan;
+        SwapEvaluationPlan(previousPlan);
+        if (suitablePlan != m_inactiveEvaluationPlans.rend())
+        {
+            SwapEvaluationPlan(*suitablePlan);
+            m_inactiveEvaluationPlans.erase(std::next(suitablePlan).base());
+        }
+
+        if (previousPlan.computationNetwork)
+        {
+            m_inactiveEvaluationPlans.push_back(std::move(previousPlan));
+            if (m_inactiveEvaluationPlans.size() > s_maxInactiveEvaluationPlans)
+                m_inactiveEvaluationPlans.erase(m_inactiveEvaluationPlans.begin());
+        }
+
+        return true;
+    }
+
     template <typename ElementType>
     ComputationNetworkPtr CompositeFunction::GetComputationNetwork(const DeviceDescriptor& device,
                                                                    const std::unordered_set<Variable>& backpropRoots,
@@ -1161,23 +1261,20 @@ namespace CNTK
                                                                    const std::unordered_set<Variable>& inputsToExcludeGradientsFor,
                                                                    bool allocateNetworkMatrices)
     {
-        if (m_computationNetwork != nullptr)
+        // Calls for outputs, backprop roots or a device that the network of the active plan was not compiled for switch to
+        // a plan that was, or compile a new one, and keep the active one for later calls.
+        if ((m_computationNetwork != nullptr) &&
+            !IsEvaluationPlanCompatible(m_computationNetwork, m_currentBackpropRoots, m_inputsExcludedFromGradientComputation, m_networkMatricesAllocated, m_allNetworkRoots,
+                                        device, backpropRoots, outputs, inputsToExcludeGradientsFor))
         {
-            // TODO: We should either invalidate and readapt the network if the backpropRoots change compared to what was specified when the network
-            // was last constructed, to just recreate a new network.
-            // For now just disallow changing the backpropRoots after the network is created
-            if (!backpropRoots.empty() && (m_currentBackpropRoots != backpropRoots))
-                LogicError("Function '%S': Changing backprop roots (Current = '%S', New = '%S') across different Forward calls on a CNTK composite Function is currently unsupported.",
-                            AsString().c_str(), NamedListString(m_currentBackpropRoots).c_str(), NamedListString(backpropRoots).c_str());
-
-            // TODO: Support changing the device across different invocations of the forward method on a Function instance
-            if (AsDeviceDescriptor(m_computationNetwork->GetDeviceId()) != device)
-                LogicError("Function '%S': Changing device (Current = '%S', New = %S') across different Forward calls on a CNTK composite Function is currently unsupported.",
-                            AsString().c_str(), AsDeviceDescriptor(m_computationNetwork->GetDeviceId()).AsString().c_str(), device.AsString().c_str());
-            
-            if (!backpropRoots.empty() && (inputsToExcludeGradientsFor != m_inputsExcludedFromGradientComputation))
-                LogicError("Function '%S': Changing the set of inputs to exclude from gradient computation, across different Forward calls on a CNTK composite Function, is currently unsupported.", AsString().c_str());
+            SwitchEvaluationPlan([&](const EvaluationPlan& plan) {
+                return IsEvaluationPlanCompatible(plan.computationNetwork, plan.currentBackpropRoots, plan.inputsExcludedFromGradientComputation, plan.networkMatricesAllocated, plan.allNetworkRoots,
+                                                  device, backpropRoots, outputs, inputsToExcludeGradientsFor);
+            }, /*newIfNoneIsSuitable =*/ true);
+        }
 
+        if (m_computationNetwork != nullptr)
+        {
             // Verify if the free dimensions of any of the arguments have changed, and if so, update the corresponding
             // input ComputationNodes and rerun validation on the computation network
             for (auto freeDimensionArgumentMapping : m_fullyDefinedArgumentsMap)
@@ -1360,6 +1457,14 @@ namespace CNTK
             for (auto output : outputs)
                 forwardOutputNodes.push_back(m_variableToNodeMap.at(output));
 
+            // the values that the roots share are kept for later cached evaluations, unless they take too much memory
+            if (m_cachedEvaluation)
+            {
+                std::vector<ComputationNodeBasePtr> allRootNodes(forwardRootNodes);
+                allRootNodes.insert(allRootNodes.end(), forwardOutputNodes.begin(), forwardOutputNodes.end());
+                m_retainsSharedValues = m_computationNetwork->RetainSharedValues(allRootNodes, m_maxCachedBytesPerSample);
+            }
+
             m_computationNetwork->AllocateAllMatrices(forwardRootNodes, forwardOutputNodes, backpropRootNode);
             m_networkMatricesAllocated = allocateNetworkMatrices;
         }
@@ -1538,6 +1643,10 @@ namespace CNTK
                                   varValue->Shape().AsString().c_str(), var.AsString().c_str(), getGradient ? "gradient" : "output", valueShape.AsString().c_str());
         }
 
+        // A specified PackedValue that is still packed receives the packed data, without unpacking and repacking
+        auto packedVarValue = std::dynamic_pointer_cast<PackedValue>(varValue);
+        bool keepPacked = (varValue == nullptr) || (packedVarValue && packedVarValue->IsPacked());
+
         ValuePtr nodeValue;
         auto layout = computationNode->GetMBLayout();
         switch (var.GetDataType())
@@ -1545,7 +1654,7 @@ namespace CNTK
         case DataType::Float:
         {
             auto& matrix = getGradient ? computationNode->As<ComputationNode<float>>()->Gradient() : computationNode->As<ComputationNode<float>>()->Value();
-            if (varValue == nullptr)
+            if (keepPacked)
                 nodeValue = MakeSharedObject<PackedValue>(varShape, var.DynamicAxes(), std::make_shared<Matrix<float>>(matrix.AsReference()), layout, /*readOnly =*/ false);
             else
                 nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(var, computationNode, matrix, layout);
@@ -1554,7 +1663,7 @@ namespace CNTK
         case DataType::Double:
         {
             auto& matrix = getGradient ? computationNode->As<ComputationNode<double>>()->Gradient() : computationNode->As<ComputationNode<double>>()->Value();
-            if (varValue == nullptr)
+            if (keepPacked)
                 nodeValue = MakeSharedObject<PackedValue>(varShape, var.DynamicAxes(), std::make_shared<Matrix<double>>(matrix.AsReference()), layout, /*readOnly =*/ false);
             else
                 nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(var, computationNode, matrix, layout);
@@ -1637,13 +1746,18 @@ namespace CNTK
 
     std::unordered_map<Variable, uint64_t> CompositeFunction::GetCurrentBackpropRootsTimeStamps() const
     {
-        std::unordered_map<Variable, uint64_t> currentBackpropRootsTimeStamps;
         assert(m_computationNetwork != nullptr);
+        return GetBackpropRootsTimeStamps(m_currentBackpropRoots, m_variableToNodeMap);
+    }
 
-        for (auto& backpropRoot : m_currentBackpropRoots)
-            currentBackpropRootsTimeStamps[backpropRoot] = m_variableToNodeMap.at(backpropRoot)->GetEvalTimeStamp();
+    /*static*/ std::unordered_map<Variable, uint64_t> CompositeFunction::GetBackpropRootsTimeStamps(const std::unordered_set<Variable>& backpropRoots,
+                                                                                                   const std::unordered_map<Variable, ComputationNodeBasePtr>& variableToNodeMap)
+    {
+        std::unordered_map<Variable, uint64_t> backpropRootsTimeStamps;
+        for (auto& backpropRoot : backpropRoots)
+            backpropRootsTimeStamps[backpropRoot] = variableToNodeMap.at(backpropRoot)->GetEvalTimeStamp();
 
-        return currentBackpropRootsTimeStamps;
+        return backpropRootsTimeStamps;
     }
 
     /*virtual*/ BackPropStatePtr CompositeFunction::Forward(const std::unordered_map<Variable, ValuePtr>& arguments,
@@ -1706,6 +1820,17 @@ namespace CNTK
                             (int)missingRequiredArguments.size(), NamedListString(missingRequiredArguments).c_str(), NamedListString(requestedOutputVariables).c_str());
         }
 
+        // A cached evaluation sets all arguments that it is given, so that the next call for other outputs finds them unchanged.
+        if (m_cachedEvaluation)
+        {
+            for (const auto& argument : Arguments())
+            {
+                auto iter = arguments.find(argument);
+                if (iter != arguments.end())
+                    requiredArgumentValues.insert(*iter);
+            }
+        }
+
         if (requiredArgumentValues.size() < arguments.size())
             fprintf(stderr, "WARNING: Function::Forward provided values for (%d) extra arguments which are not required for evaluating the specified Function outputs!\n", (int)(arguments.size() - requiredArgumentValues.size()));
 
@@ -1718,18 +1843,8 @@ namespace CNTK
         else
             InvalidArgument("Unsupported DataType %s", DataTypeName(dataType));
 
-        // Feed data into the arguments of the network
-        // TODO: Avoid copying the data when possible
-        PopulateNetworkInputs(requiredArgumentValues);
-
-        // Dropout nodes have an implicit input in the form of the random mask that is applied to its explicit input
-        // This mask is regenerated every minibatch and hence dropout nodes with a non-zero dropout rate must me marked outdated
-        // w.r.t. inputs to force evaluation in each minibatch
-        list<ComputationNodeBasePtr> dropoutNodes = m_computationNetwork->GetNodesWithType(OperationNameOf(DropoutNode));
-        for (auto& nodeIter : dropoutNodes)
-            nodeIter->SetEvalTimeStampOutdatedWrtAll();
-        
         // Bump the timestamp of the parameter nodes whose values have changed
+        bool parametersChanged = false;
         for (auto& paramTimeStampRecord : m_lastRecordedParameterValueTimeStamps)
         {
             auto parameter = paramTimeStampRecord.first;
@@ -1738,10 +1853,46 @@ namespace CNTK
             if (newTimeStamp > prevTimeStamp)
             {
                 paramTimeStampRecord.second = newTimeStamp;
-                m_variableToNodeMap.at(parameter)->BumpEvalTimeStamp();
+                const auto& node = m_variableToNodeMap.at(parameter);
+                if (dataType == DataType::Float)
+                    BindParameterNodeValue<float>(parameter, node);
+                else
+                    BindParameterNodeValue<double>(parameter, node);
+                node->BumpEvalTimeStamp();
+                parametersChanged = true;
             }
         }
 
+        // A cached evaluation over the same argument Values (and parameters) as the last one keeps all values computed since,
+        // so that only the nodes that no earlier call evaluated run.
+        bool keepValues = m_cachedEvaluation && m_retainsSharedValues && !parametersChanged;
+        for (const auto& argumentValue : requiredArgumentValues)
+        {
+            auto iter = m_cachedArguments.find(argumentValue.first);
+            keepValues = keepValues && iter != m_cachedArguments.end() && iter->second == argumentValue.second;
+        }
+        if (m_cachedEvaluation)
+        {
+            if (!keepValues)
+                m_cachedArguments = requiredArgumentValues;
+        }
+        else
+            m_cachedArguments.clear();
+
+        if (!keepValues)
+        {
+            // Feed data into the arguments of the network
+            // TODO: Avoid copying the data when possible
+            PopulateNetworkInputs(requiredArgumentValues);
+
+            // Dropout nodes have an implicit input in the form of the random mask that is applied to its explicit input
+            // This mask is regenerated every minibatch and hence dropout nodes with a non-zero dropout rate must me marked outdated
+            // w.r.t. inputs to force evaluation in each minibatch
+            list<ComputationNodeBasePtr> dropoutNodes = m_computationNetwork->GetNodesWithType(OperationNameOf(DropoutNode));
+            for (auto& nodeIter : dropoutNodes)
+                nodeIter->SetEvalTimeStampOutdatedWrtAll();
+        }
+
         std::vector<ComputationNodeBasePtr> outputsToEvaluate;
         for (auto outputVariable : requestedOutputVariables)
             outputsToEvaluate.push_back(m_variableToNodeMap.at(outputVariable));
@@ -1790,6 +1941,26 @@ namespace CNTK
         return backpropStatePtr;
     }
 
+    void CompositeFunction::EvaluateCached(const std::unordered_map<Variable, ValuePtr>& arguments,
+                                           std::unordered_map<Variable, ValuePtr>& outputs,
+                                           const DeviceDescriptor& computeDevice,
+                                           size_t maxCachedBytesPerSample)
+    {
+        m_maxCachedBytesPerSample = maxCachedBytesPerSample;
+        m_cachedEvaluation = true;
+        try
+        {
+            Forward(arguments, outputs, computeDevice, {}, {});
+        }
+        catch (...)
+        {
+            m_cachedEvaluation = false;
+            m_cachedArguments.clear(); // the network may hold some of the new arguments
+            throw;
+        }
+        m_cachedEvaluation = false;
+    }
+
     /*virtual*/ void CompositeFunction::Backward(const BackPropStatePtr& state,
                                                  const std::unordered_map<Variable, ValuePtr>& rootGradientValues,
                                                  std::unordered_map<Variable, ValuePtr>& backPropagatedGradientValuesForInputs)
@@ -1798,9 +1969,18 @@ namespace CNTK
         if (backpropState == nullptr)
             InvalidArgument("Function '%S' Backward: Invalid backprop state passed.", AsString().c_str());
 
-        // TODO: Support multiple concurrent backprop states
+        // The Forward call may have run on another evaluation plan than the latest one.
+        // TODO: Support multiple concurrent backprop states of the same plan
+        const auto& forwardTimeStamps = backpropState->BackpropRootsForwardTimeStamps();
         std::unordered_map<Variable, uint64_t> currentBackpropRootTimeStamps = GetCurrentBackpropRootsTimeStamps();
-        if (backpropState->BackpropRootsForwardTimeStamps() != currentBackpropRootTimeStamps)
+        if ((forwardTimeStamps != currentBackpropRootTimeStamps) &&
+            SwitchEvaluationPlan([&](const EvaluationPlan& plan) { return GetBackpropRootsTimeStamps(plan.currentBackpropRoots, plan.variableToNodeMap) == forwardTimeStamps; },
+                                 /*newIfNoneIsSuitable =*/ false))
+        {
+            currentBackpropRootTimeStamps = GetCurrentBackpropRootsTimeStamps();
+        }
+
+        if (forwardTimeStamps != currentBackpropRootTimeStamps)
             LogicError("Function '%S' Backward: The specified backprop state specified cannot be used for backpropagation as the Function's internal state was modified "
                         "by subsequent Forward calls to the function. This is not a user error but a shortcoming of the current implementation where multiple independent "
                         "backprop states are not simultaneously supported.", AsString().c_str());
@@ -1811,9 +1991,9 @@ namespace CNTK
 
         // TODO: Avoid copying the data when possible
 
-        // Zero all gradients of nodes below the root nodes
+        // Zero all gradients of nodes below the root nodes (but those of the parameters if they are being accumulated)
         for (auto rootGradientVarValuePair : rootGradientValues)
-            m_computationNetwork->ZeroInputGradients(m_variableToNodeMap.at(rootGradientVarValuePair.first));
+            m_computationNetwork->ZeroInputGradients(m_variableToNodeMap.at(rootGradientVarValuePair.first), m_keepParameterGradients);
 
         // Feed data into the arguments of the network
         PopulateNetworkGradients(rootGradientValues);
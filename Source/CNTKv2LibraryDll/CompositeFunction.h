@@ -51,11 +51,16 @@ namespace CNTK
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
 
-        friend void Internal::SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile);
+        friend void Internal::SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile, const std::wstring& parameterValueFormat);
 
         friend void ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
                                                          std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
                                                          const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/);
+        friend void ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
+                                                         std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
+                                                         const DistributedCommunicatorPtr& communicator,
+                                                         const std::wstring& cacheFilePath /*= L""*/,
+                                                         const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/);
 
         static std::atomic<unsigned int> s_nextAutoGeneratedDynamicAxis;
 
@@ -90,6 +95,12 @@ namespace CNTK
                                  const std::unordered_set<Variable>& outputsToRetainBackwardStateFor,
                                  const std::unordered_set<Variable>& inputsToExcludeGradientsFor);
 
+        // see Function::EvaluateCached()
+        void EvaluateCached(const std::unordered_map<Variable, ValuePtr>& arguments,
+                            std::unordered_map<Variable, ValuePtr>& outputs,
+                            const DeviceDescriptor& computeDevice,
+                            size_t maxCachedBytesPerSample);
+
         virtual BackPropStatePtr Forward(const std::vector<ValuePtr>& /*inputValues*/,
                                          std::unordered_map<Variable, ValuePtr>& /*outputs*/,
                                          const DeviceDescriptor& /*computeDevice*/,
@@ -108,6 +119,10 @@ namespace CNTK
                               const std::unordered_map<Variable, ValuePtr>& rootGradientValues,
                               std::unordered_map<Variable, ValuePtr>& backPropagatedGradientValuesForInputs) override;
 
+        // Makes the following Backward calls add the gradients of the parameters to those of the previous call rather than
+        // replace them, so that the gradients of several minibatches add up in place (see Trainer::SetGradientAccumulationSteps()).
+        void KeepParameterGradients(bool keep) { m_keepParameterGradients = keep; }
+
         Dictionary SerializeBlockComposite() const;
 
         virtual Dictionary Serialize() const override;
@@ -205,7 +220,8 @@ namespace CNTK
 
         CompositeFunction(const FunctionPtr& rootFunction, std::unordered_set<FunctionPtr>&& allPrimitiveFunctions, const std::wstring& name, const std::wstring& uid = Internal::GenerateUid(L"CompositeFunction"))
             : Function({}, Dictionary(), rootFunction, name, uid),
-            m_allPrimitiveFunctions(std::move(allPrimitiveFunctions)), m_networkMatricesAllocated(false)
+            m_allPrimitiveFunctions(std::move(allPrimitiveFunctions)), m_networkMatricesAllocated(false),
+            m_cachedEvaluation(false), m_maxCachedBytesPerSample(0), m_retainsSharedValues(false), m_keepParameterGradients(false)
         {}
 
         std::vector<Variable> DetermineInputs(bool pythonOperandOrder = false) const
@@ -264,6 +280,39 @@ namespace CNTK
 
         std::unordered_map<Variable, NDShape> InferFreeDimensionsOfArguments(const std::unordered_map<Variable, ValuePtr>& arguments);
 
+        // The state that goes with a compiled ComputationNetwork. The active plan is held in the members of the same names;
+        // see SwitchEvaluationPlan().
+        struct EvaluationPlan
+        {
+            Microsoft::MSR::CNTK::ComputationNetworkPtr computationNetwork;
+            std::unordered_map<Variable, Microsoft::MSR::CNTK::ComputationNodeBasePtr> variableToNodeMap;
+            std::unordered_set<Variable> currentBackpropRoots;
+            std::vector<Microsoft::MSR::CNTK::ComputationNodeBasePtr> currentOutputsToEvaluate;
+            bool networkMatricesAllocated = false;
+            std::unordered_set<Variable> allNetworkRoots;
+            std::unordered_map<Parameter, size_t> lastRecordedParameterValueTimeStamps;
+            std::unordered_set<Variable> inputsExcludedFromGradientComputation;
+            bool retainsSharedValues = false;
+            std::unordered_map<Variable, ValuePtr> cachedArguments;
+        };
+
+        static bool IsEvaluationPlanCompatible(const Microsoft::MSR::CNTK::ComputationNetworkPtr& computationNetwork,
+                                               const std::unordered_set<Variable>& planBackpropRoots,
+                                               const std::unordered_set<Variable>& planInputsExcludedFromGradientComputation,
+                                               bool planNetworkMatricesAllocated,
+                                               const std::unordered_set<Variable>& planNetworkRoots,
+                                               const DeviceDescriptor& device,
+                                               const std::unordered_set<Variable>& backpropRoots,
+                                               const std::unordered_set<Variable>& outputs,
+                                               const std::unordered_set<Variable>& inputsToExcludeGradientsFor);
+
+        // Exchanges the active evaluation plan with 'plan'.
+        void SwapEvaluationPlan(EvaluationPlan& plan);
+
+        // Makes the most recently used inactive plan that 'isSuitable' active, or else, if 'newIfNoneIsSuitable', an empty one,
+        // which GetComputationNetwork() then compiles. Returns whether the active plan changed.
+        bool SwitchEvaluationPlan(const std::function<bool(const EvaluationPlan&)>& isSuitable, bool newIfNoneIsSuitable);
+
         template <typename ElementType>
         Microsoft::MSR::CNTK::ComputationNetworkPtr GetComputationNetwork(const DeviceDescriptor& device,
                                                                           const std::unordered_set<Variable>& backpropRoots,
@@ -295,6 +344,9 @@ namespace CNTK
                                                                     std::unordered_map<Variable, bool>& isVariableRootMap,
                                                                     const std::unordered_set<Variable>& inputsToExcludeGradientsFor);
 
+        template <typename ElementType>
+        static void BindParameterNodeValue(const Parameter& parameter, const Microsoft::MSR::CNTK::ComputationNodeBasePtr& node);
+
         template <typename ElementType>
         static void PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, std::unordered_map< Microsoft::MSR::CNTK::MBLayoutPtr, Variable>& layoutsPopulated);
         void PopulateNetworkInputs(const std::unordered_map<Variable, ValuePtr>& arguments);
@@ -313,6 +365,8 @@ namespace CNTK
         const std::vector<Variable>& GetArgumentDependencies(const Variable& output);
 
         std::unordered_map<Variable, uint64_t> GetCurrentBackpropRootsTimeStamps() const;
+        static std::unordered_map<Variable, uint64_t> GetBackpropRootsTimeStamps(const std::unordered_set<Variable>& backpropRoots,
+                                                                                 const std::unordered_map<Variable, Microsoft::MSR::CNTK::ComputationNodeBasePtr>& variableToNodeMap);
 
         void ClearExistingOutputOrGradientStorageReferences()
         {
@@ -364,6 +418,22 @@ namespace CNTK
 
         std::unordered_set<Variable> m_inputsExcludedFromGradientComputation;
 
+        // Cached evaluation (see Function::EvaluateCached()): whether the Forward call in progress is one, whether the network keeps
+        // the values that its roots share apart from memory sharing, and the arguments that the network holds the values of.
+        bool m_cachedEvaluation;
+        size_t m_maxCachedBytesPerSample;
+        bool m_retainsSharedValues;
+        std::unordered_map<Variable, ValuePtr> m_cachedArguments;
+
+        // whether Backward adds to the gradients of the parameters, see KeepParameterGradients()
+        bool m_keepParameterGradients;
+
+        // Compiled networks for other outputs, backprop roots or devices than the active one, least recently used first.
+        // Interleaved training, evaluation and feature extraction calls switch between them instead of recompiling; they
+        // share the parameters, and each holds the memory of its own network.
+        std::vector<EvaluationPlan> m_inactiveEvaluationPlans;
+        static const size_t s_maxInactiveEvaluationPlans = 3;
+
         // Version history:
         // 1 -- initial version.
         // 2 -- add support for stateful functions (with corresponding nodes inheriting from RngUser).
@@ -7,6 +7,9 @@
 #include "CNTKLibrary.h"
 #include "Utils.h"
 #include "CompositeFunction.h"
+#include "MinibatchSource.h"
+#include "MPIWrapper.h"
+#include "fileutil.h"
 #include <tuple>
 #include "ComputationNetworkBuilder.h"
 
@@ -14,13 +17,107 @@ using namespace Microsoft::MSR::CNTK;
 
 namespace CNTK
 {
+    static const std::wstring s_readerConfigurationKey = L"readerConfiguration";
+    static const std::wstring s_streamsKey = L"streams";
+
+    // Takes the means and inverse standard deviations of the streams from the cache file, if it has all of them for the
+    // reader configuration.
+    static bool TryLoadCachedMeansAndInvStdDevs(const std::wstring& cacheFilePath, const Dictionary& readerConfiguration,
+                                                std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
+                                                const DeviceDescriptor& device)
+    {
+        if (!fexists(cacheFilePath))
+            return false;
+
+        Dictionary cache = Dictionary::Load(cacheFilePath);
+        if (!cache.Contains(s_readerConfigurationKey) || cache[s_readerConfigurationKey].Value<Dictionary>() != readerConfiguration)
+            return false;
+
+        const auto& streams = cache[s_streamsKey].Value<Dictionary>();
+        for (const auto& currentStreamKV : computedMeanAndInvStdDevs)
+        {
+            if (!streams.Contains(currentStreamKV.first.m_name))
+                return false;
+
+            const auto& meanAndInvStdDev = streams[currentStreamKV.first.m_name].Value<std::vector<DictionaryValue>>();
+            if (meanAndInvStdDev[0].Value<NDArrayView>().Shape() != currentStreamKV.first.m_sampleLayout)
+                return false;
+        }
+
+        for (auto& currentStreamKV : computedMeanAndInvStdDevs)
+        {
+            const auto& meanAndInvStdDev = streams[currentStreamKV.first.m_name].Value<std::vector<DictionaryValue>>();
+            auto& mean = currentStreamKV.second.first;
+            auto& invStdDev = currentStreamKV.second.second;
+            if (mean)
+                mean->CopyFrom(meanAndInvStdDev[0].Value<NDArrayView>());
+            else
+                mean = meanAndInvStdDev[0].Value<NDArrayView>().DeepClone(device);
+
+            if (invStdDev)
+                invStdDev->CopyFrom(meanAndInvStdDev[1].Value<NDArrayView>());
+            else
+                invStdDev = meanAndInvStdDev[1].Value<NDArrayView>().DeepClone(device);
+        }
+
+        return true;
+    }
+
+    static void SaveMeansAndInvStdDevsToCache(const std::wstring& cacheFilePath, const Dictionary& readerConfiguration,
+                                              const std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs)
+    {
+        Dictionary streams;
+        for (const auto& currentStreamKV : computedMeanAndInvStdDevs)
+        {
+            auto mean = currentStreamKV.second.first->DeepClone(DeviceDescriptor::CPUDevice());
+            auto invStdDev = currentStreamKV.second.second->DeepClone(DeviceDescriptor::CPUDevice());
+            streams[currentStreamKV.first.m_name] = std::vector<DictionaryValue>{ *mean, *invStdDev };
+        }
+
+        Dictionary cache;
+        cache[s_readerConfigurationKey] = readerConfiguration;
+        cache[s_streamsKey] = streams;
+        cache.Save(cacheFilePath);
+    }
+
+    void ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
+                                              std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
+                                              const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/)
+    {
+        ComputeInputPerDimMeansAndInvStdDevs(minibatchSource, computedMeanAndInvStdDevs, nullptr, L"", device);
+    }
+
     void ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
                                               std::unordered_map<StreamInformation, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
+                                              const DistributedCommunicatorPtr& communicator,
+                                              const std::wstring& cacheFilePath /*= L""*/,
                                               const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/)
     {
         typedef std::shared_ptr<ComputationNode<float>> ComputationNodePtr;
         const auto& minibatchSourceStreams = minibatchSource->StreamInfos();
 
+        size_t numberOfWorkers = communicator ? communicator->Workers().size() : 1;
+        size_t workerRank = communicator ? communicator->CurrentWorker().m_globalRank : 0;
+        MPIWrapperPtr mpi;
+        if (numberOfWorkers > 1)
+        {
+            mpi = MPIWrapper::GetInstance();
+            if (!mpi || mpi->NumNodesInUse() != numberOfWorkers)
+                InvalidArgument("ComputeInputPerDimMeansAndInvStdDevs: The communicator must comprise all workers.");
+        }
+
+        Dictionary readerConfiguration;
+        if (!cacheFilePath.empty())
+        {
+            auto compositeMinibatchSource = std::dynamic_pointer_cast<CompositeMinibatchSource>(minibatchSource);
+            if (!compositeMinibatchSource)
+                InvalidArgument("ComputeInputPerDimMeansAndInvStdDevs: Only the results for minibatch sources created by CreateCompositeMinibatchSource() can be cached.");
+
+            readerConfiguration = compositeMinibatchSource->Configuration();
+            if (TryLoadCachedMeansAndInvStdDevs(cacheFilePath, readerConfiguration, computedMeanAndInvStdDevs, device))
+                return;
+        }
+
         auto computationNetwork = std::make_shared<ComputationNetwork>(AsCNTKImplDeviceId(device));
         ComputationNetworkBuilder<float> builder(*computationNetwork);
 
@@ -82,7 +179,8 @@ namespace CNTK
         const size_t minibatchSize = maxMinibatchDataSize / totalSizePerSample;
         for (;;)
         {
-            auto minibatchData = minibatchSource->GetNextMinibatch(minibatchSize, device);
+            // Each worker reads its own partition of the data.
+            auto minibatchData = minibatchSource->GetNextMinibatch(/*minibatchSizeInSequences=*/0, minibatchSize, numberOfWorkers, workerRank, device);
             if (minibatchData.empty())
                 break;
 
@@ -96,7 +194,11 @@ namespace CNTK
 
         // finalize
         for (auto & preComputeNode : preComputeNodes)
+        {
+            if (mpi)
+                dynamic_pointer_cast<IPreComputeNode>(preComputeNode)->AggregateAcrossWorkers(*mpi);
             dynamic_pointer_cast<IPreComputeNode>(preComputeNode)->MarkComputed(true /*done accumulating*/);
+        }
 
         // Copy out the results
         for (auto& currentStreamKV : computedMeanAndInvStdDevs)
@@ -117,5 +219,12 @@ namespace CNTK
             if (computedMeanAndInvStdDevs[currentStreamKV.first].second == nullptr)
                 computedMeanAndInvStdDevs[currentStreamKV.first].second = invStdDev->Data();
         }
+
+        // All workers have the same results, so one of them writes the cache.
+        if (!cacheFilePath.empty() && workerRank == 0)
+            SaveMeansAndInvStdDevsToCache(cacheFilePath, readerConfiguration, computedMeanAndInvStdDevs);
+
+        if (communicator && numberOfWorkers > 1)
+            communicator->Barrier();
     }
 }
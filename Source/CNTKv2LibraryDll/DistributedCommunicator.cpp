@@ -29,9 +29,9 @@ namespace CNTK
         }
     }
 
-    DistributedCommunicatorPtr MPICommunicator(size_t packThresholdSizeInBytes)
+    DistributedCommunicatorPtr MPICommunicator(size_t packThresholdSizeInBytes, bool useHierarchicalAggregation)
     {
-        return std::make_shared<MPICommunicatorImpl>(packThresholdSizeInBytes);
+        return std::make_shared<MPICommunicatorImpl>(packThresholdSizeInBytes, useHierarchicalAggregation);
     }
 
     void DistributedCommunicator::Finalize()
@@ -66,7 +66,7 @@ namespace CNTK
         return nullptr; // Make compiler happy.
     }
 
-    MPICommunicatorImpl::MPICommunicatorImpl(size_t packThresholdSizeInBytes)
+    MPICommunicatorImpl::MPICommunicatorImpl(size_t packThresholdSizeInBytes, bool useHierarchicalAggregation)
     {
         m_mpi = MPIWrapper::GetInstance();
         if (m_mpi == nullptr)
@@ -84,6 +84,23 @@ namespace CNTK
                 m_workers.insert({ i,  L"" });
         }
         m_packThresholdSizeInBytes = packThresholdSizeInBytes;
+
+        // The hierarchical aggregation pays off with several workers on each of multiple hosts. The shards of the workers with
+        // the same rank on their host are aggregated across hosts, so all hosts need the same number of workers.
+        m_hierarchicalAggregation = false;
+        if (useHierarchicalAggregation && m_mpi->IsMultiHost())
+        {
+            const auto& hostIndexOfWorkers = m_mpi->HostIndexOfNodes();
+            size_t numHosts = *std::max_element(hostIndexOfWorkers.begin(), hostIndexOfWorkers.end()) + 1;
+            bool uniform = hostIndexOfWorkers.size() % numHosts == 0;
+            for (size_t host = 0; host < numHosts && uniform; ++host)
+                uniform = std::count(hostIndexOfWorkers.begin(), hostIndexOfWorkers.end(), host) == hostIndexOfWorkers.size() / numHosts;
+
+            if (!uniform)
+                fprintf(stderr, "WARNING: MPICommunicator: hierarchical aggregation disabled, the hosts run different numbers of workers.\n");
+            else if (m_mpi->NumNodesOnCurrentHost() > 1)
+                m_hierarchicalAggregation = true;
+        }
     }
 
     void MPICommunicatorImpl::Initialize(const std::vector<NDArrayViewPtr>& values)
@@ -356,7 +373,8 @@ namespace CNTK
         // BUGBUG: assuming the all values on the same device
         if (m_nccl == nullptr)
         {
-            m_nccl.reset(new NcclComm(AsCNTKImplDeviceId(inputValues[0]->Device()), m_mpi));
+            m_ncclDeviceId = AsCNTKImplDeviceId(inputValues[0]->Device());
+            m_nccl.reset(new NcclComm(m_ncclDeviceId, m_mpi, m_hierarchicalAggregation));
         }
 
         // For all values residing on GPU initiate async transfer to CPU buffers if needed
@@ -397,6 +415,10 @@ namespace CNTK
             }
             else
                 LogicError("MPICommunicator: Unknown DataType.");
+
+            // The hierarchical aggregation in host memory is done already, copy the result back right away.
+            if (m_hierarchicalAggregation && ShouldCopyDataToCPU(inputValue))
+                m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].data.get(), GetBufferSize(outputValue), GetDataBuffer(outputValue));
         }
 
         if (m_nccl->IsSupported())
@@ -545,6 +567,22 @@ namespace CNTK
     template <typename ElemType>
     void MPICommunicatorImpl::AllReduceGradients(ElemType* inputData, ElemType* outputData, size_t numElements, std::vector<MPI_Request> &allReduceRequests, bool dataOnCPU)
     {
+        if (m_hierarchicalAggregation)
+        {
+            if (m_nccl->IsSupported() && !dataOnCPU)
+            {
+                HierarchicalAllReduceOnGPU(inputData, outputData, numElements);
+                return;
+            }
+
+            // Without GPUDirect RDMA the values on the GPU have been copied to host memory.
+            if (dataOnCPU || !m_mpi->UseGpuGdr())
+            {
+                HierarchicalAllReduceInHostMemory(inputData, outputData, numElements);
+                return;
+            }
+        }
+
         if (m_nccl->IsSupported() && !dataOnCPU)
         {
             m_nccl->AllReduce(inputData, outputData, numElements);
@@ -568,4 +606,90 @@ namespace CNTK
         else
             m_mpi->AllReduceAsync(inputData, outputData, numElements, &allReduceRequests.back());
     }
+
+    template <>
+    std::unique_ptr<Matrix<float>>& MPICommunicatorImpl::HierarchicalBuffer<float>()
+    {
+        return m_hierarchicalBufferFloat;
+    }
+
+    template <>
+    std::unique_ptr<Matrix<double>>& MPICommunicatorImpl::HierarchicalBuffer<double>()
+    {
+        return m_hierarchicalBufferDouble;
+    }
+
+    // Reduce-scatter within the host, all-reduce of the shards across hosts, all-gather within the host.
+    // The value is padded to a multiple of the number of workers on the host, so that all shards are of the same size.
+    template <typename ElemType>
+    void MPICommunicatorImpl::HierarchicalAllReduceInHostMemory(ElemType* inputData, ElemType* outputData, size_t numElements)
+    {
+        size_t numWorkersOnHost = m_mpi->NumNodesOnCurrentHost();
+        size_t shardSize = (numElements + numWorkersOnHost - 1) / numWorkersOnHost;
+        size_t paddedSize = shardSize * numWorkersOnHost;
+
+        if (m_hierarchicalHostBuffer.size() < (paddedSize + shardSize) * sizeof(ElemType))
+            m_hierarchicalHostBuffer.resize((paddedSize + shardSize) * sizeof(ElemType));
+        ElemType* padded = reinterpret_cast<ElemType*>(m_hierarchicalHostBuffer.data());
+        ElemType* shard = padded + paddedSize;
+
+        std::copy(inputData, inputData + numElements, padded);
+        std::fill(padded + numElements, padded + paddedSize, (ElemType)0);
+
+        m_mpi->ReduceScatterWithinHost(padded, shard, shardSize);
+        m_mpi->AllReduceAcrossHosts(shard, shardSize);
+        m_mpi->AllGatherWithinHost(shard, padded, shardSize);
+
+        std::copy(padded, padded + numElements, outputData);
+    }
+
+    // As above, within the host over NCCL in place in a padded copy of the value on the GPU.
+    // Across hosts, the shard is reduced directly from the GPU with GPUDirect RDMA, otherwise through host memory.
+    template <typename ElemType>
+    void MPICommunicatorImpl::HierarchicalAllReduceOnGPU(ElemType* inputData, ElemType* outputData, size_t numElements)
+    {
+        size_t numWorkersOnHost = m_mpi->NumNodesOnCurrentHost();
+        size_t shardSize = (numElements + numWorkersOnHost - 1) / numWorkersOnHost;
+        size_t paddedSize = shardSize * numWorkersOnHost;
+        int deviceId = m_ncclDeviceId;
+
+        auto& buffer = HierarchicalBuffer<ElemType>();
+        if (buffer == nullptr || buffer->GetNumElements() < paddedSize)
+            buffer.reset(new Matrix<ElemType>(1, paddedSize, deviceId));
+
+        Matrix<ElemType> input(1, numElements, inputData, deviceId, matrixFlagDontOwnBuffer);
+        buffer->ColumnSlice(0, numElements).AssignValuesOf(input);
+        if (paddedSize > numElements)
+            buffer->ColumnSlice(numElements, paddedSize - numElements).SetValue(0);
+
+        ElemType* padded = buffer->Data();
+        ElemType* shard = padded + m_mpi->CurrentNodeRankOnHost() * shardSize;
+        m_nccl->ReduceScatter(padded, shard, shardSize);
+        m_nccl->Sync();
+
+        if (m_mpi->UseGpuGdr())
+        {
+            m_mpi->AllReduceAcrossHosts(shard, shardSize);
+        }
+        else
+        {
+            if (m_hierarchicalTransferer == nullptr)
+                m_hierarchicalTransferer = std::make_shared<GPUDataTransferer>(deviceId, true);
+            if (m_hierarchicalShardCPUBuffer.totalSize < shardSize * sizeof(ElemType))
+                m_hierarchicalShardCPUBuffer = AllocateIntermediateBuffer(deviceId, shardSize * sizeof(ElemType));
+
+            ElemType* hostShard = static_cast<ElemType*>(m_hierarchicalShardCPUBuffer.data.get());
+            m_hierarchicalTransferer->CopyGPUToCPUAsync(shard, shardSize, hostShard);
+            m_hierarchicalTransferer->WaitForCopyGPUToCPUAsync();
+            m_mpi->AllReduceAcrossHosts(hostShard, shardSize);
+            m_hierarchicalTransferer->CopyCPUToGPUAsync(hostShard, shardSize, shard);
+            m_hierarchicalTransferer->WaitForCopyCPUToGPUAsync();
+        }
+
+        m_nccl->AllGather(shard, padded, shardSize);
+        m_nccl->Sync();
+
+        Matrix<ElemType> output(1, numElements, outputData, deviceId, matrixFlagDontOwnBuffer);
+        output.AssignValuesOf(buffer->ColumnSlice(0, numElements));
+    }
 }
@@ -23,7 +23,7 @@ namespace CNTK
     class MPICommunicatorImpl : public DistributedCommunicator, public std::enable_shared_from_this<MPICommunicatorImpl>
     {
     public:
-        MPICommunicatorImpl(size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES);
+        MPICommunicatorImpl(size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES, bool useHierarchicalAggregation = false);
 
         virtual const std::unordered_set<DistributedWorkerDescriptor>& Workers() const override;
 
@@ -90,8 +90,18 @@ namespace CNTK
         std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> m_aggregationBufferFloat;
         std::unique_ptr<Microsoft::MSR::CNTK::Matrix<double>> m_aggregationBufferDouble;
 
-        // NcclComm
+        // NcclComm, among the workers of the current host only in case of hierarchical aggregation
         std::unique_ptr<Microsoft::MSR::CNTK::NcclComm> m_nccl;
+        int m_ncclDeviceId;
+
+        // Hierarchical aggregation: within each host, then across hosts (see MPICommunicator()).
+        // Buffers for the values padded to a multiple of the number of workers on the host.
+        bool m_hierarchicalAggregation;
+        std::vector<char> m_hierarchicalHostBuffer;
+        std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> m_hierarchicalBufferFloat;
+        std::unique_ptr<Microsoft::MSR::CNTK::Matrix<double>> m_hierarchicalBufferDouble;
+        std::shared_ptr<Microsoft::MSR::CNTK::GPUDataTransferer> m_hierarchicalTransferer;
+        Buffer m_hierarchicalShardCPUBuffer;
 
     protected:
         DeviceDescriptor GetNonCPUDevice(const std::vector<NDArrayViewPtr>& values)
@@ -138,5 +148,14 @@ namespace CNTK
 
         template <typename ElemType>
         void AllReduceGradients(ElemType* inputData, ElemType* outputData, size_t numElements, std::vector<MPI_Request> &allReduceRequests, bool dataOnCPU);
+
+        template <typename ElemType>
+        void HierarchicalAllReduceInHostMemory(ElemType* inputData, ElemType* outputData, size_t numElements);
+
+        template <typename ElemType>
+        void HierarchicalAllReduceOnGPU(ElemType* inputData, ElemType* outputData, size_t numElements);
+
+        template <typename ElemType>
+        std::unique_ptr<Microsoft::MSR::CNTK::Matrix<ElemType>>& HierarchicalBuffer();
     };
 }
@@ -10,6 +10,7 @@
 #include "BlockFunction.h"
 #include "Utils.h"
 #include "UserFunctionFactory.h"
+#include "PerformanceProfiler.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -202,9 +203,21 @@ namespace CNTK
         for (auto outputVarValuePair : outputsToEvaluate)
             outputsToEvaluate[outputVarValuePair.first] = outputs[outputVarValuePair.first];
 
+        // A packed root output gets a packed root gradient of the same layout, so that neither is unpacked
         auto gradientRootOutputValue = outputs[gradientRoot];
-        auto rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(gradientRoot.GetDataType(), gradientRootOutputValue->Shape(), computeDevice), gradientRootOutputValue->Mask());
-        rootGradientValue->Data()->SetValue(1.0f);
+        ValuePtr rootGradientValue;
+        auto packedGradientRootOutputValue = std::dynamic_pointer_cast<PackedValue>(gradientRootOutputValue);
+        if (packedGradientRootOutputValue && packedGradientRootOutputValue->IsPacked())
+        {
+            auto packedRootGradientValue = std::dynamic_pointer_cast<PackedValue>(packedGradientRootOutputValue->DeepClone(/*readOnly =*/ false));
+            packedRootGradientValue->SetValue(1.0);
+            rootGradientValue = packedRootGradientValue;
+        }
+        else
+        {
+            rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(gradientRoot.GetDataType(), gradientRootOutputValue->Shape(), computeDevice), gradientRootOutputValue->Mask());
+            rootGradientValue->Data()->SetValue(1.0f);
+        }
 
         this->Backward(backPropState, {{gradientRoot, rootGradientValue}}, gradients);
     }
@@ -430,6 +443,18 @@ namespace CNTK
         Forward(arguments, outputs, computeDevice, {});
     }
 
+    void Function::EvaluateCached(const std::unordered_map<Variable, ValuePtr>& arguments,
+                                  std::unordered_map<Variable, ValuePtr>& outputs,
+                                  const DeviceDescriptor& computeDevice /*= DeviceDescriptor::UseDefaultDevice()*/,
+                                  size_t maxCachedBytesPerSample /*= 0*/)
+    {
+        auto compositeFunction = dynamic_cast<CompositeFunction*>(this);
+        if (compositeFunction)
+            compositeFunction->EvaluateCached(arguments, outputs, computeDevice, maxCachedBytesPerSample);
+        else
+            Evaluate(arguments, outputs, computeDevice); // keeps no values
+    }
+
     void Function::Save(const std::wstring& filepath)
     {
         Dictionary model = Serialize();
@@ -438,14 +463,28 @@ namespace CNTK
         stream->flush();
     }
 
+    // Reads the protobuf dictionary of a model and constructs the Function from it, timing both for the profiler.
+    static FunctionPtr LoadModelDictionary(std::istream& stream, const DeviceDescriptor& computeDevice, const Internal::UDFDeserializerPtr& deserializer)
+    {
+        Dictionary model;
+        auto profDeserialize = Microsoft::MSR::CNTK::ProfilerTimeBegin();
+        stream >> model;
+        Microsoft::MSR::CNTK::ProfilerTimeEnd(profDeserialize, Microsoft::MSR::CNTK::profilerEvtLoadDeserialize);
+
+        auto profBuild = Microsoft::MSR::CNTK::ProfilerTimeBegin();
+        auto function = Function::Deserialize(model, computeDevice, deserializer);
+        Microsoft::MSR::CNTK::ProfilerTimeEnd(profBuild, Microsoft::MSR::CNTK::profilerEvtLoadBuild);
+        return function;
+    }
+
     /*static*/ FunctionPtr Function::Load(const std::wstring& filepath, const DeviceDescriptor& computeDevice, const Internal::UDFDeserializerPtr& deserializer)
     {
+        Microsoft::MSR::CNTK::ScopeProfile profLoad(Microsoft::MSR::CNTK::profilerEvtLoadModel);
+
         auto stream = GetFstream(filepath, true);
         if (!Internal::IsLegacyModel(*stream))
         {
-            Dictionary model;
-            *stream >> model;
-            return Function::Deserialize(model, computeDevice, deserializer);
+            return LoadModelDictionary(*stream, computeDevice, deserializer);
         }
         else
         {
@@ -480,9 +519,8 @@ namespace CNTK
 
     /*static*/ FunctionPtr Function::Load(std::istream& inputStream, const DeviceDescriptor& computeDevice, const Internal::UDFDeserializerPtr& deserializer)
     {
-        Dictionary model;
-        inputStream >> model;
-        return Function::Deserialize(model, computeDevice, deserializer);
+        Microsoft::MSR::CNTK::ScopeProfile profLoad(Microsoft::MSR::CNTK::profilerEvtLoadModel);
+        return LoadModelDictionary(inputStream, computeDevice, deserializer);
     }
 
     void Function::Restore(const std::wstring& filepath)
@@ -664,6 +702,10 @@ namespace CNTK
                                 else
                                     clonedInput = Constant(Constant(cloneeInput).Value(), cloneeInput.Name());
 
+                                leafVariablesCloneMap[cloneeInput] = clonedInput;
+                                break;
+                            case ParameterCloningMethod::CopyOnWrite:
+                                clonedInput = Utils::CloneSharingValue(cloneeInput);
                                 leafVariablesCloneMap[cloneeInput] = clonedInput;
                                 break;
                             default:
@@ -897,6 +939,7 @@ namespace CNTK
         for (int i = 0; i < parameters.size(); i++)
         {
             assert(Internal::AreEquivalent(parameters[i], restoredParameters[i]));
+            Utils::UnshareValue(parameters[i]);
             parameters[i].Value()->CopyFrom(*(restoredParameters[i].Value().get()));
         }
 
@@ -1499,6 +1542,15 @@ namespace CNTK
                                          name);
     }
 
+    FunctionPtr ScaledDotProductAttention(const Variable& query, const Variable& keys, const Variable& values, double scale, const std::wstring& name)
+    {
+        auto additionalProperties = Dictionary();
+        additionalProperties[PrimitiveFunction::AttributeNameAttentionScale] = scale;
+
+        std::vector<Variable> operands = { query, keys, values };
+        return AsComposite(MakeSharedObject<PrimitiveFunction>(PrimitiveOpType::ScaledDotProductAttention, operands, std::move(additionalProperties), name), name);
+    }
+
     FunctionPtr Clip(const Variable& operand, const Variable& min, const Variable& max, const std::wstring& name)
     {
         std::vector<Variable> operands = { operand, min, max };
@@ -1917,5 +1969,55 @@ namespace CNTK
             return BinaryOp(PrimitiveOpType::Convolution, convolutionMap, operand, std::move(additionalProperties), name);
         }
 
+        void MarkForRecomputation(const FunctionPtr& function)
+        {
+            std::vector<FunctionPtr> primitiveFunctions;
+            if (function->IsBlock())
+            {
+                Function::PreorderTraverseFunctions(function->BlockRoot(), [&primitiveFunctions](const FunctionPtr& nestedFunction) {
+                    if (!nestedFunction->IsBlock())
+                        primitiveFunctions.push_back(nestedFunction);
+                }, /*traverseInsideBlockFunction =*/ true);
+            }
+            else
+                primitiveFunctions.push_back(function->RootFunction());
+
+            for (const auto& primitiveFunction : primitiveFunctions)
+                primitiveFunction->m_attributes[PrimitiveFunction::AttributeNameRecompute] = true;
+        }
+
+        void MarkForOffloading(const FunctionPtr& function)
+        {
+            std::vector<FunctionPtr> primitiveFunctions;
+            if (function->IsBlock())
+            {
+                Function::PreorderTraverseFunctions(function->BlockRoot(), [&primitiveFunctions](const FunctionPtr& nestedFunction) {
+                    if (!nestedFunction->IsBlock())
+                        primitiveFunctions.push_back(nestedFunction);
+                }, /*traverseInsideBlockFunction =*/ true);
+            }
+            else
+                primitiveFunctions.push_back(function->RootFunction());
+
+            for (const auto& primitiveFunction : primitiveFunctions)
+                primitiveFunction->m_attributes[PrimitiveFunction::AttributeNameOffload] = true;
+        }
+
+        void PlaceOnDevice(const FunctionPtr& function, const DeviceDescriptor& device)
+        {
+            std::vector<FunctionPtr> primitiveFunctions;
+            if (function->IsBlock())
+            {
+                Function::PreorderTraverseFunctions(function->BlockRoot(), [&primitiveFunctions](const FunctionPtr& nestedFunction) {
+                    if (!nestedFunction->IsBlock())
+                        primitiveFunctions.push_back(nestedFunction);
+                }, /*traverseInsideBlockFunction =*/ true);
+            }
+            else
+                primitiveFunctions.push_back(function->RootFunction());
+
+            for (const auto& primitiveFunction : primitiveFunctions)
+                primitiveFunction->m_attributes[PrimitiveFunction::AttributeNamePlacementDeviceId] = (int)AsCNTKImplDeviceId(device);
+        }
     }
 }
@@ -82,6 +82,42 @@ namespace CNTK
         }
     }
 
+    // A single reduction per gradient: the sum of absolute values is Inf or NaN as soon as one element is.
+    /*static*/ bool LearnerBase::IsFinite(const NDArrayViewPtr& value)
+    {
+        switch (value->GetDataType())
+        {
+        case DataType::Float:
+            return std::isfinite(value->GetMatrix<float>()->SumOfAbsElements());
+        case DataType::Double:
+            return std::isfinite(value->GetMatrix<double>()->SumOfAbsElements());
+        default:
+            LogicError("Unsupported DataType %s", DataTypeName(value->GetDataType()));
+        }
+    }
+
+    bool LearnerBase::AdjustLossScale(const function<bool(const Parameter&)>& isFinite)
+    {
+        for (const auto& parameter : Parameters())
+        {
+            if (!isFinite(parameter))
+            {
+                m_lossScale = max(m_lossScale / 2, 1.0);
+                m_lossScaleGoodMinibatchCount = 0;
+                fprintf(stderr, "Learner: gradient overflow for parameter '%ls', skipping the update of this minibatch and reducing the loss scale to %g.\n",
+                        parameter.AsString().c_str(), m_lossScale);
+                return false;
+            }
+        }
+
+        if (++m_lossScaleGoodMinibatchCount >= m_additionalOptions.lossScaleGrowthInterval)
+        {
+            m_lossScale *= 2;
+            m_lossScaleGoodMinibatchCount = 0;
+        }
+        return true;
+    }
+
     /*static*/ void LearnerBase::Print(const NDArrayViewPtr& value, const char* msg)
     {
         switch (value->GetDataType())
@@ -142,10 +178,13 @@ namespace CNTK
     {
         const auto& gradientMatrix = gradientValue->GetWritableMatrix<ElementType>();
 
-        // get mean gradient if needed
+        // get mean gradient if needed, and remove the loss scale the gradient was computed with
+        double gradientScale = 1.0 / m_lossScale;
         if (m_additionalOptions.useMeanGradient)
+            gradientScale /= actualMBSize;
+        if (gradientScale != 1.0)
         {
-            Matrix<ElementType>::Scale((ElementType)1.0 / actualMBSize, *gradientMatrix);
+            Matrix<ElementType>::Scale((ElementType)gradientScale, *gradientMatrix);
         }
 
         // clipping gradients to prevent outliers
@@ -190,6 +229,119 @@ namespace CNTK
         }
     }
 
+    template <typename ElementType>
+    void LearnerBase::GetMultiTensorGroups(vector<Parameter>& parameters, const unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                           MultiTensorUpdateType type, map<DEVICEID_TYPE, MultiTensorGroup<ElementType>>& groups) const
+    {
+        // clipping by truncation is not a scaling of the gradient
+        const bool clip = m_additionalOptions.gradientClippingThresholdPerSample != numeric_limits<double>::infinity();
+        if (clip && m_additionalOptions.gradientClippingWithTruncation)
+            return;
+
+        vector<Parameter> others;
+        for (const auto& parameter : parameters)
+        {
+            const auto& gradientValue = gradientValues.at(parameter);
+            if (gradientValue->GetDataType() != AsDataType<ElementType>() ||
+                gradientValue->GetStorageFormat() != StorageFormat::Dense || parameter.Value()->GetStorageFormat() != StorageFormat::Dense)
+            {
+                others.push_back(parameter);
+                continue;
+            }
+
+            const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameter.Value());
+            const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+            const DEVICEID_TYPE deviceId = parameterMatrix->GetDeviceId();
+            const size_t numElements = parameterMatrix->GetNumElements();
+            bool fits = parameterMatrix->IsMultiTensorOperand(deviceId) && gradientMatrix->IsMultiTensorOperand(deviceId) &&
+                        gradientMatrix->GetNumElements() == numElements;
+
+            ElementType* smoothedGradient = nullptr;
+            if (fits && type != MultiTensorUpdateType::SGD)
+            {
+                const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(m_smoothedGradientValues.at(parameter));
+                const size_t numSmoothed = (type == MultiTensorUpdateType::Adam ? 2 : 1) * numElements;
+                fits = smoothedGradientMatrix->IsMultiTensorOperand(deviceId) && smoothedGradientMatrix->GetNumElements() == numSmoothed;
+                smoothedGradient = smoothedGradientMatrix->Data();
+            }
+            if (!fits)
+            {
+                others.push_back(parameter);
+                continue;
+            }
+
+            MultiTensorItem<ElementType> item = {};
+            item.value = parameterMatrix->Data();
+            item.gradient = gradientMatrix->Data();
+            item.smoothedGradient = smoothedGradient;
+            item.numElements = numElements;
+
+            auto& group = groups[deviceId];
+            group.parameters.push_back(parameter);
+            group.gradientValues.push_back(gradientValue);
+            group.items.push_back(item);
+        }
+        parameters.swap(others);
+
+        // one launch for the norms of all gradients of a device, which also tell whether they are finite
+        if (clip || m_additionalOptions.dynamicLossScaling)
+        {
+            for (auto& group : groups)
+                Matrix<ElementType>::MultiTensorSumOfSquares(group.first, group.second.items, group.second.sumsOfSquares);
+        }
+    }
+
+    template <typename ElementType>
+    void LearnerBase::UpdateMultiTensorGroup(DEVICEID_TYPE deviceId, MultiTensorGroup<ElementType>& group, size_t trainingSampleCount,
+                                             MultiTensorUpdateType type, double momentum, double varMomentum, bool unitGain) const
+    {
+        // the preprocessing of PreProcess() as scalars of the update
+        double gradientScale = 1.0 / m_lossScale;
+        if (m_additionalOptions.useMeanGradient)
+            gradientScale /= trainingSampleCount;
+        const size_t actualMBSize = m_additionalOptions.useMeanGradient ? 1 : trainingSampleCount;
+        const double maxGradientPerMB = m_additionalOptions.gradientClippingThresholdPerSample * actualMBSize;
+        const double l2Weight = max(m_additionalOptions.l2RegularizationWeight, 0.0) * actualMBSize;
+        const double learningRate = LearningRate(trainingSampleCount);
+
+        for (size_t k = 0; k < group.items.size(); k++)
+        {
+            double scale = gradientScale;
+            if (maxGradientPerMB != numeric_limits<double>::infinity())
+            {
+                const double gradientNorm = gradientScale * sqrt(group.sumsOfSquares[k]);
+                if (gradientNorm > maxGradientPerMB)
+                    scale *= maxGradientPerMB / gradientNorm;
+            }
+
+            auto& item = group.items[k];
+            item.gradientScale = ElementType(scale);
+            item.l2Weight = ElementType(l2Weight);
+            item.learnRatePerSample = ElementType(learningRate);
+            item.adaMul = ElementType(NextMultiTensorAdaMul(group.parameters[k], momentum, varMomentum));
+        }
+
+        Matrix<ElementType>::MultiTensorUpdate(deviceId, type, group.items, ElementType(momentum), ElementType(varMomentum), unitGain);
+
+        for (size_t k = 0; k < group.parameters.size(); k++)
+        {
+            PostProcess<ElementType>(group.parameters[k], group.gradientValues[k], trainingSampleCount);
+
+            auto paramRef = group.parameters[k];
+            paramRef.RecordValueUpdate();
+        }
+    }
+
+    template <typename ElementType>
+    /*static*/ void LearnerBase::GetFiniteGradients(const map<DEVICEID_TYPE, MultiTensorGroup<ElementType>>& groups, unordered_map<Parameter, bool>& isFinite)
+    {
+        for (const auto& group : groups)
+        {
+            for (size_t k = 0; k < group.second.parameters.size(); k++)
+                isFinite[group.second.parameters[k]] = std::isfinite(group.second.sumsOfSquares[k]);
+        }
+    }
+
     template <typename ElementType>
     /*static*/ TensorView<ElementType>* LearnerBase::GetWritableTensorView(const NDArrayViewPtr& arrayView)
     {
@@ -202,7 +354,9 @@ namespace CNTK
                              bool allocateSmoothGradients /* = true */)
                              : Learner(parameters, learningRateSchedule),
                              m_additionalOptions(additionalOptions), 
-                             m_noiseInjectionSeed(Internal::GenerateRandomSeed())
+                             m_noiseInjectionSeed(Internal::GenerateRandomSeed()),
+                             m_lossScale(additionalOptions.lossScale),
+                             m_lossScaleGoodMinibatchCount(0)
     {
         if (parameters.empty())
             InvalidArgument("The parameters list specified to a Learner must not be empty.");
@@ -212,6 +366,10 @@ namespace CNTK
         if (uniqueParameters.size() != parameters.size())
             LogicError("Learner parameters contain duplicates.");
 
+        // the learner writes its parameters, so copy-on-write clones get values of their own now
+        for (const auto& parameter : parameters)
+            Utils::UnshareValue(parameter);
+
         if (allocateSmoothGradients)
         {
             for (const auto& parameter : parameters)
@@ -225,6 +383,11 @@ namespace CNTK
         {
             LogicError("useMeanGradient should not be used with per-minibatch learning rate setting");
         }
+
+        if (!(m_additionalOptions.lossScale >= 1))
+            InvalidArgument("The loss scale (%g) must be at least 1.", m_additionalOptions.lossScale);
+        if (m_additionalOptions.dynamicLossScaling && m_additionalOptions.lossScaleGrowthInterval == 0)
+            InvalidArgument("lossScaleGrowthInterval must be positive for dynamic loss scaling.");
     }
 
     /*static*/ NDArrayViewPtr LearnerBase::AllocateNDArrayView(const Parameter& parameter, const NDShape& shape)
@@ -239,6 +402,51 @@ namespace CNTK
         }
     }
 
+    template <typename ElementType>
+    shared_ptr<Matrix<ElementType>> LearnerBase::LazyUpdateSteps(const Parameter& parameter, const Matrix<ElementType>& gradient) const
+    {
+        if (!m_additionalOptions.lazySparseUpdate || !m_additionalOptions.lazyDecayCatchUp || gradient.GetMatrixType() != SPARSE)
+            return nullptr;
+
+        auto iter = m_lazyUpdateSteps.find(parameter);
+        if (iter == m_lazyUpdateSteps.end())
+            iter = m_lazyUpdateSteps.emplace(parameter, AllocateNDArrayView(parameter, { 1, GetMatrixShape(parameter)[1] + 1 })).first;
+        return GetWritableMatrix<ElementType>(iter->second);
+    }
+
+    template <typename ElementType>
+    /*static*/ vector<double> LearnerBase::Norms(const vector<shared_ptr<Matrix<ElementType>>>& matrices)
+    {
+        vector<double> norms(matrices.size(), 0);
+        map<DEVICEID_TYPE, vector<MultiTensorItem<ElementType>>> items;
+        map<DEVICEID_TYPE, vector<size_t>> indices;
+        for (size_t i = 0; i < matrices.size(); i++)
+        {
+            const auto& matrix = *matrices[i];
+            const DEVICEID_TYPE deviceId = matrix.GetDeviceId();
+            if (!matrix.IsMultiTensorOperand(deviceId))
+            {
+                norms[i] = matrix.FrobeniusNorm();
+                continue;
+            }
+            MultiTensorItem<ElementType> item = {};
+            item.gradient = matrix.Data();
+            item.numElements = matrix.GetNumElements();
+            items[deviceId].push_back(item);
+            indices[deviceId].push_back(i);
+        }
+
+        vector<double> sumsOfSquares;
+        for (const auto& deviceItems : items)
+        {
+            Matrix<ElementType>::MultiTensorSumOfSquares(deviceItems.first, deviceItems.second, sumsOfSquares);
+            const auto& deviceIndices = indices[deviceItems.first];
+            for (size_t k = 0; k < deviceIndices.size(); k++)
+                norms[deviceIndices[k]] = sqrt(sumsOfSquares[k]);
+        }
+        return norms;
+    }
+
     /*static*/ NDShape LearnerBase::GetMatrixShape(const Parameter& parameter)
     {
         if (parameter.GetDataType() == DataType::Float)
@@ -266,7 +474,45 @@ namespace CNTK
         if (trainingSampleCount == 0)
             InvalidArgument("Learner::Update() cannot perform an update with an empty minibatch.");
 
-        for (const auto& parameter : Parameters())
+        // With multiTensorUpdate, the parameters that allow it are updated in groups per data type and device,
+        // the others one by one.
+        vector<Parameter> parameters = Parameters();
+        map<DEVICEID_TYPE, MultiTensorGroup<float>> floatGroups;
+        map<DEVICEID_TYPE, MultiTensorGroup<double>> doubleGroups;
+        MultiTensorUpdateType multiTensorType = MultiTensorUpdateType::SGD;
+        double momentum = 0, varMomentum = 0;
+        bool unitGain = false;
+        if (m_additionalOptions.multiTensorUpdate && GetMultiTensorUpdate(trainingSampleCount, multiTensorType, momentum, varMomentum, unitGain))
+        {
+            GetMultiTensorGroups<float>(parameters, gradientValues, multiTensorType, floatGroups);
+            GetMultiTensorGroups<double>(parameters, gradientValues, multiTensorType, doubleGroups);
+        }
+
+        // An overflow in the (scaled) gradients is expected every now and then with dynamic loss scaling;
+        // the minibatch is then dropped, but learning goes on with a smaller loss scale.
+        if (m_additionalOptions.dynamicLossScaling)
+        {
+            // the sums of squares of the groups are not finite either if a gradient is not
+            unordered_map<Parameter, bool> isFinite;
+            GetFiniteGradients(floatGroups, isFinite);
+            GetFiniteGradients(doubleGroups, isFinite);
+            if (!AdjustLossScale([&](const Parameter& parameter)
+                                 {
+                                     auto iter = isFinite.find(parameter);
+                                     return iter != isFinite.end() ? iter->second : IsFinite(gradientValues.at(parameter));
+                                 }))
+                return true;
+        }
+
+        for (auto& group : floatGroups)
+            UpdateMultiTensorGroup<float>(group.first, group.second, trainingSampleCount, multiTensorType, momentum, varMomentum, unitGain);
+        for (auto& group : doubleGroups)
+            UpdateMultiTensorGroup<double>(group.first, group.second, trainingSampleCount, multiTensorType, momentum, varMomentum, unitGain);
+
+        if (UpdateTogether(parameters, gradientValues, trainingSampleCount))
+            parameters.clear();
+
+        for (const auto& parameter : parameters)
         {
             const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
             const auto& gradientValue = gradientValues.at(parameter);
@@ -342,6 +588,8 @@ namespace CNTK
         checkpoint[minibatchCountKey] = m_minibatchCount;
         checkpoint[learningRateScheduleKey] = m_learningRateSchedule.Serialize();
         checkpoint[noiseInjectionSeedKey] = m_noiseInjectionSeed;
+        checkpoint[lossScaleKey] = m_lossScale;
+        checkpoint[lossScaleGoodMinibatchCountKey] = m_lossScaleGoodMinibatchCount;
 
         // TODO: should we also save momentum schedule into the checkpoint?
         // If that is the case, need to be able to override this method in subclasses.
@@ -364,6 +612,9 @@ namespace CNTK
 
         auto version = ValidateDictionary<LearnerBase>(checkpoint, s_requiredDictionaryKeys, s_learnerTypeValue, CurrentVersion());
 
+        // the catch-up starts over from the restored moments
+        m_lazyUpdateSteps.clear();
+
         if (version >= 2) 
         {
             ValidateDictionary<LearnerBase>(checkpoint, { smoothedGradientsKey }, s_learnerTypeValue, CurrentVersion());
@@ -377,6 +628,12 @@ namespace CNTK
             m_noiseInjectionSeed = checkpoint[noiseInjectionSeedKey].Value<size_t>();
         }
 
+        if (checkpoint.Contains(lossScaleKey))
+        {
+            m_lossScale = checkpoint[lossScaleKey].Value<double>();
+            m_lossScaleGoodMinibatchCount = checkpoint[lossScaleGoodMinibatchCountKey].Value<size_t>();
+        }
+
         // TODO: which learning rate schedule should take precedence here? 
         // The one given at construction time or the one loaded from a checkpoint?
         m_learningRateSchedule = TrainingParameterSchedule<double>::Deserialize(checkpoint[learningRateScheduleKey].Value<Dictionary>());
@@ -483,6 +740,13 @@ namespace CNTK
         parameterMatrix->SGDUpdate(*gradientMatrix, learningRate);
     }
 
+    /*virtual*/ bool LearnerSGD::GetMultiTensorUpdate(size_t /*trainingSampleCount*/, MultiTensorUpdateType& type,
+                                                      double& /*momentum*/, double& /*varMomentum*/, bool& /*unitGain*/) const /*override*/
+    {
+        type = MultiTensorUpdateType::SGD;
+        return true;
+    }
+
     double LearnerMomentumSGD::MomentumValueForMB(const MomentumSchedule& schedule, size_t minibatchSize) const
     {
         double currentMomentum = GetCurrentTrainingParameterValue(schedule);
@@ -518,6 +782,17 @@ namespace CNTK
                                            learningRate, momentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerMomentumSGD::GetMultiTensorUpdate(size_t trainingSampleCount, MultiTensorUpdateType& type,
+                                                              double& momentum, double& /*varMomentum*/, bool& unitGain) const /*override*/
+    {
+        ReportTrainingParameterValue(m_momentumSchedule, L"Momentum");
+
+        type = MultiTensorUpdateType::MomentumSGD;
+        momentum = MomentumValueForMB(trainingSampleCount);
+        unitGain = UseUnitGainMomentum();
+        return true;
+    }
+
     /*virtual*/ void LearnerNesterov::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, 
                                              const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
     {
@@ -537,6 +812,15 @@ namespace CNTK
                                                               learningRate, momentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerNesterov::GetMultiTensorUpdate(size_t trainingSampleCount, MultiTensorUpdateType& type,
+                                                           double& momentum, double& /*varMomentum*/, bool& unitGain) const /*override*/
+    {
+        type = MultiTensorUpdateType::NesterovMomentumSGD;
+        momentum = MomentumValueForMB(trainingSampleCount);
+        unitGain = UseUnitGainMomentum();
+        return true;
+    }
+
     LearnerAdaGrad::LearnerAdaGrad(const std::vector<Parameter>& parameters,
                                    const LearningRateSchedule& learningRateSchedule,
                                    bool needAveMultiplier,
@@ -652,7 +936,15 @@ namespace CNTK
         double& smoothedCount = m_smoothedCounts.at(parameter);
 
         smoothedGradientMatrix->FSAdagradUpdate(trainingSampleCount, *gradientMatrix, *parameterMatrix, smoothedCount, learningRate, 
-                                                s_targetAdagradAvDenom, momentum, varMomentum, UseUnitGainMomentum());
+                                                s_targetAdagradAvDenom, momentum, varMomentum, UseUnitGainMomentum(),
+                                                m_additionalOptions.lazySparseUpdate, LazyUpdateSteps<ElementType>(parameter, *gradientMatrix).get());
+    }
+
+    // FSAdaGrad scales the learning rate by the average over all elements, which a multi-tensor update does not know
+    /*virtual*/ bool LearnerFSAdaGrad::GetMultiTensorUpdate(size_t /*trainingSampleCount*/, MultiTensorUpdateType& /*type*/,
+                                                            double& /*momentum*/, double& /*varMomentum*/, bool& /*unitGain*/) const /*override*/
+    {
+        return false;
     }
 
     LearnerAdam::LearnerAdam(const vector<Parameter>& parameters,
@@ -694,7 +986,161 @@ namespace CNTK
         double& smoothedCount = m_smoothedCounts.at(parameter);
 
         smoothedGradientMatrix->AdamUpdate(*gradientMatrix, *parameterMatrix, smoothedCount, learningRate,
-            momentum, varMomentum, UseUnitGainMomentum());
+            momentum, varMomentum, UseUnitGainMomentum(),
+            m_additionalOptions.lazySparseUpdate, LazyUpdateSteps<ElementType>(parameter, *gradientMatrix).get());
+    }
+
+    /*virtual*/ bool LearnerAdam::GetMultiTensorUpdate(size_t trainingSampleCount, MultiTensorUpdateType& type,
+                                                       double& momentum, double& varMomentum, bool& unitGain) const /*override*/
+    {
+        type = MultiTensorUpdateType::Adam;
+        momentum = MomentumValueForMB(trainingSampleCount);
+        varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+        unitGain = UseUnitGainMomentum();
+        return true;
+    }
+
+    // the bias correction of Matrix::AdamUpdate()
+    /*virtual*/ double LearnerAdam::NextMultiTensorAdaMul(const Parameter& parameter, double momentum, double varMomentum) const /*override*/
+    {
+        double& smoothedCount = m_smoothedCounts.at(parameter);
+        smoothedCount++;
+        return sqrt(1 - pow(varMomentum, smoothedCount)) / (1 - pow(momentum, smoothedCount));
+    }
+
+    // ||w|| / ||update||, or 1 if either is 0, e.g. for a parameter that is initialized with zeros
+    static double TrustRatio(double valueNorm, double updateNorm)
+    {
+        return valueNorm > 0 && updateNorm > 0 ? valueNorm / updateNorm : 1.0;
+    }
+
+    /*virtual*/ bool LearnerLARS::UpdateTogether(const vector<Parameter>& parameters, const unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                                 size_t trainingSampleCount) const /*override*/
+    {
+        UpdateTogether<float>(parameters, gradientValues, trainingSampleCount);
+        UpdateTogether<double>(parameters, gradientValues, trainingSampleCount);
+        return true;
+    }
+
+    template <typename ElementType>
+    void LearnerLARS::UpdateTogether(const vector<Parameter>& parameters, const unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                     size_t trainingSampleCount) const
+    {
+        // the values, then the preprocessed gradients
+        vector<Parameter> typedParameters;
+        vector<shared_ptr<Matrix<ElementType>>> matrices;
+        for (const auto& parameter : parameters)
+        {
+            if (parameter.GetDataType() != AsDataType<ElementType>())
+                continue;
+            PreProcess<ElementType>(parameter.Value(), gradientValues.at(parameter), trainingSampleCount);
+            typedParameters.push_back(parameter);
+            matrices.push_back(GetWritableMatrix<ElementType>(parameter.Value()));
+        }
+        for (const auto& parameter : typedParameters)
+            matrices.push_back(GetWritableMatrix<ElementType>(gradientValues.at(parameter)));
+
+        const auto norms = Norms<ElementType>(matrices);
+
+        const auto learningRate = LearningRate(trainingSampleCount);
+        const auto momentum = ElementType(MomentumValueForMB(trainingSampleCount));
+        const size_t count = typedParameters.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto& parameter = typedParameters[i];
+            const auto& gradientValue = gradientValues.at(parameter);
+            const auto trustRatio = m_trustCoefficient * TrustRatio(norms[i], norms[count + i]);
+            matrices[i]->MomentumSGDUpdate(*matrices[count + i], *GetWritableMatrix<ElementType>(m_smoothedGradientValues.at(parameter)),
+                                           ElementType(learningRate * trustRatio), momentum, UseUnitGainMomentum());
+            PostProcess<ElementType>(parameter, gradientValue, trainingSampleCount);
+
+            auto paramRef = parameter;
+            paramRef.RecordValueUpdate();
+        }
+    }
+
+    LearnerLAMB::LearnerLAMB(const vector<Parameter>& parameters,
+                             const LearningRateSchedule& learningRateSchedule,
+                             const MomentumSchedule& momentumSchedule,
+                             bool unitGain,
+                             const MomentumSchedule& varianceMomentumSchedule,
+                             double weightDecay,
+                             AdditionalLearningOptions additionalOptions)
+                             : LearnerMomentumSGD(parameters, learningRateSchedule, momentumSchedule,
+                                                  unitGain, additionalOptions, /*allocateSmoothGradients*/ false),
+                             m_varianceMomentumSchedule(varianceMomentumSchedule),
+                             m_weightDecay(weightDecay)
+    {
+        for (const auto& parameter : parameters)
+        {
+            const auto shape = GetMatrixShape(parameter);
+            NDArrayViewPtr view = AllocateNDArrayView(parameter, { shape[0], 2 * shape[1] });
+            m_smoothedGradientValues.emplace(parameter, view);
+            m_smoothedCounts.emplace(parameter, 0.0);
+        }
+    }
+
+    /*virtual*/ bool LearnerLAMB::UpdateTogether(const vector<Parameter>& parameters, const unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                                 size_t trainingSampleCount) const /*override*/
+    {
+        UpdateTogether<float>(parameters, gradientValues, trainingSampleCount);
+        UpdateTogether<double>(parameters, gradientValues, trainingSampleCount);
+        return true;
+    }
+
+    template <typename ElementType>
+    void LearnerLAMB::UpdateTogether(const vector<Parameter>& parameters, const unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                     size_t trainingSampleCount) const
+    {
+        const auto momentum = MomentumValueForMB(trainingSampleCount);
+        const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+
+        // the values, then their updates: the update of Matrix::AdamUpdate() (into a zero matrix, with learning rate -1),
+        // plus the weight decay
+        vector<Parameter> typedParameters;
+        vector<shared_ptr<Matrix<ElementType>>> matrices;
+        vector<shared_ptr<Matrix<ElementType>>> updates;
+        for (const auto& parameter : parameters)
+        {
+            if (parameter.GetDataType() != AsDataType<ElementType>())
+                continue;
+            const auto& gradientValue = gradientValues.at(parameter);
+            PreProcess<ElementType>(parameter.Value(), gradientValue, trainingSampleCount);
+
+            auto iter = m_updates.find(parameter);
+            if (iter == m_updates.end())
+                iter = m_updates.emplace(parameter, AllocateNDArrayView(parameter, GetMatrixShape(parameter))).first;
+            const auto& update = GetWritableMatrix<ElementType>(iter->second);
+            const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+            const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameter.Value());
+
+            update->SetValue(0);
+            GetWritableMatrix<ElementType>(m_smoothedGradientValues.at(parameter))->AdamUpdate(*gradientMatrix, *update, m_smoothedCounts.at(parameter),
+                /*learnRatePerSample=*/ -1.0, momentum, varMomentum, UseUnitGainMomentum(),
+                m_additionalOptions.lazySparseUpdate, LazyUpdateSteps<ElementType>(parameter, *gradientMatrix).get());
+            if (m_weightDecay > 0)
+                Matrix<ElementType>::ScaleAndAdd(ElementType(m_weightDecay), *parameterMatrix, *update);
+
+            typedParameters.push_back(parameter);
+            matrices.push_back(parameterMatrix);
+            updates.push_back(update);
+        }
+        matrices.insert(matrices.end(), updates.begin(), updates.end());
+
+        const auto norms = Norms<ElementType>(matrices);
+
+        const auto learningRate = LearningRate(trainingSampleCount);
+        const size_t count = typedParameters.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto& parameter = typedParameters[i];
+            const auto trustRatio = TrustRatio(norms[i], norms[count + i]);
+            Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate * trustRatio), *matrices[count + i], *matrices[i]);
+            PostProcess<ElementType>(parameter, gradientValues.at(parameter), trainingSampleCount);
+
+            auto paramRef = parameter;
+            paramRef.RecordValueUpdate();
+        }
     }
 
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
@@ -794,6 +1240,27 @@ namespace CNTK
         return MakeSharedObject<LearnerAdam>(parameters, learningRateSchedule, momentumSchedule, unitGain, varianceMomentumSchedule, additionalOptions);
     }
 
+    LearnerPtr LARSLearner(const vector<Parameter>& parameters,
+                           const LearningRateSchedule& learningRateSchedule,
+                           const MomentumSchedule& momentumSchedule,
+                           bool unitGain, /*=true*/
+                           double trustCoefficient, /*= 0.001*/
+                           AdditionalLearningOptions additionalOptions /*= AdditionalLearningOptions()*/)
+    {
+        return MakeSharedObject<LearnerLARS>(parameters, learningRateSchedule, momentumSchedule, unitGain, trustCoefficient, additionalOptions);
+    }
+
+    LearnerPtr LAMBLearner(const vector<Parameter>& parameters,
+                           const LearningRateSchedule& learningRateSchedule,
+                           const MomentumSchedule& momentumSchedule,
+                           bool unitGain, /*=true*/
+                           const MomentumSchedule& varianceMomentumSchedule, /*= MomentumAsTimeConstantSchedulePerSample(2 * 3600 * 100)*/
+                           double weightDecay, /*= 0.0*/
+                           AdditionalLearningOptions additionalOptions /*= AdditionalLearningOptions()*/)
+    {
+        return MakeSharedObject<LearnerLAMB>(parameters, learningRateSchedule, momentumSchedule, unitGain, varianceMomentumSchedule, weightDecay, additionalOptions);
+    }
+
     LearnerPtr AdaGradLearner(const vector<Parameter>& parameters,
                               const LearningRateSchedule& learningRateSchedule,
                               bool needAveMultiplier /*= true*/,
@@ -7,6 +7,8 @@
 
 #include "stdafx.h"
 #include "CNTKLibrary.h"
+#include "CommonMatrix.h"
+#include <functional>
 #include <numeric>
 
 namespace CNTK 
@@ -27,6 +29,8 @@ namespace CNTK
 
         virtual void ResetSmoothedGradients() override final;
 
+        virtual double LossScale() const override final { return m_lossScale; }
+
     protected:
         // allocateSmoothGradients flag specifies whether NDArrayViews for smoothed gradients can be allocated 
         // in the base class constructor (in which case they are allocated with the shapes identical to the shapes of
@@ -39,6 +43,31 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const = 0;
 
+        // For AdditionalLearningOptions::multiTensorUpdate: a learner whose update is one of MultiTensorUpdateType
+        // returns true, and the scalars of the update that are the same for all parameters.
+        virtual bool GetMultiTensorUpdate(size_t /*trainingSampleCount*/, Microsoft::MSR::CNTK::MultiTensorUpdateType& /*type*/,
+                                          double& /*momentum*/, double& /*varMomentum*/, bool& /*unitGain*/) const
+        {
+            return false;
+        }
+
+        // The factor adaMul of the multi-tensor update of a parameter, called once per update of the parameter.
+        virtual double NextMultiTensorAdaMul(const Parameter& /*parameter*/, double /*momentum*/, double /*varMomentum*/) const { return 1.0; }
+
+        // Layer-wise adaptive learners (LARS, LAMB) update the parameters of a minibatch together, since the trust ratio
+        // of each parameter comes from norms that are computed for all of them at once. Called instead of Update() per
+        // parameter, including the preprocessing and postprocessing; returns false to update one by one after all.
+        virtual bool UpdateTogether(const std::vector<Parameter>& /*parameters*/, const std::unordered_map<Parameter, NDArrayViewPtr>& /*gradientValues*/,
+                                    size_t /*trainingSampleCount*/) const
+        {
+            return false;
+        }
+
+        // The Frobenius norms of 'matrices'; those of the dense ones of a device are computed together, in one kernel
+        // launch per MultiTensorItem::MaxTensorsPerLaunch matrices (Matrix::MultiTensorSumOfSquares()).
+        template <typename ElementType>
+        static std::vector<double> Norms(const std::vector<std::shared_ptr<Microsoft::MSR::CNTK::Matrix<ElementType>>>& matrices);
+
         std::string LearnerType() const;
 
         // Returns current (per-sample) learning rate.
@@ -64,8 +93,17 @@ namespace CNTK
 
         std::unordered_map<Parameter, NDArrayViewPtr> m_smoothedGradientValues;
 
+        // the state of the decay catch-up of lazy sparse updates (AdditionalLearningOptions::lazyDecayCatchUp),
+        // allocated on first use and not checkpointed
+        mutable std::unordered_map<Parameter, NDArrayViewPtr> m_lazyUpdateSteps;
+
         mutable size_t m_noiseInjectionSeed;
 
+        // current loss scale (AdditionalLearningOptions::lossScale), and the number of consecutive minibatches
+        // without overflow since it was last changed (for dynamic loss scaling)
+        double m_lossScale;
+        size_t m_lossScaleGoodMinibatchCount;
+
         // The following four static protected methods expose private methods of NDArrayView class
         // (which declares LearnerBase as friend class), so that they are available to subclasses.
         template <typename ElementType>
@@ -93,6 +131,11 @@ namespace CNTK
         template <typename ElementType>
         void PostProcess(const Parameter& parameter, const NDArrayViewPtr& gradientValue, size_t actualMBSize) const;
 
+        // Returns the state of the decay catch-up for Matrix::AdamUpdate() and Matrix::FSAdagradUpdate(), nullptr if
+        // it is off or the gradient is dense.
+        template <typename ElementType>
+        std::shared_ptr<Microsoft::MSR::CNTK::Matrix<ElementType>> LazyUpdateSteps(const Parameter& parameter, const Microsoft::MSR::CNTK::Matrix<ElementType>& gradient) const;
+
         // Returns an NDArrayView with the required shape, with the same data type as parameter value
         // and allocated on the same device.
         static NDArrayViewPtr AllocateNDArrayView(const Parameter& parameter, const NDShape& shape);
@@ -106,8 +149,37 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        // The dense parameters of one device that are updated together (AdditionalLearningOptions::multiTensorUpdate).
+        template <typename ElementType>
+        struct MultiTensorGroup
+        {
+            std::vector<Parameter> parameters;
+            std::vector<NDArrayViewPtr> gradientValues;
+            std::vector<Microsoft::MSR::CNTK::MultiTensorItem<ElementType>> items;
+            std::vector<double> sumsOfSquares; // of the gradients as passed in, if needed
+        };
+
+        // Moves the parameters that can be updated by a multi-tensor update from 'parameters' into groups.
+        template <typename ElementType>
+        void GetMultiTensorGroups(std::vector<Parameter>& parameters, const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                  Microsoft::MSR::CNTK::MultiTensorUpdateType type, std::map<DEVICEID_TYPE, MultiTensorGroup<ElementType>>& groups) const;
+
+        // Preprocessing, update and postprocessing of a group, the same as Update() of each of its parameters.
+        template <typename ElementType>
+        void UpdateMultiTensorGroup(DEVICEID_TYPE deviceId, MultiTensorGroup<ElementType>& group, size_t trainingSampleCount,
+                                    Microsoft::MSR::CNTK::MultiTensorUpdateType type, double momentum, double varMomentum, bool unitGain) const;
+
+        // whether the gradient of each parameter of the groups is finite, from their sums of squares
+        template <typename ElementType>
+        static void GetFiniteGradients(const std::map<DEVICEID_TYPE, MultiTensorGroup<ElementType>>& groups, std::unordered_map<Parameter, bool>& isFinite);
+
         // TODO: make these functions friends of NDViewArray and move to Utils?
         static bool HasNan(const NDArrayViewPtr& value, const char* name);
+        static bool IsFinite(const NDArrayViewPtr& value);
+
+        // Dynamic loss scaling: returns false (and lowers the loss scale) if any gradient overflowed, i.e. if 'isFinite'
+        // is false for any parameter.
+        bool AdjustLossScale(const std::function<bool(const Parameter&)>& isFinite);
         static void Print(const NDArrayViewPtr& value, const char* msg);
 
         // Version history:
@@ -130,6 +202,9 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool GetMultiTensorUpdate(size_t trainingSampleCount, Microsoft::MSR::CNTK::MultiTensorUpdateType& type,
+                                          double& momentum, double& varMomentum, bool& unitGain) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
     };
@@ -158,6 +233,9 @@ namespace CNTK
     protected:
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool GetMultiTensorUpdate(size_t trainingSampleCount, Microsoft::MSR::CNTK::MultiTensorUpdateType& type,
+                                          double& momentum, double& varMomentum, bool& unitGain) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -192,6 +270,9 @@ namespace CNTK
     protected:
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool GetMultiTensorUpdate(size_t trainingSampleCount, Microsoft::MSR::CNTK::MultiTensorUpdateType& type,
+                                          double& momentum, double& varMomentum, bool& unitGain) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
     };
@@ -247,6 +328,9 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool GetMultiTensorUpdate(size_t trainingSampleCount, Microsoft::MSR::CNTK::MultiTensorUpdateType& type,
+                                          double& momentum, double& varMomentum, bool& unitGain) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -278,6 +362,11 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool GetMultiTensorUpdate(size_t trainingSampleCount, Microsoft::MSR::CNTK::MultiTensorUpdateType& type,
+                                          double& momentum, double& varMomentum, bool& unitGain) const override;
+
+        virtual double NextMultiTensorAdaMul(const Parameter& parameter, double momentum, double varMomentum) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -293,6 +382,82 @@ namespace CNTK
         MomentumSchedule m_varianceMomentumSchedule;
     };
 
+    // LARS, layer-wise adaptive rate scaling (You et al., 2017) for training with large minibatches: momentum SGD whose
+    // learning rate for each parameter is scaled by the trust ratio trustCoefficient * ||w|| / ||g||, where the gradient
+    // g includes the L2 regularization (weight decay) of the additional options.
+    class LearnerLARS : public LearnerMomentumSGD
+    {
+    public:
+        LearnerLARS(const std::vector<Parameter>& parameters,
+                    const LearningRateSchedule& learningRateSchedule,
+                    const MomentumSchedule& momentumSchedule,
+                    bool unitGain,
+                    double trustCoefficient,
+                    AdditionalLearningOptions additionalOptions)
+                    : LearnerMomentumSGD(parameters, learningRateSchedule, momentumSchedule, unitGain, additionalOptions, /*allocateSmoothGradients*/ true),
+                    m_trustCoefficient(trustCoefficient)
+        {}
+
+    protected:
+        virtual bool UpdateTogether(const std::vector<Parameter>& parameters, const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                    size_t trainingSampleCount) const override;
+
+        virtual bool GetMultiTensorUpdate(size_t /*trainingSampleCount*/, Microsoft::MSR::CNTK::MultiTensorUpdateType& /*type*/,
+                                          double& /*momentum*/, double& /*varMomentum*/, bool& /*unitGain*/) const override
+        {
+            return false;
+        }
+
+        template <typename ElementType>
+        void UpdateTogether(const std::vector<Parameter>& parameters, const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                            size_t trainingSampleCount) const;
+
+    private:
+        double m_trustCoefficient;
+    };
+
+    // LAMB (You et al., 2019): Adam whose update r of each parameter, including the decoupled weight decay
+    // weightDecay * w, is scaled by the trust ratio ||w|| / ||r||.
+    class LearnerLAMB : public LearnerMomentumSGD
+    {
+    public:
+        LearnerLAMB(const std::vector<Parameter>& parameters,
+                    const LearningRateSchedule& learningRateSchedule,
+                    const MomentumSchedule& momentumSchedule,
+                    bool unitGain,
+                    const MomentumSchedule& varianceMomentumSchedule,
+                    double weightDecay,
+                    AdditionalLearningOptions additionalOptions);
+
+    protected:
+        virtual bool UpdateTogether(const std::vector<Parameter>& parameters, const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                    size_t trainingSampleCount) const override;
+
+        virtual bool GetMultiTensorUpdate(size_t /*trainingSampleCount*/, Microsoft::MSR::CNTK::MultiTensorUpdateType& /*type*/,
+                                          double& /*momentum*/, double& /*varMomentum*/, bool& /*unitGain*/) const override
+        {
+            return false;
+        }
+
+        template <typename ElementType>
+        void UpdateTogether(const std::vector<Parameter>& parameters, const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                            size_t trainingSampleCount) const;
+
+    private:
+        // returns current per-minibatch variance momentum value.
+        double VarianceMomentumValueForMB(size_t minibatchSize) const
+        {
+            return MomentumValueForMB(m_varianceMomentumSchedule, minibatchSize);
+        }
+
+        mutable std::unordered_map<Parameter, double> m_smoothedCounts;
+        MomentumSchedule m_varianceMomentumSchedule;
+        double m_weightDecay;
+
+        // the update of each parameter before it is scaled, allocated on first use
+        mutable std::unordered_map<Parameter, NDArrayViewPtr> m_updates;
+    };
+
     class LearnerRMSProp : public LearnerBase
     {
     public:
@@ -104,6 +104,7 @@ namespace CNTK
         m_truncationLength = configuration.truncationLength;
 
         auto augmentedConfiguration = Internal::ToDictionary(configuration);
+        m_configuration = augmentedConfiguration;
 
         ConfigParameters config;
         std::wstringstream s;
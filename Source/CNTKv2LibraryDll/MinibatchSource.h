@@ -34,6 +34,9 @@ namespace CNTK
         virtual Dictionary GetCheckpointState() const override;
         virtual void RestoreFromCheckpoint(const Dictionary& checkpoint) override;
 
+        // the reader configuration the source was created with
+        const Dictionary& Configuration() const { return m_configuration; }
+
     private:
         static Microsoft::MSR::CNTK::InputStreamDescription GetInputStreamDescription(const StreamInformation& s, const DeviceDescriptor& device)
         {
@@ -45,6 +48,7 @@ namespace CNTK
         }
 
     private:
+        Dictionary m_configuration;
         std::unordered_set<StreamInformation> m_streamInfos;
         bool m_epochEndReached;
         size_t m_numWorkers;
@@ -19,17 +19,24 @@ namespace CNTK
     static TensorView<ElementType>* AllocateTensorView(const NDShape& viewShape,
                                                        const DeviceDescriptor& device,
                                                        void* dataBuffer,
-                                                       size_t bufferSizeInBytes)
+                                                       size_t bufferSizeInBytes,
+                                                       const std::function<void()>& releaseBuffer)
     {
         if (dataBuffer == nullptr)
             InvalidArgument("Cannot create a NDArrayView over a null data buffer.");
 
+        if ((reinterpret_cast<uintptr_t>(dataBuffer) % alignof(ElementType)) != 0)
+            InvalidArgument("The buffer specified for creating the NDArrayView is not aligned to the size (%d) of its element type.", (int)alignof(ElementType));
+
         if (bufferSizeInBytes < (viewShape.TotalSize() * sizeof(ElementType)))
             InvalidArgument("Size (%d) of the specified buffer for creating the NDArrayView is smaller than the specified view shape '%S'.",
                             (int)bufferSizeInBytes, viewShape.AsString().c_str());
 
         auto matrixDims = GetMatrixDimensions(viewShape);
         std::shared_ptr<Matrix<ElementType>> matrix = std::make_shared<Matrix<ElementType>>(matrixDims.first, matrixDims.second, (ElementType*)dataBuffer, AsCNTKImplDeviceId(device), matrixFlagDontOwnBuffer);
+        if (releaseBuffer)
+            matrix->SetExternalBufferReleaser(releaseBuffer);
+
         return new TensorView<ElementType>(matrix, AsTensorViewShape(viewShape));
     }
 
@@ -37,14 +44,15 @@ namespace CNTK
                                     const NDShape& viewShape,
                                     const DeviceDescriptor& device,
                                     void* dataBuffer,
-                                    size_t bufferSizeInBytes)
+                                    size_t bufferSizeInBytes,
+                                    const std::function<void()>& releaseBuffer = nullptr)
     {
         switch (dataType)
         {
         case DataType::Float:
-            return AllocateTensorView<float>(viewShape, device, dataBuffer, bufferSizeInBytes);
+            return AllocateTensorView<float>(viewShape, device, dataBuffer, bufferSizeInBytes, releaseBuffer);
         case DataType::Double:
-            return AllocateTensorView<double>(viewShape, device, dataBuffer, bufferSizeInBytes);
+            return AllocateTensorView<double>(viewShape, device, dataBuffer, bufferSizeInBytes, releaseBuffer);
         default:
             LogicError("Unsupported DataType %s", DataTypeName(dataType));
             break;
@@ -90,6 +98,11 @@ namespace CNTK
     {
     }
 
+    NDArrayView::NDArrayView(CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const DeviceDescriptor& device, bool readOnly, const std::function<void()>& releaseBuffer)
+        : NDArrayView(dataType, device, StorageFormat::Dense, viewShape, readOnly, AllocateTensorView(dataType, viewShape, device, dataBuffer, bufferSizeInBytes, releaseBuffer))
+    {
+    }
+
     template <typename ElementType>
     NDArrayView::NDArrayView(const NDShape& viewShape, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const ElementType* nonZeroValues, size_t numNonZeroValues, const DeviceDescriptor& device, bool readOnly/* = false*/)
         : NDArrayView(AsDataType<ElementType>(), device, StorageFormat::SparseCSC, viewShape, false, AllocateTensorView<ElementType>(viewShape, StorageFormat::SparseCSC, device, numNonZeroValues))
@@ -139,7 +152,13 @@ namespace CNTK
             if (IsSparse())
                 LogicError("NDArrayView::SetValue: Setting a NDArrayView contents to a scalar is only allowed for objects with dense storage format.");
 
-            GetWritableMatrix<float>()->SetValue(value);
+            if (!IsContiguous())
+            {
+                auto tensorView = GetWritableTensorView<float>();
+                tensorView->DoUnaryOpOf(0, *tensorView, value, ElementWiseOperator::opConstOne, ElementWiseOperator::opSum);
+            }
+            else
+                GetWritableMatrix<float>()->SetValue(value);
         }
     }
 
@@ -148,13 +167,21 @@ namespace CNTK
         if (IsSparse())
             LogicError("NDArrayView::SetValue: Setting a NDArrayView contents to a scalar is only allowed for objects with dense storage format.");
 
-        GetWritableMatrix<double>()->SetValue(value);
+        if (!IsContiguous())
+        {
+            auto tensorView = GetWritableTensorView<double>();
+            tensorView->DoUnaryOpOf(0, *tensorView, value, ElementWiseOperator::opConstOne, ElementWiseOperator::opSum);
+        }
+        else
+            GetWritableMatrix<double>()->SetValue(value);
     }
 
     template <typename ElementType>
     /*static*/ std::shared_ptr<Matrix<ElementType>> NDArrayView::GetMatrixImpl(const TensorView<ElementType>* tensorView, size_t rowColSplitPoint)
     {
         auto tensorShape = tensorView->GetShape();
+        if (!tensorShape.IsDense())
+            InvalidArgument("NDArrayView::GetMatrix: The NDArrayView (shape = %s) is not contiguous in memory; DeepClone() it first.", ((std::string)tensorShape).c_str());
 
         // we should always reshape for rank-0, so that batch and sequence axis goes to columns
         if (tensorShape.GetRank() <= 1 && rowColSplitPoint != 0)
@@ -226,6 +253,13 @@ namespace CNTK
     NDArrayViewPtr NDArrayView::DeepClone(const DeviceDescriptor& device, bool readOnly/* = false*/) const
     {
         NDArrayViewPtr newView = MakeSharedObject<NDArrayView>(this->GetDataType(), this->GetStorageFormat(), this->Shape(), device);
+        if (!IsContiguous())
+        {
+            newView->CopyFrom(*this);
+            newView->m_isReadOnly = readOnly;
+            return newView;
+        }
+
         switch (m_dataType)
         {
         case DataType::Float:
@@ -260,6 +294,23 @@ namespace CNTK
         if (IsReadOnly())
             RuntimeError("NDArrayView::CopyFrom: Cannot modify contents of a readonly NDArrayView.");
 
+        if (!IsContiguous() || !source.IsContiguous())
+        {
+            switch (m_dataType)
+            {
+            case DataType::Float:
+                CopyStridedFrom<float>(source);
+                break;
+            case DataType::Double:
+                CopyStridedFrom<double>(source);
+                break;
+            default:
+                LogicError("NDArrayView::CopyFrom: Unsupported DataType %s", DataTypeName(m_dataType));
+                break;
+            }
+            return;
+        }
+
         switch (m_dataType)
         {
         case DataType::Float:
@@ -282,6 +333,81 @@ namespace CNTK
         }
     }
 
+    // Copies from or to a view that is not contiguous, elementwise through the TensorViews, which follow the strides.
+    // A source on another device is first made contiguous on its own device, and then transferred as a whole.
+    template <typename ElementType>
+    void NDArrayView::CopyStridedFrom(const NDArrayView& source)
+    {
+        if (source.GetDataType() != GetDataType())
+            InvalidArgument("NDArrayView::CopyFrom: The DataType %s of the source NDArrayView does not match the DataType %s of this NDArrayView.", DataTypeName(source.GetDataType()), DataTypeName(GetDataType()));
+
+        NDArrayViewPtr stagedSource;
+        const NDArrayView* sameDeviceSource = &source;
+        if (source.Device() != Device())
+        {
+            if (!source.IsContiguous())
+            {
+                stagedSource = source.DeepClone(source.Device());
+                if (IsContiguous())
+                {
+                    GetWritableMatrix<ElementType>()->AssignValuesOf(*stagedSource->GetMatrix<ElementType>());
+                    return;
+                }
+            }
+
+            auto transferredSource = MakeSharedObject<NDArrayView>(GetDataType(), StorageFormat::Dense, Shape(), Device());
+            transferredSource->CopyFrom(stagedSource ? *stagedSource : source);
+            stagedSource = transferredSource;
+            sameDeviceSource = stagedSource.get();
+        }
+
+        if (sameDeviceSource->IsSparse())
+        {
+            // sparse views are always contiguous, so 'this' is the strided one
+            stagedSource = MakeSharedObject<NDArrayView>(GetDataType(), StorageFormat::Dense, Shape(), Device());
+            stagedSource->CopyFrom(*sameDeviceSource);
+            sameDeviceSource = stagedSource.get();
+        }
+        else if (IsSparse())
+            InvalidArgument("NDArrayView::CopyFrom: Copying a NDArrayView that is not contiguous into a sparse NDArrayView is not supported.");
+
+        GetWritableTensorView<ElementType>()->AssignCopyOf(*sameDeviceSource->GetTensorView<ElementType>());
+    }
+
+    std::future<void> NDArrayView::CopyFromAsync(const NDArrayViewPtr& source)
+    {
+        if (IsReadOnly())
+            RuntimeError("NDArrayView::CopyFromAsync: Cannot modify contents of a readonly NDArrayView.");
+
+        // The task holds on to both views, so the caller need not.
+        auto destination = shared_from_this();
+        return std::async(std::launch::async, [destination, source]() {
+            destination->CopyFrom(*source);
+        });
+    }
+
+    std::future<NDArrayViewPtr> NDArrayView::DeepCloneAsync(const DeviceDescriptor& device, bool readOnly/* = false*/) const
+    {
+        auto source = shared_from_this();
+        return std::async(std::launch::async, [source, device, readOnly]() {
+            return source->DeepClone(device, readOnly);
+        });
+    }
+
+    bool NDArrayView::IsContiguous() const
+    {
+        switch (m_dataType)
+        {
+        case DataType::Float:
+            return GetTensorView<float>()->GetShape().IsDense();
+        case DataType::Double:
+            return GetTensorView<double>()->GetShape().IsDense();
+        default:
+            LogicError("NDArrayView::IsContiguous: Unsupported DataType %s", DataTypeName(m_dataType));
+            break;
+        }
+    }
+
     NDArrayViewPtr NDArrayView::Alias(bool readOnly/* = false*/) const
     {
         void* tensorView = nullptr;
@@ -301,6 +427,16 @@ namespace CNTK
         return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), Shape(), IsReadOnly() || readOnly, tensorView);
     }
 
+    template <typename ElementType>
+    static TensorView<ElementType>* NarrowedTensorView(const TensorView<ElementType>& tensorView, const std::vector<size_t>& startOffset, const std::vector<size_t>& endOffset)
+    {
+        auto tensorShape = tensorView.GetShape();
+        for (size_t i = 0; i < startOffset.size(); ++i)
+            tensorShape.NarrowTo(i, startOffset[i], endOffset[i]);
+
+        return new TensorView<ElementType>(tensorView, tensorShape);
+    }
+
     NDArrayViewPtr NDArrayView::SliceView(const std::vector<size_t>& startOffset, const std::vector<size_t>& extent, bool readOnly) const
     {
         auto rank = Shape().Rank();
@@ -314,6 +450,7 @@ namespace CNTK
             InvalidArgument("NDArrayView::SliceView: Specified slice extent is zero along at least one of the axes.");
 
         bool anyPrevAxisSliced = false;
+        bool isContiguousSlice = IsContiguous();
         NDShape sliceViewShape(extent);
         std::vector<size_t> endOffset(rank);
         for (size_t i = 0; i < rank; ++i)
@@ -322,16 +459,42 @@ namespace CNTK
                 sliceViewShape[i] = Shape()[i] - startOffset[i];
 
             endOffset[i] = startOffset[i] + ((i < sliceViewShape.Rank()) ? sliceViewShape[i] : 1);
+            if (endOffset[i] > Shape()[i])
+                InvalidArgument("NDArrayView::SliceView: The slice offset = %S, extent = %S exceeds this NDArrayView shape = %S.",
+                                NDShape(startOffset).AsString().c_str(), NDShape(extent).AsString().c_str(), Shape().AsString().c_str());
 
             if (anyPrevAxisSliced && ((endOffset[i] - startOffset[i]) != 1))
-                InvalidArgument("NDArrayView::SliceView: Cannot create a slice which is not contiguous in memory. "
-                                "This NDArrayView shape = %S, slice offset = %S, slice extent = %S.",
-                                 Shape().AsString().c_str(), NDShape(startOffset).AsString().c_str(), NDShape(extent).AsString().c_str());
+                isContiguousSlice = false;
 
             bool isCurrentAxisSliced = (startOffset[i] != 0) || (endOffset[i] != Shape()[i]);
             anyPrevAxisSliced = anyPrevAxisSliced || isCurrentAxisSliced;
         }
 
+        if (!isContiguousSlice)
+        {
+            // a strided view over the same data
+            if (IsSparse())
+                InvalidArgument("NDArrayView::SliceView: Cannot create a slice of a sparse NDArrayView which is not contiguous in memory. "
+                                "This NDArrayView shape = %S, slice offset = %S, slice extent = %S.",
+                                Shape().AsString().c_str(), NDShape(startOffset).AsString().c_str(), NDShape(extent).AsString().c_str());
+
+            void* stridedTensorView = nullptr;
+            switch (m_dataType)
+            {
+            case DataType::Float:
+                stridedTensorView = NarrowedTensorView(*GetTensorView<float>(), startOffset, endOffset);
+                break;
+            case DataType::Double:
+                stridedTensorView = NarrowedTensorView(*GetTensorView<double>(), startOffset, endOffset);
+                break;
+            default:
+                LogicError("NDArrayView::SliceView: Unsupported DataType %s", DataTypeName(m_dataType));
+                break;
+            }
+
+            return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), sliceViewShape, IsReadOnly() || readOnly, stridedTensorView);
+        }
+
         auto flatBufferOffset = AsTensorShape(Shape()).Locate(startOffset);
         auto sliceViewMatrixDims = GetMatrixDimensions(sliceViewShape);
         assert((flatBufferOffset % sliceViewMatrixDims.first) == 0);
@@ -382,6 +545,9 @@ namespace CNTK
                             (int)newShape.TotalSize(), newShape.AsString().c_str());
         }
 
+        if (!IsContiguous())
+            InvalidArgument("NDArrayView::AsShape: Cannot reshape the NDArrayView (shape '%S') which is not contiguous in memory; DeepClone() it first.", Shape().AsString().c_str());
+
         auto newTensorShape = AsTensorViewShape(newShape);
         void* tensorView = nullptr;
         switch (m_dataType)
@@ -420,6 +586,9 @@ namespace CNTK
         if (IsSparse())
             InvalidArgument("DataBuffer/WritableDataBuffer methods not supported for sparse NDArrayiew objects.");
 
+        if (!IsContiguous())
+            InvalidArgument("DataBuffer/WritableDataBuffer methods not supported for NDArrayView objects which are not contiguous in memory.");
+
         // First make sure that the underlying matrix is on the right device
         auto matrix = GetMatrix<ElementType>();
         matrix->TransferToDeviceIfNotThere(AsCNTKImplDeviceId(m_device), true);
@@ -431,6 +600,9 @@ namespace CNTK
         if (device == m_device)
             return;
 
+        if (!IsContiguous())
+            InvalidArgument("NDArrayView::ChangeDevice: Cannot move the NDArrayView (shape '%S') which is not contiguous in memory, as it shares its storage.", Shape().AsString().c_str());
+
         switch (m_dataType)
         {
         case DataType::Float:
@@ -484,7 +656,7 @@ namespace CNTK
 
         ElementType scalar = std::numeric_limits<ElementType>::quiet_NaN();
         std::shared_ptr<const NDArrayView> cpuData;
-        if (scalarData->Device() == DeviceDescriptor::CPUDevice())
+        if ((scalarData->Device() == DeviceDescriptor::CPUDevice()) && scalarData->IsContiguous())
             cpuData = scalarData;
         else
         {
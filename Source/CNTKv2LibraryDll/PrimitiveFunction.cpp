@@ -85,6 +85,9 @@ namespace CNTK
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameRecurrentOp = L"recurrentOp";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameRngSeed = L"rngSeed";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameRngOffset = L"rngOffset";
+    /*static*/ const std::wstring PrimitiveFunction::AttributeNameRecompute = L"recompute";
+    /*static*/ const std::wstring PrimitiveFunction::AttributeNameOffload = L"offload";
+    /*static*/ const std::wstring PrimitiveFunction::AttributeNamePlacementDeviceId = L"placementDeviceId";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameUnpoolingWindowShape = L"unpoolingWindowShape";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameSubstitutionPenalty = L"SubstitutionPenalty";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameDeletionPenalty = L"DeletionPenalty";
@@ -99,6 +102,7 @@ namespace CNTK
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameSequenceAxisNamePrefix = L"sequenceAxis";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameSequenceUnpackPaddingValue = L"sequenceUnpackPaddingValue";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameSequenceUnpackSuppressMaskOutput = L"sequenceUnpackSuppressMaskOutput";
+    /*static*/ const std::wstring PrimitiveFunction::AttributeNameAttentionScale = L"attentionScale";
 
     /*static*/ DataType PrimitiveFunction::GetOutputDataType(PrimitiveOpType op, std::vector<Variable>& inputs, bool inferDimensions)
     {
@@ -232,6 +236,8 @@ namespace CNTK
             outputDynamicAxes = inputs[1].DynamicAxes();
         else if (op == PrimitiveOpType::PastValue || op == PrimitiveOpType::FutureValue)
             outputDynamicAxes = inputs[0].DynamicAxes(); // second arg (initial state) may have different dynamic axis
+        else if (op == PrimitiveOpType::ScaledDotProductAttention)
+            outputDynamicAxes = inputs[0].DynamicAxes(); // keys and values may be on another sequence axis
         else
         {
             auto allInputDynamicAxesEmpty = std::find_if(inputs.begin(), inputs.end(), [](const Variable& input) { return !input.DynamicAxes().empty(); }) == inputs.end();
@@ -412,6 +418,19 @@ namespace CNTK
 
                             outputShape = UnaryElementwiseOpOutputShape(m_inputs[1].Shape());
                             break;
+                        case PrimitiveOpType::ScaledDotProductAttention:
+                        {
+                            assert(m_inputs.size() == 3);
+                            if (m_inputs[0].DynamicAxes().empty() || m_inputs[1].DynamicAxes().empty())
+                                InvalidArgument("ScaledDotProductAttention: The query '%S' and the keys '%S' must have dynamic axes.", m_inputs[0].AsString().c_str(), m_inputs[1].AsString().c_str());
+                            if (m_inputs[1].DynamicAxes() != m_inputs[2].DynamicAxes())
+                                InvalidArgument("ScaledDotProductAttention: The keys '%S' and the values '%S' must have the same dynamic axes.", m_inputs[1].AsString().c_str(), m_inputs[2].AsString().c_str());
+                            if (m_inputs[0].Shape().TotalSize() != m_inputs[1].Shape().TotalSize())
+                                InvalidArgument("ScaledDotProductAttention: The shapes of the query '%S' and the keys '%S' must have the same total size.", m_inputs[0].AsString().c_str(), m_inputs[1].AsString().c_str());
+
+                            outputShape = UnaryElementwiseOpOutputShape(m_inputs[2].Shape());
+                            break;
+                        }
                         case PrimitiveOpType::ScatterPacked:
                         {
                             assert(m_inputs.size() == 3);
@@ -99,6 +99,7 @@ namespace CNTK
         {PrimitiveOpType::ToSequenceLike, L"ToSequenceLikeOp"},
         {PrimitiveOpType::UnpackSequence, L"UnpackSequenceOp"},
         {PrimitiveOpType::Assign, L"Assign" },
+        {PrimitiveOpType::ScaledDotProductAttention, L"ScaledDotProductAttention" },
     };
 
     inline const std::wstring& PrimitiveOpTypeName(PrimitiveOpType opType)
@@ -241,6 +242,9 @@ namespace CNTK
         static const std::wstring AttributeNameReductionKeepDimensions;
         static const std::wstring AttributeNameRngSeed;
         static const std::wstring AttributeNameRngOffset;
+        static const std::wstring AttributeNameRecompute;
+        static const std::wstring AttributeNameOffload;
+        static const std::wstring AttributeNamePlacementDeviceId;
         static const std::wstring AttributeNameBidirectional;
         static const std::wstring AttributeNameNumLayers;
         static const std::wstring AttributeNameHiddenSize;
@@ -259,6 +263,7 @@ namespace CNTK
         static const std::wstring AttributeNameSequenceAxisNamePrefix;
         static const std::wstring AttributeNameSequenceUnpackPaddingValue;
         static const std::wstring AttributeNameSequenceUnpackSuppressMaskOutput;
+        static const std::wstring AttributeNameAttentionScale;
 
     protected:
         PrimitiveFunction(PrimitiveOpType op, const std::vector<Variable>& inputs, Dictionary&& functionConfig, const std::wstring& functionName, const std::wstring& uid)
@@ -750,7 +755,8 @@ namespace CNTK
         // Version 10: Add Pow operator.
         // Version 11: Add ToSequence, ToSequenceLike and UnpackSequence operators.
         // Version 12: Add Assign node.
-        static const size_t s_serializationVersion = 12;
+        // Version 13: Add ScaledDotProductAttention.
+        static const size_t s_serializationVersion = 13;
     };
 
     class UDFUtils
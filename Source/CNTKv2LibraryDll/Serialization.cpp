@@ -11,6 +11,9 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
 
 #ifdef _MSC_VER
 #include <io.h>
@@ -39,21 +42,64 @@ namespace CNTK
         friend class DictionaryValue;
 
     private:
-        static proto::DictionaryValue* CreateProto(const DictionaryValue& src, Arena* arena = nullptr);
-        static proto::Dictionary* CreateProto(const Dictionary& src, Arena* arena = nullptr);
-        static proto::Vector* CreateProto(const std::vector<DictionaryValue>& src, Arena* arena = nullptr);
-        static proto::NDArrayView* CreateProto(const NDArrayView& src, Arena* arena = nullptr);
+        // The data of large dense NDArrayViews is not copied into the protobuf message, which would hold a second copy of it
+        // in memory and is limited to 2GB, but streamed from and to raw blobs after the message. Such a stream starts with
+        //   s_blobFormatMagic, the format version, the size of the message, the number of blobs, and for each blob
+        //   its offset from the start of the stream and its size in bytes,
+        // followed by the message, and the blobs, each aligned to s_blobAlignment. The NDArrayView messages of the blobs
+        // have no values; the blobs follow in the order in which CollectBlobs() finds them, with dictionary keys sorted.
+        // Streams without blobs only contain the message, as before.
+        struct TensorBlobs
+        {
+            std::unordered_map<const proto::NDArrayView*, const NDArrayView*> sources; // when writing
+            std::unordered_map<const proto::NDArrayView*, NDArrayView*> destinations;  // when reading
+            std::vector<uint64_t> offsetsAndSizes;                                      // when reading, two per blob
+            uint64_t endOfMessage = 0;                                                  // when reading
+        };
+
+        static const char s_blobFormatMagic[8];
+        static const uint64_t s_blobFormatVersion;
+        static const uint64_t s_blobAlignment;
+        static const size_t s_minBlobBytes;
+
+        static proto::DictionaryValue* CreateProto(const DictionaryValue& src, Arena* arena = nullptr, TensorBlobs* blobs = nullptr);
+        static proto::Dictionary* CreateProto(const Dictionary& src, Arena* arena = nullptr, TensorBlobs* blobs = nullptr);
+        static proto::Vector* CreateProto(const std::vector<DictionaryValue>& src, Arena* arena = nullptr, TensorBlobs* blobs = nullptr);
+        static proto::NDArrayView* CreateProto(const NDArrayView& src, Arena* arena = nullptr, TensorBlobs* blobs = nullptr);
         static proto::Axis* CreateProto(const Axis& src, Arena* arena = nullptr);
         static proto::NDShape* CreateProto(const NDShape& src, Arena* arena = nullptr);
 
-        static Dictionary* CreateFromProto(const proto::Dictionary& src);
-        static std::vector<DictionaryValue>* CreateFromProto(const proto::Vector& src);
-        static NDArrayView* CreateFromProto(const proto::NDArrayView& src);
+        static Dictionary* CreateFromProto(const proto::Dictionary& src, TensorBlobs* blobs = nullptr);
+        static std::vector<DictionaryValue>* CreateFromProto(const proto::Vector& src, TensorBlobs* blobs = nullptr);
+        static NDArrayView* CreateFromProto(const proto::NDArrayView& src, TensorBlobs* blobs = nullptr);
         static Axis* CreateFromProto(const proto::Axis& src);
         static NDShape* CreateFromProto(const proto::NDShape& src);
 
-        static void Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena = nullptr);
-        static void Copy(const proto::DictionaryValue& src, DictionaryValue& dst);
+        static void Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena = nullptr, TensorBlobs* blobs = nullptr);
+        static void Copy(const proto::DictionaryValue& src, DictionaryValue& dst, TensorBlobs* blobs = nullptr);
+
+        static bool IsBlob(const proto::NDArrayView& src)
+        {
+            if (!proto::NDArrayView::DataType_IsValid(src.data_type()))
+                return false;
+
+            auto dataType = FromProtoType(src.data_type());
+            return ((dataType == DataType::Float) || (dataType == DataType::Double)) && !src.has_float_values() && !src.has_double_values();
+        }
+
+        static void CollectBlobs(const proto::Dictionary& src, std::vector<const proto::NDArrayView*>& blobs);
+        static void CollectBlobs(const proto::Vector& src, std::vector<const proto::NDArrayView*>& blobs);
+        static void CollectBlobs(const proto::DictionaryValue& src, std::vector<const proto::NDArrayView*>& blobs);
+
+        template <typename MessageType>
+        static void Write(std::ostream& stream, const MessageType& message, const TensorBlobs& blobs);
+
+        // Reads the message, and the layout of the blobs that follow it; returns whether there are blobs to ReadBlobs().
+        static bool ReadMessage(std::istream& stream, Message& message, TensorBlobs& blobs);
+
+        // Reads the blobs into the NDArrayViews created from the message.
+        template <typename MessageType>
+        static void ReadBlobs(std::istream& stream, const MessageType& message, TensorBlobs& blobs);
 
         static proto::NDArrayView::DataType ToProtoType(DataType type)
         {
@@ -178,14 +224,19 @@ namespace CNTK
         }
     }
 
-    /*static*/ proto::NDArrayView* Serializer::CreateProto(const NDArrayView& src, Arena* arena)
+    /*static*/ proto::NDArrayView* Serializer::CreateProto(const NDArrayView& src, Arena* arena, TensorBlobs* blobs)
     {
         proto::NDArrayView* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::NDArrayView>(arena) : new proto::NDArrayView();
         dst->set_data_type(ToProtoType(src.GetDataType()));
         dst->set_allocated_shape(CreateProto(src.Shape(), arena));
         dst->set_storage_format(ToProtoType(src.GetStorageFormat()));
-        if (src.GetDataType() == DataType::Float)
+        bool isDenseFloatOrDouble = !src.IsSparse() && ((src.GetDataType() == DataType::Float) || (src.GetDataType() == DataType::Double));
+        if (blobs && isDenseFloatOrDouble && (src.Shape().TotalSize() * DataTypeSize(src.GetDataType()) >= s_minBlobBytes))
+        {
+            blobs->sources[dst] = &src;
+        }
+        else if (src.GetDataType() == DataType::Float)
         {
             CopyData<float>(src, dst->mutable_float_values()->mutable_value());
         }
@@ -196,7 +247,7 @@ namespace CNTK
         return dst;
     }
 
-    /*static*/ NDArrayView* Serializer::CreateFromProto(const proto::NDArrayView& src)
+    /*static*/ NDArrayView* Serializer::CreateFromProto(const proto::NDArrayView& src, TensorBlobs* blobs)
     {
         if (!proto::NDArrayView::DataType_IsValid(src.data_type()) ||
             !proto::NDArrayView::StorageFormat_IsValid(src.storage_format()))
@@ -209,7 +260,11 @@ namespace CNTK
         auto storageFormat = FromProtoType(src.storage_format());
         NDArrayView* dst = new NDArrayView(dataType, storageFormat, *shape, DeviceDescriptor::CPUDevice());
 
-        if (dataType == DataType::Float)
+        if (blobs && IsBlob(src))
+        {
+            blobs->destinations[&src] = dst;
+        }
+        else if (dataType == DataType::Float)
         {
             CopyData<float>(src.float_values().value(), dst);
         }
@@ -220,60 +275,60 @@ namespace CNTK
         return dst;
     }
 
-    /*static*/ proto::Vector* Serializer::CreateProto(const std::vector<DictionaryValue>& src, Arena* arena)
+    /*static*/ proto::Vector* Serializer::CreateProto(const std::vector<DictionaryValue>& src, Arena* arena, TensorBlobs* blobs)
     {
         proto::Vector* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::Vector>(arena) : new proto::Vector();
         dst->mutable_value()->Reserve((int)src.size());
         for (const auto& value : src)
         {
-            dst->mutable_value()->AddAllocated(CreateProto(value, arena));
+            dst->mutable_value()->AddAllocated(CreateProto(value, arena, blobs));
         }
         return dst;
     }
 
-    /*static*/ std::vector<DictionaryValue>* Serializer::CreateFromProto(const proto::Vector& src)
+    /*static*/ std::vector<DictionaryValue>* Serializer::CreateFromProto(const proto::Vector& src, TensorBlobs* blobs)
     {
         std::vector<DictionaryValue>* dst = new std::vector<DictionaryValue>(src.value_size());
         for (auto i = 0; i < src.value_size(); ++i)
         {
-            Copy(src.value()[i], dst->at(i));
+            Copy(src.value()[i], dst->at(i), blobs);
         }
         return dst;
     }
 
-    /*static*/ proto::Dictionary* Serializer::CreateProto(const Dictionary& src, Arena* arena)
+    /*static*/ proto::Dictionary* Serializer::CreateProto(const Dictionary& src, Arena* arena, TensorBlobs* blobs)
     {
         proto::Dictionary* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::Dictionary>(arena) : new proto::Dictionary();
         dst->set_version(src.s_version);
         for (const auto& kv : src)
         {
-            Copy(kv.second, dst->mutable_data()->operator[](ToString(kv.first)), arena);
+            Copy(kv.second, dst->mutable_data()->operator[](ToString(kv.first)), arena, blobs);
         }
         return dst;
     }
 
-    /*static*/ Dictionary* Serializer::CreateFromProto(const proto::Dictionary& src)
+    /*static*/ Dictionary* Serializer::CreateFromProto(const proto::Dictionary& src, TensorBlobs* blobs)
     {
         Dictionary* dst = new Dictionary();
         for (const auto& kv : src.data())
         {
-            Copy(kv.second, dst->operator[](ToWString(kv.first)));
+            Copy(kv.second, dst->operator[](ToWString(kv.first)), blobs);
         }
         return dst;
     }
 
-    /*static*/ proto::DictionaryValue* Serializer::CreateProto(const DictionaryValue& src, Arena* arena)
+    /*static*/ proto::DictionaryValue* Serializer::CreateProto(const DictionaryValue& src, Arena* arena, TensorBlobs* blobs)
     {
         proto::DictionaryValue* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::DictionaryValue>(arena) : new proto::DictionaryValue();
         dst->set_version(src.s_version);
-        Copy(src, *dst, arena);
+        Copy(src, *dst, arena, blobs);
         return dst;
     }
 
-    /*static*/ void Serializer::Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena)
+    /*static*/ void Serializer::Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena, TensorBlobs* blobs)
     {
         auto valueType = src.ValueType();
         dst.set_value_type(ToProtoType(valueType));
@@ -307,20 +362,20 @@ namespace CNTK
             dst.set_allocated_axis_value(CreateProto(src.Value<Axis>(), arena));
             break;
         case DictionaryValue::Type::Vector:
-            dst.set_allocated_vector_value(CreateProto(src.Value<std::vector<DictionaryValue>>(), arena));
+            dst.set_allocated_vector_value(CreateProto(src.Value<std::vector<DictionaryValue>>(), arena, blobs));
             break;
         case DictionaryValue::Type::Dictionary:
-            dst.set_allocated_dictionary_value(CreateProto(src.Value<Dictionary>(), arena));
+            dst.set_allocated_dictionary_value(CreateProto(src.Value<Dictionary>(), arena, blobs));
             break;
         case DictionaryValue::Type::NDArrayView:
-            dst.set_allocated_nd_array_view_value(CreateProto(src.Value<NDArrayView>(), arena));
+            dst.set_allocated_nd_array_view_value(CreateProto(src.Value<NDArrayView>(), arena, blobs));
             break;
         default:
             NOT_IMPLEMENTED
         }
     }
 
-    /*static*/ void Serializer::Copy(const proto::DictionaryValue& src, DictionaryValue& dst)
+    /*static*/ void Serializer::Copy(const proto::DictionaryValue& src, DictionaryValue& dst, TensorBlobs* blobs)
     {
         auto valueType = src.value_type();
 
@@ -359,13 +414,13 @@ namespace CNTK
             dst.m_data.m_ptr = CreateFromProto(src.axis_value());
             break;
         case proto::DictionaryValue::Vector:
-            dst.m_data.m_ptr = CreateFromProto(src.vector_value());
+            dst.m_data.m_ptr = CreateFromProto(src.vector_value(), blobs);
             break;
         case proto::DictionaryValue::Dictionary:
-            dst.m_data.m_ptr = CreateFromProto(src.dictionary_value());
+            dst.m_data.m_ptr = CreateFromProto(src.dictionary_value(), blobs);
             break;
         case proto::DictionaryValue::NDArrayView:
-            dst.m_data.m_ptr = CreateFromProto(src.nd_array_view_value());
+            dst.m_data.m_ptr = CreateFromProto(src.nd_array_view_value(), blobs);
             break;
         }
     }
@@ -393,25 +448,6 @@ namespace CNTK
         return msg.ParseFromCodedStream(&input) && input.ConsumedEntireMessage();
     }
 
-    void ReadFromFile(std::wstring filename, Message& msg)
-    {
-        auto fd = GetFileDescriptor(filename, true);
-        {
-            io::FileInputStream raw_input(fd);
-            io::CodedInputStream coded_input(&raw_input);
-            if (!ParseMessage(coded_input, msg)) 
-            {
-                RuntimeError("Failed to parse protobuf %s from file %ls.", 
-                             msg.GetTypeName().c_str(), filename.c_str());
-            }
-        }
-#ifdef _MSC_VER
-        _close(fd);
-#else
-        close(fd);
-#endif
-    }
-
     struct UsingUTF8
     {
         UsingUTF8() { SetUTF8Locale(); }
@@ -431,12 +467,180 @@ namespace CNTK
     }
 
 
+    /*static*/ const char Serializer::s_blobFormatMagic[8] = { 'C', 'N', 'T', 'K', 'B', 'L', 'O', 'B' };
+    /*static*/ const uint64_t Serializer::s_blobFormatVersion = 1;
+    /*static*/ const uint64_t Serializer::s_blobAlignment = 4096;
+    /*static*/ const size_t Serializer::s_minBlobBytes = 64 * 1024;
+
+    /*static*/ void Serializer::CollectBlobs(const proto::Dictionary& src, std::vector<const proto::NDArrayView*>& blobs)
+    {
+        // The order of a protobuf map is unspecified, and can differ between writing and reading.
+        std::vector<const std::string*> keys;
+        keys.reserve(src.data_size());
+        for (const auto& kv : src.data())
+        {
+            keys.push_back(&kv.first);
+        }
+        std::sort(keys.begin(), keys.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+        for (auto key : keys)
+        {
+            CollectBlobs(src.data().at(*key), blobs);
+        }
+    }
+
+    /*static*/ void Serializer::CollectBlobs(const proto::Vector& src, std::vector<const proto::NDArrayView*>& blobs)
+    {
+        for (const auto& value : src.value())
+        {
+            CollectBlobs(value, blobs);
+        }
+    }
+
+    /*static*/ void Serializer::CollectBlobs(const proto::DictionaryValue& src, std::vector<const proto::NDArrayView*>& blobs)
+    {
+        switch (src.value_type())
+        {
+        case proto::DictionaryValue::Vector:
+            CollectBlobs(src.vector_value(), blobs);
+            break;
+        case proto::DictionaryValue::Dictionary:
+            CollectBlobs(src.dictionary_value(), blobs);
+            break;
+        case proto::DictionaryValue::NDArrayView:
+            if (IsBlob(src.nd_array_view_value()))
+                blobs.push_back(&src.nd_array_view_value());
+            break;
+        default:
+            break;
+        }
+    }
+
+    template <typename MessageType>
+    /*static*/ void Serializer::Write(std::ostream& stream, const MessageType& message, const TensorBlobs& blobs)
+    {
+        if (blobs.sources.empty())
+        {
+            message.SerializeToOstream(&stream);
+            return;
+        }
+
+        std::vector<const proto::NDArrayView*> order;
+        CollectBlobs(message, order);
+        if (order.size() != blobs.sources.size())
+            LogicError("Serializer: Found %zu of the %zu blobs in the protobuf %s.", order.size(), blobs.sources.size(), message.GetTypeName().c_str());
+
+        std::string serializedMessage;
+        if (!message.SerializeToString(&serializedMessage))
+            RuntimeError("Failed to serialize protobuf %s.", message.GetTypeName().c_str());
+
+        std::vector<uint64_t> header = { s_blobFormatVersion, serializedMessage.size(), order.size() };
+        uint64_t endOfMessage = sizeof(s_blobFormatMagic) + (header.size() + 2 * order.size()) * sizeof(uint64_t) + serializedMessage.size();
+        uint64_t offset = endOfMessage;
+        for (auto blob : order)
+        {
+            auto src = blobs.sources.at(blob);
+            uint64_t size = src->Shape().TotalSize() * DataTypeSize(src->GetDataType());
+            offset = ((offset + s_blobAlignment - 1) / s_blobAlignment) * s_blobAlignment;
+            header.push_back(offset);
+            header.push_back(size);
+            offset += size;
+        }
+
+        stream.write(s_blobFormatMagic, sizeof(s_blobFormatMagic));
+        stream.write(reinterpret_cast<const char*>(header.data()), (std::streamsize)(header.size() * sizeof(uint64_t)));
+        stream.write(serializedMessage.data(), (std::streamsize)serializedMessage.size());
+
+        // The blobs are written straight from the NDArrayViews.
+        const std::vector<char> padding(s_blobAlignment, 0);
+        uint64_t position = endOfMessage;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            auto src = blobs.sources.at(order[i]);
+            auto blobOffset = header[3 + 2 * i];
+            auto blobSize = header[4 + 2 * i];
+            const char* data = (src->GetDataType() == DataType::Float) ? reinterpret_cast<const char*>(src->DataBuffer<float>()) : reinterpret_cast<const char*>(src->DataBuffer<double>());
+            stream.write(padding.data(), (std::streamsize)(blobOffset - position));
+            stream.write(data, (std::streamsize)blobSize);
+            position = blobOffset + blobSize;
+        }
+    }
+
+    /*static*/ bool Serializer::ReadMessage(std::istream& stream, Message& message, TensorBlobs& blobs)
+    {
+        // A message without blobs starts with the tag of one of its fields, which is never the first byte of the magic.
+        if (stream.peek() != s_blobFormatMagic[0])
+        {
+            stream >> message;
+            return false;
+        }
+
+        char magic[sizeof(s_blobFormatMagic)];
+        uint64_t header[3];
+        stream.read(magic, sizeof(magic));
+        stream.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!stream || !std::equal(magic, magic + sizeof(magic), s_blobFormatMagic))
+            RuntimeError("Failed to read the header of protobuf %s from the input stream.", message.GetTypeName().c_str());
+
+        if (header[0] > s_blobFormatVersion)
+            RuntimeError("The protobuf %s in the input stream has blob format version %d, but only versions up to %d are supported.",
+                         message.GetTypeName().c_str(), (int)header[0], (int)s_blobFormatVersion);
+
+        auto messageSize = header[1];
+        auto numBlobs = header[2];
+        if (messageSize > INT_MAX)
+            RuntimeError("The protobuf %s in the input stream is too big.", message.GetTypeName().c_str());
+
+        blobs.offsetsAndSizes.resize(2 * numBlobs);
+        stream.read(reinterpret_cast<char*>(blobs.offsetsAndSizes.data()), (std::streamsize)(blobs.offsetsAndSizes.size() * sizeof(uint64_t)));
+        std::string serializedMessage((size_t)messageSize, '\0');
+        stream.read(&serializedMessage[0], (std::streamsize)messageSize);
+        if (!stream)
+            RuntimeError("Failed to read protobuf %s from the input stream.", message.GetTypeName().c_str());
+
+        io::ArrayInputStream arrayInput(serializedMessage.data(), (int)messageSize);
+        io::CodedInputStream input(&arrayInput);
+        if (!ParseMessage(input, message))
+            RuntimeError("Failed to parse protobuf %s from the input stream.", message.GetTypeName().c_str());
+
+        blobs.endOfMessage = sizeof(magic) + sizeof(header) + blobs.offsetsAndSizes.size() * sizeof(uint64_t) + messageSize;
+        return true;
+    }
+
+    template <typename MessageType>
+    /*static*/ void Serializer::ReadBlobs(std::istream& stream, const MessageType& message, TensorBlobs& blobs)
+    {
+        std::vector<const proto::NDArrayView*> order;
+        CollectBlobs(message, order);
+        if (2 * order.size() != blobs.offsetsAndSizes.size())
+            RuntimeError("The input stream has %zu blobs, but the protobuf %s refers to %zu.", blobs.offsetsAndSizes.size() / 2, message.GetTypeName().c_str(), order.size());
+
+        // The blobs are read in order, so that streams need not be seekable, and straight into the NDArrayViews.
+        uint64_t position = blobs.endOfMessage;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            auto dst = blobs.destinations.at(order[i]);
+            auto blobOffset = blobs.offsetsAndSizes[2 * i];
+            auto blobSize = blobs.offsetsAndSizes[2 * i + 1];
+            if ((blobOffset < position) || (blobSize != dst->Shape().TotalSize() * DataTypeSize(dst->GetDataType())))
+                RuntimeError("Blob %zu in the input stream does not match the NDArrayView (shape = '%S') that refers to it.", i, dst->Shape().AsString().c_str());
+
+            char* data = (dst->GetDataType() == DataType::Float) ? reinterpret_cast<char*>(dst->WritableDataBuffer<float>()) : reinterpret_cast<char*>(dst->WritableDataBuffer<double>());
+            stream.ignore((std::streamsize)(blobOffset - position));
+            stream.read(data, (std::streamsize)blobSize);
+            if (!stream)
+                RuntimeError("Failed to read blob %zu from the input stream.", i);
+
+            position = blobOffset + blobSize;
+        }
+    }
+
     std::ostream& operator<<(std::ostream& stream, const Dictionary& dictionary)
     {
         UsingUTF8 locale;
         Arena arena;
-        proto::Dictionary* proto(Serializer::CreateProto(dictionary, &arena));
-        proto->SerializeToOstream(&stream);
+        Serializer::TensorBlobs blobs;
+        proto::Dictionary* proto(Serializer::CreateProto(dictionary, &arena, &blobs));
+        Serializer::Write(stream, *proto, blobs);
         return stream;
     }
 
@@ -444,12 +648,15 @@ namespace CNTK
     {
         UsingUTF8 locale;
         proto::Dictionary proto;
-        stream >> proto;
+        Serializer::TensorBlobs blobs;
+        bool hasBlobs = Serializer::ReadMessage(stream, proto, blobs);
         dictionary.m_dictionaryData->reserve(proto.data_size());
         for (const auto& kv : proto.data())
         {
-            Serializer::Copy(kv.second, dictionary[ToWString(kv.first)]);
+            Serializer::Copy(kv.second, dictionary[ToWString(kv.first)], hasBlobs ? &blobs : nullptr);
         }
+        if (hasBlobs)
+            Serializer::ReadBlobs(stream, proto, blobs);
         return stream;
     }
 
@@ -457,8 +664,9 @@ namespace CNTK
     {
         UsingUTF8 locale;
         Arena arena;
-        proto::DictionaryValue* proto(Serializer::CreateProto(value, &arena));
-        proto->SerializeToOstream(&stream);
+        Serializer::TensorBlobs blobs;
+        proto::DictionaryValue* proto(Serializer::CreateProto(value, &arena, &blobs));
+        Serializer::Write(stream, *proto, blobs);
         return stream;
     }
 
@@ -466,66 +674,42 @@ namespace CNTK
     {
         UsingUTF8 locale;
         proto::DictionaryValue proto;
-        stream >> proto;
-        Serializer::Copy(proto, value);
+        Serializer::TensorBlobs blobs;
+        bool hasBlobs = Serializer::ReadMessage(stream, proto, blobs);
+        Serializer::Copy(proto, value, hasBlobs ? &blobs : nullptr);
+        if (hasBlobs)
+            Serializer::ReadBlobs(stream, proto, blobs);
         return stream;
     }
 
+    // Files are written and read through the stream operators, which stream the blobs of large NDArrayViews.
     void Dictionary::Save(const std::wstring& filename)
     {
-        UsingUTF8 locale;
-        auto fd = GetFileDescriptor(filename, false);
-        Arena arena;
-        proto::Dictionary* proto(Serializer::CreateProto(*this, &arena));
-        proto->SerializeToFileDescriptor(fd);
-#ifdef _MSC_VER
-        _close(fd);
-#else
-        close(fd);
-#endif
+        auto stream = GetFstream(filename, false);
+        *stream << *this;
+        stream->flush();
     }
 
     /*static*/ Dictionary Dictionary::Load(const std::wstring& filename)
     {
-        UsingUTF8 locale;
-        Arena arena;
-        proto::Dictionary* proto = Arena::CreateMessage<proto::Dictionary>(&arena);
-        ReadFromFile(filename, *proto);
-
+        auto stream = GetFstream(filename, true);
         Dictionary dictionary;
-        dictionary.m_dictionaryData->reserve(proto->data_size());
-        for (const auto& kv : proto->data())
-        {
-            Serializer::Copy(kv.second, dictionary[ToWString(kv.first)]);
-        }
-
+        *stream >> dictionary;
         return dictionary;
     }
 
     void DictionaryValue::Save(const std::wstring& filename)
     {
-        UsingUTF8 locale;
-        auto fd = GetFileDescriptor(filename, false);
-        Arena arena;
-        proto::DictionaryValue* proto(Serializer::CreateProto(*this, &arena));
-        proto->SerializeToFileDescriptor(fd);
-#ifdef _MSC_VER
-        _close(fd);
-#else
-        close(fd);
-#endif
+        auto stream = GetFstream(filename, false);
+        *stream << *this;
+        stream->flush();
     }
 
     /*static*/ DictionaryValue DictionaryValue::Load(const std::wstring& filename)
     {
-        UsingUTF8 locale;
-        Arena arena;
-        proto::DictionaryValue* proto = Arena::CreateMessage<proto::DictionaryValue>(&arena);
-        ReadFromFile(filename, *proto);
-       
+        auto stream = GetFstream(filename, true);
         DictionaryValue dictionaryValue;
-        Serializer::Copy(*proto, dictionaryValue);
-
+        *stream >> dictionaryValue;
         return dictionaryValue;
     }
 }
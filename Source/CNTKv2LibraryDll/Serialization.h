@@ -35,6 +35,8 @@ namespace CNTK
     const std::wstring learningRateScheduleKey = L"learnig_rate_schedule";
     const std::wstring smoothedGradientsKey = L"smoothed_gradients";
     const std::wstring noiseInjectionSeedKey = L"noise_injection_seed";
+    const std::wstring lossScaleKey = L"loss_scale";
+    const std::wstring lossScaleGoodMinibatchCountKey = L"loss_scale_good_minibatch_count";
     const std::wstring stateKey = L"state";
     const std::wstring rngSeedKey = L"rng_seed";
     const std::wstring rngOffsetKey = L"rng_offset";
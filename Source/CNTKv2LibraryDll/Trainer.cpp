@@ -8,6 +8,7 @@
 #include "Utils.h"
 #include "Learner.h"
 #include "PerformanceProfiler.h"
+#include "TrainingMetrics.h"
 #include "CompositeFunction.h"
 #include "Serialization.h"
 
@@ -44,7 +45,10 @@ namespace CNTK
           m_distributed(false),
           m_aggregatedTrainingLossValue(std::make_shared<Accumulator>()),
           m_aggregatedTrainingEvalCriterionValue(),
-          m_prevDistributedTotalNumSamples(0)
+          m_prevDistributedTotalNumSamples(0),
+          m_gradientAccumulationSteps(1),
+          m_numAccumulatedMinibatches(0),
+          m_numAccumulatedSamples(0)
     {
         std::vector<Variable> combinedFunctionArgs;
         if (m_model) // model is optional, since it may not be adding any information on top of lossFunction
@@ -167,15 +171,34 @@ namespace CNTK
             return false;
         }
 
+        // With gradient accumulation, backprop adds the parameter gradients of the calls since the last update up in place.
         std::unordered_map<Variable, ValuePtr> parameterGradients;
-        ExecuteForwardBackward(arguments, outputsToFetch, computeDevice, parameterGradients);
+        ExecuteForwardBackward(arguments, outputsToFetch, computeDevice, parameterGradients, /*keepParameterGradients=*/m_numAccumulatedMinibatches > 0);
+        Microsoft::MSR::CNTK::TrainingMetricsAddSamples(m_prevMinibatchNumSamples, AsCNTKImplDeviceId(computeDevice));
+        m_numAccumulatedSamples += m_prevMinibatchNumSamples;
+        if (++m_numAccumulatedMinibatches < m_gradientAccumulationSteps && !sweepEnd)
+            return true;
 
         auto profWeights = Microsoft::MSR::CNTK::ScopeProfile(Microsoft::MSR::CNTK::profilerEvtMainWeights);
 
         std::unordered_map<Parameter, NDArrayViewPtr> gradients;
         for (const auto& parameter : m_learnerParameters)
             gradients[parameter] = parameterGradients[parameter]->Data();
-        return m_parameterLearners->Update(gradients, m_prevMinibatchNumSamples, sweepEnd);
+        size_t numSamples = m_numAccumulatedSamples;
+        m_numAccumulatedMinibatches = 0;
+        m_numAccumulatedSamples = 0;
+        return m_parameterLearners->Update(gradients, numSamples, sweepEnd);
+    }
+
+    void Trainer::SetGradientAccumulationSteps(size_t numSteps)
+    {
+        if (numSteps == 0)
+            InvalidArgument("Trainer::SetGradientAccumulationSteps: The number of steps must be at least 1.");
+
+        if (m_distributed && numSteps > 1)
+            InvalidArgument("Trainer::SetGradientAccumulationSteps: Gradient accumulation is not supported with distributed learners.");
+
+        m_gradientAccumulationSteps = numSteps;
     }
 
     bool Trainer::TrainDistributedMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, bool sweepEnd, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::UseDefaultDevice()*/)
@@ -205,6 +228,7 @@ namespace CNTK
         }
 
         auto currentWorkerNumSamples = m_prevMinibatchNumSamples;
+        Microsoft::MSR::CNTK::TrainingMetricsAddSamples(currentWorkerNumSamples, AsCNTKImplDeviceId(computeDevice));
         auto prevTotalNumSamples = TotalNumberOfSamplesSeen();
 
         MinibatchInfo info{ arguments.empty(), sweepEnd, m_prevMinibatchNumSamples, trainingLoss, evalCriterion };
@@ -278,7 +302,7 @@ namespace CNTK
         m_progressWriters.insert(progressWriters.begin(), progressWriters.end());
     }
 
-    void Trainer::ExecuteForwardBackward(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice, std::unordered_map<Variable, ValuePtr>& parameterGradients)
+    void Trainer::ExecuteForwardBackward(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice, std::unordered_map<Variable, ValuePtr>& parameterGradients, bool keepParameterGradients)
     {
         auto profForwardBackward = Microsoft::MSR::CNTK::ScopeProfile(Microsoft::MSR::CNTK::profilerEvtMainFB);
         std::unordered_map<Variable, ValuePtr> outputs = { { m_aggregatedLossFunction, nullptr }, { m_trainingSampleCountVar, nullptr } };
@@ -307,14 +331,22 @@ namespace CNTK
             m_rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(m_aggregatedLossFunction->Output().GetDataType(), m_prevMinibatchAggregateTrainingLossValue->Shape(), computeDevice), outputs.at(m_aggregatedLossFunction)->Mask());
         }
 
+        // the learners divide the loss scale out of the parameter gradients again
+        double lossScale = m_parameterLearners->LossScale();
         if (m_aggregatedLossFunction->Output().GetDataType() == DataType::Float)
-            m_rootGradientValue->Data()->SetValue(1.0f);
+            m_rootGradientValue->Data()->SetValue((float)lossScale);
         else
-            m_rootGradientValue->Data()->SetValue(1.0);
+            m_rootGradientValue->Data()->SetValue(lossScale);
 
         for (const auto& parameter : m_learnerParameters)
             parameterGradients[parameter] = nullptr;
 
+        auto compositeFunction = std::dynamic_pointer_cast<CompositeFunction>(m_combinedTrainingFunction);
+        if (compositeFunction)
+            compositeFunction->KeepParameterGradients(keepParameterGradients);
+        else if (keepParameterGradients)
+            RuntimeError("Combined training function is not a CompositeFunction.");
+
         // TODO: Why Backward signature does not take Parameter instead of Variable for gradients?
         m_combinedTrainingFunction->Backward(backPropSate, { { m_aggregatedLossFunction, m_rootGradientValue } }, parameterGradients);
         m_prevMinibatchNumSamples = GetSampleCount(m_trainingSampleCountVar, outputs[m_trainingSampleCountVar]);
@@ -327,11 +359,31 @@ namespace CNTK
     }
 
     void Trainer::SaveCheckpoint(const std::wstring& modelFilePath, Dictionary externalState)
+    {
+        SaveCheckpointImpl(modelFilePath, externalState, /*inBackground=*/false);
+    }
+
+    void Trainer::SaveCheckpointAsync(const std::wstring& modelFilePath, Dictionary externalState)
+    {
+        SaveCheckpointImpl(modelFilePath, externalState, /*inBackground=*/true);
+    }
+
+    void Trainer::WaitForCheckpoint()
+    {
+        if (m_pendingCheckpoint.valid())
+            m_pendingCheckpoint.get(); // (rethrows an error of the background write)
+
+        // the other workers wait for the main one, which writes
+        if (m_distributed)
+            MPICommunicator()->Barrier();
+    }
+
+    void Trainer::SaveCheckpointImpl(const std::wstring& modelFilePath, Dictionary externalState, bool inBackground)
     {
         auto learnersState = m_parameterLearners->CreateCheckpoint();
 
         if (!m_distributed)
-            return Save(modelFilePath, learnersState, externalState);
+            return Save(modelFilePath, learnersState, externalState, {}, inBackground);
 
         auto compositeFunction = dynamic_cast<CompositeFunction*>(m_combinedTrainingFunction.get());
 
@@ -353,38 +405,76 @@ namespace CNTK
         }
 
         if (communicator->CurrentWorker().IsMain())
-            Save(modelFilePath, learnersState, externalState, aggregatedState);
+            Save(modelFilePath, learnersState, externalState, aggregatedState, inBackground);
 
         // all workers need to sync up after saving model to avoid read-after-write hazard
         // i.e. one worker is in the middle of write while another tries to read
         communicator->Barrier();
     }
 
-    void Trainer::Save(const std::wstring& modelFilePath, const std::vector<DictionaryValue>& learnerState, const Dictionary& externalState, const Dictionary& distributedState)
+    // Makes the OS write a file that has been written and closed through to the disk.
+    static void SyncFile(const std::wstring& filePath)
+    {
+        FILE* f = fopenOrDie(filePath, L"r+b");
+        fsyncOrDie(f);
+        fclose(f);
+    }
+
+    // The model and the learner state are serialized into dictionaries first, which copies the values to host memory.
+    // 'inBackground', the files are then written from these on a background thread.
+    void Trainer::Save(const std::wstring& modelFilePath, const std::vector<DictionaryValue>& learnerState, const Dictionary& externalState, const Dictionary& distributedState, bool inBackground)
     {
-        std::wstring tempModelFile = modelFilePath + L".tmp";
+        // the files of a previous save must not be written concurrently
+        if (m_pendingCheckpoint.valid())
+            m_pendingCheckpoint.get();
+
         Dictionary state;
         state[versionPropertyName] = trainerCheckpointVersion;
         state[learnersPropertyName] = learnerState;
         state[externalStatePropertyName] = externalState;
         state[distributedStatePropertyName] = distributedState;
 
-        m_combinedTrainingFunction->Save(tempModelFile);
-        std::wstring trainerStateCheckpointFilePath = GetTrainerStateCheckpointFilePath(modelFilePath);
-        std::wstring tempCheckpointFile = trainerStateCheckpointFilePath + L".tmp";
-
-        state.Save(tempCheckpointFile);
+        Dictionary model = m_combinedTrainingFunction->Serialize();
 
-        // The return value is ignored here.
-        _wunlink(modelFilePath.c_str());
-        _wunlink(trainerStateCheckpointFilePath.c_str());
-
-        renameOrDie(tempModelFile, modelFilePath);
-        renameOrDie(tempCheckpointFile, trainerStateCheckpointFilePath);
+        auto writeFiles = [modelFilePath, model, state, inBackground]() mutable
+        {
+            std::wstring tempModelFile = modelFilePath + L".tmp";
+            {
+                auto stream = GetFstream(tempModelFile, false);
+                *stream << model;
+                stream->flush();
+            }
+            std::wstring trainerStateCheckpointFilePath = GetTrainerStateCheckpointFilePath(modelFilePath);
+            std::wstring tempCheckpointFile = trainerStateCheckpointFilePath + L".tmp";
+
+            state.Save(tempCheckpointFile);
+
+            // a checkpoint written in the background replaces the previous one only once it is on disk
+            if (inBackground)
+            {
+                SyncFile(tempModelFile);
+                SyncFile(tempCheckpointFile);
+            }
+
+            // The return value is ignored here.
+            _wunlink(modelFilePath.c_str());
+            _wunlink(trainerStateCheckpointFilePath.c_str());
+
+            renameOrDie(tempModelFile, modelFilePath);
+            renameOrDie(tempCheckpointFile, trainerStateCheckpointFilePath);
+        };
+
+        if (inBackground)
+            m_pendingCheckpoint = std::async(std::launch::async, writeFiles);
+        else
+            writeFiles();
     }
 
     Dictionary Trainer::RestoreFromCheckpoint(const std::wstring& modelFilePath)
     {
+        // the files may be those of a checkpoint that is still being written
+        WaitForCheckpoint();
+
         // Restore the model's parameters
         m_combinedTrainingFunction->Restore(modelFilePath);
 
@@ -400,6 +490,10 @@ namespace CNTK
 
         m_parameterLearners->RestoreFromCheckpoint(learnerState);
 
+        // the gradients accumulated so far belong to the parameter values before the restore
+        m_numAccumulatedMinibatches = 0;
+        m_numAccumulatedSamples = 0;
+
         if (!m_distributed)
         {
             return externalState;
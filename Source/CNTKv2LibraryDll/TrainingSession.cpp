@@ -7,6 +7,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 
 #include "CNTKLibrary.h"
+#include "Utils.h"
 #include "fileutil.h"
 #include "PerformanceProfiler.h"
 
@@ -26,11 +27,13 @@ namespace CNTK
         const std::wstring& checkPointFileName,
         size_t checkpointFrequencyInSamples,
         bool restoreFromCheckpointIfExists,
-        bool preserveAllCheckpoints) :
+        bool preserveAllCheckpoints,
+        bool asyncCheckpointing) :
         m_preserveAll(preserveAllCheckpoints),
         m_restore(restoreFromCheckpointIfExists),
         m_fileName(checkPointFileName),
-        m_frequency(checkpointFrequencyInSamples)
+        m_frequency(checkpointFrequencyInSamples),
+        m_async(asyncCheckpointing)
     {
         if (m_fileName.empty())
         {
@@ -47,10 +50,14 @@ namespace CNTK
     CrossValidationConfig::CrossValidationConfig(
         const MinibatchSourcePtr& crossValidationSource,
         const MinibatchSizeSchedule& crossValidationSchedule,
-        size_t crossValidationFrequencyInSamples):
+        size_t crossValidationFrequencyInSamples,
+        bool runInBackground,
+        const DeviceDescriptor& backgroundDevice):
         m_source(crossValidationSource),
         m_mbSize(crossValidationSchedule),
-        m_frequency(crossValidationFrequencyInSamples)
+        m_frequency(crossValidationFrequencyInSamples),
+        m_background(runInBackground),
+        m_backgroundDevice(backgroundDevice)
     {
     }
 
@@ -132,6 +139,10 @@ namespace CNTK
             }
         }
 
+        // The workers would each validate on all of the data, and the results could not be aggregated without them waiting for each other.
+        if (m_cv.m_source && m_cv.m_background && m_numberOfWorkers != 1)
+            InvalidArgument("Cross validation in the background is not supported in distributed training.");
+
         // Fill-in required actions.
         if (m_checkpoint.m_frequency != 0)
             m_actions.push_back({ m_checkpoint.m_frequency, 0, 0,
@@ -203,6 +214,9 @@ namespace CNTK
                     action.sampleCountWhenLastCalled = totalNumberOfSamples;
                 }
             }
+
+            // Deliver the result of a cross validation in the background once it is there.
+            earlyExit |= !FinishBackgroundCrossValidation(/*wait=*/false);
         }
 
         if (restoredNumberOfSamples != Trainer()->TotalNumberOfSamplesSeen())
@@ -216,6 +230,12 @@ namespace CNTK
             }
         }
 
+        FinishBackgroundCrossValidation(/*wait=*/true);
+
+        // The checkpoint files must be complete before they are checked below, and when training returns.
+        if (m_checkpoint.m_async)
+            Trainer()->WaitForCheckpoint();
+
         // In case of incremental - save final checkpoint.
         // This is required only when we keep all existing checkpoints, otherwise 
         // The checkpoint was already saved with the proper name.
@@ -231,7 +251,9 @@ namespace CNTK
     // TODO: Possibly expose a limiting counter on the number of samples for validation.
     bool TrainingSession::CrossValidate(size_t currentIndex, const DeviceDescriptor& computeDevice)
     {
-        if (m_cv.m_source) // Running cross validation
+        if (m_cv.m_source && m_cv.m_background)
+            return StartBackgroundCrossValidation(currentIndex);
+        else if (m_cv.m_source) // Running cross validation
         {
             std::unordered_map<Variable, ValuePtr> minibatch;
             double accumulatedError = 0;
@@ -266,6 +288,68 @@ namespace CNTK
         }
     }
 
+    // Cross validation of a snapshot of the evaluation function, on a background thread. Only one runs at a time, as they share
+    // the cross validation source. The result is delivered on the training thread by FinishBackgroundCrossValidation().
+    bool TrainingSession::StartBackgroundCrossValidation(size_t currentIndex)
+    {
+        bool shouldContinue = FinishBackgroundCrossValidation(/*wait=*/true);
+
+        auto evaluationFunction = Trainer()->EvaluationFunction();
+        if (!evaluationFunction)
+            InvalidArgument("Cross validation in the background requires the trainer to have an evaluation function.");
+
+        // The parameters are copied here, on the device they are trained on, and then frozen into constants, which the network
+        // of the snapshot copies to the cross validation device. The arguments are kept, so that the minibatches can be fed.
+        std::unordered_map<Variable, Variable> sameArguments;
+        for (const auto& argument : evaluationFunction->Arguments())
+            sameArguments[argument] = argument;
+        auto snapshot = evaluationFunction->Clone(ParameterCloningMethod::Clone, sameArguments)->Clone(ParameterCloningMethod::Freeze, sameArguments);
+        auto evaluator = CreateEvaluator(snapshot);
+
+        const DeviceDescriptor device = m_cv.m_backgroundDevice;
+        m_backgroundCrossValidation = std::async(std::launch::async, [this, currentIndex, evaluator, device]()
+        {
+            BackgroundCrossValidationResult result{ currentIndex, evaluator, 0, 0, 0 };
+            std::unordered_map<Variable, ValuePtr> minibatch;
+            std::pair<ValuePtr, size_t> errorAndCount;
+            auto checkpoint = m_cv.m_source->GetCheckpointState();
+            for (;;)
+            {
+                GetNextMinibatch(m_cv.m_source, minibatch, m_cv.m_mbSize[result.numberOfSamples], 0, 1, device);
+                if (!evaluator->TestMinibatch(minibatch, errorAndCount, device, /*distributed=*/false))
+                    break;
+                result.accumulatedError += errorAndCount.first->AsScalar<double>();
+                result.numberOfSamples += errorAndCount.second;
+                result.numberOfMinibatches++;
+            }
+            m_cv.m_source->RestoreFromCheckpoint(checkpoint);
+            return result;
+        });
+        return shouldContinue;
+    }
+
+    // Delivers the result of the cross validation in the background, if it is done or 'wait'. The progress writers are not
+    // thread-safe, so they only get to see it here.
+    bool TrainingSession::FinishBackgroundCrossValidation(bool wait)
+    {
+        if (!m_backgroundCrossValidation.valid())
+            return true;
+        if (!wait && m_backgroundCrossValidation.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return true;
+
+        auto result = m_backgroundCrossValidation.get(); // (rethrows an error of the background thread)
+        if (result.numberOfSamples > 0)
+        {
+            for (const auto& progressWriter : Trainer()->ProgressWriters())
+            {
+                progressWriter->UpdateTest(result.numberOfSamples, result.evaluator->m_aggregatedTestEvalCriterionValue);
+                progressWriter->WriteTestSummary(result.evaluator->m_aggregatedTestEvalCriterionValue);
+            }
+        }
+        double averageError = result.numberOfSamples > 0 ? result.accumulatedError / result.numberOfSamples : 0;
+        return OnCrossValidationEnd(result.index, averageError, result.numberOfSamples, result.numberOfMinibatches);
+    }
+
     void TrainingSession::Test(const DeviceDescriptor& computeDevice)
     {
         if (!m_test.m_source)
@@ -342,7 +426,10 @@ namespace CNTK
         wstring checkpointFile = m_checkpoint.m_fileName;
         if (m_checkpoint.m_preserveAll)
             checkpointFile += std::to_wstring(currentIndex);
-        Trainer()->SaveCheckpoint(checkpointFile, externalState);
+        if (m_checkpoint.m_async)
+            Trainer()->SaveCheckpointAsync(checkpointFile, externalState);
+        else
+            Trainer()->SaveCheckpoint(checkpointFile, externalState);
         OnCheckpointEnd(currentIndex);
     }
 
@@ -952,6 +952,16 @@ namespace CNTK
 
         if (m_isDistributed)
             CheckDistributedLearners();
+
+        // the root gradient is seeded once, with a single loss scale, and a dynamic loss scale evolves per learner
+        if (m_learners.size() > 1)
+        {
+            for (const auto& learner : m_learners)
+            {
+                if (learner->LossScale() != 1)
+                    InvalidArgument("Loss scaling is only supported for a Trainer with a single learner.");
+            }
+        }
     }
 
     void Learners::CheckDistributedLearners()
@@ -664,6 +664,12 @@ namespace CNTK
             return m_isDistributed;
         }
 
+        // The factor the Trainer scales the gradient of the loss with (see AdditionalLearningOptions::lossScale).
+        double LossScale() const
+        {
+            return m_learners.front()->LossScale();
+        }
+
     private:
         void GetLearnerGradients(LearnerPtr learner, const std::unordered_map<Parameter, NDArrayViewPtr>& allGradients, std::unordered_map<Parameter, NDArrayViewPtr>& learnerGradients);
         void CheckDistributedLearners();
@@ -690,6 +696,13 @@ namespace CNTK
         }
         static void VerifyVariableValueCompatibility(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape = nullptr);
 
+        // Clones a Parameter or Constant that shares the value of 'var' until either of them is written (ParameterCloningMethod::CopyOnWrite)
+        static Variable CloneSharingValue(const Variable& var);
+
+        // Gives 'var' a copy of its own of a value it shares with copy-on-write clones; to be called before the value is written.
+        // This bumps the Parameter's value time stamp, so that a network compiled over the shared value binds the new one.
+        static void UnshareValue(const Variable& var);
+
         template <typename ElementType>
         static std::pair<std::shared_ptr<const Microsoft::MSR::CNTK::Matrix<ElementType>>, Microsoft::MSR::CNTK::MBLayoutPtr>
         GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape,
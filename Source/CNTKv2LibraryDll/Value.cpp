@@ -331,6 +331,38 @@ namespace CNTK
         return Create(sampleShape, sequencesView, {}, device, readOnly, /*createNewCopy =*/ true);
     }
 
+    /*static*/ ValuePtr Value::CreateBatch(const NDShape& sampleShape, const NDArrayViewPtr& batchData, const DeviceDescriptor& device, bool readOnly /*= false */)
+    {
+        if (batchData->IsSparse())
+            InvalidArgument("Value::CreateBatch: The batch data must be dense; use Value::Create for sparse data.");
+
+        auto batchDataShape = batchData->Shape();
+        if ((batchDataShape.Rank() < sampleShape.Rank()) || (batchDataShape.Rank() > (sampleShape.Rank() + 1)))
+            InvalidArgument("Value::CreateBatch: The shape '%S' of the batch data is not compatible with the sample shape '%S'.", batchDataShape.AsString().c_str(), sampleShape.AsString().c_str());
+
+        NDShape fullyDefinedSampleShape = sampleShape;
+        for (size_t k = 0; k < sampleShape.Rank(); ++k)
+        {
+            if (sampleShape[k] == NDShape::FreeDimension)
+                fullyDefinedSampleShape[k] = batchDataShape[k];
+            else if (sampleShape[k] != batchDataShape[k])
+                InvalidArgument("Value::CreateBatch: The shape '%S' of the batch data is not compatible with the sample shape '%S'.", batchDataShape.AsString().c_str(), sampleShape.AsString().c_str());
+        }
+
+        auto numSamples = batchDataShape.SubShape(sampleShape.Rank()).TotalSize();
+        if (numSamples == 0)
+            InvalidArgument("Value::CreateBatch: The number of samples must be > 0");
+
+        // each sample is a sequence of length 1, so no mask is needed
+        NDArrayViewPtr valueData = batchData->AsShape(fullyDefinedSampleShape.AppendShape({ 1, numSamples }));
+        if (valueData->Device() != device)
+            valueData = valueData->DeepClone(device, readOnly);
+        else if (readOnly && !valueData->IsReadOnly())
+            valueData = valueData->Alias(readOnly);
+
+        return MakeSharedObject<Value>(valueData);
+    }
+
     template <typename ElementType>
     /*static*/ ValuePtr Value::CreateSequence(const NDShape& sampleShape, const std::vector<ElementType>& sequenceData, bool sequenceStartFlag, const DeviceDescriptor& device, bool readOnly /*= false */)
     {
@@ -626,6 +658,52 @@ namespace CNTK
         }
     }
 
+    void PackedValue::CopyFrom(const Value& source)
+    {
+        auto packedSource = dynamic_cast<const PackedValue*>(&source);
+        if (!packedSource || !packedSource->IsPacked())
+        {
+            Unpack();
+            Value::CopyFrom(source);
+            return;
+        }
+
+        if (IsReadOnly())
+            InvalidArgument("PackedValue::CopyFrom: Cannot copy into a read-only Value object.");
+
+        if (m_isPacked && (m_packedData->Shape() == packedSource->m_packedData->Shape()) && (m_packedData->GetStorageFormat() == packedSource->m_packedData->GetStorageFormat()))
+            m_packedData->CopyFrom(*packedSource->m_packedData);
+        else
+        {
+            auto device = Device();
+            Value::Erase();
+            m_packedData = packedSource->m_packedData->DeepClone(device, m_isReadOnly);
+        }
+
+        // The layout is copied rather than shared, as the layout of the source may be that of a network.
+        if (packedSource->m_packedDataLayout)
+        {
+            m_packedDataLayout = std::make_shared<Microsoft::MSR::CNTK::MBLayout>();
+            m_packedDataLayout->CopyFrom(packedSource->m_packedDataLayout);
+        }
+        else
+            m_packedDataLayout = nullptr;
+
+        m_sampleShape = packedSource->m_sampleShape;
+        m_sampleDynamicAxes = packedSource->m_sampleDynamicAxes;
+        m_unpackedShape = packedSource->m_unpackedShape;
+        m_isPacked = true;
+    }
+
+    void PackedValue::SetValue(double value)
+    {
+        auto data = m_isPacked ? m_packedData : Value::Data();
+        if (data->GetDataType() == DataType::Float)
+            data->SetValue((float)value);
+        else
+            data->SetValue(value);
+    }
+
     template <typename ElementType, typename DestType>
     void DirectCopy(const ElementType *source, const size_t elementCount, std::vector<DestType>& dest)
     {
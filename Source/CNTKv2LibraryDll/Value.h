@@ -90,15 +90,20 @@ namespace CNTK
                 return Value::DeepClone(readOnly);
         }
 
-        ValuePtr Alias(bool /*readOnly = false*/) const override
+        ValuePtr Alias(bool readOnly = false) const override
         {
-            LogicError("Value::Alias is currently unsupported for PackedValue objects.");
+            if (m_isPacked)
+                return MakeSharedObject<PackedValue>(m_sampleShape, m_sampleDynamicAxes, m_packedData->Alias(readOnly), m_packedDataLayout, readOnly);
+            else
+                return Value::Alias(readOnly);
         }
 
-        void CopyFrom(const Value& /*source*/) override
-        {
-            LogicError("Value::CopyFrom is currently unsupported for PackedValue objects");
-        }
+        // A packed source is copied as is, together with its layout, so that outputs chained from one Function into
+        // the next are never unpacked; an unpacked source is copied into the unpacked data.
+        void CopyFrom(const Value& source) override;
+
+        // Sets all elements to 'value' without unpacking; the gaps of the layout are set too, as the nodes ignore them.
+        void SetValue(double value);
 
         template <typename ElementType>
         std::pair<std::shared_ptr<const Microsoft::MSR::CNTK::Matrix<ElementType>>, std::shared_ptr<Microsoft::MSR::CNTK::MBLayout>> PackedData()
@@ -9,6 +9,7 @@
 #include "CompositeFunction.h"
 #include "Serialization.h"
 #include "InputAndParamNodes.h"
+#include "Utils.h"
 
 namespace CNTK
 {
@@ -159,7 +160,14 @@ namespace CNTK
             LogicError("Variable '%S' SetValue(): 'source' shape '%S' differs 'destination' shape '%S'.", AsString().c_str(), value->Shape().AsString().c_str(), Shape().AsString().c_str());
 
         bool alreadySet = false;
-        if (m_dataFields->m_initValueFlag)
+        if (m_dataFields->m_valueIsShared)
+        {
+            // the value is replaced rather than copied into, which would change it for all copy-on-write sharers
+            m_dataFields->m_value = value->DeepClone(m_dataFields->m_value->Device(), false);
+            m_dataFields->m_valueIsShared = false;
+            alreadySet = true;
+        }
+        else if (m_dataFields->m_initValueFlag)
         {
             // In the case of lazy initialization, try to avoid the redundant call to the initializer. 
             std::call_once(*m_dataFields->m_initValueFlag, [=, &value, &alreadySet] {
@@ -222,7 +230,7 @@ namespace CNTK
             return nullptr;
     }
 
-    std::shared_ptr<VariableFields> VariableFields::Clone() const
+    std::shared_ptr<VariableFields> VariableFields::Clone(bool shareValue /*= false*/) const
     {
         if (Owner() != nullptr)
             InvalidArgument("Output variable '%S' cannot be cloned.", AsString().c_str());
@@ -232,7 +240,7 @@ namespace CNTK
             m_varKind,
             m_dataType,
             m_ownerFunction,
-            (m_value) ? m_value->DeepClone() : nullptr,
+            (m_value) ? (shareValue ? m_value : m_value->DeepClone()) : nullptr,
             m_needsGradient,
             m_dynamicAxes,
             m_isSparse,
@@ -242,9 +250,34 @@ namespace CNTK
         if (m_valueInitializer)
             clone->SetValueInitialization(*m_valueInitializer, *m_valueInitializationDevice);
 
+        clone->m_valueIsShared = shareValue && m_value;
         return clone;
     }
 
+    /*static*/ Variable Utils::CloneSharingValue(const Variable& var)
+    {
+        if (!var.IsParameter() && !var.IsConstant())
+            LogicError("Variable '%S': Only Parameters and Constants can share their value with a clone.", var.AsString().c_str());
+
+        var.Value(); // runs a pending lazy initialization, so that there is a value to share
+        Variable clonedVariable;
+        clonedVariable.m_dataFields = var.m_dataFields->Clone(/*shareValue =*/ true);
+        var.m_dataFields->m_valueIsShared = true;
+        return clonedVariable;
+    }
+
+    /*static*/ void Utils::UnshareValue(const Variable& var)
+    {
+        auto& dataFields = *var.m_dataFields;
+        if (!dataFields.m_valueIsShared)
+            return;
+
+        // The last of the sharers copies too; it cannot tell whether the others have already made copies of their own.
+        dataFields.m_value = dataFields.m_value->DeepClone(/*readOnly =*/ false);
+        dataFields.m_valueIsShared = false;
+        dataFields.m_valueTimeStamp++;
+    }
+
     void VariableFields::SetValueInitialization(const ParameterInitializer& initializationConfig, const DeviceDescriptor& device)
     {
         if (m_value != nullptr)
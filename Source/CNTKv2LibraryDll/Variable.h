@@ -30,9 +30,10 @@ namespace CNTK
         std::wstring m_uid;
         std::atomic<size_t> m_valueTimeStamp;
         Variable m_blockFunctionVariableMapping;
+        bool m_valueIsShared; // m_value is shared with copy-on-write clones (ParameterCloningMethod::CopyOnWrite), and must be copied before it is written
 
         VariableFields(const NDShape& shape, VariableKind varType, ::CNTK::DataType type, const std::weak_ptr<Function>& ownerFunction, const NDArrayViewPtr& value, bool needsGradient, const std::vector<Axis>& dynamicAxes, bool isSparse, const std::wstring& name, const std::wstring& uid)
-            : m_shape(shape), m_varKind(varType), m_dataType(type), m_ownerFunction(ownerFunction), m_value(value), m_needsGradient(needsGradient), m_dynamicAxes(dynamicAxes), m_isSparse(isSparse), m_name(name), m_uid(uid), m_valueTimeStamp(0)
+            : m_shape(shape), m_varKind(varType), m_dataType(type), m_ownerFunction(ownerFunction), m_value(value), m_needsGradient(needsGradient), m_dynamicAxes(dynamicAxes), m_isSparse(isSparse), m_name(name), m_uid(uid), m_valueTimeStamp(0), m_valueIsShared(false)
         {
             if (value && (type != value->GetDataType()))
                 InvalidArgument("The DataType of the Parameter/Constant Variable '%S' does not match the DataType of the associated Value", AsString().c_str());
@@ -63,7 +64,7 @@ namespace CNTK
         }
 
         std::wstring AsString() const;
-        std::shared_ptr<VariableFields> Clone() const;
+        std::shared_ptr<VariableFields> Clone(bool shareValue = false) const;
         FunctionPtr Owner() const;
 
         CNTK_API void SetValueInitialization(const ParameterInitializer& initializationConfig, const DeviceDescriptor& device);
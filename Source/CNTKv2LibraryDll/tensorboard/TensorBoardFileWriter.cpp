@@ -6,12 +6,21 @@
 #include "stdafx.h"
 #include "CNTKLibraryInternals.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <ctime>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iomanip>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #pragma warning(push)
 #pragma warning(disable : 4244 4245)
@@ -74,12 +83,156 @@ namespace CNTK
             return record;
         }
 
+        template <typename ElementType>
+        static void FillHistogram(const NDArrayView& values, tensorflow::HistogramProto& histogram)
+        {
+            const size_t numBuckets = 30;
+
+            const ElementType* data = values.DataBuffer<ElementType>();
+            size_t size = values.Shape().TotalSize();
+            double min = size ? DBL_MAX : 0, max = size ? -DBL_MAX : 0, sum = 0, sumSquares = 0;
+            for (size_t i = 0; i < size; ++i)
+            {
+                double value = data[i];
+                min = std::min(min, value);
+                max = std::max(max, value);
+                sum += value;
+                sumSquares += value * value;
+            }
+
+            // Buckets of equal width between the smallest and the largest value.
+            std::vector<double> counts(numBuckets, 0);
+            double width = (max - min) / numBuckets;
+            for (size_t i = 0; i < size; ++i)
+            {
+                size_t bucket = width > 0 ? (size_t)((data[i] - min) / width) : 0;
+                counts[std::min(bucket, numBuckets - 1)]++;
+            }
+
+            histogram.set_min(min);
+            histogram.set_max(max);
+            histogram.set_num((double)size);
+            histogram.set_sum(sum);
+            histogram.set_sum_squares(sumSquares);
+            for (size_t i = 0; i < numBuckets; ++i)
+            {
+                histogram.add_bucket_limit(i + 1 < numBuckets ? min + (i + 1) * width : max);
+                histogram.add_bucket(counts[i]);
+            }
+        }
+
+        // Runs the tasks of a TensorBoardFileWriter in order on a thread of its own, and flushes the file at a fixed interval.
+        // A task that throws does not stop the ones after it; the first exception is rethrown to the user of the writer.
+        class TensorBoardFileWriter::BackgroundWriter
+        {
+        public:
+            explicit BackgroundWriter(TensorBoardFileWriter& owner)
+                : m_owner(owner), m_stopping(false), m_thread([this]() { Run(); })
+            {
+            }
+
+            ~BackgroundWriter()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_stopping = true;
+                }
+                m_tasksQueued.notify_one();
+                m_thread.join();
+            }
+
+            void Post(std::function<void()>&& task)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                RethrowPendingException();
+                m_tasks.push_back(std::move(task));
+                m_tasksQueued.notify_one();
+            }
+
+            // Runs the task after all queued ones, and waits for its result.
+            bool Call(std::function<bool()>&& task)
+            {
+                auto packagedTask = std::make_shared<std::packaged_task<bool()>>(std::move(task));
+                auto result = packagedTask->get_future();
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_tasks.push_back([packagedTask]() { (*packagedTask)(); });
+                    m_tasksQueued.notify_one();
+                }
+
+                bool success = result.get();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                RethrowPendingException();
+                return success;
+            }
+
+        private:
+            void RethrowPendingException() // caller holds m_mutex
+            {
+                if (m_exception)
+                {
+                    auto exception = m_exception;
+                    m_exception = nullptr;
+                    std::rethrow_exception(exception);
+                }
+            }
+
+            void Run()
+            {
+                const auto flushInterval = std::chrono::seconds(2);
+                auto nextFlush = std::chrono::steady_clock::now() + flushInterval;
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                for (;;)
+                {
+                    m_tasksQueued.wait_until(lock, nextFlush, [this]() { return m_stopping || !m_tasks.empty(); });
+                    if (!m_tasks.empty())
+                    {
+                        auto task = std::move(m_tasks.front());
+                        m_tasks.pop_front();
+                        lock.unlock();
+                        std::exception_ptr exception;
+                        try
+                        {
+                            task();
+                        }
+                        catch (...)
+                        {
+                            exception = std::current_exception();
+                        }
+                        lock.lock();
+                        if (exception && !m_exception)
+                            m_exception = exception;
+                    }
+                    else if (m_stopping)
+                        return;
+
+                    if (std::chrono::steady_clock::now() >= nextFlush)
+                    {
+                        lock.unlock();
+                        m_owner.FlushFile();
+                        lock.lock();
+                        nextFlush = std::chrono::steady_clock::now() + flushInterval;
+                    }
+                }
+            }
+
+            TensorBoardFileWriter& m_owner;
+            std::mutex m_mutex;                                // guards the members below, except m_thread
+            std::condition_variable m_tasksQueued;
+            std::deque<std::function<void()>> m_tasks;
+            std::exception_ptr m_exception;
+            bool m_stopping;
+            std::thread m_thread;
+        };
+
         TensorBoardFileWriter::TensorBoardFileWriter(const std::wstring& dir, const FunctionPtr& modelToVisualize)
             : m_model(modelToVisualize),
             m_dir(dir),
             m_file(NULL),
             m_fileName()
         {
+            m_backgroundWriter = std::make_unique<BackgroundWriter>(*this);
         }
 
         TensorBoardFileWriter::TensorBoardFileWriter(const std::wstring& dir,
@@ -88,6 +241,21 @@ namespace CNTK
         {
         }
 
+        TensorBoardFileWriter::~TensorBoardFileWriter()
+        {
+            try
+            {
+                Close();
+            }
+            catch (const std::exception& e)
+            {
+                fprintf(stderr, "TensorBoardFileWriter: Error while closing the event file: %s\n", e.what());
+            }
+
+            // Stops the background thread before the members it uses go away.
+            m_backgroundWriter.reset();
+        }
+
         void TensorBoardFileWriter::Init()
         {
             time_t time = std::time(0);
@@ -107,21 +275,54 @@ namespace CNTK
                 WriteModel();
             }
 
-            Flush();
+            FlushFile();
         }
 
         void TensorBoardFileWriter::WriteValue(const std::wstring& name, float value, uint64_t step)
         {
-            tensorflow::Event event;
-            event.set_step(step);
-            event.set_wall_time(static_cast<double>(std::time(0)));
+            auto wallTime = std::time(0);
+            m_backgroundWriter->Post([this, name, value, step, wallTime]()
+            {
+                tensorflow::Event event;
+                event.set_step(step);
+                event.set_wall_time(static_cast<double>(wallTime));
 
-            tensorflow::Summary* summary = event.mutable_summary();
-            tensorflow::Summary::Value* summaryValue = summary->add_value();
-            summaryValue->set_tag(ToString(name));
-            summaryValue->set_simple_value(value);
+                tensorflow::Summary* summary = event.mutable_summary();
+                tensorflow::Summary::Value* summaryValue = summary->add_value();
+                summaryValue->set_tag(ToString(name));
+                summaryValue->set_simple_value(value);
 
-            WriteRecord(Serialize(event));
+                WriteRecord(Serialize(event));
+            });
+        }
+
+        void TensorBoardFileWriter::WriteHistogram(const std::wstring& name, const NDArrayViewPtr& values, uint64_t step)
+        {
+            if (values->IsSparse())
+                InvalidArgument("TensorBoardFileWriter: Histograms of sparse values are not supported ('%S').", name.c_str());
+
+            if (values->GetDataType() != DataType::Float && values->GetDataType() != DataType::Double)
+                InvalidArgument("TensorBoardFileWriter: Histograms of values of DataType '%s' are not supported ('%S').", DataTypeName(values->GetDataType()), name.c_str());
+
+            // The values may change on the device while the histogram is computed, so a copy is taken right away.
+            auto cpuValues = values->DeepClone(DeviceDescriptor::CPUDevice(), /*readOnly=*/true);
+            auto wallTime = std::time(0);
+            m_backgroundWriter->Post([this, name, cpuValues, step, wallTime]()
+            {
+                tensorflow::Event event;
+                event.set_step(step);
+                event.set_wall_time(static_cast<double>(wallTime));
+
+                tensorflow::Summary* summary = event.mutable_summary();
+                tensorflow::Summary::Value* summaryValue = summary->add_value();
+                summaryValue->set_tag(ToString(name));
+                if (cpuValues->GetDataType() == DataType::Float)
+                    FillHistogram<float>(*cpuValues, *summaryValue->mutable_histo());
+                else
+                    FillHistogram<double>(*cpuValues, *summaryValue->mutable_histo());
+
+                WriteRecord(Serialize(event));
+            });
         }
 
         void TensorBoardFileWriter::WriteModel()
@@ -173,7 +374,7 @@ namespace CNTK
                 fprintf(stderr,
                     "TensorBoardFileWriter: Unable to write to the currently open file. "
                     "Subsequent writes will attempt to re-open a new one. (%ls)", m_fileName.c_str());
-                Close();
+                CloseFile();
                 throw;
             }
         }
@@ -189,6 +390,16 @@ namespace CNTK
         }
 
         bool TensorBoardFileWriter::Flush()
+        {
+            return m_backgroundWriter->Call([this]() { return FlushFile(); });
+        }
+
+        bool TensorBoardFileWriter::Close()
+        {
+            return m_backgroundWriter->Call([this]() { return CloseFile(); });
+        }
+
+        bool TensorBoardFileWriter::FlushFile()
         {
             if (m_file == NULL)
             {
@@ -204,14 +415,14 @@ namespace CNTK
             return true;
         }
 
-        bool TensorBoardFileWriter::Close()
+        bool TensorBoardFileWriter::CloseFile()
         {
             if (m_file == NULL)
             {
                 return false;
             }
 
-            bool success = Flush();
+            bool success = FlushFile();
             if (fclose(m_file))
             {
                 fprintf(stderr,
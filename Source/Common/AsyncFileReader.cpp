@@ -0,0 +1,503 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AsyncFileReader.cpp -- reads of ranges of a file that are queued to the OS and complete in the background
+//
+
+#include "AsyncFileReader.h"
+#include "Basics.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAS_IO_URING
+#endif
+#endif
+#endif
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// offsets, sizes and addresses of direct reads are multiples of this, which covers the sector sizes of current devices
+static const size_t s_directIOAlignment = 4096;
+
+#ifdef HAS_IO_URING
+// The submission and completion queues of an io_uring, shared with the kernel. liburing is not required, the few
+// system calls are made directly.
+class IoUring
+{
+public:
+    IoUring() : m_fd(-1) {}
+
+    ~IoUring()
+    {
+        if (m_fd < 0)
+            return;
+        munmap(m_sqes, m_sqesSize);
+        if (m_cqRing != m_sqRing)
+            munmap(m_cqRing, m_cqRingSize);
+        munmap(m_sqRing, m_sqRingSize);
+        close(m_fd);
+    }
+
+    // Returns false if the kernel does not provide io_uring.
+    bool Setup(unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        m_fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+        if (m_fd < 0)
+            return false;
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap)
+            m_sqRingSize = m_cqRingSize = max(m_sqRingSize, m_cqRingSize);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqRing = (char*) mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        m_cqRing = singleMap ? m_sqRing : (char*) mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        m_sqes = (io_uring_sqe*) mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || m_sqes == MAP_FAILED)
+        {
+            if (m_sqes != MAP_FAILED)
+                munmap(m_sqes, m_sqesSize);
+            if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+                munmap(m_cqRing, m_cqRingSize);
+            if (m_sqRing != MAP_FAILED)
+                munmap(m_sqRing, m_sqRingSize);
+            close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+
+        m_sqTail = (unsigned*) (m_sqRing + params.sq_off.tail);
+        m_sqMask = (unsigned*) (m_sqRing + params.sq_off.ring_mask);
+        m_sqArray = (unsigned*) (m_sqRing + params.sq_off.array);
+        m_cqHead = (unsigned*) (m_cqRing + params.cq_off.head);
+        m_cqTail = (unsigned*) (m_cqRing + params.cq_off.tail);
+        m_cqMask = (unsigned*) (m_cqRing + params.cq_off.ring_mask);
+        m_cqes = (io_uring_cqe*) (m_cqRing + params.cq_off.cqes);
+        m_entries = params.sq_entries;
+        return true;
+    }
+
+    unsigned Entries() const { return m_entries; }
+
+    // Submits a readv of one buffer. The caller serializes submissions and keeps at most Entries() in flight, so that
+    // neither queue overflows.
+    int SubmitRead(int fd, const iovec* iov, int64_t offset, uint64_t userData)
+    {
+        const unsigned tail = *m_sqTail;
+        const unsigned index = tail & *m_sqMask;
+        io_uring_sqe* sqe = &m_sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->off = (uint64_t) offset;
+        sqe->addr = (uint64_t) (uintptr_t) iov;
+        sqe->len = 1;
+        sqe->user_data = userData;
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        return Enter(1, 0, 0);
+    }
+
+    // Blocks until at least one completion is posted. May run concurrently with SubmitRead().
+    int WaitForCompletion()
+    {
+        return Enter(0, 1, IORING_ENTER_GETEVENTS);
+    }
+
+    // Calls f(userData, result) for the posted completions. The caller serializes this.
+    template <class F>
+    void ReapCompletions(F&& f)
+    {
+        unsigned head = *m_cqHead;
+        const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+            f(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    int Enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        int rc;
+        do
+            rc = (int) syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete, flags, nullptr, 0);
+        while (rc < 0 && errno == EINTR);
+        return rc;
+    }
+
+    int m_fd;
+    unsigned m_entries;
+    char* m_sqRing;
+    char* m_cqRing;
+    io_uring_sqe* m_sqes;
+    size_t m_sqRingSize, m_cqRingSize, m_sqesSize;
+    unsigned *m_sqTail, *m_sqMask, *m_sqArray;
+    unsigned *m_cqHead, *m_cqTail, *m_cqMask;
+    io_uring_cqe* m_cqes;
+};
+#endif
+
+struct AsyncFileReader::Request::State
+{
+    char* m_buffer;
+    size_t m_capacity;
+    int64_t m_readOffset; // of the read, aligned for direct I/O
+    size_t m_readSize;
+    int64_t m_result;     // bytes read, or -errno
+    bool m_done;
+    mutex m_waitMutex;
+#ifdef _WIN32
+    OVERLAPPED m_overlapped;
+#else
+    iovec m_iov;
+#endif
+};
+
+struct AsyncFileReader::Impl
+{
+    wstring m_fileName;
+    bool m_direct;
+    bool m_async;
+    size_t m_queueDepth;
+#ifdef _WIN32
+    HANDLE m_file;
+#else
+    int m_fd;
+#endif
+#ifdef HAS_IO_URING
+    IoUring m_ring;
+#endif
+
+    mutex m_mutex;
+    condition_variable m_completed;
+    size_t m_numInFlight;
+    bool m_reaping;                           // a thread waits for completions in the kernel
+    vector<pair<size_t, char*>> m_freeBuffers; // [capacity, buffer]
+
+    Impl(const wstring& fileName, bool direct, size_t queueDepth)
+        : m_fileName(fileName), m_direct(direct), m_async(false), m_queueDepth(max<size_t>(1, queueDepth)), m_numInFlight(0), m_reaping(false)
+    {
+#ifdef _WIN32
+        m_file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_FLAG_OVERLAPPED | (direct ? FILE_FLAG_NO_BUFFERING : 0), nullptr);
+        if (m_file == INVALID_HANDLE_VALUE && direct)
+        {
+            m_direct = false;
+            m_file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+        }
+        if (m_file == INVALID_HANDLE_VALUE)
+            RuntimeError("AsyncFileReader: cannot open file '%ls' (error %d).", fileName.c_str(), (int) GetLastError());
+        m_async = true;
+#else
+        const string path = wtocharpath(fileName);
+#ifdef O_DIRECT
+        m_fd = direct ? open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT) : -1;
+#else
+        m_fd = -1;
+#endif
+        if (m_fd < 0)
+        {
+            m_direct = false;
+            m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        if (m_fd < 0)
+            RuntimeError("AsyncFileReader: cannot open file '%ls': %s.", fileName.c_str(), strerror(errno));
+#ifdef HAS_IO_URING
+        m_async = m_ring.Setup((unsigned) min<size_t>(m_queueDepth, 4096));
+        if (m_async)
+            m_queueDepth = min<size_t>(m_queueDepth, m_ring.Entries());
+#endif
+#endif
+    }
+
+    ~Impl()
+    {
+        // the requests hold the implementation, so none is in flight
+        for (const auto& buffer : m_freeBuffers)
+            FreeAligned(buffer.second);
+#ifdef _WIN32
+        CloseHandle(m_file);
+#else
+        close(m_fd);
+#endif
+    }
+
+    static char* AllocateAligned(size_t size)
+    {
+#ifdef _WIN32
+        void* p = _aligned_malloc(size, s_directIOAlignment);
+#else
+        void* p = nullptr;
+        if (posix_memalign(&p, s_directIOAlignment, size) != 0)
+            p = nullptr;
+#endif
+        if (!p)
+            throw bad_alloc();
+        return (char*) p;
+    }
+
+    static void FreeAligned(char* p)
+    {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    // Takes the smallest pooled buffer that is large enough, or allocates one.
+    void TakeBuffer(Request::State& state, size_t size)
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            auto best = m_freeBuffers.end();
+            for (auto it = m_freeBuffers.begin(); it != m_freeBuffers.end(); ++it)
+            {
+                if (it->first >= size && (best == m_freeBuffers.end() || it->first < best->first))
+                    best = it;
+            }
+            if (best != m_freeBuffers.end())
+            {
+                state.m_capacity = best->first;
+                state.m_buffer = best->second;
+                m_freeBuffers.erase(best);
+                return;
+            }
+        }
+        state.m_capacity = size;
+        state.m_buffer = AllocateAligned(size);
+    }
+
+    // Pools the buffer, keeping as many as may be in flight at once.
+    void ReturnBuffer(char* buffer, size_t capacity)
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (m_freeBuffers.size() < m_queueDepth)
+            {
+                m_freeBuffers.push_back(make_pair(capacity, buffer));
+                return;
+            }
+        }
+        FreeAligned(buffer);
+    }
+
+    void Submit(Request::State& state)
+    {
+        state.m_done = false;
+#ifdef _WIN32
+        memset(&state.m_overlapped, 0, sizeof(state.m_overlapped));
+        state.m_overlapped.Offset = (DWORD) state.m_readOffset;
+        state.m_overlapped.OffsetHigh = (DWORD) (state.m_readOffset >> 32);
+        state.m_overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        if (!state.m_overlapped.hEvent)
+            RuntimeError("AsyncFileReader: cannot create an event (error %d).", (int) GetLastError());
+        if (!ReadFile(m_file, state.m_buffer, (DWORD) state.m_readSize, nullptr, &state.m_overlapped))
+        {
+            const DWORD error = GetLastError();
+            if (error == ERROR_HANDLE_EOF)
+            {
+                state.m_result = 0;
+                state.m_done = true;
+            }
+            else if (error != ERROR_IO_PENDING)
+                RuntimeError("AsyncFileReader: error %d reading file '%ls'.", (int) error, m_fileName.c_str());
+        }
+#else
+        state.m_iov.iov_base = state.m_buffer;
+        state.m_iov.iov_len = state.m_readSize;
+#ifdef HAS_IO_URING
+        if (m_async)
+        {
+            unique_lock<mutex> lock(m_mutex);
+            while (m_numInFlight >= m_queueDepth)
+                WaitForCompletions(lock);
+            if (m_ring.SubmitRead(m_fd, &state.m_iov, state.m_readOffset, (uint64_t) (uintptr_t) &state) < 0)
+                RuntimeError("AsyncFileReader: cannot submit a read of file '%ls': %s.", m_fileName.c_str(), strerror(errno));
+            m_numInFlight++;
+            return;
+        }
+#endif
+        state.m_result = 0;
+        state.m_done = true;
+#endif
+    }
+
+#ifdef HAS_IO_URING
+    // Waits for some completion. One thread at a time waits in the kernel; the others wait for it to reap.
+    void WaitForCompletions(unique_lock<mutex>& lock)
+    {
+        if (m_reaping)
+        {
+            m_completed.wait(lock);
+            return;
+        }
+        m_reaping = true;
+        lock.unlock();
+        const int rc = m_ring.WaitForCompletion();
+        const int error = errno;
+        lock.lock();
+        m_reaping = false;
+        m_ring.ReapCompletions([this](uint64_t userData, int result)
+        {
+            auto& state = *(Request::State*) (uintptr_t) userData;
+            state.m_result = result;
+            state.m_done = true;
+            m_numInFlight--;
+        });
+        m_completed.notify_all();
+        if (rc < 0)
+            RuntimeError("AsyncFileReader: cannot wait for the reads of file '%ls': %s.", m_fileName.c_str(), strerror(error));
+    }
+#endif
+
+    void Wait(Request::State& state)
+    {
+#ifdef _WIN32
+        if (!state.m_done)
+        {
+            DWORD bytesRead = 0;
+            if (GetOverlappedResult(m_file, &state.m_overlapped, &bytesRead, TRUE))
+                state.m_result = bytesRead;
+            else if (GetLastError() == ERROR_HANDLE_EOF)
+                state.m_result = bytesRead;
+            else
+                state.m_result = -(int64_t) GetLastError();
+            state.m_done = true;
+        }
+        if (state.m_overlapped.hEvent)
+        {
+            CloseHandle(state.m_overlapped.hEvent);
+            state.m_overlapped.hEvent = nullptr;
+        }
+        if (state.m_result < 0)
+            RuntimeError("AsyncFileReader: error %d reading file '%ls'.", (int) -state.m_result, m_fileName.c_str());
+#else
+#ifdef HAS_IO_URING
+        if (m_async)
+        {
+            unique_lock<mutex> lock(m_mutex);
+            while (!state.m_done)
+                WaitForCompletions(lock);
+        }
+#endif
+        if (state.m_result < 0)
+            RuntimeError("AsyncFileReader: error reading file '%ls': %s.", m_fileName.c_str(), strerror((int) -state.m_result));
+        // the rest of short reads (and all of synchronous ones), until the end of the file
+        while ((size_t) state.m_result < state.m_readSize)
+        {
+            const ssize_t n = pread(m_fd, state.m_buffer + state.m_result, state.m_readSize - state.m_result, state.m_readOffset + state.m_result);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                RuntimeError("AsyncFileReader: error reading file '%ls': %s.", m_fileName.c_str(), strerror(errno));
+            if (n == 0)
+                break;
+            if (m_direct && n % s_directIOAlignment != 0) // the end of the file, after which unaligned reads fail
+            {
+                state.m_result += n;
+                break;
+            }
+            state.m_result += n;
+        }
+#endif
+    }
+};
+
+AsyncFileReader::Request::Request(const shared_ptr<Impl>& impl, int64_t offset, size_t size)
+    : m_impl(impl), m_state(new State()), m_offset(offset), m_size(size)
+{
+    const size_t alignment = impl->m_direct ? s_directIOAlignment : 1;
+    m_state->m_readOffset = offset / (int64_t) alignment * (int64_t) alignment;
+    const size_t end = (size_t) (offset - m_state->m_readOffset) + size;
+    m_state->m_readSize = max<size_t>(alignment, (end + alignment - 1) / alignment * alignment);
+    m_state->m_result = 0;
+    m_state->m_done = true;
+#ifdef _WIN32
+    m_state->m_overlapped.hEvent = nullptr;
+#endif
+    impl->TakeBuffer(*m_state, m_state->m_readSize);
+    try
+    {
+        impl->Submit(*m_state);
+    }
+    catch (...)
+    {
+        impl->ReturnBuffer(m_state->m_buffer, m_state->m_capacity);
+        throw;
+    }
+}
+
+AsyncFileReader::Request::~Request()
+{
+    // the OS must be done with the buffer before it is reused
+    try
+    {
+        Wait();
+    }
+    catch (...)
+    {
+    }
+    m_impl->ReturnBuffer(m_state->m_buffer, m_state->m_capacity);
+}
+
+const char* AsyncFileReader::Request::Wait()
+{
+    lock_guard<mutex> lock(m_state->m_waitMutex);
+    m_impl->Wait(*m_state);
+    const size_t skip = (size_t) (m_offset - m_state->m_readOffset);
+    if ((size_t) m_state->m_result < skip + m_size)
+        RuntimeError("AsyncFileReader: unexpected end of file '%ls' reading %d bytes at position %lld.",
+                     m_impl->m_fileName.c_str(), (int) m_size, (long long) m_offset);
+    return m_state->m_buffer + skip;
+}
+
+AsyncFileReader::AsyncFileReader(const wstring& fileName, bool directIO, size_t queueDepth)
+    : m_impl(make_shared<Impl>(fileName, directIO, queueDepth))
+{
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+}
+
+AsyncFileReader::RequestPtr AsyncFileReader::Read(int64_t offset, size_t size)
+{
+    return RequestPtr(new Request(m_impl, offset, size));
+}
+
+bool AsyncFileReader::IsAsync() const
+{
+    return m_impl->m_async;
+}
+
+bool AsyncFileReader::IsDirect() const
+{
+    return m_impl->m_direct;
+}
+
+}}}
@@ -237,6 +237,12 @@ size_t DataReader::GetCurrentSamplePosition()
     return m_dataReaders[m_ioNames.back()]->GetCurrentSamplePosition();
 }
 
+void DataReader::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    // BUGBUG: composition of old readers is not supported.
+    m_dataReaders[m_ioNames.back()]->SetCurrentSamplePosition(currentSamplePosition);
+}
+
 // GetMinibatch - Get the next minibatch (features and labels)
 // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
 //             [out] each matrix resized if necessary containing data.
@@ -284,6 +284,12 @@ void File::Flush()
     fflushOrDie(m_file);
 }
 
+void File::Sync()
+{
+    Flush();
+    fsyncOrDie(m_file);
+}
+
 // read a line
 // End of line is denoted by one of these, i.e. we don't support the old Mac OS convention of CR
 //  - LF
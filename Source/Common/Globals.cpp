@@ -16,6 +16,23 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     std::atomic<bool> Globals::m_enableShareNodeValueMatrices(true);
     std::atomic<bool> Globals::m_optimizeGradientAccumulation(true);
+    std::atomic<bool> Globals::m_quantizedInference(false);
+    std::atomic<bool> Globals::m_float16Products(false);
+    std::atomic<size_t> Globals::m_numComputeStreams(0);
+    std::atomic<bool> Globals::m_cudaGraphCapture(false);
+    std::atomic<bool> Globals::m_forwardPlans(false);
+    std::atomic<bool> Globals::m_memoryPlans(false);
+    std::atomic<bool> Globals::m_lazyParameterLoading(false);
+    std::atomic<bool> Globals::m_simplifyNetwork(false);
+    std::atomic<bool> Globals::m_fuseElementwiseOps(false);
+    std::atomic<bool> Globals::m_fuseBatchNormActivations(false);
+    std::atomic<bool> Globals::m_hoistLoopInvariantProducts(false);
+    std::atomic<bool> Globals::m_compactGapFrames(false);
+    std::atomic<size_t> Globals::m_recomputeSegmentBytesPerSample(0);
+    std::atomic<bool> Globals::m_offloadLoopValues(false);
+    std::atomic<size_t> Globals::m_offloadPrefetchDistance(2);
+    std::atomic<bool> Globals::m_counterBasedDropout(false);
+    std::atomic<bool> Globals::m_poolingArgmax(false);
 
     // Note: this is a map that transfers the old reader and writer names to
     //       the new naming scheme
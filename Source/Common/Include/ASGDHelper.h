@@ -6,6 +6,7 @@
 
 #include <list>
 #include "ComputationNetwork.h"
+#include "MPIWrapper.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -62,6 +63,9 @@ ASGDHelper<ElemType>* NewASGDHelper(
     double adjustCoef = 0.2,                                                 // see in DecayCoefficient()
     size_t adjustPerMinibatches = 600,                                       //
     int traceLevel = 0,                                                      // log level
-    int syncPerfStats = 0);                                                  // shown perf data every syncPerfStats
+    int syncPerfStats = 0,                                                   // shown perf data every syncPerfStats
+    bool useBuiltinParameterServer = false,                                  // Using the parameter server on the MPI nodes rather than Multiverso
+    int maxStaleness = -1,                                                   // Syncs a worker may be ahead of the slowest one, -1 for no bound (built-in server only)
+    const MPIWrapperPtr& mpi = nullptr);
 
 }}}
@@ -0,0 +1,77 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AsyncFileReader.h -- reads of ranges of a file that are queued to the OS and complete in the background
+//
+// fileutil's freadOrDie() blocks the calling thread, so a reader thread has one read in flight at a time, which does
+// not saturate an NVMe device. A deserializer that starts the read of a chunk with AsyncFileReader::Read() when the
+// chunk is requested, and waits for the data only when its first sequence is requested, lets the randomizer keep as
+// many reads in flight as it prefetches chunks (chunkPrefetchDepth), from one thread.
+//  - On Linux the reads are submitted to an io_uring, on Windows they are overlapped reads. Where neither is available
+//    (kernels before 5.1, io_uring disabled by a seccomp profile), the data is read synchronously by Wait().
+//  - With directIO the file is opened with O_DIRECT (FILE_FLAG_NO_BUFFERING), bypassing the page cache, which does not
+//    help for data sets that are much larger than memory. The reads are then of whole pages, into page-aligned buffers;
+//    the buffers of completed reads are pooled and reused. File systems without direct I/O (e.g. tmpfs) are read
+//    through the page cache.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class AsyncFileReader
+{
+    struct Impl;
+
+public:
+    // A read in flight. Its buffer is returned to the pool of the reader when it is destroyed.
+    class Request
+    {
+    public:
+        ~Request();
+
+        // Waits for the read to complete and returns the bytes that were requested. Thread-safe.
+        const char* Wait();
+
+        size_t Size() const { return m_size; }
+
+    private:
+        friend class AsyncFileReader;
+        friend struct AsyncFileReader::Impl;
+        struct State;
+
+        Request(const std::shared_ptr<Impl>& impl, int64_t offset, size_t size);
+
+        std::shared_ptr<Impl> m_impl; // kept alive by the requests, which may outlive the reader
+        std::unique_ptr<State> m_state;
+        int64_t m_offset;
+        size_t m_size;
+    };
+    typedef std::shared_ptr<Request> RequestPtr;
+
+    // Opens the file; queueDepth is the number of reads that may be in flight at once, more wait for a free slot.
+    AsyncFileReader(const std::wstring& fileName, bool directIO, size_t queueDepth = 32);
+    ~AsyncFileReader();
+
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    // Starts reading size bytes at offset. Thread-safe.
+    RequestPtr Read(int64_t offset, size_t size);
+
+    // Whether the reads complete in the background, i.e. io_uring or overlapped I/O is used.
+    bool IsAsync() const;
+
+    // Whether the file was opened for direct I/O.
+    bool IsDirect() const;
+
+private:
+    std::shared_ptr<Impl> m_impl;
+};
+
+}}}
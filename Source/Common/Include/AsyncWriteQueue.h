@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AsyncWriteQueue.h -- runs the output writes of a data writer on the thread pool, with a bounded number in flight
+//
+// A writer copies each output into a buffer it owns on the calling thread, and pushes a task that writes the buffer;
+// the forward pass then continues while the file is created and written. Once maxPending writes are in flight, Push()
+// waits for the oldest, which bounds the memory held by the buffers. Errors of a write are rethrown from a later Push()
+// or from Flush(). With maxPending = 0, writes run on the calling thread.
+//
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <deque>
+#include <future>
+#include <utility>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class AsyncWriteQueue
+{
+public:
+    explicit AsyncWriteQueue(size_t maxPending = 0)
+        : m_maxPending(maxPending)
+    {
+    }
+
+    // waits for the pending writes but drops their errors; call Flush() first to see them
+    ~AsyncWriteQueue()
+    {
+        for (auto& write : m_pending)
+            if (write.valid())
+                write.wait();
+    }
+
+    void SetMaxPending(size_t maxPending) { m_maxPending = maxPending; }
+    size_t GetMaxPending() const { return m_maxPending; }
+    size_t NumPending() const { return m_pending.size(); }
+
+    template <class Write>
+    void Push(Write&& write)
+    {
+        if (m_maxPending == 0)
+        {
+            write();
+            return;
+        }
+        while (m_pending.size() >= m_maxPending)
+            WaitForOldest();
+        m_pending.push_back(ThreadPool::Instance().Async(std::launch::async, std::forward<Write>(write)));
+    }
+
+    // waits for all pending writes, and rethrows the first error
+    void Flush()
+    {
+        while (!m_pending.empty())
+            WaitForOldest();
+    }
+
+private:
+    void WaitForOldest()
+    {
+        std::future<void> oldest = std::move(m_pending.front());
+        m_pending.pop_front();
+        oldest.get();
+    }
+
+    size_t m_maxPending;
+    std::deque<std::future<void>> m_pending;
+};
+
+}}}
@@ -508,7 +508,7 @@ public:
                     // Hence there is an ugly fix for it below. This will go away when we replace all configuration parsing by BrainScript.
                     const static std::string customSeperators = "`~!@$%^&*_-+|:;,?.";
 
-                    if (customSeperators.find(stringParse[tokenStart]) != npos && stringParse.substr(tokenStart).find("..") != 0 && stringParse.substr(tokenStart).find(".\\") != 0 && stringParse.substr(tokenStart).find("./") != 0 && stringParse.substr(tokenStart).find("\\\\") != 0 // [fseide] otherwise this will nuke leading . or .. or \\ in a pathname... Aargh!
+                    if (customSeperators.find(stringParse[tokenStart]) != npos && stringParse.compare(tokenStart, 2, "..") != 0 && stringParse.compare(tokenStart, 2, ".\\") != 0 && stringParse.compare(tokenStart, 2, "./") != 0 && stringParse.compare(tokenStart, 2, "\\\\") != 0 // [fseide] otherwise this will nuke leading . or .. or \\ in a pathname... Aargh!
                         )
                     {
                         char separator = stringParse[tokenStart];
@@ -883,8 +883,9 @@ public:
     // Insert - insert a new name and value into the dictionary
     void Insert(const std::string& name, const std::string& val)
     {
-        auto iter = find(name);
-        if (iter != end())
+        // one search for both cases, keys are compared case-insensitively
+        auto iter = lower_bound(name);
+        if (iter != end() && !key_comp()(name, iter->first))
         {
             // replace or append the value
             iter->second.ReplaceAppend(val);
@@ -892,13 +893,7 @@ public:
         else
         {
             std::string fullName = m_configName + ":" + name;
-            auto res = ConfigDictionary::insert(std::make_pair(name, ConfigValue(val, fullName, this)));
-
-            if (!res.second)
-            {
-                // no insertion was made
-                RuntimeError("configparameters: duplicate parameter definition for %s", fullName.c_str());
-            }
+            ConfigDictionary::emplace_hint(iter, name, ConfigValue(val, fullName, this));
         }
     }
 
@@ -974,9 +969,10 @@ public:
     {
         // find the value
         // TODO: unify with the Find() function below
+        const string key(name, name + wcslen(name));
         for (auto* dict = this; dict; dict = dict->m_parent)
         {
-            auto iter = dict->find(string(name, name + wcslen(name)));
+            auto iter = dict->find(key);
             if (iter != dict->end())
             {
                 if (iter->second == "default")
@@ -1013,10 +1009,7 @@ public:
         }
         else
         {
-            std::string rhs = iter->second;
-            rhs = this->ResolveVariables(rhs);
-            std::string fullName = m_configName + ":" + name;
-            result = ConfigValue(rhs, fullName, this);
+            result = ConfigValue(this->ResolveVariables(iter->second), m_configName + ":" + name, this);
             return true;
         }
         return false; // not found
@@ -1049,6 +1042,10 @@ public:
         if (configLine.find_first_of("\n") != std::string::npos)
             LogicError("ResolveVariablesInSingleLine() should not be called with a string containing a newline character");
 
+        // Most values have neither variables nor comments.
+        if (configLine.find_first_of("$#") == std::string::npos && configLine.find_first_not_of(" \t") != std::string::npos)
+            return configLine;
+
         std::string newConfigLine = StripComments(configLine);
         std::size_t start = newConfigLine.find_first_of(openBraceVar);
         std::size_t end = 0;
@@ -1128,11 +1125,17 @@ public:
         std::string newConfigString;
         if (configString.find_first_of("\n") != std::string::npos)
         {
-            // if 'configString' contains newlines, put them back after resolving each line.
-            std::vector<std::string> configLines = msra::strfun::split(configString, "\n");
-            for (auto configLine : configLines)
+            // if 'configString' contains newlines, put them back after resolving each line (empty lines are dropped).
+            // This runs on every lookup of a section, so the lines are not split into a vector first.
+            newConfigString.reserve(configString.size() + 1);
+            for (auto lineStart = configString.find_first_not_of('\n'); lineStart != std::string::npos;)
             {
-                newConfigString += ResolveVariablesInSingleLine(configLine) + "\n";
+                auto lineEnd = configString.find('\n', lineStart);
+                if (lineEnd == std::string::npos)
+                    lineEnd = configString.size();
+                newConfigString += ResolveVariablesInSingleLine(configString.substr(lineStart, lineEnd - lineStart));
+                newConfigString += '\n';
+                lineStart = configString.find_first_not_of('\n', lineEnd);
             }
         }
         else
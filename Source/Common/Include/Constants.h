@@ -10,5 +10,8 @@
 // The default threshold size to pack a gradient into a continuous buffer during aggregation for less MPI ops.
 const size_t DEFAULT_PACK_THRESHOLD_SIZE_IN_KB = 32;
 const size_t DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES = DEFAULT_PACK_THRESHOLD_SIZE_IN_KB * 1024;
+// Sparse gradients are aggregated by their non-zero columns until all workers together send more columns than this
+// multiple of the number of columns of the gradient, then by a dense allreduce.
+const double DEFAULT_SPARSE_GRADIENT_DENSITY_THRESHOLD = 1.0;
 
 #endif
@@ -253,6 +253,12 @@ public:
         NOT_IMPLEMENTED;
     }
 
+    // Continues reading at the given sample position on the global timeline.
+    virtual void SetCurrentSamplePosition(size_t /*currentSamplePosition*/)
+    {
+        NOT_IMPLEMENTED;
+    }
+
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize)
     {
         if (SupportsDistributedMBRead() || (numSubsets != 1) || (subsetNum != 0))
@@ -425,6 +431,7 @@ public:
     virtual ~DataReader();
 
     size_t GetCurrentSamplePosition() override;
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
 
     // StartMinibatchLoop - Startup a minibatch loop
     // mbSize - [in] size of the minibatch (number of frames, etc.)
@@ -62,6 +62,8 @@ public:
     virtual bool SaveData(size_t recordStart, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t datasetSize, size_t byteVariableSized) = 0;
     virtual void SaveMapping(std::wstring saveId, const std::map<LabelIdType, LabelType>& labelMapping) = 0;
     virtual bool SupportMultiUtterances() const = 0;
+    // waits until everything passed to SaveData() is written, and reports errors of writers that write in the background
+    virtual void Flush() { }
 };
 typedef std::shared_ptr<IDataWriter> IDataWriterPtr;
 
@@ -165,6 +167,12 @@ public:
     {
         return false;
     };
+
+    // Flush - wait until all saved data is written out
+    virtual void Flush()
+    {
+        m_dataWriter->Flush();
+    }
 };
 
 } } }
@@ -355,6 +355,51 @@ public:
     // resetRNN - flags whether to reset memory cells of RNN. 
     //
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) = 0;
+
+    //
+    // ForwardPassStreams - Evaluate the next frames of several independent streams (e.g. live audio) in a single forward
+    // pass. The recurrent state (PastValue) of each stream is kept on the device between the calls, keyed by its id.
+    // streamIds - the streams to continue. A stream id that is not known (yet, or since EndStream()) begins a new stream.
+    // inputs - [k] the input buffers of stream streamIds[k], as for ForwardPass(). Dense inputs only; the streams may
+    //          have different numbers of frames.
+    // outputs - [k] the output buffers of stream streamIds[k], as for ForwardPass(). Must be sized to fit all its frames.
+    //
+    virtual void ForwardPassStreams(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) = 0;
+
+    //
+    // EndStream - Release the recurrent state of a stream of ForwardPassStreams(). Its id may be reused afterwards.
+    //
+    virtual void EndStream(size_t streamId) = 0;
+
+    //
+    // Clone - create another evaluator of the same model, e.g. for another thread. The clone shares the parameters
+    // of the model (read-only) with this evaluator, but has its own intermediate values and memory buffers, so that
+    // the clones can call ForwardPass() concurrently. Must be called before StartForwardEvaluation(); concurrent
+    // calls are allowed. Release the clone with Destroy().
+    //
+    virtual IEvaluateModelExtended<ElemType>* Clone() = 0;
+
+    //
+    // BindInput/BindOutput - Bind memory of the caller to an input or output, by its index into GetInputSchema() or
+    // GetOutputSchema(), for ForwardPassBound(). Dense variables only. Called after StartForwardEvaluation(); the
+    // memory must stay valid until the variable is bound again, or the next StartForwardEvaluation() or Destroy()
+    // has returned.
+    // buffer - the memory of the variable, column-major as for ForwardPass(). Inputs are only read.
+    // capacity - size of the buffer in elements
+    // onDevice - the buffer is memory of the GPU that the network runs on, instead of host memory
+    //
+    virtual void BindInput(size_t index, const ElemType* buffer, size_t capacity, bool onDevice) = 0;
+    virtual void BindOutput(size_t index, ElemType* buffer, size_t capacity, bool onDevice) = 0;
+
+    //
+    // ForwardPassBound - Same as ForwardPass(), but reads the inputs from and writes the outputs to the bound buffers,
+    // without looking up or marshalling them. Buffers on the device the network runs on are used in place: an input
+    // becomes the value of its node, and an output is computed into its buffer if it fits. Others are copied once.
+    // numSamples - [i] the number of samples in the buffer of input i
+    // outputSizes - [i] receives the number of elements written to the buffer of output i; can be nullptr
+    // resetRNN - flags whether to reset memory cells of RNN.
+    //
+    virtual void ForwardPassBound(const size_t* numSamples, size_t* outputSizes, bool resetRNN) = 0;
 };
 
 template <typename ElemType>
@@ -362,4 +407,44 @@ void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval);
 extern "C" EVAL_API void GetEvalExtendedF(IEvaluateModelExtended<float>** peval);
 extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval);
 
+// ------------------------------------------------------------------------
+// Ensemble interface
+// ------------------------------------------------------------------------
+
+//
+// Evaluates several models that have the same inputs and outputs (by name and dimension), e.g. the members of an ensemble,
+// as one. The inputs are packed once and shared by the models, which run concurrently: on streams of the GPU if they all
+// run on the same one, on threads otherwise. Their outputs are combined on the device, as given by the config of Init():
+//   ensembleCombination=mean (default): the mean of the outputs of the models, e.g. of their logits
+//   ensembleCombination=logMean: the mean of the logarithms of the outputs, e.g. the log of the geometric mean of posteriors
+//
+template <typename ElemType>
+class IEvaluateModelEnsemble : public IEvaluateModelBase<ElemType>
+{
+public:
+    //
+    // Init - the config of all the models, as for IEvaluateModelBase::Init(). Called before CreateNetwork().
+    // CreateNetwork - adds a model to the ensemble, from an (NDL) network description or "modelPath=...".
+    //
+
+    virtual size_t GetNumModels() const = 0;
+
+    //
+    // As for IEvaluateModelExtended. The schemas are those of the first model, which all the others must match.
+    //
+    virtual VariableSchema GetOutputSchema() const = 0;
+    virtual void StartForwardEvaluation(const std::vector<std::wstring>& outputs) = 0;
+    virtual VariableSchema GetInputSchema() const = 0;
+
+    //
+    // ForwardPass - As IEvaluateModelExtended::ForwardPass(), with the combined outputs of the models.
+    //
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs, bool resetRNN) = 0;
+};
+
+template <typename ElemType>
+void EVAL_API GetEvalEnsemble(IEvaluateModelEnsemble<ElemType>** peval);
+extern "C" EVAL_API void GetEvalEnsembleF(IEvaluateModelEnsemble<float>** peval);
+extern "C" EVAL_API void GetEvalEnsembleD(IEvaluateModelEnsemble<double>** peval);
+
 } } }
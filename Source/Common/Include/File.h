@@ -108,8 +108,10 @@ public:
     ~File();
 
     void Flush();
+    void Sync(); // Flush(), then have the OS write the file through to the disk
 
     bool CanSeek() const { return m_seekable; }
+    const std::wstring& GetFileName() const { return m_filename; }
     size_t Size();
     uint64_t GetPosition();
     void SetPosition(uint64_t pos);
@@ -195,6 +197,30 @@ public:
         return *this;
     }
 
+    // get/put an array of basic types; a single read or write in binary mode
+    template <typename T>
+    void ReadArray(T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                fgetText(m_file, data[i]);
+        }
+        else
+            freadOrDie(data, sizeof(T), count, m_file);
+    }
+    template <typename T>
+    void WriteArray(const T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                fputText(m_file, data[i]);
+        }
+        else
+            fwriteOrDie(data, sizeof(T), count, m_file);
+    }
+
     void WriteString(const char* str, int size = 0);                   // zero terminated strings use size=0
     void ReadString(char* str, int size);                              // read up to size bytes, or a zero terminator (or space in text mode)
     void WriteString(const wchar_t* str, int size = 0);                // zero terminated strings use size=0
@@ -28,11 +28,110 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static void SetShareNodeValueMatrices(bool enable) { m_enableShareNodeValueMatrices = enable; }
         static bool ShouldEnableShareNodeValueMatrices() { return m_enableShareNodeValueMatrices; }
 
+        // Opt-in: during inference, compute products with constant weights (TimesNode) in fixed point: 16 bit on the CPU, 8 bit on the GPU.
+        static void SetQuantizedInference(bool enable) { m_quantizedInference = enable; }
+        static bool ShouldUseQuantizedInference() { return m_quantizedInference; }
+
+        // Opt-in: on the GPU, compute float matrix products with fp16 operands and fp32 accumulation (tensor cores
+        // where available). Parameters, gradients and all other operations stay in float.
+        static void SetFloat16Products(bool enable) { m_float16Products = enable; }
+        static bool ShouldUseFloat16Products() { return m_float16Products; }
+
+        // Opt-in: run independent nodes of a network concurrently on this many CUDA streams on the GPU, or on this many
+        // worker threads on the CPU (0 or 1: off).
+        static void SetNumComputeStreams(size_t numStreams) { m_numComputeStreams = numStreams; }
+        static size_t GetNumComputeStreams() { return m_numComputeStreams; }
+
+        // Opt-in: on the GPU, record the forward pass of a network as a CUDA graph for each minibatch layout, and replay it
+        // for later minibatches with the same layout.
+        static void SetCudaGraphCapture(bool enable) { m_cudaGraphCapture = enable; }
+        static bool ShouldCaptureCudaGraphs() { return m_cudaGraphCapture; }
+
+        // Opt-in: in inference mode, run repeated forward passes of a network from a precompiled list of the nodes to run,
+        // without checking each node for whether it is out of date.
+        static void SetForwardPlans(bool enable) { m_forwardPlans = enable; }
+        static bool ShouldUseForwardPlans() { return m_forwardPlans; }
+
+        // Opt-in: in inference mode, place the shared matrices of a network into one arena per minibatch shape, laid out by a
+        // plan recorded from the first minibatch of that shape, instead of resizing them for every larger minibatch.
+        static void SetMemoryPlans(bool enable) { m_memoryPlans = enable; }
+        static bool ShouldUseMemoryPlans() { return m_memoryPlans; }
+
+        // Opt-in: when loading a model, leave the values of the parameters in the file until the network needs them
+        // (ComputationNetwork::MaterializeParameters()), so that parameters that are not needed are never loaded.
+        static void SetLazyParameterLoading(bool enable) { m_lazyParameterLoading = enable; }
+        static bool ShouldLoadParametersLazily() { return m_lazyParameterLoading; }
+
+        // Opt-in: when compiling a network, let the consumers of nodes that compute the same value as another node, or that have
+        // no effect (e.g. x + 0, a transpose of a transpose), read that node instead, and delete the nodes no longer needed.
+        static void SetNetworkSimplification(bool enable) { m_simplifyNetwork = enable; }
+        static bool ShouldSimplifyNetwork() { return m_simplifyNetwork; }
+
+        // Opt-in: evaluate chains of elementwise nodes (e.g. bias + activation + product) as one fused tensor operation.
+        static void SetElementwiseFusion(bool enable) { m_fuseElementwiseOps = enable; }
+        static bool ShouldFuseElementwiseOps() { return m_fuseElementwiseOps; }
+
+        // Opt-in: evaluate a batch normalization followed by a ReLU (or by a residual addition and a ReLU) as one node, which
+        // computes the activation in place of the normalized value.
+        static void SetBatchNormActivationFusion(bool enable) { m_fuseBatchNormActivations = enable; }
+        static bool ShouldFuseBatchNormActivations() { return m_fuseBatchNormActivations; }
+
+        // Opt-in: in recurrent loops, compute the part of a product W * RowStack(x, h) that does not depend on the recurrence,
+        // W_x * x, once for the whole minibatch before the loop instead of once per time step.
+        static void SetLoopInvariantProductHoisting(bool enable) { m_hoistLoopInvariantProducts = enable; }
+        static bool ShouldHoistLoopInvariantProducts() { return m_hoistLoopInvariantProducts; }
+
+        // Opt-in: evaluate runs of products and elementwise operations on the valid frames of the minibatch only, gathered
+        // into a dense matrix, instead of on all columns of the MBLayout including the gaps between sequences.
+        static void SetGapFrameCompaction(bool enable) { m_compactGapFrames = enable; }
+        static bool ShouldCompactGapFrames() { return m_compactGapFrames; }
+
+        // Gradient checkpointing: the values of nodes marked for recomputation (tag="recompute") are dropped after the forward
+        // pass and recomputed in the backward pass. If nonzero, nodes are also picked automatically, in segments whose values
+        // take at most this many bytes per sample.
+        static void SetRecomputeSegmentBytesPerSample(size_t bytes) { m_recomputeSegmentBytesPerSample = bytes; }
+        static size_t GetRecomputeSegmentBytesPerSample() { return m_recomputeSegmentBytesPerSample; }
+
+        // Host-memory offloading, on the GPU: the values of nodes marked for offloading (tag="offload"), and of all nodes in
+        // recurrent loops if enabled, are copied to host memory after the forward pass and back before the backward pass reads
+        // them, this many nodes or loops ahead.
+        static void SetOffloadLoopValues(bool enable) { m_offloadLoopValues = enable; }
+        static bool ShouldOffloadLoopValues() { return m_offloadLoopValues; }
+        static void SetOffloadPrefetchDistance(size_t distance) { m_offloadPrefetchDistance = distance; }
+        static size_t GetOffloadPrefetchDistance() { return m_offloadPrefetchDistance; }
+
+        // Opt-in: dropout draws its mask from a counter-based generator (Philox) keyed by the node's seed and RNG offset, and
+        // regenerates it in the backward pass instead of keeping an activation-sized mask matrix per dropout node.
+        static void SetCounterBasedDropout(bool enable) { m_counterBasedDropout = enable; }
+        static bool ShouldUseCounterBasedDropout() { return m_counterBasedDropout; }
+
+        // Opt-in: max pooling stores the position of the max of each window as int16 in the forward pass, and the backward
+        // pass scatters the gradient to it without the input and output values of the pooling, which then need not be kept.
+        static void SetPoolingArgmax(bool enable) { m_poolingArgmax = enable; }
+        static bool ShouldStorePoolingArgmax() { return m_poolingArgmax; }
+
     private:
         static std::atomic<bool> m_forceDeterministicAlgorithms;
         // The global flag to enable matrices values in forward and backward prop
         static std::atomic<bool> m_enableShareNodeValueMatrices;
         static std::atomic<bool> m_forceConstantRandomSeed;
         static std::atomic<bool> m_optimizeGradientAccumulation;
+        static std::atomic<bool> m_quantizedInference;
+        static std::atomic<bool> m_float16Products;
+        static std::atomic<size_t> m_numComputeStreams;
+        static std::atomic<bool> m_cudaGraphCapture;
+        static std::atomic<bool> m_forwardPlans;
+        static std::atomic<bool> m_memoryPlans;
+        static std::atomic<bool> m_lazyParameterLoading;
+        static std::atomic<bool> m_simplifyNetwork;
+        static std::atomic<bool> m_fuseElementwiseOps;
+        static std::atomic<bool> m_fuseBatchNormActivations;
+        static std::atomic<bool> m_hoistLoopInvariantProducts;
+        static std::atomic<bool> m_compactGapFrames;
+        static std::atomic<size_t> m_recomputeSegmentBytesPerSample;
+        static std::atomic<bool> m_offloadLoopValues;
+        static std::atomic<size_t> m_offloadPrefetchDistance;
+        static std::atomic<bool> m_counterBasedDropout;
+        static std::atomic<bool> m_poolingArgmax;
     };
 }}}
@@ -27,6 +27,7 @@ typedef void *MPI_Comm;
 typedef enum _MPI_Datatype { MPI_CHAR, MPI_INT, MPI_FLOAT, MPI_DOUBLE, MPI_UNSIGNED, MPI_LONG_LONG_INT } MPI_Datatype;
 
 #define MPI_IN_PLACE          ((void*)(int)-1)
+#define MPI_MAX               ((MPI_Op)0x58000001)
 #define MPI_SUM               ((MPI_Op)0x58000003)
 
 #define MPI_STATUSES_IGNORE  (MPI_Status*)1
@@ -39,6 +40,7 @@ typedef void *MPI_Status;
 #endif
 
 #include <errno.h> 
+#include <stdexcept>
 #include <string>
 #include <array>
 #include <vector>
@@ -58,6 +60,16 @@ struct MpiFail : public std::string
 
 extern int operator||(int rc, const MpiFail &what);
 
+// Thrown by the data-exchange functions instead of aborting the job when a node in use failed,
+// if fault tolerance is enabled, see MPIWrapper::EnableFaultTolerance().
+struct MpiProcessFailure : public std::runtime_error
+{
+    MpiProcessFailure(const std::string &what)
+        : std::runtime_error(what)
+    {
+    }
+};
+
 class MPIWrapper;
 typedef std::shared_ptr<MPIWrapper> MPIWrapperPtr;
 
@@ -96,9 +108,31 @@ public:
     virtual size_t MainNodeRank() const = 0;
     virtual bool IsMultiHost() const = 0;
 
-    // Use GPUDirect RDMA support
+    // Topology of the nodes in use: the index of the host each node runs on (hosts are numbered in
+    // the order of their lowest node rank), and the rank of the current node among the nodes of its host.
+    virtual const std::vector<size_t>& HostIndexOfNodes() const = 0;
+    virtual size_t NumNodesOnCurrentHost() const = 0;
+    virtual size_t CurrentNodeRankOnHost() const = 0;
+
+    // Use GPUDirect RDMA support: the MPI library accesses GPU memory directly (CUDA-aware MPI), so that GPU data
+    // is not staged in host memory. Only true if all nodes in use support it.
     virtual bool UseGpuGdr() = 0;
 
+    // Elastic training, needs an MPI library with the ULFM fault tolerance extension (e.g. Open MPI built with it).
+    // With fault tolerance enabled, the failure of a node in use makes the data-exchange functions throw MpiProcessFailure
+    // on the surviving nodes, which then all call RecoverFromFailure() to continue with the nodes that are left (renumbered
+    // in the order of their previous rank). EnableFaultTolerance() returns false if the MPI library does not support it.
+    virtual bool EnableFaultTolerance() = 0;
+    virtual bool IsFaultTolerant() const = 0;
+    virtual void RecoverFromFailure() = 0;
+
+    // Adding nodes while running: the nodes in use call AcceptNodes() together, with the port name that the main node
+    // got from OpenPort(), while the new processes call JoinNodes() together with the same port name. The new nodes
+    // are appended to the nodes in use, in the order of their rank.
+    virtual std::string OpenPort() = 0;
+    virtual void AcceptNodes(const std::string& portName) = 0;
+    virtual void JoinNodes(const std::string& portName) = 0;
+
     // -----------------------------------------------------------------------
     // data-exchange functions (wrappers around MPI functions)
     // -----------------------------------------------------------------------
@@ -163,6 +197,7 @@ public:
     virtual void AllGather(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements) const = 0;
     virtual void AllGather(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements) const = 0;
     virtual void Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype) const = 0;
+    virtual void Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[], const int displs[], MPI_Datatype recvtype) const = 0;
 
     virtual void Gather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, size_t rootRank) const = 0;
     virtual void Gather(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements, size_t rootRank) const = 0;
@@ -175,6 +210,30 @@ public:
     virtual void Gatherv(const float *sendData, size_t numSendElements, float *receiveData, int recvCounts[], int offsets[], size_t rootRank) const = 0;
     virtual void Gatherv(const double *sendData, size_t numSendElements, double *receiveData, int recvCounts[], int offsets[], size_t rootRank) const = 0;
 
+    // collectives among the nodes of the current host: sendData of ReduceScatterWithinHost() and receiveData of
+    // AllGatherWithinHost() hold numElementsPerNode elements for each node of the host, in the order of their rank on the host
+    virtual void ReduceScatterWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const = 0;
+    virtual void ReduceScatterWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const = 0;
+    virtual void AllGatherWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const = 0;
+    virtual void AllGatherWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const = 0;
+
+    // in-place sum among the nodes that have the same rank on their host, one on each host
+    virtual void AllReduceAcrossHosts(float* data, size_t numElements) const = 0;
+    virtual void AllReduceAcrossHosts(double* data, size_t numElements) const = 0;
+
+    // one-sided access to memory that each node exposes, e.g. for the shards of a parameter server: CreateWindow() is
+    // collective, each node exposes its numElements at base (possibly none). FetchAndAdd() adds data (unless null) to the
+    // elements at targetOffset of the target node and returns their previous values in result, atomically per element
+    // and without the participation of the target node. The operations complete at FlushWindow().
+    virtual size_t CreateWindow(float* base, size_t numElements) = 0;
+    virtual size_t CreateWindow(double* base, size_t numElements) = 0;
+    virtual size_t CreateWindow(size_t* base, size_t numElements) = 0;
+    virtual void FreeWindow(size_t window) = 0;
+    virtual void FetchAndAdd(size_t window, const float* data, float* result, size_t numElements, size_t targetRank, size_t targetOffset) = 0;
+    virtual void FetchAndAdd(size_t window, const double* data, double* result, size_t numElements, size_t targetRank, size_t targetOffset) = 0;
+    virtual void FetchAndAdd(size_t window, const size_t* data, size_t* result, size_t numElements, size_t targetRank, size_t targetOffset) = 0;
+    virtual void FlushWindow(size_t window) = 0;
+
     // wait for all ranks to reach here
     virtual int WaitAll() = 0;
     virtual void WaitAny(MPI_Request* requests, int numRequests, int* index) = 0;
@@ -182,4 +241,8 @@ public:
     virtual int WaitAll(std::vector<MPI_Request>& requests) = 0;
 };
 
+// The offset of the clock of this node (Clock::GetTimeStamp()) to the clock of the main node, in clock ticks, e.g.
+// to merge the profiler traces of all nodes (see ProfilerSetRank()). Collective, all nodes in use have to call it.
+long long EstimateClockOffsetToMainNode(MPIWrapper& mpi);
+
 }}}
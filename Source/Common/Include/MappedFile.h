@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MappedFile.h -- read-only memory mapping of a whole file
+//
+
+#pragma once
+
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+#include <string>
+#include <algorithm>
+#include "Basics.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Maps a file into memory, e.g. to read parts of it without copying them through a stream buffer first. Pages are read
+// in on first access and shared with the page cache. The mapping stays valid until the object is destroyed.
+class MappedFile
+{
+public:
+    MappedFile(const std::wstring& path)
+        : m_data(nullptr), m_size(0)
+    {
+        FILE* f = fopenOrDie(path, L"rb");
+        m_size = filesize(f);
+        if (m_size > 0)
+        {
+#ifdef _WIN32
+            HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(f)));
+            HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL)
+            {
+                m_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, m_size);
+                CloseHandle(mapping); // the view keeps the mapping alive
+            }
+            if (m_data == NULL)
+            {
+                fclose(f);
+                RuntimeError("MappedFile: Error mapping %ls: error 0x%x.", path.c_str(), (unsigned int)GetLastError());
+            }
+#else
+            m_data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fileno(f), 0);
+            if (m_data == MAP_FAILED)
+            {
+                m_data = nullptr;
+                fclose(f);
+                RuntimeError("MappedFile: Error mapping %ls: %s.", path.c_str(), strerror(errno));
+            }
+#endif
+        }
+        fclose(f); // the mapping does not need the file handle
+    }
+
+    ~MappedFile()
+    {
+        if (!m_data)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap(m_data, m_size);
+#endif
+    }
+
+    // Asks the OS to start reading a range of the file in the background, so that the first accesses do not stall.
+    // Best effort; a no-op where this is not supported.
+    void WillNeed(size_t offset, size_t size) const
+    {
+#ifndef _WIN32
+        if (!m_data || offset >= m_size)
+            return;
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+        size_t begin = offset - offset % pageSize;
+        madvise(static_cast<char*>(m_data) + begin, std::min(offset + size, m_size) - begin, MADV_WILLNEED);
+#else
+        UNUSED(offset);
+        UNUSED(size);
+#endif
+    }
+
+    const char* GetData() const { return static_cast<const char*>(m_data); }
+    size_t Size() const { return m_size; }
+
+private:
+    void* m_data;
+    size_t m_size;
+
+    DISABLE_COPY_AND_MOVE(MappedFile);
+};
+
+}}}
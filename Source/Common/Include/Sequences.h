@@ -8,6 +8,7 @@
 #pragma once
 
 #include <vector>
+#include <map>
 #include <memory> // for shared_ptr
 #include <mutex>
 #include "Basics.h"
@@ -109,7 +110,6 @@ struct MBLayout
     // -------------------------------------------------------------------
 
     MBLayout(size_t numParallelSequences, size_t numTimeSteps, const std::wstring &name)
-        : m_distanceToStart(CPUDEVICE), m_distanceToEnd(CPUDEVICE), m_columnsValidityMask(CPUDEVICE)
     {
         Init(numParallelSequences, numTimeSteps);
         SetUniqueAxisName(name != L"" ? name : L"DynamicAxis");
@@ -131,15 +131,19 @@ struct MBLayout
         m_numFramesDeclared = other->m_numFramesDeclared;
         m_numGapFrames = other->m_numGapFrames;
 
-        m_distanceToStart.SetValue(other->m_distanceToStart);
-        m_distanceToEnd.SetValue(other->m_distanceToEnd);
+        m_distanceToStart = other->m_distanceToStart;
+        m_distanceToEnd = other->m_distanceToEnd;
 
         m_distanceToNearestStart = other->m_distanceToNearestStart;
         m_distanceToNearestEnd = other->m_distanceToNearestEnd;
 
         m_timeStepHasGap = other->m_timeStepHasGap;
 
-        m_columnsValidityMask.SetValue(other->m_columnsValidityMask);
+        // the masks are never modified once created, so the copy shares them
+        {
+            std::lock_guard<std::mutex> lock(other->m_columnsValidityMasksMutex);
+            m_columnsValidityMasks = other->m_columnsValidityMasks;
+        }
         m_writable = other->m_writable;
 
         if (!keepName)
@@ -165,7 +169,7 @@ struct MBLayout
 
         m_timeStepHasGap = std::move(other->m_timeStepHasGap);
 
-        m_columnsValidityMask = std::move(other->m_columnsValidityMask);
+        m_columnsValidityMasks = std::move(other->m_columnsValidityMasks);
         m_writable = other->m_writable;
 
         m_axisName = std::move(other->m_axisName);
@@ -181,12 +185,12 @@ public:
         // remember the dimensions
         m_numParallelSequences = numParallelSequences;
         m_numTimeSteps = numTimeSteps;
-        m_distanceToStart.Resize(m_numParallelSequences, m_numTimeSteps);
-        m_distanceToEnd.Resize(m_numParallelSequences, m_numTimeSteps);
+        m_distanceToStart.resize(m_numParallelSequences * m_numTimeSteps);
+        m_distanceToEnd.resize(m_numParallelSequences * m_numTimeSteps);
         m_distanceToNearestStart.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_distanceToNearestEnd.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_timeStepHasGap.assign(m_numTimeSteps, false);
-        m_columnsValidityMask.Resize(0, 0); // invalidate
+        m_columnsValidityMasks.clear(); // invalidate (copies made by CopyFrom() keep theirs)
         // reset state
         m_numFramesDeclared = 0;
         m_numGapFrames = 0;
@@ -311,6 +315,7 @@ public:
     // This is used by MeanNode and InvStdDevNode, and by statistics reporting.
     size_t GetActualNumSamples() const;
 
+    // 1 for each column with content, 0 for gaps; created once per device, and shared by all users of the layout
     const Matrix<char>& GetColumnsValidityMask(DEVICEID_TYPE deviceId) const;
 
     // compare whether two layouts are the same
@@ -393,7 +398,7 @@ public:
             for (size_t t = b; t < e; t++)
             {
                 m_timeStepHasGap[t] = true;
-                m_distanceToStart(s, t) = -1; // start flags also encode gaps
+                m_distanceToStart[s + t * m_numParallelSequences] = -1; // start flags also encode gaps
             }
         }
         else
@@ -403,8 +408,8 @@ public:
                 // If 0, then we are on a boundary. If not 0, we can still test in presence of FrameRange.m_timeOffset.
                 ptrdiff_t distanceToStart = (ptrdiff_t) t - beginTime;
                 ptrdiff_t distanceToEnd = (ptrdiff_t)(endTime - 1 - t);
-                m_distanceToStart(s, t) = (float) distanceToStart;
-                m_distanceToEnd(s, t) = (float) distanceToEnd;
+                m_distanceToStart[s + t * m_numParallelSequences] = (float) distanceToStart;
+                m_distanceToEnd[s + t * m_numParallelSequences] = (float) distanceToEnd;
                 // and the aggregate
                 if (m_distanceToNearestStart[t] > distanceToStart)
                     m_distanceToNearestStart[t] = distanceToStart;
@@ -435,8 +440,8 @@ public:
         m_numFramesDeclared = numSamples;
 
         // create all the cached fast-lookup information
-        m_distanceToStart.SetValue(0);
-        m_distanceToEnd.SetValue(0);
+        m_distanceToStart.assign(numSamples, 0);
+        m_distanceToEnd.assign(numSamples, 0);
         m_distanceToNearestStart[0] = 0;
         m_distanceToNearestEnd[0] = 0;
 
@@ -593,7 +598,7 @@ private:
     //                              2  1  0  .  . ]          // (last two time steps undefined)
     // m_distanceToNearestStart = [ 0  1  2  3  4 ]
     // m_distanceToNearestEnd   = [ 2  1  0  1  0 ]
-    Matrix<float> m_distanceToStart, m_distanceToEnd;                   // (s,t); value<0 stands for gap
+    vector<float> m_distanceToStart, m_distanceToEnd;                   // [s + t * numParallelSequences]; value<0 stands for gap
     vector<ptrdiff_t> m_distanceToNearestStart, m_distanceToNearestEnd; // [t]    (does not store info about gaps; consult m_timeStepHasGap[] vector instead)
 
     vector<bool> m_timeStepHasGap; // [t] true if at least one gap in time step t
@@ -602,11 +607,13 @@ private:
     // TODO: We actually just need a boolean matrix for this.
     // A value of 1 indicates that the column has valid content
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
-    mutable Matrix<char> m_columnsValidityMask;
+    // There is one per device that asked for it, so that nodes on different devices do not move it back and forth.
+    mutable std::map<DEVICEID_TYPE, std::shared_ptr<Matrix<char>>> m_columnsValidityMasks;
+    mutable std::mutex m_columnsValidityMasksMutex; // nodes may be evaluated concurrently
 
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
-    // Meant to guard in lazy creation of m_columnsValidityMask.
+    // Meant to guard in lazy creation of m_columnsValidityMasks.
     mutable bool m_writable;
 
     // The axis this MBLayout represents.
@@ -623,7 +630,7 @@ public:
     // special accessor for sequence training  --TODO: must be replaced by a different mechanism
     bool IsEnd(size_t s, size_t t) const
     {
-        auto distanceToStart = (ptrdiff_t) m_distanceToStart(s, t);
+        auto distanceToStart = (ptrdiff_t) m_distanceToStart[s + t * m_numParallelSequences];
 #if 1 // I don't exactly know what this does, so try assert() first
         assert(distanceToStart != -1);
         distanceToStart;
@@ -631,7 +638,7 @@ public:
         if (distanceToStart == -1) // indicates a gap
             return false;
 #endif
-        auto distanceToEnd = (size_t) m_distanceToEnd(s, t);
+        auto distanceToEnd = (size_t) m_distanceToEnd[s + t * m_numParallelSequences];
         return distanceToEnd == 0;
     }
 };
@@ -835,7 +842,7 @@ inline bool MBLayout::IsGap(const FrameRange &fr) const
         return m_timeStepHasGap[t];
 
     // determine flags from matrices
-    return m_distanceToStart(s, t) < 0; // value is -1 for gaps, non-negative otherwise
+    return m_distanceToStart[s + t * m_numParallelSequences] < 0; // value is -1 for gaps, non-negative otherwise
 }
 
 // test whether frame is exceeding the bounds of the MB
@@ -877,7 +884,7 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
     }
 
     // determine flags from matrices
-    auto distanceToStart = (ptrdiff_t) m_distanceToStart(s, t);
+    auto distanceToStart = (ptrdiff_t) m_distanceToStart[s + t * m_numParallelSequences];
     if (distanceToStart == -1) // indicates a gap
     {
         assert(m_timeStepHasGap[t]);
@@ -887,7 +894,7 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
     {
         if (distanceToStart < -fr.m_timeOffset)
             return true;
-        auto distanceToEnd = (ptrdiff_t) m_distanceToEnd(s, t);
+        auto distanceToEnd = (ptrdiff_t) m_distanceToEnd[s + t * m_numParallelSequences];
         if (distanceToEnd < fr.m_timeOffset)
             return true;
     }
@@ -897,48 +904,41 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
 // TODO: Remove this version (with sanity checks) after this has been tested. Then the function can be inlined above.
 inline size_t MBLayout::GetActualNumSamples() const { return m_numFramesDeclared - m_numGapFrames; }
 
-// return m_columnsValidityMask(,), which is lazily created here upon first call
+// return m_columnsValidityMasks[deviceId], which is lazily created here upon first call for the device
 // only called from MaskMissingColumnsTo()
-// TODO: Can probably be faster by using the sequence array directly.
-// TODO: Or should we just blast m_distanceToStart to GPU, and maks based on that? It is small compared to features.
+// The mask is made from the gaps in m_sequences, and copied to the device once; all nodes of the layout, and the
+// layouts copied from it (CopyFrom()), then use that copy. Another device gets its own.
 inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE deviceId) const
 {
     CheckIsValid();
-    // lazily compute the validity mask
-    if (m_columnsValidityMask.IsEmpty())
+    std::lock_guard<std::mutex> lock(m_columnsValidityMasksMutex);
+    auto& mask = m_columnsValidityMasks[deviceId];
+    if (!mask)
     {
         assert(HasGaps()); // must only be called if there are gaps
         Lock();
 
         // Determine indices of all invalid columns in the minibatch
-        // TODO: This can be done more efficiently by using m_sequences[].
         size_t nT = GetNumTimeSteps();
         size_t nS = GetNumParallelSequences();
 
         std::vector<char> columnsValidityMask(nT * nS, 1); // form the mask in a CPU-side STL vector first
         size_t gapsFound = 0;
-        for (size_t t = 0; t < nT; t++)
+        for (const auto& seq : m_sequences)
         {
-            FrameRange fr(nullptr, t);
-            if (IsGap(fr))
+            if (seq.seqId != GAP_SEQUENCE_ID)
+                continue;
+            for (size_t t = (size_t)max(seq.tBegin, (ptrdiff_t)0); t < min(seq.tEnd, nT); t++)
             {
-                for (size_t s = 0; s < nS; s++)
-                {
-                    if (IsGap(fr.Sequence(s)))
-                    {
-                        columnsValidityMask[(t * nS) + s] = 0;
-                        gapsFound++;
-                    }
-                }
+                columnsValidityMask[(t * nS) + seq.s] = 0;
+                gapsFound++;
             }
         }
         assert(gapsFound == m_numGapFrames); // sanity check
 
-        if (deviceId != m_columnsValidityMask.GetDeviceId())
-            m_columnsValidityMask = Matrix<char>(deviceId);
-        m_columnsValidityMask.SetValue(1, nS * nT, deviceId, columnsValidityMask.data());
+        mask = std::make_shared<Matrix<char>>(1, nS * nT, columnsValidityMask.data(), deviceId);
     }
-    return m_columnsValidityMask;
+    return *mask;
 }
 
 // class for defining an iteration over a sequence, forward and backward
@@ -1192,9 +1192,7 @@ static inline void MaskMissingColumnsTo(Matrix<ElemType>& matrixToMask, const MB
 {
     if (pMBLayout && pMBLayout->HasGaps(fr))
     {
-        const auto& maskMatrix = pMBLayout->GetColumnsValidityMask(matrixToMask.GetDeviceId());
-
-        maskMatrix.TransferToDeviceIfNotThere(matrixToMask.GetDeviceId(), /*ismoved=*/ false, /*emptyTransfer=*/ false, /*updatePreferredDevice=*/ false);
+        const auto& maskMatrix = pMBLayout->GetColumnsValidityMask(matrixToMask.GetDeviceId()); // already on that device
         auto maskSlice = DataWithMBLayoutFor(maskMatrix, fr, pMBLayout);
 
         auto matrixSliceToMask = DataWithMBLayoutFor(matrixToMask, fr, pMBLayout);
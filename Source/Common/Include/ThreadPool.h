@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ThreadPool.h -- the process-wide pool of threads for background work, and the split of the CPUs between it and compute
+//
+// The readers (minibatch prefetch, chunk loading) and the asynchronous gradient aggregation run their tasks through
+// ThreadPool::Async() instead of std::async(), which starts a new thread for every task. A pool thread is started when a
+// task finds none idle, and is then kept for later tasks. Tasks may wait for other tasks (the prefetches of the readers
+// are chained), so the number of threads is not capped; it settles at the number of tasks in flight at once, which is
+// small. Idle threads take high-priority tasks (gradient aggregation, which the next minibatch waits for) before normal
+// ones.
+//
+// ReserveBackgroundCpus() sets aside some of the CPUs of the process for the pool threads; CPUMatrix::SetNumThreads()
+// then gives OpenMP the others. With pinning, the pool threads run only on the reserved CPUs and the OpenMP threads only
+// on the others, so that spinning OpenMP threads and reader threads do not preempt each other.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class ThreadPoolPriority
+{
+    normal, // e.g. reading data ahead
+    high,   // work that the computation is about to wait for
+};
+
+class ThreadPool
+{
+public:
+    // The pool is never destroyed, so that exiting the process does not wait for its threads.
+    static ThreadPool& Instance();
+
+    // Runs f on a pool thread. With std::launch::deferred (e.g. for reproducible tests), f runs on the first wait for the
+    // result instead, like with std::async().
+    template <class Function>
+    auto Async(std::launch policy, Function&& f, ThreadPoolPriority priority = ThreadPoolPriority::normal) -> std::future<decltype(f())>
+    {
+        typedef decltype(f()) Result;
+        if (policy == std::launch::deferred)
+            return std::async(std::launch::deferred, std::forward<Function>(f));
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(f));
+        auto result = task->get_future();
+        Post([task]() { (*task)(); }, priority);
+        return result;
+    }
+
+    size_t NumThreads() const;
+
+    // The number of logical CPUs the process may run on, i.e. in its affinity mask when the pool was created, which a
+    // container or taskset may limit to fewer than std::thread::hardware_concurrency().
+    int NumAvailableCpus() const { return (int) m_availableCpus.size(); }
+
+    // Reserves the last numCpus of the available CPUs for the pool threads (at most all but one), and pins the pool
+    // threads to them and the calling thread to the others if 'pin'. Threads that the calling thread starts afterwards
+    // (e.g. those of OpenMP) inherit its affinity. Returns the number of CPUs left for compute.
+    int ReserveBackgroundCpus(int numCpus, bool pin);
+    int NumBackgroundCpus() const { return (int) m_backgroundCpus.size(); }
+    bool PinsThreads() const { return m_pinThreads; }
+
+    // Pins the calling thread to the CPUs that are not reserved; returns false if that failed.
+    bool PinCurrentThreadToComputeCpus() const;
+
+private:
+    ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Post(std::function<void()>&& task, ThreadPoolPriority priority);
+    void WorkerLoop();
+
+    mutable std::mutex m_mutex;                      // guards everything below
+    std::condition_variable m_tasksQueued;
+    std::deque<std::function<void()>> m_queues[2];   // by ThreadPoolPriority
+    size_t m_numThreads;
+    size_t m_numIdleThreads;
+
+    std::vector<int> m_availableCpus;
+    std::vector<int> m_computeCpus;                  // the CPUs are only set by ReserveBackgroundCpus()
+    std::vector<int> m_backgroundCpus;
+    bool m_pinThreads;
+    size_t m_affinityVersion;                        // counts the changes of the CPUs, for the pool threads to follow
+};
+
+}}}
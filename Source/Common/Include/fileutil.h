@@ -17,6 +17,10 @@
 #ifdef __unix__
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#include <io.h> // for _get_osfhandle()
 #endif
 #include <algorithm> // for std::find
 #include <vector>
@@ -135,6 +139,12 @@ void fprintfOrDie(FILE* f, const char* format, ...);
 
 void fflushOrDie(FILE* f);
 
+// ----------------------------------------------------------------------------
+// fsyncOrDie(): like fsync() but terminate with err msg in case of error
+// ----------------------------------------------------------------------------
+
+void fsyncOrDie(FILE* f);
+
 // ----------------------------------------------------------------------------
 // filesize(): determine size of the file in bytes
 // ----------------------------------------------------------------------------
@@ -786,6 +796,68 @@ inline int fclose(auto_file_ptr& af)
     return af.fclose();
 }
 
+// ----------------------------------------------------------------------------
+// mappedfile -- a whole file mapped read-only into memory, e.g. for lattice
+// archives and language models in compiled format. The pages are shared with
+// all processes mapping the same file.
+// ----------------------------------------------------------------------------
+
+class mappedfile
+{
+    void* view;
+    size_t viewsize;
+
+public:
+    mappedfile(const std::wstring& path)
+        : view(nullptr), viewsize(0)
+    {
+        auto_file_ptr f(fopenOrDie(path, L"rb"));
+        viewsize = filesize(f);
+        if (viewsize == 0)
+            RuntimeError("mappedfile: empty file '%ls'", path.c_str());
+#ifdef _WIN32
+        HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(f)));
+        HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+            RuntimeError("mappedfile: error mapping '%ls': error 0x%x", path.c_str(), (unsigned int) GetLastError());
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, viewsize);
+        DWORD error = GetLastError();
+        CloseHandle(mapping); // the view keeps the mapping alive
+        if (view == NULL)
+            RuntimeError("mappedfile: error mapping '%ls': error 0x%x", path.c_str(), (unsigned int) error);
+#else
+        view = mmap(nullptr, viewsize, PROT_READ, MAP_SHARED, fileno(f), 0);
+        if (view == MAP_FAILED)
+        {
+            view = nullptr;
+            RuntimeError("mappedfile: error mapping '%ls': %s", path.c_str(), strerror(errno));
+        }
+#endif
+    } // (the mapping outlives the file handle)
+    ~mappedfile()
+    {
+        if (!view)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(view);
+#else
+        munmap(view, viewsize);
+#endif
+    }
+    const char* begin() const
+    {
+        return static_cast<const char*>(view);
+    }
+    const char* end() const
+    {
+        return begin() + viewsize;
+    }
+
+private:
+    mappedfile(const mappedfile&) = delete;
+    mappedfile& operator=(const mappedfile&) = delete;
+};
+
 namespace msra { namespace files {
 
 // ----------------------------------------------------------------------------
@@ -21,6 +21,7 @@
 #include <string>
 #include <unordered_map>
 #include <algorithm> // for find()
+#include <memory>
 #include "simplesenonehmm.h"
 #include "Matrix.h"
 
@@ -937,6 +938,77 @@ public:
 #endif
     }
 
+    // compiled format (version 3): the lattice as fread() leaves it in memory, i.e. nodes, edges with scores and the full
+    // align[] array after rebuildedges(), with unit ids already mapped to the model's symbol table. Each vector is padded to
+    // a multiple of 8 bytes, so that lattices can be read from a memory-mapped archive without parsing (see readcompiled()).
+    static const size_t compiledversion = 3;
+    static const size_t compiledalignment = 8;
+
+    static void fwritepadding(FILE* f)
+    {
+        static const char zeroes[compiledalignment] = {0};
+        const size_t padding = (compiledalignment - fgetpos(f) % compiledalignment) % compiledalignment;
+        if (padding > 0)
+            fwriteOrDie(zeroes, 1, padding, f);
+    }
+
+    template <class VECTOR>
+    void fwritecompiledvector(FILE* f, const char* tag, const VECTOR& v)
+    {
+        fwritevector(f, tag, v);
+        fwritepadding(f);
+    }
+
+    // write in compiled format; 'f' must be positioned at a multiple of 8 bytes
+    void fwritecompiled(FILE* f)
+    {
+        if (fgetpos(f) % compiledalignment != 0)
+            LogicError("fwritecompiled: lattices must start at a multiple of %d bytes", (int) compiledalignment);
+        fwritetag(f, "LAT ", compiledversion);
+        fwriteOrDie(&info, sizeof(info), 1, f);
+        fwritecompiledvector(f, "NODE", nodes);
+        fwritecompiledvector(f, "EDGE", edges);
+        fwritecompiledvector(f, "ALIG", align);
+        fputTag(f, "END ");
+        fwritepadding(f);
+    }
+
+    // write in compiled format into memory, e.g. to pass lattices through a reader stream (LatticeDeserializer)
+    // The buffer holds the same bytes as fwritecompiled() writes, so it can be read back with readcompiled().
+    void writecompiled(std::vector<char>& buffer) const
+    {
+        buffer.clear();
+        writecompiledtag(buffer, "LAT ", compiledversion);
+        writecompiledbytes(buffer, &info, sizeof(info));
+        writecompiledvector(buffer, "NODE", nodes);
+        writecompiledvector(buffer, "EDGE", edges);
+        writecompiledvector(buffer, "ALIG", align);
+        writecompiledbytes(buffer, "END ", 4);
+    }
+
+private:
+    static void writecompiledtag(std::vector<char>& buffer, const char* tag, size_t n)
+    {
+        const int value = (int) n;
+        buffer.insert(buffer.end(), tag, tag + 4);
+        buffer.insert(buffer.end(), (const char*) &value, (const char*) &value + sizeof(value));
+    }
+
+    static void writecompiledbytes(std::vector<char>& buffer, const void* data, size_t bytes)
+    {
+        buffer.insert(buffer.end(), (const char*) data, (const char*) data + bytes);
+        buffer.resize((buffer.size() + compiledalignment - 1) / compiledalignment * compiledalignment, 0);
+    }
+
+    template <class VECTOR>
+    static void writecompiledvector(std::vector<char>& buffer, const char* tag, const VECTOR& v)
+    {
+        writecompiledtag(buffer, tag, v.size());
+        if (!v.empty())
+            writecompiledbytes(buffer, &v[0], v.size() * sizeof(v[0]));
+    }
+
+public:
     // empty constructor, e.g. for use in minibatch source
     lattice()
     {
@@ -1063,6 +1135,72 @@ public:
             RuntimeError("fread: unsupported lattice format version");
     }
 
+    // read a lattice in compiled format from memory [p, end), e.g. from a memory-mapped archive (see fwritecompiled())
+    // Each vector is taken over with a single copy. Unit ids are only mapped if 'idmap' is not the identity, which it is for
+    // archives compiled against the same model.
+    template <class IDMAP>
+    void readcompiled(const char* p, const char* end, const IDMAP& idmap, size_t spunit)
+    {
+        if (readcompiledtag(p, end, "LAT ") != compiledversion)
+            RuntimeError("readcompiled: not a lattice in compiled format");
+        readcompiledbytes(p, end, &info, sizeof(info));
+        readcompiledvector(p, end, "NODE", nodes, info.numnodes);
+        if (nodes.empty() || nodes.back().t != info.numframes)
+            RuntimeError("readcompiled: mismatch between info.numframes and last node's time");
+        readcompiledvector(p, end, "EDGE", edges, info.numedges);
+        readcompiledvector(p, end, "ALIG", align);
+        if (end - p < 4 || strncmp(p, "END ", 4) != 0)
+            RuntimeError("readcompiled: malformed lattice, END tag missing");
+
+        // map align ids to user's symmap unless the archive was compiled against it
+        bool needsmapping = false;
+        foreach_index (k, idmap)
+        {
+            if (idmap[k] != (size_t) k && (k != (int) idmap.size() - 1 || idmap[k] != spunit)) // (the /sp/ entry that getcachedidmap() appends)
+            {
+                needsmapping = true;
+                break;
+            }
+        }
+        if (needsmapping)
+        {
+            foreach_index (k, align)
+                align[k].updateunit(idmap); // updates itself
+        }
+    }
+
+private:
+    static size_t readcompiledtag(const char*& p, const char* end, const char* tag)
+    {
+        if (end - p < 8 || strncmp(p, tag, 4) != 0)
+            RuntimeError("readcompiled: malformed lattice, expected tag %s", tag);
+        int n;
+        memcpy(&n, p + 4, sizeof(n));
+        p += 8;
+        return (unsigned int) n;
+    }
+
+    static void readcompiledbytes(const char*& p, const char* end, void* buffer, size_t bytes)
+    {
+        if ((size_t) (end - p) < bytes)
+            RuntimeError("readcompiled: malformed lattice, unexpected end of archive");
+        memcpy(buffer, p, bytes);
+        p += (bytes + compiledalignment - 1) / compiledalignment * compiledalignment;
+    }
+
+    template <class VECTOR>
+    static void readcompiledvector(const char*& p, const char* end, const char* tag, VECTOR& v, size_t expectedsize = SIZE_MAX)
+    {
+        const size_t sz = readcompiledtag(p, end, tag);
+        if (expectedsize != SIZE_MAX && sz != expectedsize)
+            RuntimeError("readcompiled: malformed file, number of vector elements differs from head, for tag %s", tag);
+        v.resize(sz);
+        if (sz > 0)
+            readcompiledbytes(p, end, &v[0], sz * sizeof(v[0]));
+    }
+
+public:
+
     // parallel versions (defined in parallelforwardbackward.cpp)
     class parallelstate
     {
@@ -1107,6 +1245,19 @@ public:
                            const float lmf, const float wp, const float amf, const float boostingfactor, const bool sMBRmode, array_ref<size_t> uids, const_array_ref<size_t> bounds = const_array_ref<size_t>(),
                            const_array_ref<htkmlfwordsequence::word> transcript = const_array_ref<htkmlfwordsequence::word>(), const std::vector<float>& transcriptunigrams = std::vector<float>()) const;
 
+    // batched forward-backward on the GPU (parallelstate must be enabled) for all lattices of a minibatch: same as calling
+    // forwardbackward() for each without reference alignment, but the lattices are concatenated into batches that take one
+    // kernel launch per step for all of them. logLLs, uids and result hold the frames of all lattices, concatenated in order.
+    // Returns the value forwardbackward() would return for each lattice in avlogps.
+    static void parallelforwardbackwardbatch(parallelstate& parallelstate, const std::vector<const lattice*>& lattices,
+                                             const class msra::asr::simplesenonehmm& hset, const Microsoft::MSR::CNTK::Matrix<float>& logLLs,
+                                             Microsoft::MSR::CNTK::Matrix<float>& result, const float lmf, const float wp, const float amf,
+                                             const float boostingfactor, const bool sMBRmode, const_array_ref<size_t> uids, std::vector<double>& avlogps);
+    static void parallelforwardbackwardbatch(parallelstate& parallelstate, const std::vector<const lattice*>& lattices,
+                                             const class msra::asr::simplesenonehmm& hset, const Microsoft::MSR::CNTK::Matrix<double>& logLLs,
+                                             Microsoft::MSR::CNTK::Matrix<double>& result, const float lmf, const float wp, const float amf,
+                                             const float boostingfactor, const bool sMBRmode, const_array_ref<size_t> uids, std::vector<double>& avlogps);
+
     std::wstring key; // (keep our own name (key) so we can identify ourselves for diagnostics messages)
     const wchar_t* getkey() const
     {
@@ -1212,6 +1363,8 @@ class archive
 
     mutable size_t currentarchiveindex;               // which archive is open
     mutable auto_file_ptr f;                          // cached archive file handle of currentarchiveindex
+    mutable std::vector<std::unique_ptr<mappedfile>> mappedarchives; // [archiveindex] -> mapping of archives in compiled format
+    mutable std::vector<bool> formatknown;                            // [archiveindex] -> true once we looked at the format
     std::unordered_map<std::wstring, latticeref> toc; // [key] -> (file, offset)  --table of content (.toc file)
 public:
     // construct = open the archive
@@ -1293,6 +1446,32 @@ public:
 
         // initialize symmaps  --alloc the array, but actually read the symmap on demand
         symmaps.resize(archivepaths.size());
+        mappedarchives.resize(archivepaths.size());
+        formatknown.resize(archivepaths.size(), false);
+    }
+
+    // get the mapping of an archive if it is in compiled format (lattice::fwritecompiled()), else nullptr
+    // An archive is in compiled format if its first lattice is.
+    const mappedfile* getmappedarchive(size_t archiveindex) const
+    {
+        if (!formatknown[archiveindex])
+        {
+            char head[8] = {0};
+            {
+                auto_file_ptr fhead(fopenOrDie(archivepaths[archiveindex], L"rb"));
+                ::fread(head, 1, sizeof(head), fhead);
+            }
+            int version;
+            memcpy(&version, head + 4, sizeof(version));
+            if (strncmp(head, "LAT ", 4) == 0 && version == (int) lattice::compiledversion)
+            {
+                if (verbosity > 0)
+                    fprintf(stderr, "getmappedarchive: mapping compiled archive '%ls'\n", archivepaths[archiveindex].c_str());
+                mappedarchives[archiveindex].reset(new mappedfile(archivepaths[archiveindex]));
+            }
+            formatknown[archiveindex] = true;
+        }
+        return mappedarchives[archiveindex].get();
     }
 
     // check if a lattice for a given key is available  --do this during initial check ideally
@@ -1335,30 +1514,41 @@ public:
         if (spunit2 != spunit)
             LogicError("getlattice: huh? same lookup of /sp/ gives different result?");
 #endif
-        // open archive file in case it is not the current one
-        if (archiveindex != currentarchiveindex)
+        // compiled archives are read from memory
+        if (const mappedfile* mapped = getmappedarchive(archiveindex))
         {
-            f = fopenOrDie(archivepaths[archiveindex], L"rbS"); // or throw (will close old 'f' iff succeeded)
-            currentarchiveindex = archiveindex;
+            if (offset >= (uint64_t) (mapped->end() - mapped->begin()))
+                RuntimeError("getlattice: TOC offset beyond end of archive '%ls'", archivepaths[archiveindex].c_str());
+            L.readcompiled(mapped->begin() + offset, mapped->end(), idmap, spunit);
+            L.setverbosity(verbosity);
         }
-        try // (for read operation)
+        else
         {
-            // seek to start
-            fsetpos(f, offset);
-            // get it
-            L.fread(f, idmap, spunit);
-            L.setverbosity(verbosity);
+            // open archive file in case it is not the current one
+            if (archiveindex != currentarchiveindex)
+            {
+                f = fopenOrDie(archivepaths[archiveindex], L"rbS"); // or throw (will close old 'f' iff succeeded)
+                currentarchiveindex = archiveindex;
+            }
+            try // (for read operation)
+            {
+                // seek to start
+                fsetpos(f, offset);
+                // get it
+                L.fread(f, idmap, spunit);
+                L.setverbosity(verbosity);
 #ifdef HACK_IN_SILENCE // hack to simulate DEL in the lattice
-            const size_t silunit = getid(modelsymmap, "sil");
-            const bool addsp = true;
-            L.hackinsilencesubstitutionedges(silunit, spunit, addsp);
+                const size_t silunit = getid(modelsymmap, "sil");
+                const bool addsp = true;
+                L.hackinsilencesubstitutionedges(silunit, spunit, addsp);
 #endif
-        }
-        catch (...) // to retry a read error due to a disconnected file handle, we need to reopen the file
-        {
-            currentarchiveindex = SIZE_MAX;
-            f = NULL; // this closes the file handle
-            throw;
+            }
+            catch (...) // to retry a read error due to a disconnected file handle, we need to reopen the file
+            {
+                currentarchiveindex = SIZE_MAX;
+                f = NULL; // this closes the file handle
+                throw;
+            }
         }
         // check if number of frames is as expected
         if (expectedframes != SIZE_MAX && L.getnumframes() != expectedframes)
@@ -1367,6 +1557,60 @@ public:
         L.key = key;
     };
 
+    // Concurrent reading, e.g. by the LatticeDeserializer, which loads the lattices of a chunk on several threads.
+    // getlattice() keeps the current archive open and loads symbol maps lazily, so only one thread may call it at a time.
+    // After preparereading(), readlattice() does not change the archive object and can be called from several threads,
+    // each with its own handle 'f' on the archive file (unused for archives in compiled format, which are memory-mapped).
+    void preparereading() const
+    {
+        for (size_t archiveindex = 0; archiveindex < archivepaths.size(); archiveindex++)
+        {
+            getcachedidmap(archiveindex, modelsymmap);
+            getmappedarchive(archiveindex);
+        }
+    }
+
+    size_t getnumarchives() const
+    {
+        return archivepaths.size();
+    }
+
+    const std::wstring& getarchivepath(size_t archiveindex) const
+    {
+        return archivepaths[archiveindex];
+    }
+
+    bool iscompiled(size_t archiveindex) const
+    {
+        return getmappedarchive(archiveindex) != nullptr;
+    }
+
+    // call f(key, archiveindex, offset) for each lattice in the TOC, in no particular order
+    template <class FUNCTION>
+    void foreachlattice(const FUNCTION& f) const
+    {
+        for (const auto& entry : toc)
+            f(entry.first, (size_t) entry.second.archiveindex, (uint64_t) entry.second.offset);
+    }
+
+    void readlattice(size_t archiveindex, uint64_t offset, FILE* f, lattice& L) const
+    {
+        const auto& idmap = getcachedidmap(archiveindex, modelsymmap);
+        const size_t spunit = idmap.back();
+        if (const mappedfile* mapped = getmappedarchive(archiveindex))
+        {
+            if (offset >= (uint64_t) (mapped->end() - mapped->begin()))
+                RuntimeError("readlattice: TOC offset beyond end of archive '%ls'", archivepaths[archiveindex].c_str());
+            L.readcompiled(mapped->begin() + offset, mapped->end(), idmap, spunit);
+        }
+        else
+        {
+            fsetpos(f, offset);
+            L.fread(f, idmap, spunit);
+        }
+        L.setverbosity(verbosity);
+    }
+
     // static method for building an archive
     static void build(const std::vector<std::wstring>& infiles, const std::wstring& outpath,
                       const std::unordered_map<std::string, size_t>& modelsymmap,
@@ -1380,6 +1624,11 @@ public:
     //  - merge two lattices (for merging numer into denom lattices)
     static void convert(const std::wstring& intocpath, const std::wstring& intocpath2, const std::wstring& outpath,
                         const msra::asr::simplesenonehmm& hset);
+
+    // static method for compiling an archive for fast loading (lattice::fwritecompiled())
+    // The lattices are stored as they are used, with unit ids mapped to the model's symbol table, so reading them from the
+    // memory-mapped output archive takes neither parsing nor rebuildedges(). Use the same model for training.
+    static void compile(const std::wstring& intocpath, const std::wstring& outpath, const msra::asr::simplesenonehmm& hset);
 };
 };
 };
@@ -4,9 +4,24 @@
 //
 #include "Include/Basics.h"
 #include "Include/MPIWrapper.h"
+#include "PerformanceProfiler.h"
+#include "TimerUtility.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
 
 #if HAS_MPI
 #pragma comment(lib, "msmpi.lib")
+// the extensions of the MPI library, if it provides them: ULFM fault tolerance (MPIX_Comm_shrink() etc.)
+// and the query for CUDA-aware MPI (MPIX_Query_cuda_support(), Open MPI)
+#if defined(__has_include)
+#if __has_include(<mpi-ext.h>)
+#include <mpi-ext.h>
+#endif
+#endif
+#if defined(MPIX_ERR_PROC_FAILED)
+#define HAS_MPI_ULFM 1
+#endif
 #else
 #define MPI_SUCCESS             0
 #define MPI_ERR_INTERN          1
@@ -33,6 +48,42 @@ class MPIWrapperMpi : public MPIWrapper
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    // Host of each node in use, and the communicators of the nodes of the current host
+    // and of the nodes with the same rank on their host (split from m_currentComm)
+    std::vector<size_t> m_hostIndexOfNodes;
+    MPI_Comm m_hostComm;
+    MPI_Comm m_crossHostComm;
+    int m_rankOnHost;
+    int m_numNodesOnHost;
+
+    // Failures of nodes are reported to the caller (MPI_ERRORS_RETURN) instead of aborting the job
+    bool m_faultTolerant;
+
+    // All nodes in use pass GPU memory to MPI directly, see InitGpuGdr()
+    bool m_useGpuGdr;
+
+    // windows for one-sided access, see CreateWindow(); each is in a passive-target epoch (MPI_Win_lock_all) while it exists
+    std::vector<MPI_Win> m_windows;
+
+    size_t CreateWindow(void* base, size_t numElements, int elementSize);
+    void FetchAndAdd(size_t window, const void* data, void* result, size_t numElements, MPI_Datatype datatype, size_t targetRank, size_t targetOffset);
+
+    // Profiling of the collectives, see ProfilerCommEnd(). Non-blocking collectives are recorded when one of
+    // the Wait functions finds them completed. Numbers of elements are per node for allgather and reduce-scatter.
+    struct PendingCollective
+    {
+        int eventId;
+        const char* algorithm;
+        long long bytes;
+        long long beginClock;
+    };
+    mutable std::map<MPI_Request, PendingCollective> m_pendingCollectives;
+    mutable std::mutex m_pendingCollectivesMutex;
+
+    void ProfileCollective(long long beginClock, int eventId, const char* algorithm, size_t numElements, MPI_Datatype datatype, MPI_Comm comm) const;
+    void ProfileStart(const MPI_Request* request, long long beginClock, int eventId, size_t numElements, MPI_Datatype datatype) const;
+    void ProfileCompletion(const MPI_Request* requests, int numRequests, long long waitBeginClock) const;
+
     // MPI_Init() is loading the msmpi.dll. Failing to load the dll will terminate the
     // application.
     int MPI_Init_DL();
@@ -60,6 +111,15 @@ private:
 
     void RequestNodes(const char *msg, size_t requestednodes = SIZE_MAX /*default: all*/);
 
+    // Determines the hosts of the nodes in use and splits the communicators by host, see RequestNodes().
+    void InitHostTopology(const char *msg);
+
+    // Continues with the nodes of the given communicator, after a failure or when nodes were added.
+    void SetCommunicator(MPI_Comm comm, const char *msg);
+
+    // Determines whether the MPI library of every node in use can access GPU memory, see UseGpuGdr().
+    void InitGpuGdr(const char *msg);
+
 public:
 
     size_t NumNodesInUse() const;
@@ -70,10 +130,20 @@ public:
     bool UsingAllNodes() const;
     size_t MainNodeRank() const;
     bool IsMultiHost() const;
+    const std::vector<size_t>& HostIndexOfNodes() const;
+    size_t NumNodesOnCurrentHost() const;
+    size_t CurrentNodeRankOnHost() const;
 
     // Use GPUDirect RDMA support
     virtual bool UseGpuGdr() override;
 
+    bool EnableFaultTolerance();
+    bool IsFaultTolerant() const;
+    void RecoverFromFailure();
+    std::string OpenPort();
+    void AcceptNodes(const std::string& portName);
+    void JoinNodes(const std::string& portName);
+
     // -----------------------------------------------------------------------
     // data-exchange functions (wrappers around MPI functions)
     // -----------------------------------------------------------------------
@@ -131,6 +201,7 @@ public:
     virtual void AllGather(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements) const;
     virtual void AllGather(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements) const;
     virtual void Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype) const;
+    virtual void Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[], const int displs[], MPI_Datatype recvtype) const;
 
     virtual void Gather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, size_t rootRank) const;
     virtual void Gather(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements, size_t rootRank) const;
@@ -143,6 +214,22 @@ public:
     virtual void Gatherv(const float *sendData, size_t numSendElements, float *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
     virtual void Gatherv(const double *sendData, size_t numSendElements, double *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
 
+    virtual void ReduceScatterWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const;
+    virtual void ReduceScatterWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const;
+    virtual void AllGatherWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const;
+    virtual void AllGatherWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const;
+    virtual void AllReduceAcrossHosts(float* data, size_t numElements) const;
+    virtual void AllReduceAcrossHosts(double* data, size_t numElements) const;
+
+    virtual size_t CreateWindow(float* base, size_t numElements);
+    virtual size_t CreateWindow(double* base, size_t numElements);
+    virtual size_t CreateWindow(size_t* base, size_t numElements);
+    virtual void FreeWindow(size_t window);
+    virtual void FetchAndAdd(size_t window, const float* data, float* result, size_t numElements, size_t targetRank, size_t targetOffset);
+    virtual void FetchAndAdd(size_t window, const double* data, double* result, size_t numElements, size_t targetRank, size_t targetOffset);
+    virtual void FetchAndAdd(size_t window, const size_t* data, size_t* result, size_t numElements, size_t targetRank, size_t targetOffset);
+    virtual void FlushWindow(size_t window);
+
     // wait for all ranks to reach here
     virtual int WaitAll();
     virtual void WaitAny(MPI_Request* requests, int numRequests, int* index);
@@ -168,9 +255,19 @@ public:
     bool UsingAllNodes() const;
     size_t MainNodeRank() const;
     bool IsMultiHost() const;
+    const std::vector<size_t>& HostIndexOfNodes() const;
+    size_t NumNodesOnCurrentHost() const;
+    size_t CurrentNodeRankOnHost() const;
     // Use GPUDirect RDMA
     virtual bool UseGpuGdr() override;
 
+    bool EnableFaultTolerance();
+    bool IsFaultTolerant() const;
+    void RecoverFromFailure();
+    std::string OpenPort();
+    void AcceptNodes(const std::string& portName);
+    void JoinNodes(const std::string& portName);
+
     // -----------------------------------------------------------------------
     // data-exchange functions (wrappers around MPI functions)
     // -----------------------------------------------------------------------
@@ -223,6 +320,7 @@ public:
     virtual void AllGatherAsync(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements, MPI_Request* request) const;
     virtual void AllGatherAsync(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements, MPI_Request* request) const;
     virtual void Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype) const;
+    virtual void Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[], const int displs[], MPI_Datatype recvtype) const;
 
     virtual void AllGather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements) const;
     virtual void AllGather(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements) const;
@@ -240,11 +338,30 @@ public:
     virtual void Gatherv(const float *sendData, size_t numSendElements, float *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
     virtual void Gatherv(const double *sendData, size_t numSendElements, double *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
 
+    virtual void ReduceScatterWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const;
+    virtual void ReduceScatterWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const;
+    virtual void AllGatherWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const;
+    virtual void AllGatherWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const;
+    virtual void AllReduceAcrossHosts(float* data, size_t numElements) const;
+    virtual void AllReduceAcrossHosts(double* data, size_t numElements) const;
+
+    virtual size_t CreateWindow(float* base, size_t numElements);
+    virtual size_t CreateWindow(double* base, size_t numElements);
+    virtual size_t CreateWindow(size_t* base, size_t numElements);
+    virtual void FreeWindow(size_t window);
+    virtual void FetchAndAdd(size_t window, const float* data, float* result, size_t numElements, size_t targetRank, size_t targetOffset);
+    virtual void FetchAndAdd(size_t window, const double* data, double* result, size_t numElements, size_t targetRank, size_t targetOffset);
+    virtual void FetchAndAdd(size_t window, const size_t* data, size_t* result, size_t numElements, size_t targetRank, size_t targetOffset);
+    virtual void FlushWindow(size_t window);
+
     // wait for all ranks to reach here
     virtual int WaitAll();
     virtual void WaitAny(MPI_Request* requests, int numRequests, int* index);
     virtual void Wait(MPI_Request* request);
     virtual int WaitAll(std::vector<MPI_Request>& requests);
+
+private:
+    std::vector<void*> m_windows; // see CreateWindow()
 };
 
 
@@ -285,6 +402,14 @@ int operator||(int rc, const MpiFail &what)
 
     if (MPIWrapper::s_mpi != nullptr)
     {
+#if HAS_MPI_ULFM
+        // a failed node is not fatal in elastic training, the surviving nodes recover from it
+        int errorClass = MPI_SUCCESS;
+        MPI_Error_class(rc, &errorClass);
+        if (MPIWrapper::s_mpi->IsFaultTolerant() && (errorClass == MPIX_ERR_PROC_FAILED || errorClass == MPIX_ERR_REVOKED))
+            throw MpiProcessFailure(what);
+#endif
+
         // (special case: we use that code to indicate a missing msmpi.dll...)
         if (rc != MPI_ERR_INTERN)
         {
@@ -386,6 +511,24 @@ int MPIWrapper::GetTotalNumberOfMPINodes()
 #endif
 }
 
+// The nodes leave a barrier at about the same time, right after which the main node broadcasts its time stamp.
+// The median over several rounds discards rounds in which a node was delayed.
+long long EstimateClockOffsetToMainNode(MPIWrapper& mpi)
+{
+    const int numRounds = 7;
+    std::vector<long long> offsets;
+    for (int i = 0; i < numRounds; i++)
+    {
+        mpi.WaitAll();
+        long long localTime = Clock::GetTimeStamp();
+        size_t mainTime = (size_t)localTime;
+        mpi.Bcast(&mainTime, 1, mpi.MainNodeRank());
+        offsets.push_back((long long)mainTime - localTime);
+    }
+    std::nth_element(offsets.begin(), offsets.begin() + numRounds / 2, offsets.end());
+    return offsets[numRounds / 2];
+}
+
 #if HAS_MPI
 // -----------------------------------------------------------------------
 // MPIWrapper that actually calls into msmpi.dll
@@ -394,7 +537,7 @@ int MPIWrapper::GetTotalNumberOfMPINodes()
 int MPIWrapperMpi::s_myRank = -1;
 
 MPIWrapperMpi::MPIWrapperMpi()
-    : m_currentComm(MPI_COMM_WORLD)
+    : m_currentComm(MPI_COMM_WORLD), m_hostComm(MPI_COMM_NULL), m_crossHostComm(MPI_COMM_NULL), m_rankOnHost(0), m_numNodesOnHost(1), m_faultTolerant(false), m_useGpuGdr(false)
 {
     static bool initialized = false;
     if (initialized)
@@ -447,6 +590,8 @@ MPIWrapperMpi::MPIWrapperMpi()
     // do an initial handshake
     Ping("mpihelper");
 
+    InitGpuGdr("mpihelper");
+
     // stagger the jobs just a little to get a sort-of deterministic order e.g. in GPU allocation when running on one machine
     // continue 0.5 seconds apart
     ::Sleep((DWORD)(500 * CurrentNodeRank()));
@@ -584,6 +729,16 @@ void MPIWrapperMpi::RequestNodes(const char *msg, size_t requestednodes /*defaul
     }
     Ping("requestnodes (after change)");
 
+    InitHostTopology(msg);
+
+    fprintf(stderr, "requestnodes [%s]: using %d out of %d MPI nodes on %s (%d requested); we (%d) are %s\n",
+        msg, (int)m_numNodesInUse, (int)m_numMPINodes, m_multiHost ? "multiple hosts" : "a single host",
+        (int)requestednodes, (int)CurrentNodeRank(), IsIdle() ? "out (idle)" : "in (participating)");
+    fflush(stderr);
+}
+
+void MPIWrapperMpi::InitHostTopology(const char *msg)
+{
     // If all ranks run on a single host, we can enable optimized communication
     // paths (e.g. NCCL). To determine if a single machine is being used, we
     // check that MPI_Get_processor_name matches for all ranks.
@@ -608,17 +763,133 @@ void MPIWrapperMpi::RequestNodes(const char *msg, size_t requestednodes /*defaul
         }
     }
 
-    fprintf(stderr, "requestnodes [%s]: using %d out of %d MPI nodes on %s (%d requested); we (%d) are %s\n",
-        msg, (int)m_numNodesInUse, (int)m_numMPINodes, m_multiHost ? "multiple hosts" : "a single host",
-        (int)requestednodes, (int)CurrentNodeRank(), IsIdle() ? "out (idle)" : "in (participating)");
+    // Number the hosts in the order of their lowest rank, and split the communicator by host and by rank on the host,
+    // for the hierarchical (within host, then across hosts) collectives.
+    m_hostIndexOfNodes.assign(m_numNodesInUse, 0);
+    size_t numHosts = 0;
+    for (size_t i = 0; i < m_numNodesInUse; i++)
+    {
+        size_t j = 0;
+        while (j < i && strcmp(allNames + i*nameMax, allNames + j*nameMax) != 0)
+            j++;
+        m_hostIndexOfNodes[i] = (j < i) ? m_hostIndexOfNodes[j] : numHosts++;
+    }
+
+    if (m_hostComm != MPI_COMM_NULL)
+        MPI_Comm_free(&m_hostComm) || MpiFail("requestnodes: MPI_Comm_free");
+    if (m_crossHostComm != MPI_COMM_NULL)
+        MPI_Comm_free(&m_crossHostComm) || MpiFail("requestnodes: MPI_Comm_free");
+
+    MPI_Comm_split(m_currentComm, (int)m_hostIndexOfNodes[CurrentNodeRank()], (int)CurrentNodeRank(), &m_hostComm) || MpiFail("requestnodes: MPI_Comm_split");
+    MPI_Comm_rank(m_hostComm, &m_rankOnHost) || MpiFail("requestnodes: MPI_Comm_rank");
+    MPI_Comm_size(m_hostComm, &m_numNodesOnHost) || MpiFail("requestnodes: MPI_Comm_size");
+    MPI_Comm_split(m_currentComm, m_rankOnHost, (int)CurrentNodeRank(), &m_crossHostComm) || MpiFail("requestnodes: MPI_Comm_split");
+}
+
+void MPIWrapperMpi::SetCommunicator(MPI_Comm comm, const char *msg)
+{
+    if (m_currentComm != MPI_COMM_WORLD)
+        MPI_Comm_free(&m_currentComm);
+    m_currentComm = comm;
+    if (m_faultTolerant)
+        MPI_Comm_set_errhandler(m_currentComm, MPI_ERRORS_RETURN) || MpiFail("setcommunicator: MPI_Comm_set_errhandler");
+
+    MPI_Comm_rank(m_currentComm, &m_myRank) || MpiFail("setcommunicator: MPI_Comm_rank");
+    MPI_Comm_size(m_currentComm, &m_numMPINodes) || MpiFail("setcommunicator: MPI_Comm_size");
+    m_numNodesInUse = m_numMPINodes;
+    s_myRank = m_myRank;
+
+    InitHostTopology(msg);
+    InitGpuGdr(msg);
+
+    fprintf(stderr, "%s: continuing with %d MPI nodes on %s; we are node %d\n",
+        msg, (int)m_numNodesInUse, m_multiHost ? "multiple hosts" : "a single host", (int)CurrentNodeRank());
     fflush(stderr);
 }
 
+bool MPIWrapperMpi::EnableFaultTolerance()
+{
+#if HAS_MPI_ULFM
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN) || MpiFail("enablefaulttolerance: MPI_Comm_set_errhandler");
+    for (MPI_Comm comm : { m_currentComm, m_hostComm, m_crossHostComm })
+    {
+        if (comm != MPI_COMM_NULL)
+            MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN) || MpiFail("enablefaulttolerance: MPI_Comm_set_errhandler");
+    }
+    m_faultTolerant = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool MPIWrapperMpi::IsFaultTolerant() const
+{
+    return m_faultTolerant;
+}
+
+void MPIWrapperMpi::RecoverFromFailure()
+{
+#if HAS_MPI_ULFM
+    if (!m_faultTolerant)
+        LogicError("RecoverFromFailure: fault tolerance is not enabled.");
+
+    // Revoking makes the operations of the surviving nodes that did not notice the failure yet fail as well,
+    // so that all of them get here. Shrinking is fault tolerant itself, nodes that fail meanwhile are left out.
+    MPIX_Comm_revoke(m_currentComm);
+    MPI_Comm survivors;
+    MPIX_Comm_shrink(m_currentComm, &survivors) || MpiFail("recoverfromfailure: MPIX_Comm_shrink");
+    SetCommunicator(survivors, "recoverfromfailure");
+#else
+    LogicError("RecoverFromFailure: the MPI library does not support fault tolerance.");
+#endif
+}
+
+std::string MPIWrapperMpi::OpenPort()
+{
+    char portName[MPI_MAX_PORT_NAME + 1] = { 0 };
+    MPI_Open_port(MPI_INFO_NULL, portName) || MpiFail("openport: MPI_Open_port");
+    return portName;
+}
+
+void MPIWrapperMpi::AcceptNodes(const std::string& portName)
+{
+    MPI_Comm newNodes, merged;
+    MPI_Comm_accept(portName.c_str(), MPI_INFO_NULL, (int)MainNodeRank(), m_currentComm, &newNodes) || MpiFail("acceptnodes: MPI_Comm_accept");
+    MPI_Intercomm_merge(newNodes, 0 /*nodes in use first*/, &merged) || MpiFail("acceptnodes: MPI_Intercomm_merge");
+    MPI_Comm_free(&newNodes);
+    SetCommunicator(merged, "acceptnodes");
+}
+
+void MPIWrapperMpi::JoinNodes(const std::string& portName)
+{
+    MPI_Comm nodesInUse, merged;
+    MPI_Comm_connect(portName.c_str(), MPI_INFO_NULL, (int)MainNodeRank(), m_currentComm, &nodesInUse) || MpiFail("joinnodes: MPI_Comm_connect");
+    MPI_Intercomm_merge(nodesInUse, 1 /*new nodes last*/, &merged) || MpiFail("joinnodes: MPI_Intercomm_merge");
+    MPI_Comm_free(&nodesInUse);
+    SetCommunicator(merged, "joinnodes");
+}
+
 bool MPIWrapperMpi::IsMultiHost() const
 {
     return m_multiHost;
 }
 
+const std::vector<size_t>& MPIWrapperMpi::HostIndexOfNodes() const
+{
+    return m_hostIndexOfNodes;
+}
+
+size_t MPIWrapperMpi::NumNodesOnCurrentHost() const
+{
+    return m_numNodesOnHost;
+}
+
+size_t MPIWrapperMpi::CurrentNodeRankOnHost() const
+{
+    return m_rankOnHost;
+}
+
 MPI_Comm MPIWrapperMpi::Communicator() const
 {
     return m_currentComm;
@@ -637,22 +908,39 @@ int MPIWrapperMpi::WaitAll()
 
 int MPIWrapperMpi::Wait(MPI_Request* request, MPI_Status* status)
 {
-    return MPI_Wait(request, status);
+    MPI_Request started = *request;
+    auto profWait = ProfilerTimeBegin();
+    int rc = MPI_Wait(request, status);
+    ProfileCompletion(&started, 1, profWait);
+    return rc;
 }
 
 int MPIWrapperMpi::WaitAll(std::vector<MPI_Request>& requests)
 {
-    return MPI_Waitall((int)requests.size(), &requests[0], MPI_STATUSES_IGNORE) || MpiFail("waitall: MPI_Waitall");
+    std::vector<MPI_Request> started(requests);
+    auto profWait = ProfilerTimeBegin();
+    int rc = MPI_Waitall((int)requests.size(), &requests[0], MPI_STATUSES_IGNORE) || MpiFail("waitall: MPI_Waitall");
+    ProfileCompletion(started.data(), (int)started.size(), profWait);
+    return rc;
 }
 
 int MPIWrapperMpi::Waitany(int count, MPI_Request array_of_requests[], int* index, MPI_Status* status)
 {
-    return MPI_Waitany(count, array_of_requests, index, status);
+    std::vector<MPI_Request> started(array_of_requests, array_of_requests + count);
+    auto profWait = ProfilerTimeBegin();
+    int rc = MPI_Waitany(count, array_of_requests, index, status);
+    if (rc == MPI_SUCCESS && *index != MPI_UNDEFINED)
+        ProfileCompletion(&started[*index], 1, profWait);
+    return rc;
 }
 
 int MPIWrapperMpi::Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[])
 {
-    return MPI_Waitall(count, array_of_requests, array_of_statuses);
+    std::vector<MPI_Request> started(array_of_requests, array_of_requests + count);
+    auto profWait = ProfilerTimeBegin();
+    int rc = MPI_Waitall(count, array_of_requests, array_of_statuses);
+    ProfileCompletion(started.data(), count, profWait);
+    return rc;
 }
 
 int MPIWrapperMpi::Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Request* request)
@@ -672,7 +960,11 @@ int MPIWrapperMpi::Irecv(void* buf, int count, MPI_Datatype datatype, int source
 
 int MPIWrapperMpi::Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Request* request)
 {
-    return MPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, m_currentComm, request);
+    auto profState = ProfilerTimeBegin();
+    int rc = MPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, m_currentComm, request);
+    if (rc == MPI_SUCCESS)
+        ProfileStart(request, profState, profilerEvtCommAllReduce, count, datatype);
+    return rc;
 }
 
 int MPIWrapperMpi::Abort(int errorcode)
@@ -688,12 +980,34 @@ int MPIWrapperMpi::Error_string(int errorcode, char* str, int* resultlen)
 
 bool MPIWrapperMpi::UseGpuGdr()
 {
-    // Only support GPUDirect RDMA on Unix and built with GDR
-#if defined(USE_CUDA_GDR) && defined(__unix__)
-    return true;
+    return m_useGpuGdr;
+}
+
+// GPU memory is passed to MPI directly if the build asserts GPUDirect RDMA (Unix only), or if the MPI library
+// reports at runtime that it is CUDA-aware. This saves the copies to and from pinned host memory for the
+// gradients when NCCL is not used. All nodes must agree, since they then take different code paths
+// (e.g. blocking instead of non-blocking allreduce), hence the allreduce of the local support.
+void MPIWrapperMpi::InitGpuGdr(const char *msg)
+{
+#if defined(CPUONLY)
+    int supported = 0;
+#elif defined(USE_CUDA_GDR) && defined(__unix__)
+    int supported = 1;
+#elif defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+    int supported = MPIX_Query_cuda_support() ? 1 : 0;
 #else
-    return false;
+    int supported = 0;
 #endif
+    int allSupported = supported;
+    MPI_Allreduce(&supported, &allSupported, 1, MPI_INT, MPI_MIN, m_currentComm) || MpiFail("initgpugdr: MPI_Allreduce");
+
+    if (supported && !allSupported)
+        fprintf(stderr, "%s: WARNING: not all nodes support CUDA-aware MPI, copying GPU data to host memory for MPI\n", msg);
+    else if (allSupported && (GetMathLibTraceLevel() > 0 || !m_useGpuGdr))
+        fprintf(stderr, "%s: CUDA-aware MPI, passing GPU memory to MPI directly\n", msg);
+    fflush(stderr);
+
+    m_useGpuGdr = allSupported != 0;
 }
 
 size_t MPIWrapperMpi::NumNodesInUse() const
@@ -791,27 +1105,37 @@ void MPIWrapperMpi::AllReduce(float* sendData, size_t numElements, MPI_Op op) co
 
 void MPIWrapperMpi::AllReduce(size_t* sendData, size_t* receiveData, size_t numElements, MPI_Op op) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+    ProfileCollective(profState, profilerEvtCommAllReduce, "mpi", (int)numElements, GetDataType(sendData), Communicator());
 }
 
 void MPIWrapperMpi::AllReduce(int* sendData, int* receiveData, size_t numElements, MPI_Op op) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+    ProfileCollective(profState, profilerEvtCommAllReduce, "mpi", (int)numElements, GetDataType(sendData), Communicator());
 }
 
 void MPIWrapperMpi::AllReduce(double* sendData, double* receiveData, size_t numElements, MPI_Op op) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+    ProfileCollective(profState, profilerEvtCommAllReduce, "mpi", (int)numElements, GetDataType(sendData), Communicator());
 }
 
 void MPIWrapperMpi::AllReduce(float* sendData, float* receiveData, size_t numElements, MPI_Op op) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+    ProfileCollective(profState, profilerEvtCommAllReduce, "mpi", (int)numElements, GetDataType(sendData), Communicator());
 }
 
 void MPIWrapperMpi::Bcast(size_t* sendData, size_t numElements, size_t srcRank)
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Bcast(sendData, (int)numElements, GetDataType(sendData), (int)srcRank, Communicator()) || MpiFail("Bcast: MPI_Bcast");
+    ProfileCollective(profState, profilerEvtCommBroadcast, "mpi", (int)numElements, GetDataType(sendData), Communicator());
 }
 
 void MPIWrapperMpi::AllReduceAsync(size_t* sendData, size_t numElements, MPI_Request* request, MPI_Op op) const
@@ -836,81 +1160,120 @@ void MPIWrapperMpi::AllReduceAsync(float* sendData, size_t numElements, MPI_Requ
 
 void MPIWrapperMpi::AllReduceAsync(size_t *sendData, size_t *receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Iallreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallreduce");
+    ProfileStart(request, profState, profilerEvtCommAllReduce, (int)numElements, GetDataType(sendData));
 }
 
 void MPIWrapperMpi::AllReduceAsync(int *sendData, int *receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Iallreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallreduce");
+    ProfileStart(request, profState, profilerEvtCommAllReduce, (int)numElements, GetDataType(sendData));
 }
 void MPIWrapperMpi::AllReduceAsync(double *sendData, double *receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Iallreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallreduce");
+    ProfileStart(request, profState, profilerEvtCommAllReduce, (int)numElements, GetDataType(sendData));
 }
 void MPIWrapperMpi::AllReduceAsync(float *sendData, float *receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Iallreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallreduce");
+    ProfileStart(request, profState, profilerEvtCommAllReduce, (int)numElements, GetDataType(sendData));
 }
 
 
 void MPIWrapperMpi::Bcast(double* sendData, size_t numElements, size_t srcRank)
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Bcast(sendData, (int)numElements, GetDataType(sendData), (int)srcRank, Communicator()) || MpiFail("Bcast: MPI_Bcast");
+    ProfileCollective(profState, profilerEvtCommBroadcast, "mpi", (int)numElements, GetDataType(sendData), Communicator());
 }
 
 void MPIWrapperMpi::Bcast(float* sendData, size_t numElements, size_t srcRank)
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Bcast(sendData, (int)numElements, GetDataType(sendData), (int)srcRank, Communicator()) || MpiFail("Bcast: MPI_Bcast");
+    ProfileCollective(profState, profilerEvtCommBroadcast, "mpi", (int)numElements, GetDataType(sendData), Communicator());
 }
 
 void MPIWrapperMpi::Bcast(void* buffer, int count, MPI_Datatype datatype, int root)
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Bcast(buffer, count, datatype, root, Communicator()) || MpiFail("Bcast: MPI_Bcast");
+    ProfileCollective(profState, profilerEvtCommBroadcast, "mpi", count, datatype, Communicator());
 }
 
 void MPIWrapperMpi::AllGatherAsync(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, MPI_Request* request) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Iallgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallgather");
+    ProfileStart(request, profState, profilerEvtCommAllGather, (int)numSendElements, GetDataType(receiveData));
 }
 
 void MPIWrapperMpi::AllGatherAsync(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements, MPI_Request* request) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Iallgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallgather");
+    ProfileStart(request, profState, profilerEvtCommAllGather, (int)numSendElements, GetDataType(receiveData));
 }
 
 void MPIWrapperMpi::AllGatherAsync(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements, MPI_Request* request) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Iallgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallgather");
+    ProfileStart(request, profState, profilerEvtCommAllGather, (int)numSendElements, GetDataType(receiveData));
 }
 
 void MPIWrapperMpi::AllGatherAsync(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements, MPI_Request* request) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Iallgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallgather");
+    ProfileStart(request, profState, profilerEvtCommAllGather, (int)numSendElements, GetDataType(receiveData));
 }
 
 void MPIWrapperMpi::AllGather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator()) || MpiFail("AllReduceAsync: MPI_Allgather");
+    ProfileCollective(profState, profilerEvtCommAllGather, "mpi", (int)numSendElements, GetDataType(receiveData), Communicator());
 }
 
 void MPIWrapperMpi::AllGather(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator()) || MpiFail("AllReduceAsync: MPI_Allgather");
+    ProfileCollective(profState, profilerEvtCommAllGather, "mpi", (int)numSendElements, GetDataType(receiveData), Communicator());
 }
 
 void MPIWrapperMpi::AllGather(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator()) || MpiFail("AllReduceAsync: MPI_Allgather");
+    ProfileCollective(profState, profilerEvtCommAllGather, "mpi", (int)numSendElements, GetDataType(receiveData), Communicator());
 }
 
 void MPIWrapperMpi::AllGather(const double *sendData, size_t numSendElements, double*receiveData, size_t numRecvElements) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator()) || MpiFail("AllReduceAsync: MPI_Allgather");
+    ProfileCollective(profState, profilerEvtCommAllGather, "mpi", (int)numSendElements, GetDataType(receiveData), Communicator());
 }
 
 void MPIWrapperMpi::Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype) const
 {
+    auto profState = ProfilerTimeBegin();
     MPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, Communicator()) || MpiFail("AllReduceAsync: MPI_Allgather");
+    ProfileCollective(profState, profilerEvtCommAllGather, "mpi", sendcount, recvtype, Communicator());
+}
+
+void MPIWrapperMpi::Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[], const int displs[], MPI_Datatype recvtype) const
+{
+    auto profState = ProfilerTimeBegin();
+    MPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, Communicator()) || MpiFail("Allgatherv: MPI_Allgatherv");
+    ProfileCollective(profState, profilerEvtCommAllGather, "mpi", sendcount, sendtype, Communicator());
 }
 
 void MPIWrapperMpi::Gather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, size_t rootRank) const
@@ -959,14 +1322,171 @@ void MPIWrapperMpi::Gatherv(const double *sendData, size_t numSendElements, doub
 }
 
 // wait for an async request to finish
+void MPIWrapperMpi::ReduceScatterWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const
+{
+    auto profState = ProfilerTimeBegin();
+    MPI_Reduce_scatter_block(sendData, receiveData, (int)numElementsPerNode, GetDataType(receiveData), MPI_SUM, m_hostComm) || MpiFail("ReduceScatterWithinHost: MPI_Reduce_scatter_block");
+    ProfileCollective(profState, profilerEvtCommReduceScatter, "mpi within host", (int)numElementsPerNode, GetDataType(receiveData), m_hostComm);
+}
+
+void MPIWrapperMpi::ReduceScatterWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const
+{
+    auto profState = ProfilerTimeBegin();
+    MPI_Reduce_scatter_block(sendData, receiveData, (int)numElementsPerNode, GetDataType(receiveData), MPI_SUM, m_hostComm) || MpiFail("ReduceScatterWithinHost: MPI_Reduce_scatter_block");
+    ProfileCollective(profState, profilerEvtCommReduceScatter, "mpi within host", (int)numElementsPerNode, GetDataType(receiveData), m_hostComm);
+}
+
+void MPIWrapperMpi::AllGatherWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const
+{
+    auto profState = ProfilerTimeBegin();
+    MPI_Allgather(sendData, (int)numElementsPerNode, GetDataType(receiveData), receiveData, (int)numElementsPerNode, GetDataType(receiveData), m_hostComm) || MpiFail("AllGatherWithinHost: MPI_Allgather");
+    ProfileCollective(profState, profilerEvtCommAllGather, "mpi within host", (int)numElementsPerNode, GetDataType(receiveData), m_hostComm);
+}
+
+void MPIWrapperMpi::AllGatherWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const
+{
+    auto profState = ProfilerTimeBegin();
+    MPI_Allgather(sendData, (int)numElementsPerNode, GetDataType(receiveData), receiveData, (int)numElementsPerNode, GetDataType(receiveData), m_hostComm) || MpiFail("AllGatherWithinHost: MPI_Allgather");
+    ProfileCollective(profState, profilerEvtCommAllGather, "mpi within host", (int)numElementsPerNode, GetDataType(receiveData), m_hostComm);
+}
+
+void MPIWrapperMpi::AllReduceAcrossHosts(float* data, size_t numElements) const
+{
+    auto profState = ProfilerTimeBegin();
+    MPI_Allreduce(MPI_IN_PLACE, data, (int)numElements, GetDataType(data), MPI_SUM, m_crossHostComm) || MpiFail("AllReduceAcrossHosts: MPI_Allreduce");
+    ProfileCollective(profState, profilerEvtCommAllReduce, "mpi across hosts", (int)numElements, GetDataType(data), m_crossHostComm);
+}
+
+void MPIWrapperMpi::AllReduceAcrossHosts(double* data, size_t numElements) const
+{
+    auto profState = ProfilerTimeBegin();
+    MPI_Allreduce(MPI_IN_PLACE, data, (int)numElements, GetDataType(data), MPI_SUM, m_crossHostComm) || MpiFail("AllReduceAcrossHosts: MPI_Allreduce");
+    ProfileCollective(profState, profilerEvtCommAllReduce, "mpi across hosts", (int)numElements, GetDataType(data), m_crossHostComm);
+}
+
+size_t MPIWrapperMpi::CreateWindow(void* base, size_t numElements, int elementSize)
+{
+    MPI_Win window;
+    MPI_Win_create(numElements > 0 ? base : nullptr, (MPI_Aint)(numElements * elementSize), elementSize, MPI_INFO_NULL, m_currentComm, &window) || MpiFail("CreateWindow: MPI_Win_create");
+    MPI_Win_lock_all(0, window) || MpiFail("CreateWindow: MPI_Win_lock_all");
+    m_windows.push_back(window);
+    return m_windows.size() - 1;
+}
+
+size_t MPIWrapperMpi::CreateWindow(float* base, size_t numElements)
+{
+    return CreateWindow(base, numElements, (int)sizeof(*base));
+}
+
+size_t MPIWrapperMpi::CreateWindow(double* base, size_t numElements)
+{
+    return CreateWindow(base, numElements, (int)sizeof(*base));
+}
+
+size_t MPIWrapperMpi::CreateWindow(size_t* base, size_t numElements)
+{
+    return CreateWindow(base, numElements, (int)sizeof(*base));
+}
+
+void MPIWrapperMpi::FreeWindow(size_t window)
+{
+    MPI_Win_unlock_all(m_windows[window]) || MpiFail("FreeWindow: MPI_Win_unlock_all");
+    MPI_Win_free(&m_windows[window]) || MpiFail("FreeWindow: MPI_Win_free");
+}
+
+void MPIWrapperMpi::FetchAndAdd(size_t window, const void* data, void* result, size_t numElements, MPI_Datatype datatype, size_t targetRank, size_t targetOffset)
+{
+    // MPI_NO_OP only reads, its origin buffer is not used
+    MPI_Get_accumulate(data ? data : result, (int)numElements, datatype, result, (int)numElements, datatype,
+                       (int)targetRank, (MPI_Aint)targetOffset, (int)numElements, datatype, data ? MPI_SUM : MPI_NO_OP, m_windows[window])
+        || MpiFail("FetchAndAdd: MPI_Get_accumulate");
+}
+
+void MPIWrapperMpi::FetchAndAdd(size_t window, const float* data, float* result, size_t numElements, size_t targetRank, size_t targetOffset)
+{
+    FetchAndAdd(window, data, result, numElements, GetDataType(result), targetRank, targetOffset);
+}
+
+void MPIWrapperMpi::FetchAndAdd(size_t window, const double* data, double* result, size_t numElements, size_t targetRank, size_t targetOffset)
+{
+    FetchAndAdd(window, data, result, numElements, GetDataType(result), targetRank, targetOffset);
+}
+
+void MPIWrapperMpi::FetchAndAdd(size_t window, const size_t* data, size_t* result, size_t numElements, size_t targetRank, size_t targetOffset)
+{
+    FetchAndAdd(window, data, result, numElements, GetDataType(result), targetRank, targetOffset);
+}
+
+void MPIWrapperMpi::FlushWindow(size_t window)
+{
+    MPI_Win_flush_all(m_windows[window]) || MpiFail("FlushWindow: MPI_Win_flush_all");
+}
+
 void MPIWrapperMpi::Wait(MPI_Request* request)
 {
+    MPI_Request started = *request;
+    auto profWait = ProfilerTimeBegin();
     MPI_Wait(request, MPI_STATUSES_IGNORE) || MpiFail("Wait: MPI_Wait");
+    ProfileCompletion(&started, 1, profWait);
 }
 
 void MPIWrapperMpi::WaitAny(MPI_Request* requests, int numRequests, int* index)
 {
+    std::vector<MPI_Request> started(requests, requests + numRequests);
+    auto profWait = ProfilerTimeBegin();
     MPI_Waitany(numRequests, requests, index, MPI_STATUSES_IGNORE) || MpiFail("WaitAny: MPI_Waitany");
+    if (*index != MPI_UNDEFINED)
+        ProfileCompletion(&started[*index], 1, profWait);
+}
+
+void MPIWrapperMpi::ProfileCollective(long long beginClock, int eventId, const char* algorithm, size_t numElements, MPI_Datatype datatype, MPI_Comm comm) const
+{
+    if (!ProfilerIsEnabled())
+        return;
+
+    int typeSize, numNodes;
+    MPI_Type_size(datatype, &typeSize);
+    MPI_Comm_size(comm, &numNodes);
+    long long bytes = (long long)numElements * typeSize;
+    if (eventId == profilerEvtCommAllGather || eventId == profilerEvtCommReduceScatter)
+        bytes *= numNodes;
+    ProfilerCommEnd(beginClock, eventId, algorithm, bytes, numNodes, -1 /*blocking*/);
+}
+
+void MPIWrapperMpi::ProfileStart(const MPI_Request* request, long long beginClock, int eventId, size_t numElements, MPI_Datatype datatype) const
+{
+    if (!ProfilerIsEnabled())
+        return;
+
+    int typeSize;
+    MPI_Type_size(datatype, &typeSize);
+    long long bytes = (long long)numElements * typeSize;
+    if (eventId == profilerEvtCommAllGather)
+        bytes *= m_numNodesInUse;
+    std::lock_guard<std::mutex> lock(m_pendingCollectivesMutex);
+    m_pendingCollectives[*request] = PendingCollective{ eventId, "mpi", bytes, beginClock };
+}
+
+void MPIWrapperMpi::ProfileCompletion(const MPI_Request* requests, int numRequests, long long waitBeginClock) const
+{
+    std::lock_guard<std::mutex> lock(m_pendingCollectivesMutex);
+    if (m_pendingCollectives.empty())
+        return;
+
+    // All requests that completed together were waited for all the time.
+    long long waitClocks = ProfilerTimeBegin() - waitBeginClock;
+    bool waitedForCollective = false;
+    for (int i = 0; i < numRequests; i++)
+    {
+        auto pending = m_pendingCollectives.find(requests[i]);
+        if (pending == m_pendingCollectives.end())
+            continue; // not a collective, or started while not profiling
+        ProfilerCommEnd(pending->second.beginClock, pending->second.eventId, pending->second.algorithm, pending->second.bytes, (int)m_numNodesInUse, waitClocks);
+        m_pendingCollectives.erase(pending);
+        waitedForCollective = true;
+    }
+    if (waitedForCollective)
+        ProfilerTimeEnd(waitBeginClock, profilerEvtCommWait);
 }
 
 #endif
@@ -1002,11 +1522,57 @@ bool MPIWrapperEmpty::IsMultiHost() const
     return false;
 }
 
+const std::vector<size_t>& MPIWrapperEmpty::HostIndexOfNodes() const
+{
+    static const std::vector<size_t> hostIndexOfNodes(1, 0);
+    return hostIndexOfNodes;
+}
+
+size_t MPIWrapperEmpty::NumNodesOnCurrentHost() const
+{
+    return 1;
+}
+
+size_t MPIWrapperEmpty::CurrentNodeRankOnHost() const
+{
+    return 0;
+}
+
 bool MPIWrapperEmpty::UseGpuGdr()
 {
     return false;
 }
 
+bool MPIWrapperEmpty::EnableFaultTolerance()
+{
+    return false;
+}
+
+bool MPIWrapperEmpty::IsFaultTolerant() const
+{
+    return false;
+}
+
+void MPIWrapperEmpty::RecoverFromFailure()
+{
+    LogicError("RecoverFromFailure: not supported without MPI.");
+}
+
+std::string MPIWrapperEmpty::OpenPort()
+{
+    LogicError("OpenPort: not supported without MPI.");
+}
+
+void MPIWrapperEmpty::AcceptNodes(const std::string& /*portName*/)
+{
+    LogicError("AcceptNodes: not supported without MPI.");
+}
+
+void MPIWrapperEmpty::JoinNodes(const std::string& /*portName*/)
+{
+    LogicError("JoinNodes: not supported without MPI.");
+}
+
 int MPIWrapperEmpty::Finalize(void)
 {
     return MPI_UNDEFINED;
@@ -1241,6 +1807,10 @@ void MPIWrapperEmpty::Allgather(const void* sendbuf, int sendcount, MPI_Datatype
 {
 }
 
+void MPIWrapperEmpty::Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[], const int displs[], MPI_Datatype recvtype) const
+{
+}
+
 void MPIWrapperEmpty::Gather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, size_t rootRank) const
 {
 }
@@ -1278,6 +1848,93 @@ void MPIWrapperEmpty::Gatherv(const double *sendData, size_t numSendElements, do
 }
 
 
+// with a single node the collectives within the host only copy the data, and there is nothing to reduce across hosts
+void MPIWrapperEmpty::ReduceScatterWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const
+{
+    if (sendData != receiveData)
+        memcpy(receiveData, sendData, numElementsPerNode * sizeof(float));
+}
+
+void MPIWrapperEmpty::ReduceScatterWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const
+{
+    if (sendData != receiveData)
+        memcpy(receiveData, sendData, numElementsPerNode * sizeof(double));
+}
+
+void MPIWrapperEmpty::AllGatherWithinHost(const float* sendData, float* receiveData, size_t numElementsPerNode) const
+{
+    if (sendData != receiveData)
+        memcpy(receiveData, sendData, numElementsPerNode * sizeof(float));
+}
+
+void MPIWrapperEmpty::AllGatherWithinHost(const double* sendData, double* receiveData, size_t numElementsPerNode) const
+{
+    if (sendData != receiveData)
+        memcpy(receiveData, sendData, numElementsPerNode * sizeof(double));
+}
+
+void MPIWrapperEmpty::AllReduceAcrossHosts(float* data, size_t numElements) const
+{
+}
+
+void MPIWrapperEmpty::AllReduceAcrossHosts(double* data, size_t numElements) const
+{
+}
+
+// with a single node the windows are the node's own memory, accessed directly
+template <class ElemType>
+static void FetchAndAddLocal(ElemType* base, const ElemType* data, ElemType* result, size_t numElements)
+{
+    for (size_t i = 0; i < numElements; i++)
+    {
+        result[i] = base[i];
+        if (data)
+            base[i] += data[i];
+    }
+}
+
+size_t MPIWrapperEmpty::CreateWindow(float* base, size_t /*numElements*/)
+{
+    m_windows.push_back(base);
+    return m_windows.size() - 1;
+}
+
+size_t MPIWrapperEmpty::CreateWindow(double* base, size_t /*numElements*/)
+{
+    m_windows.push_back(base);
+    return m_windows.size() - 1;
+}
+
+size_t MPIWrapperEmpty::CreateWindow(size_t* base, size_t /*numElements*/)
+{
+    m_windows.push_back(base);
+    return m_windows.size() - 1;
+}
+
+void MPIWrapperEmpty::FreeWindow(size_t window)
+{
+    m_windows[window] = nullptr;
+}
+
+void MPIWrapperEmpty::FetchAndAdd(size_t window, const float* data, float* result, size_t numElements, size_t /*targetRank*/, size_t targetOffset)
+{
+    FetchAndAddLocal((float*)m_windows[window] + targetOffset, data, result, numElements);
+}
+
+void MPIWrapperEmpty::FetchAndAdd(size_t window, const double* data, double* result, size_t numElements, size_t /*targetRank*/, size_t targetOffset)
+{
+    FetchAndAddLocal((double*)m_windows[window] + targetOffset, data, result, numElements);
+}
+
+void MPIWrapperEmpty::FetchAndAdd(size_t window, const size_t* data, size_t* result, size_t numElements, size_t /*targetRank*/, size_t targetOffset)
+{
+    FetchAndAddLocal((size_t*)m_windows[window] + targetOffset, data, result, numElements);
+}
+
+void MPIWrapperEmpty::FlushWindow(size_t /*window*/)
+{
+}
+
 void MPIWrapperEmpty::Wait(MPI_Request* request)
 {
 }
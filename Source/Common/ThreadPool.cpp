@@ -0,0 +1,162 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ThreadPool.cpp -- the process-wide pool of threads for background work
+//
+
+#include "ThreadPool.h"
+#include "Basics.h"
+#include <algorithm>
+#include <thread>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// the CPUs in the affinity mask of the calling thread, in increasing order
+static vector<int> GetAffinityCpus()
+{
+    vector<int> cpus;
+#ifdef _WIN32
+    DWORD_PTR processMask, systemMask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    {
+        for (int cpu = 0; cpu < (int) sizeof(processMask) * 8; cpu++)
+            if (processMask & ((DWORD_PTR) 1 << cpu))
+                cpus.push_back(cpu);
+    }
+#else
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &mask))
+                cpus.push_back(cpu);
+    }
+#endif
+    if (cpus.empty()) // unknown
+    {
+        for (int cpu = 0; cpu < (int) max(1u, thread::hardware_concurrency()); cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+static bool PinCurrentThread(const vector<int>& cpus)
+{
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+        mask |= (DWORD_PTR) 1 << cpu;
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &mask);
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#endif
+}
+
+/*static*/ ThreadPool& ThreadPool::Instance()
+{
+    static ThreadPool* instance = new ThreadPool();
+    return *instance;
+}
+
+ThreadPool::ThreadPool()
+    : m_numThreads(0), m_numIdleThreads(0), m_availableCpus(GetAffinityCpus()), m_pinThreads(false), m_affinityVersion(0)
+{
+}
+
+size_t ThreadPool::NumThreads() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_numThreads;
+}
+
+void ThreadPool::Post(function<void()>&& task, ThreadPoolPriority priority)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_queues[(int) priority].push_back(move(task));
+    // a thread is started if the queued tasks outnumber the idle threads, so that no task waits for another to finish
+    if (m_queues[0].size() + m_queues[1].size() > m_numIdleThreads)
+    {
+        thread([this]() { WorkerLoop(); }).detach();
+        m_numThreads++;
+        m_numIdleThreads++;
+    }
+    m_tasksQueued.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+    size_t affinityVersion = 0;
+    unique_lock<mutex> lock(m_mutex);
+    for (;;)
+    {
+        auto& highQueue = m_queues[(int) ThreadPoolPriority::high];
+        auto& normalQueue = m_queues[(int) ThreadPoolPriority::normal];
+        m_tasksQueued.wait(lock, [&]() { return !highQueue.empty() || !normalQueue.empty(); });
+        auto& queue = !highQueue.empty() ? highQueue : normalQueue;
+        auto task = move(queue.front());
+        queue.pop_front();
+        m_numIdleThreads--;
+
+        // follow changes of the reserved CPUs
+        vector<int> cpus;
+        if (affinityVersion != m_affinityVersion)
+        {
+            cpus = m_pinThreads ? m_backgroundCpus : m_availableCpus;
+            affinityVersion = m_affinityVersion;
+        }
+        lock.unlock();
+
+        if (!cpus.empty())
+            PinCurrentThread(cpus); // best effort; the task also runs unpinned
+        task(); // a packaged_task, which passes exceptions on to its future
+
+        lock.lock();
+        m_numIdleThreads++;
+    }
+}
+
+int ThreadPool::ReserveBackgroundCpus(int numCpus, bool pin)
+{
+    bool wasPinned;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        numCpus = max(0, min(numCpus, (int) m_availableCpus.size() - 1));
+        m_computeCpus.assign(m_availableCpus.begin(), m_availableCpus.end() - numCpus);
+        m_backgroundCpus.assign(m_availableCpus.end() - numCpus, m_availableCpus.end());
+        wasPinned = m_pinThreads;
+        m_pinThreads = pin && numCpus > 0;
+        m_affinityVersion++;
+    }
+    if (m_pinThreads && !PinCurrentThreadToComputeCpus())
+        RuntimeError("ThreadPool: Could not pin the thread to the %d compute CPUs.", (int) m_computeCpus.size());
+    else if (!m_pinThreads && wasPinned)
+        PinCurrentThread(m_availableCpus);
+    return (int) m_computeCpus.size();
+}
+
+bool ThreadPool::PinCurrentThreadToComputeCpus() const
+{
+    vector<int> cpus;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (!m_pinThreads)
+            return true;
+        cpus = m_computeCpus;
+    }
+    return PinCurrentThread(cpus);
+}
+
+}}}
@@ -0,0 +1,138 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BatchNormActivationFusion.cpp -- evaluates a batch normalization and the ReLU that consumes it as one operation
+//
+
+#include "stdafx.h"
+#include "BatchNormActivationFusion.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "TrainingNodes.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// 0: not a float or double node
+static int GetPrecision(const ComputationNodeBasePtr& node)
+{
+    if (node->Is<ComputationNode<float>>())
+        return 1;
+    if (node->Is<ComputationNode<double>>())
+        return 2;
+    return 0;
+}
+
+// whether 'node' computes values of the same kind as 'root', so that it can share its value matrix
+static bool IsCompatible(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& root)
+{
+    return GetPrecision(node) == GetPrecision(root) && node->GetMBLayout() == root->GetMBLayout() && node->GetSampleLayout() == root->GetSampleLayout();
+}
+
+/*static*/ std::vector<std::shared_ptr<FusedBatchNormActivation>> FusedBatchNormActivation::Find(const std::list<ComputationNodeBasePtr>& evalOrder, const std::vector<ComputationNodeBasePtr>& roots)
+{
+    std::map<ComputationNodeBasePtr, size_t> numConsumers; // counting each use
+    for (const auto& node : evalOrder)
+    {
+        for (const auto& input : node->GetInputs())
+            numConsumers[input]++;
+    }
+    std::set<ComputationNodeBasePtr> rootSet(roots.begin(), roots.end());
+
+    // whether 'node' can be a node of the group other than its root 'root'
+    auto canBeInterior = [&](const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& root)
+    {
+        return numConsumers[node] == 1 && rootSet.find(node) == rootSet.end() && !node->GetFusedChain() && !node->IsPartOfLoop() && IsCompatible(node, root);
+    };
+    auto isBatchNormalization = [&](const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& root)
+    {
+        return node->OperationName() == OperationNameOf(BatchNormalizationNode) && canBeInterior(node, root);
+    };
+
+    std::vector<std::shared_ptr<FusedBatchNormActivation>> groups;
+    for (const auto& root : evalOrder)
+    {
+        if (root->OperationName() != OperationNameOf(RectifiedLinearNode) || root->IsPartOfLoop() || root->GetFusedChain() || GetPrecision(root) == 0)
+            continue;
+
+        const auto& input = root->GetInputs()[0];
+        std::vector<ComputationNodeBasePtr> nodes;
+        ComputationNodeBasePtr residual;
+        if (input->OperationName() == OperationNameOf(PlusNode) && canBeInterior(input, root))
+        {
+            // BatchNormalization(x) + shortcut, in either order
+            const auto& inputs = input->GetInputs();
+            size_t bnIndex = isBatchNormalization(inputs[0], root) ? 0 : isBatchNormalization(inputs[1], root) ? 1 : SIZE_MAX;
+            if (bnIndex == SIZE_MAX || inputs[0] == inputs[1] || !IsCompatible(inputs[1 - bnIndex], root))
+                continue;
+            nodes = { inputs[bnIndex], input, root };
+            residual = inputs[1 - bnIndex];
+        }
+        else if (isBatchNormalization(input, root))
+            nodes = { input, root };
+        else
+            continue;
+
+        groups.push_back(std::shared_ptr<FusedBatchNormActivation>(new FusedBatchNormActivation(std::move(nodes), residual)));
+    }
+    return groups;
+}
+
+FusedBatchNormActivation::FusedBatchNormActivation(std::vector<ComputationNodeBasePtr>&& nodes, const ComputationNodeBasePtr& residual)
+    : FusedNodes(std::move(nodes)), m_residual(residual)
+{
+    m_leaves = m_nodes.front()->GetInputs();
+    if (m_residual && std::find(m_leaves.begin(), m_leaves.end(), m_residual) == m_leaves.end())
+        m_leaves.push_back(m_residual);
+}
+
+void FusedBatchNormActivation::ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    fr; // the batch normalization always processes the whole minibatch
+    if (node != GetRoot())
+        return;
+    node->BeginForwardProp();
+    if (GetPrecision(node) == 1)
+        ForwardPropFused<float>();
+    else
+        ForwardPropFused<double>();
+    node->EndForwardProp();
+}
+
+void FusedBatchNormActivation::Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    fr;
+    if (node != GetRoot())
+        return;
+    node->BeginBackprop();
+    if (GetPrecision(node) == 1)
+        BackpropFused<float>();
+    else
+        BackpropFused<double>();
+    node->EndBackprop();
+}
+
+template <class ElemType>
+void FusedBatchNormActivation::ForwardPropFused()
+{
+    auto root = GetRoot()->As<ComputationNode<ElemType>>();
+    auto residual = m_residual ? m_residual->As<ComputationNode<ElemType>>() : nullptr;
+    m_nodes.front()->As<BatchNormalizationNode<ElemType>>()->ForwardPropFused(*root, residual);
+}
+
+template <class ElemType>
+void FusedBatchNormActivation::BackpropFused()
+{
+    auto root = GetRoot()->As<ComputationNode<ElemType>>();
+    if (!root->NeedsGradient())
+        return;
+    root->LazyZeroGradient(); // as in ComputationNode::Backprop(), for roots that received no gradient
+
+    auto residual = m_residual ? m_residual->As<ComputationNode<ElemType>>() : nullptr;
+    m_nodes.front()->As<BatchNormalizationNode<ElemType>>()->BackpropFused(*root, residual);
+}
+
+}}}
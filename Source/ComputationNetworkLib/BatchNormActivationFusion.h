@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BatchNormActivationFusion.h -- evaluates a batch normalization and the ReLU that consumes it as one operation
+//
+// Convolutional networks apply ReLU(BatchNormalization(x)), and residual blocks ReLU(BatchNormalization(x) + shortcut).
+// Node by node, the normalized value, the sum and the activation each get a full-size value and gradient matrix, and the
+// ReLU reads and writes all of it once more. With fuseBatchNormActivations=true, ComputationNetwork::CompileNetwork()
+// groups these nodes into FusedBatchNormActivations. The ReLU, the root of the group, computes the normalization directly
+// into its own value and applies the residual and the activation there in place (BatchNormEngine::ForwardActivation()).
+// In the backward pass it turns its gradient into the gradient of the normalized value in place, and propagates that to
+// the shortcut and through the normalization. The values and gradients of the BatchNormalizationNode and the PlusNode are
+// never computed, so the MatrixPool does not need memory for them.
+//
+// The BatchNormalizationNode and the PlusNode must
+//  - have a single consumer, the next node of the group, and not be a root of the network,
+//  - have the same MBLayout, sample layout and precision as the ReLU, and so must the shortcut,
+// and the ReLU must not be part of a recurrent loop.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "FusedNodes.h"
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class FusedBatchNormActivation : public FusedNodes
+{
+public:
+    // finds the groups in 'evalOrder', the global evaluation order; nodes in 'roots' can only be roots of groups
+    static std::vector<std::shared_ptr<FusedBatchNormActivation>> Find(const std::list<ComputationNodeBasePtr>& evalOrder, const std::vector<ComputationNodeBasePtr>& roots);
+
+    // The root does the work for all; the other nodes do nothing.
+    void ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr) override;
+    void Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr) override;
+
+private:
+    FusedBatchNormActivation(std::vector<ComputationNodeBasePtr>&& nodes, const ComputationNodeBasePtr& residual);
+
+    template <class ElemType> void ForwardPropFused();
+    template <class ElemType> void BackpropFused();
+
+    ComputationNodeBasePtr m_residual; // the other input of the PlusNode, if any
+};
+
+}}}
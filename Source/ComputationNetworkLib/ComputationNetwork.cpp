@@ -21,11 +21,18 @@
 #include "SpecialPurposeNodes.h"
 #include "DeprecatedNodes.h" // (for SaveToDbnFile(), which is also deprecated)
 #include "MPIWrapper.h" // TODO: does not belong here
+#include "MappedFile.h"
+#include "PerformanceProfiler.h"
 #include <string>
 #include <vector>
 #include <stack>
 #include <list>
 #include <set>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 
@@ -47,6 +54,18 @@ vector<MemRequestInfo<double>>& MatrixPool::GetMemRequestInfoVec<double>()
     return m_memRequestInfoDoubleVec;
 }
 
+template <>
+vector<shared_ptr<Matrix<float>>>& MatrixPool::GetBuffers<float>()
+{
+    return m_floatBuffers;
+}
+
+template <>
+vector<shared_ptr<Matrix<double>>>& MatrixPool::GetBuffers<double>()
+{
+    return m_doubleBuffers;
+}
+
 // -----------------------------------------------------------------------
 // construction
 // -----------------------------------------------------------------------
@@ -76,6 +95,7 @@ void ComputationNetwork::ClearNetwork()
     }
 
     m_nameToNodeMap.clear();
+    m_stateBeforeEdits.reset();
 
     m_pMBLayoutOfNetwork->Init(1, 0);
 }
@@ -85,26 +105,209 @@ void ComputationNetwork::ClearNetwork()
 // -----------------------------------------------------------------------
 
 // after after editing--network is possibly not validated/compiled
+// Within an edit session, this compiles the edits so far, and the session goes on.
 void ComputationNetwork::SaveEdited(const wstring& fileName, const FileOptions fileFormat)
 {
-    if (!IsCompiled())
+    if (IsEditing())
+    {
+        let editSessionDepth = m_editSessionDepth;
+        m_editSessionDepth = 0;
+        InvalidateCompiledNetwork();
+        CompileNetwork();
+        m_editSessionDepth = editSessionDepth;
+        SaveStateBeforeEdits();
+    }
+    else if (!IsCompiled())
         CompileNetwork();
     Save(fileName, fileFormat);
 }
 
-void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFormat) const
+void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFormat, ParameterValueFormat valueFormat) const
 {
     VerifyIsCompiled("Save");
     // Saving into temporary file and then renaming it to the requested fileName
     // This is a standard trick to avoid havign corrupted model files if process dies during writing
     wstring tmpFileName = fileName + L".tmp";
-    SaveToFileImpl(tmpFileName, fileFormat);
+    SaveToFileImpl(tmpFileName, fileFormat, valueFormat);
     renameOrDie(tmpFileName, fileName);
 }
 
+template <class ElemType>
+static MatrixBasePtr CopyValueForSave(const ComputationNodeBasePtr& node)
+{
+    const auto& value = node->As<ComputationNode<ElemType>>()->Value();
+    // dense values go to host memory; a sparse one stays on its device, since only the GPU form of a sparse matrix can be written
+    if (value.GetMatrixType() != MatrixType::DENSE)
+        return make_shared<Matrix<ElemType>>(value.DeepClone());
+    auto copy = make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), CPUDEVICE);
+    copy->AssignValuesOf(value);
+    return copy;
+}
+
+// the value of a node that saves its value copied by CopyValueForSave() if it is on a GPU, else null
+template <class ElemType>
+static MatrixBasePtr CopyGPUValueForSave(const ComputationNodeBasePtr& node, size_t& numBytes)
+{
+    const auto& value = node->As<ComputationNode<ElemType>>()->Value();
+    if (value.GetDeviceId() == CPUDEVICE)
+        return nullptr;
+    numBytes = value.GetNumElements() * sizeof(ElemType);
+    return CopyValueForSave<ElemType>(node);
+}
+
+// Writes the nodes of the node list in order on a background thread, while the calling thread (which owns the
+// device) copies the values of the next nodes from the GPU, so that the device-to-host transfers overlap the writing.
+// The copies waiting to be written are limited to maxBytesQueued, but one is always accepted.
+class NodeListWriter
+{
+public:
+    typedef function<void(const ComputationNodeBasePtr&, const MatrixBase*)> WriteFunction;
+
+    NodeListWriter(const WriteFunction& write, size_t maxBytesQueued)
+        : m_write(write), m_maxBytesQueued(maxBytesQueued), m_bytesQueued(0), m_isFinished(false)
+    {
+        m_thread = thread([this]() { Run(); });
+    }
+
+    ~NodeListWriter()
+    {
+        if (m_thread.joinable()) // the caller failed before Finish()
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_isFinished = true;
+                m_queue.clear();
+            }
+            m_canPop.notify_one();
+            m_thread.join();
+        }
+    }
+
+    // 'value' is null for a node that writes its own value
+    void Push(const ComputationNodeBasePtr& node, const MatrixBasePtr& value, size_t numBytes)
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_canPush.wait(lock, [&]() { return m_error || m_queue.empty() || m_bytesQueued + numBytes <= m_maxBytesQueued; });
+        if (m_error)
+            rethrow_exception(m_error);
+        m_queue.push_back(Item{ node, value, numBytes });
+        m_bytesQueued += numBytes;
+        m_canPop.notify_one();
+    }
+
+    // waits until all nodes are written; rethrows an error of the writing
+    void Finish()
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_isFinished = true;
+        }
+        m_canPop.notify_one();
+        m_thread.join();
+        if (m_error)
+            rethrow_exception(m_error);
+    }
+
+private:
+    struct Item
+    {
+        ComputationNodeBasePtr m_node;
+        MatrixBasePtr m_value;
+        size_t m_numBytes;
+    };
+
+    void Run()
+    {
+        try
+        {
+            for (;;)
+            {
+                Item item;
+                {
+                    unique_lock<mutex> lock(m_mutex);
+                    m_canPop.wait(lock, [&]() { return m_isFinished || !m_queue.empty(); });
+                    if (m_queue.empty())
+                        return;
+                    item = move(m_queue.front());
+                    m_queue.pop_front();
+                }
+                m_write(item.m_node, item.m_value.get());
+                item.m_value.reset();
+                {
+                    lock_guard<mutex> lock(m_mutex);
+                    m_bytesQueued -= item.m_numBytes;
+                }
+                m_canPush.notify_one();
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_error = current_exception();
+            m_canPush.notify_one();
+        }
+    }
+
+    WriteFunction m_write;
+    size_t m_maxBytesQueued;
+    size_t m_bytesQueued;
+    bool m_isFinished;
+    deque<Item> m_queue;
+    exception_ptr m_error;
+    mutex m_mutex;
+    condition_variable m_canPush;
+    condition_variable m_canPop;
+    thread m_thread;
+};
+
+static const size_t saveQueueBytes = 256 * 1024 * 1024;
+
+// saves a LearnableParameter<ElemType> in the given format; returns false for other nodes
+template <class ElemType>
+static bool SaveParameterWithValueFormat(File& fstream, const ComputationNodeBasePtr& node, const MatrixBase* value, ParameterValueFormat valueFormat)
+{
+    auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+    if (!parameter)
+        return false;
+    parameter->SaveWithValue(fstream, value ? *value : parameter->Value(), valueFormat);
+    return true;
+}
+
+function<void()> ComputationNetwork::SnapshotForSave(const wstring& fileName, const FileOptions fileFormat) const
+{
+    VerifyIsCompiled("SnapshotForSave");
+    MaterializeParameters();
+
+    auto valueSnapshot = make_shared<map<const ComputationNodeBase*, MatrixBasePtr>>();
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        if (!node->SavesValue())
+            continue;
+        if (node->Is<ComputationNode<float>>())
+            (*valueSnapshot)[node.get()] = CopyValueForSave<float>(node);
+        else if (node->Is<ComputationNode<double>>())
+            (*valueSnapshot)[node.get()] = CopyValueForSave<double>(node);
+        else
+            LogicError("Unexpected node type.");
+    }
+
+    return [this, fileName, fileFormat, valueSnapshot]()
+    {
+        wstring tmpFileName = fileName + L".tmp";
+        SaveToFileImpl(tmpFileName, fileFormat, ParameterValueFormat::full, valueSnapshot.get());
+        renameOrDie(tmpFileName, fileName);
+    };
+}
+
 // TODO: how does the file distinguish float vs double nodes?
-void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
+// If 'valueSnapshot' is given, the values of the nodes in it are written from there (see SnapshotForSave()).
+void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat, ParameterValueFormat valueFormat,
+                                        const map<const ComputationNodeBase*, MatrixBasePtr>* valueSnapshot) const
 {
+    if (!valueSnapshot) // (SnapshotForSave() has done this already)
+        MaterializeParameters();
+
     File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
     // Buffer writes in memory then flush to filesystem, which reduces number of small writes
     fstream.Setvbuf();
@@ -118,10 +321,9 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
     fstream << (size_t) m_nameToNodeMap.size();
 
     // put all node info first
-    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
-    for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+    // 'value' is null if the node writes its own value
+    auto writeNode = [&fstream, valueFormat](const ComputationNodeBasePtr& nodePtr, const MatrixBase* value)
     {
-        ComputationNodeBasePtr nodePtr = nodeIter->second;
         // type
 #if CURRENT_CNTK_MODEL_VERSION >= CNTK_MODEL_VERSION_7
         wstring precision;
@@ -136,7 +338,48 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
         // name
         fstream << nodePtr->NodeName();
         // content
-        nodePtr->Save(fstream);
+        if (valueFormat != ParameterValueFormat::full &&
+            (SaveParameterWithValueFormat<float>(fstream, nodePtr, value, valueFormat) || SaveParameterWithValueFormat<double>(fstream, nodePtr, value, valueFormat)))
+            return;
+        if (value)
+            nodePtr->SaveWithValue(fstream, *value);
+        else
+            nodePtr->Save(fstream);
+    };
+
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
+    if (valueSnapshot || GetDeviceId() == CPUDEVICE)
+    {
+        for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+        {
+            const MatrixBase* snapshotValue = nullptr;
+            if (valueSnapshot)
+            {
+                auto snapshotIter = valueSnapshot->find(nodeIter->second.get());
+                if (snapshotIter != valueSnapshot->end())
+                    snapshotValue = snapshotIter->second.get();
+            }
+            writeNode(nodeIter->second, snapshotValue);
+        }
+    }
+    else // copy the values from the GPU while the previous nodes are written
+    {
+        NodeListWriter writer(writeNode, saveQueueBytes);
+        for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+        {
+            const auto& nodePtr = nodeIter->second;
+            MatrixBasePtr hostValue;
+            size_t numBytes = 0;
+            if (nodePtr->SavesValue())
+            {
+                if (nodePtr->Is<ComputationNode<float>>())
+                    hostValue = CopyGPUValueForSave<float>(nodePtr, numBytes);
+                else if (nodePtr->Is<ComputationNode<double>>())
+                    hostValue = CopyGPUValueForSave<double>(nodePtr, numBytes);
+            }
+            writer.Push(nodePtr, hostValue, numBytes);
+        }
+        writer.Finish();
     }
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
@@ -193,7 +436,11 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECN");
 
-    fstream.Flush();
+    // a snapshot is written in the background, and is meant to be durable by the time it is reported complete
+    if (valueSnapshot)
+        fstream.Sync();
+    else
+        fstream.Flush();
 }
 
 
@@ -272,6 +519,8 @@ void ComputationNetwork::ReadPersistableParameters(size_t modelVersion, File& fs
 template <class ElemType> // for ReadPersistableParameters()
 void ComputationNetwork::Read(const wstring& fileName)
 {
+    PROFILE_SCOPE(profilerEvtLoadDeserialize);
+
     ClearNetwork();
 
     File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
@@ -408,6 +657,130 @@ void ComputationNetwork::Read(const wstring& fileName)
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECN");
 }
 
+void ComputationNetwork::MaterializeParameters() const
+{
+    vector<ComputationNodeBasePtr> nodes;
+    for (const auto& iter : m_nameToNodeMap)
+        nodes.push_back(iter.second);
+    MaterializeDeferredValues(nodes);
+}
+
+void ComputationNetwork::MaterializeParameters(const vector<ComputationNodeBasePtr>& roots) const
+{
+    vector<ComputationNodeBasePtr> nodes;
+    for (const auto& root : roots)
+    {
+        const auto& evalOrder = GetEvalOrder(root);
+        nodes.insert(nodes.end(), evalOrder.begin(), evalOrder.end());
+    }
+    MaterializeDeferredValues(nodes);
+}
+
+// Each model file is mapped into memory once, and each value is copied out of the mapping in one piece.
+// The values are copied in file order, and the pages of the next loadReadAheadBytes are requested from the OS ahead
+// of the copies, so that reading the file overlaps copying (on a GPU, the host-to-device transfers).
+static const size_t loadReadAheadBytes = 64 * 1024 * 1024;
+
+void ComputationNetwork::MaterializeDeferredValues(const vector<ComputationNodeBasePtr>& nodes) const
+{
+    map<wstring, vector<IDeferredValueNode*>> deferredNodes; // by file
+    for (const auto& node : nodes)
+    {
+        if (node->Is<IDeferredValueNode>() && !node->As<IDeferredValueNode>()->DeferredValueFile().empty())
+            deferredNodes[node->As<IDeferredValueNode>()->DeferredValueFile()].push_back(node->As<IDeferredValueNode>());
+    }
+
+    for (auto& iter : deferredNodes)
+    {
+        auto& fileNodes = iter.second;
+        sort(fileNodes.begin(), fileNodes.end(), [](const IDeferredValueNode* a, const IDeferredValueNode* b)
+        {
+            return a->DeferredValuePosition() < b->DeferredValuePosition();
+        });
+        fileNodes.erase(unique(fileNodes.begin(), fileNodes.end()), fileNodes.end()); // (listed more than once)
+
+        MappedFile file(iter.first);
+        size_t numLoaded = 0;
+        size_t numRequested = 0;
+        for (auto node : fileNodes)
+        {
+            let readAheadEnd = node->DeferredValuePosition() + loadReadAheadBytes;
+            for (; numRequested < fileNodes.size() && fileNodes[numRequested]->DeferredValuePosition() < readAheadEnd; numRequested++)
+                file.WillNeed(fileNodes[numRequested]->DeferredValuePosition(), fileNodes[numRequested]->DeferredValueBytes());
+            node->LoadDeferredValue(file.GetData());
+            numLoaded++;
+        }
+        if (TraceLevel() > 0)
+            fprintf(stderr, "MaterializeParameters: Loaded %d parameters from %ls.\n", (int)numLoaded, iter.first.c_str());
+    }
+}
+
+// a parameter whose value and gradient can be placed into the flat buffers
+template <class ElemType>
+static bool IsFlattenable(const ComputationNodeBasePtr& node)
+{
+    auto typedNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+    return typedNode && typedNode->GradientPtr() &&
+           typedNode->Value().GetMatrixType() == DENSE && typedNode->Gradient().GetMatrixType() == DENSE &&
+           typedNode->Value().GetDeviceId() == typedNode->Gradient().GetDeviceId();
+}
+
+// returns the number of elements of each of the two buffers
+template <class ElemType>
+static size_t FlattenParameters(DEVICEID_TYPE deviceId, const vector<ComputationNodeBasePtr>& nodes, vector<MatrixBasePtr>& buffers)
+{
+    size_t numElements = 0;
+    for (const auto& node : nodes)
+        numElements += node->As<ComputationNode<ElemType>>()->Value().GetNumElements();
+
+    auto values = make_shared<Matrix<ElemType>>(1, numElements, deviceId);
+    auto gradients = make_shared<Matrix<ElemType>>(1, numElements, deviceId);
+    gradients->SetValue(0);
+
+    size_t offset = 0;
+    for (const auto& node : nodes)
+    {
+        auto& value = node->As<ComputationNode<ElemType>>()->Value();
+        auto& gradient = node->As<ComputationNode<ElemType>>()->Gradient();
+        const size_t numRows = value.GetNumRows();
+        const size_t numCols = value.GetNumCols();
+        values->ColumnSlice(offset, numRows * numCols).AssignValuesOf(value.Reshaped(1, numRows * numCols));
+        value = Matrix<ElemType>(numRows, numCols, values->Data() + offset, deviceId, matrixFlagDontOwnBuffer);
+        gradient = Matrix<ElemType>(numRows, numCols, gradients->Data() + offset, deviceId, matrixFlagDontOwnBuffer);
+        offset += numRows * numCols;
+    }
+
+    buffers.push_back(values);
+    buffers.push_back(gradients);
+    return numElements;
+}
+
+void ComputationNetwork::AllocateFlatParameterBuffers(const list<ComputationNodeBasePtr>& learnableNodes)
+{
+    map<DEVICEID_TYPE, vector<ComputationNodeBasePtr>> floatNodes, doubleNodes;
+    for (const auto& node : learnableNodes)
+    {
+        if (!node->IsParameterUpdateRequired())
+            continue;
+        if (IsFlattenable<float>(node))
+            floatNodes[node->As<ComputationNode<float>>()->Value().GetDeviceId()].push_back(node);
+        else if (IsFlattenable<double>(node))
+            doubleNodes[node->As<ComputationNode<double>>()->Value().GetDeviceId()].push_back(node);
+    }
+
+    for (size_t pass = 0; pass < 2; pass++)
+    {
+        for (const auto& iter : pass == 0 ? floatNodes : doubleNodes)
+        {
+            const size_t numElements = pass == 0 ? FlattenParameters<float>(iter.first, iter.second, m_flatParameterBuffers)
+                                                 : FlattenParameters<double>(iter.first, iter.second, m_flatParameterBuffers);
+            if (TraceLevel() > 0)
+                fprintf(stderr, "AllocateFlatParameterBuffers: %d parameters with %d elements on device %d.\n",
+                        (int)iter.second.size(), (int)numElements, (int)iter.first);
+        }
+    }
+}
+
 // -----------------------------------------------------------------------
 // node construction
 // -----------------------------------------------------------------------
@@ -464,9 +837,8 @@ bool ComputationNetwork::IsTypicalCriterionNode(ComputationNodeBasePtr nodePtr)
         nodePtr->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassificationErrorNode) ||
         nodePtr->OperationName() == OperationNameOf(ForwardBackwardNode) ||
-#ifdef COMING_SOON
+        nodePtr->OperationName() == OperationNameOf(LatticeFreeMMINode) ||
         nodePtr->OperationName() == OperationNameOf(CRFNode) ||
-#endif
         nodePtr->OperationName() == OperationNameOf(DummyCriterionNode))
         return true;
 
@@ -13,6 +13,14 @@
 #include "ComputationNode.h"
 #include "ScriptableObjects.h"
 #include "ComputationEnvironment.h"
+#include "StreamSchedule.h"
+#include "ForwardGraphCache.h"
+#include "ForwardPlan.h"
+#include "MemoryPlan.h"
+#include "ElementwiseFusion.h"
+#include "BatchNormActivationFusion.h"
+#include "GapCompaction.h"
+#include "ValueOffload.h"
 
 #include <map>
 #include <string>
@@ -29,6 +37,7 @@
 #include <chrono>
 #include <unordered_map>
 #include <set>
+#include <functional>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -51,7 +60,9 @@ public:
     ComputationNetwork() :
         m_randomSeedOffset(0),
         m_isCompiled(false),
+        m_editSessionDepth(0),
         m_areMatricesAllocated(false),
+        m_parameterGradientAccumulation(false),
         m_pMBLayoutOfNetwork(make_shared<MBLayout>(1, 0, ComputationNodeBase::DefaultDynamicAxisName)),
         m_environment(make_shared<ComputationEnvironment>())
     {
@@ -117,12 +128,33 @@ public:
         return net;
     }
 
-    void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
+    // valueFormat compresses the values of the parameters, e.g. for distributing a model for inference (see ParameterValueFormat)
+    void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary,
+              ParameterValueFormat valueFormat = ParameterValueFormat::full) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
 
+    // Copies the values that Save() writes (of parameters and precomputed nodes) into host memory, and returns a function
+    // that writes the model file from this copy, e.g. on a background thread while training goes on and changes the values.
+    // The rest of the model (structure, node configurations) is written from the network itself, which must outlive the
+    // function and must not be edited until it has run.
+    std::function<void()> SnapshotForSave(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
+
+    // Load the values of parameters that lazy parameter loading (lazyParameterLoading) left in the model file: of all
+    // of them, or of those that 'roots' depend on. AllocateAllMatrices() does the latter for its roots.
+    void MaterializeParameters() const;
+    void MaterializeParameters(const std::vector<ComputationNodeBasePtr>& roots) const;
+
+    // Moves the values of the dense parameters among 'learnableNodes' that are updated into one flat buffer per device and
+    // element type, and their gradients into another, in the order of 'learnableNodes' (flatParameterBuffers). The nodes
+    // keep their matrix objects, which become views into the buffers, so that an operation over all parameters or all
+    // gradients of a device (e.g. gradient aggregation) can work on one buffer. Call after AllocateAllMatrices().
+    void AllocateFlatParameterBuffers(const std::list<ComputationNodeBasePtr>& learnableNodes);
+
 private:
+    void MaterializeDeferredValues(const std::vector<ComputationNodeBasePtr>& nodes) const;
 
-    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat) const;
+    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat, ParameterValueFormat valueFormat,
+                        const std::map<const ComputationNodeBase*, MatrixBasePtr>* valueSnapshot = nullptr) const;
     
     static size_t GetModelVersion(File& fstream);
 
@@ -138,8 +170,16 @@ public:
     // main entry point for post forward and backward prop
     void PostForwardAndBackProp(const ComputationNodeBasePtr rootNode);
 
+    // callback for the parameters whose gradient has been computed, see Backprop()
+    typedef std::function<void(const ComputationNodeBasePtr&)> GradientReadyCallback;
+
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // If given, 'gradientReady' is called for each learnable parameter as soon as its gradient is final, i.e. once all nodes
+    // that use it have been backpropagated, while the backward pass goes on with the remaining nodes. Gradients of nodes
+    // that run concurrently (numComputeStreams) are reported after their streams or threads have joined again.
+    // With 'keepParameterGradients', the gradients of the learnable parameters are added to those of the previous call
+    // rather than replacing them, so that the gradients of several minibatches can be accumulated in place.
+    void Backprop(const ComputationNodeBasePtr rootNode, const GradientReadyCallback& gradientReady = nullptr, bool keepParameterGradients = false);
 
     template <class NODESET> // version that takes multiple nodes
     void TravserseInSortedGlobalEvalOrder(const NODESET& nodes, const std::function<void(const ComputationNodeBasePtr&)>& action)
@@ -174,9 +214,22 @@ public:
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
     {
-        TravserseInSortedGlobalEvalOrder(nodes, [](const ComputationNodeBasePtr& node) {
-            PARTraversalFlowControlNode::ForwardProp(node, FrameRange(nullptr));
-        });
+        if (Globals::ShouldUseMemoryPlans())
+            PrepareMemoryPlan();
+        auto forwardProp = [this, &nodes]()
+        {
+            StreamSchedule::Execution execution(m_streamSchedule.get(), StreamSchedule::Pass::Forward);
+            TravserseInSortedGlobalEvalOrder(nodes, [&execution](const ComputationNodeBasePtr& node) {
+                execution.Run(node, [node]() { PARTraversalFlowControlNode::ForwardProp(node, FrameRange(nullptr)); });
+            });
+            execution.Join();
+        };
+        if (Globals::ShouldCaptureCudaGraphs())
+            ForwardPropWithGraphs(std::vector<ComputationNodeBasePtr>(nodes.begin(), nodes.end()), forwardProp);
+        else if (Globals::ShouldUseForwardPlans() && !m_streamSchedule)
+            ForwardPropWithPlans(std::vector<ComputationNodeBasePtr>(nodes.begin(), nodes.end()), forwardProp);
+        else
+            forwardProp();
     }
 
     template <class NODESET> // version that takes multiple nodes
@@ -239,11 +292,28 @@ public:
     // -----------------------------------------------------------------------
 
     void CompileNetwork(); // call this after creation, Load(), and any modification
-    void ValidateNetwork();
+    // splits the network into pipeline stages on several devices (see DevicePlacement.cpp)
+    void PlacePipelineStages(const ComputationNodeBasePtr& criterionNode, const std::vector<DEVICEID_TYPE>& devices);
+    void ValidateNetwork(const std::unordered_set<ComputationNodeBasePtr>* nodesToValidate = nullptr); // all nodes unless given, see EndEdits()
 
 private:
-    size_t ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass);
-    bool ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const;
+    // change tracking of ValidateNetwork(), so that passes after the first only revisit nodes that may have changed
+    struct NodeValidationState
+    {
+        bool m_validated = false;           // Validate() was called at least once
+        bool m_allInputsVisited = false;    // all inputs had been validated when it last was
+        size_t m_validatedAt = 0;           // change count when it was last validated
+        size_t m_changedAt = 0;             // change count when it (or its dimensions, inferred by a consumer) last changed
+        bool m_isKept = false;              // not to be validated unless something changes, see ValidateNetwork()
+    };
+    struct ValidationChangeTracker
+    {
+        unordered_map<const ComputationNodeBase*, NodeValidationState> m_nodes;
+        size_t m_numChanges = 0;
+        bool NeedsRevalidation(const ComputationNodeBasePtr& node);
+    };
+    size_t ValidateNodes(const list<ComputationNodeBasePtr>& nodes, bool isFirstPass, bool isFinalValidationPass, ValidationChangeTracker& changes);
+    bool ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass, bool* inputsChanged = nullptr) const;
     void MarkValueNonSharableNodes();
     void ChangeNodeInputs(ComputationNodeBasePtr fromNode, ComputationNodeBasePtr toNode);
 
@@ -251,12 +321,25 @@ private:
     void DetermineSetOfAllRoots();
     void CollectInputAndLearnableParameters(const ComputationNodeBasePtr& rootNode);
     void CollectInputAndLearnableParametersRec(const ComputationNodeBasePtr& node, set<ComputationNodeBasePtr>& visited, list<ComputationNodeBasePtr>& inputs, list<ComputationNodeBasePtr>& learnableParameters);
-    void ResetMBLayouts();
+    void ResetMBLayouts(bool keepDynamicAxes = false);
+    bool PlaceNodesOnDevices();
+    bool SimplifyNetwork();
+    void FuseBatchNormActivations();
+    void FuseElementwiseChains();
+    void FormCompactedRuns();
+    void ClearElementwiseChains();
+    void HoistLoopInvariantProducts();
+    void ClearLoopInvariantProducts();
     bool IsCompiled() const { return m_isCompiled; }
     bool AreMatricesAllocated() const { return m_areMatricesAllocated; }
     void VerifyIsCompiled(const char* where) const;
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    // keep the values shared by the forward passes of several roots valid across forward passes, within a memory bound
+    bool RetainSharedValues(const std::vector<ComputationNodeBasePtr>& roots, size_t maxBytesPerSample);
+    // the largest minibatch (in samples) for which the matrices planned by AllocateAllMatrices(), the inputs, and numParameterCopies
+    // copies of the learnable parameters (their values and the state of the learner) fit into budgetBytes on each device
+    size_t GetMaxSamplesInMemory(size_t budgetBytes, size_t numParameterCopies);
 
     // From the set of nodes extract all nodes which are used as accumulator nodes.
     std::set<ComputationNodeBasePtr> ExtractNodesWhichAccumulateResult(std::set<ComputationNodeBasePtr> nodes);
@@ -264,6 +347,21 @@ public:
 private:
     void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap);
+    void PlanConcurrentExecution(const std::vector<ComputationNodeBasePtr>& forwardPropRoots, ComputationNodeBasePtr trainRootNode);
+    void PlanRecomputation(ComputationNodeBasePtr trainRootNode, const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                           std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp);
+    void PlanOffloading(ComputationNodeBasePtr trainRootNode, const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                        const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp);
+    static ValueOffloadActions& GetOrCreateOffloadActions(const ComputationNodeBasePtr& node);
+    void ReleaseMatricesAfterLastReader(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& lastReader);
+    // all nodes of the forward pass of 'roots', in global evaluation order
+    std::vector<ComputationNodeBasePtr> GetForwardPropNodes(const std::vector<ComputationNodeBasePtr>& roots);
+    // runs 'forwardProp', the forward pass of 'roots', or replays it from a CUDA graph (cudaGraphs)
+    void ForwardPropWithGraphs(const std::vector<ComputationNodeBasePtr>& roots, const std::function<void()>& forwardProp);
+    // runs 'forwardProp', the forward pass of 'roots', or its precompiled plan (forwardPlans)
+    void ForwardPropWithPlans(const std::vector<ComputationNodeBasePtr>& roots, const std::function<void()>& forwardProp);
+    // places the shared matrices for the minibatch of the input nodes (memoryPlans)
+    void PrepareMemoryPlan();
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
 public:
@@ -461,6 +559,7 @@ public:
     ComputationNodeBasePtr CopyNode(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toName, const CopyNodeFlags flags);
     void CopySubTree(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toNamePrefix, const CopyNodeFlags flags);
     void CopyInputs(const std::wstring fromName, std::wstring toName);
+    ComputationNetworkPtr CloneSharingParameters() const;
     void RenameNode(const std::wstring& nodeNameOrig, const std::wstring& nodeNameNew);
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
     void DeleteNode(const std::wstring& nodeName);
@@ -472,6 +571,15 @@ public:
     //ComputationNodeBasePtr RemoveFeatureNode(ComputationNodeBasePtr featureNode);
     void SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode = nullptr);
 
+    // Batched editing: CompileNetwork() calls between BeginEdits() and the matching EndEdits() are deferred to
+    // EndEdits(), so that any number of edits cost a single compilation. If the network was compiled at BeginEdits(),
+    // that compilation only validates the nodes that are new or whose inputs, dimensions, or parameter updates were
+    // changed, and the nodes that depend on them. (Edits of other node attributes that affect the validation need a
+    // CompileNetwork() outside of a session.) Sessions may be nested.
+    void BeginEdits();
+    void EndEdits();
+    bool IsEditing() const { return m_editSessionDepth > 0; }
+
     // -----------------------------------------------------------------------
     // node access
     // -----------------------------------------------------------------------
@@ -834,6 +942,15 @@ public:
     template <class ElemType>
     void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
 
+    // removes Dropout, folds BatchNormalization into the preceding weights, and computes constant subgraphs once (see ComputationNetworkInference.cpp)
+    template <class ElemType>
+    void OptimizeForInference();
+
+    // stores the weights of products that are at most 'maxDensity' nonzero as sparse matrices; with 'benchmarkColumns' > 0, logs
+    // the break-even density of each weight for products with that many columns (see ComputationNetworkInference.cpp)
+    template <class ElemType>
+    void SparsifyParametersForInference(double maxDensity, size_t benchmarkColumns = 0);
+
     template <class ElemType>
     void SaveToDbnFile(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
@@ -931,12 +1048,19 @@ public:
 
     // zeroes out all gradients except the root itself (since its gradient is set from outside rather than propagated down)
     // (Note that inside the nodes this only really sets a flag to do it later when needed, but that's not our concern.)
-    void ZeroInputGradients(const ComputationNodeBasePtr& rootNode)
+    // With 'keepParameterGradients', the gradients of the learnable parameters are kept for the next backprop to add to.
+    void ZeroInputGradients(const ComputationNodeBasePtr& rootNode, bool keepParameterGradients = false)
     {
+        if (keepParameterGradients)
+            EnableParameterGradientAccumulation();
         for (auto& node : GetAllNodesForRoot(rootNode))
-            node->ZeroGradientsOfInputs();
+            node->ZeroGradientsOfInputs(keepParameterGradients);
     }
 
+    // Turns off the optimization that lets the lone parent of a learnable parameter overwrite its gradient instead of
+    // adding to it, which accumulating the gradients over several backprops requires. This can be done at any time.
+    void EnableParameterGradientAccumulation();
+
 private:
     bool IsTypicalCriterionNode(ComputationNodeBasePtr nodePtr);
     void PrintComputationTree(const ComputationNodeBasePtr& rootNode, const bool forwardCompute, const bool printMatrices = false);
@@ -1137,7 +1261,14 @@ protected:
         virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool);
         virtual bool IsOutOfDateWrtInputs() const override;
 
+    private:
+        void ForwardPropTimeSteps();
+
+        ForwardGraphCache m_graphCache; // replays the time steps of the forward pass (cudaGraphs=true)
+
     public:
+        void ClearGraphCache() { m_graphCache.Clear(); }
+
         ComputationNodeBasePtr m_sourceNode; // one of the nodes of the loop   --TODO: What is the special meaning of this node? It seems to always be a delay node.
         int m_loopId;                        // unique loop id, index in m_allSEQNodes array
         int m_steppingDirection;             // +1 if left to right (t=0..T-1), -1 if rightt to left (t=T-1..0)
@@ -1200,6 +1331,16 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // set by AllocateAllMatrices() if independent nodes run concurrently (numComputeStreams)
+        void SetStreamSchedule(const std::shared_ptr<StreamSchedule>& streamSchedule) { m_streamSchedule = streamSchedule; }
+
+        // set by ComputationNetwork::Backprop() for the duration of one backward pass
+        void SetGradientReadyCallback(const GradientReadyCallback& gradientReady) { m_gradientReady = gradientReady; }
+
+    private:
+        std::shared_ptr<StreamSchedule> m_streamSchedule;
+        GradientReadyCallback m_gradientReady;
     };
 
 public:
@@ -1259,7 +1400,22 @@ private:
 
     // cache for evaluation ordering:
     bool m_isCompiled; // CompileNetwork has been called
+
+    // state of a node at BeginEdits(), to find the nodes that the edits changed
+    struct NodeStateBeforeEdits
+    {
+        std::vector<ComputationNodeBasePtr> m_inputs;
+        TensorShape m_sampleLayout;
+        MBLayoutPtr m_pMBLayout;
+        bool m_isParameterUpdateRequired;
+    };
+    typedef std::map<ComputationNodeBasePtr, NodeStateBeforeEdits> NetworkStateBeforeEdits;
+    int m_editSessionDepth;                                     // nesting of BeginEdits()
+    std::shared_ptr<NetworkStateBeforeEdits> m_stateBeforeEdits; // null unless compiled at BeginEdits()
+    void SaveStateBeforeEdits();
+    std::unordered_set<ComputationNodeBasePtr> DetermineNodesAffectedByEdits(const NetworkStateBeforeEdits& stateBeforeEdits);
     bool m_areMatricesAllocated; // AllocateAllMatrices has been called
+    bool m_parameterGradientAccumulation; // EnableParameterGradientAccumulation has been called
 
     // cached network iterations
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
@@ -1273,6 +1429,24 @@ private:
     // pool for matrices that can be shared across nodes
     // TODO: does this apply to anything else besides temporary node-internal intermediate results? What, for example?
     MatrixPool m_matrixPool;
+
+    // concurrent execution of independent nodes on several streams (numComputeStreams), null if off
+    std::shared_ptr<StreamSchedule> m_streamSchedule;
+
+    // CUDA graphs of the forward pass per minibatch layout (cudaGraphs)
+    ForwardGraphCache m_forwardGraphCache;
+
+    // precompiled forward passes in inference mode per set of roots (forwardPlans)
+    ForwardPlanCache m_forwardPlanCache;
+
+    // arenas for the shared matrices per minibatch shape in inference mode (memoryPlans)
+    MemoryPlanCache m_memoryPlanCache;
+
+    // the buffers of AllocateFlatParameterBuffers(), which the values and gradients of the parameters point into
+    std::vector<MatrixBasePtr> m_flatParameterBuffers;
+
+    // values kept in host memory between the forward and the backward pass (see PlanOffloading())
+    std::unordered_map<ComputationNodeBasePtr, std::shared_ptr<ValueOffload>> m_valueOffloads;
 };
 typedef ComputationNetwork::ComputationNetworkPtr ComputationNetworkPtr;
 
@@ -9,6 +9,8 @@
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "ReshapingNodes.h"
 #include <string>
 #include <set>
 
@@ -475,4 +477,76 @@ static int DetermineLoopDirection(const std::vector<ComputationNodeBasePtr>& nes
     return steppingDirection;
 }
 
+// -----------------------------------------------------------------------
+// loop-invariant product hoisting
+// -----------------------------------------------------------------------
+
+// A recurrent loop only contains nodes that depend on its delay nodes, so an input projection W * x is outside of it. But
+// if the recurrence is written as W * RowStack(x, h), as is common for LSTMs and GRUs, then the whole product is computed
+// once per time step, including W_x * x, the part for x. If 'node' is such a product, tell it which inputs of the RowStack
+// are computed outside of the loop, so that it computes their part for all time steps at once (see TimesNodeBase).
+template <class ElemType>
+static bool HoistLoopInvariantProduct(const ComputationNodeBasePtr& node, const set<ComputationNodeBasePtr>& loopNodes)
+{
+    auto times = dynamic_pointer_cast<TimesNode<ElemType>>(node);
+    if (!times || times->OutputRank() != 1 || node->GetSampleLayout().GetRank() != 1)
+        return false;
+
+    // W: a matrix computed outside of the loop; the right operand: column vectors stacked inside of it
+    const auto& weights = node->Input(0);
+    const auto& stack = node->Input(1);
+    auto rowStack = dynamic_pointer_cast<RowStackNode<ElemType>>(stack);
+    if (weights->HasMBLayout() || loopNodes.find(weights) != loopNodes.end() || weights->GetSampleLayout().GetRank() != 2 ||
+        !rowStack || rowStack->GetSpliceDim() != 1 || loopNodes.find(stack) == loopNodes.end() || stack->GetSampleLayout().GetRank() != 1 ||
+        weights->GetSampleLayout()[0] != node->GetSampleLayout()[0] || weights->GetSampleLayout()[1] != stack->GetSampleLayout()[0])
+        return false;
+
+    vector<size_t> loopInvariantInputs;
+    for (size_t i = 0; i < stack->GetNumInputs(); i++)
+    {
+        const auto& input = stack->Input(i);
+        if (input->GetSampleLayout().GetRank() != 1 || input->GetMBLayout() != node->GetMBLayout()) // no broadcasting
+            return false;
+        if (loopNodes.find(input) == loopNodes.end())
+            loopInvariantInputs.push_back(i);
+    }
+    if (loopInvariantInputs.empty())
+        return false;
+
+    times->SetLoopInvariantStackedInputs(move(loopInvariantInputs));
+    return true;
+}
+
+void ComputationNetwork::HoistLoopInvariantProducts()
+{
+    vector<ComputationNodeBasePtr> hoisted;
+    for (const auto& loop : m_allSEQNodes)
+    {
+        set<ComputationNodeBasePtr> loopNodes(loop->m_nestedNodes.begin(), loop->m_nestedNodes.end());
+        for (const auto& node : loop->m_nestedNodes)
+        {
+            if (HoistLoopInvariantProduct<float>(node, loopNodes) || HoistLoopInvariantProduct<double>(node, loopNodes))
+                hoisted.push_back(node);
+        }
+    }
+
+    if (TraceLevel() > 0 && !hoisted.empty())
+    {
+        fprintf(stderr, "\nHoisted the loop-invariant part of %d products out of recurrent loops:\n", (int)hoisted.size());
+        for (const auto& node : hoisted)
+            fprintf(stderr, "\t%ls = %ls(%ls, %ls)\n", node->NodeName().c_str(), node->OperationName().c_str(), node->Input(0)->NodeName().c_str(), node->Input(1)->NodeName().c_str());
+    }
+}
+
+void ComputationNetwork::ClearLoopInvariantProducts()
+{
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        if (auto times = dynamic_pointer_cast<TimesNode<float>>(iter.second))
+            times->SetLoopInvariantStackedInputs({});
+        else if (auto times = dynamic_pointer_cast<TimesNode<double>>(iter.second))
+            times->SetLoopInvariantStackedInputs({});
+    }
+}
+
 }}}
@@ -20,6 +20,47 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This source file contains files related to model editing with MEL. Future BrainScript editing will not modify nodes in-place.
 
+// -----------------------------------------------------------------------
+// batched editing
+// -----------------------------------------------------------------------
+
+void ComputationNetwork::BeginEdits()
+{
+    if (m_editSessionDepth++ == 0)
+        SaveStateBeforeEdits();
+}
+
+void ComputationNetwork::EndEdits()
+{
+    if (m_editSessionDepth == 0)
+        LogicError("EndEdits: There is no edit session to end.");
+    if (--m_editSessionDepth > 0)
+        return;
+
+    // Not all edits invalidate the network themselves, e.g. SetInput() on a node.
+    InvalidateCompiledNetwork();
+    CompileNetwork(); // validates the nodes affected by the edits, using m_stateBeforeEdits
+}
+
+// remember the inputs, dimensions, and MBLayouts of the nodes of a compiled network, to find out what the edits change
+void ComputationNetwork::SaveStateBeforeEdits()
+{
+    m_stateBeforeEdits.reset();
+    if (!IsCompiled()) // nothing to compare with: EndEdits() will compile the network completely
+        return;
+
+    m_stateBeforeEdits = make_shared<NetworkStateBeforeEdits>();
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        auto& state = (*m_stateBeforeEdits)[node];
+        state.m_inputs = node->GetInputs();
+        state.m_sampleLayout = node->GetSampleLayout();
+        state.m_pMBLayout = node->GetMBLayout();
+        state.m_isParameterUpdateRequired = node->IsParameterUpdateRequired();
+    }
+}
+
 // -----------------------------------------------------------------------
 // network editing
 // -----------------------------------------------------------------------
@@ -103,6 +144,56 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
     CopyNode(*this, fromName, toName, CopyNodeFlags::copyNodeInputLinks);
 }
 
+// CloneSharingParameters - create a copy of this network for concurrent evaluation, e.g. one per thread
+// The copy has its own nodes, hence its own intermediate values and matrix pool, while it shares the values of
+// the LearnableParameters with this network. They must not be modified while the networks are in use.
+// Clone before allocating the matrices for the evaluation, since the values of the other nodes are copied.
+ComputationNetworkPtr ComputationNetwork::CloneSharingParameters() const
+{
+    MaterializeParameters(); // the shared values must be loaded before they are shared
+
+    auto net = make_shared<ComputationNetwork>(GetDeviceId());
+    *net->m_environment = *m_environment;
+    net->SetRandomSeedOffset(GetRandomSeedOffset());
+
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        auto flags = node->OperationName() == OperationNameOf(LearnableParameter) ?
+            (CopyNodeFlags)(CopyNodeFlags::copyNodeValue | CopyNodeFlags::shareNodeValue) : CopyNodeFlags::copyNodeValue;
+        net->AddNodeToNet(node->Duplicate(node->NodeName(), flags));
+    }
+
+    // link the new nodes by name
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        vector<ComputationNodeBasePtr> inputs;
+        for (const auto& input : iter.second->GetInputs())
+            inputs.push_back(net->GetNodeFromName(input->NodeName()));
+        net->GetNodeFromName(iter.first)->AttachInputs(inputs);
+    }
+
+    auto cloneNodeGroup = [&net](const wstring& groupTag, const vector<ComputationNodeBasePtr>& nodes)
+    {
+        for (const auto& node : nodes)
+            net->AddToNodeGroup(groupTag, net->GetNodeFromName(node->NodeName()));
+    };
+    cloneNodeGroup(L"feature",    m_featureNodes);
+    cloneNodeGroup(L"label",      m_labelNodes);
+    cloneNodeGroup(L"criterion",  m_criterionNodes);
+    cloneNodeGroup(L"evaluation", m_evaluationNodes);
+    cloneNodeGroup(L"output",     m_outputNodes);
+    for (const auto& iter : m_namedCriterionNodes)
+    {
+        auto& nodes = net->m_namedCriterionNodes[iter.first];
+        for (const auto& node : iter.second)
+            nodes.push_back(net->GetNodeFromName(node->NodeName()));
+    }
+
+    net->CompileNetwork();
+    return net;
+}
+
 // RenameNode - Rename a node to another name
 // nodeNameOrig - original node name
 // nodeNameNew - new node name
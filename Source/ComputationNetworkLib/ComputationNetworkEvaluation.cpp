@@ -11,6 +11,8 @@
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
+#include "PerformanceProfiler.h"
+#include "ComputeStreamPool.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -40,8 +42,49 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 {
     VerifyIsCompiled("ForwardProp");
 
+    if (Globals::ShouldUseMemoryPlans())
+        PrepareMemoryPlan();
+
     // traverse all nodes in the pre-determined evaluation order
-    GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
+    auto forwardProp = [this, &rootNode]() { GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr)); };
+    if (Globals::ShouldCaptureCudaGraphs())
+        ForwardPropWithGraphs(vector<ComputationNodeBasePtr>{ rootNode }, forwardProp);
+    else if (Globals::ShouldUseForwardPlans() && !m_streamSchedule)
+        ForwardPropWithPlans(vector<ComputationNodeBasePtr>{ rootNode }, forwardProp);
+    else
+        forwardProp();
+}
+
+vector<ComputationNodeBasePtr> ComputationNetwork::GetForwardPropNodes(const vector<ComputationNodeBasePtr>& roots)
+{
+    vector<ComputationNodeBasePtr> nodes;
+    for (const auto& root : roots)
+    {
+        const auto& evalOrder = GetEvalOrder(root);
+        nodes.insert(nodes.end(), evalOrder.begin(), evalOrder.end());
+    }
+    if (roots.size() > 1)
+        nodes = SortByGlobalEvalOrder(nodes);
+    return nodes;
+}
+
+void ComputationNetwork::ForwardPropWithGraphs(const vector<ComputationNodeBasePtr>& roots, const function<void()>& forwardProp)
+{
+    m_forwardGraphCache.ForwardProp(roots, GetForwardPropNodes(roots), Environment(), forwardProp);
+}
+
+void ComputationNetwork::ForwardPropWithPlans(const vector<ComputationNodeBasePtr>& roots, const function<void()>& forwardProp)
+{
+    m_forwardPlanCache.ForwardProp(roots, GetForwardPropNodes(roots), Environment(), forwardProp);
+}
+
+void ComputationNetwork::PrepareMemoryPlan()
+{
+    if (!AreMatricesAllocated())
+        return;
+    if (!m_memoryPlanCache.IsInitialized())
+        m_memoryPlanCache.Initialize(GetAllNodes());
+    m_memoryPlanCache.Prepare(m_matrixPool, Environment().IsInferring());
 }
 
 void ComputationNetwork::PostForwardAndBackProp(const ComputationNodeBasePtr rootNode)
@@ -72,7 +115,9 @@ static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, // training criterion to compute the gradients for
+                                  const GradientReadyCallback& gradientReady,
+                                  bool keepParameterGradients) // add to the parameter gradients of the previous call
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
@@ -82,10 +127,35 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
         LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
 
     // reset all gradients below rootNode to zero (actually, internally, this is lazy, but we don't care here)
-    ZeroInputGradients(rootNode);
+    ZeroInputGradients(rootNode, keepParameterGradients);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto nestedNetwork = GetNestedNetwork(rootNode)->As<PARTraversalFlowControlNode>();
+    nestedNetwork->SetGradientReadyCallback(gradientReady);
+    try
+    {
+        nestedNetwork->Backprop(FrameRange(nullptr), true, true);
+    }
+    catch (...)
+    {
+        nestedNetwork->SetGradientReadyCallback(nullptr);
+        throw;
+    }
+    nestedNetwork->SetGradientReadyCallback(nullptr);
+}
+
+void ComputationNetwork::EnableParameterGradientAccumulation()
+{
+    if (m_parameterGradientAccumulation)
+        return;
+
+    // AllocateAllMatrices() leaves the learnable parameters out of the gradient overwrite optimization from now on
+    m_parameterGradientAccumulation = true;
+    for (const auto& node : GetAllNodes())
+    {
+        if (node->IsLearnableParameter())
+            node->ClearParentOverwritesGradient();
+    }
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -140,16 +210,86 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         }
     }
 }
+// Times the forward or backward computation of a node for the profiler (profilerNodeTiming), on the GPU by events
+// on the stream the node is issued to. The estimated cost of the computation goes with it: for a time step of a loop
+// (isTimeStep) its share of the minibatch, for the backward pass that of the inputs that Backprop() propagates to with
+// the same childrenInThisLoop and childrenInOuterLoop flags. A fused chain is accounted to its root.
+// The transfers of matrices between devices meanwhile are accounted to the node as well (MatrixTransferAudit).
+class NodeTimer
+{
+public:
+    NodeTimer(const ComputationNodeBasePtr& node, bool backward, bool isTimeStep = false, bool childrenInThisLoop = true, bool childrenInOuterLoop = true)
+        : m_node(ProfilerIsNodeTimingEnabled() ? node.get() : nullptr), m_backward(backward), m_isTimeStep(isTimeStep),
+          m_childrenInThisLoop(childrenInThisLoop), m_childrenInOuterLoop(childrenInOuterLoop), m_stateId(-1),
+          m_transferAuditScope(backward ? L"Backprop" : L"ForwardProp", node->NodeName())
+    {
+        if (m_node)
+            m_stateId = ProfilerNodeBegin(m_node->GetDeviceId() >= 0, ComputeStreamPool::CurrentStream());
+    }
+
+    ~NodeTimer()
+    {
+        if (!m_node)
+            return;
+
+        double flops = 0, bytes = 0;
+        if (!m_backward)
+            m_node->GetForwardCost(flops, bytes);
+        else
+        {
+            for (size_t i = 0; i < m_node->GetNumInputs(); i++)
+            {
+                const auto& child = m_node->Input(i);
+                if (child->NeedsGradient() &&
+                    ((m_childrenInThisLoop  && child->IsPartOfLoop() == m_node->IsPartOfLoop()) ||
+                     (m_childrenInOuterLoop && child->IsPartOfLoop() != m_node->IsPartOfLoop())))
+                {
+                    double inputFlops, inputBytes;
+                    m_node->GetBackpropCost(i, inputFlops, inputBytes);
+                    flops += inputFlops;
+                    bytes += inputBytes;
+                }
+            }
+        }
+        if (m_isTimeStep)
+        {
+            double numTimeSteps = (double)m_node->GetMBLayout()->GetNumTimeSteps();
+            flops /= numTimeSteps;
+            bytes /= numTimeSteps;
+        }
+        ProfilerNodeEnd(m_stateId, m_node->NodeName().c_str(), m_node->OperationName().c_str(), m_backward, flops, bytes);
+    }
+
+private:
+    ComputationNodeBase* m_node;
+    bool m_backward;
+    bool m_isTimeStep;
+    bool m_childrenInThisLoop;
+    bool m_childrenInOuterLoop;
+    long long m_stateId;
+    MatrixTransferAudit::Scope m_transferAuditScope;
+};
+
 /*static*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr)
 {
     if (node->IsOutOfDateWrtInputs())
     {
-        node->BeginForwardProp();
-        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
-        node->EndForwardProp();
+        NodeTimer timer(node, /*backward=*/false);
+        if (node->GetFusedChain()) // the root of the chain computes all its nodes at once
+            node->GetFusedChain()->ForwardProp(node, fr);
+        else
+        {
+            node->BeginForwardProp();
+            node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+            node->EndForwardProp();
+        }
 
         node->BumpEvalTimeStamp();
 
+        // values that are kept in host memory until the backward pass (see ComputationNetwork::PlanOffloading())
+        if (node->GetOffloadActions())
+            node->GetOffloadActions()->AfterForwardProp();
+
         // Extreme Tracing, part 1/4
         if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode())
             DumpNode<float>(node, /*dumpGradient=*/false) || DumpNode<double>(node, false);
@@ -159,8 +299,10 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    StreamSchedule::Execution execution(m_streamSchedule.get(), StreamSchedule::Pass::Forward);
     for (auto& node : m_nestedNodes)
-        ForwardProp(node, fr);
+        execution.Run(node, [node, &fr]() { ForwardProp(node, fr); });
+    execution.Join();
 }
 
 /*static*/ void ComputationNetwork::PARTraversalFlowControlNode::PostForwardAndBackProp(const ComputationNodeBasePtr& node)
@@ -177,19 +319,62 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+
+    // Parameters come before all nodes that use them in evaluation order, so their gradients are final when the backward
+    // iteration reaches them. Within a region of concurrent nodes they are only reported once the streams have joined.
+    std::vector<ComputationNodeBasePtr> readyParameters;
+    auto reportReadyParameters = [this, &readyParameters]()
+    {
+        for (const auto& parameter : readyParameters)
+            m_gradientReady(parameter);
+        readyParameters.clear();
+    };
+
+    StreamSchedule::Execution execution(m_streamSchedule.get(), StreamSchedule::Pass::Backward, m_nestedNodes.empty() ? nullptr : m_nestedNodes.back());
     // process nodes in pre-determined order
     for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
     {
         auto& node = *pnode;
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+        execution.Run(node, [node, &fr]()
+        {
+            // values that were kept in host memory (see ComputationNetwork::PlanOffloading())
+            if (node->GetOffloadActions())
+                node->GetOffloadActions()->BeforeBackprop();
+
+            // values that were dropped after the forward pass (see ComputationNetwork::PlanRecomputation())
+            for (const auto& recomputedNode : node->GetNodesToRecomputeBeforeBackprop())
+            {
+                recomputedNode->BeginForwardProp();
+                recomputedNode->ForwardProp(fr.WithLayout(recomputedNode->GetMBLayout()));
+                recomputedNode->EndForwardProp();
+            }
+
+            NodeTimer timer(node, /*backward=*/true);
+            if (node->GetFusedChain())
+                node->GetFusedChain()->Backprop(node, fr);
+            else
+            {
+                node->BeginBackprop();
+                node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+                node->EndBackprop();
+            }
+        });
 
         // Extreme Tracing, part 2/4
         if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
             DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+
+        if (m_gradientReady && node->GetNumInputs() == 0 && node->NeedsGradient() && node->IsParameterUpdateRequired())
+            readyParameters.push_back(node);
+        if (!readyParameters.empty() && !execution.IsInRegion())
+            reportReadyParameters();
     }
+
+    // join all streams or workers before reporting the remaining parameters
+    execution.Join();
+    if (!readyParameters.empty())
+        reportReadyParameters();
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
@@ -262,6 +447,25 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     // All nodes share the same layout.
     assert(GetMBLayout() == m_nestedNodes[0]->GetMBLayout());
 
+    // The time steps issue several small kernels per node and step, which for small steps cost more host time than GPU time.
+    // With cudaGraphs=true, they are recorded once and replayed with one launch (see ForwardGraphCache.h).
+    if (Globals::ShouldCaptureCudaGraphs() && m_nestedNodes[0]->HasEnvironmentPtr())
+        m_graphCache.ForwardPropLoop(m_nestedNodes, m_nestedNodes[0]->Environment(), [this]() { ForwardPropTimeSteps(); });
+    else
+        ForwardPropTimeSteps();
+
+    // Extreme Tracing, part 3/4
+    for (auto& node : m_nestedNodes)
+    {
+        if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode())
+        {
+            DumpNode<float>(node, /*dumpGradient=*/false) || DumpNode<double>(node, false);
+        }
+    }
+}
+
+void ComputationNetwork::SEQTraversalFlowControlNode::ForwardPropTimeSteps()
+{
     // for every time step run through all nodes in this particular loop (treat the loop like a little ComputationNetwork)
     // Note: Currently, this is limited to linear-time loops. But nothing stops the iteration below to, e.g., be a 2D iteration over an image
     // if we implement an according FrameRangeIteration.
@@ -270,19 +474,11 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     {
         for (auto& node : m_nestedNodes)
         {
+            NodeTimer timer(node, /*backward=*/false, /*isTimeStep=*/true);
             node->ForwardProp(t);
             node->BumpEvalTimeStamp();
         }
     }
-
-    // Extreme Tracing, part 3/4
-    for (auto& node : m_nestedNodes)
-    {
-        if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode())
-        {
-            DumpNode<float>(node, /*dumpGradient=*/false) || DumpNode<double>(node, false);
-        }
-    }
 }
 
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::EndForwardProp() /*override*/
@@ -310,6 +506,7 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
         for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
         {
             auto& node2 = *nodeIter2;
+            NodeTimer timer(node2, /*backward=*/true, /*isTimeStep=*/true, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
             node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
             // The above flags tell Backprop() to skip back-propagation from inside a node into
             // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
@@ -334,6 +531,7 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     for (auto nodeIter2 = m_nestedNodes.rbegin(); nodeIter2 != m_nestedNodes.rend(); ++nodeIter2)
     {
         auto& node2 = *nodeIter2;
+        NodeTimer timer(node2, /*backward=*/true, /*isTimeStep=*/false, false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
         node2->Backprop(FrameRange(m_nestedNodes[0]->GetMBLayout()), false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
     }
 
@@ -448,6 +646,11 @@ void ComputationNetwork::PrintComputationTree(const ComputationNodeBasePtr& root
 void ComputationNetwork::InvalidateCompiledNetwork()
 {
     m_isCompiled = false;
+    m_forwardGraphCache.Clear();
+    m_forwardPlanCache.Clear();
+    m_memoryPlanCache.Clear(m_matrixPool);
+    ClearElementwiseChains();
+    ClearLoopInvariantProducts();
     m_allSEQNodes.clear();
     m_evalOrders.clear();
     m_nestedNetworks.clear();
@@ -462,12 +665,46 @@ void ComputationNetwork::VerifyIsCompiled(const char* where) const
         LogicError("%s: A compiled network was expected.", where);
 }
 
+// helper to log the time of each step of CompileNetwork(), which dominates the construction of very large networks
+class CompileStepTimer
+{
+public:
+    CompileStepTimer() : m_start(chrono::steady_clock::now()), m_last(m_start) { }
+    void Step(const char* name)
+    {
+        let now = chrono::steady_clock::now();
+        m_steps.push_back(make_pair(name, chrono::duration<double>(now - m_last).count()));
+        m_last = now;
+    }
+    void Print(size_t numNodes) const
+    {
+        fprintf(stderr, "Post-processing took %.3f seconds for %d nodes:\n", chrono::duration<double>(m_last - m_start).count(), (int)numNodes);
+        for (const auto& step : m_steps)
+            fprintf(stderr, "\t%-28s %9.3f seconds\n", step.first, step.second);
+    }
+private:
+    chrono::steady_clock::time_point m_start, m_last;
+    vector<pair<const char*, double>> m_steps;
+};
+
 // CompileNetwork() -- bring network into executable state
 // Call this after creation, load, and any modification.
 // This method sets up all members that are cleared in InvalidateCompiledNetwork();
 // TODO: This is in a somewhat partial state in that we now have a global eval order (keyed by a nullptr), but don't use it yet.
 void ComputationNetwork::CompileNetwork()
 {
+    if (IsEditing()) // deferred to EndEdits()
+    {
+        InvalidateCompiledNetwork();
+        return;
+    }
+
+    PROFILE_SCOPE(profilerEvtLoadCompile);
+    CompileStepTimer timer;
+
+    // after batched edits, only the nodes affected by them are validated (see EndEdits())
+    auto stateBeforeEdits = move(m_stateBeforeEdits);
+
     if (TraceLevel() > 0)
     fprintf(stderr, "\nPost-processing network...\n");
 
@@ -491,6 +728,7 @@ void ComputationNetwork::CompileNetwork()
     // STEP: Create a depth-first tree-traversal order through complete graph.
     // TODO: Do not cache this before reordering; get list & pass to FormRecurrentLoops() which reorders it, then store it (such that GetEvalOrder(nullptr) is always valid w.r.t. loops).
     FormEvalOrder(nullptr);
+    timer.Step("roots and evaluation order");
 
     // STEP: Form the m_inputValues and m_learnableParameters sets for the entire network.
     // Needed for ResetMBLayouts() below.
@@ -500,12 +738,24 @@ void ComputationNetwork::CompileNetwork()
     // STEP: Establish time-axis relationships.
     // This sets all MBLayout pointers of Input nodes according to user spec of time axes.
     // TODO: Don't use m_inputValues, traverse ourselves, to remove dependency on FormEvalOrder().
-    ResetMBLayouts();
+    ResetMBLayouts(/*keepDynamicAxes=*/ !!stateBeforeEdits);
+    unordered_set<ComputationNodeBasePtr> nodesAffectedByEdits;
+    if (stateBeforeEdits)
+        nodesAffectedByEdits = DetermineNodesAffectedByEdits(*stateBeforeEdits);
+    timer.Step("inputs and parameters");
 
     // STEP: Discover nested loops.
     FormRecurrentLoops(nullptr); // form the global one  --TODO: just use this; should be no need to do this for each root
     //for (auto& node : m_allRoots)
     //    FormRecurrentLoops(node); // BUGBUG: These calls are needed because they patch EvalOrders. Will be unnecessary once we move this out.
+    timer.Step("recurrent loops");
+
+    // STEP: Move nodes to the devices they are placed on. This must precede validation, which creates device-specific state.
+    if (PlaceNodesOnDevices()) // copies between devices were inserted, so the graph must be compiled again
+    {
+        CompileNetwork();
+        return;
+    }
 
     // STEP: Create loop-corrected depth-first traversals and cached input/parameter sets for every actual root node.
     for (auto& root : m_allRoots)
@@ -517,22 +767,125 @@ void ComputationNetwork::CompileNetwork()
     // STEP: Form nested structure of PAR and SEQ traversal nodes.
     for (auto& node : m_allRoots)
         FormNestedNetwork(node);
+    timer.Step("evaluation order per root");
 
     // STEP: Infer node dimensions.
-    ValidateNetwork();
+    ValidateNetwork(stateBeforeEdits ? &nodesAffectedByEdits : nullptr);
+    timer.Step("validation");
 
     // STEP: Optimize the network.
-    // :)
+    if (Globals::ShouldSimplifyNetwork() && SimplifyNetwork()) // the graph has changed, so it must be compiled again
+    {
+        CompileNetwork();
+        return;
+    }
+    if (Globals::ShouldFuseBatchNormActivations()) // first, as the elementwise chains could take the ReLUs and sums
+        FuseBatchNormActivations();
+    if (Globals::ShouldCompactGapFrames()) // before the elementwise chains, which would take the operations on the products
+        FormCompactedRuns();
+    if (Globals::ShouldFuseElementwiseOps())
+        FuseElementwiseChains();
+    if (Globals::ShouldHoistLoopInvariantProducts())
+        HoistLoopInvariantProducts();
+    timer.Step("optimizations");
 
     // STEP: Some final details.
     ResetEvalTimeStamps(); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
 
     if (TraceLevel() > 0)
-        fprintf(stderr, "\nPost-processing network complete.\n\n");
+    {
+        fprintf(stderr, "\nPost-processing network complete.\n");
+        timer.Print(GetTotalNumberOfNodes());
+        fprintf(stderr, "\n");
+    }
 
     m_isCompiled = true;
 }
 
+// group chains of elementwise nodes into FusedElementwiseChains (see ElementwiseFusion.h)
+void ComputationNetwork::FuseElementwiseChains()
+{
+    auto chains = FusedElementwiseChain::Find(GetEvalOrder(nullptr), m_allRoots);
+    for (const auto& chain : chains)
+    {
+        for (const auto& node : chain->GetNodes())
+            node->m_fusedChain = chain;
+    }
+
+    if (TraceLevel() > 0 && !chains.empty())
+    {
+        fprintf(stderr, "\nFused %d chains of elementwise operations:\n", (int)chains.size());
+        for (const auto& chain : chains)
+        {
+            fprintf(stderr, "\t%ls = %ls() <-", chain->GetRoot()->NodeName().c_str(), chain->GetRoot()->OperationName().c_str());
+            for (const auto& node : chain->GetNodes())
+            {
+                if (node != chain->GetRoot())
+                    fprintf(stderr, " %ls", node->NodeName().c_str());
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+}
+
+// group batch normalizations with the ReLUs that consume them into FusedBatchNormActivations (see BatchNormActivationFusion.h)
+void ComputationNetwork::FuseBatchNormActivations()
+{
+    auto groups = FusedBatchNormActivation::Find(GetEvalOrder(nullptr), m_allRoots);
+    for (const auto& group : groups)
+    {
+        for (const auto& node : group->GetNodes())
+            node->m_fusedChain = group;
+    }
+
+    if (TraceLevel() > 0 && !groups.empty())
+    {
+        fprintf(stderr, "\nFused %d batch normalizations with their activations:\n", (int)groups.size());
+        for (const auto& group : groups)
+        {
+            fprintf(stderr, "\t%ls = %ls() <-", group->GetRoot()->NodeName().c_str(), group->GetRoot()->OperationName().c_str());
+            for (const auto& node : group->GetNodes())
+            {
+                if (node != group->GetRoot())
+                    fprintf(stderr, " %ls", node->NodeName().c_str());
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+}
+
+// group runs of products and elementwise nodes into CompactedRuns, which skip the gap frames (see GapCompaction.h)
+void ComputationNetwork::FormCompactedRuns()
+{
+    auto runs = CompactedRun::Find(GetEvalOrder(nullptr), m_allRoots);
+    for (const auto& run : runs)
+    {
+        for (const auto& node : run->GetNodes())
+            node->m_fusedChain = run;
+    }
+
+    if (TraceLevel() > 0 && !runs.empty())
+    {
+        fprintf(stderr, "\nCompacted %d runs of operations to the frames without gaps:\n", (int)runs.size());
+        for (const auto& run : runs)
+        {
+            fprintf(stderr, "\t%ls = %ls() <-", run->GetRoot()->NodeName().c_str(), run->GetRoot()->OperationName().c_str());
+            for (const auto& node : run->GetNodes())
+            {
+                if (node != run->GetRoot())
+                    fprintf(stderr, " %ls", node->NodeName().c_str());
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+}
+
+void ComputationNetwork::ClearElementwiseChains()
+{
+    for (const auto& iter : m_nameToNodeMap)
+        iter.second->m_fusedChain.reset();
+}
+
 // determine the set of all root nodes
 // Roots are nodes that ForwardProp() may be called for.
 //  - training criterion, eval criteria
@@ -593,20 +946,33 @@ void ComputationNetwork::DetermineSetOfAllRoots()
 // initial setup of MBLayout pointers
 //  - link all input nodes to one or more MBLayouts
 //  - reset all others to nullptr, in expectation of a ValidateNetwork() pass
-void ComputationNetwork::ResetMBLayouts()
+void ComputationNetwork::ResetMBLayouts(bool keepDynamicAxes)
 {
     // reset to a well-defined MBLayout (any meaningful layout should do here)
     // Note that Validate is never called during operation. Any actual computation will lead to MBLayout to be set.
     m_pMBLayoutOfNetwork->Init(1, 0);
 
+    // DynamicAxis nodes are (apart from the soon-to-be-deprecated network-wide MBLayout) the main holders of MBLayouts. Initialize them.
+    // The only other instances are nodes that change the MBLayout, like WhereNode.
+    // With keepDynamicAxes (after edits), they keep their MBLayout object like the network-wide one, so that the nodes
+    // which are not validated again remain linked to it.
+    map<ComputationNodeBasePtr, MBLayoutPtr> dynamicAxes;
+    for (auto node : GetNodesWithType(L"DynamicAxis"))
+    {
+        auto pMBLayout = keepDynamicAxes ? node->GetMBLayout() : nullptr;
+        if (pMBLayout)
+            pMBLayout->Init(1, 0);
+        else
+            pMBLayout = make_shared<MBLayout>(1, 0, node->GetName());
+        dynamicAxes[node] = pMBLayout;
+    }
+
     // first reset all
     for (const auto& node : GetAllNodesForRoot(nullptr))
         node->LinkToMBLayout(nullptr);
 
-    // DynamicAxis nodes are (apart from the soon-to-be-deprecated network-wide MBLayout) the main holders of MBLayouts. Initialize them.
-    // The only other instances are nodes that change the MBLayout, like WhereNode. 
-    for (auto node : GetNodesWithType(L"DynamicAxis"))
-        node->LinkToMBLayout(make_shared<MBLayout>(1, 0, node->GetName()));
+    for (const auto& axis : dynamicAxes)
+        axis.first->LinkToMBLayout(axis.second);
 
     // This is now initialized inside of the Input nodes, with the proper connections.
     for (auto node : InputNodes(nullptr))
@@ -641,6 +1007,59 @@ void ComputationNetwork::ResetMBLayouts()
     }
 }
 
+// After batched edits (see EndEdits()), determine the nodes that must be validated again: the new nodes, those whose
+// inputs, dimensions, or parameter updates were changed, those that ResetMBLayouts() linked to another MBLayout, and
+// all nodes that depend on them. The other nodes get back their MBLayouts, which ResetMBLayouts() has cleared.
+unordered_set<ComputationNodeBasePtr> ComputationNetwork::DetermineNodesAffectedByEdits(const NetworkStateBeforeEdits& stateBeforeEdits)
+{
+    const auto& nodes = GetEvalOrder(nullptr);
+
+    unordered_set<ComputationNodeBasePtr> affectedNodes;
+    for (const auto& node : nodes)
+    {
+        auto iter = stateBeforeEdits.find(node);
+        if (iter == stateBeforeEdits.end() ||
+            iter->second.m_inputs != node->GetInputs() ||
+            iter->second.m_sampleLayout != node->GetSampleLayout() ||
+            iter->second.m_isParameterUpdateRequired != node->IsParameterUpdateRequired() ||
+            (node->HasMBLayout() && node->GetMBLayout() != iter->second.m_pMBLayout)) // inputs and DynamicAxis nodes
+        {
+            affectedNodes.insert(node);
+        }
+    }
+
+    // add the nodes that depend on them
+    // In the evaluation order, the inputs of a node come before it, except for the delayed inputs in loops.
+    for (bool hasAdded = true; hasAdded;)
+    {
+        hasAdded = false;
+        for (const auto& node : nodes)
+        {
+            if (affectedNodes.find(node) != affectedNodes.end())
+                continue;
+            for (const auto& input : node->GetInputs())
+            {
+                if (affectedNodes.find(input) != affectedNodes.end())
+                {
+                    affectedNodes.insert(node);
+                    hasAdded = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (const auto& node : nodes)
+    {
+        if (affectedNodes.find(node) == affectedNodes.end())
+            node->LinkToMBLayout(stateBeforeEdits.at(node).m_pMBLayout);
+    }
+
+    if (TraceLevel() > 0)
+        fprintf(stderr, "\n%d of %d nodes are affected by the edits.\n", (int)affectedNodes.size(), (int)nodes.size());
+    return affectedNodes;
+}
+
 // -----------------------------------------------------------------------
 // validation
 // -----------------------------------------------------------------------
@@ -649,15 +1068,28 @@ void ComputationNetwork::ResetMBLayouts()
 // This calls Validate() on every node in evaluation order (allowing to propagate things forwards through the net).
 // This is called lazily but once only per node until next ClearCache().
 // MBLayout links are expected to have been set up already for inputs, and reset to nullptr for all other nodes.
-void ComputationNetwork::ValidateNetwork()
+// If nodesToValidate is given, the other nodes keep the state of their last validation instead.
+void ComputationNetwork::ValidateNetwork(const unordered_set<ComputationNodeBasePtr>* nodesToValidate)
 {
+    PROFILE_SCOPE(profilerEvtLoadValidate);
+
     // we call all nodes' Validate() in order to validate, that is, set up MBLayout and FunctionValues dimension
     // A problem is that recurrent loops may require partial validation.
     // Nodes validated on partial input (i.e. some children not yet validated) will be revisited.
     const auto& nodes = GetEvalOrder(nullptr);
 
+    ValidationChangeTracker changes;
     for (auto& node : nodes)
     {
+        if (nodesToValidate && nodesToValidate->find(node) == nodesToValidate->end())
+        {
+            auto& state = changes.m_nodes[node.get()]; // validated before, and skipped unless a consumer infers its dimensions
+            state.m_validated = true;
+            state.m_allInputsVisited = true;
+            state.m_isKept = true;
+            node->m_visited = true;
+            continue;
+        }
         node->m_visited = false;
         node->m_needsGradient = node->IsParameterUpdateRequired(); // these get propagated upwards in the following
     }
@@ -666,20 +1098,22 @@ void ComputationNetwork::ValidateNetwork()
     // steps:
     //  - validate (not final)          // not final means no dimension checks
     //    Keep going through the list until all nodes have been validated and all inputs have been validated as well.
+    //    The first pass visits all nodes in topological order, which settles any network without loops or dimensions
+    //    inferred backwards. Later passes only visit the nodes that may have changed (see NeedsRevalidation()).
     //  - validate (final)              // final means consistency checks
     //    Fail if any change during this stage.
     size_t pass = 1;
-    size_t toValidate = nodes.size();
+    size_t toValidate = nodesToValidate ? nodesToValidate->size() : nodes.size();
     while (toValidate > 0)
     {
         if (TraceLevel() > 0)
         fprintf(stderr, "\nValidating network. %d nodes to process in pass %d.\n\n", (int) toValidate, (int) pass);
-        toValidate = ValidateNodes(nodes, /*isFirstPass=*/pass == 1, false /*isFinalValidationPass*/);
+        toValidate = ValidateNodes(nodes, /*isFirstPass=*/pass == 1, false /*isFinalValidationPass*/, changes);
         pass++;
     }
     if (TraceLevel() > 0)
     fprintf(stderr, "\nValidating network, final pass.\n\n");
-    toValidate = ValidateNodes(nodes, /*isFirstPass=*/pass == 1, true /*isFinalValidationPass*/);
+    toValidate = ValidateNodes(nodes, /*isFirstPass=*/pass == 1, true /*isFinalValidationPass*/, changes);
     if (toValidate != 0)
         LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
 
@@ -725,7 +1159,7 @@ static pair<TensorShape, bool> GetDims(const ComputationNodeBasePtr& node)
     return make_pair(node->GetSampleLayout(), node->HasMBLayout());
 }
 
-bool ComputationNetwork::ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const
+bool ComputationNetwork::ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass, bool* inputsChanged) const
 {
     const auto& children = node->GetInputs();
 
@@ -758,19 +1192,43 @@ bool ComputationNetwork::ValidateNode(ComputationNodeBasePtr node, bool isFinalV
     for (auto& child : children)
         newChildDims.push_back(GetDims(child));
     unchanged &= (childDims == newChildDims);
+    if (inputsChanged)
+        *inputsChanged = (childDims != newChildDims);
     unchanged &= (sampleLayout == node->GetSampleLayout());
     unchanged &= (needsGradient == node->m_needsGradient);
     unchanged &= (nodeNeedsDynamicValidation == node->m_needsDynamicValidation);
     return !unchanged;
 }
 
+// A node must be validated again if it was validated before all of its inputs were, or if it or any of its inputs
+// changed since. Validate() only depends on the inputs and the node itself, so anything else would not change it.
+// Changes of the node itself come from consumers that infer its dimensions (e.g. of a LearnableParameter).
+bool ComputationNetwork::ValidationChangeTracker::NeedsRevalidation(const ComputationNodeBasePtr& node)
+{
+    const auto& state = m_nodes[node.get()];
+    if (!state.m_validated || !state.m_allInputsVisited || state.m_changedAt > state.m_validatedAt)
+        return true;
+    for (const auto& child : node->GetInputs())
+    {
+        auto iter = m_nodes.find(child.get());
+        if (iter == m_nodes.end() || iter->second.m_changedAt > state.m_validatedAt)
+            return true;
+    }
+    return false;
+}
+
 // perform one pass of validation over the topologically-sorted node set
+// Passes other than the first and the final one skip the nodes that do not need to be validated again.
 // returns how many nodes either could not yet be validated yet or have changed and thus must be redone
-size_t ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass)
+size_t ComputationNetwork::ValidateNodes(const list<ComputationNodeBasePtr>& nodes, bool isFirstPass, bool isFinalValidationPass, ValidationChangeTracker& changes)
 {
+    const bool isIncremental = !isFirstPass && !isFinalValidationPass;
     size_t todo = 0;
     for (auto& node : nodes)
     {
+        if ((isIncremental || changes.m_nodes[node.get()].m_isKept) && !changes.NeedsRevalidation(node))
+            continue;
+
         const auto& children = node->GetInputs();
         const bool isLeaf = node->IsLeaf();
         // only validate a node if it has at least one child
@@ -791,27 +1249,50 @@ size_t ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, boo
         bool valid = false;
         if (hasVisitedChild || isLeaf) // got at least one child: it makes sense to call Validate()
         {
-            string prevPrototype = node->FormatOperationPrototype("");
+            // (formatting the prototype is expensive, so it is only done for the log)
+            string prevPrototype = TraceLevel() > 0 ? node->FormatOperationPrototype("") : string();
             bool unchanged;
+            bool inputsChanged;
             try
             {
-                unchanged = !ValidateNode(node, isFinalValidationPass);
-                string updatedPrototype = node->FormatOperationPrototype("");
-#if 0           // print prototype in final validation pass. Problematic for tracking down validation errors in loops.
-                unchanged;
-                if (isFinalValidationPass)
-#else           // print prototype upon every change (useful for debugging)
-                if (isFirstPass || !unchanged || prevPrototype != updatedPrototype)
+                unchanged = !ValidateNode(node, isFinalValidationPass, &inputsChanged);
+                if (TraceLevel() > 0)
+                {
+                    string updatedPrototype = node->FormatOperationPrototype("");
+#if 0               // print prototype in final validation pass. Problematic for tracking down validation errors in loops.
+                    unchanged;
+                    if (isFinalValidationPass)
+#else               // print prototype upon every change (useful for debugging)
+                    if (isFirstPass || !unchanged || prevPrototype != updatedPrototype)
 #endif
-                    if (TraceLevel() > 0)
-                    fprintf(stderr, "Validating --> %s\n", updatedPrototype.c_str());
+                        fprintf(stderr, "Validating --> %s\n", updatedPrototype.c_str());
+                }
             }
             catch (...) // if validation failed then print the prototype anyway so one can see the input args
             {
+                if (prevPrototype.empty())
+                    prevPrototype = node->FormatOperationPrototype("");
                 fprintf(stderr, "Validating --> %s FAILED\n", prevPrototype.c_str());
                 throw;
             }
             node->m_visited = true;
+
+            // remember what changed for the next pass
+            auto& state = changes.m_nodes[node.get()];
+            if (!unchanged)
+            {
+                changes.m_numChanges++;
+                state.m_changedAt = changes.m_numChanges;
+                if (inputsChanged) // Validate() inferred dimensions of the inputs
+                {
+                    for (auto& child : children)
+                        changes.m_nodes[child.get()].m_changedAt = changes.m_numChanges;
+                }
+            }
+            state.m_validated = true;
+            state.m_allInputsVisited = allChildrenVisited;
+            state.m_validatedAt = changes.m_numChanges;
+
             // print the new type
             // sanity checks
             if (isFinalValidationPass && !unchanged)
@@ -825,6 +1306,17 @@ size_t ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, boo
         if (!valid)
             todo++;
     }
+    if (isFinalValidationPass)
+        return todo;
+
+    // Otherwise, count those that may change in the next pass instead. This must be done after the pass, since nodes
+    // later in it may have changed inputs of nodes earlier in it.
+    todo = 0;
+    for (auto& node : nodes)
+    {
+        if (changes.NeedsRevalidation(node))
+            todo++;
+    }
     return todo;
 }
 
@@ -892,6 +1384,41 @@ void ComputationNetwork::MarkValueNonSharableNodes()
     }
 }
 
+// Keeps the values of the nodes that the forward passes of more than one of 'roots' share out of memory sharing, so that the
+// forward pass of one root cannot overwrite values that a later forward pass of another root reads without computing them
+// again (see CNTK::Function::EvaluateCached()). Does nothing and returns false if these take more than 'maxBytesPerSample'
+// (0: no limit). Must be called before AllocateAllMatrices().
+bool ComputationNetwork::RetainSharedValues(const std::vector<ComputationNodeBasePtr>& roots, size_t maxBytesPerSample)
+{
+    VerifyIsCompiled("RetainSharedValues");
+    if (AreMatricesAllocated())
+        LogicError("RetainSharedValues: The matrices of the network are allocated already.");
+
+    std::map<ComputationNodeBasePtr, size_t> numRoots; // number of roots whose forward pass evaluates the node
+    for (const auto& root : set<ComputationNodeBasePtr>(roots.begin(), roots.end()))
+    {
+        for (const auto& node : GetEvalOrder(root))
+            numRoots[node]++;
+    }
+
+    std::vector<ComputationNodeBasePtr> sharedNodes;
+    size_t bytesPerSample = 0;
+    for (const auto& entry : numRoots)
+    {
+        const auto& node = entry.first;
+        if (entry.second < 2 || node->IsLeaf() || !node->IsValueSharable())
+            continue;
+        sharedNodes.push_back(node);
+        bytesPerSample += node->GetSampleLayout().GetNumElements() * (node->Is<ComputationNode<float>>() ? sizeof(float) : sizeof(double));
+    }
+    if (maxBytesPerSample > 0 && bytesPerSample > maxBytesPerSample)
+        return false;
+
+    for (const auto& node : sharedNodes)
+        node->MarkValueNonSharable();
+    return true;
+}
+
 // From the set of nodes extract all nodes which are used as accumulator nodes.
 set<ComputationNodeBasePtr> ComputationNetwork::ExtractNodesWhichAccumulateResult(set<ComputationNodeBasePtr> candidates)
 {
@@ -1021,21 +1548,27 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                                              const std::vector<ComputationNodeBasePtr>& outValueRootNodes,
                                              ComputationNodeBasePtr trainRootNode)
 {
+    std::vector<ComputationNodeBasePtr> forwardPropRoots;
+    forwardPropRoots.insert(forwardPropRoots.end(), evalRootNodes.begin(), evalRootNodes.end());
+    forwardPropRoots.insert(forwardPropRoots.end(), outValueRootNodes.begin(), outValueRootNodes.end());
+    if (trainRootNode != nullptr)
+        forwardPropRoots.push_back(trainRootNode);
+
+    // the parameters that these roots need, if they were left in the model file (also if the matrices are allocated already)
+    if (IsCompiled())
+        MaterializeParameters(forwardPropRoots);
+
     if (AreMatricesAllocated())
         return;
 
+    PROFILE_SCOPE(profilerEvtLoadAllocate);
+
     // Allocate memory for forward/backward computation
     if (TraceLevel() > 0)
         fprintf(stderr, "\n\nAllocating matrices for forward and/or backward propagation.\n");
 
     VerifyIsCompiled("AllocateAllMatrices");
 
-    std::vector<ComputationNodeBasePtr> forwardPropRoots;
-    forwardPropRoots.insert(forwardPropRoots.end(), evalRootNodes.begin(), evalRootNodes.end());
-    forwardPropRoots.insert(forwardPropRoots.end(), outValueRootNodes.begin(), outValueRootNodes.end());
-    if (trainRootNode != nullptr)
-        forwardPropRoots.push_back(trainRootNode);
-
     // Mark all the eval, output and criterion roots as non-shareable
     for (auto& rootNode : forwardPropRoots)
         rootNode->MarkValueNonSharable();
@@ -1080,7 +1613,9 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     {
         // Indicate on the node that it's parent overwrites its gradient if the node is not part of a loop
         // and has exactly one parent who implements the gradient overwrite optimization
+        // (Not so for learnable parameters whose gradients are accumulated over several backprops.)
         if (Globals::ShouldOptimizeGradientAccumulation() &&
+            !(m_parameterGradientAccumulation && keyValue.first->IsLearnableParameter()) &&
             !keyValue.first->IsPartOfLoop() &&
             (keyValue.second.size() == 1) &&
             (*keyValue.second.begin())->ImplementsGradientOverwriteOptimization())
@@ -1094,9 +1629,43 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // The root of a fused chain of elementwise nodes reads the chain's leaves in both passes, in place of the interior nodes.
+    for (const auto& node : uniqueForwardPropEvalNodes)
+    {
+        const auto& chain = node->GetFusedChain();
+        if (!chain || chain->GetRoot() != node)
+            continue;
+        for (const auto& leaf : chain->GetLeaves())
+        {
+            parentsMap[leaf].insert(node);
+            if (performingBackPropagation && node->NeedsGradient())
+                outputValueNeededDuringBackProp[leaf] = true;
+        }
+    }
+
+    // Concurrent execution must be planned first: matrices of nodes that may run at the same time cannot be shared.
+    PlanConcurrentExecution(forwardPropRoots, trainRootNode);
+    PlanRecomputation(trainRootNode, parentsMap, outputValueNeededDuringBackProp);
+    PlanOffloading(trainRootNode, parentsMap, outputValueNeededDuringBackProp);
+    int concurrentRegion = -1;
+    auto enterConcurrentRegion = [&concurrentRegion, this](StreamSchedule::Pass pass, const ComputationNodeBasePtr& node)
+    {
+        if (node && node->GetNumInputs() == 0 && !node->Is<SEQTraversalFlowControlNode>())
+            return; // not scheduled, does not compute anything
+        const int region = m_streamSchedule && node ? m_streamSchedule->GetRegion(pass, node) : -1;
+        if (region == concurrentRegion)
+            return;
+        if (concurrentRegion >= 0)
+            m_matrixPool.EndConcurrentRegion();
+        if (region >= 0)
+            m_matrixPool.BeginConcurrentRegion();
+        concurrentRegion = region;
+    };
+
     m_matrixPool.ResetStepCounter();
 
-    TravserseInSortedGlobalEvalOrder(forwardPropRoots, [&outputValueNeededDuringBackProp, &parentsMap, this](const ComputationNodeBasePtr& node) {
+    TravserseInSortedGlobalEvalOrder(forwardPropRoots, [&outputValueNeededDuringBackProp, &parentsMap, &enterConcurrentRegion, this](const ComputationNodeBasePtr& node) {
+        enterConcurrentRegion(StreamSchedule::Pass::Forward, node);
         if (node->Is<SEQTraversalFlowControlNode>())
         {
             auto seqTraversalFlowControlNode = node->As<SEQTraversalFlowControlNode>();
@@ -1117,6 +1686,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             ReleaseMatricesAfterEvalForChildren(node, parentsMap);
         }
     });
+    enterConcurrentRegion(StreamSchedule::Pass::Forward, nullptr);
 
     if (trainRootNode != nullptr)
     {
@@ -1128,6 +1698,20 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         // we need to call it here since we always compute gradients for children and root node is not children of other node
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
 
+        // offloaded values are kept again from where they are copied back (see PlanOffloading())
+        auto prefetchOffloadedValues = [this](const ComputationNodeBasePtr& node)
+        {
+            if (!node->GetOffloadActions() || node->GetOffloadActions()->valuesToPrefetch.empty())
+                return;
+            m_matrixPool.BeginRecomputation();
+            for (const auto& offload : node->GetOffloadActions()->valuesToPrefetch)
+            {
+                offload->GetNode()->RequestMatricesBeforeForwardProp(m_matrixPool);
+                offload->GetNode()->ReleaseMatricesAfterForwardProp(m_matrixPool);
+            }
+            m_matrixPool.EndRecomputation();
+        };
+
         for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
         {
             auto n = *iter;
@@ -1137,6 +1721,8 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                 shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, n);
                 if (completedGradient.insert(recInfo).second)
                 {
+                    enterConcurrentRegion(StreamSchedule::Pass::Backward, recInfo);
+                    prefetchOffloadedValues(recInfo);
                     // SEQ mode: allocate all in loop first, then deallocate again
                     // TODO: next step: use PARTraversalFlowControlNode::AllocateGradientMatricesForInputs() and ReleaseMatricesAfterBackprop()...
                     // BUGBUG: naw, ^^ would not work! Wrong order! Need to rethink this. Need to make AllocateEvalMatrices() and AllocateGradientMatrices() the virtual functions.
@@ -1148,6 +1734,23 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             else
             {
                 // PAR mode: we can allocate and immediately deallocate one by one
+                enterConcurrentRegion(StreamSchedule::Pass::Backward, n);
+                prefetchOffloadedValues(n);
+                if (!n->GetNodesToRecomputeBeforeBackprop().empty()) // their values are kept again from here on
+                {
+                    m_matrixPool.BeginRecomputation();
+                    for (const auto& recomputedNode : n->GetNodesToRecomputeBeforeBackprop())
+                    {
+                        recomputedNode->RequestMatricesBeforeForwardProp(m_matrixPool);
+                        recomputedNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
+                    }
+                    m_matrixPool.EndRecomputation();
+                }
+                if (n->GetFusedChain() && n->GetFusedChain()->GetRoot() == n) // the root computes the gradients of the whole chain
+                {
+                    for (const auto& chainNode : n->GetFusedChain()->GetNodes())
+                        chainNode->AllocateGradientMatricesForInputs(m_matrixPool);
+                }
                 n->AllocateGradientMatricesForInputs(m_matrixPool);
                 // Root node's information will be used and should not be shared with others, also it's small (1x1)
                 if ((n != trainRootNode) && n->NeedsGradient())
@@ -1156,8 +1759,25 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    enterConcurrentRegion(StreamSchedule::Pass::Backward, nullptr);
+
+    auto profMemoryPlan = ProfilerTimeBegin();
     m_matrixPool.OptimizedMemoryAllocation(); 
+    ProfilerTimeEnd(profMemoryPlan, profilerEvtLoadMemoryPlan);
     m_areMatricesAllocated = true;
+    m_forwardGraphCache.Clear(); // the node values have moved
+    for (auto& loop : m_allSEQNodes)
+        loop->ClearGraphCache();
+    m_forwardPlanCache.Clear();
+    m_memoryPlanCache.Clear(m_matrixPool);
+
+    if (!MemoryReport::GetOutputPath().empty())
+    {
+        MemoryReport report;
+        m_matrixPool.FillReport(report);
+        report.Write(MemoryReport::GetOutputPath());
+        fprintf(stderr, "\nMemory report of %d matrices in %d buffers written to %ls.\n", (int)report.requests.size(), (int)report.numBuffers, MemoryReport::GetOutputPath().c_str());
+    }
 
     // TO DO: At the time of AllocateAllMatrices we don't know the minibatch size. In theory one may allocate memory again once we start to receive
     // data from the reader (and the minibatch size is known). For some problems, minibatch size can change constantly, and there needs to be a 
@@ -1171,6 +1791,357 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         PrintMemorySharingStructure(GetAllNodes());
 }
 
+size_t ComputationNetwork::GetMaxSamplesInMemory(size_t budgetBytes, size_t numParameterCopies)
+{
+    if (!AreMatricesAllocated())
+        LogicError("GetMaxSamplesInMemory: AllocateAllMatrices() has not been called.");
+
+    MemoryReport report;
+    m_matrixPool.FillReport(report);
+    std::set<int> devices = report.GetDevices();
+
+    // the inputs and the parameters are not taken from the pool; each input gets a buffer of its own (sparse ones are counted as dense)
+    for (const auto& node : GetAllNodes())
+    {
+        if (node->OperationName() != OperationNameOf(InputValue) && node->OperationName() != OperationNameOf(SparseInputValue))
+            continue;
+        bool isFloat = node->Is<ComputationNode<float>>();
+        report.requests.push_back(MemoryReport::Request{ node->NodeName(), "input", node->GetDeviceId(), isFloat ? sizeof(float) : sizeof(double),
+                                                         node->GetSampleLayout().GetNumElements(), true, false, 0, INT_MAX, report.numBuffers++, {} });
+        devices.insert(node->GetDeviceId());
+    }
+    std::map<int, size_t> parameterBytes;
+    for (const auto& node : GetNodesWithType(OperationNameOf(LearnableParameter)))
+    {
+        parameterBytes[node->GetDeviceId()] += node->GetSampleLayout().GetNumElements() * (node->Is<ComputationNode<float>>() ? sizeof(float) : sizeof(double));
+        devices.insert(node->GetDeviceId());
+    }
+
+    size_t maxSamples = SIZE_MAX;
+    for (int deviceId : devices)
+        maxSamples = min(maxSamples, report.GetMaxSamples(deviceId, budgetBytes, parameterBytes[deviceId] * numParameterCopies));
+    return maxSamples;
+}
+
+// plans the concurrent execution of the forward and backward passes of AllocateAllMatrices(), if enabled (numComputeStreams)
+void ComputationNetwork::PlanConcurrentExecution(const std::vector<ComputationNodeBasePtr>& forwardPropRoots, ComputationNodeBasePtr trainRootNode)
+{
+    m_streamSchedule.reset();
+    const size_t numStreams = Globals::GetNumComputeStreams();
+    if (numStreams < 2)
+        return;
+    auto streamSchedule = make_shared<StreamSchedule>(GetDeviceId(), numStreams);
+
+    // the order in which a pass executes the nodes, with loops represented by their SEQTraversalFlowControlNode
+    std::vector<ComputationNodeBasePtr> order;
+    std::unordered_map<ComputationNodeBasePtr, size_t> indices; // [node in order or member of a loop] -> index in order
+    auto addToOrder = [&](const ComputationNodeBasePtr& node)
+    {
+        if (node->Is<SEQTraversalFlowControlNode>())
+        {
+            for (auto& loopNode : node->As<SEQTraversalFlowControlNode>()->m_nestedNodes)
+                indices[loopNode] = order.size();
+        }
+        else if (node->GetNumInputs() == 0)
+            return; // does not compute anything in either pass
+        indices[node] = order.size();
+        order.push_back(node);
+    };
+    // a loop is scheduled as a whole, so it stands for all of its nodes
+    auto computingNodes = [](const ComputationNodeBasePtr& node)
+    {
+        return node->Is<SEQTraversalFlowControlNode>() ? node->As<SEQTraversalFlowControlNode>()->m_nestedNodes : std::vector<ComputationNodeBasePtr>{ node };
+    };
+    auto addPredecessor = [](std::vector<size_t>& predecessors, size_t index, size_t predecessor)
+    {
+        if (predecessor < index && std::find(predecessors.begin(), predecessors.end(), predecessor) == predecessors.end())
+            predecessors.push_back(predecessor);
+    };
+
+    // forward: the inputs of each node; for a loop, those of its nodes that are outside of the loop
+    TravserseInSortedGlobalEvalOrder(forwardPropRoots, addToOrder);
+    std::vector<std::vector<size_t>> predecessors(order.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        for (auto& node : computingNodes(order[i]))
+        {
+            for (auto& input : node->GetInputs())
+            {
+                auto iter = indices.find(input);
+                if (iter != indices.end())
+                    addPredecessor(predecessors[i], i, iter->second);
+            }
+        }
+    }
+    streamSchedule->Plan(StreamSchedule::Pass::Forward, order, predecessors);
+
+    // backward: the nodes that wrote the gradients of a node and of its inputs last; this is the order of AllocateAllMatrices()
+    if (trainRootNode)
+    {
+        order.clear();
+        indices.clear();
+        const std::list<ComputationNodeBasePtr>& backPropNodes = GetEvalOrder(trainRootNode);
+        set<ComputationNodeBasePtr> loopsSeen;
+        for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++)
+        {
+            if ((*iter)->IsPartOfLoop())
+            {
+                shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, *iter);
+                if (loopsSeen.insert(recInfo).second)
+                    addToOrder(recInfo);
+            }
+            else
+                addToOrder(*iter);
+        }
+        predecessors.assign(order.size(), std::vector<size_t>());
+        std::unordered_map<ComputationNodeBasePtr, size_t> lastGradientWriters; // [node] -> index in order
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            // the gradients that are read; within a loop, only those written outside of it
+            const auto writingNodes = computingNodes(order[i]);
+            for (auto& node : writingNodes)
+            {
+                auto writer = lastGradientWriters.find(node);
+                if (writer != lastGradientWriters.end())
+                    addPredecessor(predecessors[i], i, writer->second);
+            }
+            // the gradients that are accumulated into
+            for (auto& node : writingNodes)
+            {
+                for (auto& input : node->GetInputs())
+                {
+                    auto writer = lastGradientWriters.find(input);
+                    if (writer != lastGradientWriters.end())
+                        addPredecessor(predecessors[i], i, writer->second);
+                    lastGradientWriters[input] = i;
+                }
+            }
+        }
+        streamSchedule->Plan(StreamSchedule::Pass::Backward, order, predecessors, trainRootNode);
+    }
+
+    if (TraceLevel() > 0)
+        fprintf(stderr, "Concurrent execution on %d %s: %d nodes in %d regions in the forward pass, %d nodes in %d regions in the backward pass.\n",
+                (int) numStreams, GetDeviceId() < 0 ? "threads" : "streams",
+                (int) streamSchedule->GetNumConcurrentNodes(StreamSchedule::Pass::Forward), (int) streamSchedule->GetNumRegions(StreamSchedule::Pass::Forward),
+                (int) streamSchedule->GetNumConcurrentNodes(StreamSchedule::Pass::Backward), (int) streamSchedule->GetNumRegions(StreamSchedule::Pass::Backward));
+
+    m_streamSchedule = streamSchedule;
+    for (auto& nestedNetwork : m_nestedNetworks)
+        nestedNetwork.second->As<PARTraversalFlowControlNode>()->SetStreamSchedule(m_streamSchedule);
+}
+
+// gradient checkpointing: determine the values that are dropped after the forward pass and recomputed in the backward pass
+// The candidates are the nodes of the training criterion that are marked for recomputation (tag="recompute"), or all of them
+// if recomputeSegmentBytesPerSample is set, in which case consecutive candidates are split into segments whose values take at
+// most that many bytes per sample. The value of a candidate is recomputed if all its parents are in its segment, so that no
+// node outside of the segment reads it. The other values of the segment, and the inputs of the recomputed nodes, are kept
+// until their own backprop. The recomputation runs right before the backprop of the last node that reads a recomputed value.
+void ComputationNetwork::PlanRecomputation(ComputationNodeBasePtr trainRootNode, const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                           std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp)
+{
+    for (const auto& node : GetAllNodes())
+    {
+        node->m_valueRecomputed = false;
+        node->m_nodesToRecomputeBeforeBackprop.clear();
+    }
+    if (!trainRootNode)
+        return;
+
+    const size_t segmentBytesPerSample = Globals::GetRecomputeSegmentBytesPerSample();
+    const auto& evalOrder = GetEvalOrder(trainRootNode);
+    std::unordered_map<ComputationNodeBasePtr, size_t> positions;
+    std::vector<std::vector<ComputationNodeBasePtr>> segments(1);
+    size_t segmentBytes = 0;
+    size_t numIgnored = 0; // marked, but cannot be recomputed
+    for (const auto& node : evalOrder)
+    {
+        const size_t position = positions.size();
+        positions[node] = position;
+        const bool isCandidate = node != trainRootNode && !node->IsPartOfLoop() && node->GetNumInputs() > 0 && node->NeedsGradient() &&
+                                 node->IsValueSharable() && !node->IsValueSparse() && !node->GetFusedChain() && node->CanRecomputeValue();
+        if (!isCandidate || (segmentBytesPerSample == 0 && !node->IsMarkedForRecomputation()))
+        {
+            numIgnored += node->IsMarkedForRecomputation();
+            if (!segments.back().empty())
+                segments.emplace_back();
+            segmentBytes = 0;
+            continue;
+        }
+        const size_t bytes = node->GetSampleLayout().GetNumElements() * (node->Is<ComputationNode<float>>() ? sizeof(float) : sizeof(double));
+        if (segmentBytesPerSample > 0 && segmentBytes + bytes > segmentBytesPerSample && !segments.back().empty())
+        {
+            segments.emplace_back();
+            segmentBytes = 0;
+        }
+        segments.back().push_back(node);
+        segmentBytes += bytes;
+    }
+    if (numIgnored > 0)
+        fprintf(stderr, "WARNING: %d nodes marked for recomputation keep their values, since they are part of a loop or fused, or their operation cannot be recomputed.\n", (int) numIgnored);
+
+    // the nodes of each segment that no node outside of it reads, and the last node that reads them
+    std::vector<std::pair<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>> plan;
+    for (const auto& segment : segments)
+    {
+        std::unordered_set<ComputationNodeBasePtr> inSegment(segment.begin(), segment.end());
+        ComputationNodeBasePtr lastReader;
+        std::vector<ComputationNodeBasePtr> recomputedNodes;
+        for (const auto& node : segment)
+        {
+            auto parents = parentsMap.find(node);
+            if (parents == parentsMap.end() || parents->second.empty() ||
+                !std::all_of(parents->second.begin(), parents->second.end(), [&inSegment](const ComputationNodeBasePtr& parent) { return inSegment.find(parent) != inSegment.end(); }))
+                continue;
+            recomputedNodes.push_back(node);
+            for (const auto& parent : parents->second)
+            {
+                if (!lastReader || positions[parent] > positions[lastReader])
+                    lastReader = parent;
+            }
+        }
+        if (!recomputedNodes.empty())
+            plan.push_back(make_pair(lastReader, recomputedNodes));
+    }
+    if (plan.empty())
+        return;
+    if (m_streamSchedule)
+    {
+        fprintf(stderr, "WARNING: Node values are not recomputed in the backward pass when nodes run concurrently (numComputeStreams).\n");
+        return;
+    }
+
+    size_t numRecomputed = 0;
+    for (const auto& segment : plan)
+    {
+        for (const auto& node : segment.second)
+        {
+            node->m_valueRecomputed = true;
+            for (const auto& input : node->GetInputs())
+            {
+                if (!input->m_valueRecomputed)
+                    outputValueNeededDuringBackProp[input] = true; // read by the recomputation
+            }
+        }
+        segment.first->m_nodesToRecomputeBeforeBackprop = segment.second;
+        numRecomputed += segment.second.size();
+    }
+
+    if (TraceLevel() > 0)
+    {
+        fprintf(stderr, "\nRecomputing the values of %d nodes in %d segments in the backward pass:\n", (int) numRecomputed, (int) plan.size());
+        for (const auto& segment : plan)
+        {
+            fprintf(stderr, "\tbefore %ls = %ls():", segment.first->NodeName().c_str(), segment.first->OperationName().c_str());
+            for (const auto& node : segment.second)
+                fprintf(stderr, " %ls", node->NodeName().c_str());
+            fprintf(stderr, "\n");
+        }
+    }
+}
+
+// host-memory offloading: determine the values that are kept in host memory between the forward and the backward pass (see ValueOffload.h)
+// The candidates are the values of GPU nodes of the training criterion that the backward pass reads and that are not recomputed: those of
+// the nodes marked for offloading (tag="offload"), and those of all nodes in recurrent loops if offloadLoopValues is set. All nodes that
+// read them must be part of the training criterion. The GPU memory of such a value is released after the forward pass of its last reader
+// (see ReleaseMatricesAfterLastReader()), and it is copied back offloadPrefetchDistance nodes or loops, in backward order, before the
+// first backprop that reads it, i.e. that of the node, of its loop, or of one of its parents.
+void ComputationNetwork::PlanOffloading(ComputationNodeBasePtr trainRootNode, const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                        const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp)
+{
+    m_valueOffloads.clear();
+    for (const auto& node : GetAllNodes())
+    {
+        node->m_valueOffloaded = false;
+        node->m_offloadActions.reset();
+    }
+    for (const auto& loop : m_allSEQNodes)
+        loop->m_offloadActions.reset();
+    if (!trainRootNode)
+        return;
+
+    // the nodes of the PAR traversal of the criterion, with loops represented by their SEQTraversalFlowControlNode
+    std::vector<ComputationNodeBasePtr> order;
+    std::unordered_map<ComputationNodeBasePtr, size_t> positions; // [node] -> index in order
+    for (const auto& node : GetEvalOrder(trainRootNode))
+    {
+        ComputationNodeBasePtr item = node->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, node) : node;
+        if (order.empty() || order.back() != item) // the nodes of a loop are consecutive
+            order.push_back(item);
+        positions[node] = order.size() - 1;
+    }
+
+    const bool offloadLoopValues = Globals::ShouldOffloadLoopValues();
+    std::vector<ComputationNodeBasePtr> offloadedNodes;
+    size_t numIgnored = 0; // marked, but cannot be offloaded
+    for (const auto& node : GetEvalOrder(trainRootNode))
+    {
+        auto needed = outputValueNeededDuringBackProp.find(node);
+        if ((!node->IsMarkedForOffloading() && !(offloadLoopValues && node->IsPartOfLoop())) ||
+            needed == outputValueNeededDuringBackProp.end() || !needed->second) // released after the forward pass anyway
+            continue;
+        auto parents = parentsMap.find(node);
+        const bool isCandidate = node != trainRootNode && node->GetNumInputs() > 0 && node->NeedsGradient() && node->GetDeviceId() >= 0 &&
+                                 node->IsValueSharable() && !node->IsValueSparse() && !node->GetFusedChain() && !node->IsValueRecomputed() &&
+                                 parents != parentsMap.end() && !parents->second.empty() &&
+                                 std::all_of(parents->second.begin(), parents->second.end(), [&positions](const ComputationNodeBasePtr& parent) {
+                                     return positions.find(parent) != positions.end() && !parent->IsValueRecomputed();
+                                 });
+        if (isCandidate)
+            offloadedNodes.push_back(node);
+        else
+            numIgnored += node->IsMarkedForOffloading();
+    }
+    if (numIgnored > 0)
+        fprintf(stderr, "WARNING: %d nodes marked for offloading keep their values on the GPU, since they are not on the GPU, are fused, sparse or recomputed, or are read outside of the training criterion.\n", (int) numIgnored);
+    if (offloadedNodes.empty())
+        return;
+    if (m_streamSchedule || Globals::ShouldCaptureCudaGraphs())
+    {
+        fprintf(stderr, "WARNING: Node values are not offloaded to host memory when nodes run concurrently (numComputeStreams) or the forward pass is replayed from CUDA graphs (cudaGraphs).\n");
+        return;
+    }
+
+    const size_t prefetchDistance = Globals::GetOffloadPrefetchDistance();
+    for (const auto& node : offloadedNodes)
+    {
+        auto offload = make_shared<ValueOffload>(node);
+        node->m_valueOffloaded = true;
+        m_valueOffloads[node] = offload;
+        GetOrCreateOffloadActions(order[positions[node]]).valuesToOffload.push_back(offload);
+
+        size_t firstReader = positions[node];
+        for (const auto& parent : parentsMap.at(node))
+            firstReader = std::max(firstReader, positions[parent]);
+        GetOrCreateOffloadActions(order[std::min(firstReader + prefetchDistance, order.size() - 1)]).valuesToPrefetch.push_back(offload);
+        GetOrCreateOffloadActions(order[firstReader]).valuesToAwait.push_back(offload);
+    }
+
+    if (TraceLevel() > 0)
+    {
+        fprintf(stderr, "\nOffloading the values of %d nodes to host memory, copied back %d nodes or loops ahead of the backward pass:\n", (int) offloadedNodes.size(), (int) prefetchDistance);
+        for (const auto& node : offloadedNodes)
+            fprintf(stderr, "\t%ls = %ls()\n", node->NodeName().c_str(), node->OperationName().c_str());
+    }
+}
+
+/*static*/ ValueOffloadActions& ComputationNetwork::GetOrCreateOffloadActions(const ComputationNodeBasePtr& node)
+{
+    if (!node->m_offloadActions)
+        node->m_offloadActions = make_shared<ValueOffloadActions>();
+    return *node->m_offloadActions;
+}
+
+// releases the matrices of a node after the forward pass of the last node that reads them
+// An offloaded value must have reached host memory before its GPU memory is used by others.
+void ComputationNetwork::ReleaseMatricesAfterLastReader(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& lastReader)
+{
+    node->ReleaseMatricesAfterForwardProp(m_matrixPool);
+    auto offload = m_valueOffloads.find(node);
+    if (offload != m_valueOffloads.end())
+        GetOrCreateOffloadActions(lastReader->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, lastReader) : lastReader).valuesToRelease.push_back(offload->second);
+}
+
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap)
 {
     for (int i = 0; i < n->GetNumInputs(); i++)
@@ -1180,7 +2151,19 @@ void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBase
         {
             parentsMap[pNode].erase(n);
             if (parentsMap[pNode].empty())
-                pNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
+                ReleaseMatricesAfterLastReader(pNode, n);
+        }
+    }
+
+    // the root of a fused chain also reads the leaves of the chain
+    const auto& chain = n->GetFusedChain();
+    if (chain && chain->GetRoot() == n)
+    {
+        for (const auto& leaf : chain->GetLeaves())
+        {
+            auto& parents = parentsMap[leaf];
+            if (!parents.empty() && parents.erase(n) && parents.empty())
+                ReleaseMatricesAfterLastReader(leaf, n);
         }
     }
 }
@@ -0,0 +1,404 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ComputationNetworkInference.cpp -- rewrites a trained network into a smaller one that computes the same outputs in inference mode
+//
+// OptimizeForInference() (CNTKEval config optimizeForInference=true) applies these rewrites:
+//  - Dropout nodes are removed. In inference mode, they only copy their input.
+//  - A BatchNormalization node whose input is a Times or Convolution of a parameter is folded into that parameter. With
+//    a = scale / sqrt(runVariance + epsilon), the weights of each output element (Times) resp. map (Convolution) are scaled
+//    by a, and the BatchNormalization node becomes a Plus of the bias  bias - a .* runMean.
+//  - Subgraphs that only depend on parameters (e.g. a weight normalization, or the Times of the two factors of an SVD) are
+//    computed once and replaced by a parameter that holds their value.
+// Nodes in node groups (inputs, outputs, criteria etc.) are kept, since callers ask for them by name. Other nodes may be
+// folded away, their values cannot be asked for any more. Gradients are not touched: forward-only evaluation does not
+// allocate them (see AllocateAllMatrices()).
+//
+// SparsifyParametersForInference() (CNTKEval config sparseInferenceMaxDensity=d) stores pruned weights as sparse matrices:
+// a [M x K] parameter that is only used as the left operand of Times nodes, and has at most a fraction d of nonzeros, is
+// switched to a sparse matrix, CSC on the CPU and CSR on the GPU, the formats the sparse * dense products of the Matrix
+// library are fast for. TensorView then dispatches these products to the sparse kernels. With sparseInferenceBenchmarkColumns=N,
+// the dense and the sparse product with N random input columns are timed for each such parameter, and the density at which
+// both take equally long is logged, assuming the time of the sparse product is proportional to the number of nonzeros.
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "ComputationNetwork.h"
+#include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "ConvolutionalNodes.h"
+#include "TrainingNodes.h"
+#include "MatrixPool.h"
+#include "TimerUtility.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+template <class ElemType>
+static vector<ElemType> CopyToVector(const Matrix<ElemType>& matrix)
+{
+    vector<ElemType> result(matrix.GetNumElements());
+    ElemType* data = result.data();
+    size_t size = result.size();
+    matrix.CopyToArray(data, size);
+    return result;
+}
+
+template <class ElemType>
+static void CopyFromVector(Matrix<ElemType>& matrix, vector<ElemType>& values)
+{
+    assert(matrix.GetNumElements() == values.size());
+    matrix.SetValue(matrix.GetNumRows(), matrix.GetNumCols(), matrix.GetDeviceId(), values.data());
+}
+
+template <class ElemType>
+void ComputationNetwork::OptimizeForInference()
+{
+    MaterializeParameters(); // the foldings read the values of the parameters
+
+    set<ComputationNodeBasePtr> groupNodes;
+    for (auto group : GetAllNodeGroups())
+        groupNodes.insert(group->begin(), group->end());
+    auto isInGroup = [&](const ComputationNodeBasePtr& node) { return groupNodes.find(node) != groupNodes.end(); };
+
+    map<ComputationNodeBasePtr, size_t> numConsumers; // counting each use
+    auto countConsumers = [&]()
+    {
+        numConsumers.clear();
+        for (const auto& iter : m_nameToNodeMap)
+            for (const auto& input : iter.second->GetInputs())
+                if (input)
+                    numConsumers[input]++;
+    };
+
+    // Replaced nodes are deleted together with their inputs that are no longer used. Their replacements take over their names.
+    vector<ComputationNodeBasePtr> replacedNodes;
+    vector<pair<ComputationNodeBasePtr, wstring>> pendingRenames;
+    auto replace = [&](const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& replacement, bool takeOverName)
+    {
+        ChangeNodeInputs(node, replacement);
+        replacedNodes.push_back(node);
+        if (takeOverName)
+            pendingRenames.push_back(make_pair(replacement, node->NodeName()));
+    };
+    auto deleteReplacedNodes = [&]()
+    {
+        countConsumers();
+        while (!replacedNodes.empty())
+        {
+            auto node = replacedNodes.back();
+            replacedNodes.pop_back();
+            if (!NodeNameExists(node->NodeName()) || GetNodeFromName(node->NodeName()) != node || numConsumers[node] > 0 || isInGroup(node))
+                continue;
+            for (const auto& input : node->GetInputs())
+            {
+                if (input && --numConsumers[input] == 0)
+                    replacedNodes.push_back(input);
+            }
+            DeleteNode(node->NodeName());
+        }
+        for (const auto& rename : pendingRenames)
+            RenameNode(rename.first, rename.second);
+        pendingRenames.clear();
+    };
+
+    vector<ComputationNodeBasePtr> nodes;
+    auto collectNodes = [&]()
+    {
+        nodes.clear();
+        for (const auto& iter : m_nameToNodeMap)
+            nodes.push_back(iter.second);
+    };
+
+    // step 1: remove Dropout
+    size_t numDropoutNodes = 0;
+    collectNodes();
+    for (const auto& node : nodes)
+    {
+        if (node->Is<DropoutNode<ElemType>>() && !isInGroup(node))
+        {
+            replace(node, node->GetInputs()[0], /*takeOverName =*/ false);
+            numDropoutNodes++;
+        }
+    }
+    deleteReplacedNodes();
+
+    // step 2: fold BatchNormalization
+    size_t numBatchNormalizationNodes = 0;
+    countConsumers();
+    collectNodes();
+    for (const auto& node : nodes)
+    {
+        if (isInGroup(node))
+            continue;
+        auto bn = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+        if (!bn)
+            continue;
+        auto producer = bn->GetInputs()[0];
+        if (numConsumers[producer] != 1 || isInGroup(producer))
+            continue;
+        shared_ptr<LearnableParameter<ElemType>> params[5];
+        bool hasParams = true;
+        for (size_t i = 1; i < 5; i++)
+        {
+            params[i] = dynamic_pointer_cast<LearnableParameter<ElemType>>(bn->GetInputs()[i]);
+            hasParams &= params[i] != nullptr;
+        }
+        auto weight = dynamic_pointer_cast<LearnableParameter<ElemType>>(producer->GetInputs()[0]);
+        if (!hasParams || !weight || numConsumers[weight] != 1)
+            continue;
+
+        // the statistics are per element of the producer's output, or per map (the trailing dimensions) if spatial
+        const auto& outputShape = producer->GetSampleLayout();
+        size_t numOutputs = outputShape.GetNumElements();
+        size_t numFactors = params[1]->Value().GetNumElements();
+        if (numFactors == 0 || numOutputs % numFactors != 0)
+            continue;
+        size_t spatialSize = numOutputs / numFactors;
+        SmallVector<size_t> biasDims = outputShape.GetDims();
+        size_t leadingSize = 1;
+        for (size_t i = 0; i < biasDims.size() && leadingSize < spatialSize; i++)
+        {
+            leadingSize *= biasDims[i];
+            biasDims[i] = 1;
+        }
+        if (leadingSize != spatialSize)
+            continue;
+
+        // which factor the weight element j is scaled with
+        size_t numWeights = weight->Value().GetNumElements();
+        function<size_t(size_t)> factorIndex;
+        auto times = dynamic_pointer_cast<TimesNode<ElemType>>(producer);
+        auto convolution = dynamic_pointer_cast<ConvolutionNode<ElemType>>(producer);
+        if (times && numWeights == numOutputs * producer->GetInputs()[1]->GetSampleLayout().GetNumElements())
+        {
+            // weight is [outputShape x inputShape], column-major
+            factorIndex = [numOutputs, spatialSize](size_t j) { return (j % numOutputs) / spatialSize; };
+        }
+        else if (convolution && !convolution->Transpose() && convolution->ImageLayout() == ImageLayoutKind::CHW &&
+                 convolution->MapCount().GetNumElements() == numFactors && numWeights % numFactors == 0)
+        {
+            // the kernels of the maps follow each other (cuDNN/reference engines); the legacy HWC engine is not supported
+            size_t kernelSize = numWeights / numFactors;
+            factorIndex = [kernelSize](size_t j) { return j / kernelSize; };
+        }
+        else
+            continue;
+
+        double epsilon = bn->Epsilon();
+        if (!bn->UseCNTKEngine() && m_deviceId != CPUDEVICE)
+            epsilon = max(epsilon, 1e-5); // cuDNN's minimum, see BatchNormalizationNode::Validate()
+
+        auto scale    = CopyToVector(params[1]->Value());
+        auto bias     = CopyToVector(params[2]->Value());
+        auto runMean  = CopyToVector(params[3]->Value());
+        auto runVar   = CopyToVector(params[4]->Value());
+        auto weights  = CopyToVector(weight->Value());
+        for (size_t k = 0; k < numFactors; k++)
+        {
+            scale[k] = (ElemType)(scale[k] / sqrt(runVar[k] + epsilon));
+            bias[k] -= scale[k] * runMean[k];
+        }
+        for (size_t j = 0; j < numWeights; j++)
+            weights[j] *= scale[factorIndex(j)];
+        CopyFromVector(weight->Value(), weights);
+
+        auto foldedBias = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, bn->NodeName() + L".foldedBias", TensorShape(biasDims)));
+        InitLearnableParameters(foldedBias, L"fixedValue", 0);
+        ComputationNodeBasePtr(foldedBias)->SetLearningRateMultiplier(0);
+        CopyFromVector(foldedBias->Value(), bias);
+        auto plus = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(m_deviceId, bn->NodeName() + L".folded"), { producer, foldedBias });
+        replace(bn, plus, /*takeOverName =*/ true);
+        numBatchNormalizationNodes++;
+    }
+    deleteReplacedNodes();
+    CompileNetwork();
+
+    // step 3: determine the nodes whose value only depends on parameters
+    set<ComputationNodeBasePtr> constantNodes;
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        bool isConstant;
+        if (node->IsLeaf())
+            isConstant = node->Is<LearnableParameter<float>>() || node->Is<LearnableParameter<double>>();
+        else
+        {
+            isConstant = !node->HasMBLayout() && !node->IsPartOfLoop() && !dynamic_pointer_cast<IRngUser>(node) && !node->IsValueSparse();
+            for (const auto& input : node->GetInputs())
+                isConstant &= constantNodes.find(input) != constantNodes.end();
+        }
+        if (isConstant)
+            constantNodes.insert(node);
+    }
+
+    // Only the largest constant subgraphs are replaced, those whose roots feed into a node that is not constant.
+    auto isFoldable = [&](const ComputationNodeBasePtr& node)
+    {
+        return !node->IsLeaf() && constantNodes.find(node) != constantNodes.end() && !isInGroup(node) && node->Is<ComputationNode<ElemType>>();
+    };
+    vector<ComputationNodeBasePtr> foldedRoots;
+    set<ComputationNodeBasePtr> foldedRootSet;
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        if (isFoldable(node))
+            continue;
+        for (const auto& input : node->GetInputs())
+        {
+            if (isFoldable(input) && foldedRootSet.insert(input).second)
+                foldedRoots.push_back(input);
+        }
+    }
+
+    if (!foldedRoots.empty())
+    {
+        auto evalOrder = ComputationNodeBase::EnumerateNodes(foldedRoots);
+        MatrixPool matrixPool;
+        for (const auto& node : evalOrder)
+        {
+            if (!node->IsLeaf())
+                node->RequestMatricesBeforeForwardProp(matrixPool);
+        }
+        matrixPool.OptimizedMemoryAllocation();
+
+        auto previousMode = Environment().SetOperationMode(NetworkOperationMode::inferring);
+        for (const auto& node : evalOrder)
+        {
+            if (node->IsLeaf())
+                continue;
+            node->BeginForwardProp();
+            node->ForwardProp(FrameRange(nullptr));
+            node->EndForwardProp();
+        }
+        Environment().SetOperationMode(previousMode);
+
+        for (const auto& root : foldedRoots)
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(root);
+            auto constant = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, node->NodeName() + L".folded", node->GetSampleLayout()));
+            InitLearnableParameters(constant, L"fixedValue", 0);
+            ComputationNodeBasePtr(constant)->SetLearningRateMultiplier(0);
+            auto values = CopyToVector(node->Value());
+            CopyFromVector(constant->Value(), values);
+            replace(node, constant, /*takeOverName =*/ true);
+        }
+        deleteReplacedNodes();
+        CompileNetwork();
+    }
+
+    fprintf(stderr, "OptimizeForInference: removed %d Dropout nodes, folded %d BatchNormalization nodes and %d constant subgraphs.\n",
+            (int)numDropoutNodes, (int)numBatchNormalizationNodes, (int)foldedRoots.size());
+}
+
+template void ComputationNetwork::OptimizeForInference<float>();
+template void ComputationNetwork::OptimizeForInference<double>();
+
+// the format of sparse weights, see SparsifyParametersForInference()
+static MatrixFormat SparseWeightFormat(DEVICEID_TYPE deviceId)
+{
+    return deviceId == CPUDEVICE ? matrixFormatSparseCSC : matrixFormatSparseCSR;
+}
+
+// seconds per product of 'weights' with 'numColumns' random input columns
+template <class ElemType>
+static double TimeProduct(const Matrix<ElemType>& weights, size_t numColumns)
+{
+    const size_t numRepetitions = 10;
+    Matrix<ElemType> input(weights.GetNumCols(), numColumns, weights.GetDeviceId());
+    input.SetUniformRandomValue(-1, 1, /*seed =*/ 1);
+    Matrix<ElemType> output(weights.GetNumRows(), numColumns, weights.GetDeviceId());
+    Matrix<ElemType>::MultiplyAndWeightedAdd(1, weights, false, input, false, 0, output); // warm-up
+    output.Get00Element(); // waits for the GPU
+
+    Timer timer;
+    timer.Start();
+    for (size_t i = 0; i < numRepetitions; i++)
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, weights, false, input, false, 0, output);
+    output.Get00Element();
+    timer.Stop();
+    return timer.ElapsedSeconds() / numRepetitions;
+}
+
+template <class ElemType>
+void ComputationNetwork::SparsifyParametersForInference(double maxDensity, size_t benchmarkColumns)
+{
+    MaterializeParameters(); // the densities are counted from the values
+
+    set<ComputationNodeBasePtr> groupNodes;
+    for (auto group : GetAllNodeGroups())
+        groupNodes.insert(group->begin(), group->end());
+
+    map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>> consumers;
+    for (const auto& iter : m_nameToNodeMap)
+        for (const auto& input : iter.second->GetInputs())
+            if (input)
+                consumers[input].push_back(iter.second);
+
+    // A parameter qualifies if all its consumers are Times nodes that take it as [M x K] matrix on the left of a dense operand,
+    // since the sparse matrix cannot be reshaped, nor be multiplied with another sparse one.
+    auto qualifies = [&](const ComputationNodeBasePtr& node)
+    {
+        if (!node->Is<LearnableParameter<ElemType>>() || groupNodes.find(node) != groupNodes.end() || node->IsValueSparse())
+            return false;
+        if (node->GetSampleLayout().GetRank() != 2 || consumers[node].empty())
+            return false;
+        for (const auto& consumer : consumers[node])
+        {
+            auto times = dynamic_pointer_cast<TimesNode<ElemType>>(consumer);
+            if (!times || times->OutputRank() != 1 || times->GetInputs()[0] != node || times->GetInputs()[1] == node || times->GetInputs()[1]->IsValueSparse())
+                return false;
+        }
+        return true;
+    };
+
+    size_t numParameters = 0, numSparsified = 0;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        if (!qualifies(node))
+            continue;
+        numParameters++;
+
+        auto& weights = node->As<LearnableParameter<ElemType>>()->Value();
+        if (weights.GetMatrixType() != DENSE || weights.GetNumElements() == 0)
+            continue;
+        auto values = CopyToVector(weights);
+        size_t numNonzeros = values.size() - count(values.begin(), values.end(), (ElemType)0);
+        double density = (double)numNonzeros / values.size();
+
+        if (benchmarkColumns > 0)
+        {
+            double denseSeconds = TimeProduct(weights, benchmarkColumns);
+            Matrix<ElemType> sparseWeights = weights.DeepClone();
+            sparseWeights.SwitchToMatrixType(SPARSE, SparseWeightFormat(m_deviceId), /*keepValues =*/ true);
+            double sparseSeconds = TimeProduct(sparseWeights, benchmarkColumns);
+            double breakEvenDensity = sparseSeconds > 0 ? min(1.0, density * denseSeconds / sparseSeconds) : 1.0;
+            fprintf(stderr, "SparsifyParametersForInference: %ls [%d x %d] density %.1f%%: %.3f ms dense vs. %.3f ms sparse for %d columns, break-even density %.1f%%\n",
+                    node->NodeName().c_str(), (int)weights.GetNumRows(), (int)weights.GetNumCols(), 100 * density,
+                    1e3 * denseSeconds, 1e3 * sparseSeconds, (int)benchmarkColumns, 100 * breakEvenDensity);
+        }
+
+        if (density > maxDensity)
+            continue;
+        weights.SwitchToMatrixType(SPARSE, SparseWeightFormat(m_deviceId), /*keepValues =*/ true);
+        numSparsified++;
+    }
+
+    fprintf(stderr, "SparsifyParametersForInference: stored %d of %d weight parameters of products as sparse matrices (density <= %.1f%%).\n",
+            (int)numSparsified, (int)numParameters, 100 * maxDensity);
+}
+
+template void ComputationNetwork::SparsifyParametersForInference<float>(double maxDensity, size_t benchmarkColumns);
+template void ComputationNetwork::SparsifyParametersForInference<double>(double maxDensity, size_t benchmarkColumns);
+
+}}}
@@ -155,7 +155,16 @@ void ComputationNetwork::ConstructFromRoots(DEVICEID_TYPE deviceId, deque<Comput
             if      (tag == L"criteria") tag = L"criterion";
             else if (tag == L"eval"    ) tag = L"evaluation";
 #endif
-            AddToNodeGroup(tag, node); // tag may be empty, or may have been set by array parameters
+            if (tag == L"recompute") // not a node group: drop the value after the forward pass and recompute it for the backward pass
+                node->MarkForRecomputation();
+            else if (tag == L"offload") // ditto: keep the value in host memory between the forward and the backward pass
+                node->MarkForOffloading();
+            else if (tag == L"cpu") // ditto: run the node on another device than the network (see PlaceNodesOnDevices())
+                node->PlaceOnDevice(CPUDEVICE);
+            else if (tag.size() > 3 && tag.compare(0, 3, L"gpu") == 0 && all_of(tag.begin() + 3, tag.end(), ::iswdigit))
+                node->PlaceOnDevice((DEVICEID_TYPE)stoi(tag.substr(3)));
+            else
+                AddToNodeGroup(tag, node); // tag may be empty, or may have been set by array parameters
         }
 
         // traverse children: append them to the end of the work list
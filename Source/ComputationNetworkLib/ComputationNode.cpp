@@ -123,10 +123,12 @@ template<class ElemType>
             unpackedData->Resize(packedData.GetNumRows(), maxNumTimeSteps * numSequences);
         }
 
+        // The scatter indices are computed on the device: time step j of the i-th sequence goes to column
+        // j * numSequences + i (batch major) or i * maxNumTimeSteps + j.
         size_t i = 0;
         auto& layoutSequences = layout->GetAllSequences();
         int numLayoutSequences = (int)layoutSequences.size();
-        std::vector<ElemType> scatterIndicesVector(layout->GetNumCols(), -1);
+        std::vector<PackedSequenceRange> sequenceRanges;
         std::vector<char> columnsValidityMask;
         if (gapPadValue)
             columnsValidityMask.resize(numSequences * maxNumTimeSteps, 1);
@@ -135,21 +137,22 @@ template<class ElemType>
             auto sequenceInfo = layoutSequences[layoutSequenceIdx];
             if (sequenceInfo.seqId != GAP_SEQUENCE_ID)
             {
-                size_t targetParallelStreamIdx = sequenceInfo.s;
                 auto currentSequenceBeginIdx = std::max<ptrdiff_t>(0, sequenceInfo.tBegin);
                 auto currentSequenceEndIdx = std::min(maxNumTimeSteps, sequenceInfo.tEnd);
                 size_t currentSequenceLength = (currentSequenceEndIdx - currentSequenceBeginIdx);
 
-                for (size_t j = 0; j < maxNumTimeSteps; ++j)
+                PackedSequenceRange range;
+                range.s            = (int)sequenceInfo.s;
+                range.tBegin       = (int)currentSequenceBeginIdx;
+                range.tEnd         = (int)currentSequenceEndIdx;
+                range.targetColumn = (int)(batchMajor ? i : (i * maxNumTimeSteps));
+                range.targetLength = (int)currentSequenceLength;
+                sequenceRanges.push_back(range);
+
+                if (gapPadValue)
                 {
-                    auto targetIdx = (batchMajor ? ((j * numSequences) + i) : ((i * maxNumTimeSteps) + j));
-                    if (j < currentSequenceLength)
-                        scatterIndicesVector[((currentSequenceBeginIdx + j) * layout->GetNumParallelSequences()) + targetParallelStreamIdx] = (ElemType)targetIdx;
-                    else
-                    {
-                        if (gapPadValue)
-                            columnsValidityMask[targetIdx] = 0;
-                    }
+                    for (size_t j = currentSequenceLength; j < maxNumTimeSteps; ++j)
+                        columnsValidityMask[batchMajor ? ((j * numSequences) + i) : ((i * maxNumTimeSteps) + j)] = 0;
                 }
 
                 i++;
@@ -158,9 +161,8 @@ template<class ElemType>
 
         auto scatterIdxMatrix = tempIndicesStorage;
         if (!scatterIdxMatrix)
-            scatterIdxMatrix = std::make_shared<Matrix<ElemType>>(1, layout->GetNumCols(), scatterIndicesVector.data(), packedData.GetDeviceId());
-        else
-            scatterIdxMatrix->SetValue(1, layout->GetNumCols(), packedData.GetDeviceId(), scatterIndicesVector.data());
+            scatterIdxMatrix = std::make_shared<Matrix<ElemType>>(packedData.GetDeviceId());
+        scatterIdxMatrix->AssignPackedIndicesOf(nullptr, layout->GetNumParallelSequences(), maxNumTimeSteps, sequenceRanges, /*targetStride=*/batchMajor ? numSequences : 1);
 
         // DoScatterColumnsOf for sparse matrices requires the output to be pre-fileed with 0s
         if (gapPadValue && (*gapPadValue == 0) && (unpackedData->GetMatrixType() == MatrixType::SPARSE))
@@ -194,42 +196,31 @@ template<class ElemType>
                                                              const std::shared_ptr<Matrix<ElemType>>& tempIndicesStorage)
 {
     auto targetLayout = targetFrameRange.m_pMBLayout;
-    
-    // Generate the gather indices
-    std::vector<ElemType> gatherIndicesVector(broadcastTo.GetNumCols(), -1);
-    auto& layoutSequences = targetLayout->GetAllSequences();
-    int numLayoutSequences = (int)layoutSequences.size();
-
-    // 2-way thread parallelism is sufficient for the memory bound
-    // operation of just setting the values of an array.
-    const unsigned NUM_THREADS = 2;
-    UNUSED(NUM_THREADS); // in case OMP is turned off.
-#pragma omp parallel for num_threads(NUM_THREADS)
-    for (int layoutSequenceIdx = 0; layoutSequenceIdx < numLayoutSequences; ++layoutSequenceIdx)
-    {
-        auto sequenceInfo = layoutSequences[layoutSequenceIdx];
 
+    // Generate the gather indices on the device: all columns of a target sequence gather the first column of the
+    // input sequence of the same id (a target stride of 0). For a single time step, the columns are the sequences.
+    std::vector<PackedSequenceRange> sequenceRanges;
+    for (const auto& sequenceInfo : targetLayout->GetAllSequences())
+    {
         if ((sequenceInfo.seqId != GAP_SEQUENCE_ID) && 
             (targetFrameRange.IsAllFrames() || ((sequenceInfo.tBegin <= (ptrdiff_t)(targetFrameRange.timeIdxInSeq + targetFrameRange.m_timeOffset)) && (sequenceInfo.tEnd > (targetFrameRange.timeIdxInSeq + targetFrameRange.m_timeOffset)))))
         {
             auto srcSequenceInfo = inputLayout->FindSequence(sequenceInfo.seqId);
-            auto gatherFromIndex = inputLayout->GetColumnIndex(srcSequenceInfo, 0);
-            std::vector<size_t> currentSequenceColumnIndices;
-            if (targetFrameRange.IsAllFrames())
-                currentSequenceColumnIndices = targetLayout->GetColumnIndices(sequenceInfo);
-            else
-                currentSequenceColumnIndices.push_back(sequenceInfo.s);
-
-            for (auto i : currentSequenceColumnIndices)
-                gatherIndicesVector[i] = (ElemType)gatherFromIndex;
+            PackedSequenceRange range;
+            range.s            = (int)sequenceInfo.s;
+            range.tBegin       = targetFrameRange.IsAllFrames() ? (int)sequenceInfo.tBegin : 0;
+            range.tEnd         = targetFrameRange.IsAllFrames() ? (int)sequenceInfo.tEnd : 1;
+            range.targetColumn = (int)inputLayout->GetColumnIndex(srcSequenceInfo, 0);
+            range.targetLength = range.tEnd - range.tBegin;
+            sequenceRanges.push_back(range);
         }
     }
 
     auto gatherIdxMatrix = tempIndicesStorage;
     if (!gatherIdxMatrix)
-        gatherIdxMatrix = std::make_shared<Matrix<ElemType>>(1, broadcastTo.GetNumCols(), gatherIndicesVector.data(), broadcastTo.GetDeviceId());
-    else
-        gatherIdxMatrix->SetValue(1, broadcastTo.GetNumCols(), broadcastTo.GetDeviceId(), gatherIndicesVector.data());
+        gatherIdxMatrix = std::make_shared<Matrix<ElemType>>(broadcastTo.GetDeviceId());
+    size_t numTimeSteps = targetFrameRange.IsAllFrames() ? targetLayout->GetNumTimeSteps() : 1;
+    gatherIdxMatrix->AssignPackedIndicesOf(nullptr, targetLayout->GetNumParallelSequences(), numTimeSteps, sequenceRanges, /*targetStride=*/0);
 
     broadcastTo.DoGatherColumnsOf(beta, *gatherIdxMatrix, dataToBroadcast, 1);
 }
@@ -54,7 +54,9 @@
 #define CNTK_MODEL_VERSION_22 22 // Slice and pad accepts multiple axes 
 #define CNTK_MODEL_VERSION_23 23 // pooling: add include pad func for average pooling
 #define CNTK_MODEL_VERSION_24 24 // ReduceElements: add keepDimensions
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_24
+#define CNTK_MODEL_VERSION_25 25 // LearnableParameter: format of the value (full, float16, int8)
+#define CNTK_MODEL_VERSION_26 26 // LambdaRank: truncation
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_26
 
 
 // helper mode for debugging
@@ -69,7 +71,8 @@ enum CopyNodeFlags // flags to be passed to the CopyTo() function
     copyNodeValue          = 1, // copy everything except for the input links
     copyNodeInputLinks     = 2, // copy over input links
     copyNodeAll            = 3, // copy everything
-    copyNodeAcrossNetworks = 4  // allow a cross network child copy
+    copyNodeAcrossNetworks = 4, // allow a cross network child copy
+    shareNodeValue         = 8  // with copyNodeValue: share the value matrix instead of copying it (read-only use, e.g. parameters)
 };
 
 #pragma region base computation class
@@ -160,12 +163,30 @@ typedef IStatefulNode::NodeStatePtr NodeStatePtr;
 // =======================================================================
 
 class ComputationNetwork;
+class FusedNodes;
+struct ValueOffloadActions;
+
+// describes the operation of a node for which IsFusibleElementwiseOp() is true
+struct FusibleElementwiseOp
+{
+    enum GradientArg { noArg, inputValueArg, outputValueArg };
+
+    ElementWiseOperator m_op;         // value := m_op(input 0, input 1, ...)
+    ElementWiseOperator m_gradientOp; // unary ops only: input gradient += m_gradientOp(gradient[, input or output value])
+    GradientArg m_gradientArg;
+
+    FusibleElementwiseOp(ElementWiseOperator op = opNone, ElementWiseOperator gradientOp = opNone, GradientArg gradientArg = noArg)
+        : m_op(op), m_gradientOp(gradientOp), m_gradientArg(gradientArg)
+    {
+    }
+};
+
 struct ComputationNetworkOwnedNodeState
 {
     friend class ComputationNetwork;
 
     ComputationNetworkOwnedNodeState()
-        : m_needsGradient(false), m_needsDynamicValidation(false), m_valueSharable(true), m_parentOverwritesGradient(false)
+        : m_needsGradient(false), m_needsDynamicValidation(false), m_valueSharable(true), m_parentOverwritesGradient(false), m_markedForRecomputation(false), m_valueRecomputed(false), m_markedForOffloading(false), m_valueOffloaded(false), m_placementDeviceId(DEVICEID_NOTYETDETERMINED)
     {
         PurgeStateForFormingRecurrentLoops();
         m_isPartOfLoop = false;
@@ -183,13 +204,43 @@ struct ComputationNetworkOwnedNodeState
         other.m_traceNodeValueUpToDim         = m_traceNodeValueUpToDim;
         other.m_traceNodeValueUpToT           = m_traceNodeValueUpToT;
         other.m_parentOverwritesGradient = m_parentOverwritesGradient;
+        other.m_markedForRecomputation = m_markedForRecomputation;
+        other.m_markedForOffloading = m_markedForOffloading;
+        other.m_placementDeviceId = m_placementDeviceId;
     }
 
     bool IsPartOfLoop() const { return m_isPartOfLoop; }
 
     void MarkParentOverwritesGradient() { m_parentOverwritesGradient = true; }
+    void ClearParentOverwritesGradient() { m_parentOverwritesGradient = false; }
     bool ParentOverwritesGradient() const { return m_parentOverwritesGradient; }
 
+    // the group of fused nodes (see FusedNodes.h) that this node belongs to, if any
+    const std::shared_ptr<FusedNodes>& GetFusedChain() const { return m_fusedChain; }
+
+    // gradient checkpointing (see ComputationNetwork::PlanRecomputation())
+    // A node marked by the user (tag="recompute") may have its value dropped after the forward pass and recomputed in the backward pass.
+    void MarkForRecomputation() { m_markedForRecomputation = true; }
+    bool IsMarkedForRecomputation() const { return m_markedForRecomputation; }
+    // true if the value is in fact dropped; it is recomputed before the backprop of the node that lists it below
+    bool IsValueRecomputed() const { return m_valueRecomputed; }
+    const std::vector<std::shared_ptr<ComputationNodeBase>>& GetNodesToRecomputeBeforeBackprop() const { return m_nodesToRecomputeBeforeBackprop; }
+
+    // host-memory offloading (see ComputationNetwork::PlanOffloading())
+    // A node marked by the user (tag="offload") may have its value copied to host memory after the forward pass and back before the backward pass reads it.
+    void MarkForOffloading() { m_markedForOffloading = true; }
+    bool IsMarkedForOffloading() const { return m_markedForOffloading; }
+    // true if the value is in fact offloaded; its GPU memory is shared with other matrices in between
+    bool IsValueOffloaded() const { return m_valueOffloaded; }
+    // the copies that this node, or the loop it stands for in a PAR traversal, starts or waits for; null if none
+    const std::shared_ptr<ValueOffloadActions>& GetOffloadActions() const { return m_offloadActions; }
+
+    // per-node device placement (see ComputationNetwork::PlaceNodesOnDevices())
+    // A node placed by the user (tag="gpu1", tag="cpu") runs on that device instead of the device of the network.
+    void PlaceOnDevice(DEVICEID_TYPE deviceId) { m_placementDeviceId = deviceId; }
+    bool IsPlaced() const { return m_placementDeviceId != DEVICEID_NOTYETDETERMINED; }
+    DEVICEID_TYPE GetPlacementDeviceId() const { return m_placementDeviceId; }
+
     virtual void MarkValueNonSharable() { m_valueSharable = false; }
     virtual void MarkValueSharable() { m_valueSharable = true; }
     bool IsValueSharable() const { return m_valueSharable; }
@@ -216,6 +267,18 @@ protected:                // TODO: should be fully encapsulated here
 
     bool m_parentOverwritesGradient; // flag indicating whether the parent of this node overwrites the gradient of this node instead of accumulating to it
 
+    std::shared_ptr<FusedNodes> m_fusedChain; // set by ComputationNetwork::FuseElementwiseChains() etc.; not copied
+
+    bool m_markedForRecomputation;
+    bool m_valueRecomputed;                                                           // set by ComputationNetwork::PlanRecomputation(); not copied
+    std::vector<std::shared_ptr<ComputationNodeBase>> m_nodesToRecomputeBeforeBackprop; // ditto
+
+    bool m_markedForOffloading;
+    bool m_valueOffloaded;                                // set by ComputationNetwork::PlanOffloading(); not copied
+    std::shared_ptr<ValueOffloadActions> m_offloadActions; // ditto
+
+    DEVICEID_TYPE m_placementDeviceId; // DEVICEID_NOTYETDETERMINED if not placed
+
 private:
     bool m_isPartOfLoop; // true if this loop is part of a recurrent loop
 
@@ -371,6 +434,12 @@ public:
         // base class has nothing else to save
     }
 
+    // Nodes whose Save() writes their value (parameters, precomputed statistics) also implement SaveWithValue(), which
+    // writes 'value' in its place. This lets a copy of the values be written while training changes the values
+    // (see ComputationNetwork::SnapshotForSave()).
+    virtual bool SavesValue() const { return false; }
+    virtual void SaveWithValue(File& fstream, const MatrixBase& /*value*/) const { Save(fstream); }
+
     std::wstring CreateUniqNodeName() const
     {
 #ifdef USE_GUID_AS_NAME
@@ -458,6 +527,11 @@ public:
         else
             return 1; // no layout: treat as 1-sample minibatch that is meant to broadcast
     }
+    // number of values of the minibatch (or of the tensor), e.g. for the cost estimates below
+    double GetNumValues() const
+    {
+        return (double)GetSampleMatrixNumRows() * GetSampleMatrixNumCols();
+    }
     // determine if we are the output of an op over 'other', whether that would be a reduction, so that we need to mask
     bool ReducesInTimeWrt(const ComputationNodeBasePtr& other) const
     {
@@ -643,6 +717,8 @@ public:
     // -----------------------------------------------------------------------
 
     DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
+    // moves the node and the matrices it has so far to another device (see ComputationNetwork::PlaceNodesOnDevices())
+    virtual void MoveToDevice(DEVICEID_TYPE deviceId) { m_deviceId = deviceId; }
 
     // helper to access to element(0,0) without having to type-cast
     virtual double Get00Element() const = 0;
@@ -775,14 +851,49 @@ public:
         return false;
     }
 
+    // whether ForwardProp() issues the same GPU work for all minibatches with the same MBLayout and operation mode, so that
+    // it can be replayed from a CUDA graph (see ForwardGraphCache.h). Not so if it depends on host-side state, e.g. a counter
+    // or a random number generator that the host advances with every minibatch.
+    virtual bool CanReplayForwardProp() const { return true; }
+
+    // the same for the per-time-step ForwardProp() calls of a node in a recurrent loop, for the current minibatch; unlike
+    // above, BeginForwardProp() and EndForwardProp() still run on the host (see SEQTraversalFlowControlNode::ForwardProp())
+    virtual bool CanReplayForwardPropInLoop() const { return CanReplayForwardProp(); }
+
+    // whether ForwardProp() only reads the inputs and writes the value, always with the same result, so that the value may be
+    // dropped after the forward pass and recomputed in the backward pass (see ComputationNetwork::PlanRecomputation())
+    virtual bool CanRecomputeValue() const { return false; }
+
+    // whether this node computes a single elementwise tensor operation of its inputs (in input order) without other state,
+    // so that ComputationNetwork may fuse it with neighboring ones (see ElementwiseFusion.h)
+    virtual bool IsFusibleElementwiseOp(FusibleElementwiseOp& /*op*/) const { return false; }
+
+    // whether this node computes the same value as 'other', a node of the same type and sample layout over the same inputs,
+    // so that one can stand in for the other (see ComputationNetwork::SimplifyNetwork()); nodes with attributes that do not
+    // show in the sample layout must compare them, and nodes with state or randomness must keep the default
+    virtual bool ComputesSameValueAs(const ComputationNodeBase& /*other*/) const { return false; }
+
+    // estimated cost of ForwardProp() and of BackpropTo() into an input on the whole minibatch, as floating-point operations and
+    // bytes read and written, for the roofline report of the profiler (see ProfilerNodeEnd()); the defaults of ComputationNode<ElemType>
+    // assume an elementwise operation, nodes that do more work per value override them
+    virtual void GetForwardCost(double& flops, double& bytes) const { flops = bytes = 0; }
+    virtual void GetBackpropCost(size_t /*inputIndex*/, double& flops, double& bytes) const { flops = bytes = 0; }
+
     // reset gradients of a node's inputs
     // This really only clears the lazy-init flags (LazyZeroGradient() actually clears the values lazily).
-    void /*ComputationNodeBase::*/ ZeroGradientsOfInputs()
+    // With 'keepParameterGradients', the gradients of learnable parameters are left as they are, for backprop to add to them.
+    void /*ComputationNodeBase::*/ ZeroGradientsOfInputs(bool keepParameterGradients = false)
     {
         for (size_t i = 0; i < m_inputs.size(); i++)
-            Input(i)->m_gradientInitialized = false;
+        {
+            if (!keepParameterGradients || !Input(i)->IsLearnableParameter())
+                Input(i)->m_gradientInitialized = false;
+        }
     }
 
+    // whether this node is a parameter that the learners update, i.e. a leaf with a learning rate
+    bool IsLearnableParameter() const { return IsLeaf() && IsParameterUpdateRequired(); }
+
     // -----------------------------------------------------------------------
     // masking
     // -----------------------------------------------------------------------
@@ -1262,14 +1373,16 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = DownCast(nodeP);
-            if (m_value)
+            if (m_value && (flags & CopyNodeFlags::shareNodeValue))
+                node->m_value = m_value;
+            else if (m_value)
             {
                 node->CreateValueMatrixIfNull();
                 node->m_value->SetValue(*m_value);
             }
             else
                 node->m_value = nullptr;
-            if (m_gradient)
+            if (m_gradient && !(flags & CopyNodeFlags::shareNodeValue))
             {
                 node->CreateGradientMatrixIfNull();
                 node->m_gradient->SetValue(*m_gradient);
@@ -1634,6 +1747,15 @@ public:
     // TODO: Are all these meant to read out a scalar? Then rename and verify dimensions.
     virtual double Get00Element() const override final { return Value().Get00Element(); }
 
+    virtual void MoveToDevice(DEVICEID_TYPE deviceId) override
+    {
+        Base::MoveToDevice(deviceId);
+        if (m_value)
+            m_value->TransferToDeviceIfNotThere(deviceId, /*isBeingMoved=*/ true, /*emptyTransfer=*/ false, /*updatePreferredDevice=*/ true);
+        if (m_gradient)
+            m_gradient->TransferToDeviceIfNotThere(deviceId, /*isBeingMoved=*/ true, /*emptyTransfer=*/ false, /*updatePreferredDevice=*/ true);
+    }
+
     // -----------------------------------------------------------------------
     // dimensions and allocation
     // -----------------------------------------------------------------------
@@ -1733,6 +1855,24 @@ public:
     // TODO: move to -Base (or -Network?)
     void Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) override;
 
+    // elementwise: one operation per value, reading the inputs and writing the value
+    virtual void /*ComputationNodeBase::*/ GetForwardCost(double& flops, double& bytes) const override
+    {
+        flops = GetNumValues();
+        bytes = flops;
+        for (const auto& input : m_inputs)
+            bytes += input->GetNumValues();
+        bytes *= sizeof(ElemType);
+    }
+
+    // elementwise: one operation per gradient value, reading the gradient and the input value, and updating the input gradient
+    virtual void /*ComputationNodeBase::*/ GetBackpropCost(size_t inputIndex, double& flops, double& bytes) const override
+    {
+        double inputValues = m_inputs[inputIndex]->GetNumValues();
+        flops = std::max(GetNumValues(), inputValues);
+        bytes = (GetNumValues() + 3 * inputValues) * sizeof(ElemType);
+    }
+
     // lazy resetting of gradient
     // This performs the actual zeroing out.
     void LazyZeroGradient()
@@ -1814,7 +1954,8 @@ public:
     // don't release matrices that need to be used in the gradient computation
     virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
     {
-        if (!IsOutputNeededDuringBackprop() && !m_isValueSparse && IsValueSharable())
+        // a recomputed or offloaded value lives again from its recomputation or prefetch in the backward pass until ReleaseMatricesAfterBackprop()
+        if ((!IsOutputNeededDuringBackprop() || IsValueRecomputed() || IsValueOffloaded()) && !m_isValueSparse && IsValueSharable() && !matrixPool.IsRecomputing())
             ReleaseMatrixToPool(m_value, matrixPool);
     }
 
@@ -1851,7 +1992,7 @@ public:
 
             // Release the Value matrix only if the output value is needed during backprop
             // since in the case it isn't used, we release it during forward prop itself
-            if (IsOutputNeededDuringBackprop() && !m_isValueSparse && IsValueSharable())
+            if ((IsOutputNeededDuringBackprop() || IsValueRecomputed() || IsValueOffloaded()) && !m_isValueSparse && IsValueSharable())
                 ReleaseMatrixToPool(m_value, matrixPool);
 
             auto multiOutputNode = dynamic_cast<MultiOutputNode<ElemType>*>(this);
@@ -1902,9 +2043,10 @@ protected:
     // this is currently a workaround for workspace memory for convolutions
     void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, size_t matrixSize=0, bool mbScale=false, bool isWorkSpace=false)
     {
-        if (matrixPtr == nullptr)
+        if (matrixPtr == nullptr || matrixPool.IsRecomputing()) // when recomputing, this makes the pool keep the matrix again
         {
-            matrixPool.RequestAllocate<ElemType>(m_deviceId, &matrixPtr, matrixSize, mbScale, isWorkSpace);
+            const char* kind = &matrixPtr == &m_value ? "value" : &matrixPtr == &m_gradient ? "gradient" : isWorkSpace ? "workspace" : "temp";
+            matrixPool.RequestAllocate<ElemType>(m_deviceId, &matrixPtr, matrixSize, mbScale, isWorkSpace, NodeName(), kind);
         }
     }
 
@@ -2254,11 +2396,44 @@ struct IRecurrentNode { virtual int GetRecurrenceSteppingDirection() const = 0;
 
 struct IFreezable { virtual void FreezeParameters() { } };
 
+// =======================================================================
+// IDeferredValueNode -- nodes whose value can be left in the model file when loading, until it is needed
+// (lazyParameterLoading, see ComputationNetwork::MaterializeParameters())
+// =======================================================================
+
+struct IDeferredValueNode
+{
+    // the model file that holds the value; empty if the value is loaded
+    virtual const std::wstring& DeferredValueFile() const = 0;
+    // loads the value from 'fileData', a mapping of the whole model file
+    virtual void LoadDeferredValue(const char* fileData) = 0;
+    // where the value is in the file, for reading ahead
+    virtual uint64_t DeferredValuePosition() const = 0;
+    virtual size_t DeferredValueBytes() const = 0;
+};
+
+// =======================================================================
+// ParameterValueFormat -- the format in which the values of parameters are stored in a model file
+// (see ComputationNetwork::Save()); compressed values are converted back to the precision of the node when loading
+// =======================================================================
+
+enum class ParameterValueFormat : int
+{
+    full = 0,    // the precision of the node
+    float16 = 1, // IEEE half precision
+    int8 = 2,    // 8-bit integers with a scale per row (output channel); vectors are stored as float16
+};
+
+// "full", "float16" or "int8"
+ParameterValueFormat ParseParameterValueFormat(const std::wstring& name);
+
 // =======================================================================
 // PreComputedNodeBase -- interface implemented by ComputationNodes that precompute
 // TODO: We can use this interface in more places.
 // =======================================================================
 
+class MPIWrapper;
+
 struct IPreComputeNode
 {
     // check whether node has already undergone precomputation
@@ -2266,6 +2441,9 @@ struct IPreComputeNode
     // call this with 'false' at start and with 'true' at end
     // This is used for resetting and updating from accumulators.
     virtual void MarkComputed(const bool hasComputed) = 0;
+    // When each worker has accumulated a different part of the data, call this on all of them before MarkComputed(true),
+    // to combine what they accumulated.
+    virtual void AggregateAcrossWorkers(const MPIWrapper& mpi) = 0;
 };
 
 // =======================================================================
@@ -2309,6 +2487,7 @@ protected:
     using Base::GetNumInputs;                                                                                                                            \
     using Base::GetNumParallelSequences;                                                                                                                 \
     using Base::GetNumTimeSteps;                                                                                                                         \
+    using Base::GetNumValues;                                                                                                                            \
     using Base::GetSampleLayout;                                                                                                                         \
     using Base::GetSampleMatrixNumCols;                                                                                                                  \
     using Base::GetSampleMatrixNumRows;                                                                                                                  \
@@ -2462,6 +2641,8 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
 #endif
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual bool /*ComputationNodeBase::*/ CanRecomputeValue() const override { return true; }
+    virtual bool /*ComputationNodeBase::*/ ComputesSameValueAs(const ComputationNodeBase& /*other*/) const override { return true; }
 
     virtual void /*IComputationNode::*/ BeginForwardProp() override // called before first iteration step of ForwardProp()
     {
@@ -9,6 +9,7 @@
 #include "Matrix.h"
 #include "ComputationNode.h"
 #include "ConvolutionEngine.h"
+#include "ConvolutionAlgorithmCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -166,6 +167,7 @@ public:
     TensorShape LowerPad() const { return m_lowerPad; }
     TensorShape UpperPad() const { return m_upperPad; }
     bool Transpose() const { return m_transpose; }
+    ImageLayoutKind ImageLayout() const { return m_imageLayout; }
     TensorShape OutputShape() const { return m_outputShape; }
     size_t MaxTempMemSizeInSamples() const { return m_maxTempMemSizeInSamples; }
     PoolKind PoolingKind() const { return m_poolKind; }
@@ -228,18 +230,20 @@ protected:
     // filter transform calculation here to be reused by derived classes. For example convolution and de-convolution
     // have same transform but inversed, hence both of them may reuse this method and one will call inverse in addition
     // (similar holds for pooling nodes).
-    SpaceTransform ComputeFilterTransform()
+    // 'firstSpatialAxis' is the tensor axis of the width, e.g. 1 when the channels come first (HWC).
+    SpaceTransform ComputeFilterTransform(size_t firstSpatialAxis = 0)
     {
         std::shared_ptr<const ConvolveGeometry> geometry = m_convEng->Geometry();
 
         SpaceTransform result;
         result.m_axisTransforms.resize(2);
 
-        result.m_axisTransforms[0].scale = (float)(geometry->GetStride(0));
-        result.m_axisTransforms[0].translate = (float)((geometry->KernelShape()[0] - 1) / 2 - geometry->GetLowerPad(0));
-
-        result.m_axisTransforms[1].scale = (float)(geometry->GetStride(1));
-        result.m_axisTransforms[1].translate = (float)((geometry->KernelShape()[1] - 1) / 2 - geometry->GetLowerPad(1));
+        for (size_t i = 0; i < 2; i++)
+        {
+            size_t axis = firstSpatialAxis + i;
+            result.m_axisTransforms[i].scale = (float)(geometry->GetStride(axis));
+            result.m_axisTransforms[i].translate = (float)((geometry->KernelShape()[axis] - 1) / 2 - geometry->GetLowerPad(axis));
+        }
 
         return result;
     }
@@ -563,6 +567,8 @@ public:
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
                                                                 ConvolutionEngineKind::All, NodeName(), Globals::ShouldForceDeterministicAlgorithms());
+                // with cudnnAutotuneBatchSizes, tune ahead of training instead of whenever the minibatch size changes
+                m_convEng->Autotune(ConvolutionAlgorithmCache::GetAutotuneBatchSizes());
             }
 
             if (Input(0)->GetSampleLayout().GetNumElements() != m_kernelShape.GetNumElements() * m_convEng->Geometry()->KernelCount())
@@ -610,6 +616,27 @@ public:
     bool IsConvolution2D() const { return m_convolution2D; }
 
     bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    bool CanRecomputeValue() const override { return true; }
+
+    // a multiply-add per kernel value (which spans the input channels) for each value of the convolved (larger for a
+    // transposed convolution) side; the kernel gradient and the data gradient are convolutions of the same size
+    void GetForwardCost(double& flops, double& bytes) const override
+    {
+        if (m_convEng == nullptr)
+        {
+            Base::GetForwardCost(flops, bytes);
+            return;
+        }
+        double values = m_transpose ? Input(1)->GetNumValues() : GetNumValues();
+        flops = 2 * values * m_convEng->Geometry()->KernelShape().GetNumElements();
+        bytes = (Input(0)->GetNumValues() + Input(1)->GetNumValues() + GetNumValues()) * sizeof(ElemType);
+    }
+
+    void GetBackpropCost(size_t inputIndex, double& flops, double& bytes) const override
+    {
+        GetForwardCost(flops, bytes);
+        bytes += Input(inputIndex)->GetNumValues() * sizeof(ElemType);
+    }
 
 private:
     using TransformerNode::m_transforms;
@@ -853,13 +880,25 @@ public:
     {
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
         const Matrix<ElemType>& input0 = InputRef(0).ValueFor(fr);
-        m_convEng->ForwardPooling(input0, sliceOutputValue);
+        if (m_storeArgmax)
+        {
+            m_argmax->Resize(Value().GetNumRows(), Value().GetNumCols());
+            Matrix<short> sliceArgmax = ArgmaxFor(fr);
+            m_convEng->ForwardPoolingWithArgmax(input0, sliceOutputValue, sliceArgmax);
+        }
+        else
+            m_convEng->ForwardPooling(input0, sliceOutputValue);
     }
 
     void BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         auto sliceOutputGrad = GradientFor(fr);
         Matrix<ElemType> sliceInput0Grad = InputRef(0).GradientFor(fr);
+        if (m_storeArgmax)
+        {
+            m_convEng->BackwardPoolingWithArgmax(ArgmaxFor(fr), sliceOutputGrad, sliceInput0Grad);
+            return;
+        }
         Matrix<ElemType> sliceInput0Value = InputRef(0).ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
@@ -868,24 +907,25 @@ public:
 
     bool OutputUsedInComputingInputNodesGradients() const override
     {
-        // The PoolingNode requires output values only for max pooling.
-        return m_poolKind == PoolKind::Max;
+        // The PoolingNode requires output values only for max pooling, and not even then if it keeps the argmax.
+        return m_poolKind == PoolKind::Max && !m_storeArgmax;
     }
 
+    bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override
+    {
+        return !m_storeArgmax;
+    }
+
+    bool CanRecomputeValue() const override { return true; }
+
 public:
     void Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
         InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
 
-        if (m_imageLayout != ImageLayoutKind::CHW)
-        {
-            InvalidArgument(
-                "%ls %ls supports only cuDNN (CHW) data layout. "
-                "Please specify imageLayout=\"cudnn\" in %ls node in your script "
-                "and make sure input data layout is CHW", NodeName().c_str(), OperationName().c_str(), NodeName().c_str());
-        }
-
+        // With imageLayout="legacy" (HWC), the kernel and stride shapes are given in the order of the tensor, i.e. with the
+        // channels first, e.g. (1:3:3) for 3x3 pooling. HWC pooling runs on the reference engine.
         const auto& inputShape = GetInputSampleLayout(0);
 
         // infer reduction dimensions if not given
@@ -900,14 +940,33 @@ public:
             {
                 auto geometry = std::make_shared<ConvolveGeometry>(inputShape, m_kernelShape, m_mapCount, m_stride,
                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad, m_ceilOutDim);
+                // cuDNN neither stores the argmax nor pools HWC, and the legacy engine does not store the argmax.
+                bool wantArgmax = Globals::ShouldStorePoolingArgmax() && m_poolKind == PoolKind::Max;
+                int engines = (int)ConvolutionEngineKind::All;
+                if (m_imageLayout == ImageLayoutKind::HWC)
+                    engines &= ~(int)ConvolutionEngineKind::Legacy;
+                if (wantArgmax)
+                    engines &= ~(int)ConvolutionEngineKind::CuDnn;
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
-                                                                ConvolutionEngineKind::All, NodeName(), false, m_poolIncludePad);
+                                                                (ConvolutionEngineKind)engines, NodeName(), false, m_poolIncludePad);
+                m_storeArgmax = wantArgmax && m_convEng->SupportsPoolingArgmax();
+                if (m_storeArgmax && m_argmax == nullptr)
+                    m_argmax = std::make_shared<Matrix<short>>(m_deviceId);
             }
         }
     }
 
 private:
+    Matrix<short> ArgmaxFor(const FrameRange& fr) const
+    {
+        auto columns = ColumnRangeWithMBLayoutFor(m_argmax->GetNumCols(), fr, GetMBLayout());
+        return m_argmax->ColumnSlice(columns.first, columns.second);
+    }
+
+    bool m_storeArgmax = false;
+    shared_ptr<Matrix<short>> m_argmax; // position of the max within each pooling window, of the shape of Value()
+
     using TransformerNode::m_transforms;
     using ConvolutionNodeBase<ElemType>::ComputeFilterTransform;
 
@@ -915,7 +974,7 @@ private:
     {
         if (m_transforms[0].m_axisTransforms.empty())
         {
-            m_transforms[0] = ComputeFilterTransform();
+            m_transforms[0] = ComputeFilterTransform(m_imageLayout == ImageLayoutKind::HWC ? 1 : 0);
             m_transforms[0] = m_transforms[0].Inverse();
         }
         // else: transform already computed, no need to do it again.
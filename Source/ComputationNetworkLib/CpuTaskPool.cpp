@@ -0,0 +1,152 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CpuTaskPool.cpp -- worker threads that run graphs of dependent tasks, for the concurrent execution of nodes on the CPU
+//
+
+#include "stdafx.h"
+#include "CpuTaskPool.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+CpuTaskPool::CpuTaskPool(size_t numWorkers)
+    : m_queues(numWorkers), m_shuttingDown(false), m_tasks(nullptr), m_numUnfinishedTasks(0)
+{
+    if (numWorkers == 0)
+        InvalidArgument("CpuTaskPool: At least one worker is needed.");
+#ifdef _OPENMP
+    const int numThreads = omp_get_max_threads();
+#else
+    const int numThreads = ThreadPool::Instance().NumAvailableCpus();
+#endif
+    m_numThreadsPerWorker = std::max(1, numThreads / (int) numWorkers);
+
+    for (size_t worker = 0; worker < numWorkers; worker++)
+        m_workers.emplace_back([this, worker]() { WorkerLoop(worker); });
+}
+
+CpuTaskPool::~CpuTaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shuttingDown = true;
+    }
+    m_tasksReady.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void CpuTaskPool::Run(const std::vector<Task>& tasks)
+{
+    if (tasks.empty())
+        return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_tasks)
+        LogicError("CpuTaskPool: Run() is not reentrant.");
+    m_tasks = &tasks;
+    m_numPendingPredecessors.assign(tasks.size(), 0);
+    m_successors.assign(tasks.size(), std::vector<size_t>());
+    m_numUnfinishedTasks = tasks.size();
+    m_exception = nullptr;
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        for (size_t p : tasks[i].predecessors)
+        {
+            if (p >= i)
+                LogicError("CpuTaskPool: Predecessors must come first in the list of tasks.");
+            m_successors[p].push_back(i);
+        }
+        m_numPendingPredecessors[i] = tasks[i].predecessors.size();
+        if (m_numPendingPredecessors[i] == 0)
+            m_queues[tasks[i].preferredWorker % m_queues.size()].push_back(i);
+    }
+    m_tasksReady.notify_all();
+
+    m_allFinished.wait(lock, [this]() { return m_numUnfinishedTasks == 0; });
+    m_tasks = nullptr;
+    std::exception_ptr exception = m_exception;
+    m_exception = nullptr;
+    lock.unlock();
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+// takes the task queued last to the worker's own queue, or else the task queued first to another worker
+bool CpuTaskPool::TryTakeTask(size_t worker, size_t& task)
+{
+    auto& ownQueue = m_queues[worker];
+    if (!ownQueue.empty())
+    {
+        task = ownQueue.back();
+        ownQueue.pop_back();
+        return true;
+    }
+    for (size_t i = 1; i < m_queues.size(); i++)
+    {
+        auto& otherQueue = m_queues[(worker + i) % m_queues.size()];
+        if (!otherQueue.empty())
+        {
+            task = otherQueue.front();
+            otherQueue.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void CpuTaskPool::WorkerLoop(size_t worker)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(m_numThreadsPerWorker); // the OpenMP thread count is per calling thread
+#endif
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        size_t task = SIZE_MAX;
+        m_tasksReady.wait(lock, [&]() { return m_shuttingDown || TryTakeTask(worker, task); });
+        if (task == SIZE_MAX) // shutting down; the pool is only destroyed when no Run() is active
+            return;
+
+        std::exception_ptr exception;
+        if (!m_exception)
+        {
+            lock.unlock();
+            try
+            {
+                (*m_tasks)[task].action();
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+            lock.lock();
+        }
+        if (exception && !m_exception)
+            m_exception = exception;
+
+        size_t numQueued = 0;
+        for (size_t successor : m_successors[task])
+        {
+            if (--m_numPendingPredecessors[successor] == 0)
+            {
+                m_queues[worker].push_back(successor);
+                numQueued++;
+            }
+        }
+        if (--m_numUnfinishedTasks == 0)
+            m_allFinished.notify_one();
+        else if (numQueued > 1) // this worker takes one of them itself
+            m_tasksReady.notify_all();
+    }
+}
+
+}}}
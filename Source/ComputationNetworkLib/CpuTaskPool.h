@@ -0,0 +1,76 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CpuTaskPool.h -- worker threads that run graphs of dependent tasks, for the concurrent execution of nodes on the CPU
+//
+// Run() executes a list of tasks, each after the tasks it depends on, and returns when all of them have finished.
+// Each worker has a queue of ready tasks. A task that becomes ready is queued to the worker that finished its last
+// predecessor, or, if it has none, to the worker it prefers (StreamSchedule passes the stream of the node, so chains stay
+// on one thread and their data in its caches). Workers take the task queued last from their own queue, and when it is
+// empty steal the task queued first from another one.
+//
+// Each worker limits OpenMP, which CPUMatrix uses within a single operation, to its share of the threads that were
+// available to the thread that created the pool, so that concurrent tasks do not oversubscribe the cores. BLAS libraries
+// with a process-wide thread count (CPUBlas::SetNumThreads()) are not limited per worker.
+//
+// If a task throws, the tasks that have not started yet are skipped, and Run() rethrows the first exception once the
+// running tasks have finished.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class CpuTaskPool
+{
+public:
+    struct Task
+    {
+        std::function<void()> action;
+        std::vector<size_t> predecessors; // indices of tasks that come before this one in the list
+        size_t preferredWorker;           // modulo the number of workers
+    };
+
+    explicit CpuTaskPool(size_t numWorkers);
+    ~CpuTaskPool();
+
+    size_t NumWorkers() const { return m_workers.size(); }
+    int NumThreadsPerWorker() const { return m_numThreadsPerWorker; }
+
+    // Not reentrant: tasks must not call Run() of the same pool.
+    void Run(const std::vector<Task>& tasks);
+
+private:
+    CpuTaskPool(const CpuTaskPool&) = delete;
+    CpuTaskPool& operator=(const CpuTaskPool&) = delete;
+
+    void WorkerLoop(size_t worker);
+    bool TryTakeTask(size_t worker, size_t& task); // caller holds m_mutex
+
+    std::vector<std::thread> m_workers;
+    int m_numThreadsPerWorker;
+    std::mutex m_mutex;                        // guards everything below
+    std::condition_variable m_tasksReady;      // workers wait for queued tasks
+    std::condition_variable m_allFinished;     // Run() waits for the last task
+    std::vector<std::deque<size_t>> m_queues;  // ready tasks of each worker
+    bool m_shuttingDown;
+
+    // state of the current Run()
+    const std::vector<Task>* m_tasks;
+    std::vector<size_t> m_numPendingPredecessors;
+    std::vector<std::vector<size_t>> m_successors;
+    size_t m_numUnfinishedTasks;
+    std::exception_ptr m_exception;
+};
+
+}}}
@@ -0,0 +1,218 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DevicePlacement.cpp -- runs parts of a network on other devices than that of the network, within one process
+//
+// A model that does not fit into the memory of one GPU can be split over the GPUs of a machine by placing nodes on
+// devices: tag="gpu1" (or "cpu") in BrainScript, Internal::PlaceOnDevice() in the V2 API, which places all primitive
+// functions of a block. ComputationNetwork::PlaceNodesOnDevices() runs when the network is compiled, before validation:
+//  - The nodes of a recurrent loop run on one device: that of the nodes of the loop that are placed. They must agree.
+//  - Learnable parameters that are not placed go with their consumers if these are all placed on the same device, so
+//    that placing the operations of a layer also places its weights. SGD keeps their state on their device.
+//  - All other nodes run on the device of the network.
+// The nodes are moved to their devices together with their values, and a CrossDeviceCopyNode is inserted where a node
+// reads a node on another device; the copy is shared by all consumers on the same device. It copies the value in the
+// forward pass and adds the gradient to that of its input in the backward pass. GPU-to-GPU copies go through
+// cudaMemcpyPeer(), which is ordered with the work on both GPUs, so each GPU runs its part in the order of the network.
+// Placement is not saved with the model, but the copies are, and they are correct on one device as well.
+//
+
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "InputAndParamNodes.h"
+#include "SpecialPurposeNodes.h"
+#include <map>
+#include <numeric>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static std::wstring DeviceName(DEVICEID_TYPE deviceId)
+{
+    return deviceId < 0 ? L"CPU" : L"GPU" + std::to_wstring(deviceId);
+}
+
+template <class ElemType>
+static ComputationNodeBasePtr NewCrossDeviceCopy(DEVICEID_TYPE deviceId, const std::wstring& name)
+{
+    return New<CrossDeviceCopyNode<ElemType>>(deviceId, name);
+}
+
+// Splits the PAR traversal of 'criterionNode' into consecutive stages, one per device, that hold about the same number of elements
+// of values and parameters, and places the nodes of each stage on its device (modelParallelSGD, see SGD.h). Recurrent loops are not
+// split. Leaves are not placed, so learnable parameters go with their consumers. Nodes placed by the user stay where they are.
+// Micro-batches then pass through the stages, each stage holding the values and accumulating the gradients of its part.
+void ComputationNetwork::PlacePipelineStages(const ComputationNodeBasePtr& criterionNode, const std::vector<DEVICEID_TYPE>& devices)
+{
+    VerifyIsCompiled("PlacePipelineStages");
+    if (devices.empty())
+        return;
+
+    // the steps of the PAR traversal, a loop being one step, and the number of elements each holds
+    std::vector<std::vector<ComputationNodeBasePtr>> steps;
+    std::vector<size_t> sizes;
+    ComputationNodeBasePtr prevLoop;
+    for (const auto& node : GetEvalOrder(criterionNode))
+    {
+        if (node->IsLeaf())
+            continue;
+        ComputationNodeBasePtr loop = node->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, node) : nullptr;
+        if (!loop || loop != prevLoop)
+        {
+            steps.push_back(std::vector<ComputationNodeBasePtr>());
+            sizes.push_back(0);
+        }
+        prevLoop = loop;
+        steps.back().push_back(node);
+        sizes.back() += node->GetSampleLayout().GetNumElements();
+        for (const auto& input : node->GetInputs())
+        {
+            if (input && input->OperationName() == OperationNameOf(LearnableParameter))
+                sizes.back() += input->GetSampleLayout().GetNumElements();
+        }
+    }
+
+    const size_t totalSize = std::accumulate(sizes.begin(), sizes.end(), (size_t)0);
+    std::vector<size_t> stageSizes(devices.size(), 0);
+    std::vector<ComputationNodeBasePtr> stageBegins(devices.size());
+    size_t stage = 0;
+    size_t sizeSoFar = 0;
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        while (stage + 1 < devices.size() && sizeSoFar >= totalSize * (stage + 1) / devices.size()) // this stage holds its share
+            stage++;
+        for (const auto& node : steps[i])
+        {
+            if (!node->IsPlaced())
+                node->PlaceOnDevice(devices[stage]);
+        }
+        if (!stageBegins[stage])
+            stageBegins[stage] = steps[i].front();
+        stageSizes[stage] += sizes[i];
+        sizeSoFar += sizes[i];
+    }
+
+    if (TraceLevel() > 0)
+    {
+        fprintf(stderr, "\nSplit the network into %d pipeline stages:\n", (int)devices.size());
+        for (size_t i = 0; i < devices.size(); i++)
+            fprintf(stderr, "\t%ls: from %ls, %d elements per sample\n", DeviceName(devices[i]).c_str(),
+                    stageBegins[i] ? stageBegins[i]->NodeName().c_str() : L"(empty)", (int)stageSizes[i]);
+    }
+
+    CompileNetwork(); // moves the nodes (see PlaceNodesOnDevices())
+}
+
+// Moves nodes to the devices they are placed on, as described above. Returns whether copies were inserted, in which
+// case the network must be compiled again.
+bool ComputationNetwork::PlaceNodesOnDevices()
+{
+    const auto nodes = GetAllNodes();
+    if (std::none_of(nodes.begin(), nodes.end(), [](const ComputationNodeBasePtr& node) { return node->IsPlaced(); }))
+        return false;
+
+    // the device of each node
+    std::map<ComputationNodeBasePtr, DEVICEID_TYPE> devices;
+    for (const auto& node : nodes)
+        devices[node] = node->IsPlaced() ? node->GetPlacementDeviceId() : GetDeviceId();
+    for (const auto& loop : m_allSEQNodes)
+    {
+        auto device = GetDeviceId();
+        bool isPlaced = false;
+        for (const auto& node : loop->m_nestedNodes)
+        {
+            if (!node->IsPlaced())
+                continue;
+            if (isPlaced && node->GetPlacementDeviceId() != device)
+                InvalidArgument("PlaceNodesOnDevices: %ls is placed on %ls, but other nodes of its recurrent loop are placed on %ls.",
+                                node->NodeDescription().c_str(), DeviceName(node->GetPlacementDeviceId()).c_str(), DeviceName(device).c_str());
+            device = node->GetPlacementDeviceId();
+            isPlaced = true;
+        }
+        for (const auto& node : loop->m_nestedNodes)
+            devices[node] = device;
+    }
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> consumers;
+    for (const auto& node : nodes)
+    {
+        for (const auto& input : node->GetInputs())
+            consumers[input].push_back(node);
+    }
+    for (const auto& node : nodes)
+    {
+        if (node->IsPlaced() || node->OperationName() != OperationNameOf(LearnableParameter) || consumers[node].empty())
+            continue;
+        const auto device = devices[consumers[node].front()];
+        if (std::all_of(consumers[node].begin(), consumers[node].end(), [&devices, device](const ComputationNodeBasePtr& consumer) { return devices[consumer] == device; }))
+        {
+            node->PlaceOnDevice(device); // so that it stays with them when the network is compiled again
+            devices[node] = device;
+        }
+    }
+
+    if (Globals::GetNumComputeStreams() > 1 || Globals::ShouldCaptureCudaGraphs())
+    {
+        fprintf(stderr, "WARNING: Node placement is ignored when nodes run concurrently (numComputeStreams) or the forward pass is replayed from CUDA graphs (cudaGraphs).\n");
+        return false;
+    }
+
+    size_t numMoved = 0;
+    for (const auto& node : nodes)
+    {
+        if (node->GetDeviceId() != devices[node])
+        {
+            node->MoveToDevice(devices[node]);
+            numMoved++;
+        }
+    }
+
+    // copy where a node reads a node on another device
+    std::map<std::pair<ComputationNodeBasePtr, DEVICEID_TYPE>, ComputationNodeBasePtr> copies; // [input, device] -> copy
+    for (const auto& node : nodes)
+    {
+        if (node->OperationName() == OperationNameOf(CrossDeviceCopyNode)) // inserted before
+            copies[make_pair(node->Input(0), node->GetDeviceId())] = node;
+    }
+    size_t numInserted = 0;
+    for (const auto& node : nodes)
+    {
+        if (node->OperationName() == OperationNameOf(CrossDeviceCopyNode))
+            continue;
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            const auto input = node->Input(i);
+            const auto device = node->GetDeviceId();
+            if (!input || input->GetDeviceId() == device)
+                continue;
+            auto& copy = copies[make_pair(input, device)];
+            if (!copy)
+            {
+                const auto name = input->NodeName() + L".copyTo" + DeviceName(device);
+                if (input->Is<ComputationNode<float>>())
+                    copy = NewCrossDeviceCopy<float>(device, name);
+                else if (input->Is<ComputationNode<double>>())
+                    copy = NewCrossDeviceCopy<double>(device, name);
+                else
+                    InvalidArgument("PlaceNodesOnDevices: %ls cannot be copied to %ls.", input->NodeDescription().c_str(), DeviceName(device).c_str());
+                copy->PlaceOnDevice(device);
+                AddNodeToNetAndAttachInputs(copy, { input });
+                numInserted++;
+            }
+            node->SetInput(i, copy);
+        }
+    }
+
+    if (TraceLevel() > 0 && (numMoved > 0 || numInserted > 0))
+    {
+        std::map<DEVICEID_TYPE, size_t> numNodesPerDevice;
+        for (const auto& iter : devices)
+            numNodesPerDevice[iter.second]++;
+        fprintf(stderr, "\nPlaced the network on %d devices:", (int)numNodesPerDevice.size());
+        for (const auto& iter : numNodesPerDevice)
+            fprintf(stderr, " %d nodes on %ls", (int)iter.second, DeviceName(iter.first).c_str());
+        fprintf(stderr, ", %d nodes moved, %d copies between devices inserted.\n", (int)numMoved, (int)numInserted);
+    }
+    return numInserted > 0;
+}
+
+}}}
@@ -0,0 +1,325 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ElementwiseFusion.cpp -- evaluates chains of elementwise nodes as single fused tensor operations
+//
+
+#include "stdafx.h"
+#include "ElementwiseFusion.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// 0: not a float or double node
+static int GetPrecision(const ComputationNodeBasePtr& node)
+{
+    if (node->Is<ComputationNode<float>>())
+        return 1;
+    if (node->Is<ComputationNode<double>>())
+        return 2;
+    return 0;
+}
+
+/*static*/ bool FusedElementwiseChain::IsFusible(const ComputationNodeBasePtr& node, FusibleElementwiseOp& op)
+{
+    if (!node->IsFusibleElementwiseOp(op) || node->IsPartOfLoop() || GetPrecision(node) == 0 || node->GetFusedChain()) // (already in another group)
+        return false;
+    size_t arity = ElementwiseProgram::GetArity(op.m_op);
+    if (arity != node->GetNumInputs())
+        return false;
+    if (arity == 2)
+        return op.m_op == opSum || op.m_op == opDifference || op.m_op == opElementwiseProduct;
+    return arity == 1 && ElementwiseProgram::GetArity(op.m_gradientOp) == (op.m_gradientArg == FusibleElementwiseOp::noArg ? 1 : 2);
+}
+
+// the distinct inputs of 'members' that are not members themselves, in order of first use; false if one cannot be a leaf
+static bool DetermineLeaves(const std::vector<ComputationNodeBasePtr>& members, const ComputationNodeBasePtr& root, std::vector<ComputationNodeBasePtr>& leaves)
+{
+    leaves.clear();
+    for (const auto& member : members)
+    {
+        for (const auto& input : member->GetInputs())
+        {
+            if (std::find(members.begin(), members.end(), input) != members.end() || std::find(leaves.begin(), leaves.end(), input) != leaves.end())
+                continue;
+            if ((input->HasMBLayout() && input->GetMBLayout() != root->GetMBLayout()) || GetPrecision(input) != GetPrecision(root))
+                return false;
+            leaves.push_back(input);
+        }
+    }
+    return true;
+}
+
+/*static*/ std::vector<std::shared_ptr<FusedElementwiseChain>> FusedElementwiseChain::Find(const std::list<ComputationNodeBasePtr>& evalOrder, const std::vector<ComputationNodeBasePtr>& roots)
+{
+    std::map<ComputationNodeBasePtr, size_t> numConsumers; // counting each use
+    std::map<ComputationNodeBasePtr, size_t> positions;
+    for (const auto& node : evalOrder)
+    {
+        positions[node] = positions.size();
+        for (const auto& input : node->GetInputs())
+            numConsumers[input]++;
+    }
+    std::set<ComputationNodeBasePtr> rootSet(roots.begin(), roots.end());
+    std::set<ComputationNodeBasePtr> taken;
+
+    std::vector<std::shared_ptr<FusedElementwiseChain>> chains;
+    for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); iter++) // consumers first, so that chains grow towards the inputs
+    {
+        const auto& root = *iter;
+        FusibleElementwiseOp rootOp;
+        std::vector<ComputationNodeBasePtr> leaves;
+        if (taken.find(root) != taken.end() || !IsFusible(root, rootOp) || !DetermineLeaves({ root }, root, leaves))
+            continue;
+
+        // grow breadth-first through the inputs, as long as the chain stays within the limits
+        std::vector<ComputationNodeBasePtr> members = { root };
+        std::map<ComputationNodeBasePtr, FusibleElementwiseOp> ops = { { root, rootOp } };
+        for (size_t i = 0; i < members.size() && members.size() < s_maxNodes; i++)
+        {
+            for (const auto& input : members[i]->GetInputs())
+            {
+                FusibleElementwiseOp op;
+                if (members.size() == s_maxNodes || ops.find(input) != ops.end() || taken.find(input) != taken.end() ||
+                    rootSet.find(input) != rootSet.end() || numConsumers[input] != 1 || !IsFusible(input, op) ||
+                    GetPrecision(input) != GetPrecision(root) || input->GetMBLayout() != root->GetMBLayout() ||
+                    input->GetSampleLayout() != root->GetSampleLayout())
+                    continue;
+                members.push_back(input);
+                std::vector<ComputationNodeBasePtr> newLeaves;
+                if (DetermineLeaves(members, root, newLeaves) && newLeaves.size() <= s_maxLeaves)
+                    ops[input] = op;
+                else
+                    members.pop_back();
+            }
+        }
+        if (members.size() < 2 || !DetermineLeaves(members, root, leaves) || leaves.size() > s_maxLeaves)
+            continue;
+
+        std::sort(members.begin(), members.end(), [&](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b) { return positions[a] < positions[b]; });
+        std::vector<FusibleElementwiseOp> memberOps;
+        for (const auto& member : members)
+        {
+            memberOps.push_back(ops[member]);
+            taken.insert(member);
+        }
+        chains.push_back(std::shared_ptr<FusedElementwiseChain>(new FusedElementwiseChain(std::move(members), std::move(memberOps))));
+    }
+    return chains;
+}
+
+FusedElementwiseChain::FusedElementwiseChain(std::vector<ComputationNodeBasePtr>&& nodes, std::vector<FusibleElementwiseOp>&& ops)
+    : FusedNodes(std::move(nodes)), m_ops(std::move(ops))
+{
+    if (!DetermineLeaves(m_nodes, GetRoot(), m_leaves))
+        LogicError("FusedElementwiseChain: Invalid leaves for chain of %ls %ls operation.", GetRoot()->NodeName().c_str(), GetRoot()->OperationName().c_str());
+    CompilePrograms();
+}
+
+// Registers [0, #leaves) hold the leaves; the gradient programs read the root gradient from register #leaves.
+void FusedElementwiseChain::CompilePrograms()
+{
+    size_t numLeaves = m_leaves.size();
+
+    // append the computation of the values of all nodes to 'program'; returns the register of each node and leaf
+    auto compileForward = [&](ElementwiseProgram& program)
+    {
+        std::map<ComputationNodeBasePtr, size_t> registers;
+        for (size_t i = 0; i < numLeaves; i++)
+            registers[m_leaves[i]] = i;
+        for (size_t k = 0; k < m_nodes.size(); k++)
+        {
+            const auto& inputs = m_nodes[k]->GetInputs();
+            registers[m_nodes[k]] = inputs.size() == 1 ? program.Add(m_ops[k].m_op, registers[inputs[0]])
+                                                       : program.Add(m_ops[k].m_op, registers[inputs[0]], registers[inputs[1]]);
+        }
+        return registers;
+    };
+
+    m_program = ElementwiseProgram(numLeaves);
+    compileForward(m_program);
+
+    // Each gradient program recomputes the values, then sweeps backwards over the nodes that depend on its leaf, and sums
+    // up the gradient contributions ('adjoints') of each node's output to its inputs.
+    m_gradientPrograms.clear();
+    for (const auto& leaf : m_leaves)
+    {
+        ElementwiseProgram program(numLeaves + 1);
+        auto registers = compileForward(program);
+
+        std::set<ComputationNodeBasePtr> dependsOnLeaf = { leaf };
+        for (const auto& node : m_nodes)
+        {
+            for (const auto& input : node->GetInputs())
+                if (dependsOnLeaf.find(input) != dependsOnLeaf.end())
+                    dependsOnLeaf.insert(node);
+        }
+
+        std::map<ComputationNodeBasePtr, size_t> adjoints = { { GetRoot(), numLeaves } };
+        for (size_t k = m_nodes.size(); k-- > 0;)
+        {
+            const auto& node = m_nodes[k];
+            auto adjoint = adjoints.find(node);
+            if (adjoint == adjoints.end())
+                continue;
+            size_t g = adjoint->second;
+            const auto& op = m_ops[k];
+            const auto& inputs = node->GetInputs();
+            for (size_t j = 0; j < inputs.size(); j++)
+            {
+                if (dependsOnLeaf.find(inputs[j]) == dependsOnLeaf.end())
+                    continue;
+                size_t contribution;
+                if (inputs.size() == 2)
+                {
+                    if (op.m_op == opElementwiseProduct)
+                        contribution = program.Add(opElementwiseProduct, g, registers[inputs[1 - j]]);
+                    else if (op.m_op == opDifference && j == 1)
+                        contribution = program.Add(opNegate, g);
+                    else
+                        contribution = g;
+                }
+                else if (op.m_gradientArg == FusibleElementwiseOp::noArg)
+                    contribution = op.m_gradientOp == opCopy ? g : program.Add(op.m_gradientOp, g);
+                else
+                    contribution = program.Add(op.m_gradientOp, g, registers[op.m_gradientArg == FusibleElementwiseOp::inputValueArg ? inputs[0] : node]);
+
+                auto existing = adjoints.find(inputs[j]);
+                if (existing == adjoints.end())
+                    adjoints[inputs[j]] = contribution;
+                else
+                    existing->second = program.Add(opSum, existing->second, contribution);
+            }
+        }
+
+        // the result of a program is its last register
+        size_t result = adjoints.at(leaf);
+        if (result + 1 != program.GetNumRegisters())
+            program.Add(opCopy, result);
+        m_gradientPrograms.push_back(program);
+    }
+}
+
+bool FusedElementwiseChain::CanRunFused() const
+{
+    const auto& root = GetRoot();
+    if (root->HasEnvironmentPtr() && root->Environment().trackGapNans)
+        return false;
+    for (const auto& leaf : m_leaves)
+    {
+        if (leaf->ValuePtr()->GetMatrixType() == SPARSE)
+            return false;
+    }
+    return true;
+}
+
+// the largest sample rank in the chain, so that all leaves can be padded to it
+size_t FusedElementwiseChain::DetermineTensorRank() const
+{
+    size_t rank = 0;
+    for (const auto& node : m_nodes)
+        rank = std::max(rank, node->GetSampleLayout().GetRank());
+    for (const auto& leaf : m_leaves)
+        rank = std::max(rank, leaf->GetSampleLayout().GetRank());
+    return rank;
+}
+
+void FusedElementwiseChain::ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    bool isRoot = node == GetRoot();
+    if (!CanRunFused())
+    {
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
+    }
+    else if (!isRoot)
+        node->BeginForwardProp(); // only to resize the value, which BeginBackprop() of its consumer verifies
+    else
+    {
+        node->BeginForwardProp();
+        if (GetPrecision(node) == 1)
+            ForwardPropFused<float>(fr.WithLayout(node->GetMBLayout()));
+        else
+            ForwardPropFused<double>(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
+    }
+}
+
+void FusedElementwiseChain::Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    if (!CanRunFused())
+    {
+        node->BeginBackprop();
+        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        node->EndBackprop();
+    }
+    else if (node == GetRoot())
+    {
+        node->BeginBackprop();
+        if (GetPrecision(node) == 1)
+            BackpropFused<float>(fr.WithLayout(node->GetMBLayout()));
+        else
+            BackpropFused<double>(fr.WithLayout(node->GetMBLayout()));
+        node->EndBackprop();
+    }
+}
+
+template <class ElemType>
+void FusedElementwiseChain::ForwardPropFused(const FrameRange& fr)
+{
+    auto root = GetRoot()->As<ComputationNode<ElemType>>();
+    size_t rank = DetermineTensorRank();
+    std::vector<TensorView<ElemType>> inputs;
+    for (const auto& leaf : m_leaves)
+        inputs.push_back(leaf->As<ComputationNode<ElemType>>()->ValueTensorFor(rank, fr.AllowBroadcast()));
+    root->ValueTensorFor(rank, fr).DoElementwiseProgramOf(0, inputs, m_program, 1);
+}
+
+template <class ElemType>
+void FusedElementwiseChain::BackpropFused(const FrameRange& fr)
+{
+    auto root = GetRoot()->As<ComputationNode<ElemType>>();
+    if (!root->NeedsGradient())
+        return;
+    root->LazyZeroGradient(); // as in ComputationNode::Backprop(), for roots that received no gradient
+
+    size_t rank = DetermineTensorRank();
+    std::vector<TensorView<ElemType>> inputs;
+    for (const auto& leaf : m_leaves)
+        inputs.push_back(leaf->As<ComputationNode<ElemType>>()->ValueTensorFor(rank, fr.AllowBroadcast()));
+    inputs.push_back(root->GradientTensorFor(rank, fr));
+
+    for (size_t i = 0; i < m_leaves.size(); i++)
+    {
+        auto leaf = m_leaves[i]->As<ComputationNode<ElemType>>();
+        if (!leaf->NeedsGradient())
+            continue;
+        leaf->LazyZeroGradient();
+        ElemType beta = leaf->ParentOverwritesGradient() ? 0 : 1;
+        auto leafGradient = leaf->GradientTensorFor(rank, fr.AllowBroadcast());
+
+        bool reducesInTime = leaf->ReducesInTimeWrt(GetRoot());
+        if (!reducesInTime && leafGradient.GetShape().GetNumElements() == inputs.back().GetShape().GetNumElements())
+        {
+            leafGradient.DoElementwiseProgramOf(beta, inputs, m_gradientPrograms[i], 1);
+            continue;
+        }
+
+        // the leaf broadcasts: compute its gradient in the root's shape, then reduce
+        if (!m_gradientBuffer)
+            m_gradientBuffer = std::make_shared<Matrix<ElemType>>(root->GetDeviceId());
+        auto& buffer = static_cast<Matrix<ElemType>&>(*m_gradientBuffer);
+        buffer.Resize(root->Gradient().GetNumRows(), root->Gradient().GetNumCols());
+        auto bufferTensor = root->DataTensorFor(m_gradientBuffer, rank, fr);
+        bufferTensor.DoElementwiseProgramOf(0, inputs, m_gradientPrograms[i], 1);
+        if (reducesInTime) // zero out the gaps
+            ComputationNode<ElemType>::MaskMissingColumnsToZero(buffer, root->GetMBLayout(), fr);
+        leafGradient.DoCopyOf(beta, bufferTensor, 1);
+    }
+}
+
+}}}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ElementwiseFusion.h -- evaluates chains of elementwise nodes as single fused tensor operations
+//
+// Typical networks contain chains such as Sigmoid(Plus(Times(W, x), b)) .* Tanh(c), where every elementwise node reads
+// its inputs from memory and writes a full-size result that only the next node reads. With fuseElementwiseOps=true,
+// ComputationNetwork::CompileNetwork() groups such nodes into FusedElementwiseChains. The forward pass of a chain is a
+// single ElementwiseProgram (see CommonMatrix.h) that computes the value of the chain's root from the chain's leaves,
+// the inputs that are not part of it. Its backward pass is one program per leaf that recomputes the values inside the
+// chain and propagates the root gradient straight to that leaf. The values and gradients of the interior nodes are never
+// computed.
+//
+// An interior node must
+//  - compute a single elementwise operation (ComputationNodeBase::IsFusibleElementwiseOp()),
+//  - have the same MBLayout, sample layout and precision as the root,
+//  - have a single consumer, and not be a root of the network (its value cannot be asked for),
+//  - not participate in a recurrent loop.
+// Leaves may broadcast into the root's shape, like the inputs of PlusNode etc. A chain has at most s_maxNodes nodes and
+// s_maxLeaves distinct leaves, so that its programs fit into an ElementwiseProgram.
+//
+// Chains with a sparse leaf, and chains in environments that track NaNs in gaps, run node by node as before.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "FusedNodes.h"
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class FusedElementwiseChain : public FusedNodes
+{
+public:
+    static const size_t s_maxLeaves = ElementwiseProgram::MaxInputs - 1; // the gradient programs also read the root gradient
+    static const size_t s_maxNodes = (ElementwiseProgram::MaxInstructions - 1) / 5;
+
+    // whether we know how to fuse the operation of 'node', including its gradient; 'op' receives the operation
+    static bool IsFusible(const ComputationNodeBasePtr& node, FusibleElementwiseOp& op);
+
+    // finds the chains in 'evalOrder', the global evaluation order; nodes in 'roots' can only be roots of chains
+    static std::vector<std::shared_ptr<FusedElementwiseChain>> Find(const std::list<ComputationNodeBasePtr>& evalOrder, const std::vector<ComputationNodeBasePtr>& roots);
+
+    // The root does the work for all; interior nodes only prepare their value matrix.
+    void ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr) override;
+    void Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr) override;
+
+private:
+    FusedElementwiseChain(std::vector<ComputationNodeBasePtr>&& nodes, std::vector<FusibleElementwiseOp>&& ops);
+
+    void CompilePrograms();
+    bool CanRunFused() const;
+    size_t DetermineTensorRank() const;
+
+    template <class ElemType> void ForwardPropFused(const FrameRange& fr);
+    template <class ElemType> void BackpropFused(const FrameRange& fr);
+
+    std::vector<FusibleElementwiseOp> m_ops;            // the operation of each node in m_nodes
+    ElementwiseProgram m_program;                       // value of the root from the leaves
+    std::vector<ElementwiseProgram> m_gradientPrograms; // for each leaf: its gradient from the leaves and the root gradient
+    MatrixBasePtr m_gradientBuffer;                     // root-sized gradient for leaves that broadcast, before reduction
+};
+
+}}}
@@ -56,7 +56,10 @@ public:
     {
         FrameRange fr(InputRef(0).GetMBLayout());
         InputRef(0).ValueFor(fr).VectorMax(*m_maxIndexes0, *m_maxValues, true);
-        InputRef(1).ValueFor(fr).VectorMax(*m_maxIndexes1, *m_maxValues, true, m_topK);
+        if (m_topK == 1)
+            InputRef(1).ValueFor(fr).VectorMax(*m_maxIndexes1, *m_maxValues, true);
+        else
+            InputRef(1).ValueFor(fr).TopK(*m_maxValues, *m_maxIndexes1, m_topK);
         MaskMissingColumnsToZero(*m_maxIndexes0, InputRef(0).GetMBLayout(), fr);
         MaskMissingColumnsToZero(*m_maxIndexes1, InputRef(1).GetMBLayout(), fr);
         Value().AssignNumOfDiff(*m_maxIndexes0, *m_maxIndexes1, m_topK > 1);
@@ -176,104 +179,26 @@ public:
         //      2. query id
         FrameRange fr(Input(0)->GetMBLayout());
 
-        // Construct matrices for further computation.
         const Matrix<ElemType>& gains = Input(0)->ValueFor(fr);
         const Matrix<ElemType>& preds = Input(1)->ValueFor(fr);
         const Matrix<ElemType>& queryIds = Input(2)->ValueFor(fr);
+        const size_t numberOfSamples = gains.GetNumCols();
+        const size_t numberOfQueries = UpdateQueryStarts(queryIds);
 
-        // Iterate through all samples
-        size_t numberOfSamples = gains.GetNumCols();
-        QueryUrls aqu;
-        int previousQueryId = -1;
-        int numberOfQueries = 0;
-
-        // Iterate all samples and populate m_queryUrls table. 
-        for (size_t i = 0; i < numberOfSamples; i++)
-        {
-            int queryId = (int)queryIds(0, i);
-            // Samples are grouped by queries. Find all the urls 
-            // belonging to each individual query.
-            if (queryId != previousQueryId)
-            {
-                m_queryUrls.push_back(aqu);
-                numberOfQueries++;
-                previousQueryId = queryId;
-            }
-
-            // Get the last QueryUrls and add the Url.
-            QueryUrls& qub = m_queryUrls.back();
-            Url u(i, qub.m_urls.size(), preds(0, i), gains(0, i));
-            qub.m_urls.push_back(u);
-        }
-
-        for (auto &qu : m_queryUrls)
-        {
-            std::vector<Url>& urls = qu.m_urls;
-            // Urls are pre-sorted in descending order of gains.
-            typename std::vector<Url>::iterator its = m_urlSorter.begin(), it = urls.begin();
-            typename std::vector<Url>::iterator its0 = its;
-            its = std::copy(it, urls.end(), its);
-            std::sort(its0, its);
-
-            // Set the sorted rk order to each url and 
-            // the urls are still in the original order
-            int rk = 0;
-            for (it = its0; it != its; it++)
-            {
-                urls[it->m_rank0].m_rank = rk++;
-            }
-        }
-
-        // calculate IRMetrics
-        size_t sampleCount = 0;
-        for (const auto &qu: m_queryUrls)
-        {
-            for (const auto &url : qu.m_urls)
-            {
-                (*m_urlGain0)(0, sampleCount) = url.m_gain;
-                (*m_urlGain1)(0, sampleCount) = url.m_gain;
-                (*m_urlDiscount0)(0, sampleCount) = (ElemType)url.m_rank0;
-                (*m_urlDiscount1)(0, sampleCount) = (ElemType)url.m_rank;
-                sampleCount++;
-            }
-        }
-
-        // log(2+rank)
-        *m_urlDiscount0 += 2.0;
-        m_urlDiscount0->InplaceLog();
-        *m_urlDiscount1 += 2.0;
-        m_urlDiscount1->InplaceLog();
-        // gain/log(2+rank)
-        m_urlGain0->AssignElementDivisionOf(*m_urlGain0, *m_urlDiscount0);
-        m_urlGain1->AssignElementDivisionOf(*m_urlGain1, *m_urlDiscount1);
-
-        //Aggregate at query level.
-        const Matrix<ElemType>& urlDiscountedGain0 = *m_urlGain0;
-        const Matrix<ElemType>& urlDiscountedGain1 = *m_urlGain1;
-        ElemType irMetricValue = 0.0;
-        ElemType idealMetric = 0.0, metric = 0.0;
+        // Rank the urls of each query by score on the device of the inputs; the DCG @ 1 of a query is that of its
+        // first url by score, the ideal DCG @ 1 that of its first url (urls are pre-sorted in descending order of gains).
+        Matrix<ElemType>::RankWithinGroups(preds, gains, *m_groupStarts, 1, *m_ranks, *m_dcgs, *m_idealDCGs);
 
         // IRMetric @ 1
-        for (auto &qu : m_queryUrls)
+        m_metrics.resize(numberOfQueries);
+        m_idealMetrics.resize(numberOfQueries);
+        m_dcgs->CopySection(1, numberOfQueries, m_metrics.data(), 1);
+        m_idealDCGs->CopySection(1, numberOfQueries, m_idealMetrics.data(), 1);
+        ElemType irMetricValue = 0.0;
+        for (size_t q = 0; q < numberOfQueries; q++)
         {
-            idealMetric = urlDiscountedGain0(0, qu.m_urls.begin()->m_id);
-            if (idealMetric == 0.0) continue;
-
-            for (auto &url : qu.m_urls)
-            {
-                if (url.m_rank == 0)
-                {
-                    metric = urlDiscountedGain1(0, url.m_id);
-                    break;
-                }
-            }
-
-            irMetricValue += (metric / idealMetric);
-        }
-
-        if (numberOfQueries == 0)
-        {
-            LogicError("In %ls %ls numberOfQueries==0, check your data.", NodeName().c_str(), OperationName().c_str());
+            if (m_idealMetrics[q] != 0.0)
+                irMetricValue += m_metrics[q] / m_idealMetrics[q];
         }
 
         irMetricValue = irMetricValue / numberOfQueries * 100 * numberOfSamples;
@@ -294,165 +219,65 @@ public:
         ValidateBinaryReduce(isFinalValidationPass);
     }
 
-    virtual void UpdateFunctionMBSize() override
-    {
-        UpdateCounts();
-
-        // clean up first
-        if (!m_queryUrls.empty()) m_queryUrls.clear();
-        if (!m_urlSorter.empty()) m_urlSorter.clear();
-        if (!m_logWeights.empty()) m_logWeights.clear();
-
-        m_urlGain0->Resize(1, m_numberOfQueryUrls);
-        m_urlGain1->Resize(1, m_numberOfQueryUrls);
-        m_urlDiscount0->Resize(1, m_numberOfQueryUrls);
-        m_urlDiscount1->Resize(1, m_numberOfQueryUrls);
-
-        // keep one additional space to avoid pointer moving out
-        m_urlSorter.resize(m_maxNumberOfUrlsPerQuery + 1);
-
-        // prepared lookup table
-        m_logWeights.resize(m_maxNumberOfUrlsPerQuery);
-        size_t i = 0;
-        for (typename std::vector<ElemType>::iterator it = m_logWeights.begin(); it != m_logWeights.end(); it++, i++)
-        {
-            *it = (ElemType)log(2.0 + i);
-        }
-    }
-
-    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
-    {
-        Base::CopyTo(nodeP, newName, flags);
-        if (flags & CopyNodeFlags::copyNodeValue)
-        {
-            auto node = dynamic_pointer_cast<NDCG1EvalNode<ElemType>>(nodeP);
-            node->m_urlGain0->SetValue(*m_urlGain0);
-            node->m_urlGain1->SetValue(*m_urlGain1);
-            node->m_urlDiscount0->SetValue(*m_urlDiscount0);
-            node->m_urlDiscount1->SetValue(*m_urlDiscount1);
-
-            node->m_queryUrls = m_queryUrls;
-            node->m_urlSorter = m_urlSorter;
-            node->m_logWeights = m_logWeights;
-        }
-    }
-
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_urlGain0, matrixPool);
-        RequestMatrixFromPool(m_urlGain1, matrixPool);
-        RequestMatrixFromPool(m_urlDiscount0, matrixPool);
-        RequestMatrixFromPool(m_urlDiscount1, matrixPool);
+        RequestMatrixFromPool(m_groupStarts, matrixPool);
+        RequestMatrixFromPool(m_ranks, matrixPool);
+        RequestMatrixFromPool(m_dcgs, matrixPool);
+        RequestMatrixFromPool(m_idealDCGs, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_urlGain0, matrixPool);
-        ReleaseMatrixToPool(m_urlGain1, matrixPool);
-        ReleaseMatrixToPool(m_urlDiscount0, matrixPool);
-        ReleaseMatrixToPool(m_urlDiscount1, matrixPool);
-
-        // is this the right place?  it was not called after bp.
-        m_queryUrls.clear();
-        m_urlSorter.clear();
-        m_logWeights.clear();
+        ReleaseMatrixToPool(m_groupStarts, matrixPool);
+        ReleaseMatrixToPool(m_ranks, matrixPool);
+        ReleaseMatrixToPool(m_dcgs, matrixPool);
+        ReleaseMatrixToPool(m_idealDCGs, matrixPool);
     }
 
 protected:
 
-    void UpdateCounts()
+    // Finds the first url of each query and the number of urls in m_groupStarts, and returns the number of queries.
+    size_t UpdateQueryStarts(const Matrix<ElemType>& queryIds)
     {
-        FrameRange fr(Input(0)->GetMBLayout());
-        const Matrix<ElemType>& gains = Input(0)->ValueFor(fr);
-        const Matrix<ElemType>& queryIds = Input(2)->ValueFor(fr);
-        const size_t numberOfQueryUrls = gains.GetNumCols();
-        int previousQueryId = -1;
-
-        // Number of urls we have seen for the current query
-        size_t numberOfUrls = 0;
-        size_t maxNumberOfUrlsPerQuery = 0;
-        for (size_t i = 0; i < numberOfQueryUrls; i++)
+        const size_t numberOfSamples = queryIds.GetNumCols();
+        m_queryIds.resize(numberOfSamples);
+        queryIds.CopySection(1, numberOfSamples, m_queryIds.data(), 1);
+        m_queryStarts.clear();
+        for (size_t i = 0; i < numberOfSamples; i++)
         {
-            int queryId = (int)queryIds(0, i);
-            if (queryId != previousQueryId)
-            {
-                if (numberOfUrls > maxNumberOfUrlsPerQuery)
-                {
-                    maxNumberOfUrlsPerQuery = numberOfUrls;
-                }
-
-                // New query
-                numberOfUrls = 0;
-                previousQueryId = queryId;
-            }
-            
-            numberOfUrls++;
+            if (i == 0 || (int)m_queryIds[i] != (int)m_queryIds[i - 1])
+                m_queryStarts.push_back((ElemType)i);
         }
 
-        // Add last query.
+        const size_t numberOfQueries = m_queryStarts.size();
+        if (numberOfQueries == 0)
         {
-            if (numberOfUrls > maxNumberOfUrlsPerQuery)
-            {
-                maxNumberOfUrlsPerQuery = numberOfUrls;
-            }
+            LogicError("In %ls %ls numberOfQueries==0, check your data.", NodeName().c_str(), OperationName().c_str());
         }
 
-        m_numberOfQueryUrls = numberOfQueryUrls;
-        m_maxNumberOfUrlsPerQuery = maxNumberOfUrlsPerQuery;
+        m_queryStarts.push_back((ElemType)numberOfSamples);
+        m_groupStarts->SetValue(1, m_queryStarts.size(), m_groupStarts->GetDeviceId(), m_queryStarts.data());
+        return numberOfQueries;
     }
 
-    struct Url
-    {
-        Url()
-        {
-            m_id = 0;
-            m_rank0 = 0;
-            m_rank = 0;
-            m_score = (ElemType)0;
-            m_gain = (ElemType)0;
-        }
-
-        Url(int _id, int _rk0, ElemType _sc, ElemType _gn) : m_id(_id), m_rank0(_rk0), m_rank(0), m_score(_sc), m_gain(_gn) {}
-
-        int m_id;         // sample id
-        int m_rank0;        // original rank based on label
-        int m_rank;         // rank based on s in the associated query
-        ElemType m_score;    // score
-        ElemType m_gain;    // gain
-        bool operator < (const Url &url) const{
-            // tie breaking
-            if (m_score == url.m_score || std::isnan(m_score) || std::isnan(url.m_score))
-            {
-                return m_gain < url.m_gain;
-            }
-
-            return m_score > url.m_score;
-        }
-    };
-
-    struct QueryUrls
-    {
-        std::vector<Url> m_urls;
-    };
+    // host buffers
+    std::vector<ElemType> m_queryIds;
+    std::vector<ElemType> m_queryStarts;
+    std::vector<ElemType> m_metrics;
+    std::vector<ElemType> m_idealMetrics;
 
-    // master data structure
-    std::list<QueryUrls> m_queryUrls;
-    // buffer for sorting
-    std::vector<Url> m_urlSorter;
-    // lookup table for position based weights
-    std::vector<ElemType> m_logWeights;
-
-    size_t m_numberOfQueryUrls;
-    size_t m_maxNumberOfUrlsPerQuery;
-    // store the gains and weights
-    shared_ptr<Matrix<ElemType>> m_urlGain0;
-    shared_ptr<Matrix<ElemType>> m_urlGain1;
-    shared_ptr<Matrix<ElemType>> m_urlDiscount0;
-    shared_ptr<Matrix<ElemType>> m_urlDiscount1;
+    // first url of each query, and the number of urls
+    shared_ptr<Matrix<ElemType>> m_groupStarts;
+    // rank of each url by score within its query
+    shared_ptr<Matrix<ElemType>> m_ranks;
+    // DCG @ 1 of each query, and the ideal one
+    shared_ptr<Matrix<ElemType>> m_dcgs;
+    shared_ptr<Matrix<ElemType>> m_idealDCGs;
 };
 
 template class NDCG1EvalNode<float>;
@@ -569,118 +394,45 @@ public:
 
     // firstSeq - first sequence of samples
     // secondSeq - second sequence of samples
-    // numParallelSequences - number of parallel sequences in the minibatch
+    // pMBLayout - layout of the sequences in the minibatch
     // subPen - substitution penalty
     // delPen - deletion penalty
     // insPen - insertion penalty
     // squashInputs - whether to merge sequences of identical samples.
     // tokensToIgnore - list of samples to ignore during edit distance evaluation
+    // Both inputs are copied to the CPU with one transfer each; the sequences are then aligned in parallel.
     static ElemType ComputeEditDistanceError(Matrix<ElemType>& firstSeq, const Matrix<ElemType> & secondSeq, MBLayoutPtr pMBLayout, 
         float subPen, float delPen, float insPen, bool squashInputs, const vector<size_t>& tokensToIgnore)
     {
-        std::vector<int> firstSeqVec, secondSeqVec;
-
-        // Edit distance between subsequences
-        Matrix<float> grid(CPUDEVICE);
-        
-        // Number of insertions between subsequences
-        Matrix<float> insMatrix(CPUDEVICE);
-        
-        //Number of deletions between subsequences
-        Matrix<float> delMatrix(CPUDEVICE);
-
-        // Number of substitutions between subsequences
-        Matrix<float> subMatrix(CPUDEVICE);
-
-        float del, ins, sub;
-        ElemType wrongSampleNum = 0.0;
-        size_t totalSampleNum = 0, totalframeNum = 0;
-        size_t sequenceStartFrame = 0;
+        std::unique_ptr<ElemType[]> firstSeqOnHost(firstSeq.CopyToArray());
+        std::unique_ptr<ElemType[]> secondSeqOnHost(secondSeq.CopyToArray());
 
+        std::vector<std::vector<size_t>> allColumnIndices;
+        size_t totalframeNum = 0;
         for (const auto& sequence : pMBLayout->GetAllSequences())
         {
             if (sequence.seqId == GAP_SEQUENCE_ID)
                 continue;
 
             auto numFrames = pMBLayout->GetNumSequenceFramesInCurrentMB(sequence);
-
             if (numFrames > 0)
             {
                 totalframeNum += numFrames;
-
-                auto columnIndices = pMBLayout->GetColumnIndices(sequence);
-
-                ExtractSampleSequence(firstSeq, columnIndices, squashInputs, tokensToIgnore, firstSeqVec);
-                ExtractSampleSequence(secondSeq, columnIndices, squashInputs, tokensToIgnore, secondSeqVec);
-
-                //calculate edit distance
-                size_t firstSize = firstSeqVec.size();
-                totalSampleNum += firstSize;
-                size_t secondSize = secondSeqVec.size();
-                grid.Resize(firstSize + 1, secondSize + 1);
-                insMatrix.Resize(firstSize + 1, secondSize + 1);
-                delMatrix.Resize(firstSize + 1, secondSize + 1);
-                subMatrix.Resize(firstSize + 1, secondSize + 1);
-                insMatrix.SetValue(0.0f);
-                delMatrix.SetValue(0.0f);
-                subMatrix.SetValue(0.0f);
-
-                for (size_t i = 0; i < firstSize + 1; i++)
-                {
-                    grid(i, 0) = (float)(i * delPen);
-                    delMatrix(i, 0) = (float)i;
-                }
-
-                for (size_t j = 0; j < secondSize + 1; j++)
-                {
-                    grid(0, j) = (float)(j * insPen);
-                    insMatrix(0, j) = (float)j;
-                }
-                for (size_t i = 1; i < firstSize + 1; i++)
-                {
-                    for (size_t j = 1; j < secondSize + 1; j++)
-                    {
-                        if (firstSeqVec[i - 1] == secondSeqVec[j - 1])
-                        {
-                            grid(i, j) = grid(i - 1, j - 1);
-                            insMatrix(i, j) = insMatrix(i - 1, j - 1);
-                            delMatrix(i, j) = delMatrix(i - 1, j - 1);
-                            subMatrix(i, j) = subMatrix(i - 1, j - 1);
-                        }
-                        else
-                        {
-                            del = grid(i - 1, j) + delPen; //deletion 
-                            ins = grid(i, j - 1) + insPen;  //insertion
-                            sub = grid(i - 1, j - 1) + subPen; //substitution 
-                            if (sub <= del && sub <= ins)
-                            {
-                                insMatrix(i, j) = insMatrix(i - 1, j - 1);
-                                delMatrix(i, j) = delMatrix(i - 1, j - 1);
-                                subMatrix(i, j) = subMatrix(i - 1, j - 1) + 1.0f;
-                                grid(i, j) = sub;
-                            }
-                            else if (del < ins)
-                            {
-                                insMatrix(i, j) = insMatrix(i - 1, j);
-                                subMatrix(i, j) = subMatrix(i - 1, j);
-                                delMatrix(i, j) = delMatrix(i - 1, j) + 1.0f;
-                                grid(i, j) = del;
-                            }
-                            else
-                            {
-                                delMatrix(i, j) = delMatrix(i, j - 1);
-                                subMatrix(i, j) = subMatrix(i, j - 1);
-                                insMatrix(i, j) = insMatrix(i, j - 1) + 1.0f;
-                                grid(i, j) = ins;
-                            }
-                        }
-                    }
-                }
-
-                wrongSampleNum += insMatrix(firstSize, secondSize) + delMatrix(firstSize, secondSize) + subMatrix(firstSize, secondSize);
+                allColumnIndices.push_back(pMBLayout->GetColumnIndices(sequence));
             }
+        }
 
-            sequenceStartFrame += numFrames;
+        const int numSequences = (int)allColumnIndices.size();
+        double wrongSampleNum = 0.0;
+        size_t totalSampleNum = 0;
+#pragma omp parallel for reduction(+ : wrongSampleNum, totalSampleNum) schedule(dynamic)
+        for (int k = 0; k < numSequences; k++)
+        {
+            std::vector<int> firstSeqVec, secondSeqVec;
+            ExtractSampleSequence(firstSeqOnHost.get(), allColumnIndices[k], squashInputs, tokensToIgnore, firstSeqVec);
+            ExtractSampleSequence(secondSeqOnHost.get(), allColumnIndices[k], squashInputs, tokensToIgnore, secondSeqVec);
+            totalSampleNum += firstSeqVec.size();
+            wrongSampleNum += ComputeNumErrors(firstSeqVec, secondSeqVec, subPen, delPen, insPen);
         }
 
         return (ElemType)(wrongSampleNum * totalframeNum / totalSampleNum);
@@ -721,13 +473,13 @@ private:
     float m_insPen;
     std::vector<size_t> m_tokensToIgnore;
 
-    // Clear out_SampleSeqVec and extract a vector of samples from the matrix into out_SampleSeqVec.
-    static void ExtractSampleSequence(const Matrix<ElemType>& firstSeq, vector<size_t>& columnIndices, bool squashInputs, const vector<size_t>& tokensToIgnore, std::vector<int>& out_SampleSeqVec)
+    // Clear out_SampleSeqVec and extract a vector of samples from the row vector into out_SampleSeqVec.
+    static void ExtractSampleSequence(const ElemType* firstSeq, const vector<size_t>& columnIndices, bool squashInputs, const vector<size_t>& tokensToIgnore, std::vector<int>& out_SampleSeqVec)
     {
         out_SampleSeqVec.clear();
 
         // Get the first element in the sequence
-        size_t lastId = (int)firstSeq(0, columnIndices[0]);
+        size_t lastId = (int)firstSeq[columnIndices[0]];
         if (std::find(tokensToIgnore.begin(), tokensToIgnore.end(), lastId) == tokensToIgnore.end())
             out_SampleSeqVec.push_back(lastId);
 
@@ -737,7 +489,7 @@ private:
             //squash sequences of identical samples
             for (size_t i = 1; i < columnIndices.size(); i++)
             {
-                size_t refId = (int)firstSeq(0, columnIndices[i]);
+                size_t refId = (int)firstSeq[columnIndices[i]];
                 if (lastId != refId)
                 {
                     lastId = refId;
@@ -750,12 +502,70 @@ private:
         {
             for (size_t i = 1; i < columnIndices.size(); i++)
             {
-                auto refId = (int)firstSeq(0, columnIndices[i]);
+                auto refId = (int)firstSeq[columnIndices[i]];
                 if (std::find(tokensToIgnore.begin(), tokensToIgnore.end(), refId) == tokensToIgnore.end())
                     out_SampleSeqVec.push_back(refId);
             }
         }
     }
+
+    // Number of insertions, deletions and substitutions of the cheapest alignment of the two sequences.
+    // The grid is computed row by row, keeping only the previous row.
+    static float ComputeNumErrors(const std::vector<int>& firstSeqVec, const std::vector<int>& secondSeqVec, float subPen, float delPen, float insPen)
+    {
+        struct Cell
+        {
+            float cost; // edit distance between the subsequences
+            float ins;  // number of insertions
+            float del;  // number of deletions
+            float sub;  // number of substitutions
+        };
+
+        size_t firstSize = firstSeqVec.size();
+        size_t secondSize = secondSeqVec.size();
+        std::vector<Cell> prevRow(secondSize + 1), row(secondSize + 1);
+        for (size_t j = 0; j < secondSize + 1; j++)
+            row[j] = { (float)(j * insPen), (float)j, 0.0f, 0.0f };
+
+        for (size_t i = 1; i < firstSize + 1; i++)
+        {
+            std::swap(prevRow, row);
+            row[0] = { (float)(i * delPen), 0.0f, (float)i, 0.0f };
+            for (size_t j = 1; j < secondSize + 1; j++)
+            {
+                if (firstSeqVec[i - 1] == secondSeqVec[j - 1])
+                {
+                    row[j] = prevRow[j - 1];
+                    continue;
+                }
+
+                float del = prevRow[j].cost + delPen;    //deletion 
+                float ins = row[j - 1].cost + insPen;    //insertion
+                float sub = prevRow[j - 1].cost + subPen; //substitution 
+                if (sub <= del && sub <= ins)
+                {
+                    row[j] = prevRow[j - 1];
+                    row[j].sub += 1.0f;
+                    row[j].cost = sub;
+                }
+                else if (del < ins)
+                {
+                    row[j] = prevRow[j];
+                    row[j].del += 1.0f;
+                    row[j].cost = del;
+                }
+                else
+                {
+                    row[j] = row[j - 1];
+                    row[j].ins += 1.0f;
+                    row[j].cost = ins;
+                }
+            }
+        }
+
+        const Cell& last = row[secondSize];
+        return last.ins + last.del + last.sub;
+    }
 };
 
 template class EditDistanceErrorNode<float>;
@@ -0,0 +1,206 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ForwardGraphCache.cpp -- replays the forward pass of a network from CUDA graphs for minibatches of the same layout
+//
+
+#include "stdafx.h"
+#include "ForwardGraphCache.h"
+#include "FusedNodes.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+static bool GetValueSignature(const MatrixBasePtr& value, std::tuple<const void*, size_t, size_t>& signature)
+{
+    auto matrix = dynamic_cast<const Matrix<ElemType>*>(value.get());
+    if (!matrix)
+        return false;
+    signature = std::make_tuple((const void*) matrix->Data(), matrix->GetNumRows(), matrix->GetNumCols());
+    return true;
+}
+
+bool ForwardGraphCache::Signature::Matches(const Signature& current) const
+{
+    if (roots != current.roots || operationMode != current.operationMode || values != current.values ||
+        nodesToRun != current.nodesToRun || layouts != current.layouts)
+        return false;
+    for (size_t i = 0; i < layouts.size(); i++)
+    {
+        if (*layoutContents[i] != *current.layouts[i])
+            return false;
+    }
+    return true;
+}
+
+/*static*/ bool ForwardGraphCache::CanCapture(const ComputationEnvironment& environment)
+{
+    // these read values back to the host
+    return !environment.trackGapNans && !environment.ShouldDumpNode() && !environment.IsPreComputing();
+}
+
+/*static*/ bool ForwardGraphCache::AddNode(const ComputationNodeBasePtr& node, Signature& signature, DEVICEID_TYPE& deviceId)
+{
+    const MatrixBasePtr& value = node->ValuePtr();
+    if (!value || value->GetMatrixType() == MatrixType::SPARSE)
+        return false;
+    if (deviceId == CPUDEVICE)
+        deviceId = value->GetDeviceId();
+    if (deviceId < 0 || value->GetDeviceId() != deviceId)
+        return false;
+    signature.values.push_back(ValueSignature());
+    if (!GetValueSignature<float>(value, signature.values.back()) && !GetValueSignature<double>(value, signature.values.back()))
+        return false;
+
+    const MBLayoutPtr& layout = node->GetMBLayout();
+    if (layout && std::find(signature.layouts.begin(), signature.layouts.end(), layout) == signature.layouts.end())
+        signature.layouts.push_back(layout);
+    return true;
+}
+
+/*static*/ bool ForwardGraphCache::DetermineSignature(const std::vector<ComputationNodeBasePtr>& roots, const std::vector<ComputationNodeBasePtr>& nodes,
+                                                      const ComputationEnvironment& environment, Signature& signature, std::vector<ComputationNodeBasePtr>& nodesToRun)
+{
+    if (!CanCapture(environment))
+        return false;
+
+    for (const auto& root : roots)
+        signature.roots.push_back(root.get());
+    signature.operationMode = environment.networkOperationMode;
+
+    DEVICEID_TYPE deviceId = CPUDEVICE;
+    std::unordered_set<const ComputationNodeBase*> nodesThatRun;
+    for (const auto& node : nodes)
+    {
+        if (node->IsPartOfLoop() || !AddNode(node, signature, deviceId))
+            return false;
+
+        // the same test as PARTraversalFlowControlNode::ForwardProp(), as of after its inputs have run
+        bool runs = node->IsOutOfDateWrtInputs();
+        for (const auto& input : node->GetInputs())
+            runs = runs || nodesThatRun.find(input.get()) != nodesThatRun.end();
+        if (!runs)
+            continue;
+        if (!node->CanReplayForwardProp() || (node->GetFusedChain() && !node->GetFusedChain()->CanReplayForwardProp()))
+            return false;
+        nodesThatRun.insert(node.get());
+        signature.nodesToRun.push_back(node.get());
+        nodesToRun.push_back(node);
+    }
+    return true;
+}
+
+/*static*/ bool ForwardGraphCache::DetermineLoopSignature(const std::vector<ComputationNodeBasePtr>& loopNodes, const ComputationEnvironment& environment,
+                                                          Signature& signature)
+{
+    if (!CanCapture(environment))
+        return false;
+
+    signature.operationMode = environment.networkOperationMode;
+
+    // all nodes of the loop run; the inputs from outside the loop are part of the signature as well
+    DEVICEID_TYPE deviceId = CPUDEVICE;
+    std::unordered_set<const ComputationNodeBase*> nodesInSignature;
+    for (const auto& node : loopNodes)
+    {
+        if (!node->CanReplayForwardPropInLoop() || !AddNode(node, signature, deviceId))
+            return false;
+        nodesInSignature.insert(node.get());
+        signature.nodesToRun.push_back(node.get());
+    }
+    for (const auto& node : loopNodes)
+    {
+        for (const auto& input : node->GetInputs())
+        {
+            if (nodesInSignature.insert(input.get()).second && !AddNode(input, signature, deviceId))
+                return false;
+        }
+    }
+    return true;
+}
+
+void ForwardGraphCache::ForwardProp(const std::vector<ComputationNodeBasePtr>& roots, const std::vector<ComputationNodeBasePtr>& nodes,
+                                    const ComputationEnvironment& environment, const std::function<void()>& forwardProp)
+{
+    Signature current;
+    std::vector<ComputationNodeBasePtr> nodesToRun;
+    if (!DetermineSignature(roots, nodes, environment, current, nodesToRun) || nodesToRun.empty())
+    {
+        forwardProp();
+        return;
+    }
+    Run(current, nodesToRun, forwardProp);
+}
+
+void ForwardGraphCache::ForwardPropLoop(const std::vector<ComputationNodeBasePtr>& loopNodes, const ComputationEnvironment& environment,
+                                        const std::function<void()>& forwardProp)
+{
+    Signature current;
+    if (loopNodes.empty() || !DetermineLoopSignature(loopNodes, environment, current))
+    {
+        forwardProp();
+        return;
+    }
+    Run(current, loopNodes, forwardProp);
+}
+
+void ForwardGraphCache::Run(const Signature& current, const std::vector<ComputationNodeBasePtr>& nodesToRun, const std::function<void()>& forwardProp)
+{
+    auto iter = std::find_if(m_entries.begin(), m_entries.end(), [&current](const Entry& entry) { return entry.signature.Matches(current); });
+    if (iter == m_entries.end())
+    {
+        m_entries.emplace_front();
+        Signature& signature = m_entries.front().signature;
+        signature = current;
+        for (const auto& layout : current.layouts)
+        {
+            signature.layoutContents.push_back(std::make_shared<MBLayout>());
+            signature.layoutContents.back()->CopyFrom(layout);
+        }
+        if (m_entries.size() > s_maxSignatures)
+            m_entries.pop_back();
+    }
+    else
+        m_entries.splice(m_entries.begin(), m_entries, iter);
+    Entry& entry = m_entries.front();
+
+    if (entry.graph && !entry.graph->IsValid())
+        entry.graph.reset();
+    if (entry.graph)
+    {
+        entry.graph->Launch();
+        for (const auto& node : nodesToRun)
+            node->BumpEvalTimeStamp();
+        return;
+    }
+
+    if (entry.isCapturable && entry.numRuns >= s_numWarmupRuns && entry.numCaptures == s_maxCapturesPerSignature)
+    {
+        fprintf(stderr, "ForwardGraphCache: The memory of the CUDA graph of a minibatch layout was freed %d times, not capturing it anymore.\n", (int) entry.numCaptures);
+        entry.isCapturable = false;
+    }
+    if (!entry.isCapturable || entry.numRuns < s_numWarmupRuns)
+    {
+        entry.numRuns++;
+        forwardProp();
+        return;
+    }
+
+    entry.numCaptures++;
+    entry.graph = CudaGraph::Capture(nodesToRun.front()->ValuePtr()->GetDeviceId(), forwardProp);
+    if (entry.graph)
+    {
+        entry.graph->Launch();
+        return;
+    }
+    // nothing was computed, but the host code of the nodes ran
+    entry.isCapturable = false;
+    for (const auto& node : nodesToRun)
+        node->SetEvalTimeStampOutdatedWrtAll();
+    forwardProp();
+}
+
+}}}
@@ -0,0 +1,104 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ForwardGraphCache.h -- replays the forward pass of a network from CUDA graphs for minibatches of the same layout
+//
+// For small minibatches the time to issue the kernels of a forward pass on the host exceeds the time the GPU needs to run
+// them. With cudaGraphs=true, ComputationNetwork::ForwardProp() records the kernels of a forward pass once into a CUDA
+// graph (see CudaGraph.h), and replays it for later minibatches with the same signature:
+//  - the root nodes, and the operation mode of the network (training, inferring),
+//  - the MBLayouts of the nodes, compared by content, which determine the shapes and the masking of gaps,
+//  - the nodes that are out of date and would run,
+//  - the address and dimensions of the value of each node.
+// A replay runs none of the host code of the nodes; it only bumps the time stamps of the nodes that would have run.
+//
+// A signature is first run without capture s_numWarmupRuns times, so that node-internal buffers have their final size and
+// autotuning (e.g. of cuDNN algorithms) is done. A graph is dropped and captured again when the allocator reports that
+// memory it uses was freed (e.g. a node resized a temporary), up to s_maxCapturesPerSignature times.
+// Signatures are not captured if any of their nodes cannot be replayed: nodes in recurrent loops, nodes whose value is
+// sparse, and nodes that refuse (ComputationNodeBase::CanReplayForwardProp(), e.g. dropout in training, or the group of
+// the node, FusedNodes::CanReplayForwardProp()). Nodes whose forward pass synchronizes with the host cannot be captured
+// either; such signatures are run as before from then on.
+//
+// Recurrent loops have a cache of their own (SEQTraversalFlowControlNode), which replays all time steps of the loop, i.e.
+// the many small kernels that each node issues per step, with one launch. Only the per-step ForwardProp() calls are
+// replayed; BeginForwardProp() and EndForwardProp() of the nodes of the loop still run on the host for each minibatch. The
+// signature consists of the values of the nodes of the loop and of their inputs, and of their MBLayouts. All nodes of the
+// loop must be replayable (ComputationNodeBase::CanReplayForwardPropInLoop(); delay nodes only if no sequence continues
+// from the previous minibatch).
+//
+// The cache holds the graphs of the s_maxSignatures signatures used most recently, and is cleared when the matrices of
+// the network are (re-)allocated, i.e. when its node set has changed.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "ComputationEnvironment.h"
+#include "CudaGraph.h"
+#include <functional>
+#include <list>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ForwardGraphCache
+{
+public:
+    static const size_t s_numWarmupRuns = 2;
+    static const size_t s_maxCapturesPerSignature = 3;
+    static const size_t s_maxSignatures = 8;
+
+    // Runs 'forwardProp', the forward pass of 'roots', or replays it. 'nodes' are all nodes it visits, in evaluation order.
+    void ForwardProp(const std::vector<ComputationNodeBasePtr>& roots, const std::vector<ComputationNodeBasePtr>& nodes,
+                     const ComputationEnvironment& environment, const std::function<void()>& forwardProp);
+    // Runs 'forwardProp', the time steps of a recurrent loop over 'loopNodes' (in loop order), or replays it.
+    void ForwardPropLoop(const std::vector<ComputationNodeBasePtr>& loopNodes, const ComputationEnvironment& environment,
+                         const std::function<void()>& forwardProp);
+
+    void Clear() { m_entries.clear(); }
+
+private:
+    typedef std::tuple<const void*, size_t, size_t> ValueSignature; // data, rows, columns
+
+    struct Signature
+    {
+        std::vector<const ComputationNodeBase*> roots;
+        NetworkOperationMode operationMode;
+        std::vector<MBLayoutPtr> layouts;
+        std::vector<MBLayoutPtr> layoutContents; // copies of 'layouts' as they were, only in cache entries
+        std::vector<const ComputationNodeBase*> nodesToRun;
+        std::vector<ValueSignature> values;
+
+        bool Matches(const Signature& current) const;
+    };
+
+    struct Entry
+    {
+        Signature signature;
+        size_t numRuns = 0;
+        size_t numCaptures = 0;
+        bool isCapturable = true;
+        std::unique_ptr<CudaGraph> graph;
+    };
+
+    // returns false if the signature cannot be replayed
+    static bool DetermineSignature(const std::vector<ComputationNodeBasePtr>& roots, const std::vector<ComputationNodeBasePtr>& nodes,
+                                   const ComputationEnvironment& environment, Signature& signature, std::vector<ComputationNodeBasePtr>& nodesToRun);
+    static bool DetermineLoopSignature(const std::vector<ComputationNodeBasePtr>& loopNodes, const ComputationEnvironment& environment,
+                                       Signature& signature);
+    static bool CanCapture(const ComputationEnvironment& environment);
+    // adds the value and the MBLayout of 'node' to 'signature'; all values must be dense and on the same GPU 'deviceId'
+    static bool AddNode(const ComputationNodeBasePtr& node, Signature& signature, DEVICEID_TYPE& deviceId);
+
+    // runs or replays 'forwardProp' for the 'current' signature
+    void Run(const Signature& current, const std::vector<ComputationNodeBasePtr>& nodesToRun, const std::function<void()>& forwardProp);
+
+    std::list<Entry> m_entries; // most recently used first
+};
+
+}}}
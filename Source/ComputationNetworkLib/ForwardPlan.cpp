@@ -0,0 +1,107 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ForwardPlan.cpp -- runs the forward pass of a network in inference mode from a precompiled list of steps
+//
+
+#include "stdafx.h"
+#include "ForwardPlan.h"
+#include "FusedNodes.h"
+#include <unordered_set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool ForwardPlanCache::Plan::IsValid(const ComputationEnvironment& environment) const
+{
+    if (environment.networkOperationMode != operationMode)
+        return false;
+    for (const auto& timeStamp : timeStamps)
+    {
+        if (timeStamp.first->GetEvalTimeStamp() != timeStamp.second)
+            return false;
+    }
+    return true;
+}
+
+// the same as PARTraversalFlowControlNode::ForwardProp() for the nodes that are out of date
+void ForwardPlanCache::Plan::Run() const
+{
+    for (const auto& step : steps)
+    {
+        if (step.fusedChain)
+            step.fusedChain->ForwardProp(step.node, step.fr);
+        else
+        {
+            step.node->BeginForwardProp();
+            step.node->ForwardProp(step.fr);
+            step.node->EndForwardProp();
+        }
+        step.node->BumpEvalTimeStamp();
+    }
+}
+
+/*static*/ bool ForwardPlanCache::Record(const std::vector<ComputationNodeBasePtr>& nodes, const ComputationEnvironment& environment, Plan& plan)
+{
+    if (environment.IsTraining() || environment.trackGapNans || environment.ShouldDumpNode() || environment.IsPreComputing())
+        return false;
+    plan.operationMode = environment.networkOperationMode;
+    plan.steps.clear();
+    plan.timeStamps.clear();
+
+    std::unordered_set<const ComputationNodeBase*> nodesThatRun;
+    std::unordered_set<const ComputationNodeBase*> watchedNodes;
+    for (const auto& node : nodes)
+    {
+        if (node->IsPartOfLoop() || node->GetOffloadActions())
+            return false;
+
+        // the same test as PARTraversalFlowControlNode::ForwardProp(), as of after its inputs have run
+        bool runs = node->IsOutOfDateWrtInputs();
+        for (const auto& input : node->GetInputs())
+            runs = runs || nodesThatRun.find(input.get()) != nodesThatRun.end();
+        if (!runs)
+        {
+            // stays up to date as long as its inputs do not change
+            for (const auto& input : node->GetInputs())
+            {
+                if (watchedNodes.insert(input.get()).second)
+                    plan.timeStamps.push_back(std::make_pair(input.get(), input->GetEvalTimeStamp()));
+            }
+            continue;
+        }
+        if (!node->CanReplayForwardProp())
+            return false;
+        nodesThatRun.insert(node.get());
+
+        FusedNodes* fusedChain = node->GetFusedChain().get();
+        plan.steps.push_back(Step{ node, fusedChain, fusedChain ? FrameRange(nullptr) : FrameRange(nullptr).WithLayout(node->GetMBLayout()) });
+    }
+    return true;
+}
+
+void ForwardPlanCache::ForwardProp(const std::vector<ComputationNodeBasePtr>& roots, const std::vector<ComputationNodeBasePtr>& nodes,
+                                   const ComputationEnvironment& environment, const std::function<void()>& forwardProp)
+{
+    std::vector<const ComputationNodeBase*> key;
+    for (const auto& root : roots)
+        key.push_back(root.get());
+    Plan& plan = m_plans[key];
+
+    if (plan.numRecordings >= s_numRecordings && plan.IsValid(environment))
+    {
+        plan.Run();
+        return;
+    }
+
+    // The first passes after a change also run nodes that stay up to date later, e.g. the ones that only depend on parameters.
+    if (!plan.IsValid(environment))
+        plan.numRecordings = 0;
+    if (Record(nodes, environment, plan))
+        plan.numRecordings++;
+    else
+        plan.numRecordings = 0;
+    forwardProp();
+}
+
+}}}
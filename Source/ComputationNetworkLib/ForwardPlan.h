@@ -0,0 +1,70 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ForwardPlan.h -- runs the forward pass of a network in inference mode from a precompiled list of steps
+//
+// For small models evaluated a sample at a time, ComputationNetwork::ForwardProp() spends more time deciding what to run than
+// running it: for every node it compares the time stamps of all inputs (IsOutOfDateWrtInputs()), constructs a FrameRange,
+// looks up fused chains, offloading and tracing, and goes through the stream schedule. With forwardPlans=true, the forward
+// passes of a set of roots in inference mode are recorded into a ForwardPlan: a flat array of the nodes that ran, each with
+// its FrameRange (or fused chain) resolved. Once s_numRecordings passes in a row were recorded, later passes run the plan.
+//
+// A plan runs the same nodes every time, while the regular forward pass only runs the nodes that are out of date. The two
+// agree as long as the nodes that did not run stay up to date, i.e. their inputs keep their time stamps. These time stamps
+// are part of the plan, and it is recorded again when one of them changed (e.g. a parameter was updated). A node that runs
+// although its inputs did not change computes the same value again; plans are not recorded if a node with host-side state
+// would run (ComputationNodeBase::CanReplayForwardProp()), nor for recurrent loops and node tracing.
+// The nodes still size their values from their MBLayout in BeginForwardProp(), so a plan does not depend on the layout of
+// the minibatch. Plans are dropped when the network is recompiled or its matrices are reallocated.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "ComputationEnvironment.h"
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ForwardPlanCache
+{
+public:
+    static const size_t s_numRecordings = 2;
+
+    // Runs 'forwardProp', the forward pass of 'roots', or the plan of it. 'nodes' are all nodes it visits, in evaluation order.
+    void ForwardProp(const std::vector<ComputationNodeBasePtr>& roots, const std::vector<ComputationNodeBasePtr>& nodes,
+                     const ComputationEnvironment& environment, const std::function<void()>& forwardProp);
+
+    void Clear() { m_plans.clear(); }
+
+private:
+    struct Step
+    {
+        ComputationNodeBasePtr node;
+        FusedNodes* fusedChain;
+        FrameRange fr;
+    };
+
+    struct Plan
+    {
+        NetworkOperationMode operationMode = NetworkOperationMode::inferring;
+        std::vector<Step> steps;
+        std::vector<std::pair<const ComputationNodeBase*, uint64_t>> timeStamps; // of the inputs of the nodes that do not run
+        size_t numRecordings = 0;
+
+        bool IsValid(const ComputationEnvironment& environment) const;
+        void Run() const;
+    };
+
+    // returns false if the forward pass cannot run from a plan
+    static bool Record(const std::vector<ComputationNodeBasePtr>& nodes, const ComputationEnvironment& environment, Plan& plan);
+
+    std::map<std::vector<const ComputationNodeBase*>, Plan> m_plans; // per set of roots
+};
+
+}}}
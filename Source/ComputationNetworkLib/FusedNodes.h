@@ -0,0 +1,47 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// FusedNodes.h -- a group of nodes that the network evaluates as one operation
+//
+// ComputationNetwork::CompileNetwork() may group nodes whose intermediate results only feed each other, e.g. chains of
+// elementwise operations (ElementwiseFusion.h), a batch normalization followed by a ReLU (BatchNormActivationFusion.h), or
+// products and elementwise operations evaluated on the frames without gaps (GapCompaction.h).
+// The last node of a group in evaluation order, its root, computes the root value from the group's leaves, the inputs
+// that are not part of it, and propagates the root gradient to the leaves. The PAR traversal hands every node of the group
+// to ForwardProp() resp. Backprop() of the group instead of evaluating it; the other nodes do not compute anything.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class FusedNodes
+{
+public:
+    virtual ~FusedNodes() {}
+
+    const ComputationNodeBasePtr& GetRoot() const { return m_nodes.back(); }
+    const std::vector<ComputationNodeBasePtr>& GetNodes() const { return m_nodes; }
+    const std::vector<ComputationNodeBasePtr>& GetLeaves() const { return m_leaves; }
+
+    // These replace BeginForwardProp()/ForwardProp()/EndForwardProp() resp. BeginBackprop()/Backprop()/EndBackprop() of each
+    // node of the group in a PAR traversal.
+    virtual void ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr) = 0;
+    virtual void Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr) = 0;
+
+    // whether the kernels that ForwardProp() issues can be recorded into a CUDA graph and replayed (see ForwardGraphCache.h)
+    virtual bool CanReplayForwardProp() const { return true; }
+
+protected:
+    FusedNodes(std::vector<ComputationNodeBasePtr>&& nodes) : m_nodes(std::move(nodes)) {}
+
+    std::vector<ComputationNodeBasePtr> m_nodes;  // in evaluation order; the root is last
+    std::vector<ComputationNodeBasePtr> m_leaves; // the distinct inputs of the group that are not part of it
+};
+
+}}}
@@ -0,0 +1,373 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GapCompaction.cpp -- evaluates runs of sequence-agnostic nodes on the valid frames of the minibatch only
+//
+
+#include "stdafx.h"
+#include "GapCompaction.h"
+#include "ElementwiseFusion.h"
+#include "LinearAlgebraNodes.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// 0: not a float or double node
+static int GetPrecision(const ComputationNodeBasePtr& node)
+{
+    if (node->Is<ComputationNode<float>>())
+        return 1;
+    if (node->Is<ComputationNode<double>>())
+        return 2;
+    return 0;
+}
+
+static size_t GetNumElements(const ComputationNodeBasePtr& node)
+{
+    return node->GetSampleLayout().GetNumElements();
+}
+
+static bool IsTimes(const ComputationNodeBasePtr& node)
+{
+    return node->OperationName() == OperationNameOf(TimesNode);
+}
+
+// whether 'node' can be part of a run with root 'root'; 'op' receives its operation if it is elementwise
+static bool IsCompactable(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& root, FusibleElementwiseOp& op)
+{
+    if (node->IsPartOfLoop() || node->GetFusedChain() || GetPrecision(node) == 0 || GetPrecision(node) != GetPrecision(root) ||
+        !node->HasMBLayout() || node->GetMBLayout() != root->GetMBLayout())
+        return false;
+    const auto& inputs = node->GetInputs();
+    for (const auto& input : inputs)
+    {
+        if (GetPrecision(input) != GetPrecision(node) || (input->HasMBLayout() && input->GetMBLayout() != node->GetMBLayout()))
+            return false;
+    }
+
+    // W * x as a product of matrices [out x in] * [in x frames]
+    if (IsTimes(node))
+    {
+        op = FusibleElementwiseOp();
+        return inputs.size() == 2 && !inputs[0]->HasMBLayout() && inputs[1]->HasMBLayout() &&
+               GetNumElements(inputs[0]) == GetNumElements(node) * GetNumElements(inputs[1]);
+    }
+
+    // elementwise on [elements x frames], inputs without MBLayout broadcast along the frames
+    if (!FusedElementwiseChain::IsFusible(node, op))
+        return false;
+    for (const auto& input : inputs)
+    {
+        if (input->GetSampleLayout() != node->GetSampleLayout() && (input->HasMBLayout() || GetNumElements(input) != 1))
+            return false;
+    }
+    return true;
+}
+
+/*static*/ std::vector<std::shared_ptr<CompactedRun>> CompactedRun::Find(const std::list<ComputationNodeBasePtr>& evalOrder, const std::vector<ComputationNodeBasePtr>& roots)
+{
+    std::map<ComputationNodeBasePtr, size_t> numConsumers; // counting each use
+    std::map<ComputationNodeBasePtr, size_t> positions;
+    for (const auto& node : evalOrder)
+    {
+        positions[node] = positions.size();
+        for (const auto& input : node->GetInputs())
+            numConsumers[input]++;
+    }
+    std::set<ComputationNodeBasePtr> rootSet(roots.begin(), roots.end());
+    std::set<ComputationNodeBasePtr> taken;
+
+    std::vector<std::shared_ptr<CompactedRun>> runs;
+    for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); iter++) // consumers first, so that runs grow towards the inputs
+    {
+        const auto& root = *iter;
+        FusibleElementwiseOp rootOp;
+        if (taken.find(root) != taken.end() || !IsCompactable(root, root, rootOp))
+            continue;
+
+        // grow breadth-first through the inputs
+        std::vector<ComputationNodeBasePtr> members = { root };
+        std::map<ComputationNodeBasePtr, FusibleElementwiseOp> ops = { { root, rootOp } };
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            for (const auto& input : members[i]->GetInputs())
+            {
+                FusibleElementwiseOp op;
+                if (ops.find(input) != ops.end() || taken.find(input) != taken.end() || rootSet.find(input) != rootSet.end() ||
+                    numConsumers[input] != 1 || !IsCompactable(input, root, op))
+                    continue;
+                members.push_back(input);
+                ops[input] = op;
+            }
+        }
+        if (std::none_of(members.begin(), members.end(), IsTimes))
+            continue;
+
+        std::sort(members.begin(), members.end(), [&](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b) { return positions[a] < positions[b]; });
+        std::vector<FusibleElementwiseOp> memberOps;
+        for (const auto& member : members)
+        {
+            memberOps.push_back(ops[member]);
+            taken.insert(member);
+        }
+        runs.push_back(std::shared_ptr<CompactedRun>(new CompactedRun(std::move(members), std::move(memberOps))));
+    }
+    return runs;
+}
+
+CompactedRun::CompactedRun(std::vector<ComputationNodeBasePtr>&& nodes, std::vector<FusibleElementwiseOp>&& ops)
+    : FusedNodes(std::move(nodes)), m_ops(std::move(ops)), m_numValidColumns(0)
+{
+    for (const auto& node : m_nodes)
+    {
+        for (const auto& input : node->GetInputs())
+        {
+            if (std::find(m_nodes.begin(), m_nodes.end(), input) == m_nodes.end() && std::find(m_leaves.begin(), m_leaves.end(), input) == m_leaves.end())
+                m_leaves.push_back(input);
+        }
+    }
+    m_values.resize(m_nodes.size() + m_leaves.size());
+    m_gradients.resize(m_nodes.size() + m_leaves.size());
+}
+
+size_t CompactedRun::IndexOf(const ComputationNodeBasePtr& node) const
+{
+    auto member = std::find(m_nodes.begin(), m_nodes.end(), node);
+    if (member != m_nodes.end())
+        return member - m_nodes.begin();
+    return m_nodes.size() + (std::find(m_leaves.begin(), m_leaves.end(), node) - m_leaves.begin());
+}
+
+bool CompactedRun::CanRunCompacted() const
+{
+    const auto& root = GetRoot();
+    const auto& layout = root->GetMBLayout();
+    if (!layout->HasGaps() || layout->GetActualNumSamples() == 0)
+        return false;
+    if (root->HasEnvironmentPtr() && root->Environment().trackGapNans)
+        return false;
+    for (const auto& leaf : m_leaves)
+    {
+        if (leaf->ValuePtr()->GetMatrixType() == SPARSE)
+            return false;
+    }
+    return true;
+}
+
+void CompactedRun::ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    bool isRoot = node == GetRoot();
+    if (!CanRunCompacted())
+    {
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
+    }
+    else if (!isRoot)
+        node->BeginForwardProp(); // only to resize the value, which BeginBackprop() of its consumer verifies
+    else
+    {
+        node->BeginForwardProp();
+        if (GetPrecision(node) == 1)
+            ForwardPropCompacted<float>();
+        else
+            ForwardPropCompacted<double>();
+        node->EndForwardProp();
+    }
+}
+
+void CompactedRun::Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    if (!CanRunCompacted())
+    {
+        node->BeginBackprop();
+        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        node->EndBackprop();
+    }
+    else if (node == GetRoot())
+    {
+        node->BeginBackprop();
+        if (GetPrecision(node) == 1)
+            BackpropCompacted<float>();
+        else
+            BackpropCompacted<double>();
+        node->EndBackprop();
+    }
+}
+
+template <class ElemType>
+static Matrix<ElemType>& Buffer(MatrixBasePtr& buffer, DEVICEID_TYPE deviceId)
+{
+    if (!buffer)
+        buffer = std::make_shared<Matrix<ElemType>>(deviceId);
+    return static_cast<Matrix<ElemType>&>(*buffer);
+}
+
+// the indices of the columns of the root's MBLayout that are not gaps, in ascending order
+template <class ElemType>
+void CompactedRun::DetermineValidColumns()
+{
+    const auto& layout = GetRoot()->GetMBLayout();
+    std::vector<ElemType> columns;
+    columns.reserve(layout->GetActualNumSamples());
+    for (const auto& sequence : layout->GetAllSequences())
+    {
+        if (sequence.seqId == GAP_SEQUENCE_ID)
+            continue;
+        for (size_t column : layout->GetColumnIndices(sequence))
+            columns.push_back((ElemType)column);
+    }
+    std::sort(columns.begin(), columns.end());
+    m_numValidColumns = columns.size();
+    Buffer<ElemType>(m_validColumns, GetRoot()->GetDeviceId()).SetValue(1, columns.size(), GetRoot()->GetDeviceId(), columns.data());
+}
+
+template <class ElemType>
+void CompactedRun::ForwardPropCompacted()
+{
+    DetermineValidColumns<ElemType>();
+    const auto& validColumns = static_cast<Matrix<ElemType>&>(*m_validColumns);
+    DEVICEID_TYPE deviceId = GetRoot()->GetDeviceId();
+    size_t numNodes = m_nodes.size();
+
+    // the valid columns of the value of 'node', a member or a leaf; leaves without MBLayout as they are
+    auto valueOf = [&](const ComputationNodeBasePtr& node)
+    {
+        if (!node->HasMBLayout())
+            return TensorView<ElemType>(node->ValuePtr(), TensorShape(GetNumElements(node), 1));
+        return TensorView<ElemType>(m_values[IndexOf(node)], TensorShape(GetNumElements(node), m_numValidColumns));
+    };
+
+    for (size_t i = 0; i < m_leaves.size(); i++)
+    {
+        if (m_leaves[i]->HasMBLayout())
+            Buffer<ElemType>(m_values[numNodes + i], deviceId).DoGatherColumnsOf(0, validColumns, m_leaves[i]->As<ComputationNode<ElemType>>()->Value(), 1);
+    }
+
+    for (size_t k = 0; k < numNodes; k++)
+    {
+        const auto& node = m_nodes[k];
+        const auto& inputs = node->GetInputs();
+        Buffer<ElemType>(m_values[k], deviceId).Resize(GetNumElements(node), m_numValidColumns);
+        auto value = valueOf(node);
+        if (IsTimes(node))
+        {
+            TensorView<ElemType> weights(inputs[0]->ValuePtr(), TensorShape(GetNumElements(node), GetNumElements(inputs[1])));
+            value.AssignMatrixProductOf(false, weights, false, valueOf(inputs[1]), false);
+        }
+        else if (inputs.size() == 1)
+            value.DoUnaryOpOf(0, valueOf(inputs[0]), 1, m_ops[k].m_op, opSum);
+        else
+            value.DoBinaryOpOf(0, valueOf(inputs[0]), valueOf(inputs[1]), 1, m_ops[k].m_op, opSum);
+    }
+
+    // the gaps of the root are zero
+    auto root = GetRoot()->As<ComputationNode<ElemType>>();
+    root->Value().DoScatterColumnsOf(0, validColumns, static_cast<Matrix<ElemType>&>(*m_values[numNodes - 1]), 1);
+}
+
+template <class ElemType>
+void CompactedRun::BackpropCompacted()
+{
+    auto root = GetRoot()->As<ComputationNode<ElemType>>();
+    if (!root->NeedsGradient())
+        return;
+    root->LazyZeroGradient(); // as in ComputationNode::Backprop(), for roots that received no gradient
+
+    const auto& validColumns = static_cast<Matrix<ElemType>&>(*m_validColumns);
+    DEVICEID_TYPE deviceId = root->GetDeviceId();
+    size_t numNodes = m_nodes.size();
+
+    auto valueOf = [&](const ComputationNodeBasePtr& node)
+    {
+        if (!node->HasMBLayout())
+            return TensorView<ElemType>(node->ValuePtr(), TensorShape(GetNumElements(node), 1));
+        return TensorView<ElemType>(m_values[IndexOf(node)], TensorShape(GetNumElements(node), m_numValidColumns));
+    };
+
+    // The gradients of members and of leaves with MBLayout are summed up on the valid columns, those of leaves without
+    // MBLayout directly in their gradient. 'beta' is 0 for the first contribution unless the leaf's gradient is shared.
+    std::vector<bool> hasGradient(numNodes + m_leaves.size(), false);
+    auto gradientOf = [&](const ComputationNodeBasePtr& node, ElemType& beta)
+    {
+        size_t index = IndexOf(node);
+        beta = hasGradient[index] ? 1 : 0;
+        if (!hasGradient[index] && !node->HasMBLayout())
+        {
+            node->As<ComputationNode<ElemType>>()->LazyZeroGradient();
+            beta = node->ParentOverwritesGradient() ? 0 : 1;
+        }
+        else if (!hasGradient[index])
+            Buffer<ElemType>(m_gradients[index], deviceId).Resize(GetNumElements(node), m_numValidColumns);
+        hasGradient[index] = true;
+        if (!node->HasMBLayout())
+            return TensorView<ElemType>(node->As<ComputationNode<ElemType>>()->GradientPtr(), TensorShape(GetNumElements(node), 1));
+        return TensorView<ElemType>(m_gradients[index], TensorShape(GetNumElements(node), m_numValidColumns));
+    };
+
+    Buffer<ElemType>(m_gradients[numNodes - 1], deviceId).DoGatherColumnsOf(0, validColumns, root->Gradient(), 1);
+    hasGradient[numNodes - 1] = true;
+
+    for (size_t k = numNodes; k-- > 0;)
+    {
+        const auto& node = m_nodes[k];
+        if (!hasGradient[k])
+            continue;
+        const auto& inputs = node->GetInputs();
+        TensorView<ElemType> gradient(m_gradients[k], TensorShape(GetNumElements(node), m_numValidColumns));
+        ElemType beta;
+        const auto& op = m_ops[k];
+        if (IsTimes(node))
+        {
+            TensorShape weightsShape(GetNumElements(node), GetNumElements(inputs[1]));
+            if (inputs[0]->NeedsGradient())
+            {
+                auto weightsGradient = TensorView<ElemType>(gradientOf(inputs[0], beta), weightsShape);
+                weightsGradient.DoMatrixProductOf(beta, false, gradient, false, valueOf(inputs[1]), true, 1);
+            }
+            if (inputs[1]->NeedsGradient())
+            {
+                auto inputGradient = gradientOf(inputs[1], beta);
+                inputGradient.DoMatrixProductOf(beta, false, TensorView<ElemType>(inputs[0]->ValuePtr(), weightsShape), true, gradient, false, 1);
+            }
+        }
+        else if (inputs.size() == 1)
+        {
+            if (!inputs[0]->NeedsGradient())
+                continue;
+            auto inputGradient = gradientOf(inputs[0], beta);
+            if (op.m_gradientArg == FusibleElementwiseOp::noArg)
+                inputGradient.DoUnaryOpOf(beta, gradient, 1, op.m_gradientOp, opSum);
+            else
+                inputGradient.DoBinaryOpOf(beta, gradient, valueOf(op.m_gradientArg == FusibleElementwiseOp::inputValueArg ? inputs[0] : node), 1, op.m_gradientOp, opSum);
+        }
+        else
+        {
+            for (size_t j = 0; j < 2; j++)
+            {
+                if (!inputs[j]->NeedsGradient())
+                    continue;
+                auto inputGradient = gradientOf(inputs[j], beta);
+                if (op.m_op == opElementwiseProduct)
+                    inputGradient.DoBinaryOpOf(beta, gradient, valueOf(inputs[1 - j]), 1, opElementwiseProduct, opSum);
+                else
+                    inputGradient.DoUnaryOpOf(beta, gradient, 1, op.m_op == opDifference && j == 1 ? opNegate : opCopy, opSum);
+            }
+        }
+    }
+
+    // scatter the gradients of the leaves with MBLayout; their gaps receive none
+    for (size_t i = 0; i < m_leaves.size(); i++)
+    {
+        auto leaf = m_leaves[i]->As<ComputationNode<ElemType>>();
+        if (!leaf->HasMBLayout() || !hasGradient[numNodes + i])
+            continue;
+        leaf->LazyZeroGradient();
+        leaf->Gradient().DoScatterColumnsOf(leaf->ParentOverwritesGradient() ? 0 : 1, validColumns, static_cast<Matrix<ElemType>&>(*m_gradients[numNodes + i]), 1);
+    }
+}
+
+}}}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GapCompaction.h -- evaluates runs of sequence-agnostic nodes on the valid frames of the minibatch only
+//
+// Minibatches of sequences of different lengths have gaps in their MBLayout, which can be a large part of the columns.
+// Products and elementwise operations do not depend on the sequence structure, yet node by node they are computed for all
+// columns, and the gaps are masked to zero afterwards. With compactGapFrames=true, ComputationNetwork::CompileNetwork()
+// groups runs such as Tanh(Times(W2, ReLU(Plus(Times(W1, x), b)))) into CompactedRuns. The root of a run gathers the valid
+// columns of the run's leaves into dense matrices (as GatherPackedNode does), evaluates the nodes of the run on these, and
+// scatters the result into its value (as ScatterPackedNode does), with zeros in the gaps. The backward pass gathers the
+// root gradient, propagates it through the run on the valid columns, and scatters it into the gradients of the leaves.
+// Compute thus scales with the number of samples rather than with the number of columns of the minibatch.
+//
+// A node of a run must
+//  - be a TimesNode W * x, where W has no MBLayout and the product is a plain matrix product of the flattened sample
+//    shapes, or an elementwise node that FusedElementwiseChain can fuse, whose inputs with an MBLayout have its sample
+//    layout and whose other inputs are of its sample layout or scalars,
+//  - have the MBLayout and precision of the root and not participate in a recurrent loop,
+//  - have a single consumer, and not be a root of the network, unless it is the root of the run.
+// A run contains at least one TimesNode, where compaction pays off. Minibatches without gaps, runs with a sparse leaf, and
+// environments that track NaNs in gaps run node by node as before.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "FusedNodes.h"
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class CompactedRun : public FusedNodes
+{
+public:
+    // finds the runs in 'evalOrder', the global evaluation order; nodes in 'roots' can only be roots of runs
+    static std::vector<std::shared_ptr<CompactedRun>> Find(const std::list<ComputationNodeBasePtr>& evalOrder, const std::vector<ComputationNodeBasePtr>& roots);
+
+    // The root does the work for all; the other nodes only prepare their value matrix.
+    void ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr) override;
+    void Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr) override;
+
+    // The indices of the valid frames are uploaded for each minibatch.
+    bool CanReplayForwardProp() const override { return false; }
+
+private:
+    CompactedRun(std::vector<ComputationNodeBasePtr>&& nodes, std::vector<FusibleElementwiseOp>&& ops);
+
+    bool CanRunCompacted() const;
+    size_t IndexOf(const ComputationNodeBasePtr& node) const; // into m_nodes, or m_nodes.size() + index into m_leaves
+
+    template <class ElemType> void DetermineValidColumns();
+    template <class ElemType> void ForwardPropCompacted();
+    template <class ElemType> void BackpropCompacted();
+
+    std::vector<FusibleElementwiseOp> m_ops; // the operation of each node in m_nodes; opNone for TimesNodes
+    MatrixBasePtr m_validColumns;            // row vector of the indices of the columns that are not gaps
+    size_t m_numValidColumns;
+    std::vector<MatrixBasePtr> m_values;     // the valid columns of the value of each node in m_nodes, then of each leaf
+    std::vector<MatrixBasePtr> m_gradients;  // same for the gradients
+};
+
+}}}
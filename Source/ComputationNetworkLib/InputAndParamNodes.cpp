@@ -8,6 +8,8 @@
 #include "File.h"        // for LoadMatrixFromTextFile()
 #include "TensorShape.h" // for SmallVector<>
 #include "Globals.h"     // for ShouldForceConstantRandomSeed()
+#include "Float16.h"
+#include "Quantizers.h"
 
 #include <string>
 
@@ -407,15 +409,128 @@ void LearnableParameter<ElemType>::ReviseFromFile(const wstring& reviseFromFileP
     }
 }
 
+ParameterValueFormat ParseParameterValueFormat(const wstring& name)
+{
+    if (name == L"full")
+        return ParameterValueFormat::full;
+    else if (name == L"float16")
+        return ParameterValueFormat::float16;
+    else if (name == L"int8")
+        return ParameterValueFormat::int8;
+    InvalidArgument("Unknown parameter value format '%ls'; must be 'full', 'float16', or 'int8'.", name.c_str());
+}
+
+// A compressed value is stored as its dimensions, followed by
+//  - float16: the elements as IEEE half precision bits, column-major
+//  - int8: a float scale per row, and the elements as 8-bit integers, column-major; element (i,j) is q(i,j) * scale(i).
+// Each row is quantized with its own SymmetricQuantizer, so that a row (output channel) of small weights keeps its precision.
+template <class ElemType>
+static void SaveCompressedValue(File& fstream, const Matrix<ElemType>& value, ParameterValueFormat valueFormat)
+{
+    const size_t rows = value.GetNumRows();
+    const size_t cols = value.GetNumCols();
+    vector<ElemType> elements(rows * cols);
+    if (!elements.empty())
+        value.CopySection(rows, cols, elements.data(), rows);
+
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCompressedValue");
+    fstream << rows << cols;
+    if (valueFormat == ParameterValueFormat::float16)
+    {
+        vector<uint16_t> halves(elements.size());
+        for (size_t i = 0; i < elements.size(); i++)
+            halves[i] = FloatToFloat16Bits((float)elements[i]);
+        fstream.WriteArray(halves.data(), halves.size());
+    }
+    else if (valueFormat == ParameterValueFormat::int8)
+    {
+        vector<float> scales(rows);
+        vector<signed char> quantized(elements.size());
+        vector<ElemType> row(cols);
+        vector<signed char> quantizedRow(cols);
+        SymmetricQuantizer<ElemType, signed char> quantizer(0);
+        for (size_t i = 0; i < rows; i++)
+        {
+            for (size_t j = 0; j < cols; j++)
+                row[j] = elements[j * rows + i];
+            ArrayRef<ElemType> input(row.data(), cols);
+            ArrayRef<signed char> output(quantizedRow.data(), cols);
+            quantizer.Quantize(input, output);
+            scales[i] = (float)quantizer.InverseQuantizeFactor();
+            for (size_t j = 0; j < cols; j++)
+                quantized[j * rows + i] = quantizedRow[j];
+        }
+        fstream.WriteArray(scales.data(), scales.size());
+        fstream.WriteArray(quantized.data(), quantized.size());
+    }
+    else
+        LogicError("SaveCompressedValue: Unexpected parameter value format %d.", (int)valueFormat);
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECompressedValue");
+}
+
+template <class ElemType>
+static void LoadCompressedValue(File& fstream, Matrix<ElemType>& value, ParameterValueFormat valueFormat, DEVICEID_TYPE deviceId)
+{
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCompressedValue");
+    size_t rows, cols;
+    fstream >> rows >> cols;
+    vector<ElemType> elements(rows * cols);
+    if (valueFormat == ParameterValueFormat::float16)
+    {
+        vector<uint16_t> halves(elements.size());
+        fstream.ReadArray(halves.data(), halves.size());
+        for (size_t i = 0; i < elements.size(); i++)
+            elements[i] = (ElemType)Float16BitsToFloat(halves[i]);
+    }
+    else if (valueFormat == ParameterValueFormat::int8)
+    {
+        vector<float> scales(rows);
+        vector<signed char> quantized(elements.size());
+        fstream.ReadArray(scales.data(), scales.size());
+        fstream.ReadArray(quantized.data(), quantized.size());
+        for (size_t j = 0; j < cols; j++)
+            for (size_t i = 0; i < rows; i++)
+                elements[j * rows + i] = (ElemType)(quantized[j * rows + i] * scales[i]);
+    }
+    else
+        RuntimeError("LoadCompressedValue: Unknown parameter value format %d in the model file.", (int)valueFormat);
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECompressedValue");
+    value.SetValue(rows, cols, deviceId, elements.data(), matrixFlagNormal);
+}
+
 template <class ElemType>
 void LearnableParameter<ElemType>::Save(File& fstream) const /*override*/
+{
+    SaveWithValue(fstream, Value());
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::SaveWithValue(File& fstream, const MatrixBase& value) const /*override*/
+{
+    SaveWithValue(fstream, value, ParameterValueFormat::full);
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::SaveWithValue(File& fstream, const MatrixBase& value, ParameterValueFormat valueFormat) const
 {
     if (!m_initString.empty())
         LogicError("LearnableParameter: Cannot Save() before deferred initialization has completed.");
+    if (!m_deferredValueFile.empty())
+        LogicError("LearnableParameter: Cannot Save() before the value has been loaded from the model file.");
     Base::Save(fstream);
     fstream << m_learningRateMultiplier;
     m_sampleLayout.Save(fstream);
-    fstream << Value();
+
+    const auto& matrix = dynamic_cast<const Matrix<ElemType>&>(value);
+    if (fstream.IsTextBased() || matrix.GetMatrixType() != DENSE)
+        valueFormat = ParameterValueFormat::full;
+    else if (valueFormat == ParameterValueFormat::int8 && (matrix.GetNumRows() <= 1 || matrix.GetNumCols() <= 1))
+        valueFormat = ParameterValueFormat::float16; // a scale per element would take more space than float16
+    fstream << (int)valueFormat;
+    if (valueFormat == ParameterValueFormat::full)
+        fstream << matrix;
+    else
+        SaveCompressedValue(fstream, matrix, valueFormat);
 }
 
 template <class ElemType>
@@ -448,13 +563,55 @@ void LearnableParameter<ElemType>::Load(File& fstream, size_t modelVersion) /*ov
         }
     }
 
-    LoadValue(fstream);
-    SetDims(sampleLayout, false); // note: call this after LoadValue() since LoadValue() overwrites m_sampleLayout
-    VerifyDataSize(Value());      // sanity check
+    ParameterValueFormat valueFormat = ParameterValueFormat::full;
+    if (modelVersion >= CNTK_MODEL_VERSION_25)
+    {
+        int format;
+        fstream >> format;
+        valueFormat = (ParameterValueFormat)format;
+    }
+
+    // With lazy loading, only the dimensions are read; the elements stay in the file until LoadDeferredValue().
+    // Compressed values are always converted when loading.
+    m_deferredValueFile.clear();
+    if (valueFormat == ParameterValueFormat::full &&
+        Globals::ShouldLoadParametersLazily() && !fstream.IsTextBased() && fstream.CanSeek() &&
+        Matrix<ElemType>::ReadDenseHeader(fstream, m_deferredValueRows, m_deferredValueCols, m_deferredValuePosition))
+    {
+        CreateMatrixIfNull(m_value);
+        m_deferredValueFile = fstream.GetFileName();
+        SetDims(sampleLayout, false);
+    }
+    else if (valueFormat != ParameterValueFormat::full)
+    {
+        CreateMatrixIfNull(m_value);
+        LoadCompressedValue(fstream, Value(), valueFormat, m_deviceId);
+        SetDims(sampleLayout, false);
+        VerifyDataSize(Value());
+    }
+    else
+    {
+        LoadValue(fstream);
+        SetDims(sampleLayout, false); // note: call this after LoadValue() since LoadValue() overwrites m_sampleLayout
+        VerifyDataSize(Value());      // sanity check
+    }
 
     m_initString.clear(); // deferred initialization not possible after loading
 }
 
+template <class ElemType>
+/*virtual*/ void LearnableParameter<ElemType>::LoadDeferredValue(const char* fileData) /*override*/
+{
+    if (m_deferredValueFile.empty())
+        LogicError("LoadDeferredValue: %ls has no value in a model file.", NodeDescription().c_str());
+
+    // a single copy from the mapping (on a GPU, one host-to-device transfer); the elements need not be aligned
+    auto elements = reinterpret_cast<ElemType*>(const_cast<char*>(fileData + m_deferredValuePosition));
+    Value().SetValue(m_deferredValueRows, m_deferredValueCols, m_deviceId, elements, matrixFlagNormal);
+    VerifyDataSize(Value());
+    m_deferredValueFile.clear();
+}
+
 template <class ElemType>
 /*virtual*/ void LearnableParameter<ElemType>::CopyTo(ComputationNodeBasePtr nodeP, const wstring& newName, const CopyNodeFlags flags) const /*override*/
 {
@@ -469,6 +626,10 @@ template <class ElemType>
         node->m_initOutputRank = m_initOutputRank;
         node->m_initOnCPUOnly  = m_initOnCPUOnly;
         node->m_initValue      = m_initValue;
+        node->m_deferredValueFile     = m_deferredValueFile;
+        node->m_deferredValuePosition = m_deferredValuePosition;
+        node->m_deferredValueRows     = m_deferredValueRows;
+        node->m_deferredValueCols     = m_deferredValueCols;
     }
 }
 
@@ -640,4 +801,86 @@ template <class ElemType>
 template class LearnableParameter<float>;
 template class LearnableParameter<double>;
 
+// -----------------------------------------------------------------------
+// EmbeddingLookupNode (embedding matrix, indices)
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+/*virtual*/ void EmbeddingLookupNode<ElemType>::ForwardPropNonLooping() /*override*/
+{
+    if (InputRef(1).Value().GetMatrixType() == SPARSE)
+        InvalidArgument("%ls expects word indices as its second input. One-hot inputs are embedded with Times().", NodeDescription().c_str());
+    InputRef(1).MaskMissingValueColumnsTo(FrameRange(InputRef(1).GetMBLayout()), -1); // indicates an invalid column to Gather
+
+    const auto& embeddings = InputRef(0).ValueAsMatrix();
+    const auto& indices = InputRef(1).Value();
+    const size_t numWords = indices.GetNumElements();
+    auto output = Value().Reshaped(embeddings.GetNumRows(), numWords);
+    output.DoGatherColumnsOf(/*beta=*/0, indices.Reshaped(1, numWords), embeddings, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void EmbeddingLookupNode<ElemType>::BackpropToNonLooping(size_t inputIndex) /*override*/
+{
+    if (inputIndex != 0)
+        return;
+
+    // the selection matrix: column j is the one-hot vector of word j, or empty for a gap
+    const size_t numClasses = InputRef(0).GetAsMatrixNumCols();
+    const auto& indices = InputRef(1).Value();
+    const size_t numWords = indices.GetNumElements();
+    std::unique_ptr<ElemType[]> wordIndices(indices.CopyToArray());
+    std::vector<CPUSPARSE_INDEX_TYPE> selectionColumns(numWords + 1);
+    std::vector<CPUSPARSE_INDEX_TYPE> selectionRows;
+    selectionRows.reserve(numWords);
+    for (size_t j = 0; j < numWords; j++)
+    {
+        selectionColumns[j] = (CPUSPARSE_INDEX_TYPE) selectionRows.size();
+        const ElemType index = wordIndices[j];
+        if (std::isnan(index) || index < 0)
+            continue;
+        if ((size_t) index >= numClasses)
+            InvalidArgument("%ls: Word index %d is out of range of the %d columns of the embedding matrix.", NodeDescription().c_str(), (int) index, (int) numClasses);
+        selectionRows.push_back((CPUSPARSE_INDEX_TYPE) index);
+    }
+    selectionColumns[numWords] = (CPUSPARSE_INDEX_TYPE) selectionRows.size();
+    std::vector<ElemType> selectionValues(selectionRows.size(), 1);
+    m_selection->SetMatrixFromCSCFormat(selectionColumns.data(), selectionRows.data(), selectionValues.data(), selectionRows.size(), numClasses, numWords);
+
+    // Like the gradient of an embedding with sparse input, dense * sparse' gives a sparse block-column gradient (see TimesNode).
+    if (InputRef(0).GetPreferredGradientMatrixType() == UNDETERMINED && InputRef(0).Gradient().GetMatrixType() == DENSE)
+    {
+        auto& currentGradient = InputRef(0).Gradient();
+        InputRef(0).GradientPtrRef() = std::make_shared<Matrix<ElemType>>(currentGradient.GetNumRows(), currentGradient.GetNumCols(),
+                                                                          currentGradient.GetPreferredDeviceId(), SPARSE, MatrixFormat::matrixFormatSparseBlockCol);
+        InputRef(0).SetPreferredGradientMatrixType(SPARSE);
+    }
+
+    const auto outputGradient = Gradient().Reshaped(InputRef(0).GetAsMatrixNumRows(), numWords);
+    auto& embeddingsGradient = InputRef(0).GradientAsMatrix();
+    Matrix<ElemType>::MultiplyAndAdd(outputGradient, false, *m_selection, true, embeddingsGradient);
+}
+
+template <class ElemType>
+/*virtual*/ void EmbeddingLookupNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+    if (isFinalValidationPass && !HasMBLayout())
+        InvalidArgument("%ls operation can only operate on minibatches.", NodeDescription().c_str());
+    if (isFinalValidationPass && Input(0)->HasMBLayout())
+        InvalidArgument("%ls expects the embedding matrix as its first input, which must not have a dynamic axis.", NodeDescription().c_str());
+
+    // output sample: [D], or [D x k] for k indices per sample
+    SmallVector<size_t> dims(1, Input(0)->GetAsMatrixNumRows());
+    const auto& indexLayout = Input(1)->GetSampleLayout();
+    if (indexLayout.GetNumElements() > 1)
+        dims.append(indexLayout.GetDims().begin(), indexLayout.GetDims().end());
+    SetDims(TensorShape(dims), true);
+}
+
+template class EmbeddingLookupNode<float>;
+template class EmbeddingLookupNode<double>;
+
 }}}
@@ -33,7 +33,7 @@ static const wchar_t* BilinearInitializerTypeName =         L"bilinear";
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class LearnableParameter : public ComputationNode<ElemType>, public NumInputs<0>, public IFreezable, public TransformerNode
+class LearnableParameter : public ComputationNode<ElemType>, public NumInputs<0>, public IFreezable, public IDeferredValueNode, public TransformerNode
 {
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
     static const std::wstring TypeName() { return L"LearnableParameter"; }
@@ -49,6 +49,9 @@ public:
         MarkValueNonSharable();
         m_initString = L"fromValue"; // default init is with 0; typically overwritten
         m_initValue = 0;
+        m_deferredValuePosition = 0;
+        m_deferredValueRows = 0;
+        m_deferredValueCols = 0;
         m_regMultiplier = 1.0f; // enable reg in update by default
     }
     LearnableParameter(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& shape) :
@@ -125,6 +128,11 @@ public:
     virtual void Save(File& fstream) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
 
+    virtual bool SavesValue() const override { return true; }
+    virtual void SaveWithValue(File& fstream, const MatrixBase& value) const override;
+    // saves the value in the given format; values that cannot be compressed (sparse, or in a text file) are saved in full
+    void SaveWithValue(File& fstream, const MatrixBase& value, ParameterValueFormat valueFormat) const;
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
 
     // computation functions don't do anything for parameter nodes
@@ -145,6 +153,11 @@ public:
     // called from CloneFunction(..., parameters="constant")
     virtual void FreezeParameters() override; // from IFreezable
 
+    virtual const std::wstring& /*IDeferredValueNode::*/ DeferredValueFile() const override { return m_deferredValueFile; }
+    virtual void /*IDeferredValueNode::*/ LoadDeferredValue(const char* fileData) override;
+    virtual uint64_t /*IDeferredValueNode::*/ DeferredValuePosition() const override { return m_deferredValuePosition; }
+    virtual size_t /*IDeferredValueNode::*/ DeferredValueBytes() const override { return m_deferredValueRows * m_deferredValueCols * sizeof(ElemType); }
+
     // Setting the reg multiplier for a learnable node, effecting L1Reg and L2Reg both.
     void SetRegMultiplier(float regMultiplier)
     {
@@ -174,6 +187,12 @@ private:
     bool m_initOnCPUOnly;
     ElemType m_initValue;
 
+    // value left in the model file by Load() (lazyParameterLoading); the file is empty once it is loaded
+    std::wstring m_deferredValueFile;
+    uint64_t m_deferredValuePosition; // of the elements in the file
+    size_t m_deferredValueRows;
+    size_t m_deferredValueCols;
+
     // flags related to gradient update
     float m_regMultiplier; // The multiplier to adjust the L1Reg and L2Reg for Learnable node
 };
@@ -730,4 +749,40 @@ public:
 template class LookupTableNode<float>;
 template class LookupTableNode<double>;
 
+// -----------------------------------------------------------------------
+// EmbeddingLookupNode (embedding matrix, indices)
+// Implements an embedding by index: each sample of the second input holds k word indices, and the output sample is
+// the k columns of the [D x V] embedding matrix they select, i.e. a [D] vector, or [D x k] for k > 1.
+// The forward pass gathers columns, without the product with a one-hot input that LookupTableNode computes, and
+// the backward pass adds the output gradient into the columns of the selected words only: it is a product with
+// the transposed one-hot selection matrix, which (as for TimesNode with a sparse input) produces a sparse
+// block-column gradient that holds only these columns. Learners and the distributed gradient aggregation handle
+// it as they do the gradient of an embedding with sparse input. Negative indices and gaps select nothing.
+// The indices are not differentiable.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class EmbeddingLookupNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"EmbeddingLookup"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(EmbeddingLookupNode);
+    EmbeddingLookupNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name),
+          m_selection(make_shared<Matrix<ElemType>>(0, 0, deviceId, SPARSE, matrixFormatSparseCSC))
+    {
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 1; }
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
+
+private:
+    shared_ptr<Matrix<ElemType>> m_selection; // [V x (k * columns)] one-hot columns of the selected words, for the backward pass
+};
+
 }}}
@@ -127,4 +127,315 @@ void EpochAccumulatorNode<ElemType>::Reset()
 }
 
 template class EpochAccumulatorNode<float>;
-template class EpochAccumulatorNode<double>;
\ No newline at end of file
+template class EpochAccumulatorNode<double>;
+// -----------------------------------------------------------------------
+// ScaledDotProductAttentionNode
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+ElemType ScaledDotProductAttentionNode<ElemType>::EffectiveScale() const
+{
+    return (ElemType)(m_scale != 0 ? m_scale : 1 / sqrt((double)InputRef(1).GetSampleMatrixNumRows()));
+}
+
+// pairs the k-th query sequence with the k-th key sequence, in the order of their sequence ids, and uploads the
+// columns of their valid frames
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::DetermineSequencePairs()
+{
+    auto sequencesOf = [](const MBLayoutPtr& pMBLayout)
+    {
+        std::vector<MBLayout::SequenceInfo> sequences;
+        for (const auto& sequence : pMBLayout->GetAllSequences())
+        {
+            if (sequence.seqId != GAP_SEQUENCE_ID)
+                sequences.push_back(sequence);
+        }
+        std::stable_sort(sequences.begin(), sequences.end(), [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b) { return a.seqId < b.seqId; });
+        return sequences;
+    };
+
+    const auto& queryLayout = InputRef(0).GetMBLayout();
+    const auto& keyLayout = InputRef(1).GetMBLayout();
+    auto querySequences = sequencesOf(queryLayout);
+    auto keySequences = sequencesOf(keyLayout);
+    if (querySequences.size() != keySequences.size())
+        InvalidArgument("%ls %ls operation: The query has %d sequences, but the keys have %d.",
+                        NodeName().c_str(), OperationName().c_str(), (int)querySequences.size(), (int)keySequences.size());
+
+    std::vector<ElemType> queryColumns, keyColumns;
+    queryColumns.reserve(queryLayout->GetActualNumSamples());
+    keyColumns.reserve(keyLayout->GetActualNumSamples());
+    m_sequencePairs.clear();
+    for (size_t k = 0; k < querySequences.size(); k++)
+    {
+        SequencePair pair;
+        pair.queryBegin = queryColumns.size();
+        for (size_t column : queryLayout->GetColumnIndices(querySequences[k]))
+            queryColumns.push_back((ElemType)column);
+        pair.queryEnd = queryColumns.size();
+        pair.keyBegin = keyColumns.size();
+        for (size_t column : keyLayout->GetColumnIndices(keySequences[k]))
+            keyColumns.push_back((ElemType)column);
+        pair.keyEnd = keyColumns.size();
+        m_sequencePairs.push_back(pair);
+    }
+
+    m_queryColumns->SetValue(1, queryColumns.size(), m_deviceId, queryColumns.data());
+    m_keyColumns->SetValue(1, keyColumns.size(), m_deviceId, keyColumns.data());
+}
+
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::GatherInputs()
+{
+    m_queries->DoGatherColumnsOf(0, *m_queryColumns, InputRef(0).Value(), 1);
+    m_keys->DoGatherColumnsOf(0, *m_keyColumns, InputRef(1).Value(), 1);
+    m_values->DoGatherColumnsOf(0, *m_keyColumns, InputRef(2).Value(), 1);
+}
+
+// m_scores = scale * keys' * queries and m_probabilities = exp(m_scores - logNormalizers) for the query frames
+// [queryBegin, queryEnd) of 'pair'. The forward pass computes the log normalizers, backprop reads them.
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::ComputeScores(const SequencePair& pair, size_t queryBegin, size_t queryEnd, bool computeLogNormalizers)
+{
+    const size_t numKeyFrames = pair.keyEnd - pair.keyBegin;
+    const size_t numQueryFrames = queryEnd - queryBegin;
+    m_scores->Resize(numKeyFrames, numQueryFrames);
+    m_probabilities->Resize(numKeyFrames, numQueryFrames);
+    Matrix<ElemType>::MultiplyAndWeightedAdd(EffectiveScale(), m_keys->ColumnSlice(pair.keyBegin, numKeyFrames), true,
+                                             m_queries->ColumnSlice(queryBegin, numQueryFrames), false, 0, *m_scores);
+
+    TensorShape logNormalizersShape(1, m_logNormalizers->GetNumCols());
+    logNormalizersShape.NarrowTo(1, queryBegin, queryEnd);
+    TensorView<ElemType> logNormalizers(m_logNormalizers, logNormalizersShape);
+    TensorView<ElemType> scores(m_scores, TensorShape(numKeyFrames, numQueryFrames));
+    if (computeLogNormalizers)
+        logNormalizers.DoUnaryOpOf(0, scores, 1, opCopy, opLogSum);
+
+    ElementwiseProgram program(2);
+    program.Add(opExp, program.Add(opDifference, 0, 1));
+    TensorView<ElemType>(m_probabilities, TensorShape(numKeyFrames, numQueryFrames)).DoElementwiseProgramOf(0, { scores, logNormalizers }, program, 1);
+}
+
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::ForwardPropNonLooping()
+{
+    for (size_t i = 0; i < GetNumInputs(); i++)
+    {
+        if (InputRef(i).Value().GetMatrixType() != DENSE)
+            InvalidArgument("%ls %ls operation: Input %d must be dense.", NodeName().c_str(), OperationName().c_str(), (int)i);
+    }
+
+    DetermineSequencePairs();
+    GatherInputs();
+    m_output->Resize(GetSampleMatrixNumRows(), m_queries->GetNumCols());
+    m_logNormalizers->Resize(1, m_queries->GetNumCols());
+    for (const auto& pair : m_sequencePairs)
+    {
+        const size_t numKeyFrames = pair.keyEnd - pair.keyBegin;
+        if (numKeyFrames == 0) // nothing to attend to
+        {
+            m_output->ColumnSlice(pair.queryBegin, pair.queryEnd - pair.queryBegin).SetValue(0);
+            continue;
+        }
+
+        const size_t tileSize = std::max<size_t>(1, m_maxScoresPerTile / numKeyFrames);
+        const auto values = m_values->ColumnSlice(pair.keyBegin, numKeyFrames);
+        for (size_t begin = pair.queryBegin; begin < pair.queryEnd; begin += tileSize)
+        {
+            const size_t end = std::min(begin + tileSize, pair.queryEnd);
+            ComputeScores(pair, begin, end, /*computeLogNormalizers=*/true);
+            auto output = m_output->ColumnSlice(begin, end - begin);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, values, false, *m_probabilities, false, 0, output);
+        }
+    }
+
+    // the gaps of the output are zero
+    Value().DoScatterColumnsOf(0, *m_queryColumns, *m_output, 1);
+    m_haveGradients = false;
+}
+
+// The gradients of the inputs that need them, over the gathered frames. With P the probabilities of a tile and dO
+// the gradient of its output:
+//   dV += dO * P'
+//   dS = P .* (V' * dO - delta), with delta_i = sum_j P_ji (V' * dO)_ji = dO_i . O_i
+//   dQ = scale * K * dS
+//   dK += scale * Q * dS'
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::ComputeGradients()
+{
+    const bool needQueryGradient = InputRef(0).NeedsGradient();
+    const bool needKeyGradient = InputRef(1).NeedsGradient();
+    const bool needValueGradient = InputRef(2).NeedsGradient();
+    const ElemType scale = EffectiveScale();
+
+    // The gathered inputs were released after the forward pass. The sequence pairs are those of the forward pass.
+    GatherInputs();
+    const size_t numQueryFrames = m_queries->GetNumCols();
+    const size_t numKeyFrames = m_keys->GetNumCols();
+    m_outputGradient->DoGatherColumnsOf(0, *m_queryColumns, Gradient(), 1);
+    m_output->DoGatherColumnsOf(0, *m_queryColumns, Value(), 1);
+    m_deltas->Resize(1, numQueryFrames);
+    TensorShape outputShape(GetSampleMatrixNumRows(), numQueryFrames);
+    TensorView<ElemType>(m_deltas, TensorShape(1, numQueryFrames)).DoBinaryOpOf(0, TensorView<ElemType>(m_outputGradient, outputShape), TensorView<ElemType>(m_output, outputShape), 1, opElementwiseProduct, opSum);
+
+    if (needQueryGradient)
+        m_queryGradient->Resize(m_queries->GetNumRows(), numQueryFrames);
+    if (needKeyGradient)
+    {
+        m_keyGradient->Resize(m_keys->GetNumRows(), numKeyFrames);
+        m_keyGradient->SetValue(0);
+    }
+    if (needValueGradient)
+    {
+        m_valueGradient->Resize(m_values->GetNumRows(), numKeyFrames);
+        m_valueGradient->SetValue(0);
+    }
+
+    // dS = P .* (dP - delta), in place of dP
+    ElementwiseProgram program(3);
+    program.Add(opElementwiseProduct, program.Add(opDifference, 0, 2), 1);
+
+    for (const auto& pair : m_sequencePairs)
+    {
+        const size_t numPairKeyFrames = pair.keyEnd - pair.keyBegin;
+        if (numPairKeyFrames == 0)
+        {
+            if (needQueryGradient)
+                m_queryGradient->ColumnSlice(pair.queryBegin, pair.queryEnd - pair.queryBegin).SetValue(0);
+            continue;
+        }
+
+        const size_t tileSize = std::max<size_t>(1, m_maxScoresPerTile / numPairKeyFrames);
+        const auto keys = m_keys->ColumnSlice(pair.keyBegin, numPairKeyFrames);
+        const auto values = m_values->ColumnSlice(pair.keyBegin, numPairKeyFrames);
+        for (size_t begin = pair.queryBegin; begin < pair.queryEnd; begin += tileSize)
+        {
+            const size_t end = std::min(begin + tileSize, pair.queryEnd);
+            const size_t numTileFrames = end - begin;
+            ComputeScores(pair, begin, end, /*computeLogNormalizers=*/false);
+            const auto outputGradient = m_outputGradient->ColumnSlice(begin, numTileFrames);
+            if (needValueGradient)
+            {
+                auto valueGradient = m_valueGradient->ColumnSlice(pair.keyBegin, numPairKeyFrames);
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, outputGradient, false, *m_probabilities, true, 1, valueGradient);
+            }
+            if (!needQueryGradient && !needKeyGradient)
+                continue;
+
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, values, true, outputGradient, false, 0, *m_scores);
+            TensorShape deltasShape(1, numQueryFrames);
+            deltasShape.NarrowTo(1, begin, end);
+            TensorView<ElemType> scoreGradient(m_scores, TensorShape(numPairKeyFrames, numTileFrames));
+            scoreGradient.DoElementwiseProgramOf(0, { scoreGradient, TensorView<ElemType>(m_probabilities, TensorShape(numPairKeyFrames, numTileFrames)), TensorView<ElemType>(m_deltas, deltasShape) }, program, 1);
+            if (needQueryGradient)
+            {
+                auto queryGradient = m_queryGradient->ColumnSlice(begin, numTileFrames);
+                Matrix<ElemType>::MultiplyAndWeightedAdd(scale, keys, false, *m_scores, false, 0, queryGradient);
+            }
+            if (needKeyGradient)
+            {
+                auto keyGradient = m_keyGradient->ColumnSlice(pair.keyBegin, numPairKeyFrames);
+                Matrix<ElemType>::MultiplyAndWeightedAdd(scale, m_queries->ColumnSlice(begin, numTileFrames), false, *m_scores, true, 1, keyGradient);
+            }
+        }
+    }
+}
+
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::BackpropToNonLooping(size_t inputIndex)
+{
+    if (!m_haveGradients)
+    {
+        ComputeGradients();
+        m_haveGradients = true;
+    }
+
+    const auto& columns = inputIndex == 0 ? *m_queryColumns : *m_keyColumns;
+    const auto& gradient = inputIndex == 0 ? *m_queryGradient : inputIndex == 1 ? *m_keyGradient : *m_valueGradient;
+    InputRef(inputIndex).Gradient().DoScatterColumnsOf(1, columns, gradient, 1);
+}
+
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::Validate(bool isFinalValidationPass)
+{
+    ComputationNodeBase::Validate(isFinalValidationPass);
+    m_pMBLayout = Input(0)->GetMBLayout();
+
+    if (isFinalValidationPass)
+    {
+        if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout())
+            InvalidArgument("%ls %ls operation requires the query and the keys to be sequences (must have MBLayouts).", NodeName().c_str(), OperationName().c_str());
+        if (Input(1)->GetMBLayout() != Input(2)->GetMBLayout())
+            InvalidArgument("%ls %ls operation requires the keys and the values to have the same MBLayout.", NodeName().c_str(), OperationName().c_str());
+        if (Input(0)->GetSampleMatrixNumRows() != Input(1)->GetSampleMatrixNumRows())
+            InvalidArgument("%ls %ls operation: The query dimension %d does not match the key dimension %d.",
+                            NodeName().c_str(), OperationName().c_str(), (int)Input(0)->GetSampleMatrixNumRows(), (int)Input(1)->GetSampleMatrixNumRows());
+    }
+
+    SetDims(Input(2)->GetSampleLayout(), HasMBLayout());
+}
+
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
+{
+    Base::RequestMatricesBeforeForwardProp(matrixPool);
+    RequestMatrixFromPool(m_queries, matrixPool);
+    RequestMatrixFromPool(m_keys, matrixPool);
+    RequestMatrixFromPool(m_values, matrixPool);
+    RequestMatrixFromPool(m_output, matrixPool);
+    RequestMatrixFromPool(m_logNormalizers, matrixPool);
+    RequestMatrixFromPool(m_scores, matrixPool);
+    RequestMatrixFromPool(m_probabilities, matrixPool);
+}
+
+// Only the log normalizers are kept for backprop; it gathers the inputs again and recomputes the scores.
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool)
+{
+    Base::ReleaseMatricesAfterForwardProp(matrixPool);
+    ReleaseMatrixToPool(m_queries, matrixPool);
+    ReleaseMatrixToPool(m_keys, matrixPool);
+    ReleaseMatrixToPool(m_values, matrixPool);
+    ReleaseMatrixToPool(m_output, matrixPool);
+    ReleaseMatrixToPool(m_scores, matrixPool);
+    ReleaseMatrixToPool(m_probabilities, matrixPool);
+}
+
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
+{
+    Base::RequestMatricesBeforeBackprop(matrixPool);
+    RequestMatrixFromPool(m_queries, matrixPool);
+    RequestMatrixFromPool(m_keys, matrixPool);
+    RequestMatrixFromPool(m_values, matrixPool);
+    RequestMatrixFromPool(m_output, matrixPool);
+    RequestMatrixFromPool(m_scores, matrixPool);
+    RequestMatrixFromPool(m_probabilities, matrixPool);
+    RequestMatrixFromPool(m_outputGradient, matrixPool);
+    RequestMatrixFromPool(m_deltas, matrixPool);
+    RequestMatrixFromPool(m_queryGradient, matrixPool);
+    RequestMatrixFromPool(m_keyGradient, matrixPool);
+    RequestMatrixFromPool(m_valueGradient, matrixPool);
+}
+
+template <class ElemType>
+void ScaledDotProductAttentionNode<ElemType>::ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+{
+    Base::ReleaseMatricesAfterBackprop(matrixPool);
+    ReleaseMatrixToPool(m_queries, matrixPool);
+    ReleaseMatrixToPool(m_keys, matrixPool);
+    ReleaseMatrixToPool(m_values, matrixPool);
+    ReleaseMatrixToPool(m_output, matrixPool);
+    ReleaseMatrixToPool(m_logNormalizers, matrixPool);
+    ReleaseMatrixToPool(m_scores, matrixPool);
+    ReleaseMatrixToPool(m_probabilities, matrixPool);
+    ReleaseMatrixToPool(m_outputGradient, matrixPool);
+    ReleaseMatrixToPool(m_deltas, matrixPool);
+    ReleaseMatrixToPool(m_queryGradient, matrixPool);
+    ReleaseMatrixToPool(m_keyGradient, matrixPool);
+    ReleaseMatrixToPool(m_valueGradient, matrixPool);
+}
+
+template class ScaledDotProductAttentionNode<float>;
+template class ScaledDotProductAttentionNode<double>;
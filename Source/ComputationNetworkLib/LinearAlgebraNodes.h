@@ -22,6 +22,8 @@
 #include <set>
 #include "Quantizers.h"
 #include "InputAndParamNodes.h"
+#include "Globals.h"
+#include "TimerUtility.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -68,6 +70,8 @@ public:
     }
 
     virtual bool ImplementsGradientOverwriteOptimization() const override { return true; }
+
+    virtual bool IsFusibleElementwiseOp(FusibleElementwiseOp& op) const override { op = FusibleElementwiseOp(opSum); return true; }
 };
 
 template class PlusNode<float>;
@@ -231,6 +235,8 @@ public:
         ElemType sign = inputIndex == 0 ? 1.0f : -1.0f;
         inputGradient.AddCopyOf(gradient, sign);
     }
+
+    virtual bool IsFusibleElementwiseOp(FusibleElementwiseOp& op) const override { op = FusibleElementwiseOp(opDifference); return true; }
 };
 
 template class MinusNode<float>;
@@ -271,6 +277,8 @@ public:
 
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return true; }
 
+    virtual bool IsFusibleElementwiseOp(FusibleElementwiseOp& op) const override { op = FusibleElementwiseOp(opElementwiseProduct); return true; }
+
     template <typename classType>
     static void ForwardPropImpl(classType& c, const FrameRange& fr, bool allowBroadcast)
     {
@@ -332,7 +340,8 @@ public:
 
 public:
     TimesNodeBase(DEVICEID_TYPE deviceId, const wstring& name, size_t outputRank = 1, int inferInputRankToMap = NoInferredInputRank)
-        : Base(deviceId, name), m_outputRank(outputRank), m_inferInputRankToMap(inferInputRankToMap), m_beingUnrolled(false)
+        : Base(deviceId, name), m_outputRank(outputRank), m_inferInputRankToMap(inferInputRankToMap), m_beingUnrolled(false),
+          m_quantizedForInference(false), m_quantizationReported(false), m_hoistingLoopInvariantProduct(false)
     {
     }
 
@@ -416,6 +425,49 @@ private:
         return input0_ok && input1_ok && outputScalar && notBothSparse && (m_transpose || !hasSparse);
     }
 
+    // Check if the frame-by-frame products of the unrolled path can be done as one batched GEMM over the columns of the frame range:
+    // all operands are dense, each sample of A is a matrix (rowsA x colsA before transposition) and B and the output either have the
+    // same MBLayout as A or, for B only, none (then B is the same matrix for every frame). Returns false if the product must be unrolled.
+    bool GetBatchedSampleProductDims(size_t& rowsA, size_t& colsA, size_t& rowsB, size_t& colsB, bool& broadcastB)
+    {
+        const auto& shape0 = InputRef(0).GetSampleLayout();
+        if (m_outputRank != 1 || InputRef(0).Value().GetMatrixType() != DENSE || InputRef(1).Value().GetMatrixType() != DENSE)
+            return false;
+        if (shape0.GetRank() == 2)
+        {
+            rowsA = shape0.GetDim(0);
+            colsA = shape0.GetDim(1);
+        }
+        else if (shape0.GetRank() == 1 && m_transpose) // as in OneSampleTensorFor()
+        {
+            rowsA = shape0.GetDim(0);
+            colsA = 1;
+        }
+        else
+            return false;
+
+        auto layout = InputRef(0).GetMBLayout();
+        broadcastB = !InputRef(1).HasMBLayout();
+        if ((!broadcastB && InputRef(1).GetMBLayout() != layout) || GetMBLayout() != layout)
+            return false;
+
+        size_t k = m_transpose ? rowsA : colsA;
+        size_t numElements1 = InputRef(1).GetSampleLayout().GetNumElements();
+        if (k == 0 || numElements1 % k != 0)
+            return false;
+        rowsB = k;
+        colsB = numElements1 / k;
+        return GetSampleLayout().GetNumElements() == (m_transpose ? colsA : rowsA) * colsB;
+    }
+
+    // a per-frame matrix stored as the columns of 'data' for frame range 'fr', viewed as numFrames blocks of 'rows' rows
+    static Matrix<ElemType> FramesAsColumnBlocks(const Matrix<ElemType>& data, size_t rows)
+    {
+        Matrix<ElemType> blocks = data.ColumnSlice(0, data.GetNumCols());
+        blocks.Reshape(rows, data.GetNumElements() / rows);
+        return blocks;
+    }
+
     void RequestReduceSequenceAxisMatricesIfNeeded(MatrixPool& matrixPool)
     {
         if (!ReduceSequenceAxis()) return;
@@ -481,17 +533,12 @@ private:
         const Matrix<ElemType>& mat0 = unpackedInput[0].GetSOB();
         const Matrix<ElemType>& mat1 = unpackedInput[1].GetSOB();
 
-        // unroll in the batch axis, we may use batched GEMM in future
-        for (int s = 0; s < numSequences; s++)
-        {
-            Matrix<ElemType> mat0Slice = mat0.ColumnSlice(s * maxNumTimeSteps, maxNumTimeSteps); // (m * k) x s*
-            mat0Slice.Reshape(m, k * maxNumTimeSteps); // m x (k * s*)
-            Matrix<ElemType> mat1Slice = mat1.ColumnSlice(s * maxNumTimeSteps, maxNumTimeSteps); // k x s*
-            mat1Slice.Reshape(k * maxNumTimeSteps, 1); // (k * s*) x 1
-
-            Matrix<ElemType> value = Value().ColumnSlice(s, 1);
-            Matrix<ElemType>::Multiply(mat0Slice, false, mat1Slice, false, value);
-        }
+        // one batched GEMM over the batch axis, each sequence being one product m x (k * s*) times (k * s*) x 1
+        Matrix<ElemType> mat0Batch = mat0.ColumnSlice(0, numSequences * maxNumTimeSteps); // (m * k) x (s* * b*)
+        mat0Batch.Reshape(m, k * maxNumTimeSteps * numSequences); // b* blocks of m x (k * s*)
+        Matrix<ElemType> mat1Batch = mat1.ColumnSlice(0, numSequences * maxNumTimeSteps); // k x (s* * b*)
+        mat1Batch.Reshape(k * maxNumTimeSteps, numSequences); // b* blocks of (k * s*) x 1
+        Matrix<ElemType>::BatchMultiplyAndWeightedAdd(1, mat0Batch, false, mat1Batch, false, 0, Value(), numSequences);
     }
 
     void BackpropTo_ReduceSequenceAxis(size_t inputIndex)
@@ -530,15 +577,12 @@ private:
             Matrix<ElemType> tempGradientUnpacked(m * k, maxNumTimeSteps * numSequences, InputRef(inputIndex).GetDeviceId());
             Matrix<ElemType>& inputGradientUnpacked = unpacked[inputIndex] ? tempGradientUnpacked : InputRef(inputIndex).Gradient();
 
-            for (int s = 0; s < numSequences; s++)
-            {
-                Matrix<ElemType> inputGradientSlice = inputGradientUnpacked.ColumnSlice(s * maxNumTimeSteps, maxNumTimeSteps); // (m * k) x s*
-                inputGradientSlice.Reshape(m, k * maxNumTimeSteps); // m x (k * s*)
-                Matrix<ElemType> inputValueSlice = unpackedInputValue.ColumnSlice(s * maxNumTimeSteps, maxNumTimeSteps); // k x s*
-                inputValueSlice.Reshape(k * maxNumTimeSteps, 1); // (k * s*) x 1
-                Matrix<ElemType> gradientSlice = Gradient().ColumnSlice(s, 1); // m x 1
-                Matrix<ElemType>::MultiplyAndWeightedAdd(1, gradientSlice, false, inputValueSlice, true, unpacked[inputIndex] ? 0 : beta, inputGradientSlice);
-            }
+            Matrix<ElemType> inputGradientBatch = inputGradientUnpacked.ColumnSlice(0, numSequences * maxNumTimeSteps); // (m * k) x (s* * b*)
+            inputGradientBatch.Reshape(m, k * maxNumTimeSteps * numSequences); // b* blocks of m x (k * s*)
+            Matrix<ElemType> inputValueBatch = unpackedInputValue.ColumnSlice(0, numSequences * maxNumTimeSteps); // k x (s* * b*)
+            inputValueBatch.Reshape(k * maxNumTimeSteps, numSequences); // b* blocks of (k * s*) x 1
+            const Matrix<ElemType>& gradientBatch = Gradient(); // b* blocks of m x 1
+            Matrix<ElemType>::BatchMultiplyAndWeightedAdd(1, gradientBatch, false, inputValueBatch, true, unpacked[inputIndex] ? 0 : beta, inputGradientBatch, numSequences);
 
             if (unpacked[inputIndex])
                 InputRef(inputIndex).Gradient().DoGatherColumnsOf(beta, *m_tempScatterIndices[inputIndex], inputGradientUnpacked, (ElemType)1);
@@ -548,24 +592,84 @@ private:
             Matrix<ElemType> tempGradientUnpacked(k, maxNumTimeSteps * numSequences, InputRef(inputIndex).GetDeviceId());
             Matrix<ElemType>& inputGradientUnpacked = unpacked[inputIndex] ? tempGradientUnpacked : InputRef(inputIndex).Gradient();
 
-            for (int s = 0; s < numSequences; s++)
-            {
-                Matrix<ElemType> inputGradientSlice = inputGradientUnpacked.ColumnSlice(s * maxNumTimeSteps, maxNumTimeSteps); // k x s*
-                inputGradientSlice.Reshape(k * maxNumTimeSteps, 1); // (k * s*) x 1
-                Matrix<ElemType> inputValueSlice = unpackedInputValue.ColumnSlice(s * maxNumTimeSteps, maxNumTimeSteps); // (m * k) x s*
-                inputValueSlice.Reshape(m, k * maxNumTimeSteps); // m x (k * s*)
-                Matrix<ElemType> gradientSlice = Gradient().ColumnSlice(s, 1); // m x 1
-                Matrix<ElemType>::MultiplyAndWeightedAdd(1, inputValueSlice, true, gradientSlice, false, unpacked[inputIndex] ? 0 : beta, inputGradientSlice);
-            }
-            
+            Matrix<ElemType> inputGradientBatch = inputGradientUnpacked.ColumnSlice(0, numSequences * maxNumTimeSteps); // k x (s* * b*)
+            inputGradientBatch.Reshape(k * maxNumTimeSteps, numSequences); // b* blocks of (k * s*) x 1
+            Matrix<ElemType> inputValueBatch = unpackedInputValue.ColumnSlice(0, numSequences * maxNumTimeSteps); // (m * k) x (s* * b*)
+            inputValueBatch.Reshape(m, k * maxNumTimeSteps * numSequences); // b* blocks of m x (k * s*)
+            const Matrix<ElemType>& gradientBatch = Gradient(); // b* blocks of m x 1
+            Matrix<ElemType>::BatchMultiplyAndWeightedAdd(1, inputValueBatch, true, gradientBatch, false, unpacked[inputIndex] ? 0 : beta, inputGradientBatch, numSequences);
+
             if (unpacked[inputIndex])
                 InputRef(inputIndex).Gradient().DoGatherColumnsOf(beta, *m_tempScatterIndices[inputIndex], inputGradientUnpacked, (ElemType)1);
         }
     }
 
+    // Loop-invariant product hoisting (Globals::SetLoopInvariantProductHoisting()): inside a recurrent loop, W * RowStack(x, h)
+    // is W_x * x + W_h * h, with W_x and W_h the column stripes of W that multiply the stacked inputs. x is computed outside
+    // the loop, so W_x * x is computed for all time steps in BeginForwardProp() as one large product, and each time step only
+    // adds W_h * h. The RowStackNode still computes its value, which the gradient of W needs.
+    bool HoistsLoopInvariantProduct() const
+    {
+        if (m_loopInvariantStackedInputs.empty() || Globals::ShouldUseQuantizedInference())
+            return false;
+        if (InputRef(0).Value().GetMatrixType() != DENSE || Value().GetMatrixType() != DENSE)
+            return false;
+        for (size_t i = 0; i < InputRef(1).GetNumInputs(); i++)
+        {
+            if (StackedInputRef(i).Value().GetMatrixType() != DENSE)
+                return false;
+        }
+        return true;
+    }
+
+    ComputationNode<ElemType>& StackedInputRef(size_t i) const { return *InputRef(1).GetInputs()[i]->template As<ComputationNode<ElemType>>(); }
+
+    bool IsLoopInvariantStackedInput(size_t i) const
+    {
+        return std::find(m_loopInvariantStackedInputs.begin(), m_loopInvariantStackedInputs.end(), i) != m_loopInvariantStackedInputs.end();
+    }
+
+    // adds the products of the stacked inputs that are (not) loop-invariant with their stripes of W to the value for 'fr'
+    void AddStackedInputProducts(const FrameRange& fr, bool loopInvariant)
+    {
+        Matrix<ElemType> weights = FramesAsColumnBlocks(InputRef(0).Value(), GetSampleLayout().GetNumElements());
+        Matrix<ElemType> value = ValueFor(fr);
+        ElemType beta = loopInvariant ? 0 : 1; // the loop-invariant products come first and overwrite the value
+        size_t firstColumn = 0;
+        for (size_t i = 0; i < InputRef(1).GetNumInputs(); i++)
+        {
+            auto& input = StackedInputRef(i);
+            size_t numColumns = input.GetSampleLayout().GetNumElements();
+            if (IsLoopInvariantStackedInput(i) == loopInvariant)
+            {
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, weights.ColumnSlice(firstColumn, numColumns), false, input.ValueFor(fr), false, beta, value);
+                beta = 1;
+            }
+            firstColumn += numColumns;
+        }
+    }
+
 public:
+    // set by ComputationNetwork::HoistLoopInvariantProducts(): the inputs of our right operand, a RowStackNode in the same
+    // recurrent loop, that are computed outside of the loop
+    void SetLoopInvariantStackedInputs(std::vector<size_t>&& inputIndices) { m_loopInvariantStackedInputs = std::move(inputIndices); }
+
+    virtual void /*ComputationNode::*/ BeginForwardProp() override
+    {
+        Base::BeginForwardProp();
+        m_hoistingLoopInvariantProduct = HoistsLoopInvariantProduct();
+        if (m_hoistingLoopInvariantProduct)
+            AddStackedInputProducts(FrameRange(GetMBLayout()), /*loopInvariant=*/true);
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (m_hoistingLoopInvariantProduct && !fr.IsAllFrames()) // a time step of the loop
+        {
+            AddStackedInputProducts(fr, /*loopInvariant=*/false);
+            return;
+        }
+
         // If argument A is minibatch data, then this must be performed frame-by-frame, sequence-by-sequence, one GEMM call each.
         // This will be inefficient. We hope this will be the baseline of a future, more efficient TensorView-based implementation.
         auto inputMBLayout = InputRef(0).GetMBLayout();
@@ -607,7 +711,21 @@ public:
                 return;
             }
 
-            // recursively call ourselves for each individual time and sequence
+            // one batched GEMM for the products of all frames
+            size_t rowsA, colsA, rowsB, colsB;
+            bool broadcastB;
+            if (GetBatchedSampleProductDims(rowsA, colsA, rowsB, colsB, broadcastB))
+            {
+                Matrix<ElemType> value = ValueFor(fr);
+                Matrix<ElemType> input0 = InputRef(0).ValueFor(fr);
+                size_t numFrames = input0.GetNumCols();
+                Matrix<ElemType> valueBlocks = FramesAsColumnBlocks(value, m_transpose ? colsA : rowsA);
+                Matrix<ElemType> input1Blocks = FramesAsColumnBlocks(InputRef(1).ValueFor(fr), rowsB);
+                Matrix<ElemType>::BatchMultiplyAndWeightedAdd(1, FramesAsColumnBlocks(input0, rowsA), m_transpose, input1Blocks, false, 0, valueBlocks, numFrames, false, broadcastB);
+                return;
+            }
+
+            // otherwise recursively call ourselves for each individual time and sequence
 
             // note this is not performant, warn user about the slow path being used
             if (Base::HasEnvironmentPtr() && Base::Environment().traceLevel > 0)
@@ -629,7 +747,10 @@ public:
         auto input0 = OneSampleTensorFor(0,  /*gradient=*/false, fr.AllowBroadcast());
         auto input1 = OneSampleTensorFor(1,  /*gradient=*/false, fr.AllowBroadcast());
         auto output = OneSampleTensorFor(-1, /*gradient=*/false, fr);
+        UpdateQuantizationForInference();
         output.AssignMatrixProductOf(false/*transC*/, input0, m_transpose/*transA*/, input1, false/*transB*/, 1.0f, this->m_pQuantizedMultiplier);
+        if (m_quantizedForInference && !m_quantizationReported && Base::Environment().traceLevel > 0)
+            ReportQuantizationForInference(input0, input1, output);
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
@@ -670,6 +791,25 @@ public:
                 return;
             }
 
+            // one batched GEMM for the gradients of all frames, unless the gradient of B is the sum over the frames
+            size_t rowsA, colsA, rowsB, colsB;
+            bool broadcastB;
+            if (GetBatchedSampleProductDims(rowsA, colsA, rowsB, colsB, broadcastB) && (inputIndex == 0 || !broadcastB))
+            {
+                ElemType beta = Input(inputIndex)->ParentOverwritesGradient() ? (ElemType)0 : (ElemType)1;
+                Matrix<ElemType> input0 = InputRef(0).ValueFor(fr);
+                size_t numFrames = input0.GetNumCols();
+                Matrix<ElemType> gradientBlocks = FramesAsColumnBlocks(GradientFor(fr), m_transpose ? colsA : rowsA); // blocks of op(A) * B
+                Matrix<ElemType> inputGradientBlocks = FramesAsColumnBlocks(InputRef(inputIndex).GradientFor(fr), inputIndex == 0 ? rowsA : rowsB);
+                if (inputIndex == 0 && !m_transpose) // dA = dC * B^T
+                    Matrix<ElemType>::BatchMultiplyAndWeightedAdd(1, gradientBlocks, false, FramesAsColumnBlocks(InputRef(1).ValueFor(fr), rowsB), true, beta, inputGradientBlocks, numFrames, false, broadcastB);
+                else if (inputIndex == 0) // A stored transposed: dA = B * dC^T
+                    Matrix<ElemType>::BatchMultiplyAndWeightedAdd(1, FramesAsColumnBlocks(InputRef(1).ValueFor(fr), rowsB), false, gradientBlocks, true, beta, inputGradientBlocks, numFrames, broadcastB, false);
+                else // dB = op(A)^T * dC
+                    Matrix<ElemType>::BatchMultiplyAndWeightedAdd(1, FramesAsColumnBlocks(input0, rowsA), !m_transpose, gradientBlocks, false, beta, inputGradientBlocks, numFrames);
+                return;
+            }
+
             auto timeRange     = fr.GetTimeRange();
             auto sequenceRange = fr.GetSequenceRange();
             // when unroll, parent overwrite gradient should be ignored
@@ -764,6 +904,30 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     // but both *inputs* are used, so we don't overload the InputUsed-() function which defaults to 'true'
 
+    virtual bool /*ComputationNodeBase::*/ CanRecomputeValue() const override { return true; }
+
+    // (the output rank follows from the sample layouts of the inputs and the output)
+    virtual bool /*ComputationNodeBase::*/ ComputesSameValueAs(const ComputationNodeBase& /*other*/) const override { return true; }
+
+    // a multiply-add over the inner dimension k per output value; with samples of [m x k], [k x n] and [m x n], k = sqrt(mk * kn / mn)
+    double GetInnerDimension() const
+    {
+        return sqrt((double)GetInputSampleLayout(0).GetNumElements() * GetInputSampleLayout(1).GetNumElements() / GetSampleLayout().GetNumElements());
+    }
+
+    virtual void /*ComputationNodeBase::*/ GetForwardCost(double& flops, double& bytes) const override
+    {
+        flops = 2 * GetNumValues() * GetInnerDimension();
+        bytes = (Input(0)->GetNumValues() + Input(1)->GetNumValues() + GetNumValues()) * sizeof(ElemType);
+    }
+
+    // the gradient of either input is another product of the same size
+    virtual void /*ComputationNodeBase::*/ GetBackpropCost(size_t inputIndex, double& flops, double& bytes) const override
+    {
+        flops = 2 * GetNumValues() * GetInnerDimension();
+        bytes = (Input(1 - inputIndex)->GetNumValues() + 2 * Input(inputIndex)->GetNumValues() + GetNumValues()) * sizeof(ElemType);
+    }
+
     virtual bool ImplementsGradientOverwriteOptimization() const override { return true; }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -946,10 +1110,75 @@ protected:
     shared_ptr<QuantizedMultiplier<ElemType>> m_pQuantizedMultiplier;
 
 private:
+    // Quantized inference mode (Globals::SetQuantizedInference()): a plain product whose left operand is a
+    // LearnableParameter is computed in 16 bit on the CPU and in 8 bit on the GPU, like QuantizedTimes. The weights
+    // are quantized (and packed) on the first evaluation and kept while the node is used for inference only; any other
+    // use drops them, so that an evaluation after further training sees the updated weights.
+    void UpdateQuantizationForInference()
+    {
+        bool quantize = Globals::ShouldUseQuantizedInference() && !m_transpose &&
+                        Base::HasEnvironmentPtr() && Base::Environment().IsInferring() &&
+                        dynamic_pointer_cast<LearnableParameter<ElemType>>(Input(0)) &&
+                        InputRef(0).Value().GetMatrixType() == DENSE && InputRef(1).Value().GetMatrixType() == DENSE;
+        if (quantize && !this->m_pQuantizedMultiplier)
+        {
+            auto pQA = make_shared<SymmetricQuantizer<ElemType, short>>(1);
+            auto pQB = make_shared<SymmetricQuantizer<ElemType, short>>(1);
+            this->m_pQuantizedMultiplier = make_shared<QuantizedMultiplier<ElemType>>(pQA, /*isAConstant=*/true, pQB, /*isBConstant=*/false);
+            m_quantizedForInference = true;
+            m_quantizationReported = false;
+        }
+        else if (!quantize && m_quantizedForInference)
+        {
+            this->m_pQuantizedMultiplier.reset();
+            m_quantizedForInference = false;
+        }
+    }
+
+    // Log once per node how much the quantized product deviates from, and how fast it is compared to, the float product,
+    // which tells what layers are better left in float. The products on the GPU run asynchronously, so there only the
+    // deviation is logged.
+    void ReportQuantizationForInference(const TensorView<ElemType>& input0, const TensorView<ElemType>& input1, const TensorView<ElemType>& output)
+    {
+        m_quantizationReported = true;
+        const DEVICEID_TYPE deviceId = Value().GetDeviceId();
+        TensorShape shape(output.GetShape().GetDims());
+        TensorView<ElemType> reference(make_shared<Matrix<ElemType>>(shape.GetNumElements(), 1, deviceId), shape);
+        TensorView<ElemType> quantized(make_shared<Matrix<ElemType>>(shape.GetNumElements(), 1, deviceId), shape);
+        Timer timer;
+        timer.Start();
+        reference.AssignMatrixProductOf(false/*transC*/, input0, false/*transA*/, input1, false/*transB*/);
+        timer.Stop();
+        double floatSeconds = timer.ElapsedSeconds();
+        timer.Start(); // the weights have been packed by the actual evaluation already
+        quantized.AssignMatrixProductOf(false/*transC*/, input0, false/*transA*/, input1, false/*transB*/, 1.0f, this->m_pQuantizedMultiplier);
+        timer.Stop();
+        double quantizedSeconds = timer.ElapsedSeconds();
+
+        const auto& referenceValue = reference.GetSOB();
+        Matrix<ElemType> difference(deviceId);
+        difference.AssignDifferenceOf(quantized.GetSOB(), referenceValue);
+        double referenceNorm = referenceValue.FrobeniusNorm();
+        double relativeError = referenceNorm > 0 ? difference.FrobeniusNorm() / referenceNorm : 0;
+        if (deviceId != CPUDEVICE)
+        {
+            fprintf(stderr, "Quantized inference: %ls %ls operation [%s] * [%s]: relative error %.2e on the GPU\n",
+                    NodeName().c_str(), OperationName().c_str(), string(input0.GetShape()).c_str(), string(input1.GetShape()).c_str(), relativeError);
+            return;
+        }
+        fprintf(stderr, "Quantized inference: %ls %ls operation [%s] * [%s]: relative error %.2e, %.3f ms vs. %.3f ms in float (%.2fx)\n",
+                NodeName().c_str(), OperationName().c_str(), string(input0.GetShape()).c_str(), string(input1.GetShape()).c_str(),
+                relativeError, 1e3 * quantizedSeconds, 1e3 * floatSeconds, quantizedSeconds > 0 ? floatSeconds / quantizedSeconds : 0);
+    }
+
     size_t m_outputRank;
     int m_inferInputRankToMap;  // -1 (not specified) or says how to expand shape of W, to keep this many mapping dims
     bool m_beingUnrolled;
     std::once_flag m_unrollWarningOnceFlag;
+    bool m_quantizedForInference; // m_pQuantizedMultiplier was created by UpdateQuantizationForInference()
+    bool m_quantizationReported;
+    std::vector<size_t> m_loopInvariantStackedInputs; // see HoistsLoopInvariantProduct(); not copied
+    bool m_hoistingLoopInvariantProduct;              // for the current minibatch
 
     bool ReduceSequenceAxis() const { return m_inferInputRankToMap == ReduceSequenceAxisWithoutInferredInputRank; }
 
@@ -1027,8 +1256,9 @@ template class TransposeTimesNode<double>;
 
 // Fixed-point matrix product. This scales inputs to 16bit signed integers by Symmetric quantizers, performs
 // integer multiplication using SSE/AVX2, and transforms the results back.
+// On the GPU the inputs are scaled to 8bit signed integers instead, the left one per row, and multiplied with DP4A
+// (see GPUMatrix::QuantizedMultiplyAndWeightedAdd()); the bit shifts only apply on the CPU.
 // Only dense untransposed matrix multiplication will be quantized. If at least one matrix is sparse then it will fall back to un-quantized default evaluation
-// Currently it works for CPU only. On GPU logicError will be thrown.
 // One way to include this node to the network is with the Edit command:
 // ...
 // node => if node.name == 'LSTMoutput1.output' then QuantizedTimes(node.inputs[0], node.inputs[1], bitShiftA=1, bitShiftB=2) else node,
@@ -1055,10 +1285,6 @@ public:
     QuantizedTimesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t bitShiftA = 1, size_t bitShiftB = 1, size_t outputRank = 1, int inferInputRankToMap = Base::NoInferredInputRank)
         : Base(deviceId, name, outputRank, inferInputRankToMap), m_bitShiftA(bitShiftA), m_bitShiftB(bitShiftB)
     {
-        // TODO support multiplication on GPUs as well.
-        if (deviceId != CPUDEVICE)
-            LogicError("Quantized operation is supposed to be used on CPU device only.");
-
         shared_ptr<SymmetricQuantizer<ElemType, short>> pQA(new SymmetricQuantizer<ElemType, short>(m_bitShiftA));
         shared_ptr<SymmetricQuantizer<ElemType, short>> qQB(new SymmetricQuantizer<ElemType, short>(m_bitShiftB));
         this->m_pQuantizedMultiplier = shared_ptr<QuantizedMultiplier<ElemType>>(new QuantizedMultiplier<ElemType>(pQA, qQB));
@@ -1213,6 +1439,13 @@ public:
     int Axis1() const { return m_axis1; }
     int Axis2() const { return m_axis2; }
 
+    virtual bool /*ComputationNodeBase::*/ ComputesSameValueAs(const ComputationNodeBase& other) const override
+    {
+        auto& otherTranspose = dynamic_cast<const TransposeDimensionsNode<ElemType>&>(other);
+        return (m_axis1 == otherTranspose.m_axis1 && m_axis2 == otherTranspose.m_axis2) ||
+               (m_axis1 == otherTranspose.m_axis2 && m_axis2 == otherTranspose.m_axis1);
+    }
+
 private:
     // compute the transposed tensor shape (in-place)
     void TransposeShape(TensorShape& shape) const
@@ -1732,6 +1965,117 @@ private:
 template class CosDistanceWithNegativeSamplesNode<float>;
 template class CosDistanceWithNegativeSamplesNode<double>;
 
+// -----------------------------------------------------------------------
+// ScaledDotProductAttentionNode (query, keys, values, scale=0)
+//
+// Attention of each query frame over the frames of its key sequence:
+//   output[:, i] = sum_j softmax_j(scale * keys[:, j]' * query[:, i]) * values[:, j]
+// with j over the frames of the sequence of keys and values that corresponds to the sequence of frame i.
+// The k-th sequence of the query, in the order of the sequence ids of its MBLayout, attends to the k-th sequence of
+// the keys, which may be on another dynamic axis (encoder/decoder attention) or the same one (self-attention).
+// Keys and values must have the same MBLayout; the output has the MBLayout of the query and the sample layout of
+// the values. A scale of 0 stands for 1/sqrt(dimension of the keys).
+//
+// The valid frames of the inputs are gathered per minibatch, so gaps are never attended to. Scores are computed in
+// tiles of query frames of at most m_maxScoresPerTile elements, and only the log normalizer of each query frame is
+// kept for backprop, which recomputes the scores of a tile from it. Neither pass materializes the scores of a whole
+// sequence pair, let alone a [T x T x batch] tensor.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ScaledDotProductAttentionNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<3>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"ScaledDotProductAttention"; }
+
+    static const size_t m_maxScoresPerTile = 4 * 1024 * 1024;
+
+public:
+    ScaledDotProductAttentionNode(DEVICEID_TYPE deviceId, const wstring& name, double scale = 0)
+        : Base(deviceId, name), m_scale(scale), m_queryColumns(make_shared<Matrix<ElemType>>(deviceId)), m_keyColumns(make_shared<Matrix<ElemType>>(deviceId)), m_haveGradients(false)
+    {
+    }
+
+    ScaledDotProductAttentionNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : ScaledDotProductAttentionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"scale"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void ForwardPropNonLooping() override;
+    virtual void BackpropToNonLooping(size_t inputIndex) override;
+    virtual void Validate(bool isFinalValidationPass) override;
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return true; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return true; }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<ScaledDotProductAttentionNode<ElemType>>(nodeP);
+            node->m_scale = m_scale;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_scale;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_scale;
+    }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override;
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override;
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override;
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override;
+
+    double Scale() const { return m_scale; }
+
+private:
+    // a query sequence and its key sequence, as column ranges of the gathered frames
+    struct SequencePair
+    {
+        size_t queryBegin, queryEnd;
+        size_t keyBegin, keyEnd;
+    };
+
+    ElemType EffectiveScale() const;
+    void DetermineSequencePairs();
+    void GatherInputs();
+    void ComputeScores(const SequencePair& pair, size_t queryBegin, size_t queryEnd, bool computeLogNormalizers);
+    void ComputeGradients();
+
+    double m_scale;
+    shared_ptr<Matrix<ElemType>> m_queryColumns; // row vector of the columns of the valid frames of the query, by sequence
+    shared_ptr<Matrix<ElemType>> m_keyColumns;   // same for keys and values
+    std::vector<SequencePair> m_sequencePairs;
+
+    // the valid frames of the inputs and the output
+    shared_ptr<Matrix<ElemType>> m_queries;
+    shared_ptr<Matrix<ElemType>> m_keys;
+    shared_ptr<Matrix<ElemType>> m_values;
+    shared_ptr<Matrix<ElemType>> m_output;
+    shared_ptr<Matrix<ElemType>> m_logNormalizers; // of the softmax of each query frame, kept for backprop
+    // one tile
+    shared_ptr<Matrix<ElemType>> m_scores;
+    shared_ptr<Matrix<ElemType>> m_probabilities;
+    // backprop
+    shared_ptr<Matrix<ElemType>> m_outputGradient;
+    shared_ptr<Matrix<ElemType>> m_deltas; // sum_j p_ij * (dO_i . v_j) = dO_i . o_i of each query frame
+    shared_ptr<Matrix<ElemType>> m_queryGradient;
+    shared_ptr<Matrix<ElemType>> m_keyGradient;
+    shared_ptr<Matrix<ElemType>> m_valueGradient;
+    bool m_haveGradients; // the gradients of all inputs are computed by the first BackpropToNonLooping() call
+};
+
 template <class ElemType>
 void UpdateRunningAverage(ComputationNode<ElemType>& newInput, TensorView<ElemType>& runningAverage,
                           size_t& runningCount);
@@ -9,6 +9,8 @@
 #include <stdexcept>
 #include <vector>
 #include <set>
+#include <map>
+#include <tuple>
 #include <utility>
 #include <algorithm>
 #include <stdlib.h>
@@ -16,6 +18,7 @@
 #include "Basics.h"
 #include "Matrix.h"
 #include "ComputationNode.h"
+#include "MemoryReport.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -30,11 +33,21 @@ struct MemRequestInfo
     int allocStep;                              // at what step counter memory allocation is requested 
     int releaseStep;                            // at what step counter memory release is requested  
     int memoryId;                               // integer indexing the memory buffer ID 
-    MemRequestInfo(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>*pMatrixPtr, size_t matrixSize, bool mbScale, bool isWorkSpace, int allocStep)
-        :deviceId(deviceId), pMatrixPtr(pMatrixPtr), matrixSize(matrixSize), mbScale(mbScale), isWorkSpace(isWorkSpace), allocStep(allocStep), releaseStep(INT_MAX), memoryId(-1)
+    std::wstring owner;                         // name of the requesting node, for the MemoryReport
+    const char* kind;                           // value, gradient, workspace, or temp
+    vector<pair<int, int>> reallocSteps;        // further [allocation, release] steps, for values that are recomputed in the backward pass
+    MemRequestInfo(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>*pMatrixPtr, size_t matrixSize, bool mbScale, bool isWorkSpace, int allocStep, const std::wstring& owner, const char* kind)
+        :deviceId(deviceId), pMatrixPtr(pMatrixPtr), matrixSize(matrixSize), mbScale(mbScale), isWorkSpace(isWorkSpace), allocStep(allocStep), releaseStep(INT_MAX), memoryId(-1), owner(owner), kind(kind)
     {
     }
-    void SetReleaseStep(int step) { releaseStep = step; }
+    void SetReleaseStep(int step) { (reallocSteps.empty() ? releaseStep : reallocSteps.back().second) = step; }
+    bool IsReleased() const { return (reallocSteps.empty() ? releaseStep : reallocSteps.back().second) != INT_MAX; }
+    vector<pair<int, int>> GetOccupancy() const
+    {
+        vector<pair<int, int>> occ(1, make_pair(allocStep, releaseStep));
+        occ.insert(occ.end(), reallocSteps.begin(), reallocSteps.end());
+        return occ;
+    }
     void SetMemoryId(int id) { memoryId = id;  }
 };
 
@@ -65,8 +78,12 @@ class MatrixPool
 {
     vector<MemRequestInfo<float>> m_memRequestInfoFloatVec; 
     vector<MemRequestInfo<double>> m_memRequestInfoDoubleVec;
+    vector<shared_ptr<Matrix<float>>> m_floatBuffers; // assigned by OptimizedMemoryAllocation()
+    vector<shared_ptr<Matrix<double>>> m_doubleBuffers;
     set<DEVICEID_TYPE> m_deviceIDSet; 
     int m_stepCounter; 
+    int m_concurrentRegionBeginStep = -1;
+    bool m_recomputing = false;
 
     template <class ElemType>
     vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec(); 
@@ -74,6 +91,33 @@ class MatrixPool
 public:
     void ResetStepCounter() { m_stepCounter = 0; };
 
+    // The nodes between BeginConcurrentRegion() and EndConcurrentRegion() may run at the same time on different streams
+    // (see StreamSchedule.h). All memory they request or release is considered in use for the whole region, so that none
+    // of it is shared between them.
+    void BeginConcurrentRegion()
+    {
+        if (m_concurrentRegionBeginStep >= 0)
+            LogicError("MatrixPool: Concurrent regions cannot be nested.");
+        m_concurrentRegionBeginStep = m_stepCounter;
+    }
+    void EndConcurrentRegion()
+    {
+        if (m_concurrentRegionBeginStep < 0)
+            LogicError("MatrixPool: EndConcurrentRegion() without BeginConcurrentRegion().");
+        WidenToConcurrentRegion<float>();
+        WidenToConcurrentRegion<double>();
+        m_concurrentRegionBeginStep = -1;
+        m_stepCounter++; // the end step belongs to the region
+    }
+
+    // The values of nodes that are recomputed in the backward pass (see ComputationNetwork::PlanRecomputation()), or copied back from
+    // host memory (see ComputationNetwork::PlanOffloading()), are requested again between BeginRecomputation() and EndRecomputation().
+    // This does not add requests but makes the pool keep the matrices that were requested and released before, from now until they
+    // are released again.
+    void BeginRecomputation() { m_recomputing = true; }
+    void EndRecomputation() { m_recomputing = false; }
+    bool IsRecomputing() const { return m_recomputing; }
+
     template <class ElemType>
     void RequestRelease(shared_ptr<Matrix<ElemType>> *pMatrixPtr)
     {
@@ -97,10 +141,21 @@ public:
     // mbScale is another flag indicating if the size of the memory will scale w.r.t. the minibatch size. Unfortunately, at the time of memory
     // request and pointer assignment, we don't known the minibatch size. Thus our memory sharing algorithm is sub-optimal. 
     template <class ElemType>
-    void RequestAllocate(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>*pMatrixPtr, size_t matrixSize, bool mbScale, bool isWorkSpace)
+    void RequestAllocate(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>*pMatrixPtr, size_t matrixSize, bool mbScale, bool isWorkSpace,
+                         const std::wstring& owner = std::wstring(), const char* kind = "temp")
     {
         vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>(); 
-        MemRequestInfo<ElemType> memInfo(deviceId, pMatrixPtr, matrixSize, mbScale, isWorkSpace, m_stepCounter);
+        if (m_recomputing)
+        {
+            for (auto& memInfo : memInfoVec)
+            {
+                if (memInfo.pMatrixPtr == pMatrixPtr && memInfo.IsReleased())
+                    memInfo.reallocSteps.push_back(make_pair(m_stepCounter, INT_MAX));
+            }
+            m_stepCounter++;
+            return; // matrices that are not in the pool, or are still kept, stay as they are
+        }
+        MemRequestInfo<ElemType> memInfo(deviceId, pMatrixPtr, matrixSize, mbScale, isWorkSpace, m_stepCounter, owner, kind);
         memInfoVec.push_back(memInfo); 
         m_deviceIDSet.insert(deviceId); 
         m_stepCounter++; 
@@ -111,13 +166,64 @@ public:
 
     void OptimizedMemoryAllocation()
     {
+        m_floatBuffers.clear();
+        m_doubleBuffers.clear();
         // MatrixPool is not templated, so we call both float and double versions here 
         OptimizedMemoryAllocationFunc<float>(); 
         OptimizedMemoryAllocationFunc<double>();
         return; 
     }
 
+    // the matrices that OptimizedMemoryAllocation() shared among the requests; MemoryPlanCache (MemoryPlan.h) places them into an arena
+    template <class ElemType>
+    vector<shared_ptr<Matrix<ElemType>>>& GetBuffers();
+
+    // describe the requests and their assignment to buffers by OptimizedMemoryAllocation()
+    void FillReport(MemoryReport& report)
+    {
+        report.requests.clear();
+        report.numBuffers = 0;
+        FillReportFunc<float>(report);
+        FillReportFunc<double>(report);
+    }
+
 private: 
+    template <class ElemType>
+    void FillReportFunc(MemoryReport& report)
+    {
+        // memory IDs are only unique per device and workspace flag
+        map<tuple<DEVICEID_TYPE, bool, int>, size_t> buffers;
+        for (const auto& memInfo : GetMemRequestInfoVec<ElemType>())
+        {
+            auto key = make_tuple(memInfo.deviceId, memInfo.isWorkSpace, memInfo.memoryId);
+            auto iter = buffers.find(key);
+            if (iter == buffers.end())
+                iter = buffers.insert(make_pair(key, report.numBuffers++)).first;
+            report.requests.push_back(MemoryReport::Request{ memInfo.owner, memInfo.kind, memInfo.deviceId, sizeof(ElemType), memInfo.matrixSize,
+                                                             memInfo.mbScale, memInfo.isWorkSpace, memInfo.allocStep, memInfo.releaseStep, iter->second,
+                                                             memInfo.reallocSteps });
+        }
+    }
+
+    template <class ElemType>
+    void WidenToConcurrentRegion()
+    {
+        for (auto& memInfo : GetMemRequestInfoVec<ElemType>())
+        {
+            if (memInfo.allocStep >= m_concurrentRegionBeginStep)
+                memInfo.allocStep = m_concurrentRegionBeginStep;
+            if (memInfo.releaseStep >= m_concurrentRegionBeginStep && memInfo.releaseStep < m_stepCounter)
+                memInfo.releaseStep = m_stepCounter;
+            for (auto& steps : memInfo.reallocSteps)
+            {
+                if (steps.first >= m_concurrentRegionBeginStep)
+                    steps.first = m_concurrentRegionBeginStep;
+                if (steps.second >= m_concurrentRegionBeginStep && steps.second < m_stepCounter)
+                    steps.second = m_stepCounter;
+            }
+        }
+    }
+
     bool CheckOverlap(pair<int, int>occ, vector<pair<int, int>>&occVec)
     {
         bool bRet = false;
@@ -137,6 +243,16 @@ private:
         return bRet;
     }
 
+    bool CheckOverlap(const vector<pair<int, int>>& occ, vector<pair<int, int>>& occVec)
+    {
+        for (auto& o : occ)
+        {
+            if (CheckOverlap(o, occVec))
+                return true;
+        }
+        return false;
+    }
+
     template <class ElemType>
     void OptimizedMemoryAllocationFunc()
     {
@@ -176,14 +292,12 @@ private:
                         // since we assign from highest memory to lowest, every memory that has been allocated can accommodate the 
                         // current memory request, unless there is a conflict (overlap) 
                         auto iter = memAllocInfoVec.begin();
-                        while (iter != memAllocInfoVec.end() && CheckOverlap(make_pair(memInfo.allocStep, memInfo.releaseStep), iter->occupancy))
+                        while (iter != memAllocInfoVec.end() && CheckOverlap(memInfo.GetOccupancy(), iter->occupancy))
                             iter++;
                         if (iter == memAllocInfoVec.end())
                         {
                             // no current memory can be assigned, need to create a new one 
-                            vector<pair<int, int>> occ;
-                            occ.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
-                            MemAllocInfo ma(memoryCounter, memInfo.matrixSize, occ);
+                            MemAllocInfo ma(memoryCounter, memInfo.matrixSize, memInfo.GetOccupancy());
                             // insert in the front of the vector to maintain sorted order 
                             memAllocInfoVec.insert(memAllocInfoVec.begin(), ma);
                             memInfo.SetMemoryId(memoryCounter);
@@ -191,15 +305,14 @@ private:
                         }
                         else
                         {
-                            iter->occupancy.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
+                            auto occ = memInfo.GetOccupancy();
+                            iter->occupancy.insert(iter->occupancy.end(), occ.begin(), occ.end());
                             memInfo.SetMemoryId(iter->memoryId);
                         }
                     }
                     else
                     {
-                        vector<pair<int, int>> occ;
-                        occ.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
-                        MemAllocInfo ma(memoryCounter, memInfo.matrixSize, occ);
+                        MemAllocInfo ma(memoryCounter, memInfo.matrixSize, memInfo.GetOccupancy());
                         memAllocInfoVec.push_back(ma);
                         memInfo.SetMemoryId(memoryCounter);
                         memoryCounter++;
@@ -219,29 +332,26 @@ private:
                         auto workingAlloc = memAllocInfoVec.end();
                         for (auto iter = memAllocInfoVec.begin(); iter != memAllocInfoVec.end(); iter++)
                         {
-                            if (!CheckOverlap(make_pair(memInfo.allocStep, memInfo.releaseStep), iter->occupancy))
+                            if (!CheckOverlap(memInfo.GetOccupancy(), iter->occupancy))
                                 workingAlloc = iter;
                         }
                         if (workingAlloc == memAllocInfoVec.end())  // nothing works 
                         {
-                            vector<pair<int, int>> occ;
-                            occ.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
-                            MemAllocInfo ma(memoryCounter, memInfo.matrixSize, occ);
+                            MemAllocInfo ma(memoryCounter, memInfo.matrixSize, memInfo.GetOccupancy());
                             memAllocInfoVec.push_back(ma);  // add as the last one 
                             memInfo.SetMemoryId(memoryCounter);
                             memoryCounter++;
                         }
                         else
                         {
-                            workingAlloc->occupancy.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
+                            auto occ = memInfo.GetOccupancy();
+                            workingAlloc->occupancy.insert(workingAlloc->occupancy.end(), occ.begin(), occ.end());
                             memInfo.SetMemoryId(workingAlloc->memoryId);
                         }
                     }
                     else
                     {
-                        vector<pair<int, int>> occ;
-                        occ.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
-                        MemAllocInfo ma(memoryCounter, memInfo.matrixSize, occ);
+                        MemAllocInfo ma(memoryCounter, memInfo.matrixSize, memInfo.GetOccupancy());
                         memAllocInfoVec.push_back(ma);
                         memInfo.SetMemoryId(memoryCounter);
                         memoryCounter++;
@@ -254,6 +364,7 @@ private:
                     auto matrixPtr = make_shared<Matrix<ElemType>>(devId);
                     if (!matrixPtr) // this can't really happen, because we haven't started allocating memory yet
                         LogicError("MatrixPool: failed to get a valid matrix.");
+                    GetBuffers<ElemType>().push_back(matrixPtr);
                     for (auto& memInfo : memInfoVec)
                     {
                         if (memInfo.deviceId == devId && memInfo.isWorkSpace == wsFlag && memInfo.memoryId == i)
@@ -0,0 +1,196 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MemoryPlan.cpp -- places the shared matrices of a network into one arena per minibatch shape in inference mode
+//
+
+#include "stdafx.h"
+#include "MemoryPlan.h"
+#include "InputAndParamNodes.h"
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+void MemoryPlanCache::Initialize(const std::vector<ComputationNodeBasePtr>& nodes)
+{
+    m_inputs.clear();
+    for (const auto& node : nodes)
+    {
+        if (node->IsLeaf() && node->OperationName() != OperationNameOf(LearnableParameter))
+            m_inputs.push_back(node);
+    }
+    m_timeStamps.assign(m_inputs.size(), 0);
+    m_initialized = true;
+}
+
+MemoryPlanCache::Key MemoryPlanCache::GetKey() const
+{
+    Key key;
+    for (const auto& input : m_inputs)
+    {
+        const auto& layout = input->GetMBLayout();
+        if (layout)
+            key.push_back(std::make_pair(layout->GetNumParallelSequences(), layout->GetNumTimeSteps()));
+    }
+    return key;
+}
+
+void MemoryPlanCache::Prepare(MatrixPool& pool, bool isInferring)
+{
+    // which inputs were set since the last pass
+    bool anySet = false;
+    bool allSet = true;
+    for (size_t i = 0; i < m_inputs.size(); i++)
+    {
+        const uint64_t timeStamp = m_inputs[i]->GetEvalTimeStamp();
+        if (timeStamp != m_timeStamps[i])
+            anySet = true;
+        else
+            allSet = false;
+        m_timeStamps[i] = timeStamp;
+    }
+
+    if (!isInferring)
+    {
+        if (m_attached)
+            Detach(pool, /*keepValues=*/true);
+        m_attached = m_recording = m_hasKey = false;
+        return;
+    }
+    if (m_hasKey && !anySet)
+        return; // another pass over the same minibatch
+
+    // the sizes of the last minibatch, including the matrices that did not fit into its plan
+    if (m_recording || m_attached)
+        Record(pool, m_plans[m_key]);
+    m_recording = false;
+
+    const Key key = GetKey();
+    if (m_hasKey && key == m_key)
+        return;
+    m_key = key;
+    m_hasKey = true;
+
+    auto iter = m_plans.find(key);
+    if (!allSet)
+    {
+        // some values stay as they are
+        if (m_attached)
+            Detach(pool, /*keepValues=*/true);
+        m_attached = false;
+    }
+    else if (iter != m_plans.end())
+    {
+        Apply(pool, iter->second);
+        m_attached = true;
+    }
+    else if (m_plans.size() < s_maxPlans)
+    {
+        Detach(pool, /*keepValues=*/false);
+        m_attached = false;
+        m_recording = true;
+    }
+    else if (m_attached)
+    {
+        Detach(pool, /*keepValues=*/true);
+        m_attached = false;
+    }
+}
+
+void MemoryPlanCache::Clear(MatrixPool& pool)
+{
+    if (m_attached)
+        Detach(pool, /*keepValues=*/true);
+    m_attached = m_recording = m_hasKey = m_initialized = false;
+    m_plans.clear();
+    m_floatArenas.clear();
+    m_doubleArenas.clear();
+    m_inputs.clear();
+    m_timeStamps.clear();
+}
+
+void MemoryPlanCache::Record(MatrixPool& pool, MemoryPlan& plan) const
+{
+    RecordFunc(pool.GetBuffers<float>(), plan.floatSizes);
+    RecordFunc(pool.GetBuffers<double>(), plan.doubleSizes);
+}
+
+void MemoryPlanCache::Apply(MatrixPool& pool, const MemoryPlan& plan)
+{
+    ApplyFunc(pool.GetBuffers<float>(), plan.floatSizes, m_floatArenas);
+    ApplyFunc(pool.GetBuffers<double>(), plan.doubleSizes, m_doubleArenas);
+}
+
+// keepValues=false empties all matrices, so that the next pass shows how large they get
+void MemoryPlanCache::Detach(MatrixPool& pool, bool keepValues)
+{
+    DetachFunc(pool.GetBuffers<float>(), keepValues);
+    DetachFunc(pool.GetBuffers<double>(), keepValues);
+}
+
+// a matrix in the arena has the size of the plan; one that outgrew it has a buffer of its own
+template <class ElemType>
+/*static*/ void MemoryPlanCache::RecordFunc(const std::vector<shared_ptr<Matrix<ElemType>>>& buffers, std::vector<size_t>& sizes)
+{
+    sizes.resize(buffers.size(), 0);
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        if (IsPlaceable(*buffers[i]) && buffers[i]->OwnBuffer())
+            sizes[i] = std::max(sizes[i], buffers[i]->GetAllocatedSize());
+    }
+}
+
+template <class ElemType>
+/*static*/ void MemoryPlanCache::ApplyFunc(const std::vector<shared_ptr<Matrix<ElemType>>>& buffers, const std::vector<size_t>& sizes,
+                                           std::map<DEVICEID_TYPE, shared_ptr<Matrix<ElemType>>>& arenas)
+{
+    // lay out the matrices of each device one after the other
+    std::vector<size_t> offsets(buffers.size(), 0);
+    std::map<DEVICEID_TYPE, size_t> arenaSizes;
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        if (!IsPlaceable(*buffers[i]))
+            continue;
+        size_t& arenaSize = arenaSizes[buffers[i]->GetDeviceId()];
+        offsets[i] = arenaSize;
+        arenaSize += (sizes[i] + s_alignment - 1) / s_alignment * s_alignment;
+    }
+
+    // the arenas only grow; the matrices that point into them are placed again below
+    for (const auto& arenaSize : arenaSizes)
+    {
+        auto& arena = arenas[arenaSize.first];
+        if (!arena)
+            arena = make_shared<Matrix<ElemType>>(arenaSize.first);
+        if (arenaSize.second > 0)
+            arena->Resize(1, arenaSize.second);
+    }
+
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        if (!IsPlaceable(*buffers[i]))
+            continue;
+        const DEVICEID_TYPE deviceId = buffers[i]->GetDeviceId();
+        if (sizes[i] == 0) // not used by this key so far
+            *buffers[i] = Matrix<ElemType>(deviceId);
+        else
+            *buffers[i] = Matrix<ElemType>(1, sizes[i], arenas[deviceId]->Data() + offsets[i], deviceId, matrixFlagDontOwnBuffer | matrixFlagMovableBuffer);
+    }
+}
+
+template <class ElemType>
+/*static*/ void MemoryPlanCache::DetachFunc(const std::vector<shared_ptr<Matrix<ElemType>>>& buffers, bool keepValues)
+{
+    for (const auto& buffer : buffers)
+    {
+        if (!IsPlaceable(*buffer) || (keepValues && buffer->OwnBuffer()))
+            continue;
+        Matrix<ElemType> owned(buffer->GetDeviceId());
+        if (keepValues)
+            owned.SetValue(*buffer);
+        *buffer = std::move(owned);
+    }
+}
+
+}}}
@@ -0,0 +1,91 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MemoryPlan.h -- places the shared matrices of a network into one arena per minibatch shape in inference mode
+//
+// The MatrixPool shares a matrix among the nodes whose values are not needed at the same time, but it cannot know their
+// sizes, which depend on the minibatch. Every node resizes its value in BeginForwardProp(), and a shared matrix grows to
+// the largest minibatch seen so far. An evaluation service that sees minibatches of many shapes pays for reallocation
+// whenever a larger one arrives, and keeps the memory of the largest one.
+// With memoryPlans=true, the forward passes in inference mode are grouped by their key, the number of parallel sequences
+// and time steps of the MBLayouts of the input nodes. The first pass of a key starts with empty matrices, and records how
+// large each of them became into a MemoryPlan. A later minibatch of that key points each matrix at its offset into one
+// arena per device, which is only reallocated when it grows; switching between known keys is a pointer assignment.
+//
+// The matrices are placed with matrixFlagMovableBuffer: a node that needs more than the plan provides (e.g. a key that
+// does not determine all sizes, or roots that were not evaluated when the plan was recorded) resizes into a buffer of its
+// own, and the plan grows to that size for the next minibatch. Values are only moved without copying when all inputs were
+// set since the last pass, so that all values in the pool are computed again; otherwise they are copied out of the arena.
+// At most s_maxPlans keys get a plan. Plans are dropped when the network is recompiled.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "MatrixPool.h"
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MemoryPlanCache
+{
+public:
+    static const size_t s_maxPlans = 64;
+    static const size_t s_alignment = 64; // in elements
+
+    bool IsInitialized() const { return m_initialized; }
+
+    // 'nodes' are all nodes of the network; the input nodes among them determine the key
+    void Initialize(const std::vector<ComputationNodeBasePtr>& nodes);
+
+    // Called before each forward pass. Places the matrices of 'pool' for the minibatch of the input nodes.
+    void Prepare(MatrixPool& pool, bool isInferring);
+
+    // moves the matrices out of the arena (keeping their values) and forgets all plans
+    void Clear(MatrixPool& pool);
+
+private:
+    typedef std::vector<std::pair<size_t, size_t>> Key; // parallel sequences and time steps of each input layout
+
+    struct MemoryPlan
+    {
+        std::vector<size_t> floatSizes; // per buffer of the pool, in elements
+        std::vector<size_t> doubleSizes;
+    };
+
+    Key GetKey() const;
+
+    void Record(MatrixPool& pool, MemoryPlan& plan) const;
+    void Apply(MatrixPool& pool, const MemoryPlan& plan);
+    void Detach(MatrixPool& pool, bool keepValues);
+
+    template <class ElemType>
+    static void RecordFunc(const std::vector<shared_ptr<Matrix<ElemType>>>& buffers, std::vector<size_t>& sizes);
+    template <class ElemType>
+    static void ApplyFunc(const std::vector<shared_ptr<Matrix<ElemType>>>& buffers, const std::vector<size_t>& sizes,
+                          std::map<DEVICEID_TYPE, shared_ptr<Matrix<ElemType>>>& arenas);
+    template <class ElemType>
+    static void DetachFunc(const std::vector<shared_ptr<Matrix<ElemType>>>& buffers, bool keepValues);
+    template <class ElemType>
+    static bool IsPlaceable(const Matrix<ElemType>& buffer) { return buffer.GetMatrixType() == DENSE; }
+
+    bool m_initialized = false;
+    std::vector<ComputationNodeBasePtr> m_inputs;
+    std::vector<uint64_t> m_timeStamps; // of m_inputs, as of the last pass
+
+    Key m_key;                  // of the current minibatch
+    bool m_hasKey = false;      // m_key is set, i.e. the last pass was in inference mode
+    bool m_recording = false;   // the matrices were emptied for the current key, which has no plan yet
+    bool m_attached = false;    // the matrices are placed by the plan of the current key
+    std::map<Key, MemoryPlan> m_plans;
+
+    std::map<DEVICEID_TYPE, shared_ptr<Matrix<float>>> m_floatArenas;
+    std::map<DEVICEID_TYPE, shared_ptr<Matrix<double>>> m_doubleArenas;
+};
+
+}}}
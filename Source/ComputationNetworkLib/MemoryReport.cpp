@@ -0,0 +1,198 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MemoryReport.cpp -- machine-readable report of how MatrixPool laid out the matrices of a network
+//
+
+#include "stdafx.h"
+#include "MemoryReport.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+std::wstring MemoryReport::s_outputPath;
+
+static std::string JsonString(const std::string& s)
+{
+    std::string result = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char) c >= 0x20)
+            result += c;
+    }
+    return result + "\"";
+}
+
+static std::string JsonString(const std::wstring& s)
+{
+    return JsonString(std::string(msra::strfun::utf8(s)));
+}
+
+template <class T>
+static std::string JsonList(const std::vector<T>& items)
+{
+    std::string result = "[";
+    for (const auto& item : items)
+        result += (result.size() > 1 ? "," : "") + std::to_string(item);
+    return result + "]";
+}
+
+void MemoryReport::Write(const std::wstring& path) const
+{
+    auto bytes = [](const Request& r) { return r.numElements * r.elementSize; };
+
+    FILE* f = fopenOrDie(path, L"w");
+
+    auto step = [](int s) { return s == INT_MAX ? std::string("null") : std::to_string(s); };
+
+    // requests
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        const auto& r = requests[i];
+        std::string recomputeSteps = "[";
+        for (const auto& steps : r.reallocSteps)
+            recomputeSteps += (recomputeSteps.size() > 1 ? ",[" : "[") + step(steps.first) + "," + step(steps.second) + "]";
+        recomputeSteps += "]";
+        fprintf(f, "{\"type\":\"request\",\"id\":%d,\"node\":%s,\"kind\":%s,\"device\":%d,\"bytes\":%llu,\"perSample\":%s,\"workspace\":%s,\"allocStep\":%d,\"releaseStep\":%s,\"recomputeSteps\":%s,\"buffer\":%d}\n",
+                (int) i, JsonString(r.owner).c_str(), JsonString(r.kind).c_str(), r.deviceId, (unsigned long long) bytes(r),
+                r.perSample ? "true" : "false", r.isWorkSpace ? "true" : "false", r.allocStep,
+                step(r.releaseStep).c_str(), recomputeSteps.c_str(), (int) r.buffer);
+    }
+
+    // buffers
+    std::vector<size_t> bufferBytes(numBuffers, 0), bufferBytesPerSample(numBuffers, 0);
+    std::vector<std::vector<size_t>> bufferRequests(numBuffers);
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        const auto& r = requests[i];
+        auto& size = r.perSample ? bufferBytesPerSample[r.buffer] : bufferBytes[r.buffer];
+        size = std::max(size, bytes(r));
+        bufferRequests[r.buffer].push_back(i);
+    }
+    size_t totalBytes = 0, totalBytesPerSample = 0;
+    for (size_t b = 0; b < numBuffers; b++)
+    {
+        const auto& first = requests[bufferRequests[b].front()];
+        fprintf(f, "{\"type\":\"buffer\",\"id\":%d,\"device\":%d,\"workspace\":%s,\"bytes\":%llu,\"bytesPerSample\":%llu,\"requests\":%s}\n",
+                (int) b, first.deviceId, first.isWorkSpace ? "true" : "false", (unsigned long long) bufferBytes[b],
+                (unsigned long long) bufferBytesPerSample[b], JsonList(bufferRequests[b]).c_str());
+        totalBytes += bufferBytes[b];
+        totalBytesPerSample += bufferBytesPerSample[b];
+    }
+
+    // timeline: a request is live from its allocation step up to and including its release step, as in MatrixPool
+    std::map<int, std::pair<std::vector<size_t>, std::vector<size_t>>> events; // [step] -> (allocated, released)
+    size_t unsharedBytes = 0, unsharedBytesPerSample = 0;
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        events[requests[i].allocStep].first.push_back(i);
+        if (requests[i].releaseStep != INT_MAX)
+            events[requests[i].releaseStep].second.push_back(i);
+        for (const auto& steps : requests[i].reallocSteps)
+        {
+            events[steps.first].first.push_back(i);
+            if (steps.second != INT_MAX)
+                events[steps.second].second.push_back(i);
+        }
+        (requests[i].perSample ? unsharedBytesPerSample : unsharedBytes) += bytes(requests[i]);
+    }
+    size_t liveBytes = 0, liveBytesPerSample = 0;
+    int peakStep = -1;
+    size_t peakBytes = 0, peakBytesPerSample = 0;
+    for (const auto& event : events)
+    {
+        std::set<std::wstring> nodes;
+        for (size_t i : event.second.first)
+        {
+            (requests[i].perSample ? liveBytesPerSample : liveBytes) += bytes(requests[i]);
+            nodes.insert(requests[i].owner);
+        }
+        for (size_t i : event.second.second)
+            nodes.insert(requests[i].owner);
+
+        std::string nodeList = "[";
+        for (const auto& node : nodes)
+            nodeList += (nodeList.size() > 1 ? "," : "") + JsonString(node);
+        nodeList += "]";
+        fprintf(f, "{\"type\":\"step\",\"step\":%d,\"nodes\":%s,\"allocated\":%s,\"released\":%s,\"liveBytes\":%llu,\"liveBytesPerSample\":%llu}\n",
+                event.first, nodeList.c_str(), JsonList(event.second.first).c_str(), JsonList(event.second.second).c_str(),
+                (unsigned long long) liveBytes, (unsigned long long) liveBytesPerSample);
+
+        if (peakStep < 0 || std::make_pair(liveBytesPerSample, liveBytes) > std::make_pair(peakBytesPerSample, peakBytes))
+        {
+            peakStep = event.first;
+            peakBytes = liveBytes;
+            peakBytesPerSample = liveBytesPerSample;
+        }
+
+        for (size_t i : event.second.second)
+            (requests[i].perSample ? liveBytesPerSample : liveBytes) -= bytes(requests[i]);
+    }
+
+    // totals; the peak is the step with the most bytes per sample, i.e. the one that dominates for large minibatches
+    fprintf(f, "{\"type\":\"summary\",\"requests\":%d,\"buffers\":%d,\"bytes\":%llu,\"bytesPerSample\":%llu,\"unsharedBytes\":%llu,\"unsharedBytesPerSample\":%llu,\"peakStep\":%d,\"peakBytes\":%llu,\"peakBytesPerSample\":%llu}\n",
+            (int) requests.size(), (int) numBuffers, (unsigned long long) totalBytes, (unsigned long long) totalBytesPerSample,
+            (unsigned long long) unsharedBytes, (unsigned long long) unsharedBytesPerSample, peakStep,
+            (unsigned long long) peakBytes, (unsigned long long) peakBytesPerSample);
+    fcloseOrDie(f);
+}
+
+std::set<int> MemoryReport::GetDevices() const
+{
+    std::set<int> devices;
+    for (const auto& r : requests)
+        devices.insert(r.deviceId);
+    return devices;
+}
+
+size_t MemoryReport::GetBufferBytes(int deviceId, size_t numSamples) const
+{
+    std::vector<size_t> bufferBytes(numBuffers, 0);
+    for (const auto& r : requests)
+    {
+        if (r.deviceId == deviceId)
+            bufferBytes[r.buffer] = std::max(bufferBytes[r.buffer], r.numElements * r.elementSize * (r.perSample ? numSamples : 1));
+    }
+    size_t totalBytes = 0;
+    for (size_t bytes : bufferBytes)
+        totalBytes += bytes;
+    return totalBytes;
+}
+
+size_t MemoryReport::GetMaxSamples(int deviceId, size_t budgetBytes, size_t fixedBytes) const
+{
+    auto fits = [&](size_t numSamples) { return fixedBytes + GetBufferBytes(deviceId, numSamples) <= budgetBytes; };
+    if (fixedBytes > budgetBytes || !fits(1))
+        return 0;
+
+    // each buffer that grows with the minibatch takes at least the bytes per sample of its largest request
+    std::map<size_t, size_t> bufferBytesPerSample;
+    for (const auto& r : requests)
+    {
+        if (r.deviceId == deviceId && r.perSample)
+            bufferBytesPerSample[r.buffer] = std::max(bufferBytesPerSample[r.buffer], r.numElements * r.elementSize);
+    }
+    size_t bytesPerSample = 0;
+    for (const auto& buffer : bufferBytesPerSample)
+        bytesPerSample += buffer.second;
+    if (bytesPerSample == 0)
+        return SIZE_MAX;
+
+    // the bytes grow monotonically with the samples, so bisect between a size that fits and one that does not
+    size_t fitting = 1, notFitting = budgetBytes / bytesPerSample + 1;
+    while (notFitting - fitting > 1)
+    {
+        size_t numSamples = fitting + (notFitting - fitting) / 2;
+        (fits(numSamples) ? fitting : notFitting) = numSamples;
+    }
+    return fitting;
+}
+
+}}}
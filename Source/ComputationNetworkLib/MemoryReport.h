@@ -0,0 +1,73 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MemoryReport.h -- machine-readable report of how MatrixPool laid out the matrices of a network
+//
+// With memoryReport=<file>, AllocateAllMatrices() writes one JSON object per line to <file>:
+//  - {"type":"request", ...} for each matrix that a node requested from the pool: the owning node, its kind (value,
+//    gradient, workspace, temp), its size, and the steps at which it was allocated and released in the simulated
+//    forward/backward pass, as well as the shared buffer it was assigned to. Values that are recomputed in the backward pass
+//    (gradient checkpointing) are live again from the step of their recomputation ("recomputeSteps", pairs of allocation and release).
+//  - {"type":"buffer", ...} for each shared buffer: its size (the largest request assigned to it) and its requests.
+//  - {"type":"step", ...} for each step of the simulation: the request allocated or released, and the bytes of all
+//    requests live at that step, i.e. what would be needed without sharing. The largest of these is the peak.
+// Sizes of requests that scale with the minibatch are per sample (perSample:true); their bytes are multiplied by the number
+// of samples in a minibatch. Such sizes are split from the fixed ones in the totals ("bytes" and "bytesPerSample").
+// A size of 0 means that the node did not declare one. Sparse matrices do not take part in sharing and are not reported.
+//
+// GetMaxSamples() uses the same sizes to find the largest minibatch whose buffers fit into a memory budget (memoryBudgetMB in SGD).
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <string>
+#include <set>
+#include <vector>
+#include <utility>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct MemoryReport
+{
+    struct Request
+    {
+        std::wstring owner; // node name
+        std::string kind;   // value, gradient, workspace, temp
+        int deviceId;
+        size_t elementSize;
+        size_t numElements; // per sample if perSample
+        bool perSample;
+        bool isWorkSpace;
+        int allocStep;
+        int releaseStep;    // INT_MAX if never released
+        size_t buffer;      // index into the report's buffers
+        std::vector<std::pair<int, int>> reallocSteps; // further [allocStep, releaseStep] if recomputed
+    };
+
+    std::vector<Request> requests;
+    size_t numBuffers = 0;
+
+    // writes the report in the format described above
+    void Write(const std::wstring& path) const;
+
+    // the devices that the requests are on
+    std::set<int> GetDevices() const;
+
+    // bytes of the buffers of a device for minibatches of numSamples samples; a buffer is as large as the largest of its requests
+    size_t GetBufferBytes(int deviceId, size_t numSamples) const;
+
+    // the largest number of samples for which the buffers of a device and fixedBytes fit into budgetBytes;
+    // SIZE_MAX if no buffer grows with the minibatch, 0 if not even a single sample fits
+    size_t GetMaxSamples(int deviceId, size_t budgetBytes, size_t fixedBytes = 0) const;
+
+    // the file to write the report of the next AllocateAllMatrices() to; empty (default) for none
+    static void SetOutputPath(const std::wstring& path) { s_outputPath = path; }
+    static const std::wstring& GetOutputPath() { return s_outputPath; }
+
+private:
+    static std::wstring s_outputPath;
+};
+
+}}}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NativeUserOp.cpp -- registry of native C++ implementations of V2 user-defined Functions
+//
+
+#include "stdafx.h"
+#include "NativeUserOp.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace
+{
+    template <class ElemType>
+    struct FactoryMethods
+    {
+        std::mutex mutex;
+        std::unordered_map<std::wstring, typename NativeUserOpRegistry<ElemType>::FactoryMethod> map;
+    };
+
+    // defined in this translation unit, so that ops registered by any module that links the library are found
+    template <class ElemType>
+    FactoryMethods<ElemType>& GetFactoryMethods()
+    {
+        static FactoryMethods<ElemType> factoryMethods;
+        return factoryMethods;
+    }
+}
+
+template <class ElemType>
+/*static*/ void NativeUserOpRegistry<ElemType>::Register(const std::wstring& uniqueOpName, const FactoryMethod& factoryMethod)
+{
+    if (!factoryMethod)
+        InvalidArgument("NativeUserOp with op name '%ls' is registered without a factory method.", uniqueOpName.c_str());
+
+    auto& factoryMethods = GetFactoryMethods<ElemType>();
+    std::lock_guard<std::mutex> lock(factoryMethods.mutex);
+    if (!factoryMethods.map.insert(std::make_pair(uniqueOpName, factoryMethod)).second)
+        InvalidArgument("NativeUserOp with op name '%ls' is already registered. All NativeUserOp op names must be unique.", uniqueOpName.c_str());
+}
+
+template <class ElemType>
+/*static*/ std::shared_ptr<NativeUserOp<ElemType>> NativeUserOpRegistry<ElemType>::CreateInstance(const ::CNTK::Function& function)
+{
+    FactoryMethod factoryMethod;
+    {
+        auto& factoryMethods = GetFactoryMethods<ElemType>();
+        std::lock_guard<std::mutex> lock(factoryMethods.mutex);
+        auto iter = factoryMethods.map.find(function.OpName());
+        if (iter == factoryMethods.map.end())
+            return nullptr;
+        factoryMethod = iter->second;
+    }
+
+    auto op = factoryMethod(function);
+    if (!op)
+        LogicError("The factory method of NativeUserOp '%ls' returned no op for Function '%ls'.", function.OpName().c_str(), function.Name().c_str());
+    return op;
+}
+
+template class NativeUserOpRegistry<float>;
+template class NativeUserOpRegistry<double>;
+
+}}}
@@ -0,0 +1,80 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NativeUserOp.h -- native C++ implementations of V2 user-defined Functions that work on the matrices of the network
+//
+// A V2 user-defined Function is evaluated by a UserDefinedV2FunctionNode, which wraps the input matrices into Values,
+// calls Function::Forward() resp. Backward(), and copies the resulting Values back into its matrices, for every minibatch.
+// A NativeUserOp registered for the op name of the Function replaces these calls: the node hands it the value and gradient
+// matrices of its inputs and outputs, with their sample shapes and MBLayouts, and the op computes in place. It thus runs
+// like a built-in node, on the device of the network and in its order of kernel launches.
+//
+// The Function still defines the outputs (InferOutputs()), and is what gets cloned and serialized; its Forward() and
+// Backward() are only called by the nodes of ops that are not registered. The outputs of a native op must either have no
+// dynamic axes, or the dynamic axes of one of its inputs, whose MBLayout they share.
+//
+// Registration is process-wide, and must happen before the networks of the Functions are created, e.g.
+//
+//     NativeUserOpRegistry<float>::Register(L"MyOp", [](const ::CNTK::Function&) { return std::make_shared<MyOp<float>>(); });
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "Sequences.h"
+#include "TensorShape.h"
+#include "TensorView.h"
+#include "CNTKLibrary.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// an input or output of a native op
+template <class ElemType>
+struct NativeUserOpOperand
+{
+    std::shared_ptr<Matrix<ElemType>> value;    // one column per sample of 'layout', or a single column if it is null
+    std::shared_ptr<Matrix<ElemType>> gradient; // null unless the gradient is computed resp. needed by Backward()
+    TensorShape sampleLayout;
+    MBLayoutPtr layout;
+
+    TensorView<ElemType> ValueTensor() const    { return TensorView<ElemType>(value, AsTensorShape()); }
+    TensorView<ElemType> GradientTensor() const { return TensorView<ElemType>(gradient, AsTensorShape()); }
+
+private:
+    // the sample layout with the columns as the last axis
+    TensorShape AsTensorShape() const { return sampleLayout.Append(sampleLayout.GetRank(), value->GetNumCols()); }
+};
+
+template <class ElemType>
+class NativeUserOp
+{
+public:
+    virtual ~NativeUserOp() {}
+
+    // computes the values of 'outputs', which are sized already, from those of 'inputs'; the inputs are in the order of
+    // Function::Inputs() without duplicates, including the parameters
+    virtual void Forward(const std::vector<NativeUserOpOperand<ElemType>>& inputs, const std::vector<NativeUserOpOperand<ElemType>>& outputs, bool isTraining) = 0;
+
+    // adds the gradient of inputs[inputIndex] to its gradient matrix, given the gradients of the outputs that need one;
+    // values are those of the last Forward()
+    virtual void Backward(size_t inputIndex, const std::vector<NativeUserOpOperand<ElemType>>& inputs, const std::vector<NativeUserOpOperand<ElemType>>& outputs) = 0;
+};
+
+template <class ElemType>
+class NativeUserOpRegistry
+{
+public:
+    typedef std::function<std::shared_ptr<NativeUserOp<ElemType>>(const ::CNTK::Function&)> FactoryMethod;
+
+    static void Register(const std::wstring& uniqueOpName, const FactoryMethod& factoryMethod);
+
+    // the op for a Function with this op name, or nullptr if none is registered
+    static std::shared_ptr<NativeUserOp<ElemType>> CreateInstance(const ::CNTK::Function& function);
+};
+
+}}}
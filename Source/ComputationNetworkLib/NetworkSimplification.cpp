@@ -0,0 +1,204 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NetworkSimplification.cpp -- common-subexpression elimination and algebraic simplification of a validated network
+//
+// Networks built from the V2 API or from BrainScript macros often compute the same subexpression more than once, e.g. the
+// same Reshape, Slice or Times of the same inputs, or contain operations without effect. With simplifyNetwork=true,
+// ComputationNetwork::CompileNetwork() lets the consumers of such a node read an equivalent node instead:
+//  - a node that ComputesSameValueAs() an earlier node of the same type and sample layout over the same inputs,
+//  - a TransposeDimensions of a TransposeDimensions that swaps the same axes back: the input of the inner one,
+//  - a Reshape of all axes of a Reshape: the outer one reads the input of the inner one,
+//  - a Reshape to the sample layout of its input, x .* 1, 1 .* x, x + 0, 0 + x and x - 0: x.
+// A replacement must have the sample layout, MBLayout and precision of the node, and neither may be in a recurrent loop.
+// Learnable parameters with a learning-rate multiplier of 0 count as constants, so their values must not change after
+// the network is compiled. Nodes that are left without consumers and are not in a node group (criteria, outputs, etc.)
+// are deleted, so they are neither computed nor allocated, and the passes that follow see a single consumer where there
+// were duplicates. As the graph changes, the network is then compiled once more. Saved models contain the simplified network.
+//
+
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "ReshapingNodes.h"
+#include <map>
+#include <memory>
+#include <set>
+#include <typeinfo>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// whether 'node' can be read instead of 'replaced'
+static bool CanStandIn(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& replaced)
+{
+    return node != replaced && !node->IsPartOfLoop() && !replaced->IsPartOfLoop() &&
+           node->GetSampleLayout() == replaced->GetSampleLayout() && node->GetMBLayout() == replaced->GetMBLayout() &&
+           node->Is<ComputationNode<float>>() == replaced->Is<ComputationNode<float>>() &&
+           node->Is<ComputationNode<double>>() == replaced->Is<ComputationNode<double>>();
+}
+
+// whether 'node' is a constant all of whose elements are 'value'
+template <class ElemType>
+static bool IsConstantOf(const ComputationNodeBasePtr& node, ElemType value)
+{
+    const size_t maxNumElementsToCheck = 4096;
+    if (!node->Is<LearnableParameter<ElemType>>() || node->GetLearningRateMultiplier() != 0 || node->HasMBLayout())
+        return false;
+
+    auto& matrix = node->As<ComputationNode<ElemType>>()->Value();
+    if (matrix.GetMatrixType() != MatrixType::DENSE || matrix.GetNumElements() == 0 || matrix.GetNumElements() > maxNumElementsToCheck)
+        return false;
+
+    std::unique_ptr<ElemType[]> elements(matrix.CopyToArray());
+    for (size_t i = 0; i < matrix.GetNumElements(); i++)
+    {
+        if (elements[i] != value)
+            return false;
+    }
+    return true;
+}
+
+// the node that 'node' can be replaced with by an algebraic identity, or nullptr
+template <class ElemType>
+static ComputationNodeBasePtr AlgebraicReplacement(const ComputationNodeBasePtr& node)
+{
+    if (auto transpose = dynamic_pointer_cast<TransposeDimensionsNode<ElemType>>(node))
+    {
+        auto innerTranspose = dynamic_pointer_cast<TransposeDimensionsNode<ElemType>>(node->Input(0));
+        if (innerTranspose && transpose->ComputesSameValueAs(*innerTranspose)) // (swapping the same two axes)
+            return node->Input(0)->Input(0);
+    }
+    else if (node->Is<ReshapeNode<ElemType>>())
+        return node->Input(0);
+    else if (node->Is<ElementTimesNode<ElemType>>())
+    {
+        if (IsConstantOf<ElemType>(node->Input(1), 1))
+            return node->Input(0);
+        if (IsConstantOf<ElemType>(node->Input(0), 1))
+            return node->Input(1);
+    }
+    else if (node->Is<PlusNode<ElemType>>())
+    {
+        if (IsConstantOf<ElemType>(node->Input(1), 0))
+            return node->Input(0);
+        if (IsConstantOf<ElemType>(node->Input(0), 0))
+            return node->Input(1);
+    }
+    else if (node->Is<MinusNode<ElemType>>())
+    {
+        if (IsConstantOf<ElemType>(node->Input(1), 0))
+            return node->Input(0);
+    }
+    return nullptr;
+}
+
+// lets a Reshape of all axes of a Reshape read the input of the inner one; returns whether it did
+template <class ElemType>
+static bool ShortCutReshapeChain(const ComputationNodeBasePtr& node)
+{
+    auto reshape = dynamic_pointer_cast<ReshapeNode<ElemType>>(node);
+    if (!reshape || !reshape->ReshapesAllAxes() || !node->Input(0)->Is<ReshapeNode<ElemType>>() || node->Input(0)->IsPartOfLoop())
+        return false;
+
+    node->SetInput(0, node->Input(0)->Input(0));
+    return true;
+}
+
+// Simplifies the validated network as described above. Returns whether the graph has changed, in which case it must be
+// compiled again.
+bool ComputationNetwork::SimplifyNetwork()
+{
+    std::set<ComputationNodeBasePtr> groupNodes;
+    for (auto group : GetAllNodeGroups())
+        groupNodes.insert(group->begin(), group->end());
+
+    std::map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        for (const auto& input : node->GetInputs())
+            numConsumers[input]++;
+    }
+
+    // inputs come first in the evaluation order, so each node reads the replacements of its inputs before it is looked at
+    std::map<ComputationNodeBasePtr, ComputationNodeBasePtr> replacements;
+    std::map<std::pair<std::string, std::vector<ComputationNodeBasePtr>>, std::vector<ComputationNodeBasePtr>> candidates; // by type and inputs
+    size_t numRewiredInputs = 0;
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            auto replacement = replacements.find(node->Input(i));
+            if (replacement != replacements.end())
+            {
+                node->SetInput(i, replacement->second);
+                numRewiredInputs++;
+            }
+        }
+        if (node->IsLeaf() || node->IsPartOfLoop())
+            continue;
+
+        bool isFloat = node->Is<ComputationNode<float>>();
+        if (isFloat ? ShortCutReshapeChain<float>(node) : node->Is<ComputationNode<double>>() && ShortCutReshapeChain<double>(node))
+            numRewiredInputs++;
+
+        ComputationNodeBasePtr replacement = isFloat ? AlgebraicReplacement<float>(node) :
+                                             node->Is<ComputationNode<double>>() ? AlgebraicReplacement<double>(node) : nullptr;
+        if (!replacement || !CanStandIn(replacement, node))
+        {
+            replacement = nullptr;
+            auto& equivalents = candidates[make_pair(std::string(typeid(*node).name()), node->GetInputs())];
+            for (const auto& equivalent : equivalents)
+            {
+                if (CanStandIn(equivalent, node) && node->ComputesSameValueAs(*equivalent))
+                {
+                    replacement = equivalent;
+                    break;
+                }
+            }
+            if (!replacement)
+                equivalents.push_back(node);
+        }
+        if (replacement)
+            replacements[node] = replacement;
+    }
+
+    // delete the nodes that were consumed before and are no longer, unless they are asked for by name
+    std::map<ComputationNodeBasePtr, size_t> numRemainingConsumers;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        for (const auto& input : iter.second->GetInputs())
+            numRemainingConsumers[input]++;
+    }
+    std::vector<ComputationNodeBasePtr> unconsumedNodes;
+    for (const auto& iter : numConsumers)
+    {
+        if (iter.first && numRemainingConsumers[iter.first] == 0 && groupNodes.find(iter.first) == groupNodes.end())
+            unconsumedNodes.push_back(iter.first);
+    }
+    size_t numDeletedNodes = 0;
+    while (!unconsumedNodes.empty())
+    {
+        auto node = unconsumedNodes.back();
+        unconsumedNodes.pop_back();
+        if (!NodeNameExists(node->NodeName()) || node->IsLeaf()) // (leaves are inputs and parameters of the model)
+            continue;
+
+        auto inputs = node->GetInputs();
+        DeleteNode(node->NodeName());
+        numDeletedNodes++;
+        for (const auto& input : inputs)
+        {
+            if (input && --numRemainingConsumers[input] == 0 && groupNodes.find(input) == groupNodes.end())
+                unconsumedNodes.push_back(input);
+        }
+    }
+
+    if (TraceLevel() > 0 && (numRewiredInputs > 0 || numDeletedNodes > 0))
+        fprintf(stderr, "\nSimplified the network: %d inputs now read equivalent nodes, %d nodes deleted.\n", (int)numRewiredInputs, (int)numDeletedNodes);
+
+    return numRewiredInputs > 0 || numDeletedNodes > 0;
+}
+
+}}}
@@ -100,6 +100,20 @@ public:
     }
 
     virtual bool ImplementsGradientOverwriteOptimization() const override { return (opType != noGradient); }
+
+    virtual bool IsFusibleElementwiseOp(FusibleElementwiseOp& op) const override
+    {
+        GradientOperationType opTypeHolder = opType; // preventing pragma warning C4127
+        if (opTypeHolder == noGradient)
+            return false;
+        op = FusibleElementwiseOp(opForward, opBackward, opTypeHolder == unaryGradient ? FusibleElementwiseOp::noArg :
+                                                         opTypeHolder == binaryWithInputGradient ? FusibleElementwiseOp::inputValueArg :
+                                                                                                   FusibleElementwiseOp::outputValueArg);
+        return true;
+    }
+
+    virtual bool /*ComputationNodeBase::*/ CanRecomputeValue() const override { return true; }
+    virtual bool /*ComputationNodeBase::*/ ComputesSameValueAs(const ComputationNodeBase& /*other*/) const override { return true; }
 };
 
 #define UnaryElementWiseWithOpCodeNodeBaseMembers UsingComputationNodeMembersBoilerplate;
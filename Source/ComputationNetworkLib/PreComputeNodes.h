@@ -9,6 +9,7 @@
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
 #include "Matrix.h"
+#include "MPIWrapper.h"
 
 #include <iostream>
 #include <list>
@@ -55,10 +56,16 @@ public:
     virtual bool RequiresPreCompute() const override { return true; }
 
     virtual void Save(File& fstream) const override
+    {
+        SaveWithValue(fstream, Value());
+    }
+
+    virtual bool SavesValue() const override { return true; }
+    virtual void SaveWithValue(File& fstream, const MatrixBase& value) const override
     {
         Base::Save(fstream);
         fstream << m_hasComputed;
-        fstream << Value();
+        fstream << dynamic_cast<const Matrix<ElemType>&>(value);
     }
 
     virtual void Load(File& fstream, size_t modelVersion) override
@@ -191,6 +198,26 @@ public:
     }
 
 protected:
+    // Sums the sample counts of the workers into m_numSamples, and returns the share of this worker in the total.
+    double AggregateNumSamples(const MPIWrapper& mpi)
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: AggregateAcrossWorkers() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+
+        size_t numLocalSamples = m_numSamples;
+        mpi.AllReduce(&m_numSamples, 1);
+        return m_numSamples > 0 ? (double)numLocalSamples / m_numSamples : 0;
+    }
+
+    // Sums a matrix over the workers, in place.
+    static void AllReduce(const MPIWrapper& mpi, Matrix<ElemType>& matrix)
+    {
+        std::vector<ElemType> buffer(matrix.GetNumElements());
+        matrix.CopySection(matrix.GetNumRows(), matrix.GetNumCols(), buffer.data(), matrix.GetNumRows());
+        mpi.AllReduce(buffer);
+        matrix.SetValue(matrix.GetNumRows(), matrix.GetNumCols(), matrix.GetDeviceId(), buffer.data());
+    }
+
     size_t m_numSamples; // (SIZE_MAX while outside accumulation state)
     bool IsAccumulating() const { return m_numSamples != SIZE_MAX; }
 };
@@ -199,7 +226,9 @@ protected:
     ComputationNodeBoilerplate;               \
     UsingPreComputedNodeMembers;              \
     using Base::m_numSamples;                 \
-    using Base::IsAccumulating
+    using Base::IsAccumulating;               \
+    using Base::AggregateNumSamples;          \
+    using Base::AllReduce
 
 // -----------------------------------------------------------------------
 // MeanNode (features)
@@ -233,6 +262,14 @@ public:
         // no else branch because ForwardPropNonLooping() already leaves a valid mean in m_value
     }
 
+    // the mean over all workers is the mean of their means, weighted by their sample counts
+    virtual void /*IPreComputeNode::*/ AggregateAcrossWorkers(const MPIWrapper& mpi) override
+    {
+        ElemType weight = (ElemType)AggregateNumSamples(mpi);
+        Value() *= weight;
+        AllReduce(mpi, Value());
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(InputRef(0).GetMBLayout());
@@ -300,6 +337,23 @@ public:
         }
     }
 
+    // Combines the means and variances of the workers as Chan et al. do: the variance over all workers is the weighted mean
+    // of their variances plus the weighted variance of their means, with their sample counts as weights.
+    virtual void /*IPreComputeNode::*/ AggregateAcrossWorkers(const MPIWrapper& mpi) override
+    {
+        ElemType weight = (ElemType)AggregateNumSamples(mpi);
+
+        m_temp->SetValue(*m_mean);
+        *m_mean *= weight;
+        AllReduce(mpi, *m_mean);
+
+        *m_temp -= *m_mean;
+        m_temp->AssignElementPowerOf(*m_temp, 2);
+        *m_var += *m_temp;
+        *m_var *= weight;
+        AllReduce(mpi, *m_var);
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(InputRef(0).GetMBLayout());
@@ -55,16 +55,25 @@ public:
         RequestMatrixFromPool(m_transposedInput, matrixPool);
         RequestMatrixFromPool(m_transposedOutput, matrixPool);
         RequestMatrixFromPool(m_reserve, matrixPool);
-        RequestMatrixFromPool(m_workspace, matrixPool);
+        RequestMatrixFromPool(m_workspaceForward, matrixPool, 0, false, true);
         RequestMatrixFromPool(m_packingIndex, matrixPool);
     }
 
+    // m_workspaceForward is only used during RNNForward(), so it is shared with the workspaces of other RNN and convolution nodes.
+    // m_reserve must be kept for the backward pass.
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool)
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_workspaceForward, matrixPool);
+    }
+
     // request matrices needed to do node derivative value evaluation
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeBackprop(matrixPool);
         RequestMatrixFromPool(m_transposedDInput, matrixPool);
         RequestMatrixFromPool(m_transposedDOutput, matrixPool);
+        RequestMatrixFromPool(m_workspaceBackward, matrixPool, 0, false, true);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -76,7 +85,7 @@ public:
         ReleaseMatrixToPool(m_transposedDInput, matrixPool);
         ReleaseMatrixToPool(m_transposedDOutput, matrixPool);
         ReleaseMatrixToPool(m_reserve, matrixPool);
-        ReleaseMatrixToPool(m_workspace, matrixPool);
+        ReleaseMatrixToPool(m_workspaceBackward, matrixPool);
         ReleaseMatrixToPool(m_packingIndex, matrixPool);
     }
 
@@ -92,7 +101,8 @@ protected:
     shared_ptr<Matrix<ElemType>> m_transposedOutput;
     shared_ptr<Matrix<ElemType>> m_transposedDInput;
     shared_ptr<Matrix<ElemType>> m_transposedDOutput;
-    shared_ptr<Matrix<ElemType>> m_workspace;
+    shared_ptr<Matrix<ElemType>> m_workspaceForward;
+    shared_ptr<Matrix<ElemType>> m_workspaceBackward;
     shared_ptr<Matrix<ElemType>> m_reserve;
     shared_ptr<Matrix<ElemType>> m_packingIndex;
 
@@ -338,11 +338,15 @@ template<class ElemType, int direction>
             ; // none valid: leave it uninitialized
         else if (!m_delayedValue->IsEmpty()) // truncated BPTT
         {
-            // truncated BPTT carry-over
-            size_t T_delayedActivation = m_delayedActivationMBLayout ? m_delayedActivationMBLayout->GetNumTimeSteps() : 0; // (note: should never happen in full-sequence mode)
-            auto tensorShape = GetTensorShape(rank);
-            auto slice = TensorSliceWithMBLayoutFor(tensorShape.GetDims(), FrameRange(m_delayedActivationMBLayout, t_delayed/*<0*/ + T_delayedActivation), m_delayedActivationMBLayout);
-            tensorShape.NarrowTo(slice);
+            // truncated BPTT carry-over: the last frames of the previous minibatch, as kept by EndForwardProp()
+            size_t numParallelSequences = m_delayedActivationMBLayout->GetNumParallelSequences();
+            size_t numDelayedFrames = m_delayedValue->GetNumCols() / numParallelSequences;
+            if (t_delayed + (int)numDelayedFrames < 0)
+                LogicError("The delay node tries to access past values that are out of bound, beyond the previous minibatch.");
+            auto tensorShape = GetSampleLayout();
+            tensorShape.AppendInPlace(rank, numParallelSequences);
+            tensorShape.AppendInPlace(rank + 1, numDelayedFrames);
+            tensorShape.NarrowTo(rank + 1, t_delayed + numDelayedFrames, t_delayed + numDelayedFrames + 1);
             src = TensorView<ElemType>(m_delayedValue, tensorShape);
         }
         else
@@ -384,22 +388,62 @@ template<class ElemType, int direction>
     }
 }
 
+// The time steps only depend on the MBLayout, which BeginForwardProp() has evaluated on the host, unless a sequence continues
+// from the previous minibatch: then its first frames are read from m_delayedValue, depending on the previous MBLayout.
+template<class ElemType, int direction>
+/*virtual*/ bool DelayedValueNodeBase<ElemType, direction>::CanReplayForwardPropInLoop() const /*override*/
+{
+    return direction < 0 ? !m_pMBLayout->HasSequenceBeyondBegin() : !m_pMBLayout->HasSequenceBeyondEnd();
+}
+
 template<class ElemType, int direction>
 /*virtual*/ void DelayedValueNodeBase<ElemType,direction>::EndForwardProp() /*override*/ // called after last iteration step of ForwardProp()
 {
-    // In truncated BPTT, we carry over left-to-right state across minibatches.
-    // It is kept in m_delayedValue, m_delayedActivationMBLayout.
-    // This could be optimized as follows:
-    //  - only keep the required number of frames (m_timeStep)
-    //  - we don't need to keep anything in full-sequence mode
-    //  - we don't need to keep anything if all sequences are closed (sentence end)
-    //    This condition includes full-sequence mode.
-    // TODO: Can we optimize this and only copy if there is a sequence spanning across the end of the MB? And add a check to BeginForwardProp() to make sure we got one if there is a boundary at the start?
-    m_delayedValue->SetValue(InputRef(0).Value());
+    // In truncated BPTT, we carry over left-to-right state across minibatches. A sequence continues in the same parallel
+    // sequence of the next minibatch (the packer keeps it in its slot), whose first m_timeStep frames read the last ones
+    // of this minibatch. Only those are kept, in m_delayedValue, which persists across minibatches: its column k * S + s
+    // is frame T - K + k of parallel sequence s, with K = min(m_timeStep, T). A parallel sequence whose last sequence ends
+    // before the end of the minibatch keeps the last frames of that one instead (see ExportStreamState()).
+    const auto& value = InputRef(0).Value();
+    const size_t S = m_pMBLayout->GetNumParallelSequences();
+    const size_t T = m_pMBLayout->GetNumTimeSteps();
+    const size_t K = min((size_t)m_timeStep, T);
+
+    // [s] end of the last sequence of parallel sequence s in this minibatch
+    vector<size_t> ends(S, T);
+    vector<ptrdiff_t> lastBegins(S, PTRDIFF_MIN);
+    for (const auto& sequenceInfo : m_pMBLayout->GetAllSequences())
+    {
+        if (sequenceInfo.seqId != GAP_SEQUENCE_ID && sequenceInfo.tBegin > lastBegins[sequenceInfo.s])
+        {
+            lastBegins[sequenceInfo.s] = sequenceInfo.tBegin;
+            ends[sequenceInfo.s] = min(sequenceInfo.tEnd, T);
+        }
+    }
+    if (all_of(ends.begin(), ends.end(), [T](size_t end) { return end == T; }))
+        m_delayedValue->SetValue(value.ColumnSlice((T - K) * S, K * S)); // all sequences run to the end: one copy
+    else
+    {
+        // parallel sequences that end at the same frame are copied together
+        m_delayedValue->Resize(value.GetNumRows(), K * S);
+        for (size_t k = 0; k < K; k++)
+        {
+            for (size_t s = 0, numSequences; s < S; s += numSequences)
+            {
+                for (numSequences = 1; s + numSequences < S && ends[s + numSequences] == ends[s]; numSequences++)
+                    ;
+                if (ends[s] + k >= K) // (frames before the beginning are never read)
+                    m_delayedValue->SetColumnSlice(value.ColumnSlice((ends[s] + k - K) * S + s, numSequences), k * S + s, numSequences);
+            }
+        }
+    }
+
+    // Only the sequences are needed. CopyFrom() would also copy the validity mask, which may live on the GPU.
     if (!m_delayedActivationMBLayout)
         m_delayedActivationMBLayout = make_shared<MBLayout>();
-    m_delayedActivationMBLayout->CopyFrom(m_pMBLayout);
-    // Perf BUGBUG: ^^ This copies a matrix from CPU to GPU at each MB; we should short-circuit it
+    m_delayedActivationMBLayout->Init(S, T);
+    for (const auto& sequenceInfo : m_pMBLayout->GetAllSequences())
+        m_delayedActivationMBLayout->AddSequence(sequenceInfo);
 
     Base::EndForwardProp();
 }
@@ -501,7 +545,6 @@ template<class ElemType, int direction>
 /*virtual*/ NodeStatePtr DelayedValueNodeBase<ElemType, direction>::/*IStatefulNode::*/ ExportState() /*override*/
 {
     NodeStatePtr pExportedState;
-    size_t nT = m_pMBLayout->GetNumTimeSteps();
     size_t nU = m_pMBLayout->GetNumParallelSequences();
     int dir = direction;
     if (m_timeStep != 1)
@@ -520,7 +563,7 @@ template<class ElemType, int direction>
         else
         {
             auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
-            pState->CacheState(m_delayedValue->ColumnSlice((nT - 1) * nU, nU));
+            pState->CacheState(m_delayedValue->ColumnSlice(0, nU)); // the last frame (timeStep=1), see EndForwardProp()
             pState->CacheDelayedMBLayout(m_delayedActivationMBLayout);
             pExportedState = pState;
         }
@@ -536,7 +579,7 @@ template<class ElemType, int direction>
         else
         {
             auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
-            pState->CacheState(m_delayedValue->ColumnSlice((nT - 1) * nU, nU));
+            pState->CacheState(m_delayedValue->ColumnSlice(0, nU)); // the last frame (timeStep=1), see EndForwardProp()
             pState->CacheDelayedMBLayout(m_delayedActivationMBLayout);
             pExportedState = pState;
         }
@@ -563,18 +606,66 @@ template<class ElemType, int direction>
     }
 
     const Matrix<ElemType>& delayedActivation = pState->ExportCachedActivity();
-    size_t nT = m_delayedActivationMBLayout->GetNumTimeSteps();
     size_t nU = m_delayedActivationMBLayout->GetNumParallelSequences();
 
+    // the last frame of each parallel sequence, as EndForwardProp() keeps it for timeStep=1
     int dir = direction;
-    if (dir == -1) // looking backward
-        m_delayedValue->SetColumnSlice(delayedActivation, (nT - 1) * nU, nU);
-    else if (dir == 1)
+    if (dir == -1 || dir == 1)
+    {
+        m_delayedValue->Resize(delayedActivation.GetNumRows(), nU);
         m_delayedValue->SetColumnSlice(delayedActivation, 0, nU);
+    }
     else
         LogicError("Unrecognized direction in DelayedValueNodeBase");
 }
 
+template<class ElemType, int direction>
+void DelayedValueNodeBase<ElemType, direction>::ImportStreamStates(const std::vector<shared_ptr<Matrix<ElemType>>>& states)
+{
+    int dir = direction;
+    if (dir != -1 || m_timeStep != 1)
+        RuntimeError("%ls %ls operation: Streaming inference is only supported for PastValue with timeStep=1.", NodeName().c_str(), OperationName().c_str());
+
+    // present the states as a previous minibatch of a single frame, which ForwardProp() reads as in truncated BPTT
+    size_t numSequences = states.size();
+    m_delayedValue->Resize(GetSampleLayout().GetNumElements(), numSequences);
+    auto delayedActivationMBLayout = make_shared<MBLayout>();
+    delayedActivationMBLayout->Init(numSequences, 1);
+    for (size_t s = 0; s < numSequences; s++)
+    {
+        if (states[s])
+        {
+            m_delayedValue->SetColumnSlice(*states[s], s, 1);
+            delayedActivationMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, 1);
+        }
+        else
+            delayedActivationMBLayout->AddGap(s, 0, 1); // begins in the next minibatch, from the initial state
+    }
+    m_delayedActivationMBLayout = delayedActivationMBLayout;
+}
+
+template<class ElemType, int direction>
+void DelayedValueNodeBase<ElemType, direction>::ExportStreamState(size_t s, Matrix<ElemType>& state) const
+{
+    if (!m_delayedActivationMBLayout)
+        LogicError("%ls %ls operation: ExportStreamState() called before ForwardProp().", NodeName().c_str(), OperationName().c_str());
+
+    // the last sequence of parallel sequence s, as saved by EndForwardProp()
+    const MBLayout::SequenceInfo* lastSequence = nullptr;
+    for (const auto& sequenceInfo : m_delayedActivationMBLayout->GetAllSequences())
+    {
+        if (sequenceInfo.s == s && sequenceInfo.seqId != GAP_SEQUENCE_ID && (!lastSequence || lastSequence->tBegin < sequenceInfo.tBegin))
+            lastSequence = &sequenceInfo;
+    }
+    if (!lastSequence)
+        LogicError("%ls %ls operation: No sequence in parallel sequence %d of the last minibatch.", NodeName().c_str(), OperationName().c_str(), (int)s);
+
+    // its last frame is the last one kept for s
+    size_t numParallelSequences = m_delayedActivationMBLayout->GetNumParallelSequences();
+    size_t numDelayedFrames = m_delayedValue->GetNumCols() / numParallelSequences;
+    state.SetValue(m_delayedValue->ColumnSlice((numDelayedFrames - 1) * numParallelSequences + s, 1));
+}
+
 // instantiate the classes that derive from the above
 template class PastValueNode<float>;
 template class PastValueNode<double>;
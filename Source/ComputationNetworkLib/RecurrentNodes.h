@@ -69,10 +69,17 @@ public:
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override;
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual bool /*ComputationNodeBase::*/ CanReplayForwardProp() const override { return false; } // state carried over from the previous minibatch
+    virtual bool /*ComputationNodeBase::*/ CanReplayForwardPropInLoop() const override;
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
     virtual int /*IRecurrentNode::*/ GetRecurrenceSteppingDirection() const override { return -direction; }
     virtual NodeStatePtr /*IStatefulNode::*/ ExportState() override;
     virtual void /*IStatefulNode::*/ ImportState(const NodeStatePtr& pImportedState) override;
+    // Streaming inference, where the caller keeps the carried-over frame of each parallel sequence on the device:
+    // [s] is the state of parallel sequence s of the next minibatch, or null if that sequence begins in it.
+    void ImportStreamStates(const std::vector<shared_ptr<Matrix<ElemType>>>& states);
+    // copies the last frame of parallel sequence s of the last minibatch into 'state'
+    void ExportStreamState(size_t s, Matrix<ElemType>& state) const;
     int TimeStep() const { return m_timeStep; }
     ElemType InitialActivationValue() const { return m_initialStateValue; }
 
@@ -90,8 +97,8 @@ protected:
     shared_ptr<Matrix<ElemType>> m_zeroMatrix;              // constant [1]-dimensional 0 used for backprop  --TODO: could use a static map[deviceId]
     shared_ptr<Matrix<ElemType>> m_packedIndexMatrix;       // index mapping for DoGatherColumnsOf() in case of per-sequence initial state
 
-    shared_ptr<Matrix<ElemType>> m_delayedValue;            // saves the activation of the previous step that this node points to
-    MBLayoutPtr m_delayedActivationMBLayout;                // layout for m_delayedValue
+    shared_ptr<Matrix<ElemType>> m_delayedValue;            // the last min(m_timeStep, T) frames of each parallel sequence of the previous minibatch, [k * S + s]
+    MBLayoutPtr m_delayedActivationMBLayout;                // layout of the previous minibatch
 };
 
 #define UsingDelayedValueNodeMembers        \
@@ -324,6 +324,71 @@ template <class ElemType>
 template class ReduceElementsNode<float>;
 template class ReduceElementsNode<double>;
 
+// -----------------------------------------------------------------------
+// ContextExpansionNode (input) -- stack each frame with its neighbors in time
+// -----------------------------------------------------------------------
+
+// The output is viewed as a matrix of W = leftContext + 1 + rightContext times as many columns of the input dimension,
+// column j * W + k holding block k of output frame j. The whole expansion is a single gather of input columns.
+template <class ElemType>
+/*virtual*/ void ContextExpansionNode<ElemType>::ForwardPropNonLooping() /*override*/
+{
+    let& layout = *GetMBLayout();
+    let  width = m_leftContext + 1 + m_rightContext;
+    let  numCols = layout.GetNumCols();
+
+    // build the index on the CPU, gaps are -1
+    m_packedIndexBuffer.assign(width * numCols, (ElemType)-1);
+    for (let& seq : layout.GetAllSequences())
+    {
+        if (seq.seqId == GAP_SEQUENCE_ID)
+            continue;
+        // the part of the sequence inside the minibatch, relative to the sequence start
+        let tBegin = max(seq.tBegin, (ptrdiff_t)0) - seq.tBegin;
+        let tEnd   = (ptrdiff_t)min(seq.tEnd, layout.GetNumTimeSteps()) - seq.tBegin;
+        for (ptrdiff_t t = tBegin; t < tEnd; t++)
+        {
+            let j = layout.GetColumnIndex(seq, (size_t)t);
+            for (size_t k = 0; k < width; k++)
+            {
+                let tNeighbor = min(max(t + (ptrdiff_t)k - (ptrdiff_t)m_leftContext, tBegin), tEnd - 1); // index does not move beyond boundary
+                m_packedIndexBuffer[j * width + k] = (ElemType)layout.GetColumnIndex(seq, (size_t)tNeighbor);
+            }
+        }
+    }
+    m_packedIndex->SetValue(1, width * numCols, m_packedIndex->GetDeviceId(), m_packedIndexBuffer.data(), MatrixFormat::matrixFormatColMajor);
+
+    let& input = InputRef(0).Value();
+    auto output = Value().Reshaped(input.GetNumRows(), width * numCols);
+    output.DoGatherColumnsOf(/*beta=*/0, *m_packedIndex, input, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void ContextExpansionNode<ElemType>::BackpropToNonLooping(size_t /*inputIndex*/) /*override*/
+{
+    auto& inputGradient = InputRef(0).Gradient();
+    let outputGradient = Gradient().Reshaped(inputGradient.GetNumRows(), m_packedIndex->GetNumCols());
+    inputGradient.DoScatterColumnsOf(/*beta=*/1, *m_packedIndex, outputGradient, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void ContextExpansionNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+    if (isFinalValidationPass && !HasMBLayout())
+        InvalidArgument("%ls requires its input to be a time sequence.", NodeDescription().c_str());
+
+    // the trailing dimension gets multiplied by the number of frames in the window, like in RowRepeat()
+    SmallVector<size_t> dims = GetInputSampleLayout(0).GetDims();
+    dims.back() *= m_leftContext + 1 + m_rightContext;
+
+    SetDims(TensorShape(dims), HasMBLayout());
+}
+
+template class ContextExpansionNode<float>;
+template class ContextExpansionNode<double>;
+
 // -----------------------------------------------------------------------
 // Where(bitVector) -- extract indices of non-0 values in a sequence
 // -----------------------------------------------------------------------
@@ -408,9 +473,8 @@ template <class ElemType>
         assert(sequences[i].seqId == GAP_SEQUENCE_ID);
     for (size_t i = size; i < outMBLayout->GetAllSequences().size(); i++)
         assert(outMBLayout->GetAllSequences()[i].seqId == GAP_SEQUENCE_ID);
-    // the result will be kept in CPUDEVICE, since most likely we will access it again in PackedIndexNode
-    Value().TransferToDeviceIfNotThere(CPUDEVICE, /*isBeingMoved=*/ true, /*emptyTransfer=*/ true, /*updatePreferredDevice=*/ true);
-    Value().SetValue(1, outMBLayout->GetNumCols(), CPUDEVICE, buf.data(), MatrixFormat::matrixFormatColMajor);
+    // the result goes to our device, where PackedIndexNode maps it
+    Value().SetValue(1, outMBLayout->GetNumCols(), m_deviceId, buf.data(), MatrixFormat::matrixFormatColMajor);
 }
 
 template <class ElemType>
@@ -455,23 +519,26 @@ template <class ElemType>
     // loop over sourceSequences
     // Input matrix contains time indices for each sequence that refer to frames inside that sequence.
     // We replace every per-sequence index by the resolved column index w.r.t. the same MBLayout.
+    // This is done on the device, which only gets where each index sequence is and where its source sequence begins.
     let& sourceSequences = sourceMBLayout->GetAllSequences();
+    let sourceNumParallelSequences = sourceMBLayout->GetNumParallelSequences();
+    auto& sequenceRanges = m_sequenceRangeBuffer;
+    sequenceRanges.clear();
     for (size_t i = 0; i < sourceSequences.size(); i++)
     {
         let& sourceSeq = sourceSequences[i];
         if (sourceSeq.seqId == GAP_SEQUENCE_ID)
             continue;
         let& indexSeq = indexMBLayout->FindMatchingSequence(sourceSequences, i); // find corresponding entry in indexMBLayout
-        for (size_t tIndex = 0; tIndex < indexSeq.GetNumTimeSteps(); tIndex++)   // map all index values in index sequence
-        {
-            let jIndex  = indexMBLayout->GetColumnIndex(indexSeq, tIndex);    // map time index to actual location in the matrix storage object
-            let tSource = (size_t)index(0, jIndex);                           // the new time location (relative to source sequence)
-            let jSource = sourceMBLayout->GetColumnIndex(sourceSeq, tSource); // map new time index as well. This performs a range check.
-            result(0, jIndex) = (ElemType)jSource;
-        }
+        PackedSequenceRange range;
+        range.s            = (int)indexSeq.s;
+        range.tBegin       = (int)indexSeq.tBegin;
+        range.tEnd         = (int)indexSeq.tEnd;
+        range.targetColumn = (int)(sourceSeq.tBegin * (ptrdiff_t)sourceNumParallelSequences + (ptrdiff_t)sourceSeq.s); // the column of time step 0
+        range.targetLength = (int)(min(sourceSeq.tEnd, sourceMBLayout->GetNumTimeSteps()) - sourceSeq.tBegin);      // time steps in this minibatch
+        sequenceRanges.push_back(range);
     }
-    // Note: maybe this is no longer needed, now that we do the same inside UpdateFunctionValueSize() for all nodes.
-    result.CollapseDataLocation(); // BUGBUG: Move back, since BOTH state is broken at present.
+    result.AssignPackedIndicesOf(&index, indexMBLayout->GetNumParallelSequences(), indexMBLayout->GetNumTimeSteps(), sequenceRanges, sourceNumParallelSequences);
 }
 
 template <class ElemType>
@@ -167,6 +167,12 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
+    // (the result of a reshape is determined by its sample layout)
+    virtual bool /*ComputationNodeBase::*/ ComputesSameValueAs(const ComputationNodeBase& /*other*/) const override { return true; }
+
+    // whether all axes of the input are reshaped, so that the result does not depend on the input's sample layout
+    bool ReshapesAllAxes() const { return m_beginDimParameter <= 1 && m_endDimParameter == 0; }
+
 private:
     TensorShape m_replacementSampleLayout; // user-specified dimensions to replace dimensions [beginAxis, endAxis]
     int m_beginDimParameter;               // 1-based index range as specified
@@ -299,6 +305,19 @@ public:
     std::wstring ReductionOpName() const { return m_operation; }
     int ReductionAxis() const { return m_axis; }
 
+    // one operation per input value, and the same for broadcasting the gradient back
+    virtual void /*ComputationNodeBase::*/ GetForwardCost(double& flops, double& bytes) const override
+    {
+        flops = Input(0)->GetNumValues();
+        bytes = (flops + GetNumValues()) * sizeof(ElemType);
+    }
+
+    virtual void /*ComputationNodeBase::*/ GetBackpropCost(size_t /*inputIndex*/, double& flops, double& bytes) const override
+    {
+        flops = Input(0)->GetNumValues();
+        bytes = (3 * flops + 2 * GetNumValues()) * sizeof(ElemType);
+    }
+
     static const int  CNTKInternalIdxValueForAllStaticAxes = 0;
     static const int  CNTKInternalIdxValueForAllAxes = -1;
     static const int  CNTKInternalIdxValueForSequenceAxis = -2;
@@ -565,6 +584,12 @@ public:
         return m_endIndex[idx]   >  0 ? (size_t)m_endIndex[idx] : (size_t)(m_endIndex[idx] + InputRef(0).GetSampleLayout()[m_axis[idx] - 1]); 
     }
     std::vector<int> Axis() const { return m_axis; }
+
+    virtual bool /*ComputationNodeBase::*/ ComputesSameValueAs(const ComputationNodeBase& other) const override
+    {
+        auto& otherSlice = dynamic_cast<const SliceNode<ElemType>&>(other);
+        return m_beginIndex == otherSlice.m_beginIndex && m_endIndex == otherSlice.m_endIndex && m_axis == otherSlice.m_axis;
+    }
     int Axis(int idx) const 
     { 
         if (idx >= (int)m_axis.size())
@@ -971,6 +996,79 @@ private:
 template class RowRepeatNode<float>;
 template class RowRepeatNode<double>;
 
+// -----------------------------------------------------------------------
+// ContextExpansionNode (input) -- stack each frame with its neighbors in time
+// Output frame t is [x(t-leftContext); ...; x(t); ...; x(t+rightContext)],
+// where frames beyond the sequence boundaries are replaced by the first or
+// last frame, like the context expansion of the HTK deserializer. This allows
+// the reader to ship unexpanded frames with their MBLayout and to splice the
+// context on the device as a single gather. The neighbors must be part of the
+// minibatch, i.e. the input must be whole sequences (not frame mode);
+// sequences that extend beyond the minibatch are clamped to the minibatch.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ContextExpansionNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"ContextExpansion"; }
+
+public:
+    ContextExpansionNode(DEVICEID_TYPE deviceId, const wstring& name, size_t leftContext = 0, size_t rightContext = 0)
+        : Base(deviceId, name),
+          m_leftContext(leftContext),
+          m_rightContext(rightContext),
+          m_packedIndex(make_shared<Matrix<ElemType>>(deviceId))
+    {
+    }
+    ContextExpansionNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : ContextExpansionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"leftContext"), configp->Get(L"rightContext"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<ContextExpansionNode<ElemType>>(nodeP);
+            node->m_leftContext = m_leftContext;
+            node->m_rightContext = m_rightContext;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_leftContext << m_rightContext;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_leftContext >> m_rightContext;
+    }
+
+    virtual std::string FormatOperationPrototype(const std::string& extraArgs) const override
+    {
+        return Base::FormatOperationPrototype(extraArgs + msra::strfun::strprintf(", leftContext=%lu, rightContext=%lu", m_leftContext, m_rightContext));
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual void Validate(bool isFinalValidationPass) override;
+
+private:
+    size_t m_leftContext;
+    size_t m_rightContext;
+
+    vector<ElemType> m_packedIndexBuffer;   // CPU-side buffer for constructing the index
+    shared_ptr<Matrix<ElemType>> m_packedIndex; // [0, j * W + k] column of the input that goes into block k of output column j, W = leftContext + 1 + rightContext
+};
+
 // -----------------------------------------------------------------------
 // WhereNode(cond) -- extract indices of a sequence repeated according to
 // an indicator vector. Kinds of indicator values:
@@ -1000,7 +1098,8 @@ PackedIndex maps that to the internal lookup table that has strides resolved etc
 The reason that PackedIndex is separate from Gather/ScatterPacked is that the GPU has no
 access to the STL-heavy MBLayout. So PackedIndex applies the relevant information from
 the MBLayout into a GPU object that then drives the memory-copy operations in Gather()
-and Scatter().
+and Scatter(). It passes the MBLayout to the device as one PackedSequenceRange per
+sequence, from which the column indices are computed there (Matrix::AssignPackedIndicesOf()).
 */
 
 template <class ElemType>
@@ -1082,6 +1181,9 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
     virtual void Validate(bool isFinalValidationPass) override;
+
+private:
+    std::vector<PackedSequenceRange> m_sequenceRangeBuffer; // [sequence] passed to the device (kept as object state to avoid memory allocations)
 };
 
 // -----------------------------------------------------------------------
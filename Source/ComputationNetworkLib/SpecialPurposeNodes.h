@@ -7,6 +7,7 @@
 #include "Basics.h"
 #include "ComputationNode.h"
 #include "gammacalculation.h"
+#include "denominatorgraph.h"
 #include "NonlinearityNodes.h"
 
 #include <map>
@@ -974,6 +975,180 @@ protected:
 template class ForwardBackwardNode<float>;
 template class ForwardBackwardNode<double>;
 
+// -----------------------------------------------------------------------
+// LatticeFreeMMINode (labels, prediction)
+// Lattice-free MMI sequence training criterion, as in "Purely sequence-trained neural networks for ASR based on
+// lattice-free MMI", Povey et al., Interspeech 2016:
+//   sum over the utterances of the minibatch of  log(sum over the paths of the denominator graph) - numerator score
+// The denominator graph (a phone-LM FST over pdfs, see denominatorgraph.h) is read once from denominatorGraphPath, and the
+// forward-backward runs through it for all utterances of the minibatch at once, in CUDA kernels on a GPU.
+// labels: the numerator, a frame-level alignment as one-hot pdf vectors (e.g. from the MLF deserializer)
+// prediction: log scores of the pdfs, the network output without softmax
+// Sequences must be whole utterances. The gradient to the prediction is the denominator posteriors minus the labels.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class LatticeFreeMMINode : public ComputationNodeNonLooping<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"LatticeFreeMMI";
+    }
+
+public:
+    LatticeFreeMMINode(DEVICEID_TYPE deviceId, const wstring& name, const wstring& denominatorGraphPath = L"")
+        : Base(deviceId, name), m_denominatorGraphPath(denominatorGraphPath), m_denominatorGraphRead(false)
+    {
+    }
+
+    LatticeFreeMMINode(const ScriptableObjects::IConfigRecordPtr configp)
+        : LatticeFreeMMINode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"denominatorGraphPath"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        if (inputIndex == 0)
+            ; // no gradient flows to the alignment
+        else if (inputIndex == 1)
+        {
+            FrameRange fr(InputRef(0).GetMBLayout());
+            // inputGradient += gradient * (denominatorPosteriors - labels)
+            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_denominatorPosteriors, *m_numeratorPosteriors, InputRef(1).Gradient());
+            InputRef(1).MaskMissingGradientColumnsToZero(fr);
+        }
+        else
+            RuntimeError("LatticeFreeMMINode criterion expects only two inputs: labels and network output.");
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    virtual void ForwardPropNonLooping() override
+    {
+        if (!m_denominatorGraphRead)
+        {
+            if (m_denominatorGraphPath.empty())
+                InvalidArgument("%ls %ls operation requires a denominatorGraphPath.", NodeName().c_str(), OperationName().c_str());
+            m_denominatorGraph.Read(m_denominatorGraphPath);
+            m_denominatorGraphRead = true;
+        }
+
+        const MBLayoutPtr& pMBLayout = InputRef(0).GetMBLayout();
+        GetUtterances(pMBLayout, m_uttFirstColumns, m_uttFrames);
+        FrameRange fr(pMBLayout);
+        const Matrix<ElemType>& prediction = InputRef(1).MaskedValueFor(fr);
+
+        // denominator: all utterances at once through the graph
+        const double logDenominator = m_denominatorGraph.ForwardBackward(prediction, m_uttFirstColumns, m_uttFrames,
+                                                                         pMBLayout->GetNumParallelSequences(), *m_denominatorPosteriors);
+
+        // numerator: the prediction at the aligned pdfs; labels are copied to dense, since they are usually sparse
+        m_numeratorPosteriors->AssignValuesOf(InputRef(0).Value());
+        MaskMissingColumnsToZero(*m_numeratorPosteriors, pMBLayout, fr);
+        const double numerator = Matrix<ElemType>::InnerProductOfMatrices(*m_numeratorPosteriors, prediction);
+
+        Value().SetValue((ElemType) (logDenominator - numerator));
+#if NANCHECK
+        Value().HasNan("LatticeFreeMMINode");
+#endif
+    }
+
+    // first column and length of each utterance of the minibatch
+    static void GetUtterances(const MBLayoutPtr& pMBLayout, vector<unsigned int>& uttFirstColumns, vector<unsigned int>& uttFrames)
+    {
+        uttFirstColumns.clear();
+        uttFrames.clear();
+        for (const auto& sequence : pMBLayout->GetAllSequences())
+        {
+            if (sequence.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (sequence.tBegin < 0 || sequence.tEnd > pMBLayout->GetNumTimeSteps())
+                InvalidArgument("LatticeFreeMMINode: Sequences must be whole utterances; truncated training is not supported.");
+            uttFirstColumns.push_back((unsigned int) (sequence.tBegin * pMBLayout->GetNumParallelSequences() + sequence.s));
+            uttFrames.push_back((unsigned int) sequence.GetNumTimeSteps());
+        }
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // no layout
+
+        if (isFinalValidationPass)
+        {
+            if (!(Input(0)->GetSampleMatrixNumRows() == Input(1)->GetSampleMatrixNumRows() && // match vector dimension
+                  Input(0)->HasMBLayout() &&
+                  Input(0)->GetMBLayout() == Input(1)->GetMBLayout()))
+            {
+                LogicError("The Matrix dimension in the LatticeFreeMMINode operation does not match.");
+            }
+        }
+
+        SetDims(Environment().IsV2Library() ? TensorShape() : TensorShape(1), false);
+    }
+
+    virtual void CopyTo(const ComputationNodePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<LatticeFreeMMINode<ElemType>>(nodeP);
+            node->m_denominatorGraphPath = m_denominatorGraphPath; // the copy reads the graph itself when first used
+            node->m_denominatorPosteriors->SetValue(*m_denominatorPosteriors);
+            node->m_numeratorPosteriors->SetValue(*m_numeratorPosteriors);
+        }
+    }
+
+    // request matrices needed to do node function value evaluation
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_denominatorPosteriors, matrixPool);
+        RequestMatrixFromPool(m_numeratorPosteriors, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_denominatorPosteriors, matrixPool);
+        ReleaseMatrixToPool(m_numeratorPosteriors, matrixPool);
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_denominatorGraphPath;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_denominatorGraphPath;
+    }
+
+    const wstring& DenominatorGraphPath() const { return m_denominatorGraphPath; }
+
+protected:
+    virtual bool NodeDoesItsOwnCustomizedMissingColumnsMasking() { return true; }
+    shared_ptr<Matrix<ElemType>> m_denominatorPosteriors;
+    shared_ptr<Matrix<ElemType>> m_numeratorPosteriors;
+
+    wstring m_denominatorGraphPath;
+    msra::lattices::DenominatorGraph m_denominatorGraph;
+    bool m_denominatorGraphRead;
+    vector<unsigned int> m_uttFirstColumns;
+    vector<unsigned int> m_uttFrames;
+};
+
+template class LatticeFreeMMINode<float>;
+template class LatticeFreeMMINode<double>;
+
 // -----------------------------------------------------------------------
 // StopGradientNode (Input)
 // Outputs its input as it and prevents any gradient contribution from its output to its input.
@@ -1013,6 +1188,59 @@ public:
 template class StopGradientNode<float>;
 template class StopGradientNode<double>;
 
+// -----------------------------------------------------------------------
+// CrossDeviceCopyNode (Input)
+// Outputs its input, which is on another device, on its own device, and adds the gradient to that of the input on the
+// input's device. ComputationNetwork::PlaceNodesOnDevices() inserts these where a node reads a node on another device.
+// -----------------------------------------------------------------------
+template <class ElemType>
+class CrossDeviceCopyNode : public UnaryElementWiseNode<ElemType>
+{
+    typedef UnaryElementWiseNode<ElemType> Base;
+    UsingUnaryElementwiseNodeBaseMembers;
+    static const std::wstring TypeName() { return L"CrossDeviceCopy"; }
+public:
+    DeclareConstructorFromConfigWithNumInputs(CrossDeviceCopyNode);
+    CrossDeviceCopyNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        auto result = ValueFor(fr);
+        result.AssignValuesFromDevice(InputRef(0).ValueFor(fr));
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        m_gradientOnInputDevice->AssignValuesFromDevice(GradientFor(fr));
+        InputRef(0).GradientFor(fr) += *m_gradientOnInputDevice;
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        if (!m_gradientOnInputDevice || matrixPool.IsRecomputing())
+            matrixPool.RequestAllocate<ElemType>(InputRef(0).GetDeviceId(), &m_gradientOnInputDevice, GetSampleLayout().GetNumElements(), HasMBLayout(), /*isWorkSpace=*/ false, NodeName(), "temp");
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gradientOnInputDevice, matrixPool);
+    }
+
+private:
+    shared_ptr<Matrix<ElemType>> m_gradientOnInputDevice; // the gradient, copied to the device of the input
+};
+
+template class CrossDeviceCopyNode<float>;
+template class CrossDeviceCopyNode<double>;
+
 // -----------------------------------------------------------------------
 // AssignNode (RefInput, Input)
 // -----------------------------------------------------------------------
@@ -0,0 +1,248 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// StreamSchedule.cpp -- runs independent nodes of a PAR traversal concurrently on several CUDA streams or CPU threads
+//
+
+#include "stdafx.h"
+#include "StreamSchedule.h"
+#include <set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+StreamSchedule::StreamSchedule(DEVICEID_TYPE deviceId, size_t numStreams)
+    : m_deviceId(deviceId), m_numStreams(numStreams)
+{
+    if (numStreams < 2)
+        InvalidArgument("StreamSchedule: Concurrent execution needs at least 2 streams.");
+}
+
+void StreamSchedule::Plan(Pass pass, const std::vector<ComputationNodeBasePtr>& order, const std::vector<std::vector<size_t>>& predecessors,
+                          const ComputationNodeBasePtr& root)
+{
+    const size_t numNodes = order.size();
+    if (predecessors.size() != numNodes)
+        LogicError("StreamSchedule: Inconsistent plan.");
+
+    // number of nodes that still need the value (forward) or gradient (backward) of each node
+    std::vector<size_t> numPendingSuccessors(numNodes, 0);
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        for (size_t p : predecessors[i])
+        {
+            if (p >= i)
+                LogicError("StreamSchedule: Predecessors must come first in the execution order.");
+            numPendingSuccessors[p]++;
+        }
+    }
+
+    std::vector<int> regions(numNodes, -1);
+    std::vector<size_t> streams(numNodes, 0);
+    std::vector<size_t> streamTails;  // last node given each stream in the current region
+    size_t regionBegin = 0;
+    size_t nextStream = 0;
+    size_t numNodesWithPendingSuccessors = 0;
+    PassPlan plan;
+    plan.root = root;
+
+    auto endRegion = [&](size_t regionEnd)
+    {
+        std::set<size_t> streamsUsed;
+        for (size_t i = regionBegin; i < regionEnd; i++)
+            streamsUsed.insert(streams[i]);
+        if (streamsUsed.size() > 1) // otherwise it's a plain chain, which runs on the main stream
+        {
+            for (size_t i = regionBegin; i < regionEnd; i++)
+                regions[i] = (int) plan.numRegions;
+            plan.numRegions++;
+            plan.numConcurrentNodes += regionEnd - regionBegin;
+        }
+        regionBegin = regionEnd;
+        streamTails.clear();
+        nextStream = 0;
+    };
+
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        for (size_t p : predecessors[i])
+        {
+            if (--numPendingSuccessors[p] == 0)
+                numNodesWithPendingSuccessors--;
+        }
+
+        bool continuesChain = false;
+        for (size_t p : predecessors[i])
+        {
+            if (p >= regionBegin && streamTails[streams[p]] == p)
+            {
+                streams[i] = streams[p];
+                continuesChain = true;
+                break;
+            }
+        }
+        if (!continuesChain)
+        {
+            streams[i] = nextStream;
+            nextStream = (nextStream + 1) % m_numStreams;
+            if (streamTails.size() <= streams[i])
+                streamTails.resize(streams[i] + 1, SIZE_MAX);
+        }
+        streamTails[streams[i]] = i;
+
+        if (numPendingSuccessors[i] > 0)
+            numNodesWithPendingSuccessors++;
+        // all branches have joined in this node
+        const bool isJoin = numNodesWithPendingSuccessors == (numPendingSuccessors[i] > 0 ? 1 : 0);
+        if (isJoin || i + 1 - regionBegin >= s_maxRegionSize)
+            endRegion(i + 1);
+    }
+    endRegion(numNodes);
+
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        Assignment& assignment = plan.assignments[order[i].get()];
+        assignment.region = regions[i];
+        assignment.stream = streams[i];
+        if (regions[i] < 0)
+            continue;
+        for (size_t p : predecessors[i])
+        {
+            if (regions[p] == regions[i]) // earlier regions have joined already
+                assignment.predecessors.push_back(order[p].get());
+        }
+    }
+    m_plans[(int) pass] = std::move(plan);
+}
+
+int StreamSchedule::GetRegion(Pass pass, const ComputationNodeBasePtr& node) const
+{
+    const auto& assignments = m_plans[(int) pass].assignments;
+    auto iter = assignments.find(node.get());
+    return iter != assignments.end() ? iter->second.region : -1;
+}
+
+// -----------------------------------------------------------------------
+// StreamSchedule::Execution
+// -----------------------------------------------------------------------
+
+StreamSchedule::Execution::Execution(const StreamSchedule* schedule, Pass pass, const ComputationNodeBasePtr& root)
+    : m_schedule(schedule), m_pass(pass), m_region(-1)
+{
+    if (!schedule || schedule->GetNumRegions(pass) == 0)
+        return;
+    // the backward plan is only valid for the criterion it was made for
+    if (pass == Pass::Backward && root != schedule->m_plans[(int) pass].root)
+        return;
+    if (schedule->m_deviceId < 0)
+    {
+        if (!schedule->m_taskPool)
+            schedule->m_taskPool = std::make_shared<CpuTaskPool>(schedule->m_numStreams);
+        m_taskPool = schedule->m_taskPool;
+    }
+    else
+    {
+        if (!schedule->m_pool)
+            schedule->m_pool = ComputeStreamPool::Get(schedule->m_deviceId, schedule->m_numStreams);
+        m_pool = schedule->m_pool;
+    }
+}
+
+StreamSchedule::Execution::~Execution()
+{
+    // Join() was not reached because something threw; the streams or workers still need to join, but the original
+    // exception is the one to report
+    try
+    {
+        EndRegion();
+    }
+    catch (...)
+    {
+    }
+}
+
+// returns true if the node runs in a region, then EndNode() must be called after it
+bool StreamSchedule::Execution::BeginNode(const ComputationNodeBasePtr& node)
+{
+    const auto& assignments = m_schedule->m_plans[(int) m_pass].assignments;
+    auto iter = assignments.find(node.get());
+    if (iter == assignments.end())
+    {
+        // nodes without inputs do not compute anything; if the node is not in the plan at all, it runs on its own
+        if (node->GetNumInputs() > 0 || dynamic_cast<const FlowControlNode*>(node.get()))
+            EndRegion();
+        return false;
+    }
+    const Assignment& assignment = iter->second;
+    if (assignment.region < 0)
+    {
+        EndRegion();
+        return false;
+    }
+    if (assignment.region != m_region)
+    {
+        EndRegion();
+        if (m_pool)
+            m_pool->BeginRegion();
+        m_region = assignment.region;
+    }
+    if (m_taskPool)
+        return true;
+
+    m_pool->SelectStream(assignment.stream);
+    for (auto predecessor : assignment.predecessors)
+    {
+        auto recorded = m_recordedEvents.find(predecessor);
+        // Predecessors that did not run in this execution have joined with an earlier region.
+        if (recorded != m_recordedEvents.end() && recorded->second.stream != assignment.stream)
+            m_pool->WaitForEvent(recorded->second.event);
+    }
+    return true;
+}
+
+void StreamSchedule::Execution::EndNode(const ComputationNodeBasePtr& node)
+{
+    const size_t stream = m_schedule->m_plans[(int) m_pass].assignments.find(node.get())->second.stream;
+    const size_t event = m_recordedEvents.size();
+    m_pool->RecordEvent(event);
+    m_recordedEvents[node.get()] = RecordedEvent{ stream, event };
+}
+
+// on the CPU, queues the node of the current region to run when the region ends
+void StreamSchedule::Execution::DeferNode(const ComputationNodeBasePtr& node, std::function<void()> action)
+{
+    const Assignment& assignment = m_schedule->m_plans[(int) m_pass].assignments.find(node.get())->second;
+    CpuTaskPool::Task task;
+    task.action = std::move(action);
+    task.preferredWorker = assignment.stream;
+    for (auto predecessor : assignment.predecessors)
+    {
+        auto deferred = m_deferredIndices.find(predecessor);
+        // Predecessors that were not deferred in this execution have finished with an earlier region.
+        if (deferred != m_deferredIndices.end())
+            task.predecessors.push_back(deferred->second);
+    }
+    m_deferredIndices[node.get()] = m_deferredTasks.size();
+    m_deferredTasks.push_back(std::move(task));
+}
+
+void StreamSchedule::Execution::EndRegion()
+{
+    if (m_region < 0)
+        return;
+    m_region = -1;
+    if (m_taskPool)
+    {
+        std::vector<CpuTaskPool::Task> tasks;
+        tasks.swap(m_deferredTasks);
+        m_deferredIndices.clear();
+        m_taskPool->Run(tasks);
+    }
+    else
+    {
+        m_recordedEvents.clear();
+        m_pool->EndRegion();
+    }
+}
+
+}}}
@@ -0,0 +1,148 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// StreamSchedule.h -- runs independent nodes of a PAR traversal concurrently on several CUDA streams or CPU threads
+//
+// Networks with wide branches (inception towers, parallel attention heads, the feature towers of ranking models, ...)
+// consist of many small operations. Issued to a single stream they leave the GPU mostly idle, and on the CPU each of them
+// is too small to keep all OpenMP threads busy. With numComputeStreams=N (N > 1) the nodes of each pass are split into
+// regions, consecutive runs of nodes in execution order:
+//  - A region ends where all branches that were opened in it have joined again, i.e. where the output of the last node is
+//    the only value computed so far that is still needed later, or when it has grown to s_maxRegionSize nodes.
+//  - Within a region each node runs on one of the streams. A node continues the stream of its first predecessor if that
+//    stream has not been given to another node in the meantime (chains stay on one stream), otherwise it starts a new one.
+//    It waits for its predecessors on other streams through events.
+//  - All streams join at the end of a region. Regions that would only use one stream run on the main stream, as before.
+//  - A recurrent loop (SEQTraversalFlowControlNode) is scheduled as one node, whose time steps all run on its stream.
+//    Independent loops, e.g. the forward and backward directions of a bidirectional LSTM, thus run concurrently in both
+//    passes; their small per-step kernels are latency-bound, so they overlap well.
+// Predecessors in the forward pass are the inputs of a node. In the backward pass they are the nodes that wrote the
+// gradients that a node reads or accumulates into last, i.e. its parents and the other parents of its inputs. For a loop
+// these are the predecessors of its nodes outside of the loop.
+// Nodes without inputs (parameters, inputs, constants) do not compute anything in either pass and are not scheduled.
+//
+// On the CPU the streams are the N workers of a CpuTaskPool. Execution::Run() defers the nodes of a region, and the end of
+// the region runs them as a task graph over their predecessors, each worker with its share of the OpenMP threads. Nodes
+// that do not belong to a region run on the calling thread as before.
+//
+// Memory sharing (MatrixPool) relies on the execution order of the nodes. Within a region this order no longer holds, so
+// AllocateAllMatrices() widens the lifetime of all matrices requested or released in a region to the whole region (see
+// MatrixPool::BeginConcurrentRegion()). Matrices are therefore never shared between nodes of the same region, and are
+// reused by later regions only after the join.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "ComputeStreamPool.h"
+#include "CpuTaskPool.h"
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class StreamSchedule
+{
+public:
+    enum class Pass
+    {
+        Forward,
+        Backward
+    };
+
+    static const size_t s_maxRegionSize = 32;
+
+    StreamSchedule(DEVICEID_TYPE deviceId, size_t numStreams);
+
+    // Plans one pass. 'order' is the execution order without nodes that have no inputs; 'predecessors[i]' are the indices
+    // of the nodes before 'order[i]' that it depends on. 'root' is the root of the backward pass, which is only ever planned
+    // for one criterion.
+    void Plan(Pass pass, const std::vector<ComputationNodeBasePtr>& order, const std::vector<std::vector<size_t>>& predecessors,
+              const ComputationNodeBasePtr& root = nullptr);
+
+    // region a node belongs to, or -1 if it runs on the main stream
+    int GetRegion(Pass pass, const ComputationNodeBasePtr& node) const;
+    size_t GetNumRegions(Pass pass) const { return m_plans[(int) pass].numRegions; }
+    size_t GetNumConcurrentNodes(Pass pass) const { return m_plans[(int) pass].numConcurrentNodes; }
+    size_t GetNumStreams() const { return m_numStreams; }
+
+    // one execution of a pass, e.g. PARTraversalFlowControlNode::ForwardProp(); Join() ends it
+    class Execution
+    {
+    public:
+        // 'schedule' may be null, then all nodes run sequentially
+        Execution(const StreamSchedule* schedule, Pass pass, const ComputationNodeBasePtr& root = nullptr);
+        ~Execution();
+
+        // true while nodes run concurrently, i.e. results of nodes run so far may not be available on the main stream or
+        // calling thread yet
+        bool IsInRegion() const { return m_region >= 0; }
+
+        // On the CPU, 'action' may run later on a worker thread, up to Join(), so it must capture what it uses by value
+        // or refer to state that outlives the execution.
+        template <class ACTION>
+        void Run(const ComputationNodeBasePtr& node, const ACTION& action)
+        {
+            const bool scheduled = (m_pool || m_taskPool) && BeginNode(node);
+            if (scheduled && m_taskPool)
+                DeferNode(node, action);
+            else
+            {
+                action();
+                if (scheduled)
+                    EndNode(node);
+            }
+        }
+
+        // waits for all nodes run so far, and rethrows the first exception of a deferred node
+        void Join() { EndRegion(); }
+
+    private:
+        bool BeginNode(const ComputationNodeBasePtr& node);
+        void EndNode(const ComputationNodeBasePtr& node);
+        void DeferNode(const ComputationNodeBasePtr& node, std::function<void()> action);
+        void EndRegion();
+
+        struct RecordedEvent
+        {
+            size_t stream;
+            size_t event;
+        };
+
+        const StreamSchedule* m_schedule;
+        Pass m_pass;
+        std::shared_ptr<ComputeStreamPool> m_pool; // null if execution is sequential or on the CPU
+        std::shared_ptr<CpuTaskPool> m_taskPool;   // null if execution is sequential or on the GPU
+        int m_region;
+        std::unordered_map<const ComputationNodeBase*, RecordedEvent> m_recordedEvents; // in the current region
+        std::vector<CpuTaskPool::Task> m_deferredTasks;                                 // in the current region
+        std::unordered_map<const ComputationNodeBase*, size_t> m_deferredIndices;       // [node] -> index in m_deferredTasks
+    };
+
+private:
+    struct Assignment
+    {
+        int region;
+        size_t stream;
+        std::vector<const ComputationNodeBase*> predecessors;
+    };
+    struct PassPlan
+    {
+        std::unordered_map<const ComputationNodeBase*, Assignment> assignments;
+        ComputationNodeBasePtr root;
+        size_t numRegions = 0;
+        size_t numConcurrentNodes = 0;
+    };
+
+    DEVICEID_TYPE m_deviceId;
+    size_t m_numStreams;
+    PassPlan m_plans[2];
+    mutable std::shared_ptr<ComputeStreamPool> m_pool; // created on first use
+    mutable std::shared_ptr<CpuTaskPool> m_taskPool;  // same, for CPU devices
+};
+
+}}}
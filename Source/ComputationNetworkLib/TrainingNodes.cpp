@@ -264,6 +264,619 @@ void RandomSampleInclusionFrequencyNode<ElemType>::Validate(bool isFinalValidati
 template class RandomSampleInclusionFrequencyNode<float>;
 template class RandomSampleInclusionFrequencyNode<double>;
 
+// -----------------------------------------------------------------------
+// SampledSoftmaxCrossEntropyNode
+// -----------------------------------------------------------------------
+
+template<class ElemType>
+SampledSoftmaxCrossEntropyNode<ElemType>::SampledSoftmaxCrossEntropyNode(DEVICEID_TYPE deviceId, const wstring& name, size_t numSamples)
+    : Base(deviceId, name),
+      m_numSamples(numSamples),
+      m_numClassesOfDistribution(0),
+      m_samplingWeightsTimeStamp(0),
+      m_logExpectedCounts(make_shared<Matrix<ElemType>>(deviceId)),
+      m_classIds(make_shared<Matrix<ElemType>>(deviceId)),
+      m_selection(make_shared<Matrix<ElemType>>(0, 0, deviceId, SPARSE, matrixFormatSparseCSC)),
+      m_needLogitGradients(false)
+{
+    SetRngState(CreateUniqId());
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const
+{
+    Base::CopyTo(nodeP, newName, flags);
+    if (flags & CopyNodeFlags::copyNodeValue)
+    {
+        auto node = dynamic_pointer_cast<SampledSoftmaxCrossEntropyNode<ElemType>>(nodeP);
+        node->m_numSamples = m_numSamples;
+        node->SetRngState(GetRngSeed(), GetRngOffset());
+    }
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::Save(File& fstream) const
+{
+    Base::Save(fstream);
+    fstream << m_numSamples;
+    RngUser::Save(fstream);
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::Load(File& fstream, size_t modelVersion)
+{
+    Base::Load(fstream, modelVersion);
+    fstream >> m_numSamples;
+    RngUser::Load(fstream, modelVersion);
+    m_numClassesOfDistribution = 0;
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::Validate(bool isFinalValidationPass)
+{
+    Base::Validate(isFinalValidationPass);
+    m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+    if (GetNumInputs() != 4 && GetNumInputs() != 5)
+        InvalidArgument("%ls %ls operation requires 4 or 5 inputs: labels, hidden, weights, bias and optionally samplingWeights.", NodeName().c_str(), OperationName().c_str());
+    if (m_numSamples == 0)
+        InvalidArgument("%ls %ls operation: The number of samples must be positive.", NodeName().c_str(), OperationName().c_str());
+
+    if (isFinalValidationPass)
+    {
+        if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout())
+            InvalidArgument("%ls %ls operation requires the labels and the hidden input to be minibatches.", NodeName().c_str(), OperationName().c_str());
+        this->ValidateMBLayout(Input(0), Input(1));
+        for (size_t i = 2; i < GetNumInputs(); i++)
+        {
+            if (Input(i)->HasMBLayout())
+                InvalidArgument("%ls %ls operation requires the weights, the bias and the sampling weights not to be minibatches.", NodeName().c_str(), OperationName().c_str());
+        }
+
+        const size_t numClasses = Input(0)->GetSampleLayout().GetNumElements();
+        const size_t hiddenDim = Input(1)->GetSampleLayout().GetNumElements();
+        if (Input(2)->GetAsMatrixNumRows() != hiddenDim || Input(2)->GetAsMatrixNumCols() != numClasses)
+            InvalidArgument("%ls %ls operation: The weights must be a [%d x %d] matrix (hidden dimension x number of classes), but are [%d x %d].", NodeName().c_str(), OperationName().c_str(),
+                            (int) hiddenDim, (int) numClasses, (int) Input(2)->GetAsMatrixNumRows(), (int) Input(2)->GetAsMatrixNumCols());
+        for (size_t i = 3; i < GetNumInputs(); i++)
+        {
+            if (Input(i)->GetSampleLayout().GetNumElements() != numClasses)
+                InvalidArgument("%ls %ls operation: The bias and the sampling weights must have one element per class (%d).", NodeName().c_str(), OperationName().c_str(), (int) numClasses);
+        }
+    }
+
+    SetDims(TensorShape(1), false);
+}
+
+// computes the distribution Q on first use, and again when the sampling weights have changed
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::UpdateSamplingDistribution()
+{
+    const size_t numClasses = Input(0)->GetSampleLayout().GetNumElements();
+    const bool hasSamplingWeights = GetNumInputs() > 4;
+    if (m_numClassesOfDistribution == numClasses && (!hasSamplingWeights || Input(4)->GetEvalTimeStamp() == m_samplingWeightsTimeStamp))
+        return;
+
+    std::vector<double> probabilities(numClasses);
+    if (hasSamplingWeights)
+    {
+        std::unique_ptr<ElemType[]> weights(InputRef(4).ValueAsMatrix().CopyToArray());
+        m_cumulativeProbabilities.resize(numClasses);
+        double sum = 0;
+        for (size_t c = 0; c < numClasses; c++)
+        {
+            if (weights[c] < 0)
+                InvalidArgument("%ls %ls operation: The sampling weights contain the negative number %f.", NodeName().c_str(), OperationName().c_str(), (double) weights[c]);
+            sum += weights[c];
+            m_cumulativeProbabilities[c] = sum;
+        }
+        if (sum <= 0)
+            InvalidArgument("%ls %ls operation: The sampling weights are all zero.", NodeName().c_str(), OperationName().c_str());
+        for (size_t c = 0; c < numClasses; c++)
+        {
+            probabilities[c] = weights[c] / sum;
+            m_cumulativeProbabilities[c] /= sum;
+        }
+        m_samplingWeightsTimeStamp = Input(4)->GetEvalTimeStamp();
+    }
+    else
+    {
+        m_cumulativeProbabilities.clear();
+        const double logRange = log(numClasses + 1.0);
+        for (size_t c = 0; c < numClasses; c++)
+            probabilities[c] = (log(c + 2.0) - log(c + 1.0)) / logRange;
+    }
+
+    // Classes that are never sampled get a large finite correction, so that a label with Q(c) = 0 does not make the logits infinite.
+    std::vector<ElemType> logExpectedCounts(numClasses);
+    std::vector<ElemType> classIds(numClasses);
+    for (size_t c = 0; c < numClasses; c++)
+    {
+        logExpectedCounts[c] = (ElemType) log(std::max(m_numSamples * probabilities[c], 1e-30));
+        classIds[c] = (ElemType) c;
+    }
+    m_logExpectedCounts->SetValue(1, numClasses, m_deviceId, logExpectedCounts.data());
+    m_classIds->SetValue(1, numClasses, m_deviceId, classIds.data());
+    m_numClassesOfDistribution = numClasses;
+}
+
+// draws m_numSamples classes from Q, with replacement
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::DrawSamples(std::vector<ElemType>& samples)
+{
+    const size_t numClasses = m_numClassesOfDistribution;
+    const double logRange = log(numClasses + 1.0);
+    boost::random::uniform_real_distribution<double> r(0, 1);
+    CPURNGHandle* cpuRNGHandle = dynamic_cast<CPURNGHandle*>(&GetRNGHandle(CPUDEVICE));
+
+    samples.resize(m_numSamples);
+    for (auto& sample : samples)
+    {
+        const double randomValue = r(cpuRNGHandle->Generator());
+        size_t c;
+        if (!m_cumulativeProbabilities.empty())
+            c = std::lower_bound(m_cumulativeProbabilities.begin(), m_cumulativeProbabilities.end(), randomValue) - m_cumulativeProbabilities.begin();
+        else // inverse of the cumulative log-uniform distribution
+            c = (size_t) std::max(exp(randomValue * logRange) - 1.0, 0.0);
+        sample = (ElemType) std::min(c, numClasses - 1);
+    }
+    UpdateRngOffset(GetRngOffset() + m_numSamples);
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::ForwardPropNonLooping()
+{
+    FrameRange fr(InputRef(0).GetMBLayout());
+    const size_t numSamples = m_numSamples;
+    const size_t numClasses = Input(0)->GetSampleLayout().GetNumElements();
+    Matrix<ElemType> labels = InputRef(0).ValueFor(fr);
+    Matrix<ElemType> hidden = InputRef(1).ValueFor(fr);
+    const Matrix<ElemType>& weights = InputRef(2).ValueAsMatrix();
+    const Matrix<ElemType> bias = InputRef(3).ValueAsMatrix().Reshaped(1, numClasses);
+    const size_t numCols = hidden.GetNumCols();
+
+    UpdateSamplingDistribution();
+
+    // the class of the label of each frame (0 in gaps, which are masked below)
+    m_labelIndices->AssignProductOf(*m_classIds, false, labels, false);
+    std::unique_ptr<ElemType[]> labelIndices(m_labelIndices->CopyToArray());
+
+    std::vector<ElemType> samples;
+    DrawSamples(samples);
+    m_sampleIndices->SetValue(1, numSamples, m_deviceId, samples.data());
+
+    // selection matrix: column k is the one-hot vector of the sampled class k, then of the label of frame k - numSamples
+    const size_t numSelected = numSamples + numCols;
+    std::vector<CPUSPARSE_INDEX_TYPE> selectionColumns(numSelected + 1);
+    std::vector<CPUSPARSE_INDEX_TYPE> selectionRows(numSelected);
+    std::vector<ElemType> selectionValues(numSelected, 1);
+    for (size_t k = 0; k < numSelected; k++)
+    {
+        selectionColumns[k] = (CPUSPARSE_INDEX_TYPE) k;
+        selectionRows[k] = (CPUSPARSE_INDEX_TYPE) (k < numSamples ? samples[k] : labelIndices[k - numSamples]);
+    }
+    selectionColumns[numSelected] = (CPUSPARSE_INDEX_TYPE) numSelected;
+    m_selection->SetMatrixFromCSCFormat(selectionColumns.data(), selectionRows.data(), selectionValues.data(), numSelected, numClasses, numSelected);
+
+    // gather the parameters of the sampled classes and of the labels; the bias is corrected by the log expected count
+    m_sampledWeights->DoGatherColumnsOf(0, *m_sampleIndices, weights, 1);
+    m_labelWeights->DoGatherColumnsOf(0, *m_labelIndices, weights, 1);
+    m_sampledBias->DoGatherColumnsOf(0, *m_sampleIndices, bias, 1);
+    m_sampledBias->DoGatherColumnsOf(1, *m_sampleIndices, *m_logExpectedCounts, -1);
+    m_labelLogits->DoGatherColumnsOf(0, *m_labelIndices, bias, 1);
+    m_labelLogits->DoGatherColumnsOf(1, *m_labelIndices, *m_logExpectedCounts, -1);
+
+    // logits of the sampled classes, where the accidental hits get a softmax of 0
+    m_sampledLogits->AssignProductOf(*m_sampledWeights, true, hidden, false);
+    TensorView<ElemType> sampledLogits(m_sampledLogits, TensorShape(numSamples, numCols));
+    sampledLogits.AddCopyOf(TensorView<ElemType>(m_sampledBias, TensorShape(numSamples, 1)));
+    const ElemType accidentalHitLogitOffset = (ElemType) -1e30;
+    sampledLogits.DoBinaryOpOf(1, TensorView<ElemType>(m_sampleIndices, TensorShape(numSamples, 1)), TensorView<ElemType>(m_labelIndices, TensorShape(1, numCols)),
+                               accidentalHitLogitOffset, ElementWiseOperator::opEqual, ElementWiseOperator::opSum);
+
+    // logits of the labels: column-wise inner products
+    Matrix<ElemType>::InnerProduct(*m_labelWeights, hidden, *m_labelGradient, true); // not needed before the backward pass
+    *m_labelLogits += *m_labelGradient;
+
+    // criterion: -sum over frames of the log softmax of the label among the label and the samples
+    m_logSoftmax->Resize(1 + numSamples, numCols);
+    m_logSoftmax->AssignToRowSliceValuesOf(*m_labelLogits, 0, 1);
+    m_logSoftmax->AssignToRowSliceValuesOf(*m_sampledLogits, 1, numSamples);
+    m_logSoftmax->InplaceLogSoftmax(true);
+    MaskMissingColumnsToZero(*m_logSoftmax, InputRef(0).GetMBLayout(), fr);
+    m_labelLogits->AssignRowSliceValuesOf(*m_logSoftmax, 0, 1);
+    Value().AssignSumOfElements(*m_labelLogits);
+    Value() *= -1;
+    m_needLogitGradients = true;
+}
+
+// gradients of the criterion with respect to the logits: softmax - 1 for the labels, softmax for the samples, 0 in gaps
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::ComputeLogitGradients(const FrameRange& fr)
+{
+    if (!m_needLogitGradients)
+        return;
+    m_labelGradient->AssignRowSliceValuesOf(*m_logSoftmax, 0, 1);
+    m_labelGradient->InplaceExp();
+    *m_labelGradient -= 1;
+    m_sampledGradient->AssignRowSliceValuesOf(*m_logSoftmax, 1, m_numSamples);
+    m_sampledGradient->InplaceExp();
+    MaskMissingColumnsToZero(*m_labelGradient, InputRef(0).GetMBLayout(), fr);
+    MaskMissingColumnsToZero(*m_sampledGradient, InputRef(0).GetMBLayout(), fr);
+    Matrix<ElemType>::Multiply1x1AndWeightedAdd(1, Gradient(), *m_labelGradient, 0, *m_labelGradient);
+    Matrix<ElemType>::Multiply1x1AndWeightedAdd(1, Gradient(), *m_sampledGradient, 0, *m_sampledGradient);
+    m_needLogitGradients = false;
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::BackpropToNonLooping(size_t inputIndex)
+{
+    if (inputIndex == 0 || inputIndex == 4)
+        return; // the labels and the sampling distribution get no gradient
+
+    FrameRange fr(InputRef(0).GetMBLayout());
+    const size_t numSamples = m_numSamples;
+    const size_t numClasses = Input(0)->GetSampleLayout().GetNumElements();
+    Matrix<ElemType> hidden = InputRef(1).ValueFor(fr);
+    const size_t numCols = hidden.GetNumCols();
+    ComputeLogitGradients(fr);
+
+    if (inputIndex == 1) // hidden: sampled weights * sampled gradient + label weights .* label gradient
+    {
+        auto gradient = InputRef(1).GradientFor(fr);
+        Matrix<ElemType>::MultiplyAndAdd(*m_sampledWeights, false, *m_sampledGradient, false, gradient);
+        TensorView<ElemType>(InputRef(1).GradientPtr(), TensorShape(hidden.GetNumRows(), numCols))
+            .AddElementwiseProductOf(TensorView<ElemType>(m_labelWeights, TensorShape(hidden.GetNumRows(), numCols)), TensorView<ElemType>(m_labelGradient, TensorShape(1, numCols)));
+    }
+    else if (inputIndex == 2) // weights: the gradients of the selected columns, added through the selection matrix
+    {
+        // Like the gradient of an embedding, dense * sparse' gives a sparse block-column gradient (see TimesNode).
+        if (InputRef(2).GetPreferredGradientMatrixType() == UNDETERMINED && InputRef(2).Gradient().GetMatrixType() == DENSE)
+        {
+            auto& currentGradient = InputRef(2).Gradient();
+            InputRef(2).GradientPtrRef() = std::make_shared<Matrix<ElemType>>(currentGradient.GetNumRows(), currentGradient.GetNumCols(),
+                                                                              currentGradient.GetPreferredDeviceId(), SPARSE, MatrixFormat::matrixFormatSparseBlockCol);
+            InputRef(2).SetPreferredGradientMatrixType(SPARSE);
+        }
+
+        m_selectedColumnsGradient->Resize(hidden.GetNumRows(), numSamples + numCols);
+        Matrix<ElemType> sampledColumns = m_selectedColumnsGradient->ColumnSlice(0, numSamples);
+        sampledColumns.AssignProductOf(hidden, false, *m_sampledGradient, true);
+        Matrix<ElemType> labelColumns = m_selectedColumnsGradient->ColumnSlice(numSamples, numCols);
+        labelColumns.SetValue(hidden);
+        labelColumns.RowElementMultiplyWith(*m_labelGradient);
+        Matrix<ElemType>::MultiplyAndAdd(*m_selectedColumnsGradient, false, *m_selection, true, InputRef(2).GradientAsMatrix());
+    }
+    else if (inputIndex == 3) // bias: the sums of the gradients of the selected logits, added through the selection matrix
+    {
+        m_sampledBiasGradient->Resize(numSamples, 1);
+        TensorView<ElemType>(m_sampledBiasGradient, TensorShape(numSamples, 1)).AssignCopyOf(TensorView<ElemType>(m_sampledGradient, TensorShape(numSamples, numCols)));
+        m_selectedColumnsGradient->Resize(1, numSamples + numCols);
+        m_selectedColumnsGradient->ColumnSlice(0, numSamples).SetValue(m_sampledBiasGradient->Reshaped(1, numSamples));
+        m_selectedColumnsGradient->ColumnSlice(numSamples, numCols).SetValue(*m_labelGradient);
+        Matrix<ElemType> biasGradient = InputRef(3).GradientAsMatrix().Reshaped(1, numClasses);
+        Matrix<ElemType>::MultiplyAndAdd(*m_selectedColumnsGradient, false, *m_selection, true, biasGradient);
+    }
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
+{
+    Base::RequestMatricesBeforeForwardProp(matrixPool);
+    RequestMatrixFromPool(m_sampleIndices, matrixPool);
+    RequestMatrixFromPool(m_labelIndices, matrixPool);
+    RequestMatrixFromPool(m_sampledWeights, matrixPool);
+    RequestMatrixFromPool(m_labelWeights, matrixPool);
+    RequestMatrixFromPool(m_sampledBias, matrixPool);
+    RequestMatrixFromPool(m_labelLogits, matrixPool);
+    RequestMatrixFromPool(m_sampledLogits, matrixPool);
+    RequestMatrixFromPool(m_logSoftmax, matrixPool);
+    RequestMatrixFromPool(m_labelGradient, matrixPool); // also holds the label products in the forward pass
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
+{
+    Base::RequestMatricesBeforeBackprop(matrixPool);
+    RequestMatrixFromPool(m_sampledGradient, matrixPool);
+    RequestMatrixFromPool(m_selectedColumnsGradient, matrixPool);
+    RequestMatrixFromPool(m_sampledBiasGradient, matrixPool);
+}
+
+template<class ElemType>
+void SampledSoftmaxCrossEntropyNode<ElemType>::ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+{
+    Base::ReleaseMatricesAfterBackprop(matrixPool);
+    ReleaseMatrixToPool(m_sampleIndices, matrixPool);
+    ReleaseMatrixToPool(m_labelIndices, matrixPool);
+    ReleaseMatrixToPool(m_sampledWeights, matrixPool);
+    ReleaseMatrixToPool(m_labelWeights, matrixPool);
+    ReleaseMatrixToPool(m_sampledBias, matrixPool);
+    ReleaseMatrixToPool(m_labelLogits, matrixPool);
+    ReleaseMatrixToPool(m_sampledLogits, matrixPool);
+    ReleaseMatrixToPool(m_logSoftmax, matrixPool);
+    ReleaseMatrixToPool(m_labelGradient, matrixPool);
+    ReleaseMatrixToPool(m_sampledGradient, matrixPool);
+    ReleaseMatrixToPool(m_selectedColumnsGradient, matrixPool);
+    ReleaseMatrixToPool(m_sampledBiasGradient, matrixPool);
+}
+
+template class SampledSoftmaxCrossEntropyNode<float>;
+template class SampledSoftmaxCrossEntropyNode<double>;
+
+// -----------------------------------------------------------------------
+// CRFNode (labels, position_dependent_scores, transition_scores)
+// -----------------------------------------------------------------------
+
+template<class ElemType>
+TensorView<ElemType> CRFNode<ElemType>::FramesOf(const MatrixBasePtr& matrix, size_t t, const TensorShape& frameShape) const
+{
+    const auto& pMBLayout = InputRef(0).GetMBLayout();
+    const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+    TensorShape shape = frameShape.Append(frameShape.GetRank(), pMBLayout->GetNumCols());
+    shape.NarrowTo(frameShape.GetRank(), t * numParallelSequences, (t + 1) * numParallelSequences);
+    return TensorView<ElemType>(matrix, shape);
+}
+
+template<class ElemType>
+void CRFNode<ElemType>::UpdateSequenceFlags()
+{
+    const auto& pMBLayout = InputRef(0).GetMBLayout();
+    const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+    const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+    const size_t numCols = pMBLayout->GetNumCols();
+
+    std::vector<ElemType> startFlags(numCols, 1);
+    std::vector<ElemType> endFlags(numCols, 0);
+    std::vector<ElemType> hasSuccessorFlags(numCols, 0);
+    for (const auto& sequence : pMBLayout->GetAllSequences())
+    {
+        if (sequence.seqId == GAP_SEQUENCE_ID)
+            continue;
+        const size_t tBegin = (size_t) std::max(sequence.tBegin, (ptrdiff_t) 0);
+        const size_t tEnd = std::min(sequence.tEnd, numTimeSteps);
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            const size_t j = t * numParallelSequences + sequence.s;
+            startFlags[j] = (ElemType) (t == tBegin);
+            endFlags[j] = (ElemType) (t + 1 == tEnd);
+            hasSuccessorFlags[j] = (ElemType) (t + 1 < tEnd);
+        }
+    }
+    m_startFlags->SetValue(1, numCols, m_deviceId, startFlags.data());
+    m_endFlags->SetValue(1, numCols, m_deviceId, endFlags.data());
+    m_hasSuccessorFlags->SetValue(1, numCols, m_deviceId, hasSuccessorFlags.data());
+}
+
+// the scores that the frames of time step t follow: the initial scores at the start of a sequence, else the forward scores of t-1
+template<class ElemType>
+void CRFNode<ElemType>::ComputePreviousScores(size_t t, const TensorView<ElemType>& previousScores)
+{
+    const size_t numLabels = m_alpha->GetNumRows();
+    auto result = previousScores; // [labels x parallel sequences]
+    if (t == 0) // all frames start a sequence (or are gaps)
+        result.AssignCopyOf(FramesOf(m_initialScores, t, TensorShape(numLabels)));
+    else
+        result.AssignCondOf(FramesOf(m_startFlags, t, TensorShape(1)), FramesOf(m_initialScores, t, TensorShape(numLabels)), FramesOf(m_alpha, t - 1, TensorShape(numLabels)));
+}
+
+// forward recursion over the time steps, for all sequences at once:
+//   alpha[k, t] = pos[k, t] + logsum_j (previous[j, t] + pair[k, j])
+template<class ElemType>
+void CRFNode<ElemType>::ForwardPropNonLooping()
+{
+    const auto& pMBLayout = InputRef(0).GetMBLayout();
+    FrameRange fr(pMBLayout);
+    const size_t numLabels = InputRef(1).GetSampleMatrixNumRows();
+    const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+    const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+    const size_t numCols = pMBLayout->GetNumCols();
+
+    UpdateSequenceFlags();
+
+    // dense labels; the scores that enter a sequence are 0 for its first label and LZERO for the others
+    m_labels->Resize(numLabels, numCols);
+    m_labels->AssignValuesOf(InputRef(0).Value());
+    MaskMissingColumnsToZero(*m_labels, pMBLayout, fr);
+    m_initialScores->AssignDifferenceOf(*m_labels, (ElemType) 1);
+    *m_initialScores *= (ElemType) -LZERO;
+    InputRef(1).MaskMissingValueColumnsToZero(fr);
+
+    const auto& positionScores = InputRef(1).ValuePtr();
+    const auto& transitionScores = InputRef(2).ValuePtr();
+    const TensorView<ElemType> pair(transitionScores, TensorShape(numLabels, numLabels, 1));
+
+    m_alpha->Resize(numLabels, numCols);
+    m_previousScores->Resize(numLabels, numParallelSequences);
+    const TensorView<ElemType> previous(m_previousScores, TensorShape(1, numLabels, numParallelSequences));
+    for (size_t t = 0; t < numTimeSteps; t++)
+    {
+        ComputePreviousScores(t, TensorView<ElemType>(m_previousScores, TensorShape(numLabels, numParallelSequences)));
+        auto alpha = FramesOf(m_alpha, t, TensorShape(numLabels, 1));
+        alpha.DoBinaryOpOf(0, previous, pair, 1, ElementWiseOperator::opSum, ElementWiseOperator::opLogSum);
+        alpha.AddCopyOf(FramesOf(positionScores, t, TensorShape(numLabels, 1)));
+    }
+
+    // the log partition function of a sequence is the log sum of the forward scores of its last frame
+    m_logNormalizers->Resize(1, numCols);
+    TensorView<ElemType>(m_logNormalizers, TensorShape(1, numCols)).DoUnaryOpOf(0, TensorView<ElemType>(m_alpha, TensorShape(numLabels, numCols)), 1, ElementWiseOperator::opCopy, ElementWiseOperator::opLogSum);
+
+    // the labels of the previous frames, for the transition scores of the label sequences
+    m_previousLabels->Resize(numLabels, numCols);
+    m_previousLabels->SetValue(*m_labels);
+    if (numTimeSteps > 1)
+    {
+        const size_t numShifted = numCols - numParallelSequences;
+        TensorShape labelShape(numLabels, numCols);
+        TensorView<ElemType>(m_previousLabels, TensorShape(labelShape).NarrowTo(1, numParallelSequences, numCols))
+            .AssignCondOf(TensorView<ElemType>(m_startFlags, TensorShape(1, numCols).NarrowTo(1, numParallelSequences, numCols)),
+                          TensorView<ElemType>(m_labels, TensorShape(labelShape).NarrowTo(1, numParallelSequences, numCols)),
+                          TensorView<ElemType>(m_labels, TensorShape(labelShape).NarrowTo(1, 0, numShifted)));
+    }
+    m_beta->AssignProductOf(InputRef(2).ValueAsMatrix(), false, *m_previousLabels, false); // transition scores of the labels
+
+    // -log P(labels) = log partition function - score of the labels
+    TensorView<ElemType> value(ValuePtr(), TensorShape(1));
+    value.AssignElementwiseProductOf(TensorView<ElemType>(m_logNormalizers, TensorShape(1, numCols)), TensorView<ElemType>(m_endFlags, TensorShape(1, numCols)));
+    value.AddElementwiseProductOf(TensorView<ElemType>(m_labels, TensorShape(numLabels, numCols)), TensorView<ElemType>(positionScores, TensorShape(numLabels, numCols)), -1);
+    value.AddElementwiseProductOf(TensorView<ElemType>(m_labels, TensorShape(numLabels, numCols)), TensorView<ElemType>(m_beta, TensorShape(numLabels, numCols)), -1);
+
+    m_needPosteriors = true;
+}
+
+// backward recursion over the time steps, for all sequences at once:
+//   beta[j, t] = logsum_k (pair[k, j] + pos[k, t+1] + beta[k, t+1]), and 0 for the last frame of a sequence
+// then posterior[k, t] = exp(alpha[k, t] + beta[k, t] - log partition function)
+template<class ElemType>
+void CRFNode<ElemType>::ComputePosteriors()
+{
+    if (!m_needPosteriors)
+        return;
+
+    const auto& pMBLayout = InputRef(0).GetMBLayout();
+    const size_t numLabels = m_alpha->GetNumRows();
+    const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+    const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+    const size_t numCols = pMBLayout->GetNumCols();
+    const auto& positionScores = InputRef(1).ValuePtr();
+    const TensorView<ElemType> pair(InputRef(2).ValuePtr(), TensorShape(numLabels, numLabels, 1));
+
+    m_beta->Resize(numLabels, numCols);
+    m_beta->ColumnSlice((numTimeSteps - 1) * numParallelSequences, numParallelSequences).SetValue(0);
+    const TensorView<ElemType> successor(m_previousScores, TensorShape(numLabels, 1, numParallelSequences));
+    for (size_t t = numTimeSteps - 1; t-- > 0;)
+    {
+        TensorView<ElemType>(m_previousScores, TensorShape(numLabels, numParallelSequences))
+            .AssignSumOf(FramesOf(positionScores, t + 1, TensorShape(numLabels)), FramesOf(m_beta, t + 1, TensorShape(numLabels)));
+        FramesOf(m_beta, t, TensorShape(1, numLabels)).DoBinaryOpOf(0, pair, successor, 1, ElementWiseOperator::opSum, ElementWiseOperator::opLogSum);
+        auto beta = FramesOf(m_beta, t, TensorShape(numLabels));
+        beta.AssignElementwiseProductOf(beta, FramesOf(m_hasSuccessorFlags, t, TensorShape(1)));
+    }
+
+    // log posteriors; alpha + beta sums to the log partition function in each frame of a sequence
+    TensorView<ElemType> logPosteriors(m_beta, TensorShape(numLabels, numCols));
+    TensorView<ElemType> logNormalizers(m_logNormalizers, TensorShape(1, numCols));
+    logPosteriors.AddCopyOf(TensorView<ElemType>(m_alpha, TensorShape(numLabels, numCols)));
+    logNormalizers.DoUnaryOpOf(0, logPosteriors, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opLogSum);
+    logPosteriors.AssignDifferenceOf(logPosteriors, logNormalizers);
+    m_posteriors->Resize(numLabels, numCols);
+    TensorView<ElemType>(m_posteriors, TensorShape(numLabels, numCols)).AssignExpOf(logPosteriors);
+    MaskMissingColumnsToZero(*m_posteriors, pMBLayout, FrameRange(pMBLayout));
+
+    m_needPosteriors = false;
+}
+
+template<class ElemType>
+void CRFNode<ElemType>::BackpropToNonLooping(size_t inputIndex)
+{
+    // this should never be called for input[0], which is controlled through learningRateMultiplier == 0
+    if (inputIndex != 1 && inputIndex != 2)
+        InvalidArgument("CRFNode only takes with respect to input and weight.");
+
+    const auto& pMBLayout = InputRef(0).GetMBLayout();
+    FrameRange fr(pMBLayout);
+    ComputePosteriors();
+
+    if (inputIndex == 1) // position scores: posteriors - labels
+    {
+        auto gradient = InputRef(1).GradientFor(fr);
+        Matrix<ElemType>::AddScaledDifference(Gradient(), *m_posteriors, *m_labels, gradient);
+    }
+    else if (inputIndex == 2) // transition scores: expected - observed transition counts
+    {
+        const size_t numLabels = m_alpha->GetNumRows();
+        const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+        const size_t numCols = pMBLayout->GetNumCols();
+        const TensorView<ElemType> pair(InputRef(2).ValuePtr(), TensorShape(numLabels, numLabels, 1));
+
+        // The expected count of the transition from j to k in frame t is
+        //   exp(previous[j, t] + pair[k, j] + pos[k, t] + beta[k, t] - log partition function),
+        // where the last three terms are the log posterior of k minus its forward score plus its position score.
+        // The log posteriors in m_beta are not needed anymore after this.
+        TensorView<ElemType> followingScores(m_beta, TensorShape(numLabels, numCols));
+        followingScores.AddCopyOf(TensorView<ElemType>(InputRef(1).ValuePtr(), TensorShape(numLabels, numCols)));
+        followingScores.AddCopyOf(TensorView<ElemType>(m_alpha, TensorShape(numLabels, numCols)), -1);
+        MaskMissingColumnsTo(*m_beta, pMBLayout, fr, (ElemType) LZERO);
+
+        m_transitionScores->Resize(numLabels * numLabels, numParallelSequences);
+        TensorView<ElemType> transitions(m_transitionScores, TensorShape(numLabels, numLabels, numParallelSequences));
+        m_expectedTransitions->Resize(numLabels, numLabels);
+        TensorView<ElemType> expectedTransitions(m_expectedTransitions, TensorShape(numLabels, numLabels, 1));
+        for (size_t t = 0; t < numTimeSteps; t++)
+        {
+            ComputePreviousScores(t, TensorView<ElemType>(m_previousScores, TensorShape(numLabels, numParallelSequences)));
+            transitions.AssignSumOf(TensorView<ElemType>(m_previousScores, TensorShape(1, numLabels, numParallelSequences)), pair);
+            transitions.AssignSumOf(transitions, FramesOf(m_beta, t, TensorShape(numLabels, 1)));
+            expectedTransitions.DoUnaryOpOf(t == 0 ? 0 : 1, transitions, 1, ElementWiseOperator::opExp, ElementWiseOperator::opSum);
+        }
+
+        m_observedTransitions->AssignProductOf(*m_labels, false, *m_previousLabels, true);
+        Matrix<ElemType>::AddScaledDifference(Gradient(), *m_expectedTransitions, *m_observedTransitions, InputRef(2).GradientAsMatrix());
+    }
+}
+
+template<class ElemType>
+void CRFNode<ElemType>::Validate(bool isFinalValidationPass)
+{
+    Base::Validate(isFinalValidationPass);
+    m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+    if (isFinalValidationPass)
+        if (!(InputRef(1).GetSampleMatrixNumRows() == InputRef(2).GetAsMatrixNumRows() && // position dependent and pair scores have same number of labels
+              InputRef(0).GetSampleMatrixNumRows() == InputRef(1).GetSampleMatrixNumRows() &&
+              InputRef(0).HasMBLayout() && InputRef(0).GetMBLayout() == InputRef(1).GetMBLayout() &&
+              InputRef(2).GetAsMatrixNumCols() == InputRef(2).GetAsMatrixNumRows()))
+        {
+            LogicError("The Matrix dimension in the CRFNode operation does not match.");
+        }
+
+    SetDims(TensorShape(1), false);
+}
+
+template<class ElemType>
+void CRFNode<ElemType>::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
+{
+    Base::RequestMatricesBeforeForwardProp(matrixPool);
+    RequestMatrixFromPool(m_labels, matrixPool);
+    RequestMatrixFromPool(m_previousLabels, matrixPool);
+    RequestMatrixFromPool(m_initialScores, matrixPool);
+    RequestMatrixFromPool(m_alpha, matrixPool);
+    RequestMatrixFromPool(m_logNormalizers, matrixPool);
+    RequestMatrixFromPool(m_beta, matrixPool); // also holds the transition scores of the labels in the forward pass
+    RequestMatrixFromPool(m_previousScores, matrixPool);
+}
+
+template<class ElemType>
+void CRFNode<ElemType>::RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
+{
+    Base::RequestMatricesBeforeBackprop(matrixPool);
+    RequestMatrixFromPool(m_posteriors, matrixPool);
+    RequestMatrixFromPool(m_transitionScores, matrixPool);
+    RequestMatrixFromPool(m_expectedTransitions, matrixPool);
+    RequestMatrixFromPool(m_observedTransitions, matrixPool);
+}
+
+template<class ElemType>
+void CRFNode<ElemType>::ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+{
+    Base::ReleaseMatricesAfterBackprop(matrixPool);
+    ReleaseMatrixToPool(m_labels, matrixPool);
+    ReleaseMatrixToPool(m_previousLabels, matrixPool);
+    ReleaseMatrixToPool(m_initialScores, matrixPool);
+    ReleaseMatrixToPool(m_alpha, matrixPool);
+    ReleaseMatrixToPool(m_logNormalizers, matrixPool);
+    ReleaseMatrixToPool(m_beta, matrixPool);
+    ReleaseMatrixToPool(m_previousScores, matrixPool);
+    ReleaseMatrixToPool(m_posteriors, matrixPool);
+    ReleaseMatrixToPool(m_transitionScores, matrixPool);
+    ReleaseMatrixToPool(m_expectedTransitions, matrixPool);
+    ReleaseMatrixToPool(m_observedTransitions, matrixPool);
+}
+
+template class CRFNode<float>;
+template class CRFNode<double>;
+
 template<class ElemType>
 void DropoutNode<ElemType>::Save(File& fstream) const
 {
@@ -108,6 +108,8 @@ template class SquareErrorNode<double>;
 // -----------------------------------------------------------------------
 // CrossEntropyWithSoftmaxNode (labels, prediction)
 // calculates: -sum(left_i * log(softmax_i(right)))
+// The softmax is fused into the criterion: ForwardProp keeps only log(sum(exp(right))) per column,
+// and the gradients recompute the softmax from it, instead of storing softmax and log softmax of the full [V x T] input.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -130,13 +132,14 @@ public:
         if (inputIndex == 0) // left derivative
         {
 #if DUMPOUTPUT
-            m_logSoftmaxOfRight->Print("CrossEntropyWithSoftmax Partial-logSoftmaxOfRight");
+            m_logSumExpOfRight->Print("CrossEntropyWithSoftmax Partial-logSumExpOfRight");
             Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
             InputRef(0).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-in");
 #endif
 
+            // -= Gradient() /*1x1*/ * logSoftmax(right)
             auto gradient = InputRef(0).GradientFor(fr);
-            Matrix<ElemType>::Multiply1x1AndWeightedAdd(-1.0f, Gradient() /*1x1*/, *m_logSoftmaxOfRight, 1.0f, gradient);
+            Matrix<ElemType>::AddSoftmaxCrossEntropyLabelGradient(Gradient(), InputRef(1).ValueFor(fr), *m_logSumExpOfRight, gradient);
 #if DUMPOUTPUT
             InputRef(0).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-out");
 #endif
@@ -145,14 +148,15 @@ public:
         else if (inputIndex == 1) // right derivative
         {
 #if DUMPOUTPUT
-            m_softmaxOfRight->Print("CrossEntropyWithSoftmax Partial-softmaxOfRight");
+            m_logSumExpOfRight->Print("CrossEntropyWithSoftmax Partial-logSumExpOfRight");
             InputRef(0).ValueFor(fr).Print("CrossEntropyWithSoftmax Partial-inputFunctionValues");
             Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
             InputRef(1).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right-in");
 #endif
 
+            // += Gradient() /*1x1*/ * (softmax(right) - left)
             auto gradient = InputRef(1).GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, InputRef(0).ValueFor(fr), gradient);
+            Matrix<ElemType>::AddSoftmaxCrossEntropyGradient(Gradient(), InputRef(0).ValueFor(fr), InputRef(1).ValueFor(fr), *m_logSumExpOfRight, gradient);
 #if DUMPOUTPUT
             InputRef(1).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right");
 #endif
@@ -169,24 +173,15 @@ public:
 
     virtual void UpdateFunctionMBSize() override
     {
-        m_logSoftmaxOfRight->Resize(Input(1)->Value());
-        m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
+        m_logSumExpOfRight->Resize(1, Input(1)->Value().GetNumCols());
     }
 
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(InputRef(0).GetMBLayout());
-        // first compute the softmax (column-wise)
-        // Note that we need both log and non-log for gradient computation.
-        m_logSoftmaxOfRight->AssignLogSoftmaxOf(InputRef(1).ValueFor(fr), true);
-        // BUGBUG: No need to compute m_softmaxOfRight in ForwardProp, should be moved to BackpropTo().
-        m_softmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-        m_softmaxOfRight->InplaceExp();
-        // flatten all gaps to zero, such that gaps will contribute zero to the sum
-        MaskMissingColumnsToZero(*m_logSoftmaxOfRight, InputRef(1).GetMBLayout(), fr);
-        // reduce over all frames
-        Value().AssignInnerProductOfMatrices(InputRef(0).MaskedValueFor(fr), *m_logSoftmaxOfRight);
-        Value() *= -1;
+        // single fused pass (column-wise) that reduces over all frames
+        // Gaps have all-zero (masked) labels, for which the kernel ignores the prediction, so they contribute zero to the sum.
+        Value().AssignSoftmaxCrossEntropyOf(InputRef(0).MaskedValueFor(fr), InputRef(1).ValueFor(fr), *m_logSumExpOfRight);
 #if NANCHECK
         Value().HasNan("CrossEntropyWithSoftmax");
 #endif
@@ -206,8 +201,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
-            node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-            node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
+            node->m_logSumExpOfRight->SetValue(*m_logSumExpOfRight);
         }
     }
 
@@ -215,21 +209,18 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
-        RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        RequestMatrixFromPool(m_logSumExpOfRight, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_logSoftmaxOfRight, matrixPool);
-        ReleaseMatrixToPool(m_softmaxOfRight, matrixPool);
+        ReleaseMatrixToPool(m_logSumExpOfRight, matrixPool);
     }
 
 protected:
-    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
-    shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    shared_ptr<Matrix<ElemType>> m_logSumExpOfRight; // [1 x T], log(sum(exp(right))) per column
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -459,6 +450,9 @@ template class MatrixL1RegNode<double>;
 // -----------------------------------------------------------------------
 // LambdaRankNode (gain, prediction, queryId)
 // Check "From RankNet to LambdaRank to LambdaMART: An Overview" for details.
+// The urls of each query are ranked, and the lambdas of all pairs of urls of a query computed, on the device of the
+// inputs (see Matrix::RankWithinGroups() and Matrix::AddLambdaRankGradient()), so that large queries do not make the
+// criterion the bottleneck. With truncation > 0, the NDCG and the lambdas only consider the first 'truncation' ranks.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -472,9 +466,13 @@ class LambdaRankNode : public ComputationNodeNonLooping /*ComputationNode*/<Elem
     }
 
 public:
-    DeclareConstructorFromConfigWithNumInputs(LambdaRankNode);
-    LambdaRankNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name), m_sigma(1.0)
+    LambdaRankNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : LambdaRankNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Exists(L"truncation") ? (size_t)configp->Get(L"truncation") : 0)
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+    LambdaRankNode(DEVICEID_TYPE deviceId, const wstring& name, size_t truncation = 0)
+        : Base(deviceId, name), m_sigma(1.0), m_truncation(truncation)
     {
     }
 
@@ -482,66 +480,11 @@ public:
     {
         FrameRange fr(Input(0)->GetMBLayout());
 
-        if (inputIndex == 1 &&  // right derivative
-            m_numberOfUrlPairs > 0)   // 
+        if (inputIndex == 1) // right derivative
         {
             auto gradient = Input(1)->GradientFor(fr);
-
-            // sigma * (si - sj)
-            *m_pairwiseDifferences *= m_sigma;
-            // exp(sigma * (si - sj))
-            m_lambdas->AssignExpOf(*m_pairwiseDifferences);
-            // 1 + exp(sigma * (si - sj))
-            *m_lambdas += 1;
-            // 1 / (1 + exp(sigma * (si - sj)))
-            m_lambdas->AssignElementInverseOf(*m_lambdas);
-            // -sigma/(1+exp(sigma*(si - sj)))
-            m_lambdas->AssignProductOf(-m_sigma, *m_lambdas);
-
-            // Get the update of weight.
-            const Matrix<ElemType>& lambdas = *m_lambdas;
-            m_weightUpdate->SetValue(gradient);
-            size_t pairsCount = 0;
-            ElemType discountI, discountJ;
-            ElemType gainI;
-            ElemType lambdaIJ;
-            for (auto qu : m_queryUrls)
-            {
-                ElemType idealMetric = qu.m_idealMetric;
-                for (typename std::vector<Url>::iterator itUrlI = qu.m_urls.begin(); itUrlI != qu.m_urls.end(); itUrlI++)
-                {
-                    Url& UrlI = *itUrlI;
-                    size_t k = UrlI.m_K;
-                    discountI = m_logWeights[UrlI.m_rank];
-                    gainI = UrlI.m_gain;
-                    if (k == 0) continue;
-                    for (typename std::vector<Url>::iterator itUrlJ = itUrlI + 1; itUrlJ <= itUrlI + k; itUrlJ++)
-                    {
-                        Url& UrlJ = *itUrlJ;
-                        discountJ = m_logWeights[UrlJ.m_rank];
-                        if (abs(gainI - UrlJ.m_gain) < 0.0000001)
-                        {
-                            continue;
-                        }
-
-                        // delta DCG
-                        lambdaIJ = (gainI - UrlJ.m_gain) * (discountI - discountJ) / (discountI * discountJ);
-
-                        // |delta NDCG|
-                        lambdaIJ = (idealMetric == 0.0 ? (ElemType) 0.0 : abs(lambdaIJ / idealMetric));
-
-                        // Combine lambda
-                        lambdaIJ = lambdas(0, pairsCount++) * lambdaIJ;
-
-                        // Assign to gradient
-                        (*m_weightUpdate)(0, UrlI.m_id) += lambdaIJ;
-                        (*m_weightUpdate)(0, UrlJ.m_id) -= lambdaIJ;
-                        
-                    }
-                }
-            }
-
-            gradient.SetValue(*m_weightUpdate);
+            Matrix<ElemType>::AddLambdaRankGradient(Input(1)->ValueFor(fr), Input(0)->ValueFor(fr), *m_ranks, *m_groupStarts, *m_idealDCGs,
+                                                    m_sigma, m_truncation, gradient);
         }
     }
 
@@ -550,35 +493,6 @@ public:
         return false;
     }
 
-    virtual void UpdateFunctionMBSize() override
-    {
-        UpdateCounts();
-
-        // clean up first
-        if (!m_queryUrls.empty()) m_queryUrls.clear();
-        if (!m_urlSorter.empty()) m_urlSorter.clear();
-        if (!m_logWeights.empty()) m_logWeights.clear();
-
-        m_pairwiseDifferences->Resize(1, m_numberOfUrlPairs);
-        m_lambdas->Resize(1, m_numberOfUrlPairs);
-
-        m_urlGain0->Resize(1, m_numberOfQueryUrls);
-        m_urlGain1->Resize(1, m_numberOfQueryUrls);
-        m_urlDiscount0->Resize(1, m_numberOfQueryUrls);
-        m_urlDiscount1->Resize(1, m_numberOfQueryUrls);
-
-        // keep one additional space to avoid pointer moving out
-        m_urlSorter.resize(m_maxNumberOfUrlsPerQuery + 1);
-        
-        // prepared lookup table
-        m_logWeights.resize(m_maxNumberOfUrlsPerQuery);
-        size_t i = 0;
-        for (typename std::vector<ElemType>::iterator it = m_logWeights.begin(); it != m_logWeights.end(); it++, i++)
-        {
-            *it = (ElemType) log(2.0 + i);
-        }
-    }
-
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         // Inputs:
@@ -587,6 +501,7 @@ public:
         //      2. query id (used to separate urls belonging to different queries)
         // 
         // Following is an example: two queries (0 and 1) and 6 urls (three for each).
+        // Urls are grouped by queries, and pre-sorted in descending order of gains within each query.
         // 31,  0.9,    0
         // 7,   0.3,    0
         // 0,   0.0,    0
@@ -595,127 +510,25 @@ public:
         // 0,   0.3,    1
         FrameRange fr(Input(0)->GetMBLayout());
 
-        // Construct matrices for further computation.
         const Matrix<ElemType>& gains = Input(0)->ValueFor(fr);
         const Matrix<ElemType>& preds = Input(1)->ValueFor(fr);
         const Matrix<ElemType>& queryIds = Input(2)->ValueFor(fr);
+        const size_t numberOfSamples = gains.GetNumCols();
+        const size_t numberOfQueries = UpdateQueryStarts(queryIds);
 
-        // Iterate through all samples
-        size_t numberOfSamples = gains.GetNumCols();
-        QueryUrls aqu;
-        int previousQueryId = -1;
-        int numberOfQueries = 0;
-
-        // Iterate all samples and populate m_queryUrls table. 
-        for (size_t i = 0; i < numberOfSamples; i++)
-        {
-            int queryId = (int)queryIds(0, i);
-            // Samples are grouped by queries. Find all the urls 
-            // belonging to each individual query.
-            if (queryId != previousQueryId)
-            {
-                m_queryUrls.push_back(aqu);
-                numberOfQueries++;
-                previousQueryId = queryId;
-            }
-
-            // Get the last QueryUrls and add the Url.
-            QueryUrls& qu = m_queryUrls.back();
-            Url u(i, qu.m_urls.size(), preds(0, i), gains(0, i));
-            qu.m_urls.push_back(u);
-        }
-
-        // Update K (number of url pairs that have smaller or equal gain), rk (rank of 
-        // score in descending order) and and m_pairwiseDifferences (save for gradient 
-        // computation).
-        size_t pairCount = 0;
-        for (auto &qu : m_queryUrls)
-        {
-            std::vector<Url>& urls = qu.m_urls;
-            size_t numberOfUrls = urls.size();
-            // Urls are pre-sorted in descending order of gains.
-            ElemType minGain = urls[numberOfUrls - 1].m_gain;
-            for (size_t j = 0; j < urls.size(); j++)
-            {
-                if (urls[j].m_gain > minGain)
-                {
-                    size_t numberOfPairs = numberOfUrls - j - 1;
-                    urls[j].m_K = numberOfPairs;
-                    if (numberOfPairs > 0)
-                    {
-                        for (size_t k = 0; k < numberOfPairs; k++)
-                        {
-                            (*m_pairwiseDifferences)(0, pairCount++) = urls[j].m_score - urls[j + 1 + k].m_score;
-                        }
-                    }
-                }
-                // Skip urls with gain equal to min (0).
-                else 
-                {
-                    urls[j].m_K = 0;
-                }
-            }
-
-            typename std::vector<Url>::iterator its = m_urlSorter.begin(), it = urls.begin();
-            typename std::vector<Url>::iterator its0 = its;
-            its = std::copy(it, urls.end(), its);
-            std::sort(its0, its);
-            // Set the sorted rk order to each url and 
-            // the urls are still in the original order
-            int rk = 0;
-            for (it = its0; it != its; it++)
-            {
-                urls[it->m_rank0].m_rank = rk++;
-            }
-        }
-
-        // Compute ir metric.
-        size_t sampleCount = 0;
-        for (const auto &qu: m_queryUrls)
-        {
-            for (const auto &url : qu.m_urls)
-            {
-                (*m_urlGain0)(0, sampleCount) = url.m_gain;
-                (*m_urlGain1)(0, sampleCount) = url.m_gain;
-                (*m_urlDiscount0)(0, sampleCount) = (ElemType)url.m_rank0;
-                (*m_urlDiscount1)(0, sampleCount) = (ElemType)url.m_rank;
-                sampleCount++;
-            }
-        }
-        
-        // log(2+rank)
-        *m_urlDiscount0 += 2.0;
-        m_urlDiscount0->InplaceLog();
-        *m_urlDiscount1 += 2.0;
-        m_urlDiscount1->InplaceLog();
-        // gain/log(2+rank)
-        m_urlGain0->AssignElementDivisionOf(*m_urlGain0, *m_urlDiscount0);
-        m_urlGain1->AssignElementDivisionOf(*m_urlGain1, *m_urlDiscount1);
+        // Rank the urls of each query by score, and compute the DCG and the ideal DCG of each query.
+        Matrix<ElemType>::RankWithinGroups(preds, gains, *m_groupStarts, m_truncation, *m_ranks, *m_dcgs, *m_idealDCGs);
 
         // Aggregate at query level.
-        const Matrix<ElemType>& urlDiscountedGain0 = *m_urlGain0;
-        const Matrix<ElemType>& urlDiscountedGain1 = *m_urlGain1;
+        m_metrics.resize(numberOfQueries);
+        m_idealMetrics.resize(numberOfQueries);
+        m_dcgs->CopySection(1, numberOfQueries, m_metrics.data(), 1);
+        m_idealDCGs->CopySection(1, numberOfQueries, m_idealMetrics.data(), 1);
         ElemType irMetricValue = 0.0;
-        for (auto &qu : m_queryUrls)
-        {
-            qu.m_idealMetric = 0.0;
-            qu.m_metric = 0.0;
-
-            for (const auto &url : qu.m_urls)
-            {
-                qu.m_idealMetric += urlDiscountedGain0(0, url.m_id);
-                qu.m_metric += urlDiscountedGain1(0, url.m_id);
-            }
-
-            if (qu.m_idealMetric != 0.0)
-            {
-                irMetricValue += (qu.m_metric / qu.m_idealMetric);
-            }
-        }
-
-        if (numberOfQueries == 0)
+        for (size_t q = 0; q < numberOfQueries; q++)
         {
-            LogicError("In %ls %ls numberOfQueries==0, check your data.", NodeName().c_str(), OperationName().c_str());
+            if (m_idealMetrics[q] != 0.0)
+                irMetricValue += m_metrics[q] / m_idealMetrics[q];
         }
 
         // to make up the reporting
@@ -743,172 +556,85 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<LambdaRankNode<ElemType>>(nodeP);
-            node->m_pairwiseDifferences->SetValue(*m_pairwiseDifferences);
-            node->m_lambdas->SetValue(*m_lambdas);
-            node->m_weightUpdate->SetValue(*m_weightUpdate);
-            node->m_urlGain0->SetValue(*m_urlGain0);
-            node->m_urlGain1->SetValue(*m_urlGain1);
-            node->m_urlDiscount0->SetValue(*m_urlDiscount0);
-            node->m_urlDiscount1->SetValue(*m_urlDiscount1);
-
-            node->m_queryUrls = m_queryUrls;
-            node->m_urlSorter = m_urlSorter;
-            node->m_logWeights = m_logWeights;
+            node->m_truncation = m_truncation;
         }
     }
 
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_truncation;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        if (modelVersion >= CNTK_MODEL_VERSION_26)
+            fstream >> m_truncation;
+    }
+
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_pairwiseDifferences, matrixPool);
-        RequestMatrixFromPool(m_lambdas, matrixPool);
-        RequestMatrixFromPool(m_weightUpdate, matrixPool);
-        RequestMatrixFromPool(m_urlGain0, matrixPool);
-        RequestMatrixFromPool(m_urlGain1, matrixPool);
-        RequestMatrixFromPool(m_urlDiscount0, matrixPool);
-        RequestMatrixFromPool(m_urlDiscount1, matrixPool);
+        RequestMatrixFromPool(m_groupStarts, matrixPool);
+        RequestMatrixFromPool(m_ranks, matrixPool);
+        RequestMatrixFromPool(m_dcgs, matrixPool);
+        RequestMatrixFromPool(m_idealDCGs, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_pairwiseDifferences, matrixPool);
-        ReleaseMatrixToPool(m_lambdas, matrixPool);
-        ReleaseMatrixToPool(m_weightUpdate, matrixPool);
-        ReleaseMatrixToPool(m_urlGain0, matrixPool);
-        ReleaseMatrixToPool(m_urlGain1, matrixPool);
-        ReleaseMatrixToPool(m_urlDiscount0, matrixPool);
-        ReleaseMatrixToPool(m_urlDiscount1, matrixPool);
-        
-        // is this the right place?  it was not called after bp.
-        m_queryUrls.clear();
-        m_urlSorter.clear();
-        m_logWeights.clear();
+        ReleaseMatrixToPool(m_groupStarts, matrixPool);
+        ReleaseMatrixToPool(m_ranks, matrixPool);
+        ReleaseMatrixToPool(m_dcgs, matrixPool);
+        ReleaseMatrixToPool(m_idealDCGs, matrixPool);
     }
 
 protected:
 
-    void UpdateCounts()
+    // Finds the first url of each query and the number of urls in m_groupStarts, and returns the number of queries.
+    size_t UpdateQueryStarts(const Matrix<ElemType>& queryIds)
     {
-        FrameRange fr(Input(0)->GetMBLayout());
-        const Matrix<ElemType>& gains = Input(0)->ValueFor(fr);
-        const Matrix<ElemType>& queryIds = Input(2)->ValueFor(fr);
-        const size_t numberOfQueryUrls = gains.GetNumCols();
-        int previousQueryId = -1;
-
-        // Number of urls we have seen for the current query
-        size_t numberOfUrls = 0;
-
-        // Number of urls that have gains greater than 0 for the current query 
-        size_t numberOfUrlsWithNonZeroGain = 0;
-        size_t numberOfUrlPairs = 0;
-        size_t maxNumberOfUrlsPerQuery = 0;
-        for (size_t i = 0; i < numberOfQueryUrls; i++)
+        const size_t numberOfSamples = queryIds.GetNumCols();
+        m_queryIds.resize(numberOfSamples);
+        queryIds.CopySection(1, numberOfSamples, m_queryIds.data(), 1);
+        m_queryStarts.clear();
+        for (size_t i = 0; i < numberOfSamples; i++)
         {
-            int queryId = (int)queryIds(0, i);
-            ElemType gain = gains(0, i);
-            if (queryId != previousQueryId)
-            {
-                // Ignore pairs between urls with zero gains.
-                numberOfUrlPairs += (2 * numberOfUrls - 1 - numberOfUrlsWithNonZeroGain) * numberOfUrlsWithNonZeroGain / 2;
-                if (numberOfUrls > maxNumberOfUrlsPerQuery)
-                {
-                    maxNumberOfUrlsPerQuery = numberOfUrls;
-                }
-
-                // New query
-                numberOfUrls = 0;
-                numberOfUrlsWithNonZeroGain = 0;
-                previousQueryId = queryId;
-            }
-            
-            numberOfUrls++;
-            if (gain > 0)
-            {
-                numberOfUrlsWithNonZeroGain++;
-            }
+            if (i == 0 || (int)m_queryIds[i] != (int)m_queryIds[i - 1])
+                m_queryStarts.push_back((ElemType)i);
         }
 
-        // Add last query.
+        const size_t numberOfQueries = m_queryStarts.size();
+        if (numberOfQueries == 0)
         {
-            numberOfUrlPairs += (2 * numberOfUrls - 1 - numberOfUrlsWithNonZeroGain) * numberOfUrlsWithNonZeroGain / 2;
-            if (numberOfUrls > maxNumberOfUrlsPerQuery)
-            {
-                maxNumberOfUrlsPerQuery = numberOfUrls;
-            }
+            LogicError("In %ls %ls numberOfQueries==0, check your data.", NodeName().c_str(), OperationName().c_str());
         }
 
-        m_numberOfQueryUrls = numberOfQueryUrls;
-        m_numberOfUrlPairs = numberOfUrlPairs;
-        m_maxNumberOfUrlsPerQuery = maxNumberOfUrlsPerQuery;
+        m_queryStarts.push_back((ElemType)numberOfSamples);
+        m_groupStarts->SetValue(1, m_queryStarts.size(), m_groupStarts->GetDeviceId(), m_queryStarts.data());
+        return numberOfQueries;
     }
 
-    struct Url
-    {
-        Url()
-        {
-            m_id = 0;
-            m_rank0 = 0;
-            m_rank = 0;
-            m_score = (ElemType)0;
-            m_gain = (ElemType)0;
-            m_K = 0;
-        }
-
-        Url(int id, int rk0, ElemType sc, ElemType gn) : m_id(id), m_rank0(rk0), m_rank(0), m_score(sc), m_gain(gn), m_K(0) {}
-
-        int m_id;           // sample id
-        int m_rank0;        // original rank based on label
-        int m_rank;         // rank based on s in the associated query
-        ElemType m_score;   // score
-        ElemType m_gain;    // gain
-        int m_K;            // the pair index
-        bool operator < (const Url &url) const {
-            // tie breaking
-            if (m_score == url.m_score || std::isnan(m_score) || std::isnan(url.m_score))
-            {
-                return m_gain < url.m_gain;
-            }
-
-            return m_score > url.m_score;
-        }
-    };
-
-    struct QueryUrls
-    {
-        ElemType m_idealMetric;  // the ideal NDCG
-        ElemType m_metric;   // NDCG based on the current scores
-
-        std::vector<Url> m_urls;
-    };
-
-    // master data structure
-    std::list<QueryUrls> m_queryUrls;
-    // buffer for sorting
-    std::vector<Url> m_urlSorter;
-    // lookup table for position based weights
-    std::vector<ElemType> m_logWeights;
-
-    size_t m_numberOfQueryUrls;
-    size_t m_numberOfUrlPairs;
-    size_t m_maxNumberOfUrlsPerQuery;
-
     ElemType m_sigma;
-    // Score differences between url pairs
-    shared_ptr<Matrix<ElemType>> m_pairwiseDifferences;
-    // 1/(1+exp(sigma*(si - sj)))
-    shared_ptr<Matrix<ElemType>> m_lambdas;
-    
-    // update of weight matrix
-    shared_ptr<Matrix<ElemType>> m_weightUpdate;
-    
-    // store the gains and position discounts
-    shared_ptr<Matrix<ElemType>> m_urlGain0;
-    shared_ptr<Matrix<ElemType>> m_urlGain1;
-    shared_ptr<Matrix<ElemType>> m_urlDiscount0;
-    shared_ptr<Matrix<ElemType>> m_urlDiscount1;
+    size_t m_truncation; // 0: all ranks
+
+    // host buffers
+    std::vector<ElemType> m_queryIds;
+    std::vector<ElemType> m_queryStarts;
+    std::vector<ElemType> m_metrics;
+    std::vector<ElemType> m_idealMetrics;
+
+    // first url of each query, and the number of urls
+    shared_ptr<Matrix<ElemType>> m_groupStarts;
+    // rank of each url by score within its query
+    shared_ptr<Matrix<ElemType>> m_ranks;
+    // DCG of each query at these ranks, and at the ideal ranks
+    shared_ptr<Matrix<ElemType>> m_dcgs;
+    shared_ptr<Matrix<ElemType>> m_idealDCGs;
 };
 
 template class LambdaRankNode<float>;
@@ -1280,6 +1006,7 @@ public:
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false;}
+    virtual bool /*ComputationNodeBase::*/ CanReplayForwardProp() const override { return false; } // samples anew for each minibatch
     virtual void /*ComputationNode::*/ ForwardPropNonLooping() override{}
     virtual bool GetAllowDuplicates() const { return m_allowDuplicates; }
     virtual size_t GetNumSamples() const { return m_sizeOfSampledSet; }
@@ -1368,6 +1095,95 @@ private:
     double EstimateNumberOfTries();
 };
 
+// ------------------------------------------------------------------------------------------------------------------------------------------------
+// SampledSoftmaxCrossEntropyNode(labels, hidden, weights, bias[, samplingWeights], numSamples):
+// Cross entropy with a softmax over a random subset of the classes (sampled softmax), the training criterion for output layers with
+// large vocabularies. Without sampling it would be CrossEntropyWithSoftmax(labels, weights' * hidden + bias).
+//
+// For each minibatch numSamples classes are drawn with replacement from a distribution Q, on the CPU. Each frame is scored against its
+// label and the sampled classes only: the logit of a class c is corrected by -log(numSamples * Q(c)), its expected count in the sample,
+// and sampled classes that equal the label of the frame ("accidental hits") are excluded. The criterion is the sum over the frames of
+// -log of the softmax of the label's logit among these numSamples + 1 logits. It is meant for training; evaluate with the full softmax.
+//
+// Only the columns of 'weights' and the elements of 'bias' of the sampled classes and of the labels are gathered, on the device of the
+// network. Their gradients are accumulated through a sparse selection matrix, so that, like the gradient of an embedding (TimesNode with
+// a sparse input), the gradient of 'weights' is a sparse block-column matrix that sparse learners update column by column (unless another
+// consumer of 'weights' has made it dense).
+//
+// Parameters:
+// * Input(0) labels: one-hot (usually sparse) labels of shape [numClasses], a minibatch.
+// * Input(1) hidden: input of the output layer of shape [hiddenDim], a minibatch with the layout of the labels.
+// * Input(2) weights: matrix of shape [hiddenDim x numClasses].
+// * Input(3) bias: vector of shape [numClasses].
+// * Input(4) samplingWeights (optional): Q is proportional to these weights >= 0 (e.g. unigram counts, or counts^0.75). Without it Q is
+//   the log-uniform (Zipfian) distribution Q(c) = log((c + 2) / (c + 1)) / log(numClasses + 1), for classes sorted by decreasing frequency.
+// * numSamples: number of classes drawn per minibatch.
+// --------------------------------------------------------------------------------------------------------------------------------------------------
+template <class ElemType>
+class SampledSoftmaxCrossEntropyNode : public ComputationNodeNonLooping<ElemType>, public RngUser
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"SampledSoftmaxCrossEntropy"; }
+
+public:
+    SampledSoftmaxCrossEntropyNode(DEVICEID_TYPE deviceId, const wstring& name, size_t numSamples = 0);
+    SampledSoftmaxCrossEntropyNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : SampledSoftmaxCrossEntropyNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"numSamples"))
+    {
+        AttachInputsFromConfig(configp);
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
+    virtual void Save(File& fstream) const override;
+    virtual void Load(File& fstream, size_t modelVersion) override;
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 1; }
+    virtual bool /*ComputationNodeBase::*/ CanReplayForwardProp() const override { return false; } // samples anew for each minibatch
+    virtual void UpdateFunctionMBSize() override {}
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override;
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override;
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override;
+
+    size_t GetNumSamples() const { return m_numSamples; }
+
+private:
+    void UpdateSamplingDistribution();
+    void DrawSamples(std::vector<ElemType>& samples);
+    void ComputeLogitGradients(const FrameRange& fr);
+
+    size_t m_numSamples;
+
+    // sampling distribution Q
+    std::vector<double> m_cumulativeProbabilities;  // of the samplingWeights; empty for log-uniform sampling
+    size_t m_numClassesOfDistribution;              // 0 if not determined yet
+    uint64_t m_samplingWeightsTimeStamp;            // of the samplingWeights that m_cumulativeProbabilities was computed from
+    shared_ptr<Matrix<ElemType>> m_logExpectedCounts; // [1 x numClasses] log(numSamples * Q(c)) on the device
+    shared_ptr<Matrix<ElemType>> m_classIds;          // [1 x numClasses] 0, 1, 2, ... to find the labels by a product
+
+    // the sampled classes, then the label of each frame, as columns of a sparse [numClasses x (numSamples + T)] matrix
+    shared_ptr<Matrix<ElemType>> m_selection;
+    bool m_needLogitGradients;
+
+    // from the pool
+    shared_ptr<Matrix<ElemType>> m_sampleIndices;    // [1 x numSamples]
+    shared_ptr<Matrix<ElemType>> m_labelIndices;     // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_sampledWeights;   // [hiddenDim x numSamples]
+    shared_ptr<Matrix<ElemType>> m_labelWeights;     // [hiddenDim x T]
+    shared_ptr<Matrix<ElemType>> m_sampledBias;      // [1 x numSamples], bias - log expected count
+    shared_ptr<Matrix<ElemType>> m_labelLogits;      // [1 x T], first the bias - log expected count
+    shared_ptr<Matrix<ElemType>> m_sampledLogits;    // [numSamples x T]
+    shared_ptr<Matrix<ElemType>> m_logSoftmax;       // [(1 + numSamples) x T], the label in row 0
+    shared_ptr<Matrix<ElemType>> m_labelGradient;    // [1 x T] gradient of the label logits
+    shared_ptr<Matrix<ElemType>> m_sampledGradient;  // [numSamples x T] gradient of the sampled logits
+    shared_ptr<Matrix<ElemType>> m_selectedColumnsGradient; // [hiddenDim x (numSamples + T)] or [1 x (numSamples + T)], for weights or bias
+    shared_ptr<Matrix<ElemType>> m_sampledBiasGradient;     // [numSamples x 1]
+};
+
 // -----------------------------------------------------------------------
 // ClassBasedCrossEntropyWithSoftmaxNode (labeldata(.,t), inputdata(.,t), embeddingMatrix, clsProbBeforeSoftmaxData(.,t))
 //  - Input(0) [4 x T] label in dense matrix in
@@ -1630,22 +1446,18 @@ protected:
 template class ClassBasedCrossEntropyWithSoftmaxNode<float>;
 template class ClassBasedCrossEntropyWithSoftmaxNode<double>;
 
-#ifdef COMING_SOON
-
 // -----------------------------------------------------------------------
 // CRFNode (labels, position_dependent_scores, transition_scores)
-//  - labels: output label vector of [0:T-1]
-//  - position_dependent_scores [0:T-1]: score from position dependent node,
+//  - labels: one-hot label of each frame
+//  - position_dependent_scores: score of each label at each frame,
 //    in the R-CRF case, it is the RNN output score before softmax
-//  - transition scores: square transition matrix,  --TODO: log?
-//    in the R-CRF case, it is the transition probability between labels
-// BUGBUG: This node cannot operate with truncated BPTT, but does not detect it. It also does not handle gaps or test boundary flags.
+//  - transition scores: square matrix, (k, j) is the score of label k following label j
+// The value is the sum over the sequences of the minibatch of -log P(labels | scores).
 // -----------------------------------------------------------------------
 
 /**
         CRF training criterion
         It uses forward-backward algorithm within a minibatch to compute statistics for sequence level optimization
-        This node can serve a base class for other sequence level optimization
 
         Developed by Kaisheng Yao
         This node is for replicating results of the following work
@@ -1656,6 +1468,14 @@ template class ClassBasedCrossEntropyWithSoftmaxNode<double>;
         The forward-backward algorithm follows the derivation in
         http://jmlr.org/papers/volume12/collobert11a/collobert11a.pdf
 
+        The first label of each sequence is conditioned on itself: the path enters the sequence through the transition from the
+        label of its first frame, as in the R-CRF setup, where that label is a sentence-begin symbol.
+
+        All sequences of the minibatch are processed together, in log space, on the device of the inputs. The recursions step
+        through the time steps of the MBLayout; each step is a few tensor operations over [labels x labels x parallel sequences],
+        so that there is no per-label or per-sequence loop and no transfer off the device, except for the sequence boundaries,
+        which are uploaded once per minibatch. Sequences that are cut by the minibatch boundary (truncated BPTT) are treated
+        as if they ended there.
     */
 template <class ElemType>
 class CRFNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<3>
@@ -1671,268 +1491,52 @@ public:
     DeclareConstructorFromConfigWithNumInputs(CRFNode);
     CRFNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          mAlpha(deviceId),
-          mBeta(deviceId),
-          mPostProb(deviceId)
-    {
-    }
-
-    // compute posterior probability of label y at position t
-    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
-    {
-        FrameRange fr(InputRef(0).GetMBLayout());
-        size_t nrow = InputRef(0).Value().GetNumRows();
-        size_t ncol = InputRef(0).Value().GetNumCols();
-
-        mAlpha.Resize(nrow, ncol);
-        mBeta.Resize(nrow, ncol);
-        mPostProb.Resize(nrow, ncol);
-
-        Value().SetValue(0.0);
-        Matrix<ElemType> funcVal = Value(); // TODO: This just creates a 1x1 matrix set to 0.
-
-        size_t nS = InputRef(0).GetNumParallelSequences();
-        if (nS != 1)
-            LogicError("CRFNode: >1 parallel sequences are curently not implemented correctly.");
-        for (size_t i = 0; i < nS; i++) // process parallel sequences one by one  --BUGBUG: We should loop over individual sequences.
-        {
-            FrameRange sequenceRange = fr.Sequence(i); // FrameRange to select one sequence
-            // BUGBUG: This ^^ is neither supported nor correct, since this code does not handle gaps or start/end flags.
-            ForwardPropS(
-                DataWithMBLayoutFor(mPostProb, sequenceRange, InputRef(0).GetMBLayout()),
-                DataWithMBLayoutFor(mAlpha, sequenceRange, InputRef(0).GetMBLayout()),
-                DataWithMBLayoutFor(mBeta, sequenceRange, InputRef(0).GetMBLayout()),
-                funcVal,
-                InputRef(0).ValueFor(sequenceRange),
-                InputRef(1).ValueFor(sequenceRange),
-                InputRef(2).ValueAsMatrix(), mStartLbl,
-                mEndLbl);
-
-            Value() += funcVal; // aggregate over sequences
-        }
-    }
-
-    virtual void BackpropToNonLooping(size_t inputIndex) override // scaled by 2*number of colmns (samples) in the Matrix<ElemType>
-    {
-        FrameRange fr(InputRef(0).GetMBLayout());
-        // this should never be called for input[0], which is controlled through learningRateMultiplier == 0
-        if (inputIndex != 1 && inputIndex != 2)
-            InvalidArgument("CRFNode only takes with respect to input and weight.");
-
-        if (inputIndex == 1)
-        {
-            auto gradient = InputRef(1).GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), mPostProb, InputRef(0).ValueFor(fr), gradient);
-        }
-        else if (inputIndex == 2)
-        {
-            assert(InputRef(inputIndex).GradientFor(fr).GetNumElements() > 0);
-            size_t nS = InputRef(0).GetNumParallelSequences();
-            for (size_t i = 0; i < nS; i++) // process all sequences one by one
-            {
-                FrameRange sequenceRange = fr.Sequence(i); // FrameRange to select one sequence
-                auto& gradient = InputRef(2).GradientAsMatrix();
-                TransGrdCompute(InputRef(0).ValueFor(sequenceRange),
-                                DataWithMBLayoutFor(mAlpha, sequenceRange, InputRef(0).GetMBLayout()),
-                                DataWithMBLayoutFor(mBeta, sequenceRange, InputRef(0).GetMBLayout()),
-                                InputRef(2).ValueAsMatrix(),
-                                gradient,
-                                mStartLbl, 1);
-            }
-        }
-        else
-            return;
-    }
-
-    virtual bool OutputUsedInComputingInputNodesGradients() const override
-    {
-        return false;
-    }
-
-    // compute forward backward algorithm
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType> postprob, Matrix<ElemType> alpha, Matrix<ElemType> beta, Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, int& firstLbl, int& lastLbl, const int iStep = 1)
-    {
-        // to-do, each slice is for one sentence
-        // to-do, number of slices correspond to number of frames
-        // this implementation only supports one sentence per minibatch
-
-        int nObs = lbls.GetNumCols();
-
-        // change to other values so can support multiple sentences in each minibatch
-        assert(iStep == 1);
-        ForwardCompute(alpha, lbls, pos_scores, pair_scores);
-        BackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, iStep);
-        PostProbCompute(postprob, alpha, beta);
-
-        firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, nObs - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
-        functionValues.AssignInnerProductOfMatrices(lbls, pos_scores);
-
-        Matrix<ElemType> a = alpha.ColumnSlice(nObs - 1, 1);
-        ElemType fAlpha;
-        fAlpha = a.LogSumOfElements();
-
-        // transition score
-        ElemType tscore = 0;
-        for (int t = 0; t < nObs - 1; t++)
-        {
-            int i = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t) != 0)
-                {
-                    i = ik;
-                    break;
-                }
-            int j = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t + 1) != 0)
-                {
-                    j = ik;
-                    break;
-                }
-            tscore += pair_scores(j, i);
-        }
-        tscore += functionValues.Get00Element(); // correct path score
-        tscore -= fAlpha;                        // reduced by the scores from all paths
-        functionValues.SetValue(tscore);
-
-        functionValues *= (-1);
-    }
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               const Matrix<ElemType>& lbls,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = lbls.GetNumCols();
-        int iNumLab = lbls.GetNumRows();
-
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                for (int j = 0; j < iNumLab; j++)
-                {
-                    ElemType fAlpha = (j == firstLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
-                    if (t > 0)
-                        fAlpha = alpha(j, t - 1);
-                    fTmp = alpha.LogAdd(fTmp, fAlpha + pair_scores(k, j));
-                }
-                fTmp += pos_scores(k, t); // include position dependent score
-                alpha(k, t) = fTmp;
-            }
-        }
-    }
-
-    // compute backward algorithm
-    static void BackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
-                                Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
-                                const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int shift = 1)
-    {
-        assert(shift == 1);
-
-        alpha.RCRFBackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, shift);
-    }
-
-    static void TransGrdCompute(const Matrix<ElemType>& lbls,
-                                const Matrix<ElemType>& alpha,
-                                const Matrix<ElemType>& beta,
-                                const Matrix<ElemType>& pair_scores,
-                                Matrix<ElemType>& grd,
-                                const int startLbl,
-                                const int shift = 1)
+          m_startFlags(make_shared<Matrix<ElemType>>(deviceId)),
+          m_endFlags(make_shared<Matrix<ElemType>>(deviceId)),
+          m_hasSuccessorFlags(make_shared<Matrix<ElemType>>(deviceId)),
+          m_needPosteriors(false)
     {
-        assert(shift == 1);
-
-        alpha.RCRFTransGrdCompute(lbls,
-                                  alpha,
-                                  beta,
-                                  pair_scores,
-                                  grd,
-                                  startLbl, shift);
     }
 
-    // compute forward backward algorithm
-    static void PostProbCompute(Matrix<ElemType>& postprob, const Matrix<ElemType>& alpha, const Matrix<ElemType>& beta)
-    {
-        int iNumPos = alpha.GetNumCols();
-        int iNumLab = alpha.GetNumRows();
-
-        postprob.Resize(iNumLab, iNumPos);
-        postprob.SetValue(beta);
-        postprob.InplaceExp();
-    }
-
-    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
-    {
-        Base::Validate(isFinalValidationPass);
-        m_pMBLayout = nullptr; // this node does not hold mini-batch data
-
-        if (isFinalValidationPass)
-            if (!(InputRef(1).GetSampleMatrixNumRows() == InputRef(2).GetAsMatrixNumRows() && // position dependent and pair scores have same number of labels
-                  InputRef(0).GetSampleMatrixNumRows() == InputRef(1).GetSampleMatrixNumRows() &&
-                  InputRef(0).HasMBLayout() && InputRef(0).GetMBLayout() == InputRef(1).GetMBLayout() &&
-                  // InputRef(0).GetNumCols() == InputRef(1).GetNumCols() && // position dependent and pair scores have the same observation numbers
-                  InputRef(2).GetAsMatrixNumCols() == InputRef(2).GetAsMatrixNumRows()))
-            {
-                LogicError("The Matrix dimension in the CRFNode operation does not match.");
-            }
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
 
-        SetDims(TensorShape(1), false);
-    }
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex != 0; }
 
-    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
-    {
-        Base::CopyTo(nodeP, newName, flags);
-        if (flags & CopyNodeFlags::copyNodeValue)
-        {
-            auto node = dynamic_pointer_cast<CRFNode<ElemType>>(nodeP);
-            node->mAlpha = mAlpha;
-            node->mBeta = mBeta;
-            node->mPostProb = mPostProb;
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
 
-            node->mStartLbl = mStartLbl;
-            node->mEndLbl = mEndLbl;
-        }
-    }
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override;
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override;
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override;
 
 private:
-    Matrix<ElemType> mAlpha; // TODO: m_Alpha etc.
-    Matrix<ElemType> mBeta;
-    Matrix<ElemType> mPostProb;
-    int mStartLbl;
-    int mEndLbl;
+    void UpdateSequenceFlags();
+    void ComputePosteriors();
+
+    // the frames of time step t of a matrix with a column per frame, as a tensor of shape [frameShape x parallel sequences]
+    TensorView<ElemType> FramesOf(const MatrixBasePtr& matrix, size_t t, const TensorShape& frameShape) const;
+    void ComputePreviousScores(size_t t, const TensorView<ElemType>& previousScores);
+
+    // sequence boundaries of the frames, [1 x frames], uploaded for each minibatch
+    shared_ptr<Matrix<ElemType>> m_startFlags;        // 1 for the first frame of a sequence, and for gaps
+    shared_ptr<Matrix<ElemType>> m_endFlags;          // 1 for the last frame of a sequence
+    shared_ptr<Matrix<ElemType>> m_hasSuccessorFlags; // 1 if the next frame of the parallel sequence continues the sequence
+
+    shared_ptr<Matrix<ElemType>> m_labels;               // [labels x frames] dense copy of the labels
+    shared_ptr<Matrix<ElemType>> m_previousLabels;       // [labels x frames] label of the previous frame, or the own label at the start of a sequence
+    shared_ptr<Matrix<ElemType>> m_initialScores;        // [labels x frames] log of the labels, the scores that enter a sequence
+    shared_ptr<Matrix<ElemType>> m_alpha;                // [labels x frames] forward scores
+    shared_ptr<Matrix<ElemType>> m_logNormalizers;       // [1 x frames] log of the sum of the scores of all paths through the frame
+    shared_ptr<Matrix<ElemType>> m_beta;                 // [labels x frames] backward scores; also holds temporaries
+    shared_ptr<Matrix<ElemType>> m_posteriors;           // [labels x frames]
+    shared_ptr<Matrix<ElemType>> m_previousScores;       // [labels x parallel sequences] the scores that the frames of a time step follow
+    shared_ptr<Matrix<ElemType>> m_transitionScores;     // [labels x labels x parallel sequences]
+    shared_ptr<Matrix<ElemType>> m_expectedTransitions;  // [labels x labels]
+    shared_ptr<Matrix<ElemType>> m_observedTransitions;  // [labels x labels]
+    bool m_needPosteriors;
 };
 
-#endif
-
 // -----------------------------------------------------------------------
 // Logistic (labels, prediction, weight)
 // calculates: -sum(left * log(right) + (1-left)*log(1-right)) (optionally * weight)
@@ -2111,6 +1715,9 @@ template class LogisticNode<double>;
 // -----------------------------------------------------------------------
 // DropoutNode (input) -- perform drop-out
 // Output is scaled such that no post-scaling is necessary.
+// With Globals::ShouldUseCounterBasedDropout(), the mask is not stored: mask element k of a minibatch is a function
+// of (seed, offset + k) only (Philox.h), so backprop regenerates it, and it does not depend on the device or on how
+// a loop slices the minibatch.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -2127,7 +1734,9 @@ public:
     DeclareConstructorFromConfigWithNumInputs(DropoutNode);
     DropoutNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-        m_dropoutRate(0)
+        m_dropoutRate(0),
+        m_counterBasedMask(false),
+        m_maskOffset(0)
     {
         SetRngState(CreateUniqId());
     }
@@ -2140,7 +1749,9 @@ public:
         Matrix<ElemType> sliceInput0Grad = InputRef(0).GradientFor(fr);
         Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
 
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && m_counterBasedMask)
+            sliceInput0Grad.AddCounterBasedDropoutOf(sliceOutputGrad, (ElemType)m_dropoutRate, GetDropoutScale(), GetRngSeed(), MaskOffsetFor(fr));
+        else if (m_dropoutRate > 0)
             sliceInput0Grad.AddElementProductOf(sliceOutputGrad, DataFor(*m_maskOfDropout, fr));
         else
             sliceInput0Grad += sliceOutputGrad;
@@ -2148,15 +1759,28 @@ public:
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    // a new mask for each minibatch in training
+    virtual bool /*ComputationNodeBase::*/ CanReplayForwardProp() const override { return Environment().IsInferring() || m_dropoutRate <= 0; }
 
     virtual void UpdateFunctionMBSize() override
     {
         Base::UpdateFunctionMBSize();
         // resize temporaries to their proper size
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && !m_counterBasedMask)
             m_maskOfDropout->Resize(Input(0)->Value());
     }
 
+    virtual void /*IComputationNode::*/ BeginForwardProp() override
+    {
+        Base::BeginForwardProp();
+        // a counter-based mask takes one counter per element of the whole minibatch, also if a loop computes it frame by frame
+        if (m_counterBasedMask && !Environment().IsInferring() && m_dropoutRate > 0)
+        {
+            m_maskOffset = GetRngOffset();
+            UpdateRngOffset(m_maskOffset + Value().GetNumElements());
+        }
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
@@ -2166,11 +1790,15 @@ public:
         {
             sliceOutputValue.SetValue(sliceInput0Value);
         }
+        else if (m_counterBasedMask)
+        {
+            sliceOutputValue.AssignCounterBasedDropoutOf(sliceInput0Value, (ElemType)m_dropoutRate, GetDropoutScale(), GetRngSeed(), MaskOffsetFor(fr));
+        }
         else
         {
             // determine drop-out mask for this minibatch
             auto sliceMask = DataFor(*m_maskOfDropout, fr);
-            sliceMask.SetUniformRandomMask((ElemType)m_dropoutRate, (ElemType)(1.0 / (1.0 - m_dropoutRate)) /*pre-scaled*/, GetRNGHandle());
+            sliceMask.SetUniformRandomMask((ElemType)m_dropoutRate, GetDropoutScale(), GetRNGHandle());
             // apply dropout mask
             sliceOutputValue.AssignElementProductOf(sliceMask, sliceInput0Value);
             UpdateRngOffset(GetRngOffset() + sliceMask.GetNumElements());
@@ -2204,27 +1832,44 @@ public:
             node->m_dropoutRate = m_dropoutRate;
             node->SetRngState(GetRngSeed(), GetRngOffset());
             node->m_maskOfDropout = m_maskOfDropout;
+            node->m_counterBasedMask = m_counterBasedMask;
+            node->m_maskOffset = m_maskOffset;
         }
     }
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maskOfDropout, matrixPool);
+        // decided here, so that forward and backward of a minibatch agree on where the mask comes from
+        m_counterBasedMask = Globals::ShouldUseCounterBasedDropout();
+        if (!m_counterBasedMask)
+            RequestMatrixFromPool(m_maskOfDropout, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
+        if (m_maskOfDropout)
+            ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
     }
 
     double GetDropoutRate() const { return m_dropoutRate; }
 
 private:
+    ElemType GetDropoutScale() const { return (ElemType)(1.0 / (1.0 - m_dropoutRate)); } // pre-scaled, so that no post-scaling is necessary
+
+    // first counter of the mask of the frames 'fr' of the current minibatch
+    uint64_t MaskOffsetFor(const FrameRange& fr) const
+    {
+        size_t startColumn = ColumnRangeWithMBLayoutFor(Value().GetNumCols(), fr, GetMBLayout()).first;
+        return m_maskOffset + (uint64_t)startColumn * Value().GetNumRows();
+    }
+
     double m_dropoutRate;
     shared_ptr<Matrix<ElemType>> m_maskOfDropout;
+    bool m_counterBasedMask;  // mask regenerated from (seed, m_maskOffset) instead of stored in m_maskOfDropout
+    uint64_t m_maskOffset;    // RNG offset at the start of the current minibatch
 };
 
 // -----------------------------------------------------------------------
@@ -2539,6 +2184,62 @@ private: // time-constant conversions
 public:
 
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(DATA)->GetMBLayout());
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        ForwardPropInto(sliceOutputValue);
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        BackpropToNonLooping(inputIndex, *this);
+    }
+
+    // Fused with the ReLU that consumes this node, directly or through a PlusNode that adds 'residual' (see
+    // BatchNormActivationFusion.h): the normalized value is computed into the value of 'activation' and activated in place,
+    // and the gradient of 'activation' is propagated to the inputs of this node and to 'residual'. This node's own value
+    // and gradient are not used.
+    void ForwardPropFused(ComputationNode<ElemType>& activation, ComputationNode<ElemType>* residual)
+    {
+        FrameRange fr(Input(DATA)->GetMBLayout());
+        Matrix<ElemType> sliceOutputValue = activation.ValueFor(fr);
+        ForwardPropInto(sliceOutputValue);
+        if (residual)
+        {
+            Matrix<ElemType> sliceResidualValue = residual->ValueFor(fr);
+            m_bnEng->ForwardActivation(sliceOutputValue, &sliceResidualValue);
+        }
+        else
+            m_bnEng->ForwardActivation(sliceOutputValue, nullptr);
+    }
+
+    void BackpropFused(ComputationNode<ElemType>& activation, ComputationNode<ElemType>* residual)
+    {
+        FrameRange fr(Input(DATA)->GetMBLayout());
+        Matrix<ElemType> sliceOutputGrad = activation.MaskedGradientFor(fr);
+        m_bnEng->BackwardActivation(activation.ValueFor(fr), sliceOutputGrad); // now the gradient of the normalized value
+
+        if (residual && residual->NeedsGradient())
+        {
+            residual->LazyZeroGradient();
+            Matrix<ElemType> sliceResidualGrad = residual->GradientFor(fr);
+            if (residual->ParentOverwritesGradient())
+                sliceResidualGrad.AssignValuesOf(sliceOutputGrad);
+            else
+                sliceResidualGrad += sliceOutputGrad;
+        }
+
+        for (size_t i = 0; i < GetNumInputs(); i++) // DATA first, as required by BackpropToNonLooping()
+        {
+            if (!Input(i)->NeedsGradient())
+                continue;
+            Input(i)->LazyZeroGradient();
+            BackpropToNonLooping(i, activation);
+        }
+    }
+
+private:
+    void ForwardPropInto(Matrix<ElemType>& sliceOutputValue)
     {
         if (m_convertRunningVariancePending)
             LogicError("%ls: Failed to convert running variance until forward prop", NodeName().c_str());
@@ -2549,7 +2250,6 @@ public:
         const Matrix<ElemType>& bias      = Input(BIAS)->Value();
         Matrix<ElemType>& runMean         = Input(RUN_MEAN)->Value();
         Matrix<ElemType>& runVariance     = Input(RUN_VAR)->Value();
-        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
         assert(scale.GetNumRows() == bias.GetNumRows());
         assert(scale.GetNumCols() == bias.GetNumCols());
@@ -2581,7 +2281,8 @@ public:
         m_gradientValid = false;
     }
 
-    virtual void BackpropToNonLooping(size_t inputIndex) override
+    // 'output' holds the gradient of this node's output: this node itself, or the activation it is fused with
+    void BackpropToNonLooping(size_t inputIndex, ComputationNode<ElemType>& output)
     {
         // Must be in training mode.
         if (!Environment().IsTraining())
@@ -2597,7 +2298,7 @@ public:
 
         if (inputIndex == DATA || !m_gradientValid) // derivative with respect to the input.
         {
-            auto sliceOutputGrad          = MaskedGradientFor(fr);
+            auto sliceOutputGrad          = output.MaskedGradientFor(fr);
             auto sliceInputValue          = Input(DATA)->ValueFor(fr);
             const Matrix<ElemType>& scale = Input(SCALE)->Value();
             const Matrix<ElemType>& bias  = Input(BIAS)->Value();
@@ -2641,7 +2342,10 @@ public:
         // No derivatives with respect to running mean and variance.
     }
 
+public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    // in training, the running statistics are updated with factors that depend on the host-side run count
+    virtual bool /*ComputationNodeBase::*/ CanReplayForwardProp() const override { return !Environment().IsTraining(); }
 
     void Validate(bool isFinalValidationPass) override
     {
@@ -7,6 +7,7 @@
 #include "Basics.h"
 #include "ComputationNode.h"
 #include "Matrix.h"
+#include "NativeUserOp.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
 
@@ -20,6 +21,8 @@ class OutputMultiplexerNode;
 // Proxy ComputationNode type for a V2 user-defined custom Function, instances
 // of which can be part of a CNTK computation network.
 // The actual implementation of the operation itself is external to the CNTK engine.
+// If a NativeUserOp is registered for the op name of the Function, it computes on
+// the matrices of the node directly, instead of the Function's Forward()/Backward().
 // -----------------------------------------------------------------------
 
 // TODO: We currently only support external nodes that cannot be part of CNTK recurrent loops
@@ -37,12 +40,24 @@ public:
     {
         if (!m_externalFunction)
             LogicError("UserDefinedV2FunctionNode ctor should never be called with externalFunction == nullptr");
+
+        m_nativeOp = NativeUserOpRegistry<ElemType>::CreateInstance(*m_externalFunction);
     }
 
     virtual void ForwardPropNonLooping() override
     {
         this->m_outputsValue[0] = m_value;
 
+        if (m_nativeOp)
+        {
+            auto outputs = NativeOutputOperands(/*withGradients=*/false);
+            for (const auto& output : outputs)
+                output.value->Resize(output.sampleLayout.GetNumElements(), output.layout ? output.layout->GetNumCols() : 1);
+
+            m_nativeOp->Forward(NativeInputOperands(SIZE_MAX), outputs, Environment().IsTraining());
+            return;
+        }
+
         // Get the arguments of the external function
         auto arguments = m_externalFunction->Arguments();
         std::unordered_map<::CNTK::Variable, ::CNTK::ValuePtr> argumentValues;
@@ -100,8 +115,18 @@ public:
         }
     }
 
-    virtual void BackpropToNonLooping(size_t /*inputIndex*/) override
+    virtual void BackpropToNonLooping(size_t inputIndex) override
     {
+        if (m_nativeOp)
+        {
+            this->m_outputsGradient[0] = m_gradient;
+
+            auto outputs = m_externalFunction->Outputs();
+            if (std::any_of(outputs.begin(), outputs.end(), [](const ::CNTK::Variable& outVar) { return outVar.NeedsGradient(); }))
+                m_nativeOp->Backward(inputIndex, NativeInputOperands(inputIndex), NativeOutputOperands(/*withGradients=*/true));
+            return;
+        }
+
         if (m_currentBackpropStatePtr == nullptr)
             return;
 
@@ -218,6 +243,9 @@ public:
 
                 if (!this->m_outputsMBLayout[i])
                 {
+                    if (m_nativeOp)
+                        LogicError("The output (%S) of the native user defined Function (%S) has dynamic axes that none of its inputs has", output.AsString().c_str(), m_externalFunction->OpName().c_str());
+
                     this->m_outputsMBLayout[i] = make_shared<MBLayout>(); // this generates a new layout
                     this->m_outputsMBLayout[i]->SetUniqueAxisName(InternalDynamicAxisNameFromDynamicAxes(output.DynamicAxes()));
                     this->m_outputsHasNewMBLayout[i] = true;
@@ -237,7 +265,40 @@ public:
     }
 
 private:
+    // the inputs in the order of Function::Inputs(); only the gradient of the input 'gradientInputIndex' is passed, since the
+    // gradients of the others may not have been initialized yet
+    std::vector<NativeUserOpOperand<ElemType>> NativeInputOperands(size_t gradientInputIndex)
+    {
+        std::vector<NativeUserOpOperand<ElemType>> inputs(GetNumInputs());
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            auto input = Input(i);
+            inputs[i].value = input->ValuePtrRef();
+            if (i == gradientInputIndex)
+                inputs[i].gradient = input->GradientPtrRef();
+            inputs[i].sampleLayout = input->GetSampleLayout();
+            inputs[i].layout = input->GetMBLayout();
+        }
+        return inputs;
+    }
+
+    std::vector<NativeUserOpOperand<ElemType>> NativeOutputOperands(bool withGradients)
+    {
+        auto outputVars = m_externalFunction->Outputs();
+        std::vector<NativeUserOpOperand<ElemType>> outputs(outputVars.size());
+        for (size_t i = 0; i < outputs.size(); ++i)
+        {
+            outputs[i].value = this->m_outputsValue[i];
+            if (withGradients && outputVars[i].NeedsGradient())
+                outputs[i].gradient = this->m_outputsGradient[i];
+            outputs[i].sampleLayout = ::CNTK::AsTensorShape(outputVars[i].Shape());
+            outputs[i].layout = this->m_outputsMBLayout[i];
+        }
+        return outputs;
+    }
+
     ::CNTK::FunctionPtr m_externalFunction;
+    std::shared_ptr<NativeUserOp<ElemType>> m_nativeOp;
     ::CNTK::BackPropStatePtr m_currentBackpropStatePtr;
 };
 
@@ -0,0 +1,149 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ValueOffload.cpp -- keeps node values in host memory between the forward and the backward pass
+//
+
+#include "stdafx.h"
+#include "ValueOffload.h"
+#include "CUDAPageLockedMemAllocator.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// the GPU memory of the value of a ComputationNode<ElemType>, after resizing it to numRows x numCols if 'resize'
+template <class ElemType>
+static bool TryGetValue(ComputationNodeBase& nodeBase, bool resize, size_t& numRows, size_t& numCols, size_t& elementSize, void*& data)
+{
+    auto node = dynamic_cast<ComputationNode<ElemType>*>(&nodeBase);
+    if (!node)
+        return false;
+    auto& value = node->Value();
+    if (resize)
+        value.Resize(numRows, numCols);
+    numRows = value.GetNumRows();
+    numCols = value.GetNumCols();
+    elementSize = sizeof(ElemType);
+    data = value.Data();
+    return true;
+}
+
+static void* GetValue(ComputationNodeBase& node, bool resize, size_t& numRows, size_t& numCols, size_t& elementSize)
+{
+    void* data = nullptr;
+    if (!TryGetValue<float>(node, resize, numRows, numCols, elementSize, data) && !TryGetValue<double>(node, resize, numRows, numCols, elementSize, data))
+        LogicError("ValueOffload: %ls %ls operation is neither a ComputationNode<float> nor a ComputationNode<double>.", node.NodeName().c_str(), node.OperationName().c_str());
+    return data;
+}
+
+ValueOffload::ValueOffload(const ComputationNodeBasePtr& node)
+    : m_node(node),
+      m_deviceId(node->GetDeviceId()),
+      m_transferer(make_unique<OffloadGPUDataTransferer>(node->GetDeviceId())),
+      m_hostBuffer(nullptr),
+      m_hostBufferBytes(0),
+      m_numRows(0),
+      m_numCols(0),
+      m_offloading(false),
+      m_offloaded(false),
+      m_prefetching(false)
+{
+}
+
+ValueOffload::~ValueOffload()
+{
+    if (!m_hostBuffer)
+        return;
+    try
+    {
+        m_transferer->WaitForCopyGPUToCPU();
+        m_transferer->WaitForCopyCPUToGPU();
+        CUDAPageLockedMemAllocator::Free(m_hostBuffer, m_deviceId);
+    }
+    catch (...)
+    {
+        // the error is already logged
+    }
+}
+
+void ValueOffload::BeginOffload()
+{
+    auto node = GetNode();
+    if (!node || !node->HasEnvironmentPtr() || !node->Environment().IsTraining())
+        return; // no backward pass will read the value
+
+    size_t elementSize;
+    void* data = GetValue(*node, /*resize=*/false, m_numRows, m_numCols, elementSize);
+    const size_t bytes = m_numRows * m_numCols * elementSize;
+    if (bytes > m_hostBufferBytes) // grow only; the buffer is reused for every minibatch
+    {
+        if (m_hostBuffer)
+        {
+            m_transferer->WaitForCopyCPUToGPU();
+            CUDAPageLockedMemAllocator::Free(m_hostBuffer, m_deviceId);
+            m_hostBuffer = nullptr;
+            m_hostBufferBytes = 0;
+        }
+        m_hostBuffer = CUDAPageLockedMemAllocator::Malloc(bytes, m_deviceId);
+        m_hostBufferBytes = bytes;
+    }
+
+    // the copy starts once the compute stream has computed the value
+    m_transferer->RecordComputeStreamSyncPoint();
+    m_transferer->WaitForSyncPointOnFetchStreamAsync();
+    m_transferer->CopyGPUToCPUAsync(data, m_numRows * m_numCols, elementSize, m_hostBuffer);
+    m_transferer->RecordGPUToCPUCopy();
+    m_offloading = true;
+    m_offloaded = true;
+}
+
+void ValueOffload::EndOffload()
+{
+    if (!m_offloading)
+        return;
+    m_transferer->WaitForCopyGPUToCPUOnComputeStreamAsync();
+    m_offloading = false;
+}
+
+void ValueOffload::BeginPrefetch()
+{
+    auto node = GetNode();
+    if (!node || !m_offloaded)
+        return;
+    EndOffload(); // in case the value was not released, e.g. since not all its readers ran
+
+    // the copy starts once the compute stream is done with the previous user of the GPU memory
+    size_t elementSize;
+    void* data = GetValue(*node, /*resize=*/true, m_numRows, m_numCols, elementSize);
+    m_transferer->RecordComputeStreamSyncPoint();
+    m_transferer->WaitForSyncPointOnAssignStreamAsync();
+    m_transferer->CopyCPUToGPUAsync(m_hostBuffer, m_numRows * m_numCols, elementSize, data);
+    m_transferer->RecordCPUToGPUCopy();
+    m_prefetching = true;
+}
+
+void ValueOffload::EndPrefetch()
+{
+    if (!m_prefetching)
+        return;
+    m_transferer->WaitForCopyCPUToGPUOnComputeStreamAsync();
+    m_prefetching = false;
+}
+
+void ValueOffloadActions::AfterForwardProp()
+{
+    for (const auto& offload : valuesToOffload)
+        offload->BeginOffload();
+    for (const auto& offload : valuesToRelease)
+        offload->EndOffload();
+}
+
+void ValueOffloadActions::BeforeBackprop()
+{
+    for (const auto& offload : valuesToPrefetch)
+        offload->BeginPrefetch();
+    for (const auto& offload : valuesToAwait)
+        offload->EndPrefetch();
+}
+
+}}}
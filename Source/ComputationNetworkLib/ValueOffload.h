@@ -0,0 +1,71 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ValueOffload.h -- keeps node values in host memory between the forward and the backward pass
+//
+// For sequence models the values of the nodes in recurrent loops, which the backward pass reads, take most of the GPU
+// memory: one column per frame of the minibatch for every node of the loop. ComputationNetwork::PlanOffloading()
+// selects values that are instead copied to pinned host memory once computed, and back before the backward pass reads
+// them. In between, MatrixPool shares their GPU memory with other matrices. A ValueOffload moves one node value:
+//  - BeginOffload() runs after the forward pass of the node (or its loop) and starts the copy to host memory.
+//  - EndOffload() runs after the forward pass of the last node that reads the value, where MatrixPool releases it,
+//    and makes the compute stream wait for that copy before anything else may write the GPU memory.
+//  - BeginPrefetch() runs offloadPrefetchDistance nodes (or loops) before the first backprop that reads the value,
+//    where MatrixPool hands the GPU memory back to it, and starts the copy back.
+//  - EndPrefetch() runs before that backprop and makes the compute stream wait for the copy back.
+// The copies run on the copy streams of OffloadGPUDataTransferer, so they overlap with the computation in between. The
+// compute stream only stalls if that computation takes less time than a copy; a larger distance avoids this, at the cost
+// of holding the GPU memory of the value for longer.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "GPUDataTransferer.h"
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ValueOffload
+{
+public:
+    ValueOffload(const ComputationNodeBasePtr& node);
+    ~ValueOffload();
+
+    void BeginOffload();
+    void EndOffload();
+    void BeginPrefetch();
+    void EndPrefetch();
+
+    ComputationNodeBasePtr GetNode() const { return m_node.lock(); }
+
+private:
+    std::weak_ptr<ComputationNodeBase> m_node; // the node's offload actions refer to this object
+    int m_deviceId;
+    std::unique_ptr<OffloadGPUDataTransferer> m_transferer;
+    void* m_hostBuffer;
+    size_t m_hostBufferBytes;
+    size_t m_numRows, m_numCols; // of the value when it was offloaded
+    bool m_offloading;           // between BeginOffload() and EndOffload()
+    bool m_offloaded;            // the host copy is valid
+    bool m_prefetching;          // between BeginPrefetch() and EndPrefetch()
+
+    DISABLE_COPY_AND_MOVE(ValueOffload);
+};
+
+// the ValueOffload calls of a node in a PAR traversal (see ComputationNetwork::PlanOffloading())
+struct ValueOffloadActions
+{
+    std::vector<std::shared_ptr<ValueOffload>> valuesToOffload;  // BeginOffload() after the forward pass of the node
+    std::vector<std::shared_ptr<ValueOffload>> valuesToRelease;  // EndOffload() after that
+    std::vector<std::shared_ptr<ValueOffload>> valuesToPrefetch; // BeginPrefetch() before the backprop of the node
+    std::vector<std::shared_ptr<ValueOffload>> valuesToAwait;    // EndPrefetch() after that
+
+    void AfterForwardProp();
+    void BeforeBackprop();
+};
+
+}}}
@@ -15,6 +15,7 @@
 #include "Actions.h"
 #include "CNTKEval.h"
 #include "CPUMatrix.h" // for SetNumThreads()
+#include "CPUHugePageAllocator.h"
 #include "SimpleOutputWriter.h"
 #include "NDLNetworkBuilder.h"
 #ifdef LEAKDETECT
@@ -27,8 +28,10 @@
 #include "HeapMemoryProvider.h"
 #include "InputAndParamNodes.h"
 #include "latticearchive.h"
+#include "PerformanceProfiler.h"
 #include <limits>
 #include "RecurrentNodes.h"
+#include "ComputeStreamPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -39,8 +42,17 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
     m_config.Parse(config);
     size_t nThreads = m_config("numCPUThreads", "1");
     CPUMatrix<ElemType>::SetNumThreads(nThreads);
+    m_numaNode = m_config(L"numaNode", -1);
+    BindToNumaNode();
+    auto hugePageMode = CPUHugePageAllocator::ModeFromConfig(m_config(L"hugePages", false), m_config(L"hugeTlbPages", false));
+    if (hugePageMode != CPUHugePageAllocator::Mode::none) // process-wide, so a model that asks for it turns it on for all
+        CPUHugePageAllocator::SetMode(hugePageMode);
 
     Globals::SetShareNodeValueMatrices(m_config(L"shareNodeValueMatrices", true));
+    Globals::SetQuantizedInference(m_config(L"quantizedInference", false));
+    Globals::SetForwardPlans(m_config(L"forwardPlans", false));
+    Globals::SetMemoryPlans(m_config(L"memoryPlans", false));
+    Globals::SetLazyParameterLoading(m_config(L"lazyParameterLoading", false));
 }
 
 
@@ -49,8 +61,13 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
 template <typename ElemType>
 void CNTKEvalBase<ElemType>::CreateNetwork(const std::string& networkDescription)
 {
+    PROFILE_SCOPE(profilerEvtLoadModel);
+
+    BindToNumaNode();
     ConfigParameters config;
+    auto profConfig = ProfilerTimeBegin();
     config.Parse(networkDescription);
+    ProfilerTimeEnd(profConfig, profilerEvtLoadConfig);
 
     std::vector<wstring> outputNodeNames;
     this->m_net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"outputNodeNames", outputNodeNames);
@@ -59,6 +76,14 @@ void CNTKEvalBase<ElemType>::CreateNetwork(const std::string& networkDescription
     {
         LogicError("Unable to construct network from description");
     }
+
+    if (m_config(L"optimizeForInference", false))
+        this->m_net->template OptimizeForInference<ElemType>();
+
+    double sparseInferenceMaxDensity = m_config(L"sparseInferenceMaxDensity", 0.0);
+    size_t sparseInferenceBenchmarkColumns = m_config(L"sparseInferenceBenchmarkColumns", (size_t)0);
+    if (sparseInferenceMaxDensity > 0 || sparseInferenceBenchmarkColumns > 0)
+        this->m_net->template SparsifyParametersForInference<ElemType>(sparseInferenceMaxDensity, sparseInferenceBenchmarkColumns);
 }
 
 
@@ -161,6 +186,7 @@ void CNTKEval<ElemType>::StartEvaluateMinibatchLoop(const std::wstring& outputNo
 template <typename ElemType>
 void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
 {
+    this->BindToNumaNode();
     size_t minibatchSize = this->m_config(L"minibatchSize", (size_t) 10240);
     // get the evaluation names from the output string
     vector<wstring> outNodeNames;
@@ -198,6 +224,7 @@ void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>
 template <typename ElemType>
 void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& outputs)
 {
+    this->BindToNumaNode();
     // get the evaluation names from the output string
     vector<wstring> outNodeNames;
 
@@ -256,6 +283,8 @@ VariableLayout CNTKEvalExtended<ElemType>::ToVariableLayout(const ComputationNod
 template<typename ElemType>
 void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
 {
+    this->BindToNumaNode();
+    DetachBoundValues();
     m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(this->m_net, NetworkOperationMode::inferring);
     m_outputNodes  = this->m_net->OutputNodesByName(outputNodeNames);
     m_inputNodes = this->m_net->InputNodesForOutputs(outputNodeNames);
@@ -263,6 +292,8 @@ void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstrin
     this->m_net->AllocateAllMatrices({}, m_outputNodes, nullptr);
     this->m_net->StartEvaluateMinibatchLoop(m_outputNodes);
     m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(m_inputNodes);
+    m_boundInputs.assign(m_inputNodes.size(), BoundBuffer());
+    m_boundOutputs.assign(m_outputNodes.size(), BoundBuffer());
 
     for (const auto& node : m_outputNodes)
     {
@@ -271,6 +302,24 @@ void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstrin
             RuntimeError("Sparse outputs are not supported by this API.");
     }
 
+    // the delay nodes whose state ForwardPassStreams() keeps per stream
+    m_pastValueNodes.clear();
+    m_hasFutureValues = false;
+    m_streams.clear();
+    std::set<ComputationNodeBasePtr> visited;
+    for (const auto& output : m_outputNodes)
+    {
+        for (const auto& node : this->m_net->GetAllNodesForRoot(output))
+        {
+            if (!visited.insert(node).second)
+                continue;
+            auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+            if (pastValueNode)
+                m_pastValueNodes.push_back(pastValueNode);
+            m_hasFutureValues |= dynamic_pointer_cast<FutureValueNode<ElemType>>(node) != nullptr;
+        }
+    }
+
     m_started = true;
 }
 
@@ -306,16 +355,12 @@ VariableSchema CNTKEvalExtended<ElemType>::GetInputSchema() const
 
 template<typename ElemType>
 template<template<typename> class ValueContainer>
-void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN)
+void CNTKEvalExtended<ElemType>::SetInputValues(const std::vector<ValueBuffer<ElemType, ValueContainer>>& inputs, bool resetRNN)
 {
-    if (!m_started)
-        RuntimeError("ForwardPass() called before StartForwardEvaluation()");
-
     if (inputs.size() != (size_t)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()))
         RuntimeError("Expected %d inputs, but got %d.", (int)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()), (int)inputs.size());
 
-    if (outputs.size() != m_outputNodes.size())
-        RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs.size());
+    DetachBoundValues();
 
     size_t i = 0;
     for (auto& inputNode : m_inputNodes)
@@ -373,6 +418,20 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
 
         ++i;
     }
+}
+
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN)
+{
+    if (!m_started)
+        RuntimeError("ForwardPass() called before StartForwardEvaluation()");
+    this->BindToNumaNode();
+
+    if (outputs.size() != m_outputNodes.size())
+        RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs.size());
+
+    SetInputValues(inputs, resetRNN);
 
     ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
     this->m_net->ForwardProp(m_outputNodes);
@@ -433,6 +492,335 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
     ForwardPassT(inputs, outputs, resetRNN);
 }
 
+// Each stream is a parallel sequence of the minibatch, the shorter ones padded with gaps. A stream that continues
+// begins before the minibatch, and its PastValue nodes read the frames carried over from its last call.
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassStreams(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs)
+{
+    if (!m_started)
+        RuntimeError("ForwardPassStreams() called before StartForwardEvaluation()");
+    if (m_hasFutureValues)
+        RuntimeError("ForwardPassStreams: Networks that look into the future (FutureValue) cannot be evaluated as streams.");
+    this->BindToNumaNode();
+    DetachBoundValues();
+
+    size_t numStreams = streamIds.size();
+    if (numStreams == 0)
+        RuntimeError("ForwardPassStreams: Expected at least one stream.");
+    if (inputs.size() != numStreams || outputs.size() != numStreams)
+        RuntimeError("ForwardPassStreams: Expected inputs and outputs for %d streams, but got %d and %d.", (int)numStreams, (int)inputs.size(), (int)outputs.size());
+    if (std::set<size_t>(streamIds.begin(), streamIds.end()).size() != numStreams)
+        RuntimeError("ForwardPassStreams: Each stream can only be continued once per call.");
+
+    // number of frames of each stream
+    std::vector<size_t> numFrames(numStreams);
+    for (size_t k = 0; k < numStreams; k++)
+    {
+        if (inputs[k].size() != m_inputNodes.size())
+            RuntimeError("ForwardPassStreams: Expected %d inputs for stream %d, but got %d.", (int)m_inputNodes.size(), (int)k, (int)inputs[k].size());
+        if (outputs[k].size() != m_outputNodes.size())
+            RuntimeError("ForwardPassStreams: Expected %d outputs for stream %d, but got %d.", (int)m_outputNodes.size(), (int)k, (int)outputs[k].size());
+
+        for (size_t i = 0; i < m_inputNodes.size(); i++)
+        {
+            auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(m_inputNodes[i]->ValuePtr());
+            if (matrix->GetMatrixType() != MatrixType::DENSE)
+                RuntimeError("ForwardPassStreams: Input %ls: Only dense inputs are supported.", m_inputNodes[i]->GetName().c_str());
+
+            size_t numRows = m_inputNodes[i]->GetSampleLayout().GetNumElements();
+            size_t size = inputs[k][i].m_buffer.size();
+            if (size == 0 || size % numRows != 0)
+                RuntimeError("ForwardPassStreams: Input %ls: Expected input data of stream %d to be a non-zero multiple of %d, but it is %d.",
+                             m_inputNodes[i]->GetName().c_str(), (int)k, (int)numRows, (int)size);
+            if (i == 0)
+                numFrames[k] = size / numRows;
+            else if (numFrames[k] != size / numRows)
+                RuntimeError("ForwardPassStreams: The inputs of stream %d have different numbers of frames.", (int)k);
+        }
+    }
+    size_t numTimeSteps = *std::max_element(numFrames.begin(), numFrames.end());
+
+    std::vector<StreamState*> streams(numStreams, nullptr); // null for the streams that begin
+    for (size_t k = 0; k < numStreams; k++)
+    {
+        auto iter = m_streams.find(streamIds[k]);
+        if (iter != m_streams.end())
+            streams[k] = &iter->second;
+    }
+
+    std::vector<ElemType> columns;
+    for (size_t i = 0; i < m_inputNodes.size(); i++)
+    {
+        auto& inputNode = m_inputNodes[i];
+        auto pMBLayout = inputNode->GetMBLayout();
+        pMBLayout->Init(numStreams, numTimeSteps);
+        for (size_t k = 0; k < numStreams; k++)
+        {
+            pMBLayout->AddSequence(NEW_SEQUENCE_ID, k, streams[k] ? -(ptrdiff_t)streams[k]->numFrames : 0, numFrames[k]);
+            pMBLayout->AddGap(k, numFrames[k], numTimeSteps);
+        }
+
+        // interleave the frames of the streams, column t * numStreams + k
+        size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+        columns.assign(numRows * numStreams * numTimeSteps, 0);
+        for (size_t k = 0; k < numStreams; k++)
+        {
+            const auto& buffer = inputs[k][i].m_buffer;
+            for (size_t t = 0; t < numFrames[k]; t++)
+                std::copy(buffer.begin() + t * numRows, buffer.begin() + (t + 1) * numRows, columns.begin() + (t * numStreams + k) * numRows);
+        }
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+        matrix->SetValue(numRows, numStreams * numTimeSteps, matrix->GetDeviceId(), columns.data(), matrixFlagNormal);
+    }
+
+    for (size_t j = 0; j < m_pastValueNodes.size(); j++)
+    {
+        std::vector<shared_ptr<Matrix<ElemType>>> states(numStreams);
+        for (size_t k = 0; k < numStreams; k++)
+        {
+            if (streams[k])
+                states[k] = streams[k]->pastValues[j];
+        }
+        m_pastValueNodes[j]->ImportStreamStates(states);
+    }
+
+    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+    this->m_net->ForwardProp(m_outputNodes);
+
+    // keep the last frames of the streams on the device, for their next call
+    for (size_t k = 0; k < numStreams; k++)
+    {
+        StreamState& stream = m_streams[streamIds[k]];
+        if (stream.pastValues.empty())
+        {
+            for (const auto& node : m_pastValueNodes)
+                stream.pastValues.push_back(make_shared<Matrix<ElemType>>(node->Value().GetDeviceId()));
+        }
+        for (size_t j = 0; j < m_pastValueNodes.size(); j++)
+            m_pastValueNodes[j]->ExportStreamState(k, *stream.pastValues[j]);
+        stream.numFrames += numFrames[k];
+    }
+
+    for (size_t i2 = 0; i2 < m_outputNodes.size(); ++i2)
+    {
+        auto node = m_outputNodes[i2];
+        shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        auto pMBLayout = node->GetMBLayout();
+        if (!pMBLayout || pMBLayout->GetNumParallelSequences() != numStreams || pMBLayout->GetNumTimeSteps() != numTimeSteps)
+            RuntimeError("ForwardPassStreams: Output %ls: Expected one sequence per stream.", node->GetName().c_str());
+
+        size_t numRows = outputMatrix->GetNumRows();
+        columns.resize(outputMatrix->GetNumElements());
+        ElemType* data = columns.data();
+        size_t size = columns.size();
+        outputMatrix->CopyToArray(data, size);
+
+        for (size_t k = 0; k < numStreams; k++)
+        {
+            auto& vec = outputs[k][i2].m_buffer;
+            size_t numElements = numRows * numFrames[k];
+            if (vec.capacity() < numElements)
+                RuntimeError("Not enough space in output buffer for output '%ls' of stream %d.", node->GetName().c_str(), (int)k);
+
+            vec.resize(numElements);
+            for (size_t t = 0; t < numFrames[k]; t++)
+                std::copy(columns.begin() + (t * numStreams + k) * numRows, columns.begin() + (t * numStreams + k + 1) * numRows, vec.begin() + t * numRows);
+        }
+    }
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::EndStream(size_t streamId)
+{
+    m_streams.erase(streamId);
+}
+
+template<typename ElemType>
+typename CNTKEvalExtended<ElemType>::BoundBuffer CNTKEvalExtended<ElemType>::CheckBinding(const char* function, const ComputationNodeBasePtr& node,
+                                                                                         ElemType* buffer, size_t capacity, bool onDevice) const
+{
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+    if (matrix->GetMatrixType() != MatrixType::DENSE)
+        RuntimeError("%s: %ls: Only dense variables can be bound.", function, node->GetName().c_str());
+    if (buffer == nullptr || capacity == 0)
+        RuntimeError("%s: %ls: Buffer is not allocated.", function, node->GetName().c_str());
+    if (onDevice && matrix->GetDeviceId() == CPUDEVICE)
+        RuntimeError("%s: %ls: The network runs on the CPU, expected a buffer in host memory.", function, node->GetName().c_str());
+
+    BoundBuffer bound;
+    bound.data = buffer;
+    bound.capacity = capacity;
+    bound.onDevice = onDevice;
+    return bound;
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::BindInput(size_t index, const ElemType* buffer, size_t capacity, bool onDevice)
+{
+    if (!m_started)
+        RuntimeError("BindInput() called before StartForwardEvaluation()");
+    if (index >= m_inputNodes.size())
+        RuntimeError("BindInput: Expected an input index less than %d, but got %d.", (int)m_inputNodes.size(), (int)index);
+
+    // const cast: the buffer becomes the value of the input node, which the network does not write to
+    m_boundInputs[index] = CheckBinding("BindInput", m_inputNodes[index], const_cast<ElemType*>(buffer), capacity, onDevice);
+    DetachValue(m_inputNodes[index]); // may live in the buffer bound before
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::BindOutput(size_t index, ElemType* buffer, size_t capacity, bool onDevice)
+{
+    if (!m_started)
+        RuntimeError("BindOutput() called before StartForwardEvaluation()");
+    if (index >= m_outputNodes.size())
+        RuntimeError("BindOutput: Expected an output index less than %d, but got %d.", (int)m_outputNodes.size(), (int)index);
+
+    m_boundOutputs[index] = CheckBinding("BindOutput", m_outputNodes[index], buffer, capacity, onDevice);
+    DetachValue(m_outputNodes[index]);
+}
+
+// The value of a node that points into a bound buffer moves into memory of its own, so that ForwardPass() and
+// ForwardPassStreams() do not write into the buffers of the caller, and the value stays valid when it is unbound.
+template<typename ElemType>
+/*static*/ void CNTKEvalExtended<ElemType>::DetachValue(const ComputationNodeBasePtr& node)
+{
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+    if (!matrix || matrix->OwnBuffer())
+        return;
+    Matrix<ElemType> owned(matrix->GetDeviceId());
+    owned.SetValue(*matrix);
+    *matrix = std::move(owned);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::DetachBoundValues()
+{
+    for (const auto& node : m_inputNodes)
+        DetachValue(node);
+    for (const auto& node : m_outputNodes)
+        DetachValue(node);
+}
+
+// The inputs take the layouts and values of those of 'source', for evaluators of the same inputs (CNTKEvalEnsemble).
+// A dense value on the same device is read in place, like a bound buffer; the others are copied.
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ShareInputValues(const CNTKEvalExtended<ElemType>& source, const std::vector<size_t>& sourceIndices)
+{
+    for (size_t i = 0; i < m_inputNodes.size(); i++)
+    {
+        const auto& sourceNode = source.m_inputNodes[sourceIndices[i]];
+        const auto& sourceLayout = sourceNode->GetMBLayout();
+        auto& layout = m_inputNodes[i]->GetMBLayout();
+        layout->Init(sourceLayout->GetNumParallelSequences(), sourceLayout->GetNumTimeSteps());
+        for (const auto& seq : sourceLayout->GetAllSequences())
+            layout->AddSequence(seq); // also the gaps
+
+        auto sourceMatrix = dynamic_pointer_cast<Matrix<ElemType>>(sourceNode->ValuePtr());
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(m_inputNodes[i]->ValuePtr());
+        DEVICEID_TYPE deviceId = matrix->GetDeviceId();
+        if (!matrix->OwnBuffer()) // still points to the previous value of the source, which may be gone
+            *matrix = Matrix<ElemType>(deviceId);
+        if (sourceMatrix->GetDeviceId() != deviceId)
+            matrix->AssignValuesOf(*sourceMatrix);
+        else if (sourceMatrix->GetMatrixType() == MatrixType::DENSE && matrix->GetMatrixType() == MatrixType::DENSE)
+            matrix->SetValue(sourceMatrix->GetNumRows(), sourceMatrix->GetNumCols(), deviceId, sourceMatrix->Data(), matrixFlagDontOwnBuffer);
+        else
+            matrix->SetValue(*sourceMatrix);
+    }
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBound(const size_t* numSamples, size_t* outputSizes, bool resetRNN)
+{
+    if (!m_started)
+        RuntimeError("ForwardPassBound() called before StartForwardEvaluation()");
+    if (numSamples == nullptr && !m_inputNodes.empty())
+        RuntimeError("ForwardPassBound: Expected the number of samples of %d inputs, but got none.", (int)m_inputNodes.size());
+    this->BindToNumaNode();
+
+    for (size_t i = 0; i < m_inputNodes.size(); i++)
+    {
+        auto& inputNode = m_inputNodes[i];
+        const BoundBuffer& bound = m_boundInputs[i];
+        if (bound.data == nullptr)
+            RuntimeError("ForwardPassBound: Input %ls is not bound.", inputNode->GetName().c_str());
+
+        size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+        size_t numCols = numSamples[i];
+        if (numCols < 1)
+            RuntimeError("ForwardPassBound: Input %ls: Expected at least one sample.", inputNode->GetName().c_str());
+        if (numRows * numCols > bound.capacity)
+            RuntimeError("ForwardPassBound: Input %ls: %d samples of %d elements do not fit into its buffer of %d elements.",
+                         inputNode->GetName().c_str(), (int)numCols, (int)numRows, (int)bound.capacity);
+
+        inputNode->GetMBLayout()->Init(1, numCols);
+        inputNode->GetMBLayout()->AddSequence(0, 0, resetRNN ? 0 : SentinelValueIndicatingUnspecifedSequenceBeginIdx, numCols);
+
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+        DEVICEID_TYPE deviceId = matrix->GetDeviceId();
+        if (bound.onDevice || deviceId == CPUDEVICE)
+            matrix->SetValue(numRows, numCols, deviceId, bound.data, matrixFlagDontOwnBuffer); // read in place
+        else
+        {
+            // host memory for a network on the GPU, copied directly from the buffer
+            if (!matrix->OwnBuffer())
+                *matrix = Matrix<ElemType>(deviceId);
+            matrix->SetValue(numRows, numCols, deviceId, bound.data, matrixFlagNormal);
+        }
+    }
+
+    // Outputs are computed into their buffers where the matrix lives. The buffer keeps the current value of the output,
+    // in case its inputs did not change. An output that outgrows its buffer moves into memory of its own.
+    for (size_t i = 0; i < m_outputNodes.size(); i++)
+    {
+        const BoundBuffer& bound = m_boundOutputs[i];
+        if (bound.data == nullptr)
+            RuntimeError("ForwardPassBound: Output %ls is not bound.", m_outputNodes[i]->GetName().c_str());
+
+        auto outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(m_outputNodes[i]->ValuePtr());
+        DEVICEID_TYPE deviceId = outputMatrix->GetDeviceId();
+        if (bound.onDevice != (deviceId != CPUDEVICE) || outputMatrix->Data() == bound.data || outputMatrix->GetNumElements() > bound.capacity)
+            continue;
+        Matrix<ElemType> placed(1, bound.capacity, bound.data, deviceId, matrixFlagDontOwnBuffer | matrixFlagMovableBuffer);
+        placed.Resize(outputMatrix->GetNumRows(), outputMatrix->GetNumCols());
+        if (!outputMatrix->IsEmpty())
+            placed.SetValue(*outputMatrix);
+        *outputMatrix = std::move(placed);
+    }
+
+    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+    this->m_net->ForwardProp(m_outputNodes);
+
+    for (size_t i = 0; i < m_outputNodes.size(); i++)
+    {
+        auto node = m_outputNodes[i];
+        const BoundBuffer& bound = m_boundOutputs[i];
+        auto outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        if (node->GetMBLayout() && node->GetMBLayout()->GetAllSequences().size() != 1)
+            RuntimeError("Only 1 output sequence supported by this API");
+
+        size_t numElements = outputMatrix->GetNumElements();
+        if (numElements > bound.capacity)
+            RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+
+        if (outputMatrix->Data() != bound.data) // not computed in place
+        {
+            if (bound.onDevice)
+            {
+                Matrix<ElemType> target(outputMatrix->GetNumRows(), outputMatrix->GetNumCols(), bound.data, outputMatrix->GetDeviceId(), matrixFlagDontOwnBuffer);
+                target.SetValue(*outputMatrix);
+            }
+            else
+            {
+                ElemType* data = bound.data;
+                outputMatrix->CopyToArray(data, numElements);
+            }
+        }
+        if (outputSizes)
+            outputSizes[i] = numElements;
+    }
+}
+
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
@@ -442,6 +830,23 @@ void CNTKEvalExtended<ElemType>::Destroy()
     delete this;
 }
 
+template <typename ElemType>
+IEvaluateModelExtended<ElemType>* CNTKEvalExtended<ElemType>::Clone()
+{
+    if (m_started)
+        RuntimeError("Clone() must be called before StartForwardEvaluation().");
+    if (this->m_net == nullptr)
+        RuntimeError("Clone() called before CreateNetwork().");
+
+    std::lock_guard<std::mutex> lock(m_cloneMutex);
+    this->BindToNumaNode();
+    auto clone = new CNTKEvalExtended<ElemType>();
+    clone->m_config = this->m_config;
+    clone->m_numaNode = this->m_numaNode;
+    clone->m_net = this->m_net->CloneSharingParameters();
+    return clone;
+}
+
 template <typename ElemType>
 void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval)
 {
@@ -459,4 +864,264 @@ extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval
 
 template class CNTKEvalExtended<double>;
 template class CNTKEvalExtended<float>;
+
+// ----------------------------------------------------------------------------
+// Ensemble interface
+// ----------------------------------------------------------------------------
+
+template <typename ElemType>
+void CNTKEvalEnsemble<ElemType>::Init(const std::string& config)
+{
+    m_config = config;
+    ConfigParameters parameters;
+    parameters.Parse(config);
+    std::wstring combination = parameters(L"ensembleCombination", L"mean");
+    if (EqualCI(combination, L"mean"))
+        m_logMean = false;
+    else if (EqualCI(combination, L"logMean"))
+        m_logMean = true;
+    else
+        InvalidArgument("Unknown ensembleCombination '%ls', expected 'mean' or 'logMean'.", combination.c_str());
+}
+
+// adds a model, which is evaluated by an evaluator of its own
+template <typename ElemType>
+void CNTKEvalEnsemble<ElemType>::CreateNetwork(const std::string& networkDescription)
+{
+    if (m_started)
+        RuntimeError("CreateNetwork() must be called before StartForwardEvaluation().");
+
+    auto model = new CNTKEvalExtended<ElemType>();
+    try
+    {
+        model->Init(m_config);
+        model->CreateNetwork(networkDescription);
+    }
+    catch (...)
+    {
+        model->Destroy();
+        throw;
+    }
+    m_models.push_back(model);
+}
+
+template <typename ElemType>
+void CNTKEvalEnsemble<ElemType>::CheckHasModels(const char* function) const
+{
+    if (m_models.empty())
+        RuntimeError("%s called before CreateNetwork().", function);
+}
+
+template <typename ElemType>
+VariableSchema CNTKEvalEnsemble<ElemType>::GetOutputSchema() const
+{
+    CheckHasModels("GetOutputSchema()");
+    return m_models[0]->GetOutputSchema();
+}
+
+template <typename ElemType>
+VariableSchema CNTKEvalEnsemble<ElemType>::GetInputSchema() const
+{
+    CheckHasModels("GetInputSchema()");
+    return m_models[0]->GetInputSchema();
+}
+
+// Matches the inputs and outputs of the models to those of the first one, by name, and chooses how to run them.
+template <typename ElemType>
+void CNTKEvalEnsemble<ElemType>::StartForwardEvaluation(const std::vector<std::wstring>& outputs)
+{
+    CheckHasModels("StartForwardEvaluation()");
+    for (auto model : m_models)
+        model->StartForwardEvaluation(outputs);
+
+    const auto& first = *m_models[0];
+    m_inputIndices.assign(m_models.size(), std::vector<size_t>());
+    m_outputIndices.assign(m_models.size(), std::vector<size_t>());
+    for (size_t k = 0; k < m_models.size(); k++)
+    {
+        const auto& model = *m_models[k];
+        if (model.m_inputNodes.size() != first.m_inputNodes.size() || model.m_outputNodes.size() != first.m_outputNodes.size())
+            RuntimeError("Model %d of the ensemble has %d inputs and %d outputs, but the first one has %d and %d.", (int)k,
+                         (int)model.m_inputNodes.size(), (int)model.m_outputNodes.size(), (int)first.m_inputNodes.size(), (int)first.m_outputNodes.size());
+
+        // the index of the node of the same name and dimension in 'nodes'
+        auto match = [k](const std::vector<ComputationNodeBasePtr>& nodes, const ComputationNodeBasePtr& node) -> size_t
+        {
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                if (nodes[i]->GetName() != node->GetName())
+                    continue;
+                if (nodes[i]->GetSampleLayout().GetNumElements() != node->GetSampleLayout().GetNumElements())
+                    RuntimeError("Model %d of the ensemble: %ls has dimension %d in one model and %d in the other.", (int)k, node->GetName().c_str(),
+                                 (int)node->GetSampleLayout().GetNumElements(), (int)nodes[i]->GetSampleLayout().GetNumElements());
+                return i;
+            }
+            RuntimeError("Model %d of the ensemble: %ls is not an input or output of both it and the first model.", (int)k, node->GetName().c_str());
+        };
+        // input i of model k is input m_inputIndices[k][i] of the first model; output j of the first model is output m_outputIndices[k][j] of model k
+        for (const auto& input : model.m_inputNodes)
+            m_inputIndices[k].push_back(match(first.m_inputNodes, input));
+        for (const auto& output : first.m_outputNodes)
+            m_outputIndices[k].push_back(match(model.m_outputNodes, output));
+    }
+
+    // The outputs are combined on the device of the first model.
+    DEVICEID_TYPE deviceId = first.m_net->GetDeviceId();
+    m_combined.clear();
+    for (size_t j = 0; j < first.m_outputNodes.size(); j++)
+        m_combined.emplace_back(deviceId);
+    m_term = Matrix<ElemType>(deviceId);
+
+    // Models on the same GPU run on streams of it, issued from this thread; the others on threads of their own.
+    bool sameDevice = true;
+    for (auto model : m_models)
+        sameDevice &= model->m_net->GetDeviceId() == deviceId;
+    m_taskPool.reset();
+    if (m_models.size() > 1 && (!sameDevice || deviceId == CPUDEVICE))
+        m_taskPool.reset(new CpuTaskPool(m_models.size()));
+
+    m_started = true;
+}
+
+template <typename ElemType>
+void CNTKEvalEnsemble<ElemType>::ForwardPropModels()
+{
+    auto forwardProp = [this](size_t k)
+    {
+        auto& model = *m_models[k];
+        model.BindToNumaNode();
+        ComputationNetwork::BumpEvalTimeStamp(model.m_inputNodes);
+        model.m_net->ForwardProp(model.m_outputNodes);
+    };
+
+    if (m_taskPool)
+    {
+        std::vector<CpuTaskPool::Task> tasks;
+        for (size_t k = 0; k < m_models.size(); k++)
+            tasks.push_back(CpuTaskPool::Task{ [forwardProp, k]() { forwardProp(k); }, {}, k });
+        m_taskPool->Run(tasks);
+        return;
+    }
+
+    // The networks issue to streams of their own if numComputeStreams is set, and regions cannot be nested.
+    std::shared_ptr<ComputeStreamPool> streams;
+    if (m_models.size() > 1 && Globals::GetNumComputeStreams() < 2)
+        streams = ComputeStreamPool::Get(m_models[0]->m_net->GetDeviceId(), m_models.size());
+    if (!streams)
+    {
+        for (size_t k = 0; k < m_models.size(); k++)
+            forwardProp(k);
+        return;
+    }
+
+    // Each stream starts once the inputs are on the device, and the main stream waits for all of them.
+    streams->BeginRegion();
+    try
+    {
+        for (size_t k = 0; k < m_models.size(); k++)
+        {
+            streams->SelectStream(k);
+            forwardProp(k);
+        }
+    }
+    catch (...)
+    {
+        streams->EndRegion();
+        throw;
+    }
+    streams->EndRegion();
+}
+
+// The inputs are packed into the first model, whose values the others read. All models run before their outputs are
+// combined, so an ensemble takes as long as its slowest model if they fit on the device side by side.
+template <typename ElemType>
+void CNTKEvalEnsemble<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs, bool resetRNN)
+{
+    if (!m_started)
+        RuntimeError("ForwardPass() called before StartForwardEvaluation()");
+
+    auto& first = *m_models[0];
+    if (outputs.size() != first.m_outputNodes.size())
+        RuntimeError("Expected %d outputs, but got %d.", (int)first.m_outputNodes.size(), (int)outputs.size());
+
+    first.BindToNumaNode();
+    first.SetInputValues(inputs, resetRNN);
+    for (size_t k = 1; k < m_models.size(); k++)
+        m_models[k]->ShareInputValues(first, m_inputIndices[k]);
+
+    ForwardPropModels();
+
+    const ElemType scale = (ElemType)1 / m_models.size();
+    for (size_t j = 0; j < first.m_outputNodes.size(); j++)
+    {
+        const auto& node = first.m_outputNodes[j];
+        Matrix<ElemType>& combined = m_combined[j];
+        for (size_t k = 0; k < m_models.size(); k++)
+        {
+            const auto& output = m_models[k]->m_outputNodes[m_outputIndices[k][j]];
+            if (output->GetMBLayout() && output->GetMBLayout()->GetAllSequences().size() != 1)
+                RuntimeError("Only 1 output sequence supported by this API");
+
+            auto outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(output->ValuePtr());
+            const Matrix<ElemType>* term = outputMatrix.get();
+            if (k > 0 && (term->GetNumRows() != combined.GetNumRows() || term->GetNumCols() != combined.GetNumCols()))
+                RuntimeError("Output %ls: Model %d of the ensemble computed [%d x %d], but the first model [%d x %d].", node->GetName().c_str(), (int)k,
+                             (int)term->GetNumRows(), (int)term->GetNumCols(), (int)combined.GetNumRows(), (int)combined.GetNumCols());
+            if (term->GetDeviceId() != combined.GetDeviceId())
+            {
+                m_term.AssignValuesFromDevice(*term);
+                term = &m_term;
+            }
+            if (m_logMean)
+            {
+                m_term.AssignLogOf(*term);
+                term = &m_term;
+            }
+
+            if (k == 0)
+                combined.SetValue(*term);
+            else
+                combined += *term;
+        }
+        if (m_models.size() > 1)
+            combined *= scale;
+
+        Vector<ElemType>& vec = outputs[j].m_buffer;
+        size_t numElements = combined.GetNumElements();
+        if (vec.capacity() < numElements)
+            RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+
+        vec.resize(numElements);
+        ElemType* data = const_cast<ElemType*>(vec.data());
+        combined.CopyToArray(data, numElements);
+    }
+}
+
+template <typename ElemType>
+void CNTKEvalEnsemble<ElemType>::Destroy()
+{
+    m_taskPool.reset();
+    for (auto model : m_models)
+        model->Destroy();
+    m_models.clear();
+    delete this;
+}
+
+template <typename ElemType>
+void EVAL_API GetEvalEnsemble(IEvaluateModelEnsemble<ElemType>** peval)
+{
+    *peval = new CNTKEvalEnsemble<ElemType>();
+}
+
+extern "C" EVAL_API void GetEvalEnsembleF(IEvaluateModelEnsemble<float>** peval)
+{
+    GetEvalEnsemble(peval);
+}
+extern "C" EVAL_API void GetEvalEnsembleD(IEvaluateModelEnsemble<double>** peval)
+{
+    GetEvalEnsemble(peval);
+}
+
+template class CNTKEvalEnsemble<double>;
+template class CNTKEvalEnsemble<float>;
 } } }
@@ -13,12 +13,16 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <mutex>
 
 #include "Eval.h"
 #include "EvalReader.h"
 #include "EvalWriter.h"
 
 #include "ComputationNetwork.h"
+#include "RecurrentNodes.h"
+#include "CPUNuma.h"
+#include "CpuTaskPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -29,9 +33,18 @@ protected:
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
     ConfigParameters m_config;
     ComputationNetworkPtr m_net;
+    int m_numaNode; // numaNode=<node>: this replica runs on one NUMA node; -1 if not bound
 
     // constructor
-    CNTKEvalBase() : m_net(nullptr) { }
+    CNTKEvalBase() : m_net(nullptr), m_numaNode(-1) { }
+
+    // Confines the calling thread and its OpenMP threads to the configured NUMA node, so that the model and the
+    // intermediate values are allocated there. Called on every entry point; the host drives each replica from its own thread.
+    void BindToNumaNode() const
+    {
+        if (m_numaNode >= 0)
+            CPUNuma::BindToNode(m_numaNode);
+    }
 public:
 
     // CreateNetwork - create a network based on the network description
@@ -91,7 +104,7 @@ class CNTKEvalExtended : public CNTKEvalBase<ElemType>, public IEvaluateModelExt
 {
 public:
     CNTKEvalExtended() : CNTKEvalBase<ElemType>(), 
-        m_started(false){}
+        m_started(false), m_hasFutureValues(false){}
 
     virtual VariableSchema GetOutputSchema() const override;
 
@@ -107,8 +120,20 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) override;
 
+    virtual void ForwardPassStreams(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) override;
+
+    virtual void EndStream(size_t streamId) override;
+
     virtual void Destroy() override;
 
+    virtual IEvaluateModelExtended<ElemType>* Clone() override;
+
+    virtual void BindInput(size_t index, const ElemType* buffer, size_t capacity, bool onDevice) override;
+
+    virtual void BindOutput(size_t index, ElemType* buffer, size_t capacity, bool onDevice) override;
+
+    virtual void ForwardPassBound(const size_t* numSamples, size_t* outputSizes, bool resetRNN) override;
+
     virtual void CreateNetwork(const std::string& networkDescription) override
     {
         CNTKEvalBase<ElemType>::CreateNetwork(networkDescription);
@@ -120,16 +145,87 @@ public:
     }
 
 private:
+    template <typename> friend class CNTKEvalEnsemble; // runs the forward passes of its models itself
+
     static VariableLayout ToVariableLayout(const ComputationNodeBasePtr n);
     std::vector<ComputationNodeBasePtr> m_outputNodes;
     std::shared_ptr<ScopedNetworkOperationMode> m_scopedNetworkOperationMode;
     std::vector<ComputationNodeBasePtr> m_inputNodes;
     StreamMinibatchInputs m_inputMatrices;
     bool m_started;
+    std::mutex m_cloneMutex; // serializes Clone(), which reads the network
+
+    // recurrent state of a stream of ForwardPassStreams()
+    struct StreamState
+    {
+        size_t numFrames = 0;                                      // evaluated so far
+        std::vector<shared_ptr<Matrix<ElemType>>> pastValues;      // [j] the carried-over frame of m_pastValueNodes[j], on its device
+    };
+    std::vector<shared_ptr<PastValueNode<ElemType>>> m_pastValueNodes;
+    bool m_hasFutureValues;
+    std::map<size_t, StreamState> m_streams;
+
+    // memory of the caller bound by BindInput() and BindOutput()
+    struct BoundBuffer
+    {
+        ElemType* data = nullptr;
+        size_t capacity = 0; // in elements
+        bool onDevice = false;
+    };
+    std::vector<BoundBuffer> m_boundInputs;  // [i] of m_inputNodes
+    std::vector<BoundBuffer> m_boundOutputs; // [i] of m_outputNodes
+    BoundBuffer CheckBinding(const char* function, const ComputationNodeBasePtr& node, ElemType* buffer, size_t capacity, bool onDevice) const;
+    static void DetachValue(const ComputationNodeBasePtr& node);
+    void DetachBoundValues();
 
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
 
+    template<template<typename> class ValueContainer>
+    void SetInputValues(const std::vector<ValueBuffer<ElemType, ValueContainer>>& inputs, bool resetRNN);
+
+    // makes the inputs those of another evaluator: [i] is the index of input i in 'source'
+    void ShareInputValues(const CNTKEvalExtended<ElemType>& source, const std::vector<size_t>& sourceIndices);
+};
+
+// ------------------------------------------------------------------------
+// Ensemble interface
+// ------------------------------------------------------------------------
+template <typename ElemType>
+class CNTKEvalEnsemble : public IEvaluateModelEnsemble<ElemType>
+{
+public:
+    CNTKEvalEnsemble() : m_started(false), m_logMean(false), m_term(CPUDEVICE) {}
+
+    virtual void Init(const std::string& config) override;
+
+    virtual void CreateNetwork(const std::string& networkDescription) override;
+
+    virtual size_t GetNumModels() const override { return m_models.size(); }
+
+    virtual VariableSchema GetOutputSchema() const override;
+
+    virtual void StartForwardEvaluation(const std::vector<std::wstring>& outputs) override;
+
+    virtual VariableSchema GetInputSchema() const override;
+
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs, bool resetRNN) override;
+
+    virtual void Destroy() override;
+
+private:
+    void CheckHasModels(const char* function) const;
+    void ForwardPropModels();
+
+    std::string m_config;
+    std::vector<CNTKEvalExtended<ElemType>*> m_models;
+    bool m_started;
+    bool m_logMean;                                   // ensembleCombination=logMean
+    std::vector<std::vector<size_t>> m_inputIndices;  // [k][i] the index of input i of model k in the inputs of the first model
+    std::vector<std::vector<size_t>> m_outputIndices; // [k][j] the index of output j of the first model in the outputs of model k
+    std::unique_ptr<CpuTaskPool> m_taskPool;          // runs the models concurrently, unless they share a GPU
+    std::vector<Matrix<ElemType>> m_combined;         // [j] the combination of output j, on the device of the first model
+    Matrix<ElemType> m_term;                          // an output moved to that device, or its logarithm
 };
 } } }
@@ -264,6 +264,11 @@ public:
         {
             throw GetCustomException(ex);
         }
+
+        // the native model has released the bound buffers
+        FreeBindings();
+        m_boundInputs = gcnew cli::array<GCHandle>((int)m_eval->GetInputSchema().size());
+        m_boundOutputs = gcnew cli::array<GCHandle>((int)m_eval->GetOutputSchema().size());
     }
 
     //
@@ -333,6 +338,70 @@ public:
         }
     }
 
+    //
+    // BindInput/BindOutput - Bind an array to an input or output, by its index into GetInputSchema() or GetOutputSchema(),
+    // for ForwardPassBound(). The array is pinned until the variable is bound again, StartForwardEvaluation() is called,
+    // or the object is disposed, and the native model reads from and writes into it directly.
+    // Called after StartForwardEvaluation()
+    //
+    void BindInput(int index, cli::array<ElemType>^ buffer)
+    {
+        Bind(index, buffer, true);
+    }
+
+    void BindOutput(int index, cli::array<ElemType>^ buffer)
+    {
+        Bind(index, buffer, false);
+    }
+
+    //
+    // ForwardPassBound - Evaluate the bound arrays, without pinning and marshalling the buffers on each call.
+    // numSamples - [i] the number of samples in the array of input i
+    // outputSizes - [i] receives the number of elements written to the array of output i; can be null
+    // resetRNN - flags whether to reset memory cells of RNN.
+    //
+    void ForwardPassBound(cli::array<int>^ numSamples, cli::array<int>^ outputSizes, bool resetRNN)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        if (m_boundInputs == nullptr)
+        {
+            throw gcnew CNTKRuntimeException("ForwardPassBound() called before StartForwardEvaluation()", String::Empty);
+        }
+
+        if (numSamples == nullptr || numSamples->Length != m_boundInputs->Length)
+        {
+            throw gcnew CNTKRuntimeException(String::Format("Expected the number of samples of {0} inputs.", m_boundInputs->Length), String::Empty);
+        }
+
+        std::vector<size_t> stdNumSamples(numSamples->Length);
+        for (int i = 0; i < numSamples->Length; ++i)
+        {
+            stdNumSamples[i] = (size_t)numSamples[i];
+        }
+        std::vector<size_t> stdOutputSizes(m_boundOutputs->Length);
+
+        try
+        {
+            m_eval->ForwardPassBound(stdNumSamples.data(), stdOutputSizes.data(), resetRNN);
+        }
+        catch (const exception& ex)
+        {
+            throw GetCustomException(ex);
+        }
+
+        if (outputSizes != nullptr)
+        {
+            for (int i = 0; i < outputSizes->Length && i < m_boundOutputs->Length; ++i)
+            {
+                outputSizes[i] = (int)stdOutputSizes[i];
+            }
+        }
+    }
+
     ~ModelEvaluationExtended()
     {
         if (m_eval == nullptr)
@@ -351,12 +420,78 @@ protected:
             m_eval->Destroy();
             m_eval = nullptr;
         }
+        FreeBindings();
     }
 
 private:
     // Native model evaluation instance
     IEvaluateModelExtended<ElemType> *m_eval;
 
+    // The pinned arrays of BindInput() and BindOutput(), by index; null before StartForwardEvaluation()
+    cli::array<GCHandle>^ m_boundInputs;
+    cli::array<GCHandle>^ m_boundOutputs;
+
+    void Bind(int index, cli::array<ElemType>^ buffer, bool isInput)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        if (buffer == nullptr || buffer->Length == 0 || index < 0)
+        {
+            throw gcnew CNTKRuntimeException("Invalid buffer (empty) or index for binding", String::Empty);
+        }
+
+        GCHandle h = GCHandle::Alloc(buffer, GCHandleType::Pinned);
+        ElemType* pp = reinterpret_cast<ElemType *>(h.AddrOfPinnedObject().ToPointer());
+        try
+        {
+            if (isInput)
+            {
+                m_eval->BindInput(index, pp, buffer->Length, false);
+            }
+            else
+            {
+                m_eval->BindOutput(index, pp, buffer->Length, false);
+            }
+        }
+        catch (const exception& ex)
+        {
+            h.Free();
+            throw GetCustomException(ex);
+        }
+
+        // the native model checked the index, and no longer uses the array bound before
+        cli::array<GCHandle>^ handles = isInput ? m_boundInputs : m_boundOutputs;
+        if (handles[index].IsAllocated)
+        {
+            handles[index].Free();
+        }
+        handles[index] = h;
+    }
+
+    void FreeBindings()
+    {
+        for each (cli::array<GCHandle>^ handles in gcnew cli::array<cli::array<GCHandle>^>{ m_boundInputs, m_boundOutputs })
+        {
+            if (handles == nullptr)
+            {
+                continue;
+            }
+
+            for (int i = 0; i < handles->Length; ++i)
+            {
+                if (handles[i].IsAllocated)
+                {
+                    handles[i].Free();
+                }
+            }
+        }
+        m_boundInputs = nullptr;
+        m_boundOutputs = nullptr;
+    }
+
     /// <summary> Throws a CLR exception based on a native exception</summary>
     /// <param name="ex">The native exception to throw as a CLR exception</param>
     /// <returns>A CLR exception</returns>
@@ -552,6 +687,9 @@ void EmitExtended()
     f.GetOutputSchema();
     f.StartForwardEvaluation(nullptr);
     f.ForwardPass(nullptr, nullptr);
+    f.BindInput(0, nullptr);
+    f.BindOutput(0, nullptr);
+    f.ForwardPassBound(nullptr, nullptr, true);
 
     ModelEvaluationExtendedD d;
     d.CreateNetwork("");
@@ -559,6 +697,9 @@ void EmitExtended()
     d.GetOutputSchema();
     d.StartForwardEvaluation(nullptr);
     d.ForwardPass(nullptr, nullptr);
+    d.BindInput(0, nullptr);
+    d.BindOutput(0, nullptr);
+    d.ForwardPassBound(nullptr, nullptr, true);
 
     VariableSchema sc;
     sc.CreateBuffers<float>();
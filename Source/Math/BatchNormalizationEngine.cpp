@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include "BatchNormalizationEngine.h"
 #include "CuDnnFactories.h"
+#include "TensorView.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -72,6 +73,25 @@ void BatchNormEngine<ElemType>::Backward(const Mat& in, const Mat& srcGrad, Mat&
     BackwardCore(in, srcGrad, grad, scale, blendFactor, savedMean, savedInvStdDev, scaleGrad, biasGrad);
 }
 
+template <class ElemType>
+void BatchNormEngine<ElemType>::ForwardActivation(Mat& out, const Mat* residual)
+{
+    assert(out.GetNumRows() == m_inOutT.GetNumElements());
+    if (residual)
+        out += *residual;
+    out.InplaceTruncateBottom(0);
+}
+
+template <class ElemType>
+void BatchNormEngine<ElemType>::BackwardActivation(const Mat& out, Mat& grad)
+{
+    assert(out.GetNumRows() == grad.GetNumRows() && out.GetNumCols() == grad.GetNumCols());
+    // grad = grad .* (out > 0); the ReLU derivative is taken from its output, so the normalized value is not needed
+    TensorShape shape(grad.GetNumElements());
+    TensorView<ElemType> gradView(std::make_shared<Mat>(grad.AsReference()), shape);
+    gradView.AssignElementwiseProductWithLinearRectifierDerivativeFromOutputOf(gradView, TensorView<ElemType>(std::make_shared<Mat>(out.AsReference()), shape));
+}
+
 template <class ElemType>
 class CntkBatchNormEngine : public BatchNormEngine<ElemType>
 {
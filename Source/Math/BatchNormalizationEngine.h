@@ -40,6 +40,12 @@ public:
     void Backward(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& saveMean, const Mat& saveInvStdDev,
                   Mat& scaleGrad, Mat& biasGrad);
 
+    // Fused ReLU activation, for a normalization that is only consumed by a ReLU, directly or after adding a residual:
+    // ForwardActivation() turns 'out' of Forward() into ReLU(out + residual) in place, and BackwardActivation() turns the
+    // gradient of that activation into the srcGrad for Backward(), in place. 'residual' may be null.
+    void ForwardActivation(Mat& out, const Mat* residual);
+    void BackwardActivation(const Mat& out, Mat& grad);
+
     static std::unique_ptr<BatchNormEngine<ElemType>> Create(DEVICEID_TYPE deviceId, const TensorShape& inOutT,
                                                              bool spatial, ImageLayoutKind imageLayout,
                                                              BatchNormEngineKind enabledEngines = BatchNormEngineKind::All);
@@ -10,7 +10,8 @@
 #else
 #ifdef __GNUC__
 #include <stdlib.h>
-#define ALIGNED_ALLOC(bytes,alignment) aligned_alloc(alignment,bytes)
+// aligned_alloc() requires the size to be a multiple of the alignment
+#define ALIGNED_ALLOC(bytes,alignment) aligned_alloc(alignment,(((bytes)+(alignment)-1)/(alignment))*(alignment))
 #define ALIGNED_FREE(ptr) free(ptr)
 //#define FORCEINLINE __attribute__((always_inline)) 
 #define FORCEINLINE inline 
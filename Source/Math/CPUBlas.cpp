@@ -0,0 +1,504 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUBlas.cpp -- dispatch of the dense CPU BLAS calls to the linked or a runtime-loaded CBLAS library
+//
+
+#include "stdafx.h"
+#include "CPUBlas.h"
+#include "Basics.h"
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <list>
+#include <tuple>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+#ifdef USE_MKL
+#include <mkl.h>
+#else
+#ifdef _MSC_VER
+// Visual Studio doesn't define standard complex types properly
+#define HAVE_LAPACK_CONFIG_H
+#define LAPACK_COMPLEX_STRUCTURE
+#endif
+#include <cblas.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// values of the CBLAS enums, fixed by the CBLAS standard, so that loaded libraries can be called without their headers
+static const int s_cblasColMajor = 102;
+static const int s_cblasNoTrans = 111;
+static const int s_cblasTrans = 112;
+
+// the CBLAS entry points CPUBlas dispatches to, with the enums passed as int
+struct CBlasFunctions
+{
+    std::wstring name;
+    void (*sgemm)(int, int, int, int, int, int, float, const float*, int, const float*, int, float, float*, int);
+    void (*dgemm)(int, int, int, int, int, int, double, const double*, int, const double*, int, double, double*, int);
+    void (*saxpy)(int, float, const float*, int, float*, int);
+    void (*daxpy)(int, double, const double*, int, double*, int);
+    float (*sdot)(int, const float*, int, const float*, int);
+    double (*ddot)(int, const double*, int, const double*, int);
+    void (*sscal)(int, float, float*, int);
+    void (*dscal)(int, double, double*, int);
+    float (*snrm2)(int, const float*, int);
+    double (*dnrm2)(int, const double*, int);
+    float (*sasum)(int, const float*, int);
+    double (*dasum)(int, const double*, int);
+    void (*scopy)(int, const float*, int, float*, int);
+    void (*dcopy)(int, const double*, int, double*, int);
+    // optional; BLIS counts threads in its 64-bit dim_t
+    void (*setNumThreads)(int);
+    void (*setNumThreads64)(int64_t);
+};
+
+static const CBlasFunctions& LinkedFunctions()
+{
+    static const CBlasFunctions linked = []
+    {
+        CBlasFunctions f = {};
+#ifdef USE_MKL
+        f.name = L"linked (mkl)";
+        f.setNumThreads = [](int numThreads) { mkl_set_num_threads(numThreads); };
+#elif defined(USE_OPENBLAS)
+        f.name = L"linked (openblas)";
+        f.setNumThreads = [](int numThreads) { openblas_set_num_threads(numThreads); };
+#else
+        f.name = L"linked";
+#endif
+        f.sgemm = [](int order, int transA, int transB, int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float beta, float* c, int ldc)
+        {
+            cblas_sgemm((CBLAS_ORDER) order, (CBLAS_TRANSPOSE) transA, (CBLAS_TRANSPOSE) transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        };
+        f.dgemm = [](int order, int transA, int transB, int m, int n, int k, double alpha, const double* a, int lda, const double* b, int ldb, double beta, double* c, int ldc)
+        {
+            cblas_dgemm((CBLAS_ORDER) order, (CBLAS_TRANSPOSE) transA, (CBLAS_TRANSPOSE) transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+        };
+        f.saxpy = [](int n, float alpha, const float* x, int incx, float* y, int incy) { cblas_saxpy(n, alpha, x, incx, y, incy); };
+        f.daxpy = [](int n, double alpha, const double* x, int incx, double* y, int incy) { cblas_daxpy(n, alpha, x, incx, y, incy); };
+        f.sdot = [](int n, const float* x, int incx, const float* y, int incy) { return (float) cblas_sdot(n, x, incx, y, incy); };
+        f.ddot = [](int n, const double* x, int incx, const double* y, int incy) { return (double) cblas_ddot(n, x, incx, y, incy); };
+        f.sscal = [](int n, float alpha, float* x, int incx) { cblas_sscal(n, alpha, x, incx); };
+        f.dscal = [](int n, double alpha, double* x, int incx) { cblas_dscal(n, alpha, x, incx); };
+        f.snrm2 = [](int n, const float* x, int incx) { return (float) cblas_snrm2(n, x, incx); };
+        f.dnrm2 = [](int n, const double* x, int incx) { return (double) cblas_dnrm2(n, x, incx); };
+        f.sasum = [](int n, const float* x, int incx) { return (float) cblas_sasum(n, x, incx); };
+        f.dasum = [](int n, const double* x, int incx) { return (double) cblas_dasum(n, x, incx); };
+        f.scopy = [](int n, const float* x, int incx, float* y, int incy) { cblas_scopy(n, x, incx, y, incy); };
+        f.dcopy = [](int n, const double* x, int incx, double* y, int incy) { cblas_dcopy(n, x, incx, y, incy); };
+        return f;
+    }();
+    return linked;
+}
+
+// ---------------------------------------------------------------------------
+// loading a library
+// ---------------------------------------------------------------------------
+
+static void* LoadSharedLibrary(const std::wstring& path)
+{
+#ifdef _WIN32
+    HMODULE module = LoadLibraryW(path.c_str());
+    if (module == NULL)
+        RuntimeError("CPUBlas: Could not load BLAS library '%ls' (error %d).", path.c_str(), (int) GetLastError());
+    return (void*) module;
+#else
+    // RTLD_DEEPBIND: the library must use its own BLAS/LAPACK symbols, not those of the library CNTK was linked with
+    int flags = RTLD_NOW | RTLD_LOCAL;
+#ifdef RTLD_DEEPBIND
+    flags |= RTLD_DEEPBIND;
+#endif
+    void* handle = dlopen(msra::strfun::utf8(path).c_str(), flags);
+    if (handle == nullptr)
+        RuntimeError("CPUBlas: Could not load BLAS library '%ls' (error: %s).", path.c_str(), dlerror());
+    return handle;
+#endif
+}
+
+static void* FindSymbol(void* library, const char* name)
+{
+#ifdef _WIN32
+    return (void*) GetProcAddress((HMODULE) library, name);
+#else
+    return dlsym(library, name);
+#endif
+}
+
+template <class F>
+static void ResolveSymbol(void* library, const std::wstring& path, const char* name, F& function)
+{
+    function = (F) FindSymbol(library, name);
+    if (function == nullptr)
+        RuntimeError("CPUBlas: '%ls' is not a CBLAS library, it does not export '%s'.", path.c_str(), name);
+}
+
+static CBlasFunctions LoadFunctions(const std::wstring& path)
+{
+    // never unloaded: other threads may still be inside a call, and there are only ever a few of them
+    void* library = LoadSharedLibrary(path);
+
+    CBlasFunctions f = {};
+    ResolveSymbol(library, path, "cblas_sgemm", f.sgemm);
+    ResolveSymbol(library, path, "cblas_dgemm", f.dgemm);
+    ResolveSymbol(library, path, "cblas_saxpy", f.saxpy);
+    ResolveSymbol(library, path, "cblas_daxpy", f.daxpy);
+    ResolveSymbol(library, path, "cblas_sdot", f.sdot);
+    ResolveSymbol(library, path, "cblas_ddot", f.ddot);
+    ResolveSymbol(library, path, "cblas_sscal", f.sscal);
+    ResolveSymbol(library, path, "cblas_dscal", f.dscal);
+    ResolveSymbol(library, path, "cblas_snrm2", f.snrm2);
+    ResolveSymbol(library, path, "cblas_dnrm2", f.dnrm2);
+    ResolveSymbol(library, path, "cblas_sasum", f.sasum);
+    ResolveSymbol(library, path, "cblas_dasum", f.dasum);
+    ResolveSymbol(library, path, "cblas_scopy", f.scopy);
+    ResolveSymbol(library, path, "cblas_dcopy", f.dcopy);
+
+    // the thread-count setter also tells which library it is
+    std::wstring kind = L"cblas";
+    if ((f.setNumThreads = (void (*)(int)) FindSymbol(library, "MKL_Set_Num_Threads")) != nullptr)
+        kind = L"mkl";
+    else if ((f.setNumThreads = (void (*)(int)) FindSymbol(library, "openblas_set_num_threads")) != nullptr)
+        kind = L"openblas";
+    else if ((f.setNumThreads64 = (void (*)(int64_t)) FindSymbol(library, "bli_thread_set_num_threads")) != nullptr)
+        kind = L"blis";
+    f.name = kind + L" (" + path + L")";
+    return f;
+}
+
+// ---------------------------------------------------------------------------
+// backend selection
+// ---------------------------------------------------------------------------
+
+static std::mutex s_backendMutex;
+static std::atomic<const CBlasFunctions*> s_backend(nullptr);
+static std::list<CBlasFunctions> s_loadedBackends; // keeps the tables alive that s_backend may point to
+static std::atomic<int> s_numThreads(0);            // last value passed to SetNumThreads(), 0 if never set
+
+static void ApplyNumThreads(const CBlasFunctions& backend)
+{
+    int numThreads = s_numThreads;
+    if (numThreads <= 0)
+        return;
+    if (backend.setNumThreads)
+        backend.setNumThreads(numThreads);
+    else if (backend.setNumThreads64)
+        backend.setNumThreads64(numThreads);
+}
+
+// caller holds s_backendMutex
+static void SetBackend(const std::wstring& path)
+{
+    const CBlasFunctions* backend = &LinkedFunctions();
+    if (!path.empty())
+    {
+        s_loadedBackends.push_back(LoadFunctions(path));
+        backend = &s_loadedBackends.back();
+    }
+    ApplyNumThreads(*backend);
+    s_backend = backend;
+}
+
+static const CBlasFunctions& Backend()
+{
+    const CBlasFunctions* backend = s_backend.load(std::memory_order_acquire);
+    if (backend == nullptr) // first call: the environment may select a library, and switch on statistics
+    {
+        std::lock_guard<std::mutex> lock(s_backendMutex);
+        if (s_backend.load() == nullptr)
+        {
+            const char* statistics = getenv("CNTK_CPU_BLAS_STATISTICS");
+            if (statistics && *statistics && strcmp(statistics, "0") != 0)
+                CPUBlas::EnableStatistics(true);
+            const char* path = getenv("CNTK_CPU_BLAS_LIBRARY");
+            SetBackend(path ? msra::strfun::utf16(path) : std::wstring());
+        }
+        backend = s_backend.load();
+    }
+    return *backend;
+}
+
+void CPUBlas::LoadBackend(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(s_backendMutex);
+    SetBackend(path);
+}
+
+std::wstring CPUBlas::GetBackendName()
+{
+    return Backend().name;
+}
+
+void CPUBlas::SetNumThreads(int numThreads)
+{
+    s_numThreads = numThreads;
+    ApplyNumThreads(Backend());
+}
+
+// ---------------------------------------------------------------------------
+// statistics
+// ---------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+struct OpStatistics
+{
+    std::atomic<size_t> numCalls;
+    std::atomic<long long> nanoseconds;
+};
+
+struct GemmShape
+{
+    size_t m, n, k;
+    bool transposeA, transposeB;
+    size_t elementSize;
+
+    bool operator<(const GemmShape& other) const
+    {
+        return std::tie(m, n, k, transposeA, transposeB, elementSize) < std::tie(other.m, other.n, other.k, other.transposeA, other.transposeB, other.elementSize);
+    }
+};
+
+struct GemmShapeStatistics
+{
+    size_t numCalls;
+    double seconds;
+};
+
+static const char* s_opNames[(size_t) CPUBlasOp::Count] = { "gemm", "axpy", "dot", "scal", "nrm2", "asum", "copy" };
+static std::atomic<bool> s_statisticsEnabled(false);
+static OpStatistics s_opStatistics[(size_t) CPUBlasOp::Count];
+static std::mutex s_gemmShapesMutex;
+
+static std::map<GemmShape, GemmShapeStatistics>& GemmShapes()
+{
+    static std::map<GemmShape, GemmShapeStatistics> gemmShapes;
+    return gemmShapes;
+}
+
+// prints what was collected when the process exits
+struct StatisticsPrinterAtExit
+{
+    ~StatisticsPrinterAtExit()
+    {
+        if (CPUBlas::IsStatisticsEnabled())
+            CPUBlas::PrintStatistics(stderr);
+    }
+};
+
+void CPUBlas::EnableStatistics(bool enable)
+{
+    if (enable)
+    {
+        // constructed before, hence destroyed after the printer
+        LinkedFunctions();
+        GemmShapes();
+        static StatisticsPrinterAtExit printer;
+    }
+    s_statisticsEnabled = enable;
+}
+
+bool CPUBlas::IsStatisticsEnabled()
+{
+    return s_statisticsEnabled.load(std::memory_order_relaxed);
+}
+
+void CPUBlas::ResetStatistics()
+{
+    for (auto& op : s_opStatistics)
+    {
+        op.numCalls = 0;
+        op.nanoseconds = 0;
+    }
+    std::lock_guard<std::mutex> lock(s_gemmShapesMutex);
+    GemmShapes().clear();
+}
+
+size_t CPUBlas::GetNumCalls(CPUBlasOp op)
+{
+    return s_opStatistics[(size_t) op].numCalls;
+}
+
+size_t CPUBlas::GetNumGemmCalls(size_t m, size_t n, size_t k, bool transposeA, bool transposeB, size_t elementSize)
+{
+    std::lock_guard<std::mutex> lock(s_gemmShapesMutex);
+    auto iter = GemmShapes().find(GemmShape{ m, n, k, transposeA, transposeB, elementSize });
+    return iter == GemmShapes().end() ? 0 : iter->second.numCalls;
+}
+
+void CPUBlas::PrintStatistics(FILE* f, size_t maxGemmShapes)
+{
+    fprintf(f, "CPU BLAS statistics, backend %ls:\n", GetBackendName().c_str());
+    fprintf(f, "    %-6s %12s %12s\n", "op", "calls", "total ms");
+    for (size_t op = 0; op < (size_t) CPUBlasOp::Count; op++)
+    {
+        if (s_opStatistics[op].numCalls > 0)
+            fprintf(f, "    %-6s %12llu %12.3f\n", s_opNames[op], (unsigned long long) s_opStatistics[op].numCalls, s_opStatistics[op].nanoseconds * 1e-6);
+    }
+
+    std::vector<std::pair<GemmShape, GemmShapeStatistics>> shapes;
+    {
+        std::lock_guard<std::mutex> lock(s_gemmShapesMutex);
+        shapes.assign(GemmShapes().begin(), GemmShapes().end());
+    }
+    if (shapes.empty())
+        return;
+    std::sort(shapes.begin(), shapes.end(), [](const std::pair<GemmShape, GemmShapeStatistics>& a, const std::pair<GemmShape, GemmShapeStatistics>& b)
+    {
+        return a.second.seconds > b.second.seconds;
+    });
+    const size_t numShapes = maxGemmShapes == 0 ? shapes.size() : std::min(maxGemmShapes, shapes.size());
+    fprintf(f, "GEMM shapes by total time (%d of %d):\n", (int) numShapes, (int) shapes.size());
+    fprintf(f, "    %8s %8s %8s %-4s %-6s %10s %12s %10s %8s\n", "m", "n", "k", "op", "type", "calls", "total ms", "avg us", "GFlop/s");
+    for (size_t i = 0; i < numShapes; i++)
+    {
+        const GemmShape& shape = shapes[i].first;
+        const GemmShapeStatistics& statistics = shapes[i].second;
+        const double flops = 2.0 * shape.m * shape.n * shape.k * statistics.numCalls;
+        fprintf(f, "    %8d %8d %8d %c%c   %-6s %10llu %12.3f %10.2f %8.2f\n", (int) shape.m, (int) shape.n, (int) shape.k,
+                shape.transposeA ? 'T' : 'N', shape.transposeB ? 'T' : 'N', shape.elementSize == sizeof(float) ? "float" : "double",
+                (unsigned long long) statistics.numCalls, statistics.seconds * 1e3, statistics.seconds * 1e6 / statistics.numCalls,
+                statistics.seconds > 0 ? flops / statistics.seconds * 1e-9 : 0.0);
+    }
+}
+
+// times one call, and records it on destruction
+class CallRecorder
+{
+public:
+    CallRecorder(CPUBlasOp op, const GemmShape* gemmShape = nullptr)
+        : m_op(op), m_gemmShape(gemmShape), m_start(Clock::now())
+    {
+    }
+
+    ~CallRecorder()
+    {
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count();
+        auto& op = s_opStatistics[(size_t) m_op];
+        op.numCalls++;
+        op.nanoseconds += (long long) nanoseconds;
+        if (m_gemmShape)
+        {
+            std::lock_guard<std::mutex> lock(s_gemmShapesMutex);
+            auto& shape = GemmShapes()[*m_gemmShape];
+            shape.numCalls++;
+            shape.seconds += nanoseconds * 1e-9;
+        }
+    }
+
+private:
+    CPUBlasOp m_op;
+    const GemmShape* m_gemmShape;
+    Clock::time_point m_start;
+};
+
+// calls the backend, timed if statistics are enabled
+template <class Call>
+static inline auto Dispatch(CPUBlasOp op, const Call& call) -> decltype(call(Backend()))
+{
+    const CBlasFunctions& backend = Backend();
+    if (!CPUBlas::IsStatisticsEnabled())
+        return call(backend);
+    CallRecorder recorder(op);
+    return call(backend);
+}
+
+template <class ElemType, class GemmFunction>
+static inline void DispatchGemm(GemmFunction CBlasFunctions::*gemm, bool transposeA, bool transposeB, int m, int n, int k, ElemType alpha,
+                                const ElemType* a, int lda, const ElemType* b, int ldb, ElemType beta, ElemType* c, int ldc)
+{
+    const CBlasFunctions& backend = Backend();
+    const int transA = transposeA ? s_cblasTrans : s_cblasNoTrans;
+    const int transB = transposeB ? s_cblasTrans : s_cblasNoTrans;
+    if (!CPUBlas::IsStatisticsEnabled())
+        return (backend.*gemm)(s_cblasColMajor, transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    const GemmShape shape{ (size_t) m, (size_t) n, (size_t) k, transposeA, transposeB, sizeof(ElemType) };
+    CallRecorder recorder(CPUBlasOp::Gemm, &shape);
+    (backend.*gemm)(s_cblasColMajor, transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+// ---------------------------------------------------------------------------
+// operations
+// ---------------------------------------------------------------------------
+
+void CPUBlas::Gemm(bool transposeA, bool transposeB, int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float beta, float* c, int ldc)
+{
+    DispatchGemm(&CBlasFunctions::sgemm, transposeA, transposeB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+void CPUBlas::Gemm(bool transposeA, bool transposeB, int m, int n, int k, double alpha, const double* a, int lda, const double* b, int ldb, double beta, double* c, int ldc)
+{
+    DispatchGemm(&CBlasFunctions::dgemm, transposeA, transposeB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+void CPUBlas::Axpy(int n, float alpha, const float* x, int incx, float* y, int incy)
+{
+    Dispatch(CPUBlasOp::Axpy, [&](const CBlasFunctions& f) { f.saxpy(n, alpha, x, incx, y, incy); });
+}
+
+void CPUBlas::Axpy(int n, double alpha, const double* x, int incx, double* y, int incy)
+{
+    Dispatch(CPUBlasOp::Axpy, [&](const CBlasFunctions& f) { f.daxpy(n, alpha, x, incx, y, incy); });
+}
+
+float CPUBlas::Dot(int n, const float* x, int incx, const float* y, int incy)
+{
+    return Dispatch(CPUBlasOp::Dot, [&](const CBlasFunctions& f) { return f.sdot(n, x, incx, y, incy); });
+}
+
+double CPUBlas::Dot(int n, const double* x, int incx, const double* y, int incy)
+{
+    return Dispatch(CPUBlasOp::Dot, [&](const CBlasFunctions& f) { return f.ddot(n, x, incx, y, incy); });
+}
+
+void CPUBlas::Scal(int n, float alpha, float* x, int incx)
+{
+    Dispatch(CPUBlasOp::Scal, [&](const CBlasFunctions& f) { f.sscal(n, alpha, x, incx); });
+}
+
+void CPUBlas::Scal(int n, double alpha, double* x, int incx)
+{
+    Dispatch(CPUBlasOp::Scal, [&](const CBlasFunctions& f) { f.dscal(n, alpha, x, incx); });
+}
+
+float CPUBlas::Nrm2(int n, const float* x, int incx)
+{
+    return Dispatch(CPUBlasOp::Nrm2, [&](const CBlasFunctions& f) { return f.snrm2(n, x, incx); });
+}
+
+double CPUBlas::Nrm2(int n, const double* x, int incx)
+{
+    return Dispatch(CPUBlasOp::Nrm2, [&](const CBlasFunctions& f) { return f.dnrm2(n, x, incx); });
+}
+
+float CPUBlas::Asum(int n, const float* x, int incx)
+{
+    return Dispatch(CPUBlasOp::Asum, [&](const CBlasFunctions& f) { return f.sasum(n, x, incx); });
+}
+
+double CPUBlas::Asum(int n, const double* x, int incx)
+{
+    return Dispatch(CPUBlasOp::Asum, [&](const CBlasFunctions& f) { return f.dasum(n, x, incx); });
+}
+
+void CPUBlas::Copy(int n, const float* x, int incx, float* y, int incy)
+{
+    Dispatch(CPUBlasOp::Copy, [&](const CBlasFunctions& f) { f.scopy(n, x, incx, y, incy); });
+}
+
+void CPUBlas::Copy(int n, const double* x, int incx, double* y, int incy)
+{
+    Dispatch(CPUBlasOp::Copy, [&](const CBlasFunctions& f) { f.dcopy(n, x, incx, y, incy); });
+}
+
+}}}
@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUBlas.h -- dispatch of the dense CPU BLAS calls to the BLAS library CNTK was linked with, or to one chosen at runtime
+//
+// CPUMatrix and CPUSparseMatrix call BLAS only through CPUBlas. By default the calls go to the library selected at build
+// time (MATHLIB=mkl or openblas). LoadBackend() instead routes them to any shared library that exports the standard CBLAS
+// interface (MKL's mkl_rt, OpenBLAS, BLIS, ...), so the library can be chosen per deployment without rebuilding, e.g.
+// with cpuBlasLibrary=/opt/blis/lib/libblis.so in the config, or the CNTK_CPU_BLAS_LIBRARY environment variable.
+//
+// With statistics enabled, each call is counted and timed per operation, and GEMMs are recorded per shape
+// (m, n, k, transposes, precision). The shape histogram is printed on request, and at process exit.
+// LAPACK (SVD) is not dispatched; it always uses the linked library.
+//
+
+#pragma once
+
+#include <string>
+#include <cstdio>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class CPUBlasOp
+{
+    Gemm,
+    Axpy,
+    Dot,
+    Scal,
+    Nrm2,
+    Asum,
+    Copy,
+    Count // number of operations
+};
+
+class CPUBlas
+{
+public:
+    // Routes all subsequent calls to the CBLAS library at 'path'. An empty path goes back to the linked library.
+    // Meant to be called at startup, before any computation; a library that lacks any of the required symbols is
+    // rejected with a RuntimeError and the current backend stays in place.
+    static void LoadBackend(const std::wstring& path);
+    // "linked (mkl)", "openblas (/usr/lib/libopenblas.so.0)", ...
+    static std::wstring GetBackendName();
+    // forwards the thread count to the library's own setter, if it has one
+    static void SetNumThreads(int numThreads);
+
+    static void EnableStatistics(bool enable);
+    static bool IsStatisticsEnabled();
+    static void ResetStatistics();
+    // per-op totals, then the GEMM shapes with the most time (at most maxGemmShapes of them, 0 = all)
+    static void PrintStatistics(FILE* f = stderr, size_t maxGemmShapes = 20);
+    static size_t GetNumCalls(CPUBlasOp op);
+    // number of calls of one GEMM shape
+    static size_t GetNumGemmCalls(size_t m, size_t n, size_t k, bool transposeA, bool transposeB, size_t elementSize);
+
+    // Column-major operations, same arguments as cblas_?gemm etc.
+    static void Gemm(bool transposeA, bool transposeB, int m, int n, int k, float alpha, const float* a, int lda, const float* b, int ldb, float beta, float* c, int ldc);
+    static void Gemm(bool transposeA, bool transposeB, int m, int n, int k, double alpha, const double* a, int lda, const double* b, int ldb, double beta, double* c, int ldc);
+    static void Axpy(int n, float alpha, const float* x, int incx, float* y, int incy);
+    static void Axpy(int n, double alpha, const double* x, int incx, double* y, int incy);
+    static float Dot(int n, const float* x, int incx, const float* y, int incy);
+    static double Dot(int n, const double* x, int incx, const double* y, int incy);
+    static void Scal(int n, float alpha, float* x, int incx);
+    static void Scal(int n, double alpha, double* x, int incx);
+    static float Nrm2(int n, const float* x, int incx);
+    static double Nrm2(int n, const double* x, int incx);
+    static float Asum(int n, const float* x, int incx);
+    static double Asum(int n, const double* x, int incx);
+    static void Copy(int n, const float* x, int incx, float* y, int incy);
+    static void Copy(int n, const double* x, int incx, double* y, int incy);
+};
+
+}}}
@@ -0,0 +1,265 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUHugePageAllocator.cpp -- huge-page backed host memory for large CPU matrices and reader buffers
+//
+
+#include "stdafx.h"
+#include "CPUHugePageAllocator.h"
+#include "CPUNuma.h"
+#include "Basics.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static std::atomic<int> s_mode((int) CPUHugePageAllocator::Mode::none);
+static std::atomic<size_t> s_minBytes(CPUHugePageAllocator::s_pageSize);
+static std::atomic<size_t> s_maxCachedBytes(1024 * 1024 * 1024);
+// lets Free() tell without taking the lock that a buffer cannot be ours, which is the common case
+static std::atomic<size_t> s_numBlocksInUse(0);
+
+struct HugePageCache
+{
+    std::mutex mutex;
+    std::unordered_map<void*, size_t> sizesInUse; // [block handed out] -> its size class
+    std::multimap<size_t, void*> cached;          // size class -> idle blocks
+    CPUHugePageAllocator::Statistics statistics;
+    bool hugeTlbExhausted = false;                // the hugetlbfs pool failed a request, use transparent huge pages
+};
+
+// Never destroyed: matrices of static objects may be freed after it would have been.
+static HugePageCache& Cache()
+{
+    static auto* s_cache = new HugePageCache();
+    return *s_cache;
+}
+
+#ifndef _WIN32
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+static const size_t s_gigaPageSize = 1024 * 1024 * 1024;
+
+// pages of the hugetlbfs pool, nullptr if it has none left
+static void* MapHugeTlb(size_t size)
+{
+#ifdef MAP_HUGETLB
+    const int pageSizeFlag = size % s_gigaPageSize == 0 ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | pageSizeFlag, -1, 0);
+    if (p == MAP_FAILED && pageSizeFlag == MAP_HUGE_1GB) // no 1 GB pages reserved, try 2 MB ones
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+#else
+    return nullptr;
+#endif
+}
+
+// anonymous memory aligned to a huge page, which lets the kernel back all of it by huge pages
+static void* MapTransparent(size_t size)
+{
+    const size_t alignment = CPUHugePageAllocator::s_pageSize;
+    void* p = mmap(nullptr, size + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+    char* begin = (char*) p;
+    char* aligned = (char*) (((size_t) begin + alignment - 1) / alignment * alignment);
+    if (aligned > begin)
+        munmap(begin, aligned - begin);
+    munmap(aligned + size, begin + alignment - aligned); // never empty, since aligned < begin + alignment
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE); // only a hint, without it the block still works with small pages
+#endif
+    return aligned;
+}
+
+static void Unmap(void* p, size_t size)
+{
+    munmap(p, size);
+}
+
+#else
+
+static void* MapHugeTlb(size_t) { return nullptr; }
+static void* MapTransparent(size_t) { return nullptr; }
+static void Unmap(void*, size_t) { }
+
+#endif
+
+// called with the cache locked
+static void TrimTo(HugePageCache& cache, size_t maxCachedBytes)
+{
+    while (cache.statistics.bytesCached > maxCachedBytes)
+    {
+        auto largest = std::prev(cache.cached.end());
+        Unmap(largest->second, largest->first);
+        cache.statistics.numReleases++;
+        cache.statistics.bytesCached -= largest->first;
+        cache.cached.erase(largest);
+    }
+}
+
+void CPUHugePageAllocator::SetMode(Mode mode)
+{
+#ifdef _WIN32
+    if (mode != Mode::none)
+        fprintf(stderr, "CPUHugePageAllocator: Huge pages are not supported on Windows, ignored.\n");
+#endif
+    s_mode = (int) mode;
+}
+
+CPUHugePageAllocator::Mode CPUHugePageAllocator::GetMode()
+{
+    return (Mode) s_mode.load(std::memory_order_relaxed);
+}
+
+void CPUHugePageAllocator::SetMinBytes(size_t bytes)
+{
+    s_minBytes = bytes;
+}
+
+size_t CPUHugePageAllocator::GetMinBytes()
+{
+    return s_minBytes;
+}
+
+void CPUHugePageAllocator::SetMaxCachedBytes(size_t bytes)
+{
+    s_maxCachedBytes = bytes;
+    HugePageCache& cache = Cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    TrimTo(cache, bytes);
+}
+
+size_t CPUHugePageAllocator::GetMaxCachedBytes()
+{
+    return s_maxCachedBytes;
+}
+
+/*static*/ size_t CPUHugePageAllocator::SizeClass(size_t size)
+{
+    if (size <= s_pageSize)
+        return s_pageSize;
+    size_t powerOfTwo = s_pageSize;
+    while (powerOfTwo * 2 < size)
+        powerOfTwo *= 2;
+    // powerOfTwo < size <= 2 * powerOfTwo, in steps of a quarter, but at least a page
+    const size_t step = std::max(powerOfTwo / 4, s_pageSize);
+    return (size + step - 1) / step * step;
+}
+
+static void Zero(void* p, size_t size)
+{
+    if (CPUNuma::IsNumaModeEnabled())
+        CPUNuma::FirstTouchZero(p, size);
+    else
+        memset(p, 0, size);
+}
+
+void* CPUHugePageAllocator::Alloc(size_t size, bool zero)
+{
+    const Mode mode = GetMode();
+    if (mode == Mode::none || size < GetMinBytes() || size == 0)
+        return nullptr;
+
+    const size_t sizeClass = SizeClass(size);
+    HugePageCache& cache = Cache();
+    void* reused = nullptr;
+    bool tryHugeTlb;
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto cached = cache.cached.find(sizeClass);
+        if (cached != cache.cached.end())
+        {
+            reused = cached->second;
+            cache.cached.erase(cached);
+            cache.sizesInUse[reused] = sizeClass;
+            s_numBlocksInUse++;
+            cache.statistics.numReuses++;
+            cache.statistics.bytesCached -= sizeClass;
+            cache.statistics.bytesInUse += sizeClass;
+        }
+        tryHugeTlb = mode == Mode::hugetlb && !cache.hugeTlbExhausted;
+    }
+    if (reused)
+    {
+        if (zero)
+            Zero(reused, size); // the tail past 'size' is never looked at
+        return reused;
+    }
+
+    // not under the lock, this is the slow part
+    void* p = tryHugeTlb ? MapHugeTlb(sizeClass) : nullptr;
+    const bool fromHugeTlb = p != nullptr;
+    if (!p)
+        p = MapTransparent(sizeClass);
+    if (!p)
+        return nullptr;
+    // Fresh pages read as zeros; only in NUMA mode are they touched here, to place them near the threads that use them.
+    if (zero && CPUNuma::IsNumaModeEnabled())
+        CPUNuma::FirstTouchZero(p, size);
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.sizesInUse[p] = sizeClass;
+    s_numBlocksInUse++;
+    cache.statistics.numAllocations++;
+    cache.statistics.bytesInUse += sizeClass;
+    if (fromHugeTlb)
+        cache.statistics.numHugeTlbAllocations++;
+    else if (tryHugeTlb)
+        cache.hugeTlbExhausted = true;
+    return p;
+}
+
+bool CPUHugePageAllocator::Free(void* p)
+{
+    if (!p || s_numBlocksInUse.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    HugePageCache& cache = Cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto inUse = cache.sizesInUse.find(p);
+    if (inUse == cache.sizesInUse.end())
+        return false;
+    const size_t sizeClass = inUse->second;
+    cache.sizesInUse.erase(inUse);
+    s_numBlocksInUse--;
+    cache.cached.insert(std::make_pair(sizeClass, p));
+    cache.statistics.bytesInUse -= sizeClass;
+    cache.statistics.bytesCached += sizeClass;
+    TrimTo(cache, s_maxCachedBytes);
+    return true;
+}
+
+void CPUHugePageAllocator::Trim()
+{
+    HugePageCache& cache = Cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    TrimTo(cache, 0);
+}
+
+CPUHugePageAllocator::Statistics CPUHugePageAllocator::GetStatistics()
+{
+    HugePageCache& cache = Cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return cache.statistics;
+}
+
+}}}
@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUHugePageAllocator.h -- huge-page backed host memory for large CPU matrices and reader buffers
+//
+// With huge pages enabled (hugePages=true, or hugeTlbPages=true), CPUMatrix buffers and reader buffers of at least
+// GetMinBytes() are mapped in multiples of 2 MB, aligned to 2 MB, so that the kernels streaming through them take far
+// fewer TLB misses:
+//  - transparent: anonymous memory with madvise(MADV_HUGEPAGE), which the kernel backs by 2 MB pages when it can.
+//  - hugetlb: pages of the hugetlbfs pool the administrator reserved (vm.nr_hugepages), 1 GB pages for blocks that are a
+//    multiple of 1 GB; once the pool cannot serve a request, transparent huge pages are used instead.
+// Freed blocks are cached by size class and handed out again, so that a matrix that is resized back and forth does not
+// map and unmap memory every time. Idle blocks beyond GetMaxCachedBytes() are unmapped, largest first.
+//
+// Only Linux is supported. Elsewhere, and for requests below the threshold, Alloc() returns nullptr and the caller
+// allocates from the heap; Free() tells whether a buffer came from here.
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+class MATH_API CPUHugePageAllocator
+{
+public:
+    enum class Mode
+    {
+        none,
+        transparent,
+        hugetlb,
+    };
+
+    struct Statistics
+    {
+        size_t numAllocations = 0;        // blocks mapped
+        size_t numHugeTlbAllocations = 0; // of those, blocks from the hugetlbfs pool
+        size_t numReuses = 0;             // requests served from the cache
+        size_t numReleases = 0;           // blocks unmapped
+        size_t bytesInUse = 0;
+        size_t bytesCached = 0;
+    };
+
+    static void SetMode(Mode mode);
+    static Mode GetMode();
+    // the mode selected by the hugePages and hugeTlbPages options
+    static Mode ModeFromConfig(bool hugePages, bool hugeTlbPages)
+    {
+        return hugeTlbPages ? Mode::hugetlb : hugePages ? Mode::transparent : Mode::none;
+    }
+
+    // smallest request that is served from huge pages, 2 MB by default
+    static void SetMinBytes(size_t bytes);
+    static size_t GetMinBytes();
+
+    // limit of the idle bytes that are kept for reuse, 1 GB by default
+    static void SetMaxCachedBytes(size_t bytes);
+    static size_t GetMaxCachedBytes();
+
+    static const size_t s_pageSize = 2 * 1024 * 1024;
+
+    // the size that is mapped for a request of 'size' bytes: a multiple of s_pageSize, a quarter of a power of two apart
+    static size_t SizeClass(size_t size);
+
+    // A block of at least 'size' bytes, zeroed if 'zero' (by all OpenMP threads in NUMA mode, see CPUNuma.h).
+    // nullptr if huge pages are off, the request is below the threshold, or the memory could not be mapped.
+    static void* Alloc(size_t size, bool zero = true);
+    // Returns the block to the cache. Returns false if 'p' was not allocated here, then the caller frees it itself.
+    static bool Free(void* p);
+
+    // unmaps all idle blocks
+    static void Trim();
+
+    static Statistics GetStatistics();
+};
+
+}}}
@@ -28,6 +28,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 double logadd(double x, double y);
 
+template <class ElemType>
+class CPURNNExecutor;
+
 // To comply with BLAS libraries matrices are stored in ColMajor. However, by default C/C++/C# use RowMajor
 // conversion is need when passing data between CPUMatrix and C++ matrices
 template <class ElemType>
@@ -109,6 +112,10 @@ public:
 
     void AdaDelta(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learningRate, ElemType rho, ElemType epsilon);
 
+    static void MultiTensorUpdate(MultiTensorUpdateType type, const std::vector<MultiTensorItem<ElemType>>& items,
+                                  ElemType momentum, ElemType varMomentum, bool unitGainMomentum);
+    static void MultiTensorSumOfSquares(const std::vector<MultiTensorItem<ElemType>>& items, std::vector<double>& sumsOfSquares);
+
     void Reshape(const size_t numRows, const size_t numCols);
 
 
@@ -146,6 +153,8 @@ public:
     void SetValue(const size_t numRows, const size_t numCols, ElemType* pArray, size_t matrixFlags = matrixFlagNormal);
 
     void MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val, size_t numColsPerMaskEntry);
+    void AssignNormalizedBytesOf(const CPUMatrix<char>& bytes, ElemType mean, ElemType scale);
+    void AssignAugmentedImagesOf(const CPUMatrix<char>& bytes, const ImageAugmentation& augmentation, uint64_t firstImage);
 
     void SetColumn(const ElemType* colPointer, size_t colInd);
     void SetColumn(const CPUMatrix<ElemType>& valMat, size_t colInd);
@@ -156,6 +165,7 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    void CounterBasedDropout(const CPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset, const ElemType beta);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
 
     CPUMatrix<ElemType> Transpose();
@@ -163,6 +173,9 @@ public:
 
     CPUMatrix<ElemType>& DoGatherColumnsOf (ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
     CPUMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
+    CPUMatrix<ElemType>& DoGatherRowsOf   (ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
+    CPUMatrix<ElemType>& AssignPackedIndicesOf(const CPUMatrix<ElemType>* timeIndices, size_t numParallelSequences, size_t numTimeSteps,
+                                               const std::vector<PackedSequenceRange>& sequences, size_t targetStride);
 
     CPUMatrix<ElemType>& operator+=(const ElemType alpha);
     CPUMatrix<ElemType>  operator+(const ElemType alpha) const;
@@ -226,6 +239,16 @@ public:
     CPUMatrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     CPUMatrix<ElemType>& AssignLogSoftmaxOf(const CPUMatrix<ElemType>& a, const bool isColWise);
 
+    // fused column-wise softmax + cross entropy, see CrossEntropyWithSoftmaxNode
+    // [this] (1x1) = -sum_j labels(:,j)' * logSoftmax(input(:,j)), and logSumExp (1 x T) gets log(sum_i exp(input(i,j))) per column
+    CPUMatrix<ElemType>& AssignSoftmaxCrossEntropyOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& input, CPUMatrix<ElemType>& logSumExp);
+    // inputGradient += gradient * (softmax(input) - labels), gradient being 1x1 and softmax recomputed from logSumExp
+    static void AddSoftmaxCrossEntropyGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& input,
+                                               const CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& inputGradient);
+    // labelsGradient -= gradient * logSoftmax(input)
+    static void AddSoftmaxCrossEntropyLabelGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& input,
+                                                    const CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& labelsGradient);
+
     CPUMatrix<ElemType>& InplaceHardmax(const bool isColWise);
     CPUMatrix<ElemType>& AssignHardmaxOf(const CPUMatrix<ElemType>& a, const bool isColWise);
 
@@ -322,6 +345,7 @@ public:
 
     void VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<ElemType>& maxValues, const bool isColWise, int topK = 1) const;
     void VectorMin(CPUMatrix<ElemType>& minIndexes, CPUMatrix<ElemType>& minValues, const bool isColWise) const;
+    void TopK(CPUMatrix<ElemType>& topKValues, CPUMatrix<ElemType>& topKIndices, size_t k) const;
 
     CPUMatrix<ElemType>& AssignNumOfDiff(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, bool searchInCol = false);
 
@@ -367,6 +391,10 @@ public:
     void ConvolutionBackwardKernel(const CPUMatrix<ElemType>& in, const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIwht,
                                    const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& kernelGrad) const;
 
+    void DepthwiseConvolutionForward(const CPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, CPUMatrix<ElemType>& output) const;
+    void DepthwiseConvolutionBackwardData(const CPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, CPUMatrix<ElemType>& grad) const;
+    void DepthwiseConvolutionBackwardKernel(const CPUMatrix<ElemType>& in, const DepthwiseConvolutionShape& shape, CPUMatrix<ElemType>& kernelGrad) const;
+
     void UnrollConvolutionInput(size_t unrollCols, size_t mapOutSize, const CPUMatrix<int>& mpRowCol,
                                 const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output) const;
     void UnrollConvolutionOutput(size_t unrollCols, size_t mapInCount, size_t mapOutCount, const CPUMatrix<int>& mpRowCol,
@@ -378,6 +406,8 @@ public:
     void MaxPoolingBackward(const CPUMatrix<ElemType>& out, const CPUMatrix<ElemType>& in,
                             const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIndices, const CPUMatrix<int>& indices,
                             CPUMatrix<ElemType>& grad) const;
+    void MaxPoolingForwardWithArgmax(const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIndices, const CPUMatrix<int>& indices, CPUMatrix<ElemType>& output, CPUMatrix<short>& argmax) const;
+    void MaxPoolingBackwardWithArgmax(const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIndices, const CPUMatrix<int>& indices, const CPUMatrix<short>& argmax, CPUMatrix<ElemType>& grad) const;
 
     void ROIPoolingForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
                            const size_t pooledWidth, const size_t pooledHeight, const CPUMatrix<ElemType>& roiData, CPUMatrix<ElemType>& output, CPUMatrix<ElemType>& argmax) const;
@@ -396,6 +426,9 @@ public:
     void BatchNormalizationBackward(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, double blendFactor, const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
                                     CPUMatrix<ElemType>& scaleGrad, CPUMatrix<ElemType>& biasGrad) const;
 
+    // RNN support functions, forward only, see CPURNNExecutor
+    void RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const struct RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& workspace);
+
 public:
     // This functions do not depend on <ElemType>, i.e. you can call them on any <ElemType>
     static int SetNumThreads(int numThreads);
@@ -411,6 +444,8 @@ public:
     static void Multiply(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType beta, CPUMatrix<ElemType>& c);
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c,
+                                            size_t batchSize, bool broadcastA, bool broadcastB);
 
     static void ColumnwiseScaleAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& v, ElemType beta, CPUMatrix<ElemType>& c);
 
@@ -457,6 +492,10 @@ public:
                      const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                      const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
 
+    void TensorProgramOp(ElemType beta, const std::array<const CPUMatrix<ElemType>*, ElementwiseProgram::MaxInputs>& inputs, ElemType alpha, const ElementwiseProgram& program,
+                         const std::array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                         const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides);
+
     static CPUMatrix<ElemType> Ones(const size_t rows, const size_t cols);
     static CPUMatrix<ElemType> Zeros(const size_t rows, const size_t cols);
     static CPUMatrix<ElemType> Eye(const size_t rows);
@@ -487,8 +526,7 @@ public:
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        stream.ReadArray(d_array, numRows * numCols);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
 
@@ -505,8 +543,7 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.Data()[i];
+        stream.WriteArray(us.Data(), us.GetNumElements());
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
@@ -538,12 +575,20 @@ public:
                                      const size_t tPos // position
                                      );
 
+    // for LambdaRank and NDCG, see Matrix.h
+    static void RankWithinGroups(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& groupStarts, size_t truncation,
+                                 CPUMatrix<ElemType>& ranks, CPUMatrix<ElemType>& dcgs, CPUMatrix<ElemType>& idealDCGs);
+    static void AddLambdaRankGradient(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& ranks, const CPUMatrix<ElemType>& groupStarts,
+                                      const CPUMatrix<ElemType>& idealDCGs, ElemType sigma, size_t truncation, CPUMatrix<ElemType>& gradient);
+
 protected:
     size_t LocateElement(const size_t i, const size_t j) const;
     size_t LocateColumn(const size_t j) const;
 
 private:
     void Clear();
+
+    mutable std::shared_ptr<CPURNNExecutor<ElemType>> m_rnnExecutor; // for OptimizedRNNStack
 };
 
 typedef CPUMatrix<float> CPUSingleMatrix;
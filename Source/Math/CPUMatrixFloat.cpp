@@ -19,6 +19,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return (m_traceLevel > 0);
     }
 
+    bool MATH_API TracingGPUMemoryAllocator::m_cachingEnabled = true;
+
+    void TracingGPUMemoryAllocator::SetCachingEnabled(bool enabled)
+    {
+        m_cachingEnabled = enabled;
+    }
+
+    bool TracingGPUMemoryAllocator::IsCachingEnabled()
+    {
+        return m_cachingEnabled;
+    }
+
     // explicit instantiations, due to CPUMatrix being too big and causing VS2015 cl crash.
     template class MATH_API CPUMatrix<float>;
 }}}
\ No newline at end of file
@@ -12,6 +12,14 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include "CPUVectorizedTensorOps.h"
+#include "CPURNNExecutor.h"
+#include "CPUBlas.h"
+#include "CPUNuma.h"
+#include "CPUHugePageAllocator.h"
+#include "Philox.h"
+#include "ImageAugmentation.h"
+#include "ThreadPool.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -20,8 +28,10 @@
 #include <chrono>
 #include <exception>
 #include <thread>
+#include <atomic>
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 #pragma warning(push)
 #pragma warning(disable:4244) // 'conversion' conversion from 'type1' to 'type2', possible loss of data
 #include <boost/random/normal_distribution.hpp>
@@ -106,9 +116,16 @@ CPUMatrix<ElemType>::CPUMatrix()
 
 // helper to allocate an array of ElemType
 // Use this instead of new[] to get NaN initialization for debugging.
+// In NUMA mode, large arrays are zeroed by all OpenMP threads, which places their pages near the threads that use them.
 template <class ElemType>
 static ElemType* NewArray(size_t n)
 {
+    if (CPUNuma::IsNumaModeEnabled() && n * sizeof(ElemType) >= CPUNuma::s_firstTouchMinBytes)
+    {
+        ElemType* p = new ElemType[n]; // not value-initialized, so no page has been touched yet
+        CPUNuma::FirstTouchZero(p, n * sizeof(ElemType));
+        return p;
+    }
     ElemType* p = new ElemType[n]();
 #if 0 // _DEBUG
         ElemType nan = Matrix<ElemType>::MakeNan(__LINE__);
@@ -118,6 +135,22 @@ static ElemType* NewArray(size_t n)
     return p;
 }
 
+// helper to allocate the buffer of a matrix
+// Large buffers come from huge pages if they are enabled (see CPUHugePageAllocator.h), so they have to be freed with DeleteBuffer().
+template <class ElemType>
+static ElemType* NewBuffer(size_t n)
+{
+    void* p = CPUHugePageAllocator::Alloc(n * sizeof(ElemType));
+    return p ? (ElemType*) p : NewArray<ElemType>(n);
+}
+
+template <class ElemType>
+static void DeleteBuffer(ElemType* p)
+{
+    if (!CPUHugePageAllocator::Free(p))
+        delete[] p;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>::CPUMatrix(const size_t numRows, const size_t numCols)
 {
@@ -129,7 +162,7 @@ CPUMatrix<ElemType>::CPUMatrix(const size_t numRows, const size_t numCols)
 
     if (GetNumElements() != 0)
     {
-        SetBuffer(NewArray<ElemType>(GetNumElements()), GetNumElements() * sizeof(ElemType));
+        SetBuffer(NewBuffer<ElemType>(GetNumElements()), GetNumElements() * sizeof(ElemType));
     }
 }
 
@@ -692,6 +725,76 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     return *this;
 }
 
+// *this[i,:] = a[idx[i],:] * alpha + *this[i,:] * beta
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoGatherRowsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumRows() != 1 && idx.GetNumCols() != 1) // index is 1-dimensional only
+        InvalidArgument("DoGatherRowsOf: Map must be a vector.");
+
+    if (beta)
+        VerifySize(idx.GetNumElements(), a.GetNumCols());
+    else
+        Resize(idx.GetNumElements(), a.GetNumCols());
+
+    auto& us = *this;
+    const ElemType* pIdx = idx.Data();
+    // race-condition consideration: each output element is written once
+#pragma omp parallel for
+    foreach_column(j, us)
+    {
+        for (size_t iOut = 0; iOut < us.GetNumRows(); iOut++)
+        {
+            auto iInF = pIdx[iOut];
+            if (std::isnan(iInF) || iInF < 0) // negative index means gap
+                continue;
+            size_t iIn = (size_t)iInF;
+            if (iIn >= a.GetNumRows())
+                InvalidArgument("DoGatherRowsOf: Map out of bounds. %ld >= %ld", (long int)iIn, (long int)a.GetNumRows());
+            ElemType res = a(iIn, j) * alpha;
+            if (beta != 0)
+                res += us(iOut, j) * beta;
+            us(iOut, j) = res;
+        }
+    }
+
+    return *this;
+}
+
+// *this[0,j] = sequence.targetColumn + timeIndex * targetStride, see Matrix::AssignPackedIndicesOf()
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignPackedIndicesOf(const CPUMatrix<ElemType>* timeIndices, size_t numParallelSequences, size_t numTimeSteps,
+                                                                const std::vector<PackedSequenceRange>& sequences, size_t targetStride)
+{
+    const size_t numCols = numParallelSequences * numTimeSteps;
+    if (timeIndices && (timeIndices->GetNumRows() != 1 || timeIndices->GetNumCols() != numCols))
+        InvalidArgument("AssignPackedIndicesOf: The time indices must be a row vector with one entry per column of the layout.");
+
+    RequireSize(1, numCols);
+    auto* us = Data();
+    std::fill(us, us + numCols, (ElemType)-1); // gaps
+    for (const auto& seq : sequences)
+    {
+        for (ptrdiff_t t = max<ptrdiff_t>(seq.tBegin, 0); t < min<ptrdiff_t>(seq.tEnd, numTimeSteps); t++)
+        {
+            const size_t j = t * numParallelSequences + seq.s;
+            ptrdiff_t timeIndex = t - seq.tBegin;
+            if (timeIndices)
+            {
+                auto timeIndexF = timeIndices->Data()[j];
+                if (std::isnan(timeIndexF) || timeIndexF < 0 || timeIndexF >= seq.targetLength)
+                    InvalidArgument("AssignPackedIndicesOf: Time index %f out of bounds [0, %d).", (double)timeIndexF, seq.targetLength);
+                timeIndex = (ptrdiff_t)timeIndexF;
+            }
+            else if (timeIndex >= seq.targetLength)
+                InvalidArgument("AssignPackedIndicesOf: Time step %d out of bounds [0, %d).", (int)timeIndex, seq.targetLength);
+            us[j] = (ElemType)(seq.targetColumn + timeIndex * (ptrdiff_t)targetStride);
+        }
+    }
+
+    return *this;
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::SetValue(const ElemType v)
 {
@@ -727,6 +830,65 @@ void CPUMatrix<ElemType>::SetValue(const ElemType v)
     }
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignNormalizedBytesOf(const CPUMatrix<char>& bytes, ElemType mean, ElemType scale)
+{
+    RequireSize(bytes.GetNumRows(), bytes.GetNumCols());
+
+    auto src = reinterpret_cast<const unsigned char*>(bytes.Data());
+    ElemType* dst = Data();
+    long n = (long) GetNumElements();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+        dst[i] = (src[i] - mean) * scale;
+}
+
+// the same computation as the GPU kernel, one image per thread
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignAugmentedImagesOf(const CPUMatrix<char>& bytes, const ImageAugmentation& augmentation, uint64_t firstImage)
+{
+    const ImageAugmentation& a = augmentation;
+    const size_t outSize = (size_t) a.outW * a.outH * a.channels;
+    RequireSize(outSize, bytes.GetNumCols());
+
+    const long n = (long) bytes.GetNumCols();
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const auto image = reinterpret_cast<const unsigned char*>(bytes.Data()) + j * bytes.GetNumRows();
+        ElemType* out = Data() + j * outSize;
+        const ImageAugmentationSample s = DrawImageAugmentationSample(a, firstImage + j);
+        float v[ImageAugmentation::MaxChannels];
+
+        float imageMean = 0;
+        if (a.brightnessRadius > 0)
+        {
+            double sum = 0;
+            for (int y = 0; y < a.outH; y++)
+            {
+                for (int x = 0; x < a.outW; x++)
+                {
+                    SampleAugmentedPixel(a, s, image, x, y, v);
+                    for (int c = 0; c < a.channels; c++)
+                        sum += v[c];
+                }
+            }
+            imageMean = (float) (sum / outSize);
+        }
+
+        for (int y = 0; y < a.outH; y++)
+        {
+            for (int x = 0; x < a.outW; x++)
+            {
+                SampleAugmentedPixel(a, s, image, x, y, v);
+                JitterAndNormalizePixel(a, s, imageMean, v);
+                for (int c = 0; c < a.channels; c++)
+                    out[ImageElementOffset(a, a.outW, a.outH, x, y, c)] = (ElemType) v[c];
+            }
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val, size_t numColsPerMaskEntry)
 {
@@ -879,11 +1041,12 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
         // free previous array allocation if any before overwriting
-        delete[] Buffer();
+        if (OwnBuffer())
+            DeleteBuffer(Buffer());
 
         m_numRows = numRows;
         m_numCols = numCols;
-        SetBuffer(pArray, GetNumElements() * sizeof(ElemType), true);
+        SetBuffer(pArray, GetNumElements() * sizeof(ElemType), true, (matrixFlags & matrixFlagMovableBuffer) != 0);
         SetSizeAllocated(GetNumElements());
     }
     else
@@ -903,7 +1066,7 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
 #pragma omp parallel for
                     foreach_column (j, us)
                     {
-                        cblas_dcopy((int) numRows, reinterpret_cast<double*>(pArray + j), (int) numCols, reinterpret_cast<double*>(bufPtr + LocateColumn(j)), 1);
+                        CPUBlas::Copy((int) numRows, reinterpret_cast<double*>(pArray + j), (int) numCols, reinterpret_cast<double*>(bufPtr + LocateColumn(j)), 1);
                     }
                 }
                 else
@@ -913,7 +1076,7 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
                     {
                         {
 #pragma warning(suppress : 4244)
-                            cblas_scopy((int) numRows, reinterpret_cast<float*>(pArray + j), (int) numCols, reinterpret_cast<float*>(bufPtr + LocateColumn(j)), 1);
+                            CPUBlas::Copy((int) numRows, reinterpret_cast<float*>(pArray + j), (int) numCols, reinterpret_cast<float*>(bufPtr + LocateColumn(j)), 1);
                         }
                     }
                 }
@@ -1125,6 +1288,31 @@ void CPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     }
 }
 
+// this = beta * this + a .* mask, where element k (column-major) of the mask is PhiloxDropoutMask(seed, offset + k),
+// i.e. the mask is a pure function of (seed, offset) and never stored; beta == 0 overwrites this (NaNs included)
+template <class ElemType>
+void CPUMatrix<ElemType>::CounterBasedDropout(const CPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset, const ElemType beta)
+{
+    if (a.IsEmpty())
+        LogicError("CounterBasedDropout: Matrix is empty.");
+    if (beta == 0)
+        RequireSize(a.GetNumRows(), a.GetNumCols());
+    else if (GetNumRows() != a.GetNumRows() || GetNumCols() != a.GetNumCols())
+        InvalidArgument("CounterBasedDropout: The input matrix dimensions do not match.");
+
+    auto& us = *this;
+    long m = (long) GetNumRows(), n = (long) GetNumCols();
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        for (long i = 0; i < m; i++)
+        {
+            const ElemType v = a(i, j) * PhiloxDropoutMask(seed, offset + (uint64_t) j * m + i, maskRate, scaleValue);
+            us(i, j) = beta == 0 ? v : beta * us(i, j) + v;
+        }
+    }
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1411,6 +1599,72 @@ void CPUMatrix<ElemType>::AdaDelta(CPUMatrix<ElemType>& gradients, CPUMatrix<Ele
     }
 }
 
+// The same updates as Adam(), MomentumSGDUpdate() etc., of each parameter after the gradient preprocessing of the learners.
+// The parameters are updated one after the other, each by all threads.
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::MultiTensorUpdate(MultiTensorUpdateType type, const std::vector<MultiTensorItem<ElemType>>& items,
+                                                      ElemType momentum, ElemType varMomentum, bool unitGainMomentum)
+{
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+    for (const auto& item : items)
+    {
+        const long n = (long) item.numElements;
+        ElemType* val = item.value;
+        ElemType* grad = item.gradient;
+        ElemType* smoothed = item.smoothedGradient;
+        const ElemType gradientScale = item.gradientScale;
+        const ElemType l2Weight = item.l2Weight;
+        const ElemType lr = item.learnRatePerSample;
+        const ElemType adaMul = item.adaMul;
+#pragma omp parallel for
+        for (long i = 0; i < n; i++)
+        {
+            ElemType g = gradientScale * grad[i] + l2Weight * val[i];
+            grad[i] = g;
+            switch (type)
+            {
+            case MultiTensorUpdateType::SGD:
+                val[i] -= lr * g;
+                break;
+            case MultiTensorUpdateType::MomentumSGD:
+                smoothed[i] = momentum * smoothed[i] + unitGainFactor * lr * g;
+                val[i] -= smoothed[i];
+                break;
+            case MultiTensorUpdateType::NesterovMomentumSGD:
+                smoothed[i] = momentum * smoothed[i] + unitGainFactor * lr * g;
+                val[i] -= momentum * smoothed[i] + unitGainFactor * lr * g;
+                break;
+            case MultiTensorUpdateType::Adam: // smoothed squares followed by the momentum
+            {
+                ElemType adaSqr = varMomentum * smoothed[i] + (1.0f - varMomentum) * g * g;
+                smoothed[i] = adaSqr;
+                ElemType w = adaMul * (ElemType)(1.0 / (sqrt(adaSqr) + 1e-8));
+                g = momentum * smoothed[n + i] + unitGainFactor * g;
+                smoothed[n + i] = g;
+                val[i] -= g * w * lr;
+                break;
+            }
+            }
+        }
+    }
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::MultiTensorSumOfSquares(const std::vector<MultiTensorItem<ElemType>>& items, std::vector<double>& sumsOfSquares)
+{
+    sumsOfSquares.assign(items.size(), 0);
+    for (size_t k = 0; k < items.size(); k++)
+    {
+        const long n = (long) items[k].numElements;
+        const ElemType* grad = items[k].gradient;
+        double sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+        for (long i = 0; i < n; i++)
+            sum += (double) grad[i] * grad[i];
+        sumsOfSquares[k] = sum;
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1433,7 +1687,8 @@ void CPUMatrix<ElemType>::RequireSize(const size_t numRows, const size_t numCols
 // This function is cheap if the matrix size does not change.
 // Current content is not preserved.
 // If growOnly is true, resize will not reallocate memory if the current memory is large enough (i.e., will not shrink).
-// If this object does not own its memory then new memory cannot be allocated (one can still shrink and/or reshape).
+// If this object does not own its memory then new memory cannot be allocated (one can still shrink and/or reshape),
+// unless the buffer is movable (matrixFlagMovableBuffer), in which case the matrix gets a buffer of its own when it grows.
 template <class ElemType>
 void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, bool growOnly /*=true*/)
 {
@@ -1443,17 +1698,18 @@ void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
     VerifyResizable(__func__);
 
     size_t numElements = numRows * numCols;
-    if (numElements > GetSizeAllocated() ||                 // grow allocation
-        (!growOnly && (numElements != GetSizeAllocated()))) // shrink allocation (not if 'growOnly')
+    if (numElements > GetSizeAllocated() ||                                         // grow allocation
+        (!growOnly && !HasExternalBuffer() && (numElements != GetSizeAllocated()))) // shrink allocation (not if 'growOnly')
     {
         // reallocate buffer
         ElemType* pArray = nullptr;
         if (numElements > 0)
         {
-            pArray = NewArray<ElemType>(numElements);
+            pArray = NewBuffer<ElemType>(numElements);
         }
         // success: update the object
-        delete[] Buffer();
+        if (!HasExternalBuffer())
+            DeleteBuffer(Buffer());
 
         SetBuffer(pArray, numElements * sizeof(ElemType));
         SetSizeAllocated(numElements);
@@ -2347,6 +2603,121 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
     return *this;
 }
 
+// single-column kernels of the fused softmax + cross entropy; the float versions are vectorized (see CPUVectorizedTensorOps.h)
+template <class ElemType>
+static void SoftmaxCrossEntropyOfColumn(const ElemType* x, const ElemType* y, size_t n, ElemType& logSumExp, double& crossEntropy)
+{
+    ElemType maxV = x[0];
+    double labelSum = 0, labelDot = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        maxV = std::max(maxV, x[i]);
+        labelSum += y[i];
+        if (y[i] != 0) // gap columns have zero labels and may contain NaNs
+            labelDot += (double) y[i] * x[i];
+    }
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += exp((double) x[i] - maxV);
+    const double lse = maxV + log(sum);
+    logSumExp = (ElemType) lse;
+    crossEntropy = (labelSum != 0 ? labelSum * lse : 0) - labelDot;
+}
+
+static inline void SoftmaxCrossEntropyOfColumn(const float* x, const float* y, size_t n, float& logSumExp, double& crossEntropy)
+{
+    if (!CPUVectorizedTensorOps::SoftmaxCrossEntropy(x, y, n, logSumExp, crossEntropy))
+        SoftmaxCrossEntropyOfColumn<float>(x, y, n, logSumExp, crossEntropy);
+}
+
+template <class ElemType>
+static void SoftmaxCrossEntropyGradientOfColumn(ElemType alpha, const ElemType* x, const ElemType* y, ElemType logSumExp, ElemType* g, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        g[i] += alpha * (exp(x[i] - logSumExp) - y[i]);
+}
+
+static inline void SoftmaxCrossEntropyGradientOfColumn(float alpha, const float* x, const float* y, float logSumExp, float* g, size_t n)
+{
+    if (!CPUVectorizedTensorOps::SoftmaxCrossEntropyGradient(alpha, x, y, logSumExp, g, n))
+        SoftmaxCrossEntropyGradientOfColumn<float>(alpha, x, y, logSumExp, g, n);
+}
+
+// The softmax and log softmax are never stored: the forward pass keeps one value per column, and the
+// gradients recompute the softmax from it. Each of them is a single read over the inputs.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSoftmaxCrossEntropyOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& input, CPUMatrix<ElemType>& logSumExp)
+{
+    if (input.IsEmpty())
+        LogicError("AssignSoftmaxCrossEntropyOf: Matrix input is empty.");
+    if (labels.GetNumRows() != input.GetNumRows() || labels.GetNumCols() != input.GetNumCols())
+        InvalidArgument("AssignSoftmaxCrossEntropyOf: labels and input must have the same dimensions.");
+
+    const size_t m = input.GetNumRows();
+    const long n = (long) input.GetNumCols();
+    logSumExp.RequireSize(1, n);
+    const ElemType* px = input.Data();
+    const ElemType* py = labels.Data();
+    ElemType* pLogSumExp = logSumExp.Data();
+
+    double crossEntropy = 0;
+#pragma omp parallel for reduction(+ : crossEntropy)
+    for (long j = 0; j < n; j++)
+    {
+        double columnCrossEntropy;
+        SoftmaxCrossEntropyOfColumn(px + j * m, py + j * m, m, pLogSumExp[j], columnCrossEntropy);
+        crossEntropy += columnCrossEntropy;
+    }
+
+    RequireSize(1, 1);
+    Data()[0] = (ElemType) crossEntropy;
+    return *this;
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& input,
+                                                         const CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& inputGradient)
+{
+    if (gradient.GetNumElements() != 1)
+        InvalidArgument("AddSoftmaxCrossEntropyGradient: gradient must be a 1x1 matrix.");
+    if (labels.GetNumRows() != input.GetNumRows() || labels.GetNumCols() != input.GetNumCols() ||
+        inputGradient.GetNumRows() != input.GetNumRows() || inputGradient.GetNumCols() != input.GetNumCols() ||
+        logSumExp.GetNumElements() != input.GetNumCols())
+        InvalidArgument("AddSoftmaxCrossEntropyGradient: The dimensions of the matrices do not match.");
+
+    const ElemType alpha = gradient.Data()[0];
+    const size_t m = input.GetNumRows();
+    const long n = (long) input.GetNumCols();
+    const ElemType* px = input.Data();
+    const ElemType* py = labels.Data();
+    const ElemType* pLogSumExp = logSumExp.Data();
+    ElemType* pg = inputGradient.Data();
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+        SoftmaxCrossEntropyGradientOfColumn(alpha, px + j * m, py + j * m, pLogSumExp[j], pg + j * m, m);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::AddSoftmaxCrossEntropyLabelGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& input,
+                                                              const CPUMatrix<ElemType>& logSumExp, CPUMatrix<ElemType>& labelsGradient)
+{
+    if (gradient.GetNumElements() != 1)
+        InvalidArgument("AddSoftmaxCrossEntropyLabelGradient: gradient must be a 1x1 matrix.");
+    if (labelsGradient.GetNumRows() != input.GetNumRows() || labelsGradient.GetNumCols() != input.GetNumCols() ||
+        logSumExp.GetNumElements() != input.GetNumCols())
+        InvalidArgument("AddSoftmaxCrossEntropyLabelGradient: The dimensions of the matrices do not match.");
+
+    const ElemType alpha = gradient.Data()[0];
+    auto& us = labelsGradient;
+#pragma omp parallel for
+    foreach_column (j, input)
+    {
+        const ElemType lse = logSumExp.Data()[j];
+        foreach_row (i, input)
+            us(i, j) -= alpha * (input(i, j) - lse);
+    }
+}
+
 //[this]=hardmax([this])
 //the max element is 1 else is 0
 template <class ElemType>
@@ -2887,12 +3258,12 @@ ElemType CPUMatrix<ElemType>::SumOfAbsElements() const
 
     if (sizeof(ElemType) == sizeof(double))
     {
-        return (ElemType) cblas_dasum((int) GetNumElements(), reinterpret_cast<double*>(Data()), 1);
+        return (ElemType) CPUBlas::Asum((int) GetNumElements(), reinterpret_cast<double*>(Data()), 1);
     }
     else
     {
 #pragma warning(suppress : 4244)
-        return cblas_sasum((int) GetNumElements(), reinterpret_cast<float*>(Data()), 1);
+        return CPUBlas::Asum((int) GetNumElements(), reinterpret_cast<float*>(Data()), 1);
     }
 }
 
@@ -3100,7 +3471,7 @@ void CPUMatrix<ElemType>::VectorNorm2(CPUMatrix<ElemType>& c, const bool isColWi
 #pragma omp parallel for
             foreach_column (j, c)
             {
-                c(0, j) = (ElemType) cblas_dnrm2(m, reinterpret_cast<double*>(bufPtr + us.LocateColumn(j)), 1);
+                c(0, j) = (ElemType) CPUBlas::Nrm2(m, reinterpret_cast<double*>(bufPtr + us.LocateColumn(j)), 1);
             }
         }
         else
@@ -3109,7 +3480,7 @@ void CPUMatrix<ElemType>::VectorNorm2(CPUMatrix<ElemType>& c, const bool isColWi
             foreach_column (j, c)
             {
 #pragma warning(suppress : 4244)
-                c(0, j) = cblas_snrm2(m, reinterpret_cast<float*>(bufPtr + us.LocateColumn(j)), 1);
+                c(0, j) = CPUBlas::Nrm2(m, reinterpret_cast<float*>(bufPtr + us.LocateColumn(j)), 1);
             }
         }
     }
@@ -3122,7 +3493,7 @@ void CPUMatrix<ElemType>::VectorNorm2(CPUMatrix<ElemType>& c, const bool isColWi
 #pragma omp parallel for
             foreach_row (i, c)
             {
-                c(i, 0) = cblas_dnrm2(n, reinterpret_cast<double*>(bufPtr + i), m);
+                c(i, 0) = CPUBlas::Nrm2(n, reinterpret_cast<double*>(bufPtr + i), m);
             }
         }
         else
@@ -3131,7 +3502,7 @@ void CPUMatrix<ElemType>::VectorNorm2(CPUMatrix<ElemType>& c, const bool isColWi
             foreach_row (i, c)
             {
 #pragma warning(suppress : 4244)
-                c(i, 0) = cblas_snrm2(n, reinterpret_cast<float*>(bufPtr + i), m);
+                c(i, 0) = CPUBlas::Nrm2(n, reinterpret_cast<float*>(bufPtr + i), m);
             }
         }
     }
@@ -3512,34 +3883,7 @@ void CPUMatrix<ElemType>::VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<E
             }
         }
         else
-        {
-            std::vector<int> indices(m);
-            int i = 0;
-            std::generate(indices.begin(), indices.end(), [&i]
-                          {
-                              return i++;
-                          });
-
-            const ElemType* curVal =            Data();
-            ElemType* curIdx       = maxIndexes.Data();
-            ElemType* curMax       =  maxValues.Data();
-            for (int icol = 0; icol < n; icol++, curVal += m, curIdx += topK, curMax += topK)
-            {
-                // Partial sort, descending order.
-                std::nth_element(indices.begin(), indices.begin() + topK, indices.end(),
-                                 [curVal](const int& a, const int& b)
-                                 {
-                                     return curVal[a] > curVal[b];
-                                 });
-                // REVIEW alexeyk: the following produces warning (see SCL_SECURE_NO_WARNINGS) so use loop instead.
-                // std::transform(indices.begin(), indices.begin() + topK, curIdx, [](const int& a) { return static_cast<ElemType>(a); });
-                for (int i2 = 0; i2 < topK; i2++)
-                {
-                    curIdx[i2] = static_cast<ElemType>(indices[i2]);
-                    curMax[i2] = curVal[indices[i2]];
-                }
-            }
-        }
+            TopK(maxValues, maxIndexes, topK);
     }
     else
     {
@@ -3568,6 +3912,42 @@ void CPUMatrix<ElemType>::VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<E
     }
 }
 
+// the largest k values of each column, sorted descending (equal values by row index), and their row indices
+template <class ElemType>
+void CPUMatrix<ElemType>::TopK(CPUMatrix<ElemType>& topKValues, CPUMatrix<ElemType>& topKIndices, size_t k) const
+{
+    if (IsEmpty())
+        LogicError("TopK: Matrix is empty.");
+    if (k == 0 || k > GetNumRows())
+        InvalidArgument("TopK: k must be between 1 and the number of rows.");
+
+    const long m = (long) GetNumRows();
+    const long n = (long) GetNumCols();
+    topKValues.RequireSize(k, n);
+    topKIndices.RequireSize(k, n);
+
+#pragma omp parallel
+    {
+        std::vector<long> indices(m);
+#pragma omp for
+        for (long j = 0; j < n; j++)
+        {
+            const ElemType* values = Data() + j * m;
+            for (long i = 0; i < m; i++)
+                indices[i] = i;
+            std::partial_sort(indices.begin(), indices.begin() + k, indices.end(), [values](long a, long b)
+                              {
+                                  return values[a] > values[b] || (values[a] == values[b] && a < b);
+                              });
+            for (size_t i = 0; i < k; i++)
+            {
+                topKValues(i, j) = values[indices[i]];
+                topKIndices(i, j) = (ElemType) indices[i];
+            }
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::VectorMin(CPUMatrix<ElemType>& minIndexes, CPUMatrix<ElemType>& minValues, const bool isColWise) const
 {
@@ -4212,6 +4592,157 @@ void CPUMatrix<ElemType>::ConvolutionBackwardKernel(const CPUMatrix<ElemType>& i
     }
 }
 
+// Clips the kernel window [start, start + kernelSize) of an output to the input [0, size),
+// returning the range of kernel positions that fall inside.
+static inline void ClipDepthwiseConvolutionWindow(int start, int kernelSize, int size, int& kBegin, int& kEnd)
+{
+    kBegin = std::max(0, -start);
+    kEnd = std::min(kernelSize, size - start);
+}
+
+// Unlike the map-based convolution above, the depthwise convolution runs directly on the shape (see DepthwiseConvolutionShape),
+// with one task per sample and output channel: each task reads C / groups input channels and one kernel, and writes one output plane.
+template <class ElemType>
+void CPUMatrix<ElemType>::DepthwiseConvolutionForward(const CPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, CPUMatrix<ElemType>& output) const
+{
+    const int groupSize = shape.inC / shape.groups;
+    const int outC = shape.groups * shape.multiplier;
+    const size_t inPlane = (size_t)shape.inW * shape.inH;
+    const size_t outPlane = (size_t)shape.outW * shape.outH;
+    const size_t kernelSize = (size_t)shape.kernelW * shape.kernelH * groupSize;
+
+#pragma omp parallel for
+    for (int64_t task = 0; task < (int64_t)GetNumCols() * outC; task++)
+    {
+        const size_t sample = (size_t)(task / outC);
+        const int k = (int)(task % outC);
+        const ElemType* src = Data() + sample * GetNumRows() + (k % shape.groups) * groupSize * inPlane;
+        const ElemType* weights = kernel.Data() + k * kernelSize;
+        ElemType* dst = output.Data() + sample * output.GetNumRows() + k * outPlane;
+
+        for (int oy = 0; oy < shape.outH; oy++)
+        {
+            int y0 = oy * shape.strideH - shape.padH;
+            int ky0, ky1;
+            ClipDepthwiseConvolutionWindow(y0, shape.kernelH, shape.inH, ky0, ky1);
+            for (int ox = 0; ox < shape.outW; ox++)
+            {
+                int x0 = ox * shape.strideW - shape.padW;
+                int kx0, kx1;
+                ClipDepthwiseConvolutionWindow(x0, shape.kernelW, shape.inW, kx0, kx1);
+
+                ElemType sum = 0;
+                for (int c = 0; c < groupSize; c++)
+                {
+                    for (int ky = ky0; ky < ky1; ky++)
+                    {
+                        const ElemType* srcRow = src + c * inPlane + (size_t)(y0 + ky) * shape.inW + (x0 + kx0);
+                        const ElemType* weightRow = weights + ((size_t)c * shape.kernelH + ky) * shape.kernelW + kx0;
+                        for (int kx = 0; kx < kx1 - kx0; kx++)
+                            sum += weightRow[kx] * srcRow[kx];
+                    }
+                }
+                dst[(size_t)oy * shape.outW + ox] = sum;
+            }
+        }
+    }
+}
+
+// One task per sample and group, which are the only outputs that write to the group's input channels.
+template <class ElemType>
+void CPUMatrix<ElemType>::DepthwiseConvolutionBackwardData(const CPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, CPUMatrix<ElemType>& grad) const
+{
+    const int groupSize = shape.inC / shape.groups;
+    const size_t inPlane = (size_t)shape.inW * shape.inH;
+    const size_t outPlane = (size_t)shape.outW * shape.outH;
+    const size_t kernelSize = (size_t)shape.kernelW * shape.kernelH * groupSize;
+
+#pragma omp parallel for
+    for (int64_t task = 0; task < (int64_t)GetNumCols() * shape.groups; task++)
+    {
+        const size_t sample = (size_t)(task / shape.groups);
+        const int g = (int)(task % shape.groups);
+        ElemType* dst = grad.Data() + sample * grad.GetNumRows() + g * groupSize * inPlane;
+
+        for (int m = 0; m < shape.multiplier; m++)
+        {
+            const int k = g + shape.groups * m;
+            const ElemType* src = Data() + sample * GetNumRows() + k * outPlane;
+            const ElemType* weights = kernel.Data() + k * kernelSize;
+            for (int oy = 0; oy < shape.outH; oy++)
+            {
+                int y0 = oy * shape.strideH - shape.padH;
+                int ky0, ky1;
+                ClipDepthwiseConvolutionWindow(y0, shape.kernelH, shape.inH, ky0, ky1);
+                for (int ox = 0; ox < shape.outW; ox++)
+                {
+                    int x0 = ox * shape.strideW - shape.padW;
+                    int kx0, kx1;
+                    ClipDepthwiseConvolutionWindow(x0, shape.kernelW, shape.inW, kx0, kx1);
+
+                    const ElemType curGrad = src[(size_t)oy * shape.outW + ox];
+                    for (int c = 0; c < groupSize; c++)
+                    {
+                        for (int ky = ky0; ky < ky1; ky++)
+                        {
+                            ElemType* dstRow = dst + c * inPlane + (size_t)(y0 + ky) * shape.inW + (x0 + kx0);
+                            const ElemType* weightRow = weights + ((size_t)c * shape.kernelH + ky) * shape.kernelW + kx0;
+                            for (int kx = 0; kx < kx1 - kx0; kx++)
+                                dstRow[kx] += curGrad * weightRow[kx];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// One task per kernel, summing over the samples.
+template <class ElemType>
+void CPUMatrix<ElemType>::DepthwiseConvolutionBackwardKernel(const CPUMatrix<ElemType>& in, const DepthwiseConvolutionShape& shape, CPUMatrix<ElemType>& kernelGrad) const
+{
+    const int groupSize = shape.inC / shape.groups;
+    const int outC = shape.groups * shape.multiplier;
+    const size_t inPlane = (size_t)shape.inW * shape.inH;
+    const size_t outPlane = (size_t)shape.outW * shape.outH;
+    const size_t kernelSize = (size_t)shape.kernelW * shape.kernelH * groupSize;
+
+#pragma omp parallel for
+    for (int k = 0; k < outC; k++)
+    {
+        ElemType* weightGrads = kernelGrad.Data() + k * kernelSize;
+        for (size_t sample = 0; sample < GetNumCols(); sample++)
+        {
+            const ElemType* src = in.Data() + sample * in.GetNumRows() + (k % shape.groups) * groupSize * inPlane;
+            const ElemType* srcGrad = Data() + sample * GetNumRows() + k * outPlane;
+            for (int oy = 0; oy < shape.outH; oy++)
+            {
+                int y0 = oy * shape.strideH - shape.padH;
+                int ky0, ky1;
+                ClipDepthwiseConvolutionWindow(y0, shape.kernelH, shape.inH, ky0, ky1);
+                for (int ox = 0; ox < shape.outW; ox++)
+                {
+                    int x0 = ox * shape.strideW - shape.padW;
+                    int kx0, kx1;
+                    ClipDepthwiseConvolutionWindow(x0, shape.kernelW, shape.inW, kx0, kx1);
+
+                    const ElemType curGrad = srcGrad[(size_t)oy * shape.outW + ox];
+                    for (int c = 0; c < groupSize; c++)
+                    {
+                        for (int ky = ky0; ky < ky1; ky++)
+                        {
+                            const ElemType* srcRow = src + c * inPlane + (size_t)(y0 + ky) * shape.inW + (x0 + kx0);
+                            ElemType* weightGradRow = weightGrads + ((size_t)c * shape.kernelH + ky) * shape.kernelW + kx0;
+                            for (int kx = 0; kx < kx1 - kx0; kx++)
+                                weightGradRow[kx] += curGrad * srcRow[kx];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::UnrollConvolutionInput(size_t unrollCols, size_t mapOutSize, const CPUMatrix<int>& mpRowCol,
                                                  const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output) const
@@ -4380,16 +4911,70 @@ void CPUMatrix<ElemType>::MaxPoolingBackward(const CPUMatrix<ElemType>& out, con
     }
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::MaxPoolingForwardWithArgmax(const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIndices, const CPUMatrix<int>& indices,
+                                                      CPUMatrix<ElemType>& output, CPUMatrix<short>& argmax) const
+{
+#pragma omp parallel for
+    for (int64_t sample = 0; sample < (int64_t)output.GetNumCols(); sample++)
+    {
+        for (size_t row = 0; row < output.GetNumRows(); row++)
+        {
+            int colBase = mpRowCol(row, 0);
+            assert(0 <= colBase && colBase < GetNumRows());
+
+            int i0 = mpRowIndices(row, 0);
+            int size = indices(i0++, 0);
+            assert(size > 0);
+            // the first max, which is also the one MaxPoolingBackward() passes the gradient to
+            int best = 0;
+            ElemType res = (*this)(colBase + indices(i0, 0), sample);
+            for (int i = 1; i < size; i++)
+            {
+                int dcol = indices(i0 + i, 0);
+                assert(0 <= colBase + dcol && colBase + dcol < GetNumRows());
+                if ((*this)(colBase + dcol, sample) > res)
+                {
+                    res = (*this)(colBase + dcol, sample);
+                    best = i;
+                }
+            }
+            output(row, sample) = res;
+            argmax(row, sample) = (short)best;
+        }
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::MaxPoolingBackwardWithArgmax(const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIndices, const CPUMatrix<int>& indices,
+                                                       const CPUMatrix<short>& argmax, CPUMatrix<ElemType>& grad) const
+{
+    // Windows may overlap, but each sample has a column of its own.
+#pragma omp parallel for
+    for (int64_t sample = 0; sample < (int64_t)GetNumCols(); sample++)
+    {
+        for (size_t row = 0; row < GetNumRows(); row++)
+        {
+            int i0 = mpRowIndices(row, 0);
+            assert(0 <= argmax(row, sample) && argmax(row, sample) < indices(i0, 0));
+            int col = mpRowCol(row, 0) + indices(i0 + 1 + argmax(row, sample), 0);
+            assert(0 <= col && col < grad.GetNumRows());
+            grad(col, sample) += (*this)(row, sample);
+        }
+    }
+}
+
 // For each image, for each ROI, this function treats that ROI as an image
 // and does max pooling so that it has output size pooledHeight x pooledWidth.
 // It loops over each location in the output tensor, computes which ROI
 // and image should populate that location, computes the subset of the image
 // corresponding to the ROI and which pixels in that subset should go into the
 // output location, then takes the max value over that window.
+// The ROIs of all images are processed in parallel, since there are many (e.g. 2000 per image) and few images.
 // src: Images              [W x H x C x N]
 // roiData: ROIs            [4 x numROIs x N], 
 // dst: Pooled ROIs         [PW x PH x C x numROIs x N]
-// argmax: max positions    [PW x PH x C x numROIs x N]
+// argmax: max positions    [PW x PH x C x numROIs x N], -1 for an empty window
 // where PW = Pooled Width, PH = Pooled Height, C = Channels, N = Batch Size
 template <class ElemType>
 void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
@@ -4398,166 +4983,121 @@ void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
 {
     size_t roiOutputSize = pooledHeight * pooledWidth * channels;
 
-#pragma omp parallel for
-    for (int imgIdx = 0; imgIdx < numImg; imgIdx++)
+#pragma omp parallel for schedule(dynamic, 16)
+    for (long n = 0; n < (long) (numImg * numRois); n++)
     {
-        auto img = ColumnSlice(imgIdx, 1);
-        auto rois = roiData.ColumnSlice(imgIdx, 1);
-#pragma omp parallel for
-        for (int roiIdx = 0; roiIdx < numRois; roiIdx++)
-        {
-            // each ROI is 4 elements: (x, y, w, h).
-            int base = roiIdx * 4;
+        size_t imgIdx = n / numRois;
+        size_t roiIdx = n % numRois;
+        const ElemType* img = Data() + imgIdx * GetNumRows();
+        const ElemType* rois = roiData.Data() + imgIdx * roiData.GetNumRows();
 
-            // scaled ROI numbers (relative to original image size)
-            // roi points are doubles that represent location relative to image
-            ElemType scX = rois(base, (ElemType)0);
-            ElemType scY = rois(base + (ElemType)1, (ElemType)0);
-            ElemType scW = rois(base + (ElemType)2, (ElemType)0);
-            ElemType scH = rois(base + (ElemType)3, (ElemType)0);
+        // each ROI is 4 elements: (x, y, w, h).
+        size_t base = roiIdx * 4;
 
-            // compute actual spatial location of the ROI in our featuremap.
-            size_t x = (size_t)round(scX * width);
-            size_t y = (size_t)round(scY * height);
-            ElemType roiW = (ElemType)max(round(scW * width),  (ElemType)1);
-            ElemType roiH = (ElemType)max(round(scH * height), (ElemType)1);
+        // scaled ROI numbers (relative to original image size)
+        // roi points are doubles that represent location relative to image
+        ElemType scX = rois[base];
+        ElemType scY = rois[base + 1];
+        ElemType scW = rois[base + 2];
+        ElemType scH = rois[base + 3];
 
-            const ElemType winW = roiW / (ElemType)pooledWidth;
-            const ElemType winH = roiH / (ElemType)pooledHeight;
+        // compute actual spatial location of the ROI in our featuremap.
+        size_t x = (size_t)round(scX * width);
+        size_t y = (size_t)round(scY * height);
+        ElemType roiW = (ElemType)max(round(scW * width),  (ElemType)1);
+        ElemType roiH = (ElemType)max(round(scH * height), (ElemType)1);
 
-            // inspired by Ross Girshick fast-rcnn caffe cpu: https://github.com/rbgirshick/fast-rcnn
-            // loop over spatial locations in output.
-#pragma omp parallel for
-            for (int outw = 0; outw < pooledWidth; outw++)
+        const ElemType winW = roiW / (ElemType)pooledWidth;
+        const ElemType winH = roiH / (ElemType)pooledHeight;
+
+        // inspired by Ross Girshick fast-rcnn caffe cpu: https://github.com/rbgirshick/fast-rcnn
+        // loop over spatial locations in output.
+        for (size_t outw = 0; outw < pooledWidth; outw++)
+        {
+            for (size_t outh = 0; outh < pooledHeight; outh++)
             {
-                for (int outh = 0; outh < pooledHeight; outh++)
-                {
-                    // compute the top left corner of the input
-                    // spatial window corresponding to this output unit
-                    size_t hstart = (size_t)floor(outh * winH);
-                    size_t wstart = (size_t)floor(outw * winW);
+                // compute the top left corner of the input
+                // spatial window corresponding to this output unit
+                size_t hstart = (size_t)floor(outh * winH);
+                size_t wstart = (size_t)floor(outw * winW);
 
-                    // compute bottom right corner (not included)
-                    size_t hend = (size_t)ceil((outh + 1) * winH);
-                    size_t wend = (size_t)ceil((outw + 1) * winW);
+                // compute bottom right corner (not included)
+                size_t hend = (size_t)ceil((outh + 1) * winH);
+                size_t wend = (size_t)ceil((outw + 1) * winW);
 
-                    // offset window based on ROI top left corner.
-                    // these indices are into the input slice.
-                    hstart = min(max(hstart + y, (size_t)0), height);
-                    wstart = min(max(wstart + x, (size_t)0), width);
-                    hend   = min(max(hend + y,   (size_t)0), height);
-                    wend   = min(max(wend + x,   (size_t)0), width);
+                // offset window based on ROI top left corner.
+                // these indices are into the input slice.
+                hstart = min(hstart + y, height);
+                wstart = min(wstart + x, width);
+                hend   = min(hend + y,   height);
+                wend   = min(wend + x,   width);
 
-                    bool isempty = (hend <= hstart) || (wend <= wstart);
+                bool isempty = (hend <= hstart) || (wend <= wstart);
 
-                    for (size_t c = 0; c < channels; c++) 
-                    {
-                        // [W x H x C x R x N]; R = ROIs per image
-                        size_t outputIdx = roiIdx * roiOutputSize + outw + outh * pooledWidth + c * pooledHeight * pooledWidth;
-                        size_t maxidx = 0;
-                        ElemType maxval = isempty ? (ElemType)0 : -FLT_MAX;
-                        size_t baseIdx = c * height * width;
+                for (size_t c = 0; c < channels; c++) 
+                {
+                    // [W x H x C x R x N]; R = ROIs per image
+                    size_t outputIdx = roiIdx * roiOutputSize + outw + outh * pooledWidth + c * pooledHeight * pooledWidth;
+                    ptrdiff_t maxidx = -1;
+                    ElemType maxval = isempty ? (ElemType)0 : -FLT_MAX;
+                    const ElemType* channelData = img + c * height * width;
 
-                        for (size_t h = hstart; h < hend; h++)
+                    for (size_t h = hstart; h < hend; h++)
+                    {
+                        for (size_t w = wstart; w < wend; w++)
                         {
-                            for (size_t w = wstart; w < wend; w++)
+                            // stored argmax indices are relative to the current channel.
+                            size_t dataIdx = w + h * width;
+                            if (channelData[dataIdx] > maxval)
                             {
-                                // stored argmax indices are relative to the current channel.
-                                size_t dataIdx = w + h * width;
-                                if (img(baseIdx + dataIdx, 0) > maxval)
-                                {
-                                    maxval = img(baseIdx + dataIdx, 0);
-                                    maxidx = dataIdx;
-                                }
+                                maxval = channelData[dataIdx];
+                                maxidx = dataIdx;
                             }
                         }
-                        output(outputIdx, imgIdx) = maxval;
-                        argmax(outputIdx, imgIdx) = maxidx;
                     }
+                    output(outputIdx, imgIdx) = maxval;
+                    argmax(outputIdx, imgIdx) = (ElemType)maxidx;
                 }
             }
         }
     }
 }
 
-// This function loops over locations in the input to the ROIPoolingNode (image locations).
-// It loops over the ROIs corresponding to that image, seeing which ones could contain the current location
-// in their output. For each ROI, it checks the argmax data to see if that ROI indeed chose
-// this pixel location as the maximum. If so, it increments the gradient term for the input location.
+// Sends the gradient of every output location back to the input location that was its maximum, as recorded in
+// argmax, and sums the gradients over all the ROIs that chose the same location. Each (image, channel) plane of
+// the gradient is owned by one thread, so that the sums need no atomics, and the work is proportional to the size of
+// the output instead of the input size times the number of ROIs.
 template <class ElemType>
 void CPUMatrix<ElemType>::ROIPoolingBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
                                              const size_t pooledWidth, const size_t pooledHeight, const CPUMatrix<ElemType>& roiData, CPUMatrix<ElemType>& grad, 
                                              CPUMatrix<ElemType>& argmax) const
 {
-    // loop over images in the batch.
+    UNUSED(roiData);
+    const size_t planeSize = width * height;
+    const size_t pooledPlaneSize = pooledWidth * pooledHeight;
+
 #pragma omp parallel for
-    for (int imgIdx = 0; imgIdx < numImg; imgIdx++) 
+    for (long plane = 0; plane < (long) (numImg * channels); plane++)
     {
-        // ROIs for this image. length 4*numRois;
-        auto rois = roiData.ColumnSlice(imgIdx, 1).Data();
+        size_t imgIdx = plane / channels;
+        size_t c = plane % channels;
+
         // gradient values for all ROIs from this image. length numRois*pooledHeight*pooledWidth*channels;
-        auto pooledGrad = ColumnSlice(imgIdx, 1).Data();
-        auto argmaxCol = argmax.ColumnSlice(imgIdx, 1).Data();
+        const ElemType* pooledGrad = Data() + imgIdx * GetNumRows();
+        const ElemType* argmaxCol = argmax.Data() + imgIdx * argmax.GetNumRows();
+        // [W x H x C x N]
+        ElemType* gradPlane = grad.Data() + imgIdx * grad.GetNumRows() + c * planeSize;
+        memset(gradPlane, 0, sizeof(ElemType) * planeSize);
 
-        // loop over spatial locations in the image.
-#pragma omp parallel for
-        for (int w = 0; w < width; w++) 
+        for (size_t roiN = 0; roiN < numRois; roiN++)
         {
-#pragma omp parallel for
-            for (int h = 0; h < width; h++) 
+            // go right up to channel c of the current ROI.
+            size_t offset = (roiN * channels + c) * pooledPlaneSize;
+            for (size_t i = 0; i < pooledPlaneSize; i++)
             {
-                // loop over the ROIs seeing which ones contain this location.
-                for (int roiN = 0; roiN < numRois; roiN++) 
-                {
-                    // each ROI is 4 elements: (x, y, w, h).
-                    int roiOffset = roiN * 4;
-
-                    // ROI data is relative to original image size
-                    size_t roiStartW =     (size_t)round(rois[roiOffset + 0] * width);
-                    size_t roiStartH =     (size_t)round(rois[roiOffset + 1] * height);
-                    size_t roiWidth  = max((size_t)round(rois[roiOffset + 2] * width),  (size_t)1);
-                    size_t roiHeight = max((size_t)round(rois[roiOffset + 3] * height), (size_t)1);
-
-                    // skip this ROI if it doesn't contain the current input location.
-                    const bool inROI = (w >= roiStartW && w < roiStartW + roiWidth &&
-                                        h >= roiStartH && h < roiStartH + roiHeight);
-                    if (!inROI)
-                        continue;
-
-                    ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
-                    ElemType winW = (ElemType)roiWidth  / (ElemType)pooledWidth;
-
-                    // what pooled nodes in the output for this ROI could have pooled this input location?
-                    size_t phstart = (size_t)((h - roiStartH) / winH);
-                    size_t pwstart = (size_t)((w - roiStartW) / winW);
-                    size_t phend   = (size_t)(ceil((h - roiStartH + 1) / winH));
-                    size_t pwend   = (size_t)(ceil((w - roiStartW + 1) / winW));
-
-                    phstart = min(max(phstart, (size_t)0), pooledHeight);
-                    phend   = min(max(phend,   (size_t)0), pooledHeight);
-                    pwstart = min(max(pwstart, (size_t)0), pooledWidth);
-                    pwend   = min(max(pwend,   (size_t)0), pooledWidth);
-
-                    for (size_t c = 0; c < channels; c++) 
-                    {
-                        ElemType gradient = 0;
-                        // [W x H x C x N]
-                        size_t index = w + h*width + c*height*width;
-                        // go right up to channel c of the current ROI.
-                        size_t offset = (roiN * channels + c) * pooledWidth * pooledHeight;
-                        const ElemType* offsetPoolGrad = pooledGrad + offset;
-                        const ElemType* offsetArgmax = argmaxCol + offset;
-                        for (size_t ph = phstart; ph < phend; ph++)
-                        {
-                            for (size_t pw = pwstart; pw < pwend; pw++)
-                            {
-                                if ((size_t)offsetArgmax[ph * pooledWidth + pw] == (w + h * width))
-                                    gradient += offsetPoolGrad[ph * pooledWidth + pw];
-                            }
-                        }
-                        grad(index, imgIdx) = gradient;
-                    }
-                }
+                ptrdiff_t maxidx = (ptrdiff_t) argmaxCol[offset + i];
+                if (maxidx >= 0) // empty windows have no input location
+                    gradPlane[maxidx] += pooledGrad[offset + i];
             }
         }
     }
@@ -4721,6 +5261,14 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
     RuntimeError("Batch normalization training on CPU is not yet implemented.");
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& workspace)
+{
+    if (!m_rnnExecutor)
+        m_rnnExecutor = std::make_shared<CPURNNExecutor<ElemType>>(xDim, yDim, rnnAttributes);
+    m_rnnExecutor->ForwardCore(paramW, inputX, *this, numSequencesForFrame, rnnAttributes, workspace);
+}
+
 
 #pragma region Static BLAS Functions
 
@@ -4789,12 +5337,12 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
     {
         if (sizeof(ElemType) == sizeof(double))
         {
-            cblas_dgemm((CBLAS_ORDER) (int)MatrixOrder::ColMajor, mklTransA, mklTransB, m, n, k, alpha, reinterpret_cast<double*>(a.Data()), lda, reinterpret_cast<double*>(b.Data()), ldb, beta, reinterpret_cast<double*>(c.Data()), ldc);
+            CPUBlas::Gemm(transposeA, transposeB, m, n, k, alpha, reinterpret_cast<double*>(a.Data()), lda, reinterpret_cast<double*>(b.Data()), ldb, beta, reinterpret_cast<double*>(c.Data()), ldc);
         }
         else
         {
 #pragma warning(suppress : 4244)
-            cblas_sgemm((CBLAS_ORDER) (int)MatrixOrder::ColMajor, mklTransA, mklTransB, m, n, k, alpha, reinterpret_cast<float*>(a.Data()), lda, reinterpret_cast<float*>(b.Data()), ldb, beta, reinterpret_cast<float*>(c.Data()), ldc);
+            CPUBlas::Gemm(transposeA, transposeB, m, n, k, alpha, reinterpret_cast<float*>(a.Data()), lda, reinterpret_cast<float*>(b.Data()), ldb, beta, reinterpret_cast<float*>(c.Data()), ldc);
         }
     }
     else
@@ -4803,7 +5351,58 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
         if (mklTransA == CBLAS_TRANSPOSE::CblasTrans || mklTransB == CBLAS_TRANSPOSE::CblasTrans)
             LogicError("Quantized multiplier currently doesn't support transpose.");
 
-        pQuantizedMultiplier->Multiply(m, n, k, a.Data(), b.Data(), c.Data());
+        pQuantizedMultiplier->Multiply(m, n, k, a.Data(), b.Data(), c.Data(), alpha, beta);
+    }
+}
+
+// c_i = alpha * op(a_i) * op(b_i) + beta * c_i for the batchSize column blocks of a, b and c (see Matrix.h).
+// The products are small, so rather than threading each of them, the batch is spread over the OpenMP threads.
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB,
+                                                      ElemType beta, CPUMatrix<ElemType>& c, size_t batchSize, bool broadcastA, bool broadcastB)
+{
+    if (a.IsEmpty() || b.IsEmpty() || batchSize == 0)
+        return;
+    if ((!broadcastA && a.GetNumCols() % batchSize != 0) || (!broadcastB && b.GetNumCols() % batchSize != 0))
+        InvalidArgument("CPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd : The number of columns of a and b must be a multiple of the batch size.");
+
+    const int aRows = (int) a.GetNumRows(), aCols = (int) (a.GetNumCols() / (broadcastA ? 1 : batchSize));
+    const int bRows = (int) b.GetNumRows(), bCols = (int) (b.GetNumCols() / (broadcastB ? 1 : batchSize));
+    const int m = transposeA ? aCols : aRows;
+    const int k = transposeA ? aRows : aCols;
+    const int l = transposeB ? bCols : bRows;
+    const int n = transposeB ? bRows : bCols;
+
+    assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to int may cause overflow
+    if (k != l)
+        InvalidArgument("CPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd : The inner dimensions of a and b must match.");
+
+    if (beta == 0)
+        c.RequireSize(m, n * batchSize);
+    else
+        c.VerifySize(m, n * batchSize); // Can't resize if beta != 0
+
+    const size_t strideA = broadcastA ? 0 : (size_t) aRows * aCols;
+    const size_t strideB = broadcastB ? 0 : (size_t) bRows * bCols;
+    const size_t strideC = (size_t) m * n;
+    ElemType* aData = a.Data();
+    ElemType* bData = b.Data();
+    ElemType* cData = c.Data();
+
+#pragma omp parallel for
+    for (long i = 0; i < (long) batchSize; i++)
+    {
+        if (sizeof(ElemType) == sizeof(double))
+        {
+            CPUBlas::Gemm(transposeA, transposeB, m, n, k, alpha, reinterpret_cast<double*>(aData + i * strideA), aRows, reinterpret_cast<double*>(bData + i * strideB), bRows,
+                          beta, reinterpret_cast<double*>(cData + i * strideC), m);
+        }
+        else
+        {
+#pragma warning(suppress : 4244)
+            CPUBlas::Gemm(transposeA, transposeB, m, n, k, alpha, reinterpret_cast<float*>(aData + i * strideA), aRows, reinterpret_cast<float*>(bData + i * strideB), bRows,
+                          beta, reinterpret_cast<float*>(cData + i * strideC), m);
+        }
     }
 }
 
@@ -5093,12 +5692,12 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
 
         if (sizeof(ElemType) == sizeof(double))
         {
-            cblas_daxpy(len, alpha, reinterpret_cast<double*>(a.Data()), incx, reinterpret_cast<double*>(c.Data()), incy);
+            CPUBlas::Axpy(len, alpha, reinterpret_cast<double*>(a.Data()), incx, reinterpret_cast<double*>(c.Data()), incy);
         }
         else
         {
 #pragma warning(suppress : 4244)
-            cblas_saxpy(len, alpha, reinterpret_cast<float*>(a.Data()), incx, reinterpret_cast<float*>(c.Data()), incy);
+            CPUBlas::Axpy(len, alpha, reinterpret_cast<float*>(a.Data()), incx, reinterpret_cast<float*>(c.Data()), incy);
         }
     }
     else if (a.GetNumElements() == 1) // scalar, add to all elements
@@ -5136,7 +5735,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
 #pragma omp parallel for
             foreach_column (j, c)
             {
-                cblas_daxpy(m, alpha, reinterpret_cast<double*>(aBufPtr), 1, reinterpret_cast<double*>(cBufPtr + c.LocateColumn(j)), 1);
+                CPUBlas::Axpy(m, alpha, reinterpret_cast<double*>(aBufPtr), 1, reinterpret_cast<double*>(cBufPtr + c.LocateColumn(j)), 1);
             }
         }
         else
@@ -5145,7 +5744,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
             foreach_column (j, c)
             {
 #pragma warning(suppress : 4244)
-                cblas_saxpy(m, alpha, reinterpret_cast<float*>(aBufPtr), 1, reinterpret_cast<float*>(cBufPtr + c.LocateColumn(j)), 1);
+                CPUBlas::Axpy(m, alpha, reinterpret_cast<float*>(aBufPtr), 1, reinterpret_cast<float*>(cBufPtr + c.LocateColumn(j)), 1);
             }
         }
     }
@@ -5163,7 +5762,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
 #pragma omp parallel for
             foreach_row (i, c)
             {
-                cblas_daxpy(n, alpha, reinterpret_cast<double*>(aBufPtr), 1, reinterpret_cast<double*>(cBufPtr + i), m);
+                CPUBlas::Axpy(n, alpha, reinterpret_cast<double*>(aBufPtr), 1, reinterpret_cast<double*>(cBufPtr + i), m);
             }
         }
         else
@@ -5172,7 +5771,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
             foreach_row (i, c)
             {
 #pragma warning(suppress : 4244)
-                cblas_saxpy(n, alpha, reinterpret_cast<float*>(aBufPtr), 1, reinterpret_cast<float*>(cBufPtr + i), m);
+                CPUBlas::Axpy(n, alpha, reinterpret_cast<float*>(aBufPtr), 1, reinterpret_cast<float*>(cBufPtr + i), m);
             }
         }
     }
@@ -5386,12 +5985,12 @@ template <class ElemType>
     }
     else if (sizeof(ElemType) == sizeof(double))
     {
-        cblas_dscal(len, alpha, reinterpret_cast<double*>(a.Data()), incx);
+        CPUBlas::Scal(len, alpha, reinterpret_cast<double*>(a.Data()), incx);
     }
     else
     {
 #pragma warning(suppress : 4244)
-        cblas_sscal(len, alpha, reinterpret_cast<float*>(a.Data()), incx);
+        CPUBlas::Scal(len, alpha, reinterpret_cast<float*>(a.Data()), incx);
     }
 }
 
@@ -5438,7 +6037,7 @@ void CPUMatrix<ElemType>::InnerProduct(const CPUMatrix<ElemType>& a, const CPUMa
 #pragma omp parallel for
             foreach_column (j, c)
             {
-                c(0, j) = (ElemType) cblas_ddot(m, reinterpret_cast<double*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<double*>(bBufPtr + b.LocateColumn(j)), 1);
+                c(0, j) = (ElemType) CPUBlas::Dot(m, reinterpret_cast<double*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<double*>(bBufPtr + b.LocateColumn(j)), 1);
             }
         }
         else
@@ -5447,7 +6046,7 @@ void CPUMatrix<ElemType>::InnerProduct(const CPUMatrix<ElemType>& a, const CPUMa
             foreach_column (j, c)
             {
 #pragma warning(suppress : 4244)
-                c(0, j) = (ElemType) cblas_sdot(m, reinterpret_cast<float*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<float*>(bBufPtr + b.LocateColumn(j)), 1);
+                c(0, j) = (ElemType) CPUBlas::Dot(m, reinterpret_cast<float*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<float*>(bBufPtr + b.LocateColumn(j)), 1);
             }
         }
     }
@@ -5462,7 +6061,7 @@ void CPUMatrix<ElemType>::InnerProduct(const CPUMatrix<ElemType>& a, const CPUMa
 #pragma omp parallel for
             foreach_row (i, c)
             {
-                c(i, 0) = cblas_ddot(n, reinterpret_cast<double*>(aBufPtr + i), m, reinterpret_cast<double*>(bBufPtr + i), m);
+                c(i, 0) = CPUBlas::Dot(n, reinterpret_cast<double*>(aBufPtr + i), m, reinterpret_cast<double*>(bBufPtr + i), m);
             }
         }
         else
@@ -5471,7 +6070,7 @@ void CPUMatrix<ElemType>::InnerProduct(const CPUMatrix<ElemType>& a, const CPUMa
             foreach_row (i, c)
             {
 #pragma warning(suppress : 4244)
-                c(i, 0) = cblas_sdot(n, reinterpret_cast<float*>(aBufPtr + i), m, reinterpret_cast<float*>(bBufPtr + i), m);
+                c(i, 0) = CPUBlas::Dot(n, reinterpret_cast<float*>(aBufPtr + i), m, reinterpret_cast<float*>(bBufPtr + i), m);
             }
         }
     }
@@ -5495,12 +6094,12 @@ ElemType CPUMatrix<ElemType>::InnerProductOfMatrices(const CPUMatrix<ElemType>&
 
     if (sizeof(ElemType) == sizeof(double))
     {
-        return (ElemType) cblas_ddot((int) a.GetNumElements(), reinterpret_cast<double*>(a.Data()), 1, reinterpret_cast<double*>(b.Data()), 1);
+        return (ElemType) CPUBlas::Dot((int) a.GetNumElements(), reinterpret_cast<double*>(a.Data()), 1, reinterpret_cast<double*>(b.Data()), 1);
     }
     else
     {
 #pragma warning(suppress : 4244)
-        return (ElemType) cblas_sdot((int) a.GetNumElements(), reinterpret_cast<float*>(a.Data()), 1, reinterpret_cast<float*>(b.Data()), 1);
+        return (ElemType) CPUBlas::Dot((int) a.GetNumElements(), reinterpret_cast<float*>(a.Data()), 1, reinterpret_cast<float*>(b.Data()), 1);
     }
 }
 
@@ -5726,13 +6325,13 @@ void CPUMatrix<ElemType>::InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a,
         {
             for (long j = 0; j < n; j++)
             {
-                c(0, j) = (ElemType) cblas_ddot(m, reinterpret_cast<double*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<double*>(bBufPtr + b.LocateColumn(j)), 1);
+                c(0, j) = (ElemType) CPUBlas::Dot(m, reinterpret_cast<double*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<double*>(bBufPtr + b.LocateColumn(j)), 1);
             }
             for (long j = 0; j < n; j++)
             {
                 for (long i = 1; i < negnumber + 1; i++)
                 {
-                    c(i, j) = (ElemType) cblas_ddot(m, reinterpret_cast<double*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<double*>(bBufPtr + b.LocateColumn((j + shift + i - 1) % n)), 1);
+                    c(i, j) = (ElemType) CPUBlas::Dot(m, reinterpret_cast<double*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<double*>(bBufPtr + b.LocateColumn((j + shift + i - 1) % n)), 1);
                 }
             }
         }
@@ -5740,13 +6339,13 @@ void CPUMatrix<ElemType>::InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a,
         {
             for (long j = 0; j < n; j++)
             {
-                c(0, j) = (ElemType) cblas_sdot(m, reinterpret_cast<float*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<float*>(bBufPtr + b.LocateColumn(j)), 1);
+                c(0, j) = (ElemType) CPUBlas::Dot(m, reinterpret_cast<float*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<float*>(bBufPtr + b.LocateColumn(j)), 1);
             }
             for (long j = 0; j < n; j++)
             {
                 for (long i = 1; i < negnumber + 1; i++)
                 {
-                    c(i, j) = (ElemType) cblas_sdot(m, reinterpret_cast<float*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<float*>(bBufPtr + b.LocateColumn((j + shift + i - 1) % n)), 1);
+                    c(i, j) = (ElemType) CPUBlas::Dot(m, reinterpret_cast<float*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<float*>(bBufPtr + b.LocateColumn((j + shift + i - 1) % n)), 1);
                 }
             }
         }
@@ -5764,7 +6363,7 @@ void CPUMatrix<ElemType>::InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a,
 #pragma omp parallel for
             foreach_row (i, c)
             {
-                c(i, 0) = (ElemType) cblas_ddot(n, reinterpret_cast<double*>(aBufPtr + i), m, reinterpret_cast<double*>(bBufPtr + i), m);
+                c(i, 0) = (ElemType) CPUBlas::Dot(n, reinterpret_cast<double*>(aBufPtr + i), m, reinterpret_cast<double*>(bBufPtr + i), m);
             }
         }
         else
@@ -5773,7 +6372,7 @@ void CPUMatrix<ElemType>::InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a,
             foreach_row (i, c)
             {
 #pragma warning(suppress : 4244)
-                c(i, 0) = cblas_sdot(n, reinterpret_cast<float*>(aBufPtr + i), m, reinterpret_cast<float*>(bBufPtr + i), m);
+                c(i, 0) = CPUBlas::Dot(n, reinterpret_cast<float*>(aBufPtr + i), m, reinterpret_cast<float*>(bBufPtr + i), m);
             }
         }
     }
@@ -6473,6 +7072,113 @@ void CPUMatrix<ElemType>::_rcrfTransGrdCompute(size_t i,
         }
     }
 };
+// the position discount 1/log(2 + rank) of the DCG, 0 beyond the truncation
+template <class ElemType>
+static inline ElemType RankDiscount(size_t rank, size_t truncation)
+{
+    return (truncation == 0 || rank < truncation) ? (ElemType) (1 / log(2.0 + rank)) : 0;
+}
+
+// the score by which samples are ranked; NaN ranks last
+template <class ElemType>
+static inline ElemType RankingScore(ElemType score)
+{
+    return std::isnan(score) ? -std::numeric_limits<ElemType>::infinity() : score;
+}
+
+// the lambda of a pair of samples h, l of a group with gain h > gain l
+template <class ElemType>
+static inline ElemType LambdaOfPair(ElemType scoreH, ElemType scoreL, ElemType gainH, ElemType gainL, ElemType discountH, ElemType discountL, ElemType idealDCG, ElemType sigma)
+{
+    const ElemType deltaNDCG = fabs((gainH - gainL) * (discountL - discountH)) / idealDCG;
+    return -sigma / (1 + exp(sigma * (scoreH - scoreL))) * deltaNDCG;
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RankWithinGroups(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& groupStarts, size_t truncation,
+                                           CPUMatrix<ElemType>& ranks, CPUMatrix<ElemType>& dcgs, CPUMatrix<ElemType>& idealDCGs)
+{
+    const long numGroups = (long) groupStarts.GetNumElements() - 1;
+    ranks.RequireSize(1, scores.GetNumElements());
+    dcgs.RequireSize(1, numGroups);
+    idealDCGs.RequireSize(1, numGroups);
+
+    const ElemType* s = scores.Data();
+    const ElemType* g = gains.Data();
+#pragma omp parallel
+    {
+        std::vector<size_t> order;
+#pragma omp for schedule(dynamic)
+        for (long q = 0; q < numGroups; q++)
+        {
+            const size_t begin = (size_t) groupStarts.Data()[q];
+            const size_t end = (size_t) groupStarts.Data()[q + 1];
+            order.resize(end - begin);
+            std::iota(order.begin(), order.end(), begin);
+            std::sort(order.begin(), order.end(), [s, g](size_t a, size_t b)
+                      {
+                          const ElemType scoreA = RankingScore(s[a]), scoreB = RankingScore(s[b]);
+                          if (scoreA != scoreB)
+                              return scoreA > scoreB;
+                          if (g[a] != g[b])
+                              return g[a] < g[b];
+                          return a < b;
+                      });
+            ElemType dcg = 0, idealDCG = 0;
+            for (size_t rank = 0; rank < order.size(); rank++)
+            {
+                const ElemType discount = RankDiscount<ElemType>(rank, truncation);
+                ranks.Data()[order[rank]] = (ElemType) rank;
+                dcg += g[order[rank]] * discount;
+                idealDCG += g[begin + rank] * discount; // the samples are in descending order of gains
+            }
+            dcgs.Data()[q] = dcg;
+            idealDCGs.Data()[q] = idealDCG;
+        }
+    }
+}
+
+// Each pair is visited once, from its better-ranked sample, so with truncation k a group of n samples takes O(k n).
+template <class ElemType>
+void CPUMatrix<ElemType>::AddLambdaRankGradient(const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& ranks, const CPUMatrix<ElemType>& groupStarts,
+                                                const CPUMatrix<ElemType>& idealDCGs, ElemType sigma, size_t truncation, CPUMatrix<ElemType>& gradient)
+{
+    const long numGroups = (long) groupStarts.GetNumElements() - 1;
+    const ElemType* s = scores.Data();
+    const ElemType* g = gains.Data();
+    const ElemType* r = ranks.Data();
+    ElemType* grad = gradient.Data();
+
+#pragma omp parallel for schedule(dynamic)
+    for (long q = 0; q < numGroups; q++)
+    {
+        const ElemType idealDCG = idealDCGs.Data()[q];
+        if (idealDCG == 0)
+            continue;
+        const size_t begin = (size_t) groupStarts.Data()[q];
+        const size_t end = (size_t) groupStarts.Data()[q + 1];
+        for (size_t i = begin; i < end; i++)
+        {
+            const size_t rankI = (size_t) r[i];
+            const ElemType discountI = RankDiscount<ElemType>(rankI, truncation);
+            if (discountI == 0) // swapping two samples beyond the truncation does not change the DCG
+                continue;
+            for (size_t j = begin; j < end; j++)
+            {
+                const size_t rankJ = (size_t) r[j];
+                if (rankJ <= rankI || fabs(g[i] - g[j]) < 0.0000001)
+                    continue;
+                const ElemType discountJ = RankDiscount<ElemType>(rankJ, truncation);
+                const size_t h = g[i] > g[j] ? i : j;
+                const size_t l = g[i] > g[j] ? j : i;
+                const ElemType lambda = LambdaOfPair(s[h], s[l], g[h], g[l], h == i ? discountI : discountJ, h == i ? discountJ : discountI, idealDCG, sigma);
+                grad[h] += lambda;
+                grad[l] -= lambda;
+            }
+        }
+    }
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::DropFrame(const CPUMatrix<ElemType>& label, const CPUMatrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -6515,13 +7221,17 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSequenceError(const ElemType hsm
 }
 
 // note: this function does not depend on the <ElemType> parameter
+// The threads are limited to the CPUs of the process that are not reserved for background work (ThreadPool).
 template <class ElemType>
 int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
 {
-    if (numThreads == 0) // use default
+    const ThreadPool& threadPool = ThreadPool::Instance();
+    if (numThreads == 0 && threadPool.NumBackgroundCpus() == 0) // use default
         return numThreads;
 
-    int mthreads = (int) std::thread::hardware_concurrency();
+    int mthreads = threadPool.NumAvailableCpus() - threadPool.NumBackgroundCpus();
+    if (numThreads == 0)
+        numThreads = mthreads;
 
     if (numThreads <= 0)
         numThreads = std::max(1, mthreads + numThreads);
@@ -6532,11 +7242,20 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
     omp_set_num_threads(numThreads);
     numThreads = omp_get_max_threads();
 
-    #ifdef USE_MKL
-        mkl_set_num_threads(numThreads);
-    #elif defined(USE_OPENBLAS)
-        openblas_set_num_threads(numThreads);
-    #endif
+    CPUBlas::SetNumThreads(numThreads);
+    if (CPUNuma::IsNumaModeEnabled())
+        CPUNuma::PinThreadsPerNode();
+    else if (threadPool.PinsThreads())
+    {
+        std::atomic<bool> success(true);
+#pragma omp parallel
+        {
+            if (!threadPool.PinCurrentThreadToComputeCpus())
+                success = false;
+        }
+        if (!success)
+            RuntimeError("SetNumThreads: Could not pin the OpenMP threads to the compute CPUs.");
+    }
 #endif
     return numThreads;
 }
@@ -6544,7 +7263,7 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
 template <class ElemType>
 int CPUMatrix<ElemType>::GetMaxNumThreads()
 {
-    int numThreads = (int)std::thread::hardware_concurrency();
+    int numThreads = ThreadPool::Instance().NumAvailableCpus();
 #ifdef _OPENMP
     numThreads = omp_get_max_threads();
 #endif
@@ -6844,6 +7563,90 @@ struct TensorArgOpIteration<ElemType, N, -1>
     }
 };
 
+// -----------------------------------------------------------------------
+// loops for contiguous innermost dimensions, parallelized over the outermost one
+// -----------------------------------------------------------------------
+
+// TensorOpIteration<..., vectorizable, -1, 0> runs an OpenMP loop over the innermost dimension for each index of the outer
+// ones, e.g. once per column of a [512 x 256] bias addition, and for N = 1 and 4 (ternary ops) none at all. For inner
+// dimensions below this size, the outermost dimension is distributed over the threads instead, and each thread runs
+// the inner loops of its indices, with constant unit strides for the innermost one. Operations smaller than this run
+// on the calling thread.
+static const size_t TensorOpOuterLoopParallelThreshold = 32768;
+
+// loop over regular index k of a thread's share (no reduction)
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int k>
+struct TensorOpContiguousIteration
+{
+    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
+                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        array<ptrdiff_t, N> strides;
+        for (size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
+            strides[i] = regularStrides[i][(size_t) k];
+        for (size_t dim = regularOpDims[(size_t) k]; dim-- > 0;)
+        {
+            TensorOpContiguousIteration<ElemType, OPFN, ReductionOp, N, k - 1>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            for (size_t i = 0; i < N; i++)
+                pointers[i] += strides[i];
+        }
+    }
+};
+
+// innermost loop with all strides 1, on the calling thread
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N>
+struct TensorOpContiguousIteration<ElemType, OPFN, ReductionOp, N, 0>
+{
+    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
+                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        typedef TensorOpIteration<ElemType, OPFN, ReductionOp, N, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/> Scalar;
+        const size_t K = regularOpDims[0];
+        // special-case beta and alpha to allow the compiler to short-circuit it
+        if (beta != 0)
+            for (size_t j = 0; j < K; j++, Advance(pointers))
+                Scalar::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        else if (alpha != 1)
+            for (size_t j = 0; j < K; j++, Advance(pointers))
+                Scalar::Loop(0, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        else
+            for (size_t j = 0; j < K; j++, Advance(pointers))
+                Scalar::Loop(0, pointers, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    }
+
+    static inline void Advance(array<ElemType*, N>& pointers)
+    {
+        for (size_t i = 0; i < N; i++)
+            pointers[i]++;
+    }
+};
+
+// tensor operation with k+1 >= 2 dimensions whose innermost one is contiguous for all operands, without reduction
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int k>
+static void TensorOpWithParallelOuterLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
+                                          const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                          const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    static_assert(k >= 1, "TensorOpWithParallelOuterLoop: Requires at least two dimensions.");
+    size_t numElements = 1;
+    for (size_t dim : regularOpDims)
+        numElements *= dim;
+    array<ptrdiff_t, N> strides;
+    for (size_t i = 0; i < N; i++)
+        strides[i] = regularStrides[i][(size_t) k];
+    const int K = (int) regularOpDims[(size_t) k];
+#pragma omp parallel for if (numElements >= TensorOpOuterLoopParallelThreshold)
+    for (int j = 0; j < K; j++)
+    {
+        array<ElemType*, N> p;
+        for (size_t i = 0; i < N; i++)
+            p[i] = pointers[i] + j * strides[i];
+        TensorOpContiguousIteration<ElemType, OPFN, ReductionOp, N, k - 1>::Loop(beta, p, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    }
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
@@ -6867,6 +7670,9 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
         bool leadingAllOne = true;
         for (size_t i = 0; i < N; i++)
             leadingAllOne &= k >= 0 && regularStrides[i][0] == 1;
+        // enough outer indices for all threads, and inner loops too short to be worth an OpenMP loop each
+        if (leadingAllOne && k >= 1 && regularOpDims[0] < TensorOpOuterLoopParallelThreshold && regularOpDims[(size_t) max(k, 0)] >= (size_t) omp_get_max_threads())
+            return TensorOpWithParallelOuterLoop<ElemType, OPFN, ReductionOp, N, (k >= 1 ? k : 1)>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         if (leadingAllOne) // special version that uses a hard-coded increment of 1 for all leading dimensions
             return TensorOpIteration<ElemType, OPFN, ReductionOp, N, true /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
@@ -6939,6 +7745,129 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
     }
 }
 
+// -----------------------------------------------------------------------
+// vectorized fast paths (see CPUVectorizedTensorOps.h)
+// These handle the common cases where, after flattening, the innermost dimension is contiguous for
+// all operands. They return false if the case is not covered, and the caller uses the generic loops.
+// -----------------------------------------------------------------------
+
+// operations smaller than this are not worth the dispatch; the generic loop is just as fast
+static const size_t VectorizedTensorOpMinInnerDim = 32;
+static const size_t VectorizedTensorOpParallelThreshold = 32768;
+
+// generic version: there are only float kernels
+template <class ElemType, size_t N>
+static inline bool TensorOpVectorized(ElemType, const array<ElemType*, N>&, ElemType, ElementWiseOperator, ElementWiseOperator,
+                                      const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
+                                      const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&)
+{
+    return false;
+}
+
+// store a reduced value like TensorOpIteration<..., -1> does
+static inline void StoreVectorizedReduction(float beta, float alpha, double aggregate, float* pout)
+{
+    float val = (float) aggregate;
+    val *= alpha;
+    if (beta != 0)
+        val += beta * *pout;
+    *pout = val;
+}
+
+// unary op or reduction over a single input
+static inline bool TensorOpVectorized(float beta, const array<float*, 2>& pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                      const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                                      const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+    const float* pa = pointers[0];
+    float* pc = pointers[1];
+
+    if (reducingOpDims.empty())
+    {
+        // elementwise: [n] or [n x m] with contiguous n and arbitrary strides for m
+        if (regularOpDims.empty() || regularOpDims.size() > 2 || regularStrides[0][0] != 1 || regularStrides[1][0] != 1 ||
+            !CPUVectorizedTensorOps::IsSupportedUnaryOp(op))
+            return false;
+        const size_t n = regularOpDims[0];
+        if (regularOpDims.size() == 1)
+            return CPUVectorizedTensorOps::UnaryOp(op, beta, pa, alpha, pc, n);
+        if (n < VectorizedTensorOpMinInnerDim)
+            return false;
+        const int m = (int) regularOpDims[1];
+        const ptrdiff_t strideA = regularStrides[0][1], strideC = regularStrides[1][1];
+#pragma omp parallel for if (n * m >= VectorizedTensorOpParallelThreshold && n < VectorizedTensorOpParallelThreshold)
+        for (int j = 0; j < m; j++)
+            CPUVectorizedTensorOps::UnaryOp(op, beta, pa + j * strideA, alpha, pc + j * strideC, n);
+        return true;
+    }
+
+    // reduction: only plain reductions of the input (op = Copy) over one flattened dimension
+    if (op != ElementWiseOperator::opCopy || reducingOpDims.size() != 1 || regularOpDims.size() > 1 ||
+        !CPUVectorizedTensorOps::IsSupportedReductionOp(reductionOp))
+        return false;
+    const size_t m = reducingOpDims[0];
+    const ptrdiff_t reducingStride = reducingStrides[0][0];
+
+    // reduce everything to a scalar
+    if (regularOpDims.empty())
+    {
+        double aggregate;
+        if (reducingStride != 1 || !CPUVectorizedTensorOps::Reduce(reductionOp, pa, m, aggregate))
+            return false;
+        StoreVectorizedReduction(beta, alpha, aggregate, pc);
+        return true;
+    }
+
+    // [n x m] -> [n]: e.g. bias gradient; vectorize along the contiguous n
+    const size_t n = regularOpDims[0];
+    if (regularStrides[0][0] == 1 && regularStrides[1][0] == 1 && reductionOp != ElementWiseOperator::opLogSum)
+        return n >= VectorizedTensorOpMinInnerDim && CPUVectorizedTensorOps::ReduceAcross(reductionOp, beta, pa, reducingStride, m, alpha, pc, n);
+
+    // [m x n] -> [1 x n]: each output reduces a contiguous range
+    if (reducingStride == 1 && m >= VectorizedTensorOpMinInnerDim)
+    {
+        const ptrdiff_t strideA = regularStrides[0][0], strideC = regularStrides[1][0];
+#pragma omp parallel for if (n * m >= VectorizedTensorOpParallelThreshold && m < VectorizedTensorOpParallelThreshold)
+        for (int j = 0; j < (int) n; j++)
+        {
+            double aggregate = 0;
+            CPUVectorizedTensorOps::Reduce(reductionOp, pa + j * strideA, m, aggregate);
+            StoreVectorizedReduction(beta, alpha, aggregate, pc + j * strideC);
+        }
+        return true;
+    }
+    return false;
+}
+
+// binary op, with either input possibly broadcasting a scalar along the innermost dimension (e.g. bias addition)
+static inline bool TensorOpVectorized(float beta, const array<float*, 3>& pointers, float alpha, ElementWiseOperator op, ElementWiseOperator,
+                                      const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                                      const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>&)
+{
+    if (!reducingOpDims.empty() || regularOpDims.empty() || regularOpDims.size() > 2 ||
+        (regularStrides[0][0] != 0 && regularStrides[0][0] != 1) ||
+        (regularStrides[1][0] != 0 && regularStrides[1][0] != 1) ||
+        regularStrides[2][0] != 1 ||
+        !CPUVectorizedTensorOps::IsSupportedBinaryOp(op))
+        return false;
+
+    const float* pa = pointers[0];
+    const float* pb = pointers[1];
+    float* pc = pointers[2];
+    const size_t n = regularOpDims[0];
+    const ptrdiff_t innerStrideA = regularStrides[0][0], innerStrideB = regularStrides[1][0];
+    if (regularOpDims.size() == 1)
+        return CPUVectorizedTensorOps::BinaryOp(op, beta, pa, innerStrideA, pb, innerStrideB, alpha, pc, n);
+    if (n < VectorizedTensorOpMinInnerDim)
+        return false;
+    const int m = (int) regularOpDims[1];
+    const ptrdiff_t strideA = regularStrides[0][1], strideB = regularStrides[1][1], strideC = regularStrides[2][1];
+#pragma omp parallel for if (n * m >= VectorizedTensorOpParallelThreshold && n < VectorizedTensorOpParallelThreshold)
+    for (int j = 0; j < m; j++)
+        CPUVectorizedTensorOps::BinaryOp(op, beta, pa + j * strideA, innerStrideA, pb + j * strideB, innerStrideB, alpha, pc + j * strideC, n);
+    return true;
+}
+
 // -----------------------------------------------------------------------
 // entry points from Matrix.cpp; also map op to a lambda
 // -----------------------------------------------------------------------
@@ -6968,6 +7897,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 2> pointers = {a.Data(), Data()};
+    if (TensorOpVectorized(beta, array<ElemType*, 2>{pointers[0] + offsets[0], pointers[1] + offsets[1]}, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllUnaryOps(CaseUnaryTensorOp);
@@ -6996,6 +7927,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
+    if (TensorOpVectorized(beta, array<ElemType*, 3>{pointers[0] + offsets[0], pointers[1] + offsets[1], pointers[2] + offsets[2]}, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllBinaryOps(CaseBinaryTensorOp);
@@ -7032,6 +7965,32 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     }
 }
 
+// evaluate an ElementwiseProgram on up to ElementwiseProgram::MaxInputs inputs giving 'this'
+// The program is interpreted per element, so this is slower than TensorOp() for a single op, but it reads
+// and writes the data only once for the whole program.
+template <class ElemType>
+void CPUMatrix<ElemType>::TensorProgramOp(ElemType beta, const array<const CPUMatrix<ElemType>*, ElementwiseProgram::MaxInputs>& inputs, ElemType alpha, const ElementwiseProgram& program,
+                                          const array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                                          const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides)
+{
+    const size_t N = ElementwiseProgram::MaxInputs + 1;
+    array<ElemType*, N> pointers;
+    for (size_t i = 0; i < N - 1; i++)
+        pointers[i] = inputs[i]->Data();
+    pointers[N - 1] = Data();
+
+    SmallVector<size_t> reducingOpDims; // (no reduction)
+    array<SmallVector<ptrdiff_t>, N> reducingStrides;
+    TensorOpWithFn(beta, pointers, alpha, [&program](const array<ElemType*, N>& pp)
+                   {
+                       ElemType registers[ElementwiseProgram::MaxRegisters];
+                       for (size_t i = 0; i < program.m_numInputs; i++)
+                           registers[i] = *(pp[i]);
+                       return EvaluateElementwiseProgram(program, registers);
+                   },
+                   ElementWiseOperator::opSum, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
 template <class ElemType>
 int CPUMatrix<ElemType>::Argmin() const
 {
@@ -0,0 +1,229 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUNuma.cpp -- NUMA topology, thread pinning and first-touch placement of CPU matrix memory
+//
+
+#include "stdafx.h"
+#include "CPUNuma.h"
+#include "Basics.h"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <omp.h>
+
+#ifndef _WIN32
+#include <sched.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static std::atomic<bool> s_numaModeEnabled(false);
+
+// the nodes that have processors, in increasing node number
+struct NumaTopology
+{
+#ifdef _WIN32
+    std::vector<USHORT> nodeNumbers;
+    std::vector<GROUP_AFFINITY> nodeAffinities;
+#else
+    std::vector<std::vector<int>> nodeProcessors;
+    std::vector<int> processorNodes; // node index of each processor, -1 if none
+#endif
+    size_t NumNodes() const
+    {
+#ifdef _WIN32
+        return nodeNumbers.size();
+#else
+        return nodeProcessors.size();
+#endif
+    }
+};
+
+static NumaTopology DetectTopology()
+{
+    NumaTopology topology;
+#ifdef _WIN32
+    ULONG highestNodeNumber = 0;
+    if (!GetNumaHighestNodeNumber(&highestNodeNumber))
+        return topology;
+    for (USHORT node = 0; node <= highestNodeNumber; node++)
+    {
+        GROUP_AFFINITY affinity = {};
+        if (GetNumaNodeProcessorMaskEx(node, &affinity) && affinity.Mask != 0)
+        {
+            topology.nodeNumbers.push_back(node);
+            topology.nodeAffinities.push_back(affinity);
+        }
+    }
+#else
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodeList;
+    if (!std::getline(online, nodeList))
+        return topology;
+    for (int node : CPUNuma::ParseList(nodeList))
+    {
+        std::ifstream cpus("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string cpuList;
+        std::getline(cpus, cpuList);
+        auto processors = CPUNuma::ParseList(cpuList);
+        if (processors.empty()) // memory-only node
+            continue;
+        for (int processor : processors)
+        {
+            if ((size_t) processor >= topology.processorNodes.size())
+                topology.processorNodes.resize(processor + 1, -1);
+            topology.processorNodes[processor] = (int) topology.nodeProcessors.size();
+        }
+        topology.nodeProcessors.push_back(std::move(processors));
+    }
+#endif
+    return topology;
+}
+
+static const NumaTopology& Topology()
+{
+    static const NumaTopology topology = DetectTopology();
+    return topology;
+}
+
+std::vector<int> CPUNuma::ParseList(const std::string& list)
+{
+    std::vector<int> result;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        int first, last;
+        char dash;
+        std::stringstream parts(range);
+        if (!(parts >> first))
+            continue;
+        if (parts >> dash >> last)
+        {
+            if (dash != '-' || last < first)
+                InvalidArgument("CPUNuma: Invalid range '%s' in list '%s'.", range.c_str(), list.c_str());
+        }
+        else
+            last = first;
+        for (int i = first; i <= last; i++)
+            result.push_back(i);
+    }
+    return result;
+}
+
+void CPUNuma::EnableNumaMode(bool enable)
+{
+    s_numaModeEnabled = enable;
+    if (enable)
+        PinThreadsPerNode();
+}
+
+bool CPUNuma::IsNumaModeEnabled()
+{
+    return s_numaModeEnabled.load(std::memory_order_relaxed);
+}
+
+size_t CPUNuma::GetNumNodes()
+{
+    return std::max<size_t>(Topology().NumNodes(), 1);
+}
+
+size_t CPUNuma::GetCurrentNode()
+{
+    const NumaTopology& topology = Topology();
+#ifdef _WIN32
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT nodeNumber;
+    if (!GetNumaProcessorNodeEx(&processor, &nodeNumber))
+        return 0;
+    auto iter = std::find(topology.nodeNumbers.begin(), topology.nodeNumbers.end(), nodeNumber);
+    return iter == topology.nodeNumbers.end() ? 0 : iter - topology.nodeNumbers.begin();
+#else
+    const int processor = sched_getcpu();
+    if (processor < 0 || (size_t) processor >= topology.processorNodes.size() || topology.processorNodes[processor] < 0)
+        return 0;
+    return (size_t) topology.processorNodes[processor];
+#endif
+}
+
+// restricts the calling thread to the processors of one node; caller checks the node index
+static bool BindCurrentThread(size_t node)
+{
+    const NumaTopology& topology = Topology();
+#ifdef _WIN32
+    GROUP_AFFINITY affinity = topology.nodeAffinities[node];
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+    cpu_set_t processors;
+    CPU_ZERO(&processors);
+    for (int processor : topology.nodeProcessors[node])
+        CPU_SET(processor, &processors);
+    return sched_setaffinity(0, sizeof(processors), &processors) == 0;
+#endif
+}
+
+// threads cannot throw out of an OpenMP region, so failures are collected and reported afterwards
+static void VerifyBound(bool success, const char* what)
+{
+    if (!success)
+        RuntimeError("CPUNuma: Could not %s.", what);
+}
+
+void CPUNuma::PinThreadsPerNode()
+{
+    const size_t numNodes = GetNumNodes();
+    if (numNodes <= 1)
+        return;
+    std::atomic<bool> success(true);
+#pragma omp parallel
+    {
+        const size_t thread = omp_get_thread_num();
+        const size_t numThreads = omp_get_num_threads();
+        if (!BindCurrentThread(thread * numNodes / numThreads))
+            success = false;
+    }
+    VerifyBound(success, "pin the OpenMP threads to NUMA nodes");
+}
+
+void CPUNuma::BindToNode(size_t node)
+{
+    const size_t numNodes = GetNumNodes();
+    if (node >= numNodes)
+        InvalidArgument("CPUNuma: NUMA node %d requested, but this machine has %d.", (int) node, (int) numNodes);
+    if (numNodes <= 1)
+        return;
+
+    // Hosts call this before every evaluation, make that cheap. The OpenMP threads of a host thread stay with it.
+    static thread_local int t_boundNode = -1;
+    if (t_boundNode == (int) node)
+        return;
+    // Threads created from now on inherit the binding; the existing OpenMP threads are re-bound explicitly.
+    std::atomic<bool> success(BindCurrentThread(node));
+#pragma omp parallel
+    {
+        if (!BindCurrentThread(node))
+            success = false;
+    }
+    VerifyBound(success, "bind the threads to a NUMA node");
+    t_boundNode = (int) node;
+}
+
+void CPUNuma::FirstTouchZero(void* p, size_t numBytes)
+{
+    const size_t pageSize = 4096;
+    char* bytes = (char*) p;
+    const long numPages = (long) ((numBytes + pageSize - 1) / pageSize);
+#pragma omp parallel for schedule(static)
+    for (long page = 0; page < numPages; page++)
+    {
+        const size_t offset = page * pageSize;
+        memset(bytes + offset, 0, std::min(pageSize, numBytes - offset));
+    }
+}
+
+}}}
@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUNuma.h -- NUMA topology, thread pinning and first-touch placement of CPU matrix memory
+//
+// In NUMA mode (numaMode=true):
+//  - CPUMatrix buffers of at least s_firstTouchMinBytes are zeroed by all OpenMP threads with a static schedule instead of
+//    by the allocating thread. The OS places a page on the node of the thread that touches it first, and the elementwise
+//    and tensor kernels use the same static split, so each thread mostly works on memory of its own node.
+//  - The OpenMP threads are pinned in consecutive blocks per node (threads [0, n/2) to node 0, [n/2, n) to node 1, ...),
+//    which is what keeps the first-touch placement and the later accesses on the same node.
+// BindToNode() instead confines the calling thread and its OpenMP threads to a single node, e.g. to run one model replica
+// per node (EvalDll: numaNode=<node>). Memory allocated from such a thread is then local to that node.
+//
+// This does not need libnuma: the topology comes from /sys/devices/system/node on Linux, and from the Win32 NUMA API.
+// On machines with a single node, pinning is a no-op.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class CPUNuma
+{
+public:
+    static void EnableNumaMode(bool enable);
+    static bool IsNumaModeEnabled();
+
+    // number of NUMA nodes with processors, 1 if the topology is unknown
+    static size_t GetNumNodes();
+    // NUMA node of the processor the calling thread runs on
+    static size_t GetCurrentNode();
+
+    // pins the OpenMP threads in consecutive blocks per node (see above); done by CPUMatrix::SetNumThreads() in NUMA mode
+    static void PinThreadsPerNode();
+    // confines the calling thread and its OpenMP threads to the processors of 'node'
+    static void BindToNode(size_t node);
+
+    // zeroes [p, p + numBytes) in parallel, with the static schedule the CPU kernels use
+    static void FirstTouchZero(void* p, size_t numBytes);
+    // buffers below this size are zeroed by the allocating thread
+    static const size_t s_firstTouchMinBytes = 1 << 20;
+
+    // parses a Linux processor/node list like "0-3,8,10-11"
+    static std::vector<int> ParseList(const std::string& list);
+};
+
+}}}
@@ -0,0 +1,184 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPURNNExecutor.cpp -- CPU implementation of the OptimizedRNNStack forward pass
+//
+
+#include "stdafx.h"
+#include "CPURNNExecutor.h"
+#include <omp.h>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// frames with fewer elements than this are updated by the calling thread only
+static const size_t s_minParallelCellElements = 1 << 12;
+
+template <class ElemType>
+static inline ElemType Sigmoid(ElemType x)
+{
+    return 1 / (1 + std::exp(-x));
+}
+
+// column-major [numRows x numCols] view of memory owned by someone else
+template <class ElemType>
+static CPUMatrix<ElemType> View(const ElemType* p, size_t numRows, size_t numCols)
+{
+    return CPUMatrix<ElemType>(numRows, numCols, const_cast<ElemType*>(p), matrixFlagDontOwnBuffer);
+}
+
+template <class ElemType>
+CPURNNExecutor<ElemType>::CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes)
+    : m_xDim(xDim), m_yDim(yDim), m_rnnAttributes(rnnAttributes),
+      m_numGates(rnnAttributes.m_recurrentOp == L"lstm" ? 4 : rnnAttributes.m_recurrentOp == L"gru" ? 3 : 1)
+{
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardCore(const CPUMatrix<ElemType>& weightsW, const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY,
+                                           const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& workspace)
+{
+    // test that the RNN shape is correct
+    if (!(m_rnnAttributes == rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+
+    const size_t numDirections = m_rnnAttributes.m_bidirectional ? 2 : 1;
+    const size_t hiddenSize = m_rnnAttributes.m_hiddenSize;
+    const size_t numLayers = m_rnnAttributes.m_numLayers;
+    if (m_yDim != numDirections * hiddenSize)
+        InvalidArgument("CPU RNN ForwardCore: Output leading dimension must be twice hidden size for bidirectional networks");
+
+    const auto numParameters = m_rnnAttributes.GetNumParameters(m_xDim);
+    if (numParameters.first * numParameters.second != weightsW.GetNumElements())
+        InvalidArgument("RNN needs %d parameters, but %d were allocated", (int)(numParameters.first * numParameters.second), (int)weightsW.GetNumElements());
+
+    vector<size_t> frameOffsets(numSequencesForFrame.size() + 1, 0);
+    for (size_t t = 0; t < numSequencesForFrame.size(); t++)
+        frameOffsets[t + 1] = frameOffsets[t] + numSequencesForFrame[t];
+    const size_t numCols = frameOffsets.back();
+    const size_t maxNumSequences = numSequencesForFrame.empty() ? 0 : numSequencesForFrame[0];
+    if (inputX.GetNumRows() != m_xDim || inputX.GetNumCols() != numCols || outputY.GetNumRows() != m_yDim || outputY.GetNumCols() != numCols)
+        LogicError("CPU RNN ForwardCore: Input [%d x %d] and output [%d x %d] do not match the expected [%d x %d] and [%d x %d].",
+                   (int)inputX.GetNumRows(), (int)inputX.GetNumCols(), (int)outputY.GetNumRows(), (int)outputY.GetNumCols(),
+                   (int)m_xDim, (int)numCols, (int)m_yDim, (int)numCols);
+
+    // Reserve space for:
+    // 1. Input projections of one layer and direction [G*H x numCols].
+    // 2. Recurrent projections [G*H x maxNumSequences], hidden and cell state [H x maxNumSequences] each.
+    // 3. Outputs of intermediate layers, alternating between two buffers [D*H x numCols].
+    const size_t gateSize = m_numGates * hiddenSize;
+    const size_t layerBufferSize = numDirections * hiddenSize * numCols;
+    const size_t numLayerBuffers = std::min<size_t>(numLayers - 1, 2);
+    const size_t layerBuffersOffset = gateSize * numCols + (gateSize + 2 * hiddenSize) * maxNumSequences;
+    workspace.RequireSize(layerBuffersOffset + numLayerBuffers * layerBufferSize, 1);
+    ElemType* buffers = workspace.Data();
+
+    const ElemType* weights = weightsW.Data();
+    size_t biasOffset = 0;
+    for (size_t layer = 0; layer < numLayers; layer++)
+        biasOffset += numDirections * gateSize * ((layer == 0 ? m_xDim : numDirections * hiddenSize) + hiddenSize);
+    const ElemType* biases = weights + biasOffset;
+
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        const size_t inputDim = layer == 0 ? m_xDim : numDirections * hiddenSize;
+        const CPUMatrix<ElemType> in = layer == 0 ? inputX.ColumnSlice(0, numCols) : View(buffers + layerBuffersOffset + (layer - 1) % 2 * layerBufferSize, inputDim, numCols);
+        CPUMatrix<ElemType> out = layer == numLayers - 1 ? outputY.ColumnSlice(0, numCols) : View(buffers + layerBuffersOffset + layer % 2 * layerBufferSize, m_yDim, numCols);
+        for (size_t direction = 0; direction < numDirections; direction++)
+        {
+            const ElemType* weightsR = weights + inputDim * gateSize;
+            ForwardLayer(weights, weightsR, biases, biases + gateSize, in, out, direction * hiddenSize, direction == 1,
+                         numSequencesForFrame, frameOffsets, buffers);
+            weights = weightsR + hiddenSize * gateSize;
+            biases += 2 * gateSize;
+        }
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardLayer(const ElemType* weightsW, const ElemType* weightsR, const ElemType* biasW, const ElemType* biasR,
+                                            const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& out, size_t outRowOffset, bool reverse,
+                                            const vector<size_t>& numSequencesForFrame, const vector<size_t>& frameOffsets, ElemType* buffers)
+{
+    const size_t hiddenSize = m_rnnAttributes.m_hiddenSize;
+    const size_t gateSize = m_numGates * hiddenSize;
+    const size_t numCols = frameOffsets.back();
+    const size_t numFrames = numSequencesForFrame.size();
+    const size_t maxNumSequences = numFrames == 0 ? 0 : numSequencesForFrame[0];
+    const size_t outRows = out.GetNumRows();
+    const bool isLSTM = m_numGates == 4, isGRU = m_numGates == 3, isReLU = m_rnnAttributes.m_recurrentOp == L"rnnReLU";
+
+    // input projections of all frames at once: [G*H x inputDim] * [inputDim x numCols]
+    ElemType* inputProjection = buffers;
+    auto inputProjectionView = View(inputProjection, gateSize, numCols);
+    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, View(weightsW, in.GetNumRows(), gateSize), true, in, false, 0, inputProjectionView);
+
+    ElemType* recurrentProjection = inputProjection + gateSize * numCols;
+    ElemType* hidden = recurrentProjection + gateSize * maxNumSequences;
+    ElemType* cell = hidden + hiddenSize * maxNumSequences;
+    // Sequences start with zero state. Going backwards, sequences join as frames get wider, their columns are still untouched.
+    memset(hidden, 0, sizeof(ElemType) * 2 * hiddenSize * maxNumSequences);
+
+    ElemType* outData = out.Data();
+    const auto weightsRView = View(weightsR, hiddenSize, gateSize);
+    for (size_t step = 0; step < numFrames; step++)
+    {
+        const size_t t = reverse ? numFrames - 1 - step : step;
+        const size_t numSequences = numSequencesForFrame[t];
+        auto recurrentProjectionView = View(recurrentProjection, gateSize, numSequences);
+        if (step == 0)
+            recurrentProjectionView.SetValue(0);
+        else
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, weightsRView, true, View(hidden, hiddenSize, numSequences), false, 0, recurrentProjectionView);
+
+        const ElemType* frameInputProjection = inputProjection + frameOffsets[t] * gateSize;
+        ElemType* frameOut = outData + frameOffsets[t] * outRows + outRowOffset;
+#pragma omp parallel for if (numSequences * gateSize >= s_minParallelCellElements)
+        for (long j = 0; j < (long)numSequences; j++)
+        {
+            const ElemType* x = frameInputProjection + j * gateSize;
+            const ElemType* r = recurrentProjection + j * gateSize;
+            ElemType* h = hidden + j * hiddenSize;
+            ElemType* c = cell + j * hiddenSize;
+            ElemType* y = frameOut + j * outRows;
+            if (isLSTM)
+            {
+                for (size_t u = 0; u < hiddenSize; u++)
+                {
+                    const ElemType i = Sigmoid(x[u] + r[u] + biasW[u] + biasR[u]);
+                    const size_t uf = u + hiddenSize, uc = u + 2 * hiddenSize, uo = u + 3 * hiddenSize;
+                    const ElemType f = Sigmoid(x[uf] + r[uf] + biasW[uf] + biasR[uf]);
+                    const ElemType cc = std::tanh(x[uc] + r[uc] + biasW[uc] + biasR[uc]);
+                    const ElemType o = Sigmoid(x[uo] + r[uo] + biasW[uo] + biasR[uo]);
+                    c[u] = f * c[u] + i * cc;
+                    y[u] = h[u] = o * std::tanh(c[u]);
+                }
+            }
+            else if (isGRU)
+            {
+                for (size_t u = 0; u < hiddenSize; u++)
+                {
+                    const size_t uz = u + hiddenSize, uh = u + 2 * hiddenSize;
+                    const ElemType reset = Sigmoid(x[u] + r[u] + biasW[u] + biasR[u]);
+                    const ElemType z = Sigmoid(x[uz] + r[uz] + biasW[uz] + biasR[uz]);
+                    const ElemType hh = std::tanh(x[uh] + biasW[uh] + reset * (r[uh] + biasR[uh]));
+                    y[u] = h[u] = (1 - z) * hh + z * h[u];
+                }
+            }
+            else
+            {
+                for (size_t u = 0; u < hiddenSize; u++)
+                {
+                    const ElemType a = x[u] + r[u] + biasW[u] + biasR[u];
+                    y[u] = h[u] = isReLU ? (a > 0 ? a : 0) : std::tanh(a);
+                }
+            }
+        }
+    }
+}
+
+template class CPURNNExecutor<float>;
+template class CPURNNExecutor<double>;
+
+}}}
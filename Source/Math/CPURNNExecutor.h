@@ -0,0 +1,51 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPURNNExecutor.h -- CPU implementation of the OptimizedRNNStack forward pass
+//
+
+#pragma once
+
+#include "CPUMatrix.h"
+#include "RNNCommon.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// CPURNNExecutor evaluates the same stacked RNNs as CuDnnRNNExecutor, from the same parameter blob, so that
+// models trained with OptimizedRNNStack on GPU can be evaluated on CPU. Only the forward pass is supported.
+// It is attached to the output CPUMatrix, like CuDnnRNNExecutor is to a GPUMatrix.
+//
+// Parameter layout (cuDNN, CUDNN_LINEAR_INPUT): the weight matrices of all layers come first, then all biases.
+// For each layer and direction (forward first) there is an input matrix W [inputDim x G*H] and a recurrent
+// matrix R [H x G*H], where column g*H + j holds the weights of unit j of gate g. The biases follow in the same
+// order, two vectors b_W and b_R of G*H elements per layer and direction.
+// Gates are (i, f, c', o) for LSTM (G = 4), (r, z, h') for GRU (G = 3); plain RNNs have G = 1.
+//
+// Data uses the "dense CuDNN packing" of OptimizedRNNStackNode: frame t is a block of numSequencesForFrame[t]
+// consecutive columns, sequences sorted by decreasing length so that sequence j is column j of every frame it spans.
+template <class ElemType>
+class CPURNNExecutor
+{
+public:
+    CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes);
+
+    void ForwardCore(const CPUMatrix<ElemType>& weightsW, const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY, const vector<size_t>& numSequencesForFrame,
+                     const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& workspace);
+
+    DISABLE_COPY_AND_MOVE(CPURNNExecutor);
+
+private:
+    // One direction of one layer: all input projections in one GEMM, then per frame a recurrent GEMM
+    // followed by a single fused pass over gates, cell and hidden state.
+    void ForwardLayer(const ElemType* weightsW, const ElemType* weightsR, const ElemType* biasW, const ElemType* biasR,
+                      const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& out, size_t outRowOffset, bool reverse,
+                      const vector<size_t>& numSequencesForFrame, const vector<size_t>& frameOffsets, ElemType* buffers);
+
+    size_t m_xDim, m_yDim;
+    RnnAttributes m_rnnAttributes;
+    size_t m_numGates;
+};
+
+}}}
@@ -14,6 +14,7 @@
 #include <math.h>
 #include "CPUMatrix.h"
 #include "CPUSparseMatrix.h"
+#include "CPUBlas.h"
 #include <random>
 #include <chrono>
 #include <iostream>
@@ -81,6 +82,23 @@ enum class MatrixOpSide : char
 
 #pragma endregion Helpful Enum Definitions
 
+// Sparse operations with fewer nonzeros than this are not worth forking threads for.
+static const size_t s_minParallelSparseWork = 1 << 14;
+
+// memcpy() in chunks on all threads; large sparse minibatches are handed over from the readers this way
+template <class T>
+static void ParallelCopy(T* dst, const T* src, size_t count)
+{
+    const size_t chunkSize = 1 << 16;
+    const long numChunks = (long) ((count + chunkSize - 1) / chunkSize);
+#pragma omp parallel for if (numChunks > 1)
+    for (long chunk = 0; chunk < numChunks; chunk++)
+    {
+        size_t begin = chunk * chunkSize;
+        memcpy(dst + begin, src + begin, sizeof(T) * min(chunkSize, count - begin));
+    }
+}
+
 #pragma region Constructors and Destructor
 
 //-------------------------------------------------------------------------
@@ -334,13 +352,65 @@ void CPUSparseMatrix<ElemType>::SetValue(const CPUSparseMatrix<ElemType>& v)
     }
 }
 
-#if 0
+// dense -> sparse
+// Two passes over the dense matrix, both parallel over columns (CSC) or rows (CSR): the first counts the nonzeros
+// of each column to lay out the compressed index, the second fills in row indices and values.
 template <class ElemType>
-void CPUSparseMatrix<ElemType>::SetValue(const CPUMatrix<ElemType>& /*v*/)
+void CPUSparseMatrix<ElemType>::SetValue(const CPUMatrix<ElemType>& v)
 {
-    NOT_IMPLEMENTED;
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    if (GetFormat() != MatrixFormat::matrixFormatSparseCSC && GetFormat() != MatrixFormat::matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
+
+    const bool isCSC = GetFormat() == MatrixFormat::matrixFormatSparseCSC;
+    const size_t numRows = v.GetNumRows();
+    const size_t numCols = v.GetNumCols();
+    const size_t numOuter = isCSC ? numCols : numRows;
+    const size_t numInner = isCSC ? numRows : numCols;
+    const bool parallel = v.GetNumElements() >= s_minParallelSparseWork;
+
+    vector<CPUSPARSE_INDEX_TYPE> secondaryIndex(numOuter + 1, 0);
+#pragma omp parallel for if (parallel)
+    for (long j = 0; j < (long) numOuter; j++)
+    {
+        CPUSPARSE_INDEX_TYPE count = 0;
+        for (size_t i = 0; i < numInner; i++)
+        {
+            if ((isCSC ? v(i, j) : v(j, i)) != 0)
+                count++;
+        }
+        secondaryIndex[j + 1] = count;
+    }
+    for (size_t j = 0; j < numOuter; j++)
+        secondaryIndex[j + 1] += secondaryIndex[j];
+    const size_t nz = secondaryIndex[numOuter];
+
+    // as in SetMatrixFromCSCFormat(), the secondary index must be in place before the nonzeros can be addressed
+    RequireSizeAndAllocate(numRows, numCols, nz, true, false);
+    ParallelCopy(SecondaryIndexLocation(), secondaryIndex.data(), numOuter + 1);
+
+    CPUSPARSE_INDEX_TYPE* majorIndex = MajorIndexLocation();
+    ElemType* values = NzValues();
+#pragma omp parallel for if (parallel)
+    for (long j = 0; j < (long) numOuter; j++)
+    {
+        size_t p = secondaryIndex[j];
+        for (size_t i = 0; i < numInner; i++)
+        {
+            ElemType val = isCSC ? v(i, j) : v(j, i);
+            if (val != 0)
+            {
+                majorIndex[p] = (CPUSPARSE_INDEX_TYPE) i;
+                values[p] = val;
+                p++;
+            }
+        }
+    }
 }
 
+#if 0
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::SetValue(const GPUMatrix<ElemType>& /*v*/)
 {
@@ -698,9 +768,9 @@ void CPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
 
     // Note: This is a casualty of the switch away from m_nz. RowSize and NzSize depend on ColLocation being correct for format SparseCSC. Thus we must
     // copy ColLocation before RowLocation and NzValues. That's ugly and error prone.
-    memcpy(ColLocation(), h_CSCCol, sizeof(CPUSPARSE_INDEX_TYPE)*(numCols + 1));
-    memcpy(RowLocation(), h_Row, sizeof(CPUSPARSE_INDEX_TYPE)*nz);
-    memcpy(NzValues(), h_Val, sizeof(ElemType)*nz);
+    ParallelCopy(ColLocation(), h_CSCCol, numCols + 1);
+    ParallelCopy(RowLocation(), h_Row, nz);
+    ParallelCopy(NzValues(), h_Val, nz);
 }
 
 template <class ElemType>
@@ -928,18 +998,101 @@ public:
         // * checked that the matrices are compatible in size
         // * Initialized the output matrix c
 
-        // Now do the actual multiplication.
-        ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
-        int* rowIndexBuffer = sparse.MajorIndexLocation();                          // Points to the index buffer of the current view (i.e. buffer containing indices of non-zero elements).
-        size_t iNonzero = 0;                                                           // Number of nonzero elements handled so far for curent slice view.
-        int numPreviosNonzero = sparse.SecondaryIndexLocation()[0];                 // Total number of nonzero values handled in previous slices.
+        // Now do the actual multiplication, using all threads (CPUMatrix::SetNumThreads()) for large enough products.
+        // Each sparse column updates one column (dense * sparse) or row (sparse^T * dense) of c, so when the sparse
+        // 'outer' index is its column index the columns can be processed in parallel. Otherwise the nonzeros of different
+        // sparse columns collide in c. Then each thread takes a block of the dense outer index, i.e. of the c rows or
+        // columns, and walks all nonzeros; if that dimension is too small to be split, each thread accumulates a range of
+        // sparse columns into its own buffer, and the buffers are summed up at the end.
+        const bool sparseOuterIndexIsColumn = (denseTimesSparse && !transposeB) || (!denseTimesSparse && transposeA); // evaluated at compile time
+        const size_t numColsSparse = sparse.GetNumCols();
+        const size_t nz = sparse.NzCount();
+        const int numThreads = (nz * outerDimensionDense >= s_minParallelSparseProductWork) ? omp_get_max_threads() : 1;
+
+        if (numThreads == 1)
+            MultiplyBlock(alpha, sparse, dense, 0, numColsSparse, 0, outerDimensionDense, c);
+        else if (sparseOuterIndexIsColumn)
+        {
+#pragma omp parallel for schedule(dynamic, 16) num_threads(numThreads)
+            for (long colSparse = 0; colSparse < (long) numColsSparse; colSparse++)
+                MultiplyBlock(alpha, sparse, dense, colSparse, colSparse + 1, 0, outerDimensionDense, c);
+        }
+        else if (outerDimensionDense >= 4 * (size_t) numThreads)
+        {
+#pragma omp parallel num_threads(numThreads)
+            {
+                size_t blockSize = (outerDimensionDense + omp_get_num_threads() - 1) / omp_get_num_threads();
+                size_t begin = min(outerDimensionDense, omp_get_thread_num() * blockSize);
+                size_t end = min(outerDimensionDense, begin + blockSize);
+                MultiplyBlock(alpha, sparse, dense, 0, numColsSparse, begin, end, c);
+            }
+        }
+        else
+        {
+            vector<CPUMatrix<ElemType>> partialResults(numThreads);
+#pragma omp parallel num_threads(numThreads)
+            {
+                size_t blockSize = (numColsSparse + omp_get_num_threads() - 1) / omp_get_num_threads();
+                size_t begin = min(numColsSparse, omp_get_thread_num() * blockSize);
+                size_t end = min(numColsSparse, begin + blockSize);
+                auto& partialResult = partialResults[omp_get_thread_num()];
+                partialResult.Resize(c.GetNumRows(), c.GetNumCols());
+                partialResult.SetValue(0);
+                MultiplyBlock(alpha, sparse, dense, begin, end, 0, outerDimensionDense, partialResult);
+            }
+            ElemType* cData = c.Data();
+            const long numElements = (long) c.GetNumElements();
+#pragma omp parallel for num_threads(numThreads)
+            for (long i = 0; i < numElements; i++)
+            {
+                for (const auto& partialResult : partialResults)
+                {
+                    if (!partialResult.IsEmpty())
+                        cData[i] += partialResult.Data()[i];
+                }
+            }
+        }
+    }
+
+private:
+    // products below this many multiply-adds (nonzeros times the dense outer dimension) are not worth forking threads for
+    static const size_t s_minParallelSparseProductWork = 1 << 16;
+
+    // c += alpha * product, restricted to the sparse columns [colSparseBegin, colSparseEnd) and the dense outer indices [outerIndexDenseBegin, outerIndexDenseEnd)
+    static void MultiplyBlock(ElemType alpha, const CPUSparseMatrix<ElemType>& sparse, const CPUMatrix<ElemType>& dense,
+                              size_t colSparseBegin, size_t colSparseEnd, size_t outerIndexDenseBegin, size_t outerIndexDenseEnd, CPUMatrix<ElemType>& c)
+    {
+        const ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
+        const CPUSPARSE_INDEX_TYPE* rowIndexBuffer = sparse.MajorIndexLocation();         // Points to the index buffer of the current view (i.e. buffer containing indices of non-zero elements).
+        const CPUSPARSE_INDEX_TYPE* colStartBuffer = sparse.SecondaryIndexLocation();
+        const CPUSPARSE_INDEX_TYPE numPreviousNonzero = colStartBuffer[0];                // Total number of nonzero values handled in previous slices.
+
+        // Sparse times dense, neither transposed (e.g. pruned weights times activations): for each dense column, add the sparse
+        // columns scaled by its elements. That reads the dense column and writes the column of c in order instead of striding
+        // across columns for every nonzero, and skips the sparse columns that meet a zero (e.g. after a ReLU).
+        if (!denseTimesSparse && !transposeA && !transposeB) // evaluated at compile time
+        {
+            for (size_t colDense = outerIndexDenseBegin; colDense < outerIndexDenseEnd; colDense++)
+            {
+                const ElemType* denseColumn = dense.Data() + colDense * dense.GetNumRows();
+                ElemType* cColumn = c.Data() + colDense * c.GetNumRows();
+                for (size_t colSparse = colSparseBegin; colSparse < colSparseEnd; colSparse++)
+                {
+                    const ElemType denseVal = denseColumn[colSparse];
+                    if (denseVal == 0)
+                        continue;
+                    for (size_t iNonzero = colStartBuffer[colSparse] - numPreviousNonzero; iNonzero < colStartBuffer[colSparse + 1] - numPreviousNonzero; iNonzero++)
+                        cColumn[rowIndexBuffer[iNonzero]] += alpha * denseVal * valueBuffer[iNonzero];
+                }
+            }
+            return;
+        }
 
         // Loop over columns of the sparse matrix
-        for (size_t colSparse = 0; colSparse < sparse.GetNumCols(); colSparse++)
+        for (size_t colSparse = colSparseBegin; colSparse < colSparseEnd; colSparse++)
         {
-            size_t numNonzeroInSparseCol = sparse.SecondaryIndexLocation()[colSparse + 1] - numPreviosNonzero;
             // Loop over the nonzero rows of the current column of the sparse matrix
-            for (; iNonzero < numNonzeroInSparseCol; iNonzero++)
+            for (size_t iNonzero = colStartBuffer[colSparse] - numPreviousNonzero; iNonzero < colStartBuffer[colSparse + 1] - numPreviousNonzero; iNonzero++)
             {
                 size_t rowSparse = rowIndexBuffer[iNonzero]; // RowLocation
                 ElemType sparseVal = valueBuffer[iNonzero];
@@ -954,7 +1107,7 @@ public:
                 else if (!denseTimesSparse &&  transposeA) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
 
                 // Loop over the outer index of the dense matrix
-                for (size_t outerIndexDense = 0; outerIndexDense < outerDimensionDense; outerIndexDense++)
+                for (size_t outerIndexDense = outerIndexDenseBegin; outerIndexDense < outerIndexDenseEnd; outerIndexDense++)
                 {
                     // Determine the row index of the dense input matrix.
                     // Below if-statements are evaluated at compile time.
@@ -963,7 +1116,6 @@ public:
                     else if ( denseTimesSparse &&  transposeA) denseVal = dense(     innerIndex, outerIndexDense);
                     else if (!denseTimesSparse && !transposeB) denseVal = dense(     innerIndex, outerIndexDense);
                     else if (!denseTimesSparse &&  transposeB) denseVal = dense(outerIndexDense,      innerIndex);
-                    
 
                     // Update matrix c.
                     if (denseTimesSparse)
@@ -1079,21 +1231,37 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
             memset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev));
         }
 
-        for (size_t rhsCol = 0; rhsCol < rhs.GetNumCols(); rhsCol++)
+        // resolve the result block of each nonzero up front, so that the threads below only read shared state
+        const size_t numPreviousNonzero = rhs.SecondaryIndexLocation()[0];
+        vector<size_t> resultOffsets(rhs.NzCount());
+        for (size_t rhsNz = 0; rhsNz < resultOffsets.size(); rhsNz++)
+            resultOffsets[rhsNz] = col2BlockId[rhs.MajorIndexLocation()[rhsNz]] * m;
+
+        // Each thread updates a block of rows of all result columns, and walks all nonzeros for it.
+        // That way no two threads write the same element, and each element is summed up in the same order as before.
+        const long rowBlockSize = 256;
+        const long numRowBlocks = (long) ((m + rowBlockSize - 1) / rowBlockSize);
+        const ElemType* lhsData = lhs.Data();
+        const size_t lhsNumRows = lhs.GetNumRows();
+#pragma omp parallel for if (numRowBlocks > 1)
+        for (long rowBlock = 0; rowBlock < numRowBlocks; rowBlock++)
         {
-            size_t start = rhs.SecondaryIndexLocation()[rhsCol];
-            size_t end = rhs.SecondaryIndexLocation()[rhsCol + 1];
-
-            for (size_t p = start; p < end; p++)
+            const size_t rowBegin = rowBlock * rowBlockSize;
+            const size_t rowEnd = min(m, rowBegin + rowBlockSize);
+            for (size_t rhsCol = 0; rhsCol < rhs.GetNumCols(); rhsCol++)
             {
-                size_t rhsRow = rhs.MajorIndexLocation()[p];
-                ElemType val = rhs.Buffer()[p];
+                size_t start = rhs.SecondaryIndexLocation()[rhsCol];
+                size_t end = rhs.SecondaryIndexLocation()[rhsCol + 1];
+                const ElemType* lhsCol = lhsData + rhsCol * lhsNumRows;
 
-                ElemType* results = c.Buffer() + col2BlockId[rhsRow] * m;
-                #pragma omp parallel for
-                for (int lhsRow = 0; lhsRow < (int)m; lhsRow++)
+                for (size_t p = start; p < end; p++)
                 {
-                    results[lhsRow] += alpha * lhs((size_t)lhsRow, rhsCol) * val;
+                    ElemType val = rhs.Buffer()[p];
+                    ElemType* results = c.Buffer() + resultOffsets[p - numPreviousNonzero];
+                    for (size_t lhsRow = rowBegin; lhsRow < rowEnd; lhsRow++)
+                    {
+                        results[lhsRow] += alpha * lhsCol[lhsRow] * val;
+                    }
                 }
             }
         }
@@ -1161,36 +1329,44 @@ void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSpars
         InvalidArgument("CPUSparseMatrix::ScaleAndAdd: The dimensions of a and b must match.");
     }
 
+    // Every column (CSC) or row (CSR), and every block, maps to a different column or row of rhs,
+    // so they can be added in parallel.
+    const bool parallel = lhs.NzCount() >= s_minParallelSparseWork;
     if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC || lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSR)
     {
-        size_t col_num = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? lhs.GetNumCols() : lhs.GetNumRows();
-        for (size_t j = 0; j < col_num; j++)
+        const bool isCSC = lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC;
+        const long col_num = (long) (isCSC ? lhs.GetNumCols() : lhs.GetNumRows());
+        const size_t numPreviousNonzero = lhs.SecondaryIndexLocation()[0];
+#pragma omp parallel for schedule(dynamic, 64) if (parallel)
+        for (long j = 0; j < col_num; j++)
         {
             size_t start = lhs.SecondaryIndexLocation()[j];
             size_t end = lhs.SecondaryIndexLocation()[j + 1];
             for (size_t p = start; p < end; p++)
             {
-                size_t i = lhs.MajorIndexLocation()[p];
+                size_t i = lhs.MajorIndexLocation()[p - numPreviousNonzero];
                 ElemType val = lhs.Buffer()[p];
-                size_t r = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? i : j;
-                size_t c = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? j : i;
+                size_t r = isCSC ? i : j;
+                size_t c = isCSC ? j : i;
                 rhs(r, c) += alpha * val;
             }
         }
     }
     else if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
-        for (size_t j = 0; j < lhs.GetBlockSize(); j++)
+        const bool isBlockCol = lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol;
+#pragma omp parallel for if (parallel)
+        for (long j = 0; j < (long) lhs.GetBlockSize(); j++)
         {
             size_t i = lhs.GetBlockIds()[j] - lhs.GetBlockIdShift();
-            size_t len = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? lhs.GetNumRows() : lhs.GetNumCols();
+            size_t len = isBlockCol ? lhs.GetNumRows() : lhs.GetNumCols();
             size_t start = j * len;
             for (size_t p = start; p < start + len; p++)
             {
                 ElemType val = lhs.Buffer()[p];
 
-                size_t r = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? (p - start) : i;
-                size_t c = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? i : (p - start);
+                size_t r = isBlockCol ? (p - start) : i;
+                size_t c = isBlockCol ? i : (p - start);
                 rhs(r, c) += alpha * val;
             }
         }
@@ -1201,6 +1377,80 @@ void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSpars
     }
 }
 
+// sparse = alpha * sparse + beta * sparse, for block-sparse gradients (e.g. adding up those of a shared parameter)
+// without going through a dense matrix. c may be a or b.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSparseMatrix<ElemType>& a, const ElemType beta, const CPUSparseMatrix<ElemType>& b, CPUSparseMatrix<ElemType>& c)
+{
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("CPUSparseMatrix::ScaleAndAdd: The dimensions of a and b must match.");
+
+    if (a.GetFormat() != b.GetFormat() ||
+        (a.GetFormat() != MatrixFormat::matrixFormatSparseBlockCol && a.GetFormat() != MatrixFormat::matrixFormatSparseBlockRow))
+        NOT_IMPLEMENTED;
+
+    const bool isBlockCol = a.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol;
+    const size_t len = isBlockCol ? a.GetNumRows() : a.GetNumCols();
+    const size_t numColsOrRows = isBlockCol ? a.GetNumCols() : a.GetNumRows();
+
+    // the blocks of the result: those of a, then those of b that a does not have
+    const size_t noBlock = SIZE_MAX;
+    vector<size_t> resultBlock(numColsOrRows, noBlock);
+    vector<size_t> resultBlockIds;
+    for (const CPUSparseMatrix<ElemType>* m : {&a, &b})
+    {
+        for (size_t j = 0; j < m->GetBlockSize(); j++)
+        {
+            size_t i = m->GetBlockIds()[j] - m->GetBlockIdShift();
+            if (resultBlock[i] == noBlock)
+            {
+                resultBlock[i] = resultBlockIds.size();
+                resultBlockIds.push_back(i);
+            }
+        }
+    }
+
+    CPUSparseMatrix<ElemType> result(a.GetFormat(), a.GetNumRows(), a.GetNumCols(), len * resultBlockIds.size());
+    result.SetBlockSize(resultBlockIds.size());
+    if (!resultBlockIds.empty())
+    {
+        memcpy(result.GetBlockIds(), resultBlockIds.data(), sizeof(size_t) * resultBlockIds.size());
+        memset(result.Data(), 0, sizeof(ElemType) * len * resultBlockIds.size());
+    }
+
+    // the blocks of one input map to different blocks of the result
+    auto addScaled = [&](ElemType scale, const CPUSparseMatrix<ElemType>& m)
+    {
+        if (scale == 0)
+            return;
+#pragma omp parallel for if (m.NzCount() >= s_minParallelSparseWork)
+        for (long j = 0; j < (long) m.GetBlockSize(); j++)
+        {
+            const ElemType* from = m.Data() + j * len;
+            ElemType* to = result.Data() + resultBlock[m.GetBlockIds()[j] - m.GetBlockIdShift()] * len;
+            for (size_t k = 0; k < len; k++)
+                to[k] += scale * from[k];
+        }
+    };
+    addScaled(alpha, a);
+    addScaled(beta, b);
+
+    c = std::move(result);
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::Scale(const ElemType alpha, CPUSparseMatrix<ElemType>& a)
+{
+    if (!a.OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    long m = (long) a.NzCount();
+    ElemType* nzValues = a.NzValues();
+#pragma omp parallel for if (m >= (long) s_minParallelSparseWork)
+    for (long i = 0; i < m; i++)
+        nzValues[i] *= alpha;
+}
+
 template <class ElemType>
 /*static*/ bool CPUSparseMatrix<ElemType>::AreEqual(const CPUSparseMatrix<ElemType>& a, const CPUSparseMatrix<ElemType>& b, const ElemType threshold)
 {
@@ -1394,6 +1644,136 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+                                          ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+                                          bool lazy, CPUMatrix<ElemType>* lazyUpdateSteps)
+{
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+    BlockColUpdate(c, functionValues, momentum, adaWeight, lazy, lazyUpdateSteps, [=](ElemType g, ElemType& smoothAda, ElemType& smoothMom, ElemType& val)
+    {
+        // as CPUMatrix::FSAdagrad()
+        ElemType adaSqr = adaWeight * smoothAda + (1.0f - adaWeight) * g * g;
+        smoothAda = adaSqr;
+        if (adaSqr != 0.0f)
+        {
+            ElemType w = adaMul * ((ElemType) 1.0 / sqrt(adaSqr));
+            if (w > 10.0f)
+                w = 10.0f;
+            g *= w;
+        }
+        if (momentum > 0.0f)
+        {
+            g = momentum * smoothMom + unitGainFactor * g;
+            smoothMom = g;
+        }
+        val -= g * learnRatePerSample;
+    });
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+                                     ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+                                     bool lazy, CPUMatrix<ElemType>* lazyUpdateSteps)
+{
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+    BlockColUpdate(c, functionValues, momentum, adaWeight, lazy, lazyUpdateSteps, [=](ElemType g, ElemType& smoothAda, ElemType& smoothMom, ElemType& val)
+    {
+        // as CPUMatrix::Adam()
+        ElemType adaSqr = adaWeight * smoothAda + (1.0f - adaWeight) * g * g;
+        smoothAda = adaSqr;
+        ElemType w = adaMul * (ElemType)(1.0 / (sqrt(adaSqr) + 1e-8));
+        g = momentum * smoothMom + unitGainFactor * g;
+        smoothMom = g;
+        val -= g * w * learnRatePerSample;
+    });
+}
+
+// Without 'lazy', all columns are updated as for the dense gradient, those not in the gradient with 0.
+template <class ElemType>
+template <class UpdateFunction>
+void CPUSparseMatrix<ElemType>::BlockColUpdate(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType momentum, ElemType adaWeight,
+                                               bool lazy, CPUMatrix<ElemType>* lazyUpdateSteps, const UpdateFunction& update)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    const size_t len = GetNumRows();
+    const size_t numCols = GetNumCols();
+    size_t numColsNeeded = 2 * numCols;
+
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(len, numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    if (c.GetNumRows() != len || c.GetNumCols() != numColsNeeded)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    size_t n = GetNumElements();
+    ElemType* grad = Data();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+
+    if (!lazy)
+    {
+        std::vector<const ElemType*> colGrad(numCols, nullptr);
+        for (size_t j = 0; j < GetBlockSize(); j++)
+            colGrad[GetBlockIds()[j] - GetBlockIdShift()] = grad + j * len;
+
+#pragma omp parallel for
+        for (long col = 0; col < (long)numCols; col++)
+        {
+            for (size_t row = 0; row < len; row++)
+            {
+                size_t denseIndex = col * len + row;
+                update(colGrad[col] ? colGrad[col][row] : 0, smoothAda[denseIndex], smoothMom[denseIndex], val[denseIndex]);
+            }
+        }
+        return;
+    }
+
+    ElemType* steps = nullptr;
+    size_t step = 0;
+    if (lazyUpdateSteps)
+    {
+        if (lazyUpdateSteps->GetNumElements() != numCols + 1)
+        {
+            lazyUpdateSteps->RequireSize(1, numCols + 1);
+            lazyUpdateSteps->SetValue(0.0);
+        }
+        steps = lazyUpdateSteps->Data();
+        step = ((size_t)steps[numCols] + 1) % LazyUpdateStepPeriod;
+        steps[numCols] = (ElemType)step;
+    }
+
+#pragma omp parallel for
+    for (int j = 0; j < (int)GetBlockSize(); j++)
+    {
+        size_t i = GetBlockIds()[j] - GetBlockIdShift();
+        ElemType adaDecay = 1;
+        ElemType momDecay = 1;
+        if (steps)
+        {
+            // the updates since the column was last updated
+            const ElemType skipped = (ElemType)((step + LazyUpdateStepPeriod - (size_t)steps[i] - 1) % LazyUpdateStepPeriod);
+            adaDecay = pow(adaWeight, skipped);
+            momDecay = pow(momentum, skipped);
+            steps[i] = (ElemType)step;
+        }
+        size_t start = j * len;
+        for (size_t p = start; p < start + len; p++)
+        {
+            size_t denseIndex = i * len + (p - start);
+            smoothAda[denseIndex] *= adaDecay;
+            smoothMom[denseIndex] *= momDecay;
+            update(grad[p], smoothAda[denseIndex], smoothMom[denseIndex], val[denseIndex]);
+        }
+    }
+}
+
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::AdaDelta(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learningRate, ElemType rho, ElemType epsilon)
 {
@@ -1438,6 +1818,80 @@ void CPUSparseMatrix<ElemType>::AdaDelta(CPUMatrix<ElemType>& c, CPUMatrix<ElemT
     }
 }
 
+// RmsProp of a block-column gradient, like CPUMatrix::RmsProp() of the dense one: the columns without a block
+// have a zero gradient, which still decays the accumulated variances and the step sizes, as on the GPU.
+template <class ElemType>
+ElemType CPUSparseMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                            const bool needAveMultiplier)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    const ElemType floor = 1e-6f;
+    const size_t len = GetNumRows();
+    const size_t numCols = GetNumCols();
+    const size_t n = GetNumElements();
+
+    std::vector<ElemType*> colGrad(numCols, nullptr);
+    for (size_t j = 0; j < GetBlockSize(); j++)
+        colGrad[GetBlockIds()[j] - GetBlockIdShift()] = Data() + j * len;
+
+    if (c.IsEmpty() || c.GetNumCols() < numCols * 3)
+    {
+        c.RequireSize(len, numCols * 3);
+        c.SetValue(0.0);
+
+        ElemType* avars = c.Data();
+        ElemType* steps = c.Data() + 2 * n;
+        for (size_t col = 0; col < numCols; col++)
+        {
+            for (size_t row = 0; row < len; row++)
+            {
+                ElemType g = colGrad[col] ? colGrad[col][row] : 0;
+                avars[col * len + row] = g * g;
+                steps[col * len + row] = ElemType(0.02);
+            }
+        }
+    }
+
+    if (c.GetNumRows() != len || c.GetNumCols() != numCols * 3)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    ElemType* avars = c.Data();         // accumulated variances for RMS scaling
+    ElemType* signs = c.Data() + n;     // sign of previous gradient
+    ElemType* steps = c.Data() + 2 * n; // current step size
+
+    const ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
+    ElemType aveMultiplier = 0;
+#pragma omp parallel for reduction(+ : aveMultiplier)
+    for (long col = 0; col < (long) numCols; col++)
+    {
+        for (size_t row = 0; row < len; row++)
+        {
+            size_t i = col * len + row;
+            ElemType g = colGrad[col] ? colGrad[col][row] : 0;
+            avars[i] = RMS_GAMMA * avars[i] + ONE_MINUS_GAMMA * (g * g);
+            const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+
+            if (signs[i] * grad_sign > 0)
+                steps[i] = std::min(steps[i] * RMS_WGT_INC, RMS_WGT_MAX);
+            else
+                steps[i] = std::max(steps[i] * RMS_WGT_DEC, RMS_WGT_MIN);
+
+            ElemType a = steps[i] / sqrt(avars[i] + floor);
+            if (colGrad[col])
+                colGrad[col][row] *= a;
+            signs[i] = (ElemType) grad_sign;
+            aveMultiplier += a;
+        }
+    }
+
+    if (needAveMultiplier)
+        return aveMultiplier / n;
+    else
+        return 1;
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -1606,6 +2060,31 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceSoftThreshold(const
     return *this;
 }
 
+template <class ElemType>
+CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::ElementMultiplyWith(const CPUMatrix<ElemType>& b)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    if (GetNumRows() != b.GetNumRows() || GetNumCols() != b.GetNumCols())
+        InvalidArgument("CPUSparseMatrix::ElementMultiplyWith: The dimensions of the matrices must match.");
+
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol && GetFormat() != MatrixFormat::matrixFormatSparseBlockRow)
+        NOT_IMPLEMENTED;
+
+    const bool isBlockCol = GetFormat() == MatrixFormat::matrixFormatSparseBlockCol;
+    const size_t len = isBlockCol ? GetNumRows() : GetNumCols();
+#pragma omp parallel for if (NzCount() >= s_minParallelSparseWork)
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t i = GetBlockIds()[j] - GetBlockIdShift();
+        ElemType* values = Data() + j * len;
+        for (size_t k = 0; k < len; k++)
+            values[k] *= isBlockCol ? b(k, i) : b(i, k);
+    }
+    return *this;
+}
+
 template <class ElemType>
 ElemType CPUSparseMatrix<ElemType>::FrobeniusNorm() const
 {
@@ -1632,6 +2111,21 @@ ElemType CPUSparseMatrix<ElemType>::FrobeniusNorm() const
     return sqrt(v);
 }
 
+template <class ElemType>
+ElemType CPUSparseMatrix<ElemType>::MatrixNormInf() const
+{
+    if (IsEmpty())
+        return 0;
+
+    ElemType v = 0;
+    long m = (long) NzCount();
+    const ElemType* nzValues = NzValues();
+    for (long i = 0; i < m; i++)
+        v = std::max(v, (ElemType) fabs(nzValues[i]));
+
+    return v;
+}
+
 //sum of all abs(elements)
 template <class ElemType>
 ElemType CPUSparseMatrix<ElemType>::SumOfAbsElements() const
@@ -1641,12 +2135,12 @@ ElemType CPUSparseMatrix<ElemType>::SumOfAbsElements() const
 
     if (sizeof(ElemType) == sizeof(double))
     {
-        return (ElemType) cblas_dasum((int) this->NzCount(), reinterpret_cast<double*>(Data()), 1);
+        return (ElemType) CPUBlas::Asum((int) this->NzCount(), reinterpret_cast<double*>(Data()), 1);
     }
     else
     {
 #pragma warning(suppress : 4244)
-        return cblas_sasum((int) this->NzCount(), reinterpret_cast<float*>(Data()), 1);
+        return CPUBlas::Asum((int) this->NzCount(), reinterpret_cast<float*>(Data()), 1);
     }
 }
 
@@ -1783,7 +2277,7 @@ template CPUSparseMatrix<char>::CPUSparseMatrix(CPUSparseMatrix<char> const&);
 template CPUSparseMatrix<char>::CPUSparseMatrix(CPUSparseMatrix<char>&&);
 template CPUSparseMatrix<char>& CPUSparseMatrix<char>::operator=(CPUSparseMatrix<char>&& moveFrom);
 template void CPUSparseMatrix<char>::SetValue(size_t, size_t, char);
-//template void CPUSparseMatrix<char>::SetValue(CPUMatrix<char> const&);
+template void CPUSparseMatrix<char>::SetValue(CPUMatrix<char> const&);
 //template void CPUSparseMatrix<char>::SetValue(GPUMatrix<char> const&);
 template void CPUSparseMatrix<char>::SetValue(CPUSparseMatrix<char> const&);
 //template void CPUSparseMatrix<char>::SetValue(GPUSparseMatrix<char> const&);
@@ -1806,7 +2300,7 @@ template CPUSparseMatrix<short>::CPUSparseMatrix(CPUSparseMatrix<short> const&);
 template CPUSparseMatrix<short>::CPUSparseMatrix(CPUSparseMatrix<short>&&);
 template CPUSparseMatrix<short>& CPUSparseMatrix<short>::operator=(CPUSparseMatrix<short>&& moveFrom);
 template void CPUSparseMatrix<short>::SetValue(size_t, size_t, short);
-//template void CPUSparseMatrix<short>::SetValue(CPUMatrix<short> const&);
+template void CPUSparseMatrix<short>::SetValue(CPUMatrix<short> const&);
 //template void CPUSparseMatrix<short>::SetValue(GPUMatrix<short> const&);
 template void CPUSparseMatrix<short>::SetValue(CPUSparseMatrix<short> const&);
 //template void CPUSparseMatrix<short>::SetValue(GPUSparseMatrix<short> const&);
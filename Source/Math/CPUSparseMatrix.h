@@ -72,6 +72,11 @@ private:
     void ZeroInit();
     void CheckInit(const MatrixFormat format);
 
+    // FSAdagrad() and Adam() of a block-column gradient: calls update(g, smoothAda, smoothMom, value) per element
+    template <class UpdateFunction>
+    void BlockColUpdate(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType momentum, ElemType adaWeight,
+                        bool lazy, CPUMatrix<ElemType>* lazyUpdateSteps, const UpdateFunction& update);
+
 public:
     explicit CPUSparseMatrix(const MatrixFormat format);
     CPUSparseMatrix(const MatrixFormat format, const size_t numRows, const size_t numCols, const size_t size);
@@ -84,7 +89,7 @@ public:
 public:
 
     void SetValue(const size_t row, const size_t col, ElemType val);
-    //void SetValue(const CPUMatrix<ElemType>& /*val*/);
+    void SetValue(const CPUMatrix<ElemType>& val); // converts to the current format, CSC or CSR
     //void SetValue(const GPUMatrix<ElemType>& /*val*/);
     void SetValue(const CPUSparseMatrix<ElemType>& /*val*/);
     //void SetValue(const GPUSparseMatrix<ElemType>& /*val*/);
@@ -138,6 +143,11 @@ public:
 
     static void ScaleAndAdd(const ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, CPUMatrix<ElemType>& c);
 
+    // c = alpha * a + beta * b of two block-sparse matrices of the same format; c gets the union of their blocks
+    static void ScaleAndAdd(const ElemType alpha, const CPUSparseMatrix<ElemType>& a, const ElemType beta, const CPUSparseMatrix<ElemType>& b, CPUSparseMatrix<ElemType>& c);
+
+    static void Scale(const ElemType alpha, CPUSparseMatrix<ElemType>& a);
+
     static bool AreEqual(const CPUSparseMatrix<ElemType>& a, const CPUSparseMatrix<ElemType>& b, const ElemType threshold = 1e-8);
 
     // sum(vec(a).*vec(b))
@@ -231,7 +241,12 @@ public:
 public:
     void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum, bool unitGainMomentum = true);
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+                   bool lazy, CPUMatrix<ElemType>* lazyUpdateSteps);
+    void Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+              bool lazy, CPUMatrix<ElemType>* lazyUpdateSteps);
     void AdaDelta(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learningRate, ElemType rho, ElemType epsilon);
+    ElemType RmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
@@ -239,7 +254,11 @@ public:
     CPUSparseMatrix<ElemType>& InplaceTruncate(const ElemType threshold);
     CPUSparseMatrix<ElemType>& InplaceSoftThreshold(const ElemType threshold);
 
+    // this .*= b for the values stored in the blocks of a block-sparse matrix; the pattern does not change
+    CPUSparseMatrix<ElemType>& ElementMultiplyWith(const CPUMatrix<ElemType>& b);
+
     ElemType FrobeniusNorm() const; // useful for comparing CPU and GPU results
+    ElemType MatrixNormInf() const; // max(abs(elements))
 
     ElemType SumOfAbsElements() const; // sum of all abs(elements)
     ElemType SumOfElements() const;    // sum of all elements
@@ -266,6 +285,8 @@ public:
             return GetCompIndex()[GetNumRows()] - GetCompIndex()[0];
         else if (GetFormat() == matrixFormatSparseBlockCol)
             return GetBlockSize() * GetNumRows();
+        else if (GetFormat() == matrixFormatSparseBlockRow)
+            return GetBlockSize() * GetNumCols();
         else
             NOT_IMPLEMENTED;
     }
@@ -0,0 +1,193 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorizedTensorOps.cpp -- runtime (CPUID) selection of the vectorized CPU tensor kernels.
+//
+
+#include "stdafx.h"
+#include "CPUVectorizedTensorOps.h"
+#include <atomic>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// determine what the CPU and the OS support
+static CPUVectorISA DetectCPUVectorISA()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return CPUVectorISA::None;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool fma     = (info[2] & (1 << 12)) != 0;
+    if (!osxsave)
+        return CPUVectorISA::None;
+    // the OS must save the YMM (and for AVX-512, the ZMM/opmask) state across context switches
+    const unsigned long long xcr0 = _xgetbv(0);
+    const bool osYmm = (xcr0 & 0x06) == 0x06;
+    const bool osZmm = (xcr0 & 0xe6) == 0xe6;
+    __cpuidex(info, 7, 0);
+    const bool avx2    = (info[1] & (1 << 5)) != 0;
+    const bool avx512f = (info[1] & (1 << 16)) != 0;
+    if (avx512f && osZmm)
+        return CPUVectorISA::AVX512;
+    if (avx2 && fma && osYmm)
+        return CPUVectorISA::AVX2;
+    return CPUVectorISA::None;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return CPUVectorISA::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return CPUVectorISA::AVX2;
+    return CPUVectorISA::None;
+#else
+    return CPUVectorISA::None;
+#endif
+}
+
+static std::atomic<int> s_maxISA((int) CPUVectorISA::AVX512);
+
+/*static*/ CPUVectorISA CPUVectorizedTensorOps::GetSupportedISA()
+{
+    // what the CPU can do, reduced to what this build contains
+    static const CPUVectorISA supported = []()
+    {
+        CPUVectorISA isa = DetectCPUVectorISA();
+        if (isa == CPUVectorISA::AVX512 && !GetCPUVectorizedKernelsAVX512())
+            isa = CPUVectorISA::AVX2;
+        if (isa == CPUVectorISA::AVX2 && !GetCPUVectorizedKernelsAVX2())
+            isa = CPUVectorISA::None;
+        return isa;
+    }();
+    return supported;
+}
+
+/*static*/ CPUVectorISA CPUVectorizedTensorOps::GetISA()
+{
+    return (CPUVectorISA) std::min((int) GetSupportedISA(), s_maxISA.load());
+}
+
+/*static*/ void CPUVectorizedTensorOps::SetMaxISA(CPUVectorISA maxISA)
+{
+    s_maxISA = (int) maxISA;
+}
+
+/*static*/ const char* CPUVectorizedTensorOps::ISAName(CPUVectorISA isa)
+{
+    switch (isa)
+    {
+    case CPUVectorISA::AVX2:   return "AVX2";
+    case CPUVectorISA::AVX512: return "AVX-512";
+    default:                   return "none";
+    }
+}
+
+/*static*/ const CPUVectorizedKernels* CPUVectorizedTensorOps::GetKernels()
+{
+    switch (GetISA())
+    {
+    case CPUVectorISA::AVX512: return GetCPUVectorizedKernelsAVX512();
+    case CPUVectorISA::AVX2:   return GetCPUVectorizedKernelsAVX2();
+    default:                   return nullptr;
+    }
+}
+
+/*static*/ bool CPUVectorizedTensorOps::IsSupportedUnaryOp(ElementWiseOperator op)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opCopy:
+    case ElementWiseOperator::opNegate:
+    case ElementWiseOperator::opAbs:
+    case ElementWiseOperator::opSqr:
+    case ElementWiseOperator::opLinearRectifier:
+        return GetISA() != CPUVectorISA::None;
+    default:
+        return false;
+    }
+}
+
+/*static*/ bool CPUVectorizedTensorOps::IsSupportedBinaryOp(ElementWiseOperator op)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opSum:
+    case ElementWiseOperator::opDifference:
+    case ElementWiseOperator::opElementwiseProduct:
+    case ElementWiseOperator::opMax:
+    case ElementWiseOperator::opMin:
+    case ElementWiseOperator::opSqrOfDifference:
+    case ElementWiseOperator::opMaskNegative:
+    case ElementWiseOperator::opElementwiseProductWithLinearRectifierDerivativeFromOutput:
+    case ElementWiseOperator::opElementwiseProductWithSigmoidDerivativeFromOutput:
+    case ElementWiseOperator::opElementwiseProductWithTanhDerivativeFromOutput:
+        return GetISA() != CPUVectorISA::None;
+    default:
+        return false;
+    }
+}
+
+/*static*/ bool CPUVectorizedTensorOps::IsSupportedReductionOp(ElementWiseOperator reductionOp)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opSum:
+    case ElementWiseOperator::opMax:
+    case ElementWiseOperator::opMin:
+    case ElementWiseOperator::opLogSum:
+        return GetISA() != CPUVectorISA::None;
+    default:
+        return false;
+    }
+}
+
+/*static*/ bool CPUVectorizedTensorOps::UnaryOp(ElementWiseOperator op, float beta, const float* a, float alpha, float* c, size_t n)
+{
+    auto kernels = GetKernels();
+    return kernels && kernels->unaryOp(op, beta, a, alpha, c, n);
+}
+
+/*static*/ bool CPUVectorizedTensorOps::BinaryOp(ElementWiseOperator op, float beta, const float* a, ptrdiff_t strideA, const float* b, ptrdiff_t strideB, float alpha, float* c, size_t n)
+{
+    auto kernels = GetKernels();
+    return kernels && kernels->binaryOp(op, beta, a, strideA, b, strideB, alpha, c, n);
+}
+
+/*static*/ bool CPUVectorizedTensorOps::Reduce(ElementWiseOperator reductionOp, const float* a, size_t n, double& result)
+{
+    auto kernels = GetKernels();
+    return kernels && kernels->reduce(reductionOp, a, n, result);
+}
+
+/*static*/ bool CPUVectorizedTensorOps::ReduceAcross(ElementWiseOperator reductionOp, float beta, const float* a, ptrdiff_t strideJ, size_t m, float alpha, float* c, size_t n)
+{
+    auto kernels = GetKernels();
+    return kernels && kernels->reduceAcross(reductionOp, beta, a, strideJ, m, alpha, c, n);
+}
+
+/*static*/ bool CPUVectorizedTensorOps::SoftmaxCrossEntropy(const float* x, const float* y, size_t n, float& logSumExp, double& crossEntropy)
+{
+    auto kernels = GetKernels();
+    if (!kernels)
+        return false;
+    kernels->softmaxCrossEntropy(x, y, n, logSumExp, crossEntropy);
+    return true;
+}
+
+/*static*/ bool CPUVectorizedTensorOps::SoftmaxCrossEntropyGradient(float alpha, const float* x, const float* y, float logSumExp, float* g, size_t n)
+{
+    auto kernels = GetKernels();
+    if (!kernels)
+        return false;
+    kernels->softmaxCrossEntropyGradient(alpha, x, y, logSumExp, g, n);
+    return true;
+}
+
+}}}
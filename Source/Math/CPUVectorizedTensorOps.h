@@ -0,0 +1,88 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorizedTensorOps.h -- AVX2/AVX-512 kernels for the most common CPU tensor operations.
+//
+// CPUMatrix::TensorOp() hands an operation to these kernels when, after TensorView has flattened
+// the operands, the innermost dimension is contiguous for all operands (or broadcasts a scalar),
+// and the operation is one of the simple elementwise ops or reductions listed below. Everything
+// else keeps going through the generic templated loops in CPUMatrixImpl.h.
+//
+// The instruction set is picked once at runtime by CPUID, so a single binary runs on any x64 CPU.
+// Each instruction set lives in its own translation unit (CPUVectorizedTensorOpsAVX2.cpp,
+// CPUVectorizedTensorOpsAVX512.cpp) that is compiled with the matching compiler flags, just like
+// BlockHandlerAVX.cpp is for the BlockMultiplier.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// instruction sets the vectorized kernels can use, in increasing order of capability
+enum class CPUVectorISA : int
+{
+    None = 0,   // no vectorized kernels; always use the generic loops
+    AVX2 = 1,   // AVX2 + FMA, 8 floats per register
+    AVX512 = 2, // AVX-512F, 16 floats per register
+};
+
+// table of vectorized kernels for one instruction set
+// All kernels operate on contiguous float arrays. A stride of 0 means the operand is a broadcast scalar.
+// Each kernel returns false if it does not implement the given operation.
+struct CPUVectorizedKernels
+{
+    // c[i] = beta * c[i] + alpha * op(a[i])
+    bool (*unaryOp)(ElementWiseOperator op, float beta, const float* a, float alpha, float* c, size_t n);
+    // c[i] = beta * c[i] + alpha * op(a[i * strideA], b[i * strideB]), strides being 0 or 1
+    bool (*binaryOp)(ElementWiseOperator op, float beta, const float* a, ptrdiff_t strideA, const float* b, ptrdiff_t strideB, float alpha, float* c, size_t n);
+    // result = reductionOp over a[0..n)
+    bool (*reduce)(ElementWiseOperator reductionOp, const float* a, size_t n, double& result);
+    // c[i] = beta * c[i] + alpha * (reductionOp over j of a[i + j * strideJ]) for i in [0, n), j in [0, m)
+    // This is the "sum over columns" pattern of bias gradients.
+    bool (*reduceAcross)(ElementWiseOperator reductionOp, float beta, const float* a, ptrdiff_t strideJ, size_t m, float alpha, float* c, size_t n);
+    // fused softmax + cross entropy of one column x with labels y (see CPUMatrix::AssignSoftmaxCrossEntropyOf()):
+    // logSumExp = log(sum(exp(x[i]))), crossEntropy = sum(y[i]) * logSumExp - sum(y[i] * x[i])
+    void (*softmaxCrossEntropy)(const float* x, const float* y, size_t n, float& logSumExp, double& crossEntropy);
+    // g[i] += alpha * (exp(x[i] - logSumExp) - y[i]), the gradient of the above w.r.t. x
+    void (*softmaxCrossEntropyGradient)(float alpha, const float* x, const float* y, float logSumExp, float* g, size_t n);
+};
+
+class MATH_API CPUVectorizedTensorOps
+{
+public:
+    // the instruction set that will be used (determined by CPUID once, capped by SetMaxISA())
+    static CPUVectorISA GetISA();
+    // the best instruction set this CPU and build support, regardless of SetMaxISA()
+    static CPUVectorISA GetSupportedISA();
+    // cap the instruction set, e.g. CPUVectorISA::None to disable the vectorized path for comparison runs
+    static void SetMaxISA(CPUVectorISA maxISA);
+    static const char* ISAName(CPUVectorISA isa);
+
+    // Entry points used by CPUMatrix::TensorOp(). They return false if the op is not handled,
+    // in which case the caller must fall back to the generic implementation.
+    static bool UnaryOp(ElementWiseOperator op, float beta, const float* a, float alpha, float* c, size_t n);
+    static bool BinaryOp(ElementWiseOperator op, float beta, const float* a, ptrdiff_t strideA, const float* b, ptrdiff_t strideB, float alpha, float* c, size_t n);
+    static bool Reduce(ElementWiseOperator reductionOp, const float* a, size_t n, double& result);
+    static bool ReduceAcross(ElementWiseOperator reductionOp, float beta, const float* a, ptrdiff_t strideJ, size_t m, float alpha, float* c, size_t n);
+    // single-column kernels of the fused softmax + cross entropy; these run on the calling thread
+    static bool SoftmaxCrossEntropy(const float* x, const float* y, size_t n, float& logSumExp, double& crossEntropy);
+    static bool SoftmaxCrossEntropyGradient(float alpha, const float* x, const float* y, float logSumExp, float* g, size_t n);
+
+    // whether an op is implemented at all (cheap pre-check before looking at shapes)
+    static bool IsSupportedUnaryOp(ElementWiseOperator op);
+    static bool IsSupportedBinaryOp(ElementWiseOperator op);
+    static bool IsSupportedReductionOp(ElementWiseOperator reductionOp);
+
+private:
+    static const CPUVectorizedKernels* GetKernels();
+};
+
+// provided by the per-instruction-set translation units; return nullptr if not compiled in
+const CPUVectorizedKernels* GetCPUVectorizedKernelsAVX2();
+const CPUVectorizedKernels* GetCPUVectorizedKernelsAVX512();
+
+}}}
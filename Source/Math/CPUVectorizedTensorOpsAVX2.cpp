@@ -0,0 +1,84 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorizedTensorOpsAVX2.cpp -- AVX2 instantiation of the vectorized CPU tensor kernels.
+// This file must be compiled with AVX2 and FMA enabled (-mavx2 -mfma, resp. /arch:AVX2), see Makefile and Math.vcxproj.
+// The kernels are only called after CPUVectorizedTensorOps has verified by CPUID that the CPU supports them.
+//
+
+#include "stdafx.h"
+#include "CPUVectorizedTensorOps.h"
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+
+#include <immintrin.h>
+#include "CPUVectorizedTensorOpsImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct AVX2Traits
+{
+    typedef __m256 Vec;
+    typedef __m256d VecD;
+    static const size_t width = 8;
+
+    static inline Vec Load(const float* p)        { return _mm256_loadu_ps(p); }
+    static inline void Store(float* p, Vec v)     { _mm256_storeu_ps(p, v); }
+    static inline Vec Set1(float f)               { return _mm256_set1_ps(f); }
+    static inline Vec Zero()                      { return _mm256_setzero_ps(); }
+    static inline Vec Add(Vec a, Vec b)           { return _mm256_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)           { return _mm256_sub_ps(a, b); }
+    static inline Vec Mul(Vec a, Vec b)           { return _mm256_mul_ps(a, b); }
+    static inline Vec Max(Vec a, Vec b)           { return _mm256_max_ps(a, b); } // a > b ? a : b, like OpMax
+    static inline Vec Min(Vec a, Vec b)           { return _mm256_min_ps(a, b); } // a < b ? a : b, like OpMin
+    static inline Vec Abs(Vec a)                  { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline Vec MaskNonNegative(Vec b, Vec a) { return _mm256_and_ps(_mm256_cmp_ps(b, _mm256_setzero_ps(), _CMP_GE_OQ), a); }
+    static inline Vec SelectPositive(Vec b, Vec a)  { return _mm256_and_ps(_mm256_cmp_ps(b, _mm256_setzero_ps(), _CMP_GT_OQ), a); }
+    static inline Vec SelectNonZero(Vec b, Vec a)   { return _mm256_and_ps(_mm256_cmp_ps(b, _mm256_setzero_ps(), _CMP_NEQ_UQ), a); }
+
+    // exp() with the Cephes polynomial; relative error ~1e-7 over the float range
+    static inline Vec Exp(Vec x)
+    {
+        x = _mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f));
+        x = _mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f));
+        Vec fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+        x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(0.693359375f), x);
+        x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(-2.12194440e-4f), x);
+        Vec y = _mm256_set1_ps(1.9875691500E-4f);
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507E-3f));
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073E-3f));
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894E-2f));
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459E-1f));
+        y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201E-1f));
+        y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+        __m256i pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127)), 23);
+        return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+    }
+
+    static inline VecD ZeroD()                    { return _mm256_setzero_pd(); }
+    static inline VecD AddD(VecD a, VecD b)       { return _mm256_add_pd(a, b); }
+    static inline void StoreD(double* p, VecD v)  { _mm256_storeu_pd(p, v); }
+    static inline VecD ToDoubleLo(Vec v)          { return _mm256_cvtps_pd(_mm256_castps256_ps128(v)); }
+    static inline VecD ToDoubleHi(Vec v)          { return _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)); }
+};
+
+const CPUVectorizedKernels* GetCPUVectorizedKernelsAVX2()
+{
+    return VectorizedTensorOps::CPUVectorizedKernelsImpl<AVX2Traits>::Get();
+}
+
+}}}
+
+#else // compiler was not asked for AVX2: vectorized path not available in this build
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+const CPUVectorizedKernels* GetCPUVectorizedKernelsAVX2()
+{
+    return nullptr;
+}
+
+}}}
+
+#endif
@@ -0,0 +1,85 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorizedTensorOpsAVX512.cpp -- AVX-512 instantiation of the vectorized CPU tensor kernels.
+// This file must be compiled with AVX-512F enabled (-mavx512f, resp. /arch:AVX512), see Makefile and Math.vcxproj.
+// The kernels are only called after CPUVectorizedTensorOps has verified by CPUID that the CPU supports them.
+//
+
+#include "stdafx.h"
+#include "CPUVectorizedTensorOps.h"
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+#include "CPUVectorizedTensorOpsImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct AVX512Traits
+{
+    typedef __m512 Vec;
+    typedef __m512d VecD;
+    static const size_t width = 16;
+
+    static inline Vec Load(const float* p)        { return _mm512_loadu_ps(p); }
+    static inline void Store(float* p, Vec v)     { _mm512_storeu_ps(p, v); }
+    static inline Vec Set1(float f)               { return _mm512_set1_ps(f); }
+    static inline Vec Zero()                      { return _mm512_setzero_ps(); }
+    static inline Vec Add(Vec a, Vec b)           { return _mm512_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)           { return _mm512_sub_ps(a, b); }
+    static inline Vec Mul(Vec a, Vec b)           { return _mm512_mul_ps(a, b); }
+    // max/min via compare+blend to get exactly the a > b ? a : b semantics of OpMax/OpMin (incl. NaN handling)
+    static inline Vec Max(Vec a, Vec b)           { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ), b, a); }
+    static inline Vec Min(Vec a, Vec b)           { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ), b, a); }
+    static inline Vec Abs(Vec a)                  { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+    static inline Vec MaskNonNegative(Vec b, Vec a) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(b, _mm512_setzero_ps(), _CMP_GE_OQ), a); }
+    static inline Vec SelectPositive(Vec b, Vec a)  { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(b, _mm512_setzero_ps(), _CMP_GT_OQ), a); }
+    static inline Vec SelectNonZero(Vec b, Vec a)   { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(b, _mm512_setzero_ps(), _CMP_NEQ_UQ), a); }
+
+    // exp() with the Cephes polynomial; relative error ~1e-7 over the float range
+    static inline Vec Exp(Vec x)
+    {
+        x = _mm512_min_ps(x, _mm512_set1_ps(88.3762626647949f));
+        x = _mm512_max_ps(x, _mm512_set1_ps(-88.3762626647949f));
+        Vec fx = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(1.44269504088896341f), _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(0.693359375f), x);
+        x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(-2.12194440e-4f), x);
+        Vec y = _mm512_set1_ps(1.9875691500E-4f);
+        y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(1.3981999507E-3f));
+        y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(8.3334519073E-3f));
+        y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(4.1665795894E-2f));
+        y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(1.6666665459E-1f));
+        y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(5.0000001201E-1f));
+        y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+        __m512i pow2n = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(127)), 23);
+        return _mm512_mul_ps(y, _mm512_castsi512_ps(pow2n));
+    }
+
+    static inline VecD ZeroD()                    { return _mm512_setzero_pd(); }
+    static inline VecD AddD(VecD a, VecD b)       { return _mm512_add_pd(a, b); }
+    static inline void StoreD(double* p, VecD v)  { _mm512_storeu_pd(p, v); }
+    static inline VecD ToDoubleLo(Vec v)          { return _mm512_cvtps_pd(_mm512_castps512_ps256(v)); }
+    static inline VecD ToDoubleHi(Vec v)          { return _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1))); }
+};
+
+const CPUVectorizedKernels* GetCPUVectorizedKernelsAVX512()
+{
+    return VectorizedTensorOps::CPUVectorizedKernelsImpl<AVX512Traits>::Get();
+}
+
+}}}
+
+#else // compiler was not asked for AVX-512: fall back to the AVX2 kernels at runtime
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+const CPUVectorizedKernels* GetCPUVectorizedKernelsAVX512()
+{
+    return nullptr;
+}
+
+}}}
+
+#endif
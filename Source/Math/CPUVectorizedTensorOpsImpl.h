@@ -0,0 +1,466 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorizedTensorOpsImpl.h -- instruction-set independent part of the vectorized CPU tensor kernels.
+//
+// This is included by exactly one translation unit per instruction set. That translation unit defines a
+// SIMD traits class (see CPUVectorizedTensorOpsAVX2.cpp) and instantiates CPUVectorizedKernelsImpl<Traits>.
+// Do not include this anywhere else, since the code below must be compiled with the instruction set flags
+// of the respective traits class.
+//
+// A traits class provides:
+//   typedef ... Vec;   typedef ... VecD;         // float vector, double vector of half the width
+//   static const size_t width;                    // floats per Vec
+//   Load, Store, Set1, Zero, Add, Sub, Mul, Max, Min, Abs, Exp     // float vector ops
+//   MaskNonNegative(b, a)                         // b >= 0 ? a : 0
+//   SelectPositive(b, a)                          // b > 0 ? a : 0
+//   SelectNonZero(b, a)                           // b != 0 ? a : 0
+//   ToDoubleLo, ToDoubleHi, AddD, ZeroD, StoreD   // widening for sum accumulation in double
+//
+
+#pragma once
+
+#include "CPUVectorizedTensorOps.h"
+#include "TensorOps.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace VectorizedTensorOps {
+
+// Sizes below are in elements. Operations smaller than the threshold run on the calling thread,
+// since OpenMP fork/join costs more than the work itself.
+static const size_t ChunkSize = 16384;
+static const size_t ParallelThreshold = 2 * ChunkSize;
+
+// -----------------------------------------------------------------------
+// elementwise functors; each provides a vector and a scalar version
+// The scalar versions must match TensorOps.h exactly, since they are used for the tail elements.
+// -----------------------------------------------------------------------
+
+template <class V> struct UnaryCopy            { typename V::Vec operator()(typename V::Vec a) const { return a; }                        float operator()(float a) const { return a; } };
+template <class V> struct UnaryNegate          { typename V::Vec operator()(typename V::Vec a) const { return V::Sub(V::Zero(), a); }     float operator()(float a) const { return -a; } };
+template <class V> struct UnaryAbs             { typename V::Vec operator()(typename V::Vec a) const { return V::Abs(a); }                float operator()(float a) const { return fabs_(a); } };
+template <class V> struct UnarySqr             { typename V::Vec operator()(typename V::Vec a) const { return V::Mul(a, a); }             float operator()(float a) const { return a * a; } };
+template <class V> struct UnaryLinearRectifier { typename V::Vec operator()(typename V::Vec a) const { return V::Max(a, V::Zero()); }      float operator()(float a) const { return a > 0 ? a : 0; } };
+
+template <class V> struct BinarySum                { typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::Add(a, b); }              float operator()(float a, float b) const { return a + b; } };
+template <class V> struct BinaryDifference         { typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::Sub(a, b); }              float operator()(float a, float b) const { return a - b; } };
+template <class V> struct BinaryElementwiseProduct { typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::Mul(a, b); }              float operator()(float a, float b) const { return a * b; } };
+template <class V> struct BinaryMax                { typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::Max(a, b); }              float operator()(float a, float b) const { return a > b ? a : b; } };
+template <class V> struct BinaryMin                { typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::Min(a, b); }              float operator()(float a, float b) const { return a < b ? a : b; } };
+template <class V> struct BinarySqrOfDifference    { typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { auto d = V::Sub(a, b); return V::Mul(d, d); } float operator()(float a, float b) const { float d = a - b; return d * d; } };
+template <class V> struct BinaryMaskNegative       { typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::MaskNonNegative(b, a); }  float operator()(float a, float b) const { return b >= 0 ? a : 0; } };
+template <class V> struct BinaryElementwiseProductWithLinearRectifierDerivativeFromOutput
+{
+    typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::SelectPositive(b, a); }
+    float operator()(float a, float b) const { return b > 0 ? a : 0; }
+};
+template <class V> struct BinaryElementwiseProductWithSigmoidDerivativeFromOutput
+{
+    typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::Mul(a, V::Mul(b, V::Sub(V::Set1(1), b))); }
+    float operator()(float a, float b) const { return a * (b * (1 - b)); }
+};
+template <class V> struct BinaryElementwiseProductWithTanhDerivativeFromOutput
+{
+    typename V::Vec operator()(typename V::Vec a, typename V::Vec b) const { return V::Mul(a, V::Sub(V::Set1(1), V::Mul(b, b))); }
+    float operator()(float a, float b) const { return a * (1 - b * b); }
+};
+
+// -----------------------------------------------------------------------
+// helper to run [0, n) either on the calling thread or in chunks across OpenMP threads
+// -----------------------------------------------------------------------
+
+template <class FN>
+static inline void ForChunks(size_t n, const FN& fn)
+{
+    if (n < ParallelThreshold)
+        return fn(0, n);
+    const int numChunks = (int) ((n + ChunkSize - 1) / ChunkSize);
+#pragma omp parallel for
+    for (int chunk = 0; chunk < numChunks; chunk++)
+    {
+        size_t begin = chunk * ChunkSize;
+        fn(begin, std::min(begin + ChunkSize, n));
+    }
+}
+
+// -----------------------------------------------------------------------
+// kernels
+// -----------------------------------------------------------------------
+
+template <class V>
+struct CPUVectorizedKernelsImpl
+{
+    typedef typename V::Vec Vec;
+
+    // c = beta * c + alpha * val, in the same order of operations as the generic loop in CPUMatrixImpl.h
+    static inline void StoreResult(float* pc, Vec val, float beta, Vec vAlpha, Vec vBeta)
+    {
+        val = V::Mul(val, vAlpha);
+        if (beta != 0)
+            val = V::Add(val, V::Mul(vBeta, V::Load(pc)));
+        V::Store(pc, val);
+    }
+    static inline void StoreResult(float* pc, float val, float beta, float alpha)
+    {
+        val *= alpha;
+        if (beta != 0)
+            val += beta * *pc;
+        *pc = val;
+    }
+
+    template <class OP>
+    static void UnaryLoop(const OP& op, float beta, const float* a, float alpha, float* c, size_t n)
+    {
+        ForChunks(n, [&](size_t begin, size_t end)
+        {
+            const Vec vAlpha = V::Set1(alpha), vBeta = V::Set1(beta);
+            size_t i = begin;
+            for (; i + V::width <= end; i += V::width)
+                StoreResult(c + i, op(V::Load(a + i)), beta, vAlpha, vBeta);
+            for (; i < end; i++)
+                StoreResult(c + i, op(a[i]), beta, alpha);
+        });
+    }
+
+    template <class OP>
+    static void BinaryLoop(const OP& op, float beta, const float* a, ptrdiff_t strideA, const float* b, ptrdiff_t strideB, float alpha, float* c, size_t n)
+    {
+        ForChunks(n, [&](size_t begin, size_t end)
+        {
+            const Vec vAlpha = V::Set1(alpha), vBeta = V::Set1(beta);
+            // broadcast operands (stride 0) are loaded once
+            const Vec va0 = V::Set1(*a), vb0 = V::Set1(*b);
+            size_t i = begin;
+            for (; i + V::width <= end; i += V::width)
+            {
+                Vec va = strideA ? V::Load(a + i) : va0;
+                Vec vb = strideB ? V::Load(b + i) : vb0;
+                StoreResult(c + i, op(va, vb), beta, vAlpha, vBeta);
+            }
+            for (; i < end; i++)
+                StoreResult(c + i, op(a[i * strideA], b[i * strideB]), beta, alpha);
+        });
+    }
+
+    static bool UnaryOp(ElementWiseOperator op, float beta, const float* a, float alpha, float* c, size_t n)
+    {
+        switch (op)
+        {
+        case ElementWiseOperator::opCopy:            UnaryLoop(UnaryCopy<V>(),            beta, a, alpha, c, n); return true;
+        case ElementWiseOperator::opNegate:          UnaryLoop(UnaryNegate<V>(),          beta, a, alpha, c, n); return true;
+        case ElementWiseOperator::opAbs:             UnaryLoop(UnaryAbs<V>(),             beta, a, alpha, c, n); return true;
+        case ElementWiseOperator::opSqr:             UnaryLoop(UnarySqr<V>(),             beta, a, alpha, c, n); return true;
+        case ElementWiseOperator::opLinearRectifier: UnaryLoop(UnaryLinearRectifier<V>(), beta, a, alpha, c, n); return true;
+        default: return false;
+        }
+    }
+
+    static bool BinaryOp(ElementWiseOperator op, float beta, const float* a, ptrdiff_t strideA, const float* b, ptrdiff_t strideB, float alpha, float* c, size_t n)
+    {
+#define CaseVectorizedBinaryOp(oper) \
+        case ElementWiseOperator::op##oper: BinaryLoop(Binary##oper<V>(), beta, a, strideA, b, strideB, alpha, c, n); return true
+
+        switch (op)
+        {
+        CaseVectorizedBinaryOp(Sum);
+        CaseVectorizedBinaryOp(Difference);
+        CaseVectorizedBinaryOp(ElementwiseProduct);
+        CaseVectorizedBinaryOp(Max);
+        CaseVectorizedBinaryOp(Min);
+        CaseVectorizedBinaryOp(SqrOfDifference);
+        CaseVectorizedBinaryOp(MaskNegative);
+        CaseVectorizedBinaryOp(ElementwiseProductWithLinearRectifierDerivativeFromOutput);
+        CaseVectorizedBinaryOp(ElementwiseProductWithSigmoidDerivativeFromOutput);
+        CaseVectorizedBinaryOp(ElementwiseProductWithTanhDerivativeFromOutput);
+        default: return false;
+        }
+#undef CaseVectorizedBinaryOp
+    }
+
+    // --- reductions over a contiguous range
+
+    // sum, accumulated in double like the generic path
+    static double SumRange(const float* a, size_t begin, size_t end)
+    {
+        typename V::VecD acc0 = V::ZeroD(), acc1 = V::ZeroD();
+        size_t i = begin;
+        for (; i + V::width <= end; i += V::width)
+        {
+            Vec v = V::Load(a + i);
+            acc0 = V::AddD(acc0, V::ToDoubleLo(v));
+            acc1 = V::AddD(acc1, V::ToDoubleHi(v));
+        }
+        double lanes[V::width / 2];
+        V::StoreD(lanes, V::AddD(acc0, acc1));
+        double sum = 0;
+        for (size_t k = 0; k < V::width / 2; k++)
+            sum += lanes[k];
+        for (; i < end; i++)
+            sum += a[i];
+        return sum;
+    }
+
+    template <bool isMax>
+    static float MinMaxRange(const float* a, size_t begin, size_t end)
+    {
+        float result = a[begin];
+        size_t i = begin;
+        if (i + V::width <= end)
+        {
+            Vec acc = V::Load(a + i);
+            for (i += V::width; i + V::width <= end; i += V::width)
+                acc = isMax ? V::Max(acc, V::Load(a + i)) : V::Min(acc, V::Load(a + i));
+            float lanes[V::width];
+            V::Store(lanes, acc);
+            result = lanes[0];
+            for (size_t k = 1; k < V::width; k++)
+                result = isMax ? (lanes[k] > result ? lanes[k] : result) : (lanes[k] < result ? lanes[k] : result);
+        }
+        for (; i < end; i++)
+            result = isMax ? (a[i] > result ? a[i] : result) : (a[i] < result ? a[i] : result);
+        return result;
+    }
+
+    // log(sum(exp(a[i]))), computed as max + log(sum(exp(a[i] - max)))
+    static double LogSumRange(const float* a, size_t begin, size_t end)
+    {
+        const float maxVal = MinMaxRange<true>(a, begin, end);
+        const Vec vMax = V::Set1(maxVal);
+        typename V::VecD acc = V::ZeroD();
+        size_t i = begin;
+        for (; i + V::width <= end; i += V::width)
+        {
+            Vec e = V::Exp(V::Sub(V::Load(a + i), vMax));
+            acc = V::AddD(acc, V::AddD(V::ToDoubleLo(e), V::ToDoubleHi(e)));
+        }
+        double lanes[V::width / 2];
+        V::StoreD(lanes, acc);
+        double sum = 0;
+        for (size_t k = 0; k < V::width / 2; k++)
+            sum += lanes[k];
+        for (; i < end; i++)
+            sum += exp((double) a[i] - maxVal);
+        return maxVal + log(sum);
+    }
+
+    static double ReduceRange(ElementWiseOperator reductionOp, const float* a, size_t begin, size_t end)
+    {
+        switch (reductionOp)
+        {
+        case ElementWiseOperator::opSum:    return SumRange(a, begin, end);
+        case ElementWiseOperator::opMax:    return MinMaxRange<true>(a, begin, end);
+        case ElementWiseOperator::opMin:    return MinMaxRange<false>(a, begin, end);
+        case ElementWiseOperator::opLogSum: return LogSumRange(a, begin, end);
+        default: LogicError("Reduce: unexpected reduction op %d.", (int) reductionOp);
+        }
+    }
+
+    static bool Reduce(ElementWiseOperator reductionOp, const float* a, size_t n, double& result)
+    {
+        if (n == 0 ||
+            (reductionOp != ElementWiseOperator::opSum && reductionOp != ElementWiseOperator::opMax &&
+             reductionOp != ElementWiseOperator::opMin && reductionOp != ElementWiseOperator::opLogSum))
+            return false;
+
+        if (n < ParallelThreshold)
+        {
+            result = ReduceRange(reductionOp, a, 0, n);
+            return true;
+        }
+
+        // reduce chunks in parallel, then combine the partial results on this thread
+        const int numChunks = (int) ((n + ChunkSize - 1) / ChunkSize);
+        std::vector<double> partials(numChunks);
+#pragma omp parallel for
+        for (int chunk = 0; chunk < numChunks; chunk++)
+        {
+            size_t begin = chunk * ChunkSize;
+            partials[chunk] = ReduceRange(reductionOp, a, begin, std::min(begin + ChunkSize, n));
+        }
+        double aggregate = partials[0];
+        for (int chunk = 1; chunk < numChunks; chunk++)
+        {
+            switch (reductionOp)
+            {
+            case ElementWiseOperator::opSum:    aggregate = OpSum(aggregate, partials[chunk]); break;
+            case ElementWiseOperator::opMax:    aggregate = OpMax(aggregate, partials[chunk]); break;
+            case ElementWiseOperator::opMin:    aggregate = OpMin(aggregate, partials[chunk]); break;
+            case ElementWiseOperator::opLogSum: aggregate = OpLogSum(aggregate, partials[chunk]); break;
+            default: break;
+            }
+        }
+        result = aggregate;
+        return true;
+    }
+
+    // --- reduction across a strided dimension, vectorized along the contiguous one
+
+    static void SumAcrossBlock(float beta, const float* a, ptrdiff_t strideJ, size_t m, float alpha, float* c, size_t i)
+    {
+        // accumulate in double, in the same order over j as the generic path; hence bit-identical results
+        typename V::VecD acc0 = V::ZeroD(), acc1 = V::ZeroD();
+        const float* p = a + i;
+        for (size_t j = 0; j < m; j++, p += strideJ)
+        {
+            Vec v = V::Load(p);
+            acc0 = V::AddD(acc0, V::ToDoubleLo(v));
+            acc1 = V::AddD(acc1, V::ToDoubleHi(v));
+        }
+        double sums[V::width];
+        V::StoreD(sums, acc0);
+        V::StoreD(sums + V::width / 2, acc1);
+        for (size_t k = 0; k < V::width; k++)
+            StoreResult(c + i + k, (float) sums[k], beta, alpha);
+    }
+
+    template <bool isMax>
+    static void MinMaxAcrossBlock(float beta, const float* a, ptrdiff_t strideJ, size_t m, float alpha, float* c, size_t i)
+    {
+        const float* p = a + i;
+        Vec acc = V::Load(p);
+        for (size_t j = 1; j < m; j++)
+        {
+            p += strideJ;
+            acc = isMax ? V::Max(acc, V::Load(p)) : V::Min(acc, V::Load(p));
+        }
+        StoreResult(c + i, acc, beta, V::Set1(alpha), V::Set1(beta));
+    }
+
+    static bool ReduceAcross(ElementWiseOperator reductionOp, float beta, const float* a, ptrdiff_t strideJ, size_t m, float alpha, float* c, size_t n)
+    {
+        if (m == 0 ||
+            (reductionOp != ElementWiseOperator::opSum && reductionOp != ElementWiseOperator::opMax && reductionOp != ElementWiseOperator::opMin))
+            return false;
+
+        const int numBlocks = (int) (n / V::width);
+        auto doBlock = [&](int block)
+        {
+            size_t i = block * V::width;
+            switch (reductionOp)
+            {
+            case ElementWiseOperator::opSum: SumAcrossBlock(beta, a, strideJ, m, alpha, c, i); break;
+            case ElementWiseOperator::opMax: MinMaxAcrossBlock<true>(beta, a, strideJ, m, alpha, c, i); break;
+            default:                         MinMaxAcrossBlock<false>(beta, a, strideJ, m, alpha, c, i); break;
+            }
+        };
+        if (n * m < ParallelThreshold)
+        {
+            for (int block = 0; block < numBlocks; block++)
+                doBlock(block);
+        }
+        else
+        {
+#pragma omp parallel for
+            for (int block = 0; block < numBlocks; block++)
+                doBlock(block);
+        }
+
+        // tail rows
+        for (size_t i = numBlocks * V::width; i < n; i++)
+        {
+            double aggregate = a[i];
+            for (size_t j = 1; j < m; j++)
+            {
+                double val = a[i + j * strideJ];
+                switch (reductionOp)
+                {
+                case ElementWiseOperator::opSum: aggregate = OpSum(aggregate, val); break;
+                case ElementWiseOperator::opMax: aggregate = OpMax(aggregate, val); break;
+                default:                         aggregate = OpMin(aggregate, val); break;
+                }
+            }
+            StoreResult(c + i, (float) aggregate, beta, alpha);
+        }
+        return true;
+    }
+
+    // --- fused softmax + cross entropy of a single column
+
+    // Two passes over x: max and the label terms, then the sum of exp(x - max). Sums are accumulated in double.
+    static void SoftmaxCrossEntropy(const float* x, const float* y, size_t n, float& logSumExp, double& crossEntropy)
+    {
+        size_t i = 0;
+        float maxVal = x[0];
+        double labelSum = 0, labelDot = 0;
+        if (n >= V::width)
+        {
+            Vec vMax = V::Load(x);
+            typename V::VecD sum0 = V::ZeroD(), sum1 = V::ZeroD(), dot0 = V::ZeroD(), dot1 = V::ZeroD();
+            for (; i + V::width <= n; i += V::width)
+            {
+                Vec vx = V::Load(x + i), vy = V::Load(y + i);
+                vMax = V::Max(vMax, vx);
+                // zero labels must not pick up NaN/Inf from columns that are gaps
+                Vec vyx = V::SelectNonZero(vy, V::Mul(vy, vx));
+                sum0 = V::AddD(sum0, V::ToDoubleLo(vy));
+                sum1 = V::AddD(sum1, V::ToDoubleHi(vy));
+                dot0 = V::AddD(dot0, V::ToDoubleLo(vyx));
+                dot1 = V::AddD(dot1, V::ToDoubleHi(vyx));
+            }
+            float lanes[V::width];
+            V::Store(lanes, vMax);
+            for (size_t k = 0; k < V::width; k++)
+                maxVal = lanes[k] > maxVal ? lanes[k] : maxVal;
+            double lanesD[V::width / 2];
+            V::StoreD(lanesD, V::AddD(sum0, sum1));
+            for (size_t k = 0; k < V::width / 2; k++)
+                labelSum += lanesD[k];
+            V::StoreD(lanesD, V::AddD(dot0, dot1));
+            for (size_t k = 0; k < V::width / 2; k++)
+                labelDot += lanesD[k];
+        }
+        for (; i < n; i++)
+        {
+            maxVal = x[i] > maxVal ? x[i] : maxVal;
+            labelSum += y[i];
+            if (y[i] != 0)
+                labelDot += (double) y[i] * x[i];
+        }
+
+        const Vec vMax = V::Set1(maxVal);
+        typename V::VecD acc = V::ZeroD();
+        for (i = 0; i + V::width <= n; i += V::width)
+        {
+            Vec e = V::Exp(V::Sub(V::Load(x + i), vMax));
+            acc = V::AddD(acc, V::AddD(V::ToDoubleLo(e), V::ToDoubleHi(e)));
+        }
+        double lanesD[V::width / 2];
+        V::StoreD(lanesD, acc);
+        double expSum = 0;
+        for (size_t k = 0; k < V::width / 2; k++)
+            expSum += lanesD[k];
+        for (; i < n; i++)
+            expSum += exp((double) x[i] - maxVal);
+
+        const double lse = maxVal + log(expSum);
+        logSumExp = (float) lse;
+        crossEntropy = (labelSum != 0 ? labelSum * lse : 0) - labelDot;
+    }
+
+    static void SoftmaxCrossEntropyGradient(float alpha, const float* x, const float* y, float logSumExp, float* g, size_t n)
+    {
+        const Vec vAlpha = V::Set1(alpha), vLogSumExp = V::Set1(logSumExp);
+        size_t i = 0;
+        for (; i + V::width <= n; i += V::width)
+        {
+            Vec softmax = V::Exp(V::Sub(V::Load(x + i), vLogSumExp));
+            V::Store(g + i, V::Add(V::Load(g + i), V::Mul(vAlpha, V::Sub(softmax, V::Load(y + i)))));
+        }
+        for (; i < n; i++)
+            g[i] += alpha * (expf(x[i] - logSumExp) - y[i]);
+    }
+
+    static const CPUVectorizedKernels* Get()
+    {
+        static const CPUVectorizedKernels kernels = { &UnaryOp, &BinaryOp, &Reduce, &ReduceAcross, &SoftmaxCrossEntropy, &SoftmaxCrossEntropyGradient };
+        return &kernels;
+    }
+};
+
+}}}}
@@ -0,0 +1,194 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CachingDeviceAllocator.cpp -- size-class, stream-aware cache of device memory blocks
+//
+
+#include "stdafx.h"
+#include "CachingDeviceAllocator.h"
+#include <algorithm>
+#include <iterator>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+CachingDeviceAllocator::CachingDeviceAllocator(RawAllocate rawAllocate, RawFree rawFree)
+    : m_rawAllocate(rawAllocate), m_rawFree(rawFree)
+{
+}
+
+/*static*/ size_t CachingDeviceAllocator::RoundSize(size_t numBytes)
+{
+    if (numBytes <= s_smallBlockLimit)
+        return std::max<size_t>((numBytes + s_minBlockSize - 1) / s_minBlockSize, 1) * s_minBlockSize;
+    // 8 classes per power of two, i.e. at most 12.5% lost to rounding
+    size_t powerOfTwo = s_smallBlockLimit;
+    while (powerOfTwo <= numBytes / 2)
+        powerOfTwo *= 2;
+    const size_t granularity = powerOfTwo / 8;
+    return (numBytes + granularity - 1) / granularity * granularity;
+}
+
+void* CachingDeviceAllocator::Allocate(size_t numBytes, const void* stream)
+{
+    const size_t size = RoundSize(numBytes);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.numAllocations++;
+
+    // best fit among the blocks of this stream that are not too large
+    void* p = nullptr;
+    size_t blockSize = size;
+    auto iter = m_cachedBlocks.lower_bound(CachedBlock(stream, size, nullptr));
+    if (iter != m_cachedBlocks.end() && std::get<0>(*iter) == stream && std::get<1>(*iter) <= size + size / 4)
+    {
+        blockSize = std::get<1>(*iter);
+        p = std::get<2>(*iter);
+        m_cachedBlocks.erase(iter);
+        m_statistics.cachedBytes -= blockSize;
+        m_statistics.numCacheHits++;
+    }
+    else
+    {
+        p = m_rawAllocate(size);
+        if (!p && !m_cachedBlocks.empty())
+        {
+            ReleaseCachedBlocks();
+            p = m_rawAllocate(size);
+        }
+        if (!p)
+            return nullptr;
+        m_statistics.numRawAllocations++;
+        m_statistics.reservedBytes += size;
+        m_statistics.peakReservedBytes = std::max(m_statistics.peakReservedBytes, m_statistics.reservedBytes);
+    }
+
+    m_blocksInUse[p] = Block{ blockSize, numBytes, stream };
+    m_statistics.allocatedBytes += blockSize;
+    m_statistics.requestedBytes += numBytes;
+    m_statistics.peakAllocatedBytes = std::max(m_statistics.peakAllocatedBytes, m_statistics.allocatedBytes);
+    return p;
+}
+
+bool CachingDeviceAllocator::Free(void* p)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_blocksInUse.find(p);
+    if (iter == m_blocksInUse.end())
+        return false;
+    const Block block = iter->second;
+    m_blocksInUse.erase(iter);
+    if (m_capturing) // the graph being captured may use it
+    {
+        m_blocksFreedInCapture.push_back(std::make_pair(p, block));
+        return true;
+    }
+    auto captures = m_blocksUsedByCaptures.equal_range(p);
+    for (auto capture = captures.first; capture != captures.second; capture++)
+        m_captures[capture->second].isValid = false;
+    m_blocksUsedByCaptures.erase(captures.first, captures.second);
+    CacheBlock(p, block);
+    return true;
+}
+
+// caller holds the lock
+void CachingDeviceAllocator::CacheBlock(void* p, const Block& block)
+{
+    m_cachedBlocks.insert(CachedBlock(block.stream, block.size, p));
+    m_statistics.allocatedBytes -= block.size;
+    m_statistics.requestedBytes -= block.requestedSize;
+    m_statistics.cachedBytes += block.size;
+}
+
+void CachingDeviceAllocator::BeginCapture()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_capturing)
+        LogicError("CachingDeviceAllocator: Only one capture can be in progress.");
+    m_capturing = true;
+}
+
+size_t CachingDeviceAllocator::EndCapture()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_capturing)
+        LogicError("CachingDeviceAllocator: EndCapture() without BeginCapture().");
+    m_capturing = false;
+    const size_t captureId = m_nextCaptureId++;
+    Capture& capture = m_captures[captureId];
+    capture.freedBlocks.swap(m_blocksFreedInCapture);
+    capture.usedBlocks.reserve(m_blocksInUse.size());
+    for (const auto& block : m_blocksInUse)
+    {
+        capture.usedBlocks.push_back(block.first);
+        m_blocksUsedByCaptures.insert(std::make_pair(block.first, captureId));
+    }
+    capture.isValid = true;
+    return captureId;
+}
+
+bool CachingDeviceAllocator::IsCaptureValid(size_t captureId) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_captures.find(captureId);
+    return iter != m_captures.end() && iter->second.isValid;
+}
+
+void CachingDeviceAllocator::ReleaseCapture(size_t captureId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_captures.find(captureId);
+    if (iter == m_captures.end())
+        LogicError("CachingDeviceAllocator: Unknown capture %d.", (int) captureId);
+    for (void* p : iter->second.usedBlocks)
+    {
+        auto captures = m_blocksUsedByCaptures.equal_range(p);
+        for (auto capture = captures.first; capture != captures.second;)
+            capture = capture->second == captureId ? m_blocksUsedByCaptures.erase(capture) : std::next(capture);
+    }
+    // Kernels on the stream of a block run in order; graph launches that use it are issued to the same stream.
+    for (const auto& block : iter->second.freedBlocks)
+        CacheBlock(block.first, block.second);
+    m_captures.erase(iter);
+}
+
+bool CachingDeviceAllocator::IsCapturing() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capturing;
+}
+
+void CachingDeviceAllocator::EmptyCache()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ReleaseCachedBlocks();
+}
+
+// caller holds the lock
+void CachingDeviceAllocator::ReleaseCachedBlocks()
+{
+    while (!m_cachedBlocks.empty())
+    {
+        auto iter = m_cachedBlocks.begin();
+        const size_t size = std::get<1>(*iter);
+        m_rawFree(std::get<2>(*iter));
+        m_cachedBlocks.erase(iter);
+        m_statistics.cachedBytes -= size;
+        m_statistics.reservedBytes -= size;
+        m_statistics.numRawFrees++;
+    }
+}
+
+DeviceMemoryStatistics CachingDeviceAllocator::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void CachingDeviceAllocator::ResetPeakStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.peakAllocatedBytes = m_statistics.allocatedBytes;
+    m_statistics.peakReservedBytes = m_statistics.reservedBytes;
+}
+
+}}}
@@ -0,0 +1,103 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CachingDeviceAllocator.h -- size-class, stream-aware cache of device memory blocks
+//
+// cudaMalloc() and cudaFree() synchronize the device, and with minibatches of varying size GPU matrices are resized
+// all the time. Freed blocks are therefore kept and handed out again for requests of a similar size:
+//  - Requests are rounded up to a size class: multiples of 512 bytes up to 1 MB, above that 8 classes per power of two.
+//    A cached block is reused for a request whose size class is at most 25% smaller than the block.
+//  - Blocks are cached per stream, and reused only for allocations on the stream they were allocated on. Kernels on one
+//    stream run in order, so a block can be reused as soon as it is freed, without waiting for pending kernels that use it.
+//    Memory used by kernels on other streams must be synchronized by the user before it is freed, as for cudaFree().
+//  - If the device runs out of memory, all cached blocks are released and the allocation is retried.
+// Blocks are never split or merged. The memory lost to rounding up is reported as fragmented.
+//
+// CUDA graphs (CudaGraph.h) replay kernels with the addresses they were captured with. Blocks freed during a capture are
+// therefore kept for the graph until ReleaseCapture(), instead of being handed out again. A graph may also use blocks that
+// were allocated before and are still in use when capture ends; freeing any of those invalidates the capture.
+//
+// This class does not depend on CUDA; the raw allocation functions are passed in (TracingGPUMemoryAllocator in GPUMatrix.cu).
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <functional>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API CachingDeviceAllocator
+{
+public:
+    typedef std::function<void*(size_t numBytes)> RawAllocate; // returns nullptr if out of memory, throws for other errors
+    typedef std::function<void(void* p)> RawFree;
+
+    CachingDeviceAllocator(RawAllocate rawAllocate, RawFree rawFree);
+    // does not release the cached blocks: the device may be gone by the time this runs at process exit
+    ~CachingDeviceAllocator() {}
+
+    // returns nullptr if the device is out of memory even after releasing the cache
+    void* Allocate(size_t numBytes, const void* stream);
+    // returns false if p was not allocated here
+    bool Free(void* p);
+    // releases all cached blocks to the device
+    void EmptyCache();
+
+    // CUDA graph capture, one capture at a time; EndCapture() returns the id of the capture
+    void BeginCapture();
+    size_t EndCapture();
+    // false once a block that was in use when the capture ended has been freed
+    bool IsCaptureValid(size_t captureId) const;
+    // returns the blocks kept for a capture to the cache; the graph must not be launched anymore
+    void ReleaseCapture(size_t captureId);
+    bool IsCapturing() const;
+
+    DeviceMemoryStatistics GetStatistics() const;
+    void ResetPeakStatistics();
+
+    // size class of a request
+    static size_t RoundSize(size_t numBytes);
+    static const size_t s_minBlockSize = 512;
+    static const size_t s_smallBlockLimit = 1 << 20;
+
+private:
+    struct Block
+    {
+        size_t size;
+        size_t requestedSize;
+        const void* stream;
+    };
+    typedef std::tuple<const void*, size_t, void*> CachedBlock; // (stream, size, pointer), ordered for best fit per stream
+
+    struct Capture
+    {
+        std::vector<std::pair<void*, Block>> freedBlocks; // kept for the graph
+        std::vector<void*> usedBlocks;                    // in use when the capture ended
+        bool isValid;
+    };
+
+    void ReleaseCachedBlocks();
+    void CacheBlock(void* p, const Block& block);
+
+    RawAllocate m_rawAllocate;
+    RawFree m_rawFree;
+    mutable std::mutex m_mutex;
+    std::unordered_map<void*, Block> m_blocksInUse;
+    std::set<CachedBlock> m_cachedBlocks;
+    DeviceMemoryStatistics m_statistics;
+    bool m_capturing = false;
+    std::vector<std::pair<void*, Block>> m_blocksFreedInCapture;
+    size_t m_nextCaptureId = 0;
+    std::unordered_map<size_t, Capture> m_captures;
+    std::unordered_multimap<void*, size_t> m_blocksUsedByCaptures; // block -> id of a valid capture that uses it
+};
+
+}}}
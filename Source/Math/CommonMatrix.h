@@ -15,11 +15,14 @@
 
 #include "Basics.h"
 #include "basetypes.h"
+#include "CPUHugePageAllocator.h"
 #include <string>
 #include <stdint.h>
 #include <memory>
+#include <functional>
 #include <unordered_map>
 #include <map>
+#include <vector>
 
 #pragma warning( disable: 4251 )
 typedef unsigned char byte;
@@ -46,15 +49,45 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 MATH_API void SetMathLibTraceLevel(int traceLevel);
 MATH_API int GetMathLibTraceLevel();
 
+// device memory held by the cache of freed blocks of one GPU (see CachingDeviceAllocator.h)
+struct DeviceMemoryStatistics
+{
+    size_t requestedBytes = 0;     // in use, as requested
+    size_t allocatedBytes = 0;     // in use, as rounded up to the block sizes
+    size_t cachedBytes = 0;        // freed and kept for reuse
+    size_t reservedBytes = 0;      // obtained from the device: allocated + cached
+    size_t peakAllocatedBytes = 0;
+    size_t peakReservedBytes = 0;
+    size_t numAllocations = 0;
+    size_t numCacheHits = 0;       // allocations served from the cache
+    size_t numRawAllocations = 0;  // cudaMalloc() calls
+    size_t numRawFrees = 0;        // cudaFree() calls
+
+    // lost to rounding up the requests to the block sizes
+    size_t FragmentedBytes() const { return allocatedBytes - requestedBytes; }
+};
+
 class MATH_API TracingGPUMemoryAllocator
 {
 private:
     static int m_traceLevel;
+    static bool m_cachingEnabled;
 
 public:
     static void SetTraceLevel(int traceLevel);
     static bool IsTraceEnabled();
 
+    // Freed device memory is cached for reuse by default. Blocks allocated while caching was enabled go back to the cache.
+    static void SetCachingEnabled(bool enabled);
+    static bool IsCachingEnabled();
+    // releases the cached blocks of a GPU, or of all GPUs for deviceId < 0
+    static void EmptyCache(int deviceId = -1);
+    static DeviceMemoryStatistics GetMemoryStatistics(int deviceId);
+    // restarts the peaks of the statistics of a GPU from the bytes in use now, or of all GPUs for deviceId < 0
+    static void ResetPeakMemoryStatistics(int deviceId = -1);
+    // prints the statistics of a GPU, or of all GPUs that have allocated memory for deviceId < 0
+    static void PrintMemoryStatistics(int deviceId = -1);
+
     template <typename AllocatedElemType>
     static AllocatedElemType* Allocate(int deviceId, size_t numRows, size_t numCols);
 
@@ -73,6 +106,56 @@ private:
     static AllocatedElemType* AllocateNoTrace(int deviceId, size_t numElements);
 };
 
+// Audit of the transfers of matrices between the CPU and the GPUs (Matrix::TransferToDeviceIfNotThere() and the operations
+// that move an operand to the device of the others). A node without a GPU implementation (e.g. CRF, EditDistance, LambdaRank)
+// typically costs two of them per minibatch, each a synchronization with the GPU, which nobody notices. In Count mode the
+// transfers are counted and timed per scope, which the computation network sets to the node it computes; in Fail mode
+// a transfer within a scope throws, and the ones outside of scopes (e.g. when loading a model) are counted.
+class MATH_API MatrixTransferAudit
+{
+public:
+    enum class Mode
+    {
+        Off,
+        Count,
+        Fail
+    };
+
+    struct Statistics
+    {
+        size_t numTransfers = 0;
+        size_t bytes = 0;
+        double seconds = 0;
+    };
+
+    // "none", "count" or "fail"
+    static Mode ParseMode(const std::wstring& mode);
+    static void SetMode(Mode mode);
+    static Mode GetMode();
+
+    // The transfers of this thread are accounted to "<action> <name>" while the scope exists, e.g. "ForwardProp CRF1".
+    // The strings are referenced, not copied.
+    class MATH_API Scope
+    {
+    public:
+        Scope(const wchar_t* action, const std::wstring& name);
+        ~Scope();
+
+    private:
+        const wchar_t* m_previousAction;
+        const std::wstring* m_previousName;
+    };
+
+    // called by Matrix before and after a transfer
+    static void CheckTransfer(int fromDeviceId, int toDeviceId, size_t numRows, size_t numCols);
+    static void RecordTransfer(int fromDeviceId, int toDeviceId, size_t bytes, double seconds);
+
+    // the statistics per scope and direction since the last call, e.g. "ForwardProp CRF1: GPU0 -> CPU"
+    static std::map<std::wstring, Statistics> TakeStatistics();
+    // prints TakeStatistics() to stderr, the most expensive first
+    static void PrintStatistics();
+};
+
 // -----------------------------------------------------------------------
 // ElementWiseOperator -- This enum represents which function to apply.
 // This is shared between all matrix types and tensors.
@@ -179,6 +262,185 @@ enum ElementWiseOperator
     Macro(ElementwiseProductWithPowExponentDerivative); \
     Macro(ElementwiseProductWithPowBaseDerivative);
 
+// -----------------------------------------------------------------------
+// ElementwiseProgram -- a straight-line sequence of elementwise operations that is
+// evaluated per element by a single tensor kernel (TensorView::DoElementwiseProgramOf()).
+// Registers [0, m_numInputs) hold the input values; instruction i writes register
+// m_numInputs + i. The result is the register written by the last instruction.
+// It is trivially copyable so that it can be passed to CUDA kernels by value.
+// -----------------------------------------------------------------------
+
+struct ElementwiseProgram
+{
+    static const size_t MaxInputs = 6;
+    static const size_t MaxInstructions = 40;
+    static const size_t MaxRegisters = MaxInputs + MaxInstructions;
+
+    struct Instruction
+    {
+        ElementWiseOperator m_op;
+        unsigned char m_args[3]; // register indices; only the first 1, 2, or 3 are used, depending on the arity of m_op
+    };
+
+    unsigned char m_numInputs;
+    unsigned char m_numInstructions;
+    Instruction m_instructions[MaxInstructions];
+
+    ElementwiseProgram(size_t numInputs = 0)
+        : m_numInputs((unsigned char) numInputs), m_numInstructions(0)
+    {
+        if (numInputs > MaxInputs)
+            InvalidArgument("ElementwiseProgram: At most %d inputs are supported.", (int) MaxInputs);
+    }
+
+    // append an instruction; returns the register it writes
+    size_t Add(ElementWiseOperator op, size_t a, size_t b = 0, size_t c = 0)
+    {
+        if (IsFull())
+            LogicError("ElementwiseProgram: Too many instructions.");
+        if (GetArity(op) == 0)
+            InvalidArgument("ElementwiseProgram: Op code %d cannot be used in a program.", (int) op);
+        size_t result = m_numInputs + m_numInstructions;
+        if (a >= result || b >= result || c >= result)
+            LogicError("ElementwiseProgram: Instruction reads a register that has not been written yet.");
+        Instruction& instruction = m_instructions[m_numInstructions++];
+        instruction.m_op = op;
+        instruction.m_args[0] = (unsigned char) a;
+        instruction.m_args[1] = (unsigned char) b;
+        instruction.m_args[2] = (unsigned char) c;
+        return result;
+    }
+
+    bool IsFull() const { return m_numInstructions == MaxInstructions; }
+    size_t GetNumRegisters() const { return (size_t) m_numInputs + m_numInstructions; }
+
+    // number of arguments of an elementwise op, or 0 for ops that cannot be part of a program
+    static size_t GetArity(ElementWiseOperator op)
+    {
+#define CaseArity(oper, arity)       \
+    case ElementWiseOperator::op##oper: \
+        return arity;
+#define CaseUnaryArity(oper)   CaseArity(oper, 1)
+#define CaseBinaryArity(oper)  CaseArity(oper, 2)
+#define CaseTernaryArity(oper) CaseArity(oper, 3)
+        switch (op)
+        {
+        ForAllUnaryOps(CaseUnaryArity)
+        ForAllBinaryOps(CaseBinaryArity)
+        ForAllTernaryOps(CaseTernaryArity)
+        default:
+            return 0;
+        }
+#undef CaseTernaryArity
+#undef CaseBinaryArity
+#undef CaseUnaryArity
+#undef CaseArity
+    }
+};
+
+// -----------------------------------------------------------------------
+// Lazy updates of block-sparse gradients (Matrix::AdamUpdate(), Matrix::FSAdagradUpdate()
+// with lazy=true) only update the columns that are present in the gradient, e.g. the rows
+// of an embedding that a minibatch looks up, instead of decaying the moments of all columns.
+// For the optional decay catch-up, a 1 x (numCols + 1) matrix holds the update count at
+// which each column was last updated, followed by the count itself; a column first decays
+// its moments by the updates since then. The count wraps at LazyUpdateStepPeriod, which
+// keeps it exact in float; by then the moments of an untouched column have long decayed.
+// -----------------------------------------------------------------------
+
+const size_t LazyUpdateStepPeriod = 1 << 22;
+
+// -----------------------------------------------------------------------
+// MultiTensorItem -- one parameter of a multi-tensor update (Matrix::MultiTensorUpdate()),
+// which updates a list of dense parameters of one device together, in a single kernel
+// launch per MultiTensorItem::MaxTensorsPerLaunch parameters on the GPU instead of
+// several per parameter. The scalars that differ between parameters are per item.
+// -----------------------------------------------------------------------
+
+enum class MultiTensorUpdateType
+{
+    SGD,                 // w -= lr * g
+    MomentumSGD,         // as Matrix::MomentumSGDUpdate()
+    NesterovMomentumSGD, // as Matrix::NesterovAcceleratedMomentumSGDUpdate()
+    Adam,                // as Matrix::AdamUpdate()
+};
+
+template <class ElemType>
+struct MultiTensorItem
+{
+    static const size_t MaxTensorsPerLaunch = 32; // the list is passed as kernel argument, which is limited to 4 KB
+
+    ElemType* value;            // the parameter
+    ElemType* gradient;         // replaced by gradientScale * gradient + l2Weight * value, which then updates the parameter
+    ElemType* smoothedGradient; // momentum; for Adam the smoothed squares followed by the momentum; unused for SGD
+    size_t numElements;         // of value and gradient
+    ElemType gradientScale;     // e.g. mean gradient, loss scale and clipping
+    ElemType l2Weight;
+    ElemType learnRatePerSample;
+    ElemType adaMul;            // Adam only: the bias correction
+
+    // Merges neighbouring items whose matrices follow each other in memory and whose scalars are the same (e.g. the
+    // parameters in flat buffers, see ComputationNetwork::AllocateFlatParameterBuffers()), so that they are one item.
+    // Not for Adam, which keeps the two halves of the smoothed gradient of an item together.
+    static void Coalesce(std::vector<MultiTensorItem>& items, MultiTensorUpdateType type)
+    {
+        if (type == MultiTensorUpdateType::Adam || items.empty())
+            return;
+        size_t last = 0;
+        for (size_t i = 1; i < items.size(); i++)
+        {
+            auto& prev = items[last];
+            const auto& item = items[i];
+            if (item.value == prev.value + prev.numElements && item.gradient == prev.gradient + prev.numElements &&
+                (type == MultiTensorUpdateType::SGD || item.smoothedGradient == prev.smoothedGradient + prev.numElements) &&
+                item.gradientScale == prev.gradientScale && item.l2Weight == prev.l2Weight && item.learnRatePerSample == prev.learnRatePerSample)
+                prev.numElements += item.numElements;
+            else
+                items[++last] = item;
+        }
+        items.resize(last + 1);
+    }
+};
+
+// -----------------------------------------------------------------------
+// DepthwiseConvolutionShape -- a 2D convolution of [W x H x C] samples whose C channels are
+// split into 'groups' groups of C / groups channels, each group convolved with 'multiplier'
+// kernels of its own (Matrix::DepthwiseConvolutionForward() etc., used by the depthwise
+// convolution engine). Depthwise convolution is the case of one channel per group.
+// As laid out by ConvolveGeometry with sharing off along the channels, output channel
+// k = g + groups * m is the convolution of group g with kernel k, a [X x Y x C / groups]
+// tensor. Output (x', y') reads the input from (x' * strideW - padW, y' * strideH - padH) on.
+// It is trivially copyable so that it can be passed to CUDA kernels by value.
+// -----------------------------------------------------------------------
+
+struct DepthwiseConvolutionShape
+{
+    int inW, inH, inC;
+    int outW, outH;
+    int kernelW, kernelH;
+    int strideW, strideH;
+    int padW, padH;
+    int groups;
+    int multiplier;
+};
+
+// -----------------------------------------------------------------------
+// PackedSequenceRange -- a sequence of a packed minibatch (MBLayout, column t * numParallelSequences + s),
+// and where its time steps map to in a target, for Matrix::AssignPackedIndicesOf(). This is what the gather
+// and scatter indices of the dynamic-axis operations are made of, so that they can be computed on the device
+// from one entry per sequence instead of being built and copied one entry per column.
+// -----------------------------------------------------------------------
+
+struct PackedSequenceRange
+{
+    int s;            // parallel sequence that holds the sequence
+    int tBegin, tEnd; // its time steps there; those outside of the minibatch have no column
+    int targetColumn; // target column of time step 0
+    int targetLength; // number of time steps of the target, valid (time) indices are [0, targetLength)
+};
+
+struct ImageAugmentation; // see ImageAugmentation.h
+
 // -----------------------------------------------------------------------
 // various enums to describe
 // -----------------------------------------------------------------------
@@ -191,6 +453,7 @@ enum MatrixFlagBitPosition
     bitPosCompressed = 2,       // a compressed sparse format (CSC/CSR)
     bitPosDontOwnBuffer = 3,    // buffer is not owned by this matrix
     bitPosSetValueOnDevice = 4, // in a setValue situation, the copy from buffer is already on the device
+    bitPosMovableBuffer = 5,    // the matrix may leave the buffer that it does not own
 };
 
 enum MatrixFormat
@@ -218,6 +481,7 @@ enum MatrixFlags
     matrixFlagNormal = 0,
     matrixFlagDontOwnBuffer = 1 << bitPosDontOwnBuffer,       // the matrix memory pointers are externally managed, don't allocate/free or attempt to copy to another location
     matrixFlagSetValueOnDevice = 1 << bitPosSetValueOnDevice, // SetValue() call has a buffer that is already on the device
+    matrixFlagMovableBuffer = 1 << bitPosMovableBuffer,       // with matrixFlagDontOwnBuffer: Resize() reshapes within the buffer, and moves to a buffer of its own if it needs more
 };
 
 // -----------------------------------------------------------------------
@@ -253,11 +517,14 @@ public:
 
     void ReleaseMemory()
     {
-        if (!m_externalBuffer)
+        if (m_externalBuffer)
+            ReleaseExternalBuffer();
+        else
         {
             if (m_computeDevice < 0)
             {
-                delete[] m_pArray;
+                if (!CPUHugePageAllocator::Free(m_pArray)) // large dense buffers may come from huge pages, see CPUMatrix
+                    delete[] m_pArray;
                 m_pArray = nullptr;
                 m_nzValues = nullptr;
 
@@ -291,11 +558,23 @@ public:
         }
     }
 
+    // hands the external buffer back to its owner, once
+    void ReleaseExternalBuffer()
+    {
+        if (m_externalBufferReleaser)
+        {
+            auto releaser = std::move(m_externalBufferReleaser);
+            m_externalBufferReleaser = nullptr;
+            releaser();
+        }
+    }
+
 protected:
     MatrixFormat GetFormat() const { return m_format; }
     void SetFormat(MatrixFormat format) { m_format = format; }
 
     bool HasExternalBuffer() const { return m_externalBuffer; }
+    bool HasMovableBuffer() const { return m_movableBuffer; }
 
     DEVICEID_TYPE GetComputeDeviceId() const { return m_computeDevice; }
     void SetComputeDeviceId(const DEVICEID_TYPE computeId) const { m_computeDevice = computeId; }
@@ -313,7 +592,14 @@ protected:
     bool IsEmpty() const { return m_numRows == 0 || m_numCols == 0; }
 
     ElemType* Buffer() const { return m_pArray; }
-    void SetBuffer(ElemType* pArray, size_t alloc, bool external = false) { m_pArray = pArray; m_totalBufferSizeAllocated = alloc; m_externalBuffer = external; }
+    void SetBuffer(ElemType* pArray, size_t alloc, bool external = false, bool movable = false)
+    {
+        if (m_externalBuffer && pArray != m_pArray)
+            ReleaseExternalBuffer();
+        m_pArray = pArray; m_totalBufferSizeAllocated = alloc; m_externalBuffer = external; m_movableBuffer = external && movable;
+    }
+
+    void SetExternalBufferReleaser(std::function<void()> releaser) { m_externalBufferReleaser = std::move(releaser); }
 
     size_t BufferSizeAllocated() const { return m_totalBufferSizeAllocated; }
     
@@ -362,6 +648,7 @@ protected:
     void ZeroInit(const MatrixFormat matrixFormat = matrixFormatDense, const DEVICEID_TYPE computeDevice = -1)
     {
         m_externalBuffer           = false;
+        m_movableBuffer            = false;
         m_format                   = matrixFormat;
         m_computeDevice            = computeDevice;
         m_numRows                  = 0;
@@ -390,6 +677,8 @@ protected:
     MatrixFormat m_format;
     mutable DEVICEID_TYPE m_computeDevice; // current GPU device Id or CPUDEVICE
     bool m_externalBuffer; // is the buffer used by this matrix,
+    bool m_movableBuffer;  // external buffer that Resize() may replace by one of our own (matrixFlagMovableBuffer)
+    std::function<void()> m_externalBufferReleaser; // called when the external buffer is no longer used, i.e. when the storage is destroyed or replaces it
 
     // m_numRows and m_numCols should be removed
     size_t m_numRows;
@@ -452,7 +741,7 @@ public:
     { 
         if (!m_sob.unique())
             LogicError("%s: Cannot resize the matrix because it is a view.", function);
-        else if (m_sob->HasExternalBuffer())
+        else if (m_sob->HasExternalBuffer() && !m_sob->HasMovableBuffer())
             LogicError("%s: Cannot resize the matrix because it is externally owned.", function);
     }
 
@@ -487,6 +776,14 @@ public:
 
     bool OwnBuffer() const { return !HasExternalBuffer(); }
 
+    // Calls 'releaser' when the external buffer is no longer referenced by any matrix, including views that share the storage.
+    void SetExternalBufferReleaser(std::function<void()> releaser)
+    {
+        if (!HasExternalBuffer())
+            LogicError("SetExternalBufferReleaser: The matrix does not have an external buffer.");
+        m_sob->SetExternalBufferReleaser(std::move(releaser));
+    }
+
     bool IsEmpty() const { return m_numRows == 0 || m_numCols == 0; }
 
     size_t GetSizeAllocated() const { return m_sob->GetSizeAllocated(); }
@@ -515,7 +812,7 @@ protected:
     void SetSizeAllocated(size_t alloc) { m_sob->SetSizeAllocated(alloc); }
 
     ElemType* Buffer() const { return m_sob->Buffer(); }
-    void SetBuffer(ElemType* parray, size_t alloc, bool external = false) { m_sob->SetBuffer(parray, alloc, external); }
+    void SetBuffer(ElemType* parray, size_t alloc, bool external = false, bool movable = false) { m_sob->SetBuffer(parray, alloc, external, movable); }
 
     
     size_t GetBlockSize() const { return m_sob->GetBlockSize(); }
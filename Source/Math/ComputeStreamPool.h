@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ComputeStreamPool.h -- CUDA streams for issuing independent computations concurrently from one host thread
+//
+// All GPU work is issued to the current stream (SetStream()/GetStream() in GPUMatrix.h; the cuBLAS, cuSPARSE and cuDNN
+// handles follow it). Between BeginRegion() and EndRegion() work can be issued to the streams of a pool instead:
+//
+//     pool->BeginRegion();    // the streams wait for the work issued to the current ("main") stream so far
+//     pool->SelectStream(0); ...; pool->RecordEvent(e);
+//     pool->SelectStream(1); pool->WaitForEvent(e); ...  // stream 1 waits for the work issued to stream 0 up to RecordEvent(e)
+//     pool->EndRegion();      // the main stream waits for all streams, and is the current stream again
+//
+// The streams are blocking streams: work that libraries issue to the legacy default stream still synchronizes with them.
+// Memory that is used on more than one stream within a region must not be freed or reused before EndRegion().
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API ComputeStreamPool
+{
+public:
+    // the pool of 'deviceId', with at least 'numStreams' streams; nullptr for CPU devices and in CPU-only builds
+    static std::shared_ptr<ComputeStreamPool> Get(DEVICEID_TYPE deviceId, size_t numStreams);
+
+    // the current stream of the calling thread (cudaStream_t), e.g. to time the work issued to it; nullptr in CPU-only builds
+    static void* CurrentStream();
+
+    ~ComputeStreamPool();
+
+    size_t NumStreams() const { return m_streams.size(); }
+    bool IsInRegion() const { return m_inRegion; }
+
+    void BeginRegion();
+    void SelectStream(size_t stream);
+    // events are identified by consecutive numbers starting at 0 in each region
+    void RecordEvent(size_t event);
+    void WaitForEvent(size_t event);
+    void EndRegion();
+
+private:
+    ComputeStreamPool(DEVICEID_TYPE deviceId, size_t numStreams);
+    ComputeStreamPool(const ComputeStreamPool&) = delete;
+    ComputeStreamPool& operator=(const ComputeStreamPool&) = delete;
+
+    DEVICEID_TYPE m_deviceId;
+    std::vector<void*> m_streams;       // cudaStream_t
+    std::vector<void*> m_streamEvents;  // cudaEvent_t, the end of the work of each stream in a region
+    std::vector<bool> m_streamUsed;     // in the current region
+    std::vector<void*> m_events;        // cudaEvent_t, created on demand
+    void* m_regionBeginEvent;           // cudaEvent_t
+    void* m_mainStream;                 // cudaStream_t that was current at BeginRegion()
+    bool m_inRegion;
+};
+
+}}}
@@ -226,75 +226,91 @@ __device__ double round_(double a)
     return round(a);
 }
 
+// Threads per block of the ROI pooling kernels, which is also the number of ROIs per tile in the backward pass.
+static const int roiPoolingBlockSize = 256;
+
 // For each image, for each ROI, this function treats that ROI as an image
 // and does max pooling so that it has output size pooledHeight x pooledWidth.
-// The kernel operates on one location in the output tensor, computes which ROI
-// and image should populate that location, computes the subset of the image
-// corresponding to the ROI and which pixels in that subset should go into the
-// output location, then takes the max value over that window.
+// One block handles one ROI: it computes the input window of every output row and column once, in shared memory
+// (2 * (pooledHeight + pooledWidth) ints), and its threads then take the max over the window of one output location
+// each, for all channels.
 // src: Images              [W x H x C x N]
 // roiData: ROIs            [4 x numROIs x N], 
 // dst: Pooled ROIs         [PW x PH x C x numROIs x N]
 // argmax: max positions    [PW x PH x C x numROIs x N]
 // where PW = Pooled Width, PH = Pooled Height, C = Channels, N = Batch Size
 template <typename ElemType>
-__global__ void kROIPoolingForward(const int totalIterations,
-    const int numROIs, const int numImg,
+__global__ void kROIPoolingForward(const int numROIs,
     const int channels, const int width, const int height,
     const int pooledWidth, const int pooledHeight, const ElemType* src,
     const ElemType* roiData, ElemType* dst, ElemType* argmax)
 {
-    // index loops over all totalRois*c*pooledHeight*pooledWidth output locations.
-    for (int index = blockIdx.x * blockDim.x + threadIdx.x;
-         index < (totalIterations); index += blockDim.x * gridDim.x) 
+    extern __shared__ int roiWindows[];
+    int* hstarts = roiWindows;
+    int* hends   = hstarts + pooledHeight;
+    int* wstarts = hends   + pooledHeight;
+    int* wends   = wstarts + pooledWidth;
+
+    // n is the global ROI index (the new batch index)
+    const int n = blockIdx.x;
+
+    // each ROI is 4 elements: (x, y, w, h)
+    roiData += n * 4;
+
+    // roi data is relative to original image size
+    int roiStartW = (int)(    round_(roiData[0] * width));
+    int roiStartH = (int)(    round_(roiData[1] * height));
+    int roiWidth  = (int)(max(round_(roiData[2] * width),  (ElemType)1));
+    int roiHeight = (int)(max(round_(roiData[3] * height), (ElemType)1));
+
+    ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
+    ElemType winW = (ElemType)roiWidth / (ElemType)pooledWidth;
+
+    // compute the windows of the output rows and columns, add ROI offsets and clip to input boundaries
+    for (int ph = threadIdx.x; ph < pooledHeight; ph += blockDim.x)
+    {
+        hstarts[ph] = min(max((int)(       ph * winH)        + roiStartH, 0), height);
+        hends[ph]   = min(max((int)(ceilf((ph + 1) * winH)) + roiStartH, 0), height);
+    }
+    for (int pw = threadIdx.x; pw < pooledWidth; pw += blockDim.x)
+    {
+        wstarts[pw] = min(max((int)(       pw * winW)        + roiStartW, 0), width);
+        wends[pw]   = min(max((int)(ceilf((pw + 1) * winW)) + roiStartW, 0), width);
+    }
+    __syncthreads();
+
+    int imgIdx = n / numROIs;
+    int roiOutputSize = pooledWidth * pooledHeight * channels;
+    dst    += n * roiOutputSize;
+    argmax += n * roiOutputSize;
+
+    // index loops over the c*pooledHeight*pooledWidth output locations of this ROI.
+    for (int index = threadIdx.x; index < roiOutputSize; index += blockDim.x)
     {
-        
         // output is [W x H x C x N]
-        // n is the global ROI index (the new batch index)
         int pw =  index % pooledWidth;
         int ph = (index / pooledWidth) % pooledHeight;
-        int c  = (index / pooledWidth  / pooledHeight) % channels;
-        int n  =  index / pooledWidth  / pooledHeight  / channels;
-
-        // each ROI is 4 elements: (x, y, w, h)
-        roiData += n * 4;
-
-        // roi data is relative to original image size
-        int roiStartW = (int)(    round_(roiData[0] * width));
-        int roiStartH = (int)(    round_(roiData[1] * height));
-        int roiWidth  = (int)(max(round_(roiData[2] * width),  (ElemType)1));
-        int roiHeight = (int)(max(round_(roiData[3] * height), (ElemType)1));
-        
-        ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
-        ElemType winW = (ElemType)roiWidth / (ElemType)pooledWidth;
-        
-        // compute window for this output location.
-        int hstart = (int)(       ph * winH);
-        int wstart = (int)(       pw * winW);
-        int hend   = (int)(ceilf((ph + 1) * winH));
-        int wend   = (int)(ceilf((pw + 1) * winW));
-        
-        // Add ROI offsets and clip to input boundaries
-        hstart = min(max(hstart + roiStartH, 0), height);
-        hend   = min(max(hend   + roiStartH, 0), height);
-        wstart = min(max(wstart + roiStartW, 0), width);
-        wend   = min(max(wend   + roiStartW, 0), width);
-        
+        int c  =  index / pooledWidth  / pooledHeight;
+
+        int hstart = hstarts[ph];
+        int hend   = hends[ph];
+        int wstart = wstarts[pw];
+        int wend   = wends[pw];
+
         bool isempty = (hend <= hstart) || (wend <= wstart);
         // Define an empty pooling region to be zero
         ElemType maxval = isempty ? (ElemType)0 : -CUDART_INF_F;
         int maxidx = -1;
 
-        int imgIdx = n / numROIs;
-        src += (imgIdx * channels + c) * height * width;
+        const ElemType* channelSrc = src + (imgIdx * channels + c) * height * width;
         for (int h = hstart; h < hend; h++)
         {
             for (int w = wstart; w < wend; w++)
             {
                 int srcIndex = w + h * width;
-                if (src[srcIndex] > maxval)
+                if (channelSrc[srcIndex] > maxval)
                 {
-                    maxval = src[srcIndex];
+                    maxval = channelSrc[srcIndex];
                     maxidx = srcIndex;
                 }
             }
@@ -308,40 +324,57 @@ __global__ void kROIPoolingForward(const int totalIterations,
 // It loops over the ROIs corresponding to that image, seeing which ones could contain the location
 // in their output. For each ROI, it checks the argmax data to see if that ROI indeed chose
 // this pixel location as the maximum. If so, it increments the gradient term for the input location.
+// Every input location is written by one thread, so no atomics are needed. With thousands of ROIs per image, the
+// cost is in the loop over the ROIs: the blocks (of roiPoolingBlockSize threads, all in one image, blockIdx.y) load
+// the ROIs in tiles into shared memory, so that each ROI is read and rounded once per block instead of per thread.
 template <typename ElemType>
-__global__ void kROIPoolingBackward(const int totalIterations,
-    const int numROIs, const int numImg,
+__global__ void kROIPoolingBackward(const int numROIs,
     const int channels, const int width, const int height,
     const int pooledWidth, const int pooledHeight, const ElemType* pooledGrad,
     const ElemType* roiData, ElemType* grad, const ElemType* argmax)
 {
-    // index loops over all input locations (locations in the original input tensor).
-    for (int index = blockIdx.x * blockDim.x + threadIdx.x;
-        index < (totalIterations); index += blockDim.x * gridDim.x)
+    __shared__ int roiStartWs[roiPoolingBlockSize];
+    __shared__ int roiStartHs[roiPoolingBlockSize];
+    __shared__ int roiWidths[roiPoolingBlockSize];
+    __shared__ int roiHeights[roiPoolingBlockSize];
+
+    // images are laid out [W x H x C x N]
+    // (n, c, h, w) is an element in the input image
+    const int n = blockIdx.y;
+    const int imageSize = channels * height * width;
+    const int index = blockIdx.x * blockDim.x + threadIdx.x; // threads past the end of the image still load ROIs
+    int w =  index % width;
+    int h = (index / width) % height;
+    int c =  index / width  / height;
+
+    ElemType gradient = 0;
+
+    for (int tileStart = 0; tileStart < numROIs; tileStart += roiPoolingBlockSize)
     {
-        // images are laid out [W x H x C x N]
-        // (n, c, h, w) is an element in the input image
-        int w =  index % width;
-        int h = (index / width) % height;
-        int c = (index / width  / height) % channels;
-        int n =  index / width  / height  / channels;
-
-        // compute range of ROIs corresponding to this image:
-        int roiMin = n * numROIs;
-        int roiMax = (n + 1) * numROIs;
-
-        ElemType gradient = 0;
-
-        for (int roiN = roiMin; roiN < roiMax; roiN++)
+        __syncthreads(); // done with the previous tile
+        if (tileStart + threadIdx.x < numROIs)
         {
             // each ROI is 4 elements: (x, y, w, h)
-            const ElemType* roiOffset = roiData + roiN * 4;
+            const ElemType* roiOffset = roiData + (n * numROIs + tileStart + threadIdx.x) * 4;
 
             // ROI data is relative to original image size
-            int roiStartW = (int)(    round_(roiOffset[0] * width));
-            int roiStartH = (int)(    round_(roiOffset[1] * height));
-            int roiWidth  = (int)(max(round_(roiOffset[2] * width), 1.0));
-            int roiHeight = (int)(max(round_(roiOffset[3] * height), 1.0));
+            roiStartWs[threadIdx.x] = (int)(    round_(roiOffset[0] * width));
+            roiStartHs[threadIdx.x] = (int)(    round_(roiOffset[1] * height));
+            roiWidths[threadIdx.x]  = (int)(max(round_(roiOffset[2] * width),  (ElemType)1));
+            roiHeights[threadIdx.x] = (int)(max(round_(roiOffset[3] * height), (ElemType)1));
+        }
+        __syncthreads();
+
+        if (index >= imageSize)
+            continue;
+
+        const int tileSize = min(roiPoolingBlockSize, numROIs - tileStart);
+        for (int i = 0; i < tileSize; i++)
+        {
+            int roiStartW = roiStartWs[i];
+            int roiStartH = roiStartHs[i];
+            int roiWidth  = roiWidths[i];
+            int roiHeight = roiHeights[i];
 
             // skip this ROI if it doesn't contain our input location.
             const bool inROI = (w >= roiStartW && w < roiStartW + roiWidth &&
@@ -365,6 +398,7 @@ __global__ void kROIPoolingBackward(const int totalIterations,
             pwend   = min(max(pwend, 0), pooledWidth);
 
             // go right up to this channel of this ROI.
+            int roiN = n * numROIs + tileStart + i;
             int offset = (roiN * channels + c) * pooledWidth * pooledHeight;
             const ElemType* offsetPoolGrad = pooledGrad + offset;
             const ElemType* offsetArgmax = argmax + offset;
@@ -378,7 +412,80 @@ __global__ void kROIPoolingBackward(const int totalIterations,
                 }
             }
         }
-        grad[index] = gradient;
+    }
+
+    if (index < imageSize)
+        grad[n * imageSize + index] = gradient;
+}
+
+// Like kMaxPoolingForward, and records the position of the (first) max within the window.
+template <typename ElemType>
+__global__ void kMaxPoolingForwardWithArgmax(int batchSize, const int* mpRowCol, const int* mpRowIndices, const int* indices,
+                                             const ElemType* __restrict__ src, int srcVecSize,
+                                             ElemType* dst, short* argmax, int dstVecSize)
+{
+    int row = blockIdx.x * blockDim.x + threadIdx.x;
+    if (row >= dstVecSize)
+        return;
+
+    src += blockIdx.y * srcVecSize;
+    dst += blockIdx.y * dstVecSize;
+    argmax += blockIdx.y * dstVecSize;
+
+    for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
+    {
+        int colBase = mpRowCol[row];
+        assert(0 <= colBase && colBase < srcVecSize);
+
+        int i0 = mpRowIndices[row];
+        int size = indices[i0++];
+        assert(size > 0);
+        int best = 0;
+        ElemType res = src[colBase + indices[i0]];
+        for (int i = 1; i < size; i++)
+        {
+            int dcol = indices[i0 + i];
+            assert(0 <= colBase + dcol && colBase + dcol < srcVecSize);
+            if (src[colBase + dcol] > res)
+            {
+                res = src[colBase + dcol];
+                best = i;
+            }
+        }
+        dst[row] = res;
+        argmax[row] = (short)best;
+
+        src += gridDim.y * srcVecSize;
+        dst += gridDim.y * dstVecSize;
+        argmax += gridDim.y * dstVecSize;
+    }
+}
+
+// The gradient of each output goes to the input its argmax points at; overlapping windows need the atomic add.
+template <typename ElemType>
+__global__ void kMaxPoolingBackwardWithArgmax(int batchSize, const int* mpRowCol, const int* mpRowIndices, const int* indices,
+                                              const short* __restrict__ argmax, const ElemType* __restrict__ srcGrad, int srcVecSize,
+                                              ElemType* grad, int dstVecSize)
+{
+    int row = blockIdx.x * blockDim.x + threadIdx.x;
+    if (row >= srcVecSize)
+        return;
+
+    argmax += blockIdx.y * srcVecSize;
+    srcGrad += blockIdx.y * srcVecSize;
+    grad += blockIdx.y * dstVecSize;
+
+    int colBase = mpRowCol[row];
+    int i0 = mpRowIndices[row] + 1;
+    for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
+    {
+        int col = colBase + indices[i0 + argmax[row]];
+        assert(0 <= col && col < dstVecSize);
+        atomicAdd(&grad[col], srcGrad[row]);
+
+        argmax += gridDim.y * srcVecSize;
+        srcGrad += gridDim.y * srcVecSize;
+        grad += gridDim.y * dstVecSize;
     }
 }
 
@@ -423,9 +530,9 @@ __global__ void kMaxUnpooling(int batchSize, const int* mpRowCol, const int* mpR
 
         dst[colBase + dcol] = src[row];
 
-        src    += blockIdx.y * srcVecSize;
-        poolIn += blockIdx.y * dstVecSize;
-        dst    += blockIdx.y * dstVecSize;
+        src    += gridDim.y * srcVecSize;
+        poolIn += gridDim.y * dstVecSize;
+        dst    += gridDim.y * dstVecSize;
     }
 }
 
@@ -495,4 +602,149 @@ __global__ void kAveragePoolingBackward(int batchSize, const int* mpRowCol, cons
     }
 }
 
+
+// -----------------------------------------------------------------------
+// Kernels of the depthwise convolution engine, which compute a grouped 2D convolution
+// directly from its shape instead of the maps (see DepthwiseConvolutionShape).
+// src/in/grad are [W x H x C x N], dst/srcGrad are [W' x H' x K x N] with K = groups * multiplier,
+// kernel/kernelGrad are K kernels of [X x Y x C / groups].
+// -----------------------------------------------------------------------
+
+static const int depthwiseConvolutionBlockSize = 128;
+
+// One thread per output location; blockIdx.y runs over output channels and samples, so that the threads
+// of a block read the same kernel and neighbouring inputs.
+template <typename ElemType>
+__global__ void kDepthwiseConvolutionForward(int batchSize, DepthwiseConvolutionShape shape, const ElemType* __restrict__ kernel,
+                                             const ElemType* __restrict__ src, int srcVecSize,
+                                             ElemType* dst, int dstVecSize)
+{
+    const int outPlane = shape.outW * shape.outH;
+    int pos = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pos >= outPlane)
+        return;
+
+    const int groupSize = shape.inC / shape.groups;
+    const int outC = shape.groups * shape.multiplier;
+    const int inPlane = shape.inW * shape.inH;
+    const int kernelSize = shape.kernelW * shape.kernelH * groupSize;
+
+    int x0 = (pos % shape.outW) * shape.strideW - shape.padW;
+    int y0 = (pos / shape.outW) * shape.strideH - shape.padH;
+    int kx0 = max(0, -x0), kx1 = min(shape.kernelW, shape.inW - x0);
+    int ky0 = max(0, -y0), ky1 = min(shape.kernelH, shape.inH - y0);
+
+    for (int i = blockIdx.y; i < outC * batchSize; i += gridDim.y)
+    {
+        int k = i % outC;
+        int sample = i / outC;
+        const ElemType* in = src + (size_t)sample * srcVecSize + (k % shape.groups) * groupSize * inPlane;
+        const ElemType* weights = kernel + k * kernelSize;
+
+        ElemType sum = 0;
+        for (int c = 0; c < groupSize; c++)
+        {
+            for (int ky = ky0; ky < ky1; ky++)
+            {
+                for (int kx = kx0; kx < kx1; kx++)
+                    sum += weights[(c * shape.kernelH + ky) * shape.kernelW + kx] * in[c * inPlane + (y0 + ky) * shape.inW + x0 + kx];
+            }
+        }
+        dst[(size_t)sample * dstVecSize + k * outPlane + pos] = sum;
+    }
+}
+
+// One thread per input location, which gathers the gradients of the outputs whose windows cover it,
+// so that no atomics are needed. blockIdx.y runs over input channels and samples.
+template <typename ElemType>
+__global__ void kDepthwiseConvolutionBackwardData(int batchSize, DepthwiseConvolutionShape shape, const ElemType* __restrict__ kernel,
+                                                  const ElemType* __restrict__ srcGrad, int srcVecSize,
+                                                  ElemType* grad, int dstVecSize)
+{
+    const int inPlane = shape.inW * shape.inH;
+    int pos = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pos >= inPlane)
+        return;
+
+    const int groupSize = shape.inC / shape.groups;
+    const int outPlane = shape.outW * shape.outH;
+    const int kernelSize = shape.kernelW * shape.kernelH * groupSize;
+    const int x = pos % shape.inW;
+    const int y = pos / shape.inW;
+
+    for (int i = blockIdx.y; i < shape.inC * batchSize; i += gridDim.y)
+    {
+        int c = i % shape.inC;
+        int sample = i / shape.inC;
+        int g = c / groupSize;
+        const ElemType* outGrad = srcGrad + (size_t)sample * srcVecSize;
+
+        ElemType sum = 0;
+        for (int m = 0; m < shape.multiplier; m++)
+        {
+            int k = g + shape.groups * m;
+            const ElemType* weights = kernel + k * kernelSize + (c % groupSize) * shape.kernelW * shape.kernelH;
+            for (int ky = 0; ky < shape.kernelH; ky++)
+            {
+                int ty = y + shape.padH - ky;
+                if (ty < 0 || ty % shape.strideH != 0 || ty / shape.strideH >= shape.outH)
+                    continue;
+                for (int kx = 0; kx < shape.kernelW; kx++)
+                {
+                    int tx = x + shape.padW - kx;
+                    if (tx < 0 || tx % shape.strideW != 0 || tx / shape.strideW >= shape.outW)
+                        continue;
+                    sum += weights[ky * shape.kernelW + kx] * outGrad[k * outPlane + (ty / shape.strideH) * shape.outW + tx / shape.strideW];
+                }
+            }
+        }
+        grad[(size_t)sample * dstVecSize + c * inPlane + pos] += sum;
+    }
+}
+
+// One block per kernel weight, whose threads sum over the output locations and samples and then reduce in shared memory.
+template <typename ElemType>
+__global__ void kDepthwiseConvolutionBackwardKernel(int batchSize, DepthwiseConvolutionShape shape,
+                                                    const ElemType* __restrict__ in, int inVecSize,
+                                                    const ElemType* __restrict__ srcGrad, int outVecSize,
+                                                    ElemType* kernelGrad)
+{
+    __shared__ ElemType partials[depthwiseConvolutionBlockSize];
+
+    const int groupSize = shape.inC / shape.groups;
+    const int inPlane = shape.inW * shape.inH;
+    const int outPlane = shape.outW * shape.outH;
+    const int kernelSize = shape.kernelW * shape.kernelH * groupSize;
+
+    int kx = blockIdx.x % shape.kernelW;
+    int ky = (blockIdx.x / shape.kernelW) % shape.kernelH;
+    int c = (blockIdx.x / (shape.kernelW * shape.kernelH)) % groupSize;
+    int k = blockIdx.x / kernelSize;
+    const ElemType* src = in + ((k % shape.groups) * groupSize + c) * inPlane;
+    const ElemType* outGrad = srcGrad + k * outPlane;
+
+    ElemType sum = 0;
+    for (int i = threadIdx.x; i < outPlane * batchSize; i += blockDim.x)
+    {
+        int pos = i % outPlane;
+        int sample = i / outPlane;
+        int x = (pos % shape.outW) * shape.strideW - shape.padW + kx;
+        int y = (pos / shape.outW) * shape.strideH - shape.padH + ky;
+        if (x < 0 || x >= shape.inW || y < 0 || y >= shape.inH)
+            continue;
+        sum += outGrad[(size_t)sample * outVecSize + pos] * src[(size_t)sample * inVecSize + y * shape.inW + x];
+    }
+
+    partials[threadIdx.x] = sum;
+    __syncthreads();
+    for (int half = depthwiseConvolutionBlockSize / 2; half > 0; half /= 2)
+    {
+        if (threadIdx.x < half)
+            partials[threadIdx.x] += partials[threadIdx.x + half];
+        __syncthreads();
+    }
+    if (threadIdx.x == 0)
+        kernelGrad[blockIdx.x] += partials[0];
+}
+
 }}}
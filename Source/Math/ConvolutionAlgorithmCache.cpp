@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ConvolutionAlgorithmCache.cpp -- persistent cache of the convolution algorithms chosen by the cuDNN autotuner
+//
+
+#include "stdafx.h"
+#include "ConvolutionAlgorithmCache.h"
+#include "Basics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ConvolutionAlgorithmCache::ConvolutionAlgorithmCache(const std::wstring& path)
+    : m_path(path)
+{
+    Load();
+}
+
+// caller holds the lock, or is the constructor
+void ConvolutionAlgorithmCache::Load()
+{
+    m_entries.clear();
+    if (m_path.empty())
+        return;
+    std::ifstream file(msra::strfun::utf8(m_path));
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        Entry entry;
+        std::string key;
+        if (!(fields >> entry.algorithm >> entry.workspaceSize) || fields.get() != ' ' || !std::getline(fields, key) || key.empty())
+            continue; // e.g. a line cut short by a process that was killed while writing
+        if (key.back() == '\r')
+            key.pop_back();
+        m_entries[key] = entry;
+    }
+}
+
+bool ConvolutionAlgorithmCache::Find(const std::string& key, Entry& entry) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_entries.find(key);
+    if (iter == m_entries.end())
+        return false;
+    entry = iter->second;
+    return true;
+}
+
+void ConvolutionAlgorithmCache::Insert(const std::string& key, const Entry& entry)
+{
+    if (key.find('\n') != std::string::npos)
+        LogicError("ConvolutionAlgorithmCache: Keys must not contain line breaks.");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries[key] = entry;
+    if (m_path.empty())
+        return;
+    // a single write per entry, so that the entries of processes sharing the file don't interleave
+    std::string line = msra::strfun::strprintf("%d %llu ", entry.algorithm, (unsigned long long) entry.workspaceSize) + key + "\n";
+    FILE* f = _wfopen(m_path.c_str(), L"ab");
+    if (!f || fwrite(line.data(), 1, line.size(), f) != line.size())
+        fprintf(stderr, "WARNING: Could not write to the convolution algorithm cache %ls.\n", m_path.c_str());
+    if (f)
+        fclose(f);
+}
+
+size_t ConvolutionAlgorithmCache::Size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+/*static*/ ConvolutionAlgorithmCache& ConvolutionAlgorithmCache::Instance()
+{
+    static ConvolutionAlgorithmCache s_instance([]()
+    {
+        const char* path = getenv("CNTK_CUDNN_ALGORITHM_CACHE");
+        return path ? msra::strfun::utf16(path) : std::wstring();
+    }());
+    return s_instance;
+}
+
+/*static*/ void ConvolutionAlgorithmCache::SetPath(const std::wstring& path)
+{
+    ConvolutionAlgorithmCache& cache = Instance();
+    std::lock_guard<std::mutex> lock(cache.m_mutex);
+    cache.m_path = path;
+    cache.Load();
+}
+
+static std::mutex s_autotuneBatchSizesMutex;
+static std::vector<size_t> s_autotuneBatchSizes;
+
+/*static*/ void ConvolutionAlgorithmCache::SetAutotuneBatchSizes(const std::vector<size_t>& batchSizes)
+{
+    std::lock_guard<std::mutex> lock(s_autotuneBatchSizesMutex);
+    s_autotuneBatchSizes = batchSizes;
+}
+
+/*static*/ std::vector<size_t> ConvolutionAlgorithmCache::GetAutotuneBatchSizes()
+{
+    std::lock_guard<std::mutex> lock(s_autotuneBatchSizesMutex);
+    return s_autotuneBatchSizes;
+}
+
+}}}
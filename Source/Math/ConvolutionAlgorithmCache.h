@@ -0,0 +1,68 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ConvolutionAlgorithmCache.h -- persistent cache of the convolution algorithms chosen by the cuDNN autotuner
+//
+// Autotuning (cudnnFindConvolution*AlgorithmEx) runs every algorithm once for each new geometry and minibatch size, which
+// takes minutes for deep models, in every process and worker. With a cache file (config: cudnnAlgorithmCache=<file>, for
+// other hosts the environment variable CNTK_CUDNN_ALGORITHM_CACHE) the chosen algorithms are kept across runs:
+// the cuDNN engine looks up the key before tuning, and appends newly tuned results to the file.
+//
+// The key contains everything the choice depends on: GPU model, cuDNN version, data type, operation (forward, backward
+// data, backward filter), the ConvolveGeometry, minibatch size, maxTempMemSizeInSamples and whether only deterministic
+// algorithms are allowed. Keys that no longer match (e.g. after a driver update) are simply not found again.
+//
+// File format: one entry per line, "<algorithm> <workspace bytes> <key>". Entries for the same key later in the file
+// replace earlier ones, so processes sharing a file only ever append to it.
+//
+// cudnnAutotuneBatchSizes=<N1>:<N2>:... additionally tunes every convolution for these minibatch sizes when it is created,
+// ahead of training, so that no tuning is needed when the minibatch size changes later.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API ConvolutionAlgorithmCache
+{
+public:
+    struct Entry
+    {
+        int algorithm;
+        size_t workspaceSize;
+    };
+
+    // in memory only if path is empty; a missing file is created on the first insertion
+    explicit ConvolutionAlgorithmCache(const std::wstring& path);
+
+    bool Find(const std::string& key, Entry& entry) const;
+    // also appends the entry to the file; failing to write it is only reported
+    void Insert(const std::string& key, const Entry& entry);
+    size_t Size() const;
+    const std::wstring& Path() const { return m_path; }
+
+    // the process-wide cache used by the cuDNN engine
+    static ConvolutionAlgorithmCache& Instance();
+    // replaces the process-wide cache by one backed by 'path'
+    static void SetPath(const std::wstring& path);
+
+    // minibatch sizes for which convolutions are tuned when they are created
+    static void SetAutotuneBatchSizes(const std::vector<size_t>& batchSizes);
+    static std::vector<size_t> GetAutotuneBatchSizes();
+
+private:
+    void Load();
+
+    std::wstring m_path;
+    mutable std::mutex m_mutex;
+    std::map<std::string, Entry> m_entries;
+};
+
+}}}
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
+#include <omp.h>
+#include <climits>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -127,6 +129,44 @@ void ConvolutionEngine<ElemType>::MaxUnpooling(const Mat& out, const Mat& poolIn
     MaxUnpoolingCore(out, poolIn, in);
 }
 
+template <class ElemType>
+void ConvolutionEngine<ElemType>::ForwardPoolingWithArgmax(const Mat& in, Mat& out, Matrix<short>& argmax)
+{
+    const auto& g = *m_geometry;
+    assert(g.InputShape().GetNumElements() == in.GetNumRows());
+    assert(g.OutputShape().GetNumElements() == out.GetNumRows());
+    size_t batchSize = in.GetNumCols();
+    assert(batchSize == out.GetNumCols());
+    assert(argmax.GetNumRows() == out.GetNumRows() && argmax.GetNumCols() == batchSize);
+#ifdef NDEBUG
+    UNUSED(g);
+    UNUSED(batchSize);
+#endif
+
+    EnsureCompatible();
+    EnsurePoolingInitialized();
+    ForwardPoolingWithArgmaxCore(in, out, argmax);
+}
+
+template <class ElemType>
+void ConvolutionEngine<ElemType>::BackwardPoolingWithArgmax(const Matrix<short>& argmax, const Mat& srcGrad, Mat& grad)
+{
+    const auto& g = *m_geometry;
+    assert(g.InputShape().GetNumElements() == grad.GetNumRows());
+    assert(g.OutputShape().GetNumElements() == srcGrad.GetNumRows());
+    size_t batchSize = srcGrad.GetNumCols();
+    assert(batchSize == grad.GetNumCols());
+    assert(argmax.GetNumRows() == srcGrad.GetNumRows() && argmax.GetNumCols() == batchSize);
+#ifdef NDEBUG
+    UNUSED(g);
+    UNUSED(batchSize);
+#endif
+
+    EnsureCompatible();
+    EnsurePoolingInitialized();
+    BackwardPoolingWithArgmaxCore(argmax, srcGrad, grad);
+}
+
 //------------------------------------------------------------------
 // Reference convolution engine implementation.
 // This engine supports arbitrary convolution geometry but does not provide efficient implementation.
@@ -147,6 +187,12 @@ public:
     {
     }
 
+    // The positions within a window must fit into the int16 argmax.
+    bool SupportsPoolingArgmax() const override
+    {
+        return m_poolKind == PoolKind::Max && m_geometry->KernelShape().GetNumElements() <= SHRT_MAX;
+    }
+
 protected:
     using Base::m_geometry;
     using Base::m_deviceId;
@@ -157,7 +203,8 @@ protected:
 
     void EnsureCompatible() override
     {
-        if (m_imageLayout != ImageLayoutKind::CHW)
+        // Pooling maps work on any order of the tensor dimensions, so pooling also supports HWC.
+        if (m_imageLayout != ImageLayoutKind::CHW && m_poolKind == PoolKind::None)
             RuntimeError("Reference convolution engine supports only CHW/cudnn layout.");
     }
 
@@ -236,6 +283,20 @@ protected:
         out.MaxUnpooling(m_mpRowCol, *m_mpRowIndices, *m_indices, poolIn, in);
     }
 
+    void ForwardPoolingWithArgmaxCore(const Mat& in, Mat& out, Matrix<short>& argmax) override
+    {
+        if (!SupportsPoolingArgmax())
+            InvalidArgument("Storing the argmax is supported only for max pooling with at most %d kernel elements.", (int)SHRT_MAX);
+        in.MaxPoolingForwardWithArgmax(m_mpRowCol, *m_mpRowIndices, *m_indices, out, argmax);
+    }
+
+    void BackwardPoolingWithArgmaxCore(const Matrix<short>& argmax, const Mat& srcGrad, Mat& grad) override
+    {
+        if (!SupportsPoolingArgmax())
+            InvalidArgument("Storing the argmax is supported only for max pooling with at most %d kernel elements.", (int)SHRT_MAX);
+        srcGrad.MaxPoolingBackwardWithArgmax(m_mpRowCol, *m_mpRowIndices, *m_indices, argmax, grad);
+    }
+
 protected:
     static bool IsGpu(DEVICEID_TYPE deviceId)
     {
@@ -851,6 +912,370 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Winograd convolution engine implementation.
+// Forward convolution on CPU for the common 2D case of 3x3 kernels with stride 1 and full sharing,
+// using the minimal filtering algorithms F(2x2, 3x3) and F(4x4, 3x3)
+// (Fast Algorithms for Convolutional Neural Networks; Lavin, Gray).
+// Unlike GEMM engine it does not unroll the whole (sub)minibatch: the output is processed in small
+// tiles, a cache-sized block of tiles per thread, with channels as the innermost dimension.
+// Uses GEMM engine for backpropagation and reference engine for pooling operations.
+//------------------------------------------------------------------
+
+// Transforms of F(m x m, 3 x 3) on (m + 2) x (m + 2) input tiles d and 3 x 3 kernels g:
+// output tile Y = AT * ((G * g * G^T) .* (BT * d * BT^T)) * AT^T.
+struct WinogradTransform
+{
+    double BT[6][6]; // [alpha x alpha], alpha = m + 2
+    double G[6][3];  // [alpha x 3]
+    double AT[4][6]; // [m x alpha]
+};
+
+// 4x4 input tiles, 16 instead of 36 multiplications per 2x2 output tile.
+static const WinogradTransform s_winogradF2x2 =
+{
+    { { 1, 0, -1, 0 }, { 0, 1, 1, 0 }, { 0, -1, 1, 0 }, { 0, 1, 0, -1 } },
+    { { 1, 0, 0 }, { 0.5, 0.5, 0.5 }, { 0.5, -0.5, 0.5 }, { 0, 0, 1 } },
+    { { 1, 1, 1, 0 }, { 0, 1, -1, -1 } }
+};
+
+// 6x6 input tiles, 36 instead of 144 multiplications per 4x4 output tile, at the cost of larger rounding errors.
+static const WinogradTransform s_winogradF4x4 =
+{
+    { { 4, 0, -5, 0, 1, 0 }, { 0, -4, -4, 1, 1, 0 }, { 0, 4, -4, -1, 1, 0 }, { 0, -2, -1, 2, 1, 0 }, { 0, 2, -1, -2, 1, 0 }, { 0, 4, 0, -5, 0, 1 } },
+    { { 1.0 / 4, 0, 0 }, { -1.0 / 6, -1.0 / 6, -1.0 / 6 }, { -1.0 / 6, 1.0 / 6, -1.0 / 6 }, { 1.0 / 24, 1.0 / 12, 1.0 / 6 }, { 1.0 / 24, -1.0 / 12, 1.0 / 6 }, { 0, 0, 1 } },
+    { { 1, 1, 1, 1, 1, 0 }, { 0, 1, -1, 2, -2, 0 }, { 0, 1, 1, 4, 4, 0 }, { 0, 1, -1, 8, -8, 1 } }
+};
+
+template <class ElemType>
+class WinogradConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    WinogradConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad)
+    {
+    }
+
+protected:
+    using Base::m_geometry;
+
+    // Number of elements of transformed inputs and products a thread should work on at a time, about the size of L2.
+    static const size_t BlockElementCount = 1 << 15;
+
+    // Uses the same notation as GEMM engine: input is [WHC x N], kernels are [XYC x K] with X = Y = 3, output is [W'H'K x N].
+    // Picks the tile size needing fewer multiplications for this output size (F(2x2, 3x3) if equal, it is more accurate).
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        if (in.GetMatrixType() != MatrixType::DENSE)
+        {
+            Base::ForwardCore(in, kernel, out, workspace);
+            return;
+        }
+
+        const auto& outT = m_geometry->OutputShape();
+        auto multiplications = [&](size_t m) { return ((outT[0] + m - 1) / m) * ((outT[1] + m - 1) / m) * (m + 2) * (m + 2); };
+        if (multiplications(4) < multiplications(2))
+            ForwardTiles<4>(s_winogradF4x4, in, kernel, out, workspace);
+        else
+            ForwardTiles<2>(s_winogradF2x2, in, kernel, out, workspace);
+    }
+
+    // The forward method consists of 4 parts:
+    // 1. Transforming kernels into alpha x alpha matrices U, stored as [alpha^2 x C x K].
+    // 2. Transforming a block of input tiles into V, stored as [alpha^2 x tiles x C].
+    // 3. For each of the alpha^2 transformed positions, multiplying [tiles x C] * [C x K] -> [tiles x K].
+    // 4. Transforming the products back into m x m output tiles, clipped at the borders of the output.
+    // Steps 2-4 run on one block of tiles per thread, the block stays in cache between them.
+    template <size_t m>
+    void ForwardTiles(const WinogradTransform& transform, const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        static const size_t alpha = m + 2;
+        static const size_t alpha2 = alpha * alpha;
+
+        const auto& inT = m_geometry->InputShape();
+        const auto& outT = m_geometry->OutputShape();
+        const size_t inW = inT[0], inH = inT[1], mapInCount = inT[2];
+        const size_t outW = outT[0], outH = outT[1], mapOutCount = outT[2];
+        const int padW = m_geometry->GetLowerPad(0);
+        const int padH = m_geometry->GetLowerPad(1);
+        const size_t batchSize = in.GetNumCols();
+
+        const size_t tilesW = (outW + m - 1) / m;
+        const size_t tilesPerSample = tilesW * ((outH + m - 1) / m);
+        const size_t tileCount = tilesPerSample * batchSize;
+        const size_t blockSize = std::max<size_t>(1, std::min<size_t>(64, BlockElementCount / (alpha2 * (mapInCount + mapOutCount))));
+        const size_t blockCount = (tileCount + blockSize - 1) / blockSize;
+        const int numThreads = (int)std::min<size_t>(std::max(1, omp_get_max_threads()), blockCount);
+
+        // Reserve space for transformed kernels and, per thread, transformed inputs and products of a block.
+        const size_t kernelElements = alpha2 * mapInCount * mapOutCount;
+        const size_t threadElements = alpha2 * blockSize * (mapInCount + mapOutCount);
+        workspace.Resize(1, kernelElements + numThreads * threadElements);
+        ElemType* transformedKernel = workspace.Data();
+
+        ElemType BT[alpha][alpha], G[alpha][3], AT[m][alpha];
+        for (size_t a = 0; a < alpha; a++)
+        {
+            for (size_t b = 0; b < alpha; b++)
+                BT[a][b] = (ElemType)transform.BT[a][b];
+            for (size_t j = 0; j < 3; j++)
+                G[a][j] = (ElemType)transform.G[a][j];
+            for (size_t p = 0; p < m; p++)
+                AT[p][a] = (ElemType)transform.AT[p][a];
+        }
+
+        // 1. Transform kernels. cudnn layout uses row-major kernel weight matrix, so each kernel is a [3 x 3 x C] tensor.
+        const ElemType* kernelData = kernel.Data();
+#pragma omp parallel for num_threads(numThreads)
+        for (long k = 0; k < (long)mapOutCount; k++)
+        {
+            for (size_t c = 0; c < mapInCount; c++)
+            {
+                const ElemType* g = kernelData + (k * mapInCount + c) * 9;
+                ElemType tmp[alpha][3];
+                for (size_t a = 0; a < alpha; a++)
+                {
+                    for (size_t j = 0; j < 3; j++)
+                        tmp[a][j] = G[a][0] * g[3 * j] + G[a][1] * g[3 * j + 1] + G[a][2] * g[3 * j + 2];
+                }
+                for (size_t a = 0; a < alpha; a++)
+                {
+                    for (size_t b = 0; b < alpha; b++)
+                        transformedKernel[((a * alpha + b) * mapInCount + c) * mapOutCount + k] = tmp[a][0] * G[b][0] + tmp[a][1] * G[b][1] + tmp[a][2] * G[b][2];
+                }
+            }
+        }
+
+        const ElemType* inData = in.Data();
+        ElemType* outData = out.Data();
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+        for (long block = 0; block < (long)blockCount; block++)
+        {
+            ElemType* transformedInput = transformedKernel + kernelElements + omp_get_thread_num() * threadElements;
+            ElemType* product = transformedInput + alpha2 * blockSize * mapInCount;
+            const size_t firstTile = block * blockSize;
+            const size_t curBlockSize = std::min(blockSize, tileCount - firstTile);
+
+            // 2. Transform input tiles, reading zeros outside of the image.
+            for (size_t t = 0; t < curBlockSize; t++)
+            {
+                const size_t tile = (firstTile + t) % tilesPerSample;
+                const int x0 = (int)((tile % tilesW) * m) - padW;
+                const int y0 = (int)((tile / tilesW) * m) - padH;
+                const ElemType* inSample = inData + (firstTile + t) / tilesPerSample * inT.GetNumElements();
+                for (size_t c = 0; c < mapInCount; c++)
+                {
+                    const ElemType* inMap = inSample + c * inW * inH;
+                    ElemType d[alpha][alpha];
+                    for (size_t v = 0; v < alpha; v++)
+                    {
+                        const int y = y0 + (int)v;
+                        for (size_t u = 0; u < alpha; u++)
+                        {
+                            const int x = x0 + (int)u;
+                            d[u][v] = (x >= 0 && x < (int)inW && y >= 0 && y < (int)inH) ? inMap[y * inW + x] : 0;
+                        }
+                    }
+                    ElemType tmp[alpha][alpha];
+                    for (size_t a = 0; a < alpha; a++)
+                    {
+                        for (size_t v = 0; v < alpha; v++)
+                        {
+                            ElemType sum = 0;
+                            for (size_t u = 0; u < alpha; u++)
+                                sum += BT[a][u] * d[u][v];
+                            tmp[a][v] = sum;
+                        }
+                    }
+                    for (size_t a = 0; a < alpha; a++)
+                    {
+                        for (size_t b = 0; b < alpha; b++)
+                        {
+                            ElemType sum = 0;
+                            for (size_t v = 0; v < alpha; v++)
+                                sum += tmp[a][v] * BT[b][v];
+                            transformedInput[((a * alpha + b) * blockSize + t) * mapInCount + c] = sum;
+                        }
+                    }
+                }
+            }
+
+            // 3. Multiply, with output maps as the contiguous inner loop.
+            for (size_t ab = 0; ab < alpha2; ab++)
+            {
+                const ElemType* u = transformedKernel + ab * mapInCount * mapOutCount;
+                for (size_t t = 0; t < curBlockSize; t++)
+                {
+                    const ElemType* v = transformedInput + (ab * blockSize + t) * mapInCount;
+                    ElemType* prod = product + (ab * blockSize + t) * mapOutCount;
+                    std::fill(prod, prod + mapOutCount, (ElemType)0);
+                    for (size_t c = 0; c < mapInCount; c++)
+                    {
+                        const ElemType vc = v[c];
+                        const ElemType* uc = u + c * mapOutCount;
+                        for (size_t k = 0; k < mapOutCount; k++)
+                            prod[k] += vc * uc[k];
+                    }
+                }
+            }
+
+            // 4. Transform products back into output tiles.
+            for (size_t t = 0; t < curBlockSize; t++)
+            {
+                const size_t tile = (firstTile + t) % tilesPerSample;
+                const size_t x0 = (tile % tilesW) * m;
+                const size_t y0 = (tile / tilesW) * m;
+                ElemType* outSample = outData + (firstTile + t) / tilesPerSample * outT.GetNumElements();
+                for (size_t k = 0; k < mapOutCount; k++)
+                {
+                    ElemType tmp[m][alpha];
+                    for (size_t p = 0; p < m; p++)
+                    {
+                        for (size_t b = 0; b < alpha; b++)
+                        {
+                            ElemType sum = 0;
+                            for (size_t a = 0; a < alpha; a++)
+                                sum += AT[p][a] * product[((a * alpha + b) * blockSize + t) * mapOutCount + k];
+                            tmp[p][b] = sum;
+                        }
+                    }
+                    ElemType* outMap = outSample + k * outW * outH;
+                    for (size_t q = 0; q < m && y0 + q < outH; q++)
+                    {
+                        for (size_t p = 0; p < m && x0 + p < outW; p++)
+                        {
+                            ElemType sum = 0;
+                            for (size_t b = 0; b < alpha; b++)
+                                sum += tmp[p][b] * AT[q][b];
+                            outMap[(y0 + q) * outW + x0 + p] = sum;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        if (!Base::IsSupported(deviceId, geometry))
+            return false;
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        // 2D convolution over [W x H] with the kernel spanning all input channels, one output channel per map.
+        return inT.GetRank() == 3 &&
+               kernT[0] == 3 && kernT[1] == 3 && kernT[2] == inT[2] &&
+               geometry->GetStride(0) == 1 && geometry->GetStride(1) == 1 &&
+               geometry->GetMapCount(0) == 1 && geometry->GetMapCount(1) == 1 && outT[2] == geometry->GetMapCount(2) &&
+               geometry->GetLowerPad(0) >= 0 && geometry->GetLowerPad(1) >= 0;
+    }
+};
+
+//------------------------------------------------------------------
+// Depthwise convolution engine implementation.
+// 2D convolutions whose input channels are split into groups that are convolved separately, each group
+// with kernels of its own. In ConvolveGeometry terms: the kernel spans C / groups channels, the stride
+// along the channels is the same, and kernels are not shared along the channels. Depthwise convolution
+// is the case of one channel per group, with the map count being the channel multiplier.
+// GEMM engine and cuDNN do not support such geometries as they are not fully shared, and the reference
+// engine looks every weight up through the maps; this engine runs direct loops over the planes of the
+// groups instead, on CPU and GPU (see DepthwiseConvolutionShape).
+// Uses reference engine for pooling operations.
+//------------------------------------------------------------------
+template <class ElemType>
+class DepthwiseConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
+{
+public:
+    using Base = ReferenceConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DepthwiseConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad),
+        m_shape(IsSupported(geometry) ? GetShape(*geometry) : DepthwiseConvolutionShape())
+    {
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_imageLayout;
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Depthwise convolution engine supports only CHW/cudnn layout.");
+        if (!IsSupported(m_geometry))
+            LogicError("Depthwise convolution engine does not support this convolution configuration. Geometry: %s", ((string)*m_geometry).c_str());
+    }
+
+    // The engine needs none of the maps.
+    void EnsureConvolutionInitialized() override
+    {
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& /*workspace*/) override
+    {
+        in.DepthwiseConvolutionForward(kernel, m_shape, out);
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool /*accumulateGradient*/, Mat& /*workspace*/) override
+    {
+        srcGrad.DepthwiseConvolutionBackwardData(kernel, m_shape, grad);
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool /*accumulateGradient*/, bool /*allowReuse*/, Mat& /*workspace*/) override
+    {
+        srcGrad.DepthwiseConvolutionBackwardKernel(in, m_shape, kernelGrad);
+    }
+
+public:
+    static bool IsSupported(ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        if (inT.GetRank() != 3 || inT[2] % kernT[2] != 0)
+            return false;
+        size_t groups = inT[2] / kernT[2];
+        // Shared along [W x H] with one map there, groups of kernT[2] channels each, as many kernels per group as maps.
+        return geometry->GetSharing(0) && geometry->GetSharing(1) && !geometry->GetSharing(2) &&
+               geometry->GetMapCount(0) == 1 && geometry->GetMapCount(1) == 1 &&
+               geometry->GetStride(2) == kernT[2] && geometry->GetLowerPad(2) == 0 &&
+               outT[2] == groups * geometry->GetMapCount(2);
+    }
+
+private:
+    static DepthwiseConvolutionShape GetShape(const ConvolveGeometry& geometry)
+    {
+        const auto& inT = geometry.InputShape();
+        const auto& kernT = geometry.KernelShape();
+        const auto& outT = geometry.OutputShape();
+
+        DepthwiseConvolutionShape shape;
+        shape.inW = (int)inT[0];
+        shape.inH = (int)inT[1];
+        shape.inC = (int)inT[2];
+        shape.outW = (int)outT[0];
+        shape.outH = (int)outT[1];
+        shape.kernelW = (int)kernT[0];
+        shape.kernelH = (int)kernT[1];
+        shape.strideW = (int)geometry.GetStride(0);
+        shape.strideH = (int)geometry.GetStride(1);
+        shape.padW = geometry.GetLowerPad(0);
+        shape.padH = geometry.GetLowerPad(1);
+        shape.groups = (int)(inT[2] / kernT[2]);
+        shape.multiplier = (int)geometry.GetMapCount(2);
+        return shape;
+    }
+
+    DepthwiseConvolutionShape m_shape;
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -864,9 +1289,18 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
     // can be called from places like MEL with default parameters and never be used. 
     // The check will be done later in engine's EnsureCompatible call if the egnine is actually used.
     auto engStr = (std::string)(*geometry);
-    // Only legacy engine supports HWC layout.
+    // Only legacy engine supports HWC layout for convolution. Pooling in HWC may also use the reference engine, whose
+    // pooling maps do not depend on the layout, e.g. when the legacy engine was left out to store the argmax.
     if (imageLayout == ImageLayoutKind::HWC)
     {
+        if (poolKind != PoolKind::None && !isEnabled(ConvolutionEngineKind::Legacy) && isEnabled(ConvolutionEngineKind::Reference))
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsusing reference pooling engine for HWC geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+            return std::make_unique<ReferenceConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+        }
+
         if (!isEnabled(ConvolutionEngineKind::Legacy))
             RuntimeError("Trying to use Legacy convolution engine when it's disabled.");
 
@@ -886,6 +1320,22 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms, poolIncludePad);
     }
 
+    if (isEnabled(ConvolutionEngineKind::Depthwise) && DepthwiseConvolutionEngine<ElemType>::IsSupported(geometry))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing depthwise convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<DepthwiseConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+    }
+
+    if (isEnabled(ConvolutionEngineKind::Winograd) && WinogradConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing Winograd convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<WinogradConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         if (GetMathLibTraceLevel() > 0)
@@ -22,8 +22,10 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Winograd  = 1 << 4, // Winograd minimal filtering on CPU, works only for 2D 3x3 convos with stride 1 and full sharing. Backward uses GEMM.
+    Depthwise = 1 << 5, // Direct loops for 2D depthwise and grouped convos (kernels not shared along the channels), on CPU and GPU.
 
-    All       = Reference | CuDnn | Legacy | Gemm
+    All       = Reference | CuDnn | Legacy | Gemm | Winograd | Depthwise
 };
 
 enum class PoolKind
@@ -57,6 +59,15 @@ public:
 
     void MaxUnpooling(const Mat& out, const Mat& poolIn, Mat& in);
 
+    // Max pooling that stores the position of the max of each window in 'argmax' (of the shape of 'out'), so that the
+    // backward pass is a scatter of srcGrad that needs neither the input nor the output of the forward pass, which
+    // then need not be kept. Only engines for which SupportsPoolingArgmax() is true implement these.
+    virtual bool SupportsPoolingArgmax() const { return false; }
+
+    void ForwardPoolingWithArgmax(const Mat& in, Mat& out, Matrix<short>& argmax);
+
+    void BackwardPoolingWithArgmax(const Matrix<short>& argmax, const Mat& srcGrad, Mat& grad);
+
     std::shared_ptr<const ConvolveGeometry> Geometry() const { return m_geometry; }
 
     static std::unique_ptr<ConvolutionEngine<ElemType>> Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, 
@@ -74,6 +85,10 @@ public:
 
     virtual bool ImplementsGradientOverwriteOptimization() const { return false; }
 
+    // Selects the algorithms for these minibatch sizes ahead of time, so that changing the minibatch size later needs no
+    // tuning (see ConvolutionAlgorithmCache.h). Only engines that tune, i.e. cuDNN, do anything here.
+    virtual void Autotune(const std::vector<size_t>& batchSizes) { UNUSED(batchSizes); }
+
 protected:
     ConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad = false)
         : m_geometry(geometry), m_deviceId(deviceId), m_imageLayout(imageLayout), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_poolKind(poolKind), m_poolIncludePad(poolIncludePad)
@@ -99,6 +114,16 @@ protected:
 
     virtual void MaxUnpoolingCore(const Mat& out, const Mat& poolIn, Mat& in) = 0;
 
+    virtual void ForwardPoolingWithArgmaxCore(const Mat& /*in*/, Mat& /*out*/, Matrix<short>& /*argmax*/)
+    {
+        LogicError("This convolution engine does not store the argmax of max pooling.");
+    }
+
+    virtual void BackwardPoolingWithArgmaxCore(const Matrix<short>& /*argmax*/, const Mat& /*srcGrad*/, Mat& /*grad*/)
+    {
+        LogicError("This convolution engine does not store the argmax of max pooling.");
+    }
+
 protected:
     ConvolveGeometryPtr m_geometry;
     DEVICEID_TYPE m_deviceId;
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include "GPUMatrix.h"
 #include "CuDnnCommon.h"
+#include "PerformanceProfiler.h"
+#include <atomic>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -77,10 +79,14 @@ cudnnDataType_t CuDnnTensor::GetDataType()
 template cudnnDataType_t CuDnnTensor::GetDataType<float>();
 template cudnnDataType_t CuDnnTensor::GetDataType<double>();
 
+static std::atomic<bool> s_cudnnHandleCreated(false);
+
 CuDnn::ptr_t CuDnn::Instance()
 {
     auto createNew = []()
     {
+        PROFILE_SCOPE(profilerEvtLoadCuDnnInit);
+
         int deviceId;
         CUDA_CALL(cudaGetDevice(&deviceId));
         cudaDeviceProp props = {0};
@@ -89,6 +95,7 @@ CuDnn::ptr_t CuDnn::Instance()
         cudnnHandle_t* cudnn = new cudnnHandle_t;
         CUDNN_CALL(cudnnCreate(cudnn));
         CUDNN_CALL(cudnnSetStream(*cudnn, GetStream()));
+        s_cudnnHandleCreated = true;
         return cudnn;
     };
 
@@ -105,4 +112,10 @@ CuDnn::ptr_t CuDnn::Instance()
     return m_instance;
 }
 
+/*static*/ void CuDnn::SetStream(cudaStream_t stream)
+{
+    if (s_cudnnHandleCreated)
+        CUDNN_CALL(cudnnSetStream(*Instance(), stream));
+}
+
 } } }
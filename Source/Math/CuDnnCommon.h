@@ -38,6 +38,8 @@ struct CuDnn final
 {
     using ptr_t = std::shared_ptr<cudnnHandle_t>;
     static ptr_t Instance();
+    // called by SetStream(); does not create the handle
+    static void SetStream(cudaStream_t stream);
 
     DISABLE_COPY_AND_MOVE(CuDnn);
 };
@@ -10,6 +10,7 @@
 #include <typeinfo>
 #include <typeindex>
 #include "CuDnnCommon.h"
+#include "ConvolutionAlgorithmCache.h"
 
 template <>
 const char* CudaErrString<cudnnStatus_t>(cudnnStatus_t x)
@@ -197,6 +198,37 @@ public:
 
     virtual bool ImplementsGradientOverwriteOptimization() const override { return true; }
 
+    void Autotune(const std::vector<size_t>& batchSizes) override
+    {
+        if (m_poolKind != PoolKind::None || batchSizes.empty())
+            return;
+        const auto& g = *m_geometry;
+        Mat kernel(g.KernelCount(), g.KernelShape().GetNumElements(), m_deviceId);
+        kernel.SetValue(0);
+        for (size_t batchSize : batchSizes)
+        {
+            Mat in(g.InputShape().GetNumElements(), batchSize, m_deviceId);
+            Mat out(g.OutputShape().GetNumElements(), batchSize, m_deviceId);
+            Mat workspace(m_deviceId);
+            in.SetValue(0);
+            out.SetValue(0);
+            // Every minibatch size is tuned from scratch: the first call of each operation only selects an algorithm
+            // that needs no workspace, the second one tunes and stores the result in the algorithm cache.
+            ResetAutotuning();
+            for (int i = 0; i < 2; i++)
+            {
+                this->Forward(in, kernel, out, workspace);
+                this->BackwardData(out, kernel, in, /*accumulateGradient=*/false, workspace);
+                this->BackwardKernel(out, in, kernel, /*accumulateGradient=*/false, /*allowReuse=*/false, workspace);
+            }
+        }
+        // training starts over, and finds the algorithms in the cache
+        ResetAutotuning();
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "Autotuned cuDNN convolution for %d minibatch sizes, %d algorithms cached: %s\n",
+                    (int) batchSizes.size(), (int) ConvolutionAlgorithmCache::Instance().Size(), ((std::string) g).c_str());
+    }
+
 protected:
     using Base::m_geometry;
     using Base::m_deviceId;
@@ -219,6 +251,14 @@ protected:
         {
             m_kernelT = std::make_unique<CuDnnKernel>(*m_geometry, m_dataType);
             m_conv = std::make_unique<CuDnnConv>(*m_geometry, m_dataType);
+
+            cudaDeviceProp props = {0};
+            CUDA_CALL(cudaGetDeviceProperties(&props, m_deviceId));
+            m_algorithmCacheKeyPrefix = msra::strfun::strprintf("%s sm_%d%d|cuDNN %d|%s|maxTempMemSizeInSamples=%d|deterministic=%d|",
+                                                                props.name, props.major, props.minor, (int) cudnnGetVersion(),
+                                                                typeid(ElemType) == typeid(float) ? "float" : "double",
+                                                                (int) m_maxTempMemSizeInSamples, (int) m_forceDeterministicAlgorithms) +
+                                        (std::string) *m_geometry;
         }
     }
 
@@ -268,7 +308,7 @@ protected:
             }
             return err; 
         }; 
-        FindBestAlgo(batchSize, m_fwdAlgo, workspaceSizeFinder, deterministicFinder, finder, staticFinder, workspace);
+        FindBestAlgo("forward", batchSize, m_fwdAlgo, workspaceSizeFinder, deterministicFinder, finder, staticFinder, workspace);
         // Perform forward convolution operation.
         CUDNN_CALL(cudnnConvolutionForward(*m_cudnn, &C::One, m_inT, ptr(in), *m_kernelT, ptr(kernel), *m_conv, m_fwdAlgo.selectedAlgo, ptr(workspace), workspace.BufferSize(), &C::Zero, m_outT, ptr(out)));
     }
@@ -330,7 +370,7 @@ protected:
             }
             return err;
         }; 
-        FindBestAlgo(batchSize, m_backDataAlgo, workspaceSizeFinder, deterministicFinder, finder, staticFinder, workspace);
+        FindBestAlgo("backwardData", batchSize, m_backDataAlgo, workspaceSizeFinder, deterministicFinder, finder, staticFinder, workspace);
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardData(*m_cudnn, &C::One, *m_kernelT, ptr(kernel), m_outT, ptr(srcGrad), *m_conv, m_backDataAlgo.selectedAlgo, ptr(workspace), workspace.BufferSize(), accumulateGradient ? &C::One : &C::Zero, m_inT, ptr(grad)));
     }
@@ -392,7 +432,7 @@ protected:
             }
             return err;
         }; 
-        FindBestAlgo(batchSize, m_backFiltAlgo, workspaceSizeFinder, deterministicFinder, finder, staticFinder, workspace);
+        FindBestAlgo("backwardFilter", batchSize, m_backFiltAlgo, workspaceSizeFinder, deterministicFinder, finder, staticFinder, workspace);
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardFilter(*m_cudnn, &C::One, m_inT, ptr(in), m_outT, ptr(srcGrad), *m_conv, m_backFiltAlgo.selectedAlgo, ptr(workspace), workspace.BufferSize(), accumulateGradient ? &C::One : &C::Zero, *m_kernelT, ptr(kernelGrad)));
     }
@@ -435,7 +475,7 @@ private:
     static const int MaxAlgoCount = 10;
 
     template <typename TAlgo, typename TWorkspaceSizeFinder, typename TDeterministicFinder, typename TFinder, typename TStaticFinder>
-    void FindBestAlgo(size_t batchSize, TAlgo& algo, TWorkspaceSizeFinder workspaceSizeFinder, TDeterministicFinder deterministicFinder, TFinder finder, TStaticFinder staticFinder, Mat& workspace)
+    void FindBestAlgo(const char* operation, size_t batchSize, TAlgo& algo, TWorkspaceSizeFinder workspaceSizeFinder, TDeterministicFinder deterministicFinder, TFinder finder, TStaticFinder staticFinder, Mat& workspace)
     {
         m_inT.UpdateBatchSize(batchSize);
         m_outT.UpdateBatchSize(batchSize);
@@ -461,6 +501,10 @@ private:
 
         typename TAlgo::typeT algoPerf[MaxAlgoCount];
         int calgo = 0;
+        typedef decltype(algo.selectedAlgo) AlgoT;
+        const std::string cacheKey = m_algorithmCacheKeyPrefix + msra::strfun::strprintf("|%s|N=%d", operation, (int) batchSize);
+        ConvolutionAlgorithmCache& cache = ConvolutionAlgorithmCache::Instance();
+        ConvolutionAlgorithmCache::Entry cached;
         // in initState, where memory allocation for nodes are not completed, we only run the algorithm with no workspace
         // or in the special case when m_forceDeterministicAlgorithms, we allocate some memory and use the deterministic algorithm 
         if (algo.autotuningState == AutotuningState::Init)
@@ -470,13 +514,22 @@ private:
             if (m_forceDeterministicAlgorithms)
             {
                 workspace.Resize((algo.DeterministicAlgoWorkspaceSize + sizeof(ElemType) - 1) / sizeof(ElemType), 1, 0, false);
-                CUDNN_CALL(deterministicFinder(calgo, algoPerf));
-                assert(calgo == 1);                                 // only one deterministic algorithm will be returned 
+                if (cache.Find(cacheKey, cached))
+                {
+                    algo.selectedAlgo = (AlgoT) cached.algorithm;
+                    algo.AlgoWorkspaceSize = cached.workspaceSize;
+                }
+                else
+                {
+                    CUDNN_CALL(deterministicFinder(calgo, algoPerf));
+                    assert(calgo == 1);                             // only one deterministic algorithm will be returned 
+                    algo.selectedAlgo = (*algoPerf).algo;           // deterministic algorithm is the first in the list  
+                    algo.AlgoWorkspaceSize = (*algoPerf).memory;
+                    cache.Insert(cacheKey, { (int) algo.selectedAlgo, algo.AlgoWorkspaceSize });
+                }
                 algo.MBSizeForCurrentAlgo = batchSize;
-                algo.selectedAlgo = (*algoPerf).algo;               // deterministic algorithm is the first in the list  
                 algo.maxAlgo = algo.selectedAlgo;
                 algo.autotuningState = AutotuningState::Running;    // no further need for tuning since this is deterministic, directly enter running state 
-                algo.AlgoWorkspaceSize = (*algoPerf).memory;
             }
             else
             {
@@ -493,6 +546,18 @@ private:
         {
             size_t curSize = workspace.BufferSize();
 
+            // tuned before, in this or an earlier run
+            if (cache.Find(cacheKey, cached) && TryResizeWorkspace(workspace, std::max<size_t>(curSize, cached.workspaceSize)))
+            {
+                algo.MBSizeForCurrentWorkspace = batchSize;
+                algo.MBSizeForCurrentAlgo = batchSize;
+                algo.selectedAlgo = (AlgoT) cached.algorithm;
+                algo.maxAlgo = algo.selectedAlgo;
+                algo.autotuningState = AutotuningState::Running;
+                algo.AlgoWorkspaceSize = cached.workspaceSize;
+                return;
+            }
+
             // To control memory usage. No one seems to be using this flag
             size_t inputSampleSize = m_geometry->InputShape().GetNumElements();
             size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inputSampleSize * m_maxTempMemSizeInSamples * sizeof(ElemType);
@@ -522,6 +587,7 @@ private:
                 algo.maxAlgo = algo.selectedAlgo;
                 algo.autotuningState = AutotuningState::Running;
                 algo.AlgoWorkspaceSize = (*res).memory;
+                cache.Insert(cacheKey, { (int) algo.selectedAlgo, algo.AlgoWorkspaceSize });
                 if (algo.AlgoWorkspaceSize < curSize)   // need to shrink the workspace
                     workspace.Resize((curSize + sizeof(ElemType) - 1) / sizeof(ElemType), 1, 0, false);
                 else
@@ -542,6 +608,7 @@ private:
                     algo.maxAlgo = algo.selectedAlgo;
                     algo.autotuningState = AutotuningState::Running;
                     algo.AlgoWorkspaceSize = (*res).memory;
+                    cache.Insert(cacheKey, { (int) algo.selectedAlgo, algo.AlgoWorkspaceSize });
                 } 
                 catch (...) 
                 {   // fails again, let's fall back to cudnnGet
@@ -562,13 +629,38 @@ private:
         }
         else    // use fast/static method to get algorithm when batchsize get smaller, assuming workspace size doesn't expand. Avoid severe slowdown when batchsize change frequently
         {
-            CUDNN_CALL(staticFinder(algo.selectedAlgo, false));
+            // unless this size was tuned before, with an algorithm that fits into the workspace
+            if (cache.Find(cacheKey, cached) && cached.workspaceSize <= workspace.BufferSize())
+                algo.selectedAlgo = (AlgoT) cached.algorithm;
+            else
+                CUDNN_CALL(staticFinder(algo.selectedAlgo, false));
             algo.MBSizeForCurrentAlgo = batchSize;
             algo.autotuningState = AutotuningState::Running;
         }
         return;
     }
 
+    // the workspace stays as it is if the resize fails
+    static bool TryResizeWorkspace(Mat& workspace, size_t numBytes)
+    {
+        try
+        {
+            workspace.Resize((numBytes + sizeof(ElemType) - 1) / sizeof(ElemType), 1, 0, false);
+            return true;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+
+    void ResetAutotuning()
+    {
+        m_fwdAlgo = ConvAlgoInfo<cudnnConvolutionFwdAlgoPerf_t>();
+        m_backDataAlgo = ConvAlgoInfo<cudnnConvolutionBwdDataAlgoPerf_t>();
+        m_backFiltAlgo = ConvAlgoInfo<cudnnConvolutionBwdFilterAlgoPerf_t>();
+    }
+
     static ElemType* ptr(Mat& src)
     {
         return src.Data();
@@ -626,6 +718,8 @@ private:
 
     // Flag indicating whether only deterministic algorithms should be used.
     bool m_forceDeterministicAlgorithms;
+    // device, cuDNN version and geometry part of the keys in the ConvolutionAlgorithmCache
+    std::string m_algorithmCacheKeyPrefix;
 };
 
 template <class ElemType>
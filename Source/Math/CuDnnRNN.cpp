@@ -60,6 +60,17 @@ void CuDnnRNNExecutor<ElemType>::SetDescriptors(size_t dim, const vector<size_t>
     }
 }
 
+template <class ElemType>
+void CuDnnRNNExecutor<ElemType>::EnsureWorkspaceSize(GPUMatrix<ElemType>& workspace)
+{
+    size_t workSize;
+    CUDNN_CALL(cudnnGetRNNWorkspaceSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &workSize));
+    // convert from bytes to ElemType
+    workSize = (workSize + sizeof(ElemType) - 1) / (sizeof(ElemType));
+    if (workspace.GetNumElements() < workSize)
+        workspace.Resize(workSize, 1);
+}
+
 template <class ElemType>
 void CuDnnRNNExecutor<ElemType>::ForwardCore(
     const GPUMatrix<ElemType>& weightsW,
@@ -82,20 +93,17 @@ void CuDnnRNNExecutor<ElemType>::ForwardCore(
 
     // ensure workspace and reserve are large enough
     m_seqLength = numSequencesForFrame.size();
-    size_t workSize;
     size_t reserveSize;
 
-    // Need for every pass
-    CUDNN_CALL(cudnnGetRNNWorkspaceSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &workSize));
     // Only needed in training, can't be touched between passes.
     CUDNN_CALL(cudnnGetRNNTrainingReserveSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &reserveSize));
 
     // convert from bytes to ElemType
-    workSize = (workSize + sizeof(ElemType) - 1) / (sizeof(ElemType));
     reserveSize = (reserveSize + sizeof(ElemType) - 1) / sizeof(ElemType);
 
     reserve.Resize(reserveSize, 1);
-    workspace.Resize(workSize, 1);
+    // Need for every pass
+    EnsureWorkspaceSize(workspace);
 
     wDesc = make_unique<CuDnnFilter<ElemType>>(*m_rnnT, xDesc[0]);
     if (wDesc->GetSize() != weightsW.GetNumElements())
@@ -129,6 +137,7 @@ void CuDnnRNNExecutor<ElemType>::BackwardDataCore(
 
     if (!m_BackwardDataCalledYet)
     {
+        EnsureWorkspaceSize(workspace);
         CUDNN_CALL(cudnnRNNBackwardData(
             *m_cudnn, *m_rnnT,
             (int)m_seqLength,
@@ -159,6 +168,7 @@ void CuDnnRNNExecutor<ElemType>::BackwardWeightsCore(const GPUMatrix<ElemType>&
         LogicError("RNN Layout has changed during processing");
     if (!m_BackwardDataCalledYet)
         LogicError("out of order calling you have been very bad");
+    EnsureWorkspaceSize(workspace);
     CUDNN_CALL(cudnnRNNBackwardWeights(
         *m_cudnn, *m_rnnT,
         (int)m_seqLength,
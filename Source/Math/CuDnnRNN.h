@@ -213,6 +213,8 @@ private:
     }
 
     void SetDescriptors(size_t dim, const vector<size_t>& numSequencesForFrame, vector<cudnnTensorDescriptor_t>& descriptors);
+    // the workspace is not kept between calls, so the forward and backward passes may use different ones, e.g. shared with other nodes
+    void EnsureWorkspaceSize(GPUMatrix<ElemType>& workspace);
 
 private:
     std::unique_ptr<CuDnnRNN<ElemType>> m_rnnT;
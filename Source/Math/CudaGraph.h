@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CudaGraph.h -- records the GPU work of a function once and replays it with a single launch
+//
+// Capture() runs the function with the current stream switched to a capture stream: the kernels and copies it issues are
+// recorded into a CUDA graph instead of being executed. Launch() then issues the whole graph to the current stream at the
+// cost of one launch. A graph replays the kernels with the arguments and addresses they were captured with, so it is
+// only valid as long as
+//  - the host code of the function would issue exactly the same work again (same shapes, same host-side state), which
+//    the caller has to ensure, and
+//  - the device memory it uses is still allocated; this is tracked by the caching device allocator (see
+//    CachingDeviceAllocator.h), which also keeps the blocks freed during capture for the graph.
+// Work that cannot be captured (synchronous copies, anything on the legacy default stream such as cuRAND, device
+// synchronization) makes Capture() fail, and the function has to be run again without capture.
+//
+// Requires CUDA 10.1 and caching of device memory (TracingGPUMemoryAllocator::SetCachingEnabled()).
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <functional>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API CudaGraph
+{
+public:
+    // Records the work that 'issueWork' issues on 'deviceId', without executing it. Returns nullptr if the work could
+    // not be captured; then none of it has run. Also returns nullptr for CPU devices and if capture is not supported.
+    static std::unique_ptr<CudaGraph> Capture(DEVICEID_TYPE deviceId, const std::function<void()>& issueWork);
+
+    ~CudaGraph();
+
+    // issues the captured work to the current stream
+    void Launch();
+    // false once device memory that was in use when the graph was captured has been freed
+    bool IsValid() const;
+
+private:
+    CudaGraph(DEVICEID_TYPE deviceId, void* graphExec, size_t captureId);
+    CudaGraph(const CudaGraph&) = delete;
+    CudaGraph& operator=(const CudaGraph&) = delete;
+
+    DEVICEID_TYPE m_deviceId;
+    void* m_graphExec; // cudaGraphExec_t
+    size_t m_captureId; // of the caching device allocator
+};
+
+}}}
@@ -0,0 +1,113 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Float16.h -- IEEE 754 binary16 storage type and float <-> half conversions, usable from host and CUDA code.
+//
+// Matrices are still computed in float; Float16 is only used as a storage/transfer format, e.g. for the
+// operands of the mixed-precision GEMM in GPUMatrix.cu (fp16 inputs, fp32 accumulation, fp32 master weights).
+// The conversions are plain bit manipulation, so host and device code produce bit-identical results (rounding
+// to nearest even, like __float2half_rn()), and nothing depends on the cuda_fp16.h of a particular CUDA version.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __CUDACC__
+#define FLOAT16_DECL __host__ __device__ inline
+#else
+#define FLOAT16_DECL inline
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// bit pattern of the binary16 number closest to f (round to nearest even); NaNs stay NaNs
+FLOAT16_DECL uint16_t FloatToFloat16Bits(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const uint32_t absx = x & 0x7fffffff;
+
+    if (absx >= 0x7f800000) // Inf or NaN; keep the top of a NaN payload and make sure it stays a NaN
+        return (uint16_t)(sign | 0x7c00 | (absx > 0x7f800000 ? (0x200 | ((absx >> 13) & 0x3ff)) : 0));
+    if (absx >= 0x477ff000) // rounds to 65520 or more, which is beyond the largest half (65504)
+        return (uint16_t)(sign | 0x7c00);
+    if (absx < 0x33000000) // below 2^-25, rounds to zero
+        return (uint16_t)sign;
+
+    uint32_t result, remainder, halfway;
+    if (absx < 0x38800000) // below 2^-14: half subnormal, i.e. a multiple of 2^-24
+    {
+        const uint32_t mantissa = (absx & 0x7fffff) | 0x800000;
+        const uint32_t shift = 126 - (absx >> 23);
+        result = mantissa >> shift;
+        remainder = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    }
+    else // normal: rebias the exponent from 127 to 15 and drop 13 mantissa bits
+    {
+        result = (absx - 0x38000000) >> 13;
+        remainder = absx & 0x1fff;
+        halfway = 0x1000;
+    }
+    // a carry out of the mantissa correctly bumps the exponent
+    if (remainder > halfway || (remainder == halfway && (result & 1)))
+        result++;
+    return (uint16_t)(sign | result);
+}
+
+FLOAT16_DECL float Float16BitsToFloat(uint16_t h)
+{
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    const uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t x;
+    if (exponent == 0x1f) // Inf or NaN
+        x = sign | 0x7f800000 | (mantissa << 13);
+    else if (exponent != 0)
+        x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        x = sign;
+    else // subnormal half: normalize, it is a normal float
+    {
+        uint32_t floatExponent = 127 - 14;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            floatExponent--;
+        }
+        x = sign | (floatExponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// IEEE binary16 value. Same size and layout as CUDA's __half, so arrays of it can be handed to cuBLAS/cuDNN as CUDA_R_16F.
+struct Float16
+{
+    uint16_t m_bits;
+
+    Float16() = default;
+    FLOAT16_DECL explicit Float16(float f) : m_bits(FloatToFloat16Bits(f)) {}
+    FLOAT16_DECL operator float() const { return Float16BitsToFloat(m_bits); }
+
+    FLOAT16_DECL static Float16 FromBits(uint16_t bits)
+    {
+        Float16 h;
+        h.m_bits = bits;
+        return h;
+    }
+
+    // largest finite value; gradients of larger magnitude overflow to Inf, see dynamic loss scaling in the V2 learners
+    FLOAT16_DECL static float Max() { return 65504.0f; }
+};
+
+static_assert(sizeof(Float16) == 2, "Float16 must be a plain 16-bit value");
+
+}}}
+
+#undef FLOAT16_DECL
@@ -198,6 +198,33 @@ void GPUDataTransferer::WaitForCopyCPUToGPUAsync()
     SyncEvent(m_inner->m_assignCompleteEvent);
 }
 
+/// OffloadGPUDataTransferer
+
+cudaStream_t OffloadGPUDataTransferer::s_offloadStream = NULL;
+
+cudaStream_t OffloadGPUDataTransferer::s_prefetchStream = NULL;
+
+OffloadGPUDataTransferer::OffloadGPUDataTransferer(int deviceId) : GranularGPUDataTransferer(deviceId, s_offloadStream, s_prefetchStream)
+{
+    if (s_offloadStream == NULL)
+    {
+        cudaStreamCreateWithFlags(&s_offloadStream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed (OffloadGPUDataTransferer ctor)";
+        cudaStreamCreateWithFlags(&s_prefetchStream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed (OffloadGPUDataTransferer ctor)";
+    }
+}
+
+void OffloadGPUDataTransferer::WaitForCopyGPUToCPUOnComputeStreamAsync()
+{
+    PrepareDevice(m_deviceId);
+    cudaStreamWaitEvent(GetStream(), m_fetchCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
+void OffloadGPUDataTransferer::WaitForCopyCPUToGPUOnComputeStreamAsync()
+{
+    PrepareDevice(m_deviceId);
+    cudaStreamWaitEvent(GetStream(), m_assignCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
 /// PrefetchGPUDataTransferer
 
 PrefetchGPUDataTransferer::PrefetchGPUDataTransferer(int deviceId) : GranularGPUDataTransferer(deviceId, nullptr, nullptr, true)
@@ -148,4 +148,29 @@ private:
     DISABLE_COPY_AND_MOVE(PrefetchGPUDataTransferer);
 };
 
+// Transferer for moving node values to host memory during the forward pass and back before the backward pass
+// reads them. The copies of all instances run on two copy streams of their own, one per direction, and are
+// ordered with the compute stream by events only, so neither the host nor the compute stream waits unless a
+// copy is late.
+class MATH_API OffloadGPUDataTransferer : public GranularGPUDataTransferer
+{
+public:
+    OffloadGPUDataTransferer(int deviceId);
+
+    // Makes the compute stream wait for the copies recorded by RecordGPUToCPUCopy(), without blocking the host.
+    void WaitForCopyGPUToCPUOnComputeStreamAsync();
+
+    // Makes the compute stream wait for the copies recorded by RecordCPUToGPUCopy(), without blocking the host.
+    void WaitForCopyCPUToGPUOnComputeStreamAsync();
+
+private:
+#ifndef CPUONLY
+    // BUGBUG: like those of GPUDataTransferer, these streams are never destroyed
+    static cudaStream_t s_offloadStream;
+    static cudaStream_t s_prefetchStream;
+#endif
+
+    DISABLE_COPY_AND_MOVE(OffloadGPUDataTransferer);
+};
+
 }}}
\ No newline at end of file
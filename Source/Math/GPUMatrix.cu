@@ -14,6 +14,10 @@
 //#include "GPUSparseMatrix.h"
 #include "GPUTensor.h"
 #include "CommonMatrix.h"
+#include "CachingDeviceAllocator.h"
+#include "ComputeStreamPool.h"
+#include "CudaGraph.h"
+#include "Globals.h"
 #define TENSOR_OPS_DECL __device__ __host__
 #include "TensorOps.h"
 #include "device_launch_parameters.h"
@@ -23,7 +27,10 @@
 #include <curand_kernel.h>
 #include "cublas_v2.h"
 #include <assert.h>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <type_traits>
 #include "CntkBatchNormalization.cuh"
 #include "Convolution.cuh"
 #include "CuDnnRNN.h"
@@ -55,6 +62,7 @@ extern int _ConvertSMVer2Cores(int major, int minor); // forward declaration
 void MATH_API SetStream(cudaStream_t stream)
 {
     t_stream = stream;
+    Microsoft::MSR::CNTK::CuDnn::SetStream(stream); // unlike cuBLAS and cuSPARSE, the cuDNN handle is not re-bound for each call
 }
 
 // GetStream - get the stream that will be used by the GPU routines
@@ -203,14 +211,78 @@ AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numE
     return deviceBufferPtr;
 }
 
+// The caches of freed device memory, created on first use. They are never deleted: freeing device memory during
+// static destruction fails once the CUDA runtime has shut down, and at process exit the driver releases it anyway.
+static std::atomic<CachingDeviceAllocator*> s_memoryCaches[MAX_GPUS];
+
+static CachingDeviceAllocator* ExistingMemoryCache(int deviceId)
+{
+    return (deviceId >= 0 && deviceId < MAX_GPUS) ? s_memoryCaches[deviceId].load() : nullptr;
+}
+
+static CachingDeviceAllocator& MemoryCache(int deviceId)
+{
+    if (deviceId < 0 || deviceId >= MAX_GPUS)
+        LogicError("MemoryCache: Invalid GPU %d.", deviceId);
+    static std::once_flag s_created[MAX_GPUS];
+    std::call_once(s_created[deviceId], [deviceId]()
+    {
+        auto rawAllocate = [deviceId](size_t numBytes) -> void*
+        {
+            PrepareDevice(deviceId);
+            void* p = nullptr;
+            cudaError_t result = cudaMalloc(&p, numBytes);
+            if (result == cudaErrorMemoryAllocation)
+            {
+                cudaGetLastError(); // the cache is released and the allocation retried, don't report the error later
+                return nullptr;
+            }
+            CUDA_CALL(result);
+            return p;
+        };
+        auto rawFree = [deviceId](void* p)
+        {
+            PrepareDevice(deviceId);
+            CUDA_CALL(cudaFree(p));
+        };
+        s_memoryCaches[deviceId] = new CachingDeviceAllocator(rawAllocate, rawFree);
+    });
+    return *s_memoryCaches[deviceId];
+}
+
+#if CUDART_VERSION >= 10010
+// the stream that was current when capture began on each device (see CudaGraph::Capture())
+static cudaStream_t s_captureOriginStreams[MAX_GPUS];
+#endif
+
+// Blocks allocated while a graph is being captured belong to the stream the graph is launched to, also if they are
+// allocated on one of the streams that take part in the capture.
+static const void* AllocationStream(int deviceId)
+{
+    cudaStream_t stream = GetStream();
+#if CUDART_VERSION >= 10010
+    cudaStreamCaptureStatus status;
+    if (cudaStreamIsCapturing(stream, &status) == cudaSuccess && status == cudaStreamCaptureStatusActive)
+        return s_captureOriginStreams[deviceId];
+#else
+    UNUSED(deviceId);
+#endif
+    return stream;
+}
+
 template <typename AllocatedElemType>
 void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr, bool ignoreCUDARetCode /*= false*/)
 {
     PrepareDevice(deviceId);
-    if (ignoreCUDARetCode)
-        cudaFree((void*) bufferPtr);
-    else
-        CUDA_CALL(cudaFree((void*) bufferPtr));
+    // blocks allocated while caching was disabled, and null pointers, are not known to the cache
+    CachingDeviceAllocator* memoryCache = ExistingMemoryCache(deviceId);
+    if (!memoryCache || !memoryCache->Free((void*) bufferPtr))
+    {
+        if (ignoreCUDARetCode)
+            cudaFree((void*) bufferPtr);
+        else
+            CUDA_CALL(cudaFree((void*) bufferPtr));
+    }
 
     if (IsTraceEnabled())
     {
@@ -232,11 +304,270 @@ AllocatedElemType* TracingGPUMemoryAllocator::AllocateNoTrace(int deviceId, size
     // In case numElements is odd we allocate a buffer with one more element. The reason is 
     // we might call curandGenerateNormal (e.g. for Gaussian noise injection) which would fail
     // if the number of elements it needs to generate is odd.
-    CUDA_CALL(cudaMalloc((void**) &deviceBufferPtr, sizeof(AllocatedElemType) * asMultipleOf(numElements, 2)));
+    const size_t numBytes = sizeof(AllocatedElemType) * asMultipleOf(numElements, 2);
+    if (!IsCachingEnabled() || numBytes == 0)
+    {
+        CUDA_CALL(cudaMalloc((void**) &deviceBufferPtr, numBytes));
+        return deviceBufferPtr;
+    }
 
+    deviceBufferPtr = (AllocatedElemType*) MemoryCache(deviceId).Allocate(numBytes, AllocationStream(deviceId));
+    if (!deviceBufferPtr) // out of memory, also after releasing the cached blocks
+        CudaCall(cudaErrorMemoryAllocation, "cudaMalloc", "CUDA", cudaSuccess, msra::strfun::strprintf(" (%d bytes)", (int) numBytes).c_str());
     return deviceBufferPtr;
 }
 
+void TracingGPUMemoryAllocator::EmptyCache(int deviceId /*= -1*/)
+{
+    for (int id = 0; id < MAX_GPUS; id++)
+    {
+        CachingDeviceAllocator* memoryCache = ExistingMemoryCache(id);
+        if (memoryCache && (deviceId < 0 || deviceId == id))
+            memoryCache->EmptyCache();
+    }
+}
+
+DeviceMemoryStatistics TracingGPUMemoryAllocator::GetMemoryStatistics(int deviceId)
+{
+    CachingDeviceAllocator* memoryCache = ExistingMemoryCache(deviceId);
+    return memoryCache ? memoryCache->GetStatistics() : DeviceMemoryStatistics();
+}
+
+void TracingGPUMemoryAllocator::ResetPeakMemoryStatistics(int deviceId /*= -1*/)
+{
+    for (int id = 0; id < MAX_GPUS; id++)
+    {
+        CachingDeviceAllocator* memoryCache = ExistingMemoryCache(id);
+        if (memoryCache && (deviceId < 0 || deviceId == id))
+            memoryCache->ResetPeakStatistics();
+    }
+}
+
+void TracingGPUMemoryAllocator::PrintMemoryStatistics(int deviceId /*= -1*/)
+{
+    const double numBytesPerMB = 1 << 20;
+    for (int id = 0; id < MAX_GPUS; id++)
+    {
+        CachingDeviceAllocator* memoryCache = ExistingMemoryCache(id);
+        if (!memoryCache || (deviceId >= 0 && deviceId != id))
+            continue;
+        const DeviceMemoryStatistics s = memoryCache->GetStatistics();
+        fprintf(stderr, "GPU %d memory: %.1f MB in use (peak %.1f MB), %.1f MB cached, %.1f MB fragmented; %.1f MB reserved (peak %.1f MB)\n",
+                id, s.allocatedBytes / numBytesPerMB, s.peakAllocatedBytes / numBytesPerMB, s.cachedBytes / numBytesPerMB,
+                s.FragmentedBytes() / numBytesPerMB, s.reservedBytes / numBytesPerMB, s.peakReservedBytes / numBytesPerMB);
+        fprintf(stderr, "GPU %d memory: %d of %d allocations served from the cache; %d cudaMalloc() and %d cudaFree() calls\n",
+                id, (int) s.numCacheHits, (int) s.numAllocations, (int) s.numRawAllocations, (int) s.numRawFrees);
+    }
+}
+
+// -----------------------------------------------------------------------
+// ComputeStreamPool
+// -----------------------------------------------------------------------
+
+/*static*/ std::shared_ptr<ComputeStreamPool> ComputeStreamPool::Get(DEVICEID_TYPE deviceId, size_t numStreams)
+{
+    if (deviceId < 0 || deviceId >= MAX_GPUS)
+        return nullptr;
+    static std::mutex s_mutex;
+    static std::shared_ptr<ComputeStreamPool> s_pools[MAX_GPUS];
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto& pool = s_pools[deviceId];
+    if (!pool || pool->NumStreams() < numStreams)
+    {
+        if (pool && pool->IsInRegion())
+            LogicError("ComputeStreamPool: Cannot add streams during a region.");
+        pool.reset(new ComputeStreamPool(deviceId, numStreams));
+    }
+    return pool;
+}
+
+/*static*/ void* ComputeStreamPool::CurrentStream()
+{
+    return GetStream();
+}
+
+ComputeStreamPool::ComputeStreamPool(DEVICEID_TYPE deviceId, size_t numStreams)
+    : m_deviceId(deviceId), m_streamUsed(numStreams, false), m_mainStream(nullptr), m_inRegion(false)
+{
+    PrepareDevice(deviceId);
+    for (size_t i = 0; i < numStreams; i++)
+    {
+        cudaStream_t stream;
+        CUDA_CALL(cudaStreamCreate(&stream)); // blocking, see header
+        m_streams.push_back(stream);
+        cudaEvent_t event;
+        CUDA_CALL(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+        m_streamEvents.push_back(event);
+    }
+    cudaEvent_t event;
+    CUDA_CALL(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+    m_regionBeginEvent = event;
+}
+
+ComputeStreamPool::~ComputeStreamPool()
+{
+    // an older pool being replaced by a larger one; at process exit the device may be gone already, hence no error checks
+    for (auto event : m_events)
+        cudaEventDestroy((cudaEvent_t) event);
+    for (auto event : m_streamEvents)
+        cudaEventDestroy((cudaEvent_t) event);
+    cudaEventDestroy((cudaEvent_t) m_regionBeginEvent);
+    for (auto stream : m_streams)
+        cudaStreamDestroy((cudaStream_t) stream);
+}
+
+void ComputeStreamPool::BeginRegion()
+{
+    if (m_inRegion)
+        LogicError("ComputeStreamPool: BeginRegion() was called twice.");
+    m_mainStream = GetStream();
+    CUDA_CALL(cudaEventRecord((cudaEvent_t) m_regionBeginEvent, (cudaStream_t) m_mainStream));
+    m_streamUsed.assign(m_streams.size(), false);
+    m_inRegion = true;
+}
+
+void ComputeStreamPool::SelectStream(size_t stream)
+{
+    if (!m_inRegion || stream >= m_streams.size())
+        LogicError("ComputeStreamPool: SelectStream() called outside a region or for a stream that does not exist.");
+    if (!m_streamUsed[stream]) // the streams join the main stream when they are first used
+    {
+        CUDA_CALL(cudaStreamWaitEvent((cudaStream_t) m_streams[stream], (cudaEvent_t) m_regionBeginEvent, 0));
+        m_streamUsed[stream] = true;
+    }
+    SetStream((cudaStream_t) m_streams[stream]);
+}
+
+void ComputeStreamPool::RecordEvent(size_t event)
+{
+    while (m_events.size() <= event)
+    {
+        cudaEvent_t newEvent;
+        CUDA_CALL(cudaEventCreateWithFlags(&newEvent, cudaEventDisableTiming));
+        m_events.push_back(newEvent);
+    }
+    CUDA_CALL(cudaEventRecord((cudaEvent_t) m_events[event], GetStream()));
+}
+
+void ComputeStreamPool::WaitForEvent(size_t event)
+{
+    if (event >= m_events.size())
+        LogicError("ComputeStreamPool: WaitForEvent() for an event that was never recorded.");
+    CUDA_CALL(cudaStreamWaitEvent(GetStream(), (cudaEvent_t) m_events[event], 0));
+}
+
+void ComputeStreamPool::EndRegion()
+{
+    if (!m_inRegion)
+        return;
+    m_inRegion = false;
+    SetStream((cudaStream_t) m_mainStream);
+    for (size_t i = 0; i < m_streams.size(); i++)
+    {
+        if (!m_streamUsed[i])
+            continue;
+        CUDA_CALL(cudaEventRecord((cudaEvent_t) m_streamEvents[i], (cudaStream_t) m_streams[i]));
+        CUDA_CALL(cudaStreamWaitEvent((cudaStream_t) m_mainStream, (cudaEvent_t) m_streamEvents[i], 0));
+    }
+}
+
+// -----------------------------------------------------------------------
+// CudaGraph
+// -----------------------------------------------------------------------
+
+/*static*/ std::unique_ptr<CudaGraph> CudaGraph::Capture(DEVICEID_TYPE deviceId, const std::function<void()>& issueWork)
+{
+#if CUDART_VERSION >= 10010
+    if (deviceId < 0 || deviceId >= MAX_GPUS || !TracingGPUMemoryAllocator::IsCachingEnabled())
+        return nullptr;
+    PrepareDevice(deviceId);
+    static cudaStream_t s_captureStreams[MAX_GPUS];
+    cudaStream_t& captureStream = s_captureStreams[deviceId];
+    if (!captureStream)
+        CUDA_CALL(cudaStreamCreate(&captureStream)); // blocking: work issued to the legacy default stream fails the capture
+
+    CachingDeviceAllocator& memoryCache = MemoryCache(deviceId);
+    const cudaStream_t originStream = GetStream();
+    s_captureOriginStreams[deviceId] = originStream;
+    memoryCache.BeginCapture();
+    SetStream(captureStream);
+
+    // relaxed, so that other threads (e.g. readers prefetching to the GPU) are not affected
+    std::string failure;
+    cudaGraph_t graph = nullptr;
+    cudaError_t result = cudaStreamBeginCapture(captureStream, cudaStreamCaptureModeRelaxed);
+    if (result == cudaSuccess)
+    {
+        try
+        {
+            issueWork();
+        }
+        catch (const std::exception& e)
+        {
+            failure = e.what();
+        }
+        // also ends a capture that was invalidated, e.g. by a synchronous copy
+        result = cudaStreamEndCapture(captureStream, &graph);
+    }
+    SetStream(originStream);
+
+    cudaGraphExec_t graphExec = nullptr;
+    if (failure.empty() && result == cudaSuccess)
+    {
+#if CUDART_VERSION >= 12000
+        result = cudaGraphInstantiate(&graphExec, graph, 0);
+#else
+        result = cudaGraphInstantiate(&graphExec, graph, nullptr, nullptr, 0);
+#endif
+    }
+    if (graph)
+        cudaGraphDestroy(graph);
+    if (failure.empty() && result != cudaSuccess)
+        failure = cudaGetErrorString(result);
+    cudaGetLastError(); // errors of a failed capture are not sticky, don't report them later
+
+    const size_t captureId = memoryCache.EndCapture();
+    if (!failure.empty())
+    {
+        memoryCache.ReleaseCapture(captureId); // nothing has run
+        fprintf(stderr, "CudaGraph: The work cannot be captured (%s).\n", failure.c_str());
+        return nullptr;
+    }
+    return std::unique_ptr<CudaGraph>(new CudaGraph(deviceId, graphExec, captureId));
+#else
+    UNUSED(deviceId);
+    UNUSED(issueWork);
+    return nullptr;
+#endif
+}
+
+CudaGraph::CudaGraph(DEVICEID_TYPE deviceId, void* graphExec, size_t captureId)
+    : m_deviceId(deviceId), m_graphExec(graphExec), m_captureId(captureId)
+{
+}
+
+CudaGraph::~CudaGraph()
+{
+#if CUDART_VERSION >= 10010
+    // A launch in flight completes before the graph is freed. Its blocks are cached for the stream it was launched to.
+    cudaGraphExecDestroy((cudaGraphExec_t) m_graphExec);
+    MemoryCache(m_deviceId).ReleaseCapture(m_captureId);
+#endif
+}
+
+void CudaGraph::Launch()
+{
+#if CUDART_VERSION >= 10010
+    PrepareDevice(m_deviceId);
+    CUDA_CALL(cudaGraphLaunch((cudaGraphExec_t) m_graphExec, GetStream()));
+#endif
+}
+
+bool CudaGraph::IsValid() const
+{
+    return MemoryCache(m_deviceId).IsCaptureValid(m_captureId);
+}
+
 std::pair<size_t, size_t> TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(int deviceId)
 {
     PrepareDevice(deviceId);
@@ -934,32 +1265,67 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignTransposeOf(const GPUMatrix<Elem
     return *this;
 }
 
-template <class ElemType>
-__global__ void _doGatherColumnsOf(ElemType* us, size_t usStride, const ElemType beta, const ElemType* idx, size_t idxStride, const ElemType* a, size_t aStride, size_t aCols, const ElemType alpha, CUDA_LONG numElements)
+// a column of the gather and scatter kernels is processed in pieces of this many elements, which are loaded and
+// stored as one 16-byte vector if the rows and the data allow (float4, double2), else one element at a time
+template <class ElemType, int N>
+struct alignas(sizeof(ElemType) * N) ColumnPiece
 {
-    CUDA_LONG id = GridDim::GetLinearThreadId();
-    if (id >= numElements) // note: there are no __syncthread() calls inside
-        return;
+    ElemType e[N];
+};
 
-    // id = i + jOut * usStride;
-    // Each thread processes one element of the output matrix.
-    CUDA_LONG i    = id % usStride; // row index into 'us' and 'a'
-    CUDA_LONG jOut = id / usStride; // col index into 'us' and 'idx'
+// whether the matrices can be accessed in pieces of N elements, i.e. their columns start at a multiple of the vector size
+template <class ElemType, int N>
+static bool CanAccessInPiecesOf(size_t numRows, const ElemType* p1, const ElemType* p2)
+{
+    return numRows % N == 0 && (size_t)p1 % sizeof(ColumnPiece<ElemType, N>) == 0 && (size_t)p2 % sizeof(ColumnPiece<ElemType, N>) == 0;
+}
 
-    auto jInF = idx[jOut * idxStride]; // this is the column we need to get
-    if (::isnan(jInF) || jInF < 0)     // negative index means gap
-        return;
-    size_t jIn = (size_t)jInF;
-    //if (jIn >= aCols)
-    //    return; // actually a failure
+// launch configuration of the gather and scatter kernels: a block per column (looping over the columns if there are
+// more than blocks), whose threads run over the pieces of the column, so that the index is read once per column
+static void GetColumnsLaunchConfig(size_t numPieces, size_t numCols, int& blocksPerGrid, int& threadsPerBlock)
+{
+    threadsPerBlock = (int)min<size_t>(CeilDiv(max<size_t>(numPieces, 1), (size_t)32) * 32, 256);
+    blocksPerGrid = (int)min<size_t>(max<size_t>(numCols, 1), 65535);
+}
 
-    const ElemType&  ra = a[    i + jIn  *  aStride  ];
-    ElemType&       rus = us[id/*i + jOut * usStride*/];
+template <class ElemType, int N>
+__global__ void _doGatherColumnsOf(ColumnPiece<ElemType, N>* us, const ElemType beta, const ElemType* idx, size_t idxStride,
+                                   const ColumnPiece<ElemType, N>* a, const ElemType alpha, CUDA_LONG numPieces /*per column*/, CUDA_LONG numCols)
+{
+    for (CUDA_LONG jOut = blockIdx.x; jOut < numCols; jOut += gridDim.x)
+    {
+        auto jInF = idx[jOut * idxStride];  // this is the column we need to get
+        if (::isnan(jInF) || jInF < 0)      // negative index means gap
+            continue;
+        CUDA_LONG jIn = (CUDA_LONG)jInF;
+
+        const auto* pa = a  + jIn  * numPieces;
+        auto*      pus = us + jOut * numPieces;
+        for (CUDA_LONG i = threadIdx.x; i < numPieces; i += blockDim.x)
+        {
+            auto piece = pa[i];
+#pragma unroll
+            for (int k = 0; k < N; k++)
+                piece.e[k] *= alpha;
+            if (beta != 0)
+            {
+                const auto old = pus[i];
+#pragma unroll
+                for (int k = 0; k < N; k++)
+                    piece.e[k] += old.e[k] * beta;
+            }
+            pus[i] = piece;
+        }
+    }
+}
 
-    ElemType res = ra * alpha;
-    if (beta != 0)
-        res += rus * beta;
-    rus = res;
+template <class ElemType, int N>
+static void LaunchGatherColumnsOf(ElemType* us, ElemType beta, const ElemType* idx, size_t idxStride, const ElemType* a, ElemType alpha, size_t numRows, size_t numCols)
+{
+    int blocksPerGrid, threadsPerBlock;
+    GetColumnsLaunchConfig(numRows / N, numCols, blocksPerGrid, threadsPerBlock);
+    _doGatherColumnsOf<ElemType, N><<<blocksPerGrid, threadsPerBlock, 0, t_stream>>>((ColumnPiece<ElemType, N>*)us, beta, idx, idxStride,
+                                                                                    (const ColumnPiece<ElemType, N>*)a, alpha, (CUDA_LONG)(numRows / N), (CUDA_LONG)numCols);
 }
 
 // *this[:,j] = a[:,idx[j]] * alpha + *this[:,j] * beta
@@ -978,15 +1344,120 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const
         InvalidArgument("All matrices must be on the same GPU");
     a.PrepareDevice();
 
+    if (IsEmpty())
+        return *this;
+
     // launch the kernel
-    CUDA_LONG NN = (CUDA_LONG)GetNumElements(); // linear space identifying each individual input element
+    SyncGuard syncGuard;
+    const int vectorSize = 16 / sizeof(ElemType);
+    if (CanAccessInPiecesOf<ElemType, vectorSize>(GetNumRows(), Data(), a.Data()))
+        LaunchGatherColumnsOf<ElemType, vectorSize>(Data(), beta, idx.Data(), idx.GetNumRows(), a.Data(), alpha, GetNumRows(), GetNumCols());
+    else
+        LaunchGatherColumnsOf<ElemType, 1>(Data(), beta, idx.Data(), idx.GetNumRows(), a.Data(), alpha, GetNumRows(), GetNumCols());
+
+    return *this;
+}
+
+template <class ElemType>
+__global__ void _doGatherRowsOf(ElemType* us, const ElemType beta, const ElemType* idx, const ElemType* a, size_t aRows, const ElemType alpha, CUDA_LONG usRows, CUDA_LONG numElements)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numElements)
+        return;
+
+    // Each thread processes one element of the output matrix; neighbouring threads read neighbouring entries of idx.
+    CUDA_LONG iOut = id % usRows;
+    CUDA_LONG j    = id / usRows;
+
+    auto iInF = idx[iOut];          // this is the row we need to get
+    if (::isnan(iInF) || iInF < 0)  // negative index means gap
+        return;
+
+    ElemType res = a[(CUDA_LONG)iInF + j * aRows] * alpha;
+    if (beta != 0)
+        res += us[id] * beta;
+    us[id] = res;
+}
+
+// *this[i,:] = a[idx[i],:] * alpha + *this[i,:] * beta
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoGatherRowsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumRows() != 1 && idx.GetNumCols() != 1) // index is 1-dimensional only
+        InvalidArgument("DoGatherRowsOf: Map must be a vector.");
+
+    if (beta == 0)
+        RequireSize(idx.GetNumElements(), a.GetNumCols());
+    else
+        VerifySize(idx.GetNumElements(), a.GetNumCols());
+
+    if (idx.GetComputeDeviceId() != a.GetComputeDeviceId() || GetComputeDeviceId() != a.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+    a.PrepareDevice();
+
+    if (IsEmpty())
+        return *this;
+
+    CUDA_LONG NN = (CUDA_LONG)GetNumElements();
     SyncGuard syncGuard;
     GridDim grid(NN);
-    _doGatherColumnsOf<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), GetNumRows(), beta, idx.Data(), idx.GetNumRows(), a.Data(), a.GetNumRows(), a.GetNumCols(), alpha, grid.m_N);
+    _doGatherRowsOf<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), beta, idx.Data(), a.Data(), a.GetNumRows(), alpha, (CUDA_LONG)GetNumRows(), grid.m_N);
+
+    return *this;
+}
+
+// Each block fills the columns of one sequence. Columns of gaps have been set to -1 before.
+template <class ElemType>
+__global__ void _assignPackedIndicesOf(ElemType* us, const ElemType* timeIndices, const PackedSequenceRange* sequences, CUDA_LONG numSequences,
+                                       CUDA_LONG numParallelSequences, CUDA_LONG numTimeSteps, CUDA_LONG targetStride)
+{
+    for (CUDA_LONG k = blockIdx.x; k < numSequences; k += gridDim.x)
+    {
+        const PackedSequenceRange seq = sequences[k];
+        const CUDA_LONG tBegin = max(seq.tBegin, 0);
+        const CUDA_LONG tEnd   = min(seq.tEnd, (int)numTimeSteps);
+        for (CUDA_LONG t = tBegin + threadIdx.x; t < tEnd; t += blockDim.x)
+        {
+            const CUDA_LONG j = t * numParallelSequences + seq.s;
+            ElemType timeIndexF = (ElemType)(t - seq.tBegin);
+            if (timeIndices)
+                timeIndexF = timeIndices[j];
+            if (::isnan(timeIndexF) || timeIndexF < 0 || timeIndexF >= seq.targetLength) // out of bounds: no column
+                continue;
+            us[j] = (ElemType)(seq.targetColumn + (CUDA_LONG)timeIndexF * targetStride);
+        }
+    }
+}
 
-    // Note: The following fails silently (no error, immediate or delayed) for numcols = 10000 under CUDA 7.0.
-    //_doGatherColumnsOf<ElemType><<<GetNumCols(), GetNumRows(), 0, t_stream>>>(Data(), GetNumRows(), beta, idx.Data(), idx.GetNumRows(), a.Data(), a.GetNumRows(), a.GetNumCols(), alpha);
+// *this[0,j] = sequence.targetColumn + timeIndex * targetStride, see Matrix::AssignPackedIndicesOf()
+// Only the sequences are copied to the device, into a block of the device memory cache.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignPackedIndicesOf(const GPUMatrix<ElemType>* timeIndices, size_t numParallelSequences, size_t numTimeSteps,
+                                                                const std::vector<PackedSequenceRange>& sequences, size_t targetStride)
+{
+    const size_t numCols = numParallelSequences * numTimeSteps;
+    if (timeIndices && (timeIndices->GetNumRows() != 1 || timeIndices->GetNumCols() != numCols))
+        InvalidArgument("AssignPackedIndicesOf: The time indices must be a row vector with one entry per column of the layout.");
+    if (timeIndices && timeIndices->GetComputeDeviceId() != GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+
+    RequireSize(1, numCols);
+    SetValue((ElemType)-1); // gaps
+    if (sequences.empty() || numCols == 0)
+        return *this;
 
+    PrepareDevice();
+    const size_t numInts = sequences.size() * sizeof(PackedSequenceRange) / sizeof(int);
+    int* deviceSequences = TracingGPUMemoryAllocator::Allocate<int>(GetComputeDeviceId(), numInts);
+    CUDA_CALL(cudaMemcpyAsync(deviceSequences, sequences.data(), sizeof(PackedSequenceRange) * sequences.size(), cudaMemcpyHostToDevice, t_stream));
+
+    SyncGuard syncGuard;
+    const int threadsPerBlock = (int)min<size_t>(CeilDiv(numTimeSteps, (size_t)32) * 32, 256);
+    const int blocksPerGrid = (int)min<size_t>(sequences.size(), 65535);
+    _assignPackedIndicesOf<ElemType><<<blocksPerGrid, threadsPerBlock, 0, t_stream>>>(Data(), timeIndices ? timeIndices->Data() : nullptr,
+                                                                                     (const PackedSequenceRange*)deviceSequences, (CUDA_LONG)sequences.size(),
+                                                                                     (CUDA_LONG)numParallelSequences, (CUDA_LONG)numTimeSteps, (CUDA_LONG)targetStride);
+    TracingGPUMemoryAllocator::Free<int>(GetComputeDeviceId(), deviceSequences); // stream-ordered, the block is reused only after the kernel
     return *this;
 }
 
@@ -1005,36 +1476,45 @@ static void Peek(const GPUMatrix<ElemType>& m, const char* which)
 
 #define ALLOW_ATOMIC_SCATTER // allow to disable this, until we know atomicAdd() works properly here
 
-template <class ElemType>
-__global__ void _doScatterColumnsOf(ElemType* us, size_t usStride, size_t usCols, const ElemType* idx, size_t idxStride, const ElemType* a, size_t aStride, const ElemType alpha, CUDA_LONG numElements)
+template <class ElemType, int N>
+__global__ void _doScatterColumnsOf(ElemType* us, const ElemType* idx, size_t idxStride, const ColumnPiece<ElemType, N>* a, const ElemType alpha,
+                                    CUDA_LONG numPieces /*per column*/, CUDA_LONG numCols /*of a*/)
 {
-    CUDA_LONG id = GridDim::GetLinearThreadId();
-    if (id >= numElements) // note: there are no __syncthread() calls inside
-        return;
-
-    // id = i + jIn  *  aStride
-    // Each thread processes one element of a
-    CUDA_LONG i   = id % aStride; // row index into 'a' and 'us'
-    CUDA_LONG jIn = id / aStride; // col index into 'a' and 'idx'
-
-    auto jOutF = idx[jIn * idxStride];  // this is the column we copy/add into
-    if (::isnan(jOutF) || jOutF < 0)    // negative index means gap
-        return;
-    size_t jOut = (size_t)jOutF;
-    //if (jOut >= usCols)
-    //    return; // actually a failure  --TODO: This should not be necessary. Why is it?
-
-    const ElemType&  ra =  a[id/*i + jIn  *  aStride*/];
-    ElemType&       rus = us[    i + jOut * usStride  ];
-
-    ElemType res = ra * alpha;
-    if (res != 0)             // avoid memory conflict if e.g. an entire column has no gradient
+    for (CUDA_LONG jIn = blockIdx.x; jIn < numCols; jIn += gridDim.x)
+    {
+        auto jOutF = idx[jIn * idxStride];  // this is the column we copy/add into
+        if (::isnan(jOutF) || jOutF < 0)    // negative index means gap
+            continue;
+        CUDA_LONG jOut = (CUDA_LONG)jOutF;
+
+        const auto* pa = a + jIn * numPieces;
+        ElemType*  pus = us + jOut * numPieces * N;
+        for (CUDA_LONG i = threadIdx.x; i < numPieces; i += blockDim.x)
+        {
+            const auto piece = pa[i];
+#pragma unroll
+            for (int k = 0; k < N; k++)
+            {
+                ElemType res = piece.e[k] * alpha;
+                if (res != 0)                          // avoid memory conflict if e.g. an entire column has no gradient
 #ifdef ALLOW_ATOMIC_SCATTER
-        atomicAdd(&rus, res); // rus += res;
+                    atomicAdd(&pus[i * N + k], res);   // rus += res;
 #else
-        rus += res;
+                    pus[i * N + k] += res;
 #endif
-    // Note: atomicAdd() is supposed to be fast in case of no conflict (the simple case of Scatter())
+                // Note: atomicAdd() is supposed to be fast in case of no conflict (the simple case of Scatter())
+            }
+        }
+    }
+}
+
+template <class ElemType, int N>
+static void LaunchScatterColumnsOf(ElemType* us, const ElemType* idx, size_t idxStride, const ElemType* a, ElemType alpha, size_t numRows, size_t numCols)
+{
+    int blocksPerGrid, threadsPerBlock;
+    GetColumnsLaunchConfig(numRows / N, numCols, blocksPerGrid, threadsPerBlock);
+    _doScatterColumnsOf<ElemType, N><<<blocksPerGrid, threadsPerBlock, 0, t_stream>>>(us, idx, idxStride, (const ColumnPiece<ElemType, N>*)a, alpha,
+                                                                                     (CUDA_LONG)(numRows / N), (CUDA_LONG)numCols);
 }
 
 // *this[:,idx[j]] = a[:,j] * alpha + *this[:,idx[j]] * beta
@@ -1079,14 +1559,16 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     // Scatter may add more than one source column to the same target, so we must pre-scale with beta, and then just keep adding.
     Scale(beta, us); // if beta is 0, then this will be a memset()
 
+    if (a.IsEmpty())
+        return *this;
+
     // launch the kernel
-    CUDA_LONG NN = (CUDA_LONG)(a.GetNumElements()); // linear space identifying each individual input element
     SyncGuard syncGuard;
-    GridDim grid(NN);
-    _doScatterColumnsOf<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), GetNumRows(), GetNumCols(), idx.Data(), idx.GetNumRows(), a.Data(), a.GetNumRows(), alpha, NN);
-
-    //SyncGuard syncGuard;
-    //_doScatterColumnsOf<ElemType><<<a.GetNumCols(), a.GetNumRows(), 0, t_stream>>>(Data(), GetNumRows(), GetNumCols(), idx.Data(), idx.GetNumRows(), a.Data(), a.GetNumRows(), alpha, NN);
+    const int vectorSize = 16 / sizeof(ElemType);
+    if (CanAccessInPiecesOf<ElemType, vectorSize>(GetNumRows(), Data(), a.Data()))
+        LaunchScatterColumnsOf<ElemType, vectorSize>(Data(), idx.Data(), idx.GetNumRows(), a.Data(), alpha, a.GetNumRows(), a.GetNumCols());
+    else
+        LaunchScatterColumnsOf<ElemType, 1>(Data(), idx.Data(), idx.GetNumRows(), a.Data(), alpha, a.GetNumRows(), a.GetNumCols());
 
     return *this;
 }
@@ -1153,6 +1635,36 @@ void GPUMatrix<ElemType>::MaskColumnsValue(const GPUMatrix<char>& columnsMask, E
     _maskColumnsValue<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), columnsMask.Data(), (CUDA_LONG) GetNumCols(), (CUDA_LONG) GetNumRows(), val, numColsPerMaskEntry);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignNormalizedBytesOf(const GPUMatrix<char>& bytes, ElemType mean, ElemType scale)
+{
+    if (GetComputeDeviceId() != bytes.GetComputeDeviceId())
+        RuntimeError("Matrix and bytes must be on the same device");
+
+    RequireSize(bytes.GetNumRows(), bytes.GetNumCols());
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    if (N == 0)
+        return;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignNormalizedBytesOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), reinterpret_cast<const unsigned char*>(bytes.Data()), mean, scale, N);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignAugmentedImagesOf(const GPUMatrix<char>& bytes, const ImageAugmentation& augmentation, uint64_t firstImage)
+{
+    if (GetComputeDeviceId() != bytes.GetComputeDeviceId())
+        RuntimeError("Matrix and bytes must be on the same device");
+
+    RequireSize((size_t)augmentation.outW * augmentation.outH * augmentation.channels, bytes.GetNumCols());
+    if (IsEmpty())
+        return;
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignAugmentedImagesOf<256, ElemType><<<(unsigned int)bytes.GetNumCols(), 256, 0, t_stream>>>(Data(), reinterpret_cast<const unsigned char*>(bytes.Data()), augmentation, firstImage);
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetColumn(const ElemType* colPointer, size_t colInd)
 {
@@ -1182,6 +1694,20 @@ void GPUMatrix<ElemType>::SetValue(const GPUMatrix<ElemType>& deepCopyFrom)
     SetValue(deepCopyFrom.GetNumRows(), deepCopyFrom.GetNumCols(), deepCopyFrom.GetComputeDeviceId(), deepCopyFrom.Data(), matrixFlagSetValueOnDevice);
 }
 
+// cudaMemcpyPeer() is ordered with the work on both devices, and goes through host memory where the GPUs cannot access each other
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignValuesFromPeer(const GPUMatrix<ElemType>& source)
+{
+    if (source.GetComputeDeviceId() == GetComputeDeviceId())
+        return SetValue(source);
+
+    RequireSize(source.GetNumRows(), source.GetNumCols());
+    if (IsEmpty())
+        return;
+    PrepareDevice();
+    CUDA_CALL(cudaMemcpyPeer(Data(), GetComputeDeviceId(), source.Data(), source.GetComputeDeviceId(), sizeof(ElemType) * GetNumElements()));
+}
+
 #if 0
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const CPUMatrix<ElemType>& /*deepCopyFrom*/)
@@ -1211,13 +1737,13 @@ void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, i
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
         // free the existing array if it used to be an owned array
-        if ( Buffer() != NULL)
+        if (Buffer() != NULL && OwnBuffer())
         {
             TracingGPUMemoryAllocator::Free<ElemType>(GetComputeDeviceId(), Buffer());
         }
         m_numRows = numRows;
         m_numCols = numCols;
-        SetBuffer(pArray, GetNumElements() * sizeof(ElemType), true);
+        SetBuffer(pArray, GetNumElements() * sizeof(ElemType), true, (matrixFlags & matrixFlagMovableBuffer) != 0);
         SetSizeAllocated(GetNumElements());
         SetFormat(matrixFormatDense);
         SetComputeDeviceId(deviceId);
@@ -1370,6 +1896,24 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     _setMaskAndScale<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), N, maskRate, scaleValue);
 }
 
+// this = beta * this + a .* mask, with the mask computed on the fly from (seed, offset), see CPUMatrix::CounterBasedDropout()
+template <class ElemType>
+void GPUMatrix<ElemType>::CounterBasedDropout(const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset, const ElemType beta)
+{
+    if (a.IsEmpty())
+        LogicError("CounterBasedDropout: Matrix is empty.");
+    if (beta == 0)
+        RequireSize(a.GetNumRows(), a.GetNumCols());
+    else if (GetNumRows() != a.GetNumRows() || GetNumCols() != a.GetNumCols())
+        InvalidArgument("CounterBasedDropout: The input matrix dimensions do not match.");
+
+    PrepareDevice();
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    size_t blocksPerGrid = (size_t) ceil(N / (double) GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _counterBasedDropout<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), a.Data(), N, maskRate, scaleValue, seed, offset, beta);
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1561,6 +2105,81 @@ void GPUMatrix<ElemType>::AdaDelta(GPUMatrix<ElemType>& gradients, GPUMatrix<Ele
     _adadelta<ElemType> << <blocksPerGrid, GridDim::maxThreadsPerBlock >> >(n, gradients.Data(), Data(), Data() + n, functionValues.Data(), learningRate, rho, epsilon);
 }
 
+// Calls launch(list, numChunks, firstItem) for the items in lists of at most MaxTensorsPerLaunch, skipping empty ones.
+template <class ElemType, class Launch>
+static void ForEachMultiTensorList(const std::vector<MultiTensorItem<ElemType>>& items, const Launch& launch)
+{
+    MultiTensorList<ElemType> list;
+    list.numTensors = 0;
+    int numChunks = 0;
+    size_t firstItem = 0;
+    for (size_t k = 0; k < items.size(); k++)
+    {
+        const auto& item = items[k];
+        if (item.numElements > 0)
+        {
+            const int t = list.numTensors++;
+            list.value[t] = item.value;
+            list.gradient[t] = item.gradient;
+            list.smoothedGradient[t] = item.smoothedGradient;
+            list.numElements[t] = (CUDA_LONG) item.numElements;
+            list.firstChunk[t] = numChunks;
+            list.gradientScale[t] = item.gradientScale;
+            list.l2Weight[t] = item.l2Weight;
+            list.learnRatePerSample[t] = item.learnRatePerSample;
+            list.adaMul[t] = item.adaMul;
+            numChunks += (int) ((item.numElements + multiTensorChunkSize - 1) / multiTensorChunkSize);
+        }
+        if (list.numTensors == MultiTensorList<ElemType>::MaxTensors || (k + 1 == items.size() && list.numTensors > 0))
+        {
+            launch(list, numChunks, firstItem);
+            list.numTensors = 0;
+            numChunks = 0;
+            firstItem = k + 1;
+        }
+    }
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiTensorUpdate(DEVICEID_TYPE deviceId, MultiTensorUpdateType type, const std::vector<MultiTensorItem<ElemType>>& items,
+                                                      ElemType momentum, ElemType varMomentum, bool unitGainMomentum)
+{
+    PrepareDevice(deviceId);
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+    ForEachMultiTensorList(items, [&](const MultiTensorList<ElemType>& list, int numChunks, size_t /*firstItem*/)
+    {
+        _multiTensorUpdate<ElemType><<<numChunks, multiTensorThreadsPerBlock, 0, t_stream>>>(list, type, momentum, varMomentum, unitGainFactor);
+    });
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiTensorSumOfSquares(DEVICEID_TYPE deviceId, const std::vector<MultiTensorItem<ElemType>>& items, std::vector<double>& sumsOfSquares)
+{
+    PrepareDevice(deviceId);
+    sumsOfSquares.assign(items.size(), 0);
+    std::vector<double> partialSums;
+    ForEachMultiTensorList(items, [&](const MultiTensorList<ElemType>& list, int numChunks, size_t firstItem)
+    {
+        double* d_partialSums = TracingGPUMemoryAllocator::Allocate<double>(deviceId, numChunks);
+        _multiTensorSumOfSquares<ElemType><<<numChunks, multiTensorThreadsPerBlock, 0, t_stream>>>(list, d_partialSums);
+        partialSums.resize(numChunks);
+        CUDA_CALL(cudaMemcpy(partialSums.data(), d_partialSums, numChunks * sizeof(double), cudaMemcpyDeviceToHost));
+        TracingGPUMemoryAllocator::Free<double>(deviceId, d_partialSums);
+
+        // the chunks of each tensor, in the order of the items, skipping the empty ones
+        int t = 0;
+        for (size_t k = firstItem; t < list.numTensors; k++)
+        {
+            if (items[k].numElements == 0)
+                continue;
+            const int end = t + 1 < list.numTensors ? list.firstChunk[t + 1] : numChunks;
+            for (int c = list.firstChunk[t]; c < end; c++)
+                sumsOfSquares[k] += partialSums[c];
+            t++;
+        }
+    });
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1588,11 +2207,11 @@ void GPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
     VerifyResizable(__FUNCTION__);
 
     size_t numElements = numRows * numCols;
-    if (numElements > GetSizeAllocated() ||                     // grow allocation
-        (!growOnly && numElements != GetSizeAllocated()))   // shrink allocation if not growOnly
+    if (numElements > GetSizeAllocated() ||                                         // grow allocation
+        (!growOnly && !HasExternalBuffer() && numElements != GetSizeAllocated()))   // shrink allocation if not growOnly
     {
-        // If the buffer exists, free it before allocate
-        if (Buffer())
+        // If the buffer exists, free it before allocate (a movable one is not ours)
+        if (Buffer() && !HasExternalBuffer())
         {
             TracingGPUMemoryAllocator::Free<ElemType>(GetComputeDeviceId(), Buffer());
         }
@@ -2184,6 +2803,65 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<Ele
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSoftmaxCrossEntropyOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& input, GPUMatrix<ElemType>& logSumExp)
+{
+    if (input.IsEmpty())
+        LogicError("AssignSoftmaxCrossEntropyOf: Matrix input is empty.");
+    if (labels.GetNumRows() != input.GetNumRows() || labels.GetNumCols() != input.GetNumCols())
+        InvalidArgument("AssignSoftmaxCrossEntropyOf: labels and input must have the same dimensions.");
+
+    RequireSize(1, 1);
+    logSumExp.RequireSize(1, input.GetNumCols());
+    SetValue(0);
+    PrepareDevice();
+    CUDA_LONG N = (CUDA_LONG) input.GetNumCols();
+    CUDA_LONG M = (CUDA_LONG) input.GetNumRows();
+    SyncGuard syncGuard;
+    // note: kernel uses hard-coded thread dimension
+    _assignColumnwiseSoftmaxCrossEntropyOf512Threads<<<N, 512, 0, t_stream>>>(labels.Data(), input.Data(), logSumExp.Data(), Data(), M);
+    return *this;
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& input,
+                                                         const GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& inputGradient)
+{
+    if (gradient.GetNumElements() != 1)
+        InvalidArgument("AddSoftmaxCrossEntropyGradient: gradient must be a 1x1 matrix.");
+    if (labels.GetNumRows() != input.GetNumRows() || labels.GetNumCols() != input.GetNumCols() ||
+        inputGradient.GetNumRows() != input.GetNumRows() || inputGradient.GetNumCols() != input.GetNumCols() ||
+        logSumExp.GetNumElements() != input.GetNumCols())
+        InvalidArgument("AddSoftmaxCrossEntropyGradient: The dimensions of the matrices do not match.");
+    if (input.IsEmpty())
+        return;
+
+    inputGradient.PrepareDevice();
+    CUDA_LONG n = (CUDA_LONG) input.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * n / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _addSoftmaxCrossEntropyGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(gradient.Data(), labels.Data(), input.Data(), logSumExp.Data(), inputGradient.Data(), (CUDA_LONG) input.GetNumRows(), n);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddSoftmaxCrossEntropyLabelGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& input,
+                                                              const GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& labelsGradient)
+{
+    if (gradient.GetNumElements() != 1)
+        InvalidArgument("AddSoftmaxCrossEntropyLabelGradient: gradient must be a 1x1 matrix.");
+    if (labelsGradient.GetNumRows() != input.GetNumRows() || labelsGradient.GetNumCols() != input.GetNumCols() ||
+        logSumExp.GetNumElements() != input.GetNumCols())
+        InvalidArgument("AddSoftmaxCrossEntropyLabelGradient: The dimensions of the matrices do not match.");
+    if (input.IsEmpty())
+        return;
+
+    labelsGradient.PrepareDevice();
+    CUDA_LONG n = (CUDA_LONG) input.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * n / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _addSoftmaxCrossEntropyLabelGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(gradient.Data(), input.Data(), logSumExp.Data(), labelsGradient.Data(), (CUDA_LONG) input.GetNumRows(), n);
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceHardmax(const bool isColWise)
 {
@@ -2845,6 +3523,36 @@ void GPUMatrix<ElemType>::VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<E
     if (!isColWise)
         RuntimeError("Row-wise TopK max is not supported.");
 
+    TopK(maxValues, maxIndexes, topK);
+}
+
+// the largest k values of each column, sorted descending (equal values by row index), and their row indices
+template <class ElemType>
+void GPUMatrix<ElemType>::TopK(GPUMatrix<ElemType>& topKValues, GPUMatrix<ElemType>& topKIndices, size_t k) const
+{
+    if (IsEmpty())
+        LogicError("TopK: Matrix is empty.");
+    if (k == 0 || k > GetNumRows())
+        InvalidArgument("TopK: k must be between 1 and the number of rows.");
+
+    const int MaxRadixSelectK = 256;
+    if (k > MaxRadixSelectK)
+    {
+        SortTopK(topKValues, topKIndices, (int)k);
+        return;
+    }
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    topKValues.RequireSize(k, GetNumCols());
+    topKIndices.RequireSize(k, GetNumCols());
+    _radixSelectTopK<512, MaxRadixSelectK, ElemType><<<(unsigned int)GetNumCols(), 512, 0, t_stream>>>(Data(), topKValues.Data(), topKIndices.Data(), (CUDA_LONG)GetNumRows(), (int)k);
+}
+
+// TopK() through two stable radix sorts of all elements, for large k
+template <class ElemType>
+void GPUMatrix<ElemType>::SortTopK(GPUMatrix<ElemType>& maxValues, GPUMatrix<ElemType>& maxIndexes, int topK) const
+{
     const GPUMatrix<ElemType>& us = *this;
     const CUDA_LONG m = (CUDA_LONG) GetNumRows();
     const CUDA_LONG n = (CUDA_LONG) GetNumCols();
@@ -3213,6 +3921,39 @@ void GPUMatrix<ElemType>::ConvolutionBackwardKernel(const GPUMatrix<ElemType>& i
                                                                    runs.Data(), Data(), kernelGrad.Data());
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::DepthwiseConvolutionForward(const GPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& output) const
+{
+    const int BlockSize = depthwiseConvolutionBlockSize;
+    int outC = shape.groups * shape.multiplier;
+    auto gdim = dim3((shape.outW * shape.outH + BlockSize - 1) / BlockSize, std::min(outC * (int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    kDepthwiseConvolutionForward<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), shape, kernel.Data(), Data(), (int)GetNumRows(),
+                                                                     output.Data(), (int)output.GetNumRows());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::DepthwiseConvolutionBackwardData(const GPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& grad) const
+{
+    const int BlockSize = depthwiseConvolutionBlockSize;
+    auto gdim = dim3((shape.inW * shape.inH + BlockSize - 1) / BlockSize, std::min(shape.inC * (int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    kDepthwiseConvolutionBackwardData<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), shape, kernel.Data(), Data(), (int)GetNumRows(),
+                                                                          grad.Data(), (int)grad.GetNumRows());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::DepthwiseConvolutionBackwardKernel(const GPUMatrix<ElemType>& in, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& kernelGrad) const
+{
+    PrepareDevice();
+    SyncGuard syncGuard;
+    kDepthwiseConvolutionBackwardKernel<<<(int)kernelGrad.GetNumElements(), depthwiseConvolutionBlockSize, 0, t_stream>>>((int)GetNumCols(), shape,
+                                                                                                                         in.Data(), (int)in.GetNumRows(),
+                                                                                                                         Data(), (int)GetNumRows(), kernelGrad.Data());
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::MaxPoolingForward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& output) const
 {
@@ -3238,6 +3979,30 @@ void GPUMatrix<ElemType>::MaxPoolingBackward(const GPUMatrix<ElemType>& out, con
                                                             Data(), (int)GetNumRows(), grad.Data(), (int)grad.GetNumRows());
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::MaxPoolingForwardWithArgmax(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices,
+                                                      GPUMatrix<ElemType>& output, GPUMatrix<short>& argmax) const
+{
+    const int BlockSize = 128;
+    auto gdim = dim3((output.GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    kMaxPoolingForwardWithArgmax<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), mpRowCol.Data(), mpRowIndices.Data(), indices.Data(),
+                                                                     Data(), (int)GetNumRows(), output.Data(), argmax.Data(), (int)output.GetNumRows());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MaxPoolingBackwardWithArgmax(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices,
+                                                       const GPUMatrix<short>& argmax, GPUMatrix<ElemType>& grad) const
+{
+    const int BlockSize = 128;
+    auto gdim = dim3((GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    kMaxPoolingBackwardWithArgmax<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), mpRowCol.Data(), mpRowIndices.Data(), indices.Data(),
+                                                                      argmax.Data(), Data(), (int)GetNumRows(), grad.Data(), (int)grad.GetNumRows());
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
                                             const size_t pooledWidth, const size_t pooledHeight, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& output, 
@@ -3246,11 +4011,10 @@ void GPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
     PrepareDevice();
     SyncGuard syncGuard;
 
-    int count = numRois * numImg * channels * pooledHeight * pooledWidth;
-    const int blockSize = GridDim::maxThreadsPerBlock;
-    auto numThreads = dim3((int)floor((double)(count + blockSize - 1) / blockSize));
-    kROIPoolingForward<<<numThreads, blockSize, 0, t_stream>>>(count, numRois, numImg, channels, width, height, 
-                                                               pooledWidth, pooledHeight, Data(), roiData.Data(), output.Data(), argmax.Data());
+    // one block per ROI, with the windows of its output rows and columns in shared memory
+    size_t sharedMemSize = 2 * (pooledHeight + pooledWidth) * sizeof(int);
+    kROIPoolingForward<<<(int)(numRois * numImg), roiPoolingBlockSize, sharedMemSize, t_stream>>>((int)numRois, (int)channels, (int)width, (int)height,
+                                                                                                  (int)pooledWidth, (int)pooledHeight, Data(), roiData.Data(), output.Data(), argmax.Data());
 }
 
 template <class ElemType>
@@ -3261,11 +4025,11 @@ void GPUMatrix<ElemType>::ROIPoolingBackward(const size_t numRois, const size_t
     PrepareDevice();
     SyncGuard syncGuard;
 
-    int count = numImg * channels * height * width;
-    const int blockSize = GridDim::maxThreadsPerBlock;
-    auto numThreads = dim3((int)floor((double)(count + blockSize - 1) / blockSize));
-    kROIPoolingBackward<<<numThreads, blockSize, 0, t_stream>>>(count, numRois, numImg, channels, width, height, 
-                                                                pooledWidth, pooledHeight, Data(), roiData.Data(), grad.Data(), argmax.Data());
+    // the blocks of an image share the tiles of its ROIs
+    int imageSize = (int)(channels * height * width);
+    auto numBlocks = dim3((imageSize + roiPoolingBlockSize - 1) / roiPoolingBlockSize, (int)numImg);
+    kROIPoolingBackward<<<numBlocks, roiPoolingBlockSize, 0, t_stream>>>((int)numRois, (int)channels, (int)width, (int)height,
+                                                                         (int)pooledWidth, (int)pooledHeight, Data(), roiData.Data(), grad.Data(), argmax.Data());
 }
 
 template <class ElemType>
@@ -3431,6 +4195,18 @@ static cublasStatus_t cublas_gemm(cublasHandle_t handle, cublasOperation_t trans
 {
     return cublasDgemm(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
 }
+#if CUDA_VERSION >= 8000
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float* A, int lda, long long strideA,
+                                                const float* B, int ldb, long long strideB, const float* beta, float* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasSgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha, const double* A, int lda, long long strideA,
+                                                const double* B, int ldb, long long strideB, const double* beta, double* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasDgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+#endif
 static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const float* alpha, const float* x, int incx, float* y, int incy)
 {
     return cublasSaxpy(handle, n, alpha, x, incx, y, incy);
@@ -3440,6 +4216,58 @@ static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const double* al
     return cublasDaxpy(handle, n, alpha, x, incx, y, incy);
 }
 
+// fp16 products (Globals::SetFloat16Products()): both operands are rounded to fp16 into a per-GPU scratch buffer
+// and multiplied by cublasGemmEx() with fp32 accumulation into the fp32 result, on tensor cores with CUDA 9 and later.
+// The float matrices themselves (weights, gradients) are not touched, i.e. they act as the fp32 master copies.
+// Requires CUDA 8 (cublasGemmEx()); older toolkits and double products always use the regular cublas_gemm().
+#if CUDA_VERSION >= 8000
+static Float16* s_float16GemmBuffer[MAX_GPUS] = {0};
+static size_t s_float16GemmBufferSize[MAX_GPUS] = {0};
+
+// grow-only; like the cuBLAS handles it is never freed
+static Float16* GetFloat16GemmBuffer(int deviceId, size_t numElements)
+{
+    if (deviceId < 0 || deviceId >= MAX_GPUS)
+        LogicError("GetFloat16GemmBuffer: Maximum GPU exceeded");
+    if (s_float16GemmBufferSize[deviceId] < numElements)
+    {
+        // freed memory is only reused by work queued later on the same stream, after the kernels still reading the old buffer
+        if (s_float16GemmBuffer[deviceId])
+            TracingGPUMemoryAllocator::Free<short>(deviceId, reinterpret_cast<short*>(s_float16GemmBuffer[deviceId]));
+        s_float16GemmBuffer[deviceId] = nullptr; // in case the allocation below throws
+        s_float16GemmBufferSize[deviceId] = 0;
+        s_float16GemmBuffer[deviceId] = reinterpret_cast<Float16*>(TracingGPUMemoryAllocator::Allocate<short>(deviceId, numElements));
+        s_float16GemmBufferSize[deviceId] = numElements;
+    }
+    return s_float16GemmBuffer[deviceId];
+}
+
+static Float16* ConvertToFloat16(const float* a, size_t numElements, Float16* c)
+{
+    CUDA_LONG N = (CUDA_LONG) numElements;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _convertFloatToFloat16<<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(a, c, N);
+    return c;
+}
+
+static cublasStatus_t cublas_gemmFloat16(cublasHandle_t handle, int deviceId, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float* A, int lda, size_t numElementsA,
+                                         const float* B, int ldb, size_t numElementsB, const float* beta, float* C, int ldc)
+{
+    // keep the second operand 16-byte aligned, as required for tensor core use
+    size_t offsetB = (numElementsA + 7) / 8 * 8;
+    Float16* buffer = GetFloat16GemmBuffer(deviceId, offsetB + numElementsB);
+    const Float16* A16 = ConvertToFloat16(A, numElementsA, buffer);
+    const Float16* B16 = ConvertToFloat16(B, numElementsB, buffer + offsetB);
+#if CUDA_VERSION >= 9000
+    const cublasGemmAlgo_t algo = CUBLAS_GEMM_DEFAULT_TENSOR_OP;
+#else
+    const cublasGemmAlgo_t algo = CUBLAS_GEMM_DFALT;
+#endif
+    return cublasGemmEx(handle, transa, transb, m, n, k, alpha, A16, CUDA_R_16F, lda, B16, CUDA_R_16F, ldb, beta, C, CUDA_R_32F, ldc, CUDA_R_32F, algo);
+}
+#endif
+
 template <class ElemType>
 void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB,
                                                  ElemType beta, GPUMatrix<ElemType>& c)
@@ -3465,9 +4293,165 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
         RuntimeError("!(m>0 && k>0 && l>0 && n>0)"); // converting from size_t to int may cause overflow
     if (k != l)
         RuntimeError("matrix dim mismatch in MultiplyAndWeightedAdd");
+#if CUDA_VERSION >= 8000
+    if (std::is_same<ElemType, float>::value && Globals::ShouldUseFloat16Products())
+    {
+        CUBLAS_CALL(cublas_gemmFloat16(cuHandle, b.GetComputeDeviceId(), transA, transB, m, n, k, reinterpret_cast<const float*>(&alpha), reinterpret_cast<const float*>(a.Data()), (int) a.m_numRows, a.GetNumElements(),
+                                       reinterpret_cast<const float*>(b.Data()), (int) b.m_numRows, b.GetNumElements(), reinterpret_cast<const float*>(&beta), reinterpret_cast<float*>(c.Data()), (int) c.m_numRows));
+        return;
+    }
+#endif
     CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, b.Data(), (int) b.m_numRows, &beta, c.Data(), (int) c.m_numRows));
 }
 
+// c_i = alpha * op(a_i) * op(b_i) + beta * c_i for the batchSize column blocks of a, b and c (see Matrix.h), in a single
+// cublas<t>gemmStridedBatched() launch instead of one launch per product. Before CUDA 8 this falls back to a loop.
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB,
+                                                      ElemType beta, GPUMatrix<ElemType>& c, size_t batchSize, bool broadcastA, bool broadcastB)
+{
+    if (a.IsEmpty() || b.IsEmpty() || batchSize == 0)
+        return;
+    a.PrepareDevice();
+    if ((a.GetComputeDeviceId() != b.GetComputeDeviceId()) || (b.GetComputeDeviceId() != c.GetComputeDeviceId())) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+    if ((!broadcastA && a.m_numCols % batchSize != 0) || (!broadcastB && b.m_numCols % batchSize != 0))
+        InvalidArgument("BatchMultiplyAndWeightedAdd: The number of columns of a and b must be a multiple of the batch size.");
+
+    cublasHandle_t cuHandle = GetCublasHandle(b.GetComputeDeviceId());
+    cublasOperation_t transA = transposeA ? CUBLAS_OP_T : CUBLAS_OP_N;
+    cublasOperation_t transB = transposeB ? CUBLAS_OP_T : CUBLAS_OP_N;
+    int aRows = (int) a.m_numRows, aCols = int(a.m_numCols / (broadcastA ? 1 : batchSize));
+    int bRows = (int) b.m_numRows, bCols = int(b.m_numCols / (broadcastB ? 1 : batchSize));
+    int m = transposeA ? aCols : aRows;
+    int n = transposeB ? bRows : bCols;
+    int k = transposeA ? aRows : aCols;
+    int l = transposeB ? bCols : bRows;
+
+    if (beta == 0)
+        c.RequireSize(m, n * batchSize);
+    else
+        c.VerifySize(m, n * batchSize); // Can't resize if beta != 0
+
+    if (!(m > 0 && k > 0 && l > 0 && n > 0))
+        RuntimeError("!(m>0 && k>0 && l>0 && n>0)"); // converting from size_t to int may cause overflow
+    if (k != l)
+        RuntimeError("matrix dim mismatch in BatchMultiplyAndWeightedAdd");
+
+    long long strideA = broadcastA ? 0 : (long long) aRows * aCols;
+    long long strideB = broadcastB ? 0 : (long long) bRows * bCols;
+    long long strideC = (long long) m * n;
+#if CUDA_VERSION >= 8000
+    CUBLAS_CALL(cublas_gemmStridedBatched(cuHandle, transA, transB, m, n, k, &alpha, a.Data(), aRows, strideA, b.Data(), bRows, strideB, &beta, c.Data(), m, strideC, (int) batchSize));
+#else
+    for (size_t i = 0; i < batchSize; i++)
+        CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.Data() + i * strideA, aRows, b.Data() + i * strideB, bRows, &beta, c.Data() + i * strideC, m));
+#endif
+}
+
+// 8-bit products for QuantizedMultiplier (QuantizedTimes, quantized inference) on the GPU.
+// Like SymmetricQuantizer, the operands are scaled so that their largest magnitude maps to the largest integer:
+// a per row (i.e. per output channel of a weight matrix), b as a whole. The scales are found on the device, so nothing
+// waits for the GPU. The products of 4 values at a time are summed by DP4A into 32 bits, which cannot overflow below
+// k = 2^31 / 127^2, so the bit shifts that protect the 16-bit products on the CPU are not applied; a larger k falls back
+// to the float product. The integer sums are scaled back in the same kernel.
+struct QuantizedGPUBuffers
+{
+    int m_deviceId;
+    bool m_isAQuantized;  // the rows of a constant a are kept
+    size_t m_aRows;
+    size_t m_aCols;
+
+    signed char* m_a;     // [m, kPadded]
+    float* m_aInverseFactors; // [m]
+    signed char* m_b;     // [kPadded, n]
+    float* m_bMaxAbs;     // [1]
+    size_t m_aSize, m_aInverseFactorsSize, m_bSize;
+
+    QuantizedGPUBuffers(int deviceId)
+        : m_deviceId(deviceId), m_isAQuantized(false), m_aRows(0), m_aCols(0),
+          m_a(nullptr), m_aInverseFactors(nullptr), m_b(nullptr), m_bMaxAbs(nullptr), m_aSize(0), m_aInverseFactorsSize(0), m_bSize(0)
+    {
+        m_bMaxAbs = TracingGPUMemoryAllocator::Allocate<float>(m_deviceId, 1);
+    }
+
+    ~QuantizedGPUBuffers()
+    {
+        TracingGPUMemoryAllocator::Free<char>(m_deviceId, reinterpret_cast<char*>(m_a), true);
+        TracingGPUMemoryAllocator::Free<float>(m_deviceId, m_aInverseFactors, true);
+        TracingGPUMemoryAllocator::Free<char>(m_deviceId, reinterpret_cast<char*>(m_b), true);
+        TracingGPUMemoryAllocator::Free<float>(m_deviceId, m_bMaxAbs, true);
+    }
+
+    // grow-only, the contents are not kept
+    template <class T>
+    void Reserve(T*& buffer, size_t& size, size_t numElements)
+    {
+        if (size >= numElements)
+            return;
+        typedef typename std::conditional<std::is_same<T, signed char>::value, char, T>::type AllocatedType;
+        TracingGPUMemoryAllocator::Free<AllocatedType>(m_deviceId, reinterpret_cast<AllocatedType*>(buffer));
+        buffer = nullptr; // in case the allocation below throws
+        size = 0;
+        buffer = reinterpret_cast<T*>(TracingGPUMemoryAllocator::Allocate<AllocatedType>(m_deviceId, numElements));
+        size = numElements;
+    }
+};
+
+template <class ElemType>
+void GPUMatrix<ElemType>::QuantizedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c,
+                                                          bool isAConstant, std::shared_ptr<QuantizedGPUBuffers>& buffers)
+{
+    a.PrepareDevice();
+    if ((a.GetComputeDeviceId() != b.GetComputeDeviceId()) || (b.GetComputeDeviceId() != c.GetComputeDeviceId())) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+
+    size_t m = a.m_numRows;
+    size_t k = a.m_numCols;
+    size_t n = b.m_numCols;
+    if (!(m > 0 && k > 0 && n > 0))
+        RuntimeError("!(m>0 && k>0 && n>0)");
+    if (b.m_numRows != k)
+        RuntimeError("matrix dim mismatch in QuantizedMultiplyAndWeightedAdd");
+    if (k > INT_MAX / (127 * 127))
+        return MultiplyAndWeightedAdd(alpha, a, false, b, false, beta, c);
+
+    if (beta == 0)
+        c.RequireSize(m, n);
+    else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    if (!buffers || buffers->m_deviceId != a.GetComputeDeviceId())
+        buffers = std::make_shared<QuantizedGPUBuffers>(a.GetComputeDeviceId());
+    auto& q = *buffers;
+    size_t kPadded = (k + 3) / 4 * 4;
+
+    SyncGuard syncGuard;
+    if (!isAConstant || !q.m_isAQuantized || q.m_aRows != m || q.m_aCols != k)
+    {
+        q.Reserve(q.m_a, q.m_aSize, m * kPadded);
+        q.Reserve(q.m_aInverseFactors, q.m_aInverseFactorsSize, m);
+        int blocksPerGrid = (int) ceil(1.0 * m / GridDim::maxThreadsPerBlock);
+        _quantizeRowsToInt8<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(a.Data(), (CUDA_LONG) m, (CUDA_LONG) k, (CUDA_LONG) kPadded, q.m_a, q.m_aInverseFactors);
+        q.m_isAQuantized = isAConstant;
+        q.m_aRows = m;
+        q.m_aCols = k;
+    }
+
+    q.Reserve(q.m_b, q.m_bSize, kPadded * n);
+    CUDA_CALL(cudaMemsetAsync(q.m_bMaxAbs, 0, sizeof(float), t_stream));
+    CUDA_LONG N = (CUDA_LONG) b.GetNumElements();
+    int blocksPerGrid = (int) std::min(CeilDiv(N, GridDim::maxThreadsPerBlock), (CUDA_LONG) 1024); // the threads loop over the rest
+    _maxAbsToFloat<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(b.Data(), N, q.m_bMaxAbs);
+    blocksPerGrid = (int) ceil(1.0 * kPadded * n / GridDim::maxThreadsPerBlock);
+    _quantizeToInt8<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(b.Data(), (CUDA_LONG) k, (CUDA_LONG) kPadded, (CUDA_LONG) n, q.m_bMaxAbs, q.m_b);
+
+    dim3 block(QUANTIZED_PRODUCT_TILE, QUANTIZED_PRODUCT_TILE);
+    dim3 grid((unsigned int) ((n + QUANTIZED_PRODUCT_TILE - 1) / QUANTIZED_PRODUCT_TILE), (unsigned int) ((m + QUANTIZED_PRODUCT_TILE - 1) / QUANTIZED_PRODUCT_TILE));
+    _quantizedProduct<ElemType><<<grid, block, 0, t_stream>>>(reinterpret_cast<const int*>(q.m_a), reinterpret_cast<const int*>(q.m_b), (CUDA_LONG) m, (CUDA_LONG) n, (CUDA_LONG) (kPadded / 4),
+                                                              q.m_aInverseFactors, q.m_bMaxAbs, alpha, beta, c.Data());
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c)
 {
@@ -4670,6 +5654,38 @@ void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
     TracingGPUMemoryAllocator::Free<ElemType>(alpha.GetComputeDeviceId(), d_zeta);
 };
 
+// LambdaRank and NDCG: one block per group, see _rankWithinGroups() and _addLambdaRankGradient()
+template <class ElemType>
+void GPUMatrix<ElemType>::RankWithinGroups(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& groupStarts, size_t truncation,
+                                           GPUMatrix<ElemType>& ranks, GPUMatrix<ElemType>& dcgs, GPUMatrix<ElemType>& idealDCGs)
+{
+    const size_t numGroups = groupStarts.GetNumElements() - 1;
+    scores.PrepareDevice();
+    ranks.RequireSize(1, scores.GetNumElements());
+    dcgs.RequireSize(1, numGroups);
+    idealDCGs.RequireSize(1, numGroups);
+    if (numGroups == 0)
+        return;
+
+    SyncGuard syncGuard;
+    _rankWithinGroups<256, ElemType><<<(unsigned int)numGroups, 256, 0, t_stream>>>(scores.Data(), gains.Data(), groupStarts.Data(), (CUDA_LONG)truncation,
+                                                                                    ranks.Data(), dcgs.Data(), idealDCGs.Data());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddLambdaRankGradient(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& groupStarts,
+                                                const GPUMatrix<ElemType>& idealDCGs, ElemType sigma, size_t truncation, GPUMatrix<ElemType>& gradient)
+{
+    const size_t numGroups = groupStarts.GetNumElements() - 1;
+    if (numGroups == 0)
+        return;
+
+    gradient.PrepareDevice();
+    SyncGuard syncGuard;
+    _addLambdaRankGradient<256, ElemType><<<(unsigned int)numGroups, 256, 0, t_stream>>>(scores.Data(), gains.Data(), ranks.Data(), groupStarts.Data(), idealDCGs.Data(),
+                                                                                         sigma, (CUDA_LONG)truncation, gradient.Data());
+}
+
 // -----------------------------------------------------------------------
 // TensorView entry points from Matrix.cpp
 // -----------------------------------------------------------------------
@@ -4795,6 +5811,25 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
     return TensorOpN<ElemType, 4>(beta, array<ElemType*, 4>{a.Data(), b.Data(), c.Data(), Data()}, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
+// evaluate an ElementwiseProgram on up to ElementwiseProgram::MaxInputs inputs giving 'this', in a single kernel launch
+template <class ElemType>
+void GPUMatrix<ElemType>::TensorProgramOp(ElemType beta, const array<const GPUMatrix<ElemType>*, ElementwiseProgram::MaxInputs>& inputs, ElemType alpha, const ElementwiseProgram& program,
+                                          const array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                                          const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides)
+{
+    const size_t N = ElementwiseProgram::MaxInputs + 1;
+    array<ElemType*, N> pointers;
+    for (size_t i = 0; i < N - 1; i++)
+    {
+        inputs[i]->PrepareDevice();
+        if (inputs[i]->GetComputeDeviceId() != GetComputeDeviceId())
+            InvalidArgument("All matrices must be on the same GPU");
+        pointers[i] = inputs[i]->Data();
+    }
+    pointers[N - 1] = Data();
+    return TensorProgramOpN<ElemType>(beta, pointers, alpha, program, offsets, regularOpDims, regularStrides);
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::TensorArgOp(const GPUMatrix<ElemType>& a, ElementWiseOperator reductionOp,
                                       const array<size_t, 2>& offsets,
@@ -62,6 +62,7 @@ cudaStream_t MATH_API GetStream();
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 class DataTransferer;
+struct QuantizedGPUBuffers;
 
 // -----------------------------------------------------------------------
 // SyncGuard -- synchronize around CUDA calls
@@ -185,6 +186,7 @@ private:
 
     std::unique_ptr<GPUMatrix<ElemType>> GetOrCreateWorkspace() const;
     void ReleaseWorkspace(std::unique_ptr<GPUMatrix<ElemType>> src) const;
+    void SortTopK(GPUMatrix<ElemType>& maxValues, GPUMatrix<ElemType>& maxIndexes, int topK) const;
 
 public:
     explicit GPUMatrix(int deviceId);
@@ -242,6 +244,10 @@ public:
 
     void AdaDelta(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learningRate, ElemType rho, ElemType epsilon);
 
+    static void MultiTensorUpdate(DEVICEID_TYPE deviceId, MultiTensorUpdateType type, const std::vector<MultiTensorItem<ElemType>>& items,
+                                  ElemType momentum, ElemType varMomentum, bool unitGainMomentum);
+    static void MultiTensorSumOfSquares(DEVICEID_TYPE deviceId, const std::vector<MultiTensorItem<ElemType>>& items, std::vector<double>& sumsOfSquares);
+
     void Reshape(const size_t numRows, const size_t numCols);
 
     // RequireSize is now the new preferred method of ensuring the correct size inside of the Matrix class. Since Resize will fail if the storage object has
@@ -264,9 +270,13 @@ public:
     void SetColumn(const GPUMatrix<ElemType>& valMat, size_t colInd);
 
     void MaskColumnsValue(const GPUMatrix<char>& columnsMask, ElemType val, size_t numColsPerMaskEntry);
+    void AssignNormalizedBytesOf(const GPUMatrix<char>& bytes, ElemType mean, ElemType scale);
+    void AssignAugmentedImagesOf(const GPUMatrix<char>& bytes, const ImageAugmentation& augmentation, uint64_t firstImage);
 
     //void SetValue(const CPUMatrix<ElemType>& deepCopyFrom);
     void SetValue(const GPUMatrix<ElemType>& deepCopyFrom);
+    // copies from another GPU; unlike SetValue(), this matrix stays on its device
+    void AssignValuesFromPeer(const GPUMatrix<ElemType>& source);
     //void SetValue(const CPUSparseMatrix<ElemType>& deepCopyFrom);
     //void SetValue(const GPUSparseMatrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, size_t matrixFlags = matrixFlagNormal, DataTransferer* transferer = nullptr);
@@ -276,6 +286,7 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    void CounterBasedDropout(const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset, const ElemType beta);
 
     GPUMatrix<ElemType>& AssignOneHot(const GPUMatrix<ElemType>& a, vector<size_t>& shape, size_t axis);
 
@@ -284,6 +295,9 @@ public:
 
     GPUMatrix<ElemType>& DoGatherColumnsOf (ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
     GPUMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
+    GPUMatrix<ElemType>& DoGatherRowsOf   (ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
+    GPUMatrix<ElemType>& AssignPackedIndicesOf(const GPUMatrix<ElemType>* timeIndices, size_t numParallelSequences, size_t numTimeSteps,
+                                               const std::vector<PackedSequenceRange>& sequences, size_t targetStride);
 
     GPUMatrix<ElemType>& operator+=(const ElemType alpha);
     GPUMatrix<ElemType> operator+(const ElemType alpha) const;
@@ -347,6 +361,13 @@ public:
     GPUMatrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     GPUMatrix<ElemType>& AssignLogSoftmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise);
 
+    // fused column-wise softmax + cross entropy, see CPUMatrix::AssignSoftmaxCrossEntropyOf()
+    GPUMatrix<ElemType>& AssignSoftmaxCrossEntropyOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& input, GPUMatrix<ElemType>& logSumExp);
+    static void AddSoftmaxCrossEntropyGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& input,
+                                               const GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& inputGradient);
+    static void AddSoftmaxCrossEntropyLabelGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& input,
+                                                    const GPUMatrix<ElemType>& logSumExp, GPUMatrix<ElemType>& labelsGradient);
+
     GPUMatrix<ElemType>& InplaceHardmax(const bool isColWise);
     GPUMatrix<ElemType>& AssignHardmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise);
 
@@ -434,6 +455,7 @@ public:
     void VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<ElemType>& maxValues, const bool isColWise) const;
     void VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<ElemType>& maxValues, const bool isColWise, int topK) const;
     void VectorMin(GPUMatrix<ElemType>& minIndexes, GPUMatrix<ElemType>& minValues, const bool isColWise) const;
+    void TopK(GPUMatrix<ElemType>& topKValues, GPUMatrix<ElemType>& topKIndices, size_t k) const;
 
     GPUMatrix<ElemType>& AssignNumOfDiff(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, bool searchInCol = false);
 
@@ -484,10 +506,16 @@ public:
     void ConvolutionBackwardKernel(const GPUMatrix<ElemType>& in, const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIwht,
                                    const GPUMatrix<int>& mpRowRun, const GPUMatrix<int>& runs, GPUMatrix<ElemType>& kernelGrad) const;
 
+    void DepthwiseConvolutionForward(const GPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& output) const;
+    void DepthwiseConvolutionBackwardData(const GPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& grad) const;
+    void DepthwiseConvolutionBackwardKernel(const GPUMatrix<ElemType>& in, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& kernelGrad) const;
+
     void MaxPoolingForward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& output) const;
     void MaxPoolingBackward(const GPUMatrix<ElemType>& out, const GPUMatrix<ElemType>& in,
                             const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices,
                             GPUMatrix<ElemType>& grad) const;
+    void MaxPoolingForwardWithArgmax(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& output, GPUMatrix<short>& argmax) const;
+    void MaxPoolingBackwardWithArgmax(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, const GPUMatrix<short>& argmax, GPUMatrix<ElemType>& grad) const;
     void MaxUnpooling(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, const GPUMatrix<ElemType>& poolInput, GPUMatrix<ElemType>& input) const;
 
     void ROIPoolingForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
@@ -520,6 +548,12 @@ public:
     static void Multiply(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c);
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c,
+                                            size_t batchSize, bool broadcastA, bool broadcastB);
+    // c = alpha * a * b + beta * c in 8-bit integers, for QuantizedMultiplier (see QuantizedOperations.h). The quantized
+    // operands are kept in 'buffers', which are created on the first call; a constant a is quantized only once.
+    static void QuantizedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c,
+                                                bool isAConstant, std::shared_ptr<QuantizedGPUBuffers>& buffers);
 
     static void ColumnwiseScaleAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& v, ElemType beta, GPUMatrix<ElemType>& c);
 
@@ -564,6 +598,10 @@ public:
                      const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                      const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
 
+    void TensorProgramOp(ElemType beta, const std::array<const GPUMatrix<ElemType>*, ElementwiseProgram::MaxInputs>& inputs, ElemType alpha, const ElementwiseProgram& program,
+                         const std::array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                         const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides);
+
     static void CreateCurandObject(unsigned long seed, const char* caller);
     static void ResetCurandObject(unsigned long seed, const char* caller);
     static GPUMatrix<ElemType> Ones(const size_t rows, const size_t cols, int deviceId);
@@ -599,6 +637,12 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    // for LambdaRank and NDCG, see Matrix.h
+    static void RankWithinGroups(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& groupStarts, size_t truncation,
+                                 GPUMatrix<ElemType>& ranks, GPUMatrix<ElemType>& dcgs, GPUMatrix<ElemType>& idealDCGs);
+    static void AddLambdaRankGradient(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& groupStarts,
+                                      const GPUMatrix<ElemType>& idealDCGs, ElemType sigma, size_t truncation, GPUMatrix<ElemType>& gradient);
+
 public:
     friend File& operator>>(File& stream, GPUMatrix<ElemType>& us)
     {
@@ -612,8 +656,7 @@ public:
         int format;
         stream >> matrixNameDummy >> format >> numRows >> numCols;
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        stream.ReadArray(d_array, numRows * numCols);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
         delete[] d_array;
@@ -631,8 +674,7 @@ public:
 
         stream << us.m_numRows << us.m_numCols;
         ElemType* pArray = us.CopyToArray();
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << pArray[i];
+        stream.WriteArray(pArray, us.GetNumElements());
         
         delete[] pArray;
 
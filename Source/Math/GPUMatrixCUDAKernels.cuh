@@ -14,6 +14,9 @@
 #include "CommonMatrix.h"
 #include "GPUMatrix.h"
 #include "TensorOps.h" // for exp_() etc.
+#include "Float16.h"
+#include "Philox.h"
+#include "ImageAugmentation.h"
 #include "device_functions.h"
 #include <cuda_runtime.h>
 #include <assert.h>
@@ -623,6 +626,15 @@ __global__ void _multiply1x1AndWeightedAdd(
         c[id] = b[id] * f + c[id] * beta;
 }
 
+// rounds a float array to fp16, for the operands of the fp16 products in GPUMatrix<float>::MultiplyAndWeightedAdd()
+__global__ void _convertFloatToFloat16(const float* a, Float16* c, CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    c[id] = Float16(a[id]);
+}
+
 template <class ElemType>
 __global__ void _addValue(
     ElemType* a,
@@ -989,6 +1001,106 @@ __global__ void _assignColumnwiseLogSoftmaxOf512Threads(
     }
 }
 
+// fused softmax + cross entropy, one block per column (see GPUMatrix::AssignSoftmaxCrossEntropyOf())
+// logSumExp[j] = log(sum_i exp(x(i,j))); crossEntropy[0] += sum(y(:,j)) * logSumExp[j] - y(:,j)' * x(:,j)
+// crossEntropy[0] must be zeroed by the caller. Zero labels are skipped, so that gap columns do not turn the result into NaN.
+template <class ElemType>
+__global__ void _assignColumnwiseSoftmaxCrossEntropyOf512Threads(
+    const ElemType* y,
+    const ElemType* x,
+    ElemType* logSumExp,
+    ElemType* crossEntropy,
+    const CUDA_LONG numRows)
+{
+    __shared__ ElemType partialMax[512];
+    __shared__ ElemType partialLabelSum[512];
+    __shared__ ElemType partialLabelDot[512];
+    const ElemType* px = x + IDX2C(0, blockIdx.x, numRows);
+    const ElemType* py = y + IDX2C(0, blockIdx.x, numRows);
+
+    // first pass: max and the label terms
+    ElemType maxV = px[0];
+    ElemType labelSum = 0;
+    ElemType labelDot = 0;
+    for (int i = threadIdx.x; i < numRows; i += 512)
+    {
+        maxV = max(maxV, px[i]);
+        labelSum += py[i];
+        if (py[i] != 0)
+            labelDot += py[i] * px[i];
+    }
+    partialMax[threadIdx.x] = maxV;
+    partialLabelSum[threadIdx.x] = labelSum;
+    partialLabelDot[threadIdx.x] = labelDot;
+    __syncthreads();
+    for (int s = 256; s > 0; s >>= 1)
+    {
+        if (threadIdx.x < s)
+        {
+            partialMax[threadIdx.x] = max(partialMax[threadIdx.x], partialMax[threadIdx.x + s]);
+            partialLabelSum[threadIdx.x] += partialLabelSum[threadIdx.x + s];
+            partialLabelDot[threadIdx.x] += partialLabelDot[threadIdx.x + s];
+        }
+        __syncthreads();
+    }
+    const ElemType colMax = partialMax[0];
+
+    // second pass: sum of exp(x - max), reusing partialMax[]
+    ElemType sum = 0;
+    for (int i = threadIdx.x; i < numRows; i += 512)
+        sum += exp_(px[i] - colMax);
+    __syncthreads();
+    partialMax[threadIdx.x] = sum;
+    __syncthreads();
+    for (int s = 256; s > 0; s >>= 1)
+    {
+        if (threadIdx.x < s)
+            partialMax[threadIdx.x] += partialMax[threadIdx.x + s];
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+    {
+        const ElemType lse = colMax + log_(partialMax[0]);
+        logSumExp[blockIdx.x] = lse;
+        labelSum = partialLabelSum[0];
+        atomicAdd(crossEntropy, (labelSum != 0 ? labelSum * lse : 0) - partialLabelDot[0]);
+    }
+}
+
+// g += gradient[0] * (exp(x - logSumExp[column]) - y)
+template <class ElemType>
+__global__ void _addSoftmaxCrossEntropyGradient(
+    const ElemType* gradient,
+    const ElemType* y,
+    const ElemType* x,
+    const ElemType* logSumExp,
+    ElemType* g,
+    const CUDA_LONG numRows,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    g[id] += gradient[0] * (exp_(x[id] - logSumExp[id / numRows]) - y[id]);
+}
+
+// g -= gradient[0] * (x - logSumExp[column])
+template <class ElemType>
+__global__ void _addSoftmaxCrossEntropyLabelGradient(
+    const ElemType* gradient,
+    const ElemType* x,
+    const ElemType* logSumExp,
+    ElemType* g,
+    const CUDA_LONG numRows,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    g[id] -= gradient[0] * (x[id] - logSumExp[id / numRows]);
+}
+
 template <class ElemType>
 __global__ void _logSoftMaxRowWise(
     ElemType* a,
@@ -1689,6 +1801,24 @@ __global__ void _setMaskAndScale(
     a[id] = a[id] <= maskRate ? 0 : scaleValue;
 }
 
+template <class ElemType>
+__global__ void _counterBasedDropout(
+    ElemType* us,
+    const ElemType* a,
+    const CUDA_LONG N,
+    const ElemType maskRate,
+    const ElemType scaleValue,
+    const uint64_t seed,
+    const uint64_t offset,
+    const ElemType beta)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const ElemType v = a[id] * PhiloxDropoutMask(seed, offset + id, maskRate, scaleValue);
+    us[id] = beta == 0 ? v : beta * us[id] + v;
+}
+
 template <class ElemType>
 __global__ void _vectorSum(
     ElemType* c,       // output
@@ -3136,6 +3266,73 @@ __global__ void _dense1DConvMultSparseCSCTransposeAndAddToDense(
     }
 }
 
+// c = alpha * op(a) * b + beta * c for a CSC matrix b with few nonzeros per column, e.g. one-hot input words:
+// each column of c gathers the columns of op(a) that the nonzeros of the column of b select
+template <class ElemType>
+__global__ void _denseMulSparseCSCGatherAndWeightedAdd(
+    const int m, // rows of op(a) and c
+    const int k, // columns of op(a)
+    const int n, // columns of b and c
+    const ElemType alpha,
+    const ElemType* a, // dense
+    const bool transposeA,
+    const ElemType* bnzValues, // sparse nz values
+    const GPUSPARSE_INDEX_TYPE* rowIndex,
+    const GPUSPARSE_INDEX_TYPE* colCSCIndex,
+    const ElemType beta,
+    ElemType* c // dense target
+    )
+{
+    const CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= (CUDA_LONG) m * n)
+        return;
+
+    const int colInC = id / m;
+    const int rowInC = id - colInC * m;
+
+    ElemType s = 0;
+    for (int j = colCSCIndex[colInC]; j < colCSCIndex[colInC + 1]; j++)
+    {
+        const int i = rowIndex[j];
+        s += (transposeA ? a[IDX2C(i, rowInC, k)] : a[IDX2C(rowInC, i, m)]) * bnzValues[j];
+    }
+
+    c[IDX2C(rowInC, colInC, m)] = alpha * s + (beta == 0 ? 0 : beta * c[IDX2C(rowInC, colInC, m)]); // If beta is zero then don't lookup c
+}
+
+// c += alpha * op(a) * b^T for a CSC matrix b, as in the gradient of an embedding: each nonzero b[r, j] adds column j
+// of op(a), scaled, to column r of c. One thread per row of c and column of b, so that it all is one launch; columns
+// of c that several nonzeros select (the same word in several samples) are added up atomically.
+template <class ElemType>
+__global__ void _denseMulSparseCSCTransposeScatterAdd(
+    const int m, // rows of op(a) and c
+    const int k, // columns of op(a) and of b
+    const ElemType alpha,
+    const ElemType* a, // dense
+    const bool transposeA,
+    const ElemType* bnzValues, // sparse nz values
+    const GPUSPARSE_INDEX_TYPE* rowIndex,
+    const GPUSPARSE_INDEX_TYPE* colCSCIndex,
+    ElemType* c // dense target
+    )
+{
+    const CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= (CUDA_LONG) m * k)
+        return;
+
+    const int colInB = id / m;
+    const int rowInC = id - colInB * m;
+
+    const int start = colCSCIndex[colInB];
+    const int end = colCSCIndex[colInB + 1];
+    if (start == end)
+        return;
+
+    const ElemType v = alpha * (transposeA ? a[IDX2C(colInB, rowInC, k)] : a[IDX2C(rowInC, colInB, m)]);
+    for (int j = start; j < end; j++)
+        atomicAdd(&c[IDX2C(rowInC, rowIndex[j], m)], v * bnzValues[j]);
+}
+
 template <class ElemType>
 __global__ void _columnwiseScaleAndWeightedAdd(
     ElemType alpha,
@@ -3395,6 +3592,72 @@ __global__ void _scaleSparseBlockAndAddToDense(
     rhs[IDX2C(row, col, numRows)] += alpha * lhsValues[index];
 }
 
+// called before _determineBlockIds() to mark the columns (rows) that have a block in one of the inputs of a
+// block-sparse addition, so that they get a block in the result
+template <class ElemType>
+__global__ void _findBlocksWithValues(
+    const GPUSPARSE_INDEX_TYPE* blockId2ColOrRow, const size_t numBlocks, GPUSPARSE_INDEX_TYPE* colOrRow2BlockIdResult)
+{
+    const size_t blockId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (blockId >= numBlocks)
+        return;
+
+    colOrRow2BlockIdResult[blockId2ColOrRow[blockId]] = Id_Pending;
+}
+
+// result += alpha * a for block-sparse matrices of the same format, where the result has a block for every block of a
+template <class ElemType>
+__global__ void _scaleSparseBlocksAndAdd(
+    const ElemType alpha,
+    const ElemType* aValues,
+    const GPUSPARSE_INDEX_TYPE* aBlockId2ColOrRow,
+    const size_t len, // rows (blockCol) or columns (blockRow) of a block
+    const CUDA_LONG N, // elements in the blocks of a
+    const GPUSPARSE_INDEX_TYPE* resultColOrRow2BlockId,
+    ElemType* resultValues)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= N)
+        return;
+
+    const CUDA_LONG blockId = index / len;
+    const CUDA_LONG k = index - blockId * len;
+    const GPUSPARSE_INDEX_TYPE resultBlockId = resultColOrRow2BlockId[aBlockId2ColOrRow[blockId]];
+    resultValues[resultBlockId * len + k] += alpha * aValues[index];
+}
+
+// a .*= b for the values of a block-sparse matrix a and a dense matrix b
+template <class ElemType>
+__global__ void _sparseBlockElementMultiplyWithDense(
+    const bool blockCol, // true if blockRow
+    const size_t numRows,
+    const size_t numCols,
+    const size_t numBlocks,
+    ElemType* values,
+    const GPUSPARSE_INDEX_TYPE* blockIds,
+    const ElemType* b)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG row, col;
+    if (blockCol)
+    {
+        const CUDA_LONG blockId = index / numRows;
+        if (blockId >= numBlocks)
+            return;
+        row = index - numRows * blockId;
+        col = blockIds[blockId];
+    }
+    else
+    {
+        const CUDA_LONG blockId = index / numCols;
+        if (blockId >= numBlocks)
+            return;
+        col = index - numCols * blockId;
+        row = blockIds[blockId];
+    }
+    values[index] *= b[IDX2C(row, col, numRows)];
+}
+
 #if 0
 // compute predictions in cross entropy node
 template <class ElemType>
@@ -5136,6 +5399,259 @@ __global__ void _copyTopKResults(const uint64_t* indexes, const ElemType* values
     maxValues[id] = values[icol * crow + irow];
 }
 
+// Maps values to unsigned integers of the same order, for radix selection.
+template <class ElemType>
+struct RadixSelectKey;
+template <>
+struct RadixSelectKey<float>
+{
+    typedef unsigned int KeyType;
+    static __device__ KeyType Of(float v)
+    {
+        KeyType u = __float_as_uint(v);
+        return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+    }
+};
+template <>
+struct RadixSelectKey<double>
+{
+    typedef unsigned long long KeyType;
+    static __device__ KeyType Of(double v)
+    {
+        KeyType u = (KeyType)__double_as_longlong(v);
+        return (u & 0x8000000000000000ull) ? ~u : (u | 0x8000000000000000ull);
+    }
+};
+
+// Top k of each column, sorted descending, equal values by row index. One block per column, k <= MaxK.
+// The k-th largest value is found digit by digit (8 bits at a time, most significant first) from a histogram of the
+// values that agree with the digits found so far. Then the values above it and the first ones equal to it are
+// collected in row order with a block-wide scan, and sorted by their rank among the k.
+template <int BlockSize, int MaxK, class ElemType>
+__global__ void _radixSelectTopK(const ElemType* a, ElemType* topKValues, ElemType* topKIndices, CUDA_LONG crow, int k)
+{
+    typedef typename RadixSelectKey<ElemType>::KeyType KeyType;
+    typedef cub::BlockScan<int, BlockSize> BlockScan;
+    __shared__ typename BlockScan::TempStorage scanStorage;
+    __shared__ int histogram[256];
+    __shared__ KeyType s_threshold;
+    __shared__ int s_numEqual;
+    __shared__ int s_numAbove, s_numEqualSeen;
+    __shared__ ElemType s_values[MaxK];
+    __shared__ int s_indices[MaxK];
+
+    const ElemType* col = a + (size_t)blockIdx.x * crow;
+    KeyType threshold = 0;
+    KeyType thresholdMask = 0;
+    int numEqual = k; // how many of the values that agree with the threshold so far are among the top k
+    for (int shift = sizeof(KeyType) * 8 - 8; shift >= 0; shift -= 8)
+    {
+        for (int i = threadIdx.x; i < 256; i += BlockSize)
+            histogram[i] = 0;
+        __syncthreads();
+        for (CUDA_LONG i = threadIdx.x; i < crow; i += BlockSize)
+        {
+            KeyType key = RadixSelectKey<ElemType>::Of(col[i]);
+            if ((key & thresholdMask) == threshold)
+                atomicAdd(&histogram[(int)((key >> shift) & 0xff)], 1);
+        }
+        __syncthreads();
+        if (threadIdx.x == 0)
+        {
+            int digit = 255;
+            for (; digit > 0 && histogram[digit] < numEqual; digit--)
+                numEqual -= histogram[digit];
+            s_threshold = threshold | ((KeyType)digit << shift);
+            s_numEqual = numEqual;
+        }
+        __syncthreads();
+        threshold = s_threshold;
+        numEqual = s_numEqual;
+        thresholdMask |= (KeyType)0xff << shift;
+    }
+
+    // collect in row order
+    if (threadIdx.x == 0)
+    {
+        s_numAbove = 0;
+        s_numEqualSeen = 0;
+    }
+    __syncthreads();
+    for (CUDA_LONG i0 = 0; i0 < crow; i0 += BlockSize)
+    {
+        CUDA_LONG i = i0 + threadIdx.x;
+        KeyType key = i < crow ? RadixSelectKey<ElemType>::Of(col[i]) : 0;
+        int isAbove = (i < crow && key > threshold) ? 1 : 0;
+        int isEqual = (i < crow && key == threshold) ? 1 : 0;
+        int above, equal, numAboveInChunk, numEqualInChunk;
+        BlockScan(scanStorage).ExclusiveSum(isAbove, above, numAboveInChunk);
+        __syncthreads();
+        BlockScan(scanStorage).ExclusiveSum(isEqual, equal, numEqualInChunk);
+        int numAbove = s_numAbove, numEqualSeen = s_numEqualSeen;
+        if (isAbove)
+        {
+            s_values[numAbove + above] = col[i];
+            s_indices[numAbove + above] = (int)i;
+        }
+        else if (isEqual && numEqualSeen + equal < numEqual)
+        {
+            s_values[k - numEqual + numEqualSeen + equal] = col[i];
+            s_indices[k - numEqual + numEqualSeen + equal] = (int)i;
+        }
+        __syncthreads();
+        if (threadIdx.x == 0)
+        {
+            s_numAbove += numAboveInChunk;
+            s_numEqualSeen += numEqualInChunk;
+        }
+        __syncthreads();
+    }
+
+    // sort the k by rank
+    for (int j = threadIdx.x; j < k; j += BlockSize)
+    {
+        ElemType v = s_values[j];
+        int index = s_indices[j];
+        int rank = 0;
+        for (int q = 0; q < k; q++)
+            rank += (s_values[q] > v || (s_values[q] == v && s_indices[q] < index)) ? 1 : 0;
+        topKValues[(size_t)blockIdx.x * k + rank] = v;
+        topKIndices[(size_t)blockIdx.x * k + rank] = (ElemType)index;
+    }
+}
+
+// the position discount 1/log(2 + rank) of the DCG, 0 beyond the truncation
+template <class ElemType>
+__device__ __forceinline__ ElemType _rankDiscount(CUDA_LONG rank, CUDA_LONG truncation)
+{
+    return (truncation == 0 || rank < truncation) ? 1 / log_((ElemType)(2 + rank)) : 0;
+}
+
+// the score by which samples are ranked; NaN ranks last
+template <class ElemType>
+__device__ __forceinline__ ElemType _rankingScore(ElemType score)
+{
+    return isnan(score) ? -(ElemType)INFINITY : score;
+}
+
+// the lambda of a pair of samples h, l of a group with gain h > gain l
+template <class ElemType>
+__device__ __forceinline__ ElemType _lambdaOfPair(ElemType scoreH, ElemType scoreL, ElemType gainH, ElemType gainL, ElemType discountH, ElemType discountL, ElemType idealDCG, ElemType sigma)
+{
+    const ElemType deltaNDCG = fabs_((gainH - gainL) * (discountL - discountH)) / idealDCG;
+    return -sigma / (1 + exp_(sigma * (scoreH - scoreL))) * deltaNDCG;
+}
+
+// Ranks the samples of each group (consecutive columns, groupStarts[g] to groupStarts[g + 1]) by descending score, lower
+// gain first at equal score, then lower index, and computes the DCG of the group at these ranks and at the ideal ranks
+// (the samples being in descending order of gains). One block per group. Each thread counts the samples ranked before
+// its own, the group being read in tiles through shared memory, so no sort is needed for groups of any size.
+template <int BlockSize, class ElemType>
+__global__ void _rankWithinGroups(const ElemType* scores, const ElemType* gains, const ElemType* groupStarts, CUDA_LONG truncation,
+                                  ElemType* ranks, ElemType* dcgs, ElemType* idealDCGs)
+{
+    typedef cub::BlockReduce<ElemType, BlockSize> BlockReduce;
+    __shared__ typename BlockReduce::TempStorage reduceStorage;
+    __shared__ ElemType s_scores[BlockSize];
+    __shared__ ElemType s_gains[BlockSize];
+
+    const CUDA_LONG begin = (CUDA_LONG)groupStarts[blockIdx.x];
+    const CUDA_LONG end = (CUDA_LONG)groupStarts[blockIdx.x + 1];
+    ElemType dcg = 0;
+    ElemType idealDCG = 0;
+    for (CUDA_LONG i0 = begin; i0 < end; i0 += BlockSize)
+    {
+        const CUDA_LONG i = i0 + threadIdx.x;
+        const ElemType score = i < end ? _rankingScore(scores[i]) : 0;
+        const ElemType gain = i < end ? gains[i] : 0;
+        CUDA_LONG rank = 0;
+        for (CUDA_LONG j0 = begin; j0 < end; j0 += BlockSize)
+        {
+            const CUDA_LONG j = j0 + threadIdx.x;
+            if (j < end)
+            {
+                s_scores[threadIdx.x] = _rankingScore(scores[j]);
+                s_gains[threadIdx.x] = gains[j];
+            }
+            __syncthreads();
+            if (i < end)
+            {
+                const CUDA_LONG tileSize = min((CUDA_LONG)BlockSize, end - j0);
+                for (CUDA_LONG q = 0; q < tileSize; q++)
+                    rank += (s_scores[q] > score || (s_scores[q] == score && (s_gains[q] < gain || (s_gains[q] == gain && j0 + q < i)))) ? 1 : 0;
+            }
+            __syncthreads();
+        }
+        if (i < end)
+        {
+            ranks[i] = (ElemType)rank;
+            dcg += gain * _rankDiscount<ElemType>(rank, truncation);
+            idealDCG += gain * _rankDiscount<ElemType>(i - begin, truncation);
+        }
+    }
+    dcg = BlockReduce(reduceStorage).Sum(dcg);
+    __syncthreads();
+    idealDCG = BlockReduce(reduceStorage).Sum(idealDCG);
+    if (threadIdx.x == 0)
+    {
+        dcgs[blockIdx.x] = dcg;
+        idealDCGs[blockIdx.x] = idealDCG;
+    }
+}
+
+// Adds the LambdaRank gradient of each group, one block per group. Each thread sums the lambdas of all pairs of its
+// sample, the other samples being read in tiles through shared memory, so there are no atomics. Pairs of two samples
+// beyond the truncation do not change the DCG and are skipped.
+template <int BlockSize, class ElemType>
+__global__ void _addLambdaRankGradient(const ElemType* scores, const ElemType* gains, const ElemType* ranks, const ElemType* groupStarts, const ElemType* idealDCGs,
+                                       ElemType sigma, CUDA_LONG truncation, ElemType* gradient)
+{
+    __shared__ ElemType s_scores[BlockSize];
+    __shared__ ElemType s_gains[BlockSize];
+    __shared__ ElemType s_discounts[BlockSize];
+
+    const ElemType idealDCG = idealDCGs[blockIdx.x];
+    if (idealDCG == 0) // the same for the whole block
+        return;
+    const CUDA_LONG begin = (CUDA_LONG)groupStarts[blockIdx.x];
+    const CUDA_LONG end = (CUDA_LONG)groupStarts[blockIdx.x + 1];
+    for (CUDA_LONG i0 = begin; i0 < end; i0 += BlockSize)
+    {
+        const CUDA_LONG i = i0 + threadIdx.x;
+        const ElemType score = i < end ? scores[i] : 0;
+        const ElemType gain = i < end ? gains[i] : 0;
+        const ElemType discount = i < end ? _rankDiscount<ElemType>((CUDA_LONG)ranks[i], truncation) : 0;
+        ElemType lambda = 0;
+        for (CUDA_LONG j0 = begin; j0 < end; j0 += BlockSize)
+        {
+            const CUDA_LONG j = j0 + threadIdx.x;
+            if (j < end)
+            {
+                s_scores[threadIdx.x] = scores[j];
+                s_gains[threadIdx.x] = gains[j];
+                s_discounts[threadIdx.x] = _rankDiscount<ElemType>((CUDA_LONG)ranks[j], truncation);
+            }
+            __syncthreads();
+            if (i < end)
+            {
+                const CUDA_LONG tileSize = min((CUDA_LONG)BlockSize, end - j0);
+                for (CUDA_LONG q = 0; q < tileSize; q++)
+                {
+                    if (discount == 0 && s_discounts[q] == 0)
+                        continue;
+                    if (gain - s_gains[q] >= (ElemType)0.0000001)
+                        lambda += _lambdaOfPair(score, s_scores[q], gain, s_gains[q], discount, s_discounts[q], idealDCG, sigma);
+                    else if (s_gains[q] - gain >= (ElemType)0.0000001)
+                        lambda -= _lambdaOfPair(s_scores[q], score, s_gains[q], gain, s_discounts[q], discount, idealDCG, sigma);
+                }
+            }
+            __syncthreads();
+        }
+        if (i < end)
+            gradient[i] += lambda;
+    }
+}
+
 template <int BlockSize, class ElemType>
 __global__ void _assignNumOfDiffCol(const ElemType* a, const ElemType* b, ElemType* c, CUDA_LONG crowB, CUDA_LONG ccol)
 {
@@ -5188,6 +5704,163 @@ __global__ void _maskColumnsValue(ElemType* a, const char* columnsMask, CUDA_LON
     }
 }
 
+// Expands bytes (e.g. 8 bit image data) and normalizes them in one pass: a = (bytes - mean) * scale.
+template <class ElemType>
+__global__ void _assignNormalizedBytesOf(ElemType* a, const unsigned char* bytes, const ElemType mean, const ElemType scale, const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    a[id] = ((ElemType) bytes[id] - mean) * scale;
+}
+
+// One block per image, see ImageAugmentation.h. The brightness needs the mean of the cropped and scaled image,
+// for which the pixels are sampled twice.
+template <int BlockSize, class ElemType>
+__global__ void _assignAugmentedImagesOf(ElemType* a, const unsigned char* bytes, const ImageAugmentation augmentation, const uint64_t firstImage)
+{
+    typedef cub::BlockReduce<float, BlockSize> BlockReduce;
+    __shared__ typename BlockReduce::TempStorage reduceStorage;
+    __shared__ float s_imageMean;
+
+    const ImageAugmentation& aug = augmentation;
+    const CUDA_LONG numPixels = aug.outW * aug.outH;
+    const CUDA_LONG outSize = numPixels * aug.channels;
+    const unsigned char* image = bytes + (size_t)blockIdx.x * aug.inW * aug.inH * aug.channels;
+    ElemType* out = a + (size_t)blockIdx.x * outSize;
+    const ImageAugmentationSample s = DrawImageAugmentationSample(aug, firstImage + blockIdx.x);
+    float v[ImageAugmentation::MaxChannels];
+
+    float imageMean = 0;
+    if (aug.brightnessRadius > 0) // the same for the whole block
+    {
+        float sum = 0;
+        for (CUDA_LONG p = threadIdx.x; p < numPixels; p += BlockSize)
+        {
+            SampleAugmentedPixel(aug, s, image, p % aug.outW, p / aug.outW, v);
+            for (int c = 0; c < aug.channels; c++)
+                sum += v[c];
+        }
+        sum = BlockReduce(reduceStorage).Sum(sum);
+        if (threadIdx.x == 0)
+            s_imageMean = sum / outSize;
+        __syncthreads();
+        imageMean = s_imageMean;
+    }
+
+    for (CUDA_LONG p = threadIdx.x; p < numPixels; p += BlockSize)
+    {
+        const int x = p % aug.outW, y = p / aug.outW;
+        SampleAugmentedPixel(aug, s, image, x, y, v);
+        JitterAndNormalizePixel(aug, s, imageMean, v);
+        for (int c = 0; c < aug.channels; c++)
+            out[ImageElementOffset(aug, aug.outW, aug.outH, x, y, c)] = (ElemType)v[c];
+    }
+}
+
+// Kernels of GPUMatrix::QuantizedMultiplyAndWeightedAdd(). The int8 operands are laid out with the inner dimension k
+// contiguous and padded with zeros to kPadded, a multiple of 4, so that they can be read as ints of 4 values.
+
+// Quantizes each row of the column-major a[m,k] by its own scale, one thread per row, into q[m,kPadded] (row-major),
+// and stores the factors that convert the integers back.
+template <class ElemType>
+__global__ void _quantizeRowsToInt8(const ElemType* a, const CUDA_LONG m, const CUDA_LONG k, const CUDA_LONG kPadded, signed char* q, float* inverseFactors)
+{
+    CUDA_LONG row = blockDim.x * blockIdx.x + threadIdx.x;
+    if (row >= m)
+        return;
+    float maxAbs = 0;
+    for (CUDA_LONG j = 0; j < k; j++)
+        maxAbs = fmaxf(maxAbs, fabsf((float) a[row + j * m]));
+    float factor = maxAbs > 0 ? 127.0f / maxAbs : 0;
+    for (CUDA_LONG j = 0; j < kPadded; j++)
+        q[row * kPadded + j] = j < k ? (signed char) __float2int_rn((float) a[row + j * m] * factor) : 0;
+    inverseFactors[row] = maxAbs / 127.0f;
+}
+
+// Largest magnitude of the N values into *maxAbs, which must be 0 before. The bits of non-negative floats are ordered
+// like ints, so the blocks combine their maxima with an integer atomicMax().
+template <class ElemType>
+__global__ void _maxAbsToFloat(const ElemType* data, const CUDA_LONG N, float* maxAbs)
+{
+    __shared__ float partialMax[GridDim::maxThreadsPerBlock];
+    float threadMax = 0;
+    for (CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x; id < N; id += blockDim.x * gridDim.x)
+        threadMax = fmaxf(threadMax, fabsf((float) data[id]));
+    partialMax[threadIdx.x] = threadMax;
+    __syncthreads();
+    for (int stride = blockDim.x / 2; stride > 0; stride /= 2)
+    {
+        if (threadIdx.x < stride)
+            partialMax[threadIdx.x] = fmaxf(partialMax[threadIdx.x], partialMax[threadIdx.x + stride]);
+        __syncthreads();
+    }
+    if (threadIdx.x == 0)
+        atomicMax(reinterpret_cast<int*>(maxAbs), __float_as_int(partialMax[0]));
+}
+
+// Quantizes the column-major b[k,n] by the scale of *maxAbs into q[kPadded,n], one thread per value.
+template <class ElemType>
+__global__ void _quantizeToInt8(const ElemType* b, const CUDA_LONG k, const CUDA_LONG kPadded, const CUDA_LONG n, const float* maxAbs, signed char* q)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= kPadded * n)
+        return;
+    CUDA_LONG row = id % kPadded;
+    CUDA_LONG col = id / kPadded;
+    float factor = *maxAbs > 0 ? 127.0f / *maxAbs : 0;
+    q[id] = row < k ? (signed char) __float2int_rn((float) b[row + col * k] * factor) : 0;
+}
+
+// Sum of the products of the 4 signed bytes of a and b, plus c; a single instruction from compute capability 6.1 on.
+__device__ __forceinline__ int _dp4a(const int a, const int b, const int c)
+{
+#if __CUDA_ARCH__ >= 610
+    return __dp4a(a, b, c);
+#else
+    const char4 va = *reinterpret_cast<const char4*>(&a);
+    const char4 vb = *reinterpret_cast<const char4*>(&b);
+    return c + va.x * vb.x + va.y * vb.y + va.z * vb.z + va.w * vb.w;
+#endif
+}
+
+#define QUANTIZED_PRODUCT_TILE 16
+
+// c[m,n] = alpha * (a * b) * aInverseFactors[row] * *bMaxAbs / 127 + beta * c[m,n], where a[m,kWords] holds the rows and
+// b[n,kWords] the columns of the int8 operands, 4 values per int. One thread per element of c, in blocks of 16 x 16 that
+// go through k in tiles of 16 ints (64 values) in shared memory; the sums are exact in 32 bits.
+template <class ElemType>
+__global__ void _quantizedProduct(const int* a, const int* b, const CUDA_LONG m, const CUDA_LONG n, const CUDA_LONG kWords,
+                                  const float* aInverseFactors, const float* bMaxAbs, const ElemType alpha, const ElemType beta, ElemType* c)
+{
+    // one more column against bank conflicts when the tiles are read across
+    __shared__ int aTile[QUANTIZED_PRODUCT_TILE][QUANTIZED_PRODUCT_TILE + 1];
+    __shared__ int bTile[QUANTIZED_PRODUCT_TILE][QUANTIZED_PRODUCT_TILE + 1];
+
+    // consecutive threads of a warp write consecutive rows of c
+    CUDA_LONG row = blockIdx.y * QUANTIZED_PRODUCT_TILE + threadIdx.x;
+    CUDA_LONG col = blockIdx.x * QUANTIZED_PRODUCT_TILE + threadIdx.y;
+    CUDA_LONG tileRow = blockIdx.y * QUANTIZED_PRODUCT_TILE + threadIdx.y;
+
+    int sum = 0;
+    for (CUDA_LONG w0 = 0; w0 < kWords; w0 += QUANTIZED_PRODUCT_TILE)
+    {
+        CUDA_LONG w = w0 + threadIdx.x;
+        aTile[threadIdx.y][threadIdx.x] = tileRow < m && w < kWords ? a[tileRow * kWords + w] : 0;
+        bTile[threadIdx.y][threadIdx.x] = col < n && w < kWords ? b[col * kWords + w] : 0;
+        __syncthreads();
+        for (int i = 0; i < QUANTIZED_PRODUCT_TILE; i++)
+            sum = _dp4a(aTile[threadIdx.x][i], bTile[threadIdx.y][i], sum);
+        __syncthreads();
+    }
+
+    if (row >= m || col >= n)
+        return;
+    ElemType value = alpha * (ElemType)((float) sum * aInverseFactors[row] * (*bMaxAbs / 127.0f));
+    CUDA_LONG id = row + col * m;
+    c[id] = beta == 0 ? value : value + beta * c[id];
+}
+
 template <class ElemType>
 __global__ void _adam(CUDA_LONG size, ElemType* grad, ElemType* smoothAda, ElemType* smoothMom, ElemType* val,
     ElemType lr, ElemType mom, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum)
@@ -5248,6 +5921,241 @@ __global__ void _adam4BlockSparseCol(CUDA_LONG size,
     }
 }
 
+// Lazy updates of block-sparse gradients (LazyUpdateStepPeriod): one thread per non-zero element, i.e. only the
+// columns present in the gradient. With lazyUpdateSteps, the moments of a column first decay by the updates since the
+// column was last updated.
+template <class ElemType>
+__global__ void _advanceLazyUpdateSteps(ElemType* lazyUpdateSteps, const size_t numCols)
+{
+    lazyUpdateSteps[numCols] = (ElemType)(((size_t)lazyUpdateSteps[numCols] + 1) % LazyUpdateStepPeriod);
+}
+
+template <class ElemType>
+__global__ void _setLazyUpdateSteps(ElemType* lazyUpdateSteps, const size_t numCols, const GPUSPARSE_INDEX_TYPE* blockId2Col, const CUDA_LONG numBlocks)
+{
+    CUDA_LONG block = blockIdx.x * blockDim.x + threadIdx.x;
+    if (block < numBlocks)
+        lazyUpdateSteps[blockId2Col[block]] = lazyUpdateSteps[numCols];
+}
+
+template <class ElemType>
+__device__ ElemType _lazySkippedSteps(const ElemType* lazyUpdateSteps, const size_t numCols, const GPUSPARSE_INDEX_TYPE col)
+{
+    return (ElemType)(((size_t)lazyUpdateSteps[numCols] + LazyUpdateStepPeriod - (size_t)lazyUpdateSteps[col] - 1) % LazyUpdateStepPeriod);
+}
+
+template <class ElemType>
+__global__ void _fsadagrad4BlockSparseColLazy(CUDA_LONG nz,
+    const ElemType* grad_bsc, const GPUSPARSE_INDEX_TYPE* blockId2Col, const size_t len,
+    ElemType* smoothAda, ElemType* smoothMom, ElemType* val,
+    ElemType lr, ElemType mom, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+    const ElemType* lazyUpdateSteps, const size_t numCols)
+{
+    const ElemType unitGainFactor = unitGainMomentum ? (1.0 - mom) : 1.0;
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    for (; idx < nz; idx += stride)
+    {
+        const CUDA_LONG block = idx / len;
+        const GPUSPARSE_INDEX_TYPE col = blockId2Col[block];
+        const CUDA_LONG i = col * len + (idx - block * len);
+        if (lazyUpdateSteps)
+        {
+            const ElemType skipped = _lazySkippedSteps(lazyUpdateSteps, numCols, col);
+            smoothAda[i] *= pow(adaWeight, skipped);
+            smoothMom[i] *= pow(mom, skipped);
+        }
+
+        ElemType g = grad_bsc[idx];
+        ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+        smoothAda[i] = adaSqr;
+        if (adaSqr != 0.0f)
+        {
+            ElemType w;
+            if (sizeof(ElemType) == sizeof(double))
+            {
+                w = adaMul * rsqrt(adaSqr);
+            }
+            else
+            {
+                w = adaMul * rsqrtf(adaSqr);
+            }
+
+            if (w > 10.0f)
+                w = 10.0f;
+            g *= w;
+        }
+
+        if (mom > 0.0f)
+        {
+            g = mom * smoothMom[i] + unitGainFactor * g;
+            smoothMom[i] = g;
+        }
+
+        g *= lr;
+        val[i] -= g;
+    }
+}
+
+template <class ElemType>
+__global__ void _adam4BlockSparseColLazy(CUDA_LONG nz,
+    const ElemType* grad_bsc, const GPUSPARSE_INDEX_TYPE* blockId2Col, const size_t len,
+    ElemType* smoothAda, ElemType* smoothMom, ElemType* val,
+    ElemType lr, ElemType mom, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+    const ElemType* lazyUpdateSteps, const size_t numCols)
+{
+    const ElemType unitGainFactor = unitGainMomentum ? (1.0 - mom) : 1.0;
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    for (; idx < nz; idx += stride)
+    {
+        const CUDA_LONG block = idx / len;
+        const GPUSPARSE_INDEX_TYPE col = blockId2Col[block];
+        const CUDA_LONG i = col * len + (idx - block * len);
+        if (lazyUpdateSteps)
+        {
+            const ElemType skipped = _lazySkippedSteps(lazyUpdateSteps, numCols, col);
+            smoothAda[i] *= pow(adaWeight, skipped);
+            smoothMom[i] *= pow(mom, skipped);
+        }
+
+        ElemType g = grad_bsc[idx];
+        ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+        smoothAda[i] = adaSqr;
+        ElemType w;
+        if (sizeof(ElemType) == sizeof(double))
+        {
+            w = adaMul * rsqrt(adaSqr + 1e-8);
+        }
+        else
+        {
+            w = adaMul * rsqrtf(adaSqr + 1e-8);
+        }
+
+        g = mom * smoothMom[i] + unitGainFactor * g;
+        smoothMom[i] = g;
+        g = lr*g*w;
+        val[i] -= g;
+    }
+}
+
+// Multi-tensor updates (MultiTensorItem): a list of tensors passed by value, and processed in chunks. Block b works on
+// chunk b - firstChunk[t] of the tensor t with firstChunk[t] <= b < firstChunk[t + 1].
+static const CUDA_LONG multiTensorThreadsPerBlock = 512;
+static const CUDA_LONG multiTensorChunkSize = 32 * multiTensorThreadsPerBlock;
+
+template <class ElemType>
+struct MultiTensorList
+{
+    static const int MaxTensors = (int) MultiTensorItem<ElemType>::MaxTensorsPerLaunch;
+
+    int numTensors;
+    ElemType* value[MaxTensors];
+    ElemType* gradient[MaxTensors];
+    ElemType* smoothedGradient[MaxTensors];
+    CUDA_LONG numElements[MaxTensors];
+    int firstChunk[MaxTensors];
+    ElemType gradientScale[MaxTensors];
+    ElemType l2Weight[MaxTensors];
+    ElemType learnRatePerSample[MaxTensors];
+    ElemType adaMul[MaxTensors];
+};
+
+// the tensor and the range of elements of this block
+template <class ElemType>
+__device__ __forceinline__ int _multiTensorChunk(const MultiTensorList<ElemType>& list, CUDA_LONG& begin, CUDA_LONG& end)
+{
+    int t = 0;
+    while (t + 1 < list.numTensors && list.firstChunk[t + 1] <= (int) blockIdx.x)
+        t++;
+    begin = ((CUDA_LONG) blockIdx.x - list.firstChunk[t]) * multiTensorChunkSize;
+    end = min(begin + multiTensorChunkSize, list.numElements[t]);
+    return t;
+}
+
+// The same updates as _adam, MomentumSGDUpdate() etc., after the gradient preprocessing of the learners.
+template <class ElemType>
+__global__ void _multiTensorUpdate(const MultiTensorList<ElemType> list, const MultiTensorUpdateType type,
+                                   const ElemType momentum, const ElemType varMomentum, const ElemType unitGainFactor)
+{
+    CUDA_LONG begin, end;
+    const int t = _multiTensorChunk(list, begin, end);
+    ElemType* val = list.value[t];
+    ElemType* grad = list.gradient[t];
+    ElemType* smoothed = list.smoothedGradient[t];
+    const ElemType lr = list.learnRatePerSample[t];
+    for (CUDA_LONG idx = begin + threadIdx.x; idx < end; idx += blockDim.x)
+    {
+        ElemType g = list.gradientScale[t] * grad[idx] + list.l2Weight[t] * val[idx];
+        grad[idx] = g;
+        if (type == MultiTensorUpdateType::SGD)
+        {
+            val[idx] -= lr * g;
+        }
+        else if (type == MultiTensorUpdateType::MomentumSGD)
+        {
+            ElemType sg = momentum * smoothed[idx] + unitGainFactor * lr * g;
+            smoothed[idx] = sg;
+            val[idx] -= sg;
+        }
+        else if (type == MultiTensorUpdateType::NesterovMomentumSGD)
+        {
+            ElemType sg = momentum * smoothed[idx] + unitGainFactor * lr * g;
+            smoothed[idx] = sg;
+            val[idx] -= momentum * sg + unitGainFactor * lr * g;
+        }
+        else // Adam, smoothed squares followed by the momentum
+        {
+            ElemType* smoothAda = smoothed;
+            ElemType* smoothMom = smoothed + list.numElements[t];
+            ElemType adaSqr = varMomentum * smoothAda[idx] + (1.0f - varMomentum) * g * g;
+            smoothAda[idx] = adaSqr;
+            ElemType w;
+            if (sizeof(ElemType) == sizeof(double))
+            {
+                w = list.adaMul[t] * rsqrt(adaSqr + 1e-8);
+            }
+            else
+            {
+                w = list.adaMul[t] * rsqrtf(adaSqr + 1e-8);
+            }
+
+            g = momentum * smoothMom[idx] + unitGainFactor * g;
+            smoothMom[idx] = g;
+            val[idx] -= lr * g * w;
+        }
+    }
+}
+
+// sum of the squares of the gradient elements of each chunk, accumulated in double, so that only Inf and NaN elements
+// make it non-finite
+template <class ElemType>
+__global__ void _multiTensorSumOfSquares(const MultiTensorList<ElemType> list, double* partialSums)
+{
+    __shared__ double sums[multiTensorThreadsPerBlock];
+    CUDA_LONG begin, end;
+    const int t = _multiTensorChunk(list, begin, end);
+    const ElemType* grad = list.gradient[t];
+    double sum = 0;
+    for (CUDA_LONG idx = begin + threadIdx.x; idx < end; idx += blockDim.x)
+    {
+        double g = grad[idx];
+        sum += g * g;
+    }
+    sums[threadIdx.x] = sum;
+    __syncthreads();
+
+    for (CUDA_LONG stride = blockDim.x / 2; stride > 0; stride /= 2)
+    {
+        if (threadIdx.x < stride)
+            sums[threadIdx.x] += sums[threadIdx.x + stride];
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+        partialSums[blockIdx.x] = sums[0];
+}
+
 template <class ElemType>
 __global__ void _adadelta(CUDA_LONG size, ElemType* grad, ElemType* smoothAda, ElemType* smoothX2, ElemType* val,
     ElemType learningRate, ElemType rho, ElemType epsilon)
@@ -982,11 +982,9 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromSBCFormat(const size_t* blockIds, c
     size_t nz = numBlocks * numRows;
     RequireSizeAndAllocate(numRows, numCols, nz, true, false);
 
-    static std::vector<GPUSPARSE_INDEX_TYPE> gpuBlockId2Col(numCols);
-    static std::vector<GPUSPARSE_INDEX_TYPE> gpuCol2BlockId(numCols);
-
-    std::fill(gpuBlockId2Col.begin(), gpuBlockId2Col.end(), Id_NotAssigned);
-    std::fill(gpuCol2BlockId.begin(), gpuCol2BlockId.end(), Id_NotAssigned);
+    // (not static: the matrices set from here, e.g. aggregated gradients, differ in their number of columns)
+    std::vector<GPUSPARSE_INDEX_TYPE> gpuBlockId2Col(numCols, Id_NotAssigned);
+    std::vector<GPUSPARSE_INDEX_TYPE> gpuCol2BlockId(numCols, Id_NotAssigned);
 
     #pragma omp parallel for
     for (int i = 0; i < numBlocks; ++i)
@@ -1079,7 +1077,33 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     c.PrepareDevice();
     if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC)
     {
-        ConvolveAndWeightedAdd(alpha, lhs, transposeA, rhs, transposeB, beta, c, 1, 1, false, false);
+        // Sparse inputs are mostly one-hot (words), with few nonzeros per column: the product gathers columns of lhs,
+        // and the gradient scatters them back, both without the index arithmetic of the convolution kernels.
+        SyncGuard syncGuard;
+        if (!transposeB)
+        {
+            CUDA_LONG N = (CUDA_LONG) m * n;
+            int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+            _denseMulSparseCSCGatherAndWeightedAdd<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                m, k, n, alpha, lhs.Data(), transposeA,
+                rhs.Buffer(), // Note that because of the offsets we use the array
+                rhs.RowLocation(), rhs.ColLocation(),
+                beta, c.Data());
+        }
+        else
+        {
+            if (beta == 0)
+                c.SetValue((ElemType) 0);
+            else if (beta != 1)
+                c *= beta;
+
+            CUDA_LONG N = (CUDA_LONG) m * k;
+            int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+            _denseMulSparseCSCTransposeScatterAdd<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                m, k, alpha, lhs.Data(), transposeA,
+                rhs.Buffer(), rhs.RowLocation(), rhs.ColLocation(),
+                c.Data());
+        }
     }
     else if (rhs.GetFormat() == matrixFormatSparseCSR)
     {
@@ -1426,6 +1450,35 @@ void GPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const GPUSpars
     }
 }
 
+template <class ElemType>
+GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::ElementMultiplyWith(const GPUMatrix<ElemType>& b)
+{
+    VerifyWritable(__FUNCTION__);
+
+    if (GetNumRows() != b.GetNumRows() || GetNumCols() != b.GetNumCols())
+        LogicError("ElementMultiplyWith: dimension mismatch");
+    if (GetComputeDeviceId() != b.GetComputeDeviceId())
+        RuntimeError("GPUSparseMatrix::ElementMultiplyWith: All matrices must be on the same GPU");
+    if (GetFormat() != matrixFormatSparseBlockCol && GetFormat() != matrixFormatSparseBlockRow)
+        NOT_IMPLEMENTED;
+
+    if (GetBlockSize() == 0)
+        return *this;
+
+    SyncGuard syncGuard;
+    LONG64 N = (LONG64) GetNumNZElements();
+    int blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+    _sparseBlockElementMultiplyWithDense<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(
+        GetFormat() == matrixFormatSparseBlockCol,
+        GetNumRows(),
+        GetNumCols(),
+        GetBlockSize(),
+        Data(),
+        BlockId2ColOrRow(),
+        b.Data());
+    return *this;
+}
+
 template <class ElemType>
 GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::InplaceTruncate(const ElemType threshold)
 {
@@ -1562,7 +1615,9 @@ void GPUSparseMatrix<ElemType>::FSAdagrad(
     ElemType momentum,
     ElemType adaWeight,
     ElemType adaMul,
-    bool unitGainMomentum)
+    bool unitGainMomentum,
+    bool lazy,
+    GPUMatrix<ElemType>* lazyUpdateSteps)
 {
     if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
     {
@@ -1580,6 +1635,22 @@ void GPUSparseMatrix<ElemType>::FSAdagrad(
     assert((c.GetNumRows() == GetNumRows()) && (c.GetNumCols() == numColsNeeded));
 
     size_t n = GetNumElements();
+    if (lazy)
+    {
+        ElemType* steps = AdvanceLazyUpdateSteps(lazyUpdateSteps);
+        let nz = NzCount();
+        if (nz > 0)
+        {
+            int blocksPerGrid = (nz + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+            _fsadagrad4BlockSparseColLazy<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(
+                nz, Data(), BlockId2ColOrRow(), GetNumRows(),
+                c.Data(), c.Data() + n, functionValues.Data(),
+                learnRatePerSample, momentum, adaWeight, adaMul, unitGainMomentum, steps, GetNumCols());
+        }
+        SetLazyUpdateSteps(steps);
+        return;
+    }
+
     int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
     _fsadagrad4BlockSparseCol<ElemType> << <blocksPerGrid, GridDim::maxThreadsPerBlock >> >(
         n, Data(), ColOrRow2BlockId(), GetNumRows(),
@@ -1595,7 +1666,9 @@ void GPUSparseMatrix<ElemType>::Adam(
     ElemType momentum,
     ElemType adaWeight,
     ElemType adaMul,
-    bool unitGainMomentum)
+    bool unitGainMomentum,
+    bool lazy,
+    GPUMatrix<ElemType>* lazyUpdateSteps)
 {
     if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
     {
@@ -1613,6 +1686,22 @@ void GPUSparseMatrix<ElemType>::Adam(
     assert((c.GetNumRows() == GetNumRows()) && (c.GetNumCols() == numColsNeeded));
 
     size_t n = GetNumElements();
+    if (lazy)
+    {
+        ElemType* steps = AdvanceLazyUpdateSteps(lazyUpdateSteps);
+        let nz = NzCount();
+        if (nz > 0)
+        {
+            int blocksPerGrid = (nz + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+            _adam4BlockSparseColLazy<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(
+                nz, Data(), BlockId2ColOrRow(), GetNumRows(),
+                c.Data(), c.Data() + n, functionValues.Data(),
+                learnRatePerSample, momentum, adaWeight, adaMul, unitGainMomentum, steps, GetNumCols());
+        }
+        SetLazyUpdateSteps(steps);
+        return;
+    }
+
     int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
     _adam4BlockSparseCol<ElemType> << <blocksPerGrid, GridDim::maxThreadsPerBlock >> >(
         n, Data(), ColOrRow2BlockId(), GetNumRows(),
@@ -1620,6 +1709,33 @@ void GPUSparseMatrix<ElemType>::Adam(
         learnRatePerSample, momentum, adaWeight, adaMul, unitGainMomentum);
 }
 
+template <class ElemType>
+ElemType* GPUSparseMatrix<ElemType>::AdvanceLazyUpdateSteps(GPUMatrix<ElemType>* lazyUpdateSteps) const
+{
+    if (!lazyUpdateSteps)
+        return nullptr;
+
+    if (lazyUpdateSteps->GetNumElements() != GetNumCols() + 1)
+    {
+        lazyUpdateSteps->RequireSize(1, GetNumCols() + 1);
+        lazyUpdateSteps->SetValue(0.0);
+    }
+    _advanceLazyUpdateSteps<ElemType><<<1, 1>>>(lazyUpdateSteps->Data(), GetNumCols());
+    return lazyUpdateSteps->Data();
+}
+
+// records the current update count for the columns present in the gradient, after the update has read their old counts
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetLazyUpdateSteps(ElemType* lazyUpdateSteps) const
+{
+    let numBlocks = GetBlockSize();
+    if (!lazyUpdateSteps || numBlocks == 0)
+        return;
+
+    int blocksPerGrid = (numBlocks + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    _setLazyUpdateSteps<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(lazyUpdateSteps, GetNumCols(), BlockId2ColOrRow(), (CUDA_LONG)numBlocks);
+}
+
 template <class ElemType>
 ElemType GPUSparseMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& c,
     ElemType RMS_GAMMA,
@@ -1966,6 +2082,11 @@ GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::AssignProductOf(const GPUS
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, ElemType beta, const GPUSparseMatrix<ElemType>& b, GPUSparseMatrix<ElemType>& c)
 {
+    if (a.GetFormat() == b.GetFormat() && (a.GetFormat() == matrixFormatSparseBlockCol || a.GetFormat() == matrixFormatSparseBlockRow))
+    {
+        ScaleAndAddSparseBlocks(alpha, a, beta, b, c);
+        return;
+    }
     if (a.GetFormat() != matrixFormatSparseCSR || b.GetFormat() != matrixFormatSparseCSR )
     {
         NOT_IMPLEMENTED;
@@ -2024,10 +2145,76 @@ void GPUSparseMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const GPUSparseMatri
     cusparseDestroy(cusparseHandle);
 }
 
+// c = alpha * a + beta * b of two block-sparse matrices of the same format, e.g. to add up the sparse gradients of a
+// shared parameter without going through a dense matrix. c gets a block for every column (row) that has one in a or b.
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::ScaleAndAddSparseBlocks(ElemType alpha, const GPUSparseMatrix<ElemType>& a, ElemType beta, const GPUSparseMatrix<ElemType>& b, GPUSparseMatrix<ElemType>& c)
+{
+    c.VerifyWritable(__FUNCTION__);
+
+    if (a.GetNumCols() != b.GetNumCols() || a.GetNumRows() != b.GetNumRows())
+        RuntimeError("Dimensions mismatch in ScaleAndAdd");
+    if (a.GetComputeDeviceId() != b.GetComputeDeviceId())
+        RuntimeError("ScaleAndAdd: matrices must be on the same device");
+
+    const bool blockCol = (a.GetFormat() == matrixFormatSparseBlockCol);
+    const size_t len = blockCol ? a.GetNumRows() : a.GetNumCols();
+    const size_t numColsOrRows = blockCol ? a.GetNumCols() : a.GetNumRows();
+
+    // the result is built aside, since c may be a or b
+    GPUSparseMatrix<ElemType> result(a.GetNumRows(), a.GetNumCols(), 0, a.GetComputeDeviceId(), a.GetFormat());
+    a.PrepareDevice();
+    SyncGuard syncGuard;
+    CUDA_CALL(cudaMemset(result.ColOrRow2BlockId(), Id_NotAssigned, sizeof(GPUSPARSE_INDEX_TYPE) * numColsOrRows));
+    CUDA_CALL(cudaMemset(result.BlockId2ColOrRow(), Id_NotAssigned, sizeof(GPUSPARSE_INDEX_TYPE) * numColsOrRows));
+
+    const GPUSparseMatrix<ElemType>* inputs[] = {&a, &b};
+    const ElemType scales[] = {alpha, beta};
+    for (const GPUSparseMatrix<ElemType>* input : inputs)
+    {
+        if (input->GetBlockSize() == 0)
+            continue;
+        int blocksPerGrid = (int) ceil(((double) input->GetBlockSize()) / GridDim::maxThreadsPerBlock);
+        _findBlocksWithValues<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+            input->BlockId2ColOrRow(), input->GetBlockSize(), result.ColOrRow2BlockId());
+    }
+
+    size_t* blockSize = TracingGPUMemoryAllocator::Allocate<size_t>(a.GetComputeDeviceId(), 1);
+    CUDA_CALL(cudaMemset(blockSize, 0, sizeof(size_t)));
+    int blocksPerGrid = (int) ceil(((double) numColsOrRows) / GridDim::maxThreadsPerBlock);
+    _determineBlockIds<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+        result.BlockId2ColOrRow(), result.ColOrRow2BlockId(), numColsOrRows, blockSize);
+
+    size_t numBlocks;
+    CUDA_CALL(cudaMemcpy(&numBlocks, blockSize, sizeof(size_t), cudaMemcpyDeviceToHost));
+    TracingGPUMemoryAllocator::Free<size_t>(a.GetComputeDeviceId(), blockSize);
+    result.SetBlockSize(numBlocks);
+
+    if (numBlocks > 0)
+    {
+        result.RequireSizeAndAllocate(a.GetNumRows(), a.GetNumCols(), len * numBlocks, true, true); // keeps the block ids
+        CUDA_CALL(cudaMemset(result.Data(), 0, sizeof(ElemType) * len * numBlocks));
+
+        // the blocks of one input go to different blocks of the result
+        for (int i = 0; i < 2; i++)
+        {
+            const GPUSparseMatrix<ElemType>& input = *inputs[i];
+            if (input.GetBlockSize() == 0 || scales[i] == 0)
+                continue;
+            CUDA_LONG N = (CUDA_LONG) input.GetNumNZElements();
+            blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+            _scaleSparseBlocksAndAdd<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                scales[i], input.Data(), input.BlockId2ColOrRow(), len, N, result.ColOrRow2BlockId(), result.Data());
+        }
+    }
+
+    c = std::move(result);
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, ElemType beta, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c)
 {
-    if (a.GetFormat() != matrixFormatSparseCSR)
+    if (a.GetFormat() != matrixFormatSparseCSR && a.GetFormat() != matrixFormatSparseBlockCol && a.GetFormat() != matrixFormatSparseBlockRow)
         NOT_IMPLEMENTED;
 
     if (a.GetNumRows() != b.GetNumRows() || a.GetNumRows() != c.GetNumRows() || a.GetNumCols() != b.GetNumCols() || a.GetNumCols() != c.GetNumCols())
@@ -2041,6 +2228,11 @@ void GPUSparseMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const GPUSparseMatri
     {
         c *= beta;
     }
+    if (a.GetFormat() != matrixFormatSparseCSR)
+    {
+        ScaleAndAdd(alpha, a, c);
+        return;
+    }
     SyncGuard syncGuard;
     CUDA_LONG M = (CUDA_LONG) a.GetNumRows();
     int blocksPerGrid = (int) ceil(1.0 * M / GridDim::maxThreadsPerBlock);
@@ -109,6 +109,8 @@ public:
             return SecondaryIndexValueAt(GetNumRows()) - SecondaryIndexValueAt(0);
         else if (GetFormat() == matrixFormatSparseBlockCol)
             return (int)(GetNumRows() * GetBlockSize());
+        else if (GetFormat() == matrixFormatSparseBlockRow)
+            return (int)(GetNumCols() * GetBlockSize());
         else
             NOT_IMPLEMENTED;
 
@@ -390,6 +392,9 @@ public:
 
     GPUSparseMatrix<ElemType>& SetToZeroIfAbsLessThan(const ElemType threshold);
 
+    // this .*= b for the values stored in the blocks of a block-sparse matrix; the pattern does not change
+    GPUSparseMatrix<ElemType>& ElementMultiplyWith(const GPUMatrix<ElemType>& b);
+
     GPUSparseMatrix<ElemType>& AssignOneHot(const GPUMatrix<ElemType>& a, vector<size_t>& shape, size_t axis);
 
     ElemType SumOfElements() const;    // sum of all elements
@@ -420,9 +425,11 @@ public:
 
     void NormalGrad(GPUMatrix<ElemType>& c, const ElemType momentum, bool unitGainMomentum = true);
     ElemType Adagrad(GPUMatrix<ElemType>& c, const bool needAveMultiplier);
-    void FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum);
+    void FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+                   bool lazy, GPUMatrix<ElemType>* lazyUpdateSteps);
     ElemType RmsProp(GPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
-    void Adam(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum);
+    void Adam(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+              bool lazy, GPUMatrix<ElemType>* lazyUpdateSteps);
     void AdaDelta(GPUMatrix<ElemType>&c, GPUMatrix<ElemType>&functionValues, ElemType learningRate, ElemType rho, ElemType epsilon);
 
     static void Multiply(const GPUSparseMatrix<ElemType>& S, const GPUMatrix<ElemType>& D, GPUMatrix<ElemType>& C);
@@ -461,6 +468,10 @@ private:
 private:
     void ZeroInit(const MatrixFormat matrixFormat, const DEVICEID_TYPE deviceId);
 
+    // the state of the decay catch-up of a lazy update (LazyUpdateStepPeriod), advanced to the next update; nullptr if none
+    ElemType* AdvanceLazyUpdateSteps(GPUMatrix<ElemType>* lazyUpdateSteps) const;
+    void SetLazyUpdateSteps(ElemType* lazyUpdateSteps) const;
+
 private:
     void performElementWiseFunction(const ElementWiseOperator kind, const GPUSparseMatrix<ElemType>& src);
     void DeepCopy(const GPUSparseMatrix<ElemType>& deepCopyFrom);
@@ -470,6 +481,8 @@ private:
     size_t ElemCountFromBufferSize() const;
     DEVICEID_TYPE PrepareDevice(const DEVICEID_TYPE deviceId = -1) const;
     size_t IdentifyRowsWithValues() const;
+
+    static void ScaleAndAddSparseBlocks(ElemType alpha, const GPUSparseMatrix<ElemType>& a, ElemType beta, const GPUSparseMatrix<ElemType>& b, GPUSparseMatrix<ElemType>& c);
 };
 
 }}}
@@ -63,6 +63,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // Template specializations exist in order to:
 //  - terminate recursion
 //  - optimize for thread-parallel reduction where elements are consecutive in memory
+//    (reductions over a single dimension also have kernels specialized for their layout, see LaunchShapeSpecializedReduction())
 //
 // The general algorithm is very straight forward:
 //
@@ -865,6 +866,295 @@ static shared_ptr<ElemType> GetReductionBuffer(size_t N)
     return reductionBuffersCache[deviceId];
 }
 
+// -----------------------------------------------------------------------
+// kernels and launch  --reduction specialized for the memory layout
+// -----------------------------------------------------------------------
+
+// Most reductions are over a single (flattened) dimension into at most one (flattened) output dimension:
+//  - contiguous-inner: each output element reduces over consecutive inputs, e.g. ReduceElements over the first axis,
+//    or a full reduction (no output dimension), e.g. the summation of a criterion value.
+//    A warp (short rows) or a block (long rows) takes each output element, so that the reads coalesce,
+//    and the threads combine their values with warp shuffles.
+//  - contiguous-outer: consecutive output elements reduce over inputs that are consecutive, e.g. the bias gradient,
+//    summing a [10000 x bigBatch] gradient over its columns. The threads of a warp take 32 consecutive output elements,
+//    and the rows of threads of a block take different columns, which are then combined in shared memory.
+// If that leaves multiprocs idle, the reduction is split into chunks, each computed by a separate block into a buffer,
+// and a second launch reduces the chunks. Unlike atomicAdd(), this gives the same result in every run.
+
+static const CUDA_LONG reductionBlockSize         = 256; // threads per block of the kernels below
+static const CUDA_LONG reductionColumnThreadsY    = 8;   // rows of threads for the contiguous-outer kernel (a power of 2)
+static const CUDA_LONG minReductionPerThread      = 8;   // splitting the reduction into chunks leaves each thread at least that many inputs
+
+// exchange a value within a warp (the _sync variant is required from CUDA 9 on)
+static __device__ int ShuffleDown(int value, int delta)
+{
+#if CUDA_VERSION >= 9000
+    return __shfl_down_sync(0xffffffff, value, delta);
+#else
+    return __shfl_down(value, delta);
+#endif
+}
+
+static __device__ float ShuffleDown(float value, int delta)
+{
+    return __int_as_float(ShuffleDown(__float_as_int(value), delta));
+}
+
+static __device__ double ShuffleDown(double value, int delta)
+{
+    return __hiloint2double(ShuffleDown(__double2hiint(value), delta), ShuffleDown(__double2loint(value), delta));
+}
+
+// aggregate the values of all threads of a warp; the result is valid in lane 0
+template <class ElemType>
+static __device__ ElemType WarpReduce(ElemType aggregate, ElementWiseOperator reductionOp)
+{
+    for (int delta = warpSize / 2; delta > 0; delta /= 2)
+        Aggregate<ElemType, ElemType>(aggregate, ShuffleDown(aggregate, delta), reductionOp);
+    return aggregate;
+}
+
+// compute op() for output element 'id' and reduction index 'redId'
+template <class ElemType, C_size_t N>
+static __device__ ElemType TensorOpReducedElement(FixedArray<ElemType*, N> pointers, ElementWiseOperator op,
+                                                  const FixedArray<C_int, N>& regularStrides, const FixedArray<C_int, N>& reducingStrides,
+                                                  CUDA_LONG id, CUDA_LONG redId)
+{
+    #pragma unroll
+    for (C_size_t i = 0; i < N - 1; i++) // N-1 because output is not used here
+        pointers[i] += id * regularStrides[i] + redId * reducingStrides[i];
+    return TensorOps<ElemType>::Compute(pointers, op);
+}
+
+template <class ElemType>
+static __device__ void StoreReducedValue(ElemType* pout, ElemType val, ElemType alpha, ElemType beta)
+{
+    val *= alpha;
+    if (beta != 0) // (skip memory access if not needed, and allow for ignoring NaNs)
+        val += beta * *pout;
+    *pout = val;
+}
+
+// contiguous-inner: each row of threads (threadIdx.x; a multiple of the warp size) reduces one chunk of one output element.
+// Block dims are X = output elements (blockDim.y per block), Y = chunks of the reduction.
+// Output element 'id' of chunk 'blockIdx.y' is written to pointers[N-1] + id * regularStrides[N-1] + blockIdx.y * chunkOutputStride.
+template <class ElemType, C_size_t N>
+__global__ void _launchTensorOpReduceRows(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                          FixedArray<C_int, N> regularStrides, FixedArray<C_int, N> reducingStrides, CUDA_LONG numElements,
+                                          CUDA_LONG reductionDim, CUDA_LONG reductionChunkSize, CUDA_LONG chunkOutputStride)
+{
+    CUDA_LONG id = blockIdx.x * blockDim.y + threadIdx.y;
+    CUDA_LONG reductionBegin = reductionChunkSize * blockIdx.y;
+    CUDA_LONG reductionEnd = min(reductionBegin + reductionChunkSize, reductionDim);
+
+    ReduceElemType aggregate = AggregateNeutralValue<ReduceElemType>(reductionOp);
+    if (id < numElements) // note: all threads must get to the __syncthreads() below
+    {
+        for (CUDA_LONG redId = reductionBegin + threadIdx.x; redId < reductionEnd; redId += blockDim.x)
+            Aggregate<ReduceElemType, ElemType>(aggregate, TensorOpReducedElement<ElemType, N>(pointers, op, regularStrides, reducingStrides, id, redId), reductionOp);
+    }
+    aggregate = WarpReduce<ReduceElemType>(aggregate, reductionOp);
+
+    // rows longer than a warp: combine the warps through shared memory
+    if (blockDim.x > warpSize) // (same for all threads of the block)
+    {
+        __shared__ ReduceElemType warpAggregates[GridDim::maxThreadsPerBlock / 32];
+        CUDA_LONG lane = threadIdx.x % warpSize;
+        CUDA_LONG warpsPerRow = blockDim.x / warpSize;
+        if (lane == 0)
+            warpAggregates[threadIdx.y * warpsPerRow + threadIdx.x / warpSize] = aggregate;
+        __syncthreads();
+        if (threadIdx.x < warpSize) // the first warp of each row
+        {
+            aggregate = lane < warpsPerRow ? warpAggregates[threadIdx.y * warpsPerRow + lane] : AggregateNeutralValue<ReduceElemType>(reductionOp);
+            aggregate = WarpReduce<ReduceElemType>(aggregate, reductionOp);
+        }
+    }
+
+    if (threadIdx.x == 0 && id < numElements)
+        StoreReducedValue<ElemType>(pointers[N - 1] + id * regularStrides[N - 1] + blockIdx.y * chunkOutputStride, (ElemType) aggregate, alpha, beta);
+}
+
+// contiguous-outer: each column of threads (threadIdx.y) reduces one chunk of one output element.
+// Block dims are X = output elements (blockDim.x per block), Y = chunks of the reduction.
+template <class ElemType, C_size_t N>
+__global__ void _launchTensorOpReduceColumns(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                             FixedArray<C_int, N> regularStrides, FixedArray<C_int, N> reducingStrides, CUDA_LONG numElements,
+                                             CUDA_LONG reductionDim, CUDA_LONG reductionChunkSize, CUDA_LONG chunkOutputStride)
+{
+    CUDA_LONG id = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG reductionBegin = reductionChunkSize * blockIdx.y;
+    CUDA_LONG reductionEnd = min(reductionBegin + reductionChunkSize, reductionDim);
+
+    ReduceElemType aggregate = AggregateNeutralValue<ReduceElemType>(reductionOp);
+    if (id < numElements) // note: all threads must get to the __syncthreads() below
+    {
+        for (CUDA_LONG redId = reductionBegin + threadIdx.y; redId < reductionEnd; redId += blockDim.y)
+            Aggregate<ReduceElemType, ElemType>(aggregate, TensorOpReducedElement<ElemType, N>(pointers, op, regularStrides, reducingStrides, id, redId), reductionOp);
+    }
+
+    // combine the rows of threads
+    __shared__ ReduceElemType accumulators[GridDim::maxThreadsPerBlock];
+    CUDA_LONG tid = threadIdx.y * blockDim.x + threadIdx.x;
+    accumulators[tid] = aggregate;
+    __syncthreads();
+    for (CUDA_LONG i = blockDim.y / 2; i > 0; i >>= 1)
+    {
+        if (threadIdx.y < i)
+            Aggregate<ReduceElemType, ReduceElemType>(accumulators[tid], accumulators[tid + i * blockDim.x], reductionOp);
+        __syncthreads();
+    }
+
+    if (threadIdx.y == 0 && id < numElements)
+        StoreReducedValue<ElemType>(pointers[N - 1] + id * regularStrides[N - 1] + blockIdx.y * chunkOutputStride, (ElemType) accumulators[threadIdx.x], alpha, beta);
+}
+
+// helper function to provide a buffer for the chunks of split reductions
+// Unlike GetReductionBuffer(), its size depends on the tensor shapes, so the cached buffer grows as needed.
+template <class ElemType>
+static shared_ptr<ElemType> GetReductionChunksBuffer(size_t N)
+{
+    if (t_stream != 0) // we cache for the NULL stream only, like GetReductionBuffer()
+        return AllocateReductionBuffer<ElemType>(N);
+
+    static std::mutex cacheMutex;
+    static shared_ptr<ElemType> chunksBuffersCache[32];
+    static size_t chunksBuffersCacheSize[_countof(chunksBuffersCache)] = { 0 };
+    let deviceId = GridDim::GetCurrentDeviceId();
+    if (deviceId >= _countof(chunksBuffersCache)) // index check w.r.t. our hard-coded dimensions
+        return AllocateReductionBuffer<ElemType>(N); // out of bounds: don't cache
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (N > chunksBuffersCacheSize[deviceId]) // (a replaced buffer is freed when its last launch returns it; cudaFree() waits for the device)
+    {
+        chunksBuffersCache[deviceId] = AllocateReductionBuffer<ElemType>(N);
+        chunksBuffersCacheSize[deviceId] = N;
+    }
+    return chunksBuffersCache[deviceId];
+}
+
+// number of chunks to split a reduction into, such that 'numBlocks' blocks per chunk fill the GPU
+static CUDA_LONG NumReductionChunks(CUDA_LONG numBlocks, CUDA_LONG reductionDim, CUDA_LONG threadsPerOutputElement)
+{
+    let& props = GridDim::GetDeviceProps();
+    let numResidentBlocks = props.multiProcessorCount * max(props.maxThreadsPerMultiProcessor / (int) reductionBlockSize, 1);
+    if (numBlocks >= numResidentBlocks)
+        return 1;
+    return max(min(numResidentBlocks / numBlocks, CeilDiv(reductionDim, threadsPerOutputElement * minReductionPerThread)), (CUDA_LONG) 1);
+}
+
+template <class ElemType, C_size_t N>
+static void LaunchTensorOpReduceRows(ElemType beta, const FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                     const FixedArray<C_int, N>& regularStrides, const FixedArray<C_int, N>& reducingStrides, CUDA_LONG NN, CUDA_LONG reductionDim,
+                                     bool allowChunks)
+{
+    // short rows get a warp each, long ones a block
+    let& props = GridDim::GetDeviceProps();
+    let numThreadsX = reductionDim <= 4 * props.warpSize ? (CUDA_LONG) props.warpSize : reductionBlockSize;
+    let numThreadsY = reductionBlockSize / numThreadsX;
+    let numBlocksX = CeilDiv(NN, numThreadsY);
+    let numChunks = allowChunks ? NumReductionChunks(numBlocksX, reductionDim, numThreadsX) : 1;
+    let reductionChunkSize = CeilDiv(reductionDim, numChunks);
+    if (numChunks == 1)
+    {
+        _launchTensorOpReduceRows<ElemType, N><<<dim3(numBlocksX, 1), dim3(numThreadsX, numThreadsY), 0, t_stream>>>(
+            beta, pointers, alpha, op, reductionOp, regularStrides, reducingStrides, NN, reductionDim, reductionChunkSize, /*chunkOutputStride=*/0);
+        return;
+    }
+
+    // first pass: the chunks of each output element go next to each other into a buffer of dimension [numChunks x NN]
+    shared_ptr<ElemType> chunksBuffer = GetReductionChunksBuffer<ElemType>(NN * numChunks);
+    FixedArray<ElemType*, N> pointers1 = pointers;
+    pointers1[N - 1] = chunksBuffer.get();
+    FixedArray<C_int, N> regularStrides1 = regularStrides;
+    regularStrides1[N - 1] = numChunks;
+    _launchTensorOpReduceRows<ElemType, N><<<dim3(numBlocksX, numChunks), dim3(numThreadsX, numThreadsY), 0, t_stream>>>(
+        /*beta=*/0, pointers1, /*alpha=*/1, op, reductionOp, regularStrides1, reducingStrides, NN, reductionDim, reductionChunkSize, /*chunkOutputStride=*/1);
+
+    // second pass: reduce the chunks, which are again contiguous-inner, into the output
+    FixedArray<ElemType*, 2> pointers2(array<ElemType*, 2>{ chunksBuffer.get(), pointers[N - 1] });
+    FixedArray<C_int, 2> regularStrides2(array<C_int, 2>{ (C_int) numChunks, regularStrides[N - 1] });
+    FixedArray<C_int, 2> reducingStrides2(array<C_int, 2>{ 1, 0 });
+    LaunchTensorOpReduceRows<ElemType, 2>(beta, pointers2, alpha, ElementWiseOperator::opCopy, reductionOp, regularStrides2, reducingStrides2, NN, numChunks, /*allowChunks=*/false);
+}
+
+template <class ElemType, C_size_t N>
+static void LaunchTensorOpReduceColumns(ElemType beta, const FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                        const FixedArray<C_int, N>& regularStrides, const FixedArray<C_int, N>& reducingStrides, CUDA_LONG NN, CUDA_LONG reductionDim,
+                                        bool allowChunks)
+{
+    let numThreadsY = reductionColumnThreadsY;
+    let numThreadsX = reductionBlockSize / numThreadsY;
+    let numBlocksX = CeilDiv(NN, numThreadsX);
+    let numChunks = allowChunks ? NumReductionChunks(numBlocksX, reductionDim, numThreadsY) : 1;
+    let reductionChunkSize = CeilDiv(reductionDim, numChunks);
+    if (numChunks == 1)
+    {
+        _launchTensorOpReduceColumns<ElemType, N><<<dim3(numBlocksX, 1), dim3(numThreadsX, numThreadsY), 0, t_stream>>>(
+            beta, pointers, alpha, op, reductionOp, regularStrides, reducingStrides, NN, reductionDim, reductionChunkSize, /*chunkOutputStride=*/0);
+        return;
+    }
+
+    // first pass: each chunk goes into a dense row of a buffer of dimension [NN x numChunks]
+    shared_ptr<ElemType> chunksBuffer = GetReductionChunksBuffer<ElemType>(NN * numChunks);
+    FixedArray<ElemType*, N> pointers1 = pointers;
+    pointers1[N - 1] = chunksBuffer.get();
+    FixedArray<C_int, N> regularStrides1 = regularStrides;
+    regularStrides1[N - 1] = 1;
+    _launchTensorOpReduceColumns<ElemType, N><<<dim3(numBlocksX, numChunks), dim3(numThreadsX, numThreadsY), 0, t_stream>>>(
+        /*beta=*/0, pointers1, /*alpha=*/1, op, reductionOp, regularStrides1, reducingStrides, NN, reductionDim, reductionChunkSize, /*chunkOutputStride=*/NN);
+
+    // second pass: reduce the chunks, which are again contiguous-outer, into the output
+    FixedArray<ElemType*, 2> pointers2(array<ElemType*, 2>{ chunksBuffer.get(), pointers[N - 1] });
+    FixedArray<C_int, 2> regularStrides2(array<C_int, 2>{ 1, regularStrides[N - 1] });
+    FixedArray<C_int, 2> reducingStrides2(array<C_int, 2>{ (C_int) NN, 0 });
+    LaunchTensorOpReduceColumns<ElemType, 2>(beta, pointers2, alpha, ElementWiseOperator::opCopy, reductionOp, regularStrides2, reducingStrides2, NN, numChunks, /*allowChunks=*/false);
+}
+
+// Launch one of the kernels above if the reduction has one of their layouts (after flattening, at most one output and
+// exactly one reduction dimension). Returns false otherwise, leaving it to the generic kernels.
+template <class ElemType, C_size_t N>
+static bool LaunchShapeSpecializedReduction(ElemType beta, const array<ElemType*, N>& pointerVector, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors,
+                                            const SmallVector<size_t>& reducingOpDimVector, const array<SmallVector<ptrdiff_t>, N>& reducingStrideVectors)
+{
+    if (regularOpDims.size() > 1 || reducingOpDimVector.size() != 1)
+        return false;
+    let NN = regularOpDims.empty() ? (CUDA_LONG) 1 : (CUDA_LONG) regularOpDims[0];
+    let reductionDim = (CUDA_LONG) reducingOpDimVector[0];
+
+    // strides of each argument along the output and the reduction dimension
+    // Inputs may be broadcast along either (stride 0).
+    array<ptrdiff_t, N> regularStrideArray, reducingStrideArray;
+    bool isInnerContiguous = false, isOuterContiguous = false;
+    bool isInnerBroken = false, isOuterBroken = false;
+    for (C_size_t i = 0; i < N; i++)
+    {
+        regularStrideArray[i] = regularOpDims.empty() ? 0 : regularStrideVectors[i][0];
+        reducingStrideArray[i] = reducingStrideVectors[i][0];
+        if (i == N - 1) // output
+            break;
+        isInnerContiguous |= reducingStrideArray[i] == 1;
+        isInnerBroken     |= reducingStrideArray[i] != 0 && reducingStrideArray[i] != 1;
+        isOuterContiguous |= regularStrideArray[i] == 1;
+        isOuterBroken     |= regularStrideArray[i] != 0 && regularStrideArray[i] != 1;
+    }
+    isInnerContiguous &= !isInnerBroken;
+    isOuterContiguous &= !isOuterBroken && regularStrideArray[N - 1] == 1;
+
+    let& props = GridDim::GetDeviceProps();
+    FixedArray<ElemType*, N> pointers(pointerVector);
+    FixedArray<C_int, N> regularStrides(regularStrideArray);
+    FixedArray<C_int, N> reducingStrides(reducingStrideArray);
+    if (isInnerContiguous && reductionDim >= props.warpSize)
+        LaunchTensorOpReduceRows<ElemType, N>(beta, pointers, alpha, op, reductionOp, regularStrides, reducingStrides, NN, reductionDim, /*allowChunks=*/true);
+    else if (isOuterContiguous && NN >= props.warpSize && reductionDim >= reductionColumnThreadsY * minReductionPerThread) // (short columns: one thread per output element, as below, reads coalesced already)
+        LaunchTensorOpReduceColumns<ElemType, N>(beta, pointers, alpha, op, reductionOp, regularStrides, reducingStrides, NN, reductionDim, /*allowChunks=*/true);
+    else
+        return false;
+    return true;
+}
+
 // All dimensions (N-ariness, number of input dimensions K and number of reduction dimensions M) are bound to template parameters now.
 template <class ElemType, C_size_t N, C_int M, C_int K>
 static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> pointerVector, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
@@ -922,6 +1212,7 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
     GridDim grid(NN);
     let& props = GridDim::GetDeviceProps();
     bool disableParallelReduction = false;                       // (for debugging)
+    bool disableShapeSpecializedReduction = false;               // (for debugging)
 
     // === arg based reduction, one thread per output element
     if ((reductionOp == ElementWiseOperator::opArgmax) ||
@@ -933,6 +1224,15 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
             reducingOpDims, reducingStrides,
             regularOpStrideDivmod, reducingOpDimDivmod);
     }
+    // === reductions over consecutive inputs, or into consecutive outputs: kernels specialized for the layout
+    else if (reductionDim * numElements > 2 * props.warpSize && // (trivial operation, as below)
+             !disableShapeSpecializedReduction &&
+             LaunchShapeSpecializedReduction<ElemType, N>(beta, pointerVector, alpha, op, reductionOp,
+                                                          regularOpDims, regularStrideVectors,
+                                                          reducingOpDimVector, reducingStrideVectors))
+    {
+        // (launched)
+    }
     // === simple case: NN large, one thread per output element
     else if (reductionDim == 1 ||                                     // no reduction
              grid.m_blocksPerGrid >= props.multiProcessorCount ||     // enough output elements to fill all multiprocs
@@ -1168,6 +1468,100 @@ void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemTy
     }
 }
 
+// -----------------------------------------------------------------------
+// kernel and launch  --ElementwiseProgram (several elementwise ops in one pass, no reduction)
+// -----------------------------------------------------------------------
+
+static const C_size_t c_numProgramOperands = ElementwiseProgram::MaxInputs + 1; // (counting the output)
+
+template <class ElemType, C_int K>
+__global__ void _launchTensorProgramOp(ElemType beta, FixedArray<ElemType*, c_numProgramOperands> pointers, ElemType alpha, ElementwiseProgram program,
+                                       FixedMatrix<C_int, c_numProgramOperands, K> regularStrides, CUDA_LONG numElements,
+                                       FixedArray<fast_divmod, K> regularOpStrideDivmod)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numElements)
+        return;
+    // map id (location on grid) to index[k], and apply it to the pointers
+    #pragma unroll
+    for (C_int k = K - 1; k >= 0; k--)
+    {
+        C_size_t index = id;
+        if (k > 0)
+            regularOpStrideDivmod[k].divmod(id, index, id);
+        #pragma unroll
+        for (C_size_t i = 0; i < c_numProgramOperands; i++)
+            pointers[i] += index * regularStrides(i, (C_size_t) k);
+    }
+    // run the program on this element
+    ElemType registers[ElementwiseProgram::MaxRegisters];
+    for (C_size_t i = 0; i < program.m_numInputs; i++)
+        registers[i] = *pointers[i];
+    ElemType val = EvaluateElementwiseProgram(program, registers);
+    val *= alpha;
+    auto* pout = pointers[c_numProgramOperands - 1];
+    if (beta != 0) // (skip memory access if not needed, and allow for ignoring NaNs)
+        val += beta * *pout;
+    *pout = val;
+}
+
+template <class ElemType, C_int K>
+static void LaunchTensorProgramOp(ElemType beta, const array<ElemType*, c_numProgramOperands>& pointerVector, ElemType alpha, const ElementwiseProgram& program,
+                                  const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, c_numProgramOperands>& regularStrideVectors)
+{
+    // copy all parameters to CUDA-compatible data structures
+    FixedArray<ElemType*, c_numProgramOperands> pointers(pointerVector);
+    C_size_t numElements = 1;
+    SmallVector<fast_divmod> regularOpStrideDivmodVector;
+    for (C_size_t k = 0; k < regularOpDims.size(); k++)
+    {
+        regularOpStrideDivmodVector.push_back(fast_divmod(numElements));
+        numElements *= (C_size_t) regularOpDims[k];
+    }
+    FixedMatrix<C_int, c_numProgramOperands, K> regularStrides(regularStrideVectors);
+    FixedArray<fast_divmod, K> regularOpStrideDivmod(regularOpStrideDivmodVector);
+
+    // launch the kernel
+    CUDA_LONG NN = (CUDA_LONG) numElements;
+    SyncGuard syncGuard;
+    GridDim grid(NN);
+    _launchTensorProgramOp<ElemType, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, program, regularStrides, grid.m_N, regularOpStrideDivmod);
+}
+
+// ElementwiseProgram operation
+// This expands into different k and eliminates the offsets by adding them to the pointers.
+template <class ElemType>
+void TensorProgramOpN(ElemType beta, array<ElemType*, ElementwiseProgram::MaxInputs + 1> pointers, ElemType alpha, const ElementwiseProgram& program,
+                      const array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                      const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides)
+{
+    for (C_size_t i = 0; i < c_numProgramOperands; i++)
+        pointers[i] += offsets[i];
+    size_t dims = regularOpDims.size();
+    switch (dims)
+    {
+    case 4:
+        return LaunchTensorProgramOp<ElemType, 4>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 3:
+        return LaunchTensorProgramOp<ElemType, 3>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 2:
+        return LaunchTensorProgramOp<ElemType, 2>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 1:
+        return LaunchTensorProgramOp<ElemType, 1>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 0: // scalar: launch as a single element along one dimension
+    {
+        SmallVector<size_t> scalarOpDims;
+        scalarOpDims.push_back(1);
+        array<SmallVector<ptrdiff_t>, c_numProgramOperands> scalarStrides;
+        for (auto& strides : scalarStrides)
+            strides.push_back(0);
+        return LaunchTensorProgramOp<ElemType, 1>(beta, pointers, alpha, program, scalarOpDims, scalarStrides);
+    }
+    default:
+        LogicError("TensorProgramOp: %d non-flattened input dimensions are not supported.", (C_int) dims);
+    }
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
@@ -1249,6 +1643,13 @@ template void TensorOpN<double, 4>(double beta, array<double*, 4> pointers, doub
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
 
+template void TensorProgramOpN<float>(float beta, array<float*, ElementwiseProgram::MaxInputs + 1> pointers, float alpha, const ElementwiseProgram& program,
+                                      const array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                                      const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides);
+template void TensorProgramOpN<double>(double beta, array<double*, ElementwiseProgram::MaxInputs + 1> pointers, double alpha, const ElementwiseProgram& program,
+                                       const array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                                       const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides);
+
 template void LaunchUnaryTensorOp(float beta, const float* pa, float* pb, float alpha, ElementWiseOperator op, size_t regularOpDim);
 template void LaunchUnaryTensorOp(double beta, const double* pa, double* pb, double alpha, ElementWiseOperator op, size_t regularOpDim);
 
@@ -11,7 +11,7 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// GPUMatrix::TensorOp() interfaces with actual tensor code through these two functions, which are independent of the GPUMatrix class
+// GPUMatrix::TensorOp() interfaces with actual tensor code through these functions, which are independent of the GPUMatrix class
 
 #define C_size_t CUDA_LONG
 #define C_int CUDA_LONG
@@ -23,6 +23,11 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides);
 
+template <class ElemType>
+void TensorProgramOpN(ElemType beta, array<ElemType*, ElementwiseProgram::MaxInputs + 1> pointers, ElemType alpha, const ElementwiseProgram& program,
+                      const array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                      const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides);
+
 template <class ElemType>
 void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha, ElementWiseOperator op, size_t regularOpDim);
 
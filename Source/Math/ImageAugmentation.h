@@ -0,0 +1,135 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ImageAugmentation.h -- random augmentation of 8 bit images on the device, usable from host and CUDA code.
+//
+// Readers with a DeviceAugment transform ship the images as bytes, and the ReaderShim expands them into the input
+// of the network with Matrix::AssignAugmentedImagesOf() instead of running Crop, Scale, Color and Mean transforms
+// with OpenCV on the reader threads. Each image, a column of bytes, is
+//  - cropped to a square of a random fraction of its shorter side, at a random or the center position,
+//  - scaled to the output size by bilinear interpolation, which is fused with the crop,
+//  - flipped horizontally with probability 1/2,
+//  - jittered in brightness, contrast and saturation as by the ColorTransformer,
+//  - and normalized to (x - mean) * scale.
+// The random parameters of image n are the Philox uniforms (seed, n * NumRandomsPerImage + k), so they are the same
+// on the CPU and the GPU and do not depend on the minibatch boundaries.
+//
+
+#pragma once
+
+#include "Philox.h"
+#include <cstdint>
+#include <cmath>
+
+#ifdef __CUDACC__
+#define IMAGEAUGMENTATION_DECL __host__ __device__ inline
+#else
+#define IMAGEAUGMENTATION_DECL inline
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// the augmentation of the images of a stream; trivially copyable so that it can be passed to CUDA kernels by value
+struct ImageAugmentation
+{
+    static const int NumRandomsPerImage = 8;
+    static const int MaxChannels = 4;
+
+    int inW, inH, channels;
+    int outW, outH;
+    bool channelsInnermost;           // the layout is [C x W x H] (HWC) instead of [W x H x C] (CHW)
+    float sideRatioMin, sideRatioMax; // the side of the crop as a fraction of the shorter side
+    bool randomPosition;              // otherwise the crop is centered
+    bool hFlip;
+    float brightnessRadius, contrastRadius, saturationRadius;
+    float mean, scale;
+    uint64_t seed;
+};
+
+// the random parameters of one image
+struct ImageAugmentationSample
+{
+    float cropX, cropY, cropSide;
+    bool flip;
+    float brightness; // fraction of the mean of the image added to each element
+    float contrast;   // factor of each element
+    float saturation; // factor of the saturation in HSV
+};
+
+IMAGEAUGMENTATION_DECL ImageAugmentationSample DrawImageAugmentationSample(const ImageAugmentation& a, uint64_t image)
+{
+    const uint64_t index = image * ImageAugmentation::NumRandomsPerImage;
+    ImageAugmentationSample s;
+    const float sideRatio = a.sideRatioMin + PhiloxUniform(a.seed, index) * (a.sideRatioMax - a.sideRatioMin);
+    s.cropSide = sideRatio * (a.inW < a.inH ? a.inW : a.inH);
+    const float xPosition = a.randomPosition ? PhiloxUniform(a.seed, index + 1) : 0.5f;
+    const float yPosition = a.randomPosition ? PhiloxUniform(a.seed, index + 2) : 0.5f;
+    s.cropX = xPosition * (a.inW - s.cropSide);
+    s.cropY = yPosition * (a.inH - s.cropSide);
+    s.flip = a.hFlip && PhiloxUniform(a.seed, index + 3) < 0.5f;
+    s.brightness = (2 * PhiloxUniform(a.seed, index + 4) - 1) * a.brightnessRadius;
+    s.contrast = 1 + (2 * PhiloxUniform(a.seed, index + 5) - 1) * a.contrastRadius;
+    s.saturation = 1 + (2 * PhiloxUniform(a.seed, index + 6) - 1) * a.saturationRadius;
+    return s;
+}
+
+// offset of element (x, y, c) of an image of w x h
+IMAGEAUGMENTATION_DECL int ImageElementOffset(const ImageAugmentation& a, int w, int h, int x, int y, int c)
+{
+    return a.channelsInnermost ? c + a.channels * (x + w * y) : x + w * (y + h * c);
+}
+
+// the channels of output pixel (x, y) after crop, scale and flip, from the bytes of the input image
+IMAGEAUGMENTATION_DECL void SampleAugmentedPixel(const ImageAugmentation& a, const ImageAugmentationSample& s, const unsigned char* image, int x, int y, float* v)
+{
+    if (s.flip)
+        x = a.outW - 1 - x;
+    // pixel centers are at + 0.5, as in OpenCV's INTER_LINEAR
+    float sx = s.cropX + (x + 0.5f) * s.cropSide / a.outW - 0.5f;
+    float sy = s.cropY + (y + 0.5f) * s.cropSide / a.outH - 0.5f;
+    sx = sx < 0 ? 0 : (sx > a.inW - 1 ? a.inW - 1 : sx);
+    sy = sy < 0 ? 0 : (sy > a.inH - 1 ? a.inH - 1 : sy);
+    const int x0 = (int)sx, y0 = (int)sy;
+    const int x1 = x0 + 1 < a.inW ? x0 + 1 : x0;
+    const int y1 = y0 + 1 < a.inH ? y0 + 1 : y0;
+    const float fx = sx - x0, fy = sy - y0;
+    for (int c = 0; c < a.channels; c++)
+    {
+        const float top = image[ImageElementOffset(a, a.inW, a.inH, x0, y0, c)] * (1 - fx) + image[ImageElementOffset(a, a.inW, a.inH, x1, y0, c)] * fx;
+        const float bottom = image[ImageElementOffset(a, a.inW, a.inH, x0, y1, c)] * (1 - fx) + image[ImageElementOffset(a, a.inW, a.inH, x1, y1, c)] * fx;
+        v[c] = top * (1 - fy) + bottom * fy;
+    }
+}
+
+// the color jitter and the normalization of the channels of one pixel; imageMean is that of all elements of the
+// cropped and scaled image, for the brightness
+IMAGEAUGMENTATION_DECL void JitterAndNormalizePixel(const ImageAugmentation& a, const ImageAugmentationSample& s, float imageMean, float* v)
+{
+    if (a.brightnessRadius > 0 || a.contrastRadius > 0)
+    {
+        const float beta = s.brightness * imageMean;
+        for (int c = 0; c < a.channels; c++)
+        {
+            const float x = v[c] * s.contrast + beta;
+            v[c] = x < 0 ? 0 : (x > 255 ? 255 : x);
+        }
+    }
+    if (a.saturationRadius > 0 && a.channels == 3)
+    {
+        // Scaling S in HSV keeps H and V, and scales the distance of each channel from V = max: c' = V - (V - c) r,
+        // with r limited so that S' = S r <= 1.
+        const float maxV = fmaxf(v[0], fmaxf(v[1], v[2]));
+        const float minV = fminf(v[0], fminf(v[1], v[2]));
+        if (maxV > minV)
+        {
+            const float r = fminf(s.saturation, maxV / (maxV - minV));
+            for (int c = 0; c < 3; c++)
+                v[c] = maxV - (maxV - v[c]) * r;
+        }
+    }
+    for (int c = 0; c < a.channels; c++)
+        v[c] = (v[c] - a.mean) * a.scale;
+}
+
+}}}
@@ -17,7 +17,10 @@
 #include "GPUWatcher.h" // bring in this class as well so that it gets exported from this DLL
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <mutex>
 #include "Quantizers.h"
+#include "ImageAugmentation.h"
 #ifndef CPUONLY
 #define ANAMEFORLIB "Cntk.Math.Cuda-" ## CNTK_COMPONENT_VERSION ## ".lib"
 #pragma comment(lib, ANAMEFORLIB) // built by MathCUDA project
@@ -158,6 +161,98 @@ int GetMathLibTraceLevel()
     return m_mathLibTraceLevel.load();
 }
 
+#pragma region MatrixTransferAudit
+
+static std::atomic<MatrixTransferAudit::Mode> s_transferAuditMode(MatrixTransferAudit::Mode::Off);
+static thread_local const wchar_t* s_transferAuditAction = nullptr;
+static thread_local const std::wstring* s_transferAuditName = nullptr;
+static std::mutex s_transferAuditMutex;
+static std::map<std::wstring, MatrixTransferAudit::Statistics> s_transferAuditStatistics;
+
+/*static*/ MatrixTransferAudit::Mode MatrixTransferAudit::ParseMode(const std::wstring& mode)
+{
+    if (mode == L"none")
+        return Mode::Off;
+    else if (mode == L"count")
+        return Mode::Count;
+    else if (mode == L"fail")
+        return Mode::Fail;
+    InvalidArgument("Invalid matrix transfer audit mode '%ls', must be 'none', 'count' or 'fail'.", mode.c_str());
+}
+
+/*static*/ void MatrixTransferAudit::SetMode(Mode mode)
+{
+    s_transferAuditMode = mode;
+}
+
+/*static*/ MatrixTransferAudit::Mode MatrixTransferAudit::GetMode()
+{
+    return s_transferAuditMode;
+}
+
+MatrixTransferAudit::Scope::Scope(const wchar_t* action, const std::wstring& name)
+    : m_previousAction(s_transferAuditAction), m_previousName(s_transferAuditName)
+{
+    s_transferAuditAction = action;
+    s_transferAuditName = &name;
+}
+
+MatrixTransferAudit::Scope::~Scope()
+{
+    s_transferAuditAction = m_previousAction;
+    s_transferAuditName = m_previousName;
+}
+
+static std::wstring DeviceName(int deviceId)
+{
+    return deviceId < 0 ? L"CPU" : L"GPU" + std::to_wstring(deviceId);
+}
+
+/*static*/ void MatrixTransferAudit::CheckTransfer(int fromDeviceId, int toDeviceId, size_t numRows, size_t numCols)
+{
+    if (GetMode() == Mode::Fail && s_transferAuditName)
+        RuntimeError("A [%d x %d] matrix was transferred from %ls to %ls in %ls %ls (matrix transfer audit).",
+                     (int)numRows, (int)numCols, DeviceName(fromDeviceId).c_str(), DeviceName(toDeviceId).c_str(),
+                     s_transferAuditAction, s_transferAuditName->c_str());
+}
+
+/*static*/ void MatrixTransferAudit::RecordTransfer(int fromDeviceId, int toDeviceId, size_t bytes, double seconds)
+{
+    std::wstring key = s_transferAuditName ? std::wstring(s_transferAuditAction) + L" " + *s_transferAuditName : L"(outside of nodes)";
+    key += L": " + DeviceName(fromDeviceId) + L" -> " + DeviceName(toDeviceId);
+
+    std::lock_guard<std::mutex> lock(s_transferAuditMutex);
+    auto& statistics = s_transferAuditStatistics[key];
+    statistics.numTransfers++;
+    statistics.bytes += bytes;
+    statistics.seconds += seconds;
+}
+
+/*static*/ std::map<std::wstring, MatrixTransferAudit::Statistics> MatrixTransferAudit::TakeStatistics()
+{
+    std::lock_guard<std::mutex> lock(s_transferAuditMutex);
+    std::map<std::wstring, Statistics> statistics;
+    statistics.swap(s_transferAuditStatistics);
+    return statistics;
+}
+
+/*static*/ void MatrixTransferAudit::PrintStatistics()
+{
+    auto statistics = TakeStatistics();
+    std::vector<std::pair<std::wstring, Statistics>> sorted(statistics.begin(), statistics.end());
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::wstring, Statistics>& a, const std::pair<std::wstring, Statistics>& b)
+    {
+        return a.second.seconds > b.second.seconds;
+    });
+
+    fprintf(stderr, "Matrix transfers between devices: %d kinds\n", (int)sorted.size());
+    for (const auto& entry : sorted)
+        fprintf(stderr, "    %8d transfers %10.2f MB %9.3f s  %ls\n", (int)entry.second.numTransfers,
+                entry.second.bytes / (1024.0 * 1024.0), entry.second.seconds, entry.first.c_str());
+}
+
+#pragma endregion MatrixTransferAudit
+
 MatrixBase::~MatrixBase() { }
 
 #pragma region Constructors, destructors and other static matrix builders
@@ -638,6 +733,36 @@ void Matrix<ElemType>::Read(File& stream)
         LogicError("Read: Input file corrupt (invalid matrix type field 0x%02d, should be 'f' or 'd').", type);
 }
 
+// the same format as operator>>(File&, CPUMatrix<ElemType>&)
+template <class ElemType>
+/*static*/ bool Matrix<ElemType>::ReadDenseHeader(File& stream, size_t& numRows, size_t& numCols, uint64_t& elementsPosition)
+{
+    if (stream.IsTextBased() || !stream.CanSeek())
+        LogicError("ReadDenseHeader: The elements of a matrix can only be skipped in a seekable binary file.");
+
+    uint64_t position = stream.GetPosition();
+    char type;
+    stream >> type;
+    if (type != 'd')
+    {
+        stream.SetPosition(position);
+        return false;
+    }
+
+    stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+    size_t elsize;
+    stream >> elsize;
+    if (sizeof(ElemType) != elsize)
+        RuntimeError("Template argument size doesn't match those in file");
+    std::wstring matrixName;
+    int format;
+    stream >> matrixName >> format >> numRows >> numCols;
+    elementsPosition = stream.GetPosition();
+    stream.SetPosition(elementsPosition + numRows * numCols * sizeof(ElemType));
+    stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+    return true;
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Write(File& stream) const
 {
@@ -675,6 +800,17 @@ size_t Matrix<ElemType>::BufferSize() const
                             return m_GPUSparseMatrix->BufferSizeAllocated());
 }
 
+template <class ElemType>
+size_t Matrix<ElemType>::NzCount() const
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            return GetNumElements(),
+                            return GetNumElements(),
+                            return m_CPUSparseMatrix->NzCount(),
+                            return m_GPUSparseMatrix->NzCount());
+}
+
 // BUGBUG: This is ugly code. The outside world should not have access to the raw data pointers.
 // if this is to be used, then at least it should also return a number of bytes as well.
 template <class ElemType>
@@ -985,11 +1121,7 @@ void Matrix<ElemType>::SwitchToMatrixType(MatrixType newMatrixType, MatrixFormat
 template <class ElemType>
 void Matrix<ElemType>::CopyElementsFromDenseToSparse(CPUMatrix<ElemType>& from, CPUSparseMatrix<ElemType>& dest)
 {
-    foreach_coord (row, col, from)
-    {
-        auto val = from(row, col);
-        dest.SetValue(row, col, val);
-    }
+    dest.SetValue(from);
 }
 
 template <class ElemType>
@@ -1126,6 +1258,54 @@ Matrix<ElemType>& Matrix<ElemType>::DoScatterColumnsOf(ElemType beta, const Matr
     return *this;
 }
 
+// *this[i,:] = a[idx[i],:] * alpha + *this[i,:] * beta
+// idx has one entry per row of 'this' (it may be a row or a column vector) and contains values w.r.t. 'a'
+// Invalid entries are denoted by idx[i] == -1; those rows are left as they are. Dense matrices only.
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::DoGatherRowsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha)
+{
+    DecideAndMoveToRightDevice(*this, idx, a);
+
+    if (a.GetMatrixType() != DENSE || GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&a, this,
+        { m_CPUMatrix->DoGatherRowsOf(beta, *idx.m_CPUMatrix, *a.m_CPUMatrix, alpha); },
+        { m_GPUMatrix->DoGatherRowsOf(beta, *idx.m_GPUMatrix, *a.m_GPUMatrix, alpha); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+// *this[0,j] = column of time step timeIndices[0,j] in the target of the sequence that column j belongs to,
+//            = sequence.targetColumn + timeIndices[0,j] * targetStride
+// for the packed layout of 'numParallelSequences' x 'numTimeSteps' columns that holds the given sequences.
+// Without timeIndices the time step is that of column j itself (a copy, or with targetStride = 0 a broadcast, of the sequence).
+// Columns that hold no sequence (gaps) are set to -1, which DoGatherColumnsOf() and DoScatterColumnsOf() skip.
+// A time index outside [0, targetLength) is an error on the CPU; on the GPU, which cannot report it, it yields -1 as well.
+// Only the sequences are passed to the device, not the indices.
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignPackedIndicesOf(const Matrix<ElemType>* timeIndices, size_t numParallelSequences, size_t numTimeSteps,
+                                                          const std::vector<PackedSequenceRange>& sequences, size_t targetStride)
+{
+    if (timeIndices)
+    {
+        DecideAndMoveToRightDevice(*timeIndices, *this);
+        if (timeIndices->GetMatrixType() != DENSE)
+            NOT_IMPLEMENTED;
+    }
+    SwitchToMatrixType(DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignPackedIndicesOf(timeIndices ? timeIndices->m_CPUMatrix.get() : nullptr, numParallelSequences, numTimeSteps, sequences, targetStride); },
+        { m_GPUMatrix->AssignPackedIndicesOf(timeIndices ? timeIndices->m_GPUMatrix.get() : nullptr, numParallelSequences, numTimeSteps, sequences, targetStride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
 // set all elements of a matrix to a scalar value
 // For sparse matrices, the only allowed value is 0.
 template <class ElemType>
@@ -1203,6 +1383,37 @@ void Matrix<ElemType>::MaskColumnsValue(const Matrix<char>& columnsMask, ElemTyp
         { m_GPUSparseMatrix->MaskColumnsValue(*columnsMask.m_GPUMatrix, val, numColsPerMaskEntry); });
 }
 
+template <class ElemType>
+void Matrix<ElemType>::AssignNormalizedBytesOf(const Matrix<char>& bytes, ElemType mean, ElemType scale)
+{
+    if (GetDeviceId() != bytes.GetDeviceId())
+        RuntimeError("AssignNormalizedBytesOf: Matrix and bytes must be on the same device.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignNormalizedBytesOf(*bytes.m_CPUMatrix, mean, scale); },
+        { m_GPUMatrix->AssignNormalizedBytesOf(*bytes.m_GPUMatrix, mean, scale); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AssignAugmentedImagesOf(const Matrix<char>& bytes, const ImageAugmentation& augmentation, uint64_t firstImage)
+{
+    if (GetDeviceId() != bytes.GetDeviceId())
+        RuntimeError("AssignAugmentedImagesOf: Matrix and bytes must be on the same device.");
+    if (bytes.GetNumRows() != (size_t)augmentation.inW * augmentation.inH * augmentation.channels)
+        InvalidArgument("AssignAugmentedImagesOf: The bytes have %d rows, but the images have %d x %d x %d elements.",
+                        (int)bytes.GetNumRows(), augmentation.inW, augmentation.inH, augmentation.channels);
+    if (augmentation.channels > ImageAugmentation::MaxChannels)
+        InvalidArgument("AssignAugmentedImagesOf: Images of more than %d channels are not supported.", ImageAugmentation::MaxChannels);
+
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignAugmentedImagesOf(*bytes.m_CPUMatrix, augmentation, firstImage); },
+        { m_GPUMatrix->AssignAugmentedImagesOf(*bytes.m_GPUMatrix, augmentation, firstImage); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetColumn(const ElemType* colPointer, size_t colInd)
 {
@@ -1304,6 +1515,27 @@ void Matrix<ElemType>::AssignValuesOf(const Matrix<ElemType>& deepCopyFrom)
         });
 }
 
+// copies a matrix that may be on another device into this one, which keeps its device (for ComputationNetwork::PlaceNodesOnDevices())
+// Dense GPU-to-GPU copies are direct; the others go through AssignValuesOf(), which copies from and to the host.
+template <class ElemType>
+void Matrix<ElemType>::AssignValuesFromDevice(const Matrix<ElemType>& source)
+{
+    if (this == &source)
+        return;
+
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    if (GetDeviceId() == source.GetDeviceId() || GetDeviceId() < 0 || source.GetDeviceId() < 0) // at most one GPU involved
+        AssignValuesOf(source);
+    else if (source.GetMatrixType() == MatrixType::DENSE)
+        m_GPUMatrix->AssignValuesFromPeer(*source.m_GPUMatrix);
+    else
+    {
+        Matrix<ElemType> sourceOnHost(source.GetNumRows(), source.GetNumCols(), CPUDEVICE, MatrixType::DENSE);
+        sourceOnHost.AssignValuesOf(source);
+        AssignValuesOf(sourceOnHost);
+    }
+}
+
 // CastAssignValuesOf() -- assign a matrix with type conversion, needed for feeding 'float' data to 'double' inputs in V2
 // This version is a stop-gap for debugging and testing. If any conversion is done, it will be slow.
 // If this is ever used for something that needs performance, it should not be too hard (but labor) to implement this efficiently.
@@ -1421,6 +1653,49 @@ void Matrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCC
         { m_GPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols, false, -1, transferer); });
 }
 
+template <class ElemType>
+size_t Matrix<ElemType>::CopyBlockColumnsToCPU(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const
+{
+    // note: not for column slices, whose block ids are relative to the full matrix
+    if (GetMatrixType() != MatrixType::SPARSE || GetFormat() != matrixFormatSparseBlockCol)
+        LogicError("CopyBlockColumnsToCPU: Only sparse block-column matrices are supported.");
+
+    auto copyColumns = [&](const CPUSparseMatrix<ElemType>& cpuSparseMatrix)
+    {
+        size_t numColumns = cpuSparseMatrix.IsEmpty() ? 0 : cpuSparseMatrix.GetBlockSize();
+        columnIds.resize(numColumns);
+        for (size_t i = 0; i < numColumns; ++i)
+            columnIds[i] = cpuSparseMatrix.BlockIdsLocation()[i];
+        values.assign(cpuSparseMatrix.Data(), cpuSparseMatrix.Data() + numColumns * GetNumRows());
+        return numColumns;
+    };
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            { return copyColumns(*m_CPUSparseMatrix); },
+                            {
+                                CPUSparseMatrix<ElemType> cpuSparseMatrix(matrixFormatSparseBlockCol);
+                                m_GPUSparseMatrix->CopyToCPUSparseMatrix(cpuSparseMatrix);
+                                return copyColumns(cpuSparseMatrix);
+                            });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::SetBlockColumnsFromCPU(const size_t* columnIds, const ElemType* values, size_t numColumns)
+{
+    if (GetMatrixType() != MatrixType::SPARSE || GetFormat() != matrixFormatSparseBlockCol)
+        LogicError("SetBlockColumnsFromCPU: Only sparse block-column matrices are supported.");
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->SetMatrixFromSBCFormat(columnIds, values, numColumns, GetNumRows(), GetNumCols()),
+                            m_GPUSparseMatrix->SetMatrixFromSBCFormat(columnIds, values, numColumns, GetNumRows(), GetNumCols()));
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -1545,6 +1820,51 @@ void Matrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const ElemT
                             NOT_IMPLEMENTED);
 }
 
+// this = a .* mask
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCounterBasedDropoutOf(const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("AssignCounterBasedDropoutOf: Matrix is empty.");
+
+    DecideAndMoveToRightDevice(a, *this);
+    SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->CounterBasedDropout(*a.m_CPUMatrix, maskRate, scaleValue, seed, offset, 0),
+                            m_GPUMatrix->CounterBasedDropout(*a.m_GPUMatrix, maskRate, scaleValue, seed, offset, 0),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+// this += a .* mask
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddCounterBasedDropoutOf(const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("AddCounterBasedDropoutOf: Matrix is empty.");
+
+    if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("The input matrix dimensions do not match [this].");
+
+    DecideAndMoveToRightDevice(*this, a);
+
+    if (a.GetMatrixType() != GetMatrixType())
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            m_CPUMatrix->CounterBasedDropout(*a.m_CPUMatrix, maskRate, scaleValue, seed, offset, 1),
+                            m_GPUMatrix->CounterBasedDropout(*a.m_GPUMatrix, maskRate, scaleValue, seed, offset, 1),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 // Vanilla SGD update. 
 // Modifies "this" parameter matrix, on which this method is invoked.
 template <class ElemType>
@@ -1703,8 +2023,12 @@ template <class ElemType>
 void Matrix<ElemType>::FSAdagradUpdate(size_t mbSize,
                                        Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
                                        const double learnRatePerSample, const double targetAdagradAvDenom,
-                                       const double meanMomentum, const double varMomentum, bool unitGainMomentum)
+                                       const double meanMomentum, const double varMomentum, bool unitGainMomentum,
+                                       bool lazy, Matrix<ElemType>* lazyUpdateSteps)
 {
+    if (lazyUpdateSteps && (lazyUpdateSteps->GetDeviceId() != gradients.GetDeviceId() || lazyUpdateSteps->GetMatrixType() != DENSE))
+        LogicError("FSAdagradUpdate: lazyUpdateSteps must be a dense matrix on the device of the gradients.");
+
     // keep track on how many samples have been accumulated into the g^2 accumulator
     smoothedCount = varMomentum * smoothedCount + (1.0 - varMomentum) * mbSize;
 
@@ -1727,8 +2051,20 @@ void Matrix<ElemType>::FSAdagradUpdate(size_t mbSize,
                                    targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum); 
             SetDataLocation(GPU); 
         },
-        { NOT_IMPLEMENTED; },
-        { gradients.m_GPUSparseMatrix->FSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum); SetDataLocation(GPU); });
+        {
+            gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix,
+                                                   (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum,
+                                                   targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum,
+                                                   lazy, lazyUpdateSteps ? lazyUpdateSteps->m_CPUMatrix.get() : nullptr);
+            SetDataLocation(CPU);
+        },
+        {
+            gradients.m_GPUSparseMatrix->FSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix,
+                                                   (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum,
+                                                   targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum,
+                                                   lazy, lazyUpdateSteps ? lazyUpdateSteps->m_GPUMatrix.get() : nullptr);
+            SetDataLocation(GPU);
+        });
 
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
@@ -1739,8 +2075,12 @@ void Matrix<ElemType>::FSAdagradUpdate(size_t mbSize,
 ///
 template <class ElemType>
 void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
-    const double learnRatePerSample, const double meanMomentum, const double varMomentum, bool unitGainMomentum)
+    const double learnRatePerSample, const double meanMomentum, const double varMomentum, bool unitGainMomentum,
+    bool lazy, Matrix<ElemType>* lazyUpdateSteps)
 {
+    if (lazyUpdateSteps && (lazyUpdateSteps->GetDeviceId() != gradients.GetDeviceId() || lazyUpdateSteps->GetMatrixType() != DENSE))
+        LogicError("AdamUpdate: lazyUpdateSteps must be a dense matrix on the device of the gradients.");
+
     smoothedCount++;
     // Bias correction
     let biasCorrection = (ElemType)(sqrt(1- pow(varMomentum, smoothedCount))/(1- pow(meanMomentum, smoothedCount)));
@@ -1758,15 +2098,48 @@ void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>&
         biasCorrection, unitGainMomentum);
         SetDataLocation(GPU);
     },
-    { NOT_IMPLEMENTED; },
+    {
+        gradients.m_CPUSparseMatrix->Adam(*m_CPUMatrix, *functionValues.m_CPUMatrix,
+        (ElemType)learnRatePerSample, (ElemType)meanMomentum,
+        (ElemType)varMomentum, biasCorrection, unitGainMomentum,
+        lazy, lazyUpdateSteps ? lazyUpdateSteps->m_CPUMatrix.get() : nullptr);
+        SetDataLocation(CPU);
+    },
     { gradients.m_GPUSparseMatrix->Adam(*m_GPUMatrix, *functionValues.m_GPUMatrix, 
         (ElemType)learnRatePerSample, (ElemType)meanMomentum, 
-        (ElemType)varMomentum, biasCorrection, unitGainMomentum); 
+        (ElemType)varMomentum, biasCorrection, unitGainMomentum,
+        lazy, lazyUpdateSteps ? lazyUpdateSteps->m_GPUMatrix.get() : nullptr);
         SetDataLocation(GPU); });
 
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiTensorUpdate(DEVICEID_TYPE deviceId, MultiTensorUpdateType type, const std::vector<MultiTensorItem<ElemType>>& items,
+                                                   ElemType momentum, ElemType varMomentum, bool unitGainMomentum)
+{
+    if (deviceId == CPUDEVICE)
+        CPUMatrix<ElemType>::MultiTensorUpdate(type, items, momentum, varMomentum, unitGainMomentum);
+    else
+        GPUMatrix<ElemType>::MultiTensorUpdate(deviceId, type, items, momentum, varMomentum, unitGainMomentum);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiTensorSumOfSquares(DEVICEID_TYPE deviceId, const std::vector<MultiTensorItem<ElemType>>& items, std::vector<double>& sumsOfSquares)
+{
+    if (deviceId == CPUDEVICE)
+        CPUMatrix<ElemType>::MultiTensorSumOfSquares(items, sumsOfSquares);
+    else
+        GPUMatrix<ElemType>::MultiTensorSumOfSquares(deviceId, items, sumsOfSquares);
+}
+
+template <class ElemType>
+bool Matrix<ElemType>::IsMultiTensorOperand(DEVICEID_TYPE deviceId) const
+{
+    return GetMatrixType() == MatrixType::DENSE && GetDeviceId() == deviceId &&
+           GetCurrentMatrixLocation() == (deviceId == CPUDEVICE ? CurrentDataLocation::CPU : CurrentDataLocation::GPU);
+}
+
 template <class ElemType>
 ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
                                    ElemType RMS_GAMMA,
@@ -1781,7 +2154,7 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         { return m_CPUMatrix->RmsProp(*gradients.m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); SetDataLocation(CPU); },
         { return m_GPUMatrix->RmsProp(*gradients.m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); SetDataLocation(GPU); },
-        { NOT_IMPLEMENTED; },
+        { return gradients.m_CPUSparseMatrix->RmsProp(*m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); SetDataLocation(CPU); },
         { return gradients.m_GPUSparseMatrix->RmsProp(*m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); SetDataLocation(GPU); });
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
@@ -2421,6 +2794,21 @@ Matrix<ElemType>& Matrix<ElemType>::AssignElementPowerOf(const Matrix<ElemType>&
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::ElementMultiplyWith(const Matrix<ElemType>& a)
 {
+    // a sparse matrix times a dense one keeps its sparsity pattern, e.g. to weight a block-sparse gradient
+    if (GetMatrixType() == MatrixType::SPARSE && a.GetMatrixType() == MatrixType::DENSE)
+    {
+        if (!(GetNumRows() == a.GetNumRows() && GetNumCols() == a.GetNumCols()))
+            InvalidArgument("The input matrix dimensions do not match.");
+
+        DecideAndMoveToRightDevice(*this, a);
+        DISPATCH_MATRIX_ON_FLAG(this,
+                                this,
+                                NOT_IMPLEMENTED,
+                                NOT_IMPLEMENTED,
+                                m_CPUSparseMatrix->ElementMultiplyWith(*a.m_CPUMatrix),
+                                m_GPUSparseMatrix->ElementMultiplyWith(*a.m_GPUMatrix));
+        return *this;
+    }
     return AssignElementProductOf(*this, a);
 }
 
@@ -2818,6 +3206,66 @@ Matrix<ElemType>& Matrix<ElemType>::AssignLogSoftmaxOf(const Matrix<ElemType>& a
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignSoftmaxCrossEntropyOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& input, Matrix<ElemType>& logSumExp)
+{
+    if (input.IsEmpty())
+        LogicError("AssignSoftmaxCrossEntropyOf: Matrix input is empty.");
+    if (labels.GetMatrixType() != MatrixType::DENSE || input.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(input, labels, *this);
+    logSumExp._transferToDevice(input.GetDeviceId());
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    logSumExp.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&input,
+                            this,
+                            m_CPUMatrix->AssignSoftmaxCrossEntropyOf(*labels.m_CPUMatrix, *input.m_CPUMatrix, *logSumExp.m_CPUMatrix),
+                            m_GPUMatrix->AssignSoftmaxCrossEntropyOf(*labels.m_GPUMatrix, *input.m_GPUMatrix, *logSumExp.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::AddSoftmaxCrossEntropyGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& labels, const Matrix<ElemType>& input,
+                                                                 const Matrix<ElemType>& logSumExp, Matrix<ElemType>& inputGradient)
+{
+    DecideAndMoveToRightDevice(inputGradient, input, labels, logSumExp);
+    gradient._transferToDevice(inputGradient.GetDeviceId());
+
+    if (!(labels.GetMatrixType() == MatrixType::DENSE && input.GetMatrixType() == MatrixType::DENSE &&
+          inputGradient.GetMatrixType() == MatrixType::DENSE && gradient.GetMatrixType() == MatrixType::DENSE))
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&inputGradient,
+                            &inputGradient,
+                            CPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(*gradient.m_CPUMatrix, *labels.m_CPUMatrix, *input.m_CPUMatrix, *logSumExp.m_CPUMatrix, *inputGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(*gradient.m_GPUMatrix, *labels.m_GPUMatrix, *input.m_GPUMatrix, *logSumExp.m_GPUMatrix, *inputGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::AddSoftmaxCrossEntropyLabelGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& input,
+                                                                      const Matrix<ElemType>& logSumExp, Matrix<ElemType>& labelsGradient)
+{
+    DecideAndMoveToRightDevice(labelsGradient, input, logSumExp);
+    gradient._transferToDevice(labelsGradient.GetDeviceId());
+
+    if (!(input.GetMatrixType() == MatrixType::DENSE && labelsGradient.GetMatrixType() == MatrixType::DENSE && gradient.GetMatrixType() == MatrixType::DENSE))
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&labelsGradient,
+                            &labelsGradient,
+                            CPUMatrix<ElemType>::AddSoftmaxCrossEntropyLabelGradient(*gradient.m_CPUMatrix, *input.m_CPUMatrix, *logSumExp.m_CPUMatrix, *labelsGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddSoftmaxCrossEntropyLabelGradient(*gradient.m_GPUMatrix, *input.m_GPUMatrix, *logSumExp.m_GPUMatrix, *labelsGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 //[this]=softmax([this]) element wise
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::InplaceHardmax(const bool isColWise)
@@ -3624,7 +4072,7 @@ ElemType Matrix<ElemType>::MatrixNormInf() const
                             nullptr,
                             return m_CPUMatrix->MatrixNormInf(),
                             return m_GPUMatrix->MatrixNormInf(),
-                            NOT_IMPLEMENTED,
+                            return m_CPUSparseMatrix->MatrixNormInf(),
                             return m_GPUSparseMatrix->MatrixNormInf());
 }
 
@@ -3735,6 +4183,35 @@ void Matrix<ElemType>::VectorMax(Matrix<ElemType>& maxIndices, Matrix<ElemType>&
         { NOT_IMPLEMENTED; });
 }
 
+// Radix selection on the GPU, partial sort on the CPU. Rows go through a transposed copy.
+template <class ElemType>
+void Matrix<ElemType>::TopK(Matrix<ElemType>& topKValues, Matrix<ElemType>& topKIndices, size_t k, const bool isColWise) const
+{
+    if (IsEmpty())
+        LogicError("TopK: Matrix is empty.");
+
+    if (!isColWise)
+    {
+        Matrix<ElemType> transposed(GetDeviceId());
+        transposed.AssignTransposeOf(*this);
+        Matrix<ElemType> values(GetDeviceId()), indices(GetDeviceId());
+        transposed.TopK(values, indices, k, true);
+        topKValues.AssignTransposeOf(values);
+        topKIndices.AssignTransposeOf(indices);
+        return;
+    }
+
+    DecideAndMoveToRightDevice(*this, topKValues, topKIndices);
+    topKValues.SwitchToMatrixType(GetMatrixType(), GetFormat(), false);
+    topKIndices.SwitchToMatrixType(GetMatrixType(), GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(this, &topKValues,
+        { m_CPUMatrix->TopK(*topKValues.m_CPUMatrix, *topKIndices.m_CPUMatrix, k); topKIndices.SetDataLocation(CPU, DENSE); },
+        { m_GPUMatrix->TopK(*topKValues.m_GPUMatrix, *topKIndices.m_GPUMatrix, k); topKIndices.SetDataLocation(GPU, DENSE); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
 template <class ElemType>
 void Matrix<ElemType>::VectorMin(Matrix<ElemType>& minIndices, Matrix<ElemType>& minValues, const bool isColWise) const
 {
@@ -3913,6 +4390,15 @@ void Matrix<ElemType>::_transferFromDeviceToDevice(int from_id, int to_id, bool
     if ((GetMathLibTraceLevel() > 0) && (m_numTimesDeviceChanged == NUM_DEVICE_CHANGED_WARN && m_devicesTransferedTo[1] >= CPUDEVICE))
         fprintf(stderr, "WARNING: The same matrix with dim [%lu, %lu] has been transferred between different devices for %d times.\n", (unsigned long) GetNumRows(), (unsigned long) GetNumCols(), NUM_DEVICE_CHANGED_WARN);
 
+    // account for the transfer (MatrixTransferAudit)
+    bool audit = !emptyTransfer && MatrixTransferAudit::GetMode() != MatrixTransferAudit::Mode::Off;
+    std::chrono::steady_clock::time_point auditStart;
+    if (audit)
+    {
+        MatrixTransferAudit::CheckTransfer(from_id, to_id, GetNumRows(), GetNumCols());
+        auditStart = std::chrono::steady_clock::now();
+    }
+
     // do the transfer
     if (m_matrixType == MatrixType::SPARSE)
     {
@@ -4046,6 +4532,12 @@ void Matrix<ElemType>::_transferFromDeviceToDevice(int from_id, int to_id, bool
             }
         }
     } // and of omp critical section
+
+    if (audit)
+    {
+        size_t bytes = m_matrixType == MatrixType::SPARSE ? NzCount() * (sizeof(ElemType) + sizeof(GPUSPARSE_INDEX_TYPE)) : GetNumElements() * sizeof(ElemType);
+        MatrixTransferAudit::RecordTransfer(from_id, to_id, bytes, std::chrono::duration<double>(std::chrono::steady_clock::now() - auditStart).count());
+    }
 }
 
 template <class ElemType>
@@ -4412,6 +4904,54 @@ void Matrix<ElemType>::ConvolutionBackwardKernel(const Matrix<ElemType>& in, con
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::DepthwiseConvolutionForward(const Matrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, Matrix<ElemType>& output) const
+{
+    assert(GetNumRows() == (size_t)shape.inW * shape.inH * shape.inC);
+    assert(output.GetNumRows() == (size_t)shape.outW * shape.outH * shape.groups * shape.multiplier && output.GetNumCols() == GetNumCols());
+
+    DecideAndMoveToRightDevice(*this, output);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->DepthwiseConvolutionForward(*(kernel.m_CPUMatrix), shape, *(output.m_CPUMatrix)),
+                            m_GPUMatrix->DepthwiseConvolutionForward(*(kernel.m_GPUMatrix), shape, *(output.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::DepthwiseConvolutionBackwardData(const Matrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, Matrix<ElemType>& grad) const
+{
+    assert(GetNumRows() == (size_t)shape.outW * shape.outH * shape.groups * shape.multiplier);
+    assert(grad.GetNumRows() == (size_t)shape.inW * shape.inH * shape.inC && grad.GetNumCols() == GetNumCols());
+
+    DecideAndMoveToRightDevice(*this, grad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->DepthwiseConvolutionBackwardData(*(kernel.m_CPUMatrix), shape, *(grad.m_CPUMatrix)),
+                            m_GPUMatrix->DepthwiseConvolutionBackwardData(*(kernel.m_GPUMatrix), shape, *(grad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::DepthwiseConvolutionBackwardKernel(const Matrix<ElemType>& in, const DepthwiseConvolutionShape& shape, Matrix<ElemType>& kernelGrad) const
+{
+    assert(GetNumRows() == (size_t)shape.outW * shape.outH * shape.groups * shape.multiplier);
+    assert(in.GetNumRows() == (size_t)shape.inW * shape.inH * shape.inC && in.GetNumCols() == GetNumCols());
+
+    DecideAndMoveToRightDevice(*this, kernelGrad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->DepthwiseConvolutionBackwardKernel(*(in.m_CPUMatrix), shape, *(kernelGrad.m_CPUMatrix)),
+                            m_GPUMatrix->DepthwiseConvolutionBackwardKernel(*(in.m_GPUMatrix), shape, *(kernelGrad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::UnrollConvolutionInput(size_t unrollCols, size_t mapOutSize, const Matrix<int>& mpRowCol,
                                               const Matrix<int>& mpRowRun, const Matrix<int>& runs, Matrix<ElemType>& output) const
@@ -4511,6 +5051,54 @@ void Matrix<ElemType>::MaxPoolingBackward(const Matrix<ElemType>& out, const Mat
                             NOT_IMPLEMENTED);
 }
 
+// Max pooling that also records, per output, the position of the max within its window (the index into its run of
+// 'indices'), so that the backward pass is a scatter that needs neither the input nor the output values.
+template <class ElemType>
+void Matrix<ElemType>::MaxPoolingForwardWithArgmax(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices,
+                                                   Matrix<ElemType>& output, Matrix<short>& argmax) const
+{
+    assert(mpRowCol.GetNumCols() == 1);
+    assert(mpRowIndices.GetNumCols() == 1);
+    assert(indices.GetNumCols() == 1);
+    assert(argmax.GetNumRows() == output.GetNumRows() && argmax.GetNumCols() == output.GetNumCols());
+
+    DecideAndMoveToRightDevice(*this, output);
+    if (argmax.GetDeviceId() != GetDeviceId())
+        RuntimeError("MaxPoolingForwardWithArgmax: Matrix and argmax must be on the same device.");
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->MaxPoolingForwardWithArgmax(*(mpRowCol.m_CPUMatrix), *(mpRowIndices.m_CPUMatrix), *(indices.m_CPUMatrix),
+                                                                       *(output.m_CPUMatrix), *(argmax.m_CPUMatrix)),
+                            m_GPUMatrix->MaxPoolingForwardWithArgmax(*(mpRowCol.m_GPUMatrix), *(mpRowIndices.m_GPUMatrix), *(indices.m_GPUMatrix),
+                                                                       *(output.m_GPUMatrix), *(argmax.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::MaxPoolingBackwardWithArgmax(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices,
+                                                    const Matrix<short>& argmax, Matrix<ElemType>& grad) const
+{
+    assert(mpRowCol.GetNumCols() == 1);
+    assert(mpRowIndices.GetNumCols() == 1);
+    assert(indices.GetNumCols() == 1);
+    assert(argmax.GetNumRows() == GetNumRows() && argmax.GetNumCols() == GetNumCols());
+
+    DecideAndMoveToRightDevice(*this, grad);
+    if (argmax.GetDeviceId() != GetDeviceId())
+        RuntimeError("MaxPoolingBackwardWithArgmax: Matrix and argmax must be on the same device.");
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->MaxPoolingBackwardWithArgmax(*(mpRowCol.m_CPUMatrix), *(mpRowIndices.m_CPUMatrix), *(indices.m_CPUMatrix),
+                                                                        *(argmax.m_CPUMatrix), *(grad.m_CPUMatrix)),
+                            m_GPUMatrix->MaxPoolingBackwardWithArgmax(*(mpRowCol.m_GPUMatrix), *(mpRowIndices.m_GPUMatrix), *(indices.m_GPUMatrix),
+                                                                        *(argmax.m_GPUMatrix), *(grad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
                                          const size_t pooledWidth, const size_t pooledHeight, const Matrix<ElemType>& roiData, Matrix<ElemType>& output, 
@@ -4652,7 +5240,7 @@ void Matrix<ElemType>::RNNForward(const Matrix<ElemType> &inputX, const Matrix<E
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNForward(*(inputX.m_CPUMatrix), *(paramW.m_CPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNForward(*(inputX.m_GPUMatrix), *(paramW.m_GPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4667,7 +5255,7 @@ void Matrix<ElemType>::RNNBackwardData(const Matrix<ElemType>& outputDY, const M
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            RuntimeError("OptimizedRNNStack training on CPU is not yet implemented."),
                             m_GPUMatrix->RNNBackwardData(*(outputDY.m_GPUMatrix), *(paramW.m_GPUMatrix), *(outputDX.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4682,7 +5270,7 @@ void Matrix<ElemType>::RNNBackwardWeights(const Matrix<ElemType>& inputX, const
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            RuntimeError("OptimizedRNNStack training on CPU is not yet implemented."),
                             m_GPUMatrix->RNNBackwardWeights(*(inputX.m_GPUMatrix), *(outputY.m_GPUMatrix), *(dw.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4800,7 +5388,13 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
     {
         if (a.m_matrixType == MatrixType::DENSE && b.m_matrixType == MatrixType::DENSE && c.m_matrixType == MatrixType::DENSE) // GPU, DENSE * DENSE -> DENSE
         {
-            GPUMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix);
+            if (pQuantizedMultiplier == nullptr)
+                GPUMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix);
+            else if (transposeA || transposeB)
+                LogicError("Quantized multiplier currently doesn't support transpose.");
+            else
+                GPUMatrix<ElemType>::QuantizedMultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, *b.m_GPUMatrix, beta, *c.m_GPUMatrix,
+                                                                     pQuantizedMultiplier->IsAConstant(), pQuantizedMultiplier->GPUBuffers());
             c.SetDataLocation(GPU, DENSE);
         }
         else if (a.m_matrixType == MatrixType::SPARSE && b.m_matrixType == MatrixType::DENSE && c.m_matrixType == MatrixType::DENSE) // GPU, SPARSE * DENSE -> DENSE
@@ -4960,6 +5554,23 @@ void Matrix<ElemType>::ConvolveAndWeightedAdd(ElemType alpha, const Matrix<ElemT
 /// <param name="v">Input scale vector for each column of a</param>
 /// <param name="beta">Scalar</param>
 /// <param name="c">Resulting matrix, the same shape as a</param>
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB,
+                                                            ElemType beta, Matrix<ElemType>& c, size_t batchSize, bool broadcastA, bool broadcastB)
+{
+    DecideAndMoveToRightDevice(a, b, c);
+
+    if (a.GetMatrixType() != MatrixType::DENSE || b.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+        &c,
+        CPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix, batchSize, broadcastA, broadcastB),
+        GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix, batchSize, broadcastA, broadcastB),
+        NOT_IMPLEMENTED,
+        NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::ColumnwiseScaleAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& v, ElemType beta, Matrix<ElemType>& c)
 {
@@ -4992,7 +5603,7 @@ template <class ElemType>
         DISPATCH_MATRIX_ON_FLAG(&c, &c,
             { CPUMatrix<ElemType>::ScaleAndAdd(alpha, *a.m_CPUMatrix, *c.m_CPUMatrix); },
             { GPUMatrix<ElemType>::ScaleAndAdd(alpha, *a.m_GPUMatrix, *c.m_GPUMatrix); },
-            { NOT_IMPLEMENTED; },
+            { CPUSparseMatrix<ElemType>::ScaleAndAdd(alpha, *a.m_CPUSparseMatrix, 1, *c.m_CPUSparseMatrix, *c.m_CPUSparseMatrix); },
             { GPUSparseMatrix<ElemType> b = move(*c.m_GPUSparseMatrix); GPUSparseMatrix<ElemType>::ScaleAndAdd(alpha, *a.m_GPUSparseMatrix, 1, b, *c.m_GPUSparseMatrix); });
     }
     else
@@ -5262,7 +5873,7 @@ void Matrix<ElemType>::Scale(ElemType alpha, Matrix<ElemType>& a)
                                 &a,
                                 CPUMatrix<ElemType>::Scale(alpha, *a.m_CPUMatrix),
                                 GPUMatrix<ElemType>::Scale(alpha, *a.m_GPUMatrix),
-                                NOT_IMPLEMENTED,
+                                CPUSparseMatrix<ElemType>::Scale(alpha, *a.m_CPUSparseMatrix),
                                 GPUSparseMatrix<ElemType>::Scale(alpha, *a.m_GPUSparseMatrix));
 }
 
@@ -5739,6 +6350,61 @@ void Matrix<ElemType>::RCRFTransGrdCompute(const Matrix<ElemType>& lbls,
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::RankWithinGroups(const Matrix<ElemType>& scores, const Matrix<ElemType>& gains, const Matrix<ElemType>& groupStarts, size_t truncation,
+                                        Matrix<ElemType>& ranks, Matrix<ElemType>& dcgs, Matrix<ElemType>& idealDCGs)
+{
+    if (scores.GetNumElements() != gains.GetNumElements())
+        InvalidArgument("RankWithinGroups: The scores and gains must have the same number of elements.");
+    if (groupStarts.GetNumElements() == 0)
+        InvalidArgument("RankWithinGroups: groupStarts must hold at least the number of samples.");
+
+    DecideAndMoveToRightDevice(scores, gains, groupStarts);
+    ranks._transferToDevice(scores.GetDeviceId());
+    dcgs._transferToDevice(scores.GetDeviceId());
+    idealDCGs._transferToDevice(scores.GetDeviceId());
+
+    DISPATCH_MATRIX_ON_FLAG(&scores, &ranks,
+        {
+            CPUMatrix<ElemType>::RankWithinGroups(*scores.m_CPUMatrix, *gains.m_CPUMatrix, *groupStarts.m_CPUMatrix, truncation,
+                                                  *ranks.m_CPUMatrix, *dcgs.m_CPUMatrix, *idealDCGs.m_CPUMatrix);
+            dcgs.SetDataLocation(CPU, DENSE);
+            idealDCGs.SetDataLocation(CPU, DENSE);
+        },
+        {
+            GPUMatrix<ElemType>::RankWithinGroups(*scores.m_GPUMatrix, *gains.m_GPUMatrix, *groupStarts.m_GPUMatrix, truncation,
+                                                  *ranks.m_GPUMatrix, *dcgs.m_GPUMatrix, *idealDCGs.m_GPUMatrix);
+            dcgs.SetDataLocation(GPU, DENSE);
+            idealDCGs.SetDataLocation(GPU, DENSE);
+        },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AddLambdaRankGradient(const Matrix<ElemType>& scores, const Matrix<ElemType>& gains, const Matrix<ElemType>& ranks, const Matrix<ElemType>& groupStarts,
+                                             const Matrix<ElemType>& idealDCGs, ElemType sigma, size_t truncation, Matrix<ElemType>& gradient)
+{
+    if (scores.GetNumElements() != gains.GetNumElements() || scores.GetNumElements() != ranks.GetNumElements() || scores.GetNumElements() != gradient.GetNumElements())
+        InvalidArgument("AddLambdaRankGradient: The scores, gains, ranks and gradient must have the same number of elements.");
+    if (idealDCGs.GetNumElements() + 1 != groupStarts.GetNumElements())
+        InvalidArgument("AddLambdaRankGradient: There must be one ideal DCG per group.");
+
+    DecideAndMoveToRightDevice(scores, gains, gradient);
+    ranks._transferToDevice(scores.GetDeviceId());
+    groupStarts._transferToDevice(scores.GetDeviceId());
+    idealDCGs._transferToDevice(scores.GetDeviceId());
+
+    DISPATCH_MATRIX_ON_FLAG(&gradient,
+                            &gradient,
+                            CPUMatrix<ElemType>::AddLambdaRankGradient(*scores.m_CPUMatrix, *gains.m_CPUMatrix, *ranks.m_CPUMatrix, *groupStarts.m_CPUMatrix,
+                                                                       *idealDCGs.m_CPUMatrix, sigma, truncation, *gradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddLambdaRankGradient(*scores.m_GPUMatrix, *gains.m_GPUMatrix, *ranks.m_GPUMatrix, *groupStarts.m_GPUMatrix,
+                                                                       *idealDCGs.m_GPUMatrix, sigma, truncation, *gradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::DropFrame(const Matrix<ElemType>& label, const Matrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -5911,6 +6577,36 @@ void Matrix<ElemType>::TensorArgOp(const Matrix<ElemType>& a, ElementWiseOperato
         NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::TensorProgramOp(ElemType beta, const array<const Matrix<ElemType>*, ElementwiseProgram::MaxInputs>& inputs, ElemType alpha, const ElementwiseProgram& program,
+                                       const array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                                       const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides)
+{
+    // the inputs follow the output to its device
+    VerifyIsDense(*this);
+    for (const auto* input : inputs)
+    {
+        VerifyIsDense(*input);
+        if (input->GetDeviceId() != GetDeviceId())
+            input->_transferToDevice(GetDeviceId());
+    }
+
+    array<const CPUMatrix<ElemType>*, ElementwiseProgram::MaxInputs> cpuInputs;
+    array<const GPUMatrix<ElemType>*, ElementwiseProgram::MaxInputs> gpuInputs;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        cpuInputs[i] = inputs[i]->m_CPUMatrix.get();
+        gpuInputs[i] = inputs[i]->m_GPUMatrix.get();
+    }
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->TensorProgramOp(beta, cpuInputs, alpha, program, offsets, regularOpDims, regularStrides),
+                            m_GPUMatrix->TensorProgramOp(beta, gpuInputs, alpha, program, offsets, regularOpDims, regularStrides),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 //template class Matrix<short>;
 template class Matrix<float>;
 template class Matrix<double>;
@@ -162,6 +162,8 @@ public:
     MatrixType GetMatrixType() const override;
     MatrixFormat GetFormat() const override;
     bool OwnBuffer() const { return m_baseMatrix->OwnBuffer(); }
+    // for a matrix over an external buffer (matrixFlagDontOwnBuffer): 'releaser' is called once no matrix uses the buffer any more
+    void SetExternalBufferReleaser(std::function<void()> releaser) { m_baseMatrix->SetExternalBufferReleaser(std::move(releaser)); }
     int GetDeviceId() const; // -1 if CPU, otherwise GPU CUDA device id
     DEVICEID_TYPE GetPreferredDeviceId() const { return m_preferredDeviceId; }; // -1 if CPU, otherwise GPU CUDA device id
     void SetPreferredDeviceId(DEVICEID_TYPE preferredDeviceId) { m_preferredDeviceId = preferredDeviceId; }
@@ -178,6 +180,7 @@ public:
     bool HasNoElements() const { return GetNumElements() == 0; }
     bool IsEmpty() const;
     size_t BufferSize() const;
+    size_t NzCount() const; // number of elements stored: the non-zeros of a sparse matrix, all elements of a dense one
     ElemType* Data() const;
 
     ElemType* CopyToArray() const;                                              // allocated by the callee but need to be deleted by the caller
@@ -207,18 +210,31 @@ public:
     void NesterovAcceleratedMomentumSGDUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& smoothedGradients, ElemType learnRatePerSample, ElemType momentum, bool unitGainMomentum = true);
 
     ElemType Adagrad(Matrix<ElemType>& gradients, const bool needAveMultiplier);
+
+    // With a block-sparse gradient, 'lazy' only updates the columns present in it; 'lazyUpdateSteps' (on the device of
+    // the gradient, sized on first use) keeps the state of the optional decay catch-up (LazyUpdateStepPeriod).
     void FSAdagradUpdate(size_t mbSize,
                          Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
                          const double learnRatePerSample, const double targetAdagradAvDenom,
-                         const double meanMomentum, const double varMomentum, bool unitGainMomentum = true);
+                         const double meanMomentum, const double varMomentum, bool unitGainMomentum = true,
+                         bool lazy = false, Matrix<ElemType>* lazyUpdateSteps = nullptr);
 
     void AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, double& smoothedCount,
-        const double learnRatePerSample, const double meanMomentum, const double varMomentum, bool unitGainMomentum = true);
+        const double learnRatePerSample, const double meanMomentum, const double varMomentum, bool unitGainMomentum = true,
+        bool lazy = false, Matrix<ElemType>* lazyUpdateSteps = nullptr);
 
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
     void AdaDeltaUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionvalues, ElemType learningRatePerSample, ElemType rho, ElemType epsilon);
 
+    // multi-tensor updates of a list of dense parameters on one device, see MultiTensorItem
+    static void MultiTensorUpdate(DEVICEID_TYPE deviceId, MultiTensorUpdateType type, const std::vector<MultiTensorItem<ElemType>>& items,
+                                  ElemType momentum, ElemType varMomentum, bool unitGainMomentum);
+    // [k] the sum of the squares of the elements of items[k].gradient (unscaled); not finite if one of them is not
+    static void MultiTensorSumOfSquares(DEVICEID_TYPE deviceId, const std::vector<MultiTensorItem<ElemType>>& items, std::vector<double>& sumsOfSquares);
+    // whether a multi-tensor update on deviceId can use Data() of this matrix: dense, with its only copy on deviceId
+    bool IsMultiTensorOperand(DEVICEID_TYPE deviceId) const;
+
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other) // TODO: Should this carry over numNZElemToReserve for sparse matrices?
     {
@@ -266,6 +282,8 @@ public:
     void SetValue      (const Matrix<ElemType>& deepCopyFrom);
     // AssignValuesOf respects the target matrix's information. It copies the values from the target into the memory of the source.
     void AssignValuesOf(const Matrix<ElemType>& deepCopyFrom);
+    // AssignValuesFromDevice does the same for a source on another device, without moving either matrix. The target is dense.
+    void AssignValuesFromDevice(const Matrix<ElemType>& source);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, const size_t matrixFlags = matrixFlagNormal, DataTransferer* transferer = nullptr);
     void SetValue(const size_t rIdx, const size_t cIdx, ElemType val); // set matrix sparsely
     void SetValue(const size_t numRows, const size_t numCols, std::initializer_list<ElemType> l) // SetValue(2,3, {1,2,3,  4,5,6});
@@ -283,8 +301,20 @@ public:
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
         const size_t nz, const size_t numRows, const size_t numCols, DataTransferer* transferer = nullptr);
 
+    // Access to the columns of a sparse block-column matrix (e.g. the gradient of an embedding) through the CPU:
+    // the ids of the non-zero columns and their values, column by column.
+    size_t CopyBlockColumnsToCPU(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const; // returns the number of columns
+    void SetBlockColumnsFromCPU(const size_t* columnIds, const ElemType* values, size_t numColumns);
+
     void MaskColumnsValue(const Matrix<char>& columnsMask, ElemType val, size_t numColsPerMaskEntry);
 
+    // Converts a matrix of bytes (read as unsigned, e.g. 8 bit image data) into this one, normalizing each element
+    // to (byte - mean) * scale in the same pass. Used to expand compact input data after the transfer to the device.
+    void AssignNormalizedBytesOf(const Matrix<char>& bytes, ElemType mean, ElemType scale);
+    // The same for images, which are cropped, scaled, flipped and jittered on the way (see ImageAugmentation.h).
+    // The columns are images firstImage, firstImage + 1, ... of the random stream of the augmentation.
+    void AssignAugmentedImagesOf(const Matrix<char>& bytes, const ImageAugmentation& augmentation, uint64_t firstImage);
+
     void SetColumn(const ElemType* colPointer, size_t colInd);
     void SetColumn(const ElemType val, size_t colInd);
     void SetColumn(const Matrix<ElemType>& valMat, size_t colInd);
@@ -294,6 +324,10 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    // dropout with a counter-based mask (Philox.h): element k of the mask is 0 with probability maskRate and scaleValue otherwise,
+    // a pure function of (seed, offset + k), so the same mask can be applied again later (e.g. in backprop) without storing it
+    Matrix<ElemType>& AssignCounterBasedDropoutOf(const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset);
+    Matrix<ElemType>& AddCounterBasedDropoutOf(const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     Matrix<ElemType>& AssignNoiseContrastiveEstimation(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias, Matrix<ElemType>& tmp);
 
@@ -308,6 +342,9 @@ public:
 
     Matrix<ElemType>& DoGatherColumnsOf (ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha);
     Matrix<ElemType>& DoScatterColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha);
+    Matrix<ElemType>& DoGatherRowsOf   (ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha);
+    Matrix<ElemType>& AssignPackedIndicesOf(const Matrix<ElemType>* timeIndices, size_t numParallelSequences, size_t numTimeSteps,
+                                            const std::vector<PackedSequenceRange>& sequences, size_t targetStride);
 
     Matrix<ElemType>& operator+=(const ElemType alpha);
     Matrix<ElemType>  operator+(const ElemType alpha) const;
@@ -375,6 +412,16 @@ public:
     Matrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     Matrix<ElemType>& AssignLogSoftmaxOf(const Matrix<ElemType>& a, const bool isColWise);
 
+    // fused column-wise softmax + cross entropy without materializing the softmax (dense only)
+    // [this] (1x1) = -sum_j labels(:,j)' * logSoftmax(input(:,j)); logSumExp (1 x T) receives the per-column log(sum(exp(input)))
+    Matrix<ElemType>& AssignSoftmaxCrossEntropyOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& input, Matrix<ElemType>& logSumExp);
+    // inputGradient += gradient * (softmax(input) - labels), gradient being 1x1
+    static void AddSoftmaxCrossEntropyGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& labels, const Matrix<ElemType>& input,
+                                               const Matrix<ElemType>& logSumExp, Matrix<ElemType>& inputGradient);
+    // labelsGradient -= gradient * logSoftmax(input)
+    static void AddSoftmaxCrossEntropyLabelGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& input,
+                                                    const Matrix<ElemType>& logSumExp, Matrix<ElemType>& labelsGradient);
+
     Matrix<ElemType>& InplaceHardmax(const bool isColWise);
     Matrix<ElemType>& AssignHardmaxOf(const Matrix<ElemType>& a, const bool isColWise);
 
@@ -469,6 +516,8 @@ public:
     void VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise) const;
     void VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise, int topK) const;
     void VectorMin(Matrix<ElemType>& minIndexes, Matrix<ElemType>& minValues, const bool isColWise) const;
+    // the largest k values of each column (or row), sorted descending, and their indices
+    void TopK(Matrix<ElemType>& topKValues, Matrix<ElemType>& topKIndices, size_t k, const bool isColWise = true) const;
 
     Matrix<ElemType>& AssignNumOfDiff(const Matrix<ElemType>& a, const Matrix<ElemType>& b, bool searchInCol = false);
 
@@ -516,6 +565,10 @@ public:
     void ConvolutionBackwardKernel(const Matrix<ElemType>& in, const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIwht,
                                    const Matrix<int>& mpRowRun, const Matrix<int>& runs, Matrix<ElemType>& kernelGrad) const;
 
+    void DepthwiseConvolutionForward(const Matrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, Matrix<ElemType>& output) const;
+    void DepthwiseConvolutionBackwardData(const Matrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, Matrix<ElemType>& grad) const;
+    void DepthwiseConvolutionBackwardKernel(const Matrix<ElemType>& in, const DepthwiseConvolutionShape& shape, Matrix<ElemType>& kernelGrad) const;
+
     void UnrollConvolutionInput(size_t unrollCols, size_t mapOutSize, const Matrix<int>& mpRowCol,
                                 const Matrix<int>& mpRowRun, const Matrix<int>& runs, Matrix<ElemType>& output) const;
     void UnrollConvolutionOutput(size_t unrollCols, size_t mapInCount, size_t mapOutCount, const Matrix<int>& mpRowCol,
@@ -527,6 +580,8 @@ public:
     void MaxPoolingBackward(const Matrix<ElemType>& out, const Matrix<ElemType>& in,
                             const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices,
                             Matrix<ElemType>& grad) const;
+    void MaxPoolingForwardWithArgmax(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, Matrix<ElemType>& output, Matrix<short>& argmax) const;
+    void MaxPoolingBackwardWithArgmax(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, const Matrix<short>& argmax, Matrix<ElemType>& grad) const;
 
     void ROIPoolingForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
                            const size_t pooledWidth, const size_t pooledHeight, const Matrix<ElemType>& roiData, Matrix<ElemType>& output, Matrix<ElemType>& argmax) const;
@@ -566,6 +621,10 @@ public:
     static void Multiply(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c);
+    // batched SGEMM: c_i = alpha * op(a_i) * op(b_i) + beta * c_i for i < batchSize, where x_i is the i-th of batchSize equally wide blocks
+    // of columns of x, or all of x for all i if broadcastX. One call for many small products of the same shape; dense matrices only.
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c,
+                                            size_t batchSize, bool broadcastA = false, bool broadcastB = false);
     static void ConvolveAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, size_t numChannels, size_t horizontalSubsample, bool padding, bool channelwise);
 
     static void ColumnwiseScaleAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& v, ElemType beta, Matrix<ElemType>& c);
@@ -612,10 +671,19 @@ public:
                      const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                      const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
 
+    // evaluates 'program' on up to ElementwiseProgram::MaxInputs inputs in one pass; no reduction
+    void TensorProgramOp(ElemType beta, const std::array<const Matrix<ElemType>*, ElementwiseProgram::MaxInputs>& inputs, ElemType alpha, const ElementwiseProgram& program,
+                         const std::array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                         const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides);
+
 public:
     void Read(File& stream);
     void Write(File& stream) const;
 
+    // Reads the header of a dense matrix written by Write() to a binary file, and skips its elements, which start at
+    // 'elementsPosition' in the file. Returns false, without reading anything, if the matrix is not dense.
+    static bool ReadDenseHeader(File& stream, size_t& numRows, size_t& numCols, uint64_t& elementsPosition);
+
     Matrix<ElemType>& Shift(const Matrix<ElemType>& a, int shift);
 
     Matrix<ElemType>& AssignElementProductOfWithShiftNeg(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift, size_t negnumber);
@@ -638,6 +706,18 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    // for LambdaRank and NDCG: the samples (columns) are in groups of consecutive columns, e.g. the documents of one query,
+    // each group in descending order of gains. groupStarts (1 x (numGroups + 1)) holds the first column of each group and
+    // the total number of columns. truncation > 0 restricts the DCG and the lambdas to the first 'truncation' positions.
+    // RankWithinGroups() ranks the samples of each group by descending score, lower gain first at equal score, and
+    // computes the DCG of each group at these ranks and at the ideal ranks (position within the group).
+    static void RankWithinGroups(const Matrix<ElemType>& scores, const Matrix<ElemType>& gains, const Matrix<ElemType>& groupStarts, size_t truncation,
+                                 Matrix<ElemType>& ranks, Matrix<ElemType>& dcgs, Matrix<ElemType>& idealDCGs);
+    // adds the lambda gradient to 'gradient': for each pair (i, j) of a group with gain i > gain j,
+    // lambda = -sigma / (1 + exp(sigma (score i - score j))) |delta NDCG of swapping i and j|, added to i, subtracted from j
+    static void AddLambdaRankGradient(const Matrix<ElemType>& scores, const Matrix<ElemType>& gains, const Matrix<ElemType>& ranks, const Matrix<ElemType>& groupStarts,
+                                      const Matrix<ElemType>& idealDCGs, ElemType sigma, size_t truncation, Matrix<ElemType>& gradient);
+
     template <typename T>
     friend class MatrixQuantizer;
 
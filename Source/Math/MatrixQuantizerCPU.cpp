@@ -105,6 +105,43 @@ void MatrixQuantizerCPU<ElemType>::WaitUnquantizeAsyncDone()
     // TODO: Currently this is a no-op since the actual quantization is synchronous
 }
 
+// the matrices of a batch are quantized in place in the batch buffer, one after the other
+template <class ElemType>
+void MatrixQuantizerCPU<ElemType>::QuantizeBatchAsync(const std::vector<const Matrix<ElemType>*>& inMatrices, const std::vector<const Matrix<ElemType>*>& inResiduals, QuantizedMatrixBatch<ElemType>& outQBatch, const std::vector<Matrix<ElemType>*>& outResiduals, bool zeroThresholdFor1Bit)
+{
+    if ((inMatrices.size() != outQBatch.GetNumMatrices()) || (inResiduals.size() != outQBatch.GetNumMatrices()) || (outResiduals.size() != outQBatch.GetNumMatrices()))
+        LogicError("QuantizeBatchAsync: The number of matrices does not match the quantized batch.");
+
+    for (size_t i = 0; i < inMatrices.size(); i++)
+    {
+        auto outQMatrix = outQBatch.GetMatrix(i);
+        QuantizeAsync(*inMatrices[i], *inResiduals[i], outQMatrix, *outResiduals[i], zeroThresholdFor1Bit);
+    }
+}
+
+template <class ElemType>
+void MatrixQuantizerCPU<ElemType>::UnquantizeBatchAsync(QuantizedMatrixBatch<ElemType>& inQBatch, const std::vector<Matrix<ElemType>*>& outMatrices, bool add /*= false*/)
+{
+    if (outMatrices.size() != inQBatch.GetNumMatrices())
+        LogicError("UnquantizeBatchAsync: The number of matrices does not match the quantized batch.");
+
+    for (size_t i = 0; i < outMatrices.size(); i++)
+    {
+        auto inQMatrix = inQBatch.GetMatrix(i);
+        UnquantizeAsync(inQMatrix, *outMatrices[i], add);
+    }
+}
+
+template <class ElemType>
+void MatrixQuantizerCPU<ElemType>::UnquantizeSumAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix, bool add /*= false*/)
+{
+    if (inQMatrices.empty() && !add)
+        outMatrix.SetValue(0);
+
+    for (size_t k = 0; k < inQMatrices.size(); k++)
+        UnquantizeAsync(*inQMatrices[k], outMatrix, add || (k > 0));
+}
+
 //The explicit instantiation part will make the linker happy
 template class MatrixQuantizerCPU<float>;
 template class MatrixQuantizerCPU<double>;
@@ -33,5 +33,9 @@ public:
 
     void UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add = false) override;
     void WaitUnquantizeAsyncDone() override;
+
+    void QuantizeBatchAsync(const std::vector<const Matrix<ElemType>*>& inMatrices, const std::vector<const Matrix<ElemType>*>& inResiduals, QuantizedMatrixBatch<ElemType>& outQBatch, const std::vector<Matrix<ElemType>*>& outResiduals, bool zeroThresholdFor1Bit) override;
+    void UnquantizeBatchAsync(QuantizedMatrixBatch<ElemType>& inQBatch, const std::vector<Matrix<ElemType>*>& outMatrices, bool add = false) override;
+    void UnquantizeSumAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix, bool add = false) override;
 };
 } } }
@@ -178,11 +178,49 @@ QuantizedMatrix<ElemType>& MatrixQuantizerGPU<ElemType>::GetTempGPUQuantizedMatr
     return *m_tempGPUQuantizedMatrix;
 }
 
+template <class ElemType>
+char* MatrixQuantizerGPU<ElemType>::GetTempGPUBuffer(size_t size, bool& newlyAllocated)
+{
+    newlyAllocated = false;
+    if ((m_tempGPUBuffer != nullptr) && (m_tempGPUBuffer->GetNumElements() >= size))
+    {
+        return m_tempGPUBuffer->Data();
+    }
+
+    delete m_tempGPUBuffer;
+    m_tempGPUBuffer = new Matrix<char>(size, 1, (short) this->GetDeviceId());
+    newlyAllocated = true;
+
+    return m_tempGPUBuffer->Data();
+}
+
+template <class ElemType>
+const void* MatrixQuantizerGPU<ElemType>::UploadBatchEntries(const void* entries, size_t size)
+{
+    if ((m_batchEntriesGPU == nullptr) || (m_batchEntriesGPU->GetNumElements() < size))
+    {
+        delete m_batchEntriesGPU;
+        m_batchEntriesGPU = new Matrix<char>(size, 1, (short) this->GetDeviceId());
+
+        // the zeroing of the new buffer on the main compute stream must not overwrite the entries
+        if (GetComputeStream() != GetStream())
+        {
+            cudaEventRecord(m_tempMatrixZeroingCompleteEvent, GetStream()) || "cudaEventRecord failed";
+            cudaStreamWaitEvent(GetComputeStream(), m_tempMatrixZeroingCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+        }
+    }
+
+    // The entries are in pageable memory, which cudaMemcpyAsync() has staged when it returns. Being on the compute
+    // stream, the copy does not overwrite the entries of a batched kernel that has not run yet.
+    cudaMemcpyAsync(m_batchEntriesGPU->Data(), entries, size, cudaMemcpyHostToDevice, GetComputeStream()) || "cudaMemcpyAsync failed";
+    return m_batchEntriesGPU->Data();
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///cpubuffer should be page-locked memory allocated, otherwise CUDA will not be efficient (hence we don't use STL)
 template <class ElemType>
 MatrixQuantizerGPU<ElemType>::MatrixQuantizerGPU(int deviceId, bool useDedicatedComputeStream, bool forceSync /*= false*/)
-    : MatrixQuantizerImpl<ElemType>(deviceId), m_quantizeCompleteEvent(NULL), m_fetchCompleteEvent(NULL), m_tempMatrixZeroingCompleteEvent(NULL), m_assignCompleteEvent(NULL), m_forceSync(forceSync), m_tempGPUQuantizedMatrix(nullptr), m_quantizeOpIncludedFetch(false)
+    : MatrixQuantizerImpl<ElemType>(deviceId), m_quantizeCompleteEvent(NULL), m_fetchCompleteEvent(NULL), m_tempMatrixZeroingCompleteEvent(NULL), m_assignCompleteEvent(NULL), m_forceSync(forceSync), m_tempGPUQuantizedMatrix(nullptr), m_tempGPUBuffer(nullptr), m_batchEntriesGPU(nullptr), m_quantizeOpIncludedFetch(false)
 {
     PrepareDevice(this->GetDeviceId());
 
@@ -215,6 +253,9 @@ MatrixQuantizerGPU<ElemType>::~MatrixQuantizerGPU()
         m_tempGPUQuantizedMatrix = nullptr;
     }
 
+    delete m_tempGPUBuffer;
+    delete m_batchEntriesGPU;
+
     // BUGBUG: we don't destroy our streams (they are static variables); we need a static destructor, I am too lazy now
     // TODO: Check for error code and throw if !std::uncaught_exception()
     cudaEventDestroy(m_assignCompleteEvent);
@@ -340,6 +381,213 @@ void MatrixQuantizerGPU<ElemType>::WaitUnquantizeAsyncDone()
     SyncEvent(m_quantizeCompleteEvent);
 }
 
+template <class ElemType>
+void MatrixQuantizerGPU<ElemType>::QuantizeBatchAsync(const std::vector<const Matrix<ElemType>*>& inMatrices, const std::vector<const Matrix<ElemType>*>& inResiduals, QuantizedMatrixBatch<ElemType>& outQBatch, const std::vector<Matrix<ElemType>*>& outResiduals, bool zeroThresholdFor1Bit)
+{
+    const size_t numMatrices = outQBatch.GetNumMatrices();
+    if ((inMatrices.size() != numMatrices) || (inResiduals.size() != numMatrices) || (outResiduals.size() != numMatrices))
+        LogicError("QuantizeBatchAsync: The number of matrices does not match the quantized batch.");
+
+    size_t nBits = outQBatch.GetNumBits();
+
+    PrepareDevice(this->GetDeviceId());
+    if (m_forceSync)
+    {
+        Sync();
+    }
+
+    bool GPUBufferNewlyAllocated = false;
+    char* outQBufferGPU = (outQBatch.GetDeviceId() == CPUDEVICE) ? GetTempGPUBuffer(outQBatch.GetSize(), GPUBufferNewlyAllocated) : outQBatch.Buffer();
+
+    // see QuantizeAsync()
+    if (GPUBufferNewlyAllocated && (GetComputeStream() != GetStream()))
+    {
+        cudaEventRecord(m_tempMatrixZeroingCompleteEvent, GetStream()) || "cudaEventRecord failed";
+        cudaStreamWaitEvent(GetComputeStream(), m_tempMatrixZeroingCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+    }
+
+    std::vector<QuantizedMatrixBatchEntry<ElemType>> entries(numMatrices);
+    size_t totalCols = 0;
+    size_t totalQWords = 0;
+    for (size_t i = 0; i < numMatrices; i++)
+    {
+        const size_t nRow = outQBatch.GetNumRows(i);
+        const size_t nCol = outQBatch.GetNumCols(i);
+
+        // Verify various input matrix parameter's dimensions
+        assert((inMatrices[i]->GetNumRows() == nRow) && (inMatrices[i]->GetNumCols() == nCol));
+        assert((inResiduals[i]->GetNumRows() == nRow) && (inResiduals[i]->GetNumCols() == nCol));
+        assert((outResiduals[i]->GetNumRows() == nRow) && (outResiduals[i]->GetNumCols() == nCol));
+
+        auto& entry = entries[i];
+        entry.us = inMatrices[i]->Data();
+        entry.curResidual = inResiduals[i]->Data();
+        entry.newResidual = outResiduals[i]->Data();
+        entry.M = (long) nRow;
+        entry.N = (long) nCol;
+        entry.qOffset = outQBatch.GetOffset(i);
+        entry.qColSize = QuantizedColumn<ElemType>::QuantizedColumnSize(nBits, nRow);
+        entry.numQWordsPerCol = ColumnQuantizer<ElemType>::QWordsPerCol(nRow, nBits);
+        entry.firstCol = totalCols;
+        entry.firstQWord = totalQWords;
+        totalCols += nCol;
+        totalQWords += nCol * entry.numQWordsPerCol;
+    }
+
+    // Do the quantization of all matrices on the compute stream and insert event into stream
+    if (totalCols > 0)
+    {
+        auto entriesGPU = (const QuantizedMatrixBatchEntry<ElemType>*) UploadBatchEntries(entries.data(), entries.size() * sizeof(entries[0]));
+        _QuantizeMatrixBatch<ElemType>(entriesGPU, numMatrices, totalCols, totalQWords, outQBufferGPU, nBits, GetComputeStream(), zeroThresholdFor1Bit);
+    }
+
+    RecordQuantizeCompleteEvent(GetComputeStream());
+
+    // copy the whole batch from gpu to cpu if needed
+    m_quantizeOpIncludedFetch = false;
+    if (outQBatch.GetDeviceId() == CPUDEVICE)
+    {
+        SyncQuantizeCompleEventAndFetchAndRecordFetchCompleteEvent(outQBatch.Buffer(), outQBufferGPU, outQBatch.GetSize());
+        m_quantizeOpIncludedFetch = true;
+    }
+}
+
+template <class ElemType>
+void MatrixQuantizerGPU<ElemType>::UnquantizeBatchAsync(QuantizedMatrixBatch<ElemType>& inQBatch, const std::vector<Matrix<ElemType>*>& outMatrices, bool add /*= false*/)
+{
+    const size_t numMatrices = inQBatch.GetNumMatrices();
+    if (outMatrices.size() != numMatrices)
+        LogicError("UnquantizeBatchAsync: The number of matrices does not match the quantized batch.");
+
+    PrepareDevice(this->GetDeviceId());
+
+    size_t nBits = inQBatch.GetNumBits();
+
+    bool GPUBufferNewlyAllocated = false;
+    char* inQBufferGPU = (inQBatch.GetDeviceId() == CPUDEVICE) ? GetTempGPUBuffer(inQBatch.GetSize(), GPUBufferNewlyAllocated) : inQBatch.Buffer();
+
+    // see UnquantizeAsync()
+    if (inQBatch.GetDeviceId() == CPUDEVICE)
+    {
+        if (GPUBufferNewlyAllocated)
+        {
+            cudaEventRecord(m_tempMatrixZeroingCompleteEvent, GetStream()) || "cudaEventRecord failed";
+            cudaStreamWaitEvent(GetAssignStream(), m_tempMatrixZeroingCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+        }
+
+        cudaMemcpyAsync(inQBufferGPU, inQBatch.Buffer(), inQBatch.GetSize(), cudaMemcpyHostToDevice, GetAssignStream()) || "cudaMemcpyAsync failed";
+        cudaEventRecord(m_assignCompleteEvent, GetAssignStream()) || "cudaEventRecord failed";
+
+        if (m_forceSync)
+        {
+            SyncStream(GetAssignStream());
+        }
+
+        SyncAssignCompleteEvent(GetComputeStream());
+    }
+
+    std::vector<QuantizedMatrixBatchEntry<ElemType>> entries(numMatrices);
+    size_t totalQWords = 0;
+    for (size_t i = 0; i < numMatrices; i++)
+    {
+        const size_t nRow = inQBatch.GetNumRows(i);
+        const size_t nCol = inQBatch.GetNumCols(i);
+
+        // The outMatrices should be on the same GPU as the quantizer
+        assert(outMatrices[i]->GetDeviceId() == this->GetDeviceId());
+        assert((outMatrices[i]->GetNumRows() == nRow) && (outMatrices[i]->GetNumCols() == nCol));
+
+        auto& entry = entries[i];
+        entry.us = outMatrices[i]->Data();
+        entry.curResidual = nullptr;
+        entry.newResidual = nullptr;
+        entry.M = (long) nRow;
+        entry.N = (long) nCol;
+        entry.qOffset = inQBatch.GetOffset(i);
+        entry.qColSize = QuantizedColumn<ElemType>::QuantizedColumnSize(nBits, nRow);
+        entry.numQWordsPerCol = ColumnQuantizer<ElemType>::QWordsPerCol(nRow, nBits);
+        entry.firstCol = 0; // not used by unquantization
+        entry.firstQWord = totalQWords;
+        totalQWords += nCol * entry.numQWordsPerCol;
+    }
+
+    if (totalQWords > 0)
+    {
+        auto entriesGPU = (const QuantizedMatrixBatchEntry<ElemType>*) UploadBatchEntries(entries.data(), entries.size() * sizeof(entries[0]));
+        _UnquantizeMatrixBatch<ElemType>(entriesGPU, numMatrices, totalQWords, inQBufferGPU, nBits, add, GetComputeStream());
+    }
+
+    // Record the event of unquantization
+    RecordQuantizeCompleteEvent(GetComputeStream());
+}
+
+template <class ElemType>
+void MatrixQuantizerGPU<ElemType>::UnquantizeSumAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix, bool add /*= false*/)
+{
+    // The outMatrix should be on the same GPU as m_inMatrix
+    assert(outMatrix.GetDeviceId() == this->GetDeviceId());
+
+    PrepareDevice(this->GetDeviceId());
+
+    if (inQMatrices.empty())
+    {
+        if (!add)
+            cudaMemsetAsync(outMatrix.Data(), 0, outMatrix.GetNumElements() * sizeof(ElemType), GetComputeStream()) || "cudaMemsetAsync failed";
+        RecordQuantizeCompleteEvent(GetComputeStream());
+        return;
+    }
+
+    const size_t nBits = inQMatrices[0]->GetNumBits();
+    const size_t qSize = inQMatrices[0]->GetSize();
+    const bool onCPU = (inQMatrices[0]->GetDeviceId() == CPUDEVICE);
+    for (auto inQMatrix : inQMatrices)
+    {
+        if ((inQMatrix->GetNumBits() != nBits) || (inQMatrix->GetNumRows() != outMatrix.GetNumRows()) || (inQMatrix->GetNumCols() != outMatrix.GetNumCols()))
+            LogicError("UnquantizeSumAsync: The quantized matrices must all have the bits and dimensions of the output matrix.");
+        if ((inQMatrix->GetDeviceId() == CPUDEVICE) != onCPU)
+            LogicError("UnquantizeSumAsync: The quantized matrices must be either all on the CPU or all on the GPU.");
+    }
+
+    // Matrices received into CPU memory are assigned to the GPU back to back, in one buffer.
+    std::vector<const char*> packages(inQMatrices.size());
+    if (onCPU)
+    {
+        bool GPUBufferNewlyAllocated = false;
+        char* inQBufferGPU = GetTempGPUBuffer(qSize * inQMatrices.size(), GPUBufferNewlyAllocated);
+        if (GPUBufferNewlyAllocated)
+        {
+            cudaEventRecord(m_tempMatrixZeroingCompleteEvent, GetStream()) || "cudaEventRecord failed";
+            cudaStreamWaitEvent(GetAssignStream(), m_tempMatrixZeroingCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+        }
+
+        for (size_t k = 0; k < inQMatrices.size(); k++)
+        {
+            packages[k] = inQBufferGPU + k * qSize;
+            cudaMemcpyAsync(inQBufferGPU + k * qSize, inQMatrices[k]->Buffer(), qSize, cudaMemcpyHostToDevice, GetAssignStream()) || "cudaMemcpyAsync failed";
+        }
+
+        cudaEventRecord(m_assignCompleteEvent, GetAssignStream()) || "cudaEventRecord failed";
+
+        if (m_forceSync)
+        {
+            SyncStream(GetAssignStream());
+        }
+
+        SyncAssignCompleteEvent(GetComputeStream());
+    }
+    else
+    {
+        for (size_t k = 0; k < inQMatrices.size(); k++)
+            packages[k] = inQMatrices[k]->Buffer();
+    }
+
+    auto packagesGPU = (const char* const*) UploadBatchEntries(packages.data(), packages.size() * sizeof(packages[0]));
+    _UnquantizeSumMatrix<ElemType>(packagesGPU, packages.size(), outMatrix.Data(), (long) outMatrix.GetNumRows(), (long) outMatrix.GetNumCols(), nBits, add, GetComputeStream());
+
+    // Record the event of unquantization
+    RecordQuantizeCompleteEvent(GetComputeStream());
+}
+
 //explicit
 template class MatrixQuantizerGPU<float>;
 template class MatrixQuantizerGPU<double>;
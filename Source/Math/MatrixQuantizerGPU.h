@@ -29,10 +29,20 @@ public:
     void UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add = false) override;
     void WaitUnquantizeAsyncDone() override;
 
+    void QuantizeBatchAsync(const std::vector<const Matrix<ElemType>*>& inMatrices, const std::vector<const Matrix<ElemType>*>& inResiduals, QuantizedMatrixBatch<ElemType>& outQBatch, const std::vector<Matrix<ElemType>*>& outResiduals, bool zeroThresholdFor1Bit) override;
+    void UnquantizeBatchAsync(QuantizedMatrixBatch<ElemType>& inQBatch, const std::vector<Matrix<ElemType>*>& outMatrices, bool add = false) override;
+    void UnquantizeSumAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix, bool add = false) override;
+
 private:
     // Helper function to get a temporary intermediate matrix on the GPU to store quantization results
     QuantizedMatrix<ElemType>& GetTempGPUQuantizedMatrix(size_t numRows, size_t numCols, size_t nBits, bool& newlyAllocated);
 
+    // Same for batches and for the received matrices of UnquantizeSumAsync(), which are all kept in one buffer
+    char* GetTempGPUBuffer(size_t size, bool& newlyAllocated);
+
+    // Copies the per-matrix parameters of a batched kernel to the GPU, in order on the compute stream
+    const void* UploadBatchEntries(const void* entries, size_t size);
+
 #ifndef CPUONLY
     // Record a event to flag the completion of quantization/unquantization kernel on the compute stream
     void RecordQuantizeCompleteEvent(cudaStream_t computestream) const;
@@ -79,6 +89,10 @@ private:
 
     // A temporary intermediate QuantizedMatrix buffer on the GPU
     QuantizedMatrix<ElemType>* m_tempGPUQuantizedMatrix;
+
+    // The same for batches, and the per-matrix parameters of the batched kernels
+    Matrix<char>* m_tempGPUBuffer;
+    Matrix<char>* m_batchEntriesGPU;
 };
 
 // This type records and synchronizes events on the main
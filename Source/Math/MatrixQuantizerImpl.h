@@ -33,6 +33,15 @@ public:
     virtual void UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add = false) = 0;
     virtual void WaitUnquantizeAsyncDone() = 0;
 
+    // Batched versions of the above, for all matrices of a QuantizedMatrixBatch at once, with one kernel launch
+    // per step and one transfer instead of one of each per matrix. They complete with the Wait...AsyncDone() above.
+    virtual void QuantizeBatchAsync(const std::vector<const Matrix<ElemType>*>& inMatrices, const std::vector<const Matrix<ElemType>*>& inResiduals, QuantizedMatrixBatch<ElemType>& outQBatch, const std::vector<Matrix<ElemType>*>& outResiduals, bool zeroThresholdFor1Bit) = 0;
+    virtual void UnquantizeBatchAsync(QuantizedMatrixBatch<ElemType>& inQBatch, const std::vector<Matrix<ElemType>*>& outMatrices, bool add = false) = 0;
+
+    // Unquantizes the quantized matrices received from all workers and sums them up in one pass,
+    // i.e. outMatrix = (add ? outMatrix : 0) + sum of the unquantized inQMatrices
+    virtual void UnquantizeSumAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix, bool add = false) = 0;
+
     int GetDeviceId() const
     {
         return m_deviceId;
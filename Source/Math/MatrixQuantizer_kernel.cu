@@ -302,6 +302,171 @@ void _UnquantizeMatrix(const char* gpuBuffer, size_t gpuBufferSize,
     ParallelizeOverRangeDim(totalQWords, griddim, blockdim, 256);
     UnquantizeStripejOneQWord<<<griddim, blockdim, 0, stream>>>(us, M, N, gpuBuffer, colsize, numQWordsPerCol, ldNbits, add);
 }
+
+// =======================================================================
+// batched quantization
+// =======================================================================
+
+// One matrix of a QuantizedMatrixBatch. The batched kernels run over the columns (statistics) or
+// QWords (quantization) of all matrices at once; a thread finds its matrix by its global index.
+template <class ElemType>
+struct QuantizedMatrixBatchEntry
+{
+    ElemType* us;          // input of quantization, output of unquantization
+    ElemType* curResidual; // quantization only
+    ElemType* newResidual; // quantization only
+    long M;
+    long N;
+    size_t qOffset;         // of the matrix in the batch buffer
+    size_t qColSize;
+    size_t numQWordsPerCol;
+    size_t firstCol;        // index of its first column over all matrices
+    size_t firstQWord;      // index of its first QWord over all matrices
+};
+
+// the last entry whose first column (QWord) is not after 'index'; matrices without columns are skipped that way
+template <class ElemType, bool ByColumn>
+__device__ __inline__ static const QuantizedMatrixBatchEntry<ElemType>& FindBatchEntry(const QuantizedMatrixBatchEntry<ElemType>* entries, size_t numEntries, size_t index)
+{
+    size_t lo = 0;
+    size_t hi = numEntries;
+    while (hi - lo > 1)
+    {
+        const size_t mid = (lo + hi) / 2;
+        const size_t first = ByColumn ? entries[mid].firstCol : entries[mid].firstQWord;
+        if (first <= index)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return entries[lo];
+}
+
+// one column per block, as _ComputeQuantiStatParj()
+template <class ElemType, bool ZeroThresholdFor1Bit>
+__global__ void _ComputeQuantiStatParjBatch(const QuantizedMatrixBatchEntry<ElemType>* entries, size_t numEntries, size_t ldNbits, char* qBuffer)
+{
+    size_t subset = threadIdx.x;
+    const auto& e = FindBatchEntry<ElemType, true>(entries, numEntries, blockIdx.x);
+    size_t j = blockIdx.x - e.firstCol;
+
+    size_t bits = 1 << ldNbits;
+    auto& qcol = *(Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &qBuffer[e.qOffset + e.qColSize * j];
+
+    Microsoft::MSR::CNTK::ColumnQuantizer<ElemType>::ComputeRangeStatColjSubset<ZeroThresholdFor1Bit>(e.us, e.curResidual, e.M, j, bits, qcol.lower, qcol.upper,
+                                                                                                      subset, REDUCTION_BLOCK_SIZE, allreduce<ElemType, REDUCTION_BLOCK_SIZE>, allreduce<unsigned int, REDUCTION_BLOCK_SIZE>);
+}
+
+// one QWord per thread, as _QuantizeStripjOneQWord()
+template <class ElemType, bool ZeroThresholdFor1Bit>
+__global__ void _QuantizeStripjOneQWordBatch(const QuantizedMatrixBatchEntry<ElemType>* entries, size_t numEntries, size_t totalQWords, size_t ldNbits, char* qBuffer)
+{
+    const size_t linindex = ParallelizeOverRangeIndex();
+    if (linindex >= totalQWords)
+        return;
+
+    const auto& e = FindBatchEntry<ElemType, false>(entries, numEntries, linindex);
+    const size_t j = (linindex - e.firstQWord) / e.numQWordsPerCol;
+    const size_t iQWord = (linindex - e.firstQWord) % e.numQWordsPerCol;
+
+    auto& qCol = *(Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &qBuffer[e.qOffset + e.qColSize * j];
+    const Microsoft::MSR::CNTK::ColumnQuantizer<ElemType> q(ldNbits, qCol.lower, qCol.upper);
+    qCol.bits[iQWord] = q.QuantizeOneQWord<ZeroThresholdFor1Bit>(e.us, e.curResidual, e.M, iQWord, e.M, e.numQWordsPerCol, j, e.newResidual);
+}
+
+template <class ElemType>
+__global__ void UnquantizeStripejOneQWordBatch(const QuantizedMatrixBatchEntry<ElemType>* entries, size_t numEntries, size_t totalQWords, size_t ldNbits, const char* qBuffer, bool add)
+{
+    const size_t linindex = ParallelizeOverRangeIndex();
+    if (linindex >= totalQWords)
+        return;
+
+    const auto& e = FindBatchEntry<ElemType, false>(entries, numEntries, linindex);
+    const size_t j = (linindex - e.firstQWord) / e.numQWordsPerCol;
+    const size_t iQWord = (linindex - e.firstQWord) % e.numQWordsPerCol;
+
+    const auto& qcol = *(const Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &qBuffer[e.qOffset + e.qColSize * j];
+    Microsoft::MSR::CNTK::ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
+    q.UnquantizeOneQWord(e.us, e.M, iQWord, e.M, e.numQWordsPerCol, j, qcol.bits[iQWord], add);
+}
+
+// unquantizes one QWord of each of the packages, summing them up in the output
+template <class ElemType>
+__global__ void UnquantizeSumStripejOneQWord(ElemType* us, const long M, const long N, const char* const* qpackages, size_t numPackages, size_t colsize, size_t numQWordsPerCol, size_t ldNbits, bool add)
+{
+    const size_t linindex = ParallelizeOverRangeIndex();
+    const size_t j = linindex / numQWordsPerCol;
+    if (j >= N) // out of col range
+        return;
+
+    const size_t iQWord = linindex % numQWordsPerCol;
+    for (size_t k = 0; k < numPackages; k++)
+    {
+        const auto& qcol = *(const Microsoft::MSR::CNTK::QuantizedColumn<ElemType>*) &qpackages[k][colsize * j];
+        Microsoft::MSR::CNTK::ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
+        q.UnquantizeOneQWord(us, M, iQWord, M, numQWordsPerCol, j, qcol.bits[iQWord], add || (k > 0));
+    }
+}
+
+// quantize all matrices of a batch: one launch for the range statistics of all columns and one for all QWords
+template <class ElemType>
+void _QuantizeMatrixBatch(const QuantizedMatrixBatchEntry<ElemType>* gpuEntries, size_t numEntries, size_t totalCols, size_t totalQWords,
+                          char* qBuffer, size_t nBits, cudaStream_t stream, bool zeroThresholdFor1Bit)
+{
+    if (totalCols == 0)
+        return;
+
+    const size_t ldNbits = ValueQuantizer<ElemType>::ld(nBits);
+
+    dim3 mvgriddim = (unsigned int) totalCols;
+    dim3 mvblockdim = REDUCTION_BLOCK_SIZE;
+    if (zeroThresholdFor1Bit)
+        _ComputeQuantiStatParjBatch<ElemType, true><<<mvgriddim, mvblockdim, 0, stream>>>(gpuEntries, numEntries, ldNbits, qBuffer);
+    else
+        _ComputeQuantiStatParjBatch<ElemType, false><<<mvgriddim, mvblockdim, 0, stream>>>(gpuEntries, numEntries, ldNbits, qBuffer);
+
+    if (totalQWords == 0)
+        return;
+
+    dim3 griddim, blockdim;
+    ParallelizeOverRangeDim(totalQWords, griddim, blockdim, 256);
+    if (zeroThresholdFor1Bit)
+        _QuantizeStripjOneQWordBatch<ElemType, true><<<griddim, blockdim, 0, stream>>>(gpuEntries, numEntries, totalQWords, ldNbits, qBuffer);
+    else
+        _QuantizeStripjOneQWordBatch<ElemType, false><<<griddim, blockdim, 0, stream>>>(gpuEntries, numEntries, totalQWords, ldNbits, qBuffer);
+}
+
+template <class ElemType>
+void _UnquantizeMatrixBatch(const QuantizedMatrixBatchEntry<ElemType>* gpuEntries, size_t numEntries, size_t totalQWords,
+                            const char* qBuffer, size_t nBits, bool add, cudaStream_t stream)
+{
+    if (totalQWords == 0)
+        return;
+
+    const size_t ldNbits = ValueQuantizer<ElemType>::ld(nBits);
+    dim3 griddim, blockdim;
+    ParallelizeOverRangeDim(totalQWords, griddim, blockdim, 256);
+    UnquantizeStripejOneQWordBatch<<<griddim, blockdim, 0, stream>>>(gpuEntries, numEntries, totalQWords, ldNbits, qBuffer, add);
+}
+
+// unquantize and sum up several quantized matrices of the same dimensions, e.g. the ones received from all workers
+template <class ElemType>
+void _UnquantizeSumMatrix(const char* const* gpuPackages, size_t numPackages,
+                          ElemType* us, long M, long N,
+                          size_t nBits, bool add, cudaStream_t stream)
+{
+    const size_t ldNbits = ValueQuantizer<ElemType>::ld(nBits);
+    const size_t numQWordsPerCol = ColumnQuantizer<ElemType>::QWordsPerCol(M, nBits);
+    const size_t totalQWords = N * numQWordsPerCol;
+    if (totalQWords == 0)
+        return;
+
+    const size_t colsize = QuantizedColumn<ElemType>::QuantizedColumnSize(nBits, M);
+
+    dim3 griddim, blockdim;
+    ParallelizeOverRangeDim(totalQWords, griddim, blockdim, 256);
+    UnquantizeSumStripejOneQWord<<<griddim, blockdim, 0, stream>>>(us, M, N, gpuPackages, numPackages, colsize, numQWordsPerCol, ldNbits, add);
+}
 }
 }
 }
@@ -7,6 +7,8 @@
 
 #ifdef USE_NCCL
 #include "GPUMatrix.h"
+#include "PerformanceProfiler.h"
+#include <algorithm>
 #include <nccl.h>
 #include <cuda_runtime.h>
 
@@ -19,13 +21,22 @@ static void operator||(cudaError_t rc, const char *msg)
         RuntimeError("%s: %s (cuda error %d)", msg, cudaGetErrorString(rc), (int) rc);
 }
 
-NcclComm::NcclComm(int deviceId, const MPIWrapperPtr& mpi)
-    : m_ncclComm(nullptr), m_stream(nullptr)
+NcclComm::NcclComm(int deviceId, const MPIWrapperPtr& mpi, bool withinHost)
+    : m_ncclComm(nullptr), m_stream(nullptr), m_asyncStream(nullptr), m_computeEvent(nullptr), m_numRanks(0)
 {
-    if (mpi->IsMultiHost())
+    if (mpi->IsMultiHost() && !withinHost)
         return;
 
+    // NCCL cannot report failed ranks, the surviving ranks would hang in it
+    if (mpi->IsFaultTolerant())
+    {
+        fprintf(stderr, "NcclComm: disabled, elastic training needs MPI to detect failed ranks\n");
+        return;
+    }
+
+    // The decision is taken on the devices of all ranks, so that all hosts agree on it.
     size_t numRanks = mpi->NumNodesInUse();
+    const auto& hostIndexOfRanks = mpi->HostIndexOfNodes();
     std::vector<int> allDevs(numRanks);
     mpi->Allgather(&deviceId, 1, MPI_INT, allDevs.data(), 1, MPI_INT);
 
@@ -37,7 +48,7 @@ NcclComm::NcclComm(int deviceId, const MPIWrapperPtr& mpi)
             return;
         }
         for (size_t s = 0; s<r; s++)
-            if (allDevs[r] == allDevs[s])
+            if (allDevs[r] == allDevs[s] && hostIndexOfRanks[r] == hostIndexOfRanks[s])
             {
                 fprintf(stderr, "NcclComm: disabled, same device used by more than one rank\n");
                 return;
@@ -47,24 +58,49 @@ NcclComm::NcclComm(int deviceId, const MPIWrapperPtr& mpi)
     ncclUniqueId ncclId;
     ncclResult_t res;
 
-    res = ncclGetUniqueId(&ncclId);
-    if (res != ncclSuccess)
-        RuntimeError("NcclComm failed to obtain ncclUniqueId: %s", ncclGetErrorString(res));
+    if (!withinHost)
+    {
+        res = ncclGetUniqueId(&ncclId);
+        if (res != ncclSuccess)
+            RuntimeError("NcclComm failed to obtain ncclUniqueId: %s", ncclGetErrorString(res));
 
-    mpi->Bcast(&ncclId, NCCL_UNIQUE_ID_BYTES, MPI_CHAR, 0);
+        mpi->Bcast(&ncclId, NCCL_UNIQUE_ID_BYTES, MPI_CHAR, 0);
+    }
+    else
+    {
+        // Each host uses the id of its lowest rank, the ids are exchanged among all ranks.
+        memset(&ncclId, 0, sizeof(ncclId));
+        if (mpi->CurrentNodeRankOnHost() == 0)
+        {
+            res = ncclGetUniqueId(&ncclId);
+            if (res != ncclSuccess)
+                RuntimeError("NcclComm failed to obtain ncclUniqueId: %s", ncclGetErrorString(res));
+        }
+
+        std::vector<ncclUniqueId> allIds(numRanks);
+        mpi->Allgather(&ncclId, NCCL_UNIQUE_ID_BYTES, MPI_CHAR, allIds.data(), NCCL_UNIQUE_ID_BYTES, MPI_CHAR);
+        size_t hostIndex = hostIndexOfRanks[mpi->CurrentNodeRank()];
+        ncclId = allIds[std::find(hostIndexOfRanks.begin(), hostIndexOfRanks.end(), hostIndex) - hostIndexOfRanks.begin()];
+        numRanks = mpi->NumNodesOnCurrentHost();
+    }
 
     PrepareDevice(deviceId);
-    res = ncclCommInitRank(&m_ncclComm, numRanks, ncclId, mpi->CurrentNodeRank());
+    res = ncclCommInitRank(&m_ncclComm, numRanks, ncclId, withinHost ? mpi->CurrentNodeRankOnHost() : mpi->CurrentNodeRank());
     if (res != ncclSuccess)
       RuntimeError("NcclComm failed to initialize ncclComm_t: %s", ncclGetErrorString(res));
+    m_numRanks = (int)numRanks;
 
     cudaStreamCreateWithFlags(&m_stream, cudaStreamDefault)
         || "cudaStreamCreateWithFlags failed";
-    fprintf(stderr, "NcclComm: initialized\n");
+    fprintf(stderr, "NcclComm: initialized%s\n", withinHost ? " within host" : "");
 }
 
 NcclComm::~NcclComm()
 {
+    if (m_computeEvent != nullptr)
+        cudaEventDestroy(m_computeEvent);
+    if (m_asyncStream != nullptr)
+        cudaStreamDestroy(m_asyncStream);
     if (m_stream != nullptr)
         cudaStreamDestroy(m_stream);
     if (m_ncclComm != nullptr)
@@ -91,6 +127,45 @@ void NcclComm::AllReduceImpl(void* inputbuffer, void *outputbuffer, size_t count
 
     if (res != ncclSuccess)
         RuntimeError("NcclComm ncclAllReduce failed: %s", ncclGetErrorString(res));
+    ProfileIssue(profilerEvtCommAllReduce, count, dtype == DataType::FLOAT ? sizeof(float) : sizeof(double));
+}
+
+void NcclComm::AllReduceAsyncImpl(void* buffer, size_t count, DataType dtype)
+{
+    if (m_asyncStream == nullptr)
+    {
+        cudaStreamCreateWithFlags(&m_asyncStream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed";
+        cudaEventCreateWithFlags(&m_computeEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+    }
+
+    // the reduction waits for the work issued to the compute stream so far, e.g. the computation of the gradients
+    cudaEventRecord(m_computeEvent, GetStream()) || "cudaEventRecord failed";
+    cudaStreamWaitEvent(m_asyncStream, m_computeEvent, 0) || "cudaStreamWaitEvent failed";
+
+    ncclResult_t res = ncclAllReduce(buffer, buffer, count, dtype == DataType::FLOAT ? ncclFloat : ncclDouble, ncclSum, m_ncclComm, m_asyncStream);
+    if (res != ncclSuccess)
+        RuntimeError("NcclComm ncclAllReduce failed: %s", ncclGetErrorString(res));
+    ProfileIssue(profilerEvtCommAllReduce, count, dtype == DataType::FLOAT ? sizeof(float) : sizeof(double));
+}
+
+void NcclComm::ReduceScatterImpl(const void* inputbuffer, void* outputbuffer, size_t countPerRank, DataType dtype)
+{
+    ncclResult_t res = ncclReduceScatter(inputbuffer, outputbuffer, countPerRank, dtype == DataType::FLOAT ? ncclFloat : ncclDouble, ncclSum, m_ncclComm, m_stream);
+    if (res != ncclSuccess)
+        RuntimeError("NcclComm ncclReduceScatter failed: %s", ncclGetErrorString(res));
+    ProfileIssue(profilerEvtCommReduceScatter, countPerRank * m_numRanks, dtype == DataType::FLOAT ? sizeof(float) : sizeof(double));
+}
+
+void NcclComm::AllGatherImpl(const void* inputbuffer, void* outputbuffer, size_t countPerRank, DataType dtype)
+{
+#if defined(NCCL_MAJOR) && NCCL_MAJOR >= 2
+    ncclResult_t res = ncclAllGather(inputbuffer, outputbuffer, countPerRank, dtype == DataType::FLOAT ? ncclFloat : ncclDouble, m_ncclComm, m_stream);
+#else
+    ncclResult_t res = ncclAllGather(inputbuffer, (int)countPerRank, dtype == DataType::FLOAT ? ncclFloat : ncclDouble, outputbuffer, m_ncclComm, m_stream);
+#endif
+    if (res != ncclSuccess)
+        RuntimeError("NcclComm ncclAllGather failed: %s", ncclGetErrorString(res));
+    ProfileIssue(profilerEvtCommAllGather, countPerRank * m_numRanks, dtype == DataType::FLOAT ? sizeof(float) : sizeof(double));
 }
 
 void NcclComm::BroadcastImpl(void* buffer, size_t count, MPI_Datatype dtype, int root)
@@ -108,11 +183,31 @@ void NcclComm::BroadcastImpl(void* buffer, size_t count, MPI_Datatype dtype, int
     {
         RuntimeError("NcclComm ncclBcast failed: %s", ncclGetErrorString(res));
     }
+    ProfileIssue(profilerEvtCommBroadcast, count, 1);
+}
+
+void NcclComm::ProfileIssue(int eventId, size_t count, size_t elementSize)
+{
+    if (ProfilerIsEnabled())
+        m_issuedOperations.push_back(IssuedOperation{ eventId, (long long)(count * elementSize), ProfilerTimeBegin() });
 }
 
 void NcclComm::Sync()
 {
+    auto profWait = ProfilerTimeBegin();
     cudaStreamSynchronize(m_stream) || "NcclComm: cudaStreamSynchronize failed";
+    if (m_asyncStream != nullptr)
+        cudaStreamSynchronize(m_asyncStream) || "NcclComm: cudaStreamSynchronize failed";
+
+    // The operations are only known to be complete here, so that they all end here.
+    if (!m_issuedOperations.empty())
+    {
+        long long waitClocks = ProfilerTimeBegin() - profWait;
+        for (const auto& operation : m_issuedOperations)
+            ProfilerCommEnd(operation.beginClock, operation.eventId, "nccl", operation.bytes, m_numRanks, waitClocks);
+        ProfilerTimeEnd(profWait, profilerEvtCommWait);
+        m_issuedOperations.clear();
+    }
 }
 
 }}} // end namespaces
@@ -120,7 +215,7 @@ void NcclComm::Sync()
 #else // !USE_NCCL
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-NcclComm::NcclComm(int /*deviceId*/, const MPIWrapperPtr& /*mpi*/) { }
+NcclComm::NcclComm(int /*deviceId*/, const MPIWrapperPtr& /*mpi*/, bool /*withinHost*/) { }
 
 NcclComm::~NcclComm() { }
 
@@ -16,6 +16,7 @@
 
 // Forward declare CUDA stuff
 typedef struct CUstream_st* cudaStream_t;
+typedef struct CUevent_st* cudaEvent_t;
 typedef struct ncclComm* ncclComm_t;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -26,16 +27,66 @@ class NcclComm
 private:
     enum class DataType : int {FLOAT, DOUBLE};
     void AllReduceImpl(void* inputbuffer, void* outputbuffer, size_t count, DataType dtype);
+    void AllReduceAsyncImpl(void* buffer, size_t count, DataType dtype);
+    void ReduceScatterImpl(const void* inputbuffer, void* outputbuffer, size_t countPerRank, DataType dtype);
+    void AllGatherImpl(const void* inputbuffer, void* outputbuffer, size_t countPerRank, DataType dtype);
     void BroadcastImpl(void* buffer, size_t count, MPI_Datatype dtype, int root);
     cudaStream_t m_stream;
     ncclComm_t m_ncclComm;
+
+    // for AllReduceAsync(): a stream that does not synchronize with the compute stream implicitly,
+    // and an event to make it wait for the work issued to the compute stream so far
+    cudaStream_t m_asyncStream;
+    cudaEvent_t m_computeEvent;
+
+    // operations issued since the last Sync(), for profiling (see ProfilerCommEnd()), which sees them complete there
+    struct IssuedOperation
+    {
+        int eventId;
+        long long bytes;
+        long long beginClock;
+    };
+    std::vector<IssuedOperation> m_issuedOperations;
+    int m_numRanks;
+    void ProfileIssue(int eventId, size_t count, size_t elementSize);
+
+    template <typename ElemType>
+    static DataType GetDataType()
+    {
+        if (std::is_same<ElemType, double>::value)
+            return DataType::DOUBLE;
+        else if (!std::is_same<ElemType, float>::value)
+            RuntimeError("NcclComm Unsupported reduction type");
+        return DataType::FLOAT;
+    }
 #endif
 
 public:
-    NcclComm(int deviceId, const MPIWrapperPtr& mpiComm);
+    // With withinHost the communicator comprises the ranks on the host of the current rank only (see MPIWrapper::HostIndexOfNodes()),
+    // otherwise all ranks, in which case it is not supported if the ranks run on multiple hosts.
+    NcclComm(int deviceId, const MPIWrapperPtr& mpiComm, bool withinHost = false);
     ~NcclComm();
     bool IsSupported();
-    void Sync(); // waits for outstanding reductions to complete
+    void Sync(); // waits for outstanding reductions to complete, including those started by AllReduceAsync()
+
+    // Sums the buffer in place across all ranks, after the work issued to the compute stream so far has completed.
+    // As opposed to AllReduce(), work issued to the compute stream later does not wait for the reduction, so that the
+    // reduction can overlap with computation (e.g. of the remaining gradients). Call Sync() before using the result.
+    template <typename ElemType>
+    void AllReduceAsync(ElemType* buffer, size_t count)
+    {
+#ifdef USE_NCCL
+        DataType dtype = DataType::FLOAT;
+        if (std::is_same<ElemType, double>::value)
+            dtype = DataType::DOUBLE;
+        else if (!std::is_same<ElemType, float>::value)
+            RuntimeError("NcclComm Unsupported reduction type");
+
+        AllReduceAsyncImpl(buffer, count, dtype);
+#else
+        RuntimeError("NcclComm: CNTK was built without NCCL support.");
+#endif
+    }
     
     template <typename ElemType>
     void AllReduce(ElemType* inputBuffer, ElemType* outputBuffer, size_t count)
@@ -74,6 +125,31 @@ public:
 #endif
     }
 
+    // Sums the input (countPerRank elements for each rank of the communicator, in the order of the ranks) across all ranks,
+    // and leaves the part of the sum that corresponds to the current rank in the output. The output may be the current rank's
+    // part of the input.
+    template <typename ElemType>
+    void ReduceScatter(const ElemType* inputBuffer, ElemType* outputBuffer, size_t countPerRank)
+    {
+#ifdef USE_NCCL
+        ReduceScatterImpl(inputBuffer, outputBuffer, countPerRank, GetDataType<ElemType>());
+#else
+        RuntimeError("NcclComm: CNTK was built without NCCL support.");
+#endif
+    }
+
+    // Gathers countPerRank elements from each rank into the output, in the order of the ranks. The input may be the current
+    // rank's part of the output.
+    template <typename ElemType>
+    void AllGather(const ElemType* inputBuffer, ElemType* outputBuffer, size_t countPerRank)
+    {
+#ifdef USE_NCCL
+        AllGatherImpl(inputBuffer, outputBuffer, countPerRank, GetDataType<ElemType>());
+#else
+        RuntimeError("NcclComm: CNTK was built without NCCL support.");
+#endif
+    }
+
     void Broadcast(void* buffer, size_t count, MPI_Datatype dtype, int root)
     {
 #ifdef USE_NCCL
@@ -9,6 +9,8 @@
 #ifdef CPUONLY
 
 #include "CommonMatrix.h"
+#include "ComputeStreamPool.h"
+#include "CudaGraph.h"
 #include "GPUMatrix.h"
 #include "GPUSparseMatrix.h"
 #include "MatrixQuantizerGPU.h"
@@ -242,6 +244,12 @@ void GPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const GPUSpars
 {
 }
 
+template <class ElemType>
+GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::ElementMultiplyWith(const GPUMatrix<ElemType>& b)
+{
+    return *this;
+}
+
 template <class ElemType>
 GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::InplaceTruncate(const ElemType threshold)
 {
@@ -260,12 +268,13 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
 }
 
 template<class ElemType>
-void GPUSparseMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>&, GPUMatrix<ElemType>&, ElemType, ElemType, ElemType, ElemType, bool)
+void GPUSparseMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>&, GPUMatrix<ElemType>&, ElemType, ElemType, ElemType, ElemType, bool, bool, GPUMatrix<ElemType>*)
 {
 }
 
 template<class ElemType>
-void GPUSparseMatrix<ElemType>::Adam(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum)
+void GPUSparseMatrix<ElemType>::Adam(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum,
+                                     bool lazy, GPUMatrix<ElemType>* lazyUpdateSteps)
 {
 }
 
@@ -1004,6 +1013,19 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoGatherRowsOf(ElemType beta, const GPUMatrix<ElemType>& m, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignPackedIndicesOf(const GPUMatrix<ElemType>* timeIndices, size_t numParallelSequences, size_t numTimeSteps,
+                                                                const std::vector<PackedSequenceRange>& sequences, size_t targetStride)
+{
+    return *this;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const ElemType v)
 {
@@ -1028,6 +1050,16 @@ void GPUMatrix<ElemType>::MaskColumnsValue(const GPUMatrix<char>& columnsMask, E
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignNormalizedBytesOf(const GPUMatrix<char>& bytes, ElemType mean, ElemType scale)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignAugmentedImagesOf(const GPUMatrix<char>& bytes, const ImageAugmentation& augmentation, uint64_t firstImage)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::CopyColumnsStrided(const GPUMatrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride)
 {
@@ -1042,6 +1074,10 @@ template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(GPUMatrix<ElemType> const&)
 {
 }
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignValuesFromPeer(const GPUMatrix<ElemType>& source)
+{
+}
 #if 0
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(CPUSparseMatrix<ElemType> const&)
@@ -1085,6 +1121,11 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::CounterBasedDropout(const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset, const ElemType beta)
+{
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1114,6 +1155,17 @@ void GPUMatrix<ElemType>::AdaDelta(GPUMatrix<ElemType>& gradients, GPUMatrix<Ele
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiTensorUpdate(DEVICEID_TYPE deviceId, MultiTensorUpdateType type, const std::vector<MultiTensorItem<ElemType>>& items,
+                                            ElemType momentum, ElemType varMomentum, bool unitGainMomentum)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiTensorSumOfSquares(DEVICEID_TYPE deviceId, const std::vector<MultiTensorItem<ElemType>>& items, std::vector<double>& sumsOfSquares)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1388,6 +1440,24 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<Ele
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSoftmaxCrossEntropyOf(const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*input*/, GPUMatrix<ElemType>& /*logSumExp*/)
+{
+    return *this;
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddSoftmaxCrossEntropyGradient(const GPUMatrix<ElemType>& /*gradient*/, const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*input*/,
+                                                         const GPUMatrix<ElemType>& /*logSumExp*/, GPUMatrix<ElemType>& /*inputGradient*/)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddSoftmaxCrossEntropyLabelGradient(const GPUMatrix<ElemType>& /*gradient*/, const GPUMatrix<ElemType>& /*input*/,
+                                                              const GPUMatrix<ElemType>& /*logSumExp*/, GPUMatrix<ElemType>& /*labelsGradient*/)
+{
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceHardmax(const bool isColWise)
 {
@@ -1757,6 +1827,11 @@ void GPUMatrix<ElemType>::VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<E
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::TopK(GPUMatrix<ElemType>& topKValues, GPUMatrix<ElemType>& topKIndices, size_t k) const
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::VectorMin(GPUMatrix<ElemType>& minIndexes, GPUMatrix<ElemType>& minValues, const bool isColWise) const
 {
@@ -1859,6 +1934,21 @@ void GPUMatrix<ElemType>::ConvolutionBackwardKernel(const GPUMatrix<ElemType>& i
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::DepthwiseConvolutionForward(const GPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& output) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::DepthwiseConvolutionBackwardData(const GPUMatrix<ElemType>& kernel, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& grad) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::DepthwiseConvolutionBackwardKernel(const GPUMatrix<ElemType>& in, const DepthwiseConvolutionShape& shape, GPUMatrix<ElemType>& kernelGrad) const
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height, 
     const size_t pooledWidth, const size_t pooledHeight, const GPUMatrix<ElemType>& roiData, GPUMatrix<ElemType>& output, GPUMatrix<ElemType>& argmax) const
@@ -1883,6 +1973,18 @@ void GPUMatrix<ElemType>::MaxPoolingBackward(const GPUMatrix<ElemType>& out, con
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::MaxPoolingForwardWithArgmax(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices,
+                                                        GPUMatrix<ElemType>& output, GPUMatrix<short>& argmax) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MaxPoolingBackwardWithArgmax(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices,
+                                                         const GPUMatrix<short>& argmax, GPUMatrix<ElemType>& grad) const
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::MaxUnpooling(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, const GPUMatrix<ElemType>& poolInput, GPUMatrix<ElemType>& input) const
 {
@@ -1939,6 +2041,16 @@ template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUMatrix<ElemType>& rhs, ElemType beta, GPUMatrix<ElemType>& c)
 {
 }
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& /*a*/, const bool transposeA, const GPUMatrix<ElemType>& /*b*/, const bool transposeB,
+                                                      ElemType beta, GPUMatrix<ElemType>& c, size_t batchSize, bool broadcastA, bool broadcastB)
+{
+}
+template <class ElemType>
+void GPUMatrix<ElemType>::QuantizedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& /*a*/, const GPUMatrix<ElemType>& /*b*/, ElemType beta, GPUMatrix<ElemType>& c,
+                                                          bool isAConstant, std::shared_ptr<QuantizedGPUBuffers>& buffers)
+{
+}
 
 template <class ElemType>
 void GPUMatrix<ElemType>::MultiplyAndAdd(const GPUMatrix<ElemType>& /*a*/, const bool transposeA, const GPUMatrix<ElemType>& /*b*/, const bool transposeB, GPUMatrix<ElemType>& c)
@@ -2117,6 +2229,12 @@ void GPUMatrix<ElemType>::TensorArgOp(const GPUMatrix<ElemType>& a, ElementWiseO
                                       const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
 {
 }
+template <class ElemType>
+void GPUMatrix<ElemType>::TensorProgramOp(ElemType beta, const array<const GPUMatrix<ElemType>*, ElementwiseProgram::MaxInputs>& inputs, ElemType alpha, const ElementwiseProgram& program,
+                                          const array<size_t, ElementwiseProgram::MaxInputs + 1>& offsets,
+                                          const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementwiseProgram::MaxInputs + 1>& regularStrides)
+{
+}
 
 template <class ElemType>
 void GPUMatrix<ElemType>::CreateCurandObject(unsigned long seed, const char* caller)
@@ -2200,6 +2318,18 @@ void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::RankWithinGroups(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& groupStarts, size_t truncation,
+                                           GPUMatrix<ElemType>& ranks, GPUMatrix<ElemType>& dcgs, GPUMatrix<ElemType>& idealDCGs)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddLambdaRankGradient(const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& ranks, const GPUMatrix<ElemType>& groupStarts,
+                                                const GPUMatrix<ElemType>& idealDCGs, ElemType sigma, size_t truncation, GPUMatrix<ElemType>& gradient)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a,
                                                            const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias, size_t sampleCount, GPUMatrix<ElemType>& tmp, GPUMatrix<ElemType>& c)
@@ -2254,6 +2384,21 @@ void MatrixQuantizerGPU<ElemType>::WaitUnquantizeAsyncDone()
 {
 }
 
+template <class ElemType>
+void MatrixQuantizerGPU<ElemType>::QuantizeBatchAsync(const std::vector<const Matrix<ElemType>*>& inMatrices, const std::vector<const Matrix<ElemType>*>& inResiduals, QuantizedMatrixBatch<ElemType>& outQBatch, const std::vector<Matrix<ElemType>*>& outResiduals, bool zeroThresholdFor1Bit)
+{
+}
+
+template <class ElemType>
+void MatrixQuantizerGPU<ElemType>::UnquantizeBatchAsync(QuantizedMatrixBatch<ElemType>& inQBatch, const std::vector<Matrix<ElemType>*>& outMatrices, bool add /*= false*/)
+{
+}
+
+template <class ElemType>
+void MatrixQuantizerGPU<ElemType>::UnquantizeSumAsync(const std::vector<QuantizedMatrix<ElemType>*>& inQMatrices, Matrix<ElemType>& outMatrix, bool add /*= false*/)
+{
+}
+
 #pragma endregion MatrixQuantizerGPU functions
 
 #pragma region GPUMatrixComputeStreamEvent functions
@@ -2302,6 +2447,12 @@ PrefetchGPUDataTransferer::PrefetchGPUDataTransferer(int /*deviceId*/) : Granula
 
 PrefetchGPUDataTransferer::~PrefetchGPUDataTransferer() {}
 
+OffloadGPUDataTransferer::OffloadGPUDataTransferer(int /*deviceId*/) : GranularGPUDataTransferer() {}
+
+void OffloadGPUDataTransferer::WaitForCopyGPUToCPUOnComputeStreamAsync() {}
+
+void OffloadGPUDataTransferer::WaitForCopyCPUToGPUOnComputeStreamAsync() {}
+
 GPUDataTransferer::GPUDataTransferer(int, bool){}
 GPUDataTransferer::~GPUDataTransferer(){}
 void GPUDataTransferer::CopyGPUToCPUAsync(void*, size_t, void*){}
@@ -2388,6 +2539,75 @@ float CudaTimer::Elapsed()
 
 /*static*/ bool SyncGuard::IsSyncEnabled() { return false; }
 
+void TracingGPUMemoryAllocator::EmptyCache(int deviceId)
+{
+}
+
+DeviceMemoryStatistics TracingGPUMemoryAllocator::GetMemoryStatistics(int deviceId)
+{
+    return DeviceMemoryStatistics();
+}
+
+void TracingGPUMemoryAllocator::ResetPeakMemoryStatistics(int deviceId)
+{
+}
+
+void TracingGPUMemoryAllocator::PrintMemoryStatistics(int deviceId)
+{
+}
+
+/*static*/ std::shared_ptr<ComputeStreamPool> ComputeStreamPool::Get(DEVICEID_TYPE, size_t)
+{
+    return nullptr;
+}
+
+/*static*/ void* ComputeStreamPool::CurrentStream()
+{
+    return nullptr;
+}
+
+ComputeStreamPool::~ComputeStreamPool()
+{
+}
+
+void ComputeStreamPool::BeginRegion()
+{
+}
+
+void ComputeStreamPool::SelectStream(size_t)
+{
+}
+
+void ComputeStreamPool::RecordEvent(size_t)
+{
+}
+
+void ComputeStreamPool::WaitForEvent(size_t)
+{
+}
+
+void ComputeStreamPool::EndRegion()
+{
+}
+
+/*static*/ std::unique_ptr<CudaGraph> CudaGraph::Capture(DEVICEID_TYPE, const std::function<void()>&)
+{
+    return nullptr;
+}
+
+CudaGraph::~CudaGraph()
+{
+}
+
+void CudaGraph::Launch()
+{
+}
+
+bool CudaGraph::IsValid() const
+{
+    return false;
+}
+
 } } }
 
 // define a dummy GPUWatcher class too
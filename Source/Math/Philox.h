@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Philox.h -- counter-based random numbers (Philox4x32-10), usable from host and CUDA code.
+//
+// Salmon, Moraes, Dror, Shaw: "Parallel random numbers: as easy as 1, 2, 3", SC 2011.
+// A counter-based generator has no state: the random number for a given (key, counter) pair is a pure function
+// of the two, so any element of a random stream can be computed directly, in any order, by any thread, and host
+// and device code produce bit-identical results. This is what allows e.g. DropoutNode to regenerate its mask in
+// the backward pass instead of keeping it in memory.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#ifdef __CUDACC__
+#define PHILOX_DECL __host__ __device__ inline
+#else
+#define PHILOX_DECL inline
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// one Philox4x32-10 block: four 32-bit random words for the 128-bit 'counter' under the 64-bit 'key'
+PHILOX_DECL void Philox4x32(uint32_t counter[4], uint64_t key)
+{
+    const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57; // multipliers
+    const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85; // Weyl sequence for the key schedule
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    for (int round = 0; round < 10; round++)
+    {
+        const uint64_t p0 = (uint64_t)M0 * counter[0];
+        const uint64_t p1 = (uint64_t)M1 * counter[2];
+        const uint32_t c0 = (uint32_t)(p1 >> 32) ^ counter[1] ^ k0;
+        const uint32_t c2 = (uint32_t)(p0 >> 32) ^ counter[3] ^ k1;
+        counter[0] = c0;
+        counter[1] = (uint32_t)p1;
+        counter[2] = c2;
+        counter[3] = (uint32_t)p0;
+        k0 += W0;
+        k1 += W1;
+    }
+}
+
+// element 'index' of the uniform [0,1) stream for 'seed'; every Philox block serves four consecutive elements
+PHILOX_DECL float PhiloxUniform(uint64_t seed, uint64_t index)
+{
+    uint32_t counter[4] = { (uint32_t)(index >> 2), (uint32_t)(index >> 34), 0, 0 };
+    Philox4x32(counter, seed);
+    return (counter[index & 3] >> 8) * (1.0f / 16777216.0f); // top 24 bits, exactly representable as float
+}
+
+// element 'index' of a dropout mask: 0 with probability maskRate, scaleValue otherwise
+template <class ElemType>
+PHILOX_DECL ElemType PhiloxDropoutMask(uint64_t seed, uint64_t index, ElemType maskRate, ElemType scaleValue)
+{
+    return PhiloxUniform(seed, index) < maskRate ? (ElemType)0 : scaleValue;
+}
+
+}}}
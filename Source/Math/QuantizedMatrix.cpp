@@ -183,4 +183,63 @@ void QuantizedMatrix<ElemType>::Print(const char* matrixName, size_t rowStart, s
 template class QuantizedMatrix<float>;
 template class QuantizedMatrix<double>;
 
+template <class ElemType>
+QuantizedMatrixBatch<ElemType>::QuantizedMatrixBatch(const std::vector<std::pair<size_t, size_t>>& dims, const size_t nbits, DEVICEID_TYPE deviceId, MemAllocator* allocator /* = nullptr */)
+    : m_allocator(allocator), m_dims(dims), m_offsets(1, 0), m_numBits(nbits)
+{
+    if (((QuantizedColumn<ElemType>::QWordNumBits / m_numBits) * m_numBits) != QuantizedColumn<ElemType>::QWordNumBits)
+    {
+        LogicError("Quantization: 'nbits' must be a divisor of 64");
+    }
+
+    // The column sizes are multiples of sizeof(ElemType) and of sizeof(QWord), so each matrix starts aligned.
+    m_offsets.reserve(m_dims.size() + 1);
+    for (const auto& dim : m_dims)
+        m_offsets.push_back(m_offsets.back() + QuantizedColumn<ElemType>::QuantizedColumnSize(m_numBits, dim.first) * dim.second);
+
+    if (m_allocator == nullptr)
+    {
+        m_quantizedData = new Matrix<char>(GetSize(), 1, deviceId);
+    }
+    else
+    {
+        m_quantizedData = new Matrix<char>(GetSize(), 1, (char*)m_allocator->Malloc(GetSize()), deviceId, matrixFlagDontOwnBuffer);
+    }
+}
+
+template <class ElemType>
+QuantizedMatrixBatch<ElemType>::~QuantizedMatrixBatch()
+{
+    if (m_allocator != nullptr)
+    {
+        assert(!m_quantizedData->OwnBuffer());
+        m_allocator->Free(m_quantizedData->Data());
+    }
+
+    delete m_quantizedData;
+}
+
+template <class ElemType>
+int QuantizedMatrixBatch<ElemType>::GetDeviceId() const
+{
+    return m_quantizedData->GetDeviceId();
+}
+
+template <class ElemType>
+char* QuantizedMatrixBatch<ElemType>::Buffer() const
+{
+    return m_quantizedData->Data();
+}
+
+template <class ElemType>
+QuantizedMatrix<ElemType> QuantizedMatrixBatch<ElemType>::GetMatrix(size_t i) const
+{
+    const size_t qColSize = QuantizedColumn<ElemType>::QuantizedColumnSize(m_numBits, GetNumRows(i));
+    auto matrixData = new Matrix<char>(qColSize, GetNumCols(i), Buffer() + GetOffset(i), GetDeviceId(), matrixFlagDontOwnBuffer);
+    return QuantizedMatrix<ElemType>(GetNumRows(i), GetNumCols(i), m_numBits, matrixData);
+}
+
+template class QuantizedMatrixBatch<float>;
+template class QuantizedMatrixBatch<double>;
+
 }}}
@@ -3,6 +3,8 @@
 #include "Matrix.h"
 #include "MemAllocator.h"
 #include "ValueQuantizer.h"
+#include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #ifdef MATH_EXPORTS
@@ -121,6 +123,81 @@ private:
 
     template <typename T>
     friend class MatrixQuantizer;
+
+    template <typename T>
+    friend class QuantizedMatrixBatch;
+};
+
+// A QuantizedMatrixBatch holds the quantized columns of several matrices, e.g. all gradients of a model or a bucket
+// of them, back to back in one buffer, so that they are quantized, transferred and unquantized with one operation each.
+// Matrix i takes the bytes [GetOffset(i), GetOffset(i) + GetSize(i)) of the buffer, laid out as in a QuantizedMatrix.
+template <class ElemType>
+class MATH_API QuantizedMatrixBatch : public QuantizedMatrixBase
+{
+public:
+    // 'dims' are the (rows, columns) of the matrices
+    QuantizedMatrixBatch(const std::vector<std::pair<size_t, size_t>>& dims, const size_t nbits, DEVICEID_TYPE deviceId, MemAllocator* allocator = nullptr);
+    ~QuantizedMatrixBatch();
+
+    int GetDeviceId() const;
+
+    size_t GetNumMatrices() const
+    {
+        return m_dims.size();
+    }
+
+    size_t GetNumRows(size_t i) const
+    {
+        return m_dims[i].first;
+    }
+
+    size_t GetNumCols(size_t i) const
+    {
+        return m_dims[i].second;
+    }
+
+    size_t GetNumBits() const
+    {
+        return m_numBits;
+    }
+
+    size_t GetOffset(size_t i) const
+    {
+        return m_offsets[i];
+    }
+
+    size_t GetSize(size_t i) const
+    {
+        return m_offsets[i + 1] - m_offsets[i];
+    }
+
+    // bytes of all matrices
+    size_t GetSize() const
+    {
+        return m_offsets.back();
+    }
+
+    char* Buffer() const;
+
+    Matrix<char>* GetQuantizedData() const
+    {
+        return m_quantizedData;
+    }
+
+    // a QuantizedMatrix that aliases the part of matrix i, e.g. to hand it to QuantizeAsync() on its own
+    QuantizedMatrix<ElemType> GetMatrix(size_t i) const;
+
+private:
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(QuantizedMatrixBatch);
+
+private:
+    Matrix<char>* m_quantizedData; // [GetSize() x 1]
+    MemAllocator* m_allocator;
+
+    std::vector<std::pair<size_t, size_t>> m_dims;
+    std::vector<size_t> m_offsets; // one more than matrices, the last one is the total size
+    size_t m_numBits;
 };
 
 }}}
@@ -0,0 +1,126 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedOperations.cpp -- 16-bit integer GEMM behind QuantizedMultiplier
+//
+
+#include "stdafx.h"
+#include "QuantizedOperations.h"
+#include <omp.h>
+#include <cstring>
+#include <vector>
+
+// BlockHandlerSSE is not available on ARM64, see BlockHandlerSSE.cpp; use a plain loop there.
+#if !defined(__aarch64__)
+#include "BlockMultiplier.h"
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// BlockMultiplier works on row-major matrices and rewrites its right operand in block order.
+// A column-major C[m,n] = A[m,k] * B[k,n] is the row-major C'[n,m] = B'[n,k] * A'[k,m], where X' is
+// the same memory read as row-major, so CNTK's left operand A becomes the right operand of BlockMultiplier.
+// That is the operand BlockMultiplier::PrepareB() packs, which is exactly what we want for constant weights.
+struct QuantizedGemmInt16::Impl
+{
+#if !defined(__aarch64__)
+#ifdef SUPPORT_AVX2
+    typedef BlockMultiplier<BlockHandlerAVX> MultiplierT;
+#else
+    typedef BlockMultiplier<BlockHandlerSSE> MultiplierT;
+#endif
+
+    MultiplierT m_multiplier;
+    short* m_packedA;
+    int m_m, m_k;
+
+    Impl() : m_multiplier(omp_get_max_threads()), m_packedA(nullptr), m_m(0), m_k(0) {}
+    ~Impl() { FreePackedA(); }
+
+    void FreePackedA()
+    {
+        if (m_packedA)
+            MultiplierT::FreeMatrix(m_packedA);
+        m_packedA = nullptr;
+        m_m = m_k = 0;
+    }
+
+    void SetNumThreads(int numThreads) { m_multiplier.SetNumThreads(numThreads); }
+
+    void PackA(const short* A, int m, int k)
+    {
+        FreePackedA();
+        m_packedA = m_multiplier.PrepareB(const_cast<short*>(A), k, m);
+        m_m = m;
+        m_k = k;
+    }
+
+    void MultiplyPackedA(int m, int n, int k, const short* B, int32_t* C)
+    {
+        // BlockMultiplier accumulates into C
+        memset(C, 0, sizeof(int32_t) * m * n);
+        m_multiplier.MultiplyMatrices(const_cast<short*>(B), n, k, m_packedA, m, C);
+    }
+#else
+    std::vector<short> m_packedA;
+    int m_m, m_k;
+
+    Impl() : m_m(0), m_k(0) {}
+
+    void SetNumThreads(int) {}
+
+    void PackA(const short* A, int m, int k)
+    {
+        m_packedA.assign(A, A + (size_t)m * k);
+        m_m = m;
+        m_k = k;
+    }
+
+    void MultiplyPackedA(int m, int n, int k, const short* B, int32_t* C)
+    {
+        for (int j = 0; j < n; j++)
+            for (int i = 0; i < m; i++)
+            {
+                int32_t dotProduct = 0;
+                for (int l = 0; l < k; l++)
+                    dotProduct += m_packedA[i + (size_t)l * m] * B[l + (size_t)k * j];
+                C[i + (size_t)j * m] = dotProduct;
+            }
+    }
+#endif
+};
+
+QuantizedGemmInt16::QuantizedGemmInt16() : m_impl(new Impl()) {}
+QuantizedGemmInt16::~QuantizedGemmInt16() {}
+
+void QuantizedGemmInt16::SetNumThreads(int numThreads)
+{
+    m_impl->SetNumThreads(numThreads);
+}
+
+void QuantizedGemmInt16::PackA(const short* A, int m, int k)
+{
+    m_impl->PackA(A, m, k);
+}
+
+bool QuantizedGemmInt16::IsAPacked(int m, int k) const
+{
+    return m_impl->m_m == m && m_impl->m_k == k && m > 0 && k > 0;
+}
+
+void QuantizedGemmInt16::MultiplyPackedA(int m, int n, int k, const short* B, int32_t* C)
+{
+    if (!IsAPacked(m, k))
+        LogicError("QuantizedGemmInt16::MultiplyPackedA: no packed [%d x %d] matrix.", m, k);
+    m_impl->MultiplyPackedA(m, n, k, B, C);
+}
+
+void QuantizedGemmInt16::Multiply(int m, int n, int k, const short* A, const short* B, int32_t* C)
+{
+    // the rewrite into block order is the bulk of the packing cost, and needed for A in any case
+    PackA(A, m, k);
+    MultiplyPackedA(m, n, k, B, C);
+}
+
+}}}
@@ -4,13 +4,46 @@
 //
 #pragma once
 #include "Quantizers.h"
+#include "CommonMatrix.h"
+#include <cstdint>
+#include <memory>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+struct QuantizedGPUBuffers; // see GPUMatrix::QuantizedMultiplyAndWeightedAdd()
+
+// Product of two 16-bit integer matrices with 32-bit accumulation, A[m,k]*B[k,n] = C[m,n], column-major.
+// On x86/x64 this runs the blocked SSE kernels of BlockMultiplier (AVX2 if built with SUPPORT_AVX2).
+// A constant A (the weight matrix of a TimesNode) can be packed once with PackA(), after which
+// MultiplyPackedA() only needs to rewrite B on every call.
+class MATH_API QuantizedGemmInt16
+{
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+public:
+    QuantizedGemmInt16();
+    ~QuantizedGemmInt16();
+
+    // number of OpenMP threads used by the products, defaults to the current OpenMP maximum
+    void SetNumThreads(int numThreads);
+
+    // Keep a packed copy of A[m,k]; replaces a previously packed matrix.
+    void PackA(const short* A, int m, int k);
+    bool IsAPacked(int m, int k) const;
+
+    // C = A * B with the packed A
+    void MultiplyPackedA(int m, int n, int k, const short* B, int32_t* C);
+    // C = A * B, nothing is kept
+    void Multiply(int m, int n, int k, const short* A, const short* B, int32_t* C);
+};
+
 
 // Quantized product of two dense matrices A and B, where each matrix has its own quantizer.
 // This class handles quantization of both matrices, product and de-quantization of the result.
 // Other implementations should inherit from this class or extract common methods to the base class and inherit from the base.
+// On the GPU, Matrix::MultiplyAndWeightedAdd() computes the product in 8 bits instead (GPUMatrix::QuantizedMultiplyAndWeightedAdd()),
+// which only takes whether A is constant and the device buffers from here; the quantizers are used on the CPU only.
 template <class ElemType>
 class QuantizedMultiplier
 {
@@ -18,17 +51,23 @@ class QuantizedMultiplier
     shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerA;
     shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerB;
 
-    // Placeholders for quantized matrices A and B
+    // Placeholders for quantized matrices A and B, and for the integer result
     vector<short> m_pMatA, m_pMatB;
+    vector<int32_t> m_pMatC;
+    vector<ElemType> m_tempC;
 
     // Whether matrices A and B are constant (i.e. weights)
     // If the matrix is constant, the size of the underlying container for quatized values will be preserved for
-    // the lifespan of the object
+    // the lifespan of the object. A constant A is additionally kept in the packed layout of the GEMM kernel.
     bool m_isAConstant;
     bool m_isBConstant;
 
     bool m_firstPass;
 
+    QuantizedGemmInt16 m_gemm;
+
+    shared_ptr<QuantizedGPUBuffers> m_gpuBuffers;
+
 public: 
     QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, bool isAConstant, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB, bool isBConstant) :
         m_pQuantizerA(pQuantizerA), m_pQuantizerB(pQuantizerB), m_isAConstant(isAConstant), m_isBConstant(isBConstant), m_firstPass(true)
@@ -41,17 +80,25 @@ public:
     {
     };
 
-    // A[m,k]*B[k,n] = C[m,n]
-    void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C)
+    // C[m,n] = beta * C[m,n] + alpha * A[m,k]*B[k,n]
+    void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C, ElemType alpha = 1, ElemType beta = 0)
     {
         // Quantize
-        if (!m_isAConstant || m_firstPass)
+        // A constant A is quantized and packed once; it is only redone if the shape changes.
+        bool packA = m_isAConstant && (m_firstPass || !m_gemm.IsAPacked(m, k));
+        if (!m_isAConstant || packA)
         {
             m_pMatA.resize(m*k);
             ArrayRef<short> refMatA(m_pMatA.data(), m_pMatA.size());
             m_pQuantizerA->Quantize(ArrayRef<ElemType>(A, m_pMatA.size()), refMatA);
         }
-        
+        if (packA)
+        {
+            m_gemm.PackA(m_pMatA.data(), m, k);
+            // the packed copy is all we need from now on
+            vector<short>().swap(m_pMatA);
+        }
+
         if (!m_isBConstant || m_firstPass)
         {
             m_pMatB.resize(n*k);
@@ -62,28 +109,42 @@ public:
         m_firstPass = false;
 
         // Do multiply
-        // Naive inefficient product, just for demonstation
-        // TODO: replace with an efficient version, e.g. IPG, block multiplier, Eigen, gemmlowp, etc.
-        for (size_t i = 0; i < m; i++)
-            for (size_t j = 0; j < n; j++)
-            {
-                int dotProduct=0;
-                for (size_t l = 0; l < k; l++)
-                {
-                    // CNTK is using column-major storage
-                    dotProduct += m_pMatA[i + l*m] * m_pMatB[l + k*j];
-                }
-                C[i + j*m] = (ElemType)dotProduct;
-            }
+        int mn = m*n;
+        m_pMatC.resize(mn);
+        if (m_isAConstant)
+            m_gemm.MultiplyPackedA(m, n, k, m_pMatB.data(), m_pMatC.data());
+        else
+            m_gemm.Multiply(m, n, k, m_pMatA.data(), m_pMatB.data(), m_pMatC.data());
 
         // De-quantize
-        int mn = m*n;
-        m_pQuantizerB->Dequantize(C, C, mn);
-        m_pQuantizerA->Dequantize(C, C, mn);
+        ElemType* result = C;
+        if (beta != 0)
+        {
+            m_tempC.resize(mn);
+            result = m_tempC.data();
+        }
+        for (int i = 0; i < mn; i++)
+            result[i] = (ElemType)m_pMatC[i];
+        m_pQuantizerB->Dequantize(result, result, mn);
+        m_pQuantizerA->Dequantize(result, result, mn);
+
+        if (beta != 0)
+        {
+            for (int i = 0; i < mn; i++)
+                C[i] = beta * C[i] + alpha * result[i];
+        }
+        else if (alpha != 1)
+        {
+            for (int i = 0; i < mn; i++)
+                C[i] *= alpha;
+        }
     }
 
     void SetIsAConstant(bool v) { m_isAConstant = v; }
     void SetIsBConstant(bool v) { m_isBConstant = v; }
+    bool IsAConstant() const { return m_isAConstant; }
+
+    shared_ptr<QuantizedGPUBuffers>& GPUBuffers() { return m_gpuBuffers; }
 };
 
 }}}
\ No newline at end of file
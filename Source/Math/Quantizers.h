@@ -48,6 +48,9 @@ public:
     {
     }
 
+    // the factor that converts the last collection quantized back to RawType
+    RawType InverseQuantizeFactor() const { return m_inverseQuantizerFactor; }
+
     // Perform quantization of the input collection, put result into pre-allocated output collection
     virtual void Quantize(const ArrayRef<RawType>& input, ArrayRef<QuantizedType>& output)
     {
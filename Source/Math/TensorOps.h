@@ -295,6 +295,53 @@ DefTernaryOp(ElementwiseProductWithPowBaseDerivative, a * c * OpPow(b, c - 1));
 
 #pragma pop_macro("DefTernaryOp")
 
+// -----------------------------------------------------------------------
+// evaluate an ElementwiseProgram (CommonMatrix.h) for one element
+// The caller has loaded the inputs into registers[0..program.m_numInputs).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+DECL ElemType EvaluateElementwiseProgram(const ElementwiseProgram& program, ElemType* registers)
+{
+    size_t result = program.m_numInputs;
+    for (size_t i = 0; i < program.m_numInstructions; i++, result++)
+    {
+        const ElementwiseProgram::Instruction& instruction = program.m_instructions[i];
+        const ElemType a = registers[instruction.m_args[0]];
+        const ElemType b = registers[instruction.m_args[1]];
+        const ElemType c = registers[instruction.m_args[2]];
+        ElemType r;
+#pragma push_macro("CaseUnaryProgramOp")
+#pragma push_macro("CaseBinaryProgramOp")
+#pragma push_macro("CaseTernaryProgramOp")
+#define CaseUnaryProgramOp(oper)        \
+    case ElementWiseOperator::op##oper: \
+        r = Op##oper(a);                \
+        break
+#define CaseBinaryProgramOp(oper)       \
+    case ElementWiseOperator::op##oper: \
+        r = Op##oper(a, b);             \
+        break
+#define CaseTernaryProgramOp(oper)      \
+    case ElementWiseOperator::op##oper: \
+        r = Op##oper(a, b, c);          \
+        break
+        switch (instruction.m_op)
+        {
+            ForAllUnaryOps(CaseUnaryProgramOp);
+            ForAllBinaryOps(CaseBinaryProgramOp);
+            ForAllTernaryOps(CaseTernaryProgramOp);
+        default:
+            r = 0; // (not reached: ElementwiseProgram::Add() only takes ops with an arity)
+        }
+#pragma pop_macro("CaseTernaryProgramOp")
+#pragma pop_macro("CaseBinaryProgramOp")
+#pragma pop_macro("CaseUnaryProgramOp")
+        registers[result] = r;
+    }
+    return registers[result - 1];
+}
+
 }}}
 #pragma pop_macro("DECL")
 #pragma pop_macro("TENSOR_OPS_DECL")
@@ -285,6 +285,35 @@ void TensorView<ElemType>::DoTernaryOpOf(ElemType beta, const TensorView& a, con
     GetSOB().TensorOp(beta, a.GetSOB(), b.GetSOB(), c.GetSOB(), alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
+template <class ElemType>
+void TensorView<ElemType>::DoElementwiseProgramOf(ElemType beta, const vector<TensorView>& inputs, const ElementwiseProgram& program, ElemType alpha)
+{
+    const size_t N = ElementwiseProgram::MaxInputs + 1;
+    if (inputs.size() != program.m_numInputs)
+        InvalidArgument("DoElementwiseProgramOf: %d inputs were passed to a program with %d inputs.", (int) inputs.size(), (int) program.m_numInputs);
+
+    // unused input slots are padded with the output, which the program never reads
+    array<TensorShape, N> shapes;
+    array<const Matrix<ElemType>*, N - 1> sobs;
+    for (size_t i = 0; i < N - 1; i++)
+    {
+        const TensorView& input = i < inputs.size() ? inputs[i] : *this;
+        shapes[i] = input.GetShape();
+        sobs[i] = &input.GetSOB();
+    }
+    shapes[N - 1] = GetShape();
+
+    array<size_t, N> offsets;
+    array<SmallVector<ptrdiff_t>, N> regularStrides, reducingStrides;
+    SmallVector<size_t> regularOpDims, reducingOpDims;
+    PrepareTensorOperands<ElemType, N>(shapes, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    if (reducingOpDims.size() > 0)
+        InvalidArgument("DoElementwiseProgramOf: The output %s cannot be inverse-broadcasting.", string(GetShape()).c_str());
+
+    GetSOB().TensorProgramOp(beta, sobs, alpha, program, offsets, regularOpDims, regularStrides);
+}
+
 template <class ElemType>
 void TensorView<ElemType>::DoArgReductionOpOf(const TensorView& a, ElementWiseOperator reductionOp)
 {
@@ -368,9 +397,33 @@ shared_ptr<Matrix<ElemType>> TensorView<ElemType>::AsMatrix() const
         return make_shared<Matrix<ElemType>>(m_sob->ColumnSlice(firstColumn, numColumns).Reshaped(m_shape[0], m_shape[1]));
 }
 
+template <class ElemType>
+TensorView<ElemType> TensorView<ElemType>::DenseCopy() const
+{
+    TensorShape denseShape(m_shape.GetDims());
+    auto sob = make_shared<Matrix<ElemType>>(denseShape.GetNumElements(), 1, m_sob->GetDeviceId());
+    TensorView<ElemType> result(sob, denseShape);
+    result.AssignCopyOf(*this);
+    return result;
+}
+
 template <class ElemType>
 void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier)
 {
+    // GEMM takes a leading dimension but no other strides, which the Matrix class does not expose, so strided operands
+    // are multiplied as dense copies.
+    if (!a.m_shape.IsDense())
+        return DoMatrixProductOf(beta, transC, a.DenseCopy(), transA, b, transB, alpha, pQuantizedMultiplier);
+    if (!b.m_shape.IsDense())
+        return DoMatrixProductOf(beta, transC, a, transA, b.DenseCopy(), transB, alpha, pQuantizedMultiplier);
+    if (!m_shape.IsDense())
+    {
+        auto c = DenseCopy(); // (beta may be non-zero)
+        c.DoMatrixProductOf(beta, transC, a, transA, b, transB, alpha, pQuantizedMultiplier);
+        AssignCopyOf(c);
+        return;
+    }
+
     // determine integration dimension offset
     auto shapeA = a.m_shape;
     auto shapeB = b.m_shape;
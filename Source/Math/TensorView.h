@@ -134,6 +134,14 @@ public:
     void DoBinaryOpOf (ElemType beta, const TensorView& a, const TensorView& b,                      ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp);
     void DoTernaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp);
 
+    // -------------------------------------------------------------------
+    // fused elementwise operations
+    // c := beta * c + alpha * program(inputs...), evaluated in a single pass over the data.
+    // Inputs may broadcast, but the output cannot be inverse-broadcasting (no reduction).
+    // -------------------------------------------------------------------
+
+    void DoElementwiseProgramOf(ElemType beta, const std::vector<TensorView>& inputs, const ElementwiseProgram& program, ElemType alpha);
+
     // -------------------------------------------------------------------
     // arg based operations
     // -------------------------------------------------------------------
@@ -144,7 +152,7 @@ public:
     // Result goes into 'this', and can optionally be added to the existing value.
     // [I x J x K x L] * [K x L x M x N] -> [I x J x M x N] reducing over (K,L)
     // Reduction range is inferred from tensor ranks.
-    // [I x J], [K x L], and [M x N] must each be dense.
+    // Operands that are not dense, such as slices of non-trailing dimensions, go through dense copies.
     // Being a matrix product, the output cannot be in-place.
     // If beta == 0, c is not read out, i.e. it can be uninitialized or contain NaNs.
     // -------------------------------------------------------------------
@@ -156,6 +164,9 @@ public:
     shared_ptr<Matrix<ElemType>> AsMatrix() const;
     const TensorShape& GetShape() const { return m_shape; }
 
+    // a copy of the viewed elements in a new dense storage object on the same device
+    TensorView<ElemType> DenseCopy() const;
+
     // -------------------------------------------------------------------
     // accessors
     // -------------------------------------------------------------------
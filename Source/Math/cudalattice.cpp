@@ -163,6 +163,44 @@ private:
                                                     logEframescorrecttotal, totalfwscore);
     }
 
+    void forwardbackwardlatticebatch(const size_t *batchsizes, const size_t numlaunches,
+                                     const uintvector &edgeorder, const uintvector &edgelattices, const uintvector &nodeoffsets,
+                                     const size_t spalignunitid, const size_t silalignunitid,
+                                     const floatvector &edgeacscores, const edgeinfowithscoresvector &edges,
+                                     const nodeinfovector &nodes, const aligninfovector &aligns,
+                                     const ushortvector &alignments, const uintvector &alignoffsets,
+                                     doublevector &logpps, doublevector &logalphas, doublevector &logbetas,
+                                     const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                     const ushortvector &uids, const ushortvector &senone2classmap, doublevector &logaccalphas,
+                                     doublevector &logaccbetas, doublevector &logframescorrectedge, doublevector &logEframescorrect,
+                                     doublevector &totalfwscores, doublevector &logEframescorrecttotals)
+    {
+        ondevice no(deviceid);
+        latticefunctionsops::forwardbackwardlatticebatch(batchsizes, numlaunches,
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(edgeorder),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(edgelattices),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(nodeoffsets),
+                                                         spalignunitid, silalignunitid,
+                                                         dynamic_cast<const vectorbaseimpl<floatvector, vectorref<float>> &>(edgeacscores),
+                                                         dynamic_cast<const vectorbaseimpl<edgeinfowithscoresvector, vectorref<msra::lattices::edgeinfowithscores>> &>(edges),
+                                                         dynamic_cast<const vectorbaseimpl<nodeinfovector, vectorref<msra::lattices::nodeinfo>> &>(nodes),
+                                                         dynamic_cast<const vectorbaseimpl<aligninfovector, vectorref<msra::lattices::aligninfo>> &>(aligns),
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(alignments),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(alignoffsets),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logpps),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logalphas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logbetas),
+                                                         lmf, wp, amf, boostingfactor, returnEframescorrect,
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(uids),
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(senone2classmap),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logaccalphas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logaccbetas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logframescorrectedge),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logEframescorrect),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(totalfwscores),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logEframescorrecttotals));
+    }
+
     void sMBRerrorsignal(const ushortvector &alignstateids,
                          const uintvector &alignoffsets,
                          const edgeinfowithscoresvector &edges, const nodeinfovector &nodes,
@@ -183,6 +221,27 @@ private:
                                              logEframescorrecttotal, dengammasMatrixRef, dengammasbufMatrixRef);
     }
 
+    void sMBRerrorsignalbatch(const ushortvector &alignstateids, const uintvector &alignoffsets,
+                              const edgeinfowithscoresvector &edges, const nodeinfovector &nodes, const uintvector &edgelattices,
+                              const doublevector &logpps, const float amf, const doublevector &logEframescorrect,
+                              const doublevector &logEframescorrecttotals, Microsoft::MSR::CNTK::Matrix<float> &dengammas, Microsoft::MSR::CNTK::Matrix<float> &dengammasbuf)
+    {
+        ondevice no(deviceid);
+
+        matrixref<float> dengammasMatrixRef = tomatrixref(dengammas);
+        matrixref<float> dengammasbufMatrixRef = tomatrixref(dengammasbuf);
+        latticefunctionsops::sMBRerrorsignalbatch(dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(alignstateids),
+                                                  dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(alignoffsets),
+                                                  dynamic_cast<const vectorbaseimpl<edgeinfowithscoresvector, vectorref<msra::lattices::edgeinfowithscores>> &>(edges),
+                                                  dynamic_cast<const vectorbaseimpl<nodeinfovector, vectorref<msra::lattices::nodeinfo>> &>(nodes),
+                                                  dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(edgelattices),
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logpps),
+                                                  amf,
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logEframescorrect),
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logEframescorrecttotals),
+                                                  dengammasMatrixRef, dengammasbufMatrixRef);
+    }
+
     void mmierrorsignal(const ushortvector &alignstateids, const uintvector &alignoffsets,
                         const edgeinfowithscoresvector &edges, const nodeinfovector &nodes,
                         const doublevector &logpps, Microsoft::MSR::CNTK::Matrix<float> &dengammas)
@@ -212,6 +271,36 @@ private:
                                              dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logqs),
                                              logaccMatrixRef);
     }
+
+    void denominatorforwardbackward(const denominatorarcvector &inarcs, const uintvector &inarcoffsets,
+                                    const denominatorarcvector &outarcs, const uintvector &outarcoffsets,
+                                    const denominatorarcvector &pdfarcs, const uintvector &pdfarcoffsets,
+                                    const floatvector &loginitial, const floatvector &logfinal,
+                                    const uintvector &uttfirstcols, const uintvector &uttframes,
+                                    const size_t numchannels, const size_t maxframes, const Microsoft::MSR::CNTK::Matrix<float> &logLLs,
+                                    Microsoft::MSR::CNTK::Matrix<float> &logalphas, Microsoft::MSR::CNTK::Matrix<float> &logbetas,
+                                    floatvector &logtotals, Microsoft::MSR::CNTK::Matrix<float> &posteriors)
+    {
+        ondevice no(deviceid);
+
+        matrixref<float> logLLsMatrixRef = tomatrixref(logLLs);
+        matrixref<float> logalphasMatrixRef = tomatrixref(logalphas);
+        matrixref<float> logbetasMatrixRef = tomatrixref(logbetas);
+        matrixref<float> posteriorsMatrixRef = tomatrixref(posteriors);
+        latticefunctionsops::denominatorforwardbackward(dynamic_cast<const vectorbaseimpl<denominatorarcvector, vectorref<msra::lattices::denominatorarc>> &>(inarcs),
+                                                        dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(inarcoffsets),
+                                                        dynamic_cast<const vectorbaseimpl<denominatorarcvector, vectorref<msra::lattices::denominatorarc>> &>(outarcs),
+                                                        dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(outarcoffsets),
+                                                        dynamic_cast<const vectorbaseimpl<denominatorarcvector, vectorref<msra::lattices::denominatorarc>> &>(pdfarcs),
+                                                        dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(pdfarcoffsets),
+                                                        dynamic_cast<const vectorbaseimpl<floatvector, vectorref<float>> &>(loginitial),
+                                                        dynamic_cast<const vectorbaseimpl<floatvector, vectorref<float>> &>(logfinal),
+                                                        dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(uttfirstcols),
+                                                        dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(uttframes),
+                                                        numchannels, maxframes, logLLsMatrixRef, logalphasMatrixRef, logbetasMatrixRef,
+                                                        dynamic_cast<vectorbaseimpl<floatvector, vectorref<float>> &>(logtotals),
+                                                        posteriorsMatrixRef);
+    }
 };
 
 latticefunctions *newlatticefunctions(size_t deviceid)
@@ -261,5 +350,9 @@ aligninfovector *newaligninfovector(size_t deviceid)
 {
     return new vectorbaseimpl<aligninfovector, vectorref<aligninfo>>(deviceid);
 }
+denominatorarcvector *newdenominatorarcvector(size_t deviceid)
+{
+    return new vectorbaseimpl<denominatorarcvector, vectorref<denominatorarc>>(deviceid);
+}
 };
 };
@@ -79,6 +79,7 @@ typedef vectorbase<msra::lattices::lr3transP> lr3transPvector;
 typedef vectorbase<msra::lattices::nodeinfo> nodeinfovector;
 typedef vectorbase<msra::lattices::edgeinfowithscores> edgeinfowithscoresvector;
 typedef vectorbase<msra::lattices::aligninfo> aligninfovector;
+typedef vectorbase<msra::lattices::denominatorarc> denominatorarcvector;
 
 struct latticefunctions : public vectorbase<msra::lattices::empty>
 {
@@ -99,16 +100,40 @@ struct latticefunctions : public vectorbase<msra::lattices::empty>
                                         doublevector& logaccalphas, doublevector& logaccbetas,
                                         doublevector& logframescorrectedge, doublevector& logEframescorrect,
                                         doublevector& Eframescorrectbuf, double& logEframescorrecttotal, double& totalfwscore) = 0;
+    virtual void forwardbackwardlatticebatch(const size_t* batchsizes, const size_t numlaunches,
+                                             const uintvector& edgeorder, const uintvector& edgelattices, const uintvector& nodeoffsets,
+                                             const size_t spalignunitid, const size_t silalignunitid,
+                                             const floatvector& edgeacscores, const edgeinfowithscoresvector& edges,
+                                             const nodeinfovector& nodes, const aligninfovector& aligns,
+                                             const ushortvector& alignoutput, const uintvector& alignoffsets,
+                                             doublevector& logpps, doublevector& logalphas, doublevector& logbetas,
+                                             const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                             const ushortvector& uids, const ushortvector& senone2classmap,
+                                             doublevector& logaccalphas, doublevector& logaccbetas,
+                                             doublevector& logframescorrectedge, doublevector& logEframescorrect,
+                                             doublevector& totalfwscores, doublevector& logEframescorrecttotals) = 0;
     virtual void sMBRerrorsignal(const ushortvector& alignstateids, const uintvector& alignoffsets,
                                  const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
                                  const doublevector& logpps, const float amf, const doublevector& logEframescorrect,
                                  const double logEframescorrecttotal, Microsoft::MSR::CNTK::Matrix<float>& dengammas, Microsoft::MSR::CNTK::Matrix<float>& dengammasbuf) = 0;
+    virtual void sMBRerrorsignalbatch(const ushortvector& alignstateids, const uintvector& alignoffsets,
+                                      const edgeinfowithscoresvector& edges, const nodeinfovector& nodes, const uintvector& edgelattices,
+                                      const doublevector& logpps, const float amf, const doublevector& logEframescorrect,
+                                      const doublevector& logEframescorrecttotals, Microsoft::MSR::CNTK::Matrix<float>& dengammas, Microsoft::MSR::CNTK::Matrix<float>& dengammasbuf) = 0;
     virtual void mmierrorsignal(const ushortvector& alignstateids, const uintvector& alignoffsets,
                                 const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
                                 const doublevector& logpps, Microsoft::MSR::CNTK::Matrix<float>& dengammas) = 0;
     virtual void stateposteriors(const ushortvector& alignstateids, const uintvector& alignoffsets,
                                  const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
                                  const doublevector& logqs, Microsoft::MSR::CNTK::Matrix<float>& logacc) = 0;
+    virtual void denominatorforwardbackward(const denominatorarcvector& inarcs, const uintvector& inarcoffsets,
+                                            const denominatorarcvector& outarcs, const uintvector& outarcoffsets,
+                                            const denominatorarcvector& pdfarcs, const uintvector& pdfarcoffsets,
+                                            const floatvector& loginitial, const floatvector& logfinal,
+                                            const uintvector& uttfirstcols, const uintvector& uttframes,
+                                            const size_t numchannels, const size_t maxframes, const Microsoft::MSR::CNTK::Matrix<float>& logLLs,
+                                            Microsoft::MSR::CNTK::Matrix<float>& logalphas, Microsoft::MSR::CNTK::Matrix<float>& logbetas,
+                                            floatvector& logtotals, Microsoft::MSR::CNTK::Matrix<float>& posteriors) = 0;
 };
 
 // ---------------------------------------------------------------------------
@@ -127,5 +152,6 @@ lr3transPvector* newlr3transPvector(size_t deviceid);
 nodeinfovector* newnodeinfovector(size_t deviceid);
 edgeinfowithscoresvector* newedgeinfovector(size_t deviceid);
 aligninfovector* newaligninfovector(size_t deviceid);
+denominatorarcvector* newdenominatorarcvector(size_t deviceid);
 };
 };
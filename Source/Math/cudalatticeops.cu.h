@@ -201,7 +201,8 @@ __global__ void forwardlatticej(const size_t batchsize, const size_t startindex,
     if (j < batchsize) // note: will cause issues if we ever use __synctreads()
     {
         msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
-                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
+                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas,
+                                                                 0, nodes.size() - 1);
     }
 }
 
@@ -223,7 +224,7 @@ __global__ void backwardlatticej(const size_t batchsize, const size_t startindex
                                                                   edges, nodes, aligns, totalfwscore, logpps, logalphas, logbetas,
                                                                   lmf, wp, amf, boostingfactor, returnEframescorrect,
                                                                   logframescorrectedge, logaccalphas,
-                                                                  logEframescorrect, logaccbetas);
+                                                                  logEframescorrect, logaccbetas, 0, nodes.size() - 1);
     }
 }
 
@@ -326,6 +327,160 @@ void latticefunctionsops::forwardbackwardlattice(const size_t *batchsizeforward,
     }
 }
 
+// -----------------------------------------------------------------------
+// forwardbackwardlatticebatch -- forwardbackwardlattice for several lattices concatenated into one
+// Launch i processes the i-th forward batch of all lattices together. The backward pass runs the same launches in reverse
+// order: no edge of a forward batch starts at a node at or after the first end node of its batch, so an edge that starts
+// where an edge of the batch ends is in a later batch, and the edges of a batch do not depend on each other going backward.
+// -----------------------------------------------------------------------
+
+// set the initial tokens of each lattice: alpha of its first node and beta of its last node to probability 1 (0 in log)
+__global__ void setinitialtokensl(const vectorref<unsigned int> nodeoffsets, vectorref<double> logalphas, vectorref<double> logbetas)
+{
+    const size_t l = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (l + 1 < nodeoffsets.size())
+    {
+        logalphas[nodeoffsets[l]] = 0.0;
+        logbetas[nodeoffsets[l + 1] - 1] = 0.0;
+    }
+}
+
+__global__ void forwardlatticebatchj(const size_t batchsize, const size_t startindex, const vectorref<unsigned int> edgeorder,
+                                     const vectorref<unsigned int> edgelattices, const vectorref<unsigned int> nodeoffsets,
+                                     const vectorref<float> edgeacscores, const size_t spalignunitid, const size_t silalignunitid,
+                                     vectorref<msra::lattices::edgeinfowithscores> edges, vectorref<msra::lattices::nodeinfo> nodes,
+                                     const vectorref<msra::lattices::aligninfo> aligns, vectorref<unsigned short> alignments,
+                                     vectorref<unsigned int> alignmentoffsets, vectorref<double> logalphas, float lmf, float wp, float amf,
+                                     const float boostingfactor, const vectorref<unsigned short> uids, const vectorref<unsigned short> senone2classmap,
+                                     const bool returnEframescorrect, vectorref<double> logframescorrectedge, vectorref<double> logaccalphas)
+{
+    const size_t shufflemode = 1;
+    const size_t k = msra::lattices::latticefunctionskernels::shuffle(threadIdx.x, blockDim.x, threadIdx.y, blockDim.y, blockIdx.x, gridDim.x, shufflemode);
+    if (k < batchsize)
+    {
+        const size_t j = edgeorder[k + startindex];
+        const size_t l = edgelattices[j];
+        msra::lattices::latticefunctionskernels::forwardlatticej(j, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
+                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas,
+                                                                 nodeoffsets[l], nodeoffsets[l + 1] - 1);
+    }
+}
+
+// total forward score of each lattice = alpha of its last node
+__global__ void totalfwscoresl(const vectorref<unsigned int> nodeoffsets, const vectorref<double> logalphas, vectorref<double> totalfwscores)
+{
+    const size_t l = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (l < totalfwscores.size())
+        totalfwscores[l] = logalphas[nodeoffsets[l + 1] - 1];
+}
+
+__global__ void backwardlatticebatchj(const size_t batchsize, const size_t startindex, const vectorref<unsigned int> edgeorder,
+                                      const vectorref<unsigned int> edgelattices, const vectorref<unsigned int> nodeoffsets,
+                                      const vectorref<float> edgeacscores, const size_t spalignunitid, const size_t silalignunitid,
+                                      vectorref<msra::lattices::edgeinfowithscores> edges, vectorref<msra::lattices::nodeinfo> nodes,
+                                      vectorref<msra::lattices::aligninfo> aligns, const vectorref<double> totalfwscores,
+                                      vectorref<double> logpps, vectorref<double> logalphas, vectorref<double> logbetas,
+                                      float lmf, float wp, float amf, const float boostingfactor, const bool returnEframescorrect,
+                                      vectorref<double> logframescorrectedge, vectorref<double> logaccalphas,
+                                      vectorref<double> logEframescorrect, vectorref<double> logaccbetas)
+{
+    const size_t tpb = blockDim.x * blockDim.y; // total #threads in a block
+    const size_t kinblock = threadIdx.x + threadIdx.y * blockDim.x;
+    const size_t k = kinblock + blockIdx.x * tpb;
+    if (k < batchsize)
+    {
+        const size_t j = edgeorder[k + startindex];
+        const size_t l = edgelattices[j];
+        msra::lattices::latticefunctionskernels::backwardlatticej(j, edgeacscores, spalignunitid, silalignunitid,
+                                                                  edges, nodes, aligns, totalfwscores[l], logpps, logalphas, logbetas,
+                                                                  lmf, wp, amf, boostingfactor, returnEframescorrect,
+                                                                  logframescorrectedge, logaccalphas,
+                                                                  logEframescorrect, logaccbetas, nodeoffsets[l], nodeoffsets[l + 1] - 1);
+    }
+}
+
+// expected frames correct of each lattice = acc beta of its first node, normalized by its beta
+__global__ void logEframescorrecttotalsl(const vectorref<unsigned int> nodeoffsets, const vectorref<double> logbetas, const vectorref<double> logaccbetas,
+                                         vectorref<double> logEframescorrecttotals)
+{
+    const size_t l = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (l < logEframescorrecttotals.size())
+        logEframescorrecttotals[l] = logaccbetas[nodeoffsets[l]] - logbetas[nodeoffsets[l]];
+}
+
+void latticefunctionsops::forwardbackwardlatticebatch(const size_t *batchsizes, const size_t numlaunches,
+                                                      const vectorref<unsigned int> &edgeorder, const vectorref<unsigned int> &edgelattices,
+                                                      const vectorref<unsigned int> &nodeoffsets,
+                                                      const size_t spalignunitid, const size_t silalignunitid,
+                                                      const vectorref<float> &edgeacscores,
+                                                      const vectorref<msra::lattices::edgeinfowithscores> &edges,
+                                                      const vectorref<msra::lattices::nodeinfo> &nodes,
+                                                      const vectorref<msra::lattices::aligninfo> &aligns,
+                                                      const vectorref<unsigned short> &alignments,
+                                                      const vectorref<unsigned int> &aligmentoffsets,
+                                                      vectorref<double> &logpps, vectorref<double> &logalphas, vectorref<double> &logbetas,
+                                                      const float lmf, const float wp, const float amf, const float boostingfactor,
+                                                      const bool returnEframescorrect, const vectorref<unsigned short> &uids,
+                                                      const vectorref<unsigned short> &senone2classmap, vectorref<double> &logaccalphas,
+                                                      vectorref<double> &logaccbetas, vectorref<double> &logframescorrectedge,
+                                                      vectorref<double> &logEframescorrect,
+                                                      vectorref<double> &totalfwscores, vectorref<double> &logEframescorrecttotals) const
+{
+    // initialize log{,acc}(alhas/betas)
+    dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+    dim3 b((unsigned int) ((logalphas.size() + tpb - 1) / tpb));
+    setvaluej<<<b, t, 0, GetCurrentStream()>>>(logalphas, LOGZERO, logalphas.size());
+    checklaunch("setvaluej");
+    setvaluej<<<b, t, 0, GetCurrentStream()>>>(logbetas, LOGZERO, logalphas.size());
+    checklaunch("setvaluej");
+    if (returnEframescorrect)
+    {
+        setvaluej<<<b, t, 0, GetCurrentStream()>>>(logaccalphas, LOGZERO, logalphas.size());
+        checklaunch("setvaluej");
+        setvaluej<<<b, t, 0, GetCurrentStream()>>>(logaccbetas, LOGZERO, logalphas.size());
+        checklaunch("setvaluej");
+    }
+    // one thread per lattice for the per-lattice values
+    dim3 bl((unsigned int) ((totalfwscores.size() + 31) / 32));
+    setinitialtokensl<<<bl, 32, 0, GetCurrentStream()>>>(nodeoffsets, logalphas, logbetas);
+    checklaunch("setinitialtokensl");
+
+    // forward pass
+    size_t startindex = 0;
+    for (size_t i = 0; i < numlaunches; i++)
+    {
+        dim3 b2((unsigned int) ((batchsizes[i] + tpb - 1) / tpb));
+        forwardlatticebatchj<<<b2, t, 0, GetCurrentStream()>>>(batchsizes[i], startindex, edgeorder, edgelattices, nodeoffsets, edgeacscores,
+                                                              spalignunitid, silalignunitid, edges, nodes, aligns,
+                                                              alignments, aligmentoffsets, logalphas, lmf, wp, amf,
+                                                              boostingfactor, uids, senone2classmap, returnEframescorrect,
+                                                              logframescorrectedge, logaccalphas);
+        checklaunch("forwardlatticebatchj");
+        startindex += batchsizes[i];
+    }
+    totalfwscoresl<<<bl, 32, 0, GetCurrentStream()>>>(nodeoffsets, logalphas, totalfwscores);
+    checklaunch("totalfwscoresl");
+
+    // backward pass
+    for (size_t i = numlaunches; i-- > 0;)
+    {
+        startindex -= batchsizes[i];
+        dim3 b2((unsigned int) ((batchsizes[i] + tpb - 1) / tpb));
+        backwardlatticebatchj<<<b2, t, 0, GetCurrentStream()>>>(batchsizes[i], startindex, edgeorder, edgelattices, nodeoffsets,
+                                                               edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns,
+                                                               totalfwscores, logpps, logalphas, logbetas,
+                                                               lmf, wp, amf, boostingfactor, returnEframescorrect, logframescorrectedge,
+                                                               logaccalphas, logEframescorrect, logaccbetas);
+        checklaunch("backwardlatticebatchj");
+    }
+    if (returnEframescorrect)
+    {
+        logEframescorrecttotalsl<<<bl, 32, 0, GetCurrentStream()>>>(nodeoffsets, logbetas, logaccbetas, logEframescorrecttotals);
+        checklaunch("logEframescorrecttotalsl");
+    }
+}
+
 // -----------------------------------------------------------------------
 // sMBRerrorsignal -- accumulate difference of logEframescorrect and logEframescorrecttotal into errorsignal
 // -----------------------------------------------------------------------
@@ -343,6 +498,21 @@ __global__ void sMBRerrorsignalj(const vectorref<unsigned short> alignstateids,
     }
 }
 
+__global__ void sMBRerrorsignalbatchj(const vectorref<unsigned short> alignstateids, const vectorref<unsigned int> alignoffsets,
+                                      const vectorref<msra::lattices::edgeinfowithscores> edges, const vectorref<msra::lattices::nodeinfo> nodes,
+                                      const vectorref<unsigned int> edgelattices, vectorref<double> logpps, const float amf,
+                                      const vectorref<double> logEframescorrect, const vectorref<double> logEframescorrecttotals,
+                                      matrixref<float> errorsignal, matrixref<float> errorsignalneg)
+{
+    const size_t shufflemode = 1;
+    const size_t j = msra::lattices::latticefunctionskernels::shuffle(threadIdx.x, blockDim.x, threadIdx.y, blockDim.y, blockIdx.x, gridDim.x, shufflemode);
+    if (j < edges.size())
+    {
+        msra::lattices::latticefunctionskernels::sMBRerrorsignalj(j, alignstateids, alignoffsets, edges, nodes, logpps, amf,
+                                                                  logEframescorrect, logEframescorrecttotals[edgelattices[j]], errorsignal, errorsignalneg);
+    }
+}
+
 // -----------------------------------------------------------------------
 // stateposteriors --accumulate a per-edge quantity into the states that the edge is aligned with
 // -----------------------------------------------------------------------
@@ -433,6 +603,32 @@ void latticefunctionsops::sMBRerrorsignal(const vectorref<unsigned short> &align
 #endif
 }
 
+void latticefunctionsops::sMBRerrorsignalbatch(const vectorref<unsigned short> &alignstateids, const vectorref<unsigned int> &alignoffsets,
+                                               const vectorref<msra::lattices::edgeinfowithscores> &edges, const vectorref<msra::lattices::nodeinfo> &nodes,
+                                               const vectorref<unsigned int> &edgelattices, const vectorref<double> &logpps, const float amf,
+                                               const vectorref<double> &logEframescorrect, const vectorref<double> &logEframescorrecttotals,
+                                               matrixref<float> &errorsignal, matrixref<float> &errorsignalauxbuf) const
+{
+    // same as sMBRerrorsignal() without DIRECT_MODE
+    const size_t numedges = edges.size();
+    dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+    dim3 b((unsigned int) ((numedges + tpb - 1) / tpb));
+
+    setvaluei<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, LOGZERO);
+    checklaunch("setvaluei");
+    setvaluei<<<dim3((((unsigned int) errorsignalauxbuf.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignalauxbuf, LOGZERO);
+    checklaunch("setvaluei");
+    sMBRerrorsignalbatchj<<<b, t, 0, GetCurrentStream()>>>(alignstateids, alignoffsets, edges, nodes, edgelattices, logpps, amf, logEframescorrect, logEframescorrecttotals, errorsignal, errorsignalauxbuf);
+    checklaunch("sMBRerrorsignalbatch");
+
+    setunseeni<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, errorsignalauxbuf);
+    checklaunch("setunseenj");
+
+    errorcomputationi<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, errorsignalauxbuf, amf);
+    checklaunch("errorcomputationj");
+}
+
 void latticefunctionsops::mmierrorsignal(const vectorref<unsigned short> &alignstateids, const vectorref<unsigned int> &alignoffsets,
                                          const vectorref<msra::lattices::edgeinfowithscores> &edges, const vectorref<msra::lattices::nodeinfo> &nodes,
                                          const vectorref<double> &logpps, matrixref<float> &errorsignal) const
@@ -451,5 +647,93 @@ void latticefunctionsops::mmierrorsignal(const vectorref<unsigned short> &aligns
     expfi<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal);
     checklaunch("expfi");
 }
+
+// -----------------------------------------------------------------------
+// denominatorforwardbackward -- lattice-free MMI, forward-backward of a minibatch through the denominator graph
+// -----------------------------------------------------------------------
+
+__global__ void denominatorforwardj(const size_t frame, const size_t numthreads, const vectorref<msra::lattices::denominatorarc> inarcs,
+                                    const vectorref<unsigned int> inarcoffsets, const vectorref<float> loginitial,
+                                    const vectorref<unsigned int> uttfirstcols, const vectorref<unsigned int> uttframes, const size_t numchannels,
+                                    const matrixref<float> logLLs, matrixref<float> logalphas)
+{
+    const size_t tpb = blockDim.x * blockDim.y;
+    const size_t j = threadIdx.x + threadIdx.y * blockDim.x + blockIdx.x * tpb;
+    if (j < numthreads)
+        msra::lattices::latticefunctionskernels::denominatorforwardj(j, frame, inarcs, inarcoffsets, loginitial, uttfirstcols, uttframes, numchannels, logLLs, logalphas);
+}
+
+__global__ void denominatorbackwardj(const size_t frame, const size_t numthreads, const vectorref<msra::lattices::denominatorarc> outarcs,
+                                     const vectorref<unsigned int> outarcoffsets, const vectorref<float> logfinal,
+                                     const vectorref<unsigned int> uttfirstcols, const vectorref<unsigned int> uttframes, const size_t numchannels,
+                                     const matrixref<float> logLLs, matrixref<float> logbetas)
+{
+    const size_t tpb = blockDim.x * blockDim.y;
+    const size_t j = threadIdx.x + threadIdx.y * blockDim.x + blockIdx.x * tpb;
+    if (j < numthreads)
+        msra::lattices::latticefunctionskernels::denominatorbackwardj(j, frame, outarcs, outarcoffsets, logfinal, uttfirstcols, uttframes, numchannels, logLLs, logbetas);
+}
+
+// one thread per utterance
+__global__ void denominatortotalu(const vectorref<float> loginitial, const vectorref<unsigned int> uttfirstcols, const vectorref<unsigned int> uttframes,
+                                  const matrixref<float> logbetas, vectorref<float> logtotals)
+{
+    const size_t u = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (u < logtotals.size())
+        msra::lattices::latticefunctionskernels::denominatortotalu(u, loginitial, uttfirstcols, uttframes, logbetas, logtotals);
+}
+
+__global__ void denominatorposteriorj(const size_t numthreads, const vectorref<msra::lattices::denominatorarc> pdfarcs, const vectorref<unsigned int> pdfarcoffsets,
+                                      const vectorref<float> loginitial, const vectorref<float> logfinal,
+                                      const vectorref<unsigned int> uttfirstcols, const vectorref<unsigned int> uttframes,
+                                      const size_t numchannels, const size_t maxframes, const matrixref<float> logLLs,
+                                      const matrixref<float> logalphas, const matrixref<float> logbetas, const vectorref<float> logtotals,
+                                      matrixref<float> posteriors)
+{
+    const size_t tpb = blockDim.x * blockDim.y;
+    const size_t j = threadIdx.x + threadIdx.y * blockDim.x + blockIdx.x * tpb;
+    if (j < numthreads)
+        msra::lattices::latticefunctionskernels::denominatorposteriorj(j, pdfarcs, pdfarcoffsets, loginitial, logfinal, uttfirstcols, uttframes,
+                                                                       numchannels, maxframes, logLLs, logalphas, logbetas, logtotals, posteriors);
+}
+
+void latticefunctionsops::denominatorforwardbackward(const vectorref<msra::lattices::denominatorarc> &inarcs, const vectorref<unsigned int> &inarcoffsets,
+                                                     const vectorref<msra::lattices::denominatorarc> &outarcs, const vectorref<unsigned int> &outarcoffsets,
+                                                     const vectorref<msra::lattices::denominatorarc> &pdfarcs, const vectorref<unsigned int> &pdfarcoffsets,
+                                                     const vectorref<float> &loginitial, const vectorref<float> &logfinal,
+                                                     const vectorref<unsigned int> &uttfirstcols, const vectorref<unsigned int> &uttframes,
+                                                     const size_t numchannels, const size_t maxframes, const matrixref<float> &logLLs,
+                                                     matrixref<float> &logalphas, matrixref<float> &logbetas, vectorref<float> &logtotals,
+                                                     matrixref<float> &posteriors) const
+{
+    const size_t numstates = inarcoffsets.size() - 1;
+    const size_t numpdfs = pdfarcoffsets.size() - 1;
+    const size_t numutts = uttframes.size();
+    dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+
+    // one launch per frame, for all states of all utterances
+    const size_t numstatethreads = numutts * numstates;
+    dim3 b((unsigned int) ((numstatethreads + tpb - 1) / tpb));
+    for (size_t frame = 0; frame < maxframes; frame++)
+    {
+        denominatorforwardj<<<b, t, 0, GetCurrentStream()>>>(frame, numstatethreads, inarcs, inarcoffsets, loginitial, uttfirstcols, uttframes, numchannels, logLLs, logalphas);
+        checklaunch("denominatorforwardj");
+    }
+    for (size_t frame = maxframes; frame-- > 0;)
+    {
+        denominatorbackwardj<<<b, t, 0, GetCurrentStream()>>>(frame, numstatethreads, outarcs, outarcoffsets, logfinal, uttfirstcols, uttframes, numchannels, logLLs, logbetas);
+        checklaunch("denominatorbackwardj");
+    }
+    denominatortotalu<<<dim3((unsigned int) ((numutts + 31) / 32)), 32, 0, GetCurrentStream()>>>(loginitial, uttfirstcols, uttframes, logbetas, logtotals);
+    checklaunch("denominatortotalu");
+
+    // all frames at once
+    const size_t numpdfthreads = numutts * maxframes * numpdfs;
+    dim3 b2((unsigned int) ((numpdfthreads + tpb - 1) / tpb));
+    denominatorposteriorj<<<b2, t, 0, GetCurrentStream()>>>(numpdfthreads, pdfarcs, pdfarcoffsets, loginitial, logfinal, uttfirstcols, uttframes,
+                                                            numchannels, maxframes, logLLs, logalphas, logbetas, logtotals, posteriors);
+    checklaunch("denominatorposteriorj");
+}
 };
 };
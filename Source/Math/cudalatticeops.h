@@ -53,11 +53,37 @@ protected:
                                 vectorref<double>& logframescorrectedge, vectorref<double>& logEframescorrect, vectorref<double>& Eframescorrectbuf,
                                 double& logEframescorrecttotal, double& totalfwscore) const;
 
+    // batched version of forwardbackwardlattice() for several lattices concatenated into one (with node, alignment and frame
+    // indices rebased): edge j belongs to lattice edgelattices[j], whose nodes are [nodeoffsets[l], nodeoffsets[l+1]); launch i
+    // takes the next batchsizes[i] edges of edgeorder, which are the i-th forward batch of each lattice; the total forward
+    // score and expected frames correct of each lattice are left on the device
+    void forwardbackwardlatticebatch(const size_t* batchsizes, const size_t numlaunches,
+                                     const vectorref<unsigned int>& edgeorder, const vectorref<unsigned int>& edgelattices,
+                                     const vectorref<unsigned int>& nodeoffsets,
+                                     const size_t spalignunitid, const size_t silalignunitid,
+                                     const vectorref<float>& edgeacscores, const vectorref<msra::lattices::edgeinfowithscores>& edges,
+                                     const vectorref<msra::lattices::nodeinfo>& nodes,
+                                     const vectorref<msra::lattices::aligninfo>& aligns, const vectorref<unsigned short>& aligments,
+                                     const vectorref<unsigned int>& aligmentoffsets,
+                                     vectorref<double>& logpps, vectorref<double>& logalphas, vectorref<double>& logbetas,
+                                     const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                     const vectorref<unsigned short>& uids, const vectorref<unsigned short>& senone2classmap,
+                                     vectorref<double>& logaccalphas, vectorref<double>& logaccbetas,
+                                     vectorref<double>& logframescorrectedge, vectorref<double>& logEframescorrect,
+                                     vectorref<double>& totalfwscores, vectorref<double>& logEframescorrecttotals) const;
+
     void sMBRerrorsignal(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                          const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                          const vectorref<double>& logpps, const float amf, const vectorref<double>& logEframescorrect, const double logEframescorrecttotal,
                          matrixref<float>& errorsignal, matrixref<float>& errorsignalneg) const;
 
+    // batched version of sMBRerrorsignal(), with the expected frames correct of the lattice of each edge (see forwardbackwardlatticebatch())
+    void sMBRerrorsignalbatch(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
+                              const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
+                              const vectorref<unsigned int>& edgelattices, const vectorref<double>& logpps, const float amf,
+                              const vectorref<double>& logEframescorrect, const vectorref<double>& logEframescorrecttotals,
+                              matrixref<float>& errorsignal, matrixref<float>& errorsignalneg) const;
+
     void mmierrorsignal(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                         const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                         const vectorref<double>& logpps, matrixref<float>& errorsignal) const;
@@ -65,6 +91,17 @@ protected:
     void stateposteriors(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                          const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                          const vectorref<double>& logqs, matrixref<float>& logacc) const;
+
+    // lattice-free MMI: log alphas and betas, the log total score of each utterance, and the pdf posteriors of all frames of the
+    // utterances of a minibatch; see denominatorforwardj() for the layout. Columns of the posteriors outside the utterances are left alone.
+    void denominatorforwardbackward(const vectorref<msra::lattices::denominatorarc>& inarcs, const vectorref<unsigned int>& inarcoffsets,
+                                    const vectorref<msra::lattices::denominatorarc>& outarcs, const vectorref<unsigned int>& outarcoffsets,
+                                    const vectorref<msra::lattices::denominatorarc>& pdfarcs, const vectorref<unsigned int>& pdfarcoffsets,
+                                    const vectorref<float>& loginitial, const vectorref<float>& logfinal,
+                                    const vectorref<unsigned int>& uttfirstcols, const vectorref<unsigned int>& uttframes,
+                                    const size_t numchannels, const size_t maxframes, const matrixref<float>& logLLs,
+                                    matrixref<float>& logalphas, matrixref<float>& logbetas, vectorref<float>& logtotals,
+                                    matrixref<float>& posteriors) const;
 };
 };
 };
@@ -135,6 +135,15 @@ hmm gethmm(hmms, i)
 }
 #endif
 
+// arc of a lattice-free MMI denominator graph; every arc emits one frame of its pdf
+struct denominatorarc
+{
+    unsigned int from; // state the arc leaves
+    unsigned int to;   // state the arc enters
+    unsigned int pdf;  // row of the log likelihoods that it emits
+    float logweight;   // log of the graph weight (negated cost)
+};
+
 #ifndef LOGZERO
 #define LOGZERO -1e30f
 #endif
@@ -658,7 +667,8 @@ struct latticefunctionskernels
                                                   const ushortvector &alignments, const uintvector &alignmentoffsets,
                                                   doublevector &logalphas, float lmf, float wp, float amf, const float boostingfactor,
                                                   const ushortvector &uids, const ushortvector senone2classmap, const bool returnEframescorrect,
-                                                  doublevector &logframescorrectedge, doublevector &logaccalphas)
+                                                  doublevector &logframescorrectedge, doublevector &logaccalphas,
+                                                  const size_t firstnode, const size_t lastnode) // node range of the lattice of edge j (all nodes if not batched)
     {
         // edge info
         const edgeinfowithscores &e = edges[j];
@@ -729,7 +739,7 @@ struct latticefunctionskernels
 
 #ifdef FORBID_INVALID_SIL_PATHS
         // silence edge or second speech edge
-        if ((isaddedsil && e.E != nodes.size() - 1) || (forbidinvalidsilpath && e.S != 0))
+        if ((isaddedsil && e.E != lastnode) || (forbidinvalidsilpath && e.S != firstnode))
         {
             const size_t S = (size_t)(!isaddedsil ? e.S + nodes.size() : e.S); // second speech edge comes from special 'silence state' node
             const size_t E = (size_t)(isaddedsil ? e.E + nodes.size() : e.E);  // silence edge goes into special 'silence state' node
@@ -757,7 +767,8 @@ struct latticefunctionskernels
                                                    doublevector &logalphas, doublevector &logbetas, float lmf, float wp,
                                                    float amf, const float boostingfactor, const bool returnEframescorrect,
                                                    doublevector &logframescorrectedge, doublevector &logaccalphas,
-                                                   doublevector &logEframescorrect, doublevector &logaccbetas)
+                                                   doublevector &logEframescorrect, doublevector &logaccbetas,
+                                                   const size_t firstnode, const size_t lastnode) // node range of the lattice of edge j (all nodes if not batched)
     {
         // output values
         double logpp = LOGZERO;
@@ -834,7 +845,7 @@ struct latticefunctionskernels
         double logEframescorrectj2 = LOGZERO;
 
         // silence edge or second speech edge
-        if ((isaddedsil && e.E != nodes.size() - 1) || (forbidinvalidsilpath && e.S != 0))
+        if ((isaddedsil && e.E != lastnode) || (forbidinvalidsilpath && e.S != firstnode))
         {
             const size_t S = (size_t)(!isaddedsil ? e.S + nodes.size() : e.S); // second speech edge comes from special 'silence state' node
             const size_t E = (size_t)(isaddedsil ? e.E + nodes.size() : e.E);  // silence edge goes into special 'silence state' node
@@ -879,6 +890,8 @@ struct latticefunctionskernels
         }
 #else
         nodes;
+        firstnode;
+        lastnode;
 #endif
 
         // write back return values
@@ -952,6 +965,93 @@ struct latticefunctionskernels
             }
         }
     }
+
+    // lattice-free MMI: forward-backward of all utterances of a minibatch through the denominator graph at once
+    // Frame t of utterance u is column uttfirstcols[u] + t * numchannels of the log likelihoods, alphas, betas and posteriors.
+    //  - logalphas(s, col): log score of all paths that emit frames 0..t and end in state s
+    //  - logbetas(s, col): log score of all paths that leave state s and emit frames t..end
+    // The recursions run one frame per launch, j = u * numstates + s.
+    template <typename denominatorarcvector, typename uintvector, typename floatvector, typename matrix>
+    static inline __device__ void denominatorforwardj(size_t j, size_t t, const denominatorarcvector &inarcs, const uintvector &inarcoffsets,
+                                                      const floatvector &loginitial, const uintvector &uttfirstcols, const uintvector &uttframes,
+                                                      const size_t numchannels, const matrix &logLLs, matrix &logalphas)
+    {
+        const size_t numstates = inarcoffsets.size() - 1;
+        const size_t u = j / numstates;
+        const size_t s = j % numstates;
+        if (t >= uttframes[u])
+            return;
+        const size_t col = uttfirstcols[u] + t * numchannels;
+        float logalpha = LOGZERO;
+        for (size_t k = inarcoffsets[s]; k < inarcoffsets[s + 1]; k++) // arcs into s
+        {
+            const denominatorarc &arc = inarcs[k];
+            const float logprev = (t == 0) ? loginitial[arc.from] : logalphas(arc.from, col - numchannels);
+            logadd(logalpha, logprev + arc.logweight + logLLs(arc.pdf, col));
+        }
+        logalphas(s, col) = logalpha;
+    }
+
+    template <typename denominatorarcvector, typename uintvector, typename floatvector, typename matrix>
+    static inline __device__ void denominatorbackwardj(size_t j, size_t t, const denominatorarcvector &outarcs, const uintvector &outarcoffsets,
+                                                       const floatvector &logfinal, const uintvector &uttfirstcols, const uintvector &uttframes,
+                                                       const size_t numchannels, const matrix &logLLs, matrix &logbetas)
+    {
+        const size_t numstates = outarcoffsets.size() - 1;
+        const size_t u = j / numstates;
+        const size_t s = j % numstates;
+        const size_t numframes = uttframes[u];
+        if (t >= numframes)
+            return;
+        const size_t col = uttfirstcols[u] + t * numchannels;
+        float logbeta = LOGZERO;
+        for (size_t k = outarcoffsets[s]; k < outarcoffsets[s + 1]; k++) // arcs out of s
+        {
+            const denominatorarc &arc = outarcs[k];
+            const float lognext = (t + 1 == numframes) ? logfinal[arc.to] : logbetas(arc.to, col + numchannels);
+            logadd(logbeta, arc.logweight + logLLs(arc.pdf, col) + lognext);
+        }
+        logbetas(s, col) = logbeta;
+    }
+
+    // log total score of utterance u, the normalizer of its posteriors
+    template <typename uintvector, typename floatvector, typename matrix>
+    static inline __device__ void denominatortotalu(size_t u, const floatvector &loginitial, const uintvector &uttfirstcols, const uintvector &uttframes,
+                                                    const matrix &logbetas, floatvector &logtotals)
+    {
+        float logtotal = LOGZERO;
+        if (uttframes[u] > 0)
+            for (size_t s = 0; s < loginitial.size(); s++)
+                logadd(logtotal, loginitial[s] + logbetas(s, uttfirstcols[u]));
+        logtotals[u] = logtotal;
+    }
+
+    // posterior of pdf p in frame t of utterance u, summed over the arcs that emit p; j = (u * maxframes + t) * numpdfs + p
+    template <typename denominatorarcvector, typename uintvector, typename floatvector, typename matrix>
+    static inline __device__ void denominatorposteriorj(size_t j, const denominatorarcvector &pdfarcs, const uintvector &pdfarcoffsets,
+                                                        const floatvector &loginitial, const floatvector &logfinal,
+                                                        const uintvector &uttfirstcols, const uintvector &uttframes, const size_t numchannels, const size_t maxframes,
+                                                        const matrix &logLLs, const matrix &logalphas, const matrix &logbetas, const floatvector &logtotals,
+                                                        matrix &posteriors)
+    {
+        const size_t numpdfs = pdfarcoffsets.size() - 1;
+        const size_t p = j % numpdfs;
+        const size_t t = (j / numpdfs) % maxframes;
+        const size_t u = j / numpdfs / maxframes;
+        const size_t numframes = uttframes[u];
+        if (t >= numframes)
+            return;
+        const size_t col = uttfirstcols[u] + t * numchannels;
+        float logpp = LOGZERO;
+        for (size_t k = pdfarcoffsets[p]; k < pdfarcoffsets[p + 1]; k++) // arcs that emit p
+        {
+            const denominatorarc &arc = pdfarcs[k];
+            const float logprev = (t == 0) ? loginitial[arc.from] : logalphas(arc.from, col - numchannels);
+            const float lognext = (t + 1 == numframes) ? logfinal[arc.to] : logbetas(arc.to, col + numchannels);
+            logadd(logpp, logprev + arc.logweight + lognext);
+        }
+        posteriors(p, col) = (logpp <= LOGZERO) ? 0.0f : expfd(logpp + logLLs(p, col) - logtotals[u]);
+    }
 };
 
 }};
@@ -13,12 +13,16 @@
 #define _CRT_NONSTDC_NO_DEPRECATE // make VS accept POSIX functions without _
 
 #include "PerformanceProfiler.h"
+#include "TrainingMetrics.h"
 #include "Basics.h"
 #include "fileutil.h"
 #include "TimerUtility.h"
 #include <algorithm>
+#include <deque>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <stdio.h>
 #ifndef CPUONLY
 #include <cuda_runtime_api.h>
@@ -67,6 +71,34 @@ static const FixedEventDesc c_fixedEvtDesc[profilerEvtMax] = {
     { "", profilerEvtSeparator, false },                            // profilerSepSpace2
 
     { "Prefetch Minibatch", profilerEvtTime, false },               // profilerEvtPrefetchMinibatch
+    { "Prefetch Queue Full", profilerEvtTime, false },              // profilerEvtPrefetchQueueFull
+    { "_Reader Stall", profilerEvtTime, false },                    // profilerEvtPrefetchReaderStall
+    { "_Copy Stall", profilerEvtTime, false },                      // profilerEvtPrefetchCopyStall
+
+    { "", profilerEvtSeparator, false },                            // profilerSepSpace3
+    { "Communication", profilerEvtSeparator, false },               // profilerSepCommunication
+    { "", profilerEvtSeparator, false },                            // profilerSepSpace4
+
+    { "AllReduce", profilerEvtTime, false },                        // profilerEvtCommAllReduce
+    { "ReduceScatter", profilerEvtTime, false },                    // profilerEvtCommReduceScatter
+    { "AllGather", profilerEvtTime, false },                        // profilerEvtCommAllGather
+    { "Broadcast", profilerEvtTime, false },                        // profilerEvtCommBroadcast
+    { "Wait", profilerEvtTime, false },                             // profilerEvtCommWait
+    { "Bus Bandwidth", profilerEvtThroughput, false },              // profilerEvtCommBusBandwidth
+
+    { "", profilerEvtSeparator, false },                            // profilerSepSpace5
+    { "Model Loading", profilerEvtSeparator, false },               // profilerSepModelLoading
+    { "", profilerEvtSeparator, false },                            // profilerSepSpace6
+
+    { "Load Model", profilerEvtTime, false },                       // profilerEvtLoadModel
+    { "_Config Parsing", profilerEvtTime, false },                  // profilerEvtLoadConfig
+    { "_Network Construction", profilerEvtTime, false },            // profilerEvtLoadBuild
+    { "_Deserialization", profilerEvtTime, false },                 // profilerEvtLoadDeserialize
+    { "_Compilation", profilerEvtTime, false },                     // profilerEvtLoadCompile
+    { "__Validation", profilerEvtTime, false },                     // profilerEvtLoadValidate
+    { "Matrix Allocation", profilerEvtTime, true },                 // profilerEvtLoadAllocate
+    { "_Memory Sharing Plan", profilerEvtTime, false },             // profilerEvtLoadMemoryPlan
+    { "cuDNN Init", profilerEvtTime, false },                       // profilerEvtLoadCuDnnInit
 };
 
 
@@ -91,6 +123,57 @@ struct CustomEventRecord
     unsigned int    threadId;
 };
 
+//
+// Record of a collective communication operation, see ProfilerCommEnd()
+//
+struct CommEventRecord
+{
+    int             eventId;
+    const char*     algorithm;    // static string
+    long long       bytes;
+    int             numNodes;
+    long long       beginClock;
+    long long       endClock;
+    long long       waitClocks;
+    unsigned int    threadId;
+};
+
+
+//
+// Estimated cost of the computation of a node, see ProfilerNodeEnd()
+//
+struct NodeCostRecord
+{
+    double              flops;
+    double              bytes;
+};
+
+//
+// Forward and backward times of a node, see ProfilerNodeEnd()
+//
+struct NodeTimeRecord
+{
+    std::wstring        operation;
+    FixedEventRecord    forward;      // time (ns)
+    FixedEventRecord    backward;     // time (ns)
+    NodeCostRecord      forwardCost;  // of the computations whose time is recorded
+    NodeCostRecord      backwardCost;
+};
+
+#ifndef CPUONLY
+//
+// A node timed by CUDA events that have not completed yet, indices into ProfilerState::nodeEvents
+//
+struct PendingNodeEvent
+{
+    size_t              beginEvent;
+    size_t              endEvent;
+    NodeTimeRecord*     record;
+    bool                backward;
+    NodeCostRecord      cost;
+};
+#endif
+
 
 //
 // Global state of the profiler
@@ -107,6 +190,21 @@ struct ProfilerState
     unsigned long long      customEventBufferBytes;      // Number of bytes allocated for the custom event buffer
     unsigned long long      customEventOffset;           // Offset to current place in buffer
     unique_ptr<char[]>      customEventBuffer;           // Pointer to custom event buffer
+    std::vector<CommEventRecord> commEvents;             // Collective communication operations, up to the capacity reserved
+    bool                    nodeTiming;                  // Time the forward/backward computation of each node
+    std::map<std::wstring, NodeTimeRecord> nodeTimes;    // Node times by node name
+    double                  peakGFlops;                  // Peak compute of the device for the roofline report, 0 if not known
+    double                  peakGBps;                    // Peak memory bandwidth of the device, 0 if not known
+    int                     rooflineMinibatches;         // Write the roofline report after this many minibatches, 0 for never
+#ifndef CPUONLY
+    std::vector<cudaEvent_t> nodeEvents;                 // CUDA events for node timing, reused
+    std::vector<cudaStream_t> nodeEventStreams;          // Stream on which each event was last recorded
+    std::vector<size_t>     freeNodeEvents;              // Indices of the events that are not in use
+    std::deque<PendingNodeEvent> pendingNodeEvents;      // Nodes whose events are not resolved yet, in recording order
+#endif
+    std::map<unsigned int, const char*> threadNames;     // Names of the thread tracks in the trace
+    int                     rank;                        // Rank of this process, the process id in the trace
+    long long               clockOffset;                 // Offset to the clock of rank 0 (ticks)
 };
 
 
@@ -118,12 +216,20 @@ static std::mutex g_mutex;
 
 // Forward declarations
 unsigned int GetThreadId();
+void ProfilerThroughputRecordFixedEvent(const int eventId, const long long beginClock, const long long endClock, const long long bytes);
+void ProfilerResolveNodeEvents(const bool wait);
+void ProfilerReleaseNodeEvents();
 
 void ProfilerGenerateReport(const std::wstring& fileName, struct tm* timeInfo);
+void ProfilerGenerateNodeReport(FILE* f);
+void ProfilerGenerateRooflineReport(FILE* f);
+void ProfilerGenerateRooflineFile();
 void FormatTimeStr(char* str, size_t strLen, double value);
 void FormatThroughputStr(char* str, size_t strLen, double value);
 void FormatBytesStr(char* str, size_t strLen, long long bytes);
 void ProfilerGenerateDetailFile(const std::wstring& fileName);
+void ProfilerGenerateCommFile(const std::wstring& fileName);
+void ProfilerGenerateTraceFile(const std::wstring& fileName);
 
 
 double TicksToSeconds(long long ticks)
@@ -138,6 +244,17 @@ double TicksSqToSecondsSq(double ticksSq)
     return ticksSq / ticksPerSec / ticksPerSec;
 }
 
+// The share of its data that each node sends (and receives) in a collective operation.
+double CommBusFactor(int eventId, int numNodes)
+{
+    if (numNodes > 1 && eventId == profilerEvtCommAllReduce)
+        return 2.0 * (numNodes - 1) / numNodes;
+    else if (numNodes > 1 && (eventId == profilerEvtCommReduceScatter || eventId == profilerEvtCommAllGather))
+        return (double)(numNodes - 1) / numNodes;
+    else
+        return 1.0;
+}
+
 
 //
 // Initialize all resources to enable profiling.
@@ -162,9 +279,16 @@ void PERF_PROFILER_API ProfilerInit(const std::wstring& profilerDir, const unsig
     g_profilerState->customEventBufferBytes = customEventBufferBytes;
     g_profilerState->customEventOffset = 0ull;
     g_profilerState->customEventBuffer.reset(new char[customEventBufferBytes]);
+    g_profilerState->commEvents.reserve(customEventBufferBytes / 4 / sizeof(CommEventRecord));
 
     g_profilerState->syncGpu = syncGpu;
     g_profilerState->enabled = false;
+    g_profilerState->nodeTiming = false;
+    g_profilerState->peakGFlops = 0.0;
+    g_profilerState->peakGBps = 0.0;
+    g_profilerState->rooflineMinibatches = 0;
+    g_profilerState->rank = 0;
+    g_profilerState->clockOffset = 0;
 
     if (_wmkdir(g_profilerState->profilerDir.c_str()) == -1 && errno != EEXIST)
     {
@@ -186,10 +310,29 @@ void PERF_PROFILER_API ProfilerEnable(bool enable)
     g_profilerState->enabled = enable;
 }
 
+bool PERF_PROFILER_API ProfilerIsEnabled()
+{
+    return g_profilerState != nullptr && g_profilerState->enabled;
+}
+
 
 //
 // Internal helper functions to record fixed and custom profiling events.
 //
+void ProfilerRecordTime(FixedEventRecord& record, const long long delta)
+{
+    if (record.cnt == 0)
+    {
+        record.min = delta;
+        record.max = delta;
+    }
+    record.min = std::min(delta, record.min);
+    record.max = std::max(delta, record.max);
+    record.sum += delta;
+    record.sumsq += (double)delta * (double)delta;
+    record.cnt++;
+}
+
 void ProfilerTimeRecordFixedEvent(const int eventId, const long long beginClock, const long long endClock)
 {
     std::lock_guard<std::mutex> lock(g_mutex);
@@ -197,17 +340,7 @@ void ProfilerTimeRecordFixedEvent(const int eventId, const long long beginClock,
     if (!g_profilerState->enabled)
         return;
 
-    long long delta = endClock - beginClock;
-    if (g_profilerState->fixedEvents[eventId].cnt == 0)
-    {
-        g_profilerState->fixedEvents[eventId].min = delta;
-        g_profilerState->fixedEvents[eventId].max = delta;
-    }
-    g_profilerState->fixedEvents[eventId].min = std::min(delta, g_profilerState->fixedEvents[eventId].min);
-    g_profilerState->fixedEvents[eventId].max = std::max(delta, g_profilerState->fixedEvents[eventId].max);
-    g_profilerState->fixedEvents[eventId].sum += delta;
-    g_profilerState->fixedEvents[eventId].sumsq += (double)delta * (double)delta;
-    g_profilerState->fixedEvents[eventId].cnt++;
+    ProfilerRecordTime(g_profilerState->fixedEvents[eventId], endClock - beginClock);
 }
 
 void ProfilerTimeRecordToBuffer(const char* eventDescription, const long long beginClock, const long long endClock)
@@ -257,14 +390,24 @@ void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const int eventI
 {
     // A nullptr state indicates that the profiler is globally disabled, and not initialized
     if (g_profilerState == nullptr)
+    {
+        // the training metrics are recorded without the profiler as well
+        if (TrainingMetricsIsEnabled())
+            TrainingMetricsRecordEvent(eventId, stateId, Clock::GetTimeStamp());
         return;
+    }
 
     if (c_fixedEvtDesc[eventId].syncGpu)
         ProfilerSyncGpu();
 
     long long endClock = Clock::GetTimeStamp();
+    TrainingMetricsRecordEvent(eventId, stateId, endClock);
     ProfilerTimeRecordFixedEvent(eventId, stateId, endClock);
     ProfilerTimeRecordToBuffer(c_fixedEvtDesc[eventId].eventDescription, stateId, endClock);
+
+    if (eventId == profilerEvtMainMinibatch && g_profilerState->enabled &&
+        g_profilerState->fixedEvents[eventId].cnt == g_profilerState->rooflineMinibatches)
+        ProfilerGenerateRooflineFile();
 }
 
 
@@ -322,7 +465,15 @@ void PERF_PROFILER_API ProfilerThroughputEnd(const long long stateId, const int
     if (!g_profilerState->enabled)
         return;
 
-    auto beginClock = stateId;
+    ProfilerThroughputRecordFixedEvent(eventId, stateId, endClock, bytes);
+}
+
+
+//
+// Internal helper function to record a throughput event, with the mutex held.
+//
+void ProfilerThroughputRecordFixedEvent(const int eventId, const long long beginClock, const long long endClock, const long long bytes)
+{
     if (endClock == beginClock)
         return;
 
@@ -342,6 +493,310 @@ void PERF_PROFILER_API ProfilerThroughputEnd(const long long stateId, const int
 }
 
 
+//
+// Record a collective communication operation that started at stateId (from ProfilerTimeBegin()).
+//
+void PERF_PROFILER_API ProfilerCommEnd(const long long stateId, const int eventId, const char* algorithm, const long long bytes,
+    const int numNodes, const long long waitTicks)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return;
+
+    long long endClock = Clock::GetTimeStamp();
+    ProfilerTimeRecordFixedEvent(eventId, stateId, endClock);
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    if (!g_profilerState->enabled)
+        return;
+
+    ProfilerThroughputRecordFixedEvent(profilerEvtCommBusBandwidth, stateId, endClock, (long long)(bytes * CommBusFactor(eventId, numNodes)));
+
+    // The records are not reallocated, so that recording stays cheap.
+    if (g_profilerState->commEvents.size() == g_profilerState->commEvents.capacity())
+    {
+        if (!g_profilerState->customEventBufferFull)
+        {
+            fprintf(stderr, "Warning: Performance Profiler: Buffer is full, no more events will be recorded.\n");
+            g_profilerState->customEventBufferFull = true;
+        }
+        return;
+    }
+
+    CommEventRecord eventRecord;
+    eventRecord.eventId = eventId;
+    eventRecord.algorithm = algorithm;
+    eventRecord.bytes = bytes;
+    eventRecord.numNodes = numNodes;
+    eventRecord.beginClock = stateId;
+    eventRecord.endClock = endClock;
+    eventRecord.waitClocks = waitTicks < 0 ? endClock - stateId : waitTicks;
+    eventRecord.threadId = GetThreadId();
+    g_profilerState->commEvents.push_back(eventRecord);
+}
+
+
+//
+// Enable/disable the timing of each node.
+//
+void PERF_PROFILER_API ProfilerEnableNodeTiming(bool enable)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return;
+
+    g_profilerState->nodeTiming = enable;
+}
+
+bool PERF_PROFILER_API ProfilerIsNodeTimingEnabled()
+{
+    return g_profilerState != nullptr && g_profilerState->enabled && g_profilerState->nodeTiming;
+}
+
+
+//
+// Set the peak performance of the device and when to write the roofline report.
+//
+void PERF_PROFILER_API ProfilerSetRoofline(const double peakGFlops, const double peakGBps, const int reportAfterMinibatches)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return;
+
+    g_profilerState->peakGFlops = peakGFlops;
+    g_profilerState->peakGBps = peakGBps;
+    g_profilerState->rooflineMinibatches = reportAfterMinibatches;
+}
+
+
+//
+// The record of a node, created on first use. Called with the mutex held.
+//
+NodeTimeRecord& ProfilerGetNodeRecord(const wchar_t* nodeName, const wchar_t* operationName)
+{
+    auto& record = g_profilerState->nodeTimes[nodeName];
+    if (record.operation.empty())
+        record.operation = operationName;
+    return record;
+}
+
+#ifndef CPUONLY
+//
+// Records a node timing event on the stream, returns its index, or -1 if that is not possible, e.g. while the
+// stream is captured into a CUDA graph. Called with the mutex held.
+//
+long long ProfilerRecordNodeEvent(cudaStream_t stream)
+{
+#if CUDART_VERSION >= 10000
+    cudaStreamCaptureStatus captureStatus;
+    if (cudaStreamIsCapturing(stream, &captureStatus) != cudaSuccess || captureStatus != cudaStreamCaptureStatusNone)
+        return -1;
+#endif
+
+    size_t index;
+    if (!g_profilerState->freeNodeEvents.empty())
+    {
+        index = g_profilerState->freeNodeEvents.back();
+        g_profilerState->freeNodeEvents.pop_back();
+    }
+    else
+    {
+        cudaEvent_t event;
+        if (cudaEventCreate(&event) != cudaSuccess)
+            return -1;
+        index = g_profilerState->nodeEvents.size();
+        g_profilerState->nodeEvents.push_back(event);
+        g_profilerState->nodeEventStreams.push_back(stream);
+    }
+
+    if (cudaEventRecord(g_profilerState->nodeEvents[index], stream) != cudaSuccess)
+    {
+        g_profilerState->freeNodeEvents.push_back(index);
+        return -1;
+    }
+    g_profilerState->nodeEventStreams[index] = stream;
+    return (long long)index;
+}
+#endif
+
+
+//
+// Time the forward or backward computation of a node.
+// The stateId is the host clock at the beginning, or -2 - the index of the CUDA event recorded at the beginning,
+// or -1 if the node is not timed.
+//
+long long PERF_PROFILER_API ProfilerNodeBegin(const bool gpu, void* stream)
+{
+    if (!ProfilerIsNodeTimingEnabled())
+        return -1;
+
+#ifndef CPUONLY
+    if (gpu)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        long long index = ProfilerRecordNodeEvent((cudaStream_t)stream);
+        return index < 0 ? -1 : -2 - index;
+    }
+#else
+    UNUSED(gpu);
+    UNUSED(stream);
+#endif
+
+    return Clock::GetTimeStamp();
+}
+
+
+void ProfilerAddNodeCost(NodeCostRecord& record, const NodeCostRecord& cost)
+{
+    record.flops += cost.flops;
+    record.bytes += cost.bytes;
+}
+
+void PERF_PROFILER_API ProfilerNodeEnd(const long long stateId, const wchar_t* nodeName, const wchar_t* operationName, const bool backward,
+    const double flops, const double bytes)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr || stateId == -1)
+        return;
+
+    if (stateId >= 0)
+    {
+        long long endClock = Clock::GetTimeStamp();
+        std::lock_guard<std::mutex> lock(g_mutex);
+        NodeTimeRecord& record = ProfilerGetNodeRecord(nodeName, operationName);
+        ProfilerRecordTime(backward ? record.backward : record.forward, endClock - stateId);
+        ProfilerAddNodeCost(backward ? record.backwardCost : record.forwardCost, NodeCostRecord{ flops, bytes });
+        return;
+    }
+
+#ifndef CPUONLY
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    // The end event goes to the stream of the begin event; the work in between is on that stream.
+    size_t beginEvent = (size_t)(-2 - stateId);
+    long long endEvent = ProfilerRecordNodeEvent(g_profilerState->nodeEventStreams[beginEvent]);
+    if (endEvent < 0)
+    {
+        g_profilerState->freeNodeEvents.push_back(beginEvent);
+        return;
+    }
+
+    PendingNodeEvent pending;
+    pending.beginEvent = beginEvent;
+    pending.endEvent = (size_t)endEvent;
+    pending.record = &ProfilerGetNodeRecord(nodeName, operationName);
+    pending.backward = backward;
+    pending.cost = NodeCostRecord{ flops, bytes };
+    g_profilerState->pendingNodeEvents.push_back(pending);
+
+    ProfilerResolveNodeEvents(false);
+#endif
+}
+
+
+//
+// Add the times of the nodes whose events have completed (all of them if wait is set) to their records.
+// Called with the mutex held.
+//
+void ProfilerResolveNodeEvents(const bool wait)
+{
+#ifndef CPUONLY
+    auto& pendingNodeEvents = g_profilerState->pendingNodeEvents;
+    while (!pendingNodeEvents.empty())
+    {
+        const PendingNodeEvent& pending = pendingNodeEvents.front();
+        cudaEvent_t beginEvent = g_profilerState->nodeEvents[pending.beginEvent];
+        cudaEvent_t endEvent = g_profilerState->nodeEvents[pending.endEvent];
+
+        cudaError_t status = wait ? cudaEventSynchronize(endEvent) : cudaEventQuery(endEvent);
+        if (status == cudaErrorNotReady)
+            break;
+
+        float milliseconds;
+        if (status == cudaSuccess && cudaEventElapsedTime(&milliseconds, beginEvent, endEvent) == cudaSuccess)
+        {
+            long long delta = (long long)(milliseconds / 1000.0 * Clock::GetTicksPerSecond());
+            ProfilerRecordTime(pending.backward ? pending.record->backward : pending.record->forward, delta);
+            ProfilerAddNodeCost(pending.backward ? pending.record->backwardCost : pending.record->forwardCost, pending.cost);
+        }
+
+        g_profilerState->freeNodeEvents.push_back(pending.beginEvent);
+        g_profilerState->freeNodeEvents.push_back(pending.endEvent);
+        pendingNodeEvents.pop_front();
+    }
+#else
+    UNUSED(wait);
+#endif
+}
+
+
+//
+// Resolve the outstanding node events and destroy all of them.
+//
+void ProfilerReleaseNodeEvents()
+{
+#ifndef CPUONLY
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    ProfilerResolveNodeEvents(true);
+    for (auto event : g_profilerState->nodeEvents)
+        cudaEventDestroy(event);
+    g_profilerState->nodeEvents.clear();
+    g_profilerState->nodeEventStreams.clear();
+    g_profilerState->freeNodeEvents.clear();
+#endif
+}
+
+
+//
+// Number of occurrences and total time recorded so far for a fixed time event.
+//
+void PERF_PROFILER_API ProfilerGetFixedEventTime(const int eventId, int& count, double& totalSeconds)
+{
+    count = 0;
+    totalSeconds = 0.0;
+
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    count = g_profilerState->fixedEvents[eventId].cnt;
+    totalSeconds = TicksToSeconds(g_profilerState->fixedEvents[eventId].sum);
+}
+
+
+//
+// Name the calling thread for the trace.
+//
+void PERF_PROFILER_API ProfilerSetThreadName(const char* name)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_profilerState->threadNames[GetThreadId()] = name;
+}
+
+
+//
+// Set the rank of this process and the offset of its clock to the clock of rank 0.
+//
+void PERF_PROFILER_API ProfilerSetRank(const int rank, const long long clockOffset)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_profilerState->rank = rank;
+    g_profilerState->clockOffset = clockOffset;
+}
+
+
 //
 // Generate reports and release all resources.
 //
@@ -351,6 +806,8 @@ void PERF_PROFILER_API ProfilerClose()
     if (g_profilerState == nullptr)
         return;
 
+    ProfilerReleaseNodeEvents();
+
     // Get current time as yyyy-mm-dd_hh-mm-ss
     time_t currentTime;
     time(&currentTime);
@@ -366,6 +823,17 @@ void PERF_PROFILER_API ProfilerClose()
     fileName = g_profilerState->profilerDir + L"/" + std::wstring(timeStr) + L"_detail_" + g_profilerState->logSuffix + L".csv";
     ProfilerGenerateDetailFile(fileName);
 
+    // Generate communication event file
+    if (!g_profilerState->commEvents.empty())
+    {
+        fileName = g_profilerState->profilerDir + L"/" + std::wstring(timeStr) + L"_comm_" + g_profilerState->logSuffix + L".csv";
+        ProfilerGenerateCommFile(fileName);
+    }
+
+    // Generate trace of all events
+    fileName = g_profilerState->profilerDir + L"/" + std::wstring(timeStr) + L"_trace_" + g_profilerState->logSuffix + L".json";
+    ProfilerGenerateTraceFile(fileName);
+
     g_profilerState.reset();
 }
 
@@ -484,6 +952,176 @@ void ProfilerGenerateReport(const std::wstring& fileName, struct tm* timeInfo)
         if (printLine) fprintfOrDie(f, "\n");
     }
 
+    if (!g_profilerState->nodeTimes.empty())
+        ProfilerGenerateNodeReport(f);
+
+    fclose(f);
+}
+
+//
+// Add the node times to the summary report, by node and by operation type, the most expensive first.
+//
+void ProfilerMergeTime(FixedEventRecord& record, const FixedEventRecord& other)
+{
+    if (other.cnt == 0)
+        return;
+    record.min = record.cnt == 0 ? other.min : std::min(record.min, other.min);
+    record.max = record.cnt == 0 ? other.max : std::max(record.max, other.max);
+    record.sum += other.sum;
+    record.sumsq += other.sumsq;
+    record.cnt += other.cnt;
+}
+
+void ProfilerPrintNodeTimes(FILE* f, const std::vector<std::pair<std::wstring, const NodeTimeRecord*>>& records, const bool printOperation)
+{
+    for (const auto& entry : records)
+    {
+        const NodeTimeRecord& record = *entry.second;
+        if (printOperation)
+            fprintfOrDie(f, "%-40ls %-24ls: ", entry.first.c_str(), record.operation.c_str());
+        else
+            fprintfOrDie(f, "%-65ls: ", entry.first.c_str());
+
+        char str[32];
+        for (const FixedEventRecord* time : { &record.forward, &record.backward })
+        {
+            FormatTimeStr(str, sizeof(str), time->cnt > 0 ? TicksToSeconds(time->sum) / time->cnt : 0.0);
+            fprintfOrDie(f, "%s ", str);
+            FormatTimeStr(str, sizeof(str), TicksToSeconds(time->sum));
+            fprintfOrDie(f, "%s ", str);
+        }
+        fprintfOrDie(f, "%16d ", record.forward.cnt);
+        FormatTimeStr(str, sizeof(str), TicksToSeconds(record.forward.sum + record.backward.sum));
+        fprintfOrDie(f, "%s\n", str);
+    }
+}
+
+void ProfilerGenerateNodeReport(FILE* f)
+{
+    auto byTotal = [](const std::pair<std::wstring, const NodeTimeRecord*>& a, const std::pair<std::wstring, const NodeTimeRecord*>& b)
+    {
+        return a.second->forward.sum + a.second->backward.sum > b.second->forward.sum + b.second->backward.sum;
+    };
+
+    std::vector<std::pair<std::wstring, const NodeTimeRecord*>> nodes;
+    std::map<std::wstring, NodeTimeRecord> operationTimes;
+    for (const auto& node : g_profilerState->nodeTimes)
+    {
+        nodes.push_back(std::make_pair(node.first, &node.second));
+        NodeTimeRecord& operation = operationTimes[node.second.operation];
+        ProfilerMergeTime(operation.forward, node.second.forward);
+        ProfilerMergeTime(operation.backward, node.second.backward);
+    }
+    std::sort(nodes.begin(), nodes.end(), byTotal);
+
+    std::vector<std::pair<std::wstring, const NodeTimeRecord*>> operations;
+    for (const auto& operation : operationTimes)
+        operations.push_back(std::make_pair(operation.first, &operation.second));
+    std::sort(operations.begin(), operations.end(), byTotal);
+
+    const char* columns = "....Forward Mean ...Forward Total ...Backward Mean ..Backward Total ...........Count ...........Total\n\n";
+
+    fprintfOrDie(f, "\nNodes\n\n");
+    fprintfOrDie(f, "Node.................................... Operation...............: %s", columns);
+    ProfilerPrintNodeTimes(f, nodes, true);
+
+    fprintfOrDie(f, "\nOperations\n\n");
+    fprintfOrDie(f, "Operation........................................................: %s", columns);
+    ProfilerPrintNodeTimes(f, operations, false);
+
+    ProfilerGenerateRooflineReport(f);
+}
+
+//
+// Add the achieved FLOP/s and bandwidth of the nodes to a report, from their estimated cost and their times, by node
+// and by operation type, the most expensive first. Relative to the peak of the device if known (ProfilerSetRoofline()).
+//
+void ProfilerPrintRoofline(FILE* f, const std::vector<std::pair<std::wstring, NodeTimeRecord>>& records, const bool printOperation)
+{
+    for (const auto& entry : records)
+    {
+        const NodeTimeRecord& record = entry.second;
+        double flops = record.forwardCost.flops + record.backwardCost.flops;
+        double bytes = record.forwardCost.bytes + record.backwardCost.bytes;
+        double seconds = TicksToSeconds(record.forward.sum + record.backward.sum);
+        if (seconds <= 0.0 || bytes <= 0.0)
+            continue;
+
+        if (printOperation)
+            fprintfOrDie(f, "%-40ls %-24ls: ", entry.first.c_str(), record.operation.c_str());
+        else
+            fprintfOrDie(f, "%-65ls: ", entry.first.c_str());
+
+        double gflops = flops / seconds / 1e9;
+        double gbps = bytes / seconds / 1e9;
+        fprintfOrDie(f, "%16.3f %16.3f %16.2f %16.2f %16.2f ", flops / 1e9, bytes / 1e9, flops / bytes, gflops, gbps);
+        if (g_profilerState->peakGFlops > 0.0 && g_profilerState->peakGBps > 0.0)
+        {
+            // below the ridge point of the roofline the memory bandwidth is the limit
+            bool memoryBound = flops / bytes < g_profilerState->peakGFlops / g_profilerState->peakGBps;
+            fprintfOrDie(f, "%15.1f%% %15.1f%% %16s", 100.0 * gflops / g_profilerState->peakGFlops, 100.0 * gbps / g_profilerState->peakGBps,
+                memoryBound ? "memory" : "compute");
+        }
+        fprintfOrDie(f, "\n");
+    }
+}
+
+void ProfilerGenerateRooflineReport(FILE* f)
+{
+    auto byTime = [](const std::pair<std::wstring, NodeTimeRecord>& a, const std::pair<std::wstring, NodeTimeRecord>& b)
+    {
+        return a.second.forward.sum + a.second.backward.sum > b.second.forward.sum + b.second.backward.sum;
+    };
+
+    std::vector<std::pair<std::wstring, NodeTimeRecord>> nodes(g_profilerState->nodeTimes.begin(), g_profilerState->nodeTimes.end());
+    std::map<std::wstring, NodeTimeRecord> operationTimes;
+    for (const auto& node : nodes)
+    {
+        NodeTimeRecord& operation = operationTimes[node.second.operation];
+        ProfilerMergeTime(operation.forward, node.second.forward);
+        ProfilerMergeTime(operation.backward, node.second.backward);
+        ProfilerAddNodeCost(operation.forwardCost, node.second.forwardCost);
+        ProfilerAddNodeCost(operation.backwardCost, node.second.backwardCost);
+    }
+    std::sort(nodes.begin(), nodes.end(), byTime);
+    std::vector<std::pair<std::wstring, NodeTimeRecord>> operations(operationTimes.begin(), operationTimes.end());
+    std::sort(operations.begin(), operations.end(), byTime);
+
+    std::string columns = "...........GFLOP ..............GB ..........FLOP/B .........GFLOP/s ............GB/s";
+    if (g_profilerState->peakGFlops > 0.0 && g_profilerState->peakGBps > 0.0)
+        columns += " ...%Peak GFLOP/s ......%Peak GB/s ...........Bound";
+
+    fprintfOrDie(f, "\nRoofline (estimated cost of forward + backward)\n\n");
+    if (g_profilerState->peakGFlops > 0.0 && g_profilerState->peakGBps > 0.0)
+        fprintfOrDie(f, "Device peak: %.1f GFLOP/s, %.1f GB/s\n\n", g_profilerState->peakGFlops, g_profilerState->peakGBps);
+    fprintfOrDie(f, "Node.................................... Operation...............: %s\n\n", columns.c_str());
+    ProfilerPrintRoofline(f, nodes, true);
+
+    fprintfOrDie(f, "\nOperation........................................................: %s\n\n", columns.c_str());
+    ProfilerPrintRoofline(f, operations, false);
+}
+
+//
+// Write the roofline report of the nodes timed so far to its own file, while training continues.
+//
+void ProfilerGenerateRooflineFile()
+{
+    time_t currentTime;
+    time(&currentTime);
+    wchar_t timeStr[32];
+    wcsftime(timeStr, sizeof(timeStr) / sizeof(timeStr[0]), L"%Y-%m-%d_%H-%M-%S", localtime(&currentTime));
+    std::wstring fileName = g_profilerState->profilerDir + L"/" + std::wstring(timeStr) + L"_roofline_" + g_profilerState->logSuffix + L".txt";
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    ProfilerResolveNodeEvents(true);
+
+    FILE* f = _wfopen(fileName.c_str(), L"wt");
+    if (f == NULL)
+    {
+        RuntimeError("Error: ProfilerGenerateRooflineFile: Cannot create file <%ls>.\n", fileName.c_str());
+    }
+    fprintfOrDie(f, "CNTK Performance Profiler Roofline Report after %d minibatches\n", g_profilerState->rooflineMinibatches);
+    ProfilerGenerateRooflineReport(f);
     fclose(f);
 }
 
@@ -555,6 +1193,116 @@ void ProfilerGenerateDetailFile(const std::wstring& fileName)
 }
 
 
+//
+// Generate communication event file.
+//
+void ProfilerGenerateCommFile(const std::wstring& fileName)
+{
+    FILE* f = _wfopen(fileName.c_str(), L"wt");
+    if (f == NULL)
+    {
+        RuntimeError("Error: ProfilerGenerateCommFile: Cannot create file <%ls>.\n", fileName.c_str());
+    }
+
+    fprintfOrDie(f, "Operation,Algorithm,Bytes,Nodes,ThreadId,BeginTimeStamp(ms),EndTimeStamp(ms),WaitTime(ms),TransferTime(ms),BusBandwidth(MBps)\n");
+
+    for (const auto& eventRecord : g_profilerState->commEvents)
+    {
+        // The operation is in flight from its start to its end, the caller is blocked for the wait time of that.
+        double seconds = TicksToSeconds(eventRecord.endClock - eventRecord.beginClock);
+        double busFactor = CommBusFactor(eventRecord.eventId, eventRecord.numNodes);
+
+        fprintfOrDie(f, "\"%s\",\"%s\",%lld,%d,%u,%.8f,%.8f,%.8f,%.8f,%.3f\n",
+            c_fixedEvtDesc[eventRecord.eventId].eventDescription, eventRecord.algorithm, eventRecord.bytes, eventRecord.numNodes, eventRecord.threadId,
+            1000.0 * TicksToSeconds(eventRecord.beginClock),
+            1000.0 * TicksToSeconds(eventRecord.endClock),
+            1000.0 * TicksToSeconds(eventRecord.waitClocks),
+            1000.0 * seconds,
+            seconds > 0 ? eventRecord.bytes * busFactor / seconds / 1000000.0 : 0.0);
+    }
+
+    fclose(f);
+}
+
+
+//
+// Generate the trace of all events in the trace event format (one complete event per recorded event), with
+// time stamps in microseconds on the clock of rank 0.
+//
+double TicksToTraceMicroseconds(long long ticks)
+{
+    return 1000000.0 * TicksToSeconds(ticks + g_profilerState->clockOffset);
+}
+
+// Escapes a string for JSON, control characters are dropped.
+void FormatJsonStr(std::string& str, const char* value)
+{
+    str.clear();
+    for (const char* c = value; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            str.push_back('\\');
+        if ((unsigned char)*c >= 0x20)
+            str.push_back(*c);
+    }
+}
+
+void ProfilerGenerateTraceFile(const std::wstring& fileName)
+{
+    FILE* f = _wfopen(fileName.c_str(), L"wt");
+    if (f == NULL)
+    {
+        RuntimeError("Error: ProfilerGenerateTraceFile: Cannot create file <%ls>.\n", fileName.c_str());
+    }
+
+    int pid = g_profilerState->rank;
+    std::string str;
+    fprintfOrDie(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintfOrDie(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Rank %d\"}}", pid, pid);
+    fprintfOrDie(f, ",\n{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"sort_index\":%d}}", pid, pid);
+    for (const auto& thread : g_profilerState->threadNames)
+    {
+        FormatJsonStr(str, thread.second);
+        fprintfOrDie(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", pid, thread.first, str.c_str());
+    }
+
+    char* eventPtr = g_profilerState->customEventBuffer.get();
+    while (eventPtr < (g_profilerState->customEventBuffer.get() + g_profilerState->customEventOffset))
+    {
+        char* descriptionStr = eventPtr;
+        eventPtr += strlen(descriptionStr) + 1;
+
+        CustomEventRecord* eventRecord = (CustomEventRecord*)eventPtr;
+        eventPtr += sizeof(CustomEventRecord);
+
+        // fixed events are indented by underscores in the summary report
+        const char* name = descriptionStr;
+        while (*name == '_')
+            name++;
+        FormatJsonStr(str, name);
+        fprintfOrDie(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            str.c_str(), pid, eventRecord->threadId,
+            TicksToTraceMicroseconds(eventRecord->beginClock),
+            1000000.0 * TicksToSeconds(eventRecord->endClock - eventRecord->beginClock));
+    }
+
+    for (const auto& eventRecord : g_profilerState->commEvents)
+    {
+        FormatJsonStr(str, eventRecord.algorithm);
+        fprintfOrDie(f, ",\n{\"name\":\"%s\",\"cat\":\"comm\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+            "\"args\":{\"algorithm\":\"%s\",\"bytes\":%lld,\"nodes\":%d,\"waitMs\":%.3f}}",
+            c_fixedEvtDesc[eventRecord.eventId].eventDescription, pid, eventRecord.threadId,
+            TicksToTraceMicroseconds(eventRecord.beginClock),
+            1000000.0 * TicksToSeconds(eventRecord.endClock - eventRecord.beginClock),
+            str.c_str(), eventRecord.bytes, eventRecord.numNodes,
+            1000.0 * TicksToSeconds(eventRecord.waitClocks));
+    }
+
+    fprintfOrDie(f, "\n]}\n");
+    fclose(f);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Scoped helpers.
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
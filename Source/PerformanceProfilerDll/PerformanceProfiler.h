@@ -26,11 +26,32 @@
 // and ProfilerThroughputBegin() calls should be used. The throughput APIs can only be used
 // with fixed events.
 //
+// Collective communication operations are profiled with ProfilerTimeBegin() and ProfilerCommEnd(),
+// which also records the size, the algorithm, the number of nodes and the time spent waiting for
+// the operation. These are written to a separate communication log, one line per operation (or
+// chunk of an operation), together with the achieved bus bandwidth.
+//
+// At the time the profiler is torn down, a trace of all recorded events is written as well, in the trace event
+// format of chrome://tracing and Perfetto. Every thread gets its own track, which is named by
+// ProfilerSetThreadName(). For distributed jobs, ProfilerSetRank() puts each rank into its own process and moves
+// its time stamps onto the clock of rank 0, so that the traces of all ranks can be merged into one timeline
+// (Scripts/merge_profiler_traces.py).
+//
 // CNTK specifics
 //
 // The profiler is turned off during the very first epoch to avoid polluting profile data with
 // times that are typically larger (warm-up).
 //
+// Per-node timing (ProfilerEnableNodeTiming()) times ForwardProp() and Backprop() of every ComputationNode
+// with ProfilerNodeBegin() and ProfilerNodeEnd(). The times are aggregated by node name and by operation type,
+// and appear in the summary report after the fixed events. Together with the FLOPs and bytes that each node
+// estimates for its computation (ComputationNodeBase::GetForwardCost()), they give the achieved GFLOP/s and GB/s
+// of each node, the roofline report, optionally against the peak of the device (ProfilerSetRoofline()).
+//
+// The model loading events time the phases of loading a model and preparing it for its first
+// evaluation. They are recorded while the profiler is enabled, e.g. by an evaluation host that
+// calls ProfilerInit() and ProfilerEnable() before loading (see ModelLoadPerformanceTests).
+//
 
 #pragma once
 
@@ -73,6 +94,38 @@ enum ProfilerEvents
 
     // Data reader events
     profilerEvtPrefetchMinibatch,           // Prefetching the next minibatch in a background thread
+    profilerEvtPrefetchQueueFull,           // Prefetch waiting for the main thread to release a slot
+    profilerEvtPrefetchReaderStall,         // Main thread waiting for the next minibatch to be packed
+    profilerEvtPrefetchCopyStall,           // Main thread waiting for the copy of the next minibatch to the device
+
+    // Communication header (dummy events)
+    profilerSepSpace3,
+    profilerSepCommunication,
+    profilerSepSpace4,
+
+    // Communication events
+    profilerEvtCommAllReduce,               // Allreduce, from its start to its completion
+    profilerEvtCommReduceScatter,           // Reduce-scatter
+    profilerEvtCommAllGather,               // Allgather
+    profilerEvtCommBroadcast,               // Broadcast
+    profilerEvtCommWait,                    // Waiting for non-blocking operations to complete
+    profilerEvtCommBusBandwidth,            // Bus bandwidth achieved by the operations above
+
+    // Model loading header (dummy events)
+    profilerSepSpace5,
+    profilerSepModelLoading,
+    profilerSepSpace6,
+
+    // Model loading events
+    profilerEvtLoadModel,                   // Loading a model for evaluation (CNTKEval::CreateNetwork(), v2 Function::Load())
+    profilerEvtLoadConfig,                  // Parsing the config and BrainScript
+    profilerEvtLoadBuild,                   // Constructing the network from its description (BrainScript, NDL, v2 dictionary)
+    profilerEvtLoadDeserialize,             // Reading a model file (ComputationNetwork::Read(), protobuf)
+    profilerEvtLoadCompile,                 // ComputationNetwork::CompileNetwork()
+    profilerEvtLoadValidate,                // Validation of all nodes, part of CompileNetwork()
+    profilerEvtLoadAllocate,                // ComputationNetwork::AllocateAllMatrices(), before the first evaluation
+    profilerEvtLoadMemoryPlan,              // MatrixPool::OptimizedMemoryAllocation(), part of AllocateAllMatrices()
+    profilerEvtLoadCuDnnInit,               // Creation of the cuDNN handle, on first use
 
     profilerEvtMax
 };
@@ -96,6 +149,11 @@ void PERF_PROFILER_API ProfilerInit(const std::wstring& profilerDir, const unsig
 //
 void PERF_PROFILER_API ProfilerEnable(bool enable);
 
+//
+// Whether events are being recorded, to skip the preparation of events otherwise.
+//
+bool PERF_PROFILER_API ProfilerIsEnabled();
+
 
 //
 // Measure either a fixed or custom event time.
@@ -122,6 +180,67 @@ long long PERF_PROFILER_API ProfilerThroughputBegin();
 void PERF_PROFILER_API ProfilerThroughputEnd(const long long stateId, const int eventId, const long long bytes);
 
 
+//
+// Record a collective communication operation that started at stateId (from ProfilerTimeBegin()).
+// eventId: one of the profilerEvtComm* operations.
+// algorithm: how it was carried out, e.g. "mpi" or "nccl".
+// bytes: size of the data, of all nodes together for reduce-scatter and allgather.
+// numNodes: number of nodes that took part.
+// waitTicks: clock ticks spent blocked waiting for the operation, -1 for blocking calls (all of it).
+// The bus bandwidth is the data size scaled by the share that each node has to send (as reported by
+// the NCCL tests), 2 * (n - 1) / n for allreduce, (n - 1) / n for reduce-scatter and allgather.
+//
+void PERF_PROFILER_API ProfilerCommEnd(const long long stateId, const int eventId, const char* algorithm, const long long bytes,
+    const int numNodes, const long long waitTicks);
+
+
+//
+// Enable/disable the timing of the forward and backward computation of each node (off by default).
+// Nodes are only timed while profiling is enabled as well.
+//
+void PERF_PROFILER_API ProfilerEnableNodeTiming(bool enable);
+bool PERF_PROFILER_API ProfilerIsNodeTimingEnabled();
+
+//
+// Time the forward or backward computation of a node.
+// On the GPU (gpu = true) the time is measured by CUDA events recorded on 'stream' (a cudaStream_t), which are
+// resolved asynchronously by later calls and by ProfilerClose(), so the GPU is never synced. Otherwise, host
+// timers are used. ProfilerNodeBegin() returns a stateId that is passed to ProfilerNodeEnd().
+// flops and bytes are the estimated floating-point operations and bytes moved by the computation, for the roofline report.
+//
+long long PERF_PROFILER_API ProfilerNodeBegin(const bool gpu, void* stream);
+void PERF_PROFILER_API ProfilerNodeEnd(const long long stateId, const wchar_t* nodeName, const wchar_t* operationName, const bool backward,
+    const double flops = 0.0, const double bytes = 0.0);
+
+//
+// Set the peak compute (GFLOP/s) and memory bandwidth (GB/s) of the device, to rate the nodes against in the roofline
+// report (0 if not known), and write the roofline report to a file of its own after the given number of profiled
+// minibatches (0 for only in the summary report).
+//
+void PERF_PROFILER_API ProfilerSetRoofline(const double peakGFlops, const double peakGBps, const int reportAfterMinibatches);
+
+
+//
+// Number of occurrences and total time (in seconds) recorded so far for a fixed time event, e.g. for a benchmark
+// to report a breakdown without going through the summary report. Both are 0 if the profiler is not initialized.
+//
+void PERF_PROFILER_API ProfilerGetFixedEventTime(const int eventId, int& count, double& totalSeconds);
+
+
+//
+// Name the calling thread, e.g. "Prefetch", for its track in the trace. Threads without a name are shown by their
+// id. The name has to be a static string.
+//
+void PERF_PROFILER_API ProfilerSetThreadName(const char* name);
+
+
+//
+// Set the rank of this process in a distributed job, and the offset of its clock to the clock of rank 0 in clock
+// ticks (see EstimateClockOffsetToMainNode() in MPIWrapper.h), for the trace.
+//
+void PERF_PROFILER_API ProfilerSetRank(const int rank, const long long clockOffset);
+
+
 //
 // Generate reports and release all resources.
 //
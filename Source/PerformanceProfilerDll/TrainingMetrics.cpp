@@ -0,0 +1,494 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Always-on training metrics, see TrainingMetrics.h.
+//
+
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+#endif
+#define _CRT_NONSTDC_NO_DEPRECATE // make VS accept POSIX functions without _
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "TrainingMetrics.h"
+#include "TimerUtility.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <stdarg.h>
+#include <stdio.h>
+#ifndef CPUONLY
+#include <cuda_runtime_api.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+#else
+typedef int SocketHandle;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+// Names of the phases in the Prometheus labels
+static const char* c_phaseNames[trainingPhaseMax] = {
+    "minibatch",                                    // trainingPhaseMinibatch
+    "get_minibatch",                                // trainingPhaseGetMinibatch
+    "reader_wait",                                  // trainingPhaseReaderWait
+    "copy",                                         // trainingPhaseCopy
+    "forward_backward",                             // trainingPhaseFB
+    "aggregation",                                  // trainingPhaseAggregation
+    "update",                                       // trainingPhaseUpdate
+};
+
+// The histogram buckets are powers of 2 in microseconds, from 1 us to 2^23 us (8.4 s), and one for longer times
+static const int c_histogramBuckets = 24;
+
+struct PhaseHistogram
+{
+    std::atomic<long long>  buckets[c_histogramBuckets + 1];
+    std::atomic<long long>  count;
+    std::atomic<long long>  ticks;
+};
+
+struct MetricsWindow
+{
+    std::atomic<long long>  minute;                         // Minute (of the clock) the counts are for, -1 if none
+    std::atomic<long long>  samples;
+    std::atomic<long long>  minibatches;
+    std::atomic<long long>  phaseCounts[trainingPhaseMax];
+    std::atomic<long long>  phaseTicks[trainingPhaseMax];
+};
+
+//
+// Global state of the metrics. All of it is updated without locks; a window that starts while it is recorded
+// into may lose the events that race with its reset.
+//
+struct TrainingMetricsState
+{
+    std::atomic<bool>       enabled;
+    long long               ticksPerSecond;
+    long long               ticksPerMinute;
+    std::atomic<long long>  startClock;                     // Clock of TrainingMetricsEnable()
+    std::atomic<long long>  samples;
+    std::atomic<long long>  minibatches;
+    PhaseHistogram          phases[trainingPhaseMax];
+    MetricsWindow           windows[trainingMetricsWindows];
+    std::atomic<long long>  memorySampleClock;              // Clock of the last sample of the device memory
+    std::atomic<long long>  deviceMemoryUsed;               // -1 if not sampled
+    std::atomic<long long>  readerQueueCount;               // Minibatches taken from the queue of the reader
+    std::atomic<long long>  readerQueueOccupancy;           // Sum of the minibatches waiting in it at these times
+    std::atomic<long long>  readerQueueEmpty;               // Times no minibatch was waiting
+    std::atomic<int>        readerQueueDepth;               // -1 before the first minibatch
+};
+
+static TrainingMetricsState g_metrics;
+
+// The HTTP server. Its thread is detached, so that a server that is never stopped does not block the exit.
+static std::mutex g_serverMutex;
+static SocketHandle g_serverSocket = INVALID_SOCKET;
+static std::atomic<bool> g_serverStopping;
+static std::future<void> g_serverDone;
+
+
+int PhaseOfEvent(const int eventId)
+{
+    switch (eventId)
+    {
+    case profilerEvtMainMinibatch:          return trainingPhaseMinibatch;
+    case profilerEvtMainGetMinibatch:       return trainingPhaseGetMinibatch;
+    case profilerEvtPrefetchReaderStall:    return trainingPhaseReaderWait;
+    case profilerEvtPrefetchCopyStall:      return trainingPhaseCopy;
+    case profilerEvtMainFB:                 return trainingPhaseFB;
+    case profilerEvtMainGradient:           return trainingPhaseAggregation;
+    case profilerEvtMainWeights:            return trainingPhaseUpdate;
+    default:                                return -1;
+    }
+}
+
+//
+// The window of the minute of the clock, which is reset when its minute starts.
+//
+MetricsWindow& CurrentWindow(const long long clock)
+{
+    long long minute = clock / g_metrics.ticksPerMinute;
+    MetricsWindow& window = g_metrics.windows[minute % trainingMetricsWindows];
+
+    long long windowMinute = window.minute.load();
+    if (windowMinute < minute && window.minute.compare_exchange_strong(windowMinute, minute))
+    {
+        window.samples = 0;
+        window.minibatches = 0;
+        for (int i = 0; i < trainingPhaseMax; i++)
+        {
+            window.phaseCounts[i] = 0;
+            window.phaseTicks[i] = 0;
+        }
+    }
+    return window;
+}
+
+
+void PERF_PROFILER_API TrainingMetricsEnable(bool enable)
+{
+    if (enable)
+    {
+        g_metrics.enabled = false;
+        g_metrics.ticksPerSecond = Clock::GetTicksPerSecond();
+        g_metrics.ticksPerMinute = 60 * g_metrics.ticksPerSecond;
+        g_metrics.samples = 0;
+        g_metrics.minibatches = 0;
+        for (auto& phase : g_metrics.phases)
+        {
+            for (auto& bucket : phase.buckets)
+                bucket = 0;
+            phase.count = 0;
+            phase.ticks = 0;
+        }
+        for (auto& window : g_metrics.windows)
+            window.minute = -1;
+        g_metrics.memorySampleClock = 0;
+        g_metrics.deviceMemoryUsed = -1;
+        g_metrics.readerQueueCount = 0;
+        g_metrics.readerQueueOccupancy = 0;
+        g_metrics.readerQueueEmpty = 0;
+        g_metrics.readerQueueDepth = -1;
+        g_metrics.startClock = Clock::GetTimeStamp();
+    }
+    g_metrics.enabled = enable;
+}
+
+bool PERF_PROFILER_API TrainingMetricsIsEnabled()
+{
+    return g_metrics.enabled;
+}
+
+
+void PERF_PROFILER_API TrainingMetricsRecordEvent(const int eventId, const long long beginClock, const long long endClock)
+{
+    if (!g_metrics.enabled)
+        return;
+
+    int phase = PhaseOfEvent(eventId);
+    if (phase < 0)
+        return;
+
+    long long ticks = endClock - beginClock;
+    double microseconds = 1000000.0 * ticks / g_metrics.ticksPerSecond;
+    int bucket = 0;
+    for (double bound = 1.0; bucket < c_histogramBuckets && microseconds > bound; bound *= 2)
+        bucket++;
+
+    PhaseHistogram& histogram = g_metrics.phases[phase];
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.ticks += ticks;
+
+    MetricsWindow& window = CurrentWindow(endClock);
+    window.phaseCounts[phase]++;
+    window.phaseTicks[phase] += ticks;
+}
+
+
+void PERF_PROFILER_API TrainingMetricsAddSamples(const long long samples, const int deviceId)
+{
+    if (!g_metrics.enabled)
+        return;
+
+    long long clock = Clock::GetTimeStamp();
+    g_metrics.samples += samples;
+    g_metrics.minibatches++;
+
+    MetricsWindow& window = CurrentWindow(clock);
+    window.samples += samples;
+    window.minibatches++;
+
+#ifndef CPUONLY
+    // this thread runs on the device of the model, so cudaMemGetInfo() reports that device
+    if (deviceId >= 0 && clock - g_metrics.memorySampleClock >= g_metrics.ticksPerSecond)
+    {
+        g_metrics.memorySampleClock = clock;
+        size_t freeBytes, totalBytes;
+        if (cudaMemGetInfo(&freeBytes, &totalBytes) == cudaSuccess)
+            g_metrics.deviceMemoryUsed = (long long)(totalBytes - freeBytes);
+    }
+#else
+    (void)deviceId;
+#endif
+}
+
+
+void PERF_PROFILER_API TrainingMetricsRecordReaderQueue(const int occupancy, const int depth)
+{
+    if (!g_metrics.enabled)
+        return;
+
+    g_metrics.readerQueueCount++;
+    g_metrics.readerQueueOccupancy += occupancy;
+    if (occupancy == 0)
+        g_metrics.readerQueueEmpty++;
+    g_metrics.readerQueueDepth = depth;
+}
+
+
+bool PERF_PROFILER_API TrainingMetricsGetWindow(const int minutesAgo, TrainingMetricsWindow& window)
+{
+    if (!g_metrics.enabled || minutesAgo < 0 || minutesAgo >= trainingMetricsWindows)
+        return false;
+
+    long long clock = Clock::GetTimeStamp();
+    long long minute = clock / g_metrics.ticksPerMinute - minutesAgo;
+    long long beginClock = std::max(minute * g_metrics.ticksPerMinute, g_metrics.startClock.load());
+    long long endClock = std::min((minute + 1) * g_metrics.ticksPerMinute, clock);
+    if (endClock <= beginClock)
+        return false;
+
+    // a window without events since its minute started is a minute without progress
+    const MetricsWindow& source = g_metrics.windows[minute % trainingMetricsWindows];
+    bool recorded = source.minute == minute;
+    window.seconds = (double)(endClock - beginClock) / g_metrics.ticksPerSecond;
+    window.samples = recorded ? source.samples.load() : 0;
+    window.minibatches = recorded ? source.minibatches.load() : 0;
+    for (int i = 0; i < trainingPhaseMax; i++)
+    {
+        window.phaseCounts[i] = recorded ? source.phaseCounts[i].load() : 0;
+        window.phaseSeconds[i] = recorded ? (double)source.phaseTicks[i] / g_metrics.ticksPerSecond : 0;
+    }
+    return true;
+}
+
+
+//
+// Resident memory of the process in bytes, -1 if not known.
+//
+long long ResidentMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (long long)counters.WorkingSetSize;
+#else
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f != NULL)
+    {
+        long long pages, residentPages;
+        int fields = fscanf(f, "%lld %lld", &pages, &residentPages);
+        fclose(f);
+        if (fields == 2)
+            return residentPages * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return -1;
+}
+
+void AppendMetric(std::string& text, const char* name, const char* type, const char* help)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    text += line;
+}
+
+void AppendValue(std::string& text, const char* format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    text += line;
+}
+
+std::string PERF_PROFILER_API TrainingMetricsGetText()
+{
+    std::string text;
+    if (!g_metrics.enabled)
+        return text;
+
+    AppendMetric(text, "cntk_training_samples_total", "counter", "Samples trained on by this worker.");
+    AppendValue(text, "cntk_training_samples_total %lld\n", g_metrics.samples.load());
+    AppendMetric(text, "cntk_training_minibatches_total", "counter", "Minibatches trained on by this worker.");
+    AppendValue(text, "cntk_training_minibatches_total %lld\n", g_metrics.minibatches.load());
+
+    AppendMetric(text, "cntk_training_phase_seconds", "histogram", "Time of the phases of a minibatch.");
+    for (int i = 0; i < trainingPhaseMax; i++)
+    {
+        const PhaseHistogram& histogram = g_metrics.phases[i];
+        long long count = 0;
+        double bound = 1.0;
+        for (int bucket = 0; bucket < c_histogramBuckets; bucket++, bound *= 2)
+        {
+            count += histogram.buckets[bucket];
+            AppendValue(text, "cntk_training_phase_seconds_bucket{phase=\"%s\",le=\"%g\"} %lld\n", c_phaseNames[i], bound / 1000000, count);
+        }
+        count += histogram.buckets[c_histogramBuckets];
+        AppendValue(text, "cntk_training_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %lld\n", c_phaseNames[i], count);
+        AppendValue(text, "cntk_training_phase_seconds_sum{phase=\"%s\"} %.6f\n", c_phaseNames[i], (double)histogram.ticks / g_metrics.ticksPerSecond);
+        AppendValue(text, "cntk_training_phase_seconds_count{phase=\"%s\"} %lld\n", c_phaseNames[i], count);
+    }
+
+    // the last complete minute, or the current one during the first minute
+    TrainingMetricsWindow window;
+    if (TrainingMetricsGetWindow(1, window) || TrainingMetricsGetWindow(0, window))
+    {
+        AppendMetric(text, "cntk_training_samples_per_second", "gauge", "Samples per second in the last minute.");
+        AppendValue(text, "cntk_training_samples_per_second %.3f\n", window.samples / window.seconds);
+        AppendMetric(text, "cntk_training_phase_fraction", "gauge", "Share of the last minute spent in each phase.");
+        for (int i = 0; i < trainingPhaseMax; i++)
+            AppendValue(text, "cntk_training_phase_fraction{phase=\"%s\"} %.4f\n", c_phaseNames[i], window.phaseSeconds[i] / window.seconds);
+    }
+
+    // the mean occupancy over a time range is the increase of the sum over that of the count
+    if (g_metrics.readerQueueDepth >= 0)
+    {
+        AppendMetric(text, "cntk_training_reader_queue_depth", "gauge", "Minibatches the reader prefetches ahead of the network.");
+        AppendValue(text, "cntk_training_reader_queue_depth %d\n", g_metrics.readerQueueDepth.load());
+        AppendMetric(text, "cntk_training_reader_queue_occupancy", "summary", "Prefetched minibatches waiting when the network asked for the next one.");
+        AppendValue(text, "cntk_training_reader_queue_occupancy_sum %lld\n", g_metrics.readerQueueOccupancy.load());
+        AppendValue(text, "cntk_training_reader_queue_occupancy_count %lld\n", g_metrics.readerQueueCount.load());
+        AppendMetric(text, "cntk_training_reader_queue_empty_total", "counter", "Minibatches the network had to wait for.");
+        AppendValue(text, "cntk_training_reader_queue_empty_total %lld\n", g_metrics.readerQueueEmpty.load());
+    }
+
+    long long residentBytes = ResidentMemoryBytes();
+    if (residentBytes >= 0)
+    {
+        AppendMetric(text, "cntk_training_resident_memory_bytes", "gauge", "Resident memory of the process.");
+        AppendValue(text, "cntk_training_resident_memory_bytes %lld\n", residentBytes);
+    }
+    long long deviceBytes = g_metrics.deviceMemoryUsed;
+    if (deviceBytes >= 0)
+    {
+        AppendMetric(text, "cntk_training_device_memory_bytes", "gauge", "Memory in use on the GPU of the model.");
+        AppendValue(text, "cntk_training_device_memory_bytes %lld\n", deviceBytes);
+    }
+    return text;
+}
+
+
+//
+// Answers every connection with the metrics, until the listening socket is closed.
+//
+void TrainingMetricsServe(SocketHandle serverSocket, std::promise<void> done)
+{
+    for (;;)
+    {
+        SocketHandle client = accept(serverSocket, NULL, NULL);
+        if (client == INVALID_SOCKET)
+        {
+            if (g_serverStopping)
+            {
+                done.set_value();
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        // the request itself does not matter, only read it so that the client does not get a reset
+        char request[4096];
+        recv(client, request, sizeof(request), 0);
+
+        std::string body = TrainingMetricsGetText();
+        char header[256];
+        snprintf(header, sizeof(header),
+            "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n",
+            (int)body.size());
+        std::string response = header + body;
+        for (size_t sent = 0; sent < response.size();)
+        {
+            int bytes = (int)send(client, response.data() + sent, (int)(response.size() - sent), 0);
+            if (bytes <= 0)
+                break;
+            sent += bytes;
+        }
+        closesocket(client);
+    }
+}
+
+bool PERF_PROFILER_API TrainingMetricsStartServer(const int port)
+{
+    std::lock_guard<std::mutex> lock(g_serverMutex);
+    if (g_serverSocket != INVALID_SOCKET)
+        return false;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return false;
+#endif
+
+    SocketHandle serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (serverSocket == INVALID_SOCKET)
+        return false;
+
+    int reuse = 1;
+    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((unsigned short)port);
+    if (bind(serverSocket, (const sockaddr*)&address, sizeof(address)) != 0 || listen(serverSocket, 4) != 0)
+    {
+        fprintf(stderr, "Warning: Training metrics: Cannot serve the metrics on port %d.\n", port);
+        closesocket(serverSocket);
+        return false;
+    }
+
+    std::promise<void> done;
+    g_serverDone = done.get_future();
+    g_serverStopping = false;
+    g_serverSocket = serverSocket;
+    std::thread(TrainingMetricsServe, serverSocket, std::move(done)).detach();
+    return true;
+}
+
+void PERF_PROFILER_API TrainingMetricsStopServer()
+{
+    std::lock_guard<std::mutex> lock(g_serverMutex);
+    if (g_serverSocket == INVALID_SOCKET)
+        return;
+
+    // closing (Windows) or shutting down (Linux) the socket wakes up accept()
+    g_serverStopping = true;
+#ifdef _WIN32
+    closesocket(g_serverSocket);
+    g_serverDone.wait();
+    WSACleanup();
+#else
+    shutdown(g_serverSocket, SHUT_RDWR);
+    g_serverDone.wait();
+    close(g_serverSocket);
+#endif
+    g_serverSocket = INVALID_SOCKET;
+}
+
+
+void TrainingMetricsContext::Init(const int port)
+{
+    TrainingMetricsEnable(true);
+    if (port > 0)
+        TrainingMetricsStartServer(port);
+}
+
+TrainingMetricsContext::~TrainingMetricsContext()
+{
+    TrainingMetricsStopServer();
+}
+
+}}}
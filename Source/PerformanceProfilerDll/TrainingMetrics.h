@@ -0,0 +1,113 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Always-on training metrics for monitoring production jobs, where the profiler cannot run continuously.
+//
+// The metrics are lock-free counters and histograms that never fill up: the throughput (samples and
+// minibatches) and the time spent in each phase of a minibatch (reader wait, copy to the device,
+// forward/backward, gradient aggregation, weight update). The phases are fed by the fixed profiler events
+// that already time them (ProfilerTimeEnd(), ScopeProfile), whether or not the profiler is initialized, so
+// SGD::TrainOneEpoch() and the v2 Trainer only have to report their samples. Recording an event costs a few
+// atomic increments. Unless the profiler syncs the GPU, the times are measured on the host, so GPU work that
+// runs asynchronously is accounted to the phase that waits for it.
+//
+// Besides totals since TrainingMetricsEnable(), the counts and times are kept for each of the last
+// trainingMetricsWindows minutes, so that a scheduler can tell a job that got slow from one that was always
+// slow. The metrics are pulled by TrainingMetricsGetWindow() and TrainingMetricsGetText(), which formats them
+// in the Prometheus text format; TrainingMetricsStartServer() serves that text over HTTP.
+//
+
+#pragma once
+
+#include <string>
+#include "PerformanceProfiler.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+//
+// The phases of a minibatch that are timed.
+//
+enum TrainingMetricPhases
+{
+    trainingPhaseMinibatch = 0,             // One minibatch, all of the phases below and the rest
+    trainingPhaseGetMinibatch,              // Getting the minibatch from the reader
+    trainingPhaseReaderWait,                // Waiting for the prefetch thread to pack the minibatch, part of the above
+    trainingPhaseCopy,                      // Waiting for the copy of the minibatch to the device, part of the above
+    trainingPhaseFB,                        // Forward + backward pass
+    trainingPhaseAggregation,               // Gradient aggregation
+    trainingPhaseUpdate,                    // Weight update
+
+    trainingPhaseMax
+};
+
+// Number of one minute windows kept, including the current one.
+static const int trainingMetricsWindows = 16;
+
+//
+// Counts and times of a one minute window.
+//
+struct TrainingMetricsWindow
+{
+    double      seconds;                            // Length of the window, less than 60 for the current one
+    long long   samples;
+    long long   minibatches;
+    long long   phaseCounts[trainingPhaseMax];
+    double      phaseSeconds[trainingPhaseMax];     // Total time of each phase
+};
+
+
+//
+// Enable/disable the recording of the metrics (off by default). Enabling resets all of them.
+//
+void PERF_PROFILER_API TrainingMetricsEnable(bool enable);
+bool PERF_PROFILER_API TrainingMetricsIsEnabled();
+
+//
+// Record the time of a fixed profiler event from ProfilerTimeBegin() to endClock, if it times a phase.
+// Called by ProfilerTimeEnd().
+//
+void PERF_PROFILER_API TrainingMetricsRecordEvent(const int eventId, const long long beginClock, const long long endClock);
+
+//
+// Count the samples of a minibatch that was trained on (by this worker). deviceId is the device of the model;
+// for a GPU its used memory is sampled (at most once per second).
+//
+void PERF_PROFILER_API TrainingMetricsAddSamples(const long long samples, const int deviceId);
+
+//
+// Record how many prefetched minibatches were queued ahead of the network, out of depth, when it asked for the
+// next one. Called by the ReaderShim for every minibatch.
+//
+void PERF_PROFILER_API TrainingMetricsRecordReaderQueue(const int occupancy, const int depth);
+
+//
+// Get a one minute window, 0 being the current one and trainingMetricsWindows - 1 the oldest.
+// Returns false if the window does not exist or is before TrainingMetricsEnable().
+//
+bool PERF_PROFILER_API TrainingMetricsGetWindow(const int minutesAgo, TrainingMetricsWindow& window);
+
+//
+// The metrics in the Prometheus text exposition format (version 0.0.4): the totals as counters, the phase
+// times as histograms, the last complete minute as gauges, and the memory in use.
+//
+std::string PERF_PROFILER_API TrainingMetricsGetText();
+
+//
+// Serve TrainingMetricsGetText() over HTTP on the given port of all interfaces, on a background thread,
+// to any request. Returns false if the port cannot be bound. TrainingMetricsStopServer() stops serving.
+//
+bool PERF_PROFILER_API TrainingMetricsStartServer(const int port);
+void PERF_PROFILER_API TrainingMetricsStopServer();
+
+
+//
+// Scoped metrics: enables them, and serves them on the port unless it is 0.
+//
+struct PERF_PROFILER_API TrainingMetricsContext
+{
+    void Init(const int port = 0);
+    ~TrainingMetricsContext();
+};
+
+}}}
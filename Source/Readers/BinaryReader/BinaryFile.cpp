@@ -9,7 +9,14 @@
 #include "DataReader.h"
 #include "BinaryReader.h"
 #include <limits.h>
+#include <float.h>
 #include <stdint.h>
+#ifndef __WINDOWS__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #define CLOSEHANDLE_ERROR 0
 
@@ -31,7 +38,8 @@ DWORD LODWORD(size_t size)
 // size - size of the file to map, will expand/contract existing files to given size. zero means keep current size
 BinaryFile::BinaryFile(std::wstring fileName, FileOptions options, size_t size)
 {
-
+    m_sequentialAccess = false;
+#ifdef __WINDOWS__
     SYSTEM_INFO sysInfo;
     GetSystemInfo(&sysInfo);
     m_viewAlignment = sysInfo.dwAllocationGranularity;
@@ -77,6 +85,32 @@ BinaryFile::BinaryFile(std::wstring fileName, FileOptions options, size_t size)
         RuntimeError(message);
     }
     m_mappedSize = size;
+#else
+    // views are placed at the same 64K boundaries as on Windows (its allocation granularity), so the section
+    // layout of the files is the same on both platforms, and aligned for any page size up to 64K
+    m_viewAlignment = max((size_t) 0x10000, (size_t) sysconf(_SC_PAGESIZE));
+
+    m_writeFile = options == fileOptionsReadWrite;
+    m_name = fileName;
+    m_maxViewSize = 0x10000000; // 256MB initial max size
+    std::string name = msra::strfun::utf8(fileName);
+    m_fd = open(name.c_str(), m_writeFile ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+    if (m_fd < 0)
+        RuntimeError("Unable to Open/Create file %ls, error %d", fileName.c_str(), errno);
+
+    // get the actual size of the file
+    struct stat fileStat;
+    if (fstat(m_fd, &fileStat) != 0)
+        RuntimeError("Unable to get the size of file %ls, error %d", fileName.c_str(), errno);
+    if (size == 0)
+        size = (size_t) fileStat.st_size;
+    m_filePositionMax = size;
+
+    // a file mapping on Windows grows the file to the mapped size, views beyond the end of a file are not valid here
+    if (m_writeFile && (size_t) fileStat.st_size != size && ftruncate(m_fd, (off_t) size) != 0)
+        RuntimeError("Unable to resize file %ls to %zu bytes, error %d", fileName.c_str(), size, errno);
+    m_mappedSize = size;
+#endif
 
     // if writing the file, the inital size of the file is zero
     if (m_writeFile)
@@ -93,6 +127,7 @@ BinaryFile::~BinaryFile()
         // the view
         iter = ReleaseView(iter, true);
     }
+#ifdef __WINDOWS__
     int rc = CloseHandle(m_hndMapped);
     if ((rc == CLOSEHANDLE_ERROR) && !std::uncaught_exception())
     {
@@ -110,6 +145,15 @@ BinaryFile::~BinaryFile()
     {
         RuntimeError("BinaryFile: Failed to close handle, %d", ::GetLastError());
     }
+#else
+    // if we are writing the file, truncate to actual size
+    bool failed = m_writeFile && ftruncate(m_fd, (off_t) m_filePositionMax) != 0;
+    failed = close(m_fd) != 0 || failed;
+    if (failed && !std::uncaught_exception())
+    {
+        RuntimeError("BinaryFile: Failed to close file %ls, error %d", m_name.c_str(), errno);
+    }
+#endif
 }
 
 void BinaryFile::SetFilePositionMax(size_t filePositionMax)
@@ -117,9 +161,7 @@ void BinaryFile::SetFilePositionMax(size_t filePositionMax)
     m_filePositionMax = filePositionMax;
     if (m_filePositionMax > m_mappedSize)
     {
-        char message[128];
-        sprintf_s(message, "Setting max position larger than mapped file size: %ld > %ld", (long)m_filePositionMax, (long)m_mappedSize);
-        RuntimeError(message);
+        RuntimeError("Setting max position larger than mapped file size: %zu > %zu", m_filePositionMax, m_mappedSize);
     }
 }
 
@@ -201,10 +243,15 @@ vector<ViewPosition>::iterator BinaryFile::ReleaseView(vector<ViewPosition>::ite
     }
     else
     {
+#ifdef __WINDOWS__
         if (m_writeFile)
             FlushViewOfFile(iter->view, iter->size);
         bool ret = UnmapViewOfFile(iter->view) != FALSE;
         ret;
+#else
+        // MAP_SHARED pages are written back by the kernel, munmap does not need an explicit msync
+        munmap(iter->view, iter->size);
+#endif
         iter = m_views.erase(iter);
     }
     return iter;
@@ -216,6 +263,7 @@ vector<ViewPosition>::iterator BinaryFile::ReleaseView(vector<ViewPosition>::ite
 // returns - pointer to the view
 void* BinaryFile::GetView(size_t filePosition, size_t size)
 {
+#ifdef __WINDOWS__
     void* pBuf = MapViewOfFile(m_hndMapped,                                  // handle to map object
                                m_writeFile ? FILE_MAP_WRITE : FILE_MAP_READ, // get correct permissions
                                HIDWORD(filePosition),
@@ -227,6 +275,20 @@ void* BinaryFile::GetView(size_t filePosition, size_t size)
         sprintf_s(message, "Unable to map file %ls @ %lld, error %x", m_name.c_str(), filePosition, GetLastError());
         RuntimeError(message);
     }
+#else
+    // as MapViewOfFile, a size of zero maps to the end of the file, and views must lie within the mapped size
+    if (size == 0 && filePosition < m_mappedSize)
+        size = m_mappedSize - filePosition;
+    if (size == 0 || filePosition + size > m_mappedSize)
+        RuntimeError("Unable to map file %ls @ %zu, %zu bytes exceed the mapped size of %zu bytes", m_name.c_str(), filePosition, size, m_mappedSize);
+    void* pBuf = mmap(nullptr, size, m_writeFile ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, m_fd, (off_t) filePosition);
+    if (pBuf == MAP_FAILED)
+        RuntimeError("Unable to map file %ls @ %zu, error %d", m_name.c_str(), filePosition, errno);
+
+    // readers walk the records front to back: more readahead, and pages behind the reader can be dropped early
+    if (m_sequentialAccess && !m_writeFile)
+        madvise(pBuf, size, MADV_SEQUENTIAL);
+#endif
     m_views.push_back(ViewPosition(pBuf, filePosition, size));
 
     // update file position max if neccesary
@@ -254,6 +316,22 @@ void BinaryFile::ReleaseView(void* view)
     assert(found);
 }
 
+// WillNeed - hint that a view (or part of it) is about to be read, so its pages are read ahead asynchronously
+// view - pointer into a view, as returned from GetView()
+// size - number of bytes that will be read
+void BinaryFile::WillNeed(void* view, size_t size)
+{
+#ifdef __WINDOWS__
+    UNUSED(view);
+    UNUSED(size);
+#else
+    // madvise wants a page aligned start
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t misalignment = (size_t) view % pageSize;
+    madvise((char*) view - misalignment, size + misalignment, MADV_WILLNEED);
+#endif
+}
+
 // ReallocateView - Reallocate View
 // view - pointer to the view
 // size - size of the view
@@ -350,7 +428,7 @@ size_t BinaryFile::RoundUp(size_t filePosition)
 SectionFile::SectionFile(std::wstring fileName, FileOptions options, size_t size)
     : BinaryFile(fileName, options, size)
 {
-    m_fileSection = new Section(this, 0, NULL, mappingFile, sectionHeaderMin);
+    m_fileSection = new Section(this, nullptr, 0, mappingFile, sectionHeaderMin);
     if (m_writeFile)
     {
         m_fileSection->InitHeader(sectionTypeFile, string("Binary Data File"), sectionDataNone, 0);
@@ -359,9 +437,7 @@ SectionFile::SectionFile(std::wstring fileName, FileOptions options, size_t size
     // check for a file header
     if (!m_fileSection->ValidateHeader(m_writeFile))
     {
-        char message[128];
-        sprintf_s(message, "Invalid File format for binary file %ls", fileName.c_str());
-        RuntimeError(message);
+        RuntimeError("Invalid File format for binary file %ls", fileName.c_str());
     }
 }
 
@@ -399,7 +475,7 @@ void Section::InitHeader(SectionType type, std::string description, SectionData
     m_sectionHeader->flags = flagNone;                                                  // bit flags, dependent on sectionType
     m_sectionHeader->elementsCount = 0;                                                 // number of total elements stored
     memset(m_sectionHeader->nameDescription, 0, descriptionSize);                       // clear out the string buffer to all zeros first
-    strcpy_s(m_sectionHeader->nameDescription, description.c_str());                    // name and description of section contents in this format (name: description) (string, with extra bytes zeroed out, at least one null terminator required)
+    strcpy_s(m_sectionHeader->nameDescription, _countof(m_sectionHeader->nameDescription), description.c_str()); // name and description of section contents in this format (name: description) (string, with extra bytes zeroed out, at least one null terminator required)
     m_sectionHeader->size = sectionHeaderMin;                                           // size of this section (including header)
     m_sectionHeader->sizeAll = sectionHeaderMin;                                        // size of this section (including header and all sub-sections)
     m_sectionHeader->sectionFilePosition[0] = 0;                                        // sub-section file offsets (if needed), assumed to be in File Position order
@@ -507,9 +583,7 @@ Section* Section::ReadSection(size_t index, MappingType mapping, size_t sizeElem
     // make sure the header is valid
     if (!section->ValidateHeader())
     {
-        char message[256];
-        sprintf_s(message, "Invalid header in file %ls, in header %ls\n", m_file->GetName().c_str(), section->GetName().c_str());
-        RuntimeError(message);
+        RuntimeError("Invalid header in file %ls, in header %ls", m_file->GetName().c_str(), section->GetName().c_str());
     }
 
     // setup the element mapping and pointers as needed
@@ -546,9 +620,7 @@ char* Section::EnsureElements(size_t element, size_t bytesRequested)
     size_t elementsRequested = bytesRequested / GetElementSize();
     if (element + elementsRequested > GetElementCount())
     {
-        char message[256];
-        sprintf_s(message, "Element out of range, error accesing element %lld, size=%lld\n", element, bytesRequested);
-        RuntimeError(message);
+        RuntimeError("Element out of range, error accesing element %zu, size=%zu", element, bytesRequested);
     }
 
     // make sure we have the buffer in the range to handle the request
@@ -569,9 +641,7 @@ char* Section::GetElementBuffer(size_t element, size_t windowSize)
     // check element range
     if (!m_file->Writing() && element >= GetElementCount())
     {
-        char message[256];
-        sprintf_s(message, "Element out of range, error accesing element %lld, max element=%lld\n", element, GetElementCount());
-        RuntimeError(message);
+        RuntimeError("Element out of range, error accesing element %zu, max element=%zu", element, GetElementCount());
     }
 
     // section is mapped as a whole, so no separate mapping for element buffer
@@ -647,6 +717,10 @@ char* Section::GetElementBuffer(size_t element, size_t windowSize)
     }
     m_elementView = m_file->GetView(viewPosition, m_mappedElementSize + offset);
     m_elementBuffer = (char*) m_elementView + offset;
+
+    // the reader consumes the whole window, start paging it in
+    if (!m_file->Writing())
+        m_file->WillNeed(m_elementBuffer, m_mappedElementSize);
     return (char*) m_elementBuffer;
 }
 
@@ -1079,9 +1153,7 @@ void SectionString::SetLabelMapping(const std::map<SectionString::LabelIdType, S
         auto iter = labelMapping.find(i);
         if (iter == labelMapping.end())
         {
-            char message[256];
-            sprintf_s(message, "Mapping table doesn't contain an entry for label Id#%d\n", i);
-            RuntimeError(message);
+            RuntimeError("Mapping table doesn't contain an entry for label Id#%d", i);
         }
 
         // add to reverse mapping table
@@ -1091,9 +1163,7 @@ void SectionString::SetLabelMapping(const std::map<SectionString::LabelIdType, S
         errno_t err = strcpy_s(curStr, size, str.c_str());
         if (err)
         {
-            char message[256];
-            sprintf_s(message, "Not enough room in mapping buffer, %lld bytes insufficient for string %d - %s\n", originalSize, i, str.c_str());
-            RuntimeError(message);
+            RuntimeError("Not enough room in mapping buffer, %zu bytes insufficient for string %d - %s", originalSize, i, str.c_str());
         }
         size_t len = str.length() + 1; // don't forget the null
         size -= len;
@@ -1113,9 +1183,7 @@ void* SectionString::GetElement(size_t index) const
     char* str = (char*) m_elementBuffer;
     if (index >= GetElementCount())
     {
-        char message[256];
-        sprintf_s(message, "GetElement: invalid index, %lld requested when there are only %lld elements\n", index, GetElementCount());
-        RuntimeError(message);
+        RuntimeError("GetElement: invalid index, %zu requested when there are only %zu elements", index, GetElementCount());
     }
 
     // now skip all the strings before the one that we want
@@ -1139,9 +1207,7 @@ char* SectionString::EnsureElements(size_t element, size_t bytesRequested)
     assert(GetMappingType() != mappingElementWindow); // not supported for string tables currently
     if (element >= GetElementCount())
     {
-        char message[256];
-        sprintf_s(message, "Element out of range, error accesing element %lld, size=%lld\n", element, bytesRequested);
-        RuntimeError(message);
+        RuntimeError("Element out of range, error accesing element %zu, size=%zu", element, bytesRequested);
     }
 
     // make sure we have the buffer in the range to handle the request
@@ -1230,7 +1296,7 @@ void SectionStats::InitCompute(const ConfigArray& compute)
     {
         std::string name = compute[i];
         auto stat = GetElement<NumericStatistics>(i);
-        strcpy_s(stat->statistic, name.c_str());
+        strcpy_s(stat->statistic, _countof(stat->statistic), name.c_str());
         stat->value = 0.0;
     }
 
@@ -100,6 +100,8 @@ void BinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig
         for (int i = 0; i < files.size(); ++i)
         {
             SectionFile* secFile = new SectionFile(files[i], fileOptionsRead, 0);
+            // records are read front to back, let the OS read ahead of the element windows
+            secFile->SetSequentialAccess(true);
             size_t records = secFile->FileSection()->GetRecordCount();
 
             // if we haven't set the total records yet, set it
@@ -130,13 +130,18 @@ struct ViewPosition
 class BinaryFile
 {
 protected:
+#ifdef __WINDOWS__
     HANDLE m_hndFile;         // handle to the file
     HANDLE m_hndMapped;       // handle to the mapped file object
+#else
+    int m_fd;                 // file descriptor, views are mapped with mmap
+#endif
     size_t m_mappedSize;      // size of mapped file (zero for size of file being read)
     size_t m_maxViewSize;     // maximum size we want a single view to contain
     size_t m_viewAlignment;   // address alignment required by views
     size_t m_filePositionMax; // current maximum file position in the file
     bool m_writeFile;
+    bool m_sequentialAccess;      // views are read front to back, passed to the OS as a paging hint
     std::wstring m_name;          // name of this
     vector<ViewPosition> m_views; // keep track of all the views into the file
 public:
@@ -157,6 +162,11 @@ public:
     void* EnsureMapped(void* data, size_t size);
     vector<ViewPosition>::iterator Mapped(size_t filePosition, size_t& size);
     size_t RoundUp(size_t filePosition);
+    void SetSequentialAccess(bool sequentialAccess)
+    {
+        m_sequentialAccess = sequentialAccess;
+    }
+    void WillNeed(void* view, size_t size);
     size_t GetViewAlignment()
     {
         return m_viewAlignment;
@@ -9,6 +9,7 @@
 #include "BinaryChunkDeserializer.h"
 #include "BinaryDataChunk.h"
 #include "FileHelper.h"
+#include "RemoteFile.h"
 #include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -35,30 +36,51 @@ void BinaryChunkDeserializer::ReadChunkTable(FILE* infile, uint32_t firstChunkId
             firstChunkIdx, (firstChunkIdx + numChunks - 1), m_numChunks);
     }
 
-    uint64_t firstChunkOffset = firstChunkIdx * sizeof(ChunkInfo) + m_chunkTableOffset;
+    size_t entrySize = m_version == 1 ? sizeof(ChunkInfo) : sizeof(ChunkInfoV2);
+    uint64_t firstChunkOffset = firstChunkIdx * entrySize + m_chunkTableOffset;
 
     // Seek to the start of the offset info for the first requested chunk 
     CNTKBinaryFileHelper::SeekOrDie(infile, firstChunkOffset, SEEK_SET);
 
     // Note we create numChunks + 1 since we want to be consistent with determining the size of each chunk.
     ChunkInfo* chunks = new ChunkInfo[numChunks + 1];
+    vector<ChunkCompression> compression;
+    vector<uint64_t> dataSizes;
 
     // Read in all of the offsets for the chunks of interest
-    CNTKBinaryFileHelper::ReadOrDie(chunks, sizeof(ChunkInfo), numChunks, infile);
+    if (m_version == 1)
+    {
+        CNTKBinaryFileHelper::ReadOrDie(chunks, sizeof(ChunkInfo), numChunks, infile);
+    }
+    else
+    {
+        vector<ChunkInfoV2> entries(numChunks);
+        CNTKBinaryFileHelper::ReadOrDie(entries.data(), sizeof(ChunkInfoV2), numChunks, infile);
+        compression.resize(numChunks);
+        dataSizes.resize(numChunks);
+        for (uint32_t i = 0; i < numChunks; i++)
+        {
+            chunks[i] = entries[i].info;
+            compression[i] = static_cast<ChunkCompression>(entries[i].compression);
+            dataSizes[i] = entries[i].dataSize;
+            if (compression[i] != ChunkCompression::none && compression[i] != ChunkCompression::lz4)
+                RuntimeError("Chunk %" PRIu32 " of the input (%ls) uses an unknown compression %" PRIu32 ".",
+                    firstChunkIdx + i, m_filename.c_str(), entries[i].compression);
+        }
+    }
 
     // Now read the final entry. It is either the next offset entry (if we're reading a subset and the
-    // entry exists), or we just fill it with the correct information based on file size if it doesn't
+    // entry exists), or, for the last chunk, the chunk data ends where the header starts.
     if (firstChunkIdx + numChunks == m_numChunks)
     {
-        auto position = CNTKBinaryFileHelper::TellOrDie(infile);
-        chunks[numChunks].offset = position;
+        chunks[numChunks].offset = m_headerOffset;
         chunks[numChunks].numSamples = 0;
         chunks[numChunks].numSequences = 0;
     }
     else
         CNTKBinaryFileHelper::ReadOrDie(chunks + numChunks, sizeof(ChunkInfo), 1, infile);
 
-    m_chunkTable = make_unique<ChunkTable>(numChunks, chunks);
+    m_chunkTable = make_unique<ChunkTable>(numChunks, chunks, move(compression), move(dataSizes));
 
 }
 
@@ -66,6 +88,8 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helpe
     BinaryChunkDeserializer(helper.GetFilePath())
 {
     SetTraceLevel(helper.GetTraceLevel());
+    SetMapInputFile(helper.ShouldMapInputFile());
+    SetRemoteCache(helper.GetRemoteCacheDirectory(), helper.GetNumRemoteConnections());
 
     Initialize(helper.GetRename(), helper.GetElementType());
 }
@@ -77,7 +101,12 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const std::wstring& filename) :
     m_file(nullptr),
     m_headerOffset(0),
     m_chunkTableOffset(0),
-    m_traceLevel(0)
+    m_version(0),
+    m_bufferPool(make_shared<ChunkBufferPool>(4)),
+    m_traceLevel(0),
+    m_mapInputFile(false),
+    m_remoteCacheDirectory(RemoteFile::DefaultCacheDirectory()),
+    m_numRemoteConnections(8)
 {
 }
 
@@ -93,19 +122,36 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     if (m_file)
         CNTKBinaryFileHelper::CloseOrDie(m_file);
 
-    m_file = CNTKBinaryFileHelper::OpenOrDie(m_filename, L"rb");
+    wstring localPath = m_filename;
+    if (RemoteFile::IsRemote(m_filename))
+    {
+        // The file is read from its local cache, into which the header and then the chunks, when they are first
+        // requested, are downloaded.
+        m_remoteFile = make_unique<RemoteFile>(m_filename, m_remoteCacheDirectory, m_numRemoteConnections, m_traceLevel >= 2);
+        m_remoteFile->Fetch(0, sizeof(uint64_t) + sizeof(uint32_t)); // magic number and version
+        m_remoteFile->Fetch(m_remoteFile->Size() - sizeof(int64_t), sizeof(int64_t)); // offset of the header
+        localPath = m_remoteFile->CachePath();
+    }
+
+    m_file = CNTKBinaryFileHelper::OpenOrDie(localPath, L"rb");
+
+    // Buffered reads could keep bytes of the cache from before they were downloaded.
+    if (m_remoteFile)
+        setvbuf(m_file, nullptr, _IONBF, 0);
 
     // First, verify the magic number.
     CNTKBinaryFileHelper::FindMagicOrDie(m_file, m_filename);
     
-    // Second, read the version number of the data file, and (for now) make sure the reader version is the same.
-    uint32_t versionNumber = CNTKBinaryFileHelper::GetVersionNumber(m_file);
-    if (versionNumber != s_currentVersion)
+    // Second, read the version number of the data file, and make sure the reader knows it.
+    m_version = CNTKBinaryFileHelper::GetVersionNumber(m_file);
+    if (m_version < 1 || m_version > s_currentVersion)
         LogicError("The reader version is %" PRIu32 ", but the data file was created for version %" PRIu32 ".",
-            s_currentVersion, versionNumber);
+            s_currentVersion, m_version);
 
     // Now, find where the header is.
     m_headerOffset = CNTKBinaryFileHelper::GetHeaderOffset(m_file);
+    if (m_remoteFile)
+        m_remoteFile->Fetch(m_headerOffset, m_remoteFile->Size() - m_headerOffset);
     CNTKBinaryFileHelper::SeekOrDie(m_file, m_headerOffset, SEEK_SET);
     // Once again, make sure that the header is well-formed and starts with a magic number.
     CNTKBinaryFileHelper::FindMagicOrDie(m_file, m_filename);
@@ -177,6 +223,8 @@ void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vec
     auto numberOfSequences = m_chunkTable->GetNumSequences(chunkId);
     unique_ptr<uint32_t[]> numSamplesPerSequence(new uint32_t[numberOfSequences]);
 
+    FetchChunk(chunkId);
+
     // Seek to the start of the chunk
     CNTKBinaryFileHelper::SeekOrDie(m_file, offset, SEEK_SET);
     // read 'numberOfSequences' unsigned ints
@@ -196,7 +244,7 @@ void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vec
     }
 }
 
-unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
+shared_ptr<byte> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 {
     // Seek to the start of the data portion in the chunk
     CNTKBinaryFileHelper::SeekOrDie(m_file, m_chunkTable->GetDataStartOffset(chunkId), SEEK_SET);
@@ -204,9 +252,8 @@ unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
     // Determine how big the chunk is.
     size_t chunkSize = m_chunkTable->GetChunkSize(chunkId);
     
-    // Create buffer
-    // TODO: use a pool of buffers instead of allocating a new one, each time a chunk is read.
-    unique_ptr<byte[]> buffer(new byte[chunkSize]);
+    // Reuse the buffer of a released chunk if possible
+    shared_ptr<byte> buffer = m_bufferPool->Get(chunkSize);
 
     // Read the chunk from disk
     CNTKBinaryFileHelper::ReadOrDie(buffer.get(), sizeof(byte), chunkSize, m_file);
@@ -215,12 +262,58 @@ unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 }
 
 
+void BinaryChunkDeserializer::FetchChunk(ChunkIdType chunkId)
+{
+    // the whole chunk, the lengths of the sequences and the data, in one go
+    if (m_remoteFile)
+        m_remoteFile->Fetch(m_chunkTable->GetOffset(chunkId), m_chunkTable->GetOffset(chunkId + 1) - m_chunkTable->GetOffset(chunkId));
+}
+
 ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
 {
+    FetchChunk(chunkId);
+
+    auto compression = m_chunkTable->GetCompression(chunkId);
+    if (compression != ChunkCompression::none)
+    {
+        // The stored data is read (or mapped) and decompressed, the blocks of the chunk in parallel, into a buffer of
+        // the pool. This runs on the prefetch thread of the reader, meanwhile the previous chunk is used for training.
+        size_t dataSize = m_chunkTable->GetDataSize(chunkId);
+        shared_ptr<byte> buffer = m_bufferPool->Get(dataSize);
+        if (m_mapInputFile)
+        {
+            MappedFileRange mapping(m_file, m_chunkTable->GetDataStartOffset(chunkId), m_chunkTable->GetChunkSize(chunkId));
+            mapping.WillNeed();
+            DecompressChunkData(compression, static_cast<const byte*>(mapping.GetData()), m_chunkTable->GetChunkSize(chunkId), buffer.get(), dataSize);
+        }
+        else
+        {
+            shared_ptr<byte> stored = ReadChunk(chunkId);
+            DecompressChunkData(compression, stored.get(), m_chunkTable->GetChunkSize(chunkId), buffer.get(), dataSize);
+        }
+
+        // per chunk tracing is verbose, only at traceLevel 2
+        if (m_traceLevel >= 2)
+            fprintf(stderr, "BinaryChunkDeserializer: chunk %" PRIu32 " decompressed from %" PRIu64 " to %zu bytes.\n",
+                chunkId, m_chunkTable->GetChunkSize(chunkId), dataSize);
+
+        return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), dataSize, std::move(buffer), m_deserializers);
+    }
+
+    if (m_mapInputFile)
+    {
+        // The data is already stored in the expected element type, so the sequences can point directly into the
+        // mapped pages, without a copy of the chunk next to the one in the page cache. The randomizer requests a chunk
+        // ahead of its use (prefetch), so the pages are read from disk in the background meanwhile.
+        auto mapping = make_unique<MappedFileRange>(m_file, m_chunkTable->GetDataStartOffset(chunkId), m_chunkTable->GetChunkSize(chunkId));
+        mapping->WillNeed();
+        return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), m_chunkTable->GetChunkSize(chunkId), std::move(mapping), m_deserializers);
+    }
+
     // Read the chunk into memory
-    unique_ptr<byte[]> buffer = ReadChunk(chunkId);
+    shared_ptr<byte> buffer = ReadChunk(chunkId);
 
-    return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), std::move(buffer), m_deserializers);
+    return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), m_chunkTable->GetChunkSize(chunkId), std::move(buffer), m_deserializers);
 }
 
 void BinaryChunkDeserializer::SetTraceLevel(unsigned int traceLevel)
@@ -228,4 +321,15 @@ void BinaryChunkDeserializer::SetTraceLevel(unsigned int traceLevel)
     m_traceLevel = traceLevel;
 }
 
+void BinaryChunkDeserializer::SetMapInputFile(bool mapInputFile)
+{
+    m_mapInputFile = mapInputFile;
+}
+
+void BinaryChunkDeserializer::SetRemoteCache(const wstring& directory, size_t numConnections)
+{
+    m_remoteCacheDirectory = directory;
+    m_numRemoteConnections = numConnections;
+}
+
 }}}
@@ -10,6 +10,8 @@
 #include "CorpusDescriptor.h"
 #include "BinaryDataChunk.h"
 #include "BinaryDataDeserializer.h"
+#include "ChunkCompression.h"
+#include "RemoteFile.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,14 +23,28 @@ struct ChunkInfo
     uint32_t numSamples;
 };
 
+// Chunk table entry of version 2 files, which also records how the chunk data is stored.
+struct ChunkInfoV2
+{
+    ChunkInfo info;
+    uint64_t dataSize;    // size of the chunk data after decompression
+    uint32_t compression; // ChunkCompression
+    uint32_t reserved;
+};
+static_assert(sizeof(ChunkInfo) == 16 && sizeof(ChunkInfoV2) == 32, "The chunk table entries must match the file format.");
+
 // Chunk table used to find the chunks in the binary file. Added some helper methods around the core data.
 class ChunkTable {
 public:
 
-    ChunkTable(uint32_t numChunks, ChunkInfo* offsetsTable) :
+    // compression and dataSizes give the storage of each chunk; if empty, the chunk data is not compressed.
+    ChunkTable(uint32_t numChunks, ChunkInfo* offsetsTable,
+               std::vector<ChunkCompression> compression = {}, std::vector<uint64_t> dataSizes = {}) :
         m_numChunks(numChunks),
         m_diskOffsetsTable(offsetsTable),
-        m_startIndex(numChunks)
+        m_startIndex(numChunks),
+        m_compression(std::move(compression)),
+        m_dataSizes(std::move(dataSizes))
     {
         uint64_t numSequences = 0;
         for (decltype(m_numChunks) i = 0; i < m_numChunks; i++)
@@ -64,6 +80,7 @@ public:
         return m_startIndex.at(index); 
     }
 
+    // Size of the chunk data in the file (compressed or not).
     uint64_t GetChunkSize(uint32_t index) 
     { 
         auto dataStartOffset = GetDataStartOffset(index);
@@ -71,10 +88,23 @@ public:
         return dataEndOffset - dataStartOffset;
     }
 
+    ChunkCompression GetCompression(uint32_t index)
+    {
+        return m_compression.empty() ? ChunkCompression::none : m_compression.at(index);
+    }
+
+    // Size of the chunk data after decompression.
+    uint64_t GetDataSize(uint32_t index)
+    {
+        return m_dataSizes.empty() ? GetChunkSize(index) : m_dataSizes.at(index);
+    }
+
 private:
     uint32_t m_numChunks;
     unique_ptr<ChunkInfo[]> m_diskOffsetsTable;
     vector<uint64_t> m_startIndex;
+    vector<ChunkCompression> m_compression;
+    vector<uint64_t> m_dataSizes;
 };
 
 typedef unique_ptr<ChunkTable> ChunkTablePtr;
@@ -105,22 +135,30 @@ private:
     void ReadChunkTable(FILE* infile, uint32_t firstChunkIdx, uint32_t numChunks);
     void ReadChunkTable(FILE* infile);
 
-    // Reads a chunk from disk into buffer
-    unique_ptr<byte[]> ReadChunk(ChunkIdType chunkId);
+    // Reads the stored chunk data from disk into a buffer of the pool
+    shared_ptr<byte> ReadChunk(ChunkIdType chunkId);
+
+    // Downloads the chunk into the cache if the file is remote
+    void FetchChunk(ChunkIdType chunkId);
 
     BinaryChunkDeserializer(const wstring& filename);
 
     void SetTraceLevel(unsigned int traceLevel);
 
+    void SetMapInputFile(bool mapInputFile);
+
+    void SetRemoteCache(const wstring& directory, size_t numConnections);
+
 private:
     const wstring m_filename;
     FILE* m_file;
 
     int64_t m_headerOffset, m_chunkTableOffset;
+    uint32_t m_version;
 
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
     ChunkTablePtr m_chunkTable;
-    void* m_chunkBuffer;
+    ChunkBufferPoolPtr m_bufferPool;
 
     
     uint32_t m_numChunks;
@@ -128,7 +166,16 @@ private:
     
     unsigned int m_traceLevel;
 
-    static const uint32_t s_currentVersion = 1;
+    // if true, chunks are mapped into memory rather than read
+    bool m_mapInputFile;
+
+    // if the file is given by an http URL, it is read through a local cache
+    std::unique_ptr<RemoteFile> m_remoteFile;
+    std::wstring m_remoteCacheDirectory;
+    size_t m_numRemoteConnections;
+
+    // Version 2 adds the compression of the chunks to the chunk table, version 1 files are still read.
+    static const uint32_t s_currentVersion = 2;
 
     friend class CNTKBinaryReaderTestRunner;
 
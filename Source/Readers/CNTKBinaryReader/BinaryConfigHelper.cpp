@@ -12,6 +12,7 @@
 #include "StringUtil.h"
 #include "ReaderConstants.h"
 #include "ReaderUtil.h"
+#include "RemoteFile.h"
 
 using std::string;
 using std::wstring;
@@ -64,6 +65,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         m_filepath = msra::strfun::utf16(config(L"file"));
         m_keepDataInMemory = config(L"keepDataInMemory", false);
+        m_maxDataInMemoryBytes = config(L"maxDataInMemoryBytes", (size_t)0);
+        m_mapInputFile = config(L"memoryMap", false);
+        m_remoteCacheDirectory = config(L"remoteCacheDirectory", RemoteFile::DefaultCacheDirectory());
+        m_numRemoteConnections = config(L"remoteConnections", (size_t)8);
 
         m_randomizationWindow = GetRandomizationWindowFromConfig(config);
         m_sampleBasedRandomizationWindow = config(L"sampleBasedRandomizationWindow", false);
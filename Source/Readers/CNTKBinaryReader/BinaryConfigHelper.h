@@ -34,8 +34,19 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    // Limit of the memory used to keep the data (see ChunkCache); 0 for no limit.
+    size_t GetMaxDataInMemorySize() const { return m_maxDataInMemoryBytes; }
+
+    // If true, chunks are mapped into memory instead of read into buffers of their own (see MappedFileRange).
+    bool ShouldMapInputFile() const { return m_mapInputFile; }
+
     ElementType GetElementType() const { return m_elementType; }
 
+    // For a file given by an http URL, the directory of the local cache and the number of parallel range requests
+    // (see RemoteFile).
+    const wstring& GetRemoteCacheDirectory() const { return m_remoteCacheDirectory; }
+    size_t GetNumRemoteConnections() const { return m_numRemoteConnections; }
+
     DISABLE_COPY_AND_MOVE(BinaryConfigHelper);
 
 private:
@@ -48,6 +59,10 @@ private:
     bool m_sampleBasedRandomizationWindow;
     unsigned int m_traceLevel;
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_maxDataInMemoryBytes; // if not 0, only the most recently used chunks up to this size are kept in memory
+    bool m_mapInputFile;
+    std::wstring m_remoteCacheDirectory;
+    size_t m_numRemoteConnections;
 };
 
 } } }
@@ -10,6 +10,7 @@
 #include "CorpusDescriptor.h"
 #include "BinaryChunkDeserializer.h"
 #include "BinaryDataDeserializer.h"
+#include "FileHelper.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 class BinaryDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
@@ -17,11 +18,28 @@ class BinaryDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
 public:
     explicit BinaryDataChunk(ChunkIdType chunkId,
         size_t numSequences, 
-        unique_ptr<byte[]> buffer, 
+        size_t sizeInBytes,
+        shared_ptr<byte> buffer, 
         std::vector<BinaryDataDeserializerPtr> deserializer)
         : m_chunkId(chunkId),
         m_numSequences(numSequences), 
+        m_sizeInBytes(sizeInBytes),
         m_buffer(std::move(buffer)), 
+        m_chunkData(m_buffer.get()),
+        m_deserializers(deserializer)
+    { }
+
+    // A chunk that is mapped into memory instead of read, the sequence data points directly into the mapped pages.
+    explicit BinaryDataChunk(ChunkIdType chunkId,
+        size_t numSequences,
+        size_t sizeInBytes,
+        unique_ptr<MappedFileRange> mapping,
+        std::vector<BinaryDataDeserializerPtr> deserializer)
+        : m_chunkId(chunkId),
+        m_numSequences(numSequences),
+        m_sizeInBytes(sizeInBytes),
+        m_mapping(std::move(mapping)),
+        m_chunkData(static_cast<byte*>(m_mapping->GetData())),
         m_deserializers(deserializer)
     { }
 
@@ -41,6 +59,12 @@ public:
             result[i] = m_data[i].at(sequenceIdx);
     }
 
+    // The size of the (uncompressed) chunk data, most sequences point into it.
+    size_t SizeInBytes() const override
+    {
+        return m_sizeInBytes;
+    }
+
     uint32_t GetNumSamples(size_t sequenceIdx)
     {
         uint32_t numSamples = 0;
@@ -58,7 +82,7 @@ protected:
         size_t bytesProcessed = 0;
         // Now call all of the deserializers on the chunk, in order
         for (size_t i = 0; i < m_deserializers.size(); i++)
-            bytesProcessed += m_deserializers[i]->GetSequenceDataForChunk(m_numSequences, m_buffer.get() + bytesProcessed, m_data[i]);
+            bytesProcessed += m_deserializers[i]->GetSequenceDataForChunk(m_numSequences, m_chunkData + bytesProcessed, m_data[i]);
     }
 
     // chunk id (copied from the descriptor)
@@ -68,8 +92,18 @@ protected:
     // so we must tell the chunk where it starts.
     size_t m_numSequences;
 
-    // This is the actual chunk read from disk. We will call back to the deserializer for it to be deserialized
-    unique_ptr<byte[]> m_buffer;
+    // size of the chunk data in bytes
+    size_t m_sizeInBytes;
+
+    // This is the actual chunk read from disk (and decompressed), a buffer of the ChunkBufferPool of the deserializer.
+    // We will call back to the deserializer for it to be deserialized
+    shared_ptr<byte> m_buffer;
+
+    // Or the chunk mapped into memory (see BinaryConfigHelper::ShouldMapInputFile()).
+    unique_ptr<MappedFileRange> m_mapping;
+
+    // The start of the chunk, either in m_buffer or in m_mapping.
+    byte* m_chunkData;
 
     // This is the deserializer who knows how to interpret the m_data chunk that we read in
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
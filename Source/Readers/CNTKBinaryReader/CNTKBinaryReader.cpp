@@ -13,6 +13,7 @@
 #include "NoRandomizer.h"
 #include "SequencePacker.h"
 #include "FramePacker.h"
+#include "ConfigUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -31,8 +32,10 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
 
         if (configHelper.ShouldKeepDataInMemory())
         {
-            m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer));
+            m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer, configHelper.GetMaxDataInMemorySize(), configHelper.GetTraceLevel() >= 1));
             log << " | keeping data in memory";
+            if (configHelper.GetMaxDataInMemorySize() > 0)
+                log << " (up to " << configHelper.GetMaxDataInMemorySize() << " bytes)";
         }
 
         size_t window = configHelper.GetRandomizationWindow();
@@ -59,7 +62,8 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
         }
 
         m_packer = std::make_shared<SequencePacker>( m_sequenceEnumerator,
-                                                    ReaderBase::GetStreamDescriptions());
+                                                    ReaderBase::GetStreamDescriptions(),
+                                                    GetNumberOfPackerBuffers(config));
     }
     catch (const std::runtime_error& e)
     {
@@ -0,0 +1,212 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <string.h>
+#include <omp.h>
+#include "ChunkCompression.h"
+#include "ExceptionCapture.h"
+#include "CPUHugePageAllocator.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Decoding follows the LZ4 block format: a sequence of (token, literals, match) where the token holds the literal
+// length (high 4 bits) and the match length - 4 (low 4 bits), each extended by bytes of 255 while saturated;
+// the match is given by a 2 byte little endian offset back into the output. The last sequence has no match.
+size_t Lz4DecompressBlock(const byte* source, size_t sourceSize, byte* destination, size_t destinationCapacity)
+{
+    const size_t minMatch = 4;
+    const byte* in = source;
+    const byte* inEnd = source + sourceSize;
+    byte* out = destination;
+    byte* outEnd = destination + destinationCapacity;
+
+    auto readLength = [&](size_t length)
+    {
+        if (length == 15)
+        {
+            byte extension;
+            do
+            {
+                if (in == inEnd)
+                    RuntimeError("Corrupt LZ4 block: truncated length.");
+                extension = *in++;
+                length += extension;
+            } while (extension == 255);
+        }
+        return length;
+    };
+
+    while (in < inEnd)
+    {
+        byte token = *in++;
+
+        size_t literalLength = readLength(token >> 4);
+        if (literalLength > static_cast<size_t>(inEnd - in) || literalLength > static_cast<size_t>(outEnd - out))
+            RuntimeError("Corrupt LZ4 block: literals of %zu bytes exceed the block.", literalLength);
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        // the last sequence ends with its literals
+        if (in == inEnd)
+            break;
+
+        if (inEnd - in < 2)
+            RuntimeError("Corrupt LZ4 block: truncated match offset.");
+        size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+        if (offset == 0 || offset > static_cast<size_t>(out - destination))
+            RuntimeError("Corrupt LZ4 block: match offset %zu is out of range.", offset);
+
+        size_t matchLength = readLength(token & 15) + minMatch;
+        if (matchLength > static_cast<size_t>(outEnd - out))
+            RuntimeError("Corrupt LZ4 block: match of %zu bytes exceeds the output.", matchLength);
+
+        // matches may overlap their own output (offset < length repeats the last bytes), so copy forward
+        const byte* match = out - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; i++)
+                *out++ = *match++;
+        }
+    }
+
+    return out - destination;
+}
+
+void DecompressChunkData(ChunkCompression compression, const byte* data, size_t size, byte* output, size_t outputSize, int maxThreads)
+{
+    if (compression == ChunkCompression::none)
+    {
+        if (size < outputSize)
+            RuntimeError("Chunk data of %zu bytes is smaller than expected (%zu bytes).", size, outputSize);
+        memcpy(output, data, outputSize);
+        return;
+    }
+
+    if (compression != ChunkCompression::lz4)
+        RuntimeError("Unknown chunk compression %u.", static_cast<unsigned int>(compression));
+
+    uint32_t numBlocks;
+    if (size < sizeof(numBlocks))
+        RuntimeError("Compressed chunk data is truncated.");
+    memcpy(&numBlocks, data, sizeof(numBlocks));
+
+    struct BlockInfo
+    {
+        uint32_t compressedSize;
+        uint32_t size;
+    };
+    size_t tableSize = sizeof(numBlocks) + numBlocks * sizeof(BlockInfo);
+    if (size < tableSize)
+        RuntimeError("Compressed chunk data is truncated.");
+    vector<BlockInfo> blocks(numBlocks);
+    memcpy(blocks.data(), data + sizeof(numBlocks), numBlocks * sizeof(BlockInfo));
+
+    // positions of the blocks in the compressed data and in the output
+    vector<size_t> sourceOffsets(numBlocks), outputOffsets(numBlocks);
+    size_t sourceOffset = tableSize, outputOffset = 0;
+    for (uint32_t i = 0; i < numBlocks; i++)
+    {
+        sourceOffsets[i] = sourceOffset;
+        outputOffsets[i] = outputOffset;
+        sourceOffset += blocks[i].compressedSize;
+        outputOffset += blocks[i].size;
+    }
+    if (sourceOffset > size || outputOffset != outputSize)
+        RuntimeError("Compressed chunk data is inconsistent: %zu bytes in %u blocks, expected %zu bytes.",
+                     outputOffset, numBlocks, outputSize);
+
+    int numThreads = static_cast<int>(min<size_t>(numBlocks, maxThreads > 0 ? maxThreads : omp_get_max_threads()));
+    ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(max(numThreads, 1))
+    for (int i = 0; i < static_cast<int>(numBlocks); i++)
+    {
+        capture.SafeRun([&](int block)
+        {
+            const byte* source = data + sourceOffsets[block];
+            byte* destination = output + outputOffsets[block];
+            if (blocks[block].compressedSize == blocks[block].size)
+                memcpy(destination, source, blocks[block].size);
+            else if (Lz4DecompressBlock(source, blocks[block].compressedSize, destination, blocks[block].size) != blocks[block].size)
+                RuntimeError("Corrupt LZ4 block %d: the decompressed size does not match.", block);
+        }, i);
+    }
+    capture.RethrowIfHappened();
+}
+
+void ChunkBufferDeleter::operator()(byte* data) const
+{
+    if (!CPUHugePageAllocator::Free(data))
+        delete[] data;
+}
+
+ChunkBuffer AllocateChunkBuffer(size_t size)
+{
+    // the chunk is read or decompressed into it, so it need not be zeroed
+    void* data = CPUHugePageAllocator::Alloc(size, /*zero=*/false);
+    return ChunkBuffer(data ? static_cast<byte*>(data) : new byte[size]);
+}
+
+shared_ptr<byte> ChunkBufferPool::Get(size_t size)
+{
+    ChunkBuffer buffer;
+    size_t capacity = 0;
+    {
+        lock_guard<mutex> lock(m_lock);
+
+        // the smallest free buffer that fits
+        auto best = m_freeBuffers.end();
+        for (auto it = m_freeBuffers.begin(); it != m_freeBuffers.end(); ++it)
+        {
+            if (it->first >= size && (best == m_freeBuffers.end() || it->first < best->first))
+                best = it;
+        }
+        if (best != m_freeBuffers.end())
+        {
+            capacity = best->first;
+            buffer = move(best->second);
+            m_freeBuffers.erase(best);
+        }
+    }
+
+    if (!buffer)
+    {
+        capacity = size;
+        buffer = AllocateChunkBuffer(capacity);
+    }
+
+    weak_ptr<ChunkBufferPool> pool = shared_from_this();
+    return shared_ptr<byte>(buffer.release(), [pool, capacity](byte* data)
+    {
+        auto self = pool.lock();
+        if (self)
+            self->Put(data, capacity);
+        else
+            ChunkBufferDeleter()(data);
+    });
+}
+
+void ChunkBufferPool::Put(byte* data, size_t capacity)
+{
+    lock_guard<mutex> lock(m_lock);
+    m_freeBuffers.emplace_back(capacity, ChunkBuffer(data));
+    if (m_freeBuffers.size() > m_maxFreeBuffers)
+    {
+        auto smallest = min_element(m_freeBuffers.begin(), m_freeBuffers.end(),
+            [](const pair<size_t, ChunkBuffer>& a, const pair<size_t, ChunkBuffer>& b) { return a.first < b.first; });
+        m_freeBuffers.erase(smallest);
+    }
+}
+
+}}}
@@ -0,0 +1,72 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Basics.h"
+#include "basetypes.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Compression of the data of a chunk, as recorded in the chunk table of version 2 files.
+// The sequence lengths in front of the chunk data are never compressed.
+enum class ChunkCompression : uint32_t
+{
+    none = 0,
+    // The data is split into blocks that are compressed independently in the LZ4 block format, so that the
+    // blocks of a chunk can be decompressed in parallel. The compressed data is:
+    //   uint32_t: numBlocks
+    //   { uint32_t compressedSize, uint32_t size }[numBlocks]
+    //   the blocks; a block with compressedSize == size is stored as is (the data did not compress).
+    lz4 = 1,
+};
+
+// Decompresses the (stored) data of a chunk into the output, which has to be exactly as large as the uncompressed data.
+// The blocks are decompressed on up to maxThreads threads (0 for the OpenMP default).
+void DecompressChunkData(ChunkCompression compression, const byte* data, size_t size, byte* output, size_t outputSize, int maxThreads = 0);
+
+// Decompresses a block in the LZ4 block format, returns the size of the decompressed data.
+size_t Lz4DecompressBlock(const byte* source, size_t sourceSize, byte* destination, size_t destinationCapacity);
+
+// A buffer for chunk data: from huge pages if they are enabled and the chunk is large enough (see CPUHugePageAllocator.h),
+// from the heap otherwise.
+struct ChunkBufferDeleter
+{
+    void operator()(byte* data) const;
+};
+typedef std::unique_ptr<byte[], ChunkBufferDeleter> ChunkBuffer;
+ChunkBuffer AllocateChunkBuffer(size_t size);
+
+// Buffers for the chunk data, so that reading a chunk reuses the memory of a released chunk instead of allocating
+// (and page faulting) new memory every time. A buffer goes back to the pool when its last reference is released,
+// or is freed if the pool is gone by then. At most maxFreeBuffers are kept, the smallest ones are dropped first.
+class ChunkBufferPool : public std::enable_shared_from_this<ChunkBufferPool>
+{
+public:
+    explicit ChunkBufferPool(size_t maxFreeBuffers)
+        : m_maxFreeBuffers(maxFreeBuffers)
+    {
+    }
+
+    // Gets a buffer of at least the given size.
+    std::shared_ptr<byte> Get(size_t size);
+
+private:
+    void Put(byte* data, size_t capacity);
+
+    std::mutex m_lock;
+    std::vector<std::pair<size_t, ChunkBuffer>> m_freeBuffers; // capacity and buffer
+    size_t m_maxFreeBuffers;
+
+    DISABLE_COPY_AND_MOVE(ChunkBufferPool);
+};
+
+typedef std::shared_ptr<ChunkBufferPool> ChunkBufferPoolPtr;
+
+}}}
@@ -17,10 +17,14 @@
 
 #include <stdio.h>
 #ifdef __WINDOWS__
+#include <windows.h>
+#include <io.h>
 #endif
 #ifdef __unix__
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 #include <errno.h>
 #include <stdint.h>
@@ -115,9 +119,93 @@ public:
             RuntimeError("Error reading: %s.", strerror(errno));
     }
 
+    static void WriteOrDie(const void* ptr, size_t size, size_t count, FILE* f)
+    {
+        size_t rc;
+        rc = fwrite(ptr, size, count, f);
+        if (rc != count)
+            RuntimeError("Error writing: %s.", strerror(errno));
+    }
+
 private:
     CNTKBinaryFileHelper();
 };
 
+// A read-only mapping of a byte range of an open file into memory, which stays valid until the object is destroyed
+// (independent of the FILE). Pages are read in on first access and shared with the page cache, instead of being
+// copied into a separate buffer. Note that accessing the mapping fails hard (SIGBUS on Linux) if the file is
+// truncated by someone else in the meantime.
+class MappedFileRange
+{
+public:
+    MappedFileRange(FILE* f, int64_t offset, size_t size)
+        : m_view(nullptr), m_viewSize(0), m_data(nullptr)
+    {
+        if (size == 0)
+            return;
+
+        // the mapping has to start at a multiple of the allocation granularity
+#ifdef __WINDOWS__
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+        int64_t granularity = sysInfo.dwAllocationGranularity;
+#else
+        int64_t granularity = sysconf(_SC_PAGESIZE);
+#endif
+        int64_t viewOffset = offset - offset % granularity;
+        m_viewSize = static_cast<size_t>(offset - viewOffset) + size;
+
+#ifdef __WINDOWS__
+        HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(f)));
+        HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+            RuntimeError("Error mapping the input file: error 0x%x.", (unsigned int)GetLastError());
+        m_view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)(viewOffset & 0xFFFFFFFF), m_viewSize);
+        DWORD error = GetLastError();
+        CloseHandle(mapping); // the view keeps the mapping alive
+        if (m_view == NULL)
+            RuntimeError("Error mapping %llu bytes at offset %lld of the input file: error 0x%x.", (unsigned long long)m_viewSize, (long long)viewOffset, (unsigned int)error);
+#else
+        m_view = mmap(nullptr, m_viewSize, PROT_READ, MAP_SHARED, fileno(f), viewOffset);
+        if (m_view == MAP_FAILED)
+        {
+            m_view = nullptr;
+            RuntimeError("Error mapping %llu bytes at offset %lld of the input file: %s.", (unsigned long long)m_viewSize, (long long)viewOffset, strerror(errno));
+        }
+#endif
+        m_data = static_cast<char*>(m_view) + (offset - viewOffset);
+    }
+
+    ~MappedFileRange()
+    {
+        if (!m_view)
+            return;
+#ifdef __WINDOWS__
+        UnmapViewOfFile(m_view);
+#else
+        munmap(m_view, m_viewSize);
+#endif
+    }
+
+    // Asks the OS to start reading the range from disk in the background, so that the first accesses do not stall.
+    // Best effort; a no-op where this is not supported.
+    void WillNeed()
+    {
+#ifdef __unix__
+        if (m_view)
+            madvise(m_view, m_viewSize, MADV_WILLNEED);
+#endif
+    }
+
+    void* GetData() const { return m_data; }
+
+private:
+    void* m_view;
+    size_t m_viewSize;
+    void* m_data;
+
+    DISABLE_COPY_AND_MOVE(MappedFileRange);
+};
+
 }}}
 #endif
\ No newline at end of file
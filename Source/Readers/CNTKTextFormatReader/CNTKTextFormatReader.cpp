@@ -10,9 +10,11 @@
 #include "ChunkCache.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
+#include "StreamingRandomizer.h"
 #include "TextParser.h"
 #include "SequencePacker.h"
 #include "FramePacker.h"
+#include "ConfigUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -34,10 +36,15 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
             m_deserializer = make_shared<TextParser<double>>(corpus, configHelper, true);
 
         if (configHelper.ShouldKeepDataInMemory())
-            m_deserializer = make_shared<ChunkCache>(m_deserializer);
+            m_deserializer = make_shared<ChunkCache>(m_deserializer, configHelper.GetMaxDataInMemorySize(), configHelper.GetTraceLevel() >= 1);
 
         size_t window = configHelper.GetRandomizationWindow();
-        if (window > 0)
+        if (configHelper.IsStreaming())
+        {
+            // The window slides over the input and is in samples, 0 keeps the order of the input.
+            m_sequenceEnumerator = make_shared<StreamingRandomizer>(dynamic_pointer_cast<IStreamingDataDeserializer>(m_deserializer), window);
+        }
+        else if (window > 0)
         {
             // TODO: drop "verbosity", use config.traceLevel() instead. 
             int verbosity = config(L"verbosity", 0); 
@@ -56,13 +63,15 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
         {
             m_packer = std::make_shared<FramePacker>(
                 m_sequenceEnumerator,
-                ReaderBase::GetStreamDescriptions());
+                ReaderBase::GetStreamDescriptions(),
+                GetNumberOfPackerBuffers(config));
         }
         else
         {
             m_packer = std::make_shared<SequencePacker>(
                 m_sequenceEnumerator,
-                ReaderBase::GetStreamDescriptions());
+                ReaderBase::GetStreamDescriptions(),
+                GetNumberOfPackerBuffers(config));
         }
     }
     catch (const std::runtime_error& e)
@@ -123,11 +123,33 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_traceLevel = config(L"traceLevel", 1);
     m_chunkSizeBytes = config(L"chunkSizeInBytes", g_32MB); // 32 MB by default
     m_keepDataInMemory = config(L"keepDataInMemory", false);
+    m_maxDataInMemoryBytes = config(L"maxDataInMemoryBytes", (size_t)0);
     m_frameMode = config(L"frameMode", false);
+    m_cacheIndex = config(L"cacheIndex", false);
+    m_indexCacheDirectory = (wstring)config(L"indexCacheDirectory", L"");
+    m_numParseThreads = config(L"numParseThreads", 0);
+    m_streaming = config(L"streaming", false);
+    m_followInput = config(L"followInput", false);
+    if (m_followInput && !m_streaming)
+    {
+        RuntimeError("'followInput' requires 'streaming' to be enabled.");
+    }
+
+    if (m_streaming && (m_keepDataInMemory || m_cacheIndex))
+    {
+        RuntimeError("'keepDataInMemory' and 'cacheIndex' cannot be used with a streamed input.");
+    }
 
     m_randomizationWindow = GetRandomizationWindowFromConfig(config);
     m_sampleBasedRandomizationWindow = config(L"sampleBasedRandomizationWindow", false);
-    if (!m_sampleBasedRandomizationWindow && m_randomizationWindow == randomizeAuto) 
+    if (m_streaming)
+    {
+        // A streamed input is randomized in a sliding window of samples, the number of chunks is not known.
+        m_sampleBasedRandomizationWindow = true;
+        if (m_randomizationWindow == randomizeAuto)
+            m_randomizationWindow = 1000000;
+    }
+    else if (!m_sampleBasedRandomizationWindow && m_randomizationWindow == randomizeAuto) 
     {
         m_randomizationWindow = g_4GB / m_chunkSizeBytes; // ~ 4 GB (on disk) worth of chunks
     }
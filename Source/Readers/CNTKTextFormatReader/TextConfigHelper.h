@@ -39,8 +39,25 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    // Limit of the memory used to keep the data (see ChunkCache); 0 for no limit.
+    size_t GetMaxDataInMemorySize() const { return m_maxDataInMemoryBytes; }
+
     bool IsInFrameMode() const { return m_frameMode; }
 
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
+    // Directory for the index cache; empty to keep it next to the input file.
+    const std::wstring& GetIndexCacheDirectory() const { return m_indexCacheDirectory; }
+
+    // Number of threads that parse a chunk; 0 to use as many as OpenMP does.
+    unsigned int GetNumParseThreads() const { return m_numParseThreads; }
+
+    // True, when the input is read as a stream (see StreamingRandomizer.h), without indexing it first.
+    bool IsStreaming() const { return m_streaming; }
+
+    // True, when the end of a streamed input file is not the end of the input, but more data is waited for.
+    bool ShouldFollowInput() const { return m_followInput; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(TextConfigHelper);
@@ -58,7 +75,13 @@ private:
     unsigned int m_traceLevel;
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_maxDataInMemoryBytes; // if not 0, only the most recently used chunks up to this size are kept in memory
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
+    bool m_cacheIndex; // if true, the index of the input file is kept on disk across jobs (see IndexCache.h)
+    unsigned int m_numParseThreads;
+    std::wstring m_indexCacheDirectory;
+    bool m_streaming; // if true, the input (a file, a pipe or "-" for stdin) is read once, chunk by chunk, without an index
+    bool m_followInput; // if true, a streamed input is polled for more data at its end (like "tail -f")
 };
 
 } } }
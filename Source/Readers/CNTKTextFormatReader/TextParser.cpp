@@ -7,15 +7,23 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <cfloat>
+#include <chrono>
+#include <thread>
+#include <omp.h>
 #include "Indexer.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
+#include "ExceptionCapture.h"
 
 #define isSign(c) ((c == '-' || c == '+'))
 #define isE(c) ((c == 'e' || c == 'E'))
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Chunks are split into ranges of sequences of at least this many bytes for parsing in parallel,
+// smaller ones are not worth the thread overhead.
+static const size_t s_minBytesPerParseThread = 256 * 1024;
+
 inline bool IsDigit(char c)
 {
     return '0' <= c && c <= '9';
@@ -42,6 +50,9 @@ public:
     // Gets sequences by id.
     void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override;
 
+    // Memory held by the parsed sequences.
+    size_t SizeInBytes() const override;
+
     // A map from sequence ids to the sequence data.
     std::vector<SequenceBuffer> m_sequenceMap;
 
@@ -68,6 +79,9 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), primary)
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetIndexCache(helper.ShouldCacheIndex(), helper.GetIndexCacheDirectory());
+    SetNumParseThreads(helper.GetNumParseThreads());
+    SetStreaming(helper.IsStreaming(), helper.ShouldFollowInput());
 
     Initialize();
 }
@@ -80,19 +94,23 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_file(nullptr),
     m_streamInfos(streams.size()),
     m_indexer(nullptr),
-    m_fileOffsetStart(0),
-    m_fileOffsetEnd(0),
-    m_buffer(new char[BUFFER_SIZE + 1]),
-    m_bufferStart(nullptr),
-    m_bufferEnd(nullptr),
-    m_pos(nullptr),
     m_chunkSizeBytes(0),
     m_traceLevel(TraceLevel::Error),
     m_hadWarnings(false),
     m_numAllowedErrors(0),
+    m_numParseThreads(0),
     m_skipSequenceIds(false),
+    m_cacheIndex(false),
     m_numRetries(5),
-    m_corpus(corpus)
+    m_corpus(corpus),
+    m_parsedBytes(0),
+    m_parseSeconds(0),
+    m_streaming(false),
+    m_followInput(false),
+    m_hasPendingLine(false),
+    m_streamOffset(0),
+    m_nextChunkId(0),
+    m_nextSequenceKey(0)
 {
     assert(streams.size() > 0);
 
@@ -116,14 +134,12 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     }
 
     assert(m_maxAliasLength > 0);
-
-    m_scratch = unique_ptr<char[]>(new char[m_maxAliasLength + 1]);
 }
 
 template <class ElemType>
 TextParser<ElemType>::~TextParser()
 {
-    if (m_file)
+    if (m_file && m_file != stdin)
     {
         fclose(m_file);
     }
@@ -148,6 +164,16 @@ void TextParser<ElemType>::Initialize()
         return;
     }
 
+    if (m_streaming)
+    {
+        // Nothing to index, the input is read as it comes, "-" stands for stdin.
+        if (m_file == nullptr)
+        {
+            m_file = m_filename == L"-" ? stdin : fopenOrDie(m_filename, L"rbS");
+        }
+        return;
+    }
+
     attempt(m_numRetries, [this]()
     {
         if (m_file == nullptr)
@@ -169,23 +195,22 @@ void TextParser<ElemType>::Initialize()
         }
 
         m_indexer = make_unique<Indexer>(m_file, m_primary, m_skipSequenceIds, NAME_PREFIX, m_chunkSizeBytes);
+        if (m_cacheIndex)
+            m_indexer->EnableCache(m_filename, m_indexCacheDirectory, m_traceLevel >= Info);
         m_indexer->Build(m_corpus);
     });
 
     assert(m_indexer != nullptr);
-
-    int64_t position = _ftelli64(m_file);
-    if (position < 0)
-    {
-        RuntimeError("Error retrieving current position in the input file (%ls).", m_filename.c_str());
-    }
-
-    m_fileOffsetEnd = m_fileOffsetStart = static_cast<size_t>(position);
 }
 
 template <class ElemType>
 ChunkDescriptions TextParser<ElemType>::GetChunkDescriptions()
 {
+    if (m_streaming)
+    {
+        LogicError("The chunks of the streamed input (%ls) cannot be enumerated.", m_filename.c_str());
+    }
+
     assert(m_indexer != nullptr);
 
     const auto& index = m_indexer->GetIndex();
@@ -242,6 +267,31 @@ void TextParser<ElemType>::TextDataChunk::GetSequence(size_t sequenceId, std::ve
     result.insert(result.end(), sequenceData.begin(), sequenceData.end());
 }
 
+template <class ElemType>
+size_t TextParser<ElemType>::TextDataChunk::SizeInBytes() const
+{
+    size_t size = m_sequenceMap.capacity() * sizeof(SequenceBuffer);
+    for (const auto& sequenceData : m_sequenceMap)
+    {
+        size += sequenceData.capacity() * sizeof(SequenceDataPtr);
+        for (size_t j = 0; j < sequenceData.size(); ++j)
+        {
+            if (m_parser->m_streamInfos[j].m_type == StorageType::dense)
+            {
+                const auto& data = static_cast<const DenseInputStreamBuffer&>(*sequenceData[j]);
+                size += sizeof(data) + data.m_buffer.capacity() * sizeof(ElemType);
+            }
+            else
+            {
+                const auto& data = static_cast<const SparseInputStreamBuffer&>(*sequenceData[j]);
+                size += sizeof(data) + data.m_buffer.capacity() * sizeof(ElemType) + data.m_indicesBuffer.capacity() * sizeof(IndexType) +
+                        data.m_nnzCounts.capacity() * sizeof(IndexType);
+            }
+        }
+    }
+    return size;
+}
+
 template <class ElemType>
 ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
 {
@@ -264,79 +314,251 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
 template <class ElemType>
 void TextParser<ElemType>::LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor)
 {
-    chunk->m_sequenceMap.resize(descriptor.m_sequences.size());
-    for (size_t sequenceIndex = 0; sequenceIndex < descriptor.m_sequences.size(); ++sequenceIndex)
+    auto start = std::chrono::steady_clock::now();
+
+    // read the text of all sequences at once, so that the parsing threads do not wait for each other on the file
+    size_t chunkBytes = 0;
+    for (const auto& sequence : descriptor.m_sequences)
     {
-        const auto& sequenceDescriptor = descriptor.m_sequences[sequenceIndex];
-        chunk->m_sequenceMap[sequenceIndex] = LoadSequence(sequenceDescriptor, descriptor.m_offset);
+        chunkBytes = max<size_t>(chunkBytes, sequence.OffsetInChunk() + sequence.SizeInBytes());
     }
-}
 
-template <class ElemType>
-void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
-{
-    if (m_numAllowedErrors == 0)
+    unique_ptr<char[]> text(new char[chunkBytes + 1]);
+    if (_fseeki64(m_file, descriptor.m_offset, SEEK_SET) != 0)
+    {
+        PrintWarningNotification();
+        RuntimeError("Error seeking to position %" PRIu64 " in the input file (%ls).",
+            descriptor.m_offset, m_filename.c_str());
+    }
+
+    if (fread(text.get(), 1, chunkBytes, m_file) != chunkBytes)
     {
         PrintWarningNotification();
-        RuntimeError("Reached the maximum number of allowed errors"
-            " while reading the input file (%ls).",
-            m_filename.c_str());
+        RuntimeError("Could not read from the input file (%ls).", m_filename.c_str());
+    }
+
+    size_t numThreads = ParseChunk(chunk, descriptor, text.get(), chunkBytes);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_parsedBytes += chunkBytes;
+    m_parseSeconds += seconds;
+    if (m_traceLevel >= Info)
+    {
+        fprintf(stderr,
+            "INFO: Loaded chunk (id = %u, %" PRIu64 " sequences, %.1f MB) from the input file (%ls) on %" PRIu64 " threads"
+            " in %.3f s (%.1f MB/s, %.1f MB/s over all chunks so far).\n",
+            descriptor.m_id, descriptor.m_sequences.size(), chunkBytes / 1e6, m_filename.c_str(), numThreads,
+            seconds, seconds > 0 ? chunkBytes / 1e6 / seconds : 0.0,
+            m_parseSeconds > 0 ? m_parsedBytes / 1e6 / m_parseSeconds : 0.0);
     }
-    --m_numAllowedErrors;
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryRefillBuffer()
+size_t TextParser<ElemType>::ParseChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor, const char* text, size_t chunkBytes)
 {
-    size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
-
-    if (bytesRead == (size_t)-1)
+    // Split the sequences into contiguous ranges of about the same number of bytes, one per thread.
+    const size_t numSequences = descriptor.m_sequences.size();
+    size_t numThreads = m_numParseThreads > 0 ? m_numParseThreads : static_cast<size_t>(omp_get_max_threads());
+    size_t numRanges = min(min(numThreads, numSequences), max<size_t>(1, chunkBytes / s_minBytesPerParseThread));
+    numRanges = max<size_t>(1, numRanges);
+
+    std::vector<size_t> rangeBegin(numRanges + 1, numSequences);
+    rangeBegin[0] = 0;
+    for (size_t range = 1, sequenceIndex = 0; range < numRanges; ++range)
     {
-        PrintWarningNotification();
-        RuntimeError("Could not read from the input file (%ls).", m_filename.c_str());
+        size_t rangeStartOffset = chunkBytes * range / numRanges;
+        while (sequenceIndex < numSequences && descriptor.m_sequences[sequenceIndex].OffsetInChunk() < rangeStartOffset)
+        {
+            ++sequenceIndex;
+        }
+        rangeBegin[range] = sequenceIndex;
     }
 
-    if (!bytesRead)
+    chunk->m_sequenceMap.resize(numSequences);
+    auto parseRange = [this, &chunk, &descriptor, text, &rangeBegin, chunkBytes](int range)
     {
-        return false;
+        Cursor cursor(text, text + chunkBytes, descriptor.m_offset, m_maxAliasLength);
+        for (size_t sequenceIndex = rangeBegin[range]; sequenceIndex < rangeBegin[range + 1]; ++sequenceIndex)
+        {
+            chunk->m_sequenceMap[sequenceIndex] = LoadSequence(cursor, descriptor.m_sequences[sequenceIndex]);
+        }
+    };
+
+    if (numRanges == 1)
+    {
+        parseRange(0);
+    }
+    else
+    {
+        ExceptionCapture capture;
+#pragma omp parallel for schedule(static, 1) num_threads(static_cast<int>(numRanges))
+        for (int range = 0; range < static_cast<int>(numRanges); ++range)
+            capture.SafeRun(parseRange, range);
+        capture.RethrowIfHappened();
     }
 
-    m_fileOffsetStart = m_fileOffsetEnd;
-    m_fileOffsetEnd += bytesRead;
-    m_bufferStart = m_buffer.get();
-    m_pos = m_bufferStart;
-    m_bufferEnd = m_bufferStart + bytesRead;
-    return true;
+    return numRanges;
+}
+
+template <class ElemType>
+bool TextParser<ElemType>::TryReadLine(std::string& line)
+{
+    line.clear();
+    char buffer[4096];
+    for (;;)
+    {
+        if (fgets(buffer, sizeof(buffer), m_file) != nullptr)
+        {
+            line += buffer;
+            if (line.back() == ROW_DELIMITER)
+            {
+                return true;
+            }
+            continue;
+        }
+
+        if (ferror(m_file) != 0)
+        {
+            PrintWarningNotification();
+            RuntimeError("Could not read from the input (%ls).", m_filename.c_str());
+        }
+
+        if (m_followInput)
+        {
+            // wait for the writer to append more data (possibly the rest of this line)
+            clearerr(m_file);
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            continue;
+        }
+
+        if (line.empty())
+        {
+            return false;
+        }
+
+        line += ROW_DELIMITER;
+        return true;
+    }
 }
 
 template <class ElemType>
-void TextParser<ElemType>::SetFileOffset(int64_t offset)
+ChunkPtr TextParser<ElemType>::GetNextChunk(std::vector<SequenceDescription>& result)
 {
-    int rc = _fseeki64(m_file, offset, SEEK_SET);
-    if (rc)
+    if (!m_streaming)
+    {
+        LogicError("GetNextChunk() requires the input (%ls) to be streamed.", m_filename.c_str());
+    }
+
+    // Collect the lines of whole sequences until the chunk size is reached. Lines belong to the same sequence
+    // as long as they start with the same sequence id, so a sequence is only complete once the first line
+    // of the next one (or the end of the input) has been read; that line is kept for the next chunk.
+    Index index(SIZE_MAX, /*primary =*/ true);
+    index.Reserve(0);
+    index.m_chunks.back().m_offset = m_streamOffset;
+
+    std::string text;
+    text.reserve(m_chunkSizeBytes);
+    std::string sequenceId;
+    size_t sequenceOffset = m_streamOffset;
+    uint32_t numberOfSamples = 0;
+    while (m_hasPendingLine || (m_hasPendingLine = TryReadLine(m_pendingLine)))
+    {
+        if (m_streamOffset == 0 && m_pendingLine.compare(0, 3, "\xEF\xBB\xBF") == 0)
+        {
+            // input contains UTF-8 BOM value, skip it.
+            m_pendingLine.erase(0, 3);
+            m_streamOffset = sequenceOffset = 3;
+            index.m_chunks.back().m_offset = m_streamOffset;
+        }
+
+        size_t idLength = 0;
+        while (!m_skipSequenceIds && idLength < m_pendingLine.size() && IsDigit(m_pendingLine[idLength]))
+        {
+            ++idLength;
+        }
+
+        // lines without a sequence id are sequences on their own
+        if (numberOfSamples > 0 && (idLength == 0 || m_pendingLine.compare(0, idLength, sequenceId) != 0))
+        {
+            index.AddSequence(SequenceDescriptor{ KeyType{ m_nextSequenceKey++, 0 }, numberOfSamples }, sequenceOffset, m_streamOffset);
+            sequenceOffset = m_streamOffset;
+            numberOfSamples = 0;
+            if (text.size() >= m_chunkSizeBytes)
+            {
+                break;
+            }
+        }
+
+        sequenceId.assign(m_pendingLine, 0, idLength);
+        text += m_pendingLine;
+        m_streamOffset += m_pendingLine.size();
+        numberOfSamples++;
+        m_hasPendingLine = false;
+    }
+
+    if (numberOfSamples > 0)
+    {
+        // the end of the input
+        index.AddSequence(SequenceDescriptor{ KeyType{ m_nextSequenceKey++, 0 }, numberOfSamples }, sequenceOffset, m_streamOffset);
+    }
+
+    ChunkDescriptor& descriptor = index.m_chunks.back();
+    if (descriptor.m_sequences.empty())
     {
         PrintWarningNotification();
-        RuntimeError("Error seeking to position %" PRId64 " in the input file (%ls).",
-            offset, m_filename.c_str());
+        return nullptr;
     }
 
-    m_fileOffsetStart = offset;
-    m_fileOffsetEnd = offset;
+    descriptor.m_id = m_nextChunkId++;
+    auto textChunk = make_shared<TextDataChunk>(descriptor, this);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t numThreads = ParseChunk(textChunk, descriptor, text.data(), text.size());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (m_traceLevel >= Info)
+    {
+        fprintf(stderr,
+            "INFO: Parsed chunk (id = %u, %" PRIu64 " sequences, %.1f MB) of the streamed input (%ls) on %" PRIu64 " threads"
+            " in %.3f s.\n",
+            descriptor.m_id, descriptor.m_sequences.size(), text.size() / 1e6, m_filename.c_str(), numThreads, seconds);
+    }
+
+    result.reserve(result.size() + descriptor.m_sequences.size());
+    for (size_t sequenceIndex = 0; sequenceIndex < descriptor.m_sequences.size(); ++sequenceIndex)
+    {
+        const auto& s = descriptor.m_sequences[sequenceIndex];
+        result.push_back(
+        {
+            sequenceIndex,
+            s.m_numberOfSamples,
+            descriptor.m_id,
+            s.m_key
+        });
+    }
 
-    TryRefillBuffer();
+    return textChunk;
 }
 
 template <class ElemType>
-typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence(const SequenceDescriptor& sequenceDsc, size_t chunkOffsetInFile)
+void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 {
-    size_t fileOffset = sequenceDsc.OffsetInChunk() + chunkOffsetInFile;
-    if (fileOffset < m_fileOffsetStart || fileOffset > m_fileOffsetEnd)
+    unsigned int numAllowedErrors = m_numAllowedErrors;
+    do
     {
-        SetFileOffset(fileOffset);
-    }
+        if (numAllowedErrors == 0)
+        {
+            PrintWarningNotification();
+            RuntimeError("Reached the maximum number of allowed errors"
+                " while reading the input file (%ls).",
+                m_filename.c_str());
+        }
+    } while (!m_numAllowedErrors.compare_exchange_weak(numAllowedErrors, numAllowedErrors - 1));
+}
 
-    size_t bufferOffset = fileOffset - m_fileOffsetStart;
-    m_pos = m_bufferStart + bufferOffset;
+template <class ElemType>
+typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence(Cursor& cursor, const SequenceDescriptor& sequenceDsc)
+{
+    cursor.m_pos = cursor.m_bufferStart + sequenceDsc.OffsetInChunk();
     size_t bytesToRead = sequenceDsc.SizeInBytes();
 
     SequenceBuffer sequence;
@@ -358,7 +580,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
     size_t numRowsRead = 0, expectedRowCount = sequenceDsc.m_numberOfSamples;
     for (size_t i = 0; i < expectedRowCount; i++)
     {
-        if ((TryReadRow(sequence, bytesToRead)))
+        if ((TryReadRow(cursor, sequence, bytesToRead)))
         {
             ++numRowsRead;
         }
@@ -371,7 +593,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
                     " while loading sequence (id = %" PRIu64 ") %ls.\n",
                     i + 1,
                     sequenceDsc.m_key.m_sequence,
-                    GetFileInfo().c_str());
+                    GetFileInfo(cursor).c_str());
             }
             IncrementNumberOfErrorsOrDie();
         }
@@ -385,7 +607,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
                     " expected for the current sequence (id = %" PRIu64 ") %ls,"
                     " but only read %" PRIu64 " out of %" PRIu64 " expected rows.\n",
                     sequenceDsc.m_key.m_sequence,
-                    GetFileInfo().c_str(), numRowsRead, expectedRowCount);
+                    GetFileInfo(cursor).c_str(), numRowsRead, expectedRowCount);
             }
             break;
         }
@@ -401,7 +623,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
         {
             fprintf(stderr,
                 "ERROR: Input ('%ls') is empty in sequence (id = %" PRIu64 ") %ls.\n",
-                m_streams[i]->m_name.c_str(), sequenceDsc.m_key.m_sequence, GetFileInfo().c_str());
+                m_streams[i]->m_name.c_str(), sequenceDsc.m_key.m_sequence, GetFileInfo(cursor).c_str());
             hasEmptyInputs = true;
         }
 
@@ -414,7 +636,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
                     "WARNING: Input ('%ls') contains more samples than expected"
                     " (%u vs. %" PRIu64 ") for sequence (id = %" PRIu64 ") %ls.\n",
                     m_streams[i]->m_name.c_str(), sequence[i]->m_numberOfSamples, expectedRowCount,
-                    sequenceDsc.m_key.m_sequence, GetFileInfo().c_str());
+                    sequenceDsc.m_key.m_sequence, GetFileInfo(cursor).c_str());
             }
         }
         maxInputLength = max(sequence[i]->m_numberOfSamples, maxInputLength);
@@ -438,7 +660,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
                 "WARNING: Maximum per-input number of samples for sequence (id = %" PRIu64 ") %ls"
                 " is less than expected (%u vs. %" PRIu64 ").\n",
                 sequenceDsc.m_key.m_sequence,
-                GetFileInfo().c_str(), maxInputLength, expectedRowCount);
+                GetFileInfo(cursor).c_str(), maxInputLength, expectedRowCount);
         }
         IncrementNumberOfErrorsOrDie();
     }
@@ -448,7 +670,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
         fprintf(stderr,
             "INFO: Finished loading sequence (id = %" PRIu64 ") %ls,"
             " successfully read %" PRIu64 " out of expected %" PRIu64 " rows.\n",
-            sequenceDsc.m_key.m_sequence, GetFileInfo().c_str(), numRowsRead, expectedRowCount);
+            sequenceDsc.m_key.m_sequence, GetFileInfo(cursor).c_str(), numRowsRead, expectedRowCount);
     }
 
     FillSequenceMetadata(sequence, sequenceDsc.m_key);
@@ -479,37 +701,37 @@ void TextParser<ElemType>::FillSequenceMetadata(SequenceBuffer& sequenceData, co
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadRow(Cursor& cursor, SequenceBuffer& sequence, size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead() && IsDigit(*m_pos))
+    while (bytesToRead && CanRead(cursor) && IsDigit(*cursor.m_pos))
     {
         // skip sequence ids
-        ++m_pos;
+        ++cursor.m_pos;
         --bytesToRead;
     }
 
     size_t numSampleRead = 0;
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(cursor))
     {
-        char c = *m_pos;
+        char c = *cursor.m_pos;
 
         if (c == ROW_DELIMITER)
         {
             // found the end of row, skip the delimiter, return.
-            ++m_pos;
+            ++cursor.m_pos;
             --bytesToRead;
 
             if (numSampleRead == 0 && ShouldWarn())
             {
                 fprintf(stderr,
-                    "WARNING: Empty input row %ls.\n", GetFileInfo().c_str());
+                    "WARNING: Empty input row %ls.\n", GetFileInfo(cursor).c_str());
             }
             else if (numSampleRead > m_streams.size() && ShouldWarn())
             {
                 fprintf(stderr,
                     "WARNING: Input row %ls contains more"
                     " samples than expected (%" PRIu64 " vs. %" PRIu64 ").\n",
-                    GetFileInfo().c_str(), numSampleRead, m_streams.size());
+                    GetFileInfo(cursor).c_str(), numSampleRead, m_streams.size());
             }
 
             return numSampleRead > 0;
@@ -518,19 +740,19 @@ bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToR
         if (isColumnDelimiter(c))
         {
             // skip column (input) delimiters.
-            ++m_pos;
+            ++cursor.m_pos;
             --bytesToRead;
             continue;
         }
 
-        if (TryReadSample(sequence, bytesToRead))
+        if (TryReadSample(cursor, sequence, bytesToRead))
         {
             numSampleRead++;
         }
         else
         {
             // skip over until the next sample/end of row
-            SkipToNextInput(bytesToRead);
+            SkipToNextInput(cursor, bytesToRead);
         }
     }
 
@@ -539,7 +761,7 @@ bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToR
         fprintf(stderr,
             "WARNING: Exhausted all input expected for the current sequence"
             " while reading an input row %ls."
-            " Possibly, a trailing newline is missing.\n", GetFileInfo().c_str());
+            " Possibly, a trailing newline is missing.\n", GetFileInfo(cursor).c_str());
     }
 
     // Return true when we've consumed all expected input.
@@ -548,40 +770,40 @@ bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToR
 
 // Reads one sample (an pipe-prefixed input identifier followed by a list of values)
 template <class ElemType>
-bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadSample(Cursor& cursor, SequenceBuffer& sequence, size_t& bytesToRead)
 {
-    assert(m_pos < m_bufferEnd);
+    assert(cursor.m_pos < cursor.m_bufferEnd);
 
     // prefix check.
-    if (*m_pos != NAME_PREFIX)
+    if (*cursor.m_pos != NAME_PREFIX)
     {
         if (ShouldWarn())
         {
             fprintf(stderr,
                 "WARNING: Unexpected character('%c') in place of a name prefix ('%c')"
                 " in an input name %ls.\n",
-                *m_pos, NAME_PREFIX, GetFileInfo().c_str());
+                *cursor.m_pos, NAME_PREFIX, GetFileInfo(cursor).c_str());
         }
         IncrementNumberOfErrorsOrDie();
         return false;
     }
 
     // skip name prefix
-    ++m_pos;
+    ++cursor.m_pos;
     --bytesToRead;
 
-    if (bytesToRead && CanRead() && *m_pos == ESCAPE_SYMBOL)
+    if (bytesToRead && CanRead(cursor) && *cursor.m_pos == ESCAPE_SYMBOL)
     {
         // A vertical bar followed by the number sign (|#) is treated as an escape sequence, 
         // everything that follows is ignored until the next vertical bar or the end of 
         // row, whichever comes first.
-        ++m_pos;
+        ++cursor.m_pos;
         --bytesToRead;
         return false;
     }
 
     size_t id;
-    if (!TryGetInputId(id, bytesToRead))
+    if (!TryGetInputId(cursor, id, bytesToRead))
     {
         return false;
     }
@@ -594,7 +816,7 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
         vector<ElemType>& values = data->m_buffer;
         size_t size = values.size();
         assert(size % stream.m_sampleDimension == 0);
-        if (!TryReadDenseSample(values, stream.m_sampleDimension, bytesToRead))
+        if (!TryReadDenseSample(cursor, values, stream.m_sampleDimension, bytesToRead))
         {
             // expected a dense sample, but was not able to fully read it, ignore it.
             if (values.size() != size)
@@ -615,7 +837,7 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
         vector<IndexType>& indices = data->m_indicesBuffer;
         assert(values.size() == indices.size());
         size_t size = values.size();
-        if (!TryReadSparseSample(values, indices, stream.m_sampleDimension, bytesToRead))
+        if (!TryReadSparseSample(cursor, values, indices, stream.m_sampleDimension, bytesToRead))
         {
             // expected a sparse sample, but something went south, ignore it.
             if (values.size() != size)
@@ -643,22 +865,22 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
+bool TextParser<ElemType>::TryGetInputId(Cursor& cursor, size_t& id, size_t& bytesToRead)
 {
-    char* scratchIndex = m_scratch.get();
+    char* scratchIndex = cursor.m_scratch.get();
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(cursor))
     {
-        char c = *m_pos;
+        char c = *cursor.m_pos;
 
         // stop as soon as there's a value delimiter, an input prefix
         // or a non-printable character (e.g., newline, carriage return).
         if (isValueDelimiter(c) || c == NAME_PREFIX || isNonPrintable(c))
         {
-            size_t size = scratchIndex - m_scratch.get();
+            size_t size = scratchIndex - cursor.m_scratch.get();
             if (size)
             {
-                string name(m_scratch.get(), size);
+                string name(cursor.m_scratch.get(), size);
                 auto it = m_aliasToIdMap.find(name);
                 if (it != m_aliasToIdMap.end())
                 {
@@ -671,7 +893,7 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
                     fprintf(stderr,
                         "INFO: Skipping unknown input ('%s') %ls. "
                         "Input name '%s' was not specified in the reader config section.\n",
-                        name.c_str(), GetFileInfo().c_str(), name.c_str());
+                        name.c_str(), GetFileInfo(cursor).c_str(), name.c_str());
                 }
 
                 // return false here to skip this input, but do not call IncrementNumberOfErrorsOrDie()
@@ -683,12 +905,12 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
                 fprintf(stderr,
                     "WARNING: Input name prefix ('%c') is followed by"
                     " an invalid character ('%c') %ls.\n",
-                    NAME_PREFIX, c, GetFileInfo().c_str());
+                    NAME_PREFIX, c, GetFileInfo(cursor).c_str());
             }
 
             break;
         }
-        else if (scratchIndex < (m_scratch.get() + m_maxAliasLength))
+        else if (scratchIndex < (cursor.m_scratch.get() + m_maxAliasLength))
         {
             *scratchIndex = c;
             ++scratchIndex;
@@ -699,17 +921,17 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
             // yet it's not followed by a delimiter.
             if (m_traceLevel >= Info)
             {
-                string namePrefix(m_scratch.get(), m_maxAliasLength);
+                string namePrefix(cursor.m_scratch.get(), m_maxAliasLength);
                 fprintf(stderr,
                     "INFO: Skipping unknown input %ls. "
                     "Input name (with the %" PRIu64 "-character prefix '%s') "
                     "exceeds the maximum expected length (%" PRIu64 ").\n",
-                    GetFileInfo().c_str(), m_maxAliasLength, namePrefix.c_str(), m_maxAliasLength);
+                    GetFileInfo(cursor).c_str(), m_maxAliasLength, namePrefix.c_str(), m_maxAliasLength);
             }
             return false;
         }
 
-        ++m_pos;
+        ++cursor.m_pos;
         --bytesToRead;
     }
 
@@ -718,13 +940,13 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
         {
             fprintf(stderr,
                 "WARNING: Exhausted all input expected for the current sequence"
-                " while reading an input name %ls.\n", GetFileInfo().c_str());
+                " while reading an input name %ls.\n", GetFileInfo(cursor).c_str());
         }
-        else if (!CanRead()) 
+        else if (!CanRead(cursor)) 
         {
             fprintf(stderr,
                 "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-                " while reading an input name %ls.\n", bytesToRead, GetFileInfo().c_str());
+                " while reading an input name %ls.\n", bytesToRead, GetFileInfo(cursor).c_str());
         }
     }
     
@@ -734,19 +956,19 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadDenseSample(Cursor& cursor, vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead)
 {
     size_t counter = 0;
     ElemType value;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(cursor))
     {
-        char c = *m_pos;
+        char c = *cursor.m_pos;
 
         if (isValueDelimiter(c))
         {
             // skip value delimiters
-            ++m_pos;
+            ++cursor.m_pos;
             --bytesToRead;
             continue;
         }
@@ -761,7 +983,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
                     fprintf(stderr,
                         "WARNING: Dense sample (size = %" PRIu64 ") %ls"
                         " exceeds the expected size (%" PRIu64 ").\n",
-                        counter, GetFileInfo().c_str(), sampleSize);
+                        counter, GetFileInfo(cursor).c_str(), sampleSize);
                 }
                 return false;
             }
@@ -775,7 +997,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
                     fprintf(stderr,
                         "WARNING: A dense sample %ls has a sparse suffix "
                         "(expected size = %" PRIu64 ", actual size = %" PRIu64 ").\n",
-                        GetFileInfo().c_str(), sampleSize, counter);
+                        GetFileInfo(cursor).c_str(), sampleSize, counter);
                 }
                 for (; counter < sampleSize; ++counter)
                 {
@@ -786,7 +1008,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
             return true;
         }
 
-        if (!TryReadRealNumber(value, bytesToRead))
+        if (!TryReadRealNumber(cursor, value, bytesToRead))
         {
             // bail out.
             return false;
@@ -802,13 +1024,13 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
         {
             fprintf(stderr,
                 "WARNING: Exhausted all input expected for the current sequence"
-                " while reading a dense sample %ls.\n", GetFileInfo().c_str());
+                " while reading a dense sample %ls.\n", GetFileInfo(cursor).c_str());
         }
-        else if (!CanRead())
+        else if (!CanRead(cursor))
         {
             fprintf(stderr,
                 "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-                " while reading a dense sample %ls.\n", bytesToRead, GetFileInfo().c_str());
+                " while reading a dense sample %ls.\n", bytesToRead, GetFileInfo(cursor).c_str());
         }
     }
 
@@ -818,20 +1040,20 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, std::vector<IndexType>& indices,
+bool TextParser<ElemType>::TryReadSparseSample(Cursor& cursor, std::vector<ElemType>& values, std::vector<IndexType>& indices,
     size_t sampleSize, size_t& bytesToRead)
 {
     size_t index = 0;
     ElemType value;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(cursor))
     {
-        char c = *m_pos;
+        char c = *cursor.m_pos;
 
         if (isValueDelimiter(c))
         {
             // skip value delimiters
-            ++m_pos;
+            ++cursor.m_pos;
             --bytesToRead;
             continue;
         }
@@ -844,7 +1066,7 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
         }
 
         // read next sparse index
-        if (!TryReadUint64(index, bytesToRead))
+        if (!TryReadUint64(cursor, index, bytesToRead))
         {
             // bail out.
             return false;
@@ -857,14 +1079,14 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
                 fprintf(stderr,
                     "WARNING: Sparse index value (%" PRIu64 ") %ls"
                     " exceeds the maximum expected value (%" PRIu64 ").\n",
-                    index, GetFileInfo().c_str(), sampleSize - 1);
+                    index, GetFileInfo(cursor).c_str(), sampleSize - 1);
             }
             // bail out.
             return false;
         }
 
         // an index must be followed by a delimiter
-        c = *m_pos;
+        c = *cursor.m_pos;
         if (c != INDEX_DELIMITER)
         {
             if (ShouldWarn())
@@ -873,17 +1095,17 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
                     "WARNING: Unexpected character('%c')"
                     " in place of the index delimiter ('%c')"
                     " after a sparse value index (%" PRIu64 ") %ls.\n",
-                    c, INDEX_DELIMITER, index, GetFileInfo().c_str());
+                    c, INDEX_DELIMITER, index, GetFileInfo(cursor).c_str());
             }
             return false;
         }
 
         // skip index delimiter
-        ++m_pos;
+        ++cursor.m_pos;
         --bytesToRead;
 
         // read the corresponding value
-        if (!TryReadRealNumber(value, bytesToRead))
+        if (!TryReadRealNumber(cursor, value, bytesToRead))
         {
             // bail out.
             return false;
@@ -899,13 +1121,13 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
         {
             fprintf(stderr,
                 "WARNING: Exhausted all input expected for the current sequence"
-                " while reading a sparse sample %ls.\n", GetFileInfo().c_str());
+                " while reading a sparse sample %ls.\n", GetFileInfo(cursor).c_str());
         }
-        else if (!CanRead())
+        else if (!CanRead(cursor))
         {
             fprintf(stderr,
                 "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-                " while reading a sparse sample %ls.\n", bytesToRead, GetFileInfo().c_str());
+                " while reading a sparse sample %ls.\n", bytesToRead, GetFileInfo(cursor).c_str());
         }
     }
 
@@ -915,45 +1137,45 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
 }
 
 template <class ElemType>
-void TextParser<ElemType>::SkipToNextValue(size_t& bytesToRead)
+void TextParser<ElemType>::SkipToNextValue(Cursor& cursor, size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(cursor))
     {
-        char c = *m_pos;
+        char c = *cursor.m_pos;
         // skip everything until we hit either a value delimiter, an input marker or the end of row.
         if (isValueDelimiter(c) || c == NAME_PREFIX || c == ROW_DELIMITER)
         {
             return;
         }
-        ++m_pos;
+        ++cursor.m_pos;
         --bytesToRead;
     }
 }
 
 template <class ElemType>
-void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
+void TextParser<ElemType>::SkipToNextInput(Cursor& cursor, size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(cursor))
     {
-        char c = *m_pos;
+        char c = *cursor.m_pos;
         // skip everything until we hit either an input marker or the end of row.
         if (c == NAME_PREFIX || c == ROW_DELIMITER)
         {
             return;
         }
-        ++m_pos;
+        ++cursor.m_pos;
         --bytesToRead;
     }
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadUint64(Cursor& cursor, size_t& value, size_t& bytesToRead)
 {
     value = 0;
     bool found = false;
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(cursor))
     {
-        char c = *m_pos;
+        char c = *cursor.m_pos;
 
         if (!IsDigit(c))
         {
@@ -961,7 +1183,7 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
             {
                 fprintf(stderr,
                     "WARNING: Expected a uint64 value, but none found %ls.\n", 
-                    GetFileInfo().c_str());
+                    GetFileInfo(cursor).c_str());
             }
 
             return found;
@@ -977,13 +1199,13 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
             {
                 fprintf(stderr,
                     "WARNING: Overflow while reading a uint64 value %ls.\n",
-                    GetFileInfo().c_str());
+                    GetFileInfo(cursor).c_str());
             }
 
             return false;
         }
 
-        ++m_pos;
+        ++cursor.m_pos;
         --bytesToRead;
     }
 
@@ -992,13 +1214,13 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
         if (bytesToRead == 0) {
             fprintf(stderr,
                 "WARNING: Exhausted all input expected for the current sequence"
-                " while reading a uint64 value %ls.\n", GetFileInfo().c_str());
+                " while reading a uint64 value %ls.\n", GetFileInfo(cursor).c_str());
         }
-        else if (!CanRead())
+        else if (!CanRead(cursor))
         {
             fprintf(stderr,
                 "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-                " while reading a uint64 value %ls.\n", bytesToRead, GetFileInfo().c_str());
+                " while reading a uint64 value %ls.\n", bytesToRead, GetFileInfo(cursor).c_str());
         }
         
     }
@@ -1009,23 +1231,95 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 
 
 
+// Most values in the text format are plain decimals ('1', '-0.25'), for which the state machine
+// of TryReadRealNumber() does a lot of branching per character. This scans them in tight loops
+// over the in-memory text instead, and computes the value in the same way, so that the result
+// does not depend on the path taken. Anything else (exponents, malformed values, values at the
+// very end of a sequence) is left to the state machine.
+template <class ElemType>
+bool TextParser<ElemType>::TryReadDecimalNumber(Cursor& cursor, ElemType& value, size_t& bytesToRead)
+{
+    const char* pos = cursor.m_pos;
+    const char* end = pos + min(bytesToRead, static_cast<size_t>(cursor.m_bufferEnd - pos));
+
+    bool negative = false;
+    if (pos != end && isSign(*pos))
+    {
+        negative = (*pos == '-');
+        ++pos;
+    }
+
+    const char* integralPart = pos;
+    double number = .0;
+    while (pos != end && IsDigit(*pos))
+    {
+        number = number * 10 + (*pos++ - '0');
+    }
+
+    if (pos == integralPart || pos == end)
+    {
+        return false;
+    }
+
+    double coefficient = number;
+    if (*pos == '.')
+    {
+        const char* fractionalPart = ++pos;
+        double divider = 1;
+        number = .0;
+        while (pos != end && IsDigit(*pos))
+        {
+            number = number * 10 + (*pos++ - '0');
+            divider *= 10;
+        }
+
+        if (pos == end)
+        {
+            return false;
+        }
+
+        if (pos != fractionalPart)
+        {
+            if (isE(*pos))
+            {
+                return false;
+            }
+            coefficient += (number / divider);
+        }
+    }
+    else if (isE(*pos))
+    {
+        return false;
+    }
+
+    value = static_cast<ElemType>((negative) ? -coefficient : coefficient);
+    bytesToRead -= (pos - cursor.m_pos);
+    cursor.m_pos = pos;
+    return true;
+}
+
 // TODO: better precision (at the moment we're at parity with UCIFast)?
 // Assumes that bytesToRead is greater than the number of characters 
 // in the string representation of the floating point number
 // (i.e., the string is followed by one of the delimiters)
-// Post condition: m_pos points to the first character that 
+// Post condition: cursor.m_pos points to the first character that 
 // cannot be parsed as part of a floating point number.
 // Returns true if parsing was successful.
 template <class ElemType>
-bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadRealNumber(Cursor& cursor, ElemType& value, size_t& bytesToRead)
 {
+    if (TryReadDecimalNumber(cursor, value, bytesToRead))
+    {
+        return true;
+    }
+
     State state = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && CanRead(cursor))
     {
-        char c = *m_pos;
+        char c = *cursor.m_pos;
 
         switch (state)
         {
@@ -1048,7 +1342,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
                     fprintf(stderr,
                         "WARNING: Unexpected character ('%c')"
                         " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
+                        c, GetFileInfo(cursor).c_str());
                 }
                 return false;
             }
@@ -1067,7 +1361,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
                     fprintf(stderr,
                         "WARNING: A sign symbol is followed by an invalid character('%c')"
                         " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
+                        c, GetFileInfo(cursor).c_str());
                 }
                 return false;
             }
@@ -1151,7 +1445,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
                     fprintf(stderr,
                         "WARNING: An exponent symbol is followed by"
                         " an invalid character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                        " in a floating point value %ls.\n", c, GetFileInfo(cursor).c_str());
                 }
                 return false;
             }
@@ -1170,7 +1464,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
                     fprintf(stderr,
                         "WARNING: An exponent sign symbol followed by"
                         " an unexpected character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                        " in a floating point value %ls.\n", c, GetFileInfo(cursor).c_str());
                 }
                 return false;
             }
@@ -1194,12 +1488,12 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             {
                 fprintf(stderr,
                     "WARNING: Reached an invalid state while reading a floating point value %ls.\n",
-                    GetFileInfo().c_str());
+                    GetFileInfo(cursor).c_str());
             }
             return false;
         }
 
-        ++m_pos;
+        ++cursor.m_pos;
         --bytesToRead;
     }
 
@@ -1211,7 +1505,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             fprintf(stderr,
                 "WARNING: Exhausted all input expected for the current sequence"
                 " while reading an input row %ls."
-                " Possibly, a trailing newline is missing.\n", GetFileInfo().c_str());
+                " Possibly, a trailing newline is missing.\n", GetFileInfo(cursor).c_str());
         }
 
         switch (state)
@@ -1235,7 +1529,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
         {
             fprintf(stderr,
                 "WARNING: Reached an invalid state while reading a floating point value %ls.\n",
-                GetFileInfo().c_str());
+                GetFileInfo(cursor).c_str());
         }
         return false;
     }
@@ -1244,7 +1538,7 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
     {
         fprintf(stderr,
             "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-            " while reading an input row %ls.\n", bytesToRead, GetFileInfo().c_str());
+            " while reading an input row %ls.\n", bytesToRead, GetFileInfo(cursor).c_str());
     }
 
     return false;
@@ -1281,10 +1575,30 @@ void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
 }
 
 template <class ElemType>
-std::wstring TextParser<ElemType>::GetFileInfo()
+void TextParser<ElemType>::SetIndexCache(bool cacheIndex, const std::wstring& cacheDirectory)
+{
+    m_cacheIndex = cacheIndex;
+    m_indexCacheDirectory = cacheDirectory;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetNumParseThreads(unsigned int numThreads)
+{
+    m_numParseThreads = numThreads;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetStreaming(bool streaming, bool followInput)
+{
+    m_streaming = streaming;
+    m_followInput = followInput;
+}
+
+template <class ElemType>
+std::wstring TextParser<ElemType>::GetFileInfo(const Cursor& cursor)
 {
     std::wstringstream info;
-    info << L"at offset " << GetFileOffset() << L" in the input file (" << m_filename << L")";
+    info << L"at offset " << GetFileOffset(cursor) << L" in the input file (" << m_filename << L")";
     return info.str();
 }
 
@@ -1294,23 +1608,22 @@ bool TextParser<ElemType>::GetSequenceDescriptionByKey(const KeyType& key, Seque
     if (m_primary)
         LogicError("Matching by sequence key is not supported for primary deserilalizer.");
 
-    const auto& keys = m_indexer->GetIndex().m_keyToSequenceInChunk;
-    auto sequenceLocation = keys.find(key.m_sequence);
-    if (sequenceLocation == keys.end())
+    const auto& index = m_indexer->GetIndex();
+
+    std::pair<uint32_t, uint32_t> sequenceLocation;
+    if (!index.m_keyToSequenceInChunk.TryGet(key.m_sequence, sequenceLocation))
     {
         return false;
     }
 
-    const auto& index = m_indexer->GetIndex();
-
-    assert(sequenceLocation->second.first < index.m_chunks.size());
-    const auto& chunk = index.m_chunks[sequenceLocation->second.first];
+    assert(sequenceLocation.first < index.m_chunks.size());
+    const auto& chunk = index.m_chunks[sequenceLocation.first];
 
-    assert(sequenceLocation->second.second < chunk.m_sequences.size());
-    const auto& sequence = chunk.m_sequences[sequenceLocation->second.second];
+    assert(sequenceLocation.second < chunk.m_sequences.size());
+    const auto& sequence = chunk.m_sequences[sequenceLocation.second];
 
-    result.m_chunkId = sequenceLocation->second.first;
-    result.m_indexInChunk = sequenceLocation->second.second;
+    result.m_chunkId = sequenceLocation.first;
+    result.m_indexInChunk = sequenceLocation.second;
     result.m_numberOfSamples = sequence.m_numberOfSamples;
     result.m_key = sequence.m_key;
     return true;
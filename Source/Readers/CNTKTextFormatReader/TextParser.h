@@ -5,7 +5,9 @@
 
 #pragma once
 
+#include <atomic>
 #include "DataDeserializerBase.h"
+#include "StreamingDataDeserializer.h"
 #include "Descriptors.h"
 #include "TextConfigHelper.h"
 #include "Indexer.h"
@@ -18,8 +20,10 @@ class CNTKTextFormatReaderTestRunner;
 
 // TODO: more details when tracing warnings
 // (e.g., buffer content around the char that triggered the warning)
+// In streaming mode (see TextConfigHelper::IsStreaming()) the input is not indexed, the parser
+// is then used through the IStreamingDataDeserializer interface only.
 template <class ElemType>
-class TextParser : public DataDeserializerBase {
+class TextParser : public DataDeserializerBase, public IStreamingDataDeserializer {
 public:
     TextParser(CorpusDescriptorPtr corpus, const TextConfigHelper& helper, bool pimary);
     ~TextParser();
@@ -35,6 +39,14 @@ public:
 
     bool GetSequenceDescriptionByKey(const KeyType&, SequenceDescription&) override;
 
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return DataDeserializerBase::GetStreamDescriptions();
+    }
+
+    // Reads the next whole sequences of the streamed input, up to the chunk size.
+    ChunkPtr GetNextChunk(std::vector<SequenceDescription>& result) override;
+
 private:
     TextParser(CorpusDescriptorPtr corpus, const std::wstring& filename, const vector<StreamDescriptor>& streams, bool primary = true);
 
@@ -82,6 +94,22 @@ private:
     // A chunk of input data in the text format.
     class TextDataChunk;
 
+    // The read position of one parsing thread. LoadChunk() reads the text of a whole chunk into memory,
+    // which is then parsed by several threads, each with its own cursor over a range of its sequences.
+    struct Cursor
+    {
+        Cursor(const char* bufferStart, const char* bufferEnd, size_t fileOffsetStart, size_t maxAliasLength)
+            : m_bufferStart(bufferStart), m_bufferEnd(bufferEnd), m_pos(bufferStart),
+              m_fileOffsetStart(fileOffsetStart), m_scratch(new char[maxAliasLength + 1])
+        {}
+
+        const char* m_bufferStart;
+        const char* m_bufferEnd;
+        const char* m_pos;         // buffer index
+        size_t m_fileOffsetStart;  // file offset of m_bufferStart
+        unique_ptr<char[]> m_scratch; // local buffer for string parsing
+    };
+
     typedef std::shared_ptr<TextDataChunk> TextChunkPtr;
 
     enum TraceLevel
@@ -104,28 +132,34 @@ private:
 
     std::unique_ptr<Indexer> m_indexer;
 
-    size_t m_fileOffsetStart;
-    size_t m_fileOffsetEnd;
-
-    // TODO: not DRY (same in the Indexer), needs refactoring
-    unique_ptr<char[]> m_buffer;
-    const char* m_bufferStart;
-    const char* m_bufferEnd;
-    const char* m_pos; // buffer index
-
-    unique_ptr<char[]> m_scratch; // local buffer for string parsing
-
     size_t m_chunkSizeBytes;
     unsigned int m_traceLevel;
-    bool m_hadWarnings;
-    unsigned int m_numAllowedErrors;
+    std::atomic<bool> m_hadWarnings;
+    std::atomic<unsigned int> m_numAllowedErrors; // shared by all parsing threads
+    unsigned int m_numParseThreads; // 0 to use as many as OpenMP does
     bool m_skipSequenceIds;
+    bool m_cacheIndex;
+    std::wstring m_indexCacheDirectory;
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
                                // file operation should be repeated (default value is 5).
 
     // Corpus descriptor.
     CorpusDescriptorPtr m_corpus;
 
+    // Totals over all chunks loaded so far, for the parse throughput trace.
+    size_t m_parsedBytes;
+    double m_parseSeconds;
+
+    // Streaming mode state: the input is read line by line, the first line of the sequence
+    // that did not fit into the previous chunk is kept for the next one.
+    bool m_streaming;
+    bool m_followInput;
+    std::string m_pendingLine;
+    bool m_hasPendingLine;
+    size_t m_streamOffset;     // offset of the next line in the input
+    ChunkIdType m_nextChunkId;
+    size_t m_nextSequenceKey;  // streamed sequences are numbered, sequence ids may repeat in unbounded input
+
     // throws runtime exception when number of parsing errors is
     // greater than the specified threshold
     void IncrementNumberOfErrorsOrDie();
@@ -134,52 +168,62 @@ private:
     // have been swallowed.
     void PrintWarningNotification();
 
-    void SetFileOffset(int64_t position);
-
-    void SkipToNextValue(size_t& bytesToRead);
-    void SkipToNextInput(size_t& bytesToRead);
-
-    bool TryRefillBuffer();
+    void SkipToNextValue(Cursor& cursor, size_t& bytesToRead);
+    void SkipToNextInput(Cursor& cursor, size_t& bytesToRead);
 
-    int64_t GetFileOffset() const { return m_fileOffsetStart + (m_pos - m_bufferStart); }
+    static int64_t GetFileOffset(const Cursor& cursor) { return cursor.m_fileOffsetStart + (cursor.m_pos - cursor.m_bufferStart); }
 
     // Returns a string containing input file information (current offset, file name, etc.),
     // which can be included as a part of the trace/log message.
-    std::wstring GetFileInfo();
+    std::wstring GetFileInfo(const Cursor& cursor);
 
     // Reads an alias/name and converts it to an internal stream id (= stream index).
-    bool TryGetInputId(size_t& id, size_t& bytesToRead);
+    bool TryGetInputId(Cursor& cursor, size_t& id, size_t& bytesToRead);
 
-    bool TryReadRealNumber(ElemType& value, size_t& bytesToRead);
+    bool TryReadRealNumber(Cursor& cursor, ElemType& value, size_t& bytesToRead);
 
-    bool TryReadUint64(size_t& value, size_t& bytesToRead);
+    // Fast path of TryReadRealNumber() for numbers in plain decimal notation.
+    // Returns false, without moving the cursor, for anything else.
+    static bool TryReadDecimalNumber(Cursor& cursor, ElemType& value, size_t& bytesToRead);
+
+    bool TryReadUint64(Cursor& cursor, size_t& value, size_t& bytesToRead);
 
     // Reads dense sample values into the provided vector.
-    bool TryReadDenseSample(std::vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
+    bool TryReadDenseSample(Cursor& cursor, std::vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
 
     // Reads sparse sample values and corresponding indices into the provided vectors.
-    bool TryReadSparseSample(std::vector<ElemType>& values, std::vector<IndexType>& indices,
+    bool TryReadSparseSample(Cursor& cursor, std::vector<ElemType>& values, std::vector<IndexType>& indices,
         size_t sampleSize, size_t& bytesToRead);
 
     // Reads one sample (an input identifier followed by a list of values)
-    bool TryReadSample(SequenceBuffer& sequence, size_t& bytesToRead);
+    bool TryReadSample(Cursor& cursor, SequenceBuffer& sequence, size_t& bytesToRead);
 
     // Reads one whole row (terminated by a row delimiter) of samples
-    bool TryReadRow(SequenceBuffer& sequence, size_t& bytesToRead);
+    bool TryReadRow(Cursor& cursor, SequenceBuffer& sequence, size_t& bytesToRead);
 
     // Returns true if there's still data available.
-    bool inline CanRead() { return m_pos != m_bufferEnd || TryRefillBuffer(); }
+    static bool inline CanRead(const Cursor& cursor) { return cursor.m_pos != cursor.m_bufferEnd; }
 
     // Returns true if the trace level is greater or equal to 'Warning'
     bool inline ShouldWarn() { m_hadWarnings = true; return m_traceLevel >= Warning; }
 
-    // Given a descriptor and the file offset of the containing chunk,
-    // retrieves the data for the corresponding sequence from the file.
-    SequenceBuffer LoadSequence(const SequenceDescriptor& descriptor, size_t chunkOffset);
+    // Given a descriptor and a cursor over the text of the containing chunk,
+    // parses the data for the corresponding sequence.
+    SequenceBuffer LoadSequence(Cursor& cursor, const SequenceDescriptor& descriptor);
 
-    // Given a descriptor, retrieves the data for the corresponding chunk from the file.
+    // Given a descriptor, retrieves the data for the corresponding chunk from the file,
+    // parsing its sequences on up to m_numParseThreads threads.
     void LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor);
 
+    // Parses the sequences of the chunk from its text on up to m_numParseThreads threads.
+    // Returns the number of threads used.
+    size_t ParseChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor, const char* text, size_t chunkBytes);
+
+    // Reads the next line of the streamed input including the row delimiter (which is added if the input
+    // ends without one). Waits for more input at the end when following the input.
+    // Returns false at the end of the input.
+    bool TryReadLine(std::string& line);
+
     // Fills some metadata members to be conformant to the exposed SequenceData interface.
     void FillSequenceMetadata(SequenceBuffer& sequenceBuffer, const KeyType& sequenceKey);
 
@@ -193,6 +237,12 @@ private:
 
     void SetNumRetries(unsigned int numRetries);
 
+    void SetIndexCache(bool cacheIndex, const std::wstring& cacheDirectory);
+
+    void SetNumParseThreads(unsigned int numThreads);
+
+    void SetStreaming(bool streaming, bool followInput);
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
     DISABLE_COPY_AND_MOVE(TextParser);
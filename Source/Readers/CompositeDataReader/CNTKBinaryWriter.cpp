@@ -0,0 +1,312 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include "CNTKBinaryWriter.h"
+#include "CompositeDataReader.h"
+#include "SequenceEnumerator.h"
+#include "ReaderUtil.h"
+#include "../CNTKBinaryReader/FileHelper.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// The layout of CBF files, as read by the BinaryChunkDeserializer.
+static const uint32_t s_cbfVersion = 2;
+
+enum class CBFMatrixEncoding : unsigned char
+{
+    dense = 0,
+    sparse_csc = 1
+};
+
+enum class CBFDataType : unsigned char
+{
+    tfloat = 0,
+    tdouble = 1
+};
+
+struct CBFChunkInfo
+{
+    int64_t offset;
+    uint32_t numSequences;
+    uint32_t numSamples;
+    uint64_t dataSize;    // without the sequence lengths
+    uint32_t compression; // always none
+    uint32_t reserved;
+};
+static_assert(sizeof(CBFChunkInfo) == 32, "The chunk table entries must match the file format.");
+static_assert(sizeof(IndexType) == sizeof(int32_t), "The CNTK binary format stores 32 bit sparse indices.");
+
+// Samples requested from the sequence enumerator at a time.
+static const size_t s_samplesPerRead = 4096;
+
+CNTKBinaryWriter::CNTKBinaryWriter(const ConfigParameters& config, const ConfigParameters& readerConfig)
+    : m_readerConfig(readerConfig), m_numberOfChunks(0), m_bufferedBytes(0)
+{
+    wstring outputFile = config(L"outputFile");
+    size_t numShards = config(L"numShards", (size_t)1);
+    m_chunkSizeInBytes = config(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024);
+    m_sortByLength = config(L"sortByLength", false);
+    m_sortWindowInChunks = config(L"sortWindowInChunks", (size_t)64);
+    m_traceLevel = config(L"traceLevel", 1);
+    if (numShards == 0 || m_chunkSizeInBytes == 0 || m_sortWindowInChunks == 0)
+        InvalidArgument("CNTKBinaryWriter: 'numShards', 'chunkSizeInBytes' and 'sortWindowInChunks' must be greater than zero.");
+
+    // Sequences in the order of the corpus, without truncation or frame mode (see CompositeDataReader).
+    m_readerConfig.Insert("action", "write");
+
+    m_shards.resize(numShards);
+    for (size_t i = 0; i < numShards; ++i)
+    {
+        m_shards[i].m_fileName = numShards == 1 ? outputFile : outputFile + L"." + to_wstring(i);
+        m_shards[i].m_file = nullptr;
+        m_shards[i].m_numberOfChunks = 0;
+    }
+}
+
+CNTKBinaryWriter::~CNTKBinaryWriter()
+{
+    // Only after an error: the files are incomplete.
+    for (auto& shard : m_shards)
+    {
+        if (shard.m_pendingWrite.valid())
+            shard.m_pendingWrite.wait();
+        if (shard.m_file)
+            fclose(shard.m_file);
+    }
+}
+
+size_t CNTKBinaryWriter::Write()
+{
+    CompositeDataReader reader(m_readerConfig);
+
+    m_streams = reader.GetStreamDescriptions();
+    map<wstring, int> inputs;
+    for (const auto& stream : m_streams)
+    {
+        if (stream->m_elementType != ElementType::tfloat && stream->m_elementType != ElementType::tdouble)
+            RuntimeError("CNTKBinaryWriter: the stream '%ls' is neither float nor double, which the CNTK binary format requires.", stream->m_name.c_str());
+        inputs[stream->m_name] = CPUDEVICE;
+    }
+
+    for (auto& shard : m_shards)
+    {
+        shard.m_file = CNTKBinaryFileHelper::OpenOrDie(shard.m_fileName, L"wb");
+        uint64_t magic = CNTKBinaryFileHelper::MAGIC_NUMBER;
+        CNTKBinaryFileHelper::WriteOrDie(&magic, sizeof(magic), 1, shard.m_file);
+        CNTKBinaryFileHelper::WriteOrDie(&s_cbfVersion, sizeof(s_cbfVersion), 1, shard.m_file);
+    }
+
+    // A single sweep over the data.
+    EpochConfiguration epoch;
+    epoch.m_numberOfWorkers = 1;
+    epoch.m_workerRank = 0;
+    epoch.m_minibatchSizeInSamples = s_samplesPerRead;
+    epoch.m_totalEpochSizeInSamples = requestDataSize;
+    epoch.m_totalEpochSizeInSweeps = 1;
+    epoch.m_epochIndex = 0;
+    reader.StartEpoch(epoch, inputs);
+
+    auto enumerator = reader.GetSequenceEnumerator();
+    size_t numSequences = 0, numSkipped = 0;
+    size_t window = m_chunkSizeInBytes * (m_sortByLength ? m_sortWindowInChunks : 1);
+    for (;;)
+    {
+        Sequences sequences = enumerator->GetNextSequences(s_samplesPerRead, s_samplesPerRead);
+        size_t count = sequences.m_data.empty() ? 0 : sequences.m_data.front().size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            bool isValid = true;
+            for (const auto& stream : sequences.m_data)
+                isValid = isValid && stream[i]->m_isValid;
+            if (!isValid)
+            {
+                numSkipped++;
+                continue;
+            }
+
+            m_buffer.emplace_back();
+            Serialize(sequences.m_data, i, m_buffer.back());
+            m_bufferedBytes += m_buffer.back().m_data.size() + sizeof(uint32_t);
+            numSequences++;
+        }
+
+        if (m_bufferedBytes >= window)
+            Flush(false);
+
+        if (sequences.m_endOfEpoch)
+            break;
+    }
+    Flush(true);
+
+    for (auto& shard : m_shards)
+        WriteHeader(shard);
+
+    if (m_traceLevel > 0)
+        fprintf(stderr, "CNTKBinaryWriter: wrote %d sequences in %d chunks to %d file(s)%s.\n",
+                (int)numSequences, (int)m_numberOfChunks, (int)m_shards.size(), m_sortByLength ? ", sorted by length" : "");
+    if (numSkipped > 0)
+        fprintf(stderr, "WARNING: CNTKBinaryWriter: skipped %d invalid sequences.\n", (int)numSkipped);
+
+    return numSequences;
+}
+
+void CNTKBinaryWriter::Serialize(const vector<vector<SequenceDataPtr>>& data, size_t index, SerializedSequence& result) const
+{
+    auto append = [&result](const void* source, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(source);
+        result.m_data.insert(result.m_data.end(), bytes, bytes + size);
+    };
+
+    result.m_numberOfSamples = 0;
+    result.m_streamOffsets.resize(m_streams.size() + 1);
+    for (size_t i = 0; i < m_streams.size(); ++i)
+    {
+        result.m_streamOffsets[i] = result.m_data.size();
+
+        const auto& stream = m_streams[i];
+        const auto& sequence = data[i][index];
+        size_t elementSize = GetSizeByType(stream->m_elementType);
+        uint32_t numSamples = sequence->m_numberOfSamples;
+        result.m_numberOfSamples = max(result.m_numberOfSamples, numSamples);
+
+        append(&numSamples, sizeof(numSamples));
+        if (stream->m_storageType == StorageType::dense)
+        {
+            append(sequence->GetDataBuffer(), numSamples * stream->m_sampleLayout->GetNumElements() * elementSize);
+            continue;
+        }
+
+        auto sparse = static_pointer_cast<SparseSequenceData>(sequence);
+        if (sparse->m_nnzCounts.size() != numSamples)
+            RuntimeError("CNTKBinaryWriter: a sequence of the sparse stream '%ls' has %d samples, but %d nnz counts.",
+                         stream->m_name.c_str(), (int)numSamples, (int)sparse->m_nnzCounts.size());
+
+        uint32_t nnz = static_cast<uint32_t>(sparse->m_totalNnzCount);
+        append(&nnz, sizeof(nnz));
+        append(sparse->GetDataBuffer(), nnz * elementSize);
+        append(sparse->m_indices, nnz * sizeof(IndexType));
+        append(sparse->m_nnzCounts.data(), numSamples * sizeof(IndexType));
+    }
+    result.m_streamOffsets.back() = result.m_data.size();
+}
+
+void CNTKBinaryWriter::Flush(bool final)
+{
+    if (m_sortByLength)
+        stable_sort(m_buffer.begin(), m_buffer.end(), [](const SerializedSequence& a, const SerializedSequence& b)
+        {
+            return a.m_numberOfSamples < b.m_numberOfSamples;
+        });
+
+    auto begin = m_buffer.begin();
+    size_t bytes = 0;
+    for (auto it = m_buffer.begin(); it != m_buffer.end(); ++it)
+    {
+        bytes += it->m_data.size() + sizeof(uint32_t);
+        if (bytes >= m_chunkSizeInBytes || (final && it + 1 == m_buffer.end()))
+        {
+            auto chunk = make_shared<vector<SerializedSequence>>(make_move_iterator(begin), make_move_iterator(it + 1));
+            WriteChunk(m_shards[m_numberOfChunks % m_shards.size()], chunk);
+            m_numberOfChunks++;
+            begin = it + 1;
+            bytes = 0;
+        }
+    }
+
+    // The rest does not fill a chunk yet.
+    m_buffer.erase(m_buffer.begin(), begin);
+    m_bufferedBytes = bytes;
+}
+
+void CNTKBinaryWriter::WriteChunk(Shard& shard, SequencesPtr sequences)
+{
+    // One chunk in flight per shard bounds the memory, and rethrows errors of the previous write.
+    if (shard.m_pendingWrite.valid())
+        shard.m_pendingWrite.get();
+
+    Shard* target = &shard;
+    size_t numStreams = m_streams.size();
+    shard.m_pendingWrite = async(launch::async, [target, sequences, numStreams]()
+    {
+        // The sequence lengths, then the sequences of each stream in turn.
+        vector<char> chunk;
+        uint32_t numSamples = 0;
+        for (const auto& sequence : *sequences)
+        {
+            const char* length = reinterpret_cast<const char*>(&sequence.m_numberOfSamples);
+            chunk.insert(chunk.end(), length, length + sizeof(uint32_t));
+            numSamples += sequence.m_numberOfSamples;
+        }
+        size_t lengthsSize = chunk.size();
+
+        for (size_t i = 0; i < numStreams; ++i)
+        {
+            for (const auto& sequence : *sequences)
+                chunk.insert(chunk.end(), sequence.m_data.begin() + sequence.m_streamOffsets[i], sequence.m_data.begin() + sequence.m_streamOffsets[i + 1]);
+        }
+
+        CBFChunkInfo info = {};
+        info.offset = CNTKBinaryFileHelper::TellOrDie(target->m_file);
+        info.numSequences = static_cast<uint32_t>(sequences->size());
+        info.numSamples = numSamples;
+        info.dataSize = chunk.size() - lengthsSize;
+        CNTKBinaryFileHelper::WriteOrDie(chunk.data(), 1, chunk.size(), target->m_file);
+
+        const char* entry = reinterpret_cast<const char*>(&info);
+        target->m_chunkTable.insert(target->m_chunkTable.end(), entry, entry + sizeof(info));
+        target->m_numberOfChunks++;
+    });
+}
+
+void CNTKBinaryWriter::WriteHeader(Shard& shard)
+{
+    if (shard.m_pendingWrite.valid())
+        shard.m_pendingWrite.get();
+
+    FILE* f = shard.m_file;
+    int64_t headerOffset = CNTKBinaryFileHelper::TellOrDie(f);
+    uint64_t magic = CNTKBinaryFileHelper::MAGIC_NUMBER;
+    uint32_t numInputs = static_cast<uint32_t>(m_streams.size());
+    CNTKBinaryFileHelper::WriteOrDie(&magic, sizeof(magic), 1, f);
+    CNTKBinaryFileHelper::WriteOrDie(&shard.m_numberOfChunks, sizeof(shard.m_numberOfChunks), 1, f);
+    CNTKBinaryFileHelper::WriteOrDie(&numInputs, sizeof(numInputs), 1, f);
+
+    for (const auto& stream : m_streams)
+    {
+        auto encoding = stream->m_storageType == StorageType::dense ? CBFMatrixEncoding::dense : CBFMatrixEncoding::sparse_csc;
+        string name = msra::strfun::utf8(stream->m_name);
+        uint32_t nameLength = static_cast<uint32_t>(name.size());
+        auto dataType = stream->m_elementType == ElementType::tfloat ? CBFDataType::tfloat : CBFDataType::tdouble;
+        uint32_t sampleDimension = static_cast<uint32_t>(stream->m_sampleLayout->GetNumElements());
+
+        CNTKBinaryFileHelper::WriteOrDie(&encoding, sizeof(encoding), 1, f);
+        CNTKBinaryFileHelper::WriteOrDie(&nameLength, sizeof(nameLength), 1, f);
+        CNTKBinaryFileHelper::WriteOrDie(name.data(), 1, name.size(), f);
+        CNTKBinaryFileHelper::WriteOrDie(&dataType, sizeof(dataType), 1, f);
+        CNTKBinaryFileHelper::WriteOrDie(&sampleDimension, sizeof(sampleDimension), 1, f);
+    }
+
+    CNTKBinaryFileHelper::WriteOrDie(shard.m_chunkTable.data(), 1, shard.m_chunkTable.size(), f);
+    CNTKBinaryFileHelper::WriteOrDie(&headerOffset, sizeof(headerOffset), 1, f);
+
+    shard.m_file = nullptr;
+    CNTKBinaryFileHelper::CloseOrDie(f);
+
+    if (m_traceLevel > 1)
+        fprintf(stderr, "CNTKBinaryWriter: wrote %d chunks to '%ls'.\n", (int)shard.m_numberOfChunks, shard.m_fileName.c_str());
+}
+
+}}}
@@ -0,0 +1,87 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <future>
+#include "Config.h"
+#include "DataDeserializer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Converts the data of any reader config with deserializers into the CNTK binary format (CBF) of the
+// CNTKBinaryReader, so that text or other slow to parse corpora are converted once instead of on every epoch.
+// One sweep is read in sequence mode without randomization, the sequences are serialized as they come and cut
+// into chunks of about chunkSizeInBytes. Options (see the "convertToCNTKBinary" command):
+//  - outputFile: the CBF file; with numShards > 1, chunk i goes to <outputFile>.<i % numShards>, each shard being
+//    a complete CBF file of its own (e.g. one per worker or disk). Every shard is written on its own thread.
+//  - sortByLength: sorts the sequences by length within a window of sortWindowInChunks chunks, so that chunks
+//    contain sequences of similar length for bucketing (the order of the corpus is not kept).
+// The streams keep their names, dimension and storage (dense or sparse); the element type is the precision of the
+// reader. Sequence keys are not stored, the CBF format has none.
+class CNTKBinaryWriter
+{
+public:
+    // config holds the options, the data is read with readerConfig.
+    CNTKBinaryWriter(const ConfigParameters& config, const ConfigParameters& readerConfig);
+
+    ~CNTKBinaryWriter();
+
+    // Converts the data, returns the number of sequences written.
+    size_t Write();
+
+private:
+    // A sequence serialized in the CBF layout of its streams.
+    struct SerializedSequence
+    {
+        uint32_t m_numberOfSamples;                // the maximum over the streams
+        std::vector<char> m_data;                  // the data of all streams
+        std::vector<size_t> m_streamOffsets;       // start of each stream in m_data, plus the end
+    };
+
+    // An output file with its chunk table. At most one chunk per shard is written at a time.
+    struct Shard
+    {
+        std::wstring m_fileName;
+        FILE* m_file;
+        std::vector<char> m_chunkTable;            // chunk table entries of version 2
+        uint32_t m_numberOfChunks;
+        std::future<void> m_pendingWrite;
+    };
+
+    typedef std::shared_ptr<std::vector<SerializedSequence>> SequencesPtr;
+
+    // Copies the data of a sequence, which is only valid as long as its chunk is loaded.
+    void Serialize(const std::vector<std::vector<SequenceDataPtr>>& data, size_t index, SerializedSequence& result) const;
+
+    // Cuts the buffered sequences into chunks and hands them to the shards; unless final, the sequences of the last
+    // incomplete chunk stay in the buffer.
+    void Flush(bool final);
+
+    // Writes a chunk asynchronously, after the previous chunk of the shard is written.
+    void WriteChunk(Shard& shard, SequencesPtr sequences);
+
+    // Writes the header and the chunk table at the end of the shard and closes it.
+    void WriteHeader(Shard& shard);
+
+    ConfigParameters m_readerConfig;
+    std::vector<StreamDescriptionPtr> m_streams;
+
+    std::vector<Shard> m_shards;
+    size_t m_numberOfChunks;
+
+    std::vector<SerializedSequence> m_buffer;
+    size_t m_bufferedBytes;                        // including the sequence lengths
+
+    size_t m_chunkSizeInBytes;
+    bool m_sortByLength;
+    size_t m_sortWindowInChunks;
+    int m_traceLevel;
+};
+
+}}}
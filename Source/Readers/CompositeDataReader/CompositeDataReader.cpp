@@ -15,6 +15,7 @@
 #include "Bundler.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
+#include "SequenceBucketer.h"
 #include "FramePacker.h"
 #include "SequencePacker.h"
 #include "TruncatedBpttPacker.h"
@@ -136,9 +137,21 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
             }
         }
 
+        // Number of chunks loaded ahead of the randomization window, each of them is held in memory till the window reaches it.
+        // Deeper prefetch hides the latency of slow (e.g. network) storage.
+        size_t chunkPrefetchDepth = config(L"chunkPrefetchDepth", (size_t)1);
+        if (chunkPrefetchDepth == 0)
+            InvalidArgument("'chunkPrefetchDepth' must be greater than zero.");
+
+        // In distributed training, each worker can own a stable shard of the chunks instead of a different subset
+        // in every sweep, so that its chunks stay in local caches; the shards move on every 'shardRebalanceSweeps' sweeps.
+        bool shardedCorpus = config(L"shardedCorpus", false);
+        size_t shardRebalanceSweeps = config(L"shardRebalanceSweeps", (size_t)0);
+
         bool shouldPrefetch = true;
         m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, shouldPrefetch, 
-            multiThreadedDeserialization, maxErrors, sampleBasedRandomizationWindow);
+            multiThreadedDeserialization, maxErrors, sampleBasedRandomizationWindow, chunkPrefetchDepth,
+            shardedCorpus, shardRebalanceSweeps);
     }
     else
     {
@@ -150,6 +163,15 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
         ? m_sequenceEnumerator
         : std::make_shared<TransformController>(m_transforms, m_sequenceEnumerator);
 
+    // Sequences of the next 'bucketingPoolSize' minibatches are grouped by length to reduce the padding of the minibatch layout.
+    size_t bucketingPoolSize = config(L"bucketingPoolSize", (size_t)0);
+    if (bucketingPoolSize > 0)
+    {
+        if (m_packingMode != PackingMode::sequence)
+            InvalidArgument("'bucketingPoolSize' is only supported for sequence packing (not in frame mode or with truncation).");
+        m_sequenceEnumerator = std::make_shared<SequenceBucketer>(m_sequenceEnumerator, bucketingPoolSize);
+    }
+
     // TODO: Creating output stream descriptions - this should come from the network so that we can check 
     // that input matches what the network expects (including tensor shape, etc.).
     for (const auto& streamDescription : m_sequenceEnumerator->GetStreamDescriptions())
@@ -164,9 +186,8 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
         m_streams.push_back(stream);
     }
 
-    // Currently for prefetch we use two alternating buffers,
-    // same is the default.
-    size_t numAlternatingBuffers = 2;
+    // One alternating buffer per minibatch prefetched by the ReaderShim, at least two.
+    size_t numAlternatingBuffers = GetNumberOfPackerBuffers(config);
 
     // Check whether to use local timeline, by default we use it for better performance.
     bool localTimeline = config(L"localTimeline", true);
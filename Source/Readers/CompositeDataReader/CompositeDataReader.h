@@ -63,6 +63,12 @@ public:
     // Starts a new epoch with the provided configuration
     void StartEpoch(const EpochConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
 
+    // The sequences of the current epoch, for consumers that do not need minibatches, e.g. the CNTKBinaryWriter.
+    SequenceEnumeratorPtr GetSequenceEnumerator() const
+    {
+        return m_sequenceEnumerator;
+    }
+
 private:
     void CreateDeserializers(const ConfigParameters& readerConfig);
     void CreateTransforms(const ConfigParameters& deserializerConfig);
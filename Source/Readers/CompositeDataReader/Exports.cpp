@@ -11,6 +11,7 @@
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
 #include "CompositeDataReader.h"
+#include "CNTKBinaryWriter.h"
 #include "ReaderShim.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -49,4 +50,11 @@ extern "C" DATAREADER_API Reader* CreateCompositeDataReader(const ConfigParamete
     return new CompositeDataReader(*parameters);
 }
 
+// Converts the data of the reader config into CNTK binary format files, see CNTKBinaryWriter.
+extern "C" DATAREADER_API size_t ConvertToCNTKBinary(const ConfigParameters* config, const ConfigParameters* readerConfig)
+{
+    CNTKBinaryWriter writer(*config, *readerConfig);
+    return writer.Write();
+}
+
 }}}
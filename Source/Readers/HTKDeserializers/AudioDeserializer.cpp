@@ -0,0 +1,367 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <limits>
+#include <algorithm>
+#include "AudioDeserializer.h"
+#include "ExceptionCapture.h"
+#include "StringUtil.h"
+#include "File.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Frames of an utterance, each holding the waveform samples of its analysis window.
+template <class ElemType>
+struct AudioSequenceData : DenseSequenceData
+{
+    vector<ElemType> m_samples;
+
+    const void* GetDataBuffer() override
+    {
+        return m_samples.data();
+    }
+};
+
+// Waveforms of a chunk, read on construction. Frames are cut on request.
+// The lifetime is always less than the lifetime of the parent deserializer.
+class AudioDeserializer::AudioChunk : public Chunk
+{
+    const AudioDeserializer& m_parent;
+    const ChunkDescriptor& m_descriptor;
+    vector<int16_t> m_samples; // first channel of all utterances
+
+public:
+    AudioChunk(const AudioDeserializer& parent, const ChunkDescriptor& descriptor)
+        : m_parent(parent), m_descriptor(descriptor)
+    {
+        const auto& utterances = descriptor.m_utterances;
+        m_samples.resize(descriptor.m_totalSamples);
+
+        ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic) num_threads(max(1, min(parent.m_numParallelReads, (int)utterances.size())))
+        for (int i = 0; i < (int)utterances.size(); ++i)
+            capture.SafeRun([this, &utterances](size_t i)
+            {
+                const auto& utterance = utterances[i];
+                vector<int16_t> buffer(utterance.m_numberOfSamples * utterance.m_numberOfChannels);
+                auto f = fopenOrDie(utterance.m_path, L"rbS");
+                fsetpos(f, utterance.m_dataOffset);
+                freadOrDie(buffer.data(), sizeof(int16_t), buffer.size(), f);
+                fclose(f);
+
+                int16_t* target = &m_samples[m_descriptor.m_startSamples[i]];
+                for (size_t n = 0; n < utterance.m_numberOfSamples; ++n)
+                    target[n] = buffer[n * utterance.m_numberOfChannels];
+            }, (size_t)i);
+        capture.RethrowIfHappened();
+
+        if (parent.m_verbosity)
+            fprintf(stderr, "AudioDeserializer: read chunk (%zu utterances, %zu frames)\n", utterances.size(), descriptor.m_totalFrames);
+    }
+
+    void GetSequence(size_t sequenceIndex, vector<SequenceDataPtr>& result) override
+    {
+        // In frame mode the index is the frame in the chunk.
+        size_t utteranceIndex = sequenceIndex, firstFrame = 0;
+        if (m_parent.m_frameMode)
+        {
+            const auto& startFrames = m_descriptor.m_startFrames;
+            utteranceIndex = upper_bound(startFrames.begin(), startFrames.end(), sequenceIndex) - startFrames.begin() - 1;
+            firstFrame = sequenceIndex - startFrames[utteranceIndex];
+        }
+
+        const auto& utterance = m_descriptor.m_utterances[utteranceIndex];
+        size_t numberOfFrames = m_parent.m_frameMode ? 1 : utterance.m_numberOfFrames;
+        const int16_t* samples = &m_samples[m_descriptor.m_startSamples[utteranceIndex]];
+
+        SequenceDataPtr sequence;
+        if (m_parent.m_elementType == ElementType::tfloat)
+            sequence = CutFrames<float>(samples, firstFrame, numberOfFrames);
+        else
+            sequence = CutFrames<double>(samples, firstFrame, numberOfFrames);
+
+        sequence->m_key.m_sequence = utterance.m_key;
+        sequence->m_key.m_sample = (uint32_t)firstFrame;
+        result.push_back(sequence);
+    }
+
+private:
+    template <class ElemType>
+    SequenceDataPtr CutFrames(const int16_t* samples, size_t firstFrame, size_t numberOfFrames) const
+    {
+        const size_t windowLength = m_parent.m_windowLength;
+        auto sequence = make_shared<AudioSequenceData<ElemType>>();
+        sequence->m_samples.resize(numberOfFrames * windowLength);
+        sequence->m_numberOfSamples = (uint32_t)numberOfFrames;
+        for (size_t t = 0; t < numberOfFrames; ++t)
+        {
+            const int16_t* window = samples + (firstFrame + t) * m_parent.m_frameShift;
+            copy(window, window + windowLength, &sequence->m_samples[t * windowLength]);
+        }
+        return sequence;
+    }
+};
+
+// Expects a single stream in the input section of the config, see AudioDeserializer.h.
+AudioDeserializer::AudioDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
+    : DataDeserializerBase(primary),
+      m_corpus(corpus)
+{
+    m_frameMode = (ConfigValue)cfg("frameMode", "true");
+    m_verbosity = cfg(L"verbosity", 0);
+    m_numParallelReads = cfg(L"numParallelReads", 8);
+
+    wstring precision = cfg(L"precision", L"float");
+    m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
+
+    ConfigParameters input = cfg(L"input");
+    auto inputName = input.GetMemberIds().front();
+    ConfigParameters streamConfig = input(inputName);
+
+    m_sampleRate = streamConfig(L"sampleRate", 16000);
+    m_windowLength = m_sampleRate * (size_t)streamConfig(L"windowLengthMs", 25) / 1000;
+    m_frameShift = m_sampleRate * (size_t)streamConfig(L"frameShiftMs", 10) / 1000;
+    if (m_windowLength == 0 || m_frameShift == 0)
+        InvalidArgument("AudioDeserializer: windowLengthMs and frameShiftMs must amount to at least one sample.");
+
+    // Lines are 'key=path' or 'key path'.
+    vector<pair<string, wstring>> paths;
+    wstring scriptPath = streamConfig(L"scpFile");
+    for (auto& line : msra::files::fgetfilelines(scriptPath))
+    {
+        Trim(line);
+        if (line.empty())
+            continue;
+
+        auto separator = line.find('=');
+        if (separator == string::npos)
+            separator = line.find_first_of(" \t");
+        if (separator == string::npos)
+            RuntimeError("Invalid line '%s' in script file '%ls', expected 'key=path'.", line.c_str(), scriptPath.c_str());
+
+        string path = line.substr(separator + 1);
+        Trim(path);
+        paths.push_back(make_pair(line.substr(0, separator), msra::strfun::utf16(path)));
+    }
+
+    InitializeChunkDescriptions(corpus, paths);
+    InitializeStream(inputName);
+}
+
+void AudioDeserializer::ReadWaveHeader(Utterance& utterance) const
+{
+    auto f = fopenOrDie(utterance.m_path, L"rbS");
+    char riff[12];
+    freadOrDie(riff, 1, sizeof(riff), f);
+    if (memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+        RuntimeError("'%ls' is not a RIFF WAV file.", utterance.m_path.c_str());
+
+    // Go through the chunks of the file up to the samples.
+    uint16_t format = 0, bitsPerSample = 0;
+    uint32_t sampleRate = 0, dataSize;
+    for (;;)
+    {
+        char chunkId[4];
+        uint32_t chunkSize;
+        freadOrDie(chunkId, 1, sizeof(chunkId), f);
+        freadOrDie(&chunkSize, sizeof(chunkSize), 1, f);
+        if (memcmp(chunkId, "fmt ", 4) == 0)
+        {
+            vector<char> fmt(max(chunkSize, 16u));
+            freadOrDie(fmt.data(), 1, chunkSize, f);
+            memcpy(&format, &fmt[0], sizeof(format));
+            uint16_t channels;
+            memcpy(&channels, &fmt[2], sizeof(channels));
+            memcpy(&sampleRate, &fmt[4], sizeof(sampleRate));
+            memcpy(&bitsPerSample, &fmt[14], sizeof(bitsPerSample));
+            utterance.m_numberOfChannels = channels;
+            if (chunkSize & 1)
+                fgetc(f);
+        }
+        else if (memcmp(chunkId, "data", 4) == 0)
+        {
+            dataSize = chunkSize;
+            break;
+        }
+        else
+            fsetpos(f, fgetpos(f) + chunkSize + (chunkSize & 1));
+    }
+
+    // 0xFFFE is WAVE_FORMAT_EXTENSIBLE, which we accept for 16-bit PCM.
+    if ((format != 1 && format != 0xFFFE) || bitsPerSample != 16 || utterance.m_numberOfChannels == 0)
+        RuntimeError("'%ls' does not hold 16-bit PCM samples.", utterance.m_path.c_str());
+    if (sampleRate != m_sampleRate)
+        RuntimeError("'%ls' has the sample rate %u, expected sampleRate %zu.", utterance.m_path.c_str(), sampleRate, m_sampleRate);
+
+    // Streaming writers leave the size of the data open.
+    utterance.m_dataOffset = fgetpos(f);
+    uint64_t available = (uint64_t)filesize(f) - utterance.m_dataOffset;
+    if (dataSize == 0 || dataSize == numeric_limits<uint32_t>::max() || dataSize > available)
+        dataSize = (uint32_t)available;
+    fclose(f);
+
+    utterance.m_numberOfSamples = dataSize / (sizeof(int16_t) * utterance.m_numberOfChannels);
+    utterance.m_numberOfFrames = utterance.m_numberOfSamples < m_windowLength ? 0 :
+        (uint32_t)((utterance.m_numberOfSamples - m_windowLength) / m_frameShift + 1);
+}
+
+void AudioDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const vector<pair<string, wstring>>& paths)
+{
+    // Read the formats of the files in parallel.
+    vector<Utterance> utterances;
+    for (const auto& keyAndPath : paths)
+    {
+        if (!corpus->IsIncluded(keyAndPath.first))
+            continue;
+
+        Utterance utterance = {};
+        utterance.m_key = corpus->KeyToId(keyAndPath.first);
+        utterance.m_path = keyAndPath.second;
+        utterances.push_back(utterance);
+    }
+
+    ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic) num_threads(max(1, m_numParallelReads))
+    for (int i = 0; i < (int)utterances.size(); ++i)
+        capture.SafeRun([this, &utterances](size_t i) { ReadWaveHeader(utterances[i]); }, (size_t)i);
+    capture.RethrowIfHappened();
+
+    // Chunks are consecutive utterances of about 15 minutes like the chunks of the HTK deserializer.
+    const size_t ChunkFrames = 15 * 60 * m_sampleRate / m_frameShift;
+
+    auto emptyPair = make_pair(numeric_limits<ChunkIdType>::max(), numeric_limits<uint32_t>::max());
+    size_t totalNumSequences = 0, totalNumFrames = 0, numSkipped = 0;
+    for (const auto& utterance : utterances)
+    {
+        if (utterance.m_numberOfFrames == 0 || utterance.m_numberOfFrames > SEQUENCELEN_MAX)
+        {
+            fprintf(stderr, "WARNING: Skipping the waveform '%ls' of %zu samples.\n", utterance.m_path.c_str(), utterance.m_numberOfSamples);
+            numSkipped++;
+            continue;
+        }
+
+        if (m_chunks.empty() || m_chunks.back().m_totalFrames > ChunkFrames)
+        {
+            m_chunks.push_back(ChunkDescriptor{ {}, {}, {}, 0, 0 });
+            if (m_chunks.size() >= numeric_limits<ChunkIdType>::max())
+                RuntimeError("Number of chunks exceeded overflow limit.");
+        }
+
+        auto& chunk = m_chunks.back();
+        if (m_keyToSequence.size() <= utterance.m_key)
+            m_keyToSequence.resize(utterance.m_key + 1, emptyPair);
+
+        if (m_keyToSequence[utterance.m_key] != emptyPair)
+            RuntimeError("Duplicate utterance '%s' in the script file.", corpus->IdToKey(utterance.m_key).c_str());
+
+        m_keyToSequence[utterance.m_key] = make_pair(static_cast<ChunkIdType>(m_chunks.size() - 1), static_cast<uint32_t>(chunk.m_utterances.size()));
+        chunk.m_utterances.push_back(utterance);
+        chunk.m_startFrames.push_back(chunk.m_totalFrames);
+        chunk.m_startSamples.push_back(chunk.m_totalSamples);
+        chunk.m_totalFrames += utterance.m_numberOfFrames;
+        chunk.m_totalSamples += utterance.m_numberOfSamples;
+        totalNumSequences++;
+        totalNumFrames += utterance.m_numberOfFrames;
+    }
+
+    fprintf(stderr, "AudioDeserializer: '%zu' utterances with '%zu' frames in '%zu' chunks, '%zu' skipped\n",
+        totalNumSequences, totalNumFrames, m_chunks.size(), numSkipped);
+}
+
+void AudioDeserializer::InitializeStream(const wstring& name)
+{
+    // Initializing stream description - a single stream of analysis windows.
+    StreamDescriptionPtr stream = make_shared<StreamDescription>();
+    stream->m_id = 0;
+    stream->m_name = name;
+    stream->m_sampleLayout = make_shared<TensorShape>(m_windowLength);
+    stream->m_storageType = StorageType::dense;
+    stream->m_elementType = m_elementType;
+    m_streams.push_back(stream);
+}
+
+ChunkDescriptions AudioDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions chunks;
+    chunks.reserve(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = static_cast<ChunkIdType>(i);
+        cd->m_numberOfSamples = m_chunks[i].m_totalFrames;
+        cd->m_numberOfSequences = m_frameMode ? m_chunks[i].m_totalFrames : m_chunks[i].m_utterances.size();
+        chunks.push_back(cd);
+    }
+    return chunks;
+}
+
+void AudioDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_chunks[chunkId];
+    result.reserve(m_frameMode ? chunk.m_totalFrames : chunk.m_utterances.size());
+    uint32_t offsetInChunk = 0;
+    for (const auto& utterance : chunk.m_utterances)
+    {
+        // In frame mode each frame is a sequence.
+        size_t numberOfSequences = m_frameMode ? utterance.m_numberOfFrames : 1;
+        for (size_t k = 0; k < numberOfSequences; ++k)
+        {
+            SequenceDescription f;
+            f.m_chunkId = chunkId;
+            f.m_key.m_sequence = utterance.m_key;
+            f.m_key.m_sample = (uint32_t)k;
+            f.m_indexInChunk = offsetInChunk++;
+            f.m_numberOfSamples = m_frameMode ? 1 : utterance.m_numberOfFrames;
+            result.push_back(f);
+        }
+    }
+}
+
+ChunkPtr AudioDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    ChunkPtr result;
+    attempt(5, [this, &result, chunkId]()
+    {
+        result = make_shared<AudioChunk>(*this, m_chunks[chunkId]);
+    });
+
+    return result;
+}
+
+bool AudioDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    if (key.m_sequence >= m_keyToSequence.size())
+        return false;
+
+    auto chunkAndUtteranceIndex = m_keyToSequence[key.m_sequence];
+    if (chunkAndUtteranceIndex.first == numeric_limits<ChunkIdType>::max())
+        return false;
+
+    const auto& chunk = m_chunks[chunkAndUtteranceIndex.first];
+    const auto& utterance = chunk.m_utterances[chunkAndUtteranceIndex.second];
+    result.m_chunkId = chunkAndUtteranceIndex.first;
+    result.m_key = key;
+    if (m_frameMode)
+    {
+        // Check that the sequences are equal in number of frames.
+        if (key.m_sample >= utterance.m_numberOfFrames)
+            RuntimeError("Sequence with key '%s' has '%u' frame(s), whereas the primary sequence expects at least '%u' frames",
+                m_corpus->IdToKey(key.m_sequence).c_str(), utterance.m_numberOfFrames, (unsigned)key.m_sample + 1);
+
+        result.m_indexInChunk = chunk.m_startFrames[chunkAndUtteranceIndex.second] + key.m_sample;
+        result.m_numberOfSamples = 1;
+    }
+    else
+    {
+        result.m_indexInChunk = chunkAndUtteranceIndex.second;
+        result.m_numberOfSamples = utterance.m_numberOfFrames;
+    }
+    return true;
+}
+
+}}}
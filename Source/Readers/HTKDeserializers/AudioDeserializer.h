@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Class represents a deserializer of waveforms (RIFF WAV files with 16-bit PCM samples), for the feature
+// extraction on the fly by the transforms of this module (see SpeechTransformers.h).
+// The waveforms are given by a script file, with lines 'key=path' like the HTK deserializer or 'key path' like Kaldi.
+// Each frame is exposed as a sample of the dense stream, holding the waveform samples of the analysis window
+// (windowLengthMs, shifted by frameShiftMs), so that the frames align with the frames of HTK features and labels.
+// Multi-channel files are read from their first channel.
+// E.g. input = [ features = [ scpFile = "wav.scp" ; sampleRate = 16000
+//                             transforms = ( [ type = "LogMelFilterbank" ; numFilters = 40 ] ) ] ]
+class AudioDeserializer : public DataDeserializerBase, boost::noncopyable
+{
+public:
+    AudioDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Retrieves sequence description by its key. Used for deserializers that are not in "primary"/"driving" mode.
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& s) override;
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& s) override;
+
+    // Retrieves a chunk with data.
+    virtual ChunkPtr GetChunk(ChunkIdType) override;
+
+private:
+    class AudioChunk;
+
+    // Location of the waveform of an utterance.
+    struct Utterance
+    {
+        size_t m_key;
+        std::wstring m_path;
+        uint64_t m_dataOffset;  // position of the samples in the file
+        size_t m_numberOfSamples;
+        uint32_t m_numberOfChannels;
+        uint32_t m_numberOfFrames;
+    };
+
+    // Utterances of a chunk.
+    struct ChunkDescriptor
+    {
+        std::vector<Utterance> m_utterances;
+        std::vector<size_t> m_startFrames;  // index of the first frame of each utterance in the chunk
+        std::vector<size_t> m_startSamples; // index of the first waveform sample of each utterance in the chunk
+        size_t m_totalFrames;
+        size_t m_totalSamples;
+    };
+
+    // Reads the format of a WAV file and sets the location and size of its samples.
+    void ReadWaveHeader(Utterance& utterance) const;
+
+    // Initializes chunk descriptions.
+    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const std::vector<std::pair<std::string, std::wstring>>& paths);
+
+    // Initializes a single stream this deserializer exposes.
+    void InitializeStream(const std::wstring& name);
+
+    CorpusDescriptorPtr m_corpus;
+
+    size_t m_sampleRate;
+    size_t m_windowLength; // in waveform samples
+    size_t m_frameShift;   // in waveform samples
+
+    ElementType m_elementType;
+
+    // Flag that indicates whether a single speech frames should be exposed as a sequence.
+    bool m_frameMode;
+
+    // Number of files a chunk reads in parallel.
+    int m_numParallelReads;
+    int m_verbosity;
+
+    std::vector<ChunkDescriptor> m_chunks;
+
+    // Vector that maps KeyType.m_sequence into a chunk and the index of the utterance in it (or type max() if the key is not assigned).
+    std::vector<std::pair<ChunkIdType, uint32_t>> m_keyToSequence;
+};
+
+}}}
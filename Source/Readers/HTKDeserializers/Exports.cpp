@@ -16,6 +16,10 @@
 #include "HeapMemoryProvider.h"
 #include "HTKDeserializer.h"
 #include "MLFDeserializer.h"
+#include "LatticeDeserializer.h"
+#include "KaldiDeserializer.h"
+#include "AudioDeserializer.h"
+#include "SpeechTransformers.h"
 #include "StringUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -62,6 +66,18 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
     {
         *deserializer = new MLFDeserializer(corpus, deserializerConfig, primary);
     }
+    else if (type == L"LatticeDeserializer")
+    {
+        *deserializer = new LatticeDeserializer(corpus, deserializerConfig, primary);
+    }
+    else if (type == L"KaldiDeserializer")
+    {
+        *deserializer = new KaldiDeserializer(corpus, deserializerConfig, primary);
+    }
+    else if (type == L"AudioDeserializer")
+    {
+        *deserializer = new AudioDeserializer(corpus, deserializerConfig, primary);
+    }
     else
     {
         // Unknown type.
@@ -72,4 +88,18 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
     return true;
 }
 
+extern "C" DATAREADER_API bool CreateTransformer(Transformer** transformer, const std::wstring& type, const ConfigParameters& config)
+{
+    if (type == L"LogMelFilterbank")
+        *transformer = new LogMelFilterbankTransformer(config);
+    else if (type == L"Cast")
+        *transformer = new NoCastTransformer(config);
+    else
+        // Unknown type.
+        return false;
+
+    // Transformer created.
+    return true;
+}
+
 }}}
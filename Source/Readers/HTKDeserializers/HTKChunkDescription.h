@@ -118,7 +118,9 @@ public:
     // Pages-in the data for this chunk.
     // this function supports retrying since we read from the unreliable network, i.e. do not return in a broken state
     // We pass in the feature info variables to check that that data being read has expected properties.
-    void RequireData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, int verbosity = 0) const
+    // Utterances of different physical files are read concurrently by up to numParallelReads threads,
+    // utterances of the same archive file are read sequentially by the same thread.
+    void RequireData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, int verbosity = 0, int numParallelReads = 1) const
     {
         if (GetNumberOfUtterances() == 0)
         {
@@ -132,18 +134,45 @@ public:
 
         try
         {
-            // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
-            // if this is the first feature read ever, we explicitly open the first file to get the information such as feature dimension
-            msra::asr::htkfeatreader reader;
+            // group consecutive utterances of the same physical file
+            std::vector<size_t> groupBegins;
+            foreach_index(i, m_utterances)
+            {
+                if (i == 0 || m_utterances[i].GetPath().archivePathIdx != m_utterances[i - 1].GetPath().archivePathIdx)
+                    groupBegins.push_back(i);
+            }
+            groupBegins.push_back(m_utterances.size());
 
             // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
             m_frames.resize(featureDimension, m_totalFrames);
-            foreach_index(i, m_utterances)
+            std::exception_ptr error;
+#pragma omp parallel num_threads(std::max(1, std::min(numParallelReads, (int)groupBegins.size() - 1)))
             {
-                // read features for this file
-                auto framesWrapper = GetUtteranceFrames(i);
-                reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, framesWrapper);
+                // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
+                msra::asr::htkfeatreader reader;
+
+#pragma omp for schedule(dynamic)
+                for (int group = 0; group < (int)groupBegins.size() - 1; group++)
+                {
+                    try
+                    {
+                        for (size_t i = groupBegins[group]; i < groupBegins[group + 1]; i++)
+                        {
+                            // read features for this file
+                            auto framesWrapper = GetUtteranceFrames(i);
+                            reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, framesWrapper);
+                        }
+                    }
+                    catch (...)
+                    {
+#pragma omp critical
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                }
             }
+            if (error)
+                std::rethrow_exception(error);
 
             if (verbosity)
             {
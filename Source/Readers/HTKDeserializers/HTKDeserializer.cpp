@@ -34,6 +34,7 @@ HTKDeserializer::HTKDeserializer(
     m_frameMode = (ConfigValue)cfg("frameMode", "true");
 
     m_verbosity = cfg(L"verbosity", 0);
+    m_numParallelReads = cfg(L"numParallelReads", 8);
 
     ConfigParameters input = cfg(L"input");
     auto inputName = input.GetMemberIds().front();
@@ -77,6 +78,7 @@ HTKDeserializer::HTKDeserializer(
     config.CheckFeatureType();
 
     m_verbosity = feature(L"verbosity", 0);
+    m_numParallelReads = feature(L"numParallelReads", 8);
 
     auto context = config.GetContextWindow();
     m_elementType = config.GetElementType();
@@ -312,9 +314,27 @@ private:
 };
 
 
+// A single frame of a chunk in frame mode, pointing into the frames of the chunk.
+struct HTKFrameSequenceData : DenseSequenceData
+{
+    HTKFrameSequenceData(const float* frame, size_t utteranceId) : m_frame(frame)
+    {
+        m_numberOfSamples = 1;
+        m_key.m_sequence = utteranceId;
+    }
+
+    const void* GetDataBuffer() override
+    {
+        return m_frame;
+    }
+
+private:
+    const float* m_frame;
+};
+
 // Represents a chunk data in memory. Given up to the randomizer.
 // It is up to the randomizer to decide when to release a particular chunk.
-class HTKDeserializer::HTKChunk : public Chunk, boost::noncopyable
+class HTKDeserializer::HTKChunk : public Chunk, public std::enable_shared_from_this<HTKDeserializer::HTKChunk>, boost::noncopyable
 {
 public:
     HTKChunk(HTKDeserializer* parent, ChunkIdType chunkId) : m_parent(parent), m_chunkId(chunkId)
@@ -325,13 +345,35 @@ public:
         // making several attempts
         msra::util::attempt(5, [&]()
         {
-            chunkDescription.RequireData(m_parent->m_featureKind, m_parent->m_ioFeatureDimension, m_parent->m_samplePeriod, m_parent->m_verbosity);
+            chunkDescription.RequireData(m_parent->m_featureKind, m_parent->m_ioFeatureDimension, m_parent->m_samplePeriod, m_parent->m_verbosity, m_parent->m_numParallelReads);
         });
+
+        // In frame mode without augmentation, the sequences of all frames are created once and refer to the frames in place,
+        // so that GetSequence() neither allocates nor copies.
+        if (m_parent->m_frameMode && !m_parent->m_expandToPrimary && m_parent->m_elementType == ElementType::tfloat &&
+            m_parent->m_augmentationWindow.first == 0 && m_parent->m_augmentationWindow.second == 0)
+        {
+            m_frames.reserve(chunkDescription.GetTotalFrames());
+            for (size_t i = 0; i < chunkDescription.GetNumberOfUtterances(); ++i)
+            {
+                auto utteranceFrames = chunkDescription.GetUtteranceFrames(i);
+                size_t utteranceId = chunkDescription.GetUtterance(i)->GetId();
+                for (size_t t = 0; t < utteranceFrames.cols(); ++t)
+                    m_frames.emplace_back(&utteranceFrames(0, t), utteranceId);
+            }
+        }
     }
 
     // Gets data for the sequence.
     virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
     {
+        if (!m_frames.empty())
+        {
+            // The sequence shares the ownership of the chunk.
+            result.push_back(SequenceDataPtr(shared_from_this(), &m_frames[sequenceId]));
+            return;
+        }
+
         m_parent->GetSequenceById(m_chunkId, sequenceId, result);
     }
 
@@ -345,6 +387,9 @@ public:
 private:
     HTKDeserializer* m_parent;
     ChunkIdType m_chunkId;
+
+    // Sequences of all frames in frame mode, if they do not need augmentation.
+    vector<HTKFrameSequenceData> m_frames;
 };
 
 // Gets a data chunk with the specified chunk id.
@@ -67,6 +67,9 @@ private:
     // General configuration
     int m_verbosity;
 
+    // Maximum number of threads reading the files of a chunk concurrently.
+    int m_numParallelReads;
+
     // Total number of frames.
     size_t m_totalNumberOfFrames = 0;
 
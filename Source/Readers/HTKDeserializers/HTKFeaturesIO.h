@@ -81,6 +81,15 @@ protected:
         const unsigned char* b = (const unsigned char*) &v;
         return (int) (((((b[0] << 8) + b[1]) << 8) + b[2]) << 8) + b[3];
     }
+    // written with shifts on the bit pattern, so that loops over it are vectorized by the compiler
+    static float swapfloat(float v) noexcept
+    {
+        uint32_t u;
+        memcpy(&u, &v, sizeof(u));
+        u = (u >> 24) | ((u >> 8) & 0xff00) | ((u << 8) & 0xff0000) | (u << 24);
+        memcpy(&v, &u, sizeof(v));
+        return v;
+    }
 
     struct fileheader
     {
@@ -175,6 +184,7 @@ class htkfeatreader : protected htkfeatio
     vector<float> a, b;                  // for decompression
     vector<short> tmp;                   // for decompression
     vector<unsigned char> tmpByteVector; // for decompression of idx files
+    vector<float> tmpFrames;             // for reading uncompressed frames in one go
     size_t curframe;                     // current # samples read so far
     size_t numframes;                    // number of samples for current logical file
     size_t energyElements;               // how many energy elements to add if addEnergy is true
@@ -510,6 +520,28 @@ public:
     template <class MATRIX>
     void read(MATRIX& feat, size_t ts, size_t te)
     {
+        // uncompressed frames without energy: read all with a single fread() and byte-swap them while copying into the target
+        if (!compressed && !isidxformat && !addEnergy)
+        {
+            if (curframe + (te - ts) > numframes)
+                RuntimeError("htkfeatreader:attempted to read beyond end");
+            tmpFrames.resize((te - ts) * featdim);
+            if (!tmpFrames.empty())
+                freadOrDie(tmpFrames.data(), sizeof(float), tmpFrames.size(), f);
+            for (size_t t = ts; t < te; t++)
+            {
+                const float* v = &tmpFrames[(t - ts) * featdim];
+                if (needbyteswapping)
+                    for (size_t k = 0; k < featdim; k++)
+                        feat(k, t) = swapfloat(v[k]);
+                else
+                    for (size_t k = 0; k < featdim; k++)
+                        feat(k, t) = v[k];
+            }
+            curframe += te - ts;
+            return;
+        }
+
         // read vectors from file and push to our target structure
         vector<float> v(featdim + energyElements);
         for (size_t t = ts; t < te; t++)
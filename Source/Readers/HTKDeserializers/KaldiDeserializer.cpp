@@ -0,0 +1,559 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include "KaldiDeserializer.h"
+#include "ReaderUtil.h"
+#include "SequenceData.h"
+#include "StringUtil.h"
+#include "File.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Frames of an utterance, or a single frame, pointing into the data of a chunk.
+struct KaldiDenseSequenceData : DenseSequenceData
+{
+    const void* m_buffer;
+
+    const void* GetDataBuffer() override
+    {
+        return m_buffer;
+    }
+};
+
+// Labels of an utterance, pointing into the labels of a chunk and the values of the deserializer.
+struct KaldiSparseSequenceData : SparseSequenceData
+{
+    const void* m_values;
+
+    const void* GetDataBuffer() override
+    {
+        return m_values;
+    }
+};
+
+// Runs body(group) for all groups on up to numThreads threads, rethrows the first error.
+template <class F>
+static void ParallelForEachGroup(int numThreads, size_t numGroups, const F& body)
+{
+    exception_ptr error;
+#pragma omp parallel for schedule(dynamic) num_threads(max(1, min(numThreads, (int)numGroups)))
+    for (int group = 0; group < (int)numGroups; group++)
+    {
+        try
+        {
+            body((size_t)group);
+        }
+        catch (...)
+        {
+#pragma omp critical
+            if (!error)
+                error = current_exception();
+        }
+    }
+    if (error)
+        rethrow_exception(error);
+}
+
+// Reads a Kaldi token, terminated by a space. Returns an empty string at the end of the file.
+static string ReadKaldiToken(FILE* f)
+{
+    string token;
+    int c;
+    while ((c = fgetc(f)) != EOF && c != ' ')
+        token.push_back((char)c);
+    return token;
+}
+
+// Reads a binary Kaldi integer, preceded by its size.
+static int32_t ReadKaldiInt32(FILE* f, const wstring& path)
+{
+    if (fgetc(f) != sizeof(int32_t))
+        RuntimeError("Kaldi table '%ls': expected a 32-bit integer at position %" PRIu64 ".", path.c_str(), fgetpos(f));
+
+    int32_t value;
+    freadOrDie(&value, sizeof(value), 1, f);
+    return value;
+}
+
+// Converts the features of a float or double matrix into the element type.
+template <class ElemType>
+static void ConvertFeatures(const char* source, bool isDouble, size_t count, ElemType* target)
+{
+    if (isDouble)
+        copy((const double*)source, (const double*)source + count, target);
+    else
+        copy((const float*)source, (const float*)source + count, target);
+}
+
+// Objects of a chunk, read on construction.
+// The lifetime is always less than the lifetime of the parent deserializer.
+class KaldiDeserializer::KaldiChunk : public Chunk, public enable_shared_from_this<KaldiChunk>
+{
+    const KaldiDeserializer& m_parent;
+
+    vector<char> m_data;        // features of all frames, in the element type
+    vector<IndexType> m_labels; // label of each frame
+
+    // Sequences the chunk hands out, depending on the stream and the mode.
+    vector<KaldiDenseSequenceData> m_denseSequences;
+    vector<KaldiSparseSequenceData> m_sparseSequences;
+
+public:
+    KaldiChunk(const KaldiDeserializer& parent, const ChunkDescriptor& descriptor)
+        : m_parent(parent)
+    {
+        const auto& utterances = descriptor.m_utterances;
+        const size_t frameSize = parent.m_dimension * parent.m_elementSize;
+        if (parent.m_isAlignment)
+            m_labels.resize(descriptor.m_totalFrames);
+        else
+            m_data.resize(descriptor.m_totalFrames * frameSize);
+
+        // Consecutive utterances of the same file are read by one thread, in the order of their offsets.
+        vector<size_t> groupBegins;
+        for (size_t i = 0; i < utterances.size(); ++i)
+        {
+            if (i == 0 || utterances[i].m_fileIndex != utterances[i - 1].m_fileIndex)
+                groupBegins.push_back(i);
+        }
+        groupBegins.push_back(utterances.size());
+
+        ParallelForEachGroup(parent.m_numParallelReads, groupBegins.size() - 1, [&](size_t group)
+        {
+            auto f = fopenOrDie(parent.m_files[utterances[groupBegins[group]].m_fileIndex], L"rbS");
+            vector<char> buffer;
+            for (size_t i = groupBegins[group]; i < groupBegins[group + 1]; ++i)
+            {
+                const auto& utterance = utterances[i];
+                buffer.resize(parent.GetDataSize(utterance));
+                fsetpos(f, utterance.m_dataOffset);
+                freadOrDie(buffer.data(), 1, buffer.size(), f);
+
+                size_t start = descriptor.m_startFrames[i];
+                if (parent.m_isAlignment)
+                {
+                    // Each element is preceded by its size.
+                    for (size_t t = 0; t < utterance.m_numberOfFrames; ++t)
+                    {
+                        int32_t label;
+                        memcpy(&label, &buffer[t * (1 + sizeof(int32_t)) + 1], sizeof(label));
+                        if (label < 0 || (size_t)label >= parent.m_dimension)
+                            RuntimeError("Kaldi alignment '%s' has the label %d, expected labels below labelDim %zu.",
+                                parent.m_corpus->IdToKey(utterance.m_key).c_str(), (int)label, parent.m_dimension);
+                        m_labels[start + t] = (IndexType)label;
+                    }
+                }
+                else
+                {
+                    size_t count = utterance.m_numberOfFrames * parent.m_dimension;
+                    char* target = &m_data[start * frameSize];
+                    if (parent.m_elementType == ElementType::tfloat)
+                        ConvertFeatures(buffer.data(), utterance.m_isDouble, count, (float*)target);
+                    else
+                        ConvertFeatures(buffer.data(), utterance.m_isDouble, count, (double*)target);
+                }
+            }
+            fclose(f);
+        });
+
+        if (parent.m_verbosity)
+            fprintf(stderr, "KaldiDeserializer: read chunk (%zu utterances, %zu frames)\n", utterances.size(), descriptor.m_totalFrames);
+
+        // Labels of single frames are the shared categories of the deserializer.
+        if (parent.m_isAlignment && parent.m_frameMode)
+            return;
+
+        if (parent.m_isAlignment)
+            m_sparseSequences.reserve(utterances.size());
+        else
+            m_denseSequences.reserve(parent.m_frameMode ? descriptor.m_totalFrames : utterances.size());
+
+        for (size_t i = 0; i < utterances.size(); ++i)
+        {
+            const auto& utterance = utterances[i];
+            size_t start = descriptor.m_startFrames[i];
+            if (parent.m_isAlignment)
+            {
+                KaldiSparseSequenceData s;
+                s.m_indices = &m_labels[start];
+                s.m_nnzCounts.resize(utterance.m_numberOfFrames, static_cast<IndexType>(1));
+                s.m_totalNnzCount = static_cast<IndexType>(utterance.m_numberOfFrames);
+                s.m_numberOfSamples = utterance.m_numberOfFrames;
+                s.m_values = parent.m_ones.data();
+                s.m_key.m_sequence = utterance.m_key;
+                m_sparseSequences.push_back(move(s));
+            }
+            else if (parent.m_frameMode)
+            {
+                for (size_t t = 0; t < utterance.m_numberOfFrames; ++t)
+                {
+                    KaldiDenseSequenceData s;
+                    s.m_buffer = &m_data[(start + t) * frameSize];
+                    s.m_numberOfSamples = 1;
+                    s.m_key.m_sequence = utterance.m_key;
+                    s.m_key.m_sample = (uint32_t)t;
+                    m_denseSequences.push_back(s);
+                }
+            }
+            else
+            {
+                KaldiDenseSequenceData s;
+                s.m_buffer = &m_data[start * frameSize];
+                s.m_numberOfSamples = utterance.m_numberOfFrames;
+                s.m_key.m_sequence = utterance.m_key;
+                m_denseSequences.push_back(s);
+            }
+        }
+    }
+
+    // The sequences alias the chunk, which holds their data.
+    void GetSequence(size_t sequenceIndex, vector<SequenceDataPtr>& result) override
+    {
+        if (m_parent.m_isAlignment && m_parent.m_frameMode)
+            result.push_back(m_parent.m_categories[m_labels[sequenceIndex]]);
+        else if (m_parent.m_isAlignment)
+            result.push_back(SequenceDataPtr(shared_from_this(), &m_sparseSequences[sequenceIndex]));
+        else
+            result.push_back(SequenceDataPtr(shared_from_this(), &m_denseSequences[sequenceIndex]));
+    }
+};
+
+// Expects a single stream in the input section of the config, see KaldiDeserializer.h.
+// scpFile and arkFile may contain wildcards.
+KaldiDeserializer::KaldiDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
+    : DataDeserializerBase(primary),
+      m_corpus(corpus)
+{
+    m_frameMode = (ConfigValue)cfg("frameMode", "true");
+    m_verbosity = cfg(L"verbosity", 0);
+    m_numParallelReads = cfg(L"numParallelReads", 8);
+
+    wstring precision = cfg(L"precision", L"float");
+    m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
+    m_elementSize = m_elementType == ElementType::tfloat ? sizeof(float) : sizeof(double);
+
+    ConfigParameters input = cfg(L"input");
+    auto inputName = input.GetMemberIds().front();
+    ConfigParameters streamConfig = input(inputName);
+
+    m_isAlignment = streamConfig.Exists(L"labelDim");
+    m_dimension = m_isAlignment ? streamConfig(L"labelDim") : streamConfig(L"dim");
+
+    vector<pair<string, Utterance>> utterances;
+    vector<wstring> paths;
+    if (streamConfig.Exists(L"scpFile"))
+    {
+        expand_wildcards(streamConfig(L"scpFile"), paths);
+        IndexScriptFiles(paths, utterances);
+    }
+    else if (streamConfig.Exists(L"arkFile"))
+    {
+        expand_wildcards(streamConfig(L"arkFile"), paths);
+        IndexArchives(paths, utterances);
+    }
+    else
+        InvalidArgument("KaldiDeserializer: please specify the table of the input '%ls' by scpFile or arkFile.", inputName.c_str());
+
+    InitializeChunkDescriptions(corpus, utterances);
+    InitializeStream(inputName);
+    if (m_isAlignment && m_frameMode)
+        InitializeReadOnlyArrayOfLabels();
+}
+
+void KaldiDeserializer::ReadObjectHeader(FILE* f, const wstring& path, Utterance& utterance) const
+{
+    if (fgetc(f) != '\0' || fgetc(f) != 'B')
+        RuntimeError("Kaldi table '%ls' is not in binary format at position %" PRIu64 ".", path.c_str(), fgetpos(f));
+
+    int32_t numberOfFrames;
+    utterance.m_isDouble = false;
+    if (m_isAlignment)
+    {
+        numberOfFrames = ReadKaldiInt32(f, path);
+    }
+    else
+    {
+        string type = ReadKaldiToken(f);
+        if (type == "DM")
+            utterance.m_isDouble = true;
+        else if (type[0] == 'C')
+            RuntimeError("Kaldi table '%ls' holds compressed matrices, which are not supported. Please write them with copy-feats.", path.c_str());
+        else if (type != "FM")
+            RuntimeError("Kaldi table '%ls' holds objects of type '%s', expected float or double matrices.", path.c_str(), type.c_str());
+
+        numberOfFrames = ReadKaldiInt32(f, path);
+        int32_t dimension = ReadKaldiInt32(f, path);
+        if ((size_t)dimension != m_dimension)
+            RuntimeError("Kaldi table '%ls' holds features of dimension %d, expected dim %zu.", path.c_str(), (int)dimension, m_dimension);
+    }
+
+    if (numberOfFrames <= 0 || (size_t)numberOfFrames > SEQUENCELEN_MAX)
+        RuntimeError("Kaldi table '%ls' holds an object of %d frames.", path.c_str(), (int)numberOfFrames);
+
+    utterance.m_numberOfFrames = (uint32_t)numberOfFrames;
+    utterance.m_dataOffset = fgetpos(f);
+}
+
+size_t KaldiDeserializer::GetDataSize(const Utterance& utterance) const
+{
+    if (m_isAlignment)
+        return utterance.m_numberOfFrames * (1 + sizeof(int32_t));
+
+    return utterance.m_numberOfFrames * m_dimension * (utterance.m_isDouble ? sizeof(double) : sizeof(float));
+}
+
+// Lines of a script file are 'key path:offset', the offset pointing behind the key in the archive,
+// or 'key path' for a file holding a single object.
+void KaldiDeserializer::IndexScriptFiles(const vector<wstring>& scriptPaths, vector<pair<string, Utterance>>& utterances)
+{
+    unordered_map<wstring, uint32_t> fileIndices;
+    for (const auto& scriptPath : scriptPaths)
+    {
+        for (auto& line : msra::files::fgetfilelines(scriptPath))
+        {
+            Trim(line);
+            if (line.empty())
+                continue;
+
+            auto separator = line.find_first_of(" \t");
+            if (separator == string::npos)
+                RuntimeError("Invalid line '%s' in Kaldi script file '%ls'.", line.c_str(), scriptPath.c_str());
+
+            string key = line.substr(0, separator);
+            string location = line.substr(line.find_first_not_of(" \t", separator));
+            if (location.back() == ']' || location.back() == '|')
+                RuntimeError("Kaldi script file '%ls' uses ranges or pipes, which are not supported: '%s'.", scriptPath.c_str(), location.c_str());
+
+            Utterance utterance = {};
+            auto colon = location.rfind(':');
+            if (colon != string::npos && colon + 1 < location.size() && location.find_first_not_of("0123456789", colon + 1) == string::npos)
+            {
+                utterance.m_dataOffset = stoull(location.substr(colon + 1));
+                location.resize(colon);
+            }
+
+            wstring path = msra::strfun::utf16(location);
+            auto file = fileIndices.insert(make_pair(path, (uint32_t)m_files.size()));
+            if (file.second)
+                m_files.push_back(path);
+            utterance.m_fileIndex = file.first->second;
+            utterances.push_back(make_pair(key, utterance));
+        }
+    }
+
+    // Read the headers of the objects, file by file in the order of their offsets.
+    vector<vector<size_t>> utterancesByFile(m_files.size());
+    for (size_t i = 0; i < utterances.size(); ++i)
+        utterancesByFile[utterances[i].second.m_fileIndex].push_back(i);
+
+    ParallelForEachGroup(m_numParallelReads, m_files.size(), [&](size_t fileIndex)
+    {
+        auto& indices = utterancesByFile[fileIndex];
+        sort(indices.begin(), indices.end(), [&](size_t a, size_t b) { return utterances[a].second.m_dataOffset < utterances[b].second.m_dataOffset; });
+
+        auto f = fopenOrDie(m_files[fileIndex], L"rbS");
+        for (auto i : indices)
+        {
+            fsetpos(f, utterances[i].second.m_dataOffset);
+            ReadObjectHeader(f, m_files[fileIndex], utterances[i].second);
+        }
+        fclose(f);
+    });
+}
+
+// An archive is a sequence of 'key ' followed by the binary object.
+void KaldiDeserializer::IndexArchives(const vector<wstring>& archivePaths, vector<pair<string, Utterance>>& utterances)
+{
+    m_files = archivePaths;
+    vector<vector<pair<string, Utterance>>> utterancesByFile(m_files.size());
+    ParallelForEachGroup(m_numParallelReads, m_files.size(), [&](size_t fileIndex)
+    {
+        auto f = fopenOrDie(m_files[fileIndex], L"rbS");
+        for (;;)
+        {
+            string key = ReadKaldiToken(f);
+            if (key.empty())
+                break;
+
+            Utterance utterance = {};
+            utterance.m_fileIndex = (uint32_t)fileIndex;
+            ReadObjectHeader(f, m_files[fileIndex], utterance);
+            fsetpos(f, utterance.m_dataOffset + GetDataSize(utterance));
+            utterancesByFile[fileIndex].push_back(make_pair(key, utterance));
+        }
+        fclose(f);
+    });
+
+    for (auto& fileUtterances : utterancesByFile)
+        utterances.insert(utterances.end(), fileUtterances.begin(), fileUtterances.end());
+}
+
+void KaldiDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, vector<pair<string, Utterance>>& utterances)
+{
+    // Chunks are consecutive utterances of the index, of about 15 minutes like the chunks of the HTK deserializer.
+    const size_t FramesPerSec = 100;
+    const size_t ChunkFrames = 15 * 60 * FramesPerSec;
+
+    auto emptyPair = make_pair(numeric_limits<ChunkIdType>::max(), numeric_limits<uint32_t>::max());
+    size_t totalNumSequences = 0, totalNumFrames = 0, maxNumFrames = 0;
+    for (auto& keyAndUtterance : utterances)
+    {
+        if (!corpus->IsIncluded(keyAndUtterance.first))
+            continue;
+
+        if (m_chunks.empty() || m_chunks.back().m_totalFrames > ChunkFrames)
+        {
+            m_chunks.push_back(ChunkDescriptor{ {}, {}, 0 });
+            if (m_chunks.size() >= numeric_limits<ChunkIdType>::max())
+                RuntimeError("Number of chunks exceeded overflow limit.");
+        }
+
+        auto& chunk = m_chunks.back();
+        auto& utterance = keyAndUtterance.second;
+        utterance.m_key = corpus->KeyToId(keyAndUtterance.first);
+        if (m_keyToSequence.size() <= utterance.m_key)
+            m_keyToSequence.resize(utterance.m_key + 1, emptyPair);
+
+        if (m_keyToSequence[utterance.m_key] != emptyPair)
+            RuntimeError("Duplicate utterance '%s' in the Kaldi table.", keyAndUtterance.first.c_str());
+
+        m_keyToSequence[utterance.m_key] = make_pair(static_cast<ChunkIdType>(m_chunks.size() - 1), static_cast<uint32_t>(chunk.m_utterances.size()));
+        chunk.m_utterances.push_back(utterance);
+        chunk.m_startFrames.push_back(chunk.m_totalFrames);
+        chunk.m_totalFrames += utterance.m_numberOfFrames;
+        totalNumSequences++;
+        totalNumFrames += utterance.m_numberOfFrames;
+        maxNumFrames = max(maxNumFrames, (size_t)utterance.m_numberOfFrames);
+    }
+
+    // The values of the labels of any utterance.
+    if (m_isAlignment)
+    {
+        m_ones.resize(maxNumFrames * m_elementSize);
+        if (m_elementType == ElementType::tfloat)
+            fill((float*)m_ones.data(), (float*)m_ones.data() + maxNumFrames, 1.0f);
+        else
+            fill((double*)m_ones.data(), (double*)m_ones.data() + maxNumFrames, 1.0);
+    }
+
+    fprintf(stderr, "KaldiDeserializer: '%zu' utterances with '%zu' frames in '%zu' chunks\n", totalNumSequences, totalNumFrames, m_chunks.size());
+}
+
+void KaldiDeserializer::InitializeStream(const wstring& name)
+{
+    // Initializing stream description - a single stream of features or labels.
+    StreamDescriptionPtr stream = make_shared<StreamDescription>();
+    stream->m_id = 0;
+    stream->m_name = name;
+    stream->m_sampleLayout = make_shared<TensorShape>(m_dimension);
+    stream->m_storageType = m_isAlignment ? StorageType::sparse_csc : StorageType::dense;
+    stream->m_elementType = m_elementType;
+    m_streams.push_back(stream);
+}
+
+void KaldiDeserializer::InitializeReadOnlyArrayOfLabels()
+{
+    m_categories.reserve(m_dimension);
+    m_categoryIndices.reserve(m_dimension);
+    for (size_t i = 0; i < m_dimension; ++i)
+    {
+        auto category = make_shared<CategorySequenceData>();
+        m_categoryIndices.push_back(static_cast<IndexType>(i));
+        category->m_indices = &(m_categoryIndices[i]);
+        category->m_nnzCounts.resize(1);
+        category->m_nnzCounts[0] = 1;
+        category->m_totalNnzCount = 1;
+        category->m_numberOfSamples = 1;
+        category->m_data = m_ones.data();
+        m_categories.push_back(category);
+    }
+}
+
+ChunkDescriptions KaldiDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions chunks;
+    chunks.reserve(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = static_cast<ChunkIdType>(i);
+        cd->m_numberOfSamples = m_chunks[i].m_totalFrames;
+        cd->m_numberOfSequences = m_frameMode ? m_chunks[i].m_totalFrames : m_chunks[i].m_utterances.size();
+        chunks.push_back(cd);
+    }
+    return chunks;
+}
+
+void KaldiDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_chunks[chunkId];
+    result.reserve(m_frameMode ? chunk.m_totalFrames : chunk.m_utterances.size());
+    uint32_t offsetInChunk = 0;
+    for (const auto& utterance : chunk.m_utterances)
+    {
+        // In frame mode each frame is a sequence.
+        size_t numberOfSequences = m_frameMode ? utterance.m_numberOfFrames : 1;
+        for (size_t k = 0; k < numberOfSequences; ++k)
+        {
+            SequenceDescription f;
+            f.m_chunkId = chunkId;
+            f.m_key.m_sequence = utterance.m_key;
+            f.m_key.m_sample = (uint32_t)k;
+            f.m_indexInChunk = offsetInChunk++;
+            f.m_numberOfSamples = m_frameMode ? 1 : utterance.m_numberOfFrames;
+            result.push_back(f);
+        }
+    }
+}
+
+ChunkPtr KaldiDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    ChunkPtr result;
+    attempt(5, [this, &result, chunkId]()
+    {
+        result = make_shared<KaldiChunk>(*this, m_chunks[chunkId]);
+    });
+
+    return result;
+}
+
+bool KaldiDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    if (key.m_sequence >= m_keyToSequence.size())
+        return false;
+
+    auto chunkAndUtteranceIndex = m_keyToSequence[key.m_sequence];
+    if (chunkAndUtteranceIndex.first == numeric_limits<ChunkIdType>::max())
+        return false;
+
+    const auto& chunk = m_chunks[chunkAndUtteranceIndex.first];
+    const auto& utterance = chunk.m_utterances[chunkAndUtteranceIndex.second];
+    result.m_chunkId = chunkAndUtteranceIndex.first;
+    result.m_key = key;
+    if (m_frameMode)
+    {
+        // Check that the sequences are equal in number of frames.
+        if (key.m_sample >= utterance.m_numberOfFrames)
+            RuntimeError("Sequence with key '%s' has '%u' frame(s), whereas the primary sequence expects at least '%u' frames",
+                m_corpus->IdToKey(key.m_sequence).c_str(), utterance.m_numberOfFrames, (unsigned)key.m_sample + 1);
+
+        result.m_indexInChunk = chunk.m_startFrames[chunkAndUtteranceIndex.second] + key.m_sample;
+        result.m_numberOfSamples = 1;
+    }
+    else
+    {
+        result.m_indexInChunk = chunkAndUtteranceIndex.second;
+        result.m_numberOfSamples = utterance.m_numberOfFrames;
+    }
+    return true;
+}
+
+}}}
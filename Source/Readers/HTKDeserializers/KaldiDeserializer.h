@@ -0,0 +1,116 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Class represents a deserializer of Kaldi tables in binary format, read natively without the Kaldi libraries.
+// A table is given either as a script file (lines 'key path.ark:offset', as written by copy-feats or ali-to-pdf
+// with ark,scp) or as archives that are scanned for their objects. The position and the size of all objects
+// are indexed on construction; the objects are then split into chunks of about 15 minutes of frames, which
+// read their objects in bulk, one file per thread.
+// The stream is either
+//     - features (float or double matrices, one row per frame), config: dim = <number of columns>, or
+//     - alignments (int32 vectors of pdf ids, one per frame), exposed as sparse one-hot labels like the
+//       MLF deserializer, config: labelDim = <number of pdfs>.
+// E.g. input = [ features = [ dim = 40 ; scpFile = "feats.scp" ] ]
+//   or input = [ labels = [ labelDim = 3000 ; arkFile = "ali.*.ark" ] ]
+// Compressed matrices (compress-feats) and Kaldi's text format are not supported.
+class KaldiDeserializer : public DataDeserializerBase, boost::noncopyable
+{
+public:
+    KaldiDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Retrieves sequence description by its key. Used for deserializers that are not in "primary"/"driving" mode.
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& s) override;
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& s) override;
+
+    // Retrieves a chunk with data.
+    virtual ChunkPtr GetChunk(ChunkIdType) override;
+
+private:
+    class KaldiChunk;
+
+    // Location of a table object in its file.
+    struct Utterance
+    {
+        size_t m_key;
+        uint32_t m_fileIndex;
+        uint32_t m_numberOfFrames;
+        uint64_t m_dataOffset; // position of the data following the object header
+        bool m_isDouble;       // a double matrix (features only)
+    };
+
+    // Utterances of a chunk, in the order of the index.
+    struct ChunkDescriptor
+    {
+        std::vector<Utterance> m_utterances;
+        std::vector<size_t> m_startFrames; // index of the first frame of each utterance in the chunk
+        size_t m_totalFrames;
+    };
+
+    // Builds the index from the given script files or archives.
+    void IndexScriptFiles(const std::vector<std::wstring>& scriptPaths, std::vector<std::pair<std::string, Utterance>>& utterances);
+    void IndexArchives(const std::vector<std::wstring>& archivePaths, std::vector<std::pair<std::string, Utterance>>& utterances);
+
+    // Reads the header of the object at the current position of the file and sets the size and data offset of the utterance.
+    void ReadObjectHeader(FILE* f, const std::wstring& path, Utterance& utterance) const;
+
+    // Size in bytes of the data of an utterance in its file.
+    size_t GetDataSize(const Utterance& utterance) const;
+
+    // Initializes chunk descriptions.
+    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, std::vector<std::pair<std::string, Utterance>>& utterances);
+
+    // Initializes a single stream this deserializer exposes.
+    void InitializeStream(const std::wstring& name);
+
+    // In frame mode with alignments initializes a label for each category in order to avoid memory copy.
+    void InitializeReadOnlyArrayOfLabels();
+
+    CorpusDescriptorPtr m_corpus;
+
+    // Whether the table holds alignments rather than features.
+    bool m_isAlignment;
+
+    // Number of columns of the features or number of categories of the alignments.
+    size_t m_dimension;
+
+    ElementType m_elementType;
+    size_t m_elementSize;
+
+    // Flag that indicates whether a single speech frames should be exposed as a sequence.
+    bool m_frameMode;
+
+    // Number of files a chunk reads in parallel.
+    int m_numParallelReads;
+    int m_verbosity;
+
+    std::vector<std::wstring> m_files;
+    std::vector<ChunkDescriptor> m_chunks;
+
+    // Vector that maps KeyType.m_sequence into a chunk and the index of the utterance in it (or type max() if the key is not assigned).
+    std::vector<std::pair<ChunkIdType, uint32_t>> m_keyToSequence;
+
+    // Values of the one-hot labels for the longest utterance, in the element type.
+    std::vector<char> m_ones;
+
+    // In frame mode, one label per category, shared by all frames.
+    std::vector<SparseSequenceDataPtr> m_categories;
+    std::vector<IndexType> m_categoryIndices;
+};
+
+}}}
@@ -0,0 +1,251 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <limits>
+#include <algorithm>
+#include "LatticeDeserializer.h"
+#include "ReaderConstants.h"
+#include "StringUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// A lattice in compiled format, padded to whole samples.
+struct LatticeSequenceData : DenseSequenceData
+{
+    LatticeSequenceData(const shared_ptr<const vector<char>>& lattice) : m_lattice(lattice)
+    {
+        m_numberOfSamples = (uint32_t)(lattice->size() / LatticeDeserializer::s_bytesPerSample);
+        if (m_numberOfSamples * LatticeDeserializer::s_bytesPerSample != lattice->size())
+            RuntimeError("Maximum number of samples per sequence exceeded.");
+    }
+
+    const void* GetDataBuffer() override
+    {
+        return m_lattice->data();
+    }
+
+private:
+    shared_ptr<const vector<char>> m_lattice;
+};
+
+// Lattices of a chunk, read on construction.
+// The lifetime is always less than the lifetime of the parent deserializer.
+class LatticeDeserializer::LatticeChunk : public Chunk
+{
+    vector<shared_ptr<const vector<char>>> m_lattices; // null if the lattice could not be read
+
+public:
+    LatticeChunk(const LatticeDeserializer& parent, const ChunkDescriptor& descriptor)
+    {
+        const auto& archive = *parent.m_archive;
+        const auto& path = archive.getarchivepath(descriptor.m_archiveIndex);
+        const bool compiled = archive.iscompiled(descriptor.m_archiveIndex);
+        m_lattices.resize(descriptor.m_lattices.size());
+
+        // Each thread reads and compiles the lattices through its own file handle on the archive (compiled archives are mapped).
+#pragma omp parallel
+        {
+            auto_file_ptr f;
+            msra::lattices::lattice L;
+            vector<char> buffer;
+
+#pragma omp for schedule(dynamic)
+            for (int i = 0; i < descriptor.m_lattices.size(); ++i)
+            {
+                try
+                {
+                    if (!compiled && !f)
+                        f = fopenOrDie(path, L"rbS");
+
+                    archive.readlattice(descriptor.m_archiveIndex, descriptor.m_lattices[i].second, f, L);
+                    L.writecompiled(buffer);
+                    buffer.resize((buffer.size() + s_bytesPerSample - 1) / s_bytesPerSample * s_bytesPerSample, 0);
+                    m_lattices[i] = make_shared<const vector<char>>(buffer);
+                }
+                catch (const exception& e)
+                {
+                    fprintf(stderr, "WARNING: Cannot read the lattice '%s' from '%ls': %s\n",
+                        parent.m_corpus->IdToKey(descriptor.m_lattices[i].first).c_str(), path.c_str(), e.what());
+                    f = nullptr; // reopen after read errors
+                }
+            }
+        }
+    }
+
+    void GetSequence(size_t sequenceIndex, vector<SequenceDataPtr>& result) override
+    {
+        const auto& lattice = m_lattices[sequenceIndex];
+        if (!lattice)
+        {
+            auto s = make_shared<LatticeSequenceData>(make_shared<const vector<char>>());
+            s->m_isValid = false;
+            result.push_back(s);
+            return;
+        }
+
+        result.push_back(make_shared<LatticeSequenceData>(lattice));
+    }
+};
+
+// Expects the lattices in the input section of the config, e.g.
+//     input = [ lattice = [ denLatTocFile = "..."; phoneFile = "..."; transPFile = "..."; labelMappingFile = "..."; prefixPathInToc = "" ] ]
+// denLatTocFile may contain wildcards. The model files are the ones given to the legacy HTKMLFReader.
+LatticeDeserializer::LatticeDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
+    : DataDeserializerBase(primary),
+      m_corpus(corpus)
+{
+    if (primary)
+        RuntimeError("LatticeDeserializer currently does not support primary mode.");
+
+    bool frameMode = (ConfigValue)cfg("frameMode", "false");
+    if (frameMode)
+        InvalidArgument("LatticeDeserializer requires whole utterances, please set frameMode to false.");
+
+    m_verbosity = cfg(L"traceLevel", 0);
+    m_chunkSizeBytes = cfg(L"chunkSizeInBytes", g_32MB);
+
+    ConfigParameters input = cfg("input");
+    auto inputName = input.GetMemberIds().front();
+    ConfigParameters streamConfig = input(inputName);
+
+    wstring phoneFile = streamConfig(L"phoneFile");
+    wstring transPFile = streamConfig(L"transPFile", L"");
+    wstring labelMappingFile = streamConfig(L"labelMappingFile");
+    m_hset.loadfromfile(phoneFile, labelMappingFile, transPFile);
+
+    vector<wstring> tocPaths;
+    expand_wildcards(streamConfig(L"denLatTocFile"), tocPaths);
+    wstring prefixPathInToc = streamConfig(L"prefixPathInToc", L"");
+    m_archive.reset(new msra::lattices::archive(tocPaths, m_hset.getsymmap(), prefixPathInToc));
+    m_archive->setverbosity(m_verbosity);
+
+    // Loads symbol maps and maps compiled archives, so that chunks can read lattices concurrently.
+    m_archive->preparereading();
+
+    InitializeChunkDescriptions(corpus);
+    InitializeStream(inputName);
+}
+
+void LatticeDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus)
+{
+    // Collect the lattices of each archive in the order of their offsets.
+    vector<vector<pair<uint64_t, size_t>>> latticesByArchive(m_archive->getnumarchives()); // offset and sequence key
+    m_archive->foreachlattice([&](const wstring& key, size_t archiveIndex, uint64_t offset)
+    {
+        string sequenceKey = msra::strfun::utf8(key);
+        if (!corpus->IsIncluded(sequenceKey))
+            return;
+
+        latticesByArchive[archiveIndex].push_back(make_pair(offset, corpus->KeyToId(sequenceKey)));
+    });
+
+    // Chunks are consecutive lattices of an archive, with their size in the archive estimated from the offsets.
+    auto emptyPair = make_pair(numeric_limits<ChunkIdType>::max(), numeric_limits<uint32_t>::max());
+    size_t totalNumSequences = 0;
+    for (size_t archiveIndex = 0; archiveIndex < latticesByArchive.size(); ++archiveIndex)
+    {
+        auto& lattices = latticesByArchive[archiveIndex];
+        if (lattices.empty())
+            continue;
+
+        sort(lattices.begin(), lattices.end());
+        uint64_t archiveSize = filesize64(m_archive->getarchivepath(archiveIndex).c_str());
+        for (size_t i = 0; i < lattices.size(); ++i)
+        {
+            uint64_t end = i + 1 < lattices.size() ? lattices[i + 1].first : archiveSize;
+            size_t sizeInBytes = (size_t)(end > lattices[i].first ? end - lattices[i].first : 0);
+
+            if (i == 0 || m_chunks.back().m_sizeInBytes + sizeInBytes > m_chunkSizeBytes)
+            {
+                m_chunks.push_back(ChunkDescriptor{ archiveIndex, {}, 0 });
+                if (m_chunks.size() >= numeric_limits<ChunkIdType>::max())
+                    RuntimeError("Number of chunks exceeded overflow limit.");
+            }
+
+            auto& chunk = m_chunks.back();
+            size_t key = lattices[i].second;
+            if (m_keyToSequence.size() <= key)
+                m_keyToSequence.resize(key + 1, emptyPair);
+
+            if (m_keyToSequence[key] != emptyPair)
+                RuntimeError("Duplicate lattice for the utterance '%s'.", corpus->IdToKey(key).c_str());
+
+            m_keyToSequence[key] = make_pair(static_cast<ChunkIdType>(m_chunks.size() - 1), static_cast<uint32_t>(chunk.m_lattices.size()));
+            chunk.m_lattices.push_back(make_pair(key, lattices[i].first));
+            chunk.m_sizeInBytes += sizeInBytes;
+            totalNumSequences++;
+        }
+    }
+
+    fprintf(stderr, "LatticeDeserializer: '%zu' lattices in '%zu' chunks\n", totalNumSequences, m_chunks.size());
+}
+
+void LatticeDeserializer::InitializeStream(const wstring& name)
+{
+    // Initializing stream description - a single stream of lattices in compiled format.
+    StreamDescriptionPtr stream = make_shared<StreamDescription>();
+    stream->m_id = 0;
+    stream->m_name = name;
+    stream->m_sampleLayout = make_shared<TensorShape>(s_bytesPerSample / sizeof(float));
+    stream->m_storageType = StorageType::dense;
+    stream->m_elementType = ElementType::tfloat;
+    m_streams.push_back(stream);
+}
+
+ChunkDescriptions LatticeDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions chunks;
+    chunks.reserve(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = static_cast<ChunkIdType>(i);
+        cd->m_numberOfSequences = m_chunks[i].m_lattices.size();
+        cd->m_numberOfSamples = m_chunks[i].m_lattices.size();
+        chunks.push_back(cd);
+    }
+    return chunks;
+}
+
+void LatticeDeserializer::GetSequencesForChunk(ChunkIdType, vector<SequenceDescription>& result)
+{
+    UNUSED(result);
+    LogicError("Lattice deserializer does not support primary mode, it cannot control chunking. "
+        "Please specify HTK deserializer as the first deserializer in your config file.");
+}
+
+ChunkPtr LatticeDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    ChunkPtr result;
+    attempt(5, [this, &result, chunkId]()
+    {
+        result = make_shared<LatticeChunk>(*this, m_chunks[chunkId]);
+    });
+
+    return result;
+}
+
+bool LatticeDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    if (key.m_sequence >= m_keyToSequence.size())
+        return false;
+
+    auto chunkAndSequenceIndex = m_keyToSequence[key.m_sequence];
+    if (chunkAndSequenceIndex.first == numeric_limits<ChunkIdType>::max())
+        return false;
+
+    result.m_chunkId = chunkAndSequenceIndex.first;
+    result.m_indexInChunk = chunkAndSequenceIndex.second;
+    result.m_key = key;
+
+    // The length of the lattice stream does not count, the minibatch size is defined by the features.
+    result.m_numberOfSamples = 1;
+    return true;
+}
+
+}}}
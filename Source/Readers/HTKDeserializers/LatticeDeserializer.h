@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+#include "latticearchive.h"
+#include "simplesenonehmm.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Class represents a deserializer of HTK lattice archives (denominator lattices) for sequence training.
+// The lattices of an archive are split into chunks of consecutive lattices, which the randomizer loads and prefetches
+// like the chunks of the features. A chunk reads its lattices on several threads.
+// Each lattice is exposed as a single sequence of the dense stream, holding the lattice in compiled format
+// (see lattice::writecompiled()) in samples of LatticeDeserializer::s_bytesPerSample bytes.
+// The stream is no input of the network, the ReaderShim decodes it for GetMinibatch4SE().
+class LatticeDeserializer : public DataDeserializerBase, boost::noncopyable
+{
+public:
+    LatticeDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Retrieves sequence description by its key. Used for deserializers that are not in "primary"/"driving" mode.
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& s) override;
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& s) override;
+
+    // Retrieves a chunk with data.
+    virtual ChunkPtr GetChunk(ChunkIdType) override;
+
+    // Size of a sample of the lattice stream.
+    static const size_t s_bytesPerSample = 1024;
+
+private:
+    class LatticeChunk;
+
+    // Lattices of a chunk, all of the same archive, in the order of their offsets.
+    struct ChunkDescriptor
+    {
+        size_t m_archiveIndex;
+        std::vector<std::pair<size_t, uint64_t>> m_lattices; // sequence key and offset in the archive
+        size_t m_sizeInBytes;
+    };
+
+    // Initializes chunk descriptions.
+    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus);
+
+    // Initializes a single stream this deserializer exposes.
+    void InitializeStream(const std::wstring& name);
+
+    CorpusDescriptorPtr m_corpus;
+
+    // Model the lattices are mapped to (the archive refers to its symbol map).
+    msra::asr::simplesenonehmm m_hset;
+    std::unique_ptr<msra::lattices::archive> m_archive;
+
+    std::vector<ChunkDescriptor> m_chunks;
+
+    // Vector that maps KeyType.m_sequence into a chunk and the index of the lattice in it (or type max() if the key is not assigned).
+    std::vector<std::pair<ChunkIdType, uint32_t>> m_keyToSequence;
+
+    size_t m_chunkSizeBytes;
+    int m_verbosity;
+};
+
+}}}
@@ -295,6 +295,8 @@ MLFDeserializer::MLFDeserializer(CorpusDescriptorPtr corpus, const ConfigParamet
     // Same behavior as for the old deserializer - keep almost all in memory,
     // because there are a lot of none aligned sets.
     m_chunkSizeBytes = cfg(L"chunkSizeInBytes", g_64MB);
+    m_cacheIndex = cfg(L"cacheIndex", false);
+    m_indexCacheDirectory = (wstring)cfg(L"indexCacheDirectory", L"");
 
     ConfigParameters input = cfg("input");
     auto inputName = input.GetMemberIds().front();
@@ -339,6 +341,8 @@ MLFDeserializer::MLFDeserializer(CorpusDescriptorPtr corpus, const ConfigParamet
     // Same behavior as for the old deserializer - keep almost all in memory,
     // because there are a lot of none aligned sets.
     m_chunkSizeBytes = labelConfig(L"chunkSizeInBytes", g_64MB);
+    m_cacheIndex = labelConfig(L"cacheIndex", false);
+    m_indexCacheDirectory = (wstring)labelConfig(L"indexCacheDirectory", L"");
 
     wstring precision = labelConfig(L"precision", L"float");;
     m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
@@ -372,6 +376,8 @@ void MLFDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, co
         {
             auto file = shared_ptr<FILE>(fopenOrDie(path, L"rbS"), [](FILE *f) { if (f) fclose(f); });
             indexer = make_shared<MLFIndexer>(file.get(), m_frameMode, m_chunkSizeBytes);
+            if (m_cacheIndex)
+                indexer->EnableCache(path, m_indexCacheDirectory);
             indexer->Build(corpus);
         });
 
@@ -77,6 +77,10 @@ private:
     size_t m_dimension;
     size_t m_chunkSizeBytes;
 
+    // Keep the index of each MLF file on disk across jobs (see IndexCache.h), next to the file or in the given directory.
+    bool m_cacheIndex;
+    std::wstring m_indexCacheDirectory;
+
     // Track phone boundaries
     bool m_withPhoneBoundaries;
 
@@ -86,6 +86,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return distance(line.begin(), line.end()) == 1 && *line.begin() == '.';
     }
 
+    void MLFIndexer::EnableCache(const wstring& inputPath, const wstring& cacheDirectory, bool verbose)
+    {
+        if (!m_index.IsEmpty())
+            LogicError("MLFIndexer::EnableCache must be called before the index is built.");
+        m_cache = make_shared<IndexCache>(inputPath, cacheDirectory, "MLF", verbose);
+    }
+
     // Building an index of the MLF file:
     //     MLF file -> MLF Header [MLF Utterance]+
     //     MLF Utterance -> Key EOL [Frame Range EOL]+ "." EOL
@@ -97,14 +104,31 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         if (!m_index.IsEmpty())
             return;
 
-        m_index.Reserve(filesize(m_file));
+        size_t fileSize = filesize(m_file);
+        m_index.Reserve(fileSize);
+
+        // continue after the utterances that are in the index cache
+        size_t startOffset = 0;
+        if (m_cache)
+        {
+            uint32_t flags;
+            startOffset = m_cache->Load(m_index, corpus, flags);
+            if (startOffset == fileSize)
+                return;
+            if (startOffset > 0)
+            {
+                if (_fseeki64(m_file, startOffset, SEEK_SET) != 0)
+                    RuntimeError("Cannot seek to the offset %" PRIu64 " in the MLF file.", startOffset);
+                m_fileOffsetStart = startOffset;
+            }
+        }
 
         RefillBuffer(); // read the first block of data
         if (m_done)
             RuntimeError("Input file is empty");
 
         size_t id = 0;
-        State currentState = State::Header;
+        State currentState = startOffset > 0 ? State::UtteranceKey : State::Header;
         vector<boost::iterator_range<char*>> lines, tokens;
         bool isValid = true;                    // Flag indicating whether the current sequence is valid.
         size_t lastNonEmptyString = 0;          // Needed to parse information about last frame
@@ -191,6 +215,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
             RefillBuffer();
         }
+
+        if (m_cache)
+            m_cache->Save(m_index, corpus, 0);
     }
 
     void MLFIndexer::ReadLines(vector<char>& buffer, vector<boost::iterator_range<char*>>& lines)
@@ -202,7 +229,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     // Tries to parse sequence key
     // In MLF a sequence key should be in quotes. During parsing the extension should be removed.
-    bool MLFIndexer::TryParseSequenceKey(const boost::iterator_range<char*>& line, size_t& id, function<size_t(const string&)> keyToId)
+    bool MLFIndexer::TryParseSequenceKey(const boost::iterator_range<char*>& line, size_t& id, const function<size_t(const string&)>& keyToId)
     {
         id = 0;
 
@@ -9,6 +9,7 @@
 #include <boost/noncopyable.hpp>
 
 #include "Indexer.h"
+#include "IndexCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -19,6 +20,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void Build(CorpusDescriptorPtr corpus);
 
+        // Makes Build() use the index cache of the MLF file (see IndexCache.h). Has to be called before Build().
+        void EnableCache(const std::wstring& inputPath, const std::wstring& cacheDirectory, bool verbose = false);
+
         // Returns input data index (chunk and sequence metadata)
         const Index& GetIndex() const { return m_index; }
 
@@ -39,6 +43,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         std::string m_lastPartialLineInBuffer;    // Partial string from the previous read of m_buffer.
 
         Index m_index;
+        IndexCachePtr m_cache;                    // null unless EnableCache() was called
 
         std::string m_lastNonEmptyLine;           // Last non empty estring, used for parsing sequence length.
 
@@ -48,7 +53,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         // Read lines from the buffer.
         void ReadLines(vector<char>& buffer, vector<boost::iterator_range<char*>>& lines);
-        bool TryParseSequenceKey(const boost::iterator_range<char*>& line, size_t& id, std::function<size_t(const std::string&)> keyToId);
+        bool TryParseSequenceKey(const boost::iterator_range<char*>& line, size_t& id, const std::function<size_t(const std::string&)>& keyToId);
     };
 
     typedef std::shared_ptr<MLFIndexer> MLFIndexerPtr;
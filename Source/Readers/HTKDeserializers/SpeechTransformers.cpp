@@ -0,0 +1,231 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <limits>
+#include <algorithm>
+#include <numeric>
+#include "SpeechTransformers.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static const double s_pi = 3.14159265358979323846;
+
+// Features of the frames of a sequence.
+template <class ElemType>
+struct FilterbankSequenceData : DenseSequenceData
+{
+    vector<ElemType> m_features;
+
+    const void* GetDataBuffer() override
+    {
+        return m_features.data();
+    }
+};
+
+static double MelScale(double frequency)
+{
+    return 1127.0 * log(1.0 + frequency / 700.0);
+}
+
+LogMelFilterbankTransformer::LogMelFilterbankTransformer(const ConfigParameters& config)
+    : TransformBase(config), m_windowLength(0), m_fftSize(0)
+{
+    m_sampleRate = config(L"sampleRate", 16000.0);
+    m_numFilters = config(L"numFilters", 40);
+    m_lowFrequency = config(L"lowFrequency", 20.0);
+    m_highFrequency = config(L"highFrequency", 0.0);
+    if (m_highFrequency <= 0)
+        m_highFrequency = m_sampleRate / 2;
+    m_preemphasis = config(L"preemphasis", 0.97);
+    m_dither = config(L"dither", 0.0);
+    m_removeDcOffset = config(L"removeDcOffset", true);
+    m_windowType = (wstring)config(L"windowType", L"hamming");
+    m_minGain = config(L"minGain", 1.0);
+    m_maxGain = config(L"maxGain", 1.0);
+
+    if (m_numFilters == 0 || m_lowFrequency < 0 || m_lowFrequency >= m_highFrequency || m_highFrequency > m_sampleRate / 2)
+        InvalidArgument("LogMelFilterbank: invalid numFilters or frequency range.");
+    if (!AreEqualIgnoreCase(m_windowType, L"hamming") && !AreEqualIgnoreCase(m_windowType, L"povey"))
+        InvalidArgument("LogMelFilterbank: unsupported windowType '%ls', expected 'hamming' or 'povey'.", m_windowType.c_str());
+    if (m_minGain <= 0 || m_minGain > m_maxGain)
+        InvalidArgument("LogMelFilterbank: expected 0 < minGain <= maxGain.");
+}
+
+StreamDescription LogMelFilterbankTransformer::Transform(const StreamDescription& inputStream)
+{
+    TransformBase::Transform(inputStream);
+    m_outputStream.m_sampleLayout = make_shared<TensorShape>(m_numFilters);
+    m_outputStream.m_elementType = m_precision;
+
+    m_windowLength = inputStream.m_sampleLayout->GetNumElements();
+    if (m_windowLength < 2)
+        InvalidArgument("LogMelFilterbank: the input stream '%ls' must hold windows of waveform samples.", inputStream.m_name.c_str());
+
+    m_window.resize(m_windowLength);
+    for (size_t i = 0; i < m_windowLength; ++i)
+    {
+        double hann = 0.5 - 0.5 * cos(2 * s_pi * i / (m_windowLength - 1));
+        m_window[i] = AreEqualIgnoreCase(m_windowType, L"povey") ? pow(hann, 0.85) : 0.54 - 0.46 * cos(2 * s_pi * i / (m_windowLength - 1));
+    }
+
+    // The real FFT of size N is computed by a complex FFT of size N / 2.
+    m_fftSize = 4;
+    while (m_fftSize < m_windowLength)
+        m_fftSize *= 2;
+
+    size_t half = m_fftSize / 2, bits = 0;
+    while (((size_t)1 << bits) < half)
+        bits++;
+    m_bitReversal.resize(half);
+    for (size_t i = 0; i < half; ++i)
+    {
+        size_t r = 0;
+        for (size_t b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        m_bitReversal[i] = r;
+    }
+    m_twiddles.resize(half / 2);
+    for (size_t k = 0; k < half / 2; ++k)
+        m_twiddles[k] = polar(1.0, -2 * s_pi * k / half);
+    m_realTwiddles.resize(half + 1);
+    for (size_t k = 0; k <= half; ++k)
+        m_realTwiddles[k] = polar(1.0, -2 * s_pi * k / m_fftSize);
+
+    // Triangular filters, equally spaced on the mel scale, over the bins below the Nyquist frequency.
+    double melLow = MelScale(m_lowFrequency), melHigh = MelScale(m_highFrequency);
+    double melDelta = (melHigh - melLow) / (m_numFilters + 1);
+    m_filterStarts.assign(m_numFilters, 0);
+    m_filterWeights.assign(m_numFilters, vector<double>());
+    for (size_t m = 0; m < m_numFilters; ++m)
+    {
+        double left = melLow + m * melDelta, center = left + melDelta, right = center + melDelta;
+        for (size_t k = 0; k < half; ++k)
+        {
+            double mel = MelScale(m_sampleRate * k / m_fftSize);
+            if (mel <= left || mel >= right)
+                continue;
+
+            if (m_filterWeights[m].empty())
+                m_filterStarts[m] = k;
+            m_filterWeights[m].resize(k - m_filterStarts[m] + 1, 0.0);
+            m_filterWeights[m].back() = mel <= center ? (mel - left) / (center - left) : (right - mel) / (right - center);
+        }
+
+        if (m_filterWeights[m].empty())
+            InvalidArgument("LogMelFilterbank: filter %zu is empty, please use fewer filters or longer windows.", m);
+    }
+
+    return m_outputStream;
+}
+
+void LogMelFilterbankTransformer::PowerSpectrum(vector<complex<double>>& z, double* power) const
+{
+    const size_t half = m_fftSize / 2;
+
+    // in-place radix-2 FFT of z
+    for (size_t i = 0; i < half; ++i)
+    {
+        if (i < m_bitReversal[i])
+            swap(z[i], z[m_bitReversal[i]]);
+    }
+    for (size_t length = 2; length <= half; length *= 2)
+    {
+        size_t stride = half / length;
+        for (size_t i = 0; i < half; i += length)
+        {
+            for (size_t j = 0; j < length / 2; ++j)
+            {
+                complex<double> u = z[i + j], v = z[i + j + length / 2] * m_twiddles[j * stride];
+                z[i + j] = u + v;
+                z[i + j + length / 2] = u - v;
+            }
+        }
+    }
+
+    // separate the spectra of the even and odd samples and combine them
+    for (size_t k = 0; k <= half; ++k)
+    {
+        complex<double> a = z[k % half], b = conj(z[(half - k) % half]);
+        complex<double> even = 0.5 * (a + b), odd = complex<double>(0, -0.5) * (a - b);
+        power[k] = norm(even + m_realTwiddles[k] * odd);
+    }
+}
+
+template <class InputType, class ElemType>
+SequenceDataPtr LogMelFilterbankTransformer::Apply(const InputType* input, size_t numberOfFrames, mt19937& rng) const
+{
+    auto result = make_shared<FilterbankSequenceData<ElemType>>();
+    result->m_features.resize(numberOfFrames * m_numFilters);
+    result->m_numberOfSamples = (uint32_t)numberOfFrames;
+
+    double gain = m_minGain == m_maxGain ? m_minGain : uniform_real_distribution<double>(m_minGain, m_maxGain)(rng);
+    normal_distribution<double> noise;
+
+    vector<double> x(m_windowLength), power(m_fftSize / 2 + 1);
+    vector<complex<double>> z(m_fftSize / 2);
+    for (size_t t = 0; t < numberOfFrames; ++t)
+    {
+        const InputType* samples = input + t * m_windowLength;
+        for (size_t i = 0; i < m_windowLength; ++i)
+            x[i] = samples[i] * gain + (m_dither != 0 ? m_dither * noise(rng) : 0.0);
+
+        if (m_removeDcOffset)
+        {
+            double mean = accumulate(x.begin(), x.end(), 0.0) / m_windowLength;
+            for (auto& v : x)
+                v -= mean;
+        }
+
+        for (size_t i = m_windowLength - 1; i > 0; --i)
+            x[i] -= m_preemphasis * x[i - 1];
+        x[0] -= m_preemphasis * x[0];
+
+        // pack the windowed samples pairwise into the complex buffer, padded with zeros
+        fill(z.begin(), z.end(), complex<double>());
+        for (size_t i = 0; i < m_windowLength; ++i)
+        {
+            double v = x[i] * m_window[i];
+            if (i % 2 == 0)
+                z[i / 2].real(v);
+            else
+                z[i / 2].imag(v);
+        }
+        PowerSpectrum(z, power.data());
+
+        ElemType* features = &result->m_features[t * m_numFilters];
+        for (size_t m = 0; m < m_numFilters; ++m)
+        {
+            const auto& weights = m_filterWeights[m];
+            double energy = 0;
+            for (size_t j = 0; j < weights.size(); ++j)
+                energy += weights[j] * power[m_filterStarts[m] + j];
+            features[m] = (ElemType)log(max(energy, (double)numeric_limits<float>::epsilon()));
+        }
+    }
+    return result;
+}
+
+SequenceDataPtr LogMelFilterbankTransformer::Transform(SequenceDataPtr sequence)
+{
+    unsigned int seed = GetSeed();
+    auto rng = m_rngs.pop_or_create([seed]() { return make_unique<mt19937>(seed); });
+
+    const void* input = sequence->GetDataBuffer();
+    size_t numberOfFrames = sequence->m_numberOfSamples;
+    SequenceDataPtr result;
+    if (m_inputStream.m_elementType == ElementType::tfloat)
+        result = m_precision == ElementType::tfloat ? Apply<float, float>((const float*)input, numberOfFrames, *rng) : Apply<float, double>((const float*)input, numberOfFrames, *rng);
+    else
+        result = m_precision == ElementType::tfloat ? Apply<double, float>((const double*)input, numberOfFrames, *rng) : Apply<double, double>((const double*)input, numberOfFrames, *rng);
+
+    m_rngs.push(move(rng));
+    result->m_key = sequence->m_key;
+    return result;
+}
+
+}}}
@@ -0,0 +1,81 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <random>
+#include <complex>
+#include "ConcStack.h"
+#include "TransformBase.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Computes log mel filterbank features from the analysis windows of the AudioDeserializer, on the reader threads.
+// Per window: optional gain (volume perturbation) and dither, DC removal, pre-emphasis, Hamming or Povey window,
+// power spectrum by a real FFT, triangular filters on the mel scale and the log. The definitions follow Kaldi's fbank.
+// The number of frames is not changed, so the features stay aligned with the labels.
+// Config: sampleRate (16000), numFilters (40), lowFrequency (20), highFrequency (0: Nyquist frequency),
+// preemphasis (0.97), dither (0), removeDcOffset (true), windowType ("hamming" or "povey"),
+// minGain and maxGain (1, a gain is drawn uniformly per sequence).
+class LogMelFilterbankTransformer : public TransformBase
+{
+public:
+    explicit LogMelFilterbankTransformer(const ConfigParameters& config);
+
+    // Sets up the FFT and the filters for the window length of the input stream.
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+
+private:
+    template <class InputType, class ElemType>
+    SequenceDataPtr Apply(const InputType* input, size_t numberOfFrames, std::mt19937& rng) const;
+
+    // Power spectrum of a real window of m_fftSize samples, in m_fftSize / 2 + 1 bins.
+    void PowerSpectrum(std::vector<std::complex<double>>& buffer, double* power) const;
+
+    double m_sampleRate;
+    size_t m_numFilters;
+    double m_lowFrequency;
+    double m_highFrequency;
+    double m_preemphasis;
+    double m_dither;
+    bool m_removeDcOffset;
+    std::wstring m_windowType;
+    double m_minGain;
+    double m_maxGain;
+
+    size_t m_windowLength;
+    size_t m_fftSize;
+    std::vector<double> m_window;
+
+    // Complex FFT of size m_fftSize / 2 that the real FFT is computed with.
+    std::vector<size_t> m_bitReversal;
+    std::vector<std::complex<double>> m_twiddles;     // exp(-2 pi i k / (m_fftSize / 2))
+    std::vector<std::complex<double>> m_realTwiddles; // exp(-2 pi i k / m_fftSize)
+
+    // Weights of the triangular filters, each starting at a power spectrum bin.
+    std::vector<size_t> m_filterStarts;
+    std::vector<std::vector<double>> m_filterWeights;
+
+    conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
+};
+
+// Default cast of the streams of this module. The deserializers and transforms provide the configured precision already.
+class NoCastTransformer : public TransformBase
+{
+public:
+    explicit NoCastTransformer(const ConfigParameters& config) : TransformBase(config)
+    {}
+
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override
+    {
+        return sequence;
+    }
+
+    using TransformBase::Transform;
+};
+
+}}}
@@ -18,12 +18,80 @@
 #include "DataWriter.h"
 #include "Config.h"
 #include "HTKMLFWriter.h"
+#include <mutex>
 #ifdef LEAKDETECT
 #include <vld.h> // for memory leak detection
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// HTKMLFArchive -- the utterances of one output appended to a single HTK file, instead of one file each
+// Creating millions of small files is what makes large feature-extraction runs slow. Close() patches the frame count
+// into the header and writes a TOC '<archive>.scp' with one line 'name=<archive>[firstFrame,lastFrame]' per utterance,
+// the form the HTK readers take. Utterances are added by the background writes, so they are listed in the order they
+// landed in the archive, which need not be the order of the output script.
+class HTKMLFArchive
+{
+    std::wstring m_path;
+    unsigned int m_sampPeriod;
+    std::mutex m_mutex;
+    std::unique_ptr<msra::asr::htkfeatwriter> m_writer; // opened with the first utterance, which determines the dimension
+    size_t m_numFrames;
+    std::vector<std::wstring> m_toc;
+    bool m_closed;
+
+public:
+    HTKMLFArchive(const std::wstring& path, unsigned int sampPeriod)
+        : m_path(path), m_sampPeriod(sampPeriod), m_numFrames(0), m_closed(false)
+    {
+    }
+
+    void Add(const std::wstring& name, const msra::dbn::matrix& feat)
+    {
+        if (feat.cols() == 0) // cannot be addressed as [first,last]
+        {
+            fprintf(stderr, "HTKMLFWriter: WARNING: skipping utterance %ls with no frames in archive %ls\n", name.c_str(), m_path.c_str());
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed)
+            LogicError("HTKMLFWriter: utterance %ls written to archive %ls after it was closed", name.c_str(), m_path.c_str());
+        if (!m_writer)
+        {
+            msra::files::make_intermediate_dirs(m_path);
+            m_writer.reset(new msra::asr::htkfeatwriter(m_path, "USER", feat.rows(), m_sampPeriod));
+        }
+        std::vector<float> v(feat.rows());
+        for (size_t j = 0; j < feat.cols(); j++)
+        {
+            for (size_t i = 0; i < feat.rows(); i++)
+                v[i] = feat(i, j);
+            m_writer->write(v);
+        }
+        m_toc.push_back(msra::strfun::wstrprintf(L"%ls=%ls[%d,%d]", name.c_str(), m_path.c_str(), (int) m_numFrames, (int) (m_numFrames + feat.cols() - 1)));
+        m_numFrames += feat.cols();
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed)
+            return;
+        m_closed = true;
+        if (!m_writer)
+            return;
+        m_writer->close(m_numFrames);
+        m_writer.reset();
+
+        const std::wstring tocPath = m_path + L".scp";
+        auto_file_ptr f(fopenOrDie(tocPath, L"wb"));
+        for (const auto& line : m_toc)
+            fprintfOrDie(f, "%ls\n", line.c_str());
+        fflushOrDie(f);
+        fprintf(stderr, "HTKMLFWriter: wrote %d utterances, %d frames to archive %ls\n", (int) m_toc.size(), (int) m_numFrames, m_path.c_str());
+    }
+};
+
 // Create a Data Writer
 //DATAWRITER_API IDataWriter* DataWriterFactory(void)
 
@@ -35,6 +103,7 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
     m_tempArraySize = 0;
 
     vector<wstring> scriptpaths;
+    vector<wstring> archivepaths;
     vector<wstring> filelist;
     size_t numFiles;
     size_t firstfilesonly = SIZE_MAX; // set to a lower value for testing
@@ -58,6 +127,10 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
         else
             RuntimeError("HTKMLFWriter::Init: writer needs to specify scpFile for output");
 
+        // optionally pack all utterances of this output into a single archive; the scp entries then only name them
+        wstring archivepath = thisOutput(L"archive", L"");
+        archivepaths.push_back(archivepath);
+
         outputNameToIdMap[outputNames[i]] = i;
         outputNameToDimMap[outputNames[i]] = udims[i];
         wstring type = thisOutput(L"type", "Real");
@@ -95,16 +168,44 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
     }
     outputFileIndex = 0;
     sampPeriod = 100000;
+
+    foreach_index (i, archivepaths)
+        outputArchives.push_back(archivepaths[i].empty() ? nullptr : make_shared<HTKMLFArchive>(archivepaths[i], sampPeriod));
+
+    // number of utterances that may be waiting to be written; 0 writes them synchronously
+    m_writeQueue.SetMaxPending(writerConfig(L"maxPendingWrites", (size_t) 8));
 }
 
 template <class ElemType>
 void HTKMLFWriter<ElemType>::Destroy()
 {
+    // this is called from a destructor, so errors can only be reported
+    try
+    {
+        Flush();
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "HTKMLFWriter::Destroy: writing the output failed: %s\n", e.what());
+    }
+    outputArchives.clear();
+
     delete[] m_tempArray;
     m_tempArray = nullptr;
     m_tempArraySize = 0;
 }
 
+// wait for the background writes, and finish the archives
+// No more data can be saved to an archive after this.
+template <class ElemType>
+void HTKMLFWriter<ElemType>::Flush()
+{
+    m_writeQueue.Flush();
+    for (auto& archive : outputArchives)
+        if (archive)
+            archive->Close();
+}
+
 template <class ElemType>
 void HTKMLFWriter<ElemType>::GetSections(std::map<std::wstring, SectionType, nocase_compare>& /*sections*/)
 {
@@ -129,7 +230,7 @@ bool HTKMLFWriter<ElemType>::SaveData(size_t /*recordStart*/, const std::map<std
         assert(outputData.GetNumRows() == dim);
         dim;
 
-        Save(outFile, outputData);
+        Save(outFile, outputData, outputArchives[id]);
     }
 
     outputFileIndex++;
@@ -138,9 +239,11 @@ bool HTKMLFWriter<ElemType>::SaveData(size_t /*recordStart*/, const std::map<std
 }
 
 template <class ElemType>
-void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& outputData)
+void HTKMLFWriter<ElemType>::Save(const std::wstring& outputFile, Matrix<ElemType>& outputData, const std::shared_ptr<HTKMLFArchive>& archive)
 {
-    msra::dbn::matrix output;
+    // the copy is owned by the write, since outputData is overwritten by the next minibatch
+    auto outputp = make_shared<msra::dbn::matrix>();
+    msra::dbn::matrix& output = *outputp;
     output.resize(outputData.GetNumRows(), outputData.GetNumCols());
     outputData.CopyToArray(m_tempArray, m_tempArraySize);
     ElemType* pValue = m_tempArray;
@@ -153,17 +256,27 @@ void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& ou
         }
     }
 
-    const size_t nansinf = output.countnaninf();
-    if (nansinf > 0)
-        fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output.cols());
-    // save it
-    msra::files::make_intermediate_dirs(outputFile);
-    msra::util::attempt(5, [&]()
-                        {
-                            msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
-                        });
-
-    fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output.cols(), outputFile.c_str());
+    const unsigned int period = sampPeriod;
+    m_writeQueue.Push([outputp, outputFile, archive, period]()
+    {
+        const msra::dbn::matrix& output = *outputp;
+        const size_t nansinf = output.countnaninf();
+        if (nansinf > 0)
+            fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output.cols());
+        // save it
+        if (archive)
+            archive->Add(outputFile, output);
+        else
+        {
+            msra::files::make_intermediate_dirs(outputFile);
+            msra::util::attempt(5, [&]()
+                                {
+                                    msra::asr::htkfeatwriter::write(outputFile, "USER", period, output);
+                                });
+        }
+
+        fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output.cols(), outputFile.c_str());
+    });
 }
 
 template <class ElemType>
@@ -7,17 +7,22 @@
 #pragma once
 #include "DataWriter.h"
 #include "ScriptableObjects.h"
+#include "AsyncWriteQueue.h"
 #include <map>
+#include <memory>
 #include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class HTKMLFArchive; // one HTK file holding all utterances of an output, see HTKMLFWriter.cpp
+
 template <class ElemType>
 class HTKMLFWriter : public IDataWriter
 {
 private:
     std::vector<size_t> outputDims;
     std::vector<std::vector<std::wstring>> outputFiles;
+    std::vector<std::shared_ptr<HTKMLFArchive>> outputArchives; // null for outputs written to one file per utterance
 
     std::vector<size_t> udims;
     std::map<std::wstring, size_t> outputNameToIdMap;
@@ -25,9 +30,10 @@ private:
     std::map<std::wstring, size_t> outputNameToTypeMap;
     unsigned int sampPeriod;
     size_t outputFileIndex;
-    void Save(std::wstring& outputFile, Matrix<ElemType>& outputData);
+    void Save(const std::wstring& outputFile, Matrix<ElemType>& outputData, const std::shared_ptr<HTKMLFArchive>& archive);
     ElemType* m_tempArray;
     size_t m_tempArraySize;
+    AsyncWriteQueue m_writeQueue; // file writes run in the background, so that the forward pass does not wait on the file system
 
     enum OutputTypes
     {
@@ -51,5 +57,6 @@ public:
     virtual bool SaveData(size_t recordStart, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t datasetSize, size_t byteVariableSized);
     virtual void SaveMapping(std::wstring saveId, const std::map<LabelIdType, LabelType>& labelMapping);
     virtual bool SupportMultiUtterances() const { return false; };
+    virtual void Flush();
 };
 } } }
@@ -526,6 +526,52 @@ void lattice::dedup()
     fprintf(stderr, "converted %lu lattices\n", (unsigned long)toclines.size());
 }
 
+// compile an archive for fast loading: the lattices are written as getlattice() returns them, in the compiled format
+// (lattice::fwritecompiled()) that archive::getlattice() reads from a memory mapping
+// Example command:
+// compilelatticearchive c:\smbrdebug\sw20_small.den.lats.toc c:\smbrdebug\sw20_small.den.lats.compiled
+/*static*/ void archive::compile(const std::wstring &intocpath, const std::wstring &outpath, const msra::asr::simplesenonehmm &hset)
+{
+    const auto &modelsymmap = hset.getsymmap();
+
+    const std::wstring tocpath = outpath + L".toc";
+    const std::wstring symlistpath = outpath + L".symlist";
+
+    std::vector<std::wstring> intocpaths(1, intocpath); // set of paths consisting of 1
+    msra::lattices::archive archive(intocpaths, modelsymmap);
+
+    // read the intocpath file once again to get the keys in original order
+    std::vector<char> textbuffer;
+    auto toclines = msra::files::fgetfilelines(intocpath, textbuffer);
+
+    msra::files::make_intermediate_dirs(outpath);
+    auto_file_ptr f(fopenOrDie(outpath, L"wb"));
+    auto_file_ptr ftoc(fopenOrDie(tocpath, L"wb"));
+    foreach_index (i, toclines)
+    {
+        const char *line = toclines[i];
+        const char *p = strchr(line, '=');
+        if (p == NULL)
+            RuntimeError("compile: invalid TOC line (no = sign): %s", line);
+        const std::wstring key = msra::strfun::utf16(std::string(line, p - line));
+
+        // fetch lattice  --this maps the units to the model and rebuilds the edges
+        lattice L;
+        archive.getlattice(key, L);
+
+        uint64_t offset = fgetpos(f);
+        L.fwritecompiled(f);
+        fprintfOrDie(ftoc, "%s=%s[%llu]\n", msra::strfun::utf8(key).c_str(), (i == 0) ? msra::strfun::utf8(outpath).c_str() : "", offset);
+    }
+    fflushOrDie(f);
+    fflushOrDie(ftoc);
+
+    // the units are stored in the order of the model's symbol table, so reading against the same model requires no mapping
+    writeunitmap(symlistpath, modelsymmap);
+
+    fprintf(stderr, "compiled %lu lattices\n", (unsigned long)toclines.size());
+}
+
 // ---------------------------------------------------------------------------
 // reading lattices from external formats (HTK lat, MLF)
 // ---------------------------------------------------------------------------
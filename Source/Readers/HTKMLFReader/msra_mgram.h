@@ -12,6 +12,7 @@
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <memory>
 #include <algorithm> // for various sort() calls
 #include <math.h>
 
@@ -25,6 +26,12 @@ class ILM // generic interface -- mostly the score() function
 {
 public:
     virtual double score(const int *mgram, int m) const = 0;
+    // score n m-grams at once; m-gram k is mgrams[k * m .. k * m + m - 1]
+    virtual void scorebatch(const int *mgrams, int m, size_t n, double *scores) const
+    {
+        for (size_t k = 0; k < n; k++)
+            scores[k] = score(mgrams + k * m, m);
+    }
     virtual bool oov(int w) const = 0; // needed for perplexity calculation
     // ... TODO (?): return true/false to indicate whether anything changed.
     // Intended as a signal to derived LMs that cache values.
@@ -505,6 +512,19 @@ public:
         return -1 + (int) w2id.size();
     }
 
+    // --- raw access to the levels (used to write the compiled format)
+
+    // internal id of entry i in level m
+    inline int id(int m, size_t i) const
+    {
+        return ids[m][i];
+    }
+    // index of the first child of entry i of level m in level m+1 (i = size(m) gives the end)
+    inline size_t first(int m, size_t i) const
+    {
+        return firsts[m][i];
+    }
+
     // map is indexed with a 'key'.
     // A key represents an m-gram by storing a pointer to the original array.
     // The key allows to remove predicted word (pop_w()) or history (pop_h()).
@@ -1166,6 +1186,7 @@ protected:
     mgram_data<float> logP; // [M+1][i] probabilities
     mgram_data<float> logB; // [M][i] back-off weights (stored for histories only)
     friend class CMGramLMIterator;
+    friend class CMGramLMCompiled; // for writing the compiled format
 
     // diagnostics of previous score() call
     mutable int longestMGramFound;   // longest m-gram (incl. predicted token) found
@@ -1964,4 +1985,448 @@ public:
     }
 };
 
+// ===========================================================================
+// CMGramLMCompiled -- a back-off M-gram language model in compiled binary
+// format, used in place from a read-only memory mapping of the file
+// ===========================================================================
+
+// The compiled format is written from a CMGramLM that was read from an ARPA
+// file. It stores the mgram_map levels as flat arrays of 32-bit ids and
+// indexes (instead of int24_vectors that have to be built on loading), and
+// the scores quantized to 16-bit codes into a codebook per level. Each
+// section is padded to 8 bytes, such that all arrays can be accessed directly
+// in the mapping. Thus loading is instantaneous, and processes that load the
+// same model share its memory pages. Lookups are the same as in CMGramLM.
+//
+// Layout (little endian):
+//  - header
+//  - vocabulary: numsymbols zero-terminated strings, in order of internal ids
+//  - for each level m = 1..M:
+//     - uint64 number of m-grams n
+//     - int ids[n]                   internal ids, sorted within each history
+//     - unsigned int lookup[numsymbols]  (level 1 only) id -> index of unigram, or nindex
+//     - unsigned int firsts[n + 1]   (m < M only) first child of each m-gram in level m+1
+//     - logP: uint64 codebook size K, float codebook[K], unsigned short codes[n]
+//     - logB: same as logP           (m < M only)
+
+class CMGramLMCompiled : public ILM
+{
+    typedef unsigned int index_t;
+    static const index_t nindex = (index_t) -1; // invalid index
+    static const unsigned int compiledversion = 1;
+    static const size_t maxcodes = 65536; // codebook size for 16-bit codes
+
+    struct header
+    {
+        char tag[4];              // "CLM "
+        unsigned int version;     // compiledversion
+        unsigned int M;           // order, e.g. 3 for trigram
+        unsigned int numsymbols;  // LM vocabulary size
+        unsigned int symbolbytes; // size of the vocabulary section
+        float zerogramlogP;       // score of OOVs
+    };
+
+    // a level of the tree, pointing into the mapping
+    struct level
+    {
+        size_t size;                      // number of m-grams
+        const int *ids;                   // [i] internal id of m-gram i
+        const index_t *firsts;            // [i] first child of m-gram i in next level, [i+1] its end (not for level M)
+        const float *logPcodebook;        // [code] -> logP
+        const unsigned short *logPcodes;  // [i] -> code of logP of m-gram i
+        const float *logBcodebook;        // [code] -> logB (not for level M)
+        const unsigned short *logBcodes;  // [i] -> code of logB of m-gram i (not for level M)
+    };
+
+    std::unique_ptr<mappedfile> mapping;
+    int M;                      // e.g. M=3 for trigram
+    float zerogramlogP;         // score of OOVs
+    std::vector<level> levels;  // [m] for m = 1..M ([0] = zerogram, not used)
+    const index_t *level1lookup; // [id] -> index in level 1
+    size_t numsymbols;           // size of level1lookup
+    std::vector<int> w2id;       // w -> id, for the user's symbol map
+
+    // diagnostics of previous score() call
+    mutable int longestMGramFound;   // longest m-gram (incl. predicted token) found
+    mutable int longestHistoryFound; // longest history (excl. predicted token) found
+
+    static void fail(const char *msg)
+    {
+        RuntimeError("CMGramLMCompiled::%s", msg);
+    }
+
+    inline int map(int w) const
+    {
+        if (w < 0 || w >= (int) w2id.size())
+            return -1;
+        else
+            return w2id[w];
+    }
+
+    // get index for 'id' in level m+1, as a child of index i in level m (see mgram_map::find_child())
+    inline index_t find_child(int m, index_t i, int id) const
+    {
+        if (id < 0)
+            return nindex;
+        if (m == 0)
+            return (size_t) id < numsymbols ? level1lookup[id] : nindex;
+        const index_t *f = levels[m].firsts;
+        index_t beg = f[i];
+        index_t end = f[i + 1];
+        const int *ids_m1 = levels[m + 1].ids;
+        while (beg < end)
+        {
+            i = (beg + end) / 2;
+            int v = ids_m1[i];
+            if (id == v)
+                return i; // found it
+            else if (id < v)
+                end = i; // id is left of i
+            else
+                beg = i + 1; // id is right of i
+        }
+        return nindex; // not found
+    }
+
+    inline float logP(int m, index_t i) const
+    {
+        const level &l = levels[m];
+        return l.logPcodebook[l.logPcodes[i]];
+    }
+
+    inline float logB(int m, index_t i) const
+    {
+        if (m == 0)
+            return 0.0f; // no extra penalty for backing off to the zerogram
+        const level &l = levels[m];
+        return l.logBcodebook[l.logBcodes[i]];
+    }
+
+    // locate the histories of an m-gram for each back-off step k,
+    // i.e. hist[k] = index of history mgram[k..m-2] in level m-1-k, or nindex
+    void findhistories(const int *mgram, int m, index_t *hist) const
+    {
+        for (int k = 0; k < m; k++)
+        {
+            index_t i = 0;
+            for (int n = k; n < m - 1 && i != nindex; n++)
+                i = find_child(n - k, i, map(mgram[n]));
+            hist[k] = i;
+        }
+    }
+
+    // compute an m-gram score from the histories located by findhistories()
+    double score(const int *mgram, int m, const index_t *hist) const
+    {
+        longestHistoryFound = 0; // (diagnostics)
+
+        double totalLogB = 0.0; // accumulated back-off
+        const int id = map(mgram[m - 1]);
+        for (int k = 0; k < m; k++)
+        {
+            const int n = m - k; // order of current key
+            if (hist[k] == nindex)
+                continue; // history not found -> fall back
+
+            if (n - 1 > longestHistoryFound)
+                longestHistoryFound = n - 1;
+
+            // full m-gram found -> return it
+            const index_t i = find_child(n - 1, hist[k], id);
+            if (i != nindex)
+            {
+                longestMGramFound = n;
+                return totalLogB + logP(n, i);
+            }
+
+            // history found but predicted word not -> back-off
+            totalLogB += logB(n - 1, hist[k]);
+        }
+        longestMGramFound = 0;
+        return totalLogB + zerogramlogP; // zerogram always considered found
+    }
+
+    // return a pointer to an array of n elements at p and advance p behind its padding
+    template <class T>
+    const T *readarray(const char *&p, size_t n) const
+    {
+        const size_t bytes = n * sizeof(T);
+        const size_t padded = (bytes + 7) / 8 * 8;
+        if ((size_t) (mapping->end() - p) < padded)
+            fail("read: unexpected end of file");
+        const T *a = reinterpret_cast<const T *>(p);
+        p += padded;
+        return a;
+    }
+
+    // read a codebook and the codes of n values
+    void readquantized(const char *&p, size_t n, const float *&codebook, const unsigned short *&codes) const
+    {
+        const size_t numcodes = (size_t) *readarray<uint64_t>(p, 1);
+        if (numcodes > maxcodes || (numcodes == 0 && n > 0))
+            fail("read: invalid codebook size");
+        codebook = readarray<float>(p, numcodes);
+        codes = readarray<unsigned short>(p, n);
+    }
+
+    static void writearray(FILE *f, const void *data, size_t bytes)
+    {
+        static const char padding[8] = {0};
+        if (bytes > 0)
+            fwriteOrDie(data, 1, bytes, f);
+        if (bytes % 8 != 0)
+            fwriteOrDie(padding, 1, 8 - bytes % 8, f);
+    }
+
+    template <class T>
+    static void writearray(FILE *f, const std::vector<T> &v)
+    {
+        writearray(f, v.data(), v.size() * sizeof(T));
+    }
+
+    // quantize values to codes into a codebook.
+    // If there are no more distinct values than codes, the codebook holds all of them, i.e. quantization is lossless.
+    // Otherwise the distinct values are split in order into bins of equal count, each represented by its mean.
+    static void writequantized(FILE *f, const std::vector<float> &values)
+    {
+        std::vector<float> codebook(values);
+        std::sort(codebook.begin(), codebook.end());
+        codebook.erase(std::unique(codebook.begin(), codebook.end()), codebook.end());
+        if (codebook.size() > maxcodes)
+        {
+            std::vector<float> distinct;
+            distinct.swap(codebook);
+            codebook.resize(maxcodes);
+            for (size_t k = 0; k < maxcodes; k++)
+            {
+                const size_t beg = distinct.size() * k / maxcodes;
+                const size_t end = distinct.size() * (k + 1) / maxcodes;
+                double sum = 0.0;
+                for (size_t j = beg; j < end; j++)
+                    sum += distinct[j];
+                codebook[k] = (float) (sum / (end - beg));
+            }
+        }
+
+        // code of each value is its nearest codebook entry
+        std::vector<unsigned short> codes(values.size());
+        foreach_index (i, values)
+        {
+            size_t k = std::lower_bound(codebook.begin(), codebook.end(), values[i]) - codebook.begin();
+            if (k == codebook.size() || (k > 0 && values[i] - codebook[k - 1] < codebook[k] - values[i]))
+                k--;
+            codes[i] = (unsigned short) k;
+        }
+
+        const uint64_t numcodes = codebook.size();
+        writearray(f, &numcodes, sizeof(numcodes));
+        writearray(f, codebook);
+        writearray(f, codes);
+    }
+
+public:
+    CMGramLMCompiled()
+        : M(-1), zerogramlogP(0.0f), level1lookup(NULL), numsymbols(0), longestMGramFound(0), longestHistoryFound(0)
+    {
+    } // needs explicit initialization through read()
+
+    // write an LM in compiled format
+    static void write(const CMGramLM &lm, const std::wstring &pathname)
+    {
+        const mgram_map &map = lm.map;
+        auto_file_ptr f(fopenOrDie(pathname, L"wb"));
+
+        // vocabulary in order of internal ids
+        std::vector<char> symbols;
+        for (int id = 0; id < (int) lm.lmSymbols.size(); id++)
+        {
+            const char *sym = lm.idToSymbol(id);
+            symbols.insert(symbols.end(), sym, sym + strlen(sym) + 1);
+        }
+
+        header h;
+        memcpy(h.tag, "CLM ", sizeof(h.tag));
+        h.version = compiledversion;
+        h.M = lm.M;
+        h.numsymbols = (unsigned int) lm.lmSymbols.size();
+        h.symbolbytes = (unsigned int) symbols.size();
+        h.zerogramlogP = lm.logP[mgram_map::coord()];
+        writearray(f, &h, sizeof(h));
+        writearray(f, symbols);
+
+        for (int m = 1; m <= lm.M; m++)
+        {
+            const uint64_t n = map.size(m);
+            writearray(f, &n, sizeof(n));
+
+            std::vector<int> ids((size_t) n);
+            foreach_index (i, ids)
+                ids[i] = map.id(m, i);
+            writearray(f, ids);
+
+            if (m == 1)
+            {
+                std::vector<index_t> lookup(lm.lmSymbols.size(), (index_t) nindex);
+                foreach_index (i, ids)
+                    lookup[ids[i]] = (index_t) i;
+                writearray(f, lookup);
+            }
+
+            if (m < lm.M)
+            {
+                std::vector<index_t> firsts((size_t) n + 1);
+                foreach_index (i, firsts)
+                    firsts[i] = (index_t) map.first(m, i);
+                writearray(f, firsts);
+            }
+
+            std::vector<float> values((size_t) n);
+            foreach_index (i, values)
+                values[i] = lm.logP[mgram_map::coord(m, i)];
+            writequantized(f, values);
+
+            if (m < lm.M)
+            {
+                foreach_index (i, values)
+                    values[i] = lm.logB[mgram_map::coord(m, i)];
+                writequantized(f, values);
+            }
+        }
+        fflushOrDie(f);
+    }
+
+    // map an LM in compiled format.
+    // The 'userSymMap' defines the vocabulary space used in score(), like in CMGramLM::read().
+    // If 'filterVocabulary' then words not in userSymMap are OOVs.
+    // Otherwise the userSymMap is updated with the words from the LM.
+    template <class SYMMAP>
+    void read(const std::wstring &pathname, SYMMAP &userSymMap, bool filterVocabulary)
+    {
+        fprintf(stderr, "read: mapping %ls", pathname.c_str());
+        mapping.reset(new mappedfile(pathname));
+        const char *p = mapping->begin();
+
+        const header &h = *readarray<header>(p, 1);
+        if (memcmp(h.tag, "CLM ", sizeof(h.tag)) != 0)
+            fail("read: not a compiled LM file");
+        if (h.version != compiledversion)
+            fail("read: unsupported version of compiled LM file");
+        M = (int) h.M;
+        numsymbols = h.numsymbols;
+        zerogramlogP = h.zerogramlogP;
+
+        // establish mapping of word ids from user to LM space
+        const char *sym = readarray<char>(p, h.symbolbytes);
+        const char *symend = sym + h.symbolbytes;
+        w2id.assign(userSymMap.size(), -1);
+        for (int id = 0; id < (int) numsymbols; id++)
+        {
+            const char *next = (const char *) memchr(sym, 0, symend - sym);
+            if (next == NULL)
+                fail("read: vocabulary section corrupted");
+            int w = filterVocabulary ? userSymMap.sym2existingId(sym) : userSymMap.sym2id(sym);
+            if (w >= 0)
+            {
+                if (w >= (int) w2id.size())
+                    w2id.resize(w + 1, -1);
+                w2id[w] = id;
+            }
+            sym = next + 1;
+        }
+
+        // the levels
+        levels.assign(M + 1, level());
+        for (int m = 1; m <= M; m++)
+        {
+            level &l = levels[m];
+            l.size = (size_t) *readarray<uint64_t>(p, 1);
+            l.ids = readarray<int>(p, l.size);
+            if (m == 1)
+                level1lookup = readarray<index_t>(p, numsymbols);
+            l.firsts = NULL;
+            if (m < M)
+                l.firsts = readarray<index_t>(p, l.size + 1);
+            readquantized(p, l.size, l.logPcodebook, l.logPcodes);
+            l.logBcodebook = NULL;
+            l.logBcodes = NULL;
+            if (m < M)
+                readquantized(p, l.size, l.logBcodebook, l.logBcodes);
+
+            if (m > 1 && levels[m - 1].firsts[levels[m - 1].size] != l.size)
+                fail("read: inconsistent level sizes");
+            fprintf(stderr, ", %d %d-grams", (int) l.size, m);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    // -----------------------------------------------------------------------
+    // score() -- compute an m-gram score (incl. back-off and fallback)
+    // -----------------------------------------------------------------------
+    // mgram[m-1] = word to predict, tokens before that are history
+    virtual double score(const int *mgram, int m) const
+    {
+        if (m > M) // truncate to the m-gram length supported by this
+        {
+            mgram += m - M;
+            m = M;
+        }
+        std::vector<index_t> hist(m);
+        findhistories(mgram, m, hist.data());
+        return score(mgram, m, hist.data());
+    }
+
+    // score n m-grams at once.
+    // The histories are looked up only once for consecutive m-grams that share them, e.g. when scoring all words given a history.
+    virtual void scorebatch(const int *mgrams, int m, size_t n, double *scores) const
+    {
+        const int stride = m;
+        const int offset = m > M ? m - M : 0; // truncate to the m-gram length supported by this
+        m -= offset;
+        std::vector<index_t> hist(m);
+        const int *prevmgram = NULL;
+        for (size_t k = 0; k < n; k++)
+        {
+            const int *mgram = mgrams + k * stride + offset;
+            if (!prevmgram || !std::equal(mgram, mgram + m - 1, prevmgram))
+                findhistories(mgram, m, hist.data());
+            scores[k] = score(mgram, m, hist.data());
+            prevmgram = mgram;
+        }
+    }
+
+    // test for OOV word (OOV w.r.t. LM)
+    virtual bool oov(int w) const
+    {
+        return map(w) < 0;
+    }
+
+    virtual void adapt(const int *, size_t)
+    {
+    } // this LM does not adapt
+
+    virtual IIter *iter(int, int) const
+    {
+        fail("iter: not supported for compiled models, use the ARPA model instead");
+        return NULL;
+    }
+
+    virtual int order() const
+    {
+        return M;
+    }
+    virtual size_t size(int m) const
+    {
+        return m == 0 ? 1 : levels[m].size;
+    }
+
+    virtual int getLastLongestHistoryFound() const
+    {
+        return longestHistoryFound;
+    }
+    virtual int getLastLongestMGramFound() const
+    {
+        return longestMGramFound;
+    }
+};
+
 }; }; // namespace
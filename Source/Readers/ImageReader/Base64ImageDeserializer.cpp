@@ -53,8 +53,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void GetSequence(size_t sequenceIndex, std::vector<SequenceDataPtr>& result) override
         {
-            const size_t innerSequenceIndex = m_deserializer.m_multiViewCrop ? sequenceIndex / ImageDeserializerBase::NumMultiViewCopies : sequenceIndex;
-            const size_t copyId = m_deserializer.m_multiViewCrop ? sequenceIndex % ImageDeserializerBase::NumMultiViewCopies : 0;
+            const size_t innerSequenceIndex = sequenceIndex / m_deserializer.NumCopiesPerImage();
+            const size_t copyId = sequenceIndex % m_deserializer.NumCopiesPerImage();
 
             const auto& sequence = m_descriptor.m_sequences[innerSequenceIndex];
             const size_t offset = sequence.OffsetInChunk();
@@ -111,7 +111,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             }
             else
             {
-                image = cv::imdecode(decodedImage, m_deserializer.m_grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+                image = DecodeImage(reinterpret_cast<const unsigned char*>(decodedImage.data()), decodedImage.size(), m_deserializer.m_grayscale, m_deserializer.m_decodeMinSide);
             }
 
             m_deserializer.PopulateSequenceData(image, classId, copyId, sequence.m_key, result);
@@ -158,15 +158,17 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     {
         const auto& index = m_indexer->GetIndex();
         // In case of multi crop the deserializer provides the same sequence NumMultiViewCopies times.
-        size_t sequencesPerInitialSequence = m_multiViewCrop ? ImageDeserializerBase::NumMultiViewCopies : 1;
+        // With multiViewSequence it provides each sequence once, with NumMultiViewCopies samples.
+        size_t sequencesPerInitialSequence = NumCopiesPerImage();
         ChunkDescriptions result;
-        result.reserve(index.m_chunks.size() * sequencesPerInitialSequence);
+        result.reserve(index.m_chunks.size());
         for (auto const& chunk : index.m_chunks)
         {
             auto c = std::make_shared<ChunkDescription>();
             c->m_id = chunk.m_id;
             assert(chunk.m_numberOfSamples == chunk.m_numberOfSequences);
-            c->m_numberOfSamples = c->m_numberOfSequences = chunk.m_numberOfSequences * sequencesPerInitialSequence;
+            c->m_numberOfSequences = chunk.m_numberOfSequences * sequencesPerInitialSequence;
+            c->m_numberOfSamples = c->m_numberOfSequences * NumSamplesPerImage();
             result.push_back(c);
         }
         return result;
@@ -176,7 +178,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     {
         const auto& index = m_indexer->GetIndex();
         const auto& chunk = index.m_chunks[chunkId];
-        size_t sequenceCopies = m_multiViewCrop ? NumMultiViewCopies : 1;
+        size_t sequenceCopies = NumCopiesPerImage();
         result.reserve(sequenceCopies * chunk.m_sequences.size());
         size_t currentId = 0;
         for (uint32_t indexInChunk = 0; indexInChunk < chunk.m_sequences.size(); ++indexInChunk)
@@ -188,7 +190,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 result.push_back(
                 {
                     currentId,
-                    s.m_numberOfSamples,
+                    s.m_numberOfSamples * NumSamplesPerImage(),
                     chunkId,
                     s.m_key
                 });
@@ -208,21 +210,20 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     {
         const auto& index = m_indexer->GetIndex();
 
-        const auto& keys = index.m_keyToSequenceInChunk;
-        auto sequenceLocation = keys.find(key.m_sequence);
-        if (sequenceLocation == keys.end())
+        std::pair<uint32_t, uint32_t> sequenceLocation;
+        if (!index.m_keyToSequenceInChunk.TryGet(key.m_sequence, sequenceLocation))
             return false;
 
-        assert(sequenceLocation->second.first < index.m_chunks.size());
-        const auto& chunk = index.m_chunks[sequenceLocation->second.first];
+        assert(sequenceLocation.first < index.m_chunks.size());
+        const auto& chunk = index.m_chunks[sequenceLocation.first];
 
-        assert(sequenceLocation->second.second < chunk.m_sequences.size());
-        const auto sequence = chunk.m_sequences[sequenceLocation->second.second];
+        assert(sequenceLocation.second < chunk.m_sequences.size());
+        const auto sequence = chunk.m_sequences[sequenceLocation.second];
 
-        result.m_chunkId = sequenceLocation->second.first;
-        result.m_indexInChunk = sequenceLocation->second.second;
+        result.m_chunkId = sequenceLocation.first;
+        result.m_indexInChunk = sequenceLocation.second;
         result.m_key = sequence.m_key;
-        result.m_numberOfSamples = sequence.m_numberOfSamples;
+        result.m_numberOfSamples = sequence.m_numberOfSamples * NumSamplesPerImage();
         return true;
     }
 
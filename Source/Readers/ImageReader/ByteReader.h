@@ -32,20 +32,22 @@ public:
 class FileByteReader : public ByteReader
 {
 public:
-    FileByteReader(const std::string& expandDirectory) : m_expandDirectory(expandDirectory)
+    FileByteReader(const std::string& expandDirectory, int decodeMinSide = 0)
+        : m_expandDirectory(expandDirectory), m_decodeMinSide(decodeMinSide)
     {}
 
     void Register(const MultiMap&) override {}
     cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
 
     std::string m_expandDirectory;
+    int m_decodeMinSide;
 };
 
 #ifdef USE_ZIP
 class ZipByteReader : public ByteReader
 {
 public:
-    ZipByteReader(const std::string& zipPath);
+    ZipByteReader(const std::string& zipPath, int decodeMinSide = 0);
 
     void Register(const std::map<std::string, std::vector<size_t>>& sequences) override;
     cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
@@ -55,6 +57,7 @@ private:
     ZipPtr OpenZip();
 
     std::string m_zipPath;
+    int m_decodeMinSide;
     conc_stack<ZipPtr> m_zips;
     std::unordered_map<size_t, std::pair<zip_uint64_t, zip_uint64_t>> m_seqIdToIndex;
     conc_stack<std::vector<unsigned char>> m_workspace;
@@ -15,6 +15,7 @@
 #include "ImageTransformers.h"
 #include "CorpusDescriptor.h"
 #include "Base64ImageDeserializer.h"
+#include "ImageShardDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -45,6 +46,8 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
         *deserializer = new ImageDataDeserializer(corpus, deserializerConfig, primary);
     else if (type == L"Base64ImageDeserializer")
         *deserializer = new Base64ImageDeserializer(corpus, deserializerConfig, primary);
+    else if (type == L"ImageShardDeserializer")
+        *deserializer = new ImageShardDeserializer(corpus, deserializerConfig, primary);
     else
         // Unknown type.
         return false;
@@ -70,6 +73,8 @@ extern "C" DATAREADER_API bool CreateTransformer(Transformer** transformer, cons
         *transformer = new TransposeTransformer(config);
     else if (type == L"Cast")
         *transformer = new CastTransformer(config);
+    else if (type == L"DeviceAugment")
+        *transformer = new DeviceAugmentTransformer(config);
     else
         // Unknown type.
         return false;
@@ -72,6 +72,7 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     m_streams = configHelper.GetStreams();
     assert(m_streams.size() == 2);
     m_grayscale = configHelper.UseGrayscale();
+    m_decodeMinSide = config(L"decodeMinSide", 0);
     const auto& label = m_streams[configHelper.GetLabelStreamId()];
     const auto& feature = m_streams[configHelper.GetFeatureStreamId()];
 
@@ -117,7 +118,7 @@ ChunkDescriptions ImageDataDeserializer::GetChunkDescriptions()
     {
         auto chunk = std::make_shared<ChunkDescription>();
         chunk->m_id = s.m_chunkId;
-        chunk->m_numberOfSamples = 1;
+        chunk->m_numberOfSamples = s.m_numberOfSamples;
         chunk->m_numberOfSequences = 1;
         result.push_back(chunk);
     }
@@ -141,9 +142,9 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
 
     // Creating the default reader with expanded directory to the map file.
     auto mapFileDirectory = ExtractDirectory(mapPath);
-    m_defaultReader = make_unique<FileByteReader>(mapFileDirectory);
+    m_defaultReader = make_unique<FileByteReader>(mapFileDirectory, m_decodeMinSide);
 
-    size_t numberOfCopies = isMultiCrop ? ImageDeserializerBase::NumMultiViewCopies : 1;
+    size_t numberOfCopies = isMultiCrop && !m_multiViewSequence ? ImageDeserializerBase::NumMultiViewCopies : 1;
     static_assert(ImageDeserializerBase::NumMultiViewCopies < std::numeric_limits<uint8_t>::max(), "Do not support more than 256 copies.");
 
     size_t curId = 0;
@@ -151,7 +152,7 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
     PathReaderMap knownReaders;
     ReaderSequenceMap readerSequences;
     ImageSequenceDescription description;
-    description.m_numberOfSamples = 1;
+    description.m_numberOfSamples = NumSamplesPerImage();
 
     Timer timer;
     timer.Start();
@@ -263,7 +264,7 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
     auto r = knownReaders.find(containerPath);
     if (r == knownReaders.end())
     {
-        reader = std::make_shared<ZipByteReader>(containerPath);
+        reader = std::make_shared<ZipByteReader>(containerPath, m_decodeMinSide);
         knownReaders[containerPath] = reader;
         readerSequences[containerPath] = MultiMap();
     }
@@ -297,7 +298,25 @@ cv::Mat FileByteReader::Read(size_t, const std::string& seqPath, bool grayscale)
     assert(!seqPath.empty());
     auto path = Expand3Dots(seqPath, m_expandDirectory);
 
-    return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    if (m_decodeMinSide == 0)
+        return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+
+    // The header is needed to choose the decoding resolution, so the file is read here instead of by OpenCV.
+    auto file = std::shared_ptr<FILE>(fopen(path.c_str(), "rb"), [](FILE* f) { if (f) fclose(f); });
+    if (!file)
+        return cv::Mat();
+
+    if (fseek(file.get(), 0, SEEK_END) != 0)
+        return cv::Mat();
+    long size = ftell(file.get());
+    if (size <= 0 || fseek(file.get(), 0, SEEK_SET) != 0)
+        return cv::Mat();
+
+    std::vector<unsigned char> contents(size);
+    if (fread(contents.data(), 1, contents.size(), file.get()) != contents.size())
+        return cv::Mat();
+
+    return DecodeImage(contents.data(), contents.size(), grayscale, m_decodeMinSide);
 }
 
 bool ImageDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
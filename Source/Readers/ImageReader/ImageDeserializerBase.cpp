@@ -18,7 +18,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     ImageDeserializerBase::ImageDeserializerBase() 
         : DataDeserializerBase(true),
           m_precision(ElementType::tfloat),
-          m_grayscale(false), m_verbosity(0), m_multiViewCrop(false)
+          m_grayscale(false), m_decodeMinSide(0), m_verbosity(0), m_multiViewCrop(false), m_multiViewSequence(false)
     {}
 
     ImageDeserializerBase::ImageDeserializerBase(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary)
@@ -68,9 +68,22 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         m_grayscale = config(L"grayscale", false);
 
+        // Crop and scale transforms typically reduce images to a fraction of their resolution,
+        // decoding at that resolution instead saves most of the decoding time.
+        m_decodeMinSide = config(L"decodeMinSide", 0);
+        if (m_decodeMinSide < 0)
+            InvalidArgument("'decodeMinSide' must not be negative.");
+
         // TODO: multiview should be done on the level of randomizer/transformers - it is responsiblity of the
         // TODO: randomizer to collect how many copies each transform needs and request same sequence several times.
         m_multiViewCrop = config(L"multiViewCrop", false);
+
+        // For evaluation, the views of an image can be one sequence instead: the image is decoded once, the Crop transform
+        // with cropType=multiview10 makes the views, and the network averages its output over them, e.g. with
+        // Sequence::ReduceSum(). The labels stay one sample per image.
+        m_multiViewSequence = config(L"multiViewSequence", false);
+        if (m_multiViewSequence && !m_multiViewCrop)
+            InvalidArgument("'multiViewSequence' requires 'multiViewCrop'.");
     }
 
     void ImageDeserializerBase::PopulateSequenceData(
@@ -98,7 +111,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             imageData->m_sampleLayout = std::make_shared<TensorShape>(dimensions.AsTensorShape(HWC));
             imageData->m_copyIndex = static_cast<uint8_t>(copyId);
             imageData->m_image = image;
-            imageData->m_numberOfSamples = 1;
+            imageData->m_numberOfSamples = NumSamplesPerImage(); // the views of multiViewSequence are made by the Crop transform
             imageData->m_elementType = dataType;
             imageData->m_isValid = true;
             imageData->m_key = sequenceKey;
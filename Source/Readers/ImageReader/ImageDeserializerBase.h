@@ -43,12 +43,31 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // Flag whether images shall be loaded in grayscale.
         bool m_grayscale;
 
+        // If > 0, JPEG images are decoded at a reduced resolution with the shorter side not below this (see DecodeImage()).
+        int m_decodeMinSide;
+
         // Verbosity.
         int m_verbosity;
 
         // Flag indicating whether to generate images for multi crop.
         bool m_multiViewCrop;
 
+        // Flag indicating whether the views of multi crop are the samples of one sequence per image, which is decoded
+        // once, instead of separate sequences.
+        bool m_multiViewSequence;
+
+        // Number of sequences provided for each image.
+        size_t NumCopiesPerImage() const
+        {
+            return m_multiViewCrop && !m_multiViewSequence ? NumMultiViewCopies : 1;
+        }
+
+        // Number of samples of the sequence of an image.
+        uint32_t NumSamplesPerImage() const
+        {
+            return m_multiViewSequence ? NumMultiViewCopies : 1;
+        }
+
         // Corpus descriptor.
         CorpusDescriptorPtr m_corpus;
     };
@@ -0,0 +1,254 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <opencv2/opencv.hpp>
+#include "ImageShardDeserializer.h"
+#include "ImageTransformers.h"
+#include "ReaderUtil.h"
+#include "ReaderConstants.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+    static const char s_shardMagic[8] = { 'C', 'N', 'T', 'K', 'I', 'M', 'G', 'S' };
+    static const uint32_t s_shardVersion = 1;
+    static const size_t s_shardHeaderSize = sizeof(s_shardMagic) + 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+    // A chunk holds the records of consecutive images, read with a single read.
+    class ImageShardDeserializer::ImageChunk : public Chunk, public std::enable_shared_from_this<ImageChunk>
+    {
+        ImageShardDeserializer& m_deserializer;
+        size_t m_firstSequence;   // index into m_deserializer.m_records
+        size_t m_firstRecord;     // index of the first record in m_buffer
+        std::vector<unsigned char> m_buffer;
+        AsyncFileReader::RequestPtr m_read; // with asyncIO, the read of the records instead of m_buffer
+
+        const unsigned char* Data()
+        {
+            return m_read ? reinterpret_cast<const unsigned char*>(m_read->Wait()) : m_buffer.data();
+        }
+
+    public:
+        ImageChunk(ChunkIdType chunkId, ImageShardDeserializer& parent) : m_deserializer(parent)
+        {
+            const auto& records = m_deserializer.m_records;
+            m_firstSequence = chunkId * m_deserializer.m_recordsPerChunk;
+            size_t lastSequence = std::min(m_firstSequence + m_deserializer.m_recordsPerChunk, records.size()) - 1;
+            m_firstRecord = records[m_firstSequence].m_index;
+            size_t numberOfRecords = records[lastSequence].m_index - m_firstRecord + 1;
+            int64_t offset = s_shardHeaderSize + m_firstRecord * m_deserializer.m_recordSize;
+
+            if (m_deserializer.m_asyncFile)
+            {
+                // The first sequence waits for the read.
+                m_read = m_deserializer.m_asyncFile->Read(offset, numberOfRecords * m_deserializer.m_recordSize);
+                return;
+            }
+
+            // Let's see if the open descriptor has problems.
+            if (ferror(m_deserializer.m_dataFile.get()) != 0)
+                m_deserializer.m_dataFile.reset(fopenOrDie(m_deserializer.m_fileName.c_str(), L"rbS"), [](FILE* f) { if (f) fclose(f); });
+
+            int rc = _fseeki64(m_deserializer.m_dataFile.get(), offset, SEEK_SET);
+            if (rc)
+                RuntimeError("Error seeking to position '%" PRId64 "' in the input file '%ls', error code '%d'", offset, m_deserializer.m_fileName.c_str(), rc);
+
+            m_buffer.resize(numberOfRecords * m_deserializer.m_recordSize);
+            freadOrDie(m_buffer.data(), m_buffer.size(), 1, m_deserializer.m_dataFile.get());
+        }
+
+        void GetSequence(size_t sequenceIndex, std::vector<SequenceDataPtr>& result) override
+        {
+            const size_t innerSequenceIndex = sequenceIndex / m_deserializer.NumCopiesPerImage();
+            const size_t copyId = sequenceIndex % m_deserializer.NumCopiesPerImage();
+
+            const auto& record = m_deserializer.m_records[m_firstSequence + innerSequenceIndex];
+            const unsigned char* data = Data() + (record.m_index - m_firstRecord) * m_deserializer.m_recordSize;
+
+            uint32_t classId;
+            memcpy(&classId, data, sizeof(classId));
+            size_t labelDimension = m_deserializer.m_labelGenerator->LabelDimension();
+            if (classId >= labelDimension)
+                RuntimeError(
+                    "Image with id '%s' has invalid class id '%u'. It is exceeding the label dimension of '%" PRIu64 "'.",
+                    m_deserializer.m_corpus->IdToKey(record.m_key).c_str(), classId, labelDimension);
+
+            // Transforms may change the image in place (e.g. flip), so the chunk keeps its own copy.
+            cv::Mat image(m_deserializer.m_height, m_deserializer.m_width, CV_8UC(m_deserializer.m_channels), const_cast<unsigned char*>(data + sizeof(classId)));
+            m_deserializer.PopulateSequenceData(image.clone(), classId, copyId, KeyType{ record.m_key, 0 }, result);
+        }
+    };
+
+    ImageShardDeserializer::ImageShardDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary) : ImageDeserializerBase(corpus, config, primary)
+    {
+        wstring fileName = config(L"file");
+        m_fileName = fileName;
+
+        attempt(5, [this, corpus]()
+        {
+            if (!m_dataFile || ferror(m_dataFile.get()) != 0)
+                m_dataFile.reset(fopenOrDie(m_fileName, L"rbS"), [](FILE* f) { if (f) fclose(f); });
+
+            ReadHeader(corpus);
+        });
+
+        if (m_grayscale != (m_channels == 1))
+            RuntimeError("The images in '%ls' have %d channels, which does not match 'grayscale=%s'.", m_fileName.c_str(), m_channels, m_grayscale ? "true" : "false");
+
+        bool directIO = config(L"directIO", false);
+        if (directIO || config(L"asyncIO", false))
+            m_asyncFile.reset(new AsyncFileReader(m_fileName, directIO));
+
+        size_t chunkSizeBytes = config(L"chunkSizeInBytes", g_32MB);
+        m_recordsPerChunk = std::max<size_t>(1, chunkSizeBytes / m_recordSize);
+        if (m_verbosity > 1)
+            fprintf(stderr, "ImageShardDeserializer: %" PRIu64 " images of %dx%dx%d in '%ls', %" PRIu64 " per chunk.\n",
+                    m_records.size(), m_width, m_height, m_channels, m_fileName.c_str(), m_recordsPerChunk);
+        if (m_verbosity > 1 && m_asyncFile)
+            fprintf(stderr, "ImageShardDeserializer: reading '%ls' with %s%s I/O.\n", m_fileName.c_str(),
+                    m_asyncFile->IsAsync() ? "asynchronous" : "synchronous", m_asyncFile->IsDirect() ? " direct" : "");
+    }
+
+    void ImageShardDeserializer::ReadHeader(CorpusDescriptorPtr corpus)
+    {
+        FILE* file = m_dataFile.get();
+        char magic[sizeof(s_shardMagic)];
+        uint32_t version, width, height, channels;
+        uint64_t numberOfRecords, keysOffset;
+        freadOrDie(magic, sizeof(magic), 1, file);
+        freadOrDie(&version, sizeof(version), 1, file);
+        if (memcmp(magic, s_shardMagic, sizeof(magic)) != 0)
+            RuntimeError("'%ls' is not an image shard.", m_fileName.c_str());
+        if (version != s_shardVersion)
+            RuntimeError("Unsupported version %u of the image shard '%ls', expected %u.", version, m_fileName.c_str(), s_shardVersion);
+
+        freadOrDie(&width, sizeof(width), 1, file);
+        freadOrDie(&height, sizeof(height), 1, file);
+        freadOrDie(&channels, sizeof(channels), 1, file);
+        freadOrDie(&numberOfRecords, sizeof(numberOfRecords), 1, file);
+        freadOrDie(&keysOffset, sizeof(keysOffset), 1, file);
+        if (width == 0 || height == 0 || (channels != 1 && channels != 3) || numberOfRecords == 0)
+            RuntimeError("Invalid header of the image shard '%ls'.", m_fileName.c_str());
+
+        m_width = (int)width;
+        m_height = (int)height;
+        m_channels = (int)channels;
+        m_recordSize = sizeof(uint32_t) + (size_t)width * height * channels;
+        if (keysOffset != s_shardHeaderSize + numberOfRecords * m_recordSize)
+            RuntimeError("Invalid header of the image shard '%ls', the key section does not follow the records.", m_fileName.c_str());
+
+        // The keys are the rest of the file.
+        int rc = _fseeki64(file, keysOffset, SEEK_SET);
+        if (rc)
+            RuntimeError("Error seeking to position '%" PRIu64 "' in the input file '%ls', error code '%d'", keysOffset, m_fileName.c_str(), rc);
+
+        std::vector<char> keys;
+        char buffer[64 * 1024];
+        size_t bytesRead;
+        while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            keys.insert(keys.end(), buffer, buffer + bytesRead);
+        if (ferror(file))
+            RuntimeError("Error reading the sequence keys of the image shard '%ls'.", m_fileName.c_str());
+        if (keys.empty() || keys.back() != '\0')
+            RuntimeError("The sequence keys of the image shard '%ls' are truncated.", m_fileName.c_str());
+
+        m_records.clear();
+        m_keyToSequence.clear();
+        const char* key = keys.data();
+        const char* keysEnd = keys.data() + keys.size();
+        for (size_t i = 0; i < numberOfRecords; ++i)
+        {
+            if (key >= keysEnd)
+                RuntimeError("The image shard '%ls' has fewer sequence keys than images.", m_fileName.c_str());
+
+            std::string sequenceKey(key);
+            key += sequenceKey.size() + 1;
+
+            // Skipping sequences that are not included in corpus.
+            if (!corpus->IsIncluded(sequenceKey))
+                continue;
+
+            ImageRecord record;
+            record.m_index = i;
+            record.m_key = corpus->KeyToId(sequenceKey);
+            if (!m_primary)
+                m_keyToSequence[record.m_key] = m_records.size();
+            m_records.push_back(record);
+        }
+
+        if (m_records.empty())
+            RuntimeError("The image shard '%ls' has no images included in the corpus.", m_fileName.c_str());
+    }
+
+    ChunkDescriptions ImageShardDeserializer::GetChunkDescriptions()
+    {
+        // In case of multi crop the deserializer provides the same sequence NumMultiViewCopies times.
+        // With multiViewSequence it provides each sequence once, with NumMultiViewCopies samples.
+        size_t sequencesPerInitialSequence = NumCopiesPerImage();
+        size_t numberOfChunks = (m_records.size() + m_recordsPerChunk - 1) / m_recordsPerChunk;
+        if (numberOfChunks > CHUNKID_MAX)
+            RuntimeError("Maximum number of chunks exceeded.");
+
+        ChunkDescriptions result;
+        result.reserve(numberOfChunks);
+        for (size_t i = 0; i < numberOfChunks; ++i)
+        {
+            auto c = std::make_shared<ChunkDescription>();
+            c->m_id = (ChunkIdType)i;
+            size_t numberOfSequences = std::min(m_recordsPerChunk, m_records.size() - i * m_recordsPerChunk);
+            c->m_numberOfSequences = numberOfSequences * sequencesPerInitialSequence;
+            c->m_numberOfSamples = c->m_numberOfSequences * NumSamplesPerImage();
+            result.push_back(c);
+        }
+        return result;
+    }
+
+    void ImageShardDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
+    {
+        size_t sequenceCopies = NumCopiesPerImage();
+        size_t begin = chunkId * m_recordsPerChunk;
+        size_t end = std::min(begin + m_recordsPerChunk, m_records.size());
+        result.reserve(sequenceCopies * (end - begin));
+        size_t currentId = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            for (size_t j = 0; j < sequenceCopies; ++j)
+            {
+                result.push_back(
+                {
+                    currentId,
+                    NumSamplesPerImage(),
+                    chunkId,
+                    KeyType{ m_records[i].m_key, 0 }
+                });
+
+                currentId++;
+            }
+        }
+    }
+
+    ChunkPtr ImageShardDeserializer::GetChunk(ChunkIdType chunkId)
+    {
+        return make_shared<ImageChunk>(chunkId, *this);
+    }
+
+    bool ImageShardDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+    {
+        auto index = m_keyToSequence.find(key.m_sequence);
+        // Checks whether it is a known sequence for us.
+        if (key.m_sample != 0 || index == m_keyToSequence.end())
+            return false;
+
+        size_t sequenceCopies = NumCopiesPerImage();
+        result.m_chunkId = (ChunkIdType)(index->second / m_recordsPerChunk);
+        result.m_indexInChunk = (index->second % m_recordsPerChunk) * sequenceCopies;
+        result.m_key = KeyType{ m_records[index->second].m_key, 0 };
+        result.m_numberOfSamples = NumSamplesPerImage();
+        return true;
+    }
+
+}}}
@@ -0,0 +1,68 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "ImageDeserializerBase.h"
+#include "AsyncFileReader.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+    // Deserializer of image shards, files of images that were decoded and resized to a common size ahead of time
+    // (e.g. by Scripts/img2shard.py), so that repeated sweeps do not have to decode the images again.
+    // Since all images have the same size, the records have a fixed size and no index of the data is needed:
+    //
+    //   header:  char[8] "CNTKIMGS", uint32 version (1), uint32 width, uint32 height, uint32 channels,
+    //            uint64 number of records, uint64 offset of the key section
+    //   records: uint32 class id, followed by width * height * channels bytes of the image (uint8, HWC, BGR as in OpenCV)
+    //   keys:    a zero-terminated sequence key (UTF-8) per record
+    //
+    // The images are returned as ImageSequenceData of type uchar, as by the other image deserializers, so that
+    // the same transforms apply (typically random crop and scale for augmentation, mean and transpose).
+    // With asyncIO=true, GetChunk() only starts the read of the chunk (see AsyncFileReader.h), so that the chunks the
+    // randomizer prefetches (chunkPrefetchDepth) are read at once; directIO=true also bypasses the page cache.
+    class ImageShardDeserializer : public ImageDeserializerBase
+    {
+    public:
+        ImageShardDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+        // Get a chunk by id.
+        ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+        // Get chunk descriptions.
+        ChunkDescriptions GetChunkDescriptions() override;
+
+        // Gets sequence descriptions for the chunk.
+        void GetSequencesForChunk(ChunkIdType, std::vector<SequenceDescription>&) override;
+
+        // Gets sequence description by key.
+        bool GetSequenceDescriptionByKey(const KeyType&, SequenceDescription&) override;
+
+    private:
+        class ImageChunk;
+
+        // Reads the header and the keys of the shard.
+        void ReadHeader(CorpusDescriptorPtr corpus);
+
+        std::shared_ptr<FILE> m_dataFile;
+        std::wstring m_fileName;
+        std::unique_ptr<AsyncFileReader> m_asyncFile; // with asyncIO
+
+        int m_width;
+        int m_height;
+        int m_channels;
+        size_t m_recordSize;      // in bytes, including the class id
+        size_t m_recordsPerChunk;
+
+        // The records included in the corpus, in the order of the file.
+        struct ImageRecord
+        {
+            size_t m_index; // in the file
+            size_t m_key;   // sequence key id
+        };
+        std::vector<ImageRecord> m_records;
+    };
+
+}}}
@@ -28,15 +28,27 @@ SequenceDataPtr ImageTransformerBase::Transform(SequenceDataPtr sequence)
         RuntimeError("Unexpected sequence provided");
 
     auto result = std::make_shared<ImageSequenceData>();
-    Apply(inputSequence->m_copyIndex, inputSequence->m_image);
+    if (inputSequence->m_views.empty())
+    {
+        if (inputSequence->m_numberOfSamples > 1)
+            RuntimeError("The views of 'multiViewSequence' are made by a Crop transform with cropType=multiview10, which must be the first image transform.");
+        Apply(inputSequence->m_copyIndex, inputSequence->m_image);
+    }
+    else
+    {
+        for (size_t i = 0; i < inputSequence->m_views.size(); i++)
+            Apply((uint8_t)i, inputSequence->m_views[i]);
+    }
 
     result->m_image = inputSequence->m_image;
+    result->m_views = inputSequence->m_views;
     result->m_numberOfSamples = inputSequence->m_numberOfSamples;
-    result->m_elementType = GetElementTypeFromOpenCVType(inputSequence->m_image.depth());
+    const cv::Mat& image = result->m_views.empty() ? result->m_image : result->m_views.front();
+    result->m_elementType = GetElementTypeFromOpenCVType(image.depth());
     result->m_copyIndex = inputSequence->m_copyIndex;
     result->m_key = inputSequence->m_key;
 
-    ImageDimensions outputDimensions(inputSequence->m_image.cols, inputSequence->m_image.rows, inputSequence->m_image.channels());
+    ImageDimensions outputDimensions(image.cols, image.rows, image.channels());
     result->m_sampleLayout = std::make_shared<TensorShape>(outputDimensions.AsTensorShape(HWC));
     return result;
 }
@@ -116,6 +128,30 @@ void CropTransformer::StartEpoch(const EpochConfiguration &config)
     ImageTransformerBase::StartEpoch(config);
 }
 
+// With multiViewSequence, the image of a sequence is decoded once and becomes its NumMultiViewCopies views here.
+SequenceDataPtr CropTransformer::Transform(SequenceDataPtr sequence)
+{
+    auto inputSequence = dynamic_cast<ImageSequenceData*>(sequence.get());
+    if (inputSequence == nullptr || inputSequence->m_numberOfSamples <= 1 || !inputSequence->m_views.empty())
+        return ImageTransformerBase::Transform(sequence);
+
+    if (m_cropType != CropType::MultiView10 || inputSequence->m_numberOfSamples != ImageDeserializerBase::NumMultiViewCopies)
+        RuntimeError("'multiViewSequence' requires a Crop transform with cropType=multiview10.");
+
+    const cv::Mat image = inputSequence->m_image;
+    inputSequence->m_views.assign(inputSequence->m_numberOfSamples, image);
+    inputSequence->m_image.release();
+    auto result = ImageTransformerBase::Transform(sequence);
+
+    // The views that are not flipped still share the pixels of the image, which the transforms that follow may change in place.
+    for (auto& view : static_cast<ImageSequenceData&>(*result).m_views)
+    {
+        if (view.datastart == image.datastart)
+            view = view.clone();
+    }
+    return result;
+}
+
 void CropTransformer::Apply(uint8_t copyId, cv::Mat &mat)
 {
     auto seed = GetSeed();
@@ -145,7 +181,10 @@ void CropTransformer::Apply(uint8_t copyId, cv::Mat &mat)
     if ((m_hFlip && boost::random::bernoulli_distribution<>()(*rng)) ||
         viewIndex >= 5)
     {
-        cv::flip(mat, mat, 1);
+        // not in place, the views of a multi-view sequence are crops of the same image
+        cv::Mat flipped;
+        cv::flip(mat, flipped, 1);
+        mat = flipped;
     }
 
     m_rngs.push(std::move(rng));
@@ -458,8 +497,8 @@ void MeanTransformer::Apply(uint8_t, cv::Mat &mat)
     }
 }
 
-TransposeTransformer::TransposeTransformer(const ConfigParameters& config) : TransformBase(config),
-    m_floatTransform(this), m_doubleTransform(this)
+TransposeTransformer::TransposeTransformer(const ConfigParameters& config) : TransformBase(config, /*allowUChar*/ true),
+    m_floatTransform(this), m_doubleTransform(this), m_ucharTransform(this)
 {}
 
 // The method describes how input stream is transformed to the output stream. Called once per applied stream.
@@ -490,6 +529,13 @@ SequenceDataPtr TransposeTransformer::Transform(SequenceDataPtr sequence)
         m_inputStream.m_elementType :
         sequence->m_elementType;
 
+    if (m_precision == ElementType::tuchar)
+    {
+        if (elementType != ElementType::tuchar)
+            RuntimeError("Transpose with precision 'uchar' requires 8 bit images, please remove the transforms that produce floating point images.");
+        return m_ucharTransform.Apply<unsigned char>(inputSequence);
+    }
+
     switch (elementType)
     {
     case ElementType::tdouble:
@@ -513,33 +559,17 @@ SequenceDataPtr TransposeTransformer::Transform(SequenceDataPtr sequence)
     return nullptr; // Make compiler happy
 }
 
-template <class TElementTo>
-template<class TElementFrom>
-SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSequenceData* inputSequence)
+// Transposes an image from HWC to CHW.
+template <class TElementTo, class TElementFrom>
+static void TransposeImage(const cv::Mat& image, const ImageDimensions& dimensions, TElementTo* dst)
 {
-    TensorShapePtr shape = m_parent->m_inputStream.m_sampleLayout;
-    if (shape == nullptr) // Taking the shape from the sequence.
-        shape = inputSequence->m_sampleLayout;
-
-    if (!shape)
-        RuntimeError("Unknown shape of the sample in stream '%ls'.", m_parent->m_inputStream.m_name.c_str());
-
-    assert(inputSequence->m_numberOfSamples == 1);
-
-    size_t count = shape->GetNumElements();
-    auto result = std::make_shared<DenseSequenceWithBuffer<TElementTo>>(m_memBuffers, count);
-    result->m_key = inputSequence->m_key;
-
-    ImageDimensions dimensions(*shape, ImageLayoutKind::HWC);
     size_t rowCount = dimensions.m_height * dimensions.m_width;
     size_t channelCount = dimensions.m_numChannels;
 
-    auto dst = result->GetBuffer();
-
     if (channelCount == 3) // Unrolling for BGR, the most common case.
     {
-        size_t nRows = inputSequence->m_image.rows;
-        size_t nCols = inputSequence->m_image.cols;
+        size_t nRows = image.rows;
+        size_t nCols = image.cols;
 
         TElementTo* b = dst;
         TElementTo* g = dst + rowCount;
@@ -547,7 +577,7 @@ SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSeq
 
         for (size_t i = 0; i < nRows; ++i)
         {
-            auto* x = inputSequence->m_image.ptr<TElementFrom>((int)i);
+            auto* x = image.ptr<TElementFrom>((int)i);
             for (size_t j = 0; j < nCols; ++j)
             {
                 auto row = j * 3;
@@ -559,7 +589,8 @@ SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSeq
     }
     else
     {
-        auto src = reinterpret_cast<const TElementFrom*>(inputSequence->GetDataBuffer());
+        const cv::Mat continuous = image.isContinuous() ? image : image.clone();
+        auto src = continuous.ptr<TElementFrom>();
         for (size_t irow = 0; irow < rowCount; irow++)
         {
             for (size_t icol = 0; icol < channelCount; icol++)
@@ -568,6 +599,34 @@ SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSeq
             }
         }
     }
+}
+
+template <class TElementTo>
+template<class TElementFrom>
+SequenceDataPtr TransposeTransformer::TypedTranspose<TElementTo>::Apply(ImageSequenceData* inputSequence)
+{
+    TensorShapePtr shape = m_parent->m_inputStream.m_sampleLayout;
+    if (shape == nullptr) // Taking the shape from the sequence.
+        shape = inputSequence->m_sampleLayout;
+
+    if (!shape)
+        RuntimeError("Unknown shape of the sample in stream '%ls'.", m_parent->m_inputStream.m_name.c_str());
+
+    assert(inputSequence->m_views.empty() ? inputSequence->m_numberOfSamples == 1 : inputSequence->m_numberOfSamples == inputSequence->m_views.size());
+
+    size_t count = shape->GetNumElements();
+    auto result = std::make_shared<DenseSequenceWithBuffer<TElementTo>>(m_memBuffers, count * inputSequence->m_numberOfSamples);
+    result->m_key = inputSequence->m_key;
+
+    ImageDimensions dimensions(*shape, ImageLayoutKind::HWC);
+    auto dst = result->GetBuffer();
+    if (inputSequence->m_views.empty())
+        TransposeImage<TElementTo, TElementFrom>(inputSequence->m_image, dimensions, dst);
+    else
+    {
+        for (size_t i = 0; i < inputSequence->m_views.size(); i++) // the samples of a multi-view sequence
+            TransposeImage<TElementTo, TElementFrom>(inputSequence->m_views[i], dimensions, dst + i * count);
+    }
 
     result->m_sampleLayout = m_parent->m_outputStream.m_sampleLayout != nullptr ?
         m_parent->m_outputStream.m_sampleLayout :
@@ -762,14 +821,21 @@ void ColorTransformer::Apply(cv::Mat &mat)
     m_rngs.push(std::move(rng));
 }
 
-CastTransformer::CastTransformer(const ConfigParameters& config) : TransformBase(config), m_floatTransform(this), m_doubleTransform(this)
+CastTransformer::CastTransformer(const ConfigParameters& config) : TransformBase(config, /*allowUChar*/ true), m_floatTransform(this), m_doubleTransform(this)
 {
+    m_mean = config(L"mean", 0.0);
+    m_scale = config(L"scale", 1.0);
 }
 
 StreamDescription CastTransformer::Transform(const StreamDescription& inputStream)
 {
     m_outputStream = TransformBase::Transform(inputStream);
     m_outputStream.m_elementType = m_precision;
+    if (m_precision == ElementType::tuchar)
+    {
+        m_outputStream.m_normalizationMean = m_mean;
+        m_outputStream.m_normalizationScale = m_scale;
+    }
     return m_outputStream;
 }
 
@@ -799,11 +865,14 @@ SequenceDataPtr CastTransformer::Transform(SequenceDataPtr sequence)
     case ElementType::tfloat:
         if (inputType == ElementType::tdouble)
             result = m_floatTransform.Apply<double>(sequence);
-        if (inputType == ElementType::tuchar)
+        else if (inputType == ElementType::tuchar)
             result = m_floatTransform.Apply<unsigned char>(sequence);
         else
             RuntimeError("Unsupported type. Please apply a cast transform with 'double' or 'float' precision.");
         break;
+    case ElementType::tuchar:
+        // Unsigned chars are passed through above, everything else would lose precision.
+        RuntimeError("Cast with precision 'uchar' requires 8 bit images, please remove the transforms that produce floating point images.");
     default:
         RuntimeError("Unsupported type. Please apply a cast transform with 'double' or 'float' precision.");
     }
@@ -840,4 +909,65 @@ SequenceDataPtr CastTransformer::TypedCast<TElementTo>::Apply(SequenceDataPtr se
     return result;
 }
 
+DeviceAugmentTransformer::DeviceAugmentTransformer(const ConfigParameters& config) : TransformBase(config, /*allowUChar*/ true), m_augmentation()
+{
+    m_augmentation.outW = config(L"width");
+    m_augmentation.outH = config(L"height");
+    if (m_augmentation.outW <= 0 || m_augmentation.outH <= 0)
+        InvalidArgument("DeviceAugment: width and height must be > 0.");
+
+    CropType cropType = ImageConfigHelper::ParseCropType(config(L"cropType", "center"));
+    if (cropType != CropType::Center && cropType != CropType::RandomSide)
+        InvalidArgument("DeviceAugment: Only the crop types 'center' and 'randomSide' are supported.");
+    m_augmentation.randomPosition = cropType == CropType::RandomSide;
+
+    floatargvector sideRatio = config(L"sideRatio", "1.0");
+    m_augmentation.sideRatioMin = sideRatio[0];
+    m_augmentation.sideRatioMax = sideRatio[1];
+    if (!(m_augmentation.sideRatioMin > 0 && m_augmentation.sideRatioMax <= 1.0) || m_augmentation.sideRatioMin > m_augmentation.sideRatioMax)
+        RuntimeError("Invalid sideRatio value, must be > 0 and <= 1. sideMin must <= sideMax");
+
+    if (!config.ExistsCurrent(L"hflip"))
+        m_augmentation.hFlip = m_augmentation.randomPosition;
+    else
+        m_augmentation.hFlip = config(L"hflip");
+
+    m_augmentation.brightnessRadius = config(L"brightnessRadius", "0.0");
+    if (m_augmentation.brightnessRadius < 0 || m_augmentation.brightnessRadius > 1.0)
+        InvalidArgument("brightnessRadius must be >= 0.0 and <= 1.0");
+    m_augmentation.contrastRadius = config(L"contrastRadius", "0.0");
+    if (m_augmentation.contrastRadius < 0 || m_augmentation.contrastRadius > 1.0)
+        InvalidArgument("contrastRadius must be >= 0.0 and <= 1.0");
+    m_augmentation.saturationRadius = config(L"saturationRadius", "0.0");
+    if (m_augmentation.saturationRadius < 0 || m_augmentation.saturationRadius > 1.0)
+        InvalidArgument("saturationRadius must be >= 0.0 and <= 1.0");
+
+    m_augmentation.seed = GetSeed();
+    m_imageLayout = ImageLayoutKindFrom(config(L"imageLayout", L"CHW"));
+}
+
+StreamDescription DeviceAugmentTransformer::Transform(const StreamDescription& inputStream)
+{
+    m_outputStream = TransformBase::Transform(inputStream);
+    if (inputStream.m_elementType != ElementType::tuchar)
+        RuntimeError("DeviceAugment requires 8 bit images, please apply a Cast transform with precision 'uchar' before it.");
+    if (!inputStream.m_sampleLayout)
+        RuntimeError("DeviceAugment requires images of the same size, please apply a Scale transform before it.");
+
+    ImageDimensions dimensions(*inputStream.m_sampleLayout, m_imageLayout);
+    if (dimensions.m_numChannels > ImageAugmentation::MaxChannels)
+        RuntimeError("DeviceAugment supports images of up to %d channels.", ImageAugmentation::MaxChannels);
+    m_augmentation.inW = (int)dimensions.m_width;
+    m_augmentation.inH = (int)dimensions.m_height;
+    m_augmentation.channels = (int)dimensions.m_numChannels;
+    m_augmentation.channelsInnermost = m_imageLayout == ImageLayoutKind::HWC;
+
+    // the normalization of the Cast transform
+    m_augmentation.mean = (float)inputStream.m_normalizationMean;
+    m_augmentation.scale = (float)inputStream.m_normalizationScale;
+
+    m_outputStream.m_imageAugmentation = std::make_shared<ImageAugmentation>(m_augmentation);
+    return m_outputStream;
+}
+
 }}}
@@ -16,6 +16,7 @@
 #include "Config.h"
 #include "ImageConfigHelper.h"
 #include "TransformBase.h"
+#include "ImageAugmentation.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -27,9 +28,19 @@ struct ImageSequenceData : DenseSequenceData
     uint8_t  m_copyIndex;            // Index of the copy. Used in i.e. Multicrop,
                                      // when deserializer provides several copies of the same sequence.
 
+    // The views of a multi-view sequence (multiViewSequence), one per sample, which are made from m_image by the
+    // Crop transform. Empty for sequences of one image.
+    std::vector<cv::Mat> m_views;
+
     const void* GetDataBuffer() override
     {
-        if (!m_image.isContinuous())
+        if (!m_views.empty())
+        {
+            // The samples one after the other; the views are all cropped to the same size.
+            cv::vconcat(m_views, m_image);
+            m_views.clear();
+        }
+        else if (!m_image.isContinuous())
         {
             // According to the contract, dense sequence data 
             // should return continuous data buffer.
@@ -85,6 +96,9 @@ class CropTransformer : public ImageTransformerBase
 public:
     explicit CropTransformer(const ConfigParameters& config);
 
+    // Transformation of the sequence, which makes the views of a multi-view sequence.
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+
 private:
     void Apply(uint8_t copyId, cv::Mat &mat) override;
 
@@ -196,6 +210,9 @@ private:
 
     // Auxiliary buffer to handle images of double type.
     TypedTranspose<double> m_doubleTransform;
+
+    // Auxiliary buffer to handle images that stay unsigned chars (precision "uchar").
+    TypedTranspose<unsigned char> m_ucharTransform;
 };
 
 // Intensity jittering based on PCA transform as described in original AlexNet paper
@@ -250,6 +267,10 @@ private:
 // i.e. as a uchar due to performance reasons. On the other hand, the packer/network
 // currently only supports float and double. This transform is necessary to do a proper
 // casting before the sequence data enters the packer.
+// With precision "uchar" the cast is left to the network: 8 bit images are packed and copied to the device
+// as is, a quarter of the float data, and converted there to (x - mean) * scale with the options mean
+// (default 0) and scale (default 1), e.g. mean = 127.5 ; scale = 0.0078431 for inputs in [-1, 1].
+// This requires that no transform before the cast produces floating point images.
 class CastTransformer : public TransformBase
 {
 public:
@@ -278,7 +299,33 @@ private:
 
     TypedCast<float> m_floatTransform;
     TypedCast<double> m_doubleTransform;
+
+    // Normalization applied on the device for precision "uchar".
+    double m_mean;
+    double m_scale;
 };
 
+// Augmentation of 8 bit images on the device of the network: random crop, scale, flip, color jitter and normalization
+// run as one kernel on the minibatch after the copy (see ImageAugmentation.h) instead of the Crop, Scale, Color and
+// Mean transforms on the reader threads. The images must have the same size, e.g. scaled down by a Scale transform,
+// and be cast to "uchar". The samples are passed on unchanged; the stream describes the augmentation to the ReaderShim.
+class DeviceAugmentTransformer : public TransformBase
+{
+public:
+    explicit DeviceAugmentTransformer(const ConfigParameters&);
+
+    // Transformation of the stream.
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+    // Transformation of the sequence.
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override
+    {
+        return sequence;
+    }
+
+private:
+    ImageAugmentation m_augmentation;
+    ImageLayoutKind m_imageLayout;
+};
 
 }}}
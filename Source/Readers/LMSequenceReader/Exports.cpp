@@ -10,6 +10,8 @@
 #define DATAWRITER_EXPORTS
 #include "SequenceReader.h"
 #include "SequenceWriter.h"
+#include "LMSequenceDeserializer.h"
+#include "StringUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -31,4 +33,16 @@ extern "C" DATAWRITER_API void GetWriterD(IDataWriter** pwriter)
     *pwriter = new LMSequenceWriter<double>();
 }
 
+// A factory method for creating the deserializer of LM text corpora, see LMSequenceDeserializer.h.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool primary)
+{
+    if (type == L"LMSequenceDeserializer")
+        *deserializer = new LMSequenceDeserializer(corpus, deserializerConfig, primary);
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
+
 }}}
@@ -0,0 +1,419 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <limits>
+#include <fstream>
+#include "LMSequenceDeserializer.h"
+#include "ConfigUtil.h"
+#include "StringUtil.h"
+#include "File.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// The old reader skips lines with fewer tokens, e.g. empty sentences "<s> </s>".
+static const size_t s_minTokensPerLine = 3;
+
+static inline bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Input words of a line, pointing into the words of a chunk and the values of the deserializer.
+struct LMSparseSequenceData : SparseSequenceData
+{
+    const void* m_values;
+
+    const void* GetDataBuffer() override
+    {
+        return m_values;
+    }
+};
+
+// Output labels of a line, pointing into the labels of a chunk.
+struct LMDenseSequenceData : DenseSequenceData
+{
+    const void* m_buffer;
+
+    const void* GetDataBuffer() override
+    {
+        return m_buffer;
+    }
+};
+
+// Parses the lines of a chunk, from a single read of its bytes.
+class LMSequenceDeserializer::LMChunk : public Chunk, public std::enable_shared_from_this<LMChunk>
+{
+    vector<IndexType> m_inputs; // word ids of the input tokens of all lines
+    vector<char> m_outputs;     // output labels of all lines, in the element type
+
+    vector<LMSparseSequenceData> m_inputSequences;
+    vector<LMDenseSequenceData> m_outputSequences;
+
+    template <class ElemType>
+    void SetOutput(const LMSequenceDeserializer& parent, size_t index, IndexType word)
+    {
+        ElemType* column = reinterpret_cast<ElemType*>(m_outputs.data()) + index * parent.m_outputDimension;
+        column[0] = (ElemType)word;
+        if (parent.m_classMode)
+        {
+            IndexType wordClass = parent.m_wordToClass[word];
+            column[1] = (ElemType)wordClass;
+            column[2] = (ElemType)parent.m_classRanges[wordClass].first;
+            column[3] = (ElemType)parent.m_classRanges[wordClass].second;
+        }
+        else if (word == 0) // as the old reader, avoid an all-zero column
+            column[0] = (ElemType)1e-6;
+    }
+
+public:
+    LMChunk(const LMSequenceDeserializer& parent, const ChunkDescriptor& descriptor)
+    {
+        const auto& sequences = descriptor.m_sequences;
+        const auto& last = sequences.back();
+        vector<char> buffer(last.OffsetInChunk() + last.SizeInBytes());
+
+        auto f = fopenOrDie(parent.m_fileName, L"rbS");
+        fsetpos(f, descriptor.m_offset);
+        freadOrDie(buffer.data(), 1, buffer.size(), f);
+        fclose(f);
+
+        m_inputs.reserve(descriptor.m_numberOfSamples);
+        if (parent.m_hasOutput)
+            m_outputs.resize(descriptor.m_numberOfSamples * parent.m_outputDimension * parent.m_elementSize);
+        m_inputSequences.resize(sequences.size());
+        if (parent.m_hasOutput)
+            m_outputSequences.resize(sequences.size());
+
+        string word;
+        vector<IndexType> words;
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            const auto& sequence = sequences[i];
+            const char* pos = buffer.data() + sequence.OffsetInChunk();
+            const char* end = pos + sequence.SizeInBytes();
+
+            words.clear();
+            while (pos < end)
+            {
+                while (pos < end && IsSpace(*pos))
+                    ++pos;
+                const char* begin = pos;
+                while (pos < end && !IsSpace(*pos))
+                    ++pos;
+                if (pos > begin)
+                {
+                    word.assign(begin, pos);
+                    words.push_back(parent.GetWordId(word));
+                }
+            }
+
+            size_t numberOfSamples = sequence.m_numberOfSamples;
+            if (words.size() != numberOfSamples + (parent.m_hasOutput ? 1 : 0))
+                RuntimeError("LMSequenceDeserializer: line changed in '%ls' since the index was built.", parent.m_fileName.c_str());
+
+            size_t start = m_inputs.size();
+            m_inputs.insert(m_inputs.end(), words.begin(), words.begin() + numberOfSamples);
+
+            auto& input = m_inputSequences[i];
+            input.m_indices = &m_inputs[start];
+            input.m_nnzCounts.assign(numberOfSamples, static_cast<IndexType>(1));
+            input.m_totalNnzCount = static_cast<IndexType>(numberOfSamples);
+            input.m_numberOfSamples = static_cast<uint32_t>(numberOfSamples);
+            input.m_values = parent.m_ones.data();
+            input.m_key = sequence.m_key;
+
+            if (!parent.m_hasOutput)
+                continue;
+
+            // the output of each token is the next word
+            for (size_t t = 0; t < numberOfSamples; ++t)
+            {
+                if (parent.m_elementType == ElementType::tfloat)
+                    SetOutput<float>(parent, start + t, words[t + 1]);
+                else
+                    SetOutput<double>(parent, start + t, words[t + 1]);
+            }
+
+            auto& output = m_outputSequences[i];
+            output.m_buffer = m_outputs.data() + start * parent.m_outputDimension * parent.m_elementSize;
+            output.m_numberOfSamples = static_cast<uint32_t>(numberOfSamples);
+            output.m_key = sequence.m_key;
+        }
+
+        if (parent.m_verbosity)
+            fprintf(stderr, "LMSequenceDeserializer: read chunk %u (%zu lines, %zu words)\n", descriptor.m_id, sequences.size(), m_inputs.size());
+    }
+
+    // The sequences alias the chunk, which holds their data.
+    void GetSequence(size_t sequenceIndex, vector<SequenceDataPtr>& result) override
+    {
+        result.push_back(SequenceDataPtr(shared_from_this(), &m_inputSequences[sequenceIndex]));
+        if (!m_outputSequences.empty())
+            result.push_back(SequenceDataPtr(shared_from_this(), &m_outputSequences[sequenceIndex]));
+    }
+};
+
+// Expects an input stream (dim), optionally an output stream (labelType = "nextWord") in the input section of the config.
+LMSequenceDeserializer::LMSequenceDeserializer(CorpusDescriptorPtr, const ConfigParameters& cfg, bool primary)
+    : DataDeserializerBase(primary)
+{
+    if (!primary)
+        InvalidArgument("LMSequenceDeserializer: only supported as the primary deserializer, the lines of the file have no keys.");
+
+    m_fileName = (wstring)cfg(L"file");
+    m_unk = (string)cfg(L"unk", "<unk>");
+    m_verbosity = cfg(L"verbosity", 0);
+
+    wstring mode = cfg(L"mode", L"class");
+    if (AreEqualIgnoreCase(mode, L"class"))
+        m_classMode = true;
+    else if (AreEqualIgnoreCase(mode, L"softmax"))
+        m_classMode = false;
+    else
+        InvalidArgument("LMSequenceDeserializer: unsupported mode '%ls', expected 'class' or 'softmax'.", mode.c_str());
+
+    wstring precision = cfg(L"precision", L"float");
+    m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
+    m_elementSize = m_elementType == ElementType::tfloat ? sizeof(float) : sizeof(double);
+
+    ReadVocabulary(cfg(L"wordclass", L""), cfg(L"labelMappingFile", L""));
+    if (m_classMode && m_classRanges.empty())
+        InvalidArgument("LMSequenceDeserializer: mode 'class' requires a 'wordclass' file.");
+
+    // streams: the input words, and the next words unless labelType is "none"
+    ConfigParameters input = cfg(L"input");
+    wstring inputName, outputName;
+    size_t inputDimension = 0;
+    for (const auto& name : input.GetMemberIds())
+    {
+        ConfigParameters streamConfig = input(name);
+        wstring labelType = streamConfig(L"labelType", L"category");
+        if (AreEqualIgnoreCase(labelType, L"nextWord"))
+            outputName = msra::strfun::utf16(name);
+        else if (AreEqualIgnoreCase(labelType, L"none"))
+            continue;
+        else if (AreEqualIgnoreCase(labelType, L"category") && inputName.empty())
+        {
+            inputName = msra::strfun::utf16(name);
+            inputDimension = streamConfig(L"dim", m_vocabularySize);
+        }
+        else
+            InvalidArgument("LMSequenceDeserializer: unsupported stream '%s', expected one input stream and optionally one with labelType 'nextWord'.", name.c_str());
+    }
+    if (inputName.empty())
+        InvalidArgument("LMSequenceDeserializer: no input stream given.");
+    if (inputDimension < m_vocabularySize)
+        InvalidArgument("LMSequenceDeserializer: the dimension %zu of the input '%ls' is smaller than the vocabulary (%zu words).", inputDimension, inputName.c_str(), m_vocabularySize);
+
+    m_hasOutput = !outputName.empty();
+    m_outputDimension = m_classMode ? 4 : 1;
+
+    auto inputStream = make_shared<StreamDescription>();
+    inputStream->m_id = 0;
+    inputStream->m_name = inputName;
+    inputStream->m_sampleLayout = make_shared<TensorShape>(inputDimension);
+    inputStream->m_storageType = StorageType::sparse_csc;
+    inputStream->m_elementType = m_elementType;
+    m_streams.push_back(inputStream);
+
+    if (m_hasOutput)
+    {
+        auto outputStream = make_shared<StreamDescription>();
+        outputStream->m_id = 1;
+        outputStream->m_name = outputName;
+        outputStream->m_sampleLayout = make_shared<TensorShape>(m_outputDimension);
+        outputStream->m_storageType = StorageType::dense;
+        outputStream->m_elementType = m_elementType;
+        m_streams.push_back(outputStream);
+    }
+
+    size_t chunkSize = cfg(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024);
+    m_index = make_unique<Index>(chunkSize, true);
+
+    auto f = fopenOrDie(m_fileName, L"rbS");
+    BuildIndex(f);
+    fclose(f);
+}
+
+void LMSequenceDeserializer::ReadVocabulary(const wstring& wordClassFile, const wstring& labelMappingFile)
+{
+    vector<string> words;
+    if (!wordClassFile.empty())
+    {
+        // lines 'id count word class'
+        ifstream fin(msra::strfun::utf8(wordClassFile).c_str());
+        if (!fin)
+            RuntimeError("LMSequenceDeserializer: cannot open the word class file '%ls'.", wordClassFile.c_str());
+
+        vector<int> classes;
+        string line;
+        while (getline(fin, line))
+        {
+            auto tokens = msra::strfun::split(line, "\t ");
+            if (tokens.empty())
+                continue;
+            if (tokens.size() != 4)
+                RuntimeError("LMSequenceDeserializer: malformed line in the word class file '%ls': %s", wordClassFile.c_str(), line.c_str());
+
+            size_t id = stoul(tokens[0]);
+            if (id >= words.size())
+            {
+                words.resize(id + 1);
+                classes.resize(id + 1, -1);
+            }
+            words[id] = tokens[2];
+            classes[id] = stoi(tokens[3]);
+        }
+
+        // the words of a class have consecutive ids
+        for (size_t id = 0; id < classes.size(); ++id)
+        {
+            if (classes[id] < 0)
+                RuntimeError("LMSequenceDeserializer: the word class file '%ls' has no word with id %zu.", wordClassFile.c_str(), id);
+            size_t wordClass = classes[id];
+            if (wordClass >= m_classRanges.size())
+                m_classRanges.resize(wordClass + 1, make_pair((IndexType)id, (IndexType)id));
+            else if (wordClass != (size_t)classes[id - 1])
+                RuntimeError("LMSequenceDeserializer: the words in '%ls' are not sorted by class.", wordClassFile.c_str());
+            m_classRanges[wordClass].second = (IndexType)(id + 1);
+            m_wordToClass.push_back((IndexType)wordClass);
+        }
+    }
+    else if (!labelMappingFile.empty())
+        File::LoadLabelFile(labelMappingFile, words);
+    else
+        InvalidArgument("LMSequenceDeserializer: a 'wordclass' or 'labelMappingFile' is required, the mapping cannot be built on the fly.");
+
+    for (size_t id = 0; id < words.size(); ++id)
+        m_wordToId[words[id]] = (IndexType)id;
+    m_vocabularySize = words.size();
+
+    auto unk = m_wordToId.find(m_unk);
+    m_unkId = unk == m_wordToId.end() ? numeric_limits<IndexType>::max() : unk->second;
+    if (unk == m_wordToId.end())
+        fprintf(stderr, "LMSequenceDeserializer: 'unknown' symbol unk='%s' is not in the vocabulary. Unknown words will error out if encountered.\n", m_unk.c_str());
+}
+
+IndexType LMSequenceDeserializer::GetWordId(const string& word) const
+{
+    auto found = m_wordToId.find(word);
+    if (found != m_wordToId.end())
+        return found->second;
+    if (m_unkId == numeric_limits<IndexType>::max())
+        RuntimeError("LMSequenceDeserializer: the word '%s' is not in the vocabulary, and there is no unk symbol '%s'.", word.c_str(), m_unk.c_str());
+    return m_unkId;
+}
+
+void LMSequenceDeserializer::BuildIndex(FILE* f)
+{
+    m_index->Reserve(filesize(f));
+
+    vector<char> buffer(2 * 1024 * 1024);
+    size_t lineStart = 0, offset = 0, numTokens = 0, maxTokens = 0, numLines = 0;
+    bool inToken = false;
+    for (;;)
+    {
+        size_t bytesRead = fread(buffer.data(), 1, buffer.size(), f);
+        bool atEnd = bytesRead == 0;
+        if (atEnd)
+        {
+            buffer[0] = '\n'; // terminate the last line
+            bytesRead = 1;
+        }
+
+        for (size_t i = 0; i < bytesRead; ++i)
+        {
+            char c = buffer[i];
+            if (!IsSpace(c))
+            {
+                if (!inToken)
+                    numTokens++;
+                inToken = true;
+                continue;
+            }
+            inToken = false;
+            if (c != '\n')
+                continue;
+
+            size_t lineEnd = atEnd ? offset : offset + i + 1;
+            if (numTokens >= s_minTokensPerLine)
+            {
+                size_t numberOfSamples = numTokens - (m_hasOutput ? 1 : 0);
+                KeyType key;
+                key.m_sequence = numLines;
+                key.m_sample = 0;
+                m_index->AddSequence(SequenceDescriptor(key, (uint32_t)numberOfSamples), lineStart, lineEnd);
+                maxTokens = max(maxTokens, numberOfSamples);
+                numLines++;
+            }
+            lineStart = lineEnd;
+            numTokens = 0;
+        }
+
+        if (atEnd)
+            break;
+        offset += bytesRead;
+    }
+
+    if (numLines == 0)
+        RuntimeError("LMSequenceDeserializer: '%ls' has no lines with at least %zu tokens.", m_fileName.c_str(), s_minTokensPerLine);
+
+    m_ones.resize(maxTokens * m_elementSize);
+    for (size_t i = 0; i < maxTokens; ++i)
+    {
+        if (m_elementType == ElementType::tfloat)
+            reinterpret_cast<float*>(m_ones.data())[i] = 1;
+        else
+            reinterpret_cast<double*>(m_ones.data())[i] = 1;
+    }
+
+    fprintf(stderr, "LMSequenceDeserializer: %zu lines in %zu chunks from '%ls'\n", numLines, m_index->m_chunks.size(), m_fileName.c_str());
+}
+
+ChunkDescriptions LMSequenceDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions chunks;
+    chunks.reserve(m_index->m_chunks.size());
+    for (const auto& chunk : m_index->m_chunks)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = chunk.m_id;
+        cd->m_numberOfSamples = chunk.m_numberOfSamples;
+        cd->m_numberOfSequences = chunk.m_numberOfSequences;
+        chunks.push_back(cd);
+    }
+    return chunks;
+}
+
+void LMSequenceDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_index->m_chunks[chunkId];
+    result.reserve(chunk.m_sequences.size());
+    for (size_t i = 0; i < chunk.m_sequences.size(); ++i)
+    {
+        SequenceDescription s;
+        s.m_chunkId = chunkId;
+        s.m_key = chunk.m_sequences[i].m_key;
+        s.m_indexInChunk = i;
+        s.m_numberOfSamples = chunk.m_sequences[i].m_numberOfSamples;
+        result.push_back(s);
+    }
+}
+
+ChunkPtr LMSequenceDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    ChunkPtr result;
+    attempt(5, [this, &result, chunkId]()
+    {
+        result = make_shared<LMChunk>(*this, m_index->m_chunks[chunkId]);
+    });
+    return result;
+}
+
+}}}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+#include "Indexer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer for the text corpora of the LMSequenceReader (BatchSequenceReader), so that LM jobs get the chunked,
+// randomized and prefetched reading of the ReaderShim pipeline. Each line with at least 3 tokens is a sequence.
+// It reproduces the label semantics of the old reader:
+//  - input stream: one-hot word vectors of the tokens, except the last one if there is an output stream;
+//  - output stream (labelType "nextWord"): per token the next word, as a dense column of
+//      mode "class":   [word id, class id, first word id of the class, end word id of the class]
+//      mode "softmax": [word id]
+//  - words are mapped by the 'wordclass' file (lines 'id count word class', with the words sorted by class) or
+//    by a labelMappingFile (one word per line); unknown words are mapped to 'unk'.
+// E.g. deserializers = ([ type = "LMSequenceDeserializer" ; module = "LMSequenceReader"
+//                         file = "ptb.train.txt" ; wordclass = "vocab.txt" ; mode = "class"
+//                         input = [ features = [ dim = 10000 ] ; labels = [ labelType = "nextWord" ] ] ])
+// Not ported: labelType "category" (interleaved input and output tokens), the NCE mode and the idx2cls input.
+class LMSequenceDeserializer : public DataDeserializerBase, boost::noncopyable
+{
+public:
+    LMSequenceDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& s) override;
+
+    // Retrieves a chunk with data.
+    virtual ChunkPtr GetChunk(ChunkIdType) override;
+
+private:
+    class LMChunk;
+
+    // Builds the index of the lines in a single pass that only counts the tokens.
+    void BuildIndex(FILE* file);
+
+    // Reads the word-to-id mapping and the classes of the words.
+    void ReadVocabulary(const std::wstring& wordClassFile, const std::wstring& labelMappingFile);
+
+    // Id of a word, or of 'unk' if the word is not in the vocabulary.
+    IndexType GetWordId(const std::string& word) const;
+
+    std::wstring m_fileName;
+    std::unique_ptr<Index> m_index;
+
+    std::unordered_map<std::string, IndexType> m_wordToId;
+    std::string m_unk;
+    IndexType m_unkId; // type max() if 'unk' is not in the vocabulary
+    size_t m_vocabularySize;
+
+    bool m_hasOutput;
+    bool m_classMode;
+    std::vector<IndexType> m_wordToClass;
+    std::vector<std::pair<IndexType, IndexType>> m_classRanges; // [first, end) of the word ids of each class
+
+    ElementType m_elementType;
+    size_t m_elementSize;
+    size_t m_outputDimension;
+
+    // Values of the one-hot input vectors, for the longest sequence.
+    std::vector<char> m_ones;
+    int m_verbosity;
+};
+
+}}}
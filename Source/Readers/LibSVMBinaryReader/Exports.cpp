@@ -9,6 +9,8 @@
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
 #include "LibSVMBinaryReader.h"
+#include "SparseBinaryDeserializer.h"
+#include "StringUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,4 +23,16 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
     *preader = new LibSVMBinaryReader<double>();
 }
 
+// A factory method for creating the deserializer of sparse binary files, see SparseBinaryDeserializer.h.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool primary)
+{
+    if (type == L"SparseBinaryDeserializer")
+        *deserializer = new SparseBinaryDeserializer(corpus, deserializerConfig, primary);
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
+
 }}}
@@ -15,6 +15,7 @@
 #include <ctime>
 #include <time.h>
 #include "CUDAPageLockedMemAllocator.h"
+#include "ThreadPool.h"
 #include <chrono>
 #include <thread>
 #ifndef _WIN32
@@ -702,6 +703,9 @@ void LibSVMBinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& reader
 template <class ElemType>
 void LibSVMBinaryReader<ElemType>::Destroy()
 {
+    // the prefetch runs on the thread pool, whose futures do not wait when destroyed
+    if (m_pendingAsyncGetMinibatch.valid())
+        m_pendingAsyncGetMinibatch.wait();
 }
 
 template <class ElemType>
@@ -781,7 +785,7 @@ bool LibSVMBinaryReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matric
         {
             // fprintf(stderr, "not valid\n");
             CheckDataMatrices(matrices);
-            m_pendingAsyncGetMinibatch = std::async(std::launch::async, [this]()
+            m_pendingAsyncGetMinibatch = ThreadPool::Instance().Async(std::launch::async, [this]()
                                                     {
                                                         return m_dataInput->FillMatrices(m_dataMatrices);
                                                     });
@@ -818,7 +822,7 @@ bool LibSVMBinaryReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matric
         if (matrices.HasInput(L"DSSMLabel"))
             DoDSSMMatrix(matrices.GetInputMatrix<ElemType>(L"DSSMLabel"), actualMBSize);
 
-        m_pendingAsyncGetMinibatch = std::async(std::launch::async, [this]()
+        m_pendingAsyncGetMinibatch = ThreadPool::Instance().Async(std::launch::async, [this]()
         {
             // CheckDataMatrices(matrices);
             return m_dataInput->FillMatrices(m_dataMatrices);
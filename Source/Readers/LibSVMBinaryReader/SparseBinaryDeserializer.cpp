@@ -0,0 +1,454 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <limits>
+#include "SparseBinaryDeserializer.h"
+#include "StringUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Features of a row, pointing into the mapped file. Holds the chunk, which holds the mapping.
+struct MappedSparseSequenceData : SparseSequenceData
+{
+    const void* m_values;
+    ChunkPtr m_chunk;
+
+    const void* GetDataBuffer() override
+    {
+        return m_values;
+    }
+};
+
+// Labels of a row, pointing into the mapped file.
+struct MappedDenseSequenceData : DenseSequenceData
+{
+    const void* m_values;
+    ChunkPtr m_chunk;
+
+    const void* GetDataBuffer() override
+    {
+        return m_values;
+    }
+};
+
+// Reads a value at a position of the mapped file, checking that it is within the given end.
+template <class T>
+static T ReadValue(const char*& pos, const char* end, const wstring& fileName)
+{
+    if (pos + sizeof(T) > end)
+        RuntimeError("SparseBinaryDeserializer: unexpected end of data in '%ls'.", fileName.c_str());
+    T value;
+    memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+static void Skip(const char*& pos, const char* end, size_t size, const wstring& fileName)
+{
+    if (size > (size_t)(end - pos))
+        RuntimeError("SparseBinaryDeserializer: unexpected end of data in '%ls'.", fileName.c_str());
+    pos += size;
+}
+
+// Locates the rows of a chunk in the mapped file, which only touches the counts, not the values.
+class SparseBinaryDeserializer::SparseBinaryChunk : public Chunk, public std::enable_shared_from_this<SparseBinaryChunk>
+{
+    // Data of a row in a file stream.
+    struct RowData
+    {
+        const char* m_values;
+        const char* m_indices; // sparse streams only
+        IndexType m_nnz;
+    };
+
+    const SparseBinaryDeserializer& m_parent;
+    shared_ptr<MappedFile> m_file;
+    KeyType m_firstKey;
+    vector<RowData> m_rows; // rows x file streams
+
+    void AddLibSVMBinaryRows(const char*& pos, const char* end)
+    {
+        const auto& fileName = m_parent.m_fileName;
+        const size_t elementSize = m_parent.m_elementSize;
+        size_t numberOfStreams = m_parent.m_fileStreams.size();
+        size_t numberOfRows = ReadValue<int32_t>(pos, end, fileName);
+        size_t first = m_rows.size();
+        m_rows.resize(first + numberOfRows * numberOfStreams);
+
+        for (size_t s = 0; s < numberOfStreams; ++s)
+        {
+            const auto& stream = m_parent.m_fileStreams[s];
+            if (!stream.m_sparse)
+            {
+                // dense labels, a column per row
+                size_t columnSize = stream.m_dimension * elementSize;
+                const char* values = pos;
+                Skip(pos, end, numberOfRows * columnSize, fileName);
+                for (size_t r = 0; r < numberOfRows; ++r)
+                    m_rows[first + r * numberOfStreams + s] = { values + r * columnSize, nullptr, 0 };
+                continue;
+            }
+
+            // sparse features in CSC layout: values, row indices and the column starts
+            size_t nnz = ReadValue<int32_t>(pos, end, fileName);
+            const char* values = pos;
+            Skip(pos, end, nnz * elementSize, fileName);
+            const char* indices = pos;
+            Skip(pos, end, nnz * sizeof(int32_t), fileName);
+            const char* columnStarts = pos;
+            Skip(pos, end, (numberOfRows + 1) * sizeof(int32_t), fileName);
+
+            for (size_t r = 0; r < numberOfRows; ++r)
+            {
+                int32_t begin, last;
+                memcpy(&begin, columnStarts + r * sizeof(int32_t), sizeof(int32_t));
+                memcpy(&last, columnStarts + (r + 1) * sizeof(int32_t), sizeof(int32_t));
+                if (begin < 0 || last < begin || (size_t)last > nnz)
+                    RuntimeError("SparseBinaryDeserializer: invalid column starts in '%ls'.", fileName.c_str());
+                m_rows[first + r * numberOfStreams + s] = { values + begin * elementSize, indices + begin * sizeof(int32_t), (IndexType)(last - begin) };
+            }
+        }
+    }
+
+    void AddSparsePCRow(const char*& pos, const char* end)
+    {
+        const auto& fileName = m_parent.m_fileName;
+        const size_t elementSize = m_parent.m_elementSize;
+        for (const auto& stream : m_parent.m_fileStreams)
+        {
+            RowData row = { nullptr, nullptr, 0 };
+            if (stream.m_sparse)
+            {
+                row.m_nnz = ReadValue<int32_t>(pos, end, fileName);
+                row.m_values = pos;
+                Skip(pos, end, row.m_nnz * elementSize, fileName);
+                row.m_indices = pos;
+                Skip(pos, end, row.m_nnz * sizeof(int32_t), fileName);
+            }
+            else
+            {
+                row.m_values = pos;
+                Skip(pos, end, elementSize, fileName);
+            }
+            m_rows.push_back(row);
+        }
+
+        if (m_parent.m_verificationCode != 0 && ReadValue<int32_t>(pos, end, fileName) != m_parent.m_verificationCode)
+            RuntimeError("SparseBinaryDeserializer: verification code did not match (expected %d) in '%ls'.", (int)m_parent.m_verificationCode, fileName.c_str());
+    }
+
+public:
+    SparseBinaryChunk(const SparseBinaryDeserializer& parent, const ChunkInfo& info)
+        : m_parent(parent), m_file(parent.m_file)
+    {
+        // The chunk is created on the prefetch thread: start reading all of it, not only the counts parsed below.
+        m_file->WillNeed(info.m_offset, info.m_size);
+
+        m_firstKey.m_sequence = info.m_firstRow;
+        m_firstKey.m_sample = 0;
+        m_rows.reserve(info.m_numberOfRows * parent.m_fileStreams.size());
+
+        const char* pos = m_file->GetData() + info.m_offset;
+        const char* end = pos + info.m_size;
+        while (pos < end)
+        {
+            if (parent.m_sparsePC)
+                AddSparsePCRow(pos, end);
+            else
+                AddLibSVMBinaryRows(pos, end);
+        }
+
+        if (m_rows.size() != info.m_numberOfRows * parent.m_fileStreams.size())
+            RuntimeError("SparseBinaryDeserializer: '%ls' changed since it was indexed.", parent.m_fileName.c_str());
+    }
+
+    void GetSequence(size_t sequenceIndex, vector<SequenceDataPtr>& result) override
+    {
+        KeyType key = m_firstKey;
+        key.m_sequence += sequenceIndex;
+
+        auto self = shared_from_this();
+        size_t numberOfStreams = m_parent.m_fileStreams.size();
+        for (size_t s = 0; s < numberOfStreams; ++s)
+        {
+            if (m_parent.m_fileStreams[s].m_streamId < 0)
+                continue;
+
+            const RowData& row = m_rows[sequenceIndex * numberOfStreams + s];
+            if (m_parent.m_fileStreams[s].m_sparse)
+            {
+                auto data = make_shared<MappedSparseSequenceData>();
+                data->m_values = row.m_values;
+                data->m_indices = const_cast<IndexType*>(reinterpret_cast<const IndexType*>(row.m_indices));
+                data->m_nnzCounts.assign(1, row.m_nnz);
+                data->m_totalNnzCount = row.m_nnz;
+                data->m_numberOfSamples = 1;
+                data->m_key = key;
+                data->m_chunk = self;
+                result.push_back(data);
+            }
+            else
+            {
+                auto data = make_shared<MappedDenseSequenceData>();
+                data->m_values = row.m_values;
+                data->m_numberOfSamples = 1;
+                data->m_key = key;
+                data->m_chunk = self;
+                result.push_back(data);
+            }
+        }
+    }
+};
+
+SparseBinaryDeserializer::SparseBinaryDeserializer(CorpusDescriptorPtr, const ConfigParameters& cfg, bool primary)
+    : DataDeserializerBase(primary), m_verificationCode(0), m_numberOfRows(0)
+{
+    if (!primary)
+        InvalidArgument("SparseBinaryDeserializer: only supported as the primary deserializer, the rows of the file have no keys.");
+
+    m_fileName = (wstring)cfg(L"file");
+    m_chunkSize = cfg(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024);
+
+    wstring precision = cfg(L"precision", L"float");
+    if (AreEqualIgnoreCase(precision, L"float"))
+        m_elementType = ElementType::tfloat;
+    else if (AreEqualIgnoreCase(precision, L"double"))
+        m_elementType = ElementType::tdouble;
+    else
+        InvalidArgument("SparseBinaryDeserializer: unsupported precision '%ls', expected 'float' or 'double'.", precision.c_str());
+    m_elementSize = m_elementType == ElementType::tfloat ? sizeof(float) : sizeof(double);
+
+    wstring format = cfg(L"format", L"libsvmBinary");
+    if (AreEqualIgnoreCase(format, L"libsvmBinary"))
+        m_sparsePC = false;
+    else if (AreEqualIgnoreCase(format, L"sparsePC"))
+        m_sparsePC = true;
+    else
+        InvalidArgument("SparseBinaryDeserializer: unsupported format '%ls', expected 'libsvmBinary' or 'sparsePC'.", format.c_str());
+
+    m_file = make_shared<MappedFile>(m_fileName);
+    if (m_sparsePC)
+    {
+        ConfigureSparsePCStreams(cfg);
+        IndexSparsePC();
+    }
+    else
+    {
+        size_t tableOffset, numberOfBatches;
+        ReadLibSVMBinaryHeader(cfg, tableOffset, numberOfBatches);
+        IndexLibSVMBinary(tableOffset, numberOfBatches);
+    }
+
+    if (m_numberOfRows == 0)
+        RuntimeError("SparseBinaryDeserializer: '%ls' has no rows.", m_fileName.c_str());
+    fprintf(stderr, "SparseBinaryDeserializer: %zu rows in %zu chunks from '%ls'\n", m_numberOfRows, m_chunks.size(), m_fileName.c_str());
+}
+
+void SparseBinaryDeserializer::AddStream(const wstring& name, bool sparse, size_t dimension)
+{
+    FileStream fileStream = { -1, sparse, dimension };
+    if (!name.empty())
+    {
+        fileStream.m_streamId = (int)m_streams.size();
+
+        auto stream = make_shared<StreamDescription>();
+        stream->m_id = fileStream.m_streamId;
+        stream->m_name = name;
+        stream->m_sampleLayout = make_shared<TensorShape>(dimension);
+        stream->m_storageType = sparse ? StorageType::sparse_csc : StorageType::dense;
+        stream->m_elementType = m_elementType;
+        m_streams.push_back(stream);
+    }
+    m_fileStreams.push_back(fileStream);
+}
+
+void SparseBinaryDeserializer::AddRows(size_t offset, size_t size, size_t numberOfRows)
+{
+    if (m_chunks.empty() || (m_chunks.back().m_size > 0 && m_chunks.back().m_size + size > m_chunkSize))
+        m_chunks.push_back({ offset, 0, m_numberOfRows, 0 });
+
+    auto& chunk = m_chunks.back();
+    if (chunk.m_offset + chunk.m_size != offset)
+        RuntimeError("SparseBinaryDeserializer: the microbatches in '%ls' are not stored consecutively.", m_fileName.c_str());
+    chunk.m_size += size;
+    chunk.m_numberOfRows += numberOfRows;
+    m_numberOfRows += numberOfRows;
+}
+
+// Header: int64 rows, int64 microbatches, int32 features, int32 labels, per stream (int32 length, name, int32 dim),
+// followed by the int64 offsets of the microbatches, relative to the data that follows them.
+void SparseBinaryDeserializer::ReadLibSVMBinaryHeader(const ConfigParameters& cfg, size_t& tableOffset, size_t& numberOfBatches)
+{
+    // name in the file -> stream name
+    map<wstring, wstring> names;
+    bool selectStreams = cfg.ExistsCurrent(L"input");
+    if (selectStreams)
+    {
+        ConfigParameters input = cfg(L"input");
+        for (const auto& id : input.GetMemberIds())
+        {
+            ConfigParameters streamConfig = input(id);
+            wstring name = msra::strfun::utf16(id);
+            names[streamConfig.ExistsCurrent(L"alias") ? (wstring)streamConfig(L"alias") : name] = name;
+        }
+    }
+
+    const char* pos = m_file->GetData();
+    const char* end = pos + m_file->Size();
+    ReadValue<int64_t>(pos, end, m_fileName); // number of rows, counted from the microbatches instead
+    int64_t batches = ReadValue<int64_t>(pos, end, m_fileName);
+    int32_t numberOfFeatures = ReadValue<int32_t>(pos, end, m_fileName);
+    int32_t numberOfLabels = ReadValue<int32_t>(pos, end, m_fileName);
+    if (batches <= 0 || numberOfFeatures < 0 || numberOfLabels < 0)
+        RuntimeError("SparseBinaryDeserializer: invalid header in '%ls'.", m_fileName.c_str());
+
+    for (int32_t i = 0; i < numberOfFeatures + numberOfLabels; ++i)
+    {
+        int32_t length = ReadValue<int32_t>(pos, end, m_fileName);
+        const char* begin = pos;
+        Skip(pos, end, length, m_fileName);
+        wstring fileName = msra::strfun::utf16(string(begin, pos));
+        int32_t dimension = ReadValue<int32_t>(pos, end, m_fileName);
+
+        wstring name;
+        auto found = names.find(fileName);
+        if (found != names.end())
+        {
+            name = found->second;
+            names.erase(found);
+        }
+        else if (!selectStreams)
+            name = fileName;
+        AddStream(name, i < numberOfFeatures, dimension);
+    }
+
+    if (!names.empty())
+        InvalidArgument("SparseBinaryDeserializer: the input '%ls' is not in '%ls'.", names.begin()->first.c_str(), m_fileName.c_str());
+    if (m_streams.empty())
+        InvalidArgument("SparseBinaryDeserializer: no streams selected from '%ls'.", m_fileName.c_str());
+
+    tableOffset = pos - m_file->GetData();
+    numberOfBatches = (size_t)batches;
+}
+
+void SparseBinaryDeserializer::IndexLibSVMBinary(size_t tableOffset, size_t numberOfBatches)
+{
+    const char* data = m_file->GetData();
+    size_t fileSize = m_file->Size();
+
+    const char* table = data + tableOffset;
+    Skip(table, data + fileSize, numberOfBatches * sizeof(int64_t), m_fileName);
+    size_t dataStart = tableOffset + numberOfBatches * sizeof(int64_t);
+
+    const char* pos = data + tableOffset;
+    int64_t offset = ReadValue<int64_t>(pos, table, m_fileName);
+    for (size_t b = 0; b < numberOfBatches; ++b)
+    {
+        int64_t next = b + 1 < numberOfBatches ? ReadValue<int64_t>(pos, table, m_fileName) : (int64_t)(fileSize - dataStart);
+        if (offset < 0 || next < offset + (int64_t)sizeof(int32_t) || dataStart + next > fileSize)
+            RuntimeError("SparseBinaryDeserializer: invalid microbatch offsets in '%ls'.", m_fileName.c_str());
+
+        const char* batch = data + dataStart + offset;
+        int32_t numberOfRows = ReadValue<int32_t>(batch, data + fileSize, m_fileName);
+        AddRows(dataStart + offset, next - offset, numberOfRows);
+        offset = next;
+    }
+}
+
+void SparseBinaryDeserializer::ConfigureSparsePCStreams(const ConfigParameters& cfg)
+{
+    m_verificationCode = (int32_t)cfg(L"verificationCode", (size_t)0);
+
+    ConfigParameters input = cfg(L"input");
+    wstring labelName;
+    vector<pair<wstring, size_t>> features;
+    for (const auto& id : input.GetMemberIds())
+    {
+        ConfigParameters streamConfig = input(id);
+        if (streamConfig.ExistsCurrent(L"labelType"))
+        {
+            if (!labelName.empty())
+                InvalidArgument("SparseBinaryDeserializer: the sparsePC format has exactly one label.");
+            labelName = msra::strfun::utf16(id);
+        }
+        else
+            features.push_back(make_pair(msra::strfun::utf16(id), (size_t)streamConfig(L"dim")));
+    }
+    if (labelName.empty() || features.empty())
+        InvalidArgument("SparseBinaryDeserializer: the sparsePC format requires features (dim) and a label (labelType) in the input section.");
+
+    for (auto feature = features.rbegin(); feature != features.rend(); ++feature)
+        AddStream(feature->first, true, feature->second);
+    AddStream(labelName, false, 1);
+}
+
+// Rows: per feature (int32 nnz, values, int32 row indices), the label value and the optional int32 verification code.
+void SparseBinaryDeserializer::IndexSparsePC()
+{
+    const char* data = m_file->GetData();
+    const char* end = data + m_file->Size();
+    const char* pos = data;
+    while (pos < end)
+    {
+        const char* row = pos;
+        for (const auto& stream : m_fileStreams)
+        {
+            if (stream.m_sparse)
+            {
+                int32_t nnz = ReadValue<int32_t>(pos, end, m_fileName);
+                if (nnz < 0 || (size_t)nnz > stream.m_dimension)
+                    RuntimeError("SparseBinaryDeserializer: invalid number of non-zero values %d in row %zu of '%ls'.", (int)nnz, m_numberOfRows, m_fileName.c_str());
+                Skip(pos, end, nnz * (m_elementSize + sizeof(int32_t)), m_fileName);
+            }
+            else
+                Skip(pos, end, m_elementSize, m_fileName);
+        }
+        if (m_verificationCode != 0)
+            Skip(pos, end, sizeof(int32_t), m_fileName);
+
+        AddRows(row - data, pos - row, 1);
+    }
+}
+
+ChunkDescriptions SparseBinaryDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions chunks;
+    chunks.reserve(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = (ChunkIdType)i;
+        cd->m_numberOfSamples = m_chunks[i].m_numberOfRows;
+        cd->m_numberOfSequences = m_chunks[i].m_numberOfRows;
+        chunks.push_back(cd);
+    }
+    return chunks;
+}
+
+void SparseBinaryDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_chunks[chunkId];
+    result.reserve(chunk.m_numberOfRows);
+    for (size_t i = 0; i < chunk.m_numberOfRows; ++i)
+    {
+        SequenceDescription s;
+        s.m_chunkId = chunkId;
+        s.m_key.m_sequence = chunk.m_firstRow + i;
+        s.m_key.m_sample = 0;
+        s.m_indexInChunk = i;
+        s.m_numberOfSamples = 1;
+        result.push_back(s);
+    }
+}
+
+ChunkPtr SparseBinaryDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return make_shared<SparseBinaryChunk>(*this, m_chunks[chunkId]);
+}
+
+}}}
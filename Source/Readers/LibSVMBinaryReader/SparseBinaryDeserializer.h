@@ -0,0 +1,90 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+#include "MappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer for the sparse binary files of the LibSVMBinaryReader and the SparsePCReader, so that these jobs get
+// the chunk randomization and prefetch of the ReaderShim pipeline instead of the threads of the old readers.
+// The file is memory mapped; the sequences (one sample each, one per row of the file) point into the mapped pages
+// without copying. Formats:
+//  - "libsvmBinary": header with the names and dimensions of the sparse features and dense labels, followed by
+//    a table of microbatches of rows in CSC layout. The streams are named as in the header; if there is an input
+//    section only its streams are exposed, with 'alias' giving the name in the file.
+//  - "sparsePC": rows of (nnz, values, row indices) per feature, followed by a scalar label and an optional
+//    verification code. There is no header, so the input section defines the features (dim) and the label
+//    (labelType); as in the SparsePCReader, the features are stored in the reverse order of the input section.
+// E.g. deserializers = ([ type = "SparseBinaryDeserializer" ; module = "LibSVMBinaryReader"
+//                         file = "train.bin" ; format = "libsvmBinary" ; precision = "float" ])
+class SparseBinaryDeserializer : public DataDeserializerBase, boost::noncopyable
+{
+public:
+    SparseBinaryDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& s) override;
+
+    // Retrieves a chunk with data.
+    virtual ChunkPtr GetChunk(ChunkIdType) override;
+
+private:
+    class SparseBinaryChunk;
+
+    // Byte range and rows of a chunk, a run of whole microbatches (libsvmBinary) or rows (sparsePC).
+    struct ChunkInfo
+    {
+        size_t m_offset;
+        size_t m_size;
+        size_t m_firstRow;
+        size_t m_numberOfRows;
+    };
+
+    // Stream of the file, mapped to a stream of the deserializer, or not exposed (m_streamId < 0).
+    struct FileStream
+    {
+        int m_streamId;
+        bool m_sparse;
+        size_t m_dimension;
+    };
+
+    // Reads the streams of the header, returns the position and length of the table of microbatch offsets.
+    void ReadLibSVMBinaryHeader(const ConfigParameters& config, size_t& tableOffset, size_t& numberOfBatches);
+    void IndexLibSVMBinary(size_t tableOffset, size_t numberOfBatches);
+
+    void ConfigureSparsePCStreams(const ConfigParameters& config);
+    void IndexSparsePC();
+
+    // Adds a stream of the file, exposed under the given name unless it is empty.
+    void AddStream(const std::wstring& name, bool sparse, size_t dimension);
+
+    // Starts a new chunk at the given offset if the current one exceeds the chunk size.
+    void AddRows(size_t offset, size_t size, size_t numberOfRows);
+
+    std::wstring m_fileName;
+    std::shared_ptr<MappedFile> m_file;
+    bool m_sparsePC;
+
+    ElementType m_elementType;
+    size_t m_elementSize;
+
+    std::vector<FileStream> m_fileStreams;
+    int32_t m_verificationCode; // sparsePC: 0 if the rows have no verification code
+
+    size_t m_chunkSize;
+    std::vector<ChunkInfo> m_chunks;
+    size_t m_numberOfRows;
+};
+
+}}}
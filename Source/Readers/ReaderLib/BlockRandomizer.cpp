@@ -9,10 +9,12 @@
 #include <inttypes.h>
 #include "BlockRandomizer.h"
 #include <algorithm>
+#include <chrono>
 #include <utility>
 
 #include "DataReader.h"
 #include "ExceptionCapture.h"
+#include "ThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,7 +25,10 @@ BlockRandomizer::BlockRandomizer(
     bool shouldPrefetch,
     bool multithreadedGetNextSequence,
     size_t maxNumberOfInvalidSequences,
-    bool sampleBasedRandomizationWindow)
+    bool sampleBasedRandomizationWindow,
+    size_t prefetchDepth,
+    bool sharded,
+    size_t shardRebalanceSweeps)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_sweep(SIZE_MAX),
@@ -33,10 +38,16 @@ BlockRandomizer::BlockRandomizer(
       m_sweepSizeInSamples(0),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRange, sampleBasedRandomizationWindow)),
       m_multithreadedGetNextSequences(multithreadedGetNextSequence),
-      m_prefetchedChunk(CHUNKID_MAX),
+      m_prefetchDepth(prefetchDepth),
+      m_sharded(sharded),
+      m_shardRebalanceSweeps(shardRebalanceSweeps),
+      m_shardsNumberOfWorkers(0),
+      m_chunkLoadStallTime(0),
       m_cleaner(maxNumberOfInvalidSequences)
 {
     assert(deserializer != nullptr);
+    if (prefetchDepth == 0)
+        InvalidArgument("The chunk prefetch depth must be greater than zero.");
 
     m_launchType = shouldPrefetch ? launch::async : launch::deferred;
 
@@ -226,9 +237,8 @@ std::pair<size_t, size_t> BlockRandomizer::LoadSequenceData(size_t globalSampleC
             process(i);
     }
 
-    // Now it is safe to start the new chunk prefetch.
-    ChunkIdType chunkToPrefetchNext = GetChunkToPrefetch(windowRange);
-    Prefetch(chunkToPrefetchNext);
+    // Now it is safe to start the new chunk prefetches.
+    Prefetch(windowRange);
 
     return { numGlobalSamples, numLocalSamples };
 }
@@ -265,8 +275,9 @@ std::tuple<bool, bool, size_t, size_t> BlockRandomizer::GetNextSequenceDescripti
     if (globalSampleCount == 0)
         LogicError("Global sample count must not result in zero.");
 
+    UpdateShards();
     std::function<bool(const RandomizedSequenceDescription*)> isLocalSequence =
-        [this](const RandomizedSequenceDescription* s) { return s->m_chunk->m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank; };
+        [this](const RandomizedSequenceDescription* s) { return IsLocalChunk(*s->m_chunk); };
 
     size_t actualNumberOfGlobalSamples = 0, actualNumberOfLocalSamples = 0;
     std::tie(actualNumberOfGlobalSamples, actualNumberOfLocalSamples) = m_sequenceRandomizer->GetNextSequenceDescriptions(
@@ -323,7 +334,7 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
     for (size_t i = windowRange.m_begin; i < windowRange.m_end; ++i)
     {
         auto const& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
-        if (chunk.m_chunkId % m_config.m_numberOfWorkers != m_config.m_workerRank)
+        if (!IsLocalChunk(chunk))
         {
             continue;
         }
@@ -352,10 +363,13 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
         }
 
         auto const& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
-        if (chunk.m_original->m_id == m_prefetchedChunk && m_prefetch.valid())
+        auto stallStart = std::chrono::steady_clock::now();
+        auto prefetch = m_prefetches.find(chunk.m_original->m_id);
+        if (prefetch != m_prefetches.end())
         {
             // Taking prefetched chunk.
-            m_chunks[chunk.m_original->m_id] = m_prefetch.get();
+            m_chunks[chunk.m_original->m_id] = prefetch->second.get();
+            m_prefetches.erase(prefetch);
             if (m_verbosity >= Information)
                 fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in prefetched chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
                 chunk.m_chunkId,
@@ -365,9 +379,9 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
         else
         {
             // Make sure we have no outstanding prefetches.
-            if (m_prefetch.valid())
+            if (m_lastPrefetch.valid())
             {
-                m_prefetch.wait();
+                m_lastPrefetch.wait();
             }
 
             m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
@@ -377,6 +391,7 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 chunk.m_original->m_id,
                 ++numLoadedChunks);
         }
+        m_chunkLoadStallTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - stallStart).count();
     }
 
     if (m_verbosity >= Notification)
@@ -386,39 +401,114 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 m_chunkRandomizer->GetRandomizedChunks()[windowRange.m_end - 1].m_chunkId);
 }
 
-// Identifies chunk id that should be prefetched.
-ChunkIdType BlockRandomizer::GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange)
+// Identifies chunk ids that should be prefetched.
+std::vector<ChunkIdType> BlockRandomizer::GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange)
 {
-    ChunkIdType toBePrefetched = CHUNKID_MAX;
+    std::vector<ChunkIdType> toBePrefetched;
     auto current = windowRange.m_end;
-    while (current < m_chunkRandomizer->GetRandomizedChunks().size())
+    while (current < m_chunkRandomizer->GetRandomizedChunks().size() && toBePrefetched.size() < m_prefetchDepth)
     {
         const auto& chunk = m_chunkRandomizer->GetRandomizedChunks()[current];
-        if (chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank &&
+        if (IsLocalChunk(chunk) &&
             m_chunks.find(chunk.m_original->m_id) == m_chunks.end())
         {
-            toBePrefetched = chunk.m_original->m_id;
-            break;
+            toBePrefetched.push_back(chunk.m_original->m_id);
         }
         ++current;
     }
     return toBePrefetched;
 }
 
-// Performs io prefetch of the specified chunk if needed.
-void BlockRandomizer::Prefetch(ChunkIdType chunkId)
+bool BlockRandomizer::IsLocalChunk(const RandomizedChunk& chunk)
+{
+    if (!m_sharded)
+        return chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank;
+
+    size_t rotation = m_shardRebalanceSweeps > 0 ? m_sweep / m_shardRebalanceSweeps : 0;
+    return (m_shardOfChunk[chunk.m_original->m_id] + rotation) % m_config.m_numberOfWorkers == m_config.m_workerRank;
+}
+
+void BlockRandomizer::UpdateShards()
 {
-    // Start new prefetch if necessary.
-    if (m_prefetchedChunk != chunkId && chunkId != CHUNKID_MAX)
+    if (!m_sharded || m_shardsNumberOfWorkers == m_config.m_numberOfWorkers)
+        return;
+
+    // Contiguous ranges of the original chunks, balanced by samples: a chunk goes to the shard its middle falls in.
+    auto chunks = m_deserializer->GetChunkDescriptions();
+    size_t numberOfWorkers = m_config.m_numberOfWorkers;
+    m_shardOfChunk.assign(chunks.size(), 0);
+    size_t samplesBefore = 0;
+    for (const auto& chunk : chunks)
     {
-        // Wait to make sure there is no outstanding prefetches.
-        if (m_prefetch.valid())
+        size_t middle = samplesBefore + chunk->m_numberOfSamples / 2;
+        m_shardOfChunk[chunk->m_id] = std::min(numberOfWorkers - 1, middle * numberOfWorkers / m_sweepSizeInSamples);
+        samplesBefore += chunk->m_numberOfSamples;
+    }
+    m_shardsNumberOfWorkers = numberOfWorkers;
+
+    if (m_verbosity >= Notification)
+    {
+        size_t numberOfChunks = 0, numberOfSamples = 0;
+        for (const auto& chunk : chunks)
         {
-            m_prefetch.wait();
+            if (m_shardOfChunk[chunk->m_id] == m_config.m_workerRank)
+            {
+                numberOfChunks++;
+                numberOfSamples += chunk->m_numberOfSamples;
+            }
         }
+        fprintf(stderr, "BlockRandomizer::UpdateShards: shard %" PRIu64 " of %" PRIu64 " has %" PRIu64 " chunks with %" PRIu64 " samples, rebalanced every %" PRIu64 " sweeps\n",
+                m_config.m_workerRank, numberOfWorkers, numberOfChunks, numberOfSamples, m_shardRebalanceSweeps);
+    }
+}
 
-        m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+// Performs io prefetch of the chunks following the window if needed.
+void BlockRandomizer::Prefetch(const ClosedOpenChunkInterval& windowRange)
+{
+    auto toBePrefetched = GetChunksToPrefetch(windowRange);
+
+    // Drop prefetched chunks that are not needed anymore (e.g. after a new sweep was randomized),
+    // those still in flight are kept till the next time, not to block here.
+    for (auto it = m_prefetches.begin(); it != m_prefetches.end();)
+    {
+        if (std::find(toBePrefetched.begin(), toBePrefetched.end(), it->first) == toBePrefetched.end() &&
+            it->second.wait_for(std::chrono::seconds(0)) != std::future_status::timeout)
+        {
+            if (m_verbosity >= Debug)
+                fprintf(stderr, "BlockRandomizer::Prefetch: dropping prefetched original chunk: %u\n", it->first);
+            it = m_prefetches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Start new prefetches if necessary.
+    for (auto chunkId : toBePrefetched)
+    {
+        if (m_prefetches.size() >= m_prefetchDepth)
+        {
+            break;
+        }
+
+        if (m_prefetches.find(chunkId) != m_prefetches.end())
+        {
+            continue;
+        }
+
+        // Each load waits for the preceding one, so that the deserializer is called from one thread at a time.
+        std::shared_future<ChunkPtr> previous = m_lastPrefetch;
+        m_lastPrefetch = ThreadPool::Instance().Async(m_launchType, [this, chunkId, previous]() mutable
+        {
+            if (previous.valid())
+            {
+                previous.wait();
+                previous = std::shared_future<ChunkPtr>(); // do not keep the preceding chunk alive
+            }
+            return m_deserializer->GetChunk(chunkId);
+        }).share();
+        m_prefetches[chunkId] = m_lastPrefetch;
 
         if (m_verbosity >= Debug)
             fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
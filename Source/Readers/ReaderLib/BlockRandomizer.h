@@ -13,6 +13,7 @@
 #include "SequenceRandomizer.h"
 #include "ReaderUtil.h"
 #include <future>
+#include <map>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -32,6 +33,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //
 // This class is responsible for decimation and loading the data chunks in to memory.
 // Actual randomization happens in ChunkRandomizer and SequenceRandomizer.
+//
+// With prefetch, the next prefetchDepth chunks of the worker that follow the current window in the randomized chunk order
+// are loaded in the background, so that high-latency storage has time to deliver them before the window moves on.
+// Deserializers do not support concurrent GetChunk() calls, so the loads are chained, each starts after the preceding one.
+// Memory is bounded by prefetchDepth chunks on top of the window.
+//
+// By default the chunks are decimated by their position in the randomized order, so the chunks of a worker change in
+// every sweep. With sharding, each worker owns a stable shard instead: a contiguous range of the original chunks
+// (so mostly whole files) with about 1/numberOfWorkers of the samples. The worker still sees its chunks in the
+// randomized order, so it shuffles within its shard, and a ChunkCache (or the page cache) keeps serving its chunks
+// from local memory across sweeps. Every shardRebalanceSweeps sweeps (0 for never) the shards move on to the next
+// worker, so that over a long training each worker sees all of the data.
 // TODO: The behavior can be simplified by only randomizing sequences forward.
 class BlockRandomizer : public SequenceEnumerator
 {
@@ -43,7 +56,10 @@ public:
         bool shouldPrefetch,
         bool multithreadedGetNextSequences = false,
         size_t maxNumberOfInvalidSequences = 0, // per worker
-        bool sampleBasedRandomizationWindow = true);
+        bool sampleBasedRandomizationWindow = true,
+        size_t prefetchDepth = 1,
+        bool sharded = false,
+        size_t shardRebalanceSweeps = 0);
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -62,11 +78,18 @@ public:
     // Returns current position in the global timeline. The returned value is in samples.
     size_t GetCurrentSamplePosition() override;
 
+    // Returns the total time GetNextSequences() waited for chunks to be loaded, in seconds.
+    double GetChunkLoadStallTime() override
+    {
+        return m_chunkLoadStallTime;
+    }
+
     ~BlockRandomizer()
     {
-        if (m_prefetch.valid())
+        // the last prefetch waits for all preceding ones
+        if (m_lastPrefetch.valid() && m_launchType == launch::async)
         {
-            m_prefetch.wait();
+            m_lastPrefetch.wait();
         }
     }
 
@@ -97,11 +120,17 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
-    // Performs io prefetch of the specified chunk if needed.
-    void Prefetch(ChunkIdType chunkId);
+    // Starts the io prefetch of the chunks following the given window, up to the prefetch depth.
+    void Prefetch(const ClosedOpenChunkInterval& windowRange);
+
+    // Returns the next (up to m_prefetchDepth) candidates for the prefetch after the given window.
+    std::vector<ChunkIdType> GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange);
+
+    // Whether the chunk belongs to this worker, in the current sweep.
+    bool IsLocalChunk(const RandomizedChunk& chunk);
 
-    // Returns next candidate for the prefetch in the given range.
-    ChunkIdType GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange);
+    // Assigns the original chunks to the shards, if not done yet for the current number of workers.
+    void UpdateShards();
 
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
@@ -150,12 +179,24 @@ private:
 
     int m_verbosity;
 
-    // Prefetch future.
-    std::future<ChunkPtr> m_prefetch;
+    // Prefetch futures by original chunk id, loaded or in flight, at most m_prefetchDepth.
+    std::map<ChunkIdType, std::shared_future<ChunkPtr>> m_prefetches;
+    // The most recently started prefetch, the end of the chain.
+    std::shared_future<ChunkPtr> m_lastPrefetch;
     // Whether to have async or deferred prefetch.
     launch m_launchType;
-    // Prefetched original chunk id.
-    ChunkIdType m_prefetchedChunk;
+    // Maximum number of chunks prefetched ahead of the window.
+    size_t m_prefetchDepth;
+
+    // Sharding: whether workers own stable shards, and how often the shards move on to the next worker.
+    bool m_sharded;
+    size_t m_shardRebalanceSweeps;
+    // Shard of each original chunk, for m_shardsNumberOfWorkers workers.
+    std::vector<size_t> m_shardOfChunk;
+    size_t m_shardsNumberOfWorkers;
+
+    // Total time spent waiting for chunks in LoadDataChunks(), in seconds.
+    double m_chunkLoadStallTime;
 
     // Current loaded chunks.
     ClosedOpenChunkInterval m_currentWindowRange;
@@ -7,6 +7,8 @@
 #include "Bundler.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <future>
+#include "ThreadPool.h"
 #include <set>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -30,6 +32,7 @@ Bundler::Bundler(
       m_primaryDeserializer(primaryDeserializer)
 {
     m_verbosity = readerConfig(L"verbosity", 0);
+    m_parallelChunkLoading = readerConfig(L"parallelChunkLoading", true);
 
     // Combines streams of underlying deserializers.
     for (auto d : deserializers)
@@ -241,27 +244,15 @@ public:
         std::vector<SequenceDescription> sequences;
         sequences.reserve(original->m_numberOfSequences);
 
-        // Creating chunk mapping.
         m_parent->m_primaryDeserializer->GetSequencesForChunk(original->m_id, sequences);
-        ChunkPtr drivingChunk = m_parent->m_primaryDeserializer->GetChunk(original->m_id);
         m_sequenceToSequence.resize(deserializers.size() * sequences.size());
         m_innerChunks.resize(deserializers.size() * sequences.size());
-        for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
-        {
-            if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
-            {
-                continue;
-            }
-
-            size_t currentIndex = sequenceIndex * deserializers.size();
-            m_sequenceToSequence[currentIndex] = sequences[sequenceIndex].m_indexInChunk;
-            m_innerChunks[currentIndex] = drivingChunk;
-        }
 
-        // Creating sequence mapping and requiring underlying chunks.
-        SequenceDescription s;
-        for (size_t deserializerIndex = 1; deserializerIndex < deserializers.size(); ++deserializerIndex)
+        // Creating sequence mapping and requiring underlying chunks of the secondary deserializers.
+        // Each deserializer only writes its own entries, so that they can be loaded concurrently.
+        auto loadSecondaryChunks = [this, chunk, &deserializers, &sequences](size_t deserializerIndex)
         {
+            SequenceDescription s;
             auto& chunkTable = m_parent->m_weakChunkTable[deserializerIndex];
             for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
             {
@@ -283,7 +274,59 @@ public:
 
                 m_innerChunks[currentIndex] = secondaryChunk;
             }
+        };
+
+        // With parallel chunk loading, every secondary deserializer loads on its own thread while the primary one loads
+        // on this thread, so that the chunk takes as long as its slowest deserializer rather than all of them together.
+        // Each deserializer is still called from one thread at a time.
+        auto launchType = m_parent->m_parallelChunkLoading ? launch::async : launch::deferred;
+        std::vector<std::future<void>> secondaryLoads;
+        // The loads use the locals of this function; unlike those of std::async(), the futures of the thread pool do not
+        // wait when destroyed, so this does if the primary deserializer throws.
+        struct WaitForLoads
+        {
+            std::vector<std::future<void>>& loads;
+            ~WaitForLoads()
+            {
+                for (auto& load : loads)
+                    if (load.valid())
+                        load.wait();
+            }
+        } waitForLoads = { secondaryLoads };
+        for (size_t deserializerIndex = 1; deserializerIndex < deserializers.size(); ++deserializerIndex)
+            secondaryLoads.push_back(ThreadPool::Instance().Async(launchType, std::bind(loadSecondaryChunks, deserializerIndex)));
+
+        // Creating chunk mapping.
+        ChunkPtr drivingChunk = m_parent->m_primaryDeserializer->GetChunk(original->m_id);
+
+        for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
+        {
+            if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
+            {
+                continue;
+            }
+
+            size_t currentIndex = sequenceIndex * deserializers.size();
+            m_sequenceToSequence[currentIndex] = sequences[sequenceIndex].m_indexInChunk;
+            m_innerChunks[currentIndex] = drivingChunk;
+        }
+
+        // Rethrows the first failure of a secondary deserializer, after all of them have finished.
+        std::exception_ptr exception;
+        for (auto& load : secondaryLoads)
+        {
+            try
+            {
+                load.get();
+            }
+            catch (...)
+            {
+                if (!exception)
+                    exception = std::current_exception();
+            }
         }
+        if (exception)
+            std::rethrow_exception(exception);
     }
 
     // Gets sequence by its index.
@@ -63,6 +63,9 @@ private:
     // Inner vector is the table of chunk id into weak pointer, the outer vector has an element per deserializer.
     std::vector<std::vector<std::weak_ptr<Chunk>>> m_weakChunkTable;
 
+    // Whether the chunks of the deserializers are loaded concurrently, see BundlingChunk.
+    bool m_parallelChunkLoading;
+
     // General configuration
     int m_verbosity;
 };
@@ -9,18 +9,83 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+ChunkCache::ChunkCache(IDataDeserializerPtr deserializer, size_t maxSizeInBytes, bool verbose)
+    : m_deserializer(deserializer),
+      m_maxSizeInBytes(maxSizeInBytes),
+      m_verbose(verbose),
+      m_warnedUnknownSize(false),
+      m_statistics()
+{
+}
+
+ChunkCache::~ChunkCache()
+{
+    if (!m_verbose)
+        return;
+
+    fprintf(stderr, "ChunkCache: %zu hits, %zu misses, %zu evictions, %zu chunks (%.1f MB) cached at the end.\n",
+            m_statistics.m_hits, m_statistics.m_misses, m_statistics.m_evictions,
+            m_statistics.m_numberOfChunks, m_statistics.m_sizeInBytes / (1024.0 * 1024.0));
+}
+
 ChunkPtr ChunkCache::GetChunk(ChunkIdType chunkId)
 {
-    auto it = m_chunkMap.find(chunkId);
-    if (it != m_chunkMap.end())
     {
-        return it->second;
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto it = m_chunkMap.find(chunkId);
+        if (it != m_chunkMap.end())
+        {
+            m_lru.splice(m_lru.begin(), m_lru, it->second.m_lruPosition);
+            m_statistics.m_hits++;
+            return it->second.m_chunk;
+        }
+        m_statistics.m_misses++;
     }
- 
+
+    // Loading outside of the lock, the deserializer is not called concurrently anyway.
     ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
-    m_chunkMap[chunkId] = chunk;
- 
+    size_t sizeInBytes = m_maxSizeInBytes > 0 ? chunk->SizeInBytes() : 0;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_maxSizeInBytes > 0 && sizeInBytes == 0 && !m_warnedUnknownSize)
+    {
+        fprintf(stderr, "WARNING: ChunkCache: the size of the chunks is unknown, the cache is not limited.\n");
+        m_warnedUnknownSize = true;
+    }
+
+    if (m_maxSizeInBytes > 0 && sizeInBytes > m_maxSizeInBytes)
+        return chunk;
+
+    if (m_chunkMap.find(chunkId) == m_chunkMap.end())
+    {
+        m_lru.push_front(chunkId);
+        m_chunkMap[chunkId] = CacheEntry{ chunk, sizeInBytes, m_lru.begin() };
+        m_statistics.m_numberOfChunks++;
+        m_statistics.m_sizeInBytes += sizeInBytes;
+        Shrink();
+    }
+
     return chunk;
 }
 
+void ChunkCache::Shrink()
+{
+    while (m_maxSizeInBytes > 0 && m_statistics.m_sizeInBytes > m_maxSizeInBytes)
+    {
+        auto it = m_chunkMap.find(m_lru.back());
+        assert(it != m_chunkMap.end());
+        m_statistics.m_sizeInBytes -= it->second.m_sizeInBytes;
+        m_statistics.m_numberOfChunks--;
+        m_statistics.m_evictions++;
+        m_chunkMap.erase(it);
+        m_lru.pop_back();
+    }
+}
+
+ChunkCache::Statistics ChunkCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_statistics;
+}
+
 } } }
@@ -5,22 +5,31 @@
 
 #pragma once
 
+#include <list>
 #include <map>
+#include <mutex>
 #include "DataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// A cache to store the complete dataset (all chunks) in memory. The caching can
+// A cache to keep the chunks of the dataset in memory across sweeps. The caching can
 // be switched on/off by a boolean flag in the reader config section, independent 
-// of the randomization and chunking parameters. The caching should only be enabled 
-// when the whole dataset fits in memory.
+// of the randomization and chunking parameters.
 // Implemented as a wrapping proxy around a deserializer that stores pointers to
-// all chunks it sees in an internal map.
+// the chunks it sees in an internal map.
+//
+// Without a limit all chunks are kept, which only works when the whole dataset fits in memory.
+// With a limit (in bytes, as reported by Chunk::SizeInBytes()) the least recently used chunks are evicted,
+// so that repeated sweeps over a dataset larger than the limit still find the hot part of it in memory.
+// Chunks that are larger than the limit on their own are not cached. Evicted chunks are released
+// once the randomizer does not reference them anymore.
 class ChunkCache : public IDataDeserializer
 {
 public:
+    // maxSizeInBytes == 0 means no limit.
+    ChunkCache(IDataDeserializerPtr deserializer, size_t maxSizeInBytes = 0, bool verbose = false);
 
-    ChunkCache(IDataDeserializerPtr deserializer) : m_deserializer(deserializer) { }
+    ~ChunkCache();
 
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
@@ -45,11 +54,40 @@ public:
     // Gets chunk data given its id.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId);
 
+    struct Statistics
+    {
+        size_t m_hits;
+        size_t m_misses;
+        size_t m_evictions;
+        size_t m_numberOfChunks; // currently cached
+        size_t m_sizeInBytes;    // of the currently cached chunks
+    };
+
+    Statistics GetStatistics() const;
+
 private:
-    // A map of currently loaded chunks
-    std::map<size_t, ChunkPtr> m_chunkMap;
+    struct CacheEntry
+    {
+        ChunkPtr m_chunk;
+        size_t m_sizeInBytes;
+        std::list<ChunkIdType>::iterator m_lruPosition;
+    };
+
+    // Evicts the least recently used chunks until the cache fits into the limit.
+    void Shrink();
+
+    // A map of currently cached chunks
+    std::map<ChunkIdType, CacheEntry> m_chunkMap;
+    // Ids of the cached chunks, the most recently used first.
+    std::list<ChunkIdType> m_lru;
     IDataDeserializerPtr m_deserializer;
 
+    const size_t m_maxSizeInBytes;
+    const bool m_verbose;
+    bool m_warnedUnknownSize;
+    Statistics m_statistics;
+    mutable std::mutex m_lock;
+
     DISABLE_COPY_AND_MOVE(ChunkCache);
 };
 
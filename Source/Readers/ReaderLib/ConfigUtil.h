@@ -7,6 +7,7 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
 #include "Config.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -37,6 +38,24 @@ inline std::vector<std::string> GetSectionsWithParameter(const std::string& read
     return result;
 }
 
+// Number of minibatches the ReaderShim prefetches ahead of the network ("prefetchDepth").
+inline size_t GetPrefetchDepth(const ConfigParameters& config)
+{
+    int depth = config(L"prefetchDepth", 2);
+    if (depth < 1)
+    {
+        InvalidArgument("prefetchDepth must be at least 1, %d was specified.", depth);
+    }
+    return (size_t)depth;
+}
+
+// Each prefetched minibatch keeps its pinned packer buffer until its copy to the device
+// has finished, so packers need at least as many buffers as the prefetch depth.
+inline size_t GetNumberOfPackerBuffers(const ConfigParameters& config)
+{
+    return std::max<size_t>(2, GetPrefetchDepth(config));
+}
+
 // This class allows specifying delimiters and 3 dot patterns
 // both for char and wchar_t strings.
 template<class T>
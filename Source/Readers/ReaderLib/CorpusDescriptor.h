@@ -9,7 +9,7 @@
 #include <inttypes.h>
 
 #include "StringToIdMap.h"
-#include <set>
+#include <unordered_set>
 #include <functional>
 #include <sstream>
 
@@ -93,6 +93,13 @@ public:
         return m_sequenceIds.find(id) != m_sequenceIds.end();
     }
 
+    // Makes room for as many more symbolic keys and characters, e.g. those of an index cache.
+    void ReserveKeys(size_t numKeys, size_t numChars)
+    {
+        if (!m_numericSequenceKeys)
+            m_keyToIdMap.Reserve(numKeys, numChars);
+    }
+
     std::function<size_t(const std::string&)> KeyToId;
     std::function<std::string(size_t)> IdToKey;
 
@@ -100,7 +107,7 @@ private:
     DISABLE_COPY_AND_MOVE(CorpusDescriptor);
     bool m_numericSequenceKeys;
     bool m_includeAll;
-    std::set<size_t> m_sequenceIds;
+    std::unordered_set<size_t> m_sequenceIds;
 
     StringToIdMap m_keyToIdMap;
 };
@@ -5,10 +5,8 @@
 
 #pragma once
 
-#include <memory>
-#include <CUDAPageLockedMemAllocator.h>
-
 #include "MemoryProvider.h"
+#include "PinnedMemoryPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -16,18 +14,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 /// to decide what memory to use per stream. This class will be moved in the near future.
 class CudaMemoryProvider : public MemoryProvider
 {
-    std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
+    PinnedMemoryPool& m_pool; // page-locked buffers are slow to allocate and free, they are reused
 
 public:
     CudaMemoryProvider(int deviceId)
+        : m_pool(PinnedMemoryPool::Get(deviceId))
     {
-        m_allocator = std::make_unique<CUDAPageLockedMemAllocator>(deviceId);
     }
 
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
     {
         size_t totalSize = elementSize * numberOfElements;
-        return m_allocator->Malloc(totalSize);
+        return m_pool.Alloc(totalSize);
     }
 
     virtual void Free(void* p) override
@@ -37,7 +35,7 @@ public:
             return;
         }
 
-        m_allocator->Free(reinterpret_cast<char*>(p));
+        m_pool.Free(p);
     }
 };
 } } }
@@ -124,6 +124,9 @@ public:
     // Gets a sequence per input by its index inside the chunk.
     virtual void GetSequence(size_t sequenceIndex, std::vector<SequenceDataPtr>& result) = 0;
 
+    // Gets the (approximate) amount of memory held by the chunk, in bytes, or 0 if unknown.
+    virtual size_t SizeInBytes() const { return 0; }
+
     virtual ~Chunk() {};
 
 protected:
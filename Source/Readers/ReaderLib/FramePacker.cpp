@@ -25,4 +25,35 @@ MBLayoutPtr FramePacker::CreateMBLayout(const StreamBatch& batch)
     return pMBLayout;
 }
 
+MBLayoutPtr FramePacker::PackDenseStream(const StreamBatch& batch, size_t streamIndex)
+{
+    assert(m_outputStreamDescriptions[streamIndex]->m_storageType == StorageType::dense);
+    const auto& stream = m_inputStreamDescriptions[streamIndex];
+    if (stream->m_storageType != StorageType::dense)
+        return SequencePacker::PackDenseStream(batch, streamIndex); // sparse input is packed as dense sample by sample
+
+    auto pMBLayout = CreateMBLayout(batch);
+    size_t sampleSize = GetSampleSize(m_outputStreamDescriptions[streamIndex]);
+    auto& buffer = m_streamBuffers[m_currentBufferIndex][streamIndex];
+    size_t requiredSize = batch.size() * sampleSize;
+    if (buffer.m_size < requiredSize)
+        buffer.Resize(requiredSize);
+
+    // In frame mode, frame i goes to column i. Frames that follow each other in memory,
+    // e.g. consecutive frames of an utterance when reading without randomization, are copied at once.
+    char* bufferPtr = buffer.m_data.get();
+    for (size_t i = 0; i < batch.size();)
+    {
+        const char* source = static_cast<const char*>(batch[i]->GetDataBuffer());
+        size_t end = i + 1;
+        while (end < batch.size() && batch[end]->GetDataBuffer() == source + (end - i) * sampleSize)
+            end++;
+
+        memcpy(bufferPtr + i * sampleSize, source, (end - i) * sampleSize);
+        i = end;
+    }
+
+    return pMBLayout;
+}
+
 }}}
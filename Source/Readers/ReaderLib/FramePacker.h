@@ -24,6 +24,9 @@ public:
 
 protected:
     MBLayoutPtr CreateMBLayout(const StreamBatch& batch) override;
+
+    // Packs frame i into column i, copying runs of frames that are adjacent in memory at once.
+    MBLayoutPtr PackDenseStream(const StreamBatch& batch, size_t streamIndex) override;
 };
 
 typedef std::shared_ptr<FramePacker> FramePackerPtr;
@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include "MemoryProvider.h"
+#include "CPUHugePageAllocator.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -17,13 +18,16 @@ class HeapMemoryProvider : public MemoryProvider
 public:
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
     {
-        // Currently not alligned.
-        return ::operator new(elementSize * numberOfElements);
+        // Large buffers come from huge pages if they are enabled, the others are currently not alligned.
+        // The packers overwrite what they use, so the buffer is not zeroed.
+        void* p = CPUHugePageAllocator::Alloc(elementSize * numberOfElements, /*zero=*/false);
+        return p ? p : ::operator new(elementSize * numberOfElements);
     }
 
     virtual void Free(void* p) override
     {
-        ::operator delete(p);
+        if (!CPUHugePageAllocator::Free(p))
+            ::operator delete(p);
     }
 };
 
@@ -0,0 +1,269 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <random>
+#include "IndexCache.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static const char s_magic[8] = { 'C', 'N', 'T', 'K', 'I', 'D', 'X', '1' };
+static const uint32_t s_version = 1;
+static const size_t s_fingerprintBlockSize = 64 * 1024;
+
+// One sequence of the index, as stored in the cache file.
+struct IndexCacheRecord
+{
+    uint64_t m_startOffset;     // in the input file
+    uint64_t m_endOffset;
+    uint64_t m_key;             // numeric key, or offset of the key string in the key section for symbolic keys
+    uint32_t m_numberOfSamples;
+    uint32_t m_reserved;
+};
+
+static bool GetFileSizeAndTime(const std::wstring& path, uint64_t& size, int64_t& time)
+{
+#ifdef _WIN32
+    struct _stat64 buf;
+    if (_wstat64(path.c_str(), &buf) != 0)
+        return false;
+#else
+    struct stat buf;
+    if (stat(msra::strfun::utf8(path).c_str(), &buf) != 0)
+        return false;
+#endif
+    size = static_cast<uint64_t>(buf.st_size);
+    time = static_cast<int64_t>(buf.st_mtime);
+    return true;
+}
+
+// FNV-1a hash of the first and the last (up to) 64KB of the first 'size' bytes of the file and of 'size' itself;
+// cheap to compute, and catches a replaced or rewritten file even when its size and time stamp happen to match.
+static uint64_t GetFingerprint(const std::wstring& path, uint64_t size)
+{
+    auto file = std::shared_ptr<FILE>(fopenOrDie(path, L"rbS"), [](FILE* f) { fclose(f); });
+    std::vector<unsigned char> buffer(s_fingerprintBlockSize);
+    uint64_t hash = 14695981039346656037ull;
+    auto hashBytes = [&hash](const unsigned char* data, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i++)
+            hash = (hash ^ data[i]) * 1099511628211ull;
+    };
+    auto hashRange = [&](uint64_t offset, size_t bytes)
+    {
+        if (_fseeki64(file.get(), offset, SEEK_SET) != 0)
+            RuntimeError("Cannot seek to offset %" PRIu64 " in '%ls'.", offset, path.c_str());
+        freadOrDie(buffer.data(), 1, bytes, file.get());
+        hashBytes(buffer.data(), bytes);
+    };
+
+    hashRange(0, static_cast<size_t>(std::min<uint64_t>(size, s_fingerprintBlockSize)));
+    if (size > s_fingerprintBlockSize)
+    {
+        size_t tailBytes = static_cast<size_t>(std::min<uint64_t>(size - s_fingerprintBlockSize, s_fingerprintBlockSize));
+        hashRange(size - tailBytes, tailBytes);
+    }
+    hashBytes(reinterpret_cast<const unsigned char*>(&size), sizeof(size));
+    return hash;
+}
+
+IndexCache::IndexCache(const std::wstring& inputPath, const std::wstring& cacheDirectory, const std::string& indexerSignature, bool verbose)
+    : m_inputPath(inputPath), m_indexerSignature(indexerSignature), m_verbose(verbose)
+{
+    if (cacheDirectory.empty())
+    {
+        m_cachePath = inputPath + L".cntkindex";
+    }
+    else
+    {
+        // files with the same name in different directories must not share a cache file
+        auto separator = inputPath.find_last_of(L"/\\");
+        auto fileName = separator == std::wstring::npos ? inputPath : inputPath.substr(separator + 1);
+        wchar_t pathHash[17];
+        swprintf(pathHash, _countof(pathHash), L"%016llx", (unsigned long long) std::hash<std::wstring>()(inputPath));
+        m_cachePath = cacheDirectory + L"/" + fileName + L"." + pathHash + L".cntkindex";
+    }
+}
+
+size_t IndexCache::Load(Index& index, CorpusDescriptorPtr corpus, uint32_t& indexerFlags)
+{
+    indexerFlags = 0;
+    if (!fexists(m_cachePath))
+        return 0;
+
+    // read and validate everything before touching the index, so that a bad cache only costs the full pass
+    std::vector<IndexCacheRecord> records;
+    std::vector<char> keys;
+    uint64_t inputSize;
+    bool unchanged;
+    uint8_t numericKeys;
+    try
+    {
+        int64_t inputTime;
+        if (!GetFileSizeAndTime(m_inputPath, inputSize, inputTime))
+            return 0;
+
+        auto file = std::shared_ptr<FILE>(fopenOrDie(m_cachePath, L"rbS"), [](FILE* f) { fclose(f); });
+        char magic[sizeof(s_magic)];
+        uint32_t version, signatureLength, flags;
+        uint64_t indexedBytes, fingerprint, numSequences, keySectionSize;
+        int64_t indexedTime;
+        freadOrDie(magic, sizeof(magic), 1, file.get());
+        freadOrDie(&version, sizeof(version), 1, file.get());
+        if (memcmp(magic, s_magic, sizeof(s_magic)) != 0 || version != s_version)
+            return 0;
+        freadOrDie(&signatureLength, sizeof(signatureLength), 1, file.get());
+        std::string signature(signatureLength, '\0');
+        if (signatureLength > 0)
+            freadOrDie(&signature[0], 1, signatureLength, file.get());
+        freadOrDie(&flags, sizeof(flags), 1, file.get());
+        freadOrDie(&indexedBytes, sizeof(indexedBytes), 1, file.get());
+        freadOrDie(&indexedTime, sizeof(indexedTime), 1, file.get());
+        freadOrDie(&fingerprint, sizeof(fingerprint), 1, file.get());
+        freadOrDie(&numericKeys, sizeof(numericKeys), 1, file.get());
+        freadOrDie(&numSequences, sizeof(numSequences), 1, file.get());
+        freadOrDie(&keySectionSize, sizeof(keySectionSize), 1, file.get());
+
+        unchanged = inputSize == indexedBytes && inputTime == indexedTime;
+        const bool appended = inputSize > indexedBytes;
+        if (signature != m_indexerSignature || (numericKeys != 0) != corpus->IsNumericSequenceKeys() ||
+            !(unchanged || appended) || GetFingerprint(m_inputPath, indexedBytes) != fingerprint)
+        {
+            if (m_verbose)
+                fprintf(stderr, "IndexCache: '%ls' is out of date, indexing '%ls' again.\n", m_cachePath.c_str(), m_inputPath.c_str());
+            return 0;
+        }
+
+        // a single read for all sequences; this is the bulk of the file
+        records.resize(numSequences);
+        keys.resize(keySectionSize);
+        if (numSequences > 0)
+            freadOrDie(records.data(), sizeof(IndexCacheRecord), records.size(), file.get());
+        if (keySectionSize > 0)
+            freadOrDie(keys.data(), 1, keys.size(), file.get());
+        if (!keys.empty() && keys.back() != '\0')
+            RuntimeError("unterminated key section");
+        for (const auto& record : records)
+        {
+            if (record.m_startOffset > record.m_endOffset || record.m_endOffset > indexedBytes || (!numericKeys && record.m_key >= keys.size()))
+                RuntimeError("invalid sequence record");
+        }
+        indexerFlags = flags;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Cannot read the index cache '%ls' (%s), indexing '%ls' again.\n", m_cachePath.c_str(), e.what(), m_inputPath.c_str());
+        return 0;
+    }
+
+    // the last sequence of an appended file may continue in the new data, so it is indexed again
+    size_t numSequencesToAdd = unchanged ? records.size() : (records.empty() ? 0 : records.size() - 1);
+    if (!numericKeys)
+        corpus->ReserveKeys(numSequencesToAdd, keys.size());
+    for (size_t i = 0; i < numSequencesToAdd; i++)
+    {
+        const auto& record = records[i];
+        size_t key = numericKeys ? static_cast<size_t>(record.m_key) : corpus->KeyToId(std::string(keys.data() + record.m_key));
+        index.AddSequence(SequenceDescriptor{ KeyType{ key, 0 }, record.m_numberOfSamples }, record.m_startOffset, record.m_endOffset);
+    }
+
+    if (m_verbose)
+        fprintf(stderr, "IndexCache: read %zu sequences of '%ls' from '%ls'%s.\n", numSequencesToAdd, m_inputPath.c_str(), m_cachePath.c_str(),
+                unchanged ? "" : ", indexing the appended data");
+    if (unchanged)
+        return static_cast<size_t>(inputSize);
+    return numSequencesToAdd < records.size() ? static_cast<size_t>(records[numSequencesToAdd].m_startOffset) : 0;
+}
+
+void IndexCache::Save(const Index& index, CorpusDescriptorPtr corpus, uint32_t indexerFlags)
+{
+    std::wstring tempPath;
+    try
+    {
+        uint64_t inputSize;
+        int64_t inputTime;
+        if (!GetFileSizeAndTime(m_inputPath, inputSize, inputTime))
+            return;
+
+        // only sequences that end within what is fingerprinted, in case the file is still growing
+        std::vector<IndexCacheRecord> records;
+        std::vector<char> keys;
+        const bool numericKeys = corpus->IsNumericSequenceKeys();
+        for (const auto& chunk : index.m_chunks)
+        {
+            for (const auto& sequence : chunk.m_sequences)
+            {
+                IndexCacheRecord record;
+                record.m_startOffset = chunk.m_offset + sequence.OffsetInChunk();
+                record.m_endOffset = record.m_startOffset + sequence.SizeInBytes();
+                record.m_numberOfSamples = sequence.m_numberOfSamples;
+                record.m_reserved = 0;
+                if (record.m_endOffset > inputSize)
+                    break;
+                if (numericKeys)
+                {
+                    record.m_key = sequence.m_key.m_sequence;
+                }
+                else
+                {
+                    record.m_key = keys.size();
+                    auto key = corpus->IdToKey(sequence.m_key.m_sequence);
+                    keys.insert(keys.end(), key.begin(), key.end());
+                    keys.push_back('\0');
+                }
+                records.push_back(record);
+            }
+        }
+
+        // concurrent jobs (e.g. all workers of a distributed job) may write the same cache; the last rename wins
+        tempPath = m_cachePath + L".tmp" + std::to_wstring(std::random_device()());
+        FILE* file = fopenOrDie(tempPath, L"wbS");
+        try
+        {
+            const uint32_t signatureLength = static_cast<uint32_t>(m_indexerSignature.size());
+            const uint64_t fingerprint = GetFingerprint(m_inputPath, inputSize);
+            const uint8_t numericKeysByte = numericKeys ? 1 : 0;
+            const uint64_t numSequences = records.size(), keySectionSize = keys.size();
+            fwriteOrDie(s_magic, sizeof(s_magic), 1, file);
+            fwriteOrDie(&s_version, sizeof(s_version), 1, file);
+            fwriteOrDie(&signatureLength, sizeof(signatureLength), 1, file);
+            if (signatureLength > 0)
+                fwriteOrDie(m_indexerSignature.data(), 1, m_indexerSignature.size(), file);
+            fwriteOrDie(&indexerFlags, sizeof(indexerFlags), 1, file);
+            fwriteOrDie(&inputSize, sizeof(inputSize), 1, file);
+            fwriteOrDie(&inputTime, sizeof(inputTime), 1, file);
+            fwriteOrDie(&fingerprint, sizeof(fingerprint), 1, file);
+            fwriteOrDie(&numericKeysByte, sizeof(numericKeysByte), 1, file);
+            fwriteOrDie(&numSequences, sizeof(numSequences), 1, file);
+            fwriteOrDie(&keySectionSize, sizeof(keySectionSize), 1, file);
+            if (!records.empty())
+                fwriteOrDie(records.data(), sizeof(IndexCacheRecord), records.size(), file);
+            if (!keys.empty())
+                fwriteOrDie(keys.data(), 1, keys.size(), file);
+        }
+        catch (...)
+        {
+            fclose(file);
+            throw;
+        }
+        if (fclose(file) != 0)
+            RuntimeError("error closing '%ls'", tempPath.c_str());
+
+        renameOrDie(tempPath, m_cachePath);
+        if (m_verbose)
+            fprintf(stderr, "IndexCache: wrote %zu sequences of '%ls' to '%ls'.\n", records.size(), m_inputPath.c_str(), m_cachePath.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Cannot write the index cache '%ls' (%s).\n", m_cachePath.c_str(), e.what());
+        if (!tempPath.empty())
+            _wunlink(tempPath.c_str());
+    }
+}
+
+}}}
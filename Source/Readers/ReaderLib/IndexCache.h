@@ -0,0 +1,58 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include "Indexer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A persistent on-disk copy of the sequences an indexer found in an input file, so that the next job
+// does not have to do a full pass over the file again (which can take many minutes for large corpora).
+// The cache file stores, for every sequence, its key, number of samples and the byte range in the input file.
+// Loading replays these through Index::AddSequence(), so that chunking (chunk size, primary or not, first samples)
+// is decided anew and the same cache serves all of these configurations.
+//
+// The cache is valid as long as the input file still starts with the bytes that were indexed, checked through
+// the size, the modification time and a fingerprint of the head and the tail of the indexed bytes.
+// If the file grew since (new data appended), all sequences but the last one are taken from the cache and the
+// indexer continues at the start of the last one, since its end may have moved.
+//
+// Symbolic sequence keys are stored as strings and mapped through the corpus again when loading, in the order
+// the indexer would have encountered them, so that the resulting ids are the same as without the cache.
+//
+// The cache is written next to the input file ('<file>.cntkindex'), or into a given directory. Failures to read
+// or write it are not fatal; the indexer then does a full pass as before.
+class IndexCache
+{
+public:
+    // 'indexerSignature' identifies the indexer and those of its parameters that affect which sequences are found,
+    // e.g. the input format and whether sequence ids are parsed; a cache built with a different signature is ignored.
+    IndexCache(const std::wstring& inputPath, const std::wstring& cacheDirectory, const std::string& indexerSignature, bool verbose = false);
+
+    // Adds the cached sequences to 'index'. Returns the offset in the input file where indexing has to continue:
+    // 0 if there is no valid cache, the file size if the cache covers the whole file.
+    // 'indexerFlags' returns the value that was passed to Save().
+    size_t Load(Index& index, CorpusDescriptorPtr corpus, uint32_t& indexerFlags);
+
+    // Writes the sequences of the complete 'index' of the input file to the cache file.
+    // 'indexerFlags' is indexer-specific state that has to be known to continue indexing an appended file.
+    void Save(const Index& index, CorpusDescriptorPtr corpus, uint32_t indexerFlags);
+
+    const std::wstring& GetCachePath() const { return m_cachePath; }
+
+private:
+    const std::wstring m_inputPath;
+    std::wstring m_cachePath;
+    const std::string m_indexerSignature;
+    const bool m_verbose;
+
+    DISABLE_COPY_AND_MOVE(IndexCache);
+};
+
+typedef std::shared_ptr<IndexCache> IndexCachePtr;
+
+}}}
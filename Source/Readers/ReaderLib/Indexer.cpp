@@ -7,11 +7,15 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <inttypes.h>
 #include "Indexer.h"
+#include "IndexCache.h"
 
 using std::string;
 
 const static char ROW_DELIMITER = '\n';
 
+// IndexCache flag: the index was built from lines (the input has no sequence ids)
+const static uint32_t INDEXED_LINES = 1;
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 Indexer::Indexer(FILE* file, bool primary, bool skipSequenceIds, char streamPrefix, size_t chunkSize, size_t bufferSize) :
@@ -61,6 +65,8 @@ void Indexer::BuildFromLines()
     assert(m_pos == m_bufferStart);
     m_hasSequenceIds = false;
     size_t lines = 0;
+    for (const auto& chunk : m_index.m_chunks)
+        lines += chunk.m_numberOfSequences;
     int64_t offset = GetFileOffset();
     while (!m_done)
     {
@@ -87,6 +93,17 @@ void Indexer::BuildFromLines()
     }
 }
 
+void Indexer::EnableCache(const std::wstring& inputPath, const std::wstring& cacheDirectory, bool verbose)
+{
+    if (!m_index.IsEmpty())
+        LogicError("Indexer::EnableCache must be called before the index is built.");
+
+    // the parameters that determine which sequences are found; the chunking is redone when loading
+    char signature[64];
+    sprintf(signature, "CNTKTextFormat skipSequenceIds=%d streamPrefix=%c", m_hasSequenceIds ? 0 : 1, m_streamPrefix);
+    m_cache = std::make_shared<IndexCache>(inputPath, cacheDirectory, signature, verbose);
+}
+
 void Indexer::Build(CorpusDescriptorPtr corpus)
 {
     if (!m_index.IsEmpty())
@@ -94,6 +111,28 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
         return;
     }
 
+    size_t fileSize = filesize(m_file);
+    m_index.Reserve(fileSize);
+
+    int64_t offset = 0;
+    if (m_cache)
+    {
+        uint32_t flags;
+        offset = m_cache->Load(m_index, corpus, flags);
+        if (offset > 0 && (flags & INDEXED_LINES))
+            m_hasSequenceIds = false;
+        if (offset == (int64_t)fileSize)
+            return; // the input has not changed since it was cached
+    }
+
+    BuildFrom(corpus, offset);
+
+    if (m_cache)
+        m_cache->Save(m_index, corpus, m_hasSequenceIds ? 0 : INDEXED_LINES);
+}
+
+void Indexer::BuildFrom(CorpusDescriptorPtr corpus, int64_t startOffset)
+{
     // Create a lambda to read symbolic or numeric sequence ids,
     // depending on what the corpus expects.
     std::function<bool(size_t&)> tryGetSequenceId;
@@ -102,7 +141,13 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     else
         tryGetSequenceId = [this, corpus](size_t& id) { return TryGetSymbolicSequenceId(id, corpus->KeyToId); };
 
-    m_index.Reserve(filesize(m_file));
+    if (startOffset > 0)
+    {
+        // the index already holds the sequences before this offset
+        if (_fseeki64(m_file, startOffset, SEEK_SET) != 0)
+            RuntimeError("Cannot seek to the offset %" PRIi64 " in the input file.", startOffset);
+        m_fileOffsetStart = m_fileOffsetEnd = startOffset;
+    }
 
     RefillBuffer(); // read the first block of data
     if (m_done)
@@ -110,7 +155,8 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
         RuntimeError("Input file is empty");
     }
 
-    if ((m_bufferEnd - m_bufferStart > 3) &&
+    if (startOffset == 0 &&
+        (m_bufferEnd - m_bufferStart > 3) &&
         (m_bufferStart[0] == '\xEF' && m_bufferStart[1] == '\xBB' && m_bufferStart[2] == '\xBF'))
     {
         // input file contains UTF-8 BOM value, skip it.
@@ -119,8 +165,8 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
         m_bufferStart += 3;
     }
 
-    // check the first byte and decide what to do next
-    if (!m_hasSequenceIds || m_bufferStart[0] == m_streamPrefix)
+    // check the first byte and decide what to do next (when continuing, the decision was made for the first byte of the file)
+    if (!m_hasSequenceIds || (startOffset == 0 && m_bufferStart[0] == m_streamPrefix))
     {
         // Skip sequence id parsing, treat lines as individual sequences
         // In this case the sequences do not have ids, they are assigned a line number.
@@ -208,7 +254,7 @@ bool Indexer::TryGetNumericSequenceId(size_t& id)
     return false;
 }
 
-bool Indexer::TryGetSymbolicSequenceId(size_t& id, std::function<size_t(const std::string&)> keyToId)
+bool Indexer::TryGetSymbolicSequenceId(size_t& id, const std::function<size_t(const std::string&)>& keyToId)
 {
     bool found = false;
     id = 0;
@@ -237,6 +283,29 @@ bool Indexer::TryGetSymbolicSequenceId(size_t& id, std::function<size_t(const st
     return false;
 }
 
+void SequenceLocations::Insert(size_t key, uint32_t chunkIndex, uint32_t sequenceIndex)
+{
+    if ((m_size + 1) * 4 > m_entries.size() * 3) // at most 3/4 full
+        Rehash(std::max<size_t>(m_entries.size() * 2, 1024));
+
+    Entry& entry = m_entries[FindEntry(key)];
+    if (entry.m_key != s_emptyKey)
+        return;
+    entry = Entry{ key, chunkIndex, sequenceIndex };
+    m_size++;
+}
+
+void SequenceLocations::Rehash(size_t numEntries)
+{
+    std::vector<Entry> entries(numEntries, Entry{ s_emptyKey, 0, 0 });
+    entries.swap(m_entries);
+    for (const Entry& entry : entries)
+    {
+        if (entry.m_key != s_emptyKey)
+            m_entries[FindEntry(entry.m_key)] = entry;
+    }
+}
+
 void Index::AddSequence(SequenceDescriptor&& sd, size_t startOffsetInFile, size_t endOffsetInFile)
 {
     sd.SetSize(endOffsetInFile - startOffsetInFile);
@@ -272,7 +341,7 @@ void Index::AddSequence(SequenceDescriptor&& sd, size_t startOffsetInFile, size_
         if (location.second != chunk->m_sequences.size())
             RuntimeError("Number of sequences overflow the chunk capacity.");
 
-        m_keyToSequenceInChunk.insert(std::make_pair(sd.m_key.m_sequence, location));
+        m_keyToSequenceInChunk.Insert(sd.m_key.m_sequence, location.first, location.second);
     }
 
     sd.SetOffsetInChunk(startOffsetInFile - chunk->m_offset);
@@ -12,7 +12,11 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class IndexCache;
+
 // Sequence metadata that allows indexing a sequence in a binary file.
+// There is one per sequence of the input, so it is packed to 20 bytes instead of 24.
+#pragma pack(push, 4)
 struct SequenceDescriptor
 {
     SequenceDescriptor(KeyType key, uint32_t numberOfSamples)
@@ -55,6 +59,7 @@ private:
     uint32_t m_byteSize;                 // size in bytes
     friend struct Index;
 };
+#pragma pack(pop)
 
 // Chunk metadata, similar to the sequence descriptor above,
 // but used to facilitate indexing and retrieval of blobs of input data of
@@ -80,6 +85,56 @@ struct ChunkDescriptor : ChunkDescription
 
 typedef shared_ptr<ChunkDescriptor> ChunkDescriptorPtr;
 
+// Maps sequence keys to <chunk index, sequence index in chunk>.
+// An open-addressing table of 16 byte entries with linear probing, at most 3/4 full, i.e. about 24 bytes per
+// sequence instead of the 64 to 80 of a std::map node, which adds up for secondary deserializers of large corpora.
+class SequenceLocations
+{
+public:
+    // Adds the location of the key, unless the key was added before.
+    void Insert(size_t key, uint32_t chunkIndex, uint32_t sequenceIndex);
+
+    // Tries to get the location of the key.
+    bool TryGet(size_t key, std::pair<uint32_t, uint32_t>& location) const
+    {
+        if (m_entries.empty())
+            return false;
+        const Entry& entry = m_entries[FindEntry(key)];
+        if (entry.m_key != s_emptyKey)
+            location = std::make_pair(entry.m_chunkIndex, entry.m_sequenceIndex);
+        return entry.m_key != s_emptyKey;
+    }
+
+    size_t size() const { return m_size; }
+
+private:
+    static const uint64_t s_emptyKey = UINT64_MAX; // sequence keys have 40 bits
+
+    struct Entry
+    {
+        uint64_t m_key;
+        uint32_t m_chunkIndex;
+        uint32_t m_sequenceIndex;
+    };
+
+    // The entry of the key, or the empty entry where it would be inserted.
+    size_t FindEntry(size_t key) const
+    {
+        // Fibonacci hashing, as keys are often consecutive
+        const size_t mask = m_entries.size() - 1;
+        for (size_t i = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;; i = (i + 1) & mask)
+        {
+            if (m_entries[i].m_key == key || m_entries[i].m_key == s_emptyKey)
+                return i;
+        }
+    }
+
+    void Rehash(size_t numEntries);
+
+    std::vector<Entry> m_entries; // a power of two of them
+    size_t m_size = 0;
+};
+
 // A collection of chunk descriptors, each containing
 // a collection of sequence descriptors for the corresponding
 // chunk of the input data.
@@ -87,7 +142,7 @@ typedef shared_ptr<ChunkDescriptor> ChunkDescriptorPtr;
 struct Index
 {
     std::vector<ChunkDescriptor> m_chunks;                                  // chunks
-    std::map<size_t, std::pair<uint32_t, uint32_t>> m_keyToSequenceInChunk; // sequence key -> <chunk index, sequence index in chunk>
+    SequenceLocations m_keyToSequenceInChunk;                               // sequence key -> <chunk index, sequence index in chunk>
     const size_t m_maxChunkSize;                                            // maximum chunk size in bytes
     bool m_primary;                                                         // index for primary deserializer
     bool m_trackFirstSamples;                                               // flag indicating whether to build index of first samples
@@ -139,6 +194,10 @@ public:
     // sequences.
     void Build(CorpusDescriptorPtr corpus);
 
+    // Makes Build() take the sequences from the index cache of the input file (see IndexCache.h),
+    // if it is still valid, and write the cache otherwise. Has to be called before Build().
+    void EnableCache(const std::wstring& inputPath, const std::wstring& cacheDirectory, bool verbose = false);
+
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
 
@@ -169,6 +228,12 @@ private:
 
     const char m_streamPrefix;
 
+    std::shared_ptr<IndexCache> m_cache; // null unless EnableCache() was called
+
+    // Does the pass over the input file, starting at the given offset (of a sequence) if parts of the file
+    // were already indexed.
+    void BuildFrom(CorpusDescriptorPtr corpus, int64_t offset);
+
     // fills up the buffer with data from file, all previously buffered data
     // will be overwritten.
     void RefillBuffer();
@@ -185,12 +250,12 @@ private:
 
     // Same as above but for symbolic ids.
     // It reads a symbolic key and converts it to numeric id using provided keyToId function.
-    bool TryGetSymbolicSequenceId(size_t& id, std::function<size_t(const std::string&)> keyToId);
+    bool TryGetSymbolicSequenceId(size_t& id, const std::function<size_t(const std::string&)>& keyToId);
 
 
     // Build a chunk/sequence index, treating each line as an individual sequence.
     // Does not do any sequence parsing, instead uses line number as 
-    // the corresponding sequence id.
+    // the corresponding sequence id (counting the lines already in the index).
     void BuildFromLines();
 
     // Returns current offset in the input file (in bytes). 
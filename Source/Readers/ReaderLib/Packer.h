@@ -18,6 +18,11 @@ public:
     virtual void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) = 0;
 
     virtual Minibatch ReadMinibatch() = 0;
+
+    // Returns the total time spent getting sequences from the sequence enumerator, in seconds.
+    // Includes loading chunks, deserializing and transforming the sequences, but not packing them.
+    virtual double GetSequenceReadTime() { return 0; }
+
     virtual ~Packer() {}
 };
 
@@ -8,6 +8,7 @@
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <chrono>
 
 #include "PackerBase.h"
 #include "ReaderUtil.h"
@@ -28,6 +29,14 @@ void PackerBase::StreamBuffer::Resize(size_t newSize)
     });
 }
 
+Sequences PackerBase::GetNextSequences(size_t globalSampleCount, size_t localSampleCount)
+{
+    auto start = std::chrono::steady_clock::now();
+    Sequences sequences = m_sequenceEnumerator->GetNextSequences(globalSampleCount, localSampleCount);
+    m_sequenceReadTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return sequences;
+}
+
 void PackerBase::SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders)
 {
     // Let's check that memory providers did not change at the start of new epoch.
@@ -65,7 +74,8 @@ PackerBase::PackerBase(CorpusDescriptorPtr corpus,
     m_outputStreamDescriptions(streams),
     m_numberOfBuffers(numberOfBuffers),
     m_currentBufferIndex(0),
-    m_corpus(corpus)
+    m_corpus(corpus),
+    m_sequenceReadTime(0)
 {
     assert(m_numberOfBuffers >= 1);
     m_inputStreamDescriptions = sequenceEnumerator->GetStreamDescriptions();
@@ -84,13 +94,18 @@ PackerBase::PackerBase(CorpusDescriptorPtr corpus,
 
         // Check the input.
         if(m_inputStreamDescriptions[i]->m_elementType != ElementType::tdouble &&
-            m_inputStreamDescriptions[i]->m_elementType != ElementType::tfloat)
+            m_inputStreamDescriptions[i]->m_elementType != ElementType::tfloat &&
+            m_inputStreamDescriptions[i]->m_elementType != ElementType::tuchar)
         {
             RuntimeError("Please specify the type of the '%ls' stream. You can use 'Cast' transform for that.", m_inputStreamDescriptions[i]->m_name.c_str());
         }
 
+        // Bytes are only expanded from dense streams.
+        if (stream->m_elementType == ElementType::tuchar && stream->m_storageType != StorageType::dense)
+            RuntimeError("Stream '%ls' of unsigned chars has to be dense.", stream->m_name.c_str());
+
         // Input and output should match in everything except for sparse/dense storage type.
-        assert(stream->m_elementType == ElementType::tfloat || stream->m_elementType == ElementType::tdouble);
+        assert(stream->m_elementType == m_inputStreamDescriptions[i]->m_elementType);
         assert(stream->m_name == m_inputStreamDescriptions[i]->m_name);
         assert(stream->m_id == m_inputStreamDescriptions[i]->m_id);
 
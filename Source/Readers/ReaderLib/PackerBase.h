@@ -55,7 +55,7 @@ protected:
     // the data portion of the source sequence to the destination block of memory. sampleOffset 
     // specifies the offset of the first value from the given sample in the sequence data/ array 
     // (sampleOffset is equal to the sum of sample sizes of all preceding samples).
-    void PackDenseSample(char* destination, SequenceDataPtr sequence, size_t sampleOffset, size_t sampleSize);
+    void PackDenseSample(char* destination, const SequenceDataPtr& sequence, size_t sampleOffset, size_t sampleSize);
 
     // Establishes a mapping between id inside the mb layout and the global key in the corpus.
     // Assumes the sequences inside MBLayout have the same order as Sequences.
@@ -63,6 +63,9 @@ protected:
 
     static void CheckNameUniqueness(const std::vector<StreamDescriptionPtr>& streams);
 
+    // Gets the next sequences from the sequence enumerator, accounting for the time spent in m_sequenceReadTime.
+    Sequences GetNextSequences(size_t globalSampleCount, size_t localSampleCount);
+
     SequenceEnumeratorPtr m_sequenceEnumerator;
 
     // Input stream descriptions provided by the transformer.
@@ -94,9 +97,17 @@ protected:
 
     CorpusDescriptorPtr m_corpus;
 
+    // Total time spent in GetNextSequences(), in seconds.
+    double m_sequenceReadTime;
+
 public:
     // Sets current epoch configuration.
     virtual void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) override;
+
+    double GetSequenceReadTime() override
+    {
+        return m_sequenceReadTime;
+    }
 };
 
 inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenceDataPtr sequence,
@@ -122,7 +133,7 @@ inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenc
     }
 }
 
-inline void PackerBase::PackDenseSample(char* destination, SequenceDataPtr sequence, size_t sampleOffset, size_t sampleSize)
+inline void PackerBase::PackDenseSample(char* destination, const SequenceDataPtr& sequence, size_t sampleOffset, size_t sampleSize)
 {
     // Because the sample is dense - simply copying it to the output.
     memcpy(destination, (const char*)(sequence->GetDataBuffer()) + sampleOffset, sampleSize);
@@ -0,0 +1,105 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "PinnedMemoryPool.h"
+#include <memory>
+#include <CUDAPageLockedMemAllocator.h>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+std::atomic<size_t> PinnedMemoryPool::s_maxCachedBytes(1024 * 1024 * 1024);
+
+/*static*/ PinnedMemoryPool& PinnedMemoryPool::Get(int deviceId)
+{
+    // Never destroyed: freeing the buffers at exit could happen after the CUDA runtime has shut down.
+    static std::mutex s_mutex;
+    static auto* s_pools = new std::map<int, std::unique_ptr<PinnedMemoryPool>>();
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto& pool = (*s_pools)[deviceId];
+    if (!pool)
+        pool.reset(new PinnedMemoryPool(deviceId));
+    return *pool;
+}
+
+/*static*/ size_t PinnedMemoryPool::SizeClass(size_t size)
+{
+    const size_t minSize = 4096;
+    if (size <= minSize)
+        return minSize;
+    size_t powerOfTwo = minSize;
+    while (powerOfTwo * 2 < size)
+        powerOfTwo *= 2;
+    // powerOfTwo < size <= 2 * powerOfTwo, in steps of a quarter
+    const size_t step = powerOfTwo / 4;
+    return (size + step - 1) / step * step;
+}
+
+void* PinnedMemoryPool::Alloc(size_t size)
+{
+    const size_t sizeClass = SizeClass(size);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto cached = m_cached.find(sizeClass);
+        if (cached != m_cached.end())
+        {
+            void* p = cached->second;
+            m_cached.erase(cached);
+            m_sizesInUse[p] = sizeClass;
+            m_statistics.numReuses++;
+            m_statistics.bytesCached -= sizeClass;
+            m_statistics.bytesInUse += sizeClass;
+            return p;
+        }
+    }
+
+    // not under the lock, this is the slow part
+    void* p = CUDAPageLockedMemAllocator::Malloc(sizeClass, m_deviceId);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sizesInUse[p] = sizeClass;
+    m_statistics.numAllocations++;
+    m_statistics.bytesInUse += sizeClass;
+    return p;
+}
+
+void PinnedMemoryPool::Free(void* p)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto inUse = m_sizesInUse.find(p);
+    if (inUse == m_sizesInUse.end())
+        LogicError("PinnedMemoryPool: Attempted to free a buffer that was not allocated from the pool.");
+    const size_t sizeClass = inUse->second;
+    m_sizesInUse.erase(inUse);
+    m_cached.insert(std::make_pair(sizeClass, p));
+    m_statistics.bytesInUse -= sizeClass;
+    m_statistics.bytesCached += sizeClass;
+    TrimTo(s_maxCachedBytes);
+}
+
+void PinnedMemoryPool::Trim()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TrimTo(0);
+}
+
+void PinnedMemoryPool::TrimTo(size_t maxCachedBytes)
+{
+    while (m_statistics.bytesCached > maxCachedBytes)
+    {
+        auto largest = std::prev(m_cached.end());
+        CUDAPageLockedMemAllocator::Free(largest->second, m_deviceId);
+        m_statistics.numReleases++;
+        m_statistics.bytesCached -= largest->first;
+        m_cached.erase(largest);
+    }
+}
+
+PinnedMemoryPool::Statistics PinnedMemoryPool::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+}}}
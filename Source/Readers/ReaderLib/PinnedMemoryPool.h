@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A cache of page-locked host buffers, shared by the CudaMemoryProviders of a device.
+// cudaHostAlloc() is slow and cudaFreeHost() synchronizes with the whole device, while the packers reallocate their
+// buffers whenever a minibatch is larger than those before. Freed buffers are kept in size classes (a quarter of a power
+// of two apart) and handed out again for requests of the same class. Idle buffers beyond the limit are freed, largest first.
+// A packer frees a buffer only when it packs into it again, i.e. after the copy to the device that read it has completed
+// (ReaderShim waits for it before the prefetch slot is reused), so a freed buffer can be reused right away.
+class PinnedMemoryPool
+{
+public:
+    struct Statistics
+    {
+        size_t numAllocations = 0; // cudaHostAlloc() calls
+        size_t numReuses = 0;      // requests served from the cache
+        size_t numReleases = 0;    // cudaFreeHost() calls
+        size_t bytesInUse = 0;
+        size_t bytesCached = 0;
+    };
+
+    // the pool of a device, which lives until the end of the process
+    static PinnedMemoryPool& Get(int deviceId);
+
+    // limit of the idle bytes that each pool keeps
+    static void SetMaxCachedBytes(size_t bytes) { s_maxCachedBytes = bytes; }
+    static size_t GetMaxCachedBytes() { return s_maxCachedBytes; }
+
+    // the size that is allocated for a request of 'size' bytes
+    static size_t SizeClass(size_t size);
+
+    void* Alloc(size_t size);
+    void Free(void* p);
+
+    // frees all idle buffers
+    void Trim();
+
+    Statistics GetStatistics() const;
+
+private:
+    explicit PinnedMemoryPool(int deviceId) : m_deviceId(deviceId) {}
+    PinnedMemoryPool(const PinnedMemoryPool&) = delete;
+    PinnedMemoryPool& operator=(const PinnedMemoryPool&) = delete;
+
+    void TrimTo(size_t maxCachedBytes); // called with m_mutex held
+
+    int m_deviceId;
+    mutable std::mutex m_mutex;
+    std::unordered_map<void*, size_t> m_sizesInUse; // [buffer handed out] -> its size class
+    std::multimap<size_t, void*> m_cached;          // size class -> idle buffers
+    Statistics m_statistics;
+
+    static std::atomic<size_t> s_maxCachedBytes;
+};
+
+}}}
@@ -78,6 +78,15 @@ struct StreamDescription
     ElementType m_elementType;     // Element type of the stream
     TensorShapePtr m_sampleLayout; // Layout of the sample for the stream
                                    // If not specified - can be specified per sequence
+
+    // Streams of unsigned chars are packed and transferred to the device as is. The ReaderShim converts them to
+    // the precision of the network on the device, normalizing each element x to (x - mean) * scale.
+    double m_normalizationMean = 0;
+    double m_normalizationScale = 1;
+
+    // Image streams of unsigned chars can be augmented on the device instead (see ImageAugmentation.h),
+    // the samples of the stream then being the input images, not those of the network.
+    std::shared_ptr<ImageAugmentation> m_imageAugmentation;
 };
 typedef std::shared_ptr<StreamDescription> StreamDescriptionPtr;
 
@@ -145,6 +154,16 @@ public:
     // Reads a minibatch that contains data across all streams.
     virtual Minibatch ReadMinibatch() = 0;
 
+    // Returns the total time spent waiting for chunks of data to be loaded, in seconds.
+    virtual double GetChunkLoadStallTime() { return 0; }
+
+    // Returns the total time spent getting sequences for minibatches (loading chunks, deserializing
+    // and transforming sequences, everything except packing), in seconds.
+    virtual double GetSequenceReadTime() { return 0; }
+
+    // Returns the total time spent applying transforms to sequences, in seconds.
+    virtual double GetTransformTime() { return 0; }
+
     virtual ~Reader() {};
 };
 
@@ -79,4 +79,19 @@ void ReaderBase::SetConfiguration(const ReaderConfiguration& config, const std::
     m_packer->SetConfiguration(config, m_memoryProviders);
 }
 
+double ReaderBase::GetChunkLoadStallTime()
+{
+    return m_sequenceEnumerator->GetChunkLoadStallTime();
+}
+
+double ReaderBase::GetSequenceReadTime()
+{
+    return m_packer->GetSequenceReadTime();
+}
+
+double ReaderBase::GetTransformTime()
+{
+    return m_sequenceEnumerator->GetTransformTime();
+}
+
 }}}
@@ -34,6 +34,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
 
+        double GetChunkLoadStallTime() override;
+
+        double GetSequenceReadTime() override;
+
+        double GetTransformTime() override;
+
         virtual ~ReaderBase() = 0;
 
     protected:
@@ -12,6 +12,7 @@
 #endif
 
 #include <sstream>
+#include <chrono>
 #include "Basics.h"
 
 #define DATAREADER_EXPORTS // creating the exports here
@@ -19,17 +20,34 @@
 #include "ReaderShim.h"
 #include "DataTransferer.h"
 #include "PerformanceProfiler.h"
+#include "TrainingMetrics.h"
+#include "ConfigUtil.h"
+#include "ReaderUtil.h"
+#include "PinnedMemoryPool.h"
+#include "ImageAugmentation.h"
+#include "latticesource.h"
+#include "ThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim() :
     m_deviceId(CPUDEVICE),
-    m_dataTransferers(2, DataTransfererPtr()),
-    m_currentDataTransferIndex(0),
+    m_prefetchDepth(2),
+    m_traceLevel(0),
     m_endOfEpoch(false),
     m_endOfSweep(false),
     m_currentSamplePosition(0),
+    m_chunkLoadStallTimeAtEpochStart(0),
+    m_sequenceReadTimeAtEpochStart(0),
+    m_transformTimeAtEpochStart(0),
+    m_latticeStreamId(SIZE_MAX),
+    m_latticeLabelStreamId(SIZE_MAX),
     m_reader(nullptr),
     m_factory(nullptr)
 {
@@ -60,6 +78,13 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     // otherwise deferring - synchronous execution during .get() call
     m_launchType = prefetch ? launch::async : launch::deferred;
 
+    // Number of minibatches that are packed and copied to the device ahead of the network.
+    m_prefetchDepth = GetPrefetchDepth(config);
+    m_traceLevel = config(L"traceLevel", 0);
+
+    // Page-locked buffers that the packers no longer use are kept for reuse, up to this many megabytes per device.
+    PinnedMemoryPool::SetMaxCachedBytes((size_t)config(L"pinnedMemoryCacheMB", (size_t)1024) << 20);
+
     m_numParallelSequences = numberOfuttsPerMinibatchForAllEpochs[0];
 
     if (!m_reader)
@@ -69,7 +94,54 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     for (auto i : m_streams)
     {
         m_nameToStreamId.insert(std::make_pair(i->m_name, i->m_id));
+
+        if (i->m_elementType == ElementType::tuchar && m_traceLevel > 0)
+            fprintf(stderr, "ReaderShim: stream '%ls' is transferred as unsigned chars and normalized on the device with mean %g and scale %g.\n",
+                i->m_name.c_str(), i->m_normalizationMean, i->m_normalizationScale);
+        if (i->m_imageAugmentation && m_traceLevel > 0)
+            fprintf(stderr, "ReaderShim: stream '%ls' is augmented on the device into images of %d x %d.\n",
+                i->m_name.c_str(), i->m_imageAugmentation->outW, i->m_imageAugmentation->outH);
+    }
+
+    InitLatticeStreams(config);
+}
+
+// Sequence training reads the lattices through a LatticeDeserializer. Its stream is no input of the network: the prefetch
+// decodes the lattices from it and GetMinibatch4SE() passes them on, with the frame labels of the HTKMLFDeserializer stream.
+template <class ElemType>
+void ReaderShim<ElemType>::InitLatticeStreams(const ConfigParameters& config)
+{
+    argvector<ConfigValue> deserializers =
+        config(L"deserializers", ConfigParameters::Array(argvector<ConfigValue>(vector<ConfigValue> {})));
+    for (size_t i = 0; i < deserializers.size(); ++i)
+    {
+        ConfigParameters deserializer = deserializers[i];
+        std::wstring type = deserializer(L"type", L"");
+        if (type != L"LatticeDeserializer" && type != L"HTKMLFDeserializer")
+            continue;
+
+        ConfigParameters input = deserializer(L"input");
+        auto inputName = input.GetMemberIds().front();
+        auto stream = m_nameToStreamId.find(inputName);
+        if (stream == m_nameToStreamId.end())
+            LogicError("The reader does not expose the stream '%ls' of the %ls.", inputName.c_str(), type.c_str());
+
+        if (type == L"HTKMLFDeserializer")
+        {
+            m_latticeLabelStreamId = stream->second;
+            continue;
+        }
+
+        m_latticeStreamId = stream->second;
+
+        // The model the lattices are mapped to, for the criterion node (see GetHmmData()).
+        ConfigParameters streamConfig = input(inputName);
+        m_hset = std::make_shared<msra::asr::simplesenonehmm>();
+        m_hset->loadfromfile(streamConfig(L"phoneFile"), streamConfig(L"labelMappingFile"), streamConfig(L"transPFile", L""));
     }
+
+    if (m_latticeStreamId != SIZE_MAX && m_latticeLabelStreamId == SIZE_MAX)
+        InvalidArgument("The LatticeDeserializer requires an HTKMLFDeserializer for the frame labels of the lattices.");
 }
 
 template <class ElemType>
@@ -100,14 +172,10 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
 template <class ElemType>
 void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition)
 {
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // Make sure there are no outstanding reads and copies,
+    // the prefetched minibatches are stale after repositioning.
+    // The prefetch is restarted by the next GetMinibatch.
+    StopPrefetchPipeline();
 
     // Set current position.
     m_reader->SetCurrentSamplePosition(currentSamplePosition);
@@ -118,43 +186,20 @@ void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition
 template <class ElemType>
 void ReaderShim<ElemType>::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
 {
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // Make sure there are no outstanding reads and copies.
+    StopPrefetchPipeline();
 
     m_reader->SetConfiguration(config, inputDescriptions);
     m_reader->SetCurrentSamplePosition(m_currentSamplePosition);
 
-    // Start prefetch.
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-        [this, localCurrentDataTransferIndex]()
-    {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+    StartPrefetchPipeline();
 }
 
 template <class ElemType>
 void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const std::unordered_set<InputStreamDescription>& inputs)
 {
-    // For adaptive minibatch, make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-    {
-        m_prefetchTask.wait();
-    }
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // For adaptive minibatch, make sure there are no outstanding reads and copies.
+    StopPrefetchPipeline();
 
     // Now we can be sure, no prefetch thread is running and there are no outstanding memcopies.
     // Let's check that requested devices are ok and see whether we need to change our data transferers.
@@ -170,14 +215,15 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
         LogicError("Readers do not support running on several GPUs in the same process, at least two devices found '%d', '%d'", deviceId, secondDevice->GetDeviceId());
     }
 
-    if (m_deviceId != deviceId)
+    if (m_deviceId != deviceId || m_prefetchSlots.size() != m_prefetchDepth)
     {
         // Device changed. Let's change the data transferers.
+        // Each slot has its own transferer, so that copies of all slots can be in flight.
         m_deviceId = deviceId;
-        m_dataTransferers.clear();
-        // We need two in order to support two operations in flight.
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
+        m_prefetchSlots.clear();
+        m_prefetchSlots.resize(m_prefetchDepth);
+        for (auto& slot : m_prefetchSlots)
+            slot.m_dataTransferer = m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId);
     }
 
     // Let's create the buffers for the prefetch thread.
@@ -186,26 +232,170 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
     {
         inputDescriptions[i.GetStreamName()] = i.GetDeviceId();
         // Creating buffers with the same properties the network expects.
-        m_prefetchBuffers[i.GetStreamName()] = StreamPrefetchBuffer
+        for (auto& slot : m_prefetchSlots)
         {
-            std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
-            std::make_shared<MBLayout>()
-        };
+            auto stream = m_nameToStreamId.find(i.GetStreamName());
+            bool isBytes = stream != m_nameToStreamId.end() && m_streams[stream->second]->m_elementType == ElementType::tuchar;
+            if (isBytes && i.GetMatrixType() != MatrixType::DENSE)
+                RuntimeError("Input '%ls' has to be dense to be read from a stream of unsigned chars.", i.GetStreamName().c_str());
+
+            slot.m_buffers[i.GetStreamName()] = StreamPrefetchBuffer
+            {
+                std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
+                std::make_shared<MBLayout>(),
+                isBytes ? std::make_shared<Matrix<char>>(i.GetDeviceId()) : nullptr
+            };
+        }
     }
 
     m_endOfEpoch = false;
     m_reader->StartEpoch(config, inputDescriptions);
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    m_prefetchStatistics = PrefetchStatistics();
+    m_chunkLoadStallTimeAtEpochStart = m_reader->GetChunkLoadStallTime();
+    m_sequenceReadTimeAtEpochStart = m_reader->GetSequenceReadTime();
+    m_transformTimeAtEpochStart = m_reader->GetTransformTime();
+
+    StartPrefetchPipeline();
+}
 
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-    [this, localCurrentDataTransferIndex]()
+template <class ElemType>
+bool ReaderShim<ElemType>::PrefetchNextSlot()
+{
+    // Waiting for the main thread to release a slot, i.e. while all prefetched minibatches are still queued.
+    size_t slotIndex;
     {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+        auto stallStart = std::chrono::steady_clock::now();
+        auto profilerState = ProfilerTimeBegin();
+        bool stopped = !m_freeSlots->Pop(slotIndex);
+        ProfilerTimeEnd(profilerState, profilerEvtPrefetchQueueFull);
+        if (stopped)
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_prefetchStatisticsLock);
+        m_prefetchStatistics.m_queueFullTime += SecondsSince(stallStart);
+    }
+
+    PrefetchedSlot prefetched{ slotIndex, PrefetchResult{ false, true, false, 0 }, nullptr };
+    try
+    {
+        prefetched.m_result = PrefetchMinibatch(slotIndex);
+    }
+    catch (...)
+    {
+        prefetched.m_error = std::current_exception();
+    }
+
+    bool isLast = prefetched.m_error || prefetched.m_result.m_isEndOfEpoch;
+
+    // There are only as many slots as places in the queue, so it is never full.
+    bool isQueued = m_filledSlots->TryPush(std::move(prefetched));
+    assert(isQueued), UNUSED(isQueued);
+    return !isLast;
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::RunPrefetch()
+{
+    ProfilerSetThreadName("Prefetch");
+    while (PrefetchNextSlot())
+        ;
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::StartPrefetchPipeline()
+{
+    // Keeping all slots in flight. When the network requests a new minibatch, we wait for the oldest
+    // prefetched slot and its copy to finish, swap the buffers and release the slot for the next prefetch.
+    assert(!m_filledSlots);
+    m_freeSlots.reset(new SpscRing<size_t>(m_prefetchSlots.size()));
+    m_filledSlots.reset(new SpscRing<PrefetchedSlot>(m_prefetchSlots.size()));
+    for (size_t i = 0; i < m_prefetchSlots.size(); ++i)
+        m_freeSlots->TryPush(size_t(i));
+
+    if (m_launchType == launch::async)
+        m_prefetchThread = ThreadPool::Instance().Async(launch::async, [this]() { RunPrefetch(); });
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::StopPrefetchPipeline()
+{
+    if (m_freeSlots)
+    {
+        // The prefetch finishes the slot it is filling and stops when it asks for the next one.
+        m_freeSlots->Close();
+        if (m_prefetchThread.valid())
+            m_prefetchThread.get();
+        m_freeSlots.reset();
+        m_filledSlots.reset();
+    }
+
+    // Let's check that there is no outstanding copies.
+    // Wait on all events if there are any pending copy operations in flight.
+    for (auto& slot : m_prefetchSlots)
+    {
+        if (slot.m_dataTransferer)
+            slot.m_dataTransferer->WaitForCopyCPUToGPU();
+    }
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::ReportPrefetchStatistics()
+{
+    if (m_traceLevel < 1)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_prefetchStatisticsLock);
+    const auto& s = m_prefetchStatistics;
+    fprintf(stderr, "ReaderShim: prefetched %d minibatches with depth %d: pack %.3fs, queue full %.3fs, reader stall %.3fs, copy stall %.3fs, chunk load stall %.3fs.\n",
+        (int)s.m_numberOfMinibatches,
+        (int)m_prefetchDepth,
+        s.m_packTime,
+        s.m_queueFullTime,
+        s.m_readerStallTime,
+        s.m_copyStallTime,
+        s.m_chunkLoadStallTime);
+
+    // How many packed minibatches were waiting when the network asked for the next one: a queue that is
+    // mostly full absorbs slow chunks, one that is mostly empty means the network waits for the reader.
+    if (s.m_numberOfMinibatches > 0)
+        fprintf(stderr, "ReaderShim: queue occupancy %.2f of %d on average, empty for %d of %d minibatches.\n",
+            (double)s.m_queueOccupancy / s.m_numberOfMinibatches,
+            (int)m_prefetchDepth,
+            (int)s.m_numberOfEmptyQueues,
+            (int)s.m_numberOfMinibatches);
+
+    // Breakdown of the pack time by stage. Deserialization is what remains of getting the sequences
+    // after waiting for chunks and transforming, packing what remains of reading the minibatch.
+    double deserializeTime = std::max(0.0, s.m_sequenceReadTime - s.m_chunkLoadStallTime - s.m_transformTime);
+    double packingTime = std::max(0.0, s.m_packTime - s.m_sequenceReadTime - s.m_copyTime);
+    fprintf(stderr, "ReaderShim: pack time by stage: chunk load stall %.3fs, deserialize %.3fs, transform %.3fs, pack %.3fs, %s %.3fs.\n",
+        s.m_chunkLoadStallTime,
+        deserializeTime,
+        s.m_transformTime,
+        packingTime,
+        m_deviceId == CPUDEVICE ? "copy" : "host to device copy",
+        s.m_copyTime);
+
+    // Fraction of the minibatch columns that hold samples rather than gaps between sequences of different length.
+    if (s.m_numberOfFrames > 0)
+        fprintf(stderr, "ReaderShim: padding efficiency %.1f%% (%d samples in %d frames), worst minibatch %.1f%%.\n",
+            100.0 * s.m_numberOfSamples / s.m_numberOfFrames,
+            (int)s.m_numberOfSamples,
+            (int)s.m_numberOfFrames,
+            100.0 * s.m_worstPaddingEfficiency);
+
+    // In the steady state, all page-locked buffers come from the pool.
+    if (m_deviceId != CPUDEVICE)
+    {
+        const auto pool = PinnedMemoryPool::Get(m_deviceId).GetStatistics();
+        fprintf(stderr, "ReaderShim: page-locked memory: %d allocations, %d reuses, %d releases, %.1f MB in use, %.1f MB cached.\n",
+            (int)pool.numAllocations,
+            (int)pool.numReuses,
+            (int)pool.numReleases,
+            pool.bytesInUse / 1048576.0,
+            pool.bytesCached / 1048576.0);
+    }
 }
 
 string EnumerateInputs(const unordered_map<wstring, size_t>& nameToStreamId)
@@ -255,40 +445,96 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         }
     }
 
-    // Make sure the prefetch has finished.
-    assert(m_prefetchTask.valid());
-    auto result = m_prefetchTask.get();
+    // The prefetch is stopped after repositioning the reader.
+    if (!m_filledSlots)
+        StartPrefetchPipeline();
+
+    // Without prefetch the minibatch is read now.
+    if (m_launchType == launch::deferred && m_filledSlots->Size() == 0)
+        PrefetchNextSlot();
+
+    // Take the oldest filled slot, waiting for the prefetch if there is none yet.
+    PrefetchedSlot prefetched;
+    {
+        size_t occupancy = m_filledSlots->Size();
+        TrainingMetricsRecordReaderQueue((int)occupancy, (int)m_prefetchSlots.size());
+
+        auto stallStart = std::chrono::steady_clock::now();
+        auto profilerState = ProfilerTimeBegin();
+        if (!m_filledSlots->Pop(prefetched))
+            LogicError("The prefetch of the reader has been stopped.");
+        ProfilerTimeEnd(profilerState, profilerEvtPrefetchReaderStall);
+
+        std::lock_guard<std::mutex> lock(m_prefetchStatisticsLock);
+        m_prefetchStatistics.m_readerStallTime += SecondsSince(stallStart);
+        m_prefetchStatistics.m_queueOccupancy += occupancy;
+        if (occupancy == 0)
+            m_prefetchStatistics.m_numberOfEmptyQueues++;
+    }
+
+    // The prefetch has stopped after the error, it is restarted by the next call.
+    if (prefetched.m_error)
+    {
+        StopPrefetchPipeline();
+        std::rethrow_exception(prefetched.m_error);
+    }
 
     // Ok, prefetch is done.
+    size_t slotIndex = prefetched.m_slotIndex;
+    const PrefetchResult& result = prefetched.m_result;
 
     // Let's update our sample position.
-    m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    const size_t firstSamplePosition = m_currentSamplePosition;
+    m_currentSamplePosition = result.m_samplePosition;
 
     m_endOfEpoch = result.m_isEndOfEpoch;
     m_endOfSweep = result.m_isEndOfSweep;
     if (m_endOfEpoch && !result.m_isDataAvailable)
     {
         // No data and end of epoch, simply return.
+        ReportPrefetchStatistics();
         return false;
     }
 
-    // Remember current data transfer, async memcpy for it already started on the prefetch thread.
-    auto currentDataTransferIndex = m_currentDataTransferIndex;
+    auto& slot = m_prefetchSlots[slotIndex];
 
-    matrices.m_getKeyById = m_getKeyById;
+    // Let's wait till the memcopy of the slot has finished.
+    if (slot.m_dataTransferer)
+    {
+        auto stallStart = std::chrono::steady_clock::now();
+        auto profilerState = ProfilerTimeBegin();
+        slot.m_dataTransferer->WaitForCopyCPUToGPU();
+        ProfilerTimeEnd(profilerState, profilerEvtPrefetchCopyStall);
+
+        std::lock_guard<std::mutex> lock(m_prefetchStatisticsLock);
+        m_prefetchStatistics.m_copyStallTime += SecondsSince(stallStart);
+    }
 
-    // Let's update the current data transferer.
-    m_currentDataTransferIndex = (m_currentDataTransferIndex + 1) % 2;
+    matrices.m_getKeyById = slot.m_getKeyById;
 
-    // Record an event that prefetch can wait on to ensure that prior compute has finished.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->RecordComputeStreamSyncPoint();
+    std::swap(m_lattices, slot.m_lattices);
+    std::swap(m_latticeUids, slot.m_latticeUids);
+    std::swap(m_latticeParallelSequences, slot.m_latticeParallelSequences);
 
     // We have some data - let's swap the matrices.
     // We cannot simply change pointers because it seems they are remembered deeper in the network.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        std::swap(i->second.GetMatrix<ElemType>(), *m_prefetchBuffers[i->first].m_matrix);
+        const auto& buffer = slot.m_buffers[i->first];
+        if (buffer.m_bytes)
+        {
+            // Converting and normalizing the bytes in a single kernel on the compute stream,
+            // before the sync point below releases them to the next prefetch into the slot.
+            // Images are augmented in the same kernel, their random parameters following the sample position so that
+            // they do not repeat between epochs.
+            const auto& stream = *m_streams[m_nameToStreamId[i->first]];
+            if (stream.m_imageAugmentation)
+                i->second.GetMatrix<ElemType>().AssignAugmentedImagesOf(*buffer.m_bytes, *stream.m_imageAugmentation, firstSamplePosition);
+            else
+                i->second.GetMatrix<ElemType>().AssignNormalizedBytesOf(*buffer.m_bytes, (ElemType)stream.m_normalizationMean, (ElemType)stream.m_normalizationScale);
+        }
+        else
+            std::swap(i->second.GetMatrix<ElemType>(), *buffer.m_matrix);
 
         // Resetting layouts.
         i->second.pMBLayout->Init(1, 0);
@@ -300,7 +546,7 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // Let's now check the layouts and throw if the same layout is being assigned twice.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        auto streamLayout = m_prefetchBuffers[i->first].m_mbLayout;
+        auto streamLayout = slot.m_buffers[i->first].m_mbLayout;
         auto& layout = i->second.pMBLayout;
         if (layout->GetNumCols() == 0) // just initialized, let's take the layout of the reader.
         {
@@ -321,64 +567,220 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // So pick up the first one.
     m_numParallelSequences = matrices.begin()->second.pMBLayout->GetNumParallelSequences();
 
-    // It is time to issue the next prefetch.
-    if (!m_endOfEpoch)
-    {
-        // Starting the prefetch task. There is always a single async read in flight.
-        // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-        // and kick off the new prefetch.
-        auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-        m_prefetchTask = std::async(m_launchType, [this, localCurrentDataTransferIndex]() { return PrefetchMinibatch(localCurrentDataTransferIndex); });
-    }
+    // The slot now holds the matrices of the previous minibatch.
+    // Record an event that prefetch can wait on to ensure that prior compute has finished.
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->RecordComputeStreamSyncPoint();
 
-    // Let's wait till the previous memcopy has finished.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // It is time to release the slot for the next prefetch.
+    m_freeSlots->TryPush(std::move(slotIndex));
+    if (m_endOfEpoch)
+        ReportPrefetchStatistics();
 
     return result.m_isDataAvailable;
 }
 
 template <class ElemType>
-typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t currentDataTransferIndex)
+typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t slotIndex)
 {
     PROFILE_SCOPE(profilerEvtPrefetchMinibatch);
+    auto packStart = std::chrono::steady_clock::now();
+
+    auto& slot = m_prefetchSlots[slotIndex];
 
     // Resetting layouts.
-    for (auto& mx : m_prefetchBuffers)
+    for (auto& mx : slot.m_buffers)
         mx.second.m_mbLayout = std::make_shared<MBLayout>();
 
     Minibatch minibatch = m_reader->ReadMinibatch();
+    size_t samplePosition = m_reader->GetCurrentSamplePosition();
+
+    {
+        std::lock_guard<std::mutex> lock(m_prefetchStatisticsLock);
+        m_prefetchStatistics.m_chunkLoadStallTime = m_reader->GetChunkLoadStallTime() - m_chunkLoadStallTimeAtEpochStart;
+        m_prefetchStatistics.m_sequenceReadTime = m_reader->GetSequenceReadTime() - m_sequenceReadTimeAtEpochStart;
+        m_prefetchStatistics.m_transformTime = m_reader->GetTransformTime() - m_transformTimeAtEpochStart;
+    }
 
     // If there is no data we can simply return.
     if (minibatch.m_data.empty())
-        return PrefetchResult{ minibatch.m_endOfSweep, minibatch.m_endOfEpoch, false };
+        return PrefetchResult{ minibatch.m_endOfSweep, minibatch.m_endOfEpoch, false, samplePosition };
 
     // Ok we have some data. Let's load it to GPU.
     // But before we need to make sure that corresponding compute has already finished from the last iteration.
 
     // We need to make sure that the compute for the current transfer is finished before we start prefetch.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForSyncPointOnAssignStreamAsync();
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->WaitForSyncPointOnAssignStreamAsync();
+
+    slot.m_getKeyById = minibatch.m_getKeyById;
 
-    m_getKeyById = minibatch.m_getKeyById;
+    // The lattices are decoded from the packed host memory, which the copy below only reads.
+    if (m_latticeStreamId != SIZE_MAX)
+        DecodeLattices(minibatch, slot);
 
-    for (auto& mx : m_prefetchBuffers)
+    auto copyStart = std::chrono::steady_clock::now();
+    for (auto& mx : slot.m_buffers)
     {
         size_t streamId = m_nameToStreamId[mx.first];
         const auto& stream = minibatch.m_data[streamId];
         mx.second.m_mbLayout = stream->m_layout;
 
         size_t sampleSize = m_streams[streamId]->m_sampleLayout->GetNumElements();
-        FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, m_dataTransferers[currentDataTransferIndex].get());
+        if (mx.second.m_bytes)
+        {
+            // Only the bytes go to the device, a quarter of the float data.
+            auto& bytes = *mx.second.m_bytes;
+            bytes.SetValue(sampleSize, stream->m_layout->GetNumCols(), bytes.GetDeviceId(), reinterpret_cast<char*>(stream->m_data), matrixFlagNormal, slot.m_dataTransferer.get());
+        }
+        else
+            FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, slot.m_dataTransferer.get());
     }
 
     // Let's record that we started the copy, so that the main thread can wait afterwards.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->RecordCPUToGPUCopy();
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->RecordCPUToGPUCopy();
+
+    {
+        std::lock_guard<std::mutex> lock(m_prefetchStatisticsLock);
+        m_prefetchStatistics.m_copyTime += SecondsSince(copyStart);
+        m_prefetchStatistics.m_packTime += SecondsSince(packStart);
+        m_prefetchStatistics.m_numberOfMinibatches++;
+
+        const auto& layout = minibatch.m_data.front()->m_layout;
+        if (layout && layout->GetNumCols() > 0)
+        {
+            size_t numberOfSamples = layout->GetActualNumSamples();
+            m_prefetchStatistics.m_numberOfSamples += numberOfSamples;
+            m_prefetchStatistics.m_numberOfFrames += layout->GetNumCols();
+            m_prefetchStatistics.m_worstPaddingEfficiency = std::min(m_prefetchStatistics.m_worstPaddingEfficiency, (double)numberOfSamples / layout->GetNumCols());
+        }
+    }
+
+    return PrefetchResult{ minibatch.m_endOfSweep, minibatch.m_endOfEpoch, true, samplePosition };
+}
 
-    return PrefetchResult{ minibatch.m_endOfSweep, minibatch.m_endOfEpoch, true };
+// Frame label of a column of a packed label stream: the row of its nonzero (sparse) or of its maximum (dense).
+static size_t GetLabelOfColumn(const StreamDescription& stream, const StreamMinibatch& labels, size_t column)
+{
+    const size_t elementSize = GetSizeByType(stream.m_elementType);
+    const size_t numRows = stream.m_sampleLayout->GetNumElements();
+    if (stream.m_storageType == StorageType::sparse_csc)
+    {
+        // Packed as in FillMatrixFromStream(): nnz count, values, row indices and column starts.
+        const size_t nnzCount = *reinterpret_cast<const size_t*>(labels.m_data);
+        const char* values = reinterpret_cast<const char*>(labels.m_data) + sizeof(size_t);
+        const IndexType* rows = reinterpret_cast<const IndexType*>(values + nnzCount * elementSize);
+        const IndexType* columns = rows + nnzCount;
+        if (columns[column] == columns[column + 1])
+            RuntimeError("The frame label of a lattice is missing.");
+        return rows[columns[column]];
+    }
+
+    size_t label = 0;
+    for (size_t row = 1; row < numRows; ++row)
+    {
+        const char* values = reinterpret_cast<const char*>(labels.m_data) + column * numRows * elementSize;
+        bool isGreater = stream.m_elementType == ElementType::tfloat ?
+            reinterpret_cast<const float*>(values)[row] > reinterpret_cast<const float*>(values)[label] :
+            reinterpret_cast<const double*>(values)[row] > reinterpret_cast<const double*>(values)[label];
+        if (isGreater)
+            label = row;
+    }
+    return label;
+}
+
+// The lattices are returned in the order in which the criterion consumes the log likelihoods: the utterances of
+// parallel sequence 0 in the order of time, then those of sequence 1, etc. The utterances must not be truncated.
+template <class ElemType>
+void ReaderShim<ElemType>::DecodeLattices(const Minibatch& minibatch, PrefetchSlot& slot)
+{
+    slot.m_lattices.clear();
+    slot.m_latticeUids.clear();
+    slot.m_latticeParallelSequences.clear();
+
+    const auto& latticeStream = *minibatch.m_data[m_latticeStreamId];
+    const auto& labelStream = *minibatch.m_data[m_latticeLabelStreamId];
+    const auto& latticeLayout = *latticeStream.m_layout;
+    const auto& labelLayout = *labelStream.m_layout;
+
+    // The lattice stream has a layout of its own, its sequences are matched by their id in the minibatch.
+    std::map<size_t, MBLayout::SequenceInfo> latticeSequences;
+    for (const auto& sequence : latticeLayout.GetAllSequences())
+    {
+        if (sequence.seqId != GAP_SEQUENCE_ID)
+            latticeSequences[sequence.seqId] = sequence;
+    }
+
+    std::vector<MBLayout::SequenceInfo> utterances;
+    for (const auto& sequence : labelLayout.GetAllSequences())
+    {
+        if (sequence.seqId != GAP_SEQUENCE_ID)
+            utterances.push_back(sequence);
+    }
+    std::sort(utterances.begin(), utterances.end(), [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b)
+    {
+        return a.s < b.s || (a.s == b.s && a.tBegin < b.tBegin);
+    });
+
+    const size_t bytesPerSample = m_streams[m_latticeStreamId]->m_sampleLayout->GetNumElements() * GetSizeByType(m_streams[m_latticeStreamId]->m_elementType);
+    const std::vector<unsigned int> identityMap; // the deserializer has mapped the units to the model
+    std::vector<char> buffer;
+    for (const auto& utterance : utterances)
+    {
+        if (utterance.tBegin < 0 || utterance.tEnd > labelLayout.GetNumTimeSteps())
+            RuntimeError("Sequence training requires whole utterances in the minibatch, truncation is not supported.");
+
+        auto latticeSequence = latticeSequences.find(utterance.seqId);
+        if (latticeSequence == latticeSequences.end())
+            LogicError("The lattice of the utterance '%s' is missing in the minibatch.", slot.m_getKeyById(utterance.seqId).c_str());
+
+        // The samples of a lattice are not contiguous in the minibatch if it has several parallel sequences.
+        const auto& latticeInfo = latticeSequence->second;
+        buffer.resize(latticeInfo.GetNumTimeSteps() * bytesPerSample);
+        for (size_t t = 0; t < latticeInfo.GetNumTimeSteps(); ++t)
+            memcpy(&buffer[t * bytesPerSample], reinterpret_cast<const char*>(latticeStream.m_data) + latticeLayout.GetColumnIndex(latticeInfo, t) * bytesPerSample, bytesPerSample);
+
+        auto lattices = std::make_shared<msra::dbn::latticepair>();
+        lattices->second.readcompiled(buffer.data(), buffer.data() + buffer.size(), identityMap, SIZE_MAX);
+        lattices->second.key = msra::strfun::utf16(slot.m_getKeyById(utterance.seqId));
+
+        const size_t numFrames = utterance.GetNumTimeSteps();
+        if (lattices->getnumframes() != numFrames)
+            RuntimeError("The lattice of the utterance '%ls' has %d frames, but its labels have %d.",
+                lattices->getkey().c_str(), (int)lattices->getnumframes(), (int)numFrames);
+
+        for (size_t t = 0; t < numFrames; ++t)
+            slot.m_latticeUids.push_back(GetLabelOfColumn(*m_streams[m_latticeLabelStreamId], labelStream, labelLayout.GetColumnIndex(utterance, t)));
+
+        slot.m_lattices.push_back(lattices);
+        slot.m_latticeParallelSequences.push_back(utterance.s);
+    }
 }
 
+template <class ElemType>
+bool ReaderShim<ElemType>::GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& latticeinput, vector<size_t>& uids, vector<size_t>& boundaries, vector<size_t>& extrauttmap)
+{
+    if (m_latticeStreamId == SIZE_MAX)
+        RuntimeError("Sequence training requires a LatticeDeserializer in the reader configuration.");
+
+    latticeinput.assign(m_lattices.begin(), m_lattices.end());
+    uids = m_latticeUids;
+    // Phone boundaries are only used with reference alignments, which are not supported here.
+    boundaries.assign(uids.size(), 0);
+    extrauttmap = m_latticeParallelSequences;
+    return true;
+}
+
+template <class ElemType>
+bool ReaderShim<ElemType>::GetHmmData(msra::asr::simplesenonehmm* hmm)
+{
+    if (!m_hset)
+        RuntimeError("Sequence training requires a LatticeDeserializer in the reader configuration.");
+
+    *hmm = *m_hset;
+    return true;
+}
 
 template <class ElemType>
 /*static*/ void ReaderShim<ElemType>::FillMatrixFromStream(StorageType type, Matrix<ElemType>* matrix, size_t numRows, const StreamMinibatchPtr& stream, DataTransferer* transferer)
@@ -11,8 +11,11 @@
 #include <unordered_map>
 #include <string>
 #include <future>
+#include <memory>
+#include <mutex>
 #include "DataReader.h"
 #include "Reader.h"
+#include "SpscRing.h"
 
 namespace CNTK
 {
@@ -45,14 +48,8 @@ public:
     virtual void Destroy() override
     {
         // Make sure there are no outstanding reads.
-        // Future destructor does not wait as of 2013 so probably it is not in VS2013:
-        // More info can be found here http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2013/n3679.html.
-        if (m_prefetchTask.valid())
-        {
-            // If there are some, give them time to finish.
-            m_prefetchTask.wait_for(std::chrono::seconds(5));
-            // TODO: if the prefetch is still valid, print a warning here!
-        }
+        // The futures of the thread pool do not wait in their destructor.
+        StopPrefetchPipeline();
 
         delete this;
     }
@@ -84,6 +81,11 @@ public:
 
     virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override;
 
+    // Sequence training: lattices of the current minibatch with their frame labels (see InitLatticeStreams()).
+    virtual bool GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& latticeinput, vector<size_t>& uids, vector<size_t>& boundaries, vector<size_t>& extrauttmap) override;
+
+    virtual bool GetHmmData(msra::asr::simplesenonehmm* hmm) override;
+
     virtual bool DataEnd() override;
 
     void CopyMBLayoutTo(MBLayoutPtr) override;
@@ -92,7 +94,7 @@ public:
 
     virtual size_t GetCurrentSamplePosition() override;
 
-    void SetCurrentSamplePosition(size_t currentSamplePosition);
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
 
     void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions);
 
@@ -112,11 +114,93 @@ private:
         bool m_isEndOfSweep;
         bool m_isEndOfEpoch;
         bool m_isDataAvailable;
+
+        // Position of the reader on the global timeline after the minibatch has been read.
+        size_t m_samplePosition;
+    };
+
+    // Data structure required for prefetch.
+    struct StreamPrefetchBuffer
+    {
+        std::shared_ptr<Matrix<ElemType>> m_matrix;
+        MBLayoutPtr m_mbLayout;
+
+        // Streams of unsigned chars only: the bytes as copied to the device, GetMinibatch() expands them into
+        // the matrix of the network instead of swapping m_matrix.
+        std::shared_ptr<Matrix<char>> m_bytes;
+    };
+
+    // A single stage of the prefetch ring.
+    // The prefetch thread packs the minibatch into pinned memory of the packer and starts
+    // the asynchronous copy into the matrices of the slot on the stream of its data transferer.
+    // When the main thread enters GetMinibatch it waits for the copy of the oldest slot,
+    // swaps the matrices from the slot and hands the slot back for the next prefetch.
+    struct PrefetchSlot
+    {
+        std::unordered_map<std::wstring, StreamPrefetchBuffer> m_buffers;
+
+        // Null when running on CPU.
+        DataTransfererPtr m_dataTransferer;
+
+        // Id to key mapping of the minibatch in the slot.
+        std::function<std::string(size_t)> m_getKeyById;
+
+        // Sequence training: lattices of the minibatch in the slot, decoded by the prefetch.
+        std::vector<std::shared_ptr<const msra::dbn::latticepair>> m_lattices;
+        std::vector<size_t> m_latticeUids;
+        std::vector<size_t> m_latticeParallelSequences;
     };
 
-    PrefetchResult PrefetchMinibatch(size_t currentDataTransferIndex);
+    // A slot that the prefetch thread has filled, in the queue to the main thread.
+    struct PrefetchedSlot
+    {
+        size_t m_slotIndex;
+        PrefetchResult m_result;
+        std::exception_ptr m_error; // of the prefetch, rethrown by GetMinibatch
+    };
+
+    // Time spent in the stages of the prefetch pipeline since the start of the epoch, in seconds.
+    struct PrefetchStatistics
+    {
+        size_t m_numberOfMinibatches{ 0 };
+        double m_packTime{ 0 };        // reading and packing minibatches
+        double m_queueFullTime{ 0 };   // prefetch waiting for the main thread to release a slot
+        double m_readerStallTime{ 0 }; // main thread waiting for the next minibatch to be packed
+        double m_copyStallTime{ 0 };   // main thread waiting for the copy of the next minibatch
+        double m_chunkLoadStallTime{ 0 }; // reader waiting for chunks to be loaded from the deserializer
+        double m_sequenceReadTime{ 0 };   // reader getting sequences: chunk load stall, deserialization and transforms
+        double m_transformTime{ 0 };      // reader applying transforms
+        double m_copyTime{ 0 };           // filling the matrices, i.e. issuing the host to device copy on GPU
+        size_t m_numberOfSamples{ 0 };    // in the layouts of the first stream, i.e. columns that are not gaps
+        size_t m_numberOfFrames{ 0 };     // columns of these layouts, including gaps
+        double m_worstPaddingEfficiency{ 1 }; // lowest fraction of samples among the columns of a minibatch
+        size_t m_queueOccupancy{ 0 };     // sum over the minibatches of the slots ready when the main thread asked for it
+        size_t m_numberOfEmptyQueues{ 0 }; // minibatches for which no slot was ready
+    };
+
+    PrefetchResult PrefetchMinibatch(size_t slotIndex);
+
+    // Fills the next free slot and queues it for the main thread.
+    // Returns false when there is nothing more to prefetch: at the end of the epoch, after an error or after the stop.
+    bool PrefetchNextSlot();
+
+    // Fills the slots of the ring one after the other, on a thread of the pool.
+    void RunPrefetch();
+
+    // Starts the prefetch into all slots of the ring.
+    void StartPrefetchPipeline();
+
+    // Waits for all outstanding prefetches and copies and drops their results.
+    void StopPrefetchPipeline();
+
+    void ReportPrefetchStatistics();
+
+    // Finds the streams of the LatticeDeserializer and of the frame labels in the deserializer configuration.
+    void InitLatticeStreams(const ConfigParameters& config);
+
+    // Decodes the lattices of the minibatch into the slot.
+    void DecodeLattices(const Minibatch& minibatch, PrefetchSlot& slot);
 
-    std::future<PrefetchResult> m_prefetchTask;
     ReaderPtr m_reader;
     ReaderFactory m_factory;
     bool m_endOfEpoch;
@@ -128,33 +212,45 @@ private:
     std::vector<StreamDescriptionPtr> m_streams;
     launch m_launchType;
 
-    // Data structure required for prefetch.
-    struct StreamPrefetchBuffer
-    {
-        std::shared_ptr<Matrix<ElemType>> m_matrix;
-        MBLayoutPtr m_mbLayout;
-    };
+    // Number of minibatches prefetched ahead of the network, one per slot.
+    size_t m_prefetchDepth;
+
+    // Ring of prefetch slots, m_prefetchSlots.size() == m_prefetchDepth.
+    std::vector<PrefetchSlot> m_prefetchSlots;
 
-    // Intermediate buffer where the prefetch thread puts its data to.
-    // When the main thread enters GetMinibatch it swaps the matrices from this buffer,
-    // triggers the next prefetch and waits if memCpy is still in progress.
-    std::unordered_map<std::wstring, StreamPrefetchBuffer> m_prefetchBuffers;
+    // The slots travel between the threads through two lock-free queues: the prefetch thread takes a slot from
+    // m_freeSlots, fills it and queues it to m_filledSlots, in the order of the reader timeline; the main thread
+    // takes it from there and returns it to m_freeSlots once it has swapped the matrices out.
+    // Packed minibatches thus pile up ahead of the network while reading is fast, and are drawn down by slow
+    // chunks. Without prefetch, the main thread fills the slots itself.
+    // Both are recreated by StartPrefetchPipeline, and are null while the pipeline is stopped.
+    std::unique_ptr<SpscRing<size_t>> m_freeSlots;
+    std::unique_ptr<SpscRing<PrefetchedSlot>> m_filledSlots;
+    std::future<void> m_prefetchThread;
 
-    // Alternating data transfer operations. In the current version these are only two - 
-    // currently waiting on the main thread and the one that can be started by the prefetch thread 
-    // in the meantime.
-    std::vector<DataTransfererPtr> m_dataTransferers;
+    PrefetchStatistics m_prefetchStatistics;
+    std::mutex m_prefetchStatisticsLock;
 
-    // Id to key mapping.
-    std::function<std::string(size_t)> m_getKeyById;
+    // Chunk load stall time of the reader (which counts since its creation) at the start of the epoch.
+    double m_chunkLoadStallTimeAtEpochStart;
+    double m_sequenceReadTimeAtEpochStart;
+    double m_transformTimeAtEpochStart;
 
-    // Current data transfer. Flips 0 and 1.
-    // Can be changed only from the main thread with no ongoing prefetch.
-    size_t m_currentDataTransferIndex; 
+    int m_traceLevel;
 
     // Device id.
     int m_deviceId;
 
+    // Sequence training: ids of the streams of the LatticeDeserializer and of the frame labels, SIZE_MAX without lattices.
+    size_t m_latticeStreamId;
+    size_t m_latticeLabelStreamId;
+    std::shared_ptr<msra::asr::simplesenonehmm> m_hset;
+
+    // Lattices of the current minibatch, in the order of the parallel sequences and of time within them.
+    std::vector<std::shared_ptr<const msra::dbn::latticepair>> m_lattices;
+    std::vector<size_t> m_latticeUids;             // frame labels of all lattices, concatenated
+    std::vector<size_t> m_latticeParallelSequences; // [i] parallel sequence of lattice i
+
     // Current sample position of the reader on the global timeline.
     // We have to remember the value locally before starting prefetch.
     // The value is updated only from the main thread (in StartEpoch/GetMinibatch)
@@ -0,0 +1,460 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+
+#include "RemoteFile.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <functional>
+#include <future>
+#include <vector>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+#include "Basics.h"
+#include "File.h"
+#include "fileutil.h"
+#include "ThreadPool.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// parts of a fetch are not made smaller than this, so that small reads do not turn into many requests
+static const uint64_t s_minPartSize = 1024 * 1024;
+
+static const int s_socketTimeoutSeconds = 60;
+
+struct HttpUrl
+{
+    string host;
+    string port;
+    string target; // path and query
+};
+
+static HttpUrl ParseHttpUrl(const string& url)
+{
+    static const string scheme = "http://";
+    if (url.compare(0, 8, "https://") == 0)
+        RuntimeError("RemoteFile: '%s' is an https URL, which is not supported; use the http endpoint of the storage.", url.c_str());
+    if (url.compare(0, scheme.size(), scheme) != 0)
+        RuntimeError("RemoteFile: '%s' is not an http URL.", url.c_str());
+
+    HttpUrl result;
+    size_t authorityEnd = url.find('/', scheme.size());
+    string authority = url.substr(scheme.size(), authorityEnd == string::npos ? string::npos : authorityEnd - scheme.size());
+    result.target = authorityEnd == string::npos ? "/" : url.substr(authorityEnd);
+    size_t colon = authority.rfind(':');
+    result.host = authority.substr(0, colon);
+    result.port = colon == string::npos ? "80" : authority.substr(colon + 1);
+    if (result.host.empty())
+        RuntimeError("RemoteFile: '%s' has no host.", url.c_str());
+    return result;
+}
+
+// A TCP connection to an HTTP server, closed on destruction.
+class HttpConnection
+{
+public:
+    explicit HttpConnection(const HttpUrl& url)
+    {
+#ifdef _WIN32
+        static once_flag winsockInitialized;
+        call_once(winsockInitialized, []()
+        {
+            WSADATA data;
+            if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+                RuntimeError("RemoteFile: cannot initialize Winsock.");
+        });
+#endif
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        int rc = getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &addresses);
+        if (rc != 0)
+            RuntimeError("RemoteFile: cannot resolve '%s': %s.", url.host.c_str(), gai_strerror(rc));
+
+        m_socket = s_invalidSocket;
+        for (addrinfo* address = addresses; address && m_socket == s_invalidSocket; address = address->ai_next)
+        {
+            m_socket = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (m_socket == s_invalidSocket)
+                continue;
+            if (connect(m_socket, address->ai_addr, (int)address->ai_addrlen) != 0)
+                Close();
+        }
+        freeaddrinfo(addresses);
+        if (m_socket == s_invalidSocket)
+            RuntimeError("RemoteFile: cannot connect to '%s:%s'.", url.host.c_str(), url.port.c_str());
+
+        // a stalled connection fails (and is retried) rather than blocking the reader forever
+#ifdef _WIN32
+        DWORD timeout = s_socketTimeoutSeconds * 1000;
+#else
+        timeval timeout = { s_socketTimeoutSeconds, 0 };
+#endif
+        setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        setsockopt(m_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+    }
+
+    ~HttpConnection()
+    {
+        Close();
+    }
+
+    void Send(const string& data)
+    {
+        for (size_t sent = 0; sent < data.size();)
+        {
+            int n = send(m_socket, data.data() + sent, (int)(data.size() - sent), 0);
+            if (n <= 0)
+                RuntimeError("RemoteFile: the connection failed while sending a request.");
+            sent += n;
+        }
+    }
+
+    // Returns 0 when the server closed the connection.
+    size_t Receive(char* buffer, size_t size)
+    {
+        int n = recv(m_socket, buffer, (int)min<size_t>(size, INT_MAX), 0);
+        if (n < 0)
+            RuntimeError("RemoteFile: the connection failed or timed out while receiving.");
+        return n;
+    }
+
+private:
+#ifdef _WIN32
+    typedef SOCKET Socket;
+    static const Socket s_invalidSocket = INVALID_SOCKET;
+#else
+    typedef int Socket;
+    static const Socket s_invalidSocket = -1;
+#endif
+
+    void Close()
+    {
+        if (m_socket == s_invalidSocket)
+            return;
+#ifdef _WIN32
+        closesocket(m_socket);
+#else
+        close(m_socket);
+#endif
+        m_socket = s_invalidSocket;
+    }
+
+    Socket m_socket;
+
+    DISABLE_COPY_AND_MOVE(HttpConnection);
+};
+
+static string ToLower(string s)
+{
+    transform(s.begin(), s.end(), s.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+    return s;
+}
+
+// GETs the bytes [begin, end) of the resource and passes them in order to consume(). Returns the size of the
+// resource, from the Content-Range of the response.
+static uint64_t HttpGetRange(const HttpUrl& url, const string& displayUrl, uint64_t begin, uint64_t end,
+                             const function<void(const char*, size_t)>& consume)
+{
+    HttpConnection connection(url);
+    connection.Send("GET " + url.target + " HTTP/1.1\r\n"
+                    "Host: " + url.host + "\r\n"
+                    "Range: bytes=" + to_string(begin) + "-" + to_string(end - 1) + "\r\n"
+                    "User-Agent: CNTK\r\n"
+                    "Connection: close\r\n\r\n");
+
+    vector<char> buffer(256 * 1024);
+    string header;
+    size_t headerEnd;
+    for (;;)
+    {
+        size_t n = connection.Receive(buffer.data(), buffer.size());
+        if (n == 0)
+            RuntimeError("RemoteFile: the server closed the connection before responding to a request of '%s'.", displayUrl.c_str());
+        header.append(buffer.data(), n);
+        headerEnd = header.find("\r\n\r\n");
+        if (headerEnd != string::npos)
+            break;
+        if (header.size() > 64 * 1024)
+            RuntimeError("RemoteFile: the response header for '%s' is too long.", displayUrl.c_str());
+    }
+    string body = header.substr(headerEnd + 4);
+    header.resize(headerEnd);
+
+    int status = 0;
+    size_t space = header.find(' ');
+    if (header.compare(0, 5, "HTTP/") == 0 && space != string::npos)
+        status = atoi(header.c_str() + space + 1);
+    if (status != 206)
+        RuntimeError("RemoteFile: the server responded with status %d to a range request of '%s'%s.", status, displayUrl.c_str(),
+                     status == 200 ? ", it does not support range requests" : "");
+
+    uint64_t contentLength = end - begin;
+    uint64_t rangeBegin = UINT64_MAX, rangeEnd = 0, totalSize = 0;
+    bool hasContentRange = false;
+    for (size_t lineBegin = header.find("\r\n"); lineBegin != string::npos && lineBegin < header.size();)
+    {
+        lineBegin += 2;
+        size_t lineEnd = min(header.find("\r\n", lineBegin), header.size());
+        string line = header.substr(lineBegin, lineEnd - lineBegin);
+        lineBegin = lineEnd;
+
+        size_t colon = line.find(':');
+        if (colon == string::npos)
+            continue;
+        string name = ToLower(line.substr(0, colon));
+        string value = line.substr(colon + 1);
+        if (name == "content-length")
+            contentLength = strtoull(value.c_str(), nullptr, 10);
+        else if (name == "content-range")
+            hasContentRange = sscanf(value.c_str(), " bytes %" SCNu64 "-%" SCNu64 "/%" SCNu64, &rangeBegin, &rangeEnd, &totalSize) == 3;
+        else if (name == "transfer-encoding" && ToLower(value).find("chunked") != string::npos)
+            RuntimeError("RemoteFile: chunked transfer encoding of '%s' is not supported.", displayUrl.c_str());
+    }
+    if (!hasContentRange || rangeBegin != begin || rangeEnd + 1 != end || contentLength != end - begin)
+        RuntimeError("RemoteFile: the server did not return the requested range %" PRIu64 "-%" PRIu64 " of '%s'.", begin, end - 1, displayUrl.c_str());
+
+    uint64_t received = min<uint64_t>(body.size(), contentLength);
+    consume(body.data(), (size_t)received);
+    while (received < contentLength)
+    {
+        size_t n = connection.Receive(buffer.data(), (size_t)min<uint64_t>(buffer.size(), contentLength - received));
+        if (n == 0)
+            RuntimeError("RemoteFile: the connection closed after %" PRIu64 " of %" PRIu64 " bytes of '%s'.", received, contentLength, displayUrl.c_str());
+        consume(buffer.data(), n);
+        received += n;
+    }
+    return totalSize;
+}
+
+static void SeekOrDie(FILE* f, uint64_t offset, const wstring& path)
+{
+    if (_fseeki64(f, (int64_t)offset, SEEK_SET) != 0)
+        RuntimeError("RemoteFile: cannot seek to position %" PRIu64 " of '%ls'.", offset, path.c_str());
+}
+
+// FNV-1a, for a file name that is the same in every run
+static uint64_t StableHash(const string& s)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : s)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/*static*/ bool RemoteFile::IsRemote(const wstring& path)
+{
+    return path.compare(0, 7, L"http://") == 0 || path.compare(0, 8, L"https://") == 0;
+}
+
+/*static*/ wstring RemoteFile::DefaultCacheDirectory()
+{
+#ifdef _WIN32
+    const wchar_t* directory = _wgetenv(L"TEMP");
+    return directory ? directory : L".";
+#else
+    const char* directory = getenv("TMPDIR");
+    return msra::strfun::utf16(directory ? directory : "/tmp");
+#endif
+}
+
+RemoteFile::RemoteFile(const wstring& url, const wstring& cacheDirectory, size_t numConnections, bool verbose)
+    : m_url(msra::strfun::utf8(url)), m_numConnections(max<size_t>(1, numConnections)), m_verbose(verbose), m_size(0), m_bytesDownloaded(0)
+{
+    HttpUrl httpUrl = ParseHttpUrl(m_url);
+
+    // the size of the file, from the response to a request of its first byte
+    attempt([&]()
+    {
+        m_size = HttpGetRange(httpUrl, m_url, 0, 1, [](const char*, size_t) {});
+    });
+
+    // The cache is named after the URL, without the query, which holds the (changing) signature of SAS URLs.
+    string path = m_url.substr(0, m_url.find('?'));
+    string name = path.substr(path.rfind('/') + 1);
+    char hash[17];
+    sprintf(hash, "%016" PRIx64, StableHash(path));
+    m_cachePath = cacheDirectory + L"/" + msra::strfun::utf16(string(hash) + "_" + name);
+    m_rangesPath = m_cachePath + L".ranges";
+
+    LoadCachedRanges();
+
+    if (m_verbose)
+    {
+        uint64_t cached = 0;
+        for (const auto& range : m_cachedRanges)
+            cached += range.second - range.first;
+        fprintf(stderr, "RemoteFile: '%s' has %" PRIu64 " bytes, cached in '%ls', of which %" PRIu64 " are present.\n",
+                path.c_str(), m_size, m_cachePath.c_str(), cached);
+    }
+}
+
+// The ranges file holds the size of the remote file followed by the [begin, end) pairs of the fetched ranges. It is
+// appended after each download, once the data is flushed to the cache file, so that an interrupted run leaves it valid.
+void RemoteFile::LoadCachedRanges()
+{
+    bool valid = false;
+    if (fexists(m_rangesPath.c_str()) && fexists(m_cachePath.c_str()) && (uint64_t)filesize64(m_cachePath.c_str()) == m_size)
+    {
+        vector<uint64_t> values;
+        {
+            shared_ptr<FILE> file(fopenOrDie(m_rangesPath, L"rb"), [](FILE* f) { fclose(f); });
+            uint64_t value;
+            while (fread(&value, sizeof(value), 1, file.get()) == 1)
+                values.push_back(value);
+        }
+        valid = !values.empty() && values[0] == m_size;
+        for (size_t i = 1; valid && i + 1 < values.size(); i += 2)
+            AddCachedRange(values[i], values[i + 1]);
+    }
+
+    if (valid)
+    {
+        m_rangesFile.reset(fopenOrDie(m_rangesPath, L"ab"), [](FILE* f) { fclose(f); });
+        return;
+    }
+
+    // a new (or changed) file: an empty cache file of the full size, sparse where the file system supports it
+    msra::files::make_intermediate_dirs(m_cachePath);
+    {
+        shared_ptr<FILE> file(fopenOrDie(m_cachePath, L"wb"), [](FILE* f) { fclose(f); });
+        if (m_size > 0)
+        {
+            SeekOrDie(file.get(), m_size - 1, m_cachePath);
+            fwriteOrDie("", 1, 1, file.get());
+        }
+        fflushOrDie(file.get());
+    }
+    m_rangesFile.reset(fopenOrDie(m_rangesPath, L"wb"), [](FILE* f) { fclose(f); });
+    fwriteOrDie(&m_size, sizeof(m_size), 1, m_rangesFile.get());
+    fflushOrDie(m_rangesFile.get());
+}
+
+void RemoteFile::AddCachedRange(uint64_t begin, uint64_t end)
+{
+    // merge with the overlapping and adjacent ranges
+    auto it = m_cachedRanges.upper_bound(begin);
+    if (it != m_cachedRanges.begin() && prev(it)->second >= begin)
+        --it;
+    while (it != m_cachedRanges.end() && it->first <= end)
+    {
+        begin = min(begin, it->first);
+        end = max(end, it->second);
+        it = m_cachedRanges.erase(it);
+    }
+    m_cachedRanges[begin] = end;
+}
+
+void RemoteFile::Fetch(uint64_t offset, uint64_t size)
+{
+    uint64_t end = min(offset + size, m_size);
+    if (offset >= end)
+        return;
+
+    lock_guard<mutex> fetchLock(m_fetchMutex);
+
+    // the gaps between the cached ranges
+    vector<pair<uint64_t, uint64_t>> gaps;
+    uint64_t missing = 0;
+    {
+        lock_guard<mutex> lock(m_rangesMutex);
+        uint64_t position = offset;
+        auto it = m_cachedRanges.upper_bound(offset);
+        if (it != m_cachedRanges.begin())
+            --it;
+        for (; position < end; ++it)
+        {
+            uint64_t gapEnd = it == m_cachedRanges.end() ? end : min(end, it->first);
+            if (gapEnd > position)
+            {
+                gaps.push_back(make_pair(position, gapEnd));
+                missing += gapEnd - position;
+            }
+            if (it == m_cachedRanges.end())
+                break;
+            position = max(position, it->second);
+        }
+    }
+    if (gaps.empty())
+        return;
+
+    // the gaps split into parts for the connections
+    uint64_t partSize = max(s_minPartSize, (missing + m_numConnections - 1) / m_numConnections);
+    vector<pair<uint64_t, uint64_t>> parts;
+    for (const auto& gap : gaps)
+    {
+        for (uint64_t begin = gap.first; begin < gap.second; begin += partSize)
+            parts.push_back(make_pair(begin, min(begin + partSize, gap.second)));
+    }
+
+    HttpUrl url = ParseHttpUrl(m_url);
+    vector<future<void>> downloads;
+    for (const auto& part : parts)
+    {
+        downloads.push_back(ThreadPool::Instance().Async(launch::async, [this, &url, part]()
+        {
+            attempt([&]()
+            {
+                shared_ptr<FILE> file(fopenOrDie(m_cachePath, L"r+b"), [](FILE* f) { fclose(f); });
+                SeekOrDie(file.get(), part.first, m_cachePath);
+                uint64_t size = HttpGetRange(url, m_url, part.first, part.second, [&](const char* data, size_t n)
+                {
+                    fwriteOrDie(data, 1, n, file.get());
+                });
+                if (size != m_size)
+                    RuntimeError("RemoteFile: '%s' changed its size from %" PRIu64 " to %" PRIu64 " bytes.", m_url.c_str(), m_size, size);
+                fflushOrDie(file.get());
+            });
+
+            lock_guard<mutex> lock(m_rangesMutex);
+            AddCachedRange(part.first, part.second);
+            uint64_t range[2] = { part.first, part.second };
+            fwriteOrDie(range, sizeof(range), 1, m_rangesFile.get());
+            fflushOrDie(m_rangesFile.get());
+            m_bytesDownloaded += part.second - part.first;
+        }));
+    }
+
+    // all downloads finish before the first error is passed on, as they refer to this object
+    exception_ptr error;
+    for (auto& download : downloads)
+    {
+        try
+        {
+            download.get();
+        }
+        catch (...)
+        {
+            if (!error)
+                error = current_exception();
+        }
+    }
+    if (error)
+        rethrow_exception(error);
+
+    if (m_verbose)
+        fprintf(stderr, "RemoteFile: downloaded %" PRIu64 " bytes at %" PRIu64 " in %d requests.\n", missing, offset, (int)parts.size());
+}
+
+}}}
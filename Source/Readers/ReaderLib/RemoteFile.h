@@ -0,0 +1,65 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A file on an HTTP server, e.g. a blob in Azure Storage or an object in S3 with a SAS or pre-signed URL, that is
+// read through a local cache file, so that training can start without copying the corpus to local disks first.
+// A deserializer calls Fetch() for the ranges it is about to read, typically whole chunks as given by its index,
+// and then reads them from the cache file as from a local file. The missing parts of a range are downloaded with
+// up to numConnections range requests in parallel, which is what it takes to reach the bandwidth of the network.
+// The cached ranges are recorded next to the cache file, so that later runs only download what is still missing;
+// a file of another size at the same URL invalidates the cache.
+// Only plain HTTP/1.1 is spoken (no TLS, no redirects); https URLs are rejected.
+class RemoteFile
+{
+public:
+    // Whether the path is a URL rather than a local file.
+    static bool IsRemote(const std::wstring& path);
+
+    // The temporary directory of the system, the default for the cache.
+    static std::wstring DefaultCacheDirectory();
+
+    RemoteFile(const std::wstring& url, const std::wstring& cacheDirectory, size_t numConnections = 8, bool verbose = false);
+
+    uint64_t Size() const { return m_size; }
+
+    // The local file, of the size of the remote one, whose contents are valid in the ranges that were fetched.
+    const std::wstring& CachePath() const { return m_cachePath; }
+
+    // Downloads the parts of [offset, offset + size) that are not in the cache yet. Thread-safe.
+    void Fetch(uint64_t offset, uint64_t size);
+
+    // The number of bytes downloaded so far.
+    uint64_t BytesDownloaded() const { return m_bytesDownloaded; }
+
+private:
+    void LoadCachedRanges();
+    void AddCachedRange(uint64_t begin, uint64_t end);
+
+    std::string m_url;
+    std::wstring m_cachePath;
+    std::wstring m_rangesPath;
+    size_t m_numConnections;
+    bool m_verbose;
+    uint64_t m_size;
+    uint64_t m_bytesDownloaded;
+
+    std::mutex m_fetchMutex;                   // one Fetch() at a time, each with its parallel requests
+    std::mutex m_rangesMutex;
+    std::map<uint64_t, uint64_t> m_cachedRanges; // begin -> end, disjoint and not adjacent
+    std::shared_ptr<FILE> m_rangesFile;
+};
+
+}}}
@@ -0,0 +1,109 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "SequenceBucketer.h"
+#include "RandomOrdering.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+SequenceBucketer::SequenceBucketer(SequenceEnumeratorPtr sequenceProvider, size_t poolSize)
+    : m_sequenceProvider(sequenceProvider),
+      m_poolSize(poolSize),
+      m_poolStartSamplePosition(0)
+{
+    assert(m_sequenceProvider != nullptr);
+    if (m_poolSize == 0)
+        InvalidArgument("SequenceBucketer: the pool must hold at least one minibatch.");
+}
+
+void SequenceBucketer::StartEpoch(const EpochConfiguration& config)
+{
+    m_buckets.clear();
+    m_sequenceProvider->StartEpoch(config);
+}
+
+void SequenceBucketer::SetConfiguration(const ReaderConfiguration& config)
+{
+    m_sequenceProvider->SetConfiguration(config);
+}
+
+void SequenceBucketer::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    m_buckets.clear();
+    m_sequenceProvider->SetCurrentSamplePosition(currentSamplePosition);
+}
+
+size_t SequenceBucketer::GetCurrentSamplePosition()
+{
+    return m_buckets.empty() ? m_sequenceProvider->GetCurrentSamplePosition() : m_poolStartSamplePosition;
+}
+
+Sequences SequenceBucketer::GetNextSequences(size_t globalSampleCount, size_t localSampleCount)
+{
+    if (m_buckets.empty())
+        FillPool(globalSampleCount, localSampleCount);
+
+    assert(!m_buckets.empty());
+    Sequences result = std::move(m_buckets.front());
+    m_buckets.pop_front();
+    return result;
+}
+
+void SequenceBucketer::FillPool(size_t globalSampleCount, size_t localSampleCount)
+{
+    m_poolStartSamplePosition = m_sequenceProvider->GetCurrentSamplePosition();
+
+    // The pool is read with a single call: the data of sequences is only valid until the next call, which can release
+    // their chunks.
+    Sequences pool = m_sequenceProvider->GetNextSequences(globalSampleCount * m_poolSize, localSampleCount * m_poolSize);
+    if (pool.m_data.empty() || pool.m_data.front().empty())
+    {
+        // e.g. no sequences for this worker in distributed mode
+        m_buckets.push_back(std::move(pool));
+        return;
+    }
+
+    // The length of a sequence is that of its longest stream.
+    std::vector<size_t> lengths(pool.m_data.front().size(), 0);
+    for (const auto& stream : pool.m_data)
+        for (size_t i = 0; i < lengths.size(); ++i)
+            lengths[i] = std::max(lengths[i], (size_t)stream[i]->m_numberOfSamples);
+
+    // Sorting by length, stable to be reproducible across platforms.
+    std::vector<size_t> order(lengths.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return lengths[a] < lengths[b]; });
+
+    // Cutting into buckets of up to localSampleCount samples, each with at least one sequence.
+    for (size_t next = 0; next < order.size();)
+    {
+        Sequences bucket;
+        bucket.m_data.resize(pool.m_data.size());
+        size_t numberOfSamples = 0;
+        do
+        {
+            numberOfSamples += lengths[order[next]];
+            for (size_t s = 0; s < pool.m_data.size(); ++s)
+                bucket.m_data[s].push_back(std::move(pool.m_data[s][order[next]]));
+            ++next;
+        } while (next < order.size() && numberOfSamples + lengths[order[next]] <= localSampleCount);
+        m_buckets.push_back(std::move(bucket));
+    }
+
+    // Seeding with the pool position, so that reading the pool again after repositioning returns the same buckets.
+    std::mt19937_64 rng(m_poolStartSamplePosition);
+    RandomShuffleMT(m_buckets, rng);
+
+    // The end of sweep or epoch is reported with the last bucket.
+    m_buckets.back().m_endOfSweep = pool.m_endOfSweep;
+    m_buckets.back().m_endOfEpoch = pool.m_endOfEpoch;
+}
+
+}}}
@@ -0,0 +1,60 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include "SequenceEnumerator.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Groups randomized sequences by length, so that the sequence packer puts sequences of similar length into the same
+// minibatch and the parallel sequences of its MBLayout need less padding (gap frames).
+// The bucketer reads the sequences of the next 'poolSize' minibatches at once from the underlying enumerator (usually
+// the randomizer), sorts them by length and cuts them into buckets of up to the sample count requested by the packer.
+// The buckets are returned one per GetNextSequences() call, in random order, before the pool is read again.
+// Randomness is kept at the level of buckets: which sequences meet in a pool, and the order of the buckets, are random,
+// but the sequences of a bucket are of similar length.
+//
+// The reported sample position is that of the start of the current pool until all of its buckets are returned.
+// Repositioning (e.g. when restoring from a checkpoint) drops the remaining buckets and reads the pool again.
+class SequenceBucketer : public SequenceEnumerator
+{
+public:
+    SequenceBucketer(SequenceEnumeratorPtr sequenceProvider, size_t poolSize);
+
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_sequenceProvider->GetStreamDescriptions();
+    }
+
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+    virtual void SetConfiguration(const ReaderConfiguration& config) override;
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+    virtual size_t GetCurrentSamplePosition() override;
+    virtual Sequences GetNextSequences(size_t globalSampleCount, size_t localSampleCount) override;
+
+    virtual double GetChunkLoadStallTime() override
+    {
+        return m_sequenceProvider->GetChunkLoadStallTime();
+    }
+
+    virtual double GetTransformTime() override
+    {
+        return m_sequenceProvider->GetTransformTime();
+    }
+
+private:
+    // Reads the next pool from the underlying enumerator and cuts it into m_buckets.
+    void FillPool(size_t globalSampleCount, size_t localSampleCount);
+
+    SequenceEnumeratorPtr m_sequenceProvider;
+    size_t m_poolSize;                 // in minibatches
+    std::deque<Sequences> m_buckets;   // not yet returned buckets of the current pool, in the order to return
+    size_t m_poolStartSamplePosition;  // position of the underlying enumerator before reading the current pool
+};
+
+}}}
@@ -59,6 +59,12 @@ public:
     // Returns current position in the global timeline. The returned value is in samples.
     virtual size_t GetCurrentSamplePosition() = 0;
 
+    // Returns the total time spent waiting for chunks to be loaded from the deserializer, in seconds.
+    virtual double GetChunkLoadStallTime() { return 0; }
+
+    // Returns the total time spent applying transforms to sequences, in seconds.
+    virtual double GetTransformTime() { return 0; }
+
     virtual ~SequenceEnumerator()
     {
     }
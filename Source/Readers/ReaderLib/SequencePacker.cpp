@@ -6,7 +6,7 @@
 #define _CRT_SECURE_NO_WARNINGS
 #define _SCL_SECURE_NO_WARNINGS
 
-#include <numeric>
+#include <algorithm>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include "SequencePacker.h"
@@ -38,7 +38,7 @@ MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
 
 Minibatch SequencePacker::ReadMinibatch()
 {
-    auto sequences = m_sequenceEnumerator->GetNextSequences(m_globalMinibatchSizeInSamples, m_localMinibatchSizeInSamples);
+    auto sequences = GetNextSequences(m_globalMinibatchSizeInSamples, m_localMinibatchSizeInSamples);
     const auto& batch = sequences.m_data;
 
     Minibatch minibatch(sequences.m_endOfSweep, sequences.m_endOfEpoch);
@@ -212,8 +212,7 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     size_t nnzCount = 0;
     for (const auto& sequence : batch)
     {
-        SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
-        nnzCount += sparseSequence->m_totalNnzCount;
+        nnzCount += static_cast<const SparseSequenceData&>(*sequence).m_totalNnzCount;
     }
 
     if (nnzCount > numeric_limits<IndexType>::max())
@@ -227,6 +226,7 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     auto elementSize = GetSizeByType(stream->m_elementType);
     auto indexSize = sizeof(IndexType);
     auto pMBLayout = CreateMBLayout(batch);
+    size_t numColumns = pMBLayout->GetNumCols();
 
     // Compute the required buffer size:
     // size of nnz type + nnz * (size of the element type) + nnz * (size of the row index type) + 
@@ -234,106 +234,86 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     size_t requiredSize =
         sizeof(nnzCount) +
         nnzCount * (elementSize + indexSize) +
-        indexSize * (pMBLayout->GetNumCols() + 1);
+        indexSize * (numColumns + 1);
 
     auto& buffer = m_streamBuffers[m_currentBufferIndex][streamIndex];
     if (buffer.m_size < requiredSize)
     {
-        buffer.Resize(requiredSize);
+        // The nnz count varies from minibatch to minibatch, leave some room so that the
+        // (possibly page-locked) buffer is not reallocated each time it grows a little.
+        buffer.Resize(requiredSize + requiredSize / 4);
     }
 
     auto* destination = buffer.m_data.get();
     // insert the nnzCount as the first element in the buffer.
     memcpy(destination, &nnzCount, sizeof(nnzCount));
 
-    // create two pointers to the memory blocks inside the buffer,
-    // one for data portion and another -- for indices.
+    // create pointers to the memory blocks inside the buffer: for the data portion,
+    // for the row indices and for the column offsets (which are computed in place).
     auto* dataDst = destination + sizeof(nnzCount);
-    auto* indicesDst = dataDst + elementSize* nnzCount;
-    // column index for the current sample (= number of nnz value packed so far).
-    IndexType columnOffset = 0;
-    // a vector to store column index for each sample in the resulting (packed) matrix.
-    vector<IndexType> sparseColumnIndices;
-    // a vector to keep track of the offsets into each input sequence,
-    // there an offset is the number of nnz values packed so far. Current sample
-    // values/indices start of the offset position in the sequence data/index array
-    vector<IndexType>  sequenceOffsets(batch.size(), 0); 
-
-    vector<MBLayout::SequenceInfo> sequenceInfos(pMBLayout->GetAllSequences());
-
-    // sort the vector in ascending order of the parallel sequence index.
-    sort(sequenceInfos.begin(), sequenceInfos.end(),
-        [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b){ return a.s < b.s; });
-
-    // Iterate over the all time steps in the layout (total number of samples/columns 
-    // in a parallel sequence), traversing the layout in horizontal direction.
-    for (auto timeStep = 0; timeStep < pMBLayout->GetNumTimeSteps(); ++timeStep)
-    {
-        // For each time step, iterate over all sequences in the minibatch,
-        // traversing the layout in vertical direction.
-        for (const auto& sequenceInfo : sequenceInfos)
-        {
-            // skip the sequence if it does not intersect with the time step
-            if (timeStep < sequenceInfo.tBegin || timeStep >= sequenceInfo.tEnd)
-            {
-                continue;
-            }
-
-            // store the offset of the current column )...
-            sparseColumnIndices.push_back(columnOffset);
+    auto* indicesDst = dataDst + elementSize * nnzCount;
+    auto* columnOffsets = reinterpret_cast<IndexType*>(indicesDst + indexSize * nnzCount);
+    // verify that there's enough space in the buffer for the array of column offsets.
+    assert(reinterpret_cast<char*>(columnOffsets + numColumns + 1) <= destination + requiredSize);
 
-            auto seqId = sequenceInfo.seqId;
-            if (seqId == GAP_SEQUENCE_ID)
-            {
-                continue;
-            }
+    const auto& sequenceInfos = pMBLayout->GetAllSequences();
+    const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
 
-            // compute the index of the sample inside the sequence.
-            size_t sampleIndex = timeStep - sequenceInfo.tBegin;
-            const auto& sequence = batch[seqId];
+    // First pass: store the nnz count of each sample at the position following its column
+    // (columns of gaps stay empty), the running sum then turns these into the column offsets.
+    std::fill(columnOffsets, columnOffsets + numColumns + 1, 0);
+    for (const auto& sequenceInfo : sequenceInfos)
+    {
+        if (sequenceInfo.seqId == GAP_SEQUENCE_ID)
+        {
+            continue;
+        }
 
-            // make sure the index less than the sequence length in samples.
-            assert(sampleIndex < sequence->m_numberOfSamples);
+        const auto& sparseSequence = static_cast<const SparseSequenceData&>(*batch[sequenceInfo.seqId]);
+        // make sure that the sequence meta-data is correct.
+        assert(sparseSequence.m_numberOfSamples == sparseSequence.m_nnzCounts.size());
+        size_t column = pMBLayout->GetColumnIndex(sequenceInfo, 0);
+        for (size_t sampleIndex = 0; sampleIndex < sparseSequence.m_numberOfSamples; ++sampleIndex, column += numParallelSequences)
+        {
+            columnOffsets[column + 1] = sparseSequence.m_nnzCounts[sampleIndex];
+        }
+    }
 
-            auto& sequenceOffset = sequenceOffsets[seqId];
-            SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
-            IndexType nnz = sparseSequence->m_nnzCounts[sampleIndex];
+    for (size_t column = 0; column < numColumns; ++column)
+    {
+        columnOffsets[column + 1] += columnOffsets[column];
+    }
 
-            // compute the sample offset in bytes.
-            size_t sampleOffset = sequenceOffset * elementSize;
-            // copy all nzz values from source sequence into the buffer.
-            const auto* dataSrc = reinterpret_cast<const char*>(sequence->GetDataBuffer()) + sampleOffset;
-            memcpy(dataDst, dataSrc, nnz * elementSize);
-            dataDst += nnz * elementSize; // advance the destination pointer
+    // after the running sum the last column offset must be equal to the total nnz count.
+    assert(columnOffsets[numColumns] == nnzCount);
 
-            // copy all nzz value indices from source sequence into the buffer.
-            const auto* indicesSrc = sparseSequence->m_indices + sequenceOffset;
-            memcpy(indicesDst, indicesSrc, nnz * indexSize);
-            indicesDst += nnz * indexSize; // advance the destination pointer
+    // Second pass: copy the values and the row indices of each sample to the offset of its column,
+    // walking each source sequence front to back.
+    for (const auto& sequenceInfo : sequenceInfos)
+    {
+        if (sequenceInfo.seqId == GAP_SEQUENCE_ID)
+        {
+            continue;
+        }
 
-            sequenceOffset += nnz;
-            columnOffset += nnz;
+        const auto& sequence = batch[sequenceInfo.seqId];
+        const auto& sparseSequence = static_cast<const SparseSequenceData&>(*sequence);
+        const auto* dataSrc = reinterpret_cast<const char*>(sequence->GetDataBuffer());
+        const auto* indicesSrc = sparseSequence.m_indices;
+        size_t column = pMBLayout->GetColumnIndex(sequenceInfo, 0);
+        for (size_t sampleIndex = 0; sampleIndex < sparseSequence.m_numberOfSamples; ++sampleIndex, column += numParallelSequences)
+        {
+            size_t nnz = sparseSequence.m_nnzCounts[sampleIndex];
+            size_t columnOffset = columnOffsets[column];
+            memcpy(dataDst + columnOffset * elementSize, dataSrc, nnz * elementSize);
+            memcpy(indicesDst + columnOffset * indexSize, indicesSrc, nnz * indexSize);
+            dataSrc += nnz * elementSize;
+            indicesSrc += nnz;
         }
-    }
 
-    // at this point each element in sequenceOffsets should be equal to the total
-    // nnz count of the respective sequence and the sum of all elements - to the 
-    // overall nnz count.
-    assert(accumulate(sequenceOffsets.begin(), sequenceOffsets.end(), 0) == nnzCount);
-
-    // check the distance between data and index destination pointers.
-    assert(indicesDst == dataDst + nnzCount * indexSize);
-    // after we packed all samples, the column offset must be equal to the total nnz count.
-    assert(columnOffset == nnzCount);
-    sparseColumnIndices.push_back(columnOffset);
-    // check that the number of column indices == N + 1 (where N is the number of
-    // column in the packed matrix)
-    assert((pMBLayout->GetNumCols() + 1) == sparseColumnIndices.size());
-
-    // verify that there's enough space in the buffer for the array of column indices.
-    assert(indicesDst + sparseColumnIndices.size()*indexSize <= destination + requiredSize);
-    // copy column indices into the buffer.
-    memcpy(indicesDst, sparseColumnIndices.data(), sparseColumnIndices.size() * indexSize);
+        // the offset into the sequence must be equal to its total nnz count.
+        assert(indicesSrc == sparseSequence.m_indices + sparseSequence.m_totalNnzCount);
+    }
 
     return pMBLayout;
 }
@@ -0,0 +1,146 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A bounded lock-free queue between exactly one producer thread and one consumer thread.
+// TryPush() and TryPop() only touch two atomic indices, so handing an item over costs no lock.
+// Push() and Pop() block while the ring is full or empty: only then a thread parks on a condition
+// variable, and the other side takes the mutex to wake it only if someone is parked.
+// Close() releases the blocked threads, e.g. to stop a producer that waits for space.
+template <class T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity)
+        : m_items(capacity + 1), m_head(0), m_tail(0), m_closed(false), m_numWaiting(0)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t Capacity() const
+    {
+        return m_items.size() - 1;
+    }
+
+    // Number of items in the ring, exact only when called by the producer or the consumer.
+    size_t Size() const
+    {
+        size_t head = m_head.load(std::memory_order_acquire);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        return (tail + m_items.size() - head) % m_items.size();
+    }
+
+    // Producer only. Returns false if the ring is full.
+    bool TryPush(T&& item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % m_items.size();
+        if (next == m_head.load(std::memory_order_acquire))
+            return false;
+
+        m_items[tail] = std::move(item);
+        m_tail.store(next, std::memory_order_release);
+        WakeWaiting();
+        return true;
+    }
+
+    // Consumer only. Returns false if the ring is empty.
+    bool TryPop(T& item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        item = std::move(m_items[head]);
+        m_head.store((head + 1) % m_items.size(), std::memory_order_release);
+        WakeWaiting();
+        return true;
+    }
+
+    // Producer only. Waits while the ring is full; returns false if it is closed.
+    bool Push(T&& item)
+    {
+        return Wait([&]() { return !IsFull(); }, [&]() { return TryPush(std::move(item)); });
+    }
+
+    // Consumer only. Waits while the ring is empty; returns false if it is closed.
+    bool Pop(T& item)
+    {
+        return Wait([&]() { return !IsEmpty(); }, [&]() { return TryPop(item); });
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_changed.notify_all();
+    }
+
+    bool IsClosed() const
+    {
+        return m_closed.load();
+    }
+
+private:
+    bool IsFull() const
+    {
+        return (m_tail.load(std::memory_order_acquire) + 1) % m_items.size() == m_head.load(std::memory_order_acquire);
+    }
+
+    bool IsEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    template <class Ready, class Operation>
+    bool Wait(Ready ready, Operation operation)
+    {
+        while (!m_closed.load())
+        {
+            if (operation())
+                return true;
+
+            // The count is raised before checking again and read by the other side after it moved its index,
+            // so that either this thread sees the change or the other side sees it waiting.
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_numWaiting++;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            m_changed.wait(lock, [&]() { return m_closed.load() || ready(); });
+            m_numWaiting--;
+        }
+        return false;
+    }
+
+    void WakeWaiting()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_numWaiting.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_changed.notify_all();
+        }
+    }
+
+    std::vector<T> m_items; // one more than the capacity, so that a full ring can be told from an empty one
+    std::atomic<size_t> m_head; // next item to pop, moved only by the consumer
+    std::atomic<size_t> m_tail; // next item to push, moved only by the producer
+
+    std::atomic<bool> m_closed;
+    std::atomic<int> m_numWaiting;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+};
+
+}}}
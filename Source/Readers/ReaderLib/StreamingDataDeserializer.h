@@ -0,0 +1,35 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "DataDeserializer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Interface of data deserializers over input of unknown size, e.g. a pipe, stdin or a file that is
+// still being appended to. As opposed to IDataDeserializer, the chunks cannot be enumerated up front:
+// they are discovered one by one, in the order of the input, and each chunk is handed out only once.
+// Only the chunks the consumer (see StreamingRandomizer) still holds on to are kept in memory.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+class IStreamingDataDeserializer
+{
+public:
+    // Gets stream descriptions for all streams this deserializer exposes.
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const = 0;
+
+    // Reads the next chunk of the input, blocking until enough input is available.
+    // Fills 'descriptions' with the sequences of the chunk (in the order of the input), their m_indexInChunk
+    // can be passed to Chunk::GetSequence() of the returned chunk.
+    // Returns nullptr at the end of the input.
+    virtual ChunkPtr GetNextChunk(std::vector<SequenceDescription>& descriptions) = 0;
+
+    virtual ~IStreamingDataDeserializer() {};
+};
+
+typedef std::shared_ptr<IStreamingDataDeserializer> IStreamingDataDeserializerPtr;
+
+}}}
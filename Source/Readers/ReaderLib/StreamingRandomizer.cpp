@@ -0,0 +1,197 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+
+#include "StreamingRandomizer.h"
+#include "DataReader.h"
+#include "ExceptionCapture.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+StreamingRandomizer::StreamingRandomizer(IStreamingDataDeserializerPtr deserializer, size_t randomizationWindowInSamples,
+                                         bool multithreadedGetNextSequences, size_t maxNumberOfInvalidSequences)
+    : m_deserializer(deserializer),
+      m_multithreadedGetNextSequences(multithreadedGetNextSequences),
+      m_windowSizeInSamples(randomizationWindowInSamples),
+      m_numberOfSamplesInWindow(0),
+      m_numberOfChunksRead(0),
+      m_endOfInput(false),
+      m_globalSamplePosition(0),
+      m_warnedAboutPosition(false),
+      m_rng(0),
+      m_cleaner(maxNumberOfInvalidSequences)
+{
+    assert(deserializer != nullptr);
+    m_streams = m_deserializer->GetStreamDescriptions();
+    m_config.m_numberOfWorkers = 1;
+    m_config.m_workerRank = 0;
+}
+
+void StreamingRandomizer::StartEpoch(const EpochConfiguration& config)
+{
+    m_config = config;
+
+    // The size of the input is unknown, an epoch of a number of sweeps lasts until the end of the input.
+    if (config.m_totalEpochSizeInSweeps != g_infinity || m_config.m_totalEpochSizeInSamples == requestDataSize)
+    {
+        m_config.m_totalEpochSizeInSamples = requestDataSize;
+        return;
+    }
+
+    SetCurrentSamplePosition(m_config.m_totalEpochSizeInSamples * config.m_epochIndex);
+}
+
+bool StreamingRandomizer::FillWindow()
+{
+    while (!m_endOfInput && (m_window.empty() || m_numberOfSamplesInWindow < m_windowSizeInSamples))
+    {
+        m_chunkSequences.clear();
+        auto chunk = m_deserializer->GetNextChunk(m_chunkSequences);
+        if (!chunk)
+        {
+            m_endOfInput = true;
+            break;
+        }
+
+        if (m_numberOfChunksRead++ % m_config.m_numberOfWorkers != m_config.m_workerRank)
+            continue;
+
+        for (const auto& sequence : m_chunkSequences)
+        {
+            m_window.push_back(WindowEntry{ chunk, sequence });
+            m_numberOfSamplesInWindow += sequence.m_numberOfSamples;
+        }
+    }
+
+    return !m_window.empty();
+}
+
+void StreamingRandomizer::SelectNextSequence()
+{
+    assert(!m_window.empty());
+    if (m_windowSizeInSamples == 0)
+        return;
+
+    size_t index = std::uniform_int_distribution<size_t>(0, m_window.size() - 1)(m_rng);
+    if (index != 0)
+        std::swap(m_window[index], m_window.front());
+}
+
+size_t StreamingRandomizer::GetCurrentSamplePosition()
+{
+    return m_globalSamplePosition;
+}
+
+Sequences StreamingRandomizer::GetNextSequences(size_t globalSampleCount, size_t localSampleCount)
+{
+    if (globalSampleCount == 0)
+        LogicError("Global sample count must not be zero.");
+
+    if (localSampleCount == 0)
+        LogicError("Local sample count must not be zero.");
+
+    Sequences result;
+    size_t endOfEpochPosition = m_config.m_totalEpochSizeInSamples == requestDataSize ?
+        SIZE_MAX : m_config.m_totalEpochSizeInSamples * (m_config.m_epochIndex + 1);
+    if (m_globalSamplePosition >= endOfEpochPosition || (m_endOfInput && m_window.empty()))
+    {
+        result.m_endOfEpoch = true;
+        result.m_endOfSweep = m_endOfInput && m_window.empty();
+        return result;
+    }
+
+    // Check we do not go over epoch.
+    globalSampleCount = std::min(globalSampleCount, endOfEpochPosition - m_globalSamplePosition);
+
+    const size_t numberOfWorkers = m_config.m_numberOfWorkers;
+    size_t numGlobalSamplesLoaded = 0, numLocalSamplesLoaded = 0;
+    m_selectedSequences.clear();
+    while (globalSampleCount > numGlobalSamplesLoaded && localSampleCount > numLocalSamplesLoaded && FillWindow())
+    {
+        SelectNextSequence();
+        const auto& sequence = m_window.front().m_sequence;
+        size_t sequenceLength = sequence.m_numberOfSamples;
+
+        // Let's check whether we need to break because we exceeded global or local counter.
+        bool enoughData = !m_selectedSequences.empty();
+        if (enoughData && (globalSampleCount - numGlobalSamplesLoaded < sequenceLength * numberOfWorkers ||
+                           localSampleCount - numLocalSamplesLoaded < sequenceLength))
+            break;
+
+        numLocalSamplesLoaded += sequenceLength;
+        numGlobalSamplesLoaded += sequenceLength * numberOfWorkers;
+        m_numberOfSamplesInWindow -= sequenceLength;
+        m_selectedSequences.push_back(std::move(m_window.front()));
+        m_window.pop_front();
+    }
+
+    m_globalSamplePosition += numGlobalSamplesLoaded;
+
+    // The end of the input ends the sweep and the epoch.
+    bool endOfInput = m_endOfInput && m_window.empty();
+    result.m_endOfEpoch = endOfInput || m_globalSamplePosition >= endOfEpochPosition;
+    result.m_endOfSweep = endOfInput;
+
+    if (m_selectedSequences.empty())
+    {
+        return result;
+    }
+
+    result.m_data.resize(m_streams.size(), std::vector<SequenceDataPtr>(m_selectedSequences.size()));
+
+    auto process = [&](int i) -> void {
+        std::vector<SequenceDataPtr> sequence;
+        const auto& entry = m_selectedSequences[i];
+        entry.m_chunk->GetSequence(entry.m_sequence.m_indexInChunk, sequence);
+        for (int j = 0; j < m_streams.size(); ++j)
+        {
+            result.m_data[j][i] = sequence[j];
+        }
+    };
+
+    if (m_multithreadedGetNextSequences)
+    {
+        ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < m_selectedSequences.size(); ++i)
+            capture.SafeRun(process, i);
+        capture.RethrowIfHappened();
+    }
+    else
+    {
+        for (int i = 0; i < m_selectedSequences.size(); ++i)
+            process(i);
+    }
+
+    // Let go of the chunks that are no longer in the window.
+    m_selectedSequences.clear();
+
+    m_cleaner.Clean(result);
+    return result;
+}
+
+void StreamingRandomizer::SetCurrentSamplePosition(size_t samplePosition)
+{
+    if (samplePosition != m_globalSamplePosition && !m_warnedAboutPosition)
+    {
+        fprintf(stderr, "WARNING: StreamingRandomizer: cannot reposition the input to the sample %" PRIu64
+                " (currently at %" PRIu64 "), the data continues with the next input instead.\n",
+                samplePosition, m_globalSamplePosition);
+        m_warnedAboutPosition = true;
+    }
+
+    m_globalSamplePosition = samplePosition;
+}
+
+void StreamingRandomizer::SetConfiguration(const ReaderConfiguration& config)
+{
+    *((ReaderConfiguration*)&m_config) = config;
+}
+
+} } }
@@ -0,0 +1,109 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <deque>
+#include <random>
+#include <vector>
+#include "SequenceEnumerator.h"
+#include "StreamingDataDeserializer.h"
+#include "ReaderUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A randomizer over the input of a streaming deserializer (see StreamingDataDeserializer.h).
+// Since the input cannot be enumerated (or read again), sequences are randomized in a sliding window:
+// the window is filled with the sequences of the next chunks up to the given number of samples, and each
+// sequence returned is picked at random from the window, which is then topped up from the input again.
+// With a window of 0 samples the input is returned in its original order.
+// Memory is bounded by the window plus one chunk, chunks are released as soon as none of their sequences
+// are in the window any more.
+//
+// The whole input is one sweep, there is no next sweep to continue with: an epoch whose size is given in sweeps
+// (or not given at all) ends at the end of the input, as do all further epochs.
+// In distributed mode all workers read the same input and keep every numberOfWorkers-th chunk.
+// The global sample position is then estimated as the local one times the number of workers.
+class StreamingRandomizer : public SequenceEnumerator
+{
+public:
+    StreamingRandomizer(
+        IStreamingDataDeserializerPtr deserializer,
+        size_t randomizationWindowInSamples,
+        bool multithreadedGetNextSequences = false,
+        size_t maxNumberOfInvalidSequences = 0); // per worker
+
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+    virtual Sequences GetNextSequences(size_t globalSampleCount, size_t localSampleCount) override;
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_deserializer->GetStreamDescriptions();
+    }
+
+    size_t GetCurrentSamplePosition() override;
+
+    // The input cannot be repositioned, the position on the global timeline is changed
+    // but the data continues where it left off (with a warning).
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
+    void SetConfiguration(const ReaderConfiguration& config) override;
+
+private:
+    // A sequence in the randomization window together with the chunk that holds its data.
+    struct WindowEntry
+    {
+        ChunkPtr m_chunk;
+        SequenceDescription m_sequence;
+    };
+
+    // Reads new chunks until the window holds the requested number of samples.
+    // Returns false if the window is empty, i.e. all input was consumed.
+    bool FillWindow();
+
+    // Moves the next sequence to return to the front of the window.
+    void SelectNextSequence();
+
+    IStreamingDataDeserializerPtr m_deserializer;
+
+    // Whether to get sequences using multiple thread.
+    // Useful in case deserializer performs CPU intensive deserialization (e.g. decompression)
+    bool m_multithreadedGetNextSequences;
+
+    // Stream descriptions
+    std::vector<StreamDescriptionPtr> m_streams;
+
+    // Epoch configuration
+    EpochConfiguration m_config;
+
+    // Size of the sliding randomization window in samples, 0 to keep the order of the input.
+    const size_t m_windowSizeInSamples;
+
+    // Sequences read from the input but not yet returned, and the number of their samples.
+    std::deque<WindowEntry> m_window;
+    size_t m_numberOfSamplesInWindow;
+
+    // Number of chunks read from the input, used to distribute the chunks between workers.
+    size_t m_numberOfChunksRead;
+
+    // True, when the deserializer reached the end of the input.
+    bool m_endOfInput;
+
+    // Global sample position on the timeline.
+    size_t m_globalSamplePosition;
+
+    // Warn only once about positioning the input.
+    bool m_warnedAboutPosition;
+
+    std::mt19937_64 m_rng;
+
+    // Temp buffers to avoid allocations.
+    std::vector<SequenceDescription> m_chunkSequences;
+    std::vector<WindowEntry> m_selectedSequences;
+
+    // Helper class for removing invalid sequences.
+    SequenceCleaner m_cleaner;
+};
+
+}}}
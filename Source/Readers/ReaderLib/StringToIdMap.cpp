@@ -0,0 +1,83 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "StringToIdMap.h"
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <nmmintrin.h>
+#define HAS_CRC32_INSTRUCTION
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// reflected Castagnoli polynomial
+static const uint32_t s_crc32cPolynomial = 0x82F63B78;
+
+static uint32_t Crc32cSoftware(const unsigned char* data, size_t size, uint32_t crc)
+{
+    static const std::vector<uint32_t> table = []()
+    {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c >> 1) ^ (c & 1 ? s_crc32cPolynomial : 0);
+            t[i] = c;
+        }
+        return t;
+    }();
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef HAS_CRC32_INSTRUCTION
+// Only this function uses SSE4.2, the rest of the binary runs on any SSE4.1 CPU.
+#ifdef __GNUC__
+__attribute__((target("sse4.2")))
+#endif
+static uint32_t Crc32cHardware(const unsigned char* data, size_t size, uint32_t crc)
+{
+    uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t)crc64;
+    for (; size > 0; data++, size--)
+        crc = _mm_crc32_u8(crc, *data);
+    return crc;
+}
+
+static bool HasCrc32Instruction()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") != 0;
+#endif
+}
+#endif
+
+uint32_t Crc32c(const void* data, size_t size, uint32_t crc)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+#ifdef HAS_CRC32_INSTRUCTION
+    static const bool hasCrc32Instruction = HasCrc32Instruction();
+    if (hasCrc32Instruction)
+        return ~Crc32cHardware(bytes, size, ~crc);
+#endif
+    return ~Crc32cSoftware(bytes, size, ~crc);
+}
+
+}}}
@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <memory>
 #include <vector>
@@ -13,79 +16,173 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// CRC32C (Castagnoli) of a byte range, with the SSE4.2 crc32 instruction where the CPU has it.
+uint32_t Crc32c(const void* data, size_t size, uint32_t crc = 0);
+
 // This class represents a string registry pattern to share strings between different deserializers if needed.
-// It associates a unique key for a given string.
-// Currently it is implemented in-memory, but can be unloaded to external disk if needed.
+// It associates a unique key for a given string; the ids are consecutive, in the order the strings are added.
+// Corpora have up to hundreds of millions of sequence keys, so the strings are kept back to back in one array
+// (no allocation per string), and found through an open-addressing hash table of CRC32C hashes with linear probing.
+// Each string costs its characters, 8 bytes for its offset and 8 to 16 bytes of table.
 // TODO: Move this class to Basics.h when it is required by more than one reader.
 template<class TString>
 class TStringToIdMap
 {
+    typedef typename TString::value_type TChar;
+
 public:
-    TStringToIdMap()
+    TStringToIdMap() : m_offsets(1, 0)
     {}
 
+    // Makes room for as many more strings and characters, e.g. those of a file whose keys are known.
+    void Reserve(size_t numValues, size_t numChars)
+    {
+        m_chars.reserve(m_chars.size() + numChars);
+        m_offsets.reserve(m_offsets.size() + numValues);
+        if ((Size() + numValues) * 4 > m_slots.size() * 3)
+            Rehash(SlotsFor(Size() + numValues));
+    }
+
     // Adds string value to the registry.
     void AddValue(const TString& value)
     {
-        auto iter = m_values.insert(std::make_pair(value, m_indexedValues.size()));
-        m_indexedValues.push_back(&((iter.first)->first));
+        AddIfNotExists(value.data(), value.size());
     }
 
     // Tries to get a value by id.
     bool TryGet(const TString& value, size_t& id) const
     {
-        const auto& it = m_values.find(value);
-        if (it == m_values.end())
-        {
+        return TryGet(value.data(), value.size(), id);
+    }
+
+    bool TryGet(const TChar* value, size_t length, size_t& id) const
+    {
+        if (m_slots.empty())
             return false;
-        }
-        else
-        {
-            id = it->second;
-            return true;
-        }
+        const Slot& slot = m_slots[FindSlot(value, length, Hash(value, length))];
+        if (slot.m_id == s_emptySlot)
+            return false;
+        id = slot.m_id;
+        return true;
     }
 
     // Get integer id for the string value, adding if not exists.
     size_t AddIfNotExists(const TString& value)
     {
-        const auto& it = m_values.find(value);
-        if (it == m_values.end())
-        {
-            AddValue(value);
-            return m_values[value];
-        }
-        return it->second;
+        return AddIfNotExists(value.data(), value.size());
+    }
+
+    size_t AddIfNotExists(const TChar* value, size_t length)
+    {
+        if ((Size() + 1) * 4 > m_slots.size() * 3) // at most 3/4 full
+            Rehash(SlotsFor(Size() + 1));
+
+        const uint32_t hash = Hash(value, length);
+        Slot& slot = m_slots[FindSlot(value, length, hash)];
+        if (slot.m_id != s_emptySlot)
+            return slot.m_id;
+
+        if (Size() >= s_emptySlot)
+            RuntimeError("Too many distinct strings (more than %u).", (unsigned)s_emptySlot);
+        slot.m_hash = hash;
+        slot.m_id = (uint32_t)Size();
+        m_chars.insert(m_chars.end(), value, value + length);
+        m_offsets.push_back(m_chars.size());
+        return slot.m_id;
     }
 
     // Get integer id for the string value.
     size_t operator[](const TString& value) const
     {
-        const auto& it = m_values.find(value);
-        assert(it != m_values.end());
-        return it->second;
+        size_t id = 0;
+        bool found = TryGet(value, id);
+        assert(found);
+        UNUSED(found);
+        return id;
     }
 
     // Get string value by its integer id.
-    const TString& operator[](size_t id) const
+    TString operator[](size_t id) const
     {
-        if (id >= m_indexedValues.size())
+        if (id >= Size())
             RuntimeError("Unknown id requested");
-        return *m_indexedValues[id];
+        return TString(m_chars.data() + m_offsets[id], m_chars.data() + m_offsets[id + 1]);
     }
 
     // Checks whether the value exists.
     bool Contains(const TString& value) const
     {
-        return m_values.find(value) != m_values.end();
+        size_t id;
+        return TryGet(value, id);
+    }
+
+    size_t Size() const
+    {
+        return m_offsets.size() - 1;
     }
 
 private:
     // TODO: Move NonCopyable as a separate class to Basics.h
     DISABLE_COPY_AND_MOVE(TStringToIdMap);
 
-    std::map<TString, size_t> m_values;
-    std::deque<const TString*> m_indexedValues;
+    static const uint32_t s_emptySlot = UINT32_MAX;
+
+    struct Slot
+    {
+        uint32_t m_hash; // compared before the string
+        uint32_t m_id;
+    };
+
+    static uint32_t Hash(const TChar* value, size_t length)
+    {
+        return Crc32c(value, length * sizeof(TChar));
+    }
+
+    // a power of two that holds the values at most 3/4 full
+    static size_t SlotsFor(size_t numValues)
+    {
+        size_t numSlots = 16;
+        while (numValues * 4 > numSlots * 3)
+            numSlots *= 2;
+        return numSlots;
+    }
+
+    // The slot of the value, or the empty slot where it would be inserted.
+    size_t FindSlot(const TChar* value, size_t length, uint32_t hash) const
+    {
+        const size_t mask = m_slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            const Slot& slot = m_slots[i];
+            if (slot.m_id == s_emptySlot)
+                return i;
+            if (slot.m_hash == hash &&
+                m_offsets[slot.m_id + 1] - m_offsets[slot.m_id] == length &&
+                memcmp(m_chars.data() + m_offsets[slot.m_id], value, length * sizeof(TChar)) == 0)
+                return i;
+        }
+    }
+
+    // the hashes are kept in the slots, so the strings are not read again
+    void Rehash(size_t numSlots)
+    {
+        std::vector<Slot> slots(numSlots, Slot{ 0, s_emptySlot });
+        const size_t mask = numSlots - 1;
+        for (const Slot& slot : m_slots)
+        {
+            if (slot.m_id == s_emptySlot)
+                continue;
+            size_t i = slot.m_hash & mask;
+            while (slots[i].m_id != s_emptySlot)
+                i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+        m_slots.swap(slots);
+    }
+
+    std::vector<TChar> m_chars;      // the strings back to back, without terminators
+    std::vector<uint64_t> m_offsets; // string i is [m_offsets[i], m_offsets[i + 1]) of m_chars
+    std::vector<Slot> m_slots;       // a power of two of them
 };
 
 typedef TStringToIdMap<std::wstring> WStringToIdMap;
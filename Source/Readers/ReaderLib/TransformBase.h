@@ -17,7 +17,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class TransformBase : public Transformer
 {
 public:
-    explicit TransformBase(const ConfigParameters& config)
+    // Transforms that can output unsigned chars, which the network gets converted on its device
+    // (see StreamDescription::m_normalizationMean), accept the precision "uchar" if allowUChar is set.
+    explicit TransformBase(const ConfigParameters& config, bool allowUChar = false)
     {
         m_seed = config(L"seed", 0u);
         std::wstring precision = config(L"precision", L"float");
@@ -25,6 +27,8 @@ public:
             m_precision = ElementType::tfloat;
         else if (AreEqualIgnoreCase(precision, L"double"))
             m_precision = ElementType::tdouble;
+        else if (allowUChar && AreEqualIgnoreCase(precision, L"uchar"))
+            m_precision = ElementType::tuchar;
         else
             RuntimeError("Unsupported precision type is specified, '%ls'", precision.c_str());
     }
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <set>
+#include <chrono>
 
 #include "Transformer.h"
 #include "SequenceEnumerator.h"
@@ -27,7 +28,7 @@ class TransformController : public SequenceEnumerator
 {
 public:
     TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider)
-        : m_sequenceProvider(sequenceProvider)
+        : m_sequenceProvider(sequenceProvider), m_transformTime(0)
     {
         // Applying transformations to stream descriptions,
         // i.e. a transformation can change a stream from dense to sparse.
@@ -65,6 +66,16 @@ public:
         m_sequenceProvider->SetCurrentSamplePosition(currentSamplePosition);
     }
 
+    double GetChunkLoadStallTime() override
+    {
+        return m_sequenceProvider->GetChunkLoadStallTime();
+    }
+
+    double GetTransformTime() override
+    {
+        return m_transformTime + m_sequenceProvider->GetTransformTime();
+    }
+
     // Description of streams that the transformer provides.
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
@@ -82,6 +93,7 @@ public:
             return sequences;
         }
 
+        auto transformStart = std::chrono::steady_clock::now();
         ExceptionCapture capture;
 #pragma omp parallel for schedule(dynamic)
         for (int j = 0; j < sequences.m_data.front().size(); ++j)
@@ -96,6 +108,7 @@ public:
         }
 
         capture.RethrowIfHappened();
+        m_transformTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - transformStart).count();
         return sequences;
     }
 
@@ -122,6 +135,9 @@ private:
     SequenceEnumeratorPtr m_sequenceProvider;
     std::vector<StreamDescriptionPtr> m_outputStreams;
     std::vector<std::pair<Transformation, size_t>> m_transformations;
+
+    // Total time spent in the transformers, in seconds.
+    double m_transformTime;
 };
 
 }}}
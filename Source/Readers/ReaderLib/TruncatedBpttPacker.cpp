@@ -348,7 +348,7 @@ void TruncatedBPTTPacker::ReadSequencesToSlot(size_t slotIndex)
         // We need a single sequence, potentially we can request (m_truncationSize - slot.AvailableNumberOfSamples())
         // to be more efficient. In reality the truncation size usually is less the sequence size.
         // Bptt always operates on a local timeline, so we do not limit the global minibatch count.
-        const auto& sequences = m_sequenceEnumerator->GetNextSequences(SIZE_MAX, 1);
+        const auto& sequences = GetNextSequences(SIZE_MAX, 1);
 
         // assert that number of input streams == number of output streams -- 
         // this does not have to be the case in general, but the current
@@ -61,7 +61,8 @@ private:
 
     // Sequence buffer per stream.
     // Each sequence buffer contains m_parallelNumberOfSequences slots
-    // that get filled with sequences.
+    // that get filled with sequences. Slot i is parallel sequence i of every minibatch,
+    // so a sequence continues where the recurrent nodes kept its state (see DelayedValueNodeBase::EndForwardProp()).
     std::vector<SequenceBufferPtr> m_sequenceBufferPerStream;
 
     // Layout per stream.
@@ -9,6 +9,8 @@
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
 #include "UCIFastReader.h"
+#include "UCIDeserializer.h"
+#include "StringUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,4 +23,16 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
     *preader = new UCIFastReader<double>();
 }
 
+// A factory method for creating the deserializer of UCI dense text files, see UCIDeserializer.h.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool primary)
+{
+    if (type == L"UCIDeserializer")
+        *deserializer = new UCIDeserializer(corpus, deserializerConfig, primary);
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
+
 }}}
@@ -0,0 +1,391 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <chrono>
+#include <limits>
+#include <omp.h>
+#include "UCIDeserializer.h"
+#include "ExceptionCapture.h"
+#include "StringUtil.h"
+#include "File.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Chunks are split into ranges of lines of at least this many bytes for parsing in parallel,
+// smaller ones are not worth the thread overhead.
+static const size_t s_minBytesPerParseThread = 256 * 1024;
+
+// Decimal numbers with at most this many digits are exact in a double, so that a single division by
+// a power of ten gives the correctly rounded value.
+static const size_t s_maxFastPathDigits = 15;
+static const double s_powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+static inline bool IsDigit(char c)
+{
+    return '0' <= c && c <= '9';
+}
+
+// Samples of a line in a stream, pointing into the parsed values of a chunk, which they hold.
+struct UCISequenceData : DenseSequenceData
+{
+    const void* m_values;
+    ChunkPtr m_chunk;
+
+    const void* GetDataBuffer() override
+    {
+        return m_values;
+    }
+};
+
+// Parsed values of the lines of a chunk, a column per line and stream.
+class UCIDeserializer::UCIChunk : public Chunk, public std::enable_shared_from_this<UCIChunk>
+{
+public:
+    UCIChunk(const UCIDeserializer& parent, const ChunkDescriptor& descriptor)
+        : m_parent(parent), m_descriptor(descriptor)
+    {
+        auto start = chrono::steady_clock::now();
+
+        const auto& sequences = descriptor.m_sequences;
+        const auto& last = sequences.back();
+        size_t chunkBytes = last.OffsetInChunk() + last.SizeInBytes();
+        vector<char> text(chunkBytes);
+
+        auto f = fopenOrDie(parent.m_fileName, L"rbS");
+        fsetpos(f, descriptor.m_offset);
+        freadOrDie(text.data(), 1, text.size(), f);
+        fclose(f);
+
+        m_outputs.resize(parent.m_columns.size());
+        for (size_t s = 0; s < m_outputs.size(); ++s)
+            m_outputs[s].resize(sequences.size() * parent.m_columns[s].m_outputSize * parent.m_elementSize);
+
+        // split the lines into ranges of about the same size, one per thread
+        size_t numThreads = parent.m_numParseThreads > 0 ? parent.m_numParseThreads : static_cast<size_t>(omp_get_max_threads());
+        size_t numRanges = max<size_t>(1, min(min(numThreads, sequences.size()), chunkBytes / s_minBytesPerParseThread));
+        auto parseRange = [this, &text, &sequences, numRanges](int range)
+        {
+            size_t begin = sequences.size() * range / numRanges, end = sequences.size() * (range + 1) / numRanges;
+            if (m_parent.m_elementType == ElementType::tfloat)
+                m_parent.ParseLines<float>(m_descriptor, text.data(), begin, end, m_outputs);
+            else
+                m_parent.ParseLines<double>(m_descriptor, text.data(), begin, end, m_outputs);
+        };
+
+        if (numRanges == 1)
+            parseRange(0);
+        else
+        {
+            ExceptionCapture capture;
+#pragma omp parallel for schedule(static, 1) num_threads(static_cast<int>(numRanges))
+            for (int range = 0; range < static_cast<int>(numRanges); ++range)
+                capture.SafeRun(parseRange, range);
+            capture.RethrowIfHappened();
+        }
+
+        auto microseconds = (size_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        size_t parsedBytes = parent.m_parsedBytes += chunkBytes;
+        size_t parseMicroseconds = parent.m_parseMicroseconds += microseconds;
+        if (parent.m_traceLevel >= 2)
+            fprintf(stderr, "UCIDeserializer: parsed chunk %u (%zu lines, %.1f MB) on %zu threads in %.3f s (%.1f MB/s over all chunks so far)\n",
+                    descriptor.m_id, sequences.size(), chunkBytes / 1e6, numRanges, microseconds / 1e6,
+                    parseMicroseconds > 0 ? parsedBytes / (double)parseMicroseconds : 0.0);
+    }
+
+    void GetSequence(size_t sequenceIndex, vector<SequenceDataPtr>& result) override
+    {
+        auto self = shared_from_this();
+        for (size_t s = 0; s < m_outputs.size(); ++s)
+        {
+            auto data = make_shared<UCISequenceData>();
+            data->m_values = m_outputs[s].data() + sequenceIndex * m_parent.m_columns[s].m_outputSize * m_parent.m_elementSize;
+            data->m_numberOfSamples = 1;
+            data->m_key = m_descriptor.m_sequences[sequenceIndex].m_key;
+            data->m_chunk = self;
+            result.push_back(data);
+        }
+    }
+
+private:
+    const UCIDeserializer& m_parent;
+    const ChunkDescriptor& m_descriptor;
+    vector<vector<char>> m_outputs; // per stream, in the element type
+};
+
+UCIDeserializer::UCIDeserializer(CorpusDescriptorPtr, const ConfigParameters& cfg, bool primary)
+    : DataDeserializerBase(primary), m_numberOfColumns(0), m_parsedBytes(0), m_parseMicroseconds(0)
+{
+    if (!primary)
+        InvalidArgument("UCIDeserializer: only supported as the primary deserializer, the lines of the file have no keys.");
+
+    string delimiter = cfg(L"customDelimiter", "");
+    m_delimiter = delimiter.empty() ? ' ' : delimiter[0];
+    string decimalPoint = cfg(L"customDecimalPoint", "");
+    m_decimalPoint = decimalPoint.empty() ? '.' : decimalPoint[0];
+    if (m_delimiter == m_decimalPoint)
+        InvalidArgument("UCIDeserializer: customDelimiter and customDecimalPoint must be different.");
+
+    wstring precision = cfg(L"precision", L"float");
+    if (AreEqualIgnoreCase(precision, L"float"))
+        m_elementType = ElementType::tfloat;
+    else if (AreEqualIgnoreCase(precision, L"double"))
+        m_elementType = ElementType::tdouble;
+    else
+        InvalidArgument("UCIDeserializer: unsupported precision '%ls', expected 'float' or 'double'.", precision.c_str());
+    m_elementSize = m_elementType == ElementType::tfloat ? sizeof(float) : sizeof(double);
+    m_numParseThreads = cfg(L"numParseThreads", 0);
+    m_traceLevel = cfg(L"traceLevel", 0);
+
+    // the file is given at the top or, as in the UCIFastReader, in the stream sections
+    m_fileName = (wstring)cfg(L"file", L"");
+    ConfigParameters input = cfg(L"input");
+    for (const auto& id : input.GetMemberIds())
+    {
+        ConfigParameters streamConfig = input(id);
+        wstring name = msra::strfun::utf16(id);
+        wstring labelType = streamConfig(L"labelType", L"regression"); // features are read as regression values
+        if (!AreEqualIgnoreCase(labelType, L"regression") && !AreEqualIgnoreCase(labelType, L"category") && !AreEqualIgnoreCase(labelType, L"none"))
+            InvalidArgument("UCIDeserializer: unsupported labelType '%ls' of '%ls', expected 'category', 'regression' or 'none'.", labelType.c_str(), name.c_str());
+        if (AreEqualIgnoreCase(labelType, L"none"))
+            continue;
+
+        wstring file = streamConfig(L"file", L"");
+        if (m_fileName.empty())
+            m_fileName = file;
+        else if (!file.empty() && file != m_fileName)
+            InvalidArgument("UCIDeserializer: all streams must come from the same file, '%ls' is in '%ls'.", name.c_str(), file.c_str());
+
+        ColumnRange range;
+        range.m_start = streamConfig(L"start", (size_t)0);
+        range.m_category = AreEqualIgnoreCase(labelType, L"category");
+        range.m_dimension = range.m_category ? 1 : (size_t)streamConfig(L"dim");
+        range.m_outputSize = range.m_dimension;
+        if (range.m_category)
+        {
+            if (streamConfig(L"dim", (size_t)1) != 1)
+                InvalidArgument("UCIDeserializer: the category label '%ls' must have a single column (dim = 1).", name.c_str());
+
+            vector<string> labels;
+            File::LoadLabelFile(streamConfig(L"labelMappingFile"), labels);
+            for (size_t i = 0; i < labels.size(); ++i)
+                range.m_labelToId[labels[i]] = i;
+            range.m_outputSize = max((size_t)streamConfig(L"labelDim", (size_t)0), labels.size());
+        }
+        if (range.m_dimension == 0 || range.m_outputSize == 0)
+            InvalidArgument("UCIDeserializer: the stream '%ls' is empty.", name.c_str());
+
+        for (const auto& other : m_columns)
+        {
+            if (range.m_start < other.m_start + other.m_dimension && other.m_start < range.m_start + range.m_dimension)
+                InvalidArgument("UCIDeserializer: the columns of '%ls' overlap with another stream.", name.c_str());
+        }
+        m_columns.push_back(range);
+        m_numberOfColumns = max(m_numberOfColumns, range.m_start + range.m_dimension);
+
+        auto stream = make_shared<StreamDescription>();
+        stream->m_id = m_streams.size();
+        stream->m_name = name;
+        stream->m_sampleLayout = make_shared<TensorShape>(range.m_outputSize);
+        stream->m_storageType = StorageType::dense;
+        stream->m_elementType = m_elementType;
+        m_streams.push_back(stream);
+    }
+    if (m_streams.empty())
+        InvalidArgument("UCIDeserializer: no streams given in the input section.");
+    if (m_fileName.empty())
+        InvalidArgument("UCIDeserializer: no file given.");
+
+    size_t chunkSize = cfg(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024);
+    m_index = make_unique<Index>(chunkSize, true);
+
+    auto f = fopenOrDie(m_fileName, L"rbS");
+    BuildIndex(f);
+    fclose(f);
+}
+
+void UCIDeserializer::BuildIndex(FILE* f)
+{
+    m_index->Reserve(filesize(f));
+
+    vector<char> buffer(2 * 1024 * 1024);
+    size_t lineStart = 0, offset = 0, numLines = 0;
+    bool isEmpty = true;
+    for (;;)
+    {
+        size_t bytesRead = fread(buffer.data(), 1, buffer.size(), f);
+        bool atEnd = bytesRead == 0;
+        if (atEnd)
+        {
+            buffer[0] = '\n'; // terminate the last line
+            bytesRead = 1;
+        }
+
+        for (size_t i = 0; i < bytesRead; ++i)
+        {
+            char c = buffer[i];
+            if (c != '\n')
+            {
+                isEmpty = isEmpty && IsDelimiter(c);
+                continue;
+            }
+
+            size_t lineEnd = atEnd ? offset : offset + i + 1;
+            if (!isEmpty)
+            {
+                KeyType key;
+                key.m_sequence = numLines;
+                key.m_sample = 0;
+                m_index->AddSequence(SequenceDescriptor(key, 1), lineStart, lineEnd);
+                numLines++;
+            }
+            lineStart = lineEnd;
+            isEmpty = true;
+        }
+
+        if (atEnd)
+            break;
+        offset += bytesRead;
+    }
+
+    if (numLines == 0)
+        RuntimeError("UCIDeserializer: '%ls' has no lines.", m_fileName.c_str());
+    fprintf(stderr, "UCIDeserializer: %zu lines in %zu chunks from '%ls'\n", numLines, m_index->m_chunks.size(), m_fileName.c_str());
+}
+
+bool UCIDeserializer::ParseNumber(const char* begin, const char* end, double& value) const
+{
+    // fast path for [sign]digits[.digits]
+    const char* pos = begin;
+    bool negative = pos < end && *pos == '-';
+    if (pos < end && (*pos == '-' || *pos == '+'))
+        ++pos;
+
+    uint64_t mantissa = 0;
+    size_t digits = 0, fractionDigits = 0;
+    for (; pos < end && IsDigit(*pos); ++pos, ++digits)
+        mantissa = mantissa * 10 + (*pos - '0');
+    if (pos < end && *pos == m_decimalPoint)
+    {
+        for (++pos; pos < end && IsDigit(*pos); ++pos, ++digits, ++fractionDigits)
+            mantissa = mantissa * 10 + (*pos - '0');
+    }
+    if (pos == end && digits > 0 && digits <= s_maxFastPathDigits)
+    {
+        value = (double)mantissa / s_powersOfTen[fractionDigits];
+        if (negative)
+            value = -value;
+        return true;
+    }
+
+    // everything else (exponents, long mantissas, inf, nan) goes through strtod
+    string token(begin, end);
+    if (m_decimalPoint != '.')
+        replace(token.begin(), token.end(), m_decimalPoint, '.');
+    char* tokenEnd;
+    value = strtod(token.c_str(), &tokenEnd);
+    return tokenEnd == token.c_str() + token.size() && !token.empty();
+}
+
+template <class ElemType>
+void UCIDeserializer::ParseLines(const ChunkDescriptor& chunk, const char* text, size_t begin, size_t end, vector<vector<char>>& outputs) const
+{
+    // stream and position of each column needed, or -1 for the columns that are skipped
+    vector<pair<int, size_t>> targets(m_numberOfColumns, make_pair(-1, (size_t)0));
+    for (size_t s = 0; s < m_columns.size(); ++s)
+    {
+        for (size_t c = 0; c < m_columns[s].m_dimension; ++c)
+            targets[m_columns[s].m_start + c] = make_pair((int)s, c);
+    }
+
+    vector<ElemType*> columns(outputs.size());
+    for (size_t i = begin; i < end; ++i)
+    {
+        const auto& sequence = chunk.m_sequences[i];
+        for (size_t s = 0; s < outputs.size(); ++s)
+            columns[s] = reinterpret_cast<ElemType*>(outputs[s].data()) + i * m_columns[s].m_outputSize;
+
+        const char* pos = text + sequence.OffsetInChunk();
+        const char* lineEnd = pos + sequence.SizeInBytes();
+        size_t column = 0;
+        while (column < m_numberOfColumns)
+        {
+            while (pos < lineEnd && IsDelimiter(*pos))
+                ++pos;
+            if (pos == lineEnd || *pos == '\n')
+                RuntimeError("UCIDeserializer: sample %zu of '%ls' has %zu columns, expected at least %zu.",
+                             (size_t)sequence.m_key.m_sequence + 1, m_fileName.c_str(), column, m_numberOfColumns);
+            const char* token = pos;
+            while (pos < lineEnd && *pos != '\n' && !IsDelimiter(*pos))
+                ++pos;
+
+            const auto& target = targets[column++];
+            if (target.first < 0)
+                continue;
+
+            const auto& range = m_columns[target.first];
+            if (range.m_category)
+            {
+                auto label = range.m_labelToId.find(string(token, pos));
+                if (label == range.m_labelToId.end())
+                    RuntimeError("UCIDeserializer: the label '%s' in sample %zu of '%ls' is not in the label mapping file.",
+                                 string(token, pos).c_str(), (size_t)sequence.m_key.m_sequence + 1, m_fileName.c_str());
+                columns[target.first][label->second] = 1; // the outputs are zero-initialized
+                continue;
+            }
+
+            double value;
+            if (!ParseNumber(token, pos, value))
+                RuntimeError("UCIDeserializer: invalid number '%s' in sample %zu of '%ls'.",
+                             string(token, pos).c_str(), (size_t)sequence.m_key.m_sequence + 1, m_fileName.c_str());
+            columns[target.first][target.second] = (ElemType)value;
+        }
+    }
+}
+
+ChunkDescriptions UCIDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions chunks;
+    chunks.reserve(m_index->m_chunks.size());
+    for (const auto& chunk : m_index->m_chunks)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = chunk.m_id;
+        cd->m_numberOfSamples = chunk.m_numberOfSamples;
+        cd->m_numberOfSequences = chunk.m_numberOfSequences;
+        chunks.push_back(cd);
+    }
+    return chunks;
+}
+
+void UCIDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_index->m_chunks[chunkId];
+    result.reserve(chunk.m_sequences.size());
+    for (size_t i = 0; i < chunk.m_sequences.size(); ++i)
+    {
+        SequenceDescription s;
+        s.m_chunkId = chunkId;
+        s.m_key = chunk.m_sequences[i].m_key;
+        s.m_indexInChunk = i;
+        s.m_numberOfSamples = 1;
+        result.push_back(s);
+    }
+}
+
+ChunkPtr UCIDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    ChunkPtr result;
+    attempt(5, [this, &result, chunkId]()
+    {
+        result = make_shared<UCIChunk>(*this, m_index->m_chunks[chunkId]);
+    });
+    return result;
+}
+
+}}}
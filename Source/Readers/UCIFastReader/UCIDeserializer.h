@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <map>
+#include <atomic>
+#include <boost/noncopyable.hpp>
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+#include "Indexer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer for the dense text files of the UCIFastReader (one sample per line, columns separated by whitespace
+// or a custom delimiter), so that these jobs get the indexed chunks, randomization and prefetch of the ReaderShim
+// pipeline. The lines of a chunk are parsed on several threads, with a fast path for plain decimal numbers.
+// The streams take the column ranges of the UCIFastReader config, so existing configs migrate by moving their
+// feature and label sections into the input section:
+//  - features, and labels with labelType "regression": the values of dim columns from column start (0-based);
+//  - labels with labelType "category": the label in column start is mapped by the labelMappingFile (one label
+//    per line) to a one-hot vector of labelDim (default: the number of labels) elements;
+//  - streams with labelType "none" are skipped.
+// Empty lines are skipped, so samples are numbered by the non-empty lines.
+// E.g. deserializers = ([ type = "UCIDeserializer" ; module = "UCIFastReader" ; file = "Train-28x28.txt"
+//                         input = [ features = [ start = 1 ; dim = 784 ]
+//                                   labels = [ start = 0 ; dim = 1 ; labelType = "category" ; labelDim = 10
+//                                              labelMappingFile = "labelsmap.txt" ] ] ])
+// Other options: precision, customDelimiter, customDecimalPoint, chunkSizeInBytes, numParseThreads and traceLevel.
+class UCIDeserializer : public DataDeserializerBase, boost::noncopyable
+{
+public:
+    UCIDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& s) override;
+
+    // Retrieves a chunk with data.
+    virtual ChunkPtr GetChunk(ChunkIdType) override;
+
+private:
+    class UCIChunk;
+
+    // Columns of a stream.
+    struct ColumnRange
+    {
+        size_t m_start;
+        size_t m_dimension;   // number of columns
+        bool m_category;      // a single column with a label, mapped to a one-hot vector
+        size_t m_outputSize;  // number of elements per sample
+        std::map<std::string, size_t> m_labelToId; // category labels only
+    };
+
+    // Builds the index of the non-empty lines, without parsing them.
+    void BuildIndex(FILE* file);
+
+    // Parses the lines [begin, end) of a chunk from its text.
+    template <class ElemType>
+    void ParseLines(const ChunkDescriptor& chunk, const char* text, size_t begin, size_t end, std::vector<std::vector<char>>& outputs) const;
+
+    // Parses a number, returns false if the token is not one.
+    bool ParseNumber(const char* begin, const char* end, double& value) const;
+
+    bool IsDelimiter(char c) const
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == m_delimiter;
+    }
+
+    std::wstring m_fileName;
+    std::unique_ptr<Index> m_index;
+
+    std::vector<ColumnRange> m_columns;
+    size_t m_numberOfColumns; // columns needed per line
+
+    char m_delimiter;
+    char m_decimalPoint;
+
+    ElementType m_elementType;
+    size_t m_elementSize;
+    unsigned int m_numParseThreads;
+    int m_traceLevel;
+
+    // parse throughput, traced at traceLevel 2
+    mutable std::atomic<size_t> m_parsedBytes;
+    mutable std::atomic<size_t> m_parseMicroseconds;
+};
+
+}}}
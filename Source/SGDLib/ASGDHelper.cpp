@@ -2,7 +2,7 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
-// ASGDHelper.cpp : Implements ASGDHelper interface. The implementation is based on Multiverso.
+// ASGDHelper.cpp : Implements ASGDHelper interface, based on Multiverso or on a parameter server built into the MPI nodes.
 //
 
 #define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
@@ -14,6 +14,7 @@
 
 #include <functional>
 #include <thread>
+#include <chrono>
 #include <unordered_map>
 #include <numeric>
 #include <algorithm>
@@ -595,6 +596,263 @@ private:
 
 #endif 
 
+// ParameterServerASGDHelper is the implementation of ASGDHelper interface without an external parameter server:
+// the model is split into one shard per MPI node, which every node exposes for one-sided access (MPIWrapper::CreateWindow()).
+// A worker pushes the change of its model since its last sync, times the learning rate decay, to all shards and gets
+// their latest content back in one atomic fetch-and-add per shard and parameter, issued for all of them before waiting
+// for any (per-shard pipelining). Parameters (or their parts in a shard) the worker did not change are only read, which
+// keeps the traffic of sparsely updated models (e.g. embeddings of which few parameters change) down.
+// Bounded staleness: a worker does not get more than maxStaleness syncs ahead of the slowest worker in the same epoch.
+template<class ElemType = float>
+class ParameterServerASGDHelper : public ASGDHelper<ElemType>
+{
+public:
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+    ParameterServerASGDHelper(const std::list<ComputationNodeBasePtr> & learnableNodes,
+        const MPIWrapperPtr& pMPI,
+        bool isSimulatedModelAveragingSGD = false,
+        AdjustLearningRateAtBeginning adjusttype = AdjustLearningRateAtBeginning::None,
+        double adjustCoef = 0.2,
+        size_t adjustPerMinibatches = 600,
+        int maxStaleness = -1,
+        int traceLevel = 0,
+        int syncPerfStats = 0) :
+        m_pMPI(pMPI), m_ModelAveragingSGDSimulating(isSimulatedModelAveragingSGD),
+        m_adjustLearningRateAtBeginningType(adjusttype), m_adjustCoefficient(adjustCoef), m_adjustMBNumber(adjustPerMinibatches),
+        m_maxStaleness(isSimulatedModelAveragingSGD ? 0 : maxStaleness), m_traceLevel(traceLevel), m_syncPerfStats(syncPerfStats),
+        m_parameterSyncCounter(0), m_epochSyncCounter(0), m_numReadOnlyPieces(0), m_numPieces(0)
+    {
+        size_t numNodes = m_pMPI->NumNodesInUse();
+        size_t myRank = m_pMPI->CurrentNodeRank();
+
+        m_totalModelSize = 0;
+        for (auto& node : learnableNodes)
+        {
+            m_tableOffsets.push_back(m_totalModelSize);
+            m_tableLength.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().GetNumElements());
+            m_totalModelSize += m_tableLength.back();
+        }
+
+        // shard r holds the elements [m_shardOffsets[r], m_shardOffsets[r + 1]) of the concatenated parameters
+        for (size_t r = 0; r <= numNodes; r++)
+            m_shardOffsets.push_back(m_totalModelSize * r / numNodes);
+
+        // the parts of the parameters in each shard
+        for (size_t i = 0; i < m_tableLength.size(); i++)
+        {
+            for (size_t r = 0; r < numNodes; r++)
+            {
+                size_t begin = max(m_tableOffsets[i], m_shardOffsets[r]);
+                size_t end = min(m_tableOffsets[i] + m_tableLength[i], m_shardOffsets[r + 1]);
+                if (begin < end)
+                    m_pieces.push_back(Piece{ begin, end - begin, r, begin - m_shardOffsets[r] });
+            }
+        }
+
+        m_shard.resize(m_shardOffsets[myRank + 1] - m_shardOffsets[myRank]);
+        m_model.resize(m_totalModelSize);
+        m_delta.resize(m_totalModelSize);
+        m_modelWindow = m_pMPI->CreateWindow(m_shard.data(), m_shard.size());
+
+        // per worker, at the main node: the number of epochs it started and of its syncs in the current one
+        m_clocks.resize(m_pMPI->IsMainNode() ? 2 * numNodes : 0);
+        m_clockWindow = m_pMPI->CreateWindow(m_clocks.data(), m_clocks.size());
+    }
+
+    ~ParameterServerASGDHelper()
+    {
+        m_pMPI->FreeWindow(m_clockWindow);
+        m_pMPI->FreeWindow(m_modelWindow);
+    }
+
+    void InitModel(const std::list<ComputationNodeBasePtr> & learnableNodes) override
+    {
+        // all workers start from the same model, each node serves its shard of it
+        CopyModelToCPU(learnableNodes, m_model.data());
+        size_t myRank = m_pMPI->CurrentNodeRank();
+        std::copy(m_model.begin() + m_shardOffsets[myRank], m_model.begin() + m_shardOffsets[myRank + 1], m_shard.begin());
+        m_pMPI->WaitAll();
+
+        fprintf(stderr, "ParameterServerASGDHelper: %d parameters in %d shards, maxStaleness = %d.\n",
+                (int)m_totalModelSize, (int)m_pMPI->NumNodesInUse(), m_maxStaleness);
+        m_reportTimer.Start();
+    }
+
+    bool PushAndPullModel(const std::list<ComputationNodeBasePtr> & learnableNodes, size_t /*sampleSinceLastSynced*/) override
+    {
+        m_parameterSyncCounter++;
+        m_epochSyncCounter++;
+
+        ElemType factor = m_ModelAveragingSGDSimulating ? (ElemType)(1.0 / m_pMPI->NumNodesInUse()) : (ElemType)DecayCoefficient();
+
+        // push and pull each parameter as soon as it is on the CPU, while the next one is copied
+        size_t i = 0; // index of the learnable node
+        size_t pieceIndex = 0;
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        {
+            Matrix<ElemType>& mat = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+            ElemType* delta = m_delta.data() + m_tableOffsets[i];
+            mat.CopySection(mat.GetNumRows(), mat.GetNumCols(), delta, mat.GetNumRows());
+            const ElemType* lastPulled = m_model.data() + m_tableOffsets[i];
+            for (size_t j = 0; j < m_tableLength[i]; j++)
+                delta[j] = (delta[j] - lastPulled[j]) * factor;
+
+            for (; pieceIndex < m_pieces.size() && m_pieces[pieceIndex].offset < m_tableOffsets[i] + m_tableLength[i]; pieceIndex++)
+            {
+                const Piece& piece = m_pieces[pieceIndex];
+                const ElemType* pieceDelta = m_delta.data() + piece.offset;
+                bool changed = std::any_of(pieceDelta, pieceDelta + piece.length, [](ElemType d) { return d != 0; });
+                m_pMPI->FetchAndAdd(m_modelWindow, changed ? pieceDelta : nullptr, m_model.data() + piece.offset,
+                                    piece.length, piece.rank, piece.rankOffset);
+                m_numPieces++;
+                if (!changed)
+                    m_numReadOnlyPieces++;
+            }
+        }
+        m_pMPI->FlushWindow(m_modelWindow);
+
+        // we got the shards before our change was added
+        for (size_t k = 0; k < m_totalModelSize; k++)
+            m_model[k] += m_delta[k];
+
+        i = 0;
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        {
+            ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+            Matrix<ElemType>& mat = node->Value();
+            mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), m_model.data() + m_tableOffsets[i]);
+        }
+
+        AdvanceClock(0, 1);
+        WaitForSlowestWorker();
+
+        if (m_traceLevel > 2 && m_syncPerfStats > 0 && m_parameterSyncCounter % m_syncPerfStats == 0)
+        {
+            m_reportTimer.Stop();
+            fprintf(stderr, "\t\t(parameter server stats) %d-th sync: %.2f seconds since last report, %.1f%% of the shard parts unchanged\n",
+                    (int)m_parameterSyncCounter, m_reportTimer.ElapsedSeconds(), 100.0 * m_numReadOnlyPieces / m_numPieces);
+            m_numPieces = m_numReadOnlyPieces = 0;
+            m_reportTimer.Restart();
+        }
+        return true;
+    }
+
+    void WaitAll() override
+    {
+        // the syncs are counted per epoch, as workers may get different amounts of data
+        AdvanceClock(1, 0 - m_epochSyncCounter);
+        m_epochSyncCounter = 0;
+        m_pMPI->WaitAll();
+    }
+
+    void WaitAsyncBuffer() override { }
+
+private:
+    struct Piece
+    {
+        size_t offset;     // in the concatenated parameters
+        size_t length;
+        size_t rank;       // of the shard
+        size_t rankOffset; // in the shard
+    };
+
+    void CopyModelToCPU(const std::list<ComputationNodeBasePtr> & learnableNodes, ElemType* model)
+    {
+        size_t i = 0;
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        {
+            Matrix<ElemType>& mat = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+            mat.CopySection(mat.GetNumRows(), mat.GetNumCols(), model + m_tableOffsets[i], mat.GetNumRows());
+        }
+    }
+
+    void AdvanceClock(size_t epochs, size_t syncs)
+    {
+        size_t advance[2] = { epochs, syncs };
+        size_t previous[2];
+        m_pMPI->FetchAndAdd(m_clockWindow, advance, previous, 2, m_pMPI->MainNodeRank(), 2 * m_pMPI->CurrentNodeRank());
+        m_pMPI->FlushWindow(m_clockWindow);
+    }
+
+    // bounded staleness: wait while a worker in the same epoch is more than m_maxStaleness syncs behind
+    void WaitForSlowestWorker()
+    {
+        if (m_maxStaleness < 0)
+            return;
+
+        size_t numNodes = m_pMPI->NumNodesInUse();
+        size_t myRank = m_pMPI->CurrentNodeRank();
+        std::vector<size_t> clocks(2 * numNodes);
+        Timer waitTimer;
+        waitTimer.Start();
+        for (;;)
+        {
+            m_pMPI->FetchAndAdd(m_clockWindow, nullptr, clocks.data(), clocks.size(), m_pMPI->MainNodeRank(), 0);
+            m_pMPI->FlushWindow(m_clockWindow);
+
+            size_t slowest = clocks[2 * myRank + 1];
+            for (size_t r = 0; r < numNodes; r++)
+            {
+                if (clocks[2 * r] == clocks[2 * myRank]) // workers that finished the epoch are not waited for
+                    slowest = min(slowest, clocks[2 * r + 1]);
+            }
+            if (slowest + m_maxStaleness >= clocks[2 * myRank + 1])
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        waitTimer.Stop();
+        if (m_traceLevel > 3)
+            fprintf(stderr, "\t\t -- pullAndRequest, waited %lf seconds for slower workers\n", waitTimer.ElapsedSeconds());
+    }
+
+    float DecayCoefficient()
+    {
+        float f = 1.f;
+        switch (m_adjustLearningRateAtBeginningType)
+        {
+        case AdjustLearningRateAtBeginning::None:
+            break;
+        case AdjustLearningRateAtBeginning::Linearly:
+            f = min(f, max(0.f, (float)(m_adjustCoefficient + (1 - m_adjustCoefficient) / m_adjustMBNumber * m_parameterSyncCounter)));
+            break;
+        case AdjustLearningRateAtBeginning::Staircase:
+            f = min(f, max(0.f, (float)(m_adjustCoefficient * (m_parameterSyncCounter / m_adjustMBNumber + 1))));
+            break;
+        default:
+            break;
+        }
+        return f;
+    }
+
+    MPIWrapperPtr m_pMPI;
+    bool m_ModelAveragingSGDSimulating;
+    AdjustLearningRateAtBeginning m_adjustLearningRateAtBeginningType;
+    double m_adjustCoefficient;
+    size_t m_adjustMBNumber;
+    int m_maxStaleness;
+    int m_traceLevel;
+    int m_syncPerfStats;
+    Timer m_reportTimer;
+    size_t m_parameterSyncCounter;
+    size_t m_epochSyncCounter;
+    size_t m_numReadOnlyPieces;
+    size_t m_numPieces;
+
+    vector<size_t> m_tableLength;
+    vector<size_t> m_tableOffsets;
+    size_t m_totalModelSize;
+    vector<size_t> m_shardOffsets;
+    vector<Piece> m_pieces;           // ordered by offset
+
+    vector<ElemType> m_shard;         // the shard this node serves
+    vector<ElemType> m_model;         // as pulled at the last sync
+    vector<ElemType> m_delta;         // to push
+    vector<size_t> m_clocks;          // main node only, see WaitForSlowestWorker()
+    size_t m_modelWindow;
+    size_t m_clockWindow;
+};  // Class ParameterServerASGDHelper
+
 // A None implementation of ASGDHelper interface which does nothing
 // This is used when CNTK_ENABLE_ASGD = false
 template<class ElemType = float>
@@ -635,8 +893,18 @@ ASGDHelper<ElemType>* NewASGDHelper(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats) 
+    int syncPerfStats,
+    bool useBuiltinParameterServer,
+    int maxStaleness,
+    const MPIWrapperPtr& mpi)
 {
+    if (useBuiltinParameterServer)
+    {
+        if (useAsyncBuffer)
+            fprintf(stderr, "WARNING: UsePipeline is ignored by the built-in parameter server, it always pipelines the exchange with its shards.\n");
+        return new ParameterServerASGDHelper<ElemType>(learnableNodes, mpi, isSimulatedModelAveragingSGD,
+                                                       adjusttype, adjustCoef, adjustPerMinibatches, maxStaleness, traceLevel, syncPerfStats);
+    }
 #ifdef ASGD_PARALLEL_SUPPORT
     return new MultiversoHelper<ElemType>(learnableNodes, nodeNumRanks, useAsyncBuffer, isSimulatedModelAveragingSGD, 
                                       adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats);
@@ -655,7 +923,10 @@ template ASGDHelper<float>* NewASGDHelper<float>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats); 
+    int syncPerfStats,
+    bool useBuiltinParameterServer,
+    int maxStaleness,
+    const MPIWrapperPtr& mpi);
 
 template ASGDHelper<double>* NewASGDHelper<double>(
     const std::list<ComputationNodeBasePtr> & learnableNodes,
@@ -666,6 +937,9 @@ template ASGDHelper<double>* NewASGDHelper<double>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats); 
+    int syncPerfStats,
+    bool useBuiltinParameterServer,
+    int maxStaleness,
+    const MPIWrapperPtr& mpi);
 
 }}} 
@@ -0,0 +1,443 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BinaryOutputWriter.h -- binary output of the "write" action (SimpleOutputWriter), written to disk by a background thread.
+//
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include "Float16.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class BinaryOutputFormat
+{
+    raw, // per node: the values of all samples back to back, and a text index of the sequences
+    cbf  // all nodes in a single file in the CNTK binary format, which the CNTKBinaryReader reads back
+};
+
+enum class BinaryOutputElementType
+{
+    float32,
+    float16, // raw format only, the CNTK binary format has no half precision
+    float64
+};
+
+struct BinaryOutputOptions
+{
+    BinaryOutputFormat format = BinaryOutputFormat::raw;
+    BinaryOutputElementType elementType = BinaryOutputElementType::float32;
+    size_t bufferSize = 32 * 1024 * 1024; // size of the buffers handed to the disk; in the CNTK binary format also the chunk size
+
+    size_t ElementSize() const
+    {
+        return elementType == BinaryOutputElementType::float16 ? sizeof(uint16_t) : elementType == BinaryOutputElementType::float32 ? sizeof(float) : sizeof(double);
+    }
+};
+
+// Writes buffers to a file on a background thread, so that the evaluation does not wait for the disk.
+// The buffers are large and written without stdio buffering, i.e. without another copy. At most two buffers are
+// pending; Write() blocks if the disk cannot keep up. Errors of the background thread surface in Write() or Close().
+class AsyncFileWriter
+{
+public:
+    AsyncFileWriter(const std::wstring& path)
+        : m_file(fopenOrDie(path, L"wb")), m_path(path), m_position(0), m_closing(false)
+    {
+        setvbuf(m_file, nullptr, _IONBF, 0);
+        m_thread = std::thread([this]() { WriteBuffers(); });
+    }
+
+    ~AsyncFileWriter()
+    {
+        if (m_thread.joinable())
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_closing = true;
+            }
+            m_condition.notify_all();
+            m_thread.join();
+        }
+        if (m_file)
+            fclose(m_file);
+    }
+
+    // An empty buffer to fill, recycled from earlier writes if possible.
+    std::vector<char> GetBuffer()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::vector<char> buffer;
+        if (!m_free.empty())
+        {
+            buffer = std::move(m_free.back());
+            m_free.pop_back();
+        }
+        buffer.clear();
+        return buffer;
+    }
+
+    // Queues the buffer for writing.
+    void Write(std::vector<char>&& buffer)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return m_pending.size() < 2 || m_error; });
+        RethrowIfFailed();
+        m_position += buffer.size();
+        m_pending.push_back(std::move(buffer));
+        m_condition.notify_all();
+    }
+
+    // Number of bytes written so far, including the pending buffers.
+    uint64_t GetPosition() const
+    {
+        return m_position;
+    }
+
+    // Writes the pending buffers and closes the file.
+    void Close()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_closing = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+        RethrowIfFailed();
+
+        FILE* file = m_file;
+        m_file = nullptr;
+        fcloseOrDie(file);
+    }
+
+private:
+    void WriteBuffers()
+    {
+        for (;;)
+        {
+            std::vector<char> buffer;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return !m_pending.empty() || m_closing; });
+                if (m_pending.empty() || m_error)
+                    return;
+                buffer = std::move(m_pending.front());
+            }
+
+            try
+            {
+                fwriteOrDie(buffer.data(), 1, buffer.size(), m_file);
+            }
+            catch (...)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_error = std::current_exception();
+                m_condition.notify_all();
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_pending.pop_front();
+            if (m_free.size() < 2)
+                m_free.push_back(std::move(buffer));
+            m_condition.notify_all();
+        }
+    }
+
+    // (under the lock)
+    void RethrowIfFailed()
+    {
+        if (m_error)
+        {
+            fprintf(stderr, "AsyncFileWriter: writing '%ls' failed.\n", m_path.c_str());
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    FILE* m_file;
+    std::wstring m_path;
+    uint64_t m_position;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::vector<char>> m_pending;
+    std::vector<std::vector<char>> m_free;
+    bool m_closing;
+    std::exception_ptr m_error;
+
+    DISABLE_COPY_AND_MOVE(AsyncFileWriter);
+};
+
+// Writes the sequences of the output nodes in binary.
+//  - raw: for each node a file '<path>.<node>' with the samples as a dense row-major [numSamples x dim] array of
+//    the element type, and a text file '<path>.<node>.index' with a line 'key firstSample numSamples' per sequence.
+//  - cbf: a single file '<path>' in the CNTK binary format, with a dense input per node, named after the node. Keys
+//    are not part of the format; they are written to '<path>.keys' in the order of the sequences if requested.
+//    All nodes must have the same sequences, i.e. the same MBLayout.
+class BinaryOutputWriter
+{
+public:
+    // streams: name and sample dimension of each output node
+    BinaryOutputWriter(const std::wstring& path, const BinaryOutputOptions& options, const std::vector<std::pair<std::wstring, size_t>>& streams, bool writeKeys)
+        : m_path(path), m_options(options), m_streams(streams.size()), m_numChunkSequences(0)
+    {
+        if (m_options.format == BinaryOutputFormat::cbf && m_options.elementType == BinaryOutputElementType::float16)
+            InvalidArgument("The CNTK binary format does not support float16 values, please use float or double.");
+
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            auto& stream = m_streams[i];
+            stream.m_name = streams[i].first;
+            stream.m_dimension = streams[i].second;
+            stream.m_numSamples = 0;
+            if (m_options.format == BinaryOutputFormat::raw)
+            {
+                stream.m_file = std::make_unique<AsyncFileWriter>(m_path + L"." + stream.m_name);
+                stream.m_index = fopenOrDie(m_path + L"." + stream.m_name + L".index", L"w");
+                stream.m_buffer = stream.m_file->GetBuffer();
+            }
+        }
+
+        if (m_options.format == BinaryOutputFormat::cbf)
+        {
+            m_file = std::make_unique<AsyncFileWriter>(m_path);
+            if (writeKeys)
+                m_keys = fopenOrDie(m_path + L".keys", L"w");
+
+            // magic number and version, see CNTKBinaryReader/FileHelper.h
+            std::vector<char> buffer = m_file->GetBuffer();
+            Append(buffer, s_magicNumber);
+            Append(buffer, s_version);
+            m_file->Write(std::move(buffer));
+        }
+    }
+
+    ~BinaryOutputWriter()
+    {
+        for (auto& stream : m_streams)
+        {
+            if (stream.m_index)
+                fclose(stream.m_index);
+        }
+        if (m_keys)
+            fclose(m_keys);
+    }
+
+    // Appends a sequence of numSamples samples to stream s. The samples start at 'data', 'stride' elements apart.
+    template <class ElemType>
+    void WriteSequence(size_t s, const std::string& key, const ElemType* data, size_t numSamples, size_t stride)
+    {
+        auto& stream = m_streams[s];
+        auto& buffer = stream.m_buffer;
+        if (m_options.format == BinaryOutputFormat::cbf)
+        {
+            // sequences of the chunk, each prefixed by its number of samples
+            if (stream.m_sequenceLengths.size() == m_numChunkSequences)
+            {
+                m_numChunkSequences++;
+                m_chunkSequenceLengths.push_back(0);
+                if (m_keys)
+                    fprintfOrDie(m_keys, "%s\n", key.c_str());
+            }
+            size_t index = stream.m_sequenceLengths.size();
+            stream.m_sequenceLengths.push_back((uint32_t)numSamples);
+            m_chunkSequenceLengths[index] = std::max(m_chunkSequenceLengths[index], (uint32_t)numSamples);
+            Append(buffer, (uint32_t)numSamples);
+        }
+        else
+        {
+            fprintfOrDie(stream.m_index, "%s %llu %llu\n", key.c_str(), (unsigned long long)stream.m_numSamples, (unsigned long long)numSamples);
+        }
+        stream.m_numSamples += numSamples;
+
+        const size_t dim = stream.m_dimension;
+        size_t offset = buffer.size();
+        buffer.resize(offset + numSamples * dim * m_options.ElementSize());
+        char* out = buffer.data() + offset;
+        for (size_t t = 0; t < numSamples; t++)
+        {
+            const ElemType* sample = data + t * stride;
+            switch (m_options.elementType)
+            {
+            case BinaryOutputElementType::float16:
+                for (size_t i = 0; i < dim; i++, out += sizeof(uint16_t))
+                {
+                    uint16_t value = FloatToFloat16Bits((float)sample[i]);
+                    memcpy(out, &value, sizeof(value));
+                }
+                break;
+            case BinaryOutputElementType::float32:
+                for (size_t i = 0; i < dim; i++, out += sizeof(float))
+                {
+                    float value = (float)sample[i];
+                    memcpy(out, &value, sizeof(value));
+                }
+                break;
+            default:
+                for (size_t i = 0; i < dim; i++, out += sizeof(double))
+                {
+                    double value = (double)sample[i];
+                    memcpy(out, &value, sizeof(value));
+                }
+                break;
+            }
+        }
+
+        if (m_options.format == BinaryOutputFormat::raw && buffer.size() >= m_options.bufferSize)
+        {
+            stream.m_file->Write(std::move(buffer));
+            buffer = stream.m_file->GetBuffer();
+        }
+    }
+
+    // Called after the sequences of a minibatch have been written for all streams.
+    void EndMinibatch()
+    {
+        if (m_options.format != BinaryOutputFormat::cbf)
+            return;
+
+        size_t chunkSize = 0;
+        for (auto& stream : m_streams)
+        {
+            if (stream.m_sequenceLengths.size() != m_numChunkSequences)
+                RuntimeError("BinaryOutputWriter: the output node '%ls' has %d sequences in the minibatch instead of %d; "
+                             "the CNTK binary format requires nodes with the same sequences.",
+                             stream.m_name.c_str(), (int)stream.m_sequenceLengths.size(), (int)m_numChunkSequences);
+            chunkSize += stream.m_buffer.size();
+        }
+
+        if (chunkSize >= m_options.bufferSize)
+            WriteChunk();
+    }
+
+    // Writes what is left, the header of the CNTK binary format, and closes the files.
+    void Close()
+    {
+        if (m_options.format == BinaryOutputFormat::raw)
+        {
+            for (auto& stream : m_streams)
+            {
+                if (!stream.m_buffer.empty())
+                    stream.m_file->Write(std::move(stream.m_buffer));
+                stream.m_file->Close();
+                FILE* index = stream.m_index;
+                stream.m_index = nullptr;
+                fcloseOrDie(index);
+            }
+            return;
+        }
+
+        if (m_numChunkSequences > 0)
+            WriteChunk();
+
+        std::vector<char> header = m_file->GetBuffer();
+        int64_t headerOffset = (int64_t)m_file->GetPosition();
+        Append(header, s_magicNumber);
+        Append(header, (uint32_t)m_chunks.size());
+        Append(header, (uint32_t)m_streams.size());
+        for (auto& stream : m_streams)
+        {
+            std::string name = msra::strfun::utf8(stream.m_name);
+            Append(header, (unsigned char)0); // dense
+            Append(header, (uint32_t)name.size());
+            header.insert(header.end(), name.begin(), name.end());
+            Append(header, (unsigned char)(m_options.elementType == BinaryOutputElementType::float32 ? 0 : 1));
+            Append(header, (uint32_t)stream.m_dimension);
+        }
+        for (auto& chunk : m_chunks)
+        {
+            Append(header, chunk.m_offset);
+            Append(header, chunk.m_numSequences);
+            Append(header, chunk.m_numSamples);
+        }
+        Append(header, headerOffset);
+        m_file->Write(std::move(header));
+        m_file->Close();
+
+        if (m_keys)
+        {
+            FILE* keys = m_keys;
+            m_keys = nullptr;
+            fcloseOrDie(keys);
+        }
+    }
+
+private:
+    static const uint64_t s_magicNumber = 0x636e746b5f62696eU;
+    static const uint32_t s_version = 1;
+
+    template <class T>
+    static void Append(std::vector<char>& buffer, T value)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+    }
+
+    // chunk: the numbers of samples of the sequences, followed by the sequences of each stream
+    void WriteChunk()
+    {
+        ChunkInfo chunk;
+        chunk.m_offset = (int64_t)m_file->GetPosition();
+        chunk.m_numSequences = (uint32_t)m_numChunkSequences;
+        chunk.m_numSamples = 0;
+        for (auto length : m_chunkSequenceLengths)
+            chunk.m_numSamples += length;
+        m_chunks.push_back(chunk);
+
+        std::vector<char> buffer = m_file->GetBuffer();
+        buffer.insert(buffer.end(), reinterpret_cast<const char*>(m_chunkSequenceLengths.data()), reinterpret_cast<const char*>(m_chunkSequenceLengths.data() + m_chunkSequenceLengths.size()));
+        for (auto& stream : m_streams)
+        {
+            buffer.insert(buffer.end(), stream.m_buffer.begin(), stream.m_buffer.end());
+            stream.m_buffer.clear();
+            stream.m_sequenceLengths.clear();
+        }
+        m_file->Write(std::move(buffer));
+
+        m_numChunkSequences = 0;
+        m_chunkSequenceLengths.clear();
+    }
+
+    struct Stream
+    {
+        std::wstring m_name;
+        size_t m_dimension;
+        size_t m_numSamples;              // samples written so far
+        std::vector<char> m_buffer;       // values not yet handed to the file
+        std::unique_ptr<AsyncFileWriter> m_file; // raw format
+        FILE* m_index = nullptr;          // raw format
+        std::vector<uint32_t> m_sequenceLengths; // cbf: sequences of the current chunk
+    };
+
+    // entry of the chunk table, see CNTKBinaryReader/BinaryChunkDeserializer.h
+    struct ChunkInfo
+    {
+        int64_t m_offset;
+        uint32_t m_numSequences;
+        uint32_t m_numSamples;
+    };
+
+    std::wstring m_path;
+    BinaryOutputOptions m_options;
+    std::vector<Stream> m_streams;
+
+    // cbf format
+    std::unique_ptr<AsyncFileWriter> m_file;
+    FILE* m_keys = nullptr;
+    std::vector<ChunkInfo> m_chunks;
+    size_t m_numChunkSequences;
+    std::vector<uint32_t> m_chunkSequenceLengths; // maximum over the streams
+};
+
+}}}
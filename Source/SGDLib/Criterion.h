@@ -9,6 +9,7 @@
 #include "Basics.h"
 #include "Matrix.h"
 #include "TensorView.h"
+#include <algorithm>
 #include <memory> // for pair
 #include <limits> // for isnan() and numeric_limits  --TODO: is that the right header?
 
@@ -109,6 +110,21 @@ struct CriterionAccumulator
         else
             return EpochCriterion(m_aggregateCriterionValues->GetValue(0, i), m_aggregateSampleCounts[i]);
     }
+    // retrieve all accumulated results, with a single transfer from the GPU
+    // Each transfer waits for the GPU to finish all work queued so far, so this is to be done only when the values are needed.
+    std::vector<EpochCriterion> GetCriteria() const
+    {
+        std::vector<EpochCriterion> criteria(m_aggregateSampleCounts.size());
+        if (std::all_of(m_aggregateSampleCounts.begin(), m_aggregateSampleCounts.end(), [](size_t count) { return count == 0; }))
+            return criteria; // avoid unnecessary GPU access
+        std::unique_ptr<ElemType[]> values(m_aggregateCriterionValues->CopyToArray());
+        for (size_t i = 0; i < criteria.size(); i++)
+        {
+            if (m_aggregateSampleCounts[i] > 0) // see GetCriterion()
+                criteria[i] = EpochCriterion(values[i], m_aggregateSampleCounts[i]);
+        }
+        return criteria;
+    }
 
 private:
     // shared part of Add() and Assign()
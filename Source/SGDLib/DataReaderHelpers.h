@@ -362,8 +362,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                   const std::vector<ComputationNodeBasePtr>& evaluationNodes)
         {
             m_MBLayoutCache = make_shared<MBLayout>();
-            m_netCriterionAccumulator = make_shared<Matrix<ElemType>>(1, 1, net->GetDeviceId());
-            m_netEvaluationAccumulator = make_shared<Matrix<ElemType>>(1, evaluationNodes.size(), net->GetDeviceId());
+            m_netCriterionAccumulator = make_shared<Matrix<ElemType>>(1, 1, criterionNodes.empty() ? net->GetDeviceId() : criterionNodes.front()->GetDeviceId());
+            m_netEvaluationAccumulator = make_shared<Matrix<ElemType>>(1, evaluationNodes.size(), evaluationNodes.empty() ? net->GetDeviceId() : evaluationNodes.front()->GetDeviceId());
             // remember ptrs to learnable nodes
             for (auto x : learnableNodes)
             {
@@ -19,6 +19,18 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) = 0;
 
+    // Aggregators that can overlap the aggregation with the backward pass return true here. The training loop then calls
+    // OnGradientReady() for each gradient as soon as it is final in the current minibatch (see ComputationNetwork::Backprop()),
+    // before it calls AggregateGradients() for all of them, which completes the aggregation.
+    virtual bool SupportsOverlappedAggregation() const
+    {
+        return false;
+    }
+
+    virtual void OnGradientReady(Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
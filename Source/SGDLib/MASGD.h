@@ -404,4 +404,212 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         }
     };
 
+    // Model averaging, optionally with block momentum, that overlaps the averaging with the computation of the next block.
+    // At a sync point a worker sends the progress it made since the previous one (MPI_Iallreduce) and continues right away;
+    // at the next sync point, the average progress of the workers in that block takes the place of the worker's own.
+    // That is, a worker's model is the global model, one block behind, plus the worker's progress since.
+    // The global model G gets the block-momentum update D = blockMomentum * D + blockLearningRate * average, G += D, and the
+    // workers continue from G, or from G + blockMomentum * D with Nesterov momentum. The last block of an epoch is averaged
+    // synchronously, so that all workers end the epoch with the same model.
+    template<typename ElemType>
+    class PipelinedModelAveragingSGD : public IMASGD<ElemType>
+    {
+        typedef IMASGD<ElemType> Base;
+        using Base::m_pMPI;
+        using Base::m_deviceId;
+        using Base::DownCast;
+
+    public:
+        PipelinedModelAveragingSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID,
+                                   double blockLearningRate = 1.0, double blockMomentum = 0.0,
+                                   bool useNesterovMomentum = false, bool resetSGDMomentum = false)
+            : Base(pMPI, reportFreq, devID), m_blockLearningRate(blockLearningRate), m_blockMomentum(blockMomentum),
+            m_useNesterovMomentum(useNesterovMomentum), m_resetSGDMomentum(resetSGDMomentum),
+            m_finalSync(false), m_exchangePending(false), m_numSamplesInExchange(0)
+        {
+            fprintf(stderr, "Parallel training (%d workers) using pipelined ModelAveraging (blockLearningRate = %.4f, blockMomentum = %.4f%s)\n",
+                    (int)m_pMPI->NumNodesInUse(), blockLearningRate, blockMomentum, useNesterovMomentum ? ", Nesterov" : "");
+        }
+
+        static double TimeConstant2Momentum(double timeConstant, size_t syncPeriod)
+        {
+            return timeConstant == 0 ? 0 : exp(-((double)syncPeriod) / timeConstant);
+        }
+
+        void OnEpochStart(const std::list<ComputationNodeBasePtr>& learnableNodes) override
+        {
+            Base::OnEpochStart(learnableNodes);
+
+            // the workers start the epoch with the same model
+            if (m_globalModel.empty())
+            {
+                for (auto& pBaseNode : learnableNodes)
+                {
+                    auto& value = DownCast(pBaseNode)->Value();
+                    for (auto matrices : { &m_globalModel, &m_snapshot, &m_progress, &m_average })
+                        matrices->push_back(make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), m_deviceId));
+                    m_exchangeOffsets.push_back(m_exchangeBuffer.size());
+                    m_exchangeBuffer.resize(m_exchangeBuffer.size() + value.GetNumElements());
+                }
+            }
+            if (m_momentum.empty()) // unless loaded from the checkpoint
+            {
+                for (auto& pBaseNode : learnableNodes)
+                {
+                    auto& value = DownCast(pBaseNode)->Value();
+                    m_momentum.push_back(make_shared<Matrix<ElemType>>(Matrix<ElemType>::Zeros(value.GetNumRows(), value.GetNumCols(), m_deviceId)));
+                }
+            }
+            size_t i = 0;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                auto& value = DownCast(pBaseNode)->Value();
+                m_globalModel[i]->SetValue(value);
+                m_snapshot[i]->SetValue(value);
+                i++;
+            }
+        }
+
+        void OnEpochEnd(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                        std::list<Matrix<ElemType>>& smoothedGradient,
+                        size_t samplesSinceLastSync) override
+        {
+            m_finalSync = true;
+            Base::OnEpochEnd(learnableNodes, smoothedGradient, samplesSinceLastSync);
+            m_finalSync = false;
+        }
+
+        void ModelAggregationProcessing(
+            size_t samplesSinceLastSync,                                       /* in */
+            const std::list<ComputationNodeBasePtr>&  learnableNodes,          /* in/out */
+            std::list<Matrix<ElemType>>&              smoothedGradient,        /* in/out */
+            size_t&                                   totalSamplesProcessed,   /* out */
+            float&                                    secondsOnCommunication   /* out */) override
+        {
+            // 1. our progress in the block that ends here
+            size_t i = 0;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                m_progress[i]->AssignDifferenceOf(DownCast(pBaseNode)->Value(), *m_snapshot[i]);
+                i++;
+            }
+
+            // 2. the average of the previous block, which was exchanged while we computed this one
+            Timer commTimer;
+            commTimer.Start();
+            totalSamplesProcessed = m_exchangePending ? FinishExchange() : samplesSinceLastSync * m_pMPI->NumNodesInUse();
+
+            // 3. exchange the progress in this block, at the end of the epoch without overlap
+            StartExchange(samplesSinceLastSync);
+            if (m_finalSync)
+                totalSamplesProcessed = FinishExchange();
+            commTimer.Stop();
+            secondsOnCommunication = (float)commTimer.ElapsedSeconds();
+
+            // 4. continue from the global model, plus our progress that is not in it yet
+            i = 0;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                auto& value = DownCast(pBaseNode)->Value();
+                value.SetValue(*m_globalModel[i]);
+                if (m_useNesterovMomentum)
+                    Matrix<ElemType>::ScaleAndAdd((ElemType)m_blockMomentum, *m_momentum[i], value);
+                if (!m_finalSync)
+                    Matrix<ElemType>::ScaleAndAdd((ElemType)1, *m_progress[i], value);
+                m_snapshot[i]->SetValue(value);
+                i++;
+            }
+
+            if (m_resetSGDMomentum)
+            {
+                for (auto& gradient : smoothedGradient)
+                    gradient.SetValue((ElemType)0);
+            }
+        }
+
+        void SaveToCheckPoint(File& fstream) override
+        {
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPipelinedBlockMomentum");
+            fstream << m_momentum.size();
+            for (auto& momentum : m_momentum)
+                fstream << *momentum;
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPipelinedBlockMomentum");
+        }
+
+        void LoadFromCheckPoint(File& fstream) override
+        {
+            if (!fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BPipelinedBlockMomentum"))
+                return; // written without pipelining, the block momentum starts from 0
+            size_t numMatrices;
+            fstream >> numMatrices;
+            m_momentum.clear();
+            for (size_t i = 0; i < numMatrices; i++)
+            {
+                m_momentum.push_back(make_shared<Matrix<ElemType>>(m_deviceId));
+                fstream >> *m_momentum.back();
+            }
+            fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPipelinedBlockMomentum");
+        }
+
+    private:
+        // sends our progress weighted by our number of samples, for the average weighted by samples
+        void StartExchange(size_t samplesSinceLastSync)
+        {
+            for (size_t i = 0; i < m_progress.size(); i++)
+            {
+                auto& progress = *m_progress[i];
+                ElemType* data = m_exchangeBuffer.data() + m_exchangeOffsets[i];
+                progress.CopySection(progress.GetNumRows(), progress.GetNumCols(), data, progress.GetNumRows());
+                for (size_t j = 0; j < progress.GetNumElements(); j++)
+                    data[j] *= (ElemType)samplesSinceLastSync;
+            }
+            m_numSamplesInExchange = samplesSinceLastSync;
+            m_pMPI->AllReduceAsync(m_exchangeBuffer.data(), m_exchangeBuffer.size(), &m_exchangeRequest);
+            m_pMPI->AllReduceAsync(&m_numSamplesInExchange, 1, &m_numSamplesRequest);
+            m_exchangePending = true;
+        }
+
+        // waits for the exchange and applies the average to the global model, returns the number of samples in the block
+        size_t FinishExchange()
+        {
+            m_pMPI->Wait(&m_exchangeRequest, MPI_STATUSES_IGNORE) || MpiFail("PipelinedModelAveragingSGD: MPI_Wait");
+            m_pMPI->Wait(&m_numSamplesRequest, MPI_STATUSES_IGNORE) || MpiFail("PipelinedModelAveragingSGD: MPI_Wait");
+            m_exchangePending = false;
+            if (m_numSamplesInExchange == 0)
+                return 0;
+
+            ElemType factor = (ElemType)(m_blockLearningRate / m_numSamplesInExchange);
+            for (size_t i = 0; i < m_average.size(); i++)
+            {
+                auto& average = *m_average[i];
+                average.SetValue(average.GetNumRows(), average.GetNumCols(), m_deviceId, m_exchangeBuffer.data() + m_exchangeOffsets[i]);
+                Matrix<ElemType>::Scale((ElemType)m_blockMomentum, *m_momentum[i]);
+                Matrix<ElemType>::ScaleAndAdd(factor, average, *m_momentum[i]);
+                Matrix<ElemType>::ScaleAndAdd((ElemType)1, *m_momentum[i], *m_globalModel[i]);
+            }
+            return m_numSamplesInExchange;
+        }
+
+        double m_blockLearningRate;
+        double m_blockMomentum;
+        bool m_useNesterovMomentum;
+        bool m_resetSGDMomentum;
+        bool m_finalSync; // at the end of the epoch
+
+        // per learnable node
+        std::vector<shared_ptr<Matrix<ElemType>>> m_globalModel; // as of the last block that was averaged
+        std::vector<shared_ptr<Matrix<ElemType>>> m_momentum;    // the last update of the global model
+        std::vector<shared_ptr<Matrix<ElemType>>> m_snapshot;    // our model at the last sync point
+        std::vector<shared_ptr<Matrix<ElemType>>> m_progress;    // since then
+        std::vector<shared_ptr<Matrix<ElemType>>> m_average;
+
+        // the exchange in flight
+        std::vector<ElemType> m_exchangeBuffer;
+        std::vector<size_t> m_exchangeOffsets;
+        bool m_exchangePending;
+        size_t m_numSamplesInExchange;
+        MPI_Request m_exchangeRequest;
+        MPI_Request m_numSamplesRequest;
+    };
+
 } } }
@@ -16,7 +16,7 @@ namespace Microsoft { namespace MSR{ namespace CNTK {
 
 template <class ElemType>
 void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader * dataReader, const vector<wstring>& evalNodeNames, 
-    const wstring newModelPath, const size_t mbSize, const int iters)
+    const wstring newModelPath, const size_t mbSize, const int iters, const bool singleSweep)
 {
     // since the mean and variance of bn will be modified in statistics,
     // training mode will make it work. And there is no back prop, other parameters
@@ -66,7 +66,7 @@ void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader *
 
     bool useParallelTrain = (m_mpi != nullptr);
     bool useDistributedMBReading = useParallelTrain && m_enableDistributedMBReading && dataReader->SupportsDistributedMBRead();
-    size_t totalEpochSize = bnNodes.size() * mbSize * iters;
+    size_t totalEpochSize = (singleSweep ? 1 : bnNodes.size()) * mbSize * iters;
 
     m_net->StartEvaluateMinibatchLoop(bnNodes);
 
@@ -76,19 +76,15 @@ void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader *
         dataReader->StartMinibatchLoop(mbSize, 0, inputMatrices.GetStreamDescriptions(), totalEpochSize);
 
     bnNodes = m_net->SortByGlobalEvalOrder(bnNodes);
-    for (auto& node : bnNodes)
-    {
-        let bnNode = static_pointer_cast<BatchNormalizationNode<ElemType>>(node);
-        size_t actualMBSize = 0;
-
-        LOGPRINTF(stderr, "Estimating Statistics --> %ls\n", bnNode->GetName().c_str());
 
-
-        // for every single bn node, the statistics is the average of mean and variance for several times in forward prop
-        // the forward prop is from the feature to the current bn node
+    // the statistics of 'nodes' are the average of mean and variance over several forward props, from the features to the nodes
+    auto estimateStatistics = [&](const std::vector<ComputationNodeBasePtr>& nodes)
+    {
+        size_t numSamples = 0;
         for (int iter = 0; iter < iters; iter++)
         {
             // during the bn stat, dataRead must be ensured
+            size_t actualMBSize = 0;
             bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net,
                 nullptr, useDistributedMBReading, useParallelTrain, inputMatrices, actualMBSize, m_mpi);
 
@@ -96,46 +92,33 @@ void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader *
 
             ComputationNetwork::BumpEvalTimeStamp(featureNodes);
 
-            // forward prop till reaching the current bn node
-            m_net->ForwardProp(node);
+            // forward prop till reaching the bn nodes
+            for (auto& node : nodes)
+                m_net->ForwardProp(node);
+            numSamples += actualMBSize;
         }
 
-        // after finished statistics, the mean and variance of the bn node should be freezd.
-        bnNode->FreezeParameters();
+        // after finished statistics, the mean and variance of the bn nodes should be freezd.
+        for (auto& node : nodes)
+            static_pointer_cast<BatchNormalizationNode<ElemType>>(node)->FreezeParameters();
 
         // Sync during or after all iters of a BN node are equivalent
         if (useParallelTrain)
-        {
-            if (m_gradHeader == nullptr)
-            {
-                m_gradHeader.reset(DistGradHeader::Create(evalNodes.size()), [](DistGradHeader* ptr)
-                {
-                    DistGradHeader::Destroy(ptr);
-                });
-            }
-
-            // push the statistics results of mean and variance of bn nodes into mpi updating vector
-            std::vector<Matrix<ElemType>*> learnParamsValues(2, nullptr);
+            AggregateStatistics(nodes, numSamples);
+    };
 
-            SimpleDistGradAggregator<ElemType> distGradAgg(m_mpi, false /*useAsyncAggregation*/, m_net->GetDeviceId(), 0 /*syncStatsTrace*/);
-
-            auto runMeanParameterPtr = node->Input(3);
-            auto runStdParameterPtr  = node->Input(4);
-
-            shared_ptr<ComputationNode<ElemType>> runMeanNode = static_pointer_cast<ComputationNode<ElemType>>(runMeanParameterPtr);
-            shared_ptr<ComputationNode<ElemType>> runStdNode  = static_pointer_cast<ComputationNode<ElemType>>(runStdParameterPtr);
-
-            learnParamsValues[0] = &(runMeanNode->Value());
-            learnParamsValues[1] = &(runStdNode->Value());
-
-            m_gradHeader->numSamples = actualMBSize ? 1 : actualMBSize;
-            distGradAgg.AggregateGradients(learnParamsValues, m_gradHeader.get(), 0);
-
-            // get the average mean and variance across all the workers
-            for (auto& parameter : learnParamsValues)
-            {
-                (*parameter) /= (ElemType)m_mpi->NumNodesInUse();
-            }
+    if (singleSweep)
+    {
+        LOGPRINTF(stderr, "Estimating Statistics --> %d batch normalization nodes in one sweep\n", (int)bnNodes.size());
+        estimateStatistics(bnNodes);
+    }
+    else
+    {
+        // each bn node is estimated with the statistics of the ones below it already fixed
+        for (auto& node : bnNodes)
+        {
+            LOGPRINTF(stderr, "Estimating Statistics --> %ls\n", node->GetName().c_str());
+            estimateStatistics({ node });
         }
     }
 
@@ -154,6 +137,48 @@ void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader *
     return;
 }
 
+template <class ElemType>
+void PostComputingActions<ElemType>::AggregateStatistics(const std::vector<ComputationNodeBasePtr>& bnNodes, size_t numSamples)
+{
+    if (m_gradHeader == nullptr)
+    {
+        m_gradHeader.reset(DistGradHeader::Create(0), [](DistGradHeader* ptr)
+        {
+            DistGradHeader::Destroy(ptr);
+        });
+    }
+    m_gradHeader->Clear();
+    m_gradHeader->numSamples = numSamples;
+
+    // the running means and variances are aggregated as numSamples * value, the tied sample counts as they are
+    // (statistics shared by several bn nodes are aggregated once)
+    std::vector<Matrix<ElemType>*> averaged, summed;
+    std::set<Matrix<ElemType>*> seen;
+    for (auto& node : bnNodes)
+    {
+        for (size_t i = 3; i < node->GetNumInputs(); i++) // RUN_MEAN, RUN_VAR, and RUN_COUNT unless a legacy model
+        {
+            auto value = &node->Input(i)->As<ComputationNode<ElemType>>()->Value();
+            if (seen.insert(value).second)
+                (i < 5 ? averaged : summed).push_back(value);
+        }
+    }
+    for (auto& value : averaged)
+        (*value) *= (ElemType)numSamples;
+
+    std::vector<Matrix<ElemType>*> statistics(averaged);
+    statistics.insert(statistics.end(), summed.begin(), summed.end());
+    SimpleDistGradAggregator<ElemType> distGradAgg(m_mpi, false /*useAsyncAggregation*/, m_net->GetDeviceId(), 0 /*syncStatsTrace*/);
+    distGradAgg.AggregateGradients(statistics, m_gradHeader.get(), /*resetState=*/true);
+
+    // get the average mean and variance across all the workers
+    if (m_gradHeader->numSamples != 0)
+    {
+        for (auto& value : averaged)
+            (*value) /= (ElemType)m_gradHeader->numSamples;
+    }
+}
+
 template class PostComputingActions<float>;
 template class PostComputingActions<double>;
 
@@ -49,10 +49,15 @@ public:
     // 4. From node to node in the BN vector to generate the mean and various (This links to the changes of BatchNormalizationNode 
     //      in TrainingNodes.h, since I need to make the nodes "learn" mean and variance in inferring mode)
     // 5. Consider the multi-GPU, we need to sync up the BN results between all the worker and average the value.
+    // With 'singleSweep', all BN nodes are estimated in the same 'iters' forward passes rather than node by node (step 4), each
+    // normalizing with the statistics of the current minibatch below it, as in training.
     void BatchNormalizationStatistics(IDataReader* dataReader, const vector<wstring>& evalNodeNames, const wstring newModelPath, 
-        const size_t mbSize, const int iters = 30);
+        const size_t mbSize, const int iters = 30, const bool singleSweep = false);
 
 private:
+    // average the statistics of 'bnNodes' over all workers, weighted by the samples each one has seen, in a single aggregation
+    void AggregateStatistics(const std::vector<ComputationNodeBasePtr>& bnNodes, size_t numSamples);
+
     ComputationNetworkPtr m_net;
     MPIWrapperPtr m_mpi;
     bool m_enableDistributedMBReading;
@@ -32,12 +32,20 @@
 
 #include "CNTKLibraryInternals.h"
 #include "SimpleDistGradAggregator.h"
+#include "TopKDistGradAggregator.h"
 #include "V2SimpleDistGradAggregator.h"
 #include "ProgressTracing.h"
 #include "PerformanceProfiler.h"
+#include "TrainingMetrics.h"
+#include "CPUMatrix.h" // for SetNumThreads()
 
 #include <map>
+#include <numeric>
 #include <set>
+#include <thread>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -277,8 +285,18 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     auto preComputeNodesList = net->GetNodesRequiringPreComputation();
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
+    // model parallelism: split the network into pipeline stages on several devices
+    if (GetModelParallelizationMethod() == ParallelizationMethod::modelParallelSGD)
+        net->PlacePipelineStages(criterionNodes[0], m_pipelineDevices);
+
+    // in-process data parallelism: the replicas of the other threads, created before the values of the network are allocated
+    if (UsingHogwild())
+        CreateHogwildReplicas(net, criterionNodes, evaluationNodes, additionalNodesToEvaluate);
+
     // allocate memory for forward and backward computation
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]); // TODO: use criterionNodes.front() throughout
+    if (m_memoryBudgetMB > 0)
+        FitMinibatchSizeToMemory(net, trainSetDataReader);
 
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
     // TODO: instead, remember the nodes directly, to be able to handle both float and double nodes; current version will crash for mixed networks
@@ -336,6 +354,26 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     vector<double> smoothedCounts; // currently used by FSAdaGradUpdate()
     size_t numParameters = 0;
 
+    // With flat buffers, the smoothed gradients of momentum SGD (which have the size of the values) follow each other
+    // in the order of the values as well, so that a multi-tensor update can update all parameters of a device as one.
+    Matrix<ElemType> flatSmoothedGradients(net->GetDeviceId());
+    if (m_flatParameterBuffers)
+    {
+        net->AllocateFlatParameterBuffers(learnableNodes);
+        if (GradUpdateType() == GradientsUpdateType::None)
+        {
+            size_t numElements = 0;
+            for (const auto& node : learnableNodes)
+            {
+                if (node->IsParameterUpdateRequired() && dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().GetDeviceId() == net->GetDeviceId())
+                    numElements += dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().GetNumElements();
+            }
+            flatSmoothedGradients.Resize(1, numElements);
+            flatSmoothedGradients.SetValue(0);
+        }
+    }
+    size_t flatSmoothedGradientsOffset = 0;
+
     vector<wstring> nodesToUpdateDescriptions; // for logging only
     for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
     {
@@ -343,9 +381,16 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // Note: We don't actually need the smoothedGradients if !IsParameterUpdateRequired().
         // However, this is hard to fix since lots of code assumes smoothedGradients to be in the same order as learnableNodes.
         // V2 API fixes this.
-        smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
-                                                     node->Value().GetNumCols(),
-                                                     net->GetDeviceId()));
+        if (!flatSmoothedGradients.IsEmpty() && node->IsParameterUpdateRequired() && node->Value().GetDeviceId() == net->GetDeviceId())
+        {
+            smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(), node->Value().GetNumCols(),
+                                                         flatSmoothedGradients.Data() + flatSmoothedGradientsOffset, net->GetDeviceId(), matrixFlagDontOwnBuffer));
+            flatSmoothedGradientsOffset += node->Value().GetNumElements();
+        }
+        else
+            smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
+                                                         node->Value().GetNumCols(),
+                                                         node->GetDeviceId())); // (parameters placed on other devices keep their state there)
         smoothedCounts.push_back(0);
         if (node->IsParameterUpdateRequired())
         {
@@ -399,6 +444,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     if (GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD)
     {
         currentNumGradientBits = m_numGradientBits[startEpoch]; // remember so that we can detect a change
+        if (m_elasticTraining)
+            EnableElasticTraining();
         InitDistGradAgg(evaluationNodes.size(), currentNumGradientBits, net->GetDeviceId(), m_traceLevel);
     }
     else if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD || 
@@ -421,7 +468,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         // In case of parallel training only the main node should we saving the model to prevent
         // the parallel training nodes from colliding to write the same file
-        if ((m_mpi == nullptr) || m_mpi->IsMainNode())
+        // (a replacement worker is not part of the running workers yet, it continues with their model)
+        if (((m_mpi == nullptr) || m_mpi->IsMainNode()) && !m_elasticJoin)
             net->Save(GetModelNameForEpoch(int(startEpoch) - 1));
     }
 
@@ -496,10 +544,26 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                          m_adjustCoefficient,
                                          m_adjustPerMinibatches,
                                          m_traceLevel,
-                                         m_syncStatsTrace));
+                                         m_syncStatsTrace,
+                                         m_useBuiltinParameterServer,
+                                         m_maxStaleness,
+                                         m_mpi));
         m_pASGDHelper->InitModel(learnableNodes);
     }
 
+    // A replacement worker joins the running workers at their next epoch boundary and takes over their training state.
+    bool joinedRunningWorkers = false;
+    if (m_elasticTraining && m_elasticJoin && GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD)
+    {
+        JoinRunningWorkers();
+        BroadcastTrainingState(startEpoch, learnRatePerSample, prevCriterion, totalTrainingSamplesSeen, totalMBsSeen,
+                               learnableNodes, smoothedGradients, smoothedCounts);
+        learnRateInitialized = true;
+        currentNumGradientBits = m_numGradientBits[startEpoch];
+        InitDistGradAgg(evaluationNodes.size(), currentNumGradientBits, net->GetDeviceId(), m_traceLevel);
+        joinedRunningWorkers = true;
+    }
+
     // Create TensorBoard writer if needed. When using parallel training, make sure that only Rank 0 actually writes logs.
     ::CNTK::Internal::TensorBoardFileWriterPtr tensorBoardWriter;
     if (!m_tensorBoardLogDir.empty() && (m_mpi == nullptr || m_mpi->CurrentNodeRank() == 0))
@@ -519,7 +583,19 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         // Synchronize all ranks before proceeding to ensure that
         // rank 0 has finished writing the previous model file
-        SynchronizeWorkers();
+        // (a worker that has just joined comes from the admission below, see JoinRunningWorkers())
+        if (!joinedRunningWorkers)
+        {
+            SynchronizeWorkers();
+
+            if (m_elasticTraining && GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD && AdmitReplacementWorkers())
+            {
+                BroadcastTrainingState(i, learnRatePerSample, prevCriterion, totalTrainingSamplesSeen, totalMBsSeen,
+                                       learnableNodes, smoothedGradients, smoothedCounts);
+                InitDistGradAgg(evaluationNodes.size(), currentNumGradientBits, net->GetDeviceId(), m_traceLevel);
+            }
+        }
+        joinedRunningWorkers = false;
 
         // (re-)initialize 1-bit SGD
         if (GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD &&
@@ -643,24 +719,43 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         EpochCriterion epochCriterion; // criterion values are returned in this
         std::vector<EpochCriterion> epochEvalErrors(evaluationNodes.size());
-        totalMBsSeen += TrainOneEpoch(net,
-                                      refNet,
-                                      refNode,
-                                      i,
-                                      m_epochSize,
-                                      trainSetDataReader,
-                                      learnRatePerSample,
-                                      chosenMinibatchSize,
-                                      featureNodes,
-                                      labelNodes,
-                                      criterionNodes,
-                                      evaluationNodes,
-                                      inputMatrices,
-                                      learnableNodes, smoothedGradients, smoothedCounts,
-                                      epochCriterion, epochEvalErrors,
-                                      "", SIZE_MAX, totalMBsSeen, tensorBoardWriter);
+        if (UsingHogwild())
+            totalMBsSeen += TrainOneEpochHogwild(net,
+                                                 i,
+                                                 m_epochSize,
+                                                 trainSetDataReader,
+                                                 learnRatePerSample,
+                                                 chosenMinibatchSize,
+                                                 featureNodes,
+                                                 labelNodes,
+                                                 criterionNodes,
+                                                 evaluationNodes,
+                                                 inputMatrices,
+                                                 learnableNodes, smoothedGradients, smoothedCounts,
+                                                 epochCriterion, epochEvalErrors);
+        else
+            totalMBsSeen += TrainOneEpoch(net,
+                                          refNet,
+                                          refNode,
+                                          i,
+                                          m_epochSize,
+                                          trainSetDataReader,
+                                          learnRatePerSample,
+                                          chosenMinibatchSize,
+                                          featureNodes,
+                                          labelNodes,
+                                          criterionNodes,
+                                          evaluationNodes,
+                                          inputMatrices,
+                                          learnableNodes, smoothedGradients, smoothedCounts,
+                                          epochCriterion, epochEvalErrors,
+                                          "", SIZE_MAX, totalMBsSeen, tensorBoardWriter);
         totalTrainingSamplesSeen += epochCriterion.second; // aggregate #training samples, for logging purposes only
 
+        // The previous checkpoint (asyncCheckpointing) must be complete before anything below reads or replaces it,
+        // including a rollback on the other workers.
+        WaitForPendingCheckpoint();
+
         timer.Stop();
         double epochTime = timer.ElapsedSeconds();
 
@@ -676,6 +771,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         for (size_t j = 0; j < epochEvalErrors.size(); j++)
             epochEvalErrors[j].LogCriterion(evaluationNodes[j]->NodeName());
         fprintf(stderr, "totalSamplesSeen = %d; learningRatePerSample = %.8g; epochTime=%.6gs\n", (int)totalTrainingSamplesSeen, learnRatePerSample, epochTime);
+        if (MatrixTransferAudit::GetMode() != MatrixTransferAudit::Mode::Off)
+            MatrixTransferAudit::PrintStatistics();
 #if 0
         // TODO: This was only printed if >1 eval criterion. Why? Needed?
         LOGPRINTF(stderr, "Finished Epoch[%2d of %d]:     Criterion Node [%ls] Per Sample = %.8g\n",
@@ -703,7 +800,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         {
             // TODO(dataASGD) making evaluator becoming nondistributed one when using ASGD, since Multiverso has another background thread using MPI.
             //                Making the evaluation serial (non-distributed) will slowdown training especially when validation set is large.
-            SimpleEvaluator<ElemType> evalforvalidation(net, UsingAsyncGradientAggregation(i + 1) ?nullptr : m_mpi, m_enableDistributedMBReading);
+            SimpleEvaluator<ElemType> evalforvalidation(net, UsingAsyncGradientAggregation(i + 1) ?nullptr : m_mpi, m_enableDistributedMBReading,
+                                                        100 /*numMBsToShowResult*/, 0 /*firstMBsToShowResult*/, 0 /*traceLevel*/, m_maxSamplesInRAM,
+                                                        1 /*numSubminiBatches*/, m_shardedValidation);
             vector<wstring> cvSetTrainAndEvalNodes;
             if (criterionNodes.size() > 0)
             {
@@ -714,8 +813,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 cvSetTrainAndEvalNodes.push_back(node->NodeName());
             }
 
-            // BUGBUG: We should not use the training MB size. The training MB size is constrained by both convergence and memory. Eval is only constrained by memory.
-            let vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, UsingAsyncGradientAggregation(i + 1) ? m_mbSize[i] / m_mpi->NumNodesInUse() : m_mbSize[i]);
+            // The training MB size is constrained by both convergence and memory. Eval is only constrained by memory, hence cvMinibatchSize.
+            size_t cvMBSize = m_cvMinibatchSize > 0 ? m_cvMinibatchSize : m_mbSize[i];
+            let vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, UsingAsyncGradientAggregation(i + 1) ? cvMBSize / m_mpi->NumNodesInUse() : cvMBSize);
             LOGPRINTF(stderr, "Finished Epoch[%2d of %d]: [Validate] ", i + 1, (int)m_maxEpochs);
             for (size_t k = 0; k < vScore.size() /*&& k < 2*/; k++)
                 vScore[k].LogCriterion(cvSetTrainAndEvalNodes[k], /*addSemicolon=*/k + 1 < vScore.size());
@@ -886,36 +986,65 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             }
             else
             {
-                SaveCheckPointInfo(
-                    i,
-                    totalTrainingSamplesSeen,
-                    learnRatePerSample,
-                    smoothedGradients,
-                    smoothedCounts,
-                    prevCriterion,
-                    chosenMinibatchSize);
-                auto modelName = GetModelNameForEpoch(i);
-                if (m_traceLevel > 0)
-                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                // previous checkpoint files to delete to save space, once the new ones are written
+                vector<wstring> obsoleteCheckPointFiles;
                 if (!m_keepCheckPointFiles)
                 {
-                    // delete previous checkpoint file to save space
                     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch && m_loadBestModel)
                     {
                         if (epochsSinceLastLearnRateAdjust != 1)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                            obsoleteCheckPointFiles.push_back(GetCheckPointFileNameForEpoch(i - 1));
                         }
                         if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
+                            obsoleteCheckPointFiles.push_back(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval));
                         }
                     }
                     else
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                        obsoleteCheckPointFiles.push_back(GetCheckPointFileNameForEpoch(i - 1));
+                    }
+                }
+
+                auto modelName = GetModelNameForEpoch(i);
+                // The model-averaging state that the checkpoint info includes cannot be snapshot, so that is saved synchronously.
+                if (m_asyncCheckpointing && !m_pMASGDHelper)
+                {
+                    if (m_traceLevel > 0)
+                        LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls' in the background\n", modelName.c_str());
+                    // copy the model and learner state to host memory, then write them out while the next epoch trains
+                    auto smoothedGradientsSnapshot = make_shared<list<Matrix<ElemType>>>();
+                    for (const auto& smoothedGradient : smoothedGradients)
+                    {
+                        smoothedGradientsSnapshot->emplace_back(smoothedGradient.GetNumRows(), smoothedGradient.GetNumCols(), CPUDEVICE);
+                        smoothedGradientsSnapshot->back().AssignValuesOf(smoothedGradient);
                     }
+                    auto saveModel = net->SnapshotForSave(modelName);
+                    m_pendingCheckpoint = async(launch::async,
+                        [this, i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradientsSnapshot, smoothedCounts, prevCriterion, chosenMinibatchSize, saveModel, obsoleteCheckPointFiles]()
+                        {
+                            SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, *smoothedGradientsSnapshot, smoothedCounts, prevCriterion, chosenMinibatchSize);
+                            saveModel();
+                            for (const auto& fileName : obsoleteCheckPointFiles)
+                                _wunlink(fileName.c_str());
+                        });
+                }
+                else
+                {
+                    SaveCheckPointInfo(
+                        i,
+                        totalTrainingSamplesSeen,
+                        learnRatePerSample,
+                        smoothedGradients,
+                        smoothedCounts,
+                        prevCriterion,
+                        chosenMinibatchSize);
+                    if (m_traceLevel > 0)
+                        LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
+                    net->Save(modelName);
+                    for (const auto& fileName : obsoleteCheckPointFiles)
+                        _wunlink(fileName.c_str());
                 }
             }
         }
@@ -936,6 +1065,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    WaitForPendingCheckpoint();
+
     // Check if we need to save best model per criterion and this is the main node as well.
     if (m_saveBestModelPerCriterion && ((m_mpi == nullptr) || m_mpi->IsMainNode()))
     {
@@ -963,6 +1094,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
 
     delete inputMatrices;
+    m_hogwildReplicas.clear();
     if (m_parallelizationMethod == ParallelizationMethod::dataParallelASGD)
         m_pASGDHelper.reset();
 }
@@ -971,6 +1103,50 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 // TrainOneEpoch() -- train one epoch
 // -----------------------------------------------------------------------
 
+template <class ElemType>
+void SGD<ElemType>::FitMinibatchSizeToMemory(ComputationNetworkPtr net, IDataReader* trainSetDataReader)
+{
+    // besides its value, each parameter has a smoothed gradient, of which FSAdaGrad and RmsProp keep several
+    size_t numParameterCopies = 2;
+    if (m_gradType.type == GradientsUpdateType::FSAdaGrad)
+        numParameterCopies = 3;
+    else if (m_gradType.type == GradientsUpdateType::RmsProp)
+        numParameterCopies = 4;
+
+    const size_t maxSamples = net->GetMaxSamplesInMemory(m_memoryBudgetMB << 20, numParameterCopies);
+    if (maxSamples == 0)
+        InvalidArgument("The model does not fit into memoryBudgetMB = %d, not even with minibatches of a single sample.", (int) m_memoryBudgetMB);
+    if (maxSamples == SIZE_MAX) // nothing grows with the minibatch
+        return;
+
+    // BUGBUG: With truncated BPTT, the minibatch size is the truncation length, which the reader multiplies by its number of parallel sequences.
+    const size_t numParallelSequences = m_truncated ? max(trainSetDataReader->GetNumParallelSequencesForFixingBPTTMode(), (size_t) 1) : 1;
+    const size_t maxMBSize = maxSamples / numParallelSequences;
+    if (m_truncated)
+        LOGPRINTF(stderr, "Memory budget of %d MB per device: minibatches of up to %d samples fit, i.e. a truncation length of up to %d for %d parallel sequences.\n",
+                  (int) m_memoryBudgetMB, (int) maxSamples, (int) maxMBSize, (int) numParallelSequences);
+    else
+        LOGPRINTF(stderr, "Memory budget of %d MB per device: minibatches of up to %d samples fit, and no sequence may be longer than that.\n",
+                  (int) m_memoryBudgetMB, (int) maxSamples);
+
+    if (m_capMinibatchSizeToMemory)
+    {
+        if (maxMBSize == 0)
+            InvalidArgument("The model does not fit into memoryBudgetMB = %d with %d parallel sequences.", (int) m_memoryBudgetMB, (int) numParallelSequences);
+        // the reader packs minibatches of this size, so it no longer produces larger ones
+        for (auto& mbSize : m_mbSize)
+        {
+            if (mbSize > (int) maxMBSize)
+            {
+                LOGPRINTF(stderr, "Reducing minibatchSize %d to %d.\n", mbSize, (int) maxMBSize);
+                mbSize = (int) maxMBSize;
+            }
+        }
+    }
+    else if (m_maxSamplesInRAM == SIZE_MAX && m_numSubminiBatches <= 1 && m_gradientAccumulationSteps <= 1)
+        m_maxSamplesInRAM = maxSamples; // larger minibatches are computed in sub-minibatches
+}
+
 template <class ElemType>
 size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                     ComputationNetworkPtr refNet,
@@ -995,6 +1171,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                     ::CNTK::Internal::TensorBoardFileWriterPtr tensorBoardWriter)
 {
     PROFILE_SCOPE(profilerEvtMainEpoch);
+    ProfilerSetThreadName("Main");
 
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
 
@@ -1060,12 +1237,18 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // prepare for sub-minibatching
     // Sub-minibatching is used if a single minibatch is too large to fit into GPU RAM.
     DataReaderHelpers::SubminibatchDispatcher<ElemType> smbDispatcher;
-    size_t numSubminibatchesNeeded = DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(trainSetDataReader, m_maxSamplesInRAM, m_numSubminiBatches, tunedMBSize);
+    // with model parallelism, the micro-batches are sub-minibatches
+    const size_t numSubminibatches = GetModelParallelizationMethod() == ParallelizationMethod::modelParallelSGD ? max(m_numSubminiBatches, m_numMicroBatches) : m_numSubminiBatches;
+    size_t numSubminibatchesNeeded = DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(trainSetDataReader, m_maxSamplesInRAM, numSubminibatches, tunedMBSize);
 
     // this is non-trivial, we need a manager object to handle this
     if (numSubminibatchesNeeded > 1)
         smbDispatcher.Init(net, learnableNodes, criterionNodes, evaluationNodes);
 
+    // the sub-minibatch dispatcher moves the gradients between its own buffers and the parameters
+    if (numSubminibatchesNeeded > 1 && m_gradientAccumulationSteps > 1)
+        InvalidArgument("gradientAccumulationSteps cannot be combined with numSubminibatches or maxSamplesInRAM.");
+
     // The following is a special feature only supported by the Kaldi2Reader for more efficient sequence training.
     // This attemps to compute the error signal for the whole utterance, which will
     // be fed to the neural network as features. Currently it is a workaround
@@ -1108,6 +1291,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             else
                 fprintf(stderr, ", with %d subminibatch", (int)numSubminibatchesNeeded);
         }
+
+        if (m_gradientAccumulationSteps > 1)
+            fprintf(stderr, ", with gradients accumulated over %d minibatches", (int)m_gradientAccumulationSteps);
         fprintf(stderr, ".\n");
     }
 
@@ -1117,9 +1303,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // NOTE: the following two local matrices are not used in distGradAgg path
     // assume only one training criterion node for each epoch.
     // The criterion values are accumulated here over the minibatches (without having to pull them off the GPU).
-    CriterionAccumulator<ElemType> localEpochCriterion(criterionNodes, net->GetDeviceId());
+    // (on the device of the criteria, which may be placed on another one than the network)
+    CriterionAccumulator<ElemType> localEpochCriterion(criterionNodes, criterionNodes.front()->GetDeviceId());
     CriterionAccumulator<ElemType> localEpochEvalErrors(
-        evaluationNodes, net->GetDeviceId(),
+        evaluationNodes, evaluationNodes.empty() ? net->GetDeviceId() : evaluationNodes.front()->GetDeviceId(),
         {evaluationNodesWhichAccumulateResult.begin(), evaluationNodesWhichAccumulateResult.end()});
 
     // --- MAIN MINIBATCH LOOP
@@ -1158,6 +1345,14 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     bool noMoreSamplesToProcess = false;
     bool isFirstMinibatch = true;
+    std::vector<size_t> numTimesSlowest; // of each worker, see ReportStragglers()
+
+    // gradient accumulation (gradientAccumulationSteps): the passes through the loop since the gradients were last applied,
+    // the minibatches whose gradients the parameter gradients hold, and the samples of these passes
+    size_t numPendingPasses = 0;
+    size_t numAccumulatedMinibatches = 0;
+    size_t numPendingSamples = 0;
+    size_t numPendingSamplesWithLabel = 0;
     for (;;)
     {
         auto profMinibatch = ProfilerTimeBegin();
@@ -1173,8 +1368,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         if (maxNumSamplesExceeded) // Dropping data.
             wasDataRead = false;
 
-        if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
-            break;                                                                // end of epoch
+        if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess) && // in case of distributed reading, we do a few more loops until all ranks have completed
+            numPendingPasses == 0)                                                   // and we apply the accumulated gradients first
+            break;                                                                   // end of epoch
 
         // Note: If !wasDataRead then the data that GetMinibatchIntoNetwork() was supposed to fill in are undefined.
         // Must not touch them.
@@ -1253,7 +1449,21 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // ===========================================================
 
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                {
+                    // Gradients are final in the last sub-minibatch (of the last accumulated minibatch), their aggregation can start while backprop goes on.
+                    ComputationNetwork::GradientReadyCallback gradientReady;
+                    if (useGradientAggregation && m_distGradAgg->SupportsOverlappedAggregation() && ismb + 1 == actualNumSubminibatches &&
+                        numPendingPasses + 1 >= m_gradientAccumulationSteps)
+                    {
+                        gradientReady = [this](const ComputationNodeBasePtr& node)
+                        {
+                            auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+                            if (parameter)
+                                m_distGradAgg->OnGradientReady(&parameter->Gradient());
+                        };
+                    }
+                    net->Backprop(criterionNodes[0], gradientReady, /*keepParameterGradients=*/numAccumulatedMinibatches > 0);
+                }
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -1261,6 +1471,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             }                                                        // end sub-minibatch loop
             if (actualNumSubminibatches > 1)
                 smbDispatcher.DoneWithCurrentMinibatch();
+            if (learnRatePerSample > 0.01 * m_minLearnRate)
+                numAccumulatedMinibatches++;
         } // if (actualMBSize > 0)
         // WARNING: If actualMBSize == 0, then criterion nodes have NOT been updated, and contain garbage (last MB's) values.
 
@@ -1287,6 +1499,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         size_t aggregateNumSamples = actualMBSize; // (0 for empty MB)
         size_t aggregateNumSamplesWithLabel = CriterionAccumulator<ElemType>::GetNumSamples(criterionNodes[0], numSamplesWithLabelOfNetwork); // (0 for empty MB)
 
+        // With gradient accumulation, the gradients add up in the parameter gradients until the last pass of the accumulation, or
+        // the end of the data, and only then are aggregated and applied. With distributed reading all workers count passes alike.
+        numPendingPasses++;
+        numPendingSamples += aggregateNumSamples;
+        numPendingSamplesWithLabel += aggregateNumSamplesWithLabel;
+        bool applyGradients = (numPendingPasses >= m_gradientAccumulationSteps) || (!wasDataRead && !useDistributedMBReading);
+
         if (!useGradientAggregation)
         {
             // accumulate criterion values (objective, eval)
@@ -1298,93 +1517,161 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         }
         else
         {
-            // distributed gradient aggregation
-            if (learnParamsGradients.size() == 0)
+            // hoist the criterion into CPU space for all-reduce, summed up over the passes of a gradient accumulation
+            if (numPendingPasses == 1)
+            {
+                localEpochCriterion.Assign(0, numSamplesWithLabelOfNetwork);
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    localEpochEvalErrors.Assign(i, numSamplesWithLabelOfNetwork);
+            }
+            else
+            {
+                localEpochCriterion.Add(0, numSamplesWithLabelOfNetwork);
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    localEpochEvalErrors.Add(i, numSamplesWithLabelOfNetwork);
+            }
+
+            if (!applyGradients)
+            {
+                // nothing is aggregated before the last pass of a gradient accumulation
+                aggregateNumSamples = 0;
+                aggregateNumSamplesWithLabel = 0;
+            }
+            else
             {
-                // lazily form the list of smoothedGradients to exchange
-                learnParamsGradients.reserve(learnableNodes.size());
-                for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+                // distributed gradient aggregation
+                if (learnParamsGradients.size() == 0)
                 {
-                    ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
-                    if (node->IsParameterUpdateRequired())
+                    // lazily form the list of smoothedGradients to exchange
+                    // When the aggregation overlaps with backprop, in the order in which backprop computes them (the same on all workers).
+                    std::list<ComputationNodeBasePtr> aggregatedNodes = learnableNodes;
+                    if (m_distGradAgg->SupportsOverlappedAggregation())
                     {
-                        Matrix<ElemType>* currParamsGradient = &(node->Gradient()); // TODO: we can use shared_ptrs now
+                        std::map<ComputationNodeBasePtr, size_t> evalOrderPosition;
+                        for (const auto& node : net->GetEvalOrder(criterionNodes[0]))
+                            evalOrderPosition.insert(std::make_pair(node, evalOrderPosition.size()));
+                        aggregatedNodes.sort([&evalOrderPosition](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+                        {
+                            return evalOrderPosition[a] > evalOrderPosition[b];
+                        });
+                    }
 
-                        // Sometimes, in parallel training, the current node may not get any samples to process
-                        // In this case, the gradient matrix may not have been sized yet. If so, lets size it.
-                        if (currParamsGradient->GetNumCols() == 0)
+                    learnParamsGradients.reserve(learnableNodes.size());
+                    for (auto nodeIter = aggregatedNodes.begin(); nodeIter != aggregatedNodes.end(); nodeIter++)
+                    {
+                        ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+                        if (node->IsParameterUpdateRequired())
                         {
-                            Matrix<ElemType>* currParamsValues = &(node->Value());
-                            currParamsGradient->Resize(currParamsValues->GetNumRows(), currParamsValues->GetNumCols());
-                        }
+                            Matrix<ElemType>* currParamsGradient = &(node->Gradient()); // TODO: we can use shared_ptrs now
 
-                        learnParamsGradients.push_back(currParamsGradient);
+                            // Sometimes, in parallel training, the current node may not get any samples to process
+                            // In this case, the gradient matrix may not have been sized yet. If so, lets size it.
+                            if (currParamsGradient->GetNumCols() == 0)
+                            {
+                                Matrix<ElemType>* currParamsValues = &(node->Value());
+                                currParamsGradient->Resize(currParamsValues->GetNumRows(), currParamsValues->GetNumCols());
+                            }
+
+                            learnParamsGradients.push_back(currParamsGradient);
+                        }
                     }
                 }
-            }
 
-            // hoist the criterion into CPU space for all-reduce
-            localEpochCriterion.Assign(0, numSamplesWithLabelOfNetwork);
-            for (size_t i = 0; i < evaluationNodes.size(); i++)
-                localEpochEvalErrors.Assign(i, numSamplesWithLabelOfNetwork);
-
-            // copy all values to be aggregated into the header
-            m_gradHeader->numSamples = aggregateNumSamples;
-            m_gradHeader->criterion           = localEpochCriterion.GetCriterion(0).first;
-            m_gradHeader->numSamplesWithLabel = localEpochCriterion.GetCriterion(0).second; // same as aggregateNumSamplesWithLabel
-            assert(m_gradHeader->numSamplesWithLabel == aggregateNumSamplesWithLabel);
-            for (size_t i = 0; i < evaluationNodes.size(); i++)
-                m_gradHeader->evalErrors[i] = localEpochEvalErrors.GetCriterion(i);
 
-            // aggregate
-            m_gradHeader->numEvalNode = evaluationNodes.size(); // TODO: rename numEvalNode (plural)
-            bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), isFirstMinibatch);
-            noMoreSamplesToProcess = !samplesProcessed;
+                // copy all values to be aggregated into the header
+                m_gradHeader->numSamples = numPendingSamples;
+                // (one GPU transfer per accumulator rather than per criterion, as each one waits for the GPU)
+                EpochCriterion pendingCriterion   = localEpochCriterion.GetCriteria()[0];
+                m_gradHeader->criterion           = pendingCriterion.first;
+                m_gradHeader->numSamplesWithLabel = pendingCriterion.second; // same as numPendingSamplesWithLabel
+                assert(m_gradHeader->numSamplesWithLabel == numPendingSamplesWithLabel);
+                auto pendingEvalErrors = localEpochEvalErrors.GetCriteria();
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    m_gradHeader->evalErrors[i] = pendingEvalErrors[i];
+
+                // aggregate
+                m_gradHeader->numEvalNode = evaluationNodes.size(); // TODO: rename numEvalNode (plural)
+                bool samplesProcessed;
+                try
+                {
+                    if (m_syncStatsTrace > 0 && (numMBsRun % m_syncStatsTrace) == 0)
+                        ReportStragglers(numMBsRun, (double)(Clock::GetTimeStamp() - profMinibatch) / Clock::GetTicksPerSecond(), numTimesSlowest);
+                    samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), isFirstMinibatch);
+                }
+                catch (const MpiProcessFailure& e)
+                {
+                    // elastic training: drop this minibatch and continue with the remaining workers
+                    LOGPRINTF(stderr, "A worker failed (%s), continuing without it.\n", e.what());
+                    RecoverFromWorkerFailure(epochNumber, net, trainSetDataReader, useDistributedMBReading, tunedMBSize, epochSize,
+                                             inputMatrices, evaluationNodes.size(), learnableNodes, smoothedGradients, smoothedCounts);
+                    learnParamsGradients.clear();
+                    isFirstMinibatch = true;
+                    numPendingPasses = numAccumulatedMinibatches = numPendingSamples = numPendingSamplesWithLabel = 0;
+                    continue;
+                }
+                noMoreSamplesToProcess = !samplesProcessed;
 
-            // read out the header--now everything is aggregated
-            aggregateNumSamples          = m_gradHeader->numSamples;
-            aggregateNumSamplesWithLabel = m_gradHeader->numSamplesWithLabel;
-            epochCriterion += EpochCriterion(m_gradHeader->criterion, m_gradHeader->numSamplesWithLabel);
-            for (size_t i = 0; i < epochEvalErrors.size(); i++)
-            {
-                if (ContainsAccumulatedResult(evaluationNodes[i]))
+                // read out the header--now everything is aggregated
+                aggregateNumSamples          = m_gradHeader->numSamples;
+                aggregateNumSamplesWithLabel = m_gradHeader->numSamplesWithLabel;
+                epochCriterion += EpochCriterion(m_gradHeader->criterion, m_gradHeader->numSamplesWithLabel);
+                for (size_t i = 0; i < epochEvalErrors.size(); i++)
                 {
-                    // We don't accumulate error in epoch criterion as this node has already accumulated error for
-                    // all samples that passed through network in forward pass.
-                    if (samplesProcessed)
+                    if (ContainsAccumulatedResult(evaluationNodes[i]))
                     {
-                        epochEvalErrors[i] = m_gradHeader->evalErrors[i];
+                        // We don't accumulate error in epoch criterion as this node has already accumulated error for
+                        // all samples that passed through network in forward pass.
+                        if (samplesProcessed)
+                        {
+                            epochEvalErrors[i] = m_gradHeader->evalErrors[i];
+                        }
+                        // else: no samples processed, no aggregation happened -> we do not want to override current value
+                        // with 0.
                     }
-                    // else: no samples processed, no aggregation happened -> we do not want to override current value
-                    // with 0.
+                    else
+                        epochEvalErrors[i] += m_gradHeader->evalErrors[i];
                 }
-                else
-                    epochEvalErrors[i] += m_gradHeader->evalErrors[i];
             }
         }
 
         ProfilerTimeEnd(profGradientAgg, profilerEvtMainGradient);
         auto profWeights = ProfilerTimeBegin();
 
+        // the samples of the gradients to apply: those of all passes of a gradient accumulation (across workers if aggregated)
+        size_t updateNumSamples = 0;
+        size_t updateNumSamplesWithLabel = 0;
+        if (applyGradients)
+        {
+            updateNumSamples          = useGradientAggregation ? aggregateNumSamples          : numPendingSamples;
+            updateNumSamplesWithLabel = useGradientAggregation ? aggregateNumSamplesWithLabel : numPendingSamplesWithLabel;
+            numPendingPasses = numAccumulatedMinibatches = numPendingSamples = numPendingSamplesWithLabel = 0;
+        }
+
         // update model parameters
-        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
+        if ((updateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
         {
 #if 1       // BUGBUG: We must skip gaps in our momentum, clipping, regularization etc. criteria.
             // This will break test cases. So for now, we will only enable this for per-sample criteria.
-            size_t numSamplesInMinibatch = aggregateNumSamples;
+            size_t numSamplesInMinibatch = updateNumSamples;
             if (criterionNodes[0]->HasMBLayout())
 #endif
-            numSamplesInMinibatch = aggregateNumSamplesWithLabel;
+            numSamplesInMinibatch = updateNumSamplesWithLabel;
 #if 0
-            if (numSamplesInMinibatch != aggregateNumSamples)
-                fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)aggregateNumSamples);
+            if (numSamplesInMinibatch != updateNumSamples)
+                fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)updateNumSamples);
 #endif
+            std::set<ComputationNodeBasePtr> updatedNodes;
+            if (m_multiTensorUpdate)
+                MultiTensorUpdateWeights(learnableNodes, smoothedGradients, learnRatePerSample,
+                                         GetMomentumPerSample(epochNumber, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences()),
+                                         numSamplesInMinibatch, updatedNodes);
+
             auto smoothedGradientIter = smoothedGradients.begin();
             auto smoothedCountIter = smoothedCounts.begin();
             for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, smoothedCountIter++)
             {
                 ComputationNodeBasePtr node = *nodeIter;
-                if (node->IsParameterUpdateRequired())
+                if (node->IsParameterUpdateRequired() && updatedNodes.find(node) == updatedNodes.end())
                 {
 #ifdef _DEBUG
                     if (smoothedGradientIter->HasNan("TrainOneEpoch/UpdateWeights(): "))
@@ -1464,9 +1751,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         {
             // if no aggregation, we directly get the values from the minibatch accumulators
             timer.Restart();
-            epochCriterion = localEpochCriterion.GetCriterion(0);
-            for (size_t i = 0; i < epochEvalErrors.size(); i++)
-                epochEvalErrors[i] = localEpochEvalErrors.GetCriterion(i);
+            epochCriterion = localEpochCriterion.GetCriteria()[0];
+            epochEvalErrors = localEpochEvalErrors.GetCriteria();
             timer.Stop();
 
             // Add the last trailing compute
@@ -1586,7 +1872,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 tensorBoardWriter->WriteValue(L"minibatch/" + nodeName, (float)evalErrorSinceLastLogged.Average(), step);
             }
 
-            tensorBoardWriter->Flush();
+            // not flushing here: the writer flushes in the background at a fixed interval, and at the end of the epoch
 
             // reset statistics for differential logging
             tensorBoardEpochCriterionLastLogged = epochCriterion;
@@ -1618,7 +1904,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
         profiler.NextSample();
-        isFirstMinibatch = false;
+        if (applyGradients) // (the first aggregation of the epoch comes after a whole gradient accumulation)
+            isFirstMinibatch = false;
+
+        TrainingMetricsAddSamples(actualMBSize, net->GetDeviceId());
 
         ProfilerTimeEnd(profPost, profilerEvtMainPost);
         ProfilerTimeEnd(profMinibatch, profilerEvtMainMinibatch);
@@ -1626,6 +1915,17 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     // --- END MAIN MINIBATCH LOOP
 
+    if (!numTimesSlowest.empty())
+    {
+        LOGPRINTF(stderr, "Stragglers: the slowest worker in %d sampled minibatches was", (int)std::accumulate(numTimesSlowest.begin(), numTimesSlowest.end(), (size_t)0));
+        for (size_t i = 0; i < numTimesSlowest.size(); i++)
+        {
+            if (numTimesSlowest[i] > 0)
+                fprintf(stderr, " worker %d (%d times)", (int)i, (int)numTimesSlowest[i]);
+        }
+        fprintf(stderr, ".\n");
+    }
+
     if (useModelAggregation )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
@@ -1642,9 +1942,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // (unless we useGradientAggregation, in which case they are accumulated in the 'out' variables directly)
     if (!useGradientAggregation)
     {
-        epochCriterion = localEpochCriterion.GetCriterion(0);
-        for (size_t i = 0; i < epochEvalErrors.size(); i++)
-            epochEvalErrors[i] = localEpochEvalErrors.GetCriterion(i);
+        epochCriterion = localEpochCriterion.GetCriteria()[0];
+        epochEvalErrors = localEpochEvalErrors.GetCriteria();
     }
 
     // in case of model averaging, do one more final aggregation of criteria
@@ -1656,9 +1955,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
         // get criteria for this worker
         assert(!useGradientAggregation); // (otherwise the data would not be in localEpochCriterion)
-        epochCriterion = localEpochCriterion.GetCriterion(0);
-        for (size_t i = 0; i < epochEvalErrors.size(); i++)
-            epochEvalErrors[i] = localEpochEvalErrors.GetCriterion(i);
+        epochCriterion = localEpochCriterion.GetCriteria()[0];
+        epochEvalErrors = localEpochEvalErrors.GetCriteria();
 
         // all-reduce epochCriterion and epochEvalErrors over nodes
         m_mpi->AllReduce(&epochCriterion.first,  1);
@@ -1692,6 +1990,336 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     return numMBsRun;
 }
 
+// -----------------------------------------------------------------------
+// TrainOneEpochHogwild() -- train one epoch with several replicas of the network on threads of this process
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void SGD<ElemType>::CreateHogwildReplicas(const ComputationNetworkPtr& net,
+                                          const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                          const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                          const std::vector<ComputationNodeBasePtr>& additionalNodesToEvaluate)
+{
+    if (net->GetDeviceId() != CPUDEVICE)
+        InvalidArgument("HogwildSGD trains on the CPU only.");
+    if (GetParallelizationMethod() != ParallelizationMethod::none || GetModelParallelizationMethod() != ParallelizationMethod::none)
+        InvalidArgument("HogwildSGD cannot be combined with ParallelTrain or ModelParallelSGD.");
+    if (m_flatParameterBuffers)
+        InvalidArgument("HogwildSGD cannot be combined with flatParameterBuffers.");
+    if (m_numSubminiBatches > 1 || m_maxSamplesInRAM < SIZE_MAX || m_gradientAccumulationSteps > 1)
+        InvalidArgument("HogwildSGD cannot be combined with numSubminibatches, maxSamplesInRAM or gradientAccumulationSteps.");
+    if (m_needAdaptRegularization || criterionNodes[0]->OperationName() == L"SequenceWithSoftmax")
+        InvalidArgument("HogwildSGD does not support KL-regularized adaptation or sequence training.");
+
+    // the nodes of a replica that correspond to nodes of the main network
+    auto replicaNodes = [](const ComputationNetworkPtr& replicaNet, const std::vector<ComputationNodeBasePtr>& nodes)
+    {
+        std::vector<ComputationNodeBasePtr> result;
+        for (const auto& node : nodes)
+            result.push_back(replicaNet->GetNodeFromName(node->NodeName()));
+        return result;
+    };
+
+    m_hogwildReplicas.clear();
+    for (size_t k = 1; k < m_numHogwildReplicas; k++)
+    {
+        std::unique_ptr<HogwildReplica> replica(new HogwildReplica());
+        replica->net = net->CloneSharingParameters();
+        replica->featureNodes = replica->net->FeatureNodes();
+        replica->labelNodes = replica->net->LabelNodes();
+        replica->criterionNodes = replicaNodes(replica->net, criterionNodes);
+        replica->evaluationNodes = replicaNodes(replica->net, evaluationNodes);
+
+        for (const auto& mainNode : net->LearnableParameterNodes(criterionNodes[0]))
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(replica->net->GetNodeFromName(mainNode->NodeName()));
+            // with averaging, each replica updates a copy of its own
+            if (m_hogwildSyncPeriod > 0 && node->IsParameterUpdateRequired())
+                node->ValuePtrRef() = make_shared<Matrix<ElemType>>(node->Value().DeepClone());
+            replica->learnableNodes.push_back(node);
+            replica->smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(), node->Value().GetNumCols(), node->GetDeviceId()));
+            replica->smoothedCounts.push_back(0);
+        }
+
+        replica->net->AllocateAllMatrices(replica->evaluationNodes, replicaNodes(replica->net, additionalNodesToEvaluate), replica->criterionNodes[0]);
+        for (size_t pass = 0; pass < 2; pass++)
+        {
+            auto& nodes = (pass == 0) ? replica->featureNodes : replica->labelNodes;
+            for (const auto& node : nodes)
+                replica->inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+        }
+        m_hogwildReplicas.push_back(std::move(replica));
+    }
+}
+
+// The main thread's network and the replicas (CreateHogwildReplicas()) each train on a thread of their own, on the minibatches that
+// their thread takes from the reader in turn. The math library's OpenMP threads are divided among them.
+// With syncPeriod = 0 the replicas share the parameter values, which each thread updates with its own gradients as soon as it has
+// them, without locking (Hogwild). Otherwise the threads run syncPeriod minibatches each on their own copies, which are then averaged.
+// Each thread has its own momentum; those of the replicas start at 0 in each training run.
+template <class ElemType>
+size_t SGD<ElemType>::TrainOneEpochHogwild(ComputationNetworkPtr net,
+                                           const int epochNumber,
+                                           const size_t epochSize,
+                                           IDataReader* trainSetDataReader,
+                                           const double learnRatePerSample,
+                                           size_t tunedMBSize,
+                                           const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                           const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                           const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                           const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                           StreamMinibatchInputs* inputMatrices,
+                                           const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                           std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                                           /*out*/ EpochCriterion& epochCriterion,
+                                           /*out*/ std::vector<EpochCriterion>& epochEvalErrors)
+{
+    PROFILE_SCOPE(profilerEvtMainEpoch);
+
+    const size_t numReplicas = m_hogwildReplicas.size() + 1;
+    const bool averaging = m_hogwildSyncPeriod > 0;
+
+    auto copyValue = [](const ComputationNodeBasePtr& from, const ComputationNodeBasePtr& to)
+    {
+        dynamic_pointer_cast<ComputationNode<ElemType>>(to)->Value().SetValue(dynamic_pointer_cast<ComputationNode<ElemType>>(from)->Value());
+    };
+
+    // The replicas start from the main network, which the pre-computation, a checkpoint, or the learning-rate search may have changed.
+    for (auto& replica : m_hogwildReplicas)
+    {
+        for (const auto& node : net->GetNodesRequiringPreComputation(nullptr, /*checkComputed=*/false))
+            copyValue(node, replica->net->GetNodeFromName(node->NodeName()));
+        if (averaging)
+        {
+            auto replicaNodeIter = replica->learnableNodes.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, replicaNodeIter++)
+                if ((*nodeIter)->IsParameterUpdateRequired())
+                    copyValue(*nodeIter, *replicaNodeIter);
+        }
+    }
+
+    // averages the parameters of all replicas into the main network, and copies them back
+    auto averageParameters = [&]()
+    {
+        std::vector<std::list<ComputationNodeBasePtr>::const_iterator> replicaNodeIters;
+        for (const auto& replica : m_hogwildReplicas)
+            replicaNodeIters.push_back(replica->learnableNodes.begin());
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+        {
+            if ((*nodeIter)->IsParameterUpdateRequired())
+            {
+                auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+                for (const auto& replicaNodeIter : replicaNodeIters)
+                    Matrix<ElemType>::ScaleAndAdd(1, dynamic_pointer_cast<ComputationNode<ElemType>>(*replicaNodeIter)->Value(), value);
+                Matrix<ElemType>::Scale((ElemType) (1.0 / numReplicas), value);
+                (*nodeIter)->BumpEvalTimeStamp();
+                for (const auto& replicaNodeIter : replicaNodeIters)
+                {
+                    copyValue(*nodeIter, *replicaNodeIter);
+                    (*replicaNodeIter)->BumpEvalTimeStamp();
+                }
+            }
+            for (auto& replicaNodeIter : replicaNodeIters)
+                replicaNodeIter++;
+        }
+    };
+
+    std::vector<std::unique_ptr<ScopedNetworkOperationMode>> modeGuards;
+    modeGuards.emplace_back(new ScopedNetworkOperationMode(net, NetworkOperationMode::training));
+    for (const auto& replica : m_hogwildReplicas)
+        modeGuards.emplace_back(new ScopedNetworkOperationMode(replica->net, NetworkOperationMode::training));
+
+    trainSetDataReader->StartMinibatchLoop(tunedMBSize, epochNumber, inputMatrices->GetStreamDescriptions(), epochSize);
+
+    // the criteria of each replica, summed up at the end
+    std::vector<std::unique_ptr<CriterionAccumulator<ElemType>>> localEpochCriteria, localEpochEvalErrors;
+    for (size_t k = 0; k < numReplicas; k++)
+    {
+        const auto& replicaNet         = k == 0 ? net : m_hogwildReplicas[k - 1]->net;
+        const auto& replicaCriteria    = k == 0 ? criterionNodes : m_hogwildReplicas[k - 1]->criterionNodes;
+        const auto& replicaEvaluations = k == 0 ? evaluationNodes : m_hogwildReplicas[k - 1]->evaluationNodes;
+        replicaNet->StartEvaluateMinibatchLoop(replicaEvaluations);
+        replicaNet->StartEvaluateMinibatchLoop(replicaCriteria);
+        auto nodesWhichAccumulateResult = replicaNet->ExtractNodesWhichAccumulateResult(set<ComputationNodeBasePtr>(replicaEvaluations.begin(), replicaEvaluations.end()));
+        localEpochCriteria.emplace_back(new CriterionAccumulator<ElemType>(replicaCriteria, replicaNet->GetDeviceId()));
+        localEpochEvalErrors.emplace_back(new CriterionAccumulator<ElemType>(replicaEvaluations, replicaNet->GetDeviceId(),
+                                                                             { nodesWhichAccumulateResult.begin(), nodesWhichAccumulateResult.end() }));
+    }
+
+    const int numThreadsBefore = CPUMatrix<ElemType>::GetMaxNumThreads();
+    const int numThreadsPerReplica = max(1, numThreadsBefore / (int) numReplicas);
+    CPUMatrix<ElemType>::SetNumThreads(numThreadsPerReplica);
+
+    if (m_traceLevel > 0)
+    {
+        fprintf(stderr, "\n");
+        LOGPRINTF(stderr, "Starting minibatch loop, HogwildSGD training (%d replicas of %d threads, %s).\n",
+                  (int) numReplicas, numThreadsPerReplica,
+                  averaging ? msra::strfun::strprintf("averaged every %d minibatches", (int) m_hogwildSyncPeriod).c_str() : "shared parameters");
+    }
+
+    Timer timer;
+    timer.Start();
+
+    std::mutex readerMutex;
+    std::atomic<bool> endOfData(false);
+    size_t numMBsRun = 0;
+    while (!endOfData)
+    {
+        std::vector<size_t> numMBs(numReplicas, 0);
+        std::vector<std::exception_ptr> errors(numReplicas);
+        std::vector<std::thread> threads;
+        for (size_t k = 0; k < numReplicas; k++)
+        {
+            threads.emplace_back([&, k]()
+            {
+                try
+                {
+#ifdef _OPENMP
+                    omp_set_num_threads(numThreadsPerReplica); // (a new thread starts with the default)
+#endif
+                    const size_t maxNumMBs = averaging ? m_hogwildSyncPeriod : SIZE_MAX;
+                    if (k == 0)
+                        numMBs[k] = TrainHogwildReplica(net, epochNumber, learnRatePerSample, featureNodes, labelNodes, criterionNodes, evaluationNodes,
+                                                        *inputMatrices, learnableNodes, smoothedGradients, smoothedCounts,
+                                                        trainSetDataReader, readerMutex, endOfData, maxNumMBs, *localEpochCriteria[k], *localEpochEvalErrors[k]);
+                    else
+                    {
+                        auto& replica = *m_hogwildReplicas[k - 1];
+                        numMBs[k] = TrainHogwildReplica(replica.net, epochNumber, learnRatePerSample, replica.featureNodes, replica.labelNodes, replica.criterionNodes, replica.evaluationNodes,
+                                                        replica.inputMatrices, replica.learnableNodes, replica.smoothedGradients, replica.smoothedCounts,
+                                                        trainSetDataReader, readerMutex, endOfData, maxNumMBs, *localEpochCriteria[k], *localEpochEvalErrors[k]);
+                    }
+                }
+                catch (...)
+                {
+                    errors[k] = std::current_exception();
+                    endOfData = true; // stops the other threads
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        for (const auto& error : errors)
+        {
+            if (error)
+            {
+                CPUMatrix<ElemType>::SetNumThreads(numThreadsBefore);
+                std::rethrow_exception(error);
+            }
+        }
+
+        for (auto n : numMBs)
+            numMBsRun += n;
+        if (averaging)
+            averageParameters();
+    }
+
+    CPUMatrix<ElemType>::SetNumThreads(numThreadsBefore);
+    timer.Stop();
+
+    epochCriterion = EpochCriterion(0);
+    epochEvalErrors.assign(epochEvalErrors.size(), EpochCriterion(0));
+    for (size_t k = 0; k < numReplicas; k++)
+    {
+        epochCriterion += localEpochCriteria[k]->GetCriterion(0);
+        auto evalErrors = localEpochEvalErrors[k]->GetCriteria();
+        for (size_t i = 0; i < epochEvalErrors.size(); i++)
+            epochEvalErrors[i] += evalErrors[i];
+    }
+
+    if (m_traceLevel > 0)
+        LOGPRINTF(stderr, "HogwildSGD: %d minibatches of %d samples in %.3fs.\n",
+                  (int) numMBsRun, (int) epochCriterion.second, timer.ElapsedSeconds());
+
+    return numMBsRun;
+}
+
+// Trains one replica of TrainOneEpochHogwild() on minibatches of the shared reader, until there are no more or it has trained 'maxNumMBs'.
+// This is the minibatch loop of TrainOneEpoch(), without its parallelization, sub-minibatches and gradient accumulation.
+template <class ElemType>
+size_t SGD<ElemType>::TrainHogwildReplica(const ComputationNetworkPtr& net, const int epochNumber, const double learnRatePerSample,
+                                          const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                          const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                          const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                          const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                          StreamMinibatchInputs& inputMatrices,
+                                          const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                          std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                                          IDataReader* trainSetDataReader, std::mutex& readerMutex, std::atomic<bool>& endOfData, size_t maxNumMBs,
+                                          CriterionAccumulator<ElemType>& localEpochCriterion, CriterionAccumulator<ElemType>& localEpochEvalErrors)
+{
+    auto forwardPropRoots = evaluationNodes;
+    forwardPropRoots.push_back(criterionNodes[0]);
+    const std::vector<ComputationNodeBasePtr> parameterNodes(learnableNodes.begin(), learnableNodes.end());
+    const bool computeGradients = learnRatePerSample > 0.01 * m_minLearnRate;
+
+    size_t numMBs = 0;
+    while (numMBs < maxNumMBs)
+    {
+        // the reader hands out each minibatch once, into the input matrices of the replica that asked for it
+        size_t actualMBSize = 0;
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            if (endOfData)
+                break;
+            if (!DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNodes[0], /*useDistributedMBReading=*/false,
+                                                                       /*useParallelTrain=*/false, inputMatrices, actualMBSize, nullptr))
+            {
+                endOfData = true;
+                break;
+            }
+        }
+        numMBs++;
+        if (actualMBSize == 0)
+            continue;
+
+        MarkDropoutNodesEvalTimeStampAsOutdated(net, criterionNodes[0]);
+        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+        ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+        ComputationNetwork::BumpEvalTimeStamp(parameterNodes); // other threads may have changed them
+
+        net->ForwardProp(forwardPropRoots);
+        if (computeGradients)
+            net->Backprop(criterionNodes[0]);
+
+        size_t numSamplesWithLabelOfNetwork = net->GetNumSamplesWithLabelOfNetwork(actualMBSize);
+        localEpochCriterion.Add(0, numSamplesWithLabelOfNetwork);
+        for (size_t i = 0; i < evaluationNodes.size(); i++)
+            localEpochEvalErrors.Add(i, numSamplesWithLabelOfNetwork);
+
+        if (!computeGradients)
+            continue;
+
+        size_t numSamplesInMinibatch = actualMBSize;
+        if (criterionNodes[0]->HasMBLayout())
+            numSamplesInMinibatch = CriterionAccumulator<ElemType>::GetNumSamples(criterionNodes[0], numSamplesWithLabelOfNetwork);
+        if (numSamplesInMinibatch == 0)
+            continue;
+
+        const double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+        auto smoothedGradientIter = smoothedGradients.begin();
+        auto smoothedCountIter = smoothedCounts.begin();
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, smoothedCountIter++)
+        {
+            ComputationNodeBasePtr node = *nodeIter;
+            if (!node->IsParameterUpdateRequired())
+                continue;
+            double nodeDependentLearningRatePerSample = learnRatePerSample * node->GetLearningRateMultiplier();
+            double nodeDependentRegMultiplier = dynamic_pointer_cast<LearnableParameter<ElemType>>(node)->GetRegMultiplier();
+            UpdateWeights(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(),
+                          dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(),
+                          *smoothedGradientIter, *smoothedCountIter,
+                          nodeDependentLearningRatePerSample, momentumPerSample,
+                          numSamplesInMinibatch,
+                          m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier,
+                          m_needAveMultiplier, m_useNesterovMomentum);
+            node->BumpEvalTimeStamp();
+        }
+    }
+    return numMBs;
+}
+
 // -----------------------------------------------------------------------
 // subroutines and helpers follow below
 // -----------------------------------------------------------------------
@@ -1758,10 +2386,15 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // To support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions());
-    else // using only one epoch. Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), m_epochSize);
+    // With distributed reading, each worker accumulates the statistics of its part of the data, and they are combined at the end.
+    size_t requestedEpochSamples = m_useAllDataForPreComputedNode ? requestDataSize : m_epochSize;
+    bool useDistributedMBReading = m_mpi && m_mpi->NumNodesInUse() > 1 &&
+                                   m_enableDistributedMBReading &&
+                                   trainSetDataReader->SupportsDistributedMBRead();
+    if (useDistributedMBReading)
+        trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), inputMatrices->GetStreamDescriptions(), requestedEpochSamples);
+    else
+        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), requestedEpochSamples);
     net->StartEvaluateMinibatchLoop(nodes);
 
     // initialize
@@ -1771,7 +2404,7 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     const size_t numIterationsBeforePrintingProgress = 100;
     size_t numItersSinceLastPrintOfProgress = 0;
     size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy, m_mpi))
+    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, useDistributedMBReading, false, *inputMatrices, actualMBSizeDummy, m_mpi))
     {
         // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
@@ -1784,7 +2417,11 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
 
     // finalize
     for (auto & node : nodes)
+    {
+        if (useDistributedMBReading)
+            dynamic_pointer_cast<IPreComputeNode>(node)->AggregateAcrossWorkers(*m_mpi);
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true /*done accumulating*/);
+    }
 
     fprintf(stderr, "\n");
     LOGPRINTF(stderr, "Precomputing --> Completed.\n\n");
@@ -1827,9 +2464,49 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
         learnRatePerSample = largestPrevLearnRatePerSample / 0.618f / 0.618f;
     }
 
+    // the search starts from the model of the previous epoch, which may still be being written
+    WaitForPendingCheckpoint();
+
     int baseModelEpoch = epochNumber - 1;
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
+    // parallelSearch: trial 0 is the base trial below, trial k > 0 trains with the k-th learning rate of the descent below.
+    // They run in rounds of one trial per worker, whose criteria are kept until the search gets past them.
+    const bool parallelSearch = UsingParallelSearch();
+    const double initialLearnRatePerSample = learnRatePerSample;
+    vector<EpochCriterion> roundCriteria;
+    size_t roundBegin = 0;
+    auto parallelTrialCriterion = [&](size_t trial)
+    {
+        if (trial >= roundBegin + roundCriteria.size())
+        {
+            roundBegin = trial;
+            roundCriteria = RunSearchTrialsAcrossWorkers(m_mpi->NumNodesInUse(), [&](size_t k)
+            {
+                double trialLearnRatePerSample = 0;
+                if (roundBegin + k > 0)
+                {
+                    trialLearnRatePerSample = initialLearnRatePerSample;
+                    for (size_t j = 0; j < roundBegin + k; j++)
+                        trialLearnRatePerSample *= 0.618;
+                }
+                EpochCriterion trialCriterion;
+                vector<EpochCriterion> trialEvalErrors(evaluationNodes.size(), EpochCriterion::Infinity());
+                TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                                m_epochSize, trainSetDataReader,
+                                                trialLearnRatePerSample, m_mbSize[epochNumber], featureNodes,
+                                                labelNodes, criterionNodes,
+                                                evaluationNodes, inputMatrices,
+                                                learnableNodes, smoothedGradients, smoothedCounts,
+                                                /*out*/ trialCriterion, /*out*/ trialEvalErrors,
+                                                roundBegin + k == 0 ? "BaseAdaptiveLearnRateSearch:" : "AdaptiveLearnRateSearch:",
+                                                numFramesToUseInSearch);
+                return trialCriterion;
+            });
+        }
+        return roundCriteria[trial - roundBegin];
+    };
+
     double learnRate = learnRatePerSample;
     size_t dummyMinibatchSize;            // (not used)
     size_t dummyTotalTrainingSamplesSeen; // (not used)
@@ -1845,15 +2522,18 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     // if model is not changed this is what we will get
     EpochCriterion baseCriterion;
     vector<EpochCriterion> epochEvalErrors(evaluationNodes.size(), EpochCriterion::Infinity()); // these are ignored in this entire method
-    TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
-                                    m_epochSize, trainSetDataReader, 0, m_mbSize[epochNumber],
-                                    featureNodes, labelNodes,
-                                    criterionNodes, evaluationNodes,
-                                    inputMatrices, learnableNodes,
-                                    smoothedGradients, smoothedCounts,
-                                    /*out*/ baseCriterion, /*out*/ epochEvalErrors,
-                                    "BaseAdaptiveLearnRateSearch:",
-                                    numFramesToUseInSearch);
+    if (parallelSearch)
+        baseCriterion = parallelTrialCriterion(0);
+    else
+        TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                        m_epochSize, trainSetDataReader, 0, m_mbSize[epochNumber],
+                                        featureNodes, labelNodes,
+                                        criterionNodes, evaluationNodes,
+                                        inputMatrices, learnableNodes,
+                                        smoothedGradients, smoothedCounts,
+                                        /*out*/ baseCriterion, /*out*/ epochEvalErrors,
+                                        "BaseAdaptiveLearnRateSearch:",
+                                        numFramesToUseInSearch);
 
     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch)
     {
@@ -1870,23 +2550,28 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     }
 
     EpochCriterion epochCriterion(EpochCriterion::Infinity());
+    size_t numDescentTrials = 0;
     do
     {
         learnRatePerSample *= 0.618;
-        TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
-                                        m_epochSize, trainSetDataReader,
-                                        learnRatePerSample, m_mbSize[epochNumber], featureNodes,
-                                        labelNodes, criterionNodes,
-                                        evaluationNodes, inputMatrices,
-                                        learnableNodes, smoothedGradients, smoothedCounts,
-                                        /*out*/ epochCriterion, /*out*/ epochEvalErrors,
-                                        "AdaptiveLearnRateSearch:",
-                                        numFramesToUseInSearch);
+        if (parallelSearch)
+            epochCriterion = parallelTrialCriterion(++numDescentTrials);
+        else
+            TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                            m_epochSize, trainSetDataReader,
+                                            learnRatePerSample, m_mbSize[epochNumber], featureNodes,
+                                            labelNodes, criterionNodes,
+                                            evaluationNodes, inputMatrices,
+                                            learnableNodes, smoothedGradients, smoothedCounts,
+                                            /*out*/ epochCriterion, /*out*/ epochEvalErrors,
+                                            "AdaptiveLearnRateSearch:",
+                                            numFramesToUseInSearch);
     } while (epochCriterion.IsNan() || (epochCriterion.Average() > baseCriterion.Average() && learnRatePerSample > minLearnRate));
 
     bestLearnRatePerSample = learnRatePerSample;
 
     // grid search for the first m_numBestSearchEpoch  epochs
+    // (Each step depends on the previous one, so this runs one trial after another also with parallelSearch.)
     if (epochNumber < m_numBestSearchEpoch)
     {
         double leftLearnRatePerSample = 0.01 / m_mbSize[epochNumber];
@@ -2089,6 +2774,9 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
         return maxMinibatchSize;
     }
 
+    // the trials revert to the model of the previous epoch, which may still be being written
+    WaitForPendingCheckpoint();
+
     size_t trialMinibatchSize = 0;
     bool isFirstIteration = true;
     EpochCriterion baseCriterion(0);
@@ -2099,14 +2787,25 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
     LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Evaluating minibatchSizes %d..%d\n",
         (int)epochNumber + 1, (int)RoundToMultipleOf64(minMinibatchSize), (int)RoundToMultipleOf64(maxMinibatchSize));
 
-    size_t lastGoodMinibatchSize = 0;
-    EpochCriterion lastGoodEpochCriterion(0);
+    vector<size_t> trialMinibatchSizes;
     for (float trialMinibatchSizeFloat = (float) minMinibatchSize;
          trialMinibatchSizeFloat <= maxMinibatchSize;
          trialMinibatchSizeFloat *= minibatchSizeTuningFactor)
     {
         // round mbsize to something meaningful
-        trialMinibatchSize = RoundToMultipleOf64(trialMinibatchSizeFloat);
+        trialMinibatchSizes.push_back(RoundToMultipleOf64(trialMinibatchSizeFloat));
+    }
+
+    // parallelSearch: the trials run in rounds of one per worker, whose criteria are kept until the search gets past them
+    const bool parallelSearch = UsingParallelSearch();
+    vector<EpochCriterion> roundCriteria;
+    size_t roundBegin = 0;
+
+    size_t lastGoodMinibatchSize = 0;
+    EpochCriterion lastGoodEpochCriterion(0);
+    for (size_t trial = 0; trial < trialMinibatchSizes.size(); trial++)
+    {
+        trialMinibatchSize = trialMinibatchSizes[trial];
         if (m_traceLevel > 0)
         {
             LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Evaluating trial minibatchSize=%d (search range: %d..%d)...\n",
@@ -2117,15 +2816,40 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
 
         // Train on a few minibatches and so we can observe the epochCriterion as we try increasing
         // minibatches with iteration of this loop.
-        TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
-                                        m_epochSize, trainSetDataReader,
-                                        learnRatePerSample, trialMinibatchSize, featureNodes,
-                                        labelNodes, criterionNodes,
-                                        evaluationNodes, inputMatrices,
-                                        learnableNodes, smoothedGradients, smoothedCounts,
-                                        /*out*/ epochCriterion, /*out*/ epochEvalErrors,
-                                        isFirstIteration ? "BaseAdaptiveMinibatchSearch:" : "AdaptiveMinibatchSearch:",
-                                        numFramesToUseInSearch);
+        if (parallelSearch)
+        {
+            if (trial >= roundBegin + roundCriteria.size())
+            {
+                roundBegin = trial;
+                size_t numTrials = min(m_mpi->NumNodesInUse(), trialMinibatchSizes.size() - trial);
+                roundCriteria = RunSearchTrialsAcrossWorkers(numTrials, [&](size_t k)
+                {
+                    EpochCriterion trialCriterion;
+                    vector<EpochCriterion> trialEvalErrors(evaluationNodes.size(), EpochCriterion::Infinity());
+                    TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                                    m_epochSize, trainSetDataReader,
+                                                    learnRatePerSample, trialMinibatchSizes[roundBegin + k], featureNodes,
+                                                    labelNodes, criterionNodes,
+                                                    evaluationNodes, inputMatrices,
+                                                    learnableNodes, smoothedGradients, smoothedCounts,
+                                                    /*out*/ trialCriterion, /*out*/ trialEvalErrors,
+                                                    roundBegin + k == 0 ? "BaseAdaptiveMinibatchSearch:" : "AdaptiveMinibatchSearch:",
+                                                    numFramesToUseInSearch);
+                    return trialCriterion;
+                });
+            }
+            epochCriterion = roundCriteria[trial - roundBegin];
+        }
+        else
+            TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                            m_epochSize, trainSetDataReader,
+                                            learnRatePerSample, trialMinibatchSize, featureNodes,
+                                            labelNodes, criterionNodes,
+                                            evaluationNodes, inputMatrices,
+                                            learnableNodes, smoothedGradients, smoothedCounts,
+                                            /*out*/ epochCriterion, /*out*/ epochEvalErrors,
+                                            isFirstIteration ? "BaseAdaptiveMinibatchSearch:" : "AdaptiveMinibatchSearch:",
+                                            numFramesToUseInSearch);
 
         if (isFirstIteration)
         {
@@ -2155,7 +2879,7 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
         {
             lastGoodMinibatchSize = trialMinibatchSize;
             lastGoodEpochCriterion = epochCriterion;
-            if (m_traceLevel > 0 && trialMinibatchSizeFloat * minibatchSizeTuningFactor <= maxMinibatchSize)
+            if (m_traceLevel > 0 && trial + 1 < trialMinibatchSizes.size())
             {
                 LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Keep searching... epochCriterion = %.8f vs. baseCriterion = %.8f\n",
                           (int)epochNumber+1, epochCriterion.Average(), baseCriterion.Average());
@@ -2170,6 +2894,41 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
     return lastGoodMinibatchSize;
 }
 
+template <class ElemType>
+vector<EpochCriterion> SGD<ElemType>::RunSearchTrialsAcrossWorkers(size_t numTrials, const function<EpochCriterion(size_t trial)>& runTrial)
+{
+    assert(numTrials <= m_mpi->NumNodesInUse());
+
+    // aggregate value and sample count of each trial, set by the worker that runs it and summed across the workers
+    vector<double> trialResults(2 * numTrials, 0.0);
+    size_t trial = m_mpi->CurrentNodeRank();
+    if (trial < numTrials)
+    {
+        // without m_mpi, TrainOneEpoch() neither distributes the reading nor aggregates anything across the workers
+        auto mpi = m_mpi;
+        m_mpi = nullptr;
+        EpochCriterion trialCriterion;
+        try
+        {
+            trialCriterion = runTrial(trial);
+        }
+        catch (...)
+        {
+            m_mpi = mpi;
+            throw;
+        }
+        m_mpi = mpi;
+        trialResults[2 * trial]     = trialCriterion.first;
+        trialResults[2 * trial + 1] = (double) trialCriterion.second;
+    }
+    m_mpi->AllReduce(trialResults);
+
+    vector<EpochCriterion> trialCriteria;
+    for (size_t k = 0; k < numTrials; k++)
+        trialCriteria.push_back(EpochCriterion(trialResults[2 * k], (size_t) trialResults[2 * k + 1]));
+    return trialCriteria;
+}
+
 // run training over a small subset of an epoch, used by automatic LR and MB-size tuning
 template <class ElemType>
 void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
@@ -2283,15 +3042,171 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
     {
         if (traceLevel > 0)
             fprintf(stderr, "Initializing dataParallelSGD with FP%d aggregation.\n", numGradientBits);
-        if (Globals::UseV2Aggregator()) // Currently used to check V2 against baselines.
+        if (m_topKGradientFraction > 0)
+            m_distGradAgg = std::make_shared<TopKDistGradAggregator<ElemType>>(m_mpi, m_topKGradientFraction, m_sparseGradientMinSizeInBytes, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes,
+                                                                                  m_sparseGradientDensityThreshold);
+        else if (Globals::UseV2Aggregator()) // Currently used to check V2 against baselines.
             m_distGradAgg = std::make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, ::CNTK::MPICommunicator(m_packThresholdSizeInBytes));
         else
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes);
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes, m_gradientBucketSizeInBytes,
+                                                                                    m_sparseGradientDensityThreshold);
     }
 
     m_gradHeader.reset(DistGradHeader::Create(numEvalNodes), [](DistGradHeader* ptr) { DistGradHeader::Destroy(ptr); });
 }
 
+template <class ElemType>
+void SGD<ElemType>::EnableElasticTraining()
+{
+    if (!m_mpi->EnableFaultTolerance())
+        RuntimeError("elasticTraining requires an MPI library with the ULFM fault tolerance extension (MPIX_Comm_shrink).");
+
+    if (!m_elasticJoin && m_mpi->IsMainNode() && !m_elasticPortFile.empty())
+        PublishElasticPort();
+}
+
+template <class ElemType>
+void SGD<ElemType>::PublishElasticPort()
+{
+    m_elasticPortName = m_mpi->OpenPort();
+
+    // write under a temporary name first, so that a joining worker never reads a partial port name
+    wstring tmpPortFile = m_elasticPortFile + L".tmp";
+    FILE* f = fopenOrDie(tmpPortFile, L"wb");
+    fprintfOrDie(f, "%s\n", m_elasticPortName.c_str());
+    fcloseOrDie(f);
+    renameOrDie(tmpPortFile, m_elasticPortFile);
+    LOGPRINTF(stderr, "Elastic training: replacement workers can join through %ls.\n", m_elasticPortFile.c_str());
+}
+
+// Connects to the running workers; they admit this worker at their next epoch boundary (AdmitReplacementWorkers()).
+template <class ElemType>
+void SGD<ElemType>::JoinRunningWorkers()
+{
+    if (m_mpi->IsMainNode())
+    {
+        LOGPRINTF(stderr, "Elastic training: waiting for the port of the running workers in %ls.\n", m_elasticPortFile.c_str());
+        while (!fexists(m_elasticPortFile))
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        FILE* f = fopenOrDie(m_elasticPortFile, L"rb");
+        m_elasticPortName = fgetline(f);
+        fcloseOrDie(f);
+
+        // request the admission
+        fcloseOrDie(fopenOrDie(m_elasticPortFile + L".join", L"wb"));
+    }
+
+    m_mpi->JoinNodes(m_elasticPortName); // (the port name is only used at the main node)
+    m_elasticPortName.clear();           // the port stays with the main node of the running workers
+}
+
+template <class ElemType>
+bool SGD<ElemType>::AdmitReplacementWorkers()
+{
+    // the main node decides for all workers, as accepting is collective
+    wstring joinFile = m_elasticPortFile + L".join";
+    size_t joinRequested = (m_mpi->IsMainNode() && !m_elasticPortName.empty() && fexists(joinFile)) ? 1 : 0;
+    m_mpi->Bcast(&joinRequested, 1, m_mpi->MainNodeRank());
+    if (!joinRequested)
+        return false;
+
+    m_mpi->AcceptNodes(m_elasticPortName);
+    if (m_mpi->IsMainNode())
+        _wunlink(joinFile.c_str());
+    return true;
+}
+
+// Gives all workers the state of the main node, at an epoch boundary.
+template <class ElemType>
+void SGD<ElemType>::BroadcastTrainingState(int& epoch, double& learnRatePerSample, double& prevCriterion,
+                                           size_t& totalTrainingSamplesSeen, size_t& totalMBsSeen,
+                                           const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                           std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts)
+{
+    vector<double> state = { (double)epoch, learnRatePerSample, prevCriterion, (double)m_prevChosenMinibatchSize,
+                             (double)totalTrainingSamplesSeen, (double)totalMBsSeen };
+    m_mpi->Bcast(state.data(), state.size(), m_mpi->MainNodeRank());
+    epoch                    = (int)state[0];
+    learnRatePerSample       = state[1];
+    prevCriterion            = state[2];
+    m_prevChosenMinibatchSize = (size_t)state[3];
+    totalTrainingSamplesSeen = (size_t)state[4];
+    totalMBsSeen             = (size_t)state[5];
+
+    BroadcastModel(learnableNodes, smoothedGradients, smoothedCounts);
+}
+
+template <class ElemType>
+void SGD<ElemType>::BroadcastModel(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                   std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts)
+{
+    auto broadcast = [this](Matrix<ElemType>& mat)
+    {
+        if (mat.GetNumElements() == 0)
+            return;
+        unique_ptr<ElemType[]> px(mat.CopyToArray());
+        m_mpi->Bcast(px.get(), mat.GetNumElements(), m_mpi->MainNodeRank());
+        mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), px.get());
+    };
+
+    for (auto& node : learnableNodes)
+        broadcast(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value());
+    for (auto& smoothedGradient : smoothedGradients)
+        broadcast(smoothedGradient);
+    m_mpi->Bcast(smoothedCounts.data(), smoothedCounts.size(), m_mpi->MainNodeRank());
+}
+
+template <class ElemType>
+void SGD<ElemType>::RecoverFromWorkerFailure(int epochNumber, const ComputationNetworkPtr& net, IDataReader* trainSetDataReader,
+                                             bool useDistributedMBReading, size_t tunedMBSize, size_t epochSize,
+                                             StreamMinibatchInputs* inputMatrices, size_t numEvalNodes,
+                                             const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                             std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts)
+{
+    m_mpi->RecoverFromFailure();
+    InitDistGradAgg((int)numEvalNodes, m_numGradientBits[epochNumber], net->GetDeviceId(), m_traceLevel);
+
+    // Some workers may have updated the model with the failed minibatch already, all continue with the main node's.
+    BroadcastModel(learnableNodes, smoothedGradients, smoothedCounts);
+
+    // The rest of the epoch is read by the remaining workers.
+    if (useDistributedMBReading)
+    {
+        size_t samplePosition = trainSetDataReader->GetCurrentSamplePosition();
+        m_mpi->Bcast(&samplePosition, 1, m_mpi->MainNodeRank());
+        trainSetDataReader->StartDistributedMinibatchLoop(tunedMBSize, epochNumber, m_mpi->CurrentNodeRank(),
+            m_mpi->NumNodesInUse(), inputMatrices->GetStreamDescriptions(), epochSize);
+        trainSetDataReader->SetCurrentSamplePosition(samplePosition);
+    }
+
+    // the failed worker may have been the main node, which keeps the port for the replacement workers
+    if (m_mpi->IsMainNode() && m_elasticPortName.empty() && !m_elasticPortFile.empty())
+        PublishElasticPort();
+}
+
+// The workers wait in the aggregation for the one that takes longest to get there, as long as it takes longer.
+// secondsToAggregation is the time of the current worker from the start of the minibatch, which includes reading it.
+template <class ElemType>
+void SGD<ElemType>::ReportStragglers(int numMBsRun, double secondsToAggregation, std::vector<size_t>& numTimesSlowest)
+{
+    size_t numWorkers = m_mpi->NumNodesInUse();
+    std::vector<double> secondsOfWorkers(numWorkers);
+    m_mpi->Gather(&secondsToAggregation, 1, secondsOfWorkers.data(), 1, m_mpi->MainNodeRank());
+    if (!m_mpi->IsMainNode())
+        return;
+
+    size_t slowest = std::max_element(secondsOfWorkers.begin(), secondsOfWorkers.end()) - secondsOfWorkers.begin();
+    double slowestSeconds = secondsOfWorkers[slowest];
+    std::nth_element(secondsOfWorkers.begin(), secondsOfWorkers.begin() + numWorkers / 2, secondsOfWorkers.end());
+    double medianSeconds = secondsOfWorkers[numWorkers / 2];
+    numTimesSlowest.resize(std::max(numTimesSlowest.size(), numWorkers));
+    numTimesSlowest[slowest]++;
+
+    LOGPRINTF(stderr, "Stragglers: minibatch %d: worker %d is the slowest, %.3f ms to the aggregation, the median worker waits %.3f ms for it.\n",
+              numMBsRun + 1, (int)slowest, slowestSeconds * 1000, (slowestSeconds - medianSeconds) * 1000);
+}
+
 template <class ElemType>
 void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE devID)
 {
@@ -2299,10 +3214,22 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
     {
         return; // no need to do anything if already initialized. TODO: make it singleton 
     }
-    if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
+    if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD && m_pipelinedModelAggregation)
+    {
+        m_pMASGDHelper = make_shared<PipelinedModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID);
+    }
+    else if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
     {
         m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID);
     }
+    else if (GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD && m_pipelinedModelAggregation)
+    {
+        m_pMASGDHelper = make_shared<PipelinedModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID,
+            m_blockLearningRate,
+            PipelinedModelAveragingSGD<ElemType>::TimeConstant2Momentum(m_blockMomentumAsTimeConstant, m_modelAggregationBlockSize),
+            m_useNesterovBlockMomentum,
+            m_resetSGDMomentum);
+    }
     else if (GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD)
     {
 #ifndef CNTK_PARALLEL_TRAINING_SUPPORT
@@ -2409,7 +3336,7 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
         smoothedGradientValues.FSAdagradUpdate(actualMBSize,
                                          gradientValues, functionValues, smoothedCount,
                                          learnRatePerSample, m_gradType.targetAdagradAvDenom,
-                                         momentum, varMomentum);
+                                         momentum, varMomentum, /*unitGainMomentum=*/true, m_lazySparseUpdate);
     }
     else if (adpType == GradientsUpdateType::RmsProp)
     {
@@ -2436,6 +3363,84 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
 #endif
 }
 
+template <class ElemType>
+void SGD<ElemType>::MultiTensorUpdateWeights(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients,
+                                             const double learnRatePerSample, const double momentumPerSample, size_t actualMBSize,
+                                             std::set<ComputationNodeBasePtr>& updatedNodes) const
+{
+    // clipping by truncation and noise are not part of the multi-tensor update
+    const bool clip = m_clippingThresholdPerSample != numeric_limits<double>::infinity();
+    if (GradUpdateType() != GradientsUpdateType::None || GradientUpdateNoiseStd() > 0 || (clip && m_gradientClippingWithTruncation))
+        return;
+
+    std::map<DEVICEID_TYPE, std::vector<MultiTensorItem<ElemType>>> items;
+    std::map<DEVICEID_TYPE, std::vector<ComputationNodeBasePtr>> nodes;
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+    {
+        const ComputationNodeBasePtr& node = *nodeIter;
+        if (!node->IsParameterUpdateRequired())
+            continue;
+
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        auto& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+        const DEVICEID_TYPE deviceId = value.GetDeviceId();
+        const size_t numElements = value.GetNumElements();
+        if (!value.IsMultiTensorOperand(deviceId) || !gradient.IsMultiTensorOperand(deviceId) || !smoothedGradientIter->IsMultiTensorOperand(deviceId) ||
+            gradient.GetNumElements() != numElements || smoothedGradientIter->GetNumElements() != numElements)
+            continue;
+
+        const double L2RegWeight = m_L2RegWeight * dynamic_pointer_cast<LearnableParameter<ElemType>>(node)->GetRegMultiplier();
+        MultiTensorItem<ElemType> item = {};
+        item.value = value.Data();
+        item.gradient = gradient.Data();
+        item.smoothedGradient = smoothedGradientIter->Data();
+        item.numElements = numElements;
+        item.gradientScale = 1;
+        item.l2Weight = (ElemType)(L2RegWeight > 0 ? L2RegWeight * actualMBSize : 0);
+        item.learnRatePerSample = (ElemType)(learnRatePerSample * node->GetLearningRateMultiplier());
+        item.adaMul = 1;
+        items[deviceId].push_back(item);
+        nodes[deviceId].push_back(node);
+    }
+
+    const double momentum = MomentumPerMB(momentumPerSample, actualMBSize);
+    const double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
+    for (auto& deviceItems : items)
+    {
+        // ClipGradient() by the norm, with the norms of all gradients of the device from one launch
+        if (clip)
+        {
+            std::vector<double> sumsOfSquares;
+            Matrix<ElemType>::MultiTensorSumOfSquares(deviceItems.first, deviceItems.second, sumsOfSquares);
+            for (size_t k = 0; k < sumsOfSquares.size(); k++)
+            {
+                const double gradientNorm = sqrt(sumsOfSquares[k]);
+                if (gradientNorm > maxGradientPerMB)
+                    deviceItems.second[k].gradientScale = (ElemType)(maxGradientPerMB / gradientNorm);
+            }
+        }
+
+        // with flat parameter buffers, the parameters with the same learning rate and regularization are updated as one
+        const auto type = m_useNesterovMomentum ? MultiTensorUpdateType::NesterovMomentumSGD : MultiTensorUpdateType::MomentumSGD;
+        MultiTensorItem<ElemType>::Coalesce(deviceItems.second, type);
+        Matrix<ElemType>::MultiTensorUpdate(deviceItems.first, type, deviceItems.second, (ElemType) momentum, 0, /*unitGainMomentum=*/true);
+
+        for (const auto& node : nodes[deviceItems.first])
+        {
+            // L1 regularizer with proximal gradient descent method
+            const double L1RegWeight = m_L1RegWeight * dynamic_pointer_cast<LearnableParameter<ElemType>>(node)->GetRegMultiplier();
+            if (L1RegWeight > 0)
+            {
+                const double nodeDependentLearningRatePerSample = learnRatePerSample * node->GetLearningRateMultiplier();
+                dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().InplaceSoftThreshold((ElemType)(nodeDependentLearningRatePerSample * L1RegWeight * actualMBSize));
+            }
+            node->BumpEvalTimeStamp();
+            updatedNodes.insert(node);
+        }
+    }
+}
+
 // protected:
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
@@ -2524,8 +3529,11 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
             if (m_pMASGDHelper)
                 m_pMASGDHelper->SaveToCheckPoint(fstream);
-            // Ensuring that data is written
-            fstream.Flush();
+            // Ensuring that data is written (through to the disk when written in the background, see asyncCheckpointing)
+            if (m_asyncCheckpointing)
+                fstream.Sync();
+            else
+                fstream.Flush();
         }
 
         _wunlink(checkPointFileName.c_str());
@@ -2533,6 +3541,16 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
     }
 }
 
+template <class ElemType>
+void SGD<ElemType>::WaitForPendingCheckpoint()
+{
+    if (!m_asyncCheckpointing)
+        return;
+    if (m_pendingCheckpoint.valid())
+        m_pendingCheckpoint.get(); // (rethrows an error of the background write)
+    SynchronizeWorkers();          // the other workers wait for the main one, which writes
+}
+
 template <class ElemType>
 bool SGD<ElemType>::TryLoadCheckPointInfo(const size_t epochNumber,
                                           /*out*/ size_t& totalSamplesSeen,
@@ -2855,7 +3873,6 @@ static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
     else InvalidArgument("autoAdjustLR: Invalid learning rate search type. Valid values are (none | searchBeforeEpoch | adjustAfterEpoch)");
 }
   
-#ifdef ASGD_PARALLEL_SUPPORT
 static AdjustLearningRateAtBeginning AdjustLearningRateAtBeginningType(const wstring& s)
 {
     if      (EqualCI(s.c_str(), L"") || EqualCI(s.c_str(), L"none")) return AdjustLearningRateAtBeginning::None;
@@ -2863,7 +3880,6 @@ static AdjustLearningRateAtBeginning AdjustLearningRateAtBeginningType(const wst
     else if (EqualCI(s.c_str(), L"staircase"))                       return AdjustLearningRateAtBeginning::Staircase;
     else InvalidArgument("AdjustLearningRateatBeginningType: Invalid Type. Valid values are (None | Linearly | Staircase)");
 }
-#endif
   
 template<class ConfigRecordType>
 SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
@@ -2890,6 +3906,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_minibatchSizeTuningFrequency = configAALR(L"minibatchSizeTuningFrequency", (size_t) 1);
     m_minibatchSizeTuningMax = configAALR(L"minibatchSizeTuningMax", (size_t) 1048576);
     m_minibatchSearchCriterionErrorMargin = configAALR(L"minibatchSearchCriterionErrorMargin", (size_t) 1);
+    m_parallelSearch = configAALR(L"parallelSearch", false);
 
     m_numPrevLearnRates = configAALR(L"numPrevLearnRates", (size_t) 5);
     m_numBestSearchEpoch = configAALR(L"numBestSearchEpoch", (size_t) 1);
@@ -2904,6 +3921,13 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_truncated = configSGD(L"truncated", false);
     m_maxSamplesInRAM = configSGD(L"maxSamplesInRAM", (size_t) SIZE_MAX);
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
+    m_gradientAccumulationSteps = configSGD(L"gradientAccumulationSteps", (size_t) 1);
+    if (m_gradientAccumulationSteps == 0)
+        InvalidArgument("gradientAccumulationSteps must be at least 1.");
+    m_memoryBudgetMB = configSGD(L"memoryBudgetMB", (size_t) 0);
+    m_capMinibatchSizeToMemory = configSGD(L"capMinibatchSizeToMemory", false);
+    m_cvMinibatchSize = configSGD(L"cvMinibatchSize", (size_t) 0);
+    m_shardedValidation = configSGD(L"shardedValidation", false);
 
     m_packThresholdSizeInBytes = configSGD(L"packThresholdSizeInKB", DEFAULT_PACK_THRESHOLD_SIZE_IN_KB) * 1024;
 
@@ -2964,6 +3988,9 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
+    m_multiTensorUpdate = configSGD(L"multiTensorUpdate", false);
+    m_flatParameterBuffers = configSGD(L"flatParameterBuffers", false);
+    m_lazySparseUpdate = configSGD(L"lazySparseUpdate", false);
 
     // sequence-training parameters
     m_hSmoothingWeight = configSGD(L"hSmoothingWeight", 0.95);
@@ -3118,9 +4145,49 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = vector<int>{8 * (int)sizeofElemType}; // means no quantization
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientBucketSizeInBytes = 0;
+    m_sparseGradientDensityThreshold = DEFAULT_SPARSE_GRADIENT_DENSITY_THRESHOLD;
+    m_topKGradientFraction = 0;
+    m_sparseGradientMinSizeInBytes = 0;
+    m_elasticTraining = false;
+    m_elasticJoin = false;
+    m_isAsyncBufferEnabled = false;
+    m_isSimulateMA = false;
+    m_adjustLearningRateAtBeginning = AdjustLearningRateAtBeginning::None;
+    m_adjustCoefficient = 0.1;
+    m_adjustPerMinibatches = 256;
+    m_useBuiltinParameterServer = false;
+    m_maxStaleness = -1;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
+    m_pipelinedModelAggregation = false;
+
+    m_pipelineDevices.clear();
+    m_numMicroBatches = 1;
+    if (configSGD.Exists(L"ModelParallelSGD"))
+    {
+        const ConfigRecordType& configModelParallelSGD(configSGD(L"ModelParallelSGD", ConfigRecordType::Record()));
+        intargvector devices = configModelParallelSGD(L"devices", ConfigRecordType::Array(intargvector(vector<int>{})));
+        for (size_t i = 0; i < devices.size(); i++)
+            m_pipelineDevices.push_back((DEVICEID_TYPE)devices[i]);
+        if (m_pipelineDevices.size() < 2)
+            InvalidArgument("ModelParallelSGD needs at least two devices.");
+        m_numMicroBatches = configModelParallelSGD(L"numMicroBatches", m_pipelineDevices.size());
+        if (m_numMicroBatches == 0)
+            InvalidArgument("numMicroBatches must be at least 1.");
+    }
+
+    m_numHogwildReplicas = 1;
+    m_hogwildSyncPeriod = 0;
+    if (configSGD.Exists(L"HogwildSGD"))
+    {
+        const ConfigRecordType& configHogwildSGD(configSGD(L"HogwildSGD", ConfigRecordType::Record()));
+        m_numHogwildReplicas = configHogwildSGD(L"numReplicas", (size_t) 0);
+        if (m_numHogwildReplicas < 2)
+            InvalidArgument("HogwildSGD needs numReplicas of at least 2.");
+        m_hogwildSyncPeriod = configHogwildSGD(L"syncPeriod", (size_t) 0);
+    }
 
     if (configSGD.Exists(L"ParallelTrain"))
     {
@@ -3151,6 +4218,24 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", ConfigRecordType::Array(intargvector(vector<int>{defaultGradientBits})));
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            if (configDataParallelSGD(L"overlapGradientAggregation", false))
+                m_gradientBucketSizeInBytes = (size_t)(configDataParallelSGD(L"gradientBucketSizeInMB", 25.0) * 1024 * 1024);
+            m_sparseGradientDensityThreshold = configDataParallelSGD(L"sparseGradientDensityThreshold", DEFAULT_SPARSE_GRADIENT_DENSITY_THRESHOLD);
+            if (m_sparseGradientDensityThreshold < 0)
+                InvalidArgument("sparseGradientDensityThreshold must not be negative.");
+            m_topKGradientFraction = configDataParallelSGD(L"topKGradientFraction", 0.0);
+            m_sparseGradientMinSizeInBytes = (size_t)(configDataParallelSGD(L"sparseGradientMinSizeInKB", 256.0) * 1024);
+            if (m_topKGradientFraction < 0 || m_topKGradientFraction > 1)
+                InvalidArgument("topKGradientFraction must be in the range [0, 1].");
+            if (m_topKGradientFraction > 0 && m_gradientBucketSizeInBytes > 0)
+                InvalidArgument("topKGradientFraction cannot be combined with overlapGradientAggregation.");
+            m_elasticTraining = configDataParallelSGD(L"elasticTraining", false);
+            m_elasticPortFile = msra::strfun::utf16(configDataParallelSGD(L"elasticPortFile", L""));
+            m_elasticJoin = configDataParallelSGD(L"elasticJoin", false);
+            if (m_elasticTraining && (m_bufferedAsyncGradientAggregation || m_gradientBucketSizeInBytes > 0))
+                InvalidArgument("elasticTraining cannot be combined with useBufferedAsyncGradientAggregation or overlapGradientAggregation.");
+            if (m_elasticJoin && (!m_elasticTraining || m_elasticPortFile.empty()))
+                InvalidArgument("elasticJoin requires elasticTraining and elasticPortFile.");
             for (size_t i = 0; i < m_numGradientBits.size(); i++)
             {
                 if (m_numGradientBits[i] < 1 || m_numGradientBits[i] > defaultGradientBits)
@@ -3189,6 +4274,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 fprintf(stderr, "WARNING: option syncPeroid in ModelAveragingSGD is going to be deprecated. Please use blockSizePerWorker instead in the future.\n");
             }
 #endif
+            m_pipelinedModelAggregation = configMASGD(L"pipelined", false);
         }
         if (configParallelTrain.Exists(L"BlockMomentumSGD"))
         {
@@ -3220,6 +4306,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_resetSGDMomentum = configBMSGD(L"resetSGDMomentum", true);
             m_useNesterovBlockMomentum = configBMSGD(L"useNesterovMomentum", true);
             m_blockLearningRate = configBMSGD(L"blockLearningRate", 1.0); 
+            m_pipelinedModelAggregation = configBMSGD(L"pipelined", false);
 
             if (configBMSGD.Exists(L"blockMomentumPerSync") && configBMSGD.Exists(L"blockMomentumAsTimeConstant"))
             {
@@ -3246,10 +4333,23 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
         if (configParallelTrain.Exists(L"DataParallelASGD"))
         {
-#ifndef ASGD_PARALLEL_SUPPORT
-            InvalidArgument("DataParallelASGD is not enabled in this version.\n");
-#else
             const ConfigRecordType & configDataParallelASGD(configParallelTrain(L"DataParallelASGD", ConfigRecordType::Record()));
+#ifdef ASGD_PARALLEL_SUPPORT
+            wstring parameterServer = configDataParallelASGD(L"parameterServer", L"multiverso");
+#else
+            wstring parameterServer = configDataParallelASGD(L"parameterServer", L"builtin");
+#endif
+            if (EqualCI(parameterServer, L"builtin"))
+                m_useBuiltinParameterServer = true;
+            else if (!EqualCI(parameterServer, L"multiverso"))
+                InvalidArgument("parameterServer: Invalid value. Valid values are (builtin | multiverso)");
+#ifndef ASGD_PARALLEL_SUPPORT
+            else
+                InvalidArgument("DataParallelASGD with parameterServer=multiverso is not enabled in this version.\n");
+#endif
+            m_maxStaleness = configDataParallelASGD(L"maxStaleness", (int)-1);
+            if (m_maxStaleness < -1)
+                InvalidArgument("maxStaleness must be -1 (no bound) or a number of syncs >= 0.");
             m_nSyncSamplesPerWorker = configDataParallelASGD(L"syncPeriodPerWorker", ConfigRecordType::Array(intargvector(vector<int>{256})));
 #if 1       // legacy option
             if (configDataParallelASGD.Exists(L"syncPeriod"))
@@ -3269,7 +4369,6 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 m_adjustCoefficient = configAdjustLearningRateAtBeginning(L"adjustCoefficient", (double)0.1);
                 m_adjustPerMinibatches = configAdjustLearningRateAtBeginning(L"adjustPerMinibatches", (size_t)256);
             }
-#endif
         }
         } // if (!pMPI)
     } // if (configSGD.Exists(L"ParallelTrain"))
@@ -21,6 +21,10 @@
 #include "MASGD.h"
 #include "ASGDHelper.h"
 #include <map>
+#include <set>
+#include <future>
+#include <mutex>
+#include <atomic>
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
 #define CNTK_CHECKPOINT_VERSION_1 1     // 1 -> no version number 
@@ -69,7 +73,7 @@ enum class ParallelizationMethod : int
     modelAveragingSGD = 2,
     blockMomentumSGD = 3,
     dataParallelASGD = 4,
-    modelParallelSGD = (1 << 8) // Currently unsupported
+    modelParallelSGD = (1 << 8) // pipeline stages on the GPUs of one process, see GetModelParallelizationMethod()
 };
 
 // configuration parameters associated with RMSProp learning algorithm
@@ -133,6 +137,15 @@ protected:
     intargvector m_momentumSpecifiedForMBSize;
     bool m_useNesterovMomentum;
 
+    // update the dense parameters of one device together (Matrix::MultiTensorUpdate()) instead of one by one
+    bool m_multiTensorUpdate;
+
+    // place the parameters, their gradients and smoothed gradients into flat buffers (ComputationNetwork::AllocateFlatParameterBuffers())
+    bool m_flatParameterBuffers;
+
+    // FSAdaGrad of block-sparse gradients only updates the columns present in the gradient (Matrix::FSAdagradUpdate())
+    bool m_lazySparseUpdate;
+
     // Determine the MB size used for mapping a given learning-rate or momentum parameter to a per-sample value.
     // MB size is the number of samples across all time steps and parallel sequences.
     // This function exists to post-fix a design bug in SGD:
@@ -176,6 +189,18 @@ protected:
         return m_parallelizationMethod;
     }
 
+    // model parallelism does not need MPI, and combines with the data-parallel methods above
+    ParallelizationMethod GetModelParallelizationMethod() const
+    {
+        return m_pipelineDevices.empty() ? ParallelizationMethod::none : ParallelizationMethod::modelParallelSGD;
+    }
+
+    // in-process data parallelism, see m_numHogwildReplicas
+    bool UsingHogwild() const
+    {
+        return m_numHogwildReplicas > 1;
+    }
+
     // helper function to initialize and check BlockMomentumSGD related parameters
     void InitializeAndCheckBlockMomentumSGDParameters();
     // only true when the user specify LearningRatePerMB and the number of parallel utterances in Reader > 1
@@ -201,6 +226,22 @@ protected:
     // if m_maxTempMemSizeInSamples = SIZE_MAX (which means users do not specify the option) and m_numSubminiBatches > 1
     // we divide one minibatch to m_numSubminiBatches subMinibatches
 
+    // the gradients of this many minibatches add up in place in the parameter gradients, and are aggregated and applied
+    // after the last of them; unlike sub-minibatches, this needs no copies of the gradients or of the inputs
+    size_t m_gradientAccumulationSteps;
+
+    // memory per device for the matrices of the network, in MB (0, the default, means no limit). Before training, the largest
+    // minibatch that fits is computed from the memory plan of the network. Larger minibatches are split into sub-minibatches
+    // (unless maxSamplesInRAM or numSubminibatches are given), or with capMinibatchSizeToMemory, the minibatch size is reduced.
+    size_t m_memoryBudgetMB;
+    bool m_capMinibatchSizeToMemory;
+
+    // minibatch size for validation (0 means, use the training minibatch size). Validation is only constrained by
+    // memory, so it can use larger minibatches than training (which are still split according to m_maxSamplesInRAM).
+    size_t m_cvMinibatchSize;
+    // each worker validates on its shard of the validation set, and the results are combined once at the end
+    bool m_shardedValidation;
+
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     size_t m_epochSize;
     size_t m_maxComputedEpochSize;
@@ -240,6 +281,9 @@ protected:
     size_t m_minibatchSearchCriterionErrorMargin;
     size_t m_minibatchSizeTuningFrequency;
     size_t m_minibatchSizeTuningMax;
+    // In parallel training, run the trials of the learning-rate and minibatch-size searches concurrently, one per worker,
+    // each trained locally by its worker, instead of one after another, each trained by all workers together.
+    bool m_parallelSearch;
 
     doubleargvector m_dropoutRates;
     doubleargvector m_batchNormalizationTimeConstant;
@@ -294,12 +338,42 @@ protected:
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
 
+    // Aggregate gradients in buckets of this size while backprop computes the remaining ones, 0 to aggregate after backprop
+    size_t m_gradientBucketSizeInBytes;
+
+    // Aggregate sparse gradients (e.g. of embeddings) by their non-zero columns up to this density, see SimpleDistGradAggregator
+    double m_sparseGradientDensityThreshold;
+
+    // Send only this fraction of the entries of gradients of at least the given size (top-k sparsification), 0 to send all
+    double m_topKGradientFraction;
+    size_t m_sparseGradientMinSizeInBytes;
+
+    // Elastic training: continue with the remaining workers when one fails, and admit replacement workers (started with
+    // elasticJoin) at epoch boundaries through the MPI port that the main node publishes in m_elasticPortFile
+    bool m_elasticTraining;
+    std::wstring m_elasticPortFile;
+    bool m_elasticJoin;
+    std::string m_elasticPortName; // the open port, main node only
+
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
     bool   m_resetSGDMomentum; 
     bool   m_useNesterovBlockMomentum;
     double m_blockLearningRate; 
     double m_blockMomentumAsTimeConstant;
+    bool   m_pipelinedModelAggregation; // average each block while the next one is computed, see PipelinedModelAveragingSGD
+
+    // Model parallel SGD (ModelParallelSGD): the network is split into consecutive stages on these devices (see
+    // ComputationNetwork::PlacePipelineStages()), and each minibatch into this many micro-batches, which pass through the
+    // stages one after the other while each stage accumulates the gradients of its parameters (as sub-minibatches do)
+    std::vector<DEVICEID_TYPE> m_pipelineDevices;
+    size_t m_numMicroBatches;
+
+    // In-process data parallelism on the CPU (HogwildSGD): this many threads train replicas of the network on distinct minibatches
+    // of the one reader. With syncPeriod = 0 the replicas share the parameter values and update them without locks (Hogwild);
+    // otherwise each replica updates its own copy, and the copies are averaged after every syncPeriod minibatches of each replica.
+    size_t m_numHogwildReplicas;
+    size_t m_hogwildSyncPeriod;
 
     bool m_needAveMultiplier;
     double m_L2RegWeight;
@@ -312,6 +386,8 @@ protected:
     AdjustLearningRateAtBeginning m_adjustLearningRateAtBeginning;
     double m_adjustCoefficient;
     size_t m_adjustPerMinibatches;
+    bool m_useBuiltinParameterServer; // rather than Multiverso, see ParameterServerASGDHelper
+    int m_maxStaleness;               // syncs a worker may be ahead of the slowest one, -1 for no bound
 
     // sequence training
     double m_hSmoothingWeight;
@@ -353,6 +429,7 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_asyncCheckpointing(configSGD(L"asyncCheckpointing", false)),
           m_saveBestModelPerCriterion(configSGD(L"saveBestModelPerCriterion", false)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
@@ -462,6 +539,15 @@ protected:
                                    std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double> smoothedCounts,
                                    const double learningRateAdjustmentFactor);
 
+    // Runs 'numTrials' (at most NumNodesInUse()) trials of a search concurrently (parallelSearch): the worker of rank k
+    // runs runTrial(k) locally, and the criteria of all trials are then exchanged. Returns them, by trial.
+    std::vector<EpochCriterion> RunSearchTrialsAcrossWorkers(size_t numTrials, const std::function<EpochCriterion(size_t trial)>& runTrial);
+    bool UsingParallelSearch() const
+    {
+        return m_parallelSearch && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1 &&
+               GetParallelizationMethod() != ParallelizationMethod::dataParallelASGD;
+    }
+
     // uses a small percentage of training data of minibatch to
     // speculatively train with various MB sizes; then picks the best
     size_t SearchForBestMinibatchSize(ComputationNetworkPtr net,
@@ -490,6 +576,9 @@ protected:
                                             const std::vector<ComputationNodeBasePtr>& featureNodes,
                                             StreamMinibatchInputs* inputMatrices);
 
+    // limits the minibatches to what fits into memoryBudgetMB, after the matrices of the network have been allocated
+    void FitMinibatchSizeToMemory(ComputationNetworkPtr net, IDataReader* trainSetDataReader);
+
     size_t TrainOneEpoch(ComputationNetworkPtr net,
                          ComputationNetworkPtr refNet,
                          const ComputationNodeBasePtr& refNode,
@@ -512,8 +601,70 @@ protected:
                          const size_t totalMBsSeenBefore = 0,
                          ::CNTK::Internal::TensorBoardFileWriterPtr tensorBoardWriter = nullptr);
 
+    // HogwildSGD: the networks trained by the threads other than the main one, see m_numHogwildReplicas
+    struct HogwildReplica
+    {
+        ComputationNetworkPtr net; // a clone of the main network (ComputationNetwork::CloneSharingParameters())
+        std::vector<ComputationNodeBasePtr> featureNodes, labelNodes, criterionNodes, evaluationNodes;
+        StreamMinibatchInputs inputMatrices;
+        std::list<ComputationNodeBasePtr> learnableNodes; // in the order of those of the main network
+        std::list<Matrix<ElemType>> smoothedGradients;    // the momentum of this replica's updates, not checkpointed
+        std::vector<double> smoothedCounts;
+    };
+    void CreateHogwildReplicas(const ComputationNetworkPtr& net,
+                               const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                               const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                               const std::vector<ComputationNodeBasePtr>& additionalNodesToEvaluate);
+    // TrainOneEpoch() with all replicas, each on its own thread
+    size_t TrainOneEpochHogwild(ComputationNetworkPtr net,
+                                const int epochNumber,
+                                const size_t epochSize,
+                                IDataReader* trainSetDataReader,
+                                const double learnRatePerSample,
+                                size_t tunedMBSize,
+                                const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                StreamMinibatchInputs* inputMatrices,
+                                const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                                /*out*/ EpochCriterion& epochCriterion,
+                                /*out*/ std::vector<EpochCriterion>& epochEvalErrors);
+    // the minibatch loop of one thread of TrainOneEpochHogwild(); returns the number of minibatches it trained
+    size_t TrainHogwildReplica(const ComputationNetworkPtr& net, const int epochNumber, const double learnRatePerSample,
+                               const std::vector<ComputationNodeBasePtr>& featureNodes,
+                               const std::vector<ComputationNodeBasePtr>& labelNodes,
+                               const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                               const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                               StreamMinibatchInputs& inputMatrices,
+                               const std::list<ComputationNodeBasePtr>& learnableNodes,
+                               std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                               IDataReader* trainSetDataReader, std::mutex& readerMutex, std::atomic<bool>& endOfData, size_t maxNumMBs,
+                               CriterionAccumulator<ElemType>& localEpochCriterion, CriterionAccumulator<ElemType>& localEpochEvalErrors);
+
     void InitDistGradAgg(int numEvalNodes, int numGradientBits, int deviceId, int traceLevel);
     void InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE devID);
+
+    // elastic training, see m_elasticTraining
+    void EnableElasticTraining();
+    void PublishElasticPort();
+    void JoinRunningWorkers();
+    bool AdmitReplacementWorkers();
+    void BroadcastTrainingState(int& epoch, double& learnRatePerSample, double& prevCriterion,
+                                size_t& totalTrainingSamplesSeen, size_t& totalMBsSeen,
+                                const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts);
+    void BroadcastModel(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                        std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts);
+    void RecoverFromWorkerFailure(int epochNumber, const ComputationNetworkPtr& net, IDataReader* trainSetDataReader,
+                                  bool useDistributedMBReading, size_t tunedMBSize, size_t epochSize,
+                                  StreamMinibatchInputs* inputMatrices, size_t numEvalNodes,
+                                  const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                  std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts);
+
+    // straggler report (syncPerfStats): which worker the others wait for in the gradient aggregation
+    void ReportStragglers(int numMBsRun, double secondsToAggregation, std::vector<size_t>& numTimesSlowest);
 public:
     // UpdateWeights() - actual weight update, implementing various update rules
     void UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemType>& gradientValues,
@@ -523,6 +674,12 @@ public:
                        const double L2RegWeight, const double L1RegWeight,
                        const bool needAveMultiplier,
                        const bool useNesterovMomentum) const;
+
+    // The update of UpdateWeights() for momentum and Nesterov SGD (multiTensorUpdate=true), in one multi-tensor update per
+    // device of the dense parameters. Adds the nodes it updated to 'updatedNodes'; the others are left to UpdateWeights().
+    void MultiTensorUpdateWeights(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients,
+                                  const double learnRatePerSample, const double momentumPerSample, size_t actualMBSize,
+                                  std::set<ComputationNodeBasePtr>& updatedNodes) const;
     // return -1 if nothing exists
     int DetermineStartEpoch(const bool makeMode);
 
@@ -537,6 +694,8 @@ protected:
                             const std::vector<double>& smoothedCounts,
                             const double prevCriterion,
                             const size_t minibatchSize);
+    // wait for the background write of the last checkpoint (asyncCheckpointing) to complete, on all workers
+    void WaitForPendingCheckpoint();
 
     bool TryLoadCheckPointInfo(const size_t epochNumber,
                                /*out*/ size_t& totalSamplesSeen,
@@ -575,6 +734,10 @@ public:
 protected:
     std::wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    // Write the model and checkpoint info of each epoch on a background thread, from a copy in host memory, while the
+    // next epoch trains. The writes are synced to disk, and an epoch's files replace the previous ones only when complete.
+    bool m_asyncCheckpointing;
+    std::future<void> m_pendingCheckpoint; // the background write of the last checkpoint
     bool m_saveBestModelPerCriterion;
     // Mapping from criterion to the best epoch on validation data set.
     std::map<std::wstring, BestEpoch> m_criteriaBestEpoch;
@@ -595,6 +758,8 @@ protected:
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
+    std::vector<std::unique_ptr<HogwildReplica>> m_hogwildReplicas;
+
 private:
     void MarkDropoutNodesEvalTimeStampAsOutdated(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode);
     std::shared_ptr<ASGDHelper<ElemType>> m_pASGDHelper;
@@ -10,9 +10,13 @@
 #include "IDistGradAggregator.h"
 #include "CUDAPageLockedMemAllocator.h"
 #include "NcclComm.h"
+#include <algorithm>
+#include <climits>
 #include <future>
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
+#include "PerformanceProfiler.h"
+#include "ThreadPool.h"
 #include "MatrixQuantizerImpl.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -23,13 +27,32 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES)
+    // bucketSizeInBytes > 0 overlaps the aggregation with the backward pass, see OnGradientReady()
+    // sparseGradientDensityThreshold: see AggregateSparseGradient()
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES,
+                             size_t bucketSizeInBytes = 0, double sparseGradientDensityThreshold = DEFAULT_SPARSE_GRADIENT_DENSITY_THRESHOLD)
         : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace),
-        m_iterationCount(0), m_nccl(deviceId, mpi), m_packThresholdSizeInBytes(packThresholdSizeInBytes)
-    {}
+        m_iterationCount(0), m_nccl(deviceId, mpi), m_packThresholdSizeInBytes(packThresholdSizeInBytes), m_bucketSizeInBytes(bucketSizeInBytes), m_overlapAggregation(false), m_numBucketsStarted(0),
+        m_sparseGradientDensityThreshold(sparseGradientDensityThreshold)
+    {
+        if (bucketSizeInBytes == 0)
+            return;
+
+        // Overlapping needs reductions that do not block the compute stream (NCCL), or data that is on the CPU already.
+        if (useAsyncAggregation)
+            fprintf(stderr, "WARNING: SimpleDistGradAggregator: overlapping the gradient aggregation with backprop is not supported with buffered async aggregation, disabled.\n");
+        else if (!m_nccl.IsSupported() && deviceId != CPUDEVICE)
+            fprintf(stderr, "WARNING: SimpleDistGradAggregator: overlapping the gradient aggregation with backprop requires NCCL on GPUs, disabled.\n");
+        else
+            m_overlapAggregation = true;
+    }
 
     ~SimpleDistGradAggregator()
     {
+        // the aggregation runs on the thread pool, whose futures do not wait when destroyed
+        if (m_pendingAsyncAggregation.valid())
+            m_pendingAsyncAggregation.wait();
+
         for (size_t i = 0; i < m_recvHeaders.size(); ++i)
             DistGradHeader::Destroy(m_recvHeaders[i]);
 
@@ -100,10 +123,11 @@ public:
                 // the gradient aggregation asynchronously on a separate stream
                 MatrixComputeStreamEvent* mainStreamSyncEvent = MatrixComputeStreamEvent::Create(deviceId);
 
-                m_pendingAsyncAggregation = std::async(std::launch::async, [=] {
+                m_pendingAsyncAggregation = ThreadPool::Instance().Async(std::launch::async, [=] {
                     // We are starting on a new thread. Make sure the new thread is
                     // setup to use the right device
                     Matrix<ElemType>::SetDevice(deviceId);
+                    ProfilerSetThreadName("Gradient Aggregation");
 
                     // Synchronize the Quantization compute stream with the completion of
                     // compute of the gradient matrices on the main compute stream
@@ -111,13 +135,18 @@ public:
                     delete mainStreamSyncEvent;
 
                     AggregateGradientsImpl(newGradients, newGradHeader, showSyncPerfStats);
-                });
+                }, ThreadPoolPriority::high);
 
                 return true;
             }
 
             return false;
         }
+        else if (m_overlapAggregation)
+        {
+            AggregateGradientsOverlapped(gradients, headerCPU, showSyncPerfStats);
+            return (headerCPU->numSamples != 0);
+        }
         else
         {
             AggregateGradientsImpl(gradients, headerCPU, showSyncPerfStats);
@@ -125,7 +154,215 @@ public:
         }
     }
 
+    bool SupportsOverlappedAggregation() const override
+    {
+        return m_overlapAggregation;
+    }
+
+    // Starts the aggregation of the bucket of the gradient when all of its gradients are ready. The buckets are formed from
+    // the gradients of the first call to AggregateGradients(), in their order, which should be the order in which backprop
+    // computes them. Buckets are started in this order only, so that all workers issue the same sequence of reductions.
+    void OnGradientReady(Matrix<ElemType>* gradient) override
+    {
+        if (!m_overlapAggregation || !m_initialized)
+            return;
+
+        auto bucketIndex = m_gradientToBucket.find(gradient);
+        if (bucketIndex == m_gradientToBucket.end())
+            return;
+
+        auto& bucket = m_buckets[bucketIndex->second];
+        if (bucket.started || bucket.numPending == 0)
+            return;
+
+        bucket.numPending--;
+        while (m_numBucketsStarted < m_buckets.size() && m_buckets[m_numBucketsStarted].numPending == 0)
+            StartBucketAggregation(m_buckets[m_numBucketsStarted]);
+    }
+
 private:
+    // Gradients that are aggregated together as soon as all of them are ready.
+    struct GradientBucket
+    {
+        std::vector<Matrix<ElemType>*> gradients;
+        std::unique_ptr<Matrix<ElemType>> buffer; // the gradients packed contiguously, null for a bucket of one gradient
+        size_t numPending;                        // gradients that are not ready yet in the current minibatch
+        bool started;                             // aggregation of the bucket has been started in the current minibatch
+        MPI_Request request;                      // aggregation of CPU gradients
+    };
+
+    // Groups consecutive gradients into buckets of at least m_bucketSizeInBytes.
+    // Fewer, larger reductions use the bandwidth better, smaller ones start earlier.
+    void FormBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        size_t bucketSizeInBytes = 0;
+        for (auto gradient : gradients)
+        {
+            if (m_buckets.empty() || bucketSizeInBytes >= m_bucketSizeInBytes)
+            {
+                m_buckets.push_back(GradientBucket());
+                bucketSizeInBytes = 0;
+            }
+
+            m_buckets.back().gradients.push_back(gradient);
+            m_gradientToBucket[gradient] = m_buckets.size() - 1;
+            bucketSizeInBytes += sizeof(ElemType) * gradient->GetNumElements();
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            bucket.numPending = bucket.gradients.size();
+            bucket.started = false;
+            if (bucket.gradients.size() > 1)
+            {
+                size_t numElements = 0;
+                for (auto gradient : bucket.gradients)
+                    numElements += gradient->GetNumElements();
+                bucket.buffer.reset(new Matrix<ElemType>(1, numElements, bucket.gradients.front()->GetDeviceId()));
+            }
+        }
+
+        m_numBucketsStarted = 0;
+        fprintf(stderr, "SimpleDistGradAggregator: overlapping the aggregation of %d gradients with backprop in %d buckets of at least %.1f MB.\n",
+                (int)gradients.size(), (int)m_buckets.size(), m_bucketSizeInBytes / (1024.0 * 1024));
+    }
+
+    void StartBucketAggregation(GradientBucket& bucket)
+    {
+        // Packing is issued to the compute stream after the gradients, the reduction waits for it.
+        Matrix<ElemType>* reductionBuffer = bucket.buffer ? bucket.buffer.get() : bucket.gradients.front();
+        if (bucket.buffer)
+        {
+            size_t offset = 0;
+            for (auto gradient : bucket.gradients)
+            {
+                bucket.buffer->ColumnSlice(offset, gradient->GetNumElements()).AssignValuesOf(gradient->Reshaped(1, gradient->GetNumElements()));
+                offset += gradient->GetNumElements();
+            }
+        }
+
+        if (m_nccl.IsSupported())
+            m_nccl.AllReduceAsync(reductionBuffer->Data(), reductionBuffer->GetNumElements());
+        else
+            m_mpi->Iallreduce(MPI_IN_PLACE, reductionBuffer->Data(), reductionBuffer->GetNumElements(),
+                              MPIWrapper::GetDataType(reductionBuffer->Data()), MPI_SUM, &bucket.request) || MpiFail("MPI_Iallreduce");
+
+        bucket.started = true;
+        m_numBucketsStarted++;
+    }
+
+    // Completes the aggregation of the buckets that were not started during backprop and waits for all of them.
+    void AggregateGradientsOverlapped(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        size_t numStartedInBackprop = m_numBucketsStarted;
+
+        if (headerCPU->numSamples == 0)
+        {
+            // no backprop in this minibatch, so no gradient was reported ready
+            assert(numStartedInBackprop == 0);
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        std::vector<MPI_Request> recvHeaderRequests;
+        MPI_Request sendHeaderRequest;
+        StartHeaderAggregation(headerCPU, gradients.size(), recvHeaderRequests, sendHeaderRequest);
+
+        while (m_numBucketsStarted < m_buckets.size())
+            StartBucketAggregation(m_buckets[m_numBucketsStarted]);
+
+        for (size_t i : m_sparseGradientsIndex)
+            AggregateSparseGradient(gradients[i]);
+
+        FinishHeaderAggregation(headerCPU, recvHeaderRequests);
+
+        if (m_nccl.IsSupported())
+            m_nccl.Sync();
+        else
+        {
+            for (auto& bucket : m_buckets)
+                m_mpi->Wait(&bucket.request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            if (bucket.buffer)
+            {
+                size_t offset = 0;
+                for (auto gradient : bucket.gradients)
+                {
+                    gradient->AssignValuesOf(bucket.buffer->ColumnSlice(offset, gradient->GetNumElements()).Reshaped(gradient->GetNumRows(), gradient->GetNumCols()));
+                    offset += gradient->GetNumElements();
+                }
+            }
+
+            bucket.numPending = bucket.gradients.size();
+            bucket.started = false;
+        }
+        m_numBucketsStarted = 0;
+
+        if (!m_mpi->IsMainNode())
+            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Overlapped gradient aggregation wait time: %.6g (%d of %d buckets started during backprop)\n",
+                    aggregationTimer.ElapsedSeconds(), (int)numStartedInBackprop, (int)m_buckets.size());
+        }
+    }
+
+    // Sends the header to the main node, which aggregates the headers of all nodes, see FinishHeaderAggregation().
+    void StartHeaderAggregation(DistGradHeader* headerCPU, size_t numGradMatrices, std::vector<MPI_Request>& recvHeaderRequests, MPI_Request& sendHeaderRequest)
+    {
+        // Initiate receive of the header on the main node
+        recvHeaderRequests.resize(NumProc() - 1);
+        if (m_mpi->IsMainNode())
+        {
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                // We use a tag of 'numGradMatrices' for the pre-aggregation header
+                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, numGradMatrices, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+        }
+
+        // Send the headers from all nodes but the main node
+        if (!m_mpi->IsMainNode())
+            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, &sendHeaderRequest) || MpiFail("MPI_Isend");
+    }
+
+    // On the main node waits for the headers and aggregates them, then broadcasts the result to all nodes.
+    void FinishHeaderAggregation(DistGradHeader* headerCPU, std::vector<MPI_Request>& recvHeaderRequests)
+    {
+        if (m_mpi->IsMainNode())
+        {
+            size_t numNodesHeadersReceivedFrom = 0;
+            while (numNodesHeadersReceivedFrom < (NumProc() - 1))
+            {
+                int idx = MPI_UNDEFINED;
+                m_mpi->Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                if (idx == MPI_UNDEFINED)
+                {
+                    break;
+                }
+
+                numNodesHeadersReceivedFrom++;
+
+                headerCPU->Aggregate(m_recvHeaders[idx], true);
+            }
+
+            assert(numNodesHeadersReceivedFrom == (NumProc() - 1));
+        }
+
+        // Broadcast the aggregated header to all nodes
+        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+    }
+
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
         assert(deviceID >= 0);
@@ -166,9 +403,26 @@ private:
             }
 
             size_t packedGradientsSizeInElements = 0;
+            std::vector<Matrix<ElemType>*> denseGradients;
             for (size_t i = 0; i < gradients.size(); i++)
             {
-                if (!m_useAsyncAggregation && sizeof(ElemType) * gradients[i]->GetNumElements() <= m_packThresholdSizeInBytes)
+                // Sparse block-column gradients (e.g. of an embedding with sparse input) are aggregated by their non-zero columns,
+                // see AggregateSparseGradient(). Other sparse gradients are not supported.
+                if (gradients[i]->GetMatrixType() != DENSE)
+                {
+                    if (gradients[i]->GetFormat() != matrixFormatSparseBlockCol)
+                        RuntimeError("Gradient aggregation for sparse gradient matrices is currently only supported for the sparse block-column format!");
+                    if (m_useAsyncAggregation)
+                        RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported with async aggregation!");
+
+                    m_sparseGradientsIndex.push_back(i);
+                    continue;
+                }
+
+                denseGradients.push_back(gradients[i]);
+
+                // (buckets take care of packing when overlapping)
+                if (!m_useAsyncAggregation && !m_overlapAggregation && sizeof(ElemType) * gradients[i]->GetNumElements() <= m_packThresholdSizeInBytes)
                 {
                     packedGradientsSizeInElements += gradients[i]->GetNumElements();
                     m_packedGradientsIndex.push_back(i);
@@ -178,17 +432,31 @@ private:
                     m_gradientIndexToAggregate.push_back(i);
                 }
 
-                // Make sure none of the gradient matrixes are sparse - we currently do not support aggregation of sparse gradient matrices
-                if (gradients[i]->GetMatrixType() != DENSE)
-                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
-
                 if (m_useAsyncAggregation)
                     m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
             }
 
             // Packing matrices into continous buffer if not doing async aggregation
             m_aggregationBuffer.reset();
-            if (packedGradientsSizeInElements > 0)
+            if (!m_useAsyncAggregation && !m_overlapAggregation && AreContiguous(denseGradients))
+            {
+                // The gradients follow each other in a flat buffer (flatParameterBuffers): it is reduced in place as a whole,
+                // without packing.
+                m_packedGradientsIndex.clear();
+                m_flatGradientsIndex.clear();
+                packedGradientsSizeInElements = 0;
+                for (size_t i = 0; i < gradients.size(); i++)
+                {
+                    if (gradients[i]->GetMatrixType() == DENSE)
+                    {
+                        m_flatGradientsIndex.push_back(i);
+                        packedGradientsSizeInElements += gradients[i]->GetNumElements();
+                    }
+                }
+                m_aggregationBuffer.reset(new Matrix<ElemType>(1, packedGradientsSizeInElements, denseGradients[0]->Data(), deviceId, matrixFlagDontOwnBuffer));
+                m_gradientIndexToAggregate.assign(1, (size_t)-1);
+            }
+            else if (packedGradientsSizeInElements > 0)
             {
                 m_aggregationBuffer.reset(new (std::nothrow) Matrix<ElemType>(1, packedGradientsSizeInElements, deviceId));
             }
@@ -201,10 +469,11 @@ private:
                 // Reuse "@param m_gradientIndexToAggregate" for following code, if no continous buffer allocated
                 for (size_t i = 0; i < gradients.size(); i++)
                 {
-                    m_gradientIndexToAggregate.push_back(i);
+                    if (gradients[i]->GetMatrixType() == DENSE)
+                        m_gradientIndexToAggregate.push_back(i);
                 }
             }
-            else
+            else if (m_flatGradientsIndex.empty())
             {
                 // First element is reserved for continous buffer
                 m_gradientIndexToAggregate.insert(m_gradientIndexToAggregate.begin(), 1, (size_t)-1);
@@ -231,6 +500,9 @@ private:
                 for (size_t i = 0; i < NumProc() - 1; ++i)
                     m_recvHeaders.push_back(DistGradHeader::Create(numEvalNodes));
             }
+
+            if (m_overlapAggregation)
+                FormBuckets(denseGradients);
         }
         else if (resetState)
         {
@@ -249,8 +521,31 @@ private:
         }
     }
 
+    // whether each gradient starts where the previous one ends, on the same device
+    static bool AreContiguous(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        if (gradients.size() < 2)
+            return false;
+        for (size_t i = 1; i < gradients.size(); i++)
+        {
+            if (gradients[i]->GetDeviceId() != gradients[0]->GetDeviceId() ||
+                gradients[i]->Data() != gradients[i - 1]->Data() + gradients[i - 1]->GetNumElements())
+                return false;
+        }
+        return true;
+    }
+
     void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
     {
+        if (!m_flatGradientsIndex.empty())
+        {
+            std::vector<Matrix<ElemType>*> flatGradients;
+            for (size_t i : m_flatGradientsIndex)
+                flatGradients.push_back(gradients[i]);
+            if (!AreContiguous(flatGradients) || flatGradients[0]->Data() != m_aggregationBuffer->Data())
+                LogicError("AggregateGradients: The gradients are no longer in their flat buffer.");
+        }
+
         Timer aggregationTimer;
         int deviceId = gradients[0]->GetDeviceId();
         if (showSyncPerfStats)
@@ -309,22 +604,10 @@ private:
             }
         }
 
-        // Initiate receive of the header on the main node
-        std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
-        if (m_mpi->IsMainNode())
-        {
-            for (size_t j = 0; j < NumProc() - 1; ++j)
-            {
-                int source = (j >= MyRank()) ? (j + 1) : j;
-                // We use a tag of 'numGradMatrices' for the pre-aggregation header
-                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, numGradMatrices, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
-            }
-        }
-
-        // Send the headers from all nodes but the main node
+        // Initiate the aggregation of the headers
+        std::vector<MPI_Request> recvHeaderRequests;
         MPI_Request sendHeaderRequest;
-        if (!m_mpi->IsMainNode())
-            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, &sendHeaderRequest) || MpiFail("MPI_Isend");
+        StartHeaderAggregation(headerCPU, numGradMatrices, recvHeaderRequests, sendHeaderRequest);
 
         // Perform async allreduce on the gradient data
         std::vector<MPI_Request> allReduceRequests;
@@ -365,29 +648,12 @@ private:
             m_nccl.AllReduce(ncclReduceGradients);
         }
 
-        // On the main node wait for the headers to arrive and aggregate
-        if (m_mpi->IsMainNode())
-        {
-            size_t numNodesHeadersReceivedFrom = 0;
-            while (numNodesHeadersReceivedFrom < (NumProc() - 1))
-            {
-                int idx = MPI_UNDEFINED;
-                m_mpi->Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
-                if (idx == MPI_UNDEFINED)
-                {
-                    break;
-                }
+        // The sparse gradients are aggregated on the CPU while the dense reductions are in flight
+        for (size_t i : m_sparseGradientsIndex)
+            AggregateSparseGradient(gradients[i]);
 
-                numNodesHeadersReceivedFrom++;
-
-                headerCPU->Aggregate(m_recvHeaders[idx], true);
-            }
-
-            assert(numNodesHeadersReceivedFrom == (NumProc() - 1));
-        }
-
-        // Broadcast the aggregated header to all nodes
-        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+        // On the main node wait for the headers to arrive and aggregate, then broadcast the result
+        FinishHeaderAggregation(headerCPU, recvHeaderRequests);
 
         if (m_nccl.IsSupported())
         {
@@ -438,6 +704,93 @@ private:
         }
     }
 
+    // Aggregates a sparse block-column gradient by its non-zero columns (the rows of the embedding that the minibatch touched):
+    // the column ids and values of all workers are exchanged by allgatherv and the columns with the same id are summed.
+    // If all workers together send more than m_sparseGradientDensityThreshold times the number of columns of the matrix,
+    // an allreduce of the dense matrix is cheaper; all workers take this decision on the gathered column counts.
+    // A worker that did not process any samples has an empty gradient and contributes no columns.
+    void AggregateSparseGradient(Matrix<ElemType>* gradient)
+    {
+        size_t numRows = gradient->GetNumRows();
+        size_t numCols = gradient->GetNumCols();
+        int numSent = (int)gradient->CopyBlockColumnsToCPU(m_columnIds, m_columnValues);
+
+        std::vector<int> numReceived(NumProc()), offsets(NumProc());
+        m_mpi->Allgather(&numSent, 1, MPI_INT, numReceived.data(), 1, MPI_INT);
+        size_t numTotal = 0;
+        for (size_t j = 0; j < NumProc(); ++j)
+            numTotal += numReceived[j];
+
+        m_mergedColumnIds.clear();
+        m_mergedColumnValues.clear();
+        if (numTotal > m_sparseGradientDensityThreshold * numCols || numTotal * numRows > INT_MAX)
+        {
+            m_mergedColumnValues.assign(numRows * numCols, 0);
+            for (size_t j = 0; j < m_columnIds.size(); ++j)
+                std::copy_n(m_columnValues.data() + j * numRows, numRows, m_mergedColumnValues.data() + m_columnIds[j] * numRows);
+
+            m_mpi->AllReduce(m_mergedColumnValues.data(), m_mergedColumnValues.size());
+
+            // keep the columns that are non-zero on any worker
+            for (size_t col = 0; col < numCols; ++col)
+            {
+                const ElemType* column = m_mergedColumnValues.data() + col * numRows;
+                if (std::any_of(column, column + numRows, [](ElemType v) { return v != 0; }))
+                {
+                    std::copy_n(column, numRows, m_mergedColumnValues.data() + m_mergedColumnIds.size() * numRows);
+                    m_mergedColumnIds.push_back(col);
+                }
+            }
+            m_mergedColumnValues.resize(m_mergedColumnIds.size() * numRows);
+        }
+        else
+        {
+            int numColumnsTotal = 0;
+            for (size_t j = 0; j < NumProc(); ++j)
+            {
+                offsets[j] = numColumnsTotal;
+                numColumnsTotal += numReceived[j];
+            }
+
+            m_allColumnIds.resize(std::max<size_t>(numTotal, 1));
+            m_mpi->Allgatherv(m_columnIds.data(), numSent, MPIWrapper::GetDataType(m_columnIds.data()), m_allColumnIds.data(),
+                              numReceived.data(), offsets.data(), MPIWrapper::GetDataType(m_columnIds.data()));
+
+            for (size_t j = 0; j < NumProc(); ++j)
+            {
+                numReceived[j] *= (int)numRows;
+                offsets[j] *= (int)numRows;
+            }
+            m_allColumnValues.resize(std::max<size_t>(numTotal * numRows, 1));
+            m_mpi->Allgatherv(m_columnValues.data(), numSent * (int)numRows, MPIWrapper::GetDataType(m_columnValues.data()), m_allColumnValues.data(),
+                              numReceived.data(), offsets.data(), MPIWrapper::GetDataType(m_columnValues.data()));
+
+            // All workers merge the same columns in the same order, so that their results are identical.
+            m_columnPositions.clear();
+            for (size_t j = 0; j < numTotal; ++j)
+            {
+                const ElemType* column = m_allColumnValues.data() + j * numRows;
+                auto position = m_columnPositions.emplace(m_allColumnIds[j], m_mergedColumnIds.size());
+                if (position.second)
+                {
+                    m_mergedColumnIds.push_back(m_allColumnIds[j]);
+                    m_mergedColumnValues.insert(m_mergedColumnValues.end(), column, column + numRows);
+                }
+                else
+                {
+                    ElemType* sum = m_mergedColumnValues.data() + position.first->second * numRows;
+                    for (size_t row = 0; row < numRows; ++row)
+                        sum[row] += column[row];
+                }
+            }
+        }
+
+        if (m_mergedColumnIds.empty())
+            gradient->Reset();
+        else
+            gradient->SetBlockColumnsFromCPU(m_mergedColumnIds.data(), m_mergedColumnValues.data(), m_mergedColumnIds.size());
+    }
+
 private:
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
 
@@ -463,6 +816,31 @@ private:
     std::vector<size_t> m_packedGradientsIndex;
     std::vector<size_t> m_gradientIndexToAggregate;
 
+    // the dense gradients if they are in one flat buffer, which m_aggregationBuffer then points into; empty otherwise
+    std::vector<size_t> m_flatGradientsIndex;
+
+    // Overlapping the aggregation with backprop: gradients are aggregated in buckets of at least m_bucketSizeInBytes,
+    // each one as soon as all of its gradients are ready (tunable by "gradientBucketSizeInMB=[value]").
+    const size_t m_bucketSizeInBytes;
+    bool m_overlapAggregation;
+    std::vector<GradientBucket> m_buckets;
+    std::unordered_map<const Matrix<ElemType>*, size_t> m_gradientToBucket;
+    size_t m_numBucketsStarted; // in the current minibatch, buckets are started in order
+
+    // Sparse block-column gradients, aggregated by their non-zero columns unless the columns of all workers together
+    // exceed this multiple of the number of columns (tunable by "sparseGradientDensityThreshold=[value]").
+    const double m_sparseGradientDensityThreshold;
+    std::vector<size_t> m_sparseGradientsIndex;
+
+    // Temp buffers of the sparse aggregation to avoid allocations.
+    std::vector<size_t> m_columnIds;
+    std::vector<ElemType> m_columnValues;
+    std::vector<size_t> m_allColumnIds;
+    std::vector<ElemType> m_allColumnValues;
+    std::vector<size_t> m_mergedColumnIds;
+    std::vector<ElemType> m_mergedColumnValues;
+    std::unordered_map<size_t, size_t> m_columnPositions;
+
     int m_syncStatsTrace;
 
     // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
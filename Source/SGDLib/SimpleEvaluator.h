@@ -39,7 +39,7 @@ class SimpleEvaluator
 {
 public:
     SimpleEvaluator(ComputationNetworkPtr net, const MPIWrapperPtr& mpi, bool enableDistributedMBReading = false, const size_t numMBsToShowResult = 100, const size_t firstMBsToShowResult = 0, const int traceLevel = 0, const size_t maxSamplesInRAM = SIZE_MAX,
-                    const size_t numSubminiBatches = 1) :
+                    const size_t numSubminiBatches = 1, bool shardedEvaluation = false) :
         m_net(net), 
         m_numMBsToShowResult(numMBsToShowResult), 
         m_firstMBsToShowResult(firstMBsToShowResult),
@@ -49,7 +49,8 @@ public:
         m_mpi(mpi), 
         m_distGradAgg(nullptr),
         m_gradHeader(nullptr),
-        m_enableDistributedMBReading(enableDistributedMBReading)
+        m_enableDistributedMBReading(enableDistributedMBReading),
+        m_shardedEvaluation(shardedEvaluation)
     {
     }
 
@@ -93,6 +94,12 @@ public:
 
         bool useParallelTrain = (m_mpi != nullptr);
         bool useDistributedMBReading = useParallelTrain && m_enableDistributedMBReading && dataReader->SupportsDistributedMBRead();
+        // With sharded evaluation each worker evaluates its part of the data on its own, and the results are
+        // combined once at the end instead of after every minibatch.
+        bool useShardedEvaluation = useDistributedMBReading && m_shardedEvaluation;
+        bool aggregatePerMinibatch = useParallelTrain && !useShardedEvaluation;
+        if (useParallelTrain && m_shardedEvaluation && !useShardedEvaluation)
+            fprintf(stderr, "WARNING: Sharded evaluation requires distributed minibatch reading, aggregating the results per minibatch instead.\n");
         if (useDistributedMBReading)
             dataReader->StartDistributedMinibatchLoop(mbSize, 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), inputMatrices.GetStreamDescriptions(), testSize);
         else
@@ -122,8 +129,8 @@ public:
             size_t actualMBSize = 0;
             bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net, nullptr, useDistributedMBReading, useParallelTrain, inputMatrices, actualMBSize, m_mpi);
             // in case of distributed reading, we do a few more loops until all ranks have completed
-            // end of epoch
-            if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) 
+            // end of epoch (not needed for sharded evaluation, which does not synchronize per minibatch)
+            if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess || useShardedEvaluation))
                 break;
 
             // Note: If !wasDataRead then the data that GetMinibatchIntoNetwork() was supposed to full in are undefined.
@@ -159,7 +166,7 @@ public:
             // BUGBUG (Issue #95): Once we have multiple layouts, this must be done on a per-node basis.
             size_t numSamplesWithLabel = wasDataRead ? m_net->GetNumSamplesWithLabelOfNetwork(actualMBSize) : 0;
             size_t aggregateNumSamplesWithLabel = numSamplesWithLabel;
-            if (useParallelTrain)
+            if (aggregatePerMinibatch)
             {
                 if (m_gradHeader == nullptr)
                 {
@@ -214,20 +221,13 @@ public:
             }
             else
             {
+                // The errors are accumulated on the GPU and fetched only when they are shown, or at the end, so that
+                // the next minibatch can be queued while the GPU still works on this one. Nodes that accumulate their
+                // error themselves overwrite it (see CriterionAccumulator).
                 if (actualMBSize != 0)
                 {
                     for (int i = 0; i < evalNodes.size(); i++)
-                    {
-                        localEpochEvalErrors.Assign(i, numSamplesWithLabel);
-                        if (ContainsAccumulatedResult(evalNodes[i]))
-                        {
-                            // We don't accumulate error in epoch criterion as this node has already accumulated error
-                            // for all samples that passed through network in forward pass.
-                            evalResults[i] = localEpochEvalErrors.GetCriterion(i);
-                        }
-                        else
-                            evalResults[i] += localEpochEvalErrors.GetCriterion(i);
-                    }
+                        localEpochEvalErrors.Add(i, numSamplesWithLabel);
                 }
             }
 
@@ -240,6 +240,8 @@ public:
 
                 if (numMBsRun <= m_firstMBsToShowResult || (m_numMBsToShowResult && (numMBsRun % m_numMBsToShowResult == 0)))
                 {
+                    if (!aggregatePerMinibatch)
+                        evalResults = localEpochEvalErrors.GetCriteria();
                     DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, numSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
 
                     for (int i = 0; i < evalResults.size(); i++)
@@ -266,12 +268,35 @@ public:
             dataReader->DataEnd();
         }
 
+        if (!aggregatePerMinibatch)
+            evalResults = localEpochEvalErrors.GetCriteria();
+
         // show last batch of results
         if (m_traceLevel > 0 && numSamplesLastLogged > 0)
         {
             DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, numSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
         }
 
+        if (useShardedEvaluation)
+        {
+            // Combine the results of all workers with a single allreduce of {criterion, sample count} per node and the
+            // sample count of the epoch. Nodes that accumulate their results are aggregated below.
+            vector<double> results;
+            results.reserve(2 * evalResults.size() + 1);
+            for (const auto& evalResult : evalResults)
+            {
+                results.push_back(evalResult.first);
+                results.push_back((double)evalResult.second);
+            }
+            results.push_back((double)totalEpochSamples);
+
+            m_mpi->AllReduce(results);
+
+            for (size_t i = 0; i < evalResults.size(); i++)
+                evalResults[i] = EpochCriterion(results[2 * i], (size_t)results[2 * i + 1]);
+            totalEpochSamples = (size_t)results.back();
+        }
+
         if (useParallelTrain && !evalNodesWhichAccumulateResult.empty())
         {
             // Each worker contains accumulated values for part of the data set, we have to aggregate accumulated values
@@ -333,6 +358,7 @@ protected:
     size_t m_numSubminiBatches;
     MPIWrapperPtr m_mpi;
     bool m_enableDistributedMBReading;
+    bool m_shardedEvaluation;
 
     std::shared_ptr<IDistGradAggregator<ElemType>> m_distGradAgg;
     std::shared_ptr<struct DistGradHeader> m_gradHeader;
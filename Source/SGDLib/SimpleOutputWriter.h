@@ -18,6 +18,7 @@
 #include <cstdio>
 #include "ProgressTracing.h"
 #include "ComputationNetworkBuilder.h"
+#include "BinaryOutputWriter.h"
 
 using namespace std;
 
@@ -88,6 +89,7 @@ public:
             // reader specific process if sentence ending is reached
             dataReader.DataEnd();
         }
+        dataWriter.Flush();
 
         if (m_verbosity > 0)
             fprintf(stderr, "Total Samples Evaluated = %lu\n", (unsigned long)totalEpochSamples);
@@ -113,6 +115,7 @@ public:
 
         // TODO: What should the data size be?
         dataWriter.SaveData(0, outputMatrices, 1, 1, 0);
+        dataWriter.Flush();
     }
 
     void WriteMinibatch(FILE* f, ComputationNodePtr node,
@@ -146,7 +149,10 @@ public:
     }
 
     // TODO: Remove code dup with above function by creating a fake Writer object and then calling the other function.
-    void WriteOutput(IDataReader& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, const WriteFormattingOptions& formattingOptions, size_t numOutputSamples = requestDataSize, bool nodeUnitTest = false, bool writeSequenceKey = false)
+    // With MPI, each worker reads its part of the data and writes it to its own files '<outputPath>.rank<n>.<node>',
+    // which are merged in the order of the ranks if 'mergeShards'.
+    void WriteOutput(IDataReader& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, const WriteFormattingOptions& formattingOptions, size_t numOutputSamples = requestDataSize, bool nodeUnitTest = false, bool writeSequenceKey = false,
+                     const MPIWrapperPtr& mpi = nullptr, bool mergeShards = false)
     {
         // In case of unit test, make sure backprop works
         ScopedNetworkOperationMode modeGuard(m_net, nodeUnitTest ? NetworkOperationMode::training : NetworkOperationMode::inferring);
@@ -199,6 +205,15 @@ public:
         if ((formattingOptions.isCategoryLabel || formattingOptions.isSparse) && !formattingOptions.labelMappingFile.empty())
             File::LoadLabelFile(formattingOptions.labelMappingFile, labelMapping);
 
+        bool useDistributedMBReading = !nodeUnitTest && UseDistributedWriting(dataReader, mpi);
+        const std::wstring mergedOutputPath = outputPath;
+        if (useDistributedMBReading)
+        {
+            if (outputPath == L"-")
+                InvalidArgument("Writing the output to stdout is not supported with multiple workers.");
+            outputPath = ShardPath(outputPath, mpi->CurrentNodeRank());
+        }
+
         // open output files
         File::MakeIntermediateDirs(outputPath);
         std::map<ComputationNodeBasePtr, shared_ptr<File>> outputStreams; // TODO: why does unique_ptr not work here? Complains about non-existent default_delete()
@@ -212,7 +227,10 @@ public:
         }
 
         // evaluate with minibatches
-        dataReader.StartMinibatchLoop(mbSize, 0, inputMatrices.GetStreamDescriptions(), numOutputSamples);
+        if (useDistributedMBReading)
+            dataReader.StartDistributedMinibatchLoop(mbSize, 0, mpi->CurrentNodeRank(), mpi->NumNodesInUse(), inputMatrices.GetStreamDescriptions(), numOutputSamples);
+        else
+            dataReader.StartMinibatchLoop(mbSize, 0, inputMatrices.GetStreamDescriptions(), numOutputSamples);
 
         m_net->StartEvaluateMinibatchLoop(outputNodes);
 
@@ -230,7 +248,7 @@ public:
         char formatChar = !formattingOptions.isCategoryLabel ? 'f' : !formattingOptions.labelMappingFile.empty() ? 's' : 'u';
         std::string valueFormatString = "%" + formattingOptions.precisionFormat + formatChar; // format string used in fprintf() for formatting the values
 
-        for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize, nullptr); numMBsRun++)
+        for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, useDistributedMBReading, false, inputMatrices, actualMBSize, mpi); numMBsRun++)
         {
             ComputationNetwork::BumpEvalTimeStamp(inputNodes);
             m_net->ForwardProp(outputNodes);
@@ -288,9 +306,190 @@ public:
         // flush all files (where we can catch errors) so that we can then destruct the handle cleanly without error
         for (auto & iter : outputStreams)
             iter.second->Flush();
+
+        if (useDistributedMBReading && mergeShards)
+        {
+            outputStreams.clear();
+            std::vector<std::wstring> fileSuffixes;
+            for (auto& onode : allOutputNodes)
+                fileSuffixes.push_back(L"." + onode->NodeName());
+            MergeShards(mergedOutputPath, fileSuffixes, mpi);
+        }
+    }
+
+    // Writes the output nodes in binary (see BinaryOutputWriter.h) instead of text. The files are written by a background
+    // thread while the next minibatches are evaluated. With MPI, each worker reads its part of the data and writes it
+    // to its own files '<outputPath>.rank<n>...', which are merged in the order of the ranks if 'mergeShards' (raw format only).
+    void WriteBinaryOutput(IDataReader& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, const BinaryOutputOptions& options,
+                           size_t numOutputSamples = requestDataSize, bool writeSequenceKey = false, const MPIWrapperPtr& mpi = nullptr, bool mergeShards = false)
+    {
+        ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+
+        std::vector<ComputationNodeBasePtr> outputNodes = m_net->OutputNodesByName(outputNodeNames);
+        std::vector<ComputationNodeBasePtr> inputNodes = m_net->InputNodesForOutputs(outputNodeNames);
+
+        m_net->AllocateAllMatrices({}, outputNodes, nullptr);
+
+        StreamMinibatchInputs inputMatrices = DataReaderHelpers::RetrieveInputMatrices(inputNodes);
+
+        bool useDistributedMBReading = UseDistributedWriting(dataReader, mpi);
+        const std::wstring mergedOutputPath = outputPath;
+        if (useDistributedMBReading)
+        {
+            if (mergeShards && options.format == BinaryOutputFormat::cbf)
+                InvalidArgument("Merging the shards of the workers is not supported for the CNTK binary format.");
+            outputPath = ShardPath(outputPath, mpi->CurrentNodeRank());
+        }
+
+        if (outputPath == L"-")
+            InvalidArgument("Binary output cannot be written to stdout.");
+        File::MakeIntermediateDirs(outputPath);
+        std::vector<std::pair<std::wstring, size_t>> streams;
+        for (auto& onode : outputNodes)
+            streams.push_back(make_pair(onode->NodeName(), onode->GetSampleLayout().GetNumElements()));
+        BinaryOutputWriter outputWriter(outputPath, options, streams, writeSequenceKey);
+
+        if (useDistributedMBReading)
+            dataReader.StartDistributedMinibatchLoop(mbSize, 0, mpi->CurrentNodeRank(), mpi->NumNodesInUse(), inputMatrices.GetStreamDescriptions(), numOutputSamples);
+        else
+            dataReader.StartMinibatchLoop(mbSize, 0, inputMatrices.GetStreamDescriptions(), numOutputSamples);
+
+        m_net->StartEvaluateMinibatchLoop(outputNodes);
+
+        size_t totalEpochSamples = 0;
+        size_t numSequences = 0;
+        size_t actualMBSize;
+        const size_t numIterationsBeforePrintingProgress = 100;
+        size_t numItersSinceLastPrintOfProgress = 0;
+        for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, useDistributedMBReading, false, inputMatrices, actualMBSize, mpi); numMBsRun++)
+        {
+            ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+            m_net->ForwardProp(outputNodes);
+
+            size_t firstSequence = numSequences;
+            for (size_t i = 0; i < outputNodes.size(); i++)
+            {
+                auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(outputNodes[i]);
+                const Matrix<ElemType>& values = node->Value();
+                unique_ptr<ElemType[]> data(values.CopyToArray());
+                size_t rows = values.GetNumRows();
+
+                MBLayoutPtr pMBLayout = node->GetMBLayout();
+                if (!pMBLayout) // no MBLayout: the columns are a single sequence
+                {
+                    pMBLayout = make_shared<MBLayout>();
+                    pMBLayout->Init(1, values.GetNumCols());
+                    pMBLayout->AddSequence(0, 0, 0, values.GetNumCols());
+                }
+
+                size_t sequenceIndex = firstSequence;
+                for (const auto& seqInfo : pMBLayout->GetAllSequences())
+                {
+                    if (seqInfo.seqId == GAP_SEQUENCE_ID)
+                        continue;
+                    size_t tBegin = seqInfo.tBegin >= 0 ? seqInfo.tBegin : 0;
+                    size_t tEnd = min(seqInfo.tEnd, pMBLayout->GetNumTimeSteps());
+                    if (tBegin >= tEnd)
+                        continue;
+
+                    std::string key = writeSequenceKey && inputMatrices.m_getKeyById ? inputMatrices.m_getKeyById(seqInfo.seqId) : std::to_string(sequenceIndex);
+                    const ElemType* seqData = data.get() + pMBLayout->GetColumnIndex(seqInfo, (size_t)((ptrdiff_t)tBegin - seqInfo.tBegin)) * rows;
+                    outputWriter.WriteSequence(i, key, seqData, tEnd - tBegin, pMBLayout->GetNumParallelSequences() * rows);
+                    sequenceIndex++;
+                }
+                numSequences = max(numSequences, sequenceIndex);
+            }
+            outputWriter.EndMinibatch();
+
+            totalEpochSamples += actualMBSize;
+            numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
+
+            dataReader.DataEnd();
+        }
+
+        outputWriter.Close();
+        fprintf(stderr, "Written to %ls*\nTotal Samples Evaluated = %lu\n", outputPath.c_str(), (unsigned long)totalEpochSamples);
+
+        if (useDistributedMBReading && mergeShards)
+        {
+            std::vector<std::wstring> fileSuffixes;
+            for (auto& stream : streams)
+            {
+                fileSuffixes.push_back(L"." + stream.first);
+                fileSuffixes.push_back(L"." + stream.first + L".index");
+            }
+            MergeShards(mergedOutputPath, fileSuffixes, mpi);
+        }
     }
 
 private:
+    // Whether the workers write their parts of the data in parallel.
+    static bool UseDistributedWriting(IDataReader& dataReader, const MPIWrapperPtr& mpi)
+    {
+        if (!mpi || mpi->NumNodesInUse() <= 1)
+            return false;
+        if (!dataReader.SupportsDistributedMBRead())
+            InvalidArgument("Writing the output with multiple workers requires a reader that supports distributed reading.");
+        return true;
+    }
+
+    static std::wstring ShardPath(const std::wstring& outputPath, size_t rank)
+    {
+        return outputPath + msra::strfun::wstrprintf(L".rank%d", (int)rank);
+    }
+
+    // Concatenates the files of the workers in the order of the ranks into the files a single worker would write, and
+    // deletes them. The sample offsets in '.index' files of the binary output are renumbered on the way. Called by all workers;
+    // the main worker merges once everybody has written its files.
+    static void MergeShards(const std::wstring& outputPath, const std::vector<std::wstring>& fileSuffixes, const MPIWrapperPtr& mpi)
+    {
+        mpi->WaitAll();
+        if (mpi->IsMainNode())
+        {
+            std::vector<char> buffer(16 * 1024 * 1024);
+            for (const auto& suffix : fileSuffixes)
+            {
+                bool isIndex = suffix.size() >= 6 && suffix.compare(suffix.size() - 6, 6, L".index") == 0;
+                FILE* merged = fopenOrDie(outputPath + suffix, isIndex ? L"w" : L"wb");
+                unsigned long long numSamples = 0; // index: samples of the previous sequences
+                for (size_t rank = 0; rank < mpi->NumNodesInUse(); rank++)
+                {
+                    std::wstring shardPath = ShardPath(outputPath, rank) + suffix;
+                    FILE* shard = fopenOrDie(shardPath, isIndex ? L"r" : L"rb");
+                    if (isIndex) // lines 'key firstSample numSamples'
+                    {
+                        char line[4096];
+                        while (fgets(line, sizeof(line), shard))
+                        {
+                            std::string entry(line);
+                            size_t numSamplesPos = entry.find_last_of(' ');
+                            size_t firstSamplePos = numSamplesPos == std::string::npos ? std::string::npos : entry.find_last_of(' ', numSamplesPos - 1);
+                            if (firstSamplePos == std::string::npos)
+                                RuntimeError("MergeShards: malformed line in '%ls': %s", shardPath.c_str(), line);
+                            unsigned long long sequenceSamples = std::stoull(entry.substr(numSamplesPos + 1));
+                            fprintfOrDie(merged, "%s %llu %llu\n", entry.substr(0, firstSamplePos).c_str(), numSamples, sequenceSamples);
+                            numSamples += sequenceSamples;
+                        }
+                    }
+                    else
+                    {
+                        size_t n;
+                        while ((n = fread(buffer.data(), 1, buffer.size(), shard)) > 0)
+                            fwriteOrDie(buffer.data(), 1, n, merged);
+                    }
+                    if (ferror(shard))
+                        RuntimeError("MergeShards: error reading '%ls'.", shardPath.c_str());
+                    fclose(shard);
+                    unlinkOrDie(shardPath);
+                }
+                fflushOrDie(merged);
+                fcloseOrDie(merged);
+            }
+            fprintf(stderr, "Merged the outputs of %d workers into %ls*\n", (int)mpi->NumNodesInUse(), outputPath.c_str());
+        }
+        mpi->WaitAll();
+    }
+
     ComputationNetworkPtr m_net;
     int m_verbosity;
     void operator=(const SimpleOutputWriter&); // (not assignable)
@@ -0,0 +1,266 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "SimpleDistGradAggregator.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <unordered_map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Gradient aggregation that sends only the largest entries of large gradients (top-k sparsification with error feedback),
+// for training that is bound by the network bandwidth, e.g. with large embeddings or fully connected layers.
+//
+// Each worker keeps a residual for every sparse gradient: the gradient is added to the residual, the k entries of the
+// residual with the largest magnitude are sent and removed from it, the rest is carried over to the next minibatches.
+// The (index, value) pairs of all workers are exchanged by allgatherv and summed into the gradient. k is the given fraction
+// of the gradient size, or the number of non-zero entries if it is less.
+//
+// A gradient is aggregated sparse if it is at least minSparseSizeInBytes large and the pairs of all workers are smaller
+// than what a dense allreduce moves, as measured on the density of its residual. All workers decide on the first minibatch
+// and at the start of each epoch, on the largest density of any worker. The dense gradients, and the header, are aggregated
+// by a SimpleDistGradAggregator, as are sparse gradient matrices (by their non-zero columns).
+template <class ElemType>
+class TopKDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    TopKDistGradAggregator(const MPIWrapperPtr& mpi, double topKFraction, size_t minSparseSizeInBytes, int deviceId, int syncStatsTrace,
+                           size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES,
+                           double sparseGradientDensityThreshold = DEFAULT_SPARSE_GRADIENT_DENSITY_THRESHOLD)
+        : IDistGradAggregator<ElemType>(mpi), m_topKFraction(topKFraction), m_minSparseSizeInBytes(minSparseSizeInBytes), m_deviceId(deviceId),
+        m_syncStatsTrace(syncStatsTrace), m_packThresholdSizeInBytes(packThresholdSizeInBytes), m_sparseGradientDensityThreshold(sparseGradientDensityThreshold),
+        m_iterationCount(0)
+    {
+        if (topKFraction <= 0 || topKFraction > 1)
+            InvalidArgument("TopKDistGradAggregator: the fraction of the gradient entries to send must be in (0, 1].");
+    }
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) override
+    {
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+
+        // The header is aggregated with the dense gradients below, here it tells whether this worker computed a gradient.
+        bool hasSamples = headerCPU->numSamples != 0;
+        if (m_denseAggregator == nullptr || resetState)
+            PartitionGradients(gradients, hasSamples);
+
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        size_t numPairsSent = 0;
+        for (auto& sparseGradient : m_sparseGradients)
+            numPairsSent += AggregateSparse(sparseGradient, hasSamples);
+        m_residualIncludesGradient = false;
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Sparse gradient aggregation time: %.6g (%d entries sent)\n", aggregationTimer.ElapsedSeconds(), (int)numPairsSent);
+        }
+
+        return m_denseAggregator->AggregateGradients(m_denseGradients.empty() ? m_headerOnlyGradients : m_denseGradients, headerCPU, resetState);
+    }
+
+private:
+    struct SparseGradient
+    {
+        Matrix<ElemType>* gradient;
+        size_t k; // maximum number of entries sent per minibatch
+    };
+
+    // Decides for each gradient whether to aggregate it sparse or dense, see above.
+    void PartitionGradients(const std::vector<Matrix<ElemType>*>& gradients, bool hasSamples)
+    {
+        m_residualIncludesGradient = false;
+        std::vector<Matrix<ElemType>*> candidates;
+        std::vector<size_t> numNonZeros;
+        for (auto gradient : gradients)
+        {
+            // sparse gradient matrices are aggregated dense, i.e. by SimpleDistGradAggregator
+            if (gradient->GetMatrixType() != DENSE)
+                continue;
+
+            size_t numElements = gradient->GetNumElements();
+            if (sizeof(ElemType) * numElements < m_minSparseSizeInBytes || numElements > INT_MAX)
+                continue;
+
+            ElemType* residual = AccumulateResidual(gradient, hasSamples);
+            candidates.push_back(gradient);
+            numNonZeros.push_back(numElements - std::count(residual, residual + numElements, (ElemType)0));
+        }
+
+        // all workers take the same decision, on the densest residual of any worker
+        if (!numNonZeros.empty())
+            m_mpi->AllReduce(numNonZeros.data(), numNonZeros.size(), MPI_MAX);
+
+        std::vector<Matrix<ElemType>*> denseGradients;
+        std::vector<SparseGradient> sparseGradients;
+        size_t sparseSizeInBytes = 0, totalSizeInBytes = 0;
+        for (auto gradient : gradients)
+        {
+            totalSizeInBytes += sizeof(ElemType) * gradient->GetNumElements();
+
+            auto candidate = std::find(candidates.begin(), candidates.end(), gradient);
+            if (candidate != candidates.end())
+            {
+                size_t numElements = gradient->GetNumElements();
+                size_t k = std::min(numNonZeros[candidate - candidates.begin()], (size_t)std::ceil(m_topKFraction * numElements));
+
+                // A ring allreduce moves about twice the gradient through each worker, the allgatherv the pairs of all workers.
+                if (NumProc() * k * (sizeof(int) + sizeof(ElemType)) < 2 * numElements * sizeof(ElemType))
+                {
+                    sparseGradients.push_back(SparseGradient{ gradient, std::max<size_t>(k, 1) });
+                    sparseSizeInBytes += sizeof(ElemType) * numElements;
+                    continue;
+                }
+            }
+
+            denseGradients.push_back(gradient);
+        }
+
+        // The residuals that were accumulated for the measurement, or in earlier epochs, of the gradients that are
+        // aggregated dense now are added to the gradient; the gradients that are aggregated sparse take it into account
+        // when they are aggregated (AccumulateResidual() does not add the gradient a second time).
+        for (auto gradient : denseGradients)
+        {
+            auto residual = m_residuals.find(gradient);
+            if (residual == m_residuals.end())
+                continue;
+
+            Matrix<ElemType> residualOnDevice(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId());
+            residualOnDevice.SetValue(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId(), residual->second.data());
+            gradient->AssignValuesOf(residualOnDevice);
+            m_residuals.erase(residual);
+        }
+        m_residualIncludesGradient = true;
+
+        if (m_denseAggregator == nullptr || denseGradients != m_denseGradients)
+        {
+            m_denseGradients = denseGradients;
+            m_denseAggregator = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, false /*useAsyncAggregation*/, m_deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes,
+                                                                                     0 /*bucketSizeInBytes*/, m_sparseGradientDensityThreshold);
+            if (m_denseGradients.empty())
+            {
+                // The header is aggregated by the dense aggregator, which needs a gradient to work with.
+                m_headerOnlyGradient.reset(new Matrix<ElemType>(1, 1, m_deviceId));
+                m_headerOnlyGradient->SetValue(0);
+                m_headerOnlyGradients.assign(1, m_headerOnlyGradient.get());
+            }
+        }
+        m_sparseGradients = sparseGradients;
+
+        fprintf(stderr, "TopKDistGradAggregator: aggregating %d of %d gradients sparse (%.1f of %.1f MB, sending at most %.3g%% of their entries).\n",
+                (int)m_sparseGradients.size(), (int)gradients.size(), sparseSizeInBytes / (1024.0 * 1024), totalSizeInBytes / (1024.0 * 1024), 100 * m_topKFraction);
+    }
+
+    // Returns the residual of the gradient on the CPU, with the gradient added to it unless it was added already.
+    ElemType* AccumulateResidual(Matrix<ElemType>* gradient, bool addGradient)
+    {
+        size_t numElements = gradient->GetNumElements();
+        auto& residual = m_residuals[gradient];
+        residual.resize(numElements, 0);
+
+        if (addGradient && !m_residualIncludesGradient)
+        {
+            m_gradientBuffer.resize(numElements);
+            gradient->CopySection(gradient->GetNumRows(), gradient->GetNumCols(), m_gradientBuffer.data(), gradient->GetNumRows());
+            for (size_t i = 0; i < numElements; ++i)
+                residual[i] += m_gradientBuffer[i];
+        }
+
+        return residual.data();
+    }
+
+    // Sends the k largest entries of the residual, and replaces the gradient by the sum of the entries sent by all workers.
+    // Returns the number of entries sent.
+    size_t AggregateSparse(const SparseGradient& sparseGradient, bool hasSamples)
+    {
+        Matrix<ElemType>* gradient = sparseGradient.gradient;
+        size_t numElements = gradient->GetNumElements();
+        ElemType* residual = AccumulateResidual(gradient, hasSamples);
+
+        m_indices.clear();
+        for (size_t i = 0; i < numElements; ++i)
+        {
+            if (residual[i] != 0)
+                m_indices.push_back((int)i);
+        }
+
+        if (m_indices.size() > sparseGradient.k)
+        {
+            std::nth_element(m_indices.begin(), m_indices.begin() + sparseGradient.k, m_indices.end(),
+                             [residual](int a, int b) { return std::abs(residual[a]) > std::abs(residual[b]); });
+            m_indices.resize(sparseGradient.k);
+        }
+
+        m_values.resize(m_indices.size());
+        for (size_t i = 0; i < m_indices.size(); ++i)
+        {
+            m_values[i] = residual[m_indices[i]];
+            residual[m_indices[i]] = 0;
+        }
+
+        // exchange the pairs of all workers
+        int numSent = (int)m_indices.size();
+        std::vector<int> numReceived(NumProc()), offsets(NumProc());
+        m_mpi->Allgather(&numSent, 1, MPI_INT, numReceived.data(), 1, MPI_INT);
+        int numTotal = 0;
+        for (size_t i = 0; i < NumProc(); ++i)
+        {
+            offsets[i] = numTotal;
+            numTotal += numReceived[i];
+        }
+
+        m_allIndices.resize(std::max(numTotal, 1));
+        m_allValues.resize(std::max(numTotal, 1));
+        m_mpi->Allgatherv(m_indices.data(), numSent, MPI_INT, m_allIndices.data(), numReceived.data(), offsets.data(), MPI_INT);
+        m_mpi->Allgatherv(m_values.data(), numSent, MPIWrapper::GetDataType(m_values.data()), m_allValues.data(), numReceived.data(), offsets.data(), MPIWrapper::GetDataType(m_values.data()));
+
+        m_gradientBuffer.assign(numElements, 0);
+        for (int i = 0; i < numTotal; ++i)
+            m_gradientBuffer[m_allIndices[i]] += m_allValues[i];
+
+        gradient->SetValue(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId(), m_gradientBuffer.data());
+        return numSent;
+    }
+
+    const double m_topKFraction;
+    const size_t m_minSparseSizeInBytes;
+    const int m_deviceId;
+    const int m_syncStatsTrace;
+    const size_t m_packThresholdSizeInBytes;
+    const double m_sparseGradientDensityThreshold;
+
+    // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
+    size_t m_iterationCount;
+
+    std::vector<SparseGradient> m_sparseGradients;
+    std::unordered_map<const Matrix<ElemType>*, std::vector<ElemType>> m_residuals; // error feedback of the sparse gradients, on the CPU
+
+    // The gradient of the current minibatch was added to the residuals while measuring the density already.
+    bool m_residualIncludesGradient = false;
+
+    std::vector<Matrix<ElemType>*> m_denseGradients;
+    std::shared_ptr<SimpleDistGradAggregator<ElemType>> m_denseAggregator;
+    std::unique_ptr<Matrix<ElemType>> m_headerOnlyGradient;
+    std::vector<Matrix<ElemType>*> m_headerOnlyGradients;
+
+    // Temp buffers to avoid allocations.
+    std::vector<ElemType> m_gradientBuffer;
+    std::vector<int> m_indices;
+    std::vector<ElemType> m_values;
+    std::vector<int> m_allIndices;
+    std::vector<ElemType> m_allValues;
+};
+
+} } }
@@ -12,6 +12,8 @@
 #include "CNTKLibrary.h"
 #include "IDistGradAggregator.h"
 #include "TimerUtility.h"
+#include "PerformanceProfiler.h"
+#include "ThreadPool.h"
 #include "MatrixQuantizerImpl.h"
 #include "Utils.h"
 #include "NcclComm.h"
@@ -33,6 +35,10 @@ public:
 
     ~V2SimpleDistGradAggregator()
     {
+        // the aggregation runs on the thread pool, whose futures do not wait when destroyed
+        if (m_pendingAsyncAggregation.valid())
+            m_pendingAsyncAggregation.wait();
+
         if (m_bufferedGradHeader != nullptr)
             DistGradHeader::Destroy(m_bufferedGradHeader);
     }
@@ -102,10 +108,11 @@ public:
             DistGradHeader* newGradHeader = m_bufferedGradHeader;
             MatrixComputeStreamEvent* mainStreamSyncEvent = MatrixComputeStreamEvent::Create(deviceId);
 
-            m_pendingAsyncAggregation = std::async(std::launch::async, [=] {
+            m_pendingAsyncAggregation = ThreadPool::Instance().Async(std::launch::async, [=] {
                 // We are starting on a new thread. Make sure the new thread is
                 // setup to use the right device
                 Matrix<ElemType>::SetDevice(deviceId);
+                ProfilerSetThreadName("Gradient Aggregation");
 
                 // Synchronize the Quantization compute stream with the completion of
                 // compute of the gradient matrices on the main compute stream
@@ -113,7 +120,7 @@ public:
                 delete mainStreamSyncEvent;
 
                 AggregateGradientsImpl(newGradients, newGradHeader, showSyncPerfStats);
-            });
+            }, ThreadPoolPriority::high);
 
             return true;
         }
@@ -0,0 +1,320 @@
+// denominatorgraph.cpp -- denominator graph of the lattice-free MMI criterion, and its forward-backward over a minibatch
+//
+// The forward-backward uses the kernels in latticefunctionskernels.h, launched through cudalattice.h on a GPU and
+// called in OpenMP loops on the CPU.
+
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+#endif
+
+#include "Basics.h"
+#include "BestGpu.h" // for CPUONLY
+#include "fileutil.h"
+#include "denominatorgraph.h"
+#include "cudalattice.h"
+#include "latticefunctionskernels.h" // for the CPU version
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+namespace msra { namespace lattices {
+
+// -----------------------------------------------------------------------
+// denominatorgraphimpl --the arcs, and the buffers of the GPU version
+// -----------------------------------------------------------------------
+
+struct denominatorgraphimpl
+{
+    // the arcs three times: by the state they enter, by the state they leave, and by their pdf, each with [key] -> first arc
+    vector<denominatorarc> inarcs;
+    vector<unsigned int> inarcoffsets;
+    vector<denominatorarc> outarcs;
+    vector<unsigned int> outarcoffsets;
+    vector<denominatorarc> pdfarcs;
+    vector<unsigned int> pdfarcoffsets;
+    vector<float> loginitial; // [state] 0 for the start state, LOGZERO for the others
+    vector<float> logfinal;   // [state] log of the final weight, LOGZERO if not final
+
+    // copy of the graph on a GPU, and the buffers of the forward-backward there; created when first used
+    struct gpustate
+    {
+        int deviceid;
+        unique_ptr<msra::cuda::denominatorarcvector> inarcsgpu, outarcsgpu, pdfarcsgpu;
+        unique_ptr<msra::cuda::uintvector> inarcoffsetsgpu, outarcoffsetsgpu, pdfarcoffsetsgpu;
+        unique_ptr<msra::cuda::floatvector> loginitialgpu, logfinalgpu;
+        unique_ptr<msra::cuda::uintvector> uttfirstcolsgpu, uttframesgpu;
+        unique_ptr<msra::cuda::floatvector> logtotalsgpu;
+        Matrix<float> logalphasgpu, logbetasgpu;
+
+        gpustate(int deviceid, const denominatorgraphimpl& graph)
+            : deviceid(deviceid),
+              inarcsgpu(msra::cuda::newdenominatorarcvector(deviceid)),
+              outarcsgpu(msra::cuda::newdenominatorarcvector(deviceid)),
+              pdfarcsgpu(msra::cuda::newdenominatorarcvector(deviceid)),
+              inarcoffsetsgpu(msra::cuda::newuintvector(deviceid)),
+              outarcoffsetsgpu(msra::cuda::newuintvector(deviceid)),
+              pdfarcoffsetsgpu(msra::cuda::newuintvector(deviceid)),
+              loginitialgpu(msra::cuda::newfloatvector(deviceid)),
+              logfinalgpu(msra::cuda::newfloatvector(deviceid)),
+              uttfirstcolsgpu(msra::cuda::newuintvector(deviceid)),
+              uttframesgpu(msra::cuda::newuintvector(deviceid)),
+              logtotalsgpu(msra::cuda::newfloatvector(deviceid)),
+              logalphasgpu(deviceid),
+              logbetasgpu(deviceid)
+        {
+            inarcsgpu->assign(graph.inarcs, false);
+            outarcsgpu->assign(graph.outarcs, false);
+            pdfarcsgpu->assign(graph.pdfarcs, false);
+            inarcoffsetsgpu->assign(graph.inarcoffsets, false);
+            outarcoffsetsgpu->assign(graph.outarcoffsets, false);
+            pdfarcoffsetsgpu->assign(graph.pdfarcoffsets, false);
+            loginitialgpu->assign(graph.loginitial, false);
+            logfinalgpu->assign(graph.logfinal, true);
+        }
+    };
+    unique_ptr<gpustate> gpu;
+
+    size_t getnumstates() const
+    {
+        return loginitial.size();
+    }
+    size_t getnumpdfs() const
+    {
+        return pdfarcoffsets.empty() ? 0 : pdfarcoffsets.size() - 1;
+    }
+
+    // sorts the arcs by key(arc) < numkeys, stable, and sets offsets[k] to the first arc of key k
+    template <class KEY>
+    static void bucketarcs(const vector<denominatorarc>& arcs, size_t numkeys, KEY key, vector<denominatorarc>& sorted, vector<unsigned int>& offsets)
+    {
+        offsets.assign(numkeys + 1, 0);
+        for (const auto& arc : arcs)
+            offsets[key(arc) + 1]++;
+        for (size_t k = 0; k < numkeys; k++)
+            offsets[k + 1] += offsets[k];
+        sorted.resize(arcs.size());
+        vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+        for (const auto& arc : arcs)
+            sorted[next[key(arc)]++] = arc;
+    }
+
+    void parse(const vector<string>& lines)
+    {
+        vector<denominatorarc> arcs;
+        vector<pair<unsigned int, float>> finals;
+        size_t numstates = 0;
+        size_t numpdfs = 0;
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            istringstream is(lines[i]);
+            vector<string> fields;
+            for (string field; is >> field;)
+                fields.push_back(field);
+            if (fields.empty())
+                continue;
+            if (fields.size() != 4 && fields.size() != 5 && fields.size() > 2)
+                RuntimeError("DenominatorGraph: Line %d has %d fields, expected 'from to ilabel olabel [cost]' or 'state [cost]'.", (int) i + 1, (int) fields.size());
+            const float cost = (fields.size() == 2 || fields.size() == 5) ? stof(fields.back()) : 0.0f;
+            if (fields.size() <= 2) // final state
+            {
+                const unsigned int state = (unsigned int) stoul(fields[0]);
+                finals.push_back(make_pair(state, -cost));
+                numstates = max(numstates, (size_t) state + 1);
+                continue;
+            }
+            denominatorarc arc;
+            arc.from = (unsigned int) stoul(fields[0]);
+            arc.to = (unsigned int) stoul(fields[1]);
+            const unsigned int ilabel = (unsigned int) stoul(fields[2]);
+            if (ilabel == 0)
+                RuntimeError("DenominatorGraph: Line %d is an epsilon arc; the graph must emit a pdf on every arc.", (int) i + 1);
+            arc.pdf = ilabel - 1;
+            arc.logweight = -cost;
+            arcs.push_back(arc);
+            numstates = max(numstates, (size_t) max(arc.from, arc.to) + 1);
+            numpdfs = max(numpdfs, (size_t) arc.pdf + 1);
+        }
+        if (arcs.empty())
+            RuntimeError("DenominatorGraph: The graph has no arcs.");
+        if (finals.empty())
+            RuntimeError("DenominatorGraph: The graph has no final states.");
+
+        loginitial.assign(numstates, LOGZERO);
+        loginitial[arcs.front().from] = 0.0f; // the start state comes first
+        logfinal.assign(numstates, LOGZERO);
+        for (const auto& final : finals)
+            logfinal[final.first] = final.second;
+        bucketarcs(arcs, numstates, [](const denominatorarc& arc) { return arc.to; }, inarcs, inarcoffsets);
+        bucketarcs(arcs, numstates, [](const denominatorarc& arc) { return arc.from; }, outarcs, outarcoffsets);
+        bucketarcs(arcs, numpdfs, [](const denominatorarc& arc) { return arc.pdf; }, pdfarcs, pdfarcoffsets);
+        gpu.reset(); // uploaded again when next used
+    }
+
+    static size_t getmaxframes(const vector<unsigned int>& uttframes)
+    {
+        return uttframes.empty() ? 0 : *max_element(uttframes.begin(), uttframes.end());
+    }
+
+    static double sumoflogtotals(const vector<float>& logtotals, const vector<unsigned int>& uttframes)
+    {
+        double sum = 0;
+        for (size_t u = 0; u < logtotals.size(); u++)
+        {
+            if (uttframes[u] > 0 && logtotals[u] <= LOGZERO)
+                RuntimeError("DenominatorGraph: No path through the graph for an utterance of %d frames.", (int) uttframes[u]);
+            sum += logtotals[u];
+        }
+        return sum;
+    }
+
+    // column-major host matrix, with the interface of matrixref<> that the kernels use
+    struct hostmatrixref
+    {
+        float* p;
+        size_t numrows;
+        hostmatrixref(float* p, size_t numrows)
+            : p(p), numrows(numrows)
+        {
+        }
+        float& operator()(size_t i, size_t j)
+        {
+            return p[j * numrows + i];
+        }
+        const float& operator()(size_t i, size_t j) const
+        {
+            return p[j * numrows + i];
+        }
+    };
+
+    double forwardbackwardoncpu(const float* logLLs, size_t numrows, size_t numcols, const vector<unsigned int>& uttfirstcols,
+                                const vector<unsigned int>& uttframes, size_t numchannels, float* posteriors) const
+    {
+        const size_t numstates = getnumstates();
+        const size_t numutts = uttframes.size();
+        const size_t maxframes = getmaxframes(uttframes);
+        vector<float> logalphas(numstates * numcols, LOGZERO);
+        vector<float> logbetas(numstates * numcols, LOGZERO);
+        const hostmatrixref logLLsref(const_cast<float*>(logLLs), numrows);
+        hostmatrixref logalphasref(logalphas.data(), numstates);
+        hostmatrixref logbetasref(logbetas.data(), numstates);
+        hostmatrixref posteriorsref(posteriors, numrows);
+
+        // same launches as latticefunctionsops::denominatorforwardbackward(), as parallel loops
+        const long numstatethreads = (long) (numutts * numstates);
+        for (size_t t = 0; t < maxframes; t++)
+        {
+#pragma omp parallel for
+            for (long j = 0; j < numstatethreads; j++)
+                latticefunctionskernels::denominatorforwardj((size_t) j, t, inarcs, inarcoffsets, loginitial, uttfirstcols, uttframes, numchannels, logLLsref, logalphasref);
+        }
+        for (size_t t = maxframes; t-- > 0;)
+        {
+#pragma omp parallel for
+            for (long j = 0; j < numstatethreads; j++)
+                latticefunctionskernels::denominatorbackwardj((size_t) j, t, outarcs, outarcoffsets, logfinal, uttfirstcols, uttframes, numchannels, logLLsref, logbetasref);
+        }
+        vector<float> logtotals(numutts);
+        for (size_t u = 0; u < numutts; u++)
+            latticefunctionskernels::denominatortotalu(u, loginitial, uttfirstcols, uttframes, logbetasref, logtotals);
+        const long numpdfthreads = (long) (numutts * maxframes * getnumpdfs());
+#pragma omp parallel for
+        for (long j = 0; j < numpdfthreads; j++)
+            latticefunctionskernels::denominatorposteriorj((size_t) j, pdfarcs, pdfarcoffsets, loginitial, logfinal, uttfirstcols, uttframes, numchannels, maxframes,
+                                                           logLLsref, logalphasref, logbetasref, logtotals, posteriorsref);
+        return sumoflogtotals(logtotals, uttframes);
+    }
+
+    double forwardbackwardongpu(const Matrix<float>& logLLs, const vector<unsigned int>& uttfirstcols, const vector<unsigned int>& uttframes,
+                                size_t numchannels, Matrix<float>& posteriors)
+    {
+        const int deviceid = logLLs.GetDeviceId();
+        if (!gpu || gpu->deviceid != deviceid)
+            gpu.reset(new gpustate(deviceid, *this));
+        gpu->uttfirstcolsgpu->assign(uttfirstcols, false);
+        gpu->uttframesgpu->assign(uttframes, false);
+        gpu->logtotalsgpu->allocate(uttframes.size());
+        gpu->logalphasgpu.Resize(getnumstates(), logLLs.GetNumCols());
+        gpu->logbetasgpu.Resize(getnumstates(), logLLs.GetNumCols());
+
+        unique_ptr<msra::cuda::latticefunctions> latticefunctions(msra::cuda::newlatticefunctions(deviceid));
+        latticefunctions->denominatorforwardbackward(*gpu->inarcsgpu, *gpu->inarcoffsetsgpu, *gpu->outarcsgpu, *gpu->outarcoffsetsgpu,
+                                                     *gpu->pdfarcsgpu, *gpu->pdfarcoffsetsgpu, *gpu->loginitialgpu, *gpu->logfinalgpu,
+                                                     *gpu->uttfirstcolsgpu, *gpu->uttframesgpu, numchannels, getmaxframes(uttframes), logLLs,
+                                                     gpu->logalphasgpu, gpu->logbetasgpu, *gpu->logtotalsgpu, posteriors);
+        // the only transfer back: one value per utterance
+        vector<float> logtotals;
+        gpu->logtotalsgpu->fetch(logtotals, true);
+        return sumoflogtotals(logtotals, uttframes);
+    }
+};
+
+// -----------------------------------------------------------------------
+// DenominatorGraph
+// -----------------------------------------------------------------------
+
+DenominatorGraph::DenominatorGraph()
+    : m_impl(new denominatorgraphimpl())
+{
+}
+
+DenominatorGraph::~DenominatorGraph()
+{
+}
+
+void DenominatorGraph::Read(const wstring& path)
+{
+    m_impl->parse(msra::files::fgetfilelines(path));
+    fprintf(stderr, "DenominatorGraph: %d states, %d arcs, %d pdfs read from %ls\n", (int) GetNumStates(), (int) GetNumArcs(), (int) GetNumPdfs(), path.c_str());
+}
+
+void DenominatorGraph::Parse(const vector<string>& lines)
+{
+    m_impl->parse(lines);
+}
+
+size_t DenominatorGraph::GetNumStates() const
+{
+    return m_impl->getnumstates();
+}
+
+size_t DenominatorGraph::GetNumPdfs() const
+{
+    return m_impl->getnumpdfs();
+}
+
+size_t DenominatorGraph::GetNumArcs() const
+{
+    return m_impl->inarcs.size();
+}
+
+double DenominatorGraph::ForwardBackward(const Matrix<float>& logLLs, const vector<unsigned int>& uttfirstcols, const vector<unsigned int>& uttframes,
+                                         size_t numchannels, Matrix<float>& posteriors)
+{
+    if (GetNumStates() == 0)
+        LogicError("DenominatorGraph: ForwardBackward called before the graph was read.");
+    if (logLLs.GetNumRows() < GetNumPdfs())
+        InvalidArgument("DenominatorGraph: The graph has %d pdfs, but the scores only %d rows.", (int) GetNumPdfs(), (int) logLLs.GetNumRows());
+    if (uttfirstcols.size() != uttframes.size())
+        InvalidArgument("DenominatorGraph: Mismatching number of utterance first columns and lengths.");
+
+    posteriors.Resize(logLLs.GetNumRows(), logLLs.GetNumCols());
+    posteriors.SetValue(0);
+    if (logLLs.GetDeviceId() != CPUDEVICE)
+        return m_impl->forwardbackwardongpu(logLLs, uttfirstcols, uttframes, numchannels, posteriors);
+    return m_impl->forwardbackwardoncpu(logLLs.Data(), logLLs.GetNumRows(), logLLs.GetNumCols(), uttfirstcols, uttframes, numchannels, posteriors.Data());
+}
+
+// The kernels only exist for float; double runs them on a float copy on the CPU.
+double DenominatorGraph::ForwardBackward(const Matrix<double>& logLLs, const vector<unsigned int>& uttfirstcols, const vector<unsigned int>& uttframes,
+                                         size_t numchannels, Matrix<double>& posteriors)
+{
+    Matrix<float> logLLsFloat(CPUDEVICE);
+    logLLsFloat.CastAssignValuesOf(logLLs);
+    Matrix<float> posteriorsFloat(CPUDEVICE);
+    const double logtotal = ForwardBackward(logLLsFloat, uttfirstcols, uttframes, numchannels, posteriorsFloat);
+    posteriors.CastAssignValuesOf(posteriorsFloat);
+    return logtotal;
+}
+} }
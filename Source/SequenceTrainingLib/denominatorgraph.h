@@ -0,0 +1,46 @@
+// denominatorgraph.h -- denominator graph of the lattice-free MMI criterion, and its forward-backward over a minibatch
+//
+// The graph is a phone-LM FST compiled down to pdfs, read from the text form that 'fstprint' writes:
+//  - arc lines:   "from to ilabel olabel [cost]"; ilabel is the pdf index + 1, as in Kaldi, since 0 is epsilon
+//  - final lines: "state [cost]"
+// The start state is the source of the first arc, and costs are negated log weights. Epsilon arcs are not allowed;
+// every arc emits exactly one frame.
+
+#pragma once
+
+#include "Matrix.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace msra { namespace lattices {
+
+struct denominatorgraphimpl; // the arcs, and the buffers of the GPU version
+
+class DenominatorGraph
+{
+public:
+    DenominatorGraph();
+    ~DenominatorGraph();
+
+    void Read(const std::wstring& path);
+    void Parse(const std::vector<std::string>& lines); // the lines of the text file
+
+    size_t GetNumStates() const;
+    size_t GetNumPdfs() const;
+    size_t GetNumArcs() const;
+
+    // Forward-backward of the utterances of a minibatch through the graph, all at once.
+    // Utterance u takes the columns uttfirstcols[u] + t * numchannels, t < uttframes[u], of 'logLLs', which holds the network's
+    // log scores of the pdfs (at least GetNumPdfs() rows). Sets 'posteriors' to the pdf posteriors of those columns (0 elsewhere)
+    // and returns the sum of the log total scores of the utterances.
+    // Float matrices on a GPU run in CUDA kernels; anything else runs on the CPU, with the same kernels.
+    double ForwardBackward(const Microsoft::MSR::CNTK::Matrix<float>& logLLs, const std::vector<unsigned int>& uttfirstcols,
+                           const std::vector<unsigned int>& uttframes, size_t numchannels, Microsoft::MSR::CNTK::Matrix<float>& posteriors);
+    double ForwardBackward(const Microsoft::MSR::CNTK::Matrix<double>& logLLs, const std::vector<unsigned int>& uttfirstcols,
+                           const std::vector<unsigned int>& uttframes, size_t numchannels, Microsoft::MSR::CNTK::Matrix<double>& posteriors);
+
+private:
+    std::unique_ptr<denominatorgraphimpl> m_impl;
+};
+} }
@@ -98,6 +98,13 @@ public:
                        std::vector<size_t>& extrauttmap,
                        bool doreferencealign)
     {
+        // on the GPU, all lattices of the minibatch go through forward-backward together unless aligning to the reference
+        if (m_deviceid != CPUDEVICE && !doreferencealign)
+        {
+            calgammaformbbatch(functionValues, lattices, loglikelihood, gammafromlattice, uids, samplesInRecurrentStep, pMBLayout, extrauttmap);
+            return;
+        }
+
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
         size_t boundaryframenum;
@@ -151,23 +158,7 @@ public:
             {
                 // get number of frames for the utterance
                 mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
-
-                // scan MBLayout for end of utterance
-                size_t mapframenum = SIZE_MAX; // duration of utterance [i] as determined from MBLayout
-                for (size_t t = validframes[mapi]; t < T; t++)
-                {
-                    // TODO: Adapt this to new MBLayout, m_sequences would be easier to work off.
-                    if (pMBLayout->IsEnd(mapi, t))
-                    {
-                        mapframenum = t - validframes[mapi] + 1;
-                        break;
-                    }
-                }
-
-                // must match the explicit information we get from the reader
-                if (numframes != mapframenum)
-                    LogicError("gammacalculation: IsEnd() not working, numframes (%d) vs. mapframenum (%d)", (int) numframes, (int) mapframenum);
-                assert(numframes == mapframenum);
+                CheckUtteranceEnd(*pMBLayout, mapi, validframes[mapi], T, numframes);
 
                 if (numframes > tempmatrix.GetNumCols())
                     tempmatrix.Resize(numrows, numframes);
@@ -251,6 +242,111 @@ public:
     }
 
 
+    // calgammaformb() on the GPU for all utterances of the minibatch at once: gathers their LLs into one matrix, computes the
+    // denominator gammas of all lattices with lattice::parallelforwardbackwardbatch(), and scatters the gammas back.
+    // The LLs and gammas stay on the GPU; only one numerator LL per frame and the lattice scores are fetched.
+    void calgammaformbbatch(Microsoft::MSR::CNTK::Matrix<ElemType>& functionValues,
+                            std::vector<std::shared_ptr<const msra::dbn::latticepair>>& lattices,
+                            const Microsoft::MSR::CNTK::Matrix<ElemType>& loglikelihood,
+                            Microsoft::MSR::CNTK::Matrix<ElemType>& gammafromlattice,
+                            std::vector<size_t>& uids,
+                            size_t samplesInRecurrentStep,
+                            std::shared_ptr<Microsoft::MSR::CNTK::MBLayout> pMBLayout,
+                            std::vector<size_t>& extrauttmap)
+    {
+        size_t numrows = loglikelihood.GetNumRows();
+        size_t numcols = loglikelihood.GetNumCols();
+        size_t T = numcols / samplesInRecurrentStep; // number of time steps in minibatch
+        if (samplesInRecurrentStep > 1)
+        {
+            assert(extrauttmap.size() == lattices.size());
+            assert(T == pMBLayout->GetNumTimeSteps());
+        }
+
+        // locate the utterances
+        std::vector<const msra::lattices::lattice*> denlattices(lattices.size());
+        std::vector<size_t> firstcols(lattices.size()); // [i] first column of utterance i in loglikelihood
+        std::vector<size_t> validframes(samplesInRecurrentStep, 0);
+        size_t totalframes = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numframes = lattices[i]->getnumframes();
+            denlattices[i] = &lattices[i]->second;
+            if (samplesInRecurrentStep == 1)
+                firstcols[i] = totalframes;
+            else
+            {
+                const size_t mapi = extrauttmap[i];
+                CheckUtteranceEnd(*pMBLayout, mapi, validframes[mapi], T, numframes);
+                firstcols[i] = mapi + validframes[mapi] * samplesInRecurrentStep;
+                validframes[mapi] += numframes;
+            }
+            totalframes += numframes;
+        }
+
+        // gather the LLs of all utterances
+        Microsoft::MSR::CNTK::Matrix<ElemType> batchloglls(m_deviceid);
+        Microsoft::MSR::CNTK::Matrix<ElemType> batchgammas(m_deviceid);
+        if (samplesInRecurrentStep == 1)
+        {
+            batchloglls = loglikelihood.ColumnSlice(0, totalframes);
+            batchgammas = gammafromlattice.ColumnSlice(0, totalframes);
+        }
+        else
+        {
+            batchloglls.Resize(numrows, totalframes);
+            batchgammas.Resize(numrows, totalframes);
+            size_t ts = 0;
+            for (size_t i = 0; i < lattices.size(); i++)
+            {
+                const size_t numframes = lattices[i]->getnumframes();
+                Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(firstcols[i], ((numframes - 1) * samplesInRecurrentStep) + 1);
+                Microsoft::MSR::CNTK::Matrix<ElemType> batchlogllsForCurrentUtterance = batchloglls.ColumnSlice(ts, numframes);
+                batchlogllsForCurrentUtterance.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
+                ts += numframes;
+            }
+        }
+
+        // numerator: pick the LL of the reference state of each frame on the GPU (inner product with the one-hot reference)
+        std::unique_ptr<ElemType[]> uidvalues(new ElemType[totalframes]);
+        for (size_t t = 0; t < totalframes; t++)
+            uidvalues[t] = (ElemType) uids[t];
+        Microsoft::MSR::CNTK::Matrix<ElemType> referenceuids(1, totalframes, uidvalues.get(), m_deviceid);
+        Microsoft::MSR::CNTK::Matrix<ElemType> reference(m_deviceid);
+        std::vector<size_t> referenceshape(1, numrows);
+        reference.AssignOneHot(referenceuids, referenceshape, 0, false);
+        Microsoft::MSR::CNTK::Matrix<ElemType> referencells(m_deviceid);
+        Microsoft::MSR::CNTK::Matrix<ElemType>::InnerProduct(batchloglls, reference, referencells, true);
+        std::unique_ptr<ElemType[]> numlls(referencells.CopyToArray());
+
+        std::vector<double> denavlogps;
+        msra::lattices::lattice::parallelforwardbackwardbatch(parallellattice, denlattices, (const msra::asr::simplesenonehmm&) m_hset,
+                                                              batchloglls, batchgammas, lmf, wp, amf, boostmmifactor, seqsMBRmode,
+                                                              const_array_ref<size_t>(uids.data(), totalframes), denavlogps);
+
+        ElemType objectValue = 0.0;
+        size_t ts = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numframes = lattices[i]->getnumframes();
+            double numavlogp = 0;
+            for (size_t t = ts; t < ts + numframes; t++) // we do not allocate memory for numgamma now
+                numavlogp += numlls[t] / amf;
+            numavlogp /= numframes;
+            objectValue += (ElemType)((numavlogp - denavlogps[i]) * numframes);
+
+            // set gamma for multi channel
+            if (samplesInRecurrentStep > 1)
+            {
+                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(firstcols[i], ((numframes - 1) * samplesInRecurrentStep) + 1);
+                gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(batchgammas.ColumnSlice(ts, numframes), numframes, 1, samplesInRecurrentStep);
+            }
+            fprintf(stderr, "dengamma value %f\n", denavlogps[i]);
+            ts += numframes;
+        }
+        functionValues.SetValue(objectValue);
+    }
+
     // Calculate CTC score
     // totalScore (output): total CTC score at element (0,0)
     // prob (input): the posterior output from the network (log softmax of right)
@@ -303,6 +399,11 @@ public:
         uttFrameNum.reserve(numSequences);
         uttPhoneNum.reserve(numSequences);
         uttToChanInd.reserve(numSequences);
+
+        // The labels are read with one transfer each rather than element by element, which on the GPU is a copy per frame.
+        std::unique_ptr<ElemType[]> maxIndexesOnHost(maxIndexes.CopyToArray());
+        std::unique_ptr<ElemType[]> maxValuesOnHost(maxValues.CopyToArray());
+
         size_t seqId = 0;
         for (const auto& seq : pMBLayout->GetAllSequences())
         {
@@ -331,9 +432,9 @@ public:
                 // If the 1-hot vectors may have either value 1 or 2 at the position of the phone corresponding to the frame:
                 //      1 means the frame is within phone boundary
                 //      2 means the frame is the phone boundary
-                if (maxValues(0, frameInd) == 2) 
+                if (maxValuesOnHost[frameInd] == 2) 
                 {
-                    prevPhoneId = (size_t)maxIndexes(0, frameInd);
+                    prevPhoneId = (size_t)maxIndexesOnHost[frameInd];
 
                     phoneSeq.push_back(blankTokenId);
                     phoneBound.push_back(frameCounter);
@@ -387,6 +488,26 @@ public:
     }
 
 private:
+    // check that the utterance of 'numframes' frames from time step 'begin' of parallel sequence 's' ends where the MBLayout says
+    static void CheckUtteranceEnd(const Microsoft::MSR::CNTK::MBLayout& mbLayout, size_t s, size_t begin, size_t T, size_t numframes)
+    {
+        // scan MBLayout for end of utterance
+        size_t mapframenum = SIZE_MAX; // duration of utterance as determined from MBLayout
+        for (size_t t = begin; t < T; t++)
+        {
+            // TODO: Adapt this to new MBLayout, m_sequences would be easier to work off.
+            if (mbLayout.IsEnd(s, t))
+            {
+                mapframenum = t - begin + 1;
+                break;
+            }
+        }
+
+        // must match the explicit information we get from the reader
+        if (numframes != mapframenum)
+            LogicError("gammacalculation: IsEnd() not working, numframes (%d) vs. mapframenum (%d)", (int) numframes, (int) mapframenum);
+    }
+
     // Helper methods for copying between ssematrix objects and CNTK matrices
     void CopyFromCNTKMatrixToSSEMatrix(const Microsoft::MSR::CNTK::Matrix<ElemType>& src, size_t numCols, msra::math::ssematrixbase& dest)
     {
@@ -38,6 +38,23 @@ void latticefunctionsops::forwardbackwardlattice(const size_t* batchsizeforward,
 {
 }
 
+void latticefunctionsops::forwardbackwardlatticebatch(const size_t* batchsizes, const size_t numlaunches,
+                                                      const vectorref<unsigned int>& edgeorder, const vectorref<unsigned int>& edgelattices,
+                                                      const vectorref<unsigned int>& nodeoffsets,
+                                                      const size_t spalignunitid, const size_t silalignunitid,
+                                                      const vectorref<float>& edgeacscores, const vectorref<msra::lattices::edgeinfowithscores>& edges,
+                                                      const vectorref<msra::lattices::nodeinfo>& nodes,
+                                                      const vectorref<msra::lattices::aligninfo>& aligns, const vectorref<unsigned short>& aligments,
+                                                      const vectorref<unsigned int>& aligmentoffsets,
+                                                      vectorref<double>& logpps, vectorref<double>& logalphas, vectorref<double>& logbetas,
+                                                      const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                                      const vectorref<unsigned short>& uids, const vectorref<unsigned short>& senone2classmap,
+                                                      vectorref<double>& logaccalphas, vectorref<double>& logaccbetas,
+                                                      vectorref<double>& logframescorrectedge, vectorref<double>& logEframescorrect,
+                                                      vectorref<double>& totalfwscores, vectorref<double>& logEframescorrecttotals) const
+{
+}
+
 void latticefunctionsops::sMBRerrorsignal(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                                           const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                                           const vectorref<double>& logpps, const float amf, const vectorref<double>& logEframescorrect, const double logEframescorrecttotal,
@@ -45,6 +62,14 @@ void latticefunctionsops::sMBRerrorsignal(const vectorref<unsigned short>& align
 {
 }
 
+void latticefunctionsops::sMBRerrorsignalbatch(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
+                                               const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
+                                               const vectorref<unsigned int>& edgelattices, const vectorref<double>& logpps, const float amf,
+                                               const vectorref<double>& logEframescorrect, const vectorref<double>& logEframescorrecttotals,
+                                               matrixref<float>& errorsignal, matrixref<float>& errorsignalneg) const
+{
+}
+
 void latticefunctionsops::mmierrorsignal(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                                          const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                                          const vectorref<double>& logpps, matrixref<float>& errorsignal) const
@@ -57,6 +82,17 @@ void latticefunctionsops::stateposteriors(const vectorref<unsigned short>& align
 {
 }
 
+void latticefunctionsops::denominatorforwardbackward(const vectorref<msra::lattices::denominatorarc>& inarcs, const vectorref<unsigned int>& inarcoffsets,
+                                                     const vectorref<msra::lattices::denominatorarc>& outarcs, const vectorref<unsigned int>& outarcoffsets,
+                                                     const vectorref<msra::lattices::denominatorarc>& pdfarcs, const vectorref<unsigned int>& pdfarcoffsets,
+                                                     const vectorref<float>& loginitial, const vectorref<float>& logfinal,
+                                                     const vectorref<unsigned int>& uttfirstcols, const vectorref<unsigned int>& uttframes,
+                                                     const size_t numchannels, const size_t maxframes, const matrixref<float>& logLLs,
+                                                     matrixref<float>& logalphas, matrixref<float>& logbetas, vectorref<float>& logtotals,
+                                                     matrixref<float>& posteriors) const
+{
+}
+
 latticefunctions* newlatticefunctions(size_t deviceid)
 {
     return nullptr;
@@ -102,6 +138,10 @@ aligninfovector* newaligninfovector(size_t deviceid)
 {
     return nullptr;
 }
+denominatorarcvector* newdenominatorarcvector(size_t deviceid)
+{
+    return nullptr;
+}
 }
 }
 
@@ -108,7 +108,8 @@ void forwardlatticej(const size_t batchsize, const size_t startindex, const std:
     if (j < batchsize) // note: will cause issues if we ever use __synctreads() in forwardlatticej
     {
         msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
-                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
+                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas,
+                                                                 0, nodes.size() - 1);
     }
 }
 
@@ -129,7 +130,7 @@ void backwardlatticej(const size_t batchsize, const size_t startindex, const std
         msra::lattices::latticefunctionskernels::backwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid,
                                                                   edges, nodes, aligns, totalfwscore, logpps, logalphas,
                                                                   logbetas, lmf, wp, amf, boostingfactor, returnEframescorrect, logframescorrectedge,
-                                                                  logaccalphas, Eframescorrectbuf, logaccbetas);
+                                                                  logaccalphas, Eframescorrectbuf, logaccbetas, 0, nodes.size() - 1);
     }
 }
 
@@ -362,6 +363,40 @@ static void emulatemmierrorsignal(const std::vector<unsigned short>& alignstatei
                 });
 }
 
+// -----------------------------------------------------------------------
+// latticebatch --several lattices concatenated into one, with node, alignment and frame indices rebased, so that the kernels
+// for one lattice process all of them at once (see lattice::parallelforwardbackwardbatch())
+// -----------------------------------------------------------------------
+
+struct latticebatch
+{
+    std::vector<msra::lattices::nodeinfo> nodes;
+    std::vector<msra::lattices::edgeinfowithscores> edges;
+    std::vector<msra::lattices::aligninfo> align;
+    std::vector<unsigned int> alignoffsets; // [j] offset of the state alignment of edge j
+    std::vector<size_t> backptroffsets;     // [j] offset of the silence backpointers of edge j
+    std::vector<unsigned short> uids;       // [t] frame labels
+    std::vector<unsigned int> edgelattices; // [j] index of the lattice of edge j
+    std::vector<unsigned int> nodeoffsets;  // [l] index of the first node of lattice l; one extra element for the total
+    std::vector<unsigned int> edgeorder;    // edge indices in the order of the forward launches
+    std::vector<size_t> batchsizes;         // [i] number of edges in forward launch i
+    size_t alignbuffersize;                 // total number of frames of the alignments of all edges
+    size_t backptrstoragesize;
+
+    latticebatch()
+        : alignbuffersize(0), backptrstoragesize(0)
+    {
+    }
+    void clear()
+    {
+        *this = latticebatch();
+    }
+    size_t numlattices() const
+    {
+        return edgelattices.empty() ? 0 : edgelattices.back() + 1;
+    }
+};
+
 // -----------------------------------------------------------------------
 // parallelstate (-impl) --holds variables for CUDA access
 // -----------------------------------------------------------------------
@@ -400,7 +435,13 @@ struct parallelstateimpl
           errorsignalgpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           errorsignalneggpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           backptrstoragegpu(msra::cuda::newushortvector(deviceid)),
-          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid))
+          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid)),
+          // current batch of lattices
+          edgeordergpu(msra::cuda::newuintvector(deviceid)),
+          edgelatticesgpu(msra::cuda::newuintvector(deviceid)),
+          nodeoffsetsgpu(msra::cuda::newuintvector(deviceid)),
+          totalfwscoresgpu(msra::cuda::newdoublevector(deviceid)),
+          logEframescorrecttotalsgpu(msra::cuda::newdoublevector(deviceid))
     {
     }
 
@@ -545,6 +586,13 @@ struct parallelstateimpl
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalgpu;
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalneggpu;
 
+    // current batch of lattices (the lattice data itself goes into the vectors of the current lattice above)
+    std::unique_ptr<msra::cuda::uintvector> edgeordergpu;
+    std::unique_ptr<msra::cuda::uintvector> edgelatticesgpu;
+    std::unique_ptr<msra::cuda::uintvector> nodeoffsetsgpu;
+    std::unique_ptr<doublevector> totalfwscoresgpu;
+    std::unique_ptr<doublevector> logEframescorrecttotalsgpu;
+
     // cache current lattice
     // This is a weird mix of const/non-const and private lattice data... :(
     template <class edgestype, class nodestype, class aligntype, class edgealignments, class backpointers>
@@ -574,6 +622,24 @@ struct parallelstateimpl
         /*cudalogLLs->allocate (logLLs.rows(), logLLs.cols());
             cudalogLLs->assign(0, logLLs.rows(), 0, logLLs.cols(), &logLLs(0,0), logLLs.getcolstride(), true);  // doing this last with 'true' so we can measure time better; maybe remove later*/
     }
+    // cache a batch of lattices
+    void setbatchdata(const latticebatch& batch)
+    {
+        edgesgpu->assign(batch.edges, false);
+        nodesgpu->assign(batch.nodes, false);
+        aligngpu->assign(batch.align, false);
+        alignoffsetsgpu->assign(batch.alignoffsets, false);
+        backptrstoragegpu->allocate(batch.backptrstoragesize);
+        backptroffsetsgpu->assign(batch.backptroffsets, false);
+        alignresult->allocate(batch.alignbuffersize);
+        edgeacscoresgpu->allocate(batch.edges.size());
+
+        edgeordergpu->assign(batch.edgeorder, false);
+        edgelatticesgpu->assign(batch.edgelattices, false);
+        nodeoffsetsgpu->assign(batch.nodeoffsets, false);
+        totalfwscoresgpu->allocate(batch.numlattices());
+        logEframescorrecttotalsgpu->allocate(batch.numlattices());
+    }
     // template<class ElemType>
     void setloglls(const Microsoft::MSR::CNTK::Matrix<float>& loglls)
     {
@@ -627,29 +693,33 @@ struct parallelstateimpl
     // we can then reset errorsignalgpu to be the result.
     void cacheerrorsignal(const msra::math::ssematrixbase& errorsignal, const bool cacheerrsignalneg)
     {
-        if (errorsignalgpustorage->GetNumRows() != 0 && errorsignalgpustorage->GetNumRows() != errorsignal.rows())
+        cacheerrorsignal(errorsignal.rows(), errorsignal.cols(), cacheerrsignalneg);
+    }
+    void cacheerrorsignal(const size_t rows, const size_t cols, const bool cacheerrsignalneg)
+    {
+        if (errorsignalgpustorage->GetNumRows() != 0 && errorsignalgpustorage->GetNumRows() != rows)
             LogicError("gpumatrixstorage->rows() shall be fixed once allocated");
-        if (errorsignalgpustorage->GetNumCols() < errorsignal.cols())
+        if (errorsignalgpustorage->GetNumCols() < cols)
         {
             // Note: This is required because otherwise errorsignalgpustorage will be a view of the storage object in
             // errorsignalgpustorage, and thuse it can't resize. This is perhaps not the optimal way to do this, but
             // how else? Why do these two matrices exist? Why not just one?
             errorsignalgpu = nullptr;
-            errorsignalgpustorage->Resize(errorsignal.rows(), errorsignal.cols());
+            errorsignalgpustorage->Resize(rows, cols);
         }
-        errorsignalgpu = make_unique<Microsoft::MSR::CNTK::Matrix<float>>(errorsignalgpustorage->ColumnSlice(0, errorsignal.cols()));
+        errorsignalgpu = make_unique<Microsoft::MSR::CNTK::Matrix<float>>(errorsignalgpustorage->ColumnSlice(0, cols));
 
         if (cacheerrsignalneg)
         {
-            if (errorsignalneggpustorage->GetNumRows() != 0 && errorsignalneggpustorage->GetNumRows() != errorsignal.rows())
+            if (errorsignalneggpustorage->GetNumRows() != 0 && errorsignalneggpustorage->GetNumRows() != rows)
                 LogicError("gpumatrixstorage->rows() shall be fixed once allocated");
-            if (errorsignalneggpustorage->GetNumCols() < errorsignal.cols())
+            if (errorsignalneggpustorage->GetNumCols() < cols)
             {
                 // Same as above.
                 errorsignalneggpu = nullptr;
-                errorsignalneggpustorage->Resize(errorsignal.rows(), errorsignal.cols());
+                errorsignalneggpustorage->Resize(rows, cols);
             }
-            errorsignalneggpu = make_unique<Microsoft::MSR::CNTK::Matrix<float>>(errorsignalneggpustorage->ColumnSlice(0, errorsignal.cols()));
+            errorsignalneggpu = make_unique<Microsoft::MSR::CNTK::Matrix<float>>(errorsignalneggpustorage->ColumnSlice(0, cols));
         }
     }
 
@@ -791,6 +861,28 @@ void lattice::parallelforwardbackwardalign(parallelstate& parallelstate,
     }
 }
 
+// forward batch sizes of a lattice, same as in parallelforwardbackwardlattice(): each batch is the longest run of edges that
+// start before the end node of its first edge, which therefore do not depend on each other
+static std::vector<size_t> forwardbatchsizes(const std::vector<msra::lattices::edgeinfowithscores>& edges)
+{
+    std::vector<size_t> batchsizes;
+    size_t endindex = edges[0].E;
+    size_t countbatch = 0;
+    foreach_index (j, edges)
+    {
+        if (edges[j].S < endindex)
+            countbatch++;
+        else
+        {
+            batchsizes.push_back(countbatch);
+            countbatch = 1;
+            endindex = edges[j].E;
+        }
+    }
+    batchsizes.push_back(countbatch);
+    return batchsizes;
+}
+
 // parallelforwardbackwardlattice() -- compute the latticelevel logpps using forwardbackward
 double lattice::parallelforwardbackwardlattice(parallelstate& parallelstate, const std::vector<float>& edgeacscores,
                                                const edgealignments& thisedgealignments, const float lmf, const float wp,
@@ -960,5 +1052,200 @@ void lattice::parallelmmierrorsignal(parallelstate& parallelstate, const edgeali
         emulatemmierrorsignal(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, errorsignal);
     }
 }
+
+// ------------------------------------------------------------------------
+// batched forward-backward for all lattices of a minibatch
+// The lattices are concatenated into as few batches as the bit fields of the lattice structures allow, and each batch
+// goes through the same steps as a single lattice in forwardbackward(), with one kernel launch per step for all lattices.
+// ------------------------------------------------------------------------
+void lattice::parallelforwardbackwardbatch(parallelstate& parallelstate, const std::vector<const lattice*>& lattices,
+                                           const msra::asr::simplesenonehmm& hset, const Microsoft::MSR::CNTK::Matrix<float>& logLLs,
+                                           Microsoft::MSR::CNTK::Matrix<float>& result, const float lmf, const float wp, const float amf,
+                                           const float boostingfactor, const bool sMBRmode, const_array_ref<size_t> uids, std::vector<double>& avlogps)
+{
+    if (parallelstate->emulation)
+        LogicError("parallelforwardbackwardbatch: emulation is not supported");
+    parallelstate->validatehset(hset); // ensure the models have been correctly cached on the GPU already
+
+    size_t totalframes = 0;
+    for (const auto* L : lattices)
+        totalframes += L->info.numframes;
+    if (totalframes != logLLs.GetNumCols() || totalframes != uids.size() || totalframes != result.GetNumCols())
+        LogicError("parallelforwardbackwardbatch: #frames mismatch between lattices (%d), LLs (%d), uids (%d) and result (%d)",
+                   (int) totalframes, (int) logLLs.GetNumCols(), (int) uids.size(), (int) result.GetNumCols());
+
+    // limits of the bit fields that hold the rebased node, alignment and frame indices
+    const size_t maxnodes = (size_t) 1 << 19;   // edgeinfo::S and E
+    const size_t maxaligns = (size_t) 1 << 24;  // edgeinfo::firstalign
+    const size_t maxframes = USHRT_MAX;         // nodeinfo::t
+
+    const bool returnEframescorrect = sMBRmode;
+    const bool allocateframescorrect = (returnEframescorrect || boostingfactor != 0.0f);
+    const bool copyuids = (returnEframescorrect || boostingfactor != 0.0f);
+    const bool allocateaccvectors = returnEframescorrect;
+
+    std::unique_ptr<latticefunctions> latticefunctions(msra::cuda::newlatticefunctions(parallelstate.getdevice()));
+    avlogps.assign(lattices.size(), LOGZERO);
+    latticebatch batch;
+    std::vector<std::vector<size_t>> forwardbatches; // [l] forward batch sizes of lattice l of the batch
+    std::vector<size_t> nextedges;                   // [l] index of the first edge of the next forward batch of lattice l
+    std::vector<double> totalfwscores;
+    std::vector<double> logEframescorrecttotals;
+    size_t firstlattice = 0;
+    size_t firstframe = 0;
+    while (firstlattice < lattices.size())
+    {
+        // concatenate as many lattices as fit
+        batch.clear();
+        forwardbatches.clear();
+        nextedges.clear();
+        batch.nodeoffsets.push_back(0);
+        size_t numframes = 0;
+        size_t endlattice = firstlattice;
+        for (; endlattice < lattices.size(); endlattice++)
+        {
+            const lattice& L = *lattices[endlattice];
+            if (endlattice > firstlattice && (batch.nodes.size() + L.nodes.size() > maxnodes || batch.align.size() + L.align.size() > maxaligns ||
+                                              numframes + L.info.numframes > maxframes))
+                break;
+
+            const size_t nodeoffset = batch.nodes.size();
+            const size_t alignindexoffset = batch.align.size();
+            const edgealignments thisedgealignments(L);
+            const backpointers thisbackpointers(L, hset);
+            const auto& alignoffsets = thisedgealignments.getalignoffsets();
+            const auto& backptroffsets = thisbackpointers.getbackptroffsets();
+            foreach_index (j, L.edges)
+            {
+                auto e = L.edges[j];
+                e.S = e.S + nodeoffset;
+                e.E = e.E + nodeoffset;
+                e.firstalign = e.firstalign + alignindexoffset;
+                batch.edges.push_back(e);
+                batch.alignoffsets.push_back(alignoffsets[j] + (unsigned int) batch.alignbuffersize);
+                batch.backptroffsets.push_back(backptroffsets[j] + batch.backptrstoragesize);
+                batch.edgelattices.push_back((unsigned int) (endlattice - firstlattice));
+            }
+            foreach_index (i, L.nodes)
+            {
+                auto n = L.nodes[i];
+                n.t = (unsigned short) (n.t + numframes);
+                batch.nodes.push_back(n);
+            }
+            batch.align.insert(batch.align.end(), L.align.begin(), L.align.end());
+            for (size_t t = 0; t < L.info.numframes; t++)
+                batch.uids.push_back((unsigned short) uids[firstframe + numframes + t]);
+
+            nextedges.push_back(batch.edges.size() - L.edges.size());
+            forwardbatches.push_back(forwardbatchsizes(L.edges));
+            batch.alignbuffersize += thisedgealignments.getalignbuffersize();
+            batch.backptrstoragesize += backptroffsets.back();
+            batch.nodeoffsets.push_back((unsigned int) batch.nodes.size());
+            numframes += L.info.numframes;
+        }
+        batch.alignoffsets.push_back((unsigned int) batch.alignbuffersize); // one extra element for the length of the last entry
+        batch.backptroffsets.push_back(batch.backptrstoragesize);
+
+        // launch i takes the i-th forward batch of every lattice
+        for (size_t i = 0;; i++)
+        {
+            size_t batchsize = 0;
+            foreach_index (l, forwardbatches)
+            {
+                if (i >= forwardbatches[l].size())
+                    continue;
+                for (size_t k = 0; k < forwardbatches[l][i]; k++)
+                    batch.edgeorder.push_back((unsigned int) (nextedges[l] + k));
+                nextedges[l] += forwardbatches[l][i];
+                batchsize += forwardbatches[l][i];
+            }
+            if (batchsize == 0)
+                break;
+            batch.batchsizes.push_back(batchsize);
+        }
+        if (lattices[firstlattice]->verbosity >= 2)
+            fprintf(stderr, "parallelforwardbackwardbatch: %d lattices, %d launches for forward and backward\n", (int) (endlattice - firstlattice), (int) batch.batchsizes.size());
+
+        // move the batch to the GPU and align its edges
+        parallelstate->setbatchdata(batch);
+        parallelstate->setloglls(logLLs.ColumnSlice(firstframe, numframes));
+        latticefunctions->edgealignment(*parallelstate->hmmsgpu.get(), *parallelstate->lr3transPgpu.get(),
+                                        parallelstate->spalignunitid, parallelstate->silalignunitid,
+                                        *parallelstate->cudalogLLs.get(), *parallelstate->nodesgpu.get(),
+                                        *parallelstate->edgesgpu.get(), *parallelstate->aligngpu.get(),
+                                        *parallelstate->alignoffsetsgpu.get(),
+                                        *parallelstate->backptrstoragegpu.get(), *parallelstate->backptroffsetsgpu.get(),
+                                        *parallelstate->alignresult.get(), *parallelstate->edgeacscoresgpu.get());
+
+        // lattice-level forward-backward
+        parallelstate->allocfwbwvectors(batch.edges, batch.nodes, batch.uids, allocateframescorrect, copyuids, allocateaccvectors);
+        latticefunctions->forwardbackwardlatticebatch(&batch.batchsizes[0], batch.batchsizes.size(),
+                                                      *parallelstate->edgeordergpu.get(), *parallelstate->edgelatticesgpu.get(),
+                                                      *parallelstate->nodeoffsetsgpu.get(),
+                                                      parallelstate->spalignunitid, parallelstate->silalignunitid,
+                                                      *parallelstate->edgeacscoresgpu.get(), *parallelstate->edgesgpu.get(),
+                                                      *parallelstate->nodesgpu.get(), *parallelstate->aligngpu.get(),
+                                                      *parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(),
+                                                      *parallelstate->logppsgpu.get(), *parallelstate->logalphasgpu.get(),
+                                                      *parallelstate->logbetasgpu.get(), lmf, wp, amf, boostingfactor,
+                                                      returnEframescorrect, *parallelstate->uidsgpu.get(), *parallelstate->senone2classmapgpu.get(),
+                                                      *parallelstate->logaccalphasgpu.get(), *parallelstate->logaccbetasgpu.get(),
+                                                      *parallelstate->logframescorrectedgegpu.get(), *parallelstate->logEframescorrectgpu.get(),
+                                                      *parallelstate->totalfwscoresgpu.get(), *parallelstate->logEframescorrecttotalsgpu.get());
+
+        // error signal
+        parallelstate->cacheerrorsignal(logLLs.GetNumRows(), numframes, sMBRmode);
+        if (!sMBRmode)
+        {
+            latticefunctions->mmierrorsignal(*parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(), *parallelstate->edgesgpu.get(),
+                                             *parallelstate->nodesgpu.get(), *parallelstate->logppsgpu.get(), *parallelstate->errorsignalgpu.get());
+        }
+        else
+        {
+            latticefunctions->sMBRerrorsignalbatch(*parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(), *parallelstate->edgesgpu.get(),
+                                                   *parallelstate->nodesgpu.get(), *parallelstate->edgelatticesgpu.get(), *parallelstate->logppsgpu.get(),
+                                                   amf, *parallelstate->logEframescorrectgpu.get(), *parallelstate->logEframescorrecttotalsgpu.get(),
+                                                   *parallelstate->errorsignalgpu.get(), *parallelstate->errorsignalneggpu.get());
+        }
+        auto resultstripe = result.ColumnSlice(firstframe, numframes);
+        resultstripe.SetValue(*parallelstate->errorsignalgpu);
+
+        // per-lattice return values, as in forwardbackward()
+        totalfwscores.resize(endlattice - firstlattice);
+        parallelstate->totalfwscoresgpu->fetch(totalfwscores, true);
+        if (sMBRmode)
+        {
+            logEframescorrecttotals.resize(endlattice - firstlattice);
+            parallelstate->logEframescorrecttotalsgpu->fetch(logEframescorrecttotals, true);
+        }
+        for (size_t l = firstlattice; l < endlattice; l++)
+        {
+            const lattice& L = *lattices[l];
+            const double totalfwscore = totalfwscores[l - firstlattice];
+            if (totalfwscore < LOGZERO / 2) // (no path)
+                fprintf(stderr, "forwardbackward: WARNING: no path found in lattice (%d nodes/%d edges)\n", (int) L.nodes.size(), (int) L.edges.size());
+            else if (!sMBRmode)
+                avlogps[l] = totalfwscore / L.info.numframes; // av. posterior
+            else
+                avlogps[l] = exp(logEframescorrecttotals[l - firstlattice]) / L.info.numframes; // av. expected frame-correct count
+        }
+
+        firstlattice = endlattice;
+        firstframe += numframes;
+    }
+    if (sMBRmode)
+    {
+        static bool dummyvariable = (fprintf(stderr, "note: new version with kappa adjustment, kappa = %.2f\n", 1 / amf), true); // we only print once
+    }
+}
+
+// TODO: Overload to enable compilation for DoublePrecision though its currently unsupported
+void lattice::parallelforwardbackwardbatch(parallelstate& /*parallelstate*/, const std::vector<const lattice*>& /*lattices*/,
+                                           const msra::asr::simplesenonehmm& /*hset*/, const Microsoft::MSR::CNTK::Matrix<double>& /*logLLs*/,
+                                           Microsoft::MSR::CNTK::Matrix<double>& /*result*/, const float /*lmf*/, const float /*wp*/, const float /*amf*/,
+                                           const float /*boostingfactor*/, const bool /*sMBRmode*/, const_array_ref<size_t> /*uids*/, std::vector<double>& /*avlogps*/)
+{
+    throw ::logic_error("Double precision not supported for sequence training");
+}
 };
 };
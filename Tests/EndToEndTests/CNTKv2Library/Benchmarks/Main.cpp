@@ -0,0 +1,358 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Main.cpp -- runs the end-to-end training benchmarks (TrainingBenchmarks.cpp) and tracks regressions
+//
+// Usage: V2LibraryBenchmarks [--device cpu|gpu|all] [--distributed] [--filter <substring>]
+//                            [--minibatches <n>] [--warmup <n>]
+//                            [--json <file>] [--baseline <file> [--tolerance <fraction>]] [--list]
+//
+// --json writes one JSON object per benchmark and line:
+//     {"name":"resnet50/224x224/mb32","config":"gpu","minibatches":50,"samplesPerSecond":212.4,
+//      "p50Seconds":0.1502,"p90Seconds":0.1511,"p99Seconds":0.1538,"peakMemoryBytes":5368709120}
+// A file written this way can be passed as --baseline to a later run, which then reports every benchmark whose
+// throughput dropped below the baseline by more than the tolerance (default 0.1, i.e. 10%), and exits with 1 if there is one.
+//
+// --distributed trains data-parallel on all MPI workers (mpiexec -n <N> V2LibraryBenchmarks --distributed ...), worker i
+// on GPU i (or all on the CPU), as config "gpu-x<N>" ("cpu-x<N>"). Only the first worker prints and writes the results.
+//
+// Each benchmark trains 'warmup' untimed minibatches (which allocate memory and pick the convolution algorithms), then
+// 'minibatches' timed ones. A step ends when its loss has been read back, i.e. when the device has finished it.
+// Peak memory is that of the matrices on the GPU, or the peak resident set of the whole process on the CPU (which only
+// grows; run one benchmark per process with --filter for numbers that do not depend on the benchmarks before).
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "CNTKLibrary.h"
+#include "Common.h"
+#include "TrainingBenchmarks.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace CNTK;
+using namespace std;
+
+struct Options
+{
+    bool cpu = true;
+    bool gpu = false;
+    bool distributed = false;
+    string filter;
+    size_t minibatches = 50;
+    size_t warmup = 5;
+    string jsonPath;
+    string baselinePath;
+    double tolerance = 0.1;
+    bool list = false;
+};
+
+struct Result
+{
+    string name;
+    string config;
+    size_t minibatches;
+    double samplesPerSecond;
+    double p50Seconds;
+    double p90Seconds;
+    double p99Seconds;
+    size_t peakMemoryBytes;
+};
+
+static void Usage()
+{
+    cerr << "Usage: V2LibraryBenchmarks [--device cpu|gpu|all] [--distributed] [--filter <substring>]" << endl
+         << "                           [--minibatches <n>] [--warmup <n>]" << endl
+         << "                           [--json <file>] [--baseline <file> [--tolerance <fraction>]] [--list]" << endl;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--list")
+            options.list = true;
+        else if (arg == "--distributed")
+            options.distributed = true;
+        else if (!hasValue)
+            return false;
+        else if (arg == "--device")
+        {
+            const string device = argv[++i];
+            if (device != "cpu" && device != "gpu" && device != "all")
+                return false;
+            options.cpu = device != "gpu";
+            options.gpu = device != "cpu";
+        }
+        else if (arg == "--filter")
+            options.filter = argv[++i];
+        else if (arg == "--minibatches")
+            options.minibatches = (size_t) atoi(argv[++i]);
+        else if (arg == "--warmup")
+            options.warmup = (size_t) atoi(argv[++i]);
+        else if (arg == "--json")
+            options.jsonPath = argv[++i];
+        else if (arg == "--baseline")
+            options.baselinePath = argv[++i];
+        else if (arg == "--tolerance")
+            options.tolerance = atof(argv[++i]);
+        else
+            return false;
+    }
+    return options.minibatches > 0 && options.tolerance >= 0;
+}
+
+// peak resident set of the process so far
+static size_t PeakProcessMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (size_t) usage.ru_maxrss * 1024; // in KB on Linux
+#endif
+}
+
+// nearest-rank percentile of sorted values
+static double Percentile(const vector<double>& sorted, double percent)
+{
+    size_t rank = (size_t) ceil(percent / 100 * sorted.size());
+    return sorted[max(rank, (size_t) 1) - 1];
+}
+
+static Result Measure(const TrainingBenchmark& definition, const DeviceDescriptor& device, const DistributedCommunicatorPtr& communicator, const Options& options)
+{
+    typedef chrono::high_resolution_clock Clock;
+
+    Internal::ResetPeakGPUMemory(device);
+    TrainingWorkload workload = definition.create(device, communicator);
+    auto trainStep = [&workload, &device]()
+    {
+        workload.trainer->TrainMinibatch(workload.minibatch, device);
+        workload.trainer->PreviousMinibatchLossAverage(); // waits for the device
+        return workload.trainer->PreviousMinibatchSampleCount();
+    };
+
+    for (size_t i = 0; i < options.warmup; i++)
+        trainStep();
+
+    vector<double> stepSeconds;
+    size_t numSamples = 0;
+    for (size_t i = 0; i < options.minibatches; i++)
+    {
+        auto start = Clock::now();
+        numSamples += trainStep(); // of all workers when distributed
+        stepSeconds.push_back(chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    Result r;
+    r.minibatches = options.minibatches;
+    double totalSeconds = 0;
+    for (auto seconds : stepSeconds)
+        totalSeconds += seconds;
+    r.samplesPerSecond = numSamples / totalSeconds;
+    sort(stepSeconds.begin(), stepSeconds.end());
+    r.p50Seconds = Percentile(stepSeconds, 50);
+    r.p90Seconds = Percentile(stepSeconds, 90);
+    r.p99Seconds = Percentile(stepSeconds, 99);
+    r.peakMemoryBytes = device.Type() == DeviceKind::GPU ? Internal::GetPeakGPUMemory(device) : PeakProcessMemory();
+    return r;
+}
+
+static string ToJson(const Result& r)
+{
+    char buf[1024];
+    sprintf(buf, "{\"name\":\"%s\",\"config\":\"%s\",\"minibatches\":%d,\"samplesPerSecond\":%.6g,"
+                 "\"p50Seconds\":%.9g,\"p90Seconds\":%.9g,\"p99Seconds\":%.9g,\"peakMemoryBytes\":%.0f}",
+            r.name.c_str(), r.config.c_str(), (int) r.minibatches, r.samplesPerSecond,
+            r.p50Seconds, r.p90Seconds, r.p99Seconds, (double) r.peakMemoryBytes);
+    return buf;
+}
+
+// The fields of one line as written by ToJson(). Not a general JSON parser: names never contain quotes.
+static bool FromJson(const string& line, Result& r)
+{
+    auto field = [&line](const char* key, string& value)
+    {
+        const string pattern = string("\"") + key + "\":";
+        auto pos = line.find(pattern);
+        if (pos == string::npos)
+            return false;
+        pos += pattern.size();
+        if (line[pos] == '"')
+        {
+            auto end = line.find('"', pos + 1);
+            if (end == string::npos)
+                return false;
+            value = line.substr(pos + 1, end - pos - 1);
+        }
+        else
+            value = line.substr(pos, line.find_first_of(",}", pos) - pos);
+        return true;
+    };
+    string samplesPerSecond;
+    if (!field("name", r.name) || !field("config", r.config) || !field("samplesPerSecond", samplesPerSecond))
+        return false;
+    r.samplesPerSecond = atof(samplesPerSecond.c_str());
+    return r.samplesPerSecond > 0;
+}
+
+static map<string, double> ReadBaseline(const string& path)
+{
+    ifstream file(path);
+    if (!file)
+        RuntimeError("Could not open baseline file '%s'.", path.c_str());
+    map<string, double> baseline;
+    string line;
+    for (size_t lineNo = 1; getline(file, line); lineNo++)
+    {
+        if (line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        Result r;
+        if (!FromJson(line, r))
+            RuntimeError("%s(%d): Not a benchmark result.", path.c_str(), (int) lineNo);
+        baseline[r.config + ":" + r.name] = r.samplesPerSecond;
+    }
+    return baseline;
+}
+
+static int Run(const Options& options)
+{
+    DistributedCommunicatorPtr communicator;
+    size_t rank = 0;
+    string suffix;
+    if (options.distributed)
+    {
+        communicator = MPICommunicator();
+        rank = communicator->CurrentWorker().m_globalRank;
+        suffix = "-x" + to_string(communicator->Workers().size());
+    }
+    const bool isMainWorker = rank == 0;
+
+    vector<pair<string, DeviceDescriptor>> devices;
+    if (options.cpu)
+        devices.push_back(make_pair("cpu" + suffix, DeviceDescriptor::CPUDevice()));
+    if (options.gpu)
+        devices.push_back(make_pair("gpu" + suffix, DeviceDescriptor::GPUDevice((unsigned int) rank)));
+
+    map<string, double> baseline;
+    if (!options.baselinePath.empty())
+        baseline = ReadBaseline(options.baselinePath);
+
+    ofstream json;
+    if (!options.jsonPath.empty() && isMainWorker)
+    {
+        json.open(options.jsonPath);
+        if (!json)
+            RuntimeError("Could not open '%s' for writing.", options.jsonPath.c_str());
+    }
+
+    size_t numRegressions = 0;
+    for (const auto& device : devices)
+    {
+        for (const auto& definition : AllTrainingBenchmarks())
+        {
+            if ((device.second.Type() == DeviceKind::CPU ? !definition.cpu : !definition.gpu) ||
+                definition.name.find(options.filter) == string::npos)
+                continue;
+            if (options.list)
+            {
+                if (isMainWorker)
+                    cout << device.first << " " << definition.name << endl;
+                continue;
+            }
+
+            Result r;
+            try
+            {
+                r = Measure(definition, device.second, communicator, options);
+            }
+            catch (const exception& e)
+            {
+                fprintf(stderr, "%-8s %-36s skipped: %s\n", device.first.c_str(), definition.name.c_str(), e.what());
+                continue;
+            }
+            r.name = definition.name;
+            r.config = device.first;
+            if (!isMainWorker)
+                continue;
+
+            string comparison;
+            auto iter = baseline.find(r.config + ":" + r.name);
+            if (iter != baseline.end())
+            {
+                const double change = r.samplesPerSecond / iter->second - 1;
+                char buf[64];
+                sprintf(buf, "  %+6.1f%%", 100 * change);
+                comparison = buf;
+                if (change < -options.tolerance)
+                {
+                    comparison += "  REGRESSION";
+                    numRegressions++;
+                }
+            }
+            printf("%-8s %-36s %12.1f samples/s  p50 %9.3f ms  p90 %9.3f ms  p99 %9.3f ms  peak %8.1f MB%s\n",
+                   r.config.c_str(), r.name.c_str(), r.samplesPerSecond, r.p50Seconds * 1e3, r.p90Seconds * 1e3, r.p99Seconds * 1e3,
+                   r.peakMemoryBytes / (1024.0 * 1024.0), comparison.c_str());
+            fflush(stdout);
+            if (json.is_open())
+                json << ToJson(r) << endl;
+        }
+    }
+
+    if (!baseline.empty() && isMainWorker)
+        printf("%d benchmark(s) slower than the baseline by more than %.1f%%.\n", (int) numRegressions, 100 * options.tolerance);
+    return numRegressions == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+#if defined(_MSC_VER)
+    // in case of asserts in debug mode, print the message into stderr and throw exception
+    if (_CrtSetReportHook2(_CRT_RPTHOOK_INSTALL, HandleDebugAssert) == -1) {
+        fprintf(stderr, "_CrtSetReportHook2 failed.\n");
+        return -1;
+    }
+#endif
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        Usage();
+        return 2;
+    }
+    int exitCode;
+    try
+    {
+        exitCode = Run(options);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        exitCode = 2;
+    }
+    if (options.distributed)
+        DistributedCommunicator::Finalize();
+    return exitCode;
+}
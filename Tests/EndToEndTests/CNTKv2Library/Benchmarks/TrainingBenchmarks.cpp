@@ -0,0 +1,330 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TrainingBenchmarks.cpp -- the benchmark definitions
+//
+// The models are reduced to what dominates the training time of their kind of workload: deep convolutions with batch
+// normalization, long bidirectional recurrences, a large softmax, a large sparse embedding, and an encoder-decoder with
+// attention. Sizes are fixed; changing one changes the meaning of the numbers, so it needs a new name.
+//
+
+#include "CNTKLibrary.h"
+#include "Common.h"
+#include "Image.h"
+#include "TrainingBenchmarks.h"
+#include <algorithm>
+#include <random>
+
+using namespace CNTK;
+
+// -----------------------------------------------------------------------
+// synthetic data
+// -----------------------------------------------------------------------
+
+// sequences of length 1, uniform in [-1, 1]
+static ValuePtr RandomDenseBatch(const NDShape& sampleShape, size_t numSamples, std::mt19937& rng, const DeviceDescriptor& device)
+{
+    std::uniform_real_distribution<float> value(-1, 1);
+    std::vector<float> data(sampleShape.TotalSize() * numSamples);
+    for (auto& x : data)
+        x = value(rng);
+    return Value::CreateBatch(sampleShape, data, device, true /*readOnly*/);
+}
+
+static ValuePtr RandomDenseSequences(const NDShape& sampleShape, size_t numSequences, size_t sequenceLength, std::mt19937& rng, const DeviceDescriptor& device)
+{
+    std::uniform_real_distribution<float> value(-1, 1);
+    std::vector<std::vector<float>> sequences(numSequences, std::vector<float>(sampleShape.TotalSize() * sequenceLength));
+    for (auto& sequence : sequences)
+        for (auto& x : sequence)
+            x = value(rng);
+    return Value::Create(sampleShape, sequences, device, true /*readOnly*/);
+}
+
+static ValuePtr RandomOneHotSequences(size_t dim, size_t numSequences, size_t sequenceLength, std::mt19937& rng, const DeviceDescriptor& device)
+{
+    std::uniform_int_distribution<size_t> index(0, dim - 1);
+    std::vector<std::vector<size_t>> sequences(numSequences, std::vector<size_t>(sequenceLength));
+    for (auto& sequence : sequences)
+        for (auto& i : sequence)
+            i = index(rng);
+    return Value::Create<float>(dim, sequences, device, true /*readOnly*/);
+}
+
+// samples with 'numNonZeros' distinct ones each, as hashed categorical features are
+static ValuePtr RandomMultiHotBatch(size_t dim, size_t numNonZeros, size_t numSamples, std::mt19937& rng, const DeviceDescriptor& device)
+{
+    std::uniform_int_distribution<SparseIndexType> index(0, (SparseIndexType)dim - 1);
+    const std::vector<SparseIndexType> colStarts = { 0, (SparseIndexType)numNonZeros };
+    const std::vector<float> ones(numNonZeros, 1.0f);
+    std::vector<NDArrayViewPtr> samples(numSamples);
+    for (auto& sample : samples)
+    {
+        std::vector<SparseIndexType> rowIndices;
+        while (rowIndices.size() < numNonZeros)
+        {
+            rowIndices.push_back(index(rng));
+            std::sort(rowIndices.begin(), rowIndices.end());
+            rowIndices.erase(std::unique(rowIndices.begin(), rowIndices.end()), rowIndices.end());
+        }
+        sample = MakeSharedObject<NDArrayView>(NDShape({ dim, 1 }), colStarts.data(), rowIndices.data(), ones.data(), numNonZeros, DeviceDescriptor::CPUDevice(), true /*readOnly*/);
+    }
+    return Value::Create(NDShape({ dim }), samples, {}, device, true /*readOnly*/, true /*createNewCopy*/);
+}
+
+// -----------------------------------------------------------------------
+// helpers
+// -----------------------------------------------------------------------
+
+static TrainingWorkload CreateWorkload(const FunctionPtr& model, const FunctionPtr& loss, const FunctionPtr& evaluation, double learningRatePerSample,
+                                       const DistributedCommunicatorPtr& communicator, std::unordered_map<Variable, ValuePtr>&& minibatch)
+{
+    LearnerPtr learner = MomentumSGDLearner(model->Parameters(), LearningRatePerSampleSchedule(learningRatePerSample), MomentumAsTimeConstantSchedule(1024), /*unitGainMomentum =*/ true);
+    if (communicator)
+        learner = CreateDataParallelDistributedLearner(communicator, learner, 0);
+
+    TrainingWorkload workload;
+    workload.trainer = evaluation ? CreateTrainer(model, loss, evaluation, { learner }) : CreateTrainer(model, loss, { learner });
+    workload.minibatch = std::move(minibatch);
+    return workload;
+}
+
+static FunctionPtr PastValueHook(const Variable& x)
+{
+    return PastValue(x);
+}
+
+static FunctionPtr FutureValueHook(const Variable& x)
+{
+    return FutureValue(x);
+}
+
+// -----------------------------------------------------------------------
+// ResNet-50 image classifier, 224x224 images
+// -----------------------------------------------------------------------
+
+static const double convWScale = 1.0;
+static const double convBValue = 0;
+static const double bnScValue = 1;
+static const size_t bnTimeConst = 4096;
+
+static FunctionPtr ResNetBottleneck(Variable input, size_t innerFeatureMapCount, size_t outFeatureMapCount, size_t stride, const DeviceDescriptor& device)
+{
+    auto c1 = ConvBNReLULayer(input, innerFeatureMapCount, 1, 1, 1, 1, convWScale, convBValue, bnScValue, bnTimeConst, true /*spatial*/, device);
+    auto c2 = ConvBNReLULayer(c1, innerFeatureMapCount, 3, 3, stride, stride, convWScale, convBValue, bnScValue, bnTimeConst, true /*spatial*/, device);
+    auto c3 = ConvBNLayer(c2, outFeatureMapCount, 1, 1, 1, 1, convWScale, convBValue, bnScValue, bnTimeConst, true /*spatial*/, device);
+
+    // projection shortcut where the shape changes
+    const size_t numInputChannels = input.Shape()[input.Shape().Rank() - 1];
+    Variable shortcut = input;
+    if (stride != 1 || numInputChannels != outFeatureMapCount)
+        shortcut = ConvBNLayer(input, outFeatureMapCount, 1, 1, stride, stride, convWScale, convBValue, bnScValue, bnTimeConst, true /*spatial*/, device);
+
+    return ReLU(Plus(c3, shortcut));
+}
+
+static TrainingWorkload CreateResNet50(const DeviceDescriptor& device, const DistributedCommunicatorPtr& communicator)
+{
+    const size_t imageSize = 224;
+    const size_t numChannels = 3;
+    const size_t numClasses = 1000;
+    const size_t minibatchSize = 32;
+
+    auto images = InputVariable({ imageSize, imageSize, numChannels }, DataType::Float, L"images");
+    auto labels = InputVariable({ numClasses }, DataType::Float, L"labels");
+
+    auto conv1 = ConvBNReLULayer(images, 64, 7, 7, 2, 2, convWScale, convBValue, bnScValue, bnTimeConst, true /*spatial*/, device);
+    FunctionPtr x = Pooling(conv1, PoolingType::Max, { 3, 3 }, { 2, 2 }, { true });
+
+    const size_t numBlocks[] = { 3, 4, 6, 3 };
+    size_t innerFeatureMapCount = 64;
+    for (size_t stage = 0; stage < 4; stage++, innerFeatureMapCount *= 2)
+    {
+        for (size_t block = 0; block < numBlocks[stage]; block++)
+        {
+            const size_t stride = (stage > 0 && block == 0) ? 2 : 1;
+            x = ResNetBottleneck(x, innerFeatureMapCount, 4 * innerFeatureMapCount, stride, device);
+        }
+    }
+
+    // global average pooling over the 7x7 maps
+    auto pool = Pooling(x, PoolingType::Average, { 7, 7 }, { 1, 1 });
+    const size_t numFeatureMaps = pool->Output().Shape()[2];
+    auto outTimesParams = Parameter({ numClasses, 1, 1, numFeatureMaps }, DataType::Float, GlorotUniformInitializer(), device);
+    auto outBiasParams = Parameter({ numClasses }, 0.0f, device);
+    auto classifierOutput = Plus(Times(outTimesParams, pool), outBiasParams, L"classifierOutput");
+
+    auto trainingLoss = CrossEntropyWithSoftmax(classifierOutput, labels, L"lossFunction");
+    auto prediction = ClassificationError(classifierOutput, labels, L"classificationError");
+
+    std::mt19937 rng(1);
+    return CreateWorkload(classifierOutput, trainingLoss, prediction, 0.0078125, communicator,
+                          { { images, RandomDenseBatch(images.Shape(), minibatchSize, rng, device) },
+                            { labels, RandomOneHotSequences(numClasses, minibatchSize, 1, rng, device) } });
+}
+
+// -----------------------------------------------------------------------
+// bidirectional LSTM acoustic model, 16 utterances of 200 frames
+// -----------------------------------------------------------------------
+
+static TrainingWorkload CreateBLSTMAcousticModel(const DeviceDescriptor& device, const DistributedCommunicatorPtr& communicator)
+{
+    const size_t featureDim = 80;
+    const size_t hiddenDim = 512;
+    const size_t numLayers = 3;
+    const size_t numClasses = 9000;
+    const size_t numSequences = 16;
+    const size_t sequenceLength = 200;
+
+    auto features = InputVariable({ featureDim }, DataType::Float, L"features");
+    auto labels = InputVariable({ numClasses }, DataType::Float, L"labels");
+
+    FunctionPtr h = features;
+    for (size_t i = 0; i < numLayers; ++i)
+    {
+        auto forward = LSTMPComponentWithSelfStabilization<float>(h, { hiddenDim }, { hiddenDim }, PastValueHook, PastValueHook, device).first;
+        auto backward = LSTMPComponentWithSelfStabilization<float>(h, { hiddenDim }, { hiddenDim }, FutureValueHook, FutureValueHook, device).first;
+        h = Splice({ forward, backward }, Axis(0));
+    }
+    auto classifierOutput = FullyConnectedLinearLayer(h, numClasses, device, L"classifierOutput");
+
+    auto trainingLoss = CrossEntropyWithSoftmax(classifierOutput, labels, L"lossFunction");
+    auto prediction = ClassificationError(classifierOutput, labels, L"classificationError");
+
+    std::mt19937 rng(2);
+    return CreateWorkload(classifierOutput, trainingLoss, prediction, 0.000781, communicator,
+                          { { features, RandomDenseSequences(features.Shape(), numSequences, sequenceLength, rng, device) },
+                            { labels, RandomOneHotSequences(numClasses, numSequences, sequenceLength, rng, device) } });
+}
+
+// -----------------------------------------------------------------------
+// LSTM language model with a 50k word softmax, 32 sequences of 35 words
+// -----------------------------------------------------------------------
+
+static TrainingWorkload CreateLSTMLanguageModel(const DeviceDescriptor& device, const DistributedCommunicatorPtr& communicator)
+{
+    const size_t vocabularySize = 50000;
+    const size_t embeddingDim = 512;
+    const size_t hiddenDim = 512;
+    const size_t cellDim = 1024;
+    const size_t numLayers = 2;
+    const size_t numSequences = 32;
+    const size_t sequenceLength = 35;
+
+    auto words = InputVariable({ vocabularySize }, true /*isSparse*/, DataType::Float, L"words");
+    auto nextWords = InputVariable({ vocabularySize }, true /*isSparse*/, DataType::Float, L"nextWords");
+
+    FunctionPtr h = Embedding(words, embeddingDim, device);
+    for (size_t i = 0; i < numLayers; ++i)
+        h = LSTMPComponentWithSelfStabilization<float>(h, { hiddenDim }, { cellDim }, PastValueHook, PastValueHook, device).first;
+    auto classifierOutput = FullyConnectedLinearLayer(h, vocabularySize, device, L"classifierOutput");
+
+    auto trainingLoss = CrossEntropyWithSoftmax(classifierOutput, nextWords, L"lossFunction");
+    auto prediction = ClassificationError(classifierOutput, nextWords, L"classificationError");
+
+    std::mt19937 rng(3);
+    return CreateWorkload(classifierOutput, trainingLoss, prediction, 0.001, communicator,
+                          { { words, RandomOneHotSequences(vocabularySize, numSequences, sequenceLength, rng, device) },
+                            { nextWords, RandomOneHotSequences(vocabularySize, numSequences, sequenceLength, rng, device) } });
+}
+
+// -----------------------------------------------------------------------
+// click-through rate model: 1M hashed sparse features, 40 per sample, embedding and MLP
+// -----------------------------------------------------------------------
+
+static TrainingWorkload CreateSparseCTRModel(const DeviceDescriptor& device, const DistributedCommunicatorPtr& communicator)
+{
+    const size_t featureDim = 1000000;
+    const size_t numNonZeros = 40;
+    const size_t embeddingDim = 64;
+    const size_t hiddenDim1 = 512;
+    const size_t hiddenDim2 = 256;
+    const size_t minibatchSize = 2048;
+
+    auto features = InputVariable({ featureDim }, true /*isSparse*/, DataType::Float, L"features", { Axis::DefaultBatchAxis() });
+    auto clicks = InputVariable({ 1 }, DataType::Float, L"clicks", { Axis::DefaultBatchAxis() });
+
+    auto embedded = Embedding(features, embeddingDim, device);
+    auto h1 = FullyConnectedDNNLayer(embedded, hiddenDim1, device, std::bind(ReLU, std::placeholders::_1, L""));
+    auto h2 = FullyConnectedDNNLayer(h1, hiddenDim2, device, std::bind(ReLU, std::placeholders::_1, L""));
+    auto clickProbability = Sigmoid(FullyConnectedLinearLayer(h2, 1, device), L"clickProbability");
+
+    auto trainingLoss = BinaryCrossEntropy(clickProbability, clicks, L"lossFunction");
+
+    std::mt19937 rng(4);
+    std::bernoulli_distribution click(0.05);
+    std::vector<float> clickData(minibatchSize);
+    for (auto& c : clickData)
+        c = click(rng) ? 1.0f : 0.0f;
+    return CreateWorkload(clickProbability, trainingLoss, nullptr, 0.001, communicator,
+                          { { features, RandomMultiHotBatch(featureDim, numNonZeros, minibatchSize, rng, device) },
+                            { clicks, Value::CreateBatch(clicks.Shape(), clickData, device, true /*readOnly*/) } });
+}
+
+// -----------------------------------------------------------------------
+// sequence-to-sequence model with attention, 30k word vocabularies, 32 pairs of 30 words
+// -----------------------------------------------------------------------
+
+static TrainingWorkload CreateSeq2SeqAttentionModel(const DeviceDescriptor& device, const DistributedCommunicatorPtr& communicator)
+{
+    const size_t vocabularySize = 30000;
+    const size_t embeddingDim = 512;
+    const size_t hiddenDim = 512;
+    const size_t numLayers = 2;
+    const size_t attentionWindow = 20;
+    const size_t numSequences = 32;
+    const size_t sequenceLength = 30;
+
+    auto input = InputVariable({ vocabularySize }, true /*isSparse*/, DataType::Float, L"input", { Axis(L"inputAxis"), Axis::DefaultBatchAxis() });
+    auto labels = InputVariable({ vocabularySize }, true /*isSparse*/, DataType::Float, L"labels", { Axis(L"labelAxis"), Axis::DefaultBatchAxis() });
+
+    // encoder
+    FunctionPtr encoderH = Embedding(input, embeddingDim, device);
+    for (size_t i = 0; i < numLayers; ++i)
+        encoderH = LSTMPComponentWithSelfStabilization<float>(encoderH, { hiddenDim }, { hiddenDim }, PastValueHook, PastValueHook, device).first;
+
+    // decoder, fed the previous label
+    auto labelEmbedding = Embedding(labels, embeddingDim, device);
+    FunctionPtr decoderH = PastValue(labelEmbedding);
+    for (size_t i = 0; i < numLayers; ++i)
+        decoderH = LSTMPComponentWithSelfStabilization<float>(decoderH, { hiddenDim }, { hiddenDim }, PastValueHook, PastValueHook, device).first;
+
+    // dot-product attention over the last 'attentionWindow' encoder states, [hiddenDim x attentionWindow] at each decoder step
+    std::vector<Variable> window;
+    for (size_t k = 0; k < attentionWindow; ++k)
+        window.push_back(Reshape(k == 0 ? encoderH : PastValue(encoderH, k), { hiddenDim, 1 }));
+    auto encoderWindow = Sequence::BroadcastAs(Sequence::Last(Splice(window, Axis(1))), labelEmbedding);
+
+    auto queryParams = Parameter({ hiddenDim, hiddenDim }, DataType::Float, GlorotUniformInitializer(), device);
+    auto query = Reshape(Times(queryParams, decoderH), { hiddenDim, 1 });
+    auto scores = Reshape(ReduceSum(ElementTimes(encoderWindow, query), Axis(0)), { attentionWindow });
+    auto attentionWeights = Reshape(Softmax(scores), { 1, attentionWindow });
+    auto context = Reshape(ReduceSum(ElementTimes(encoderWindow, attentionWeights), Axis(1)), { hiddenDim });
+
+    auto classifierOutput = FullyConnectedLinearLayer(Splice({ decoderH, context }, Axis(0)), vocabularySize, device, L"classifierOutput");
+
+    auto trainingLoss = CrossEntropyWithSoftmax(classifierOutput, labels, L"lossFunction");
+    auto prediction = ClassificationError(classifierOutput, labels, L"classificationError");
+
+    std::mt19937 rng(5);
+    return CreateWorkload(classifierOutput, trainingLoss, prediction, 0.005, communicator,
+                          { { input, RandomOneHotSequences(vocabularySize, numSequences, sequenceLength, rng, device) },
+                            { labels, RandomOneHotSequences(vocabularySize, numSequences, sequenceLength, rng, device) } });
+}
+
+// -----------------------------------------------------------------------
+// all benchmarks
+// -----------------------------------------------------------------------
+
+const std::vector<TrainingBenchmark>& AllTrainingBenchmarks()
+{
+    static const std::vector<TrainingBenchmark> benchmarks = {
+        { "resnet50/224x224/mb32", true, true, CreateResNet50 },
+        { "blstm-am/3x512/16x200", true, true, CreateBLSTMAcousticModel },
+        { "lstm-lm/50k-softmax/32x35", true, true, CreateLSTMLanguageModel },
+        { "sparse-ctr/1M-features/mb2048", true, true, CreateSparseCTRModel },
+        { "seq2seq-attention/30k/32x30", true, true, CreateSeq2SeqAttentionModel },
+    };
+    return benchmarks;
+}
@@ -0,0 +1,39 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TrainingBenchmarks.h -- end-to-end training throughput of representative models
+//
+// A benchmark is a model of fixed size with a trainer, and one synthetic minibatch of fixed size that is created on the
+// device up front and trained on again and again. Reading data is not measured; everything from the forward pass to the
+// parameter update (and the gradient aggregation when distributed) is. The driver (Main.cpp) times the steps, and
+// counts the samples as the trainer does (images, frames or words, i.e. the samples of the labels).
+//
+
+#pragma once
+
+#include "CNTKLibrary.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace CNTK;
+
+// a benchmark instantiated on a device, ready to train
+struct TrainingWorkload
+{
+    TrainerPtr trainer;
+    std::unordered_map<Variable, ValuePtr> minibatch; // the synthetic minibatch, on the device
+};
+
+struct TrainingBenchmark
+{
+    std::string name; // stable, it is the key for comparing against a baseline
+    bool cpu, gpu;    // devices it runs on
+    // Creates the model and data on the device. With a communicator, the learners are wrapped for data-parallel training.
+    std::function<TrainingWorkload(const DeviceDescriptor& device, const DistributedCommunicatorPtr& communicator)> create;
+};
+
+// all benchmarks, in the order they are run
+const std::vector<TrainingBenchmark>& AllTrainingBenchmarks();
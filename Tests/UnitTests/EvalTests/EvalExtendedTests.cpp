@@ -7,6 +7,7 @@
 #include "ComputationNode.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -175,6 +176,234 @@ BOOST_AUTO_TEST_CASE(EvalScalarTimesDualOutputTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalCloneSharingParametersTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "o1 = Times(Constant(3), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    IEvaluateModelExtended<float> *eval;
+    GetEvalExtendedF(&eval);
+    eval->CreateNetwork(modelDefinition);
+
+    // The clones share the constant with the original evaluator, but run their forward passes concurrently.
+    std::vector<IEvaluateModelExtended<float>*> evals{ eval, eval->Clone(), eval->Clone() };
+    std::vector<std::thread> threads;
+    std::vector<float> results(evals.size());
+    for (size_t i = 0; i < evals.size(); i++)
+    {
+        threads.push_back(std::thread([&evals, &results, i]()
+        {
+            auto outputLayouts = evals[i]->GetOutputSchema();
+            evals[i]->StartForwardEvaluation({ outputLayouts[0].m_name });
+            Values<float> outputBuffer = evals[i]->GetOutputSchema().CreateBuffers<float>({ 1 });
+            Values<float> inputBuffer(1);
+            for (int j = 0; j < 100; j++)
+            {
+                inputBuffer[0].m_buffer = { (float)i + 1 };
+                evals[i]->ForwardPass(inputBuffer, outputBuffer);
+            }
+            results[i] = outputBuffer[0].m_buffer[0];
+        }));
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<float> expected{ 3, 6, 9 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(results.begin(), results.end(), expected.begin(), expected.end());
+
+    // Clone() is not possible once the evaluation has started.
+    BOOST_REQUIRE_THROW(eval->Clone(), std::exception);
+
+    for (auto e : evals)
+        e->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalOptimizeForInferenceTest)
+{
+    // Dropout is removed, the BatchNormalization is folded into W, and b is computed once.
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(2) \n"
+        "h = Times(Constant(2, rows=2, cols=2), i1) \n"
+        "bn = BatchNormalization(h, Constant(2, rows=2, cols=1), Constant(1, rows=2, cols=1), Constant(3, rows=2, cols=1), Constant(4, rows=2, cols=1), epsilon=0.000001) \n"
+        "d = Dropout(bn) \n"
+        "b = Times(Constant(1, rows=2, cols=2), Constant(1, rows=2, cols=1)) \n"
+        "o1 = Plus(d, b, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    std::vector<std::vector<float>> results;
+    for (auto config : { "optimizeForInference=false", "optimizeForInference=true" })
+    {
+        IEvaluateModelExtended<float> *eval;
+        GetEvalExtendedF(&eval);
+        eval->Init(config);
+        eval->CreateNetwork(modelDefinition);
+
+        auto outputLayouts = eval->GetOutputSchema();
+        eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+        Values<float> outputBuffer = eval->GetOutputSchema().CreateBuffers<float>({ 1 });
+        Values<float> inputBuffer(1);
+        inputBuffer[0].m_buffer = { 1, 2 };
+        eval->ForwardPass(inputBuffer, outputBuffer);
+        results.push_back(outputBuffer[0].m_buffer);
+
+        eval->Destroy();
+    }
+
+    // 2 * (2 + 4 - 3) / sqrt(4) + 1 + 2
+    for (const auto& result : results)
+    {
+        BOOST_REQUIRE_EQUAL(result.size(), 2);
+        for (auto value : result)
+            BOOST_CHECK_CLOSE(value, 6.0f, 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EvalSparseInferenceTest)
+{
+    // W0 has no nonzeros and is stored sparse, W1 is dense and stays so; b is only used by a Plus.
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(2) \n"
+        "W0 = Parameter(2, 2, init=\"fixedValue\", value=0) \n"
+        "W1 = Parameter(2, 2, init=\"fixedValue\", value=2) \n"
+        "b = Parameter(2, 1, init=\"fixedValue\", value=0) \n"
+        "h = Plus(Times(W0, i1), Times(W1, i1)) \n"
+        "o1 = Plus(h, b, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    for (auto config : { "sparseInferenceMaxDensity=0", "sparseInferenceMaxDensity=0.5", "sparseInferenceMaxDensity=0.5\nsparseInferenceBenchmarkColumns=4" })
+    {
+        IEvaluateModelExtended<float> *eval;
+        GetEvalExtendedF(&eval);
+        eval->Init(config);
+        eval->CreateNetwork(modelDefinition);
+
+        auto outputLayouts = eval->GetOutputSchema();
+        eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+        Values<float> outputBuffer = eval->GetOutputSchema().CreateBuffers<float>({ 1 });
+        Values<float> inputBuffer(1);
+        inputBuffer[0].m_buffer = { 1, 2 };
+        eval->ForwardPass(inputBuffer, outputBuffer);
+
+        // 2 * (1 + 2)
+        BOOST_REQUIRE_EQUAL(outputBuffer[0].m_buffer.size(), 2);
+        for (auto value : outputBuffer[0].m_buffer)
+            BOOST_CHECK_CLOSE(value, 6.0f, 1e-3);
+
+        eval->Destroy();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EvalForwardPlansTest)
+{
+    // b only depends on constants, so the plan recorded from the later passes does not run it.
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(2) \n"
+        "h = Times(Constant(2, rows=2, cols=2), i1) \n"
+        "b = Times(Constant(1, rows=2, cols=2), Constant(1, rows=2, cols=1)) \n"
+        "o1 = Plus(h, b, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    IEvaluateModelExtended<float> *eval;
+    GetEvalExtendedF(&eval);
+    eval->Init("forwardPlans=true");
+    eval->CreateNetwork(modelDefinition);
+
+    auto outputLayouts = eval->GetOutputSchema();
+    eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+    Values<float> outputBuffer = eval->GetOutputSchema().CreateBuffers<float>({ 1 });
+    Values<float> inputBuffer(1);
+
+    // the first passes are recorded, the later ones run the plan
+    for (size_t i = 0; i < 5; i++)
+    {
+        inputBuffer[0].m_buffer = { (float)i, 1 };
+        eval->ForwardPass(inputBuffer, outputBuffer);
+
+        // 2 * (i + 1) + 2
+        BOOST_REQUIRE_EQUAL(outputBuffer[0].m_buffer.size(), 2);
+        for (auto value : outputBuffer[0].m_buffer)
+            BOOST_CHECK_CLOSE(value, 2.0f * (i + 1) + 2, 1e-3);
+    }
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalMemoryPlansTest)
+{
+    // h and s are shared matrices, which the plans of the sequence lengths place into the arena.
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(2) \n"
+        "h = Times(Constant(2, rows=2, cols=2), i1) \n"
+        "s = Plus(h, h) \n"
+        "b = Times(Constant(1, rows=2, cols=2), Constant(1, rows=2, cols=1)) \n"
+        "o1 = Plus(s, b, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    IEvaluateModelExtended<float> *eval;
+    GetEvalExtendedF(&eval);
+    eval->Init("memoryPlans=true");
+    eval->CreateNetwork(modelDefinition);
+
+    auto outputLayouts = eval->GetOutputSchema();
+    eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+    Values<float> outputBuffer = eval->GetOutputSchema().CreateBuffers<float>({ 5 });
+    Values<float> inputBuffer(1);
+
+    // the first sequence of each length is recorded, the later ones switch between the plans
+    for (size_t length : { 3, 1, 3, 5, 1, 5, 3 })
+    {
+        inputBuffer[0].m_buffer.clear();
+        for (size_t t = 0; t < length; t++)
+        {
+            inputBuffer[0].m_buffer.push_back((float)(length + t));
+            inputBuffer[0].m_buffer.push_back(1);
+        }
+        eval->ForwardPass(inputBuffer, outputBuffer);
+
+        // 4 * (length + t + 1) + 2
+        BOOST_REQUIRE_EQUAL(outputBuffer[0].m_buffer.size(), 2 * length);
+        for (size_t t = 0; t < length; t++)
+        {
+            BOOST_CHECK_CLOSE(outputBuffer[0].m_buffer[2 * t], 4.0f * (length + t + 1) + 2, 1e-3);
+            BOOST_CHECK_CLOSE(outputBuffer[0].m_buffer[2 * t + 1], 4.0f * (length + t + 1) + 2, 1e-3);
+        }
+    }
+
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_CASE(EvalDenseTimesTest)
 {
     std::string modelDefinition =
@@ -227,6 +456,135 @@ BOOST_AUTO_TEST_CASE(EvalDenseTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalBoundBuffersTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    std::vector<float> input{ 1, 2, 3, 4, 1, 1, 1, 1 };
+    std::vector<float> output(2, -1);
+    size_t numSamples[] = { 1 };
+    size_t outputSizes[] = { 0 };
+
+    // Inputs and outputs must be bound
+    BOOST_REQUIRE_THROW(eval->ForwardPassBound(numSamples, outputSizes, true), std::exception);
+    BOOST_REQUIRE_THROW(eval->BindInput(1, input.data(), input.size(), false), std::exception); // No such input
+    BOOST_REQUIRE_THROW(eval->BindInput(0, input.data(), input.size(), true), std::exception);  // Not on the device
+
+    eval->BindInput(0, input.data(), input.size(), false);
+    eval->BindOutput(0, output.data(), output.size(), false);
+    eval->ForwardPassBound(numSamples, outputSizes, true);
+    BOOST_CHECK_EQUAL(outputSizes[0], 1);
+    BOOST_CHECK_EQUAL(output[0], 20);
+
+    // The buffers are read and written in place on each call
+    input[0] = 2;
+    eval->ForwardPassBound(numSamples, outputSizes, true);
+    BOOST_CHECK_EQUAL(output[0], 22);
+
+    numSamples[0] = 2;
+    eval->ForwardPassBound(numSamples, outputSizes, true);
+    std::vector<float> expected{ 22, 8 };
+    BOOST_CHECK_EQUAL(outputSizes[0], 2);
+    BOOST_CHECK_EQUAL_COLLECTIONS(output.begin(), output.end(), expected.begin(), expected.end());
+
+    // More samples than the buffers hold
+    numSamples[0] = 3;
+    BOOST_REQUIRE_THROW(eval->ForwardPassBound(numSamples, outputSizes, true), std::exception);
+
+    // ForwardPass() does not write into the bound buffers
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 1, 2, 3, 4 };
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    eval->ForwardPass(inputBuffer, outputBuffer);
+    BOOST_CHECK_EQUAL(outputBuffer[0].m_buffer[0], 20);
+    BOOST_CHECK_EQUAL_COLLECTIONS(output.begin(), output.end(), expected.begin(), expected.end());
+
+    // Rebinding the output
+    std::vector<float> output2(1);
+    eval->BindOutput(0, output2.data(), output2.size(), false);
+    numSamples[0] = 1;
+    eval->ForwardPassBound(numSamples, nullptr, true);
+    BOOST_CHECK_EQUAL(output2[0], 22);
+    BOOST_CHECK_EQUAL_COLLECTIONS(output.begin(), output.end(), expected.begin(), expected.end());
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalEnsembleTest)
+{
+    auto modelDefinition = [](int factor)
+    {
+        return
+            "deviceId = -1 \n"
+            "precision = \"float\" \n"
+            "traceLevel = 1 \n"
+            "run=NDLNetworkBuilder \n"
+            "NDLNetworkBuilder=[ \n"
+            "i1 = Input(1) \n"
+            "o1 = Times(Constant(" + std::to_string(factor) + "), i1, tag=\"output\") \n"
+            "FeatureNodes = (i1) \n"
+            "] \n";
+    };
+
+    for (bool logMean : { false, true })
+    {
+        IEvaluateModelEnsemble<float>* eval;
+        GetEvalEnsembleF(&eval);
+        eval->Init(logMean ? "ensembleCombination=logMean" : "");
+        BOOST_REQUIRE_THROW(eval->StartForwardEvaluation({ L"o1" }), std::exception); // No models
+        eval->CreateNetwork(modelDefinition(3));
+        eval->CreateNetwork(modelDefinition(5));
+        BOOST_CHECK_EQUAL(eval->GetNumModels(), 2);
+
+        eval->StartForwardEvaluation({ L"o1" });
+        VariableSchema outputLayouts = eval->GetOutputSchema();
+        BOOST_REQUIRE_EQUAL(outputLayouts.size(), 1);
+        BOOST_REQUIRE_EQUAL(eval->GetInputSchema().size(), 1);
+
+        // Both models read the same two samples
+        Values<float> inputBuffer(1);
+        inputBuffer[0].m_buffer = { 2, 4 };
+        Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 2 });
+        eval->ForwardPass(inputBuffer, outputBuffer, true);
+
+        auto buf = outputBuffer[0].m_buffer;
+        BOOST_REQUIRE_EQUAL(buf.size(), 2);
+        for (size_t i = 0; i < 2; i++)
+        {
+            float x = inputBuffer[0].m_buffer[i];
+            float expected = logMean ? (log(3 * x) + log(5 * x)) / 2 : (3 * x + 5 * x) / 2;
+            BOOST_CHECK_CLOSE(buf[i], expected, 1e-4);
+        }
+
+        // Again, with another number of samples
+        inputBuffer[0].m_buffer = { 1 };
+        eval->ForwardPass(inputBuffer, outputBuffer, true);
+        BOOST_REQUIRE_EQUAL(outputBuffer[0].m_buffer.size(), 1);
+        BOOST_CHECK_CLOSE(outputBuffer[0].m_buffer[0], logMean ? (log(3.0f) + log(5.0f)) / 2 : 4.0f, 1e-4);
+
+        eval->Destroy();
+    }
+
+    IEvaluateModelEnsemble<float>* eval;
+    GetEvalEnsembleF(&eval);
+    BOOST_REQUIRE_THROW(eval->Init("ensembleCombination=max"), std::exception);
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_CASE(EvalSparseTimesTest)
 {
     std::string modelDefinition =
@@ -292,6 +650,68 @@ BOOST_AUTO_TEST_CASE(EvalSparseTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalStreamsTest)
+{
+    // o1 is the running sum of the input of each stream
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "dp = PastValue(1, o1, timeStep = 1) \n"
+        "o1 = Plus(i1, dp, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    auto forwardPassStreams = [&](const std::vector<size_t>& streamIds, const std::vector<std::vector<float>>& frames)
+    {
+        std::vector<Values<float>> inputs;
+        std::vector<Values<float>> outputs;
+        for (const auto& streamFrames : frames)
+        {
+            inputs.push_back(Values<float>(1));
+            inputs.back()[0].m_buffer = streamFrames;
+            outputs.push_back(outputLayouts.CreateBuffers<float>({ 2 }));
+        }
+        eval->ForwardPassStreams(streamIds, inputs, outputs);
+
+        std::vector<std::vector<float>> results;
+        for (const auto& output : outputs)
+            results.push_back(output[0].m_buffer);
+        return results;
+    };
+
+    // streams of different lengths
+    auto results = forwardPassStreams({ 1, 2 }, { { 1, 2 }, { 10 } });
+    BOOST_CHECK(results[0] == std::vector<float>({ 1, 3 }));
+    BOOST_CHECK(results[1] == std::vector<float>({ 10 }));
+
+    // stream 2 continues in another parallel sequence, next to a new stream
+    results = forwardPassStreams({ 3, 2 }, { { 100 }, { 5, 5 } });
+    BOOST_CHECK(results[0] == std::vector<float>({ 100 }));
+    BOOST_CHECK(results[1] == std::vector<float>({ 15, 20 }));
+
+    results = forwardPassStreams({ 1 }, { { 4 } });
+    BOOST_CHECK(results[0] == std::vector<float>({ 7 }));
+
+    // an ended stream begins anew
+    eval->EndStream(2);
+    results = forwardPassStreams({ 2 }, { { 1 } });
+    BOOST_CHECK(results[0] == std::vector<float>({ 1 }));
+
+    // each stream at most once
+    BOOST_REQUIRE_THROW(forwardPassStreams({ 1, 1 }, { { 1 }, { 1 } }), std::exception);
+
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_CASE(EvalRNNTest)
 {
     std::string modelDefinition =
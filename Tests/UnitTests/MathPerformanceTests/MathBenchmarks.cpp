@@ -0,0 +1,488 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmarks.cpp -- the benchmark definitions
+//
+// Shapes are those of typical models: square and skinny GEMMs of feed-forward and recurrent layers,
+// one-hot embeddings of a 10k vocabulary, 3x3 convolutions of an image classifier, and so on.
+// Names must stay stable, since they are the keys for comparing against a baseline.
+//
+
+#include "stdafx.h"
+#include "MathBenchmarks.h"
+#include "TensorView.h"
+#include "ConvolutionEngine.h"
+#include "BatchNormalizationEngine.h"
+#include "RNNCommon.h"
+#include "Quantizers.h"
+#include "QuantizedOperations.h"
+#include <random>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Benchmarks {
+
+using namespace std;
+
+typedef Matrix<float> Mat;
+typedef shared_ptr<Mat> MatPtr;
+
+// -----------------------------------------------------------------------
+// helpers
+// -----------------------------------------------------------------------
+
+static MatPtr RandomMatrix(size_t rows, size_t cols, DEVICEID_TYPE deviceId, unsigned long seed)
+{
+    return make_shared<Mat>(Mat::RandomUniform(rows, cols, deviceId, -1, 1, seed));
+}
+
+// one 1 per column at a random row, as minibatches of word indices are
+static vector<float> OneHotData(size_t rows, size_t cols, unsigned long seed)
+{
+    mt19937 rng(seed);
+    uniform_int_distribution<size_t> row(0, rows - 1);
+    vector<float> data(rows * cols, 0);
+    for (size_t j = 0; j < cols; j++)
+        data[j * rows + row(rng)] = 1;
+    return data;
+}
+
+static MatPtr OneHotMatrix(size_t rows, size_t cols, DEVICEID_TYPE deviceId, unsigned long seed, bool sparse)
+{
+    auto data = OneHotData(rows, cols, seed);
+    auto m = make_shared<Mat>(rows, cols, data.data(), deviceId);
+    if (sparse)
+        m->SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, true);
+    return m;
+}
+
+// reading one element back waits for the GPU; a no-op for CPU matrices
+static function<void()> SyncOn(const MatPtr& m)
+{
+    return [m]() { m->Get00Element(); };
+}
+
+static string Dims(std::initializer_list<size_t> dims)
+{
+    string s;
+    for (size_t dim : dims)
+        s += (s.empty() ? "" : "x") + to_string(dim);
+    return s;
+}
+
+static string Dims(const TensorShape& shape)
+{
+    string s;
+    for (size_t dim : shape.GetDims())
+        s += (s.empty() ? "" : "x") + to_string(dim);
+    return s;
+}
+
+// -----------------------------------------------------------------------
+// GEMM: c = a * b, [m x k] * [k x n]
+// -----------------------------------------------------------------------
+
+static BenchmarkDefinition Gemm(size_t m, size_t n, size_t k, bool transposeA, bool transposeB)
+{
+    string name = string("gemm/") + (transposeA ? "T" : "N") + (transposeB ? "T" : "N") + "/" + Dims({ m, n, k });
+    return { name, true, true, [=](DEVICEID_TYPE deviceId)
+    {
+        auto a = transposeA ? RandomMatrix(k, m, deviceId, 1) : RandomMatrix(m, k, deviceId, 1);
+        auto b = transposeB ? RandomMatrix(n, k, deviceId, 2) : RandomMatrix(k, n, deviceId, 2);
+        auto c = make_shared<Mat>(m, n, deviceId);
+        BenchmarkInstance bm;
+        bm.flops = 2.0 * m * n * k;
+        bm.bytes = sizeof(float) * (m * k + k * n + m * n);
+        bm.run = [=]() { Mat::MultiplyAndWeightedAdd(1, *a, transposeA, *b, transposeB, 0, *c); };
+        bm.sync = SyncOn(c);
+        return bm;
+    } };
+}
+
+// -----------------------------------------------------------------------
+// sparse products of an embedding [dim x vocab] with one-hot input [vocab x T] (sparse CSC)
+// -----------------------------------------------------------------------
+
+// forward: [dim x T] = E * X
+static BenchmarkDefinition EmbeddingForward(size_t dim, size_t vocab, size_t T)
+{
+    return { "sparse/denseTimesSparse/" + Dims({ dim, vocab, T }), true, true, [=](DEVICEID_TYPE deviceId)
+    {
+        auto e = RandomMatrix(dim, vocab, deviceId, 1);
+        auto x = OneHotMatrix(vocab, T, deviceId, 2, /*sparse=*/true);
+        auto c = make_shared<Mat>(dim, T, deviceId);
+        BenchmarkInstance bm;
+        bm.flops = 2.0 * dim * T; // one nonzero per column
+        bm.bytes = sizeof(float) * (2.0 * dim * T);
+        bm.run = [=]() { Mat::MultiplyAndWeightedAdd(1, *e, false, *x, false, 0, *c); };
+        bm.sync = SyncOn(c);
+        return bm;
+    } };
+}
+
+// gradient: dE += G * X'
+static BenchmarkDefinition EmbeddingGradient(size_t dim, size_t vocab, size_t T)
+{
+    return { "sparse/denseTimesSparseTransposed/" + Dims({ dim, vocab, T }), true, true, [=](DEVICEID_TYPE deviceId)
+    {
+        auto g = RandomMatrix(dim, T, deviceId, 1);
+        auto x = OneHotMatrix(vocab, T, deviceId, 2, /*sparse=*/true);
+        auto de = make_shared<Mat>(dim, vocab, deviceId);
+        de->SetValue(0);
+        BenchmarkInstance bm;
+        bm.flops = 2.0 * dim * T;
+        bm.bytes = sizeof(float) * (3.0 * dim * T); // read G, read-modify-write the touched columns of dE
+        bm.run = [=]() { Mat::MultiplyAndWeightedAdd(1, *g, false, *x, true, 1, *de); };
+        bm.sync = SyncOn(de);
+        return bm;
+    } };
+}
+
+// -----------------------------------------------------------------------
+// TensorView
+// -----------------------------------------------------------------------
+
+static TensorView<float> RandomTensor(const TensorShape& shape, DEVICEID_TYPE deviceId, unsigned long seed)
+{
+    return TensorView<float>(RandomMatrix(shape.GetNumElements(), 1, deviceId, seed), shape);
+}
+
+// c = a + b, where b may broadcast
+static BenchmarkDefinition TensorSum(const char* variant, const TensorShape& shapeA, const TensorShape& shapeB)
+{
+    return { string("tensor/") + variant + "/" + Dims(shapeA) + "+" + Dims(shapeB), true, true, [=](DEVICEID_TYPE deviceId)
+    {
+        auto a = RandomTensor(shapeA, deviceId, 1);
+        auto b = RandomTensor(shapeB, deviceId, 2);
+        auto c = make_shared<TensorView<float>>(RandomTensor(shapeA, deviceId, 3));
+        const double n = (double) shapeA.GetNumElements();
+        BenchmarkInstance bm;
+        bm.flops = n;
+        bm.bytes = sizeof(float) * (2 * n + shapeB.GetNumElements());
+        bm.run = [=]() { c->AssignSumOf(a, b); };
+        bm.sync = SyncOn(dynamic_pointer_cast<Mat>(c->GetSOBPtr()));
+        return bm;
+    } };
+}
+
+static BenchmarkDefinition TensorSigmoid(const TensorShape& shape)
+{
+    return { "tensor/sigmoid/" + Dims(shape), true, true, [=](DEVICEID_TYPE deviceId)
+    {
+        auto a = RandomTensor(shape, deviceId, 1);
+        auto c = make_shared<TensorView<float>>(RandomTensor(shape, deviceId, 2));
+        const double n = (double) shape.GetNumElements();
+        BenchmarkInstance bm;
+        bm.flops = 4 * n; // exp, add, divide, negate
+        bm.bytes = sizeof(float) * 2 * n;
+        bm.run = [=]() { c->AssignSigmoidOf(a); };
+        bm.sync = SyncOn(dynamic_pointer_cast<Mat>(c->GetSOBPtr()));
+        return bm;
+    } };
+}
+
+// c += reduce(a), e.g. bias gradients
+static BenchmarkDefinition TensorReduction(const TensorShape& shapeA, const TensorShape& shapeC)
+{
+    return { "tensor/reduceSum/" + Dims(shapeA) + "->" + Dims(shapeC), true, true, [=](DEVICEID_TYPE deviceId)
+    {
+        auto a = RandomTensor(shapeA, deviceId, 1);
+        auto c = make_shared<TensorView<float>>(RandomTensor(shapeC, deviceId, 2));
+        const double n = (double) shapeA.GetNumElements();
+        BenchmarkInstance bm;
+        bm.flops = n;
+        bm.bytes = sizeof(float) * (n + 2 * shapeC.GetNumElements());
+        bm.run = [=]() { c->DoCopyOf(1, a, 1); };
+        bm.sync = SyncOn(dynamic_pointer_cast<Mat>(c->GetSOBPtr()));
+        return bm;
+    } };
+}
+
+// -----------------------------------------------------------------------
+// convolution: 3x3, stride 1, padded, [W x H x C] x N images -> K maps
+// -----------------------------------------------------------------------
+
+enum class ConvolutionPass { Forward, BackwardData, BackwardKernel };
+
+static BenchmarkDefinition Convolution(ConvolutionEngineKind kind, const char* engineName, bool cpu, bool gpu, ConvolutionPass pass,
+                                       size_t W, size_t H, size_t C, size_t K, size_t N)
+{
+    const char* passName = pass == ConvolutionPass::Forward ? "fwd" : pass == ConvolutionPass::BackwardData ? "bwdData" : "bwdKernel";
+    string name = string("conv/") + engineName + "/" + passName + "/" + Dims({ W, H, C, N }) + "/3x3x" + to_string(K);
+    return { name, cpu, gpu, [=](DEVICEID_TYPE deviceId)
+    {
+        auto geometry = make_shared<ConvolveGeometry>(TensorShape(W, H, C), TensorShape(3, 3, C), TensorShape(K), TensorShape(1, 1, C),
+                                                      ConvolveGeometry::BoolVec{ true }, ConvolveGeometry::BoolVec{ true, true, false },
+                                                      TensorShape(0), TensorShape(0));
+        shared_ptr<ConvolutionEngine<float>> engine = ConvolutionEngine<float>::Create(geometry, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, kind);
+        const size_t inSize = geometry->InputShape().GetNumElements();
+        const size_t outSize = geometry->OutputShape().GetNumElements();
+        const size_t kernelSize = geometry->KernelShape().GetNumElements();
+        const size_t mapCount = geometry->GetMapCount(geometry->InputShape().GetRank() - 1);
+        auto in = RandomMatrix(inSize, N, deviceId, 1);
+        auto kernel = RandomMatrix(mapCount, kernelSize, deviceId, 2);
+        auto out = RandomMatrix(outSize, N, deviceId, 3);
+        auto workspace = make_shared<Mat>(deviceId);
+
+        BenchmarkInstance bm;
+        bm.flops = 2.0 * outSize * kernelSize * N;
+        bm.bytes = sizeof(float) * ((double) inSize * N + (double) outSize * N + (double) mapCount * kernelSize);
+        switch (pass)
+        {
+        case ConvolutionPass::Forward:
+            bm.run = [=]() { engine->Forward(*in, *kernel, *out, *workspace); };
+            bm.sync = SyncOn(out);
+            break;
+        case ConvolutionPass::BackwardData:
+            bm.run = [=]() { engine->BackwardData(*out, *kernel, *in, /*accumulateGradient=*/false, *workspace); };
+            bm.sync = SyncOn(in);
+            break;
+        default:
+            bm.run = [=]() { engine->BackwardKernel(*out, *in, *kernel, /*accumulateGradient=*/false, /*allowReuse=*/false, *workspace); };
+            bm.sync = SyncOn(kernel);
+            break;
+        }
+        return bm;
+    } };
+}
+
+// -----------------------------------------------------------------------
+// batch normalization, spatial, [W x H x C] x N
+// -----------------------------------------------------------------------
+
+enum class BatchNormPass { TrainingForward, InferenceForward, Backward };
+
+static BenchmarkDefinition BatchNorm(BatchNormEngineKind kind, const char* engineName, bool cpu, bool gpu, BatchNormPass pass,
+                                     size_t W, size_t H, size_t C, size_t N)
+{
+    const char* passName = pass == BatchNormPass::TrainingForward ? "trainFwd" : pass == BatchNormPass::InferenceForward ? "inferFwd" : "bwd";
+    string name = string("batchnorm/") + engineName + "/" + passName + "/" + Dims({ W, H, C, N });
+    return { name, cpu, gpu, [=](DEVICEID_TYPE deviceId)
+    {
+        const TensorShape shape(W, H, C);
+        shared_ptr<BatchNormEngine<float>> engine = BatchNormEngine<float>::Create(deviceId, shape, /*spatial=*/true, ImageLayoutKind::CHW, kind);
+        const size_t size = shape.GetNumElements();
+        auto in = RandomMatrix(size, N, deviceId, 1);
+        auto out = RandomMatrix(size, N, deviceId, 2);
+        auto grad = RandomMatrix(size, N, deviceId, 3);
+        auto scale = RandomMatrix(C, 1, deviceId, 4);
+        auto bias = RandomMatrix(C, 1, deviceId, 5);
+        auto runMean = make_shared<Mat>(C, 1, deviceId);
+        auto runVariance = make_shared<Mat>(C, 1, deviceId);
+        auto saveMean = make_shared<Mat>(C, 1, deviceId);
+        auto saveInvStdDev = make_shared<Mat>(C, 1, deviceId);
+        auto scaleGrad = make_shared<Mat>(C, 1, deviceId);
+        auto biasGrad = make_shared<Mat>(C, 1, deviceId);
+        runMean->SetValue(0);
+        runVariance->SetValue(1);
+        // backward needs the statistics of a training forward pass
+        if (pass == BatchNormPass::Backward)
+            engine->Forward(*in, *scale, *bias, false, 1, 0, *runMean, *runVariance, *out, 1e-5, *saveMean, *saveInvStdDev);
+
+        const double n = (double) size * N;
+        BenchmarkInstance bm;
+        switch (pass)
+        {
+        case BatchNormPass::TrainingForward: // statistics pass, then normalize
+            bm.flops = 5 * n;
+            bm.bytes = sizeof(float) * 3 * n;
+            bm.run = [=]() { engine->Forward(*in, *scale, *bias, false, 0.1, 0, *runMean, *runVariance, *out, 1e-5, *saveMean, *saveInvStdDev); };
+            bm.sync = SyncOn(out);
+            break;
+        case BatchNormPass::InferenceForward:
+            bm.flops = 2 * n;
+            bm.bytes = sizeof(float) * 2 * n;
+            bm.run = [=]() { engine->Forward(*in, *scale, *bias, true, 0, 1, *runMean, *runVariance, *out, 1e-5, *saveMean, *saveInvStdDev); };
+            bm.sync = SyncOn(out);
+            break;
+        default: // reductions over x and dy, then dx
+            bm.flops = 8 * n;
+            bm.bytes = sizeof(float) * 5 * n;
+            bm.run = [=]() { engine->Backward(*in, *out, *grad, *scale, 0, *saveMean, *saveInvStdDev, *scaleGrad, *biasGrad); };
+            bm.sync = SyncOn(grad);
+            break;
+        }
+        return bm;
+    } };
+}
+
+// -----------------------------------------------------------------------
+// recurrent layers (OptimizedRNNStack forward), S sequences of T frames
+// -----------------------------------------------------------------------
+
+static BenchmarkDefinition RNNForward(const wchar_t* op, const char* opName, size_t numLayers, size_t hiddenSize, size_t xDim, size_t S, size_t T)
+{
+    string name = string("rnn/") + opName + "/fwd/" + Dims({ xDim, hiddenSize, numLayers }) + "/" + Dims({ S, T });
+    return { name, true, true, [=](DEVICEID_TYPE deviceId)
+    {
+        auto attributes = make_shared<RnnAttributes>(false, numLayers, hiddenSize, op, -1);
+        const auto numParameters = attributes->GetNumParameters(xDim);
+        auto w = RandomMatrix(numParameters.first, numParameters.second, deviceId, 1);
+        auto x = RandomMatrix(xDim, S * T, deviceId, 2);
+        auto y = make_shared<Mat>(hiddenSize, S * T, deviceId);
+        auto reserve = make_shared<Mat>(deviceId);
+        auto workspace = make_shared<Mat>(deviceId);
+        auto numSequencesForFrame = make_shared<vector<size_t>>(T, S);
+
+        const double numGates = wcscmp(op, L"lstm") == 0 ? 4 : wcscmp(op, L"gru") == 0 ? 3 : 1;
+        const double numCols = (double) S * T;
+        BenchmarkInstance bm;
+        bm.flops = 2 * numGates * hiddenSize * numCols * ((xDim + hiddenSize) + (numLayers - 1) * 2.0 * hiddenSize);
+        bm.bytes = sizeof(float) * ((double) numParameters.first * numParameters.second + numCols * (xDim + hiddenSize));
+        bm.run = [=]() { y->RNNForward(*x, *w, xDim, hiddenSize, *numSequencesForFrame, *attributes, *reserve, *workspace); };
+        bm.sync = SyncOn(y);
+        return bm;
+    } };
+}
+
+// -----------------------------------------------------------------------
+// fused softmax + cross entropy, [V x T]
+// -----------------------------------------------------------------------
+
+static BenchmarkDefinition SoftmaxCrossEntropy(bool backward, size_t V, size_t T)
+{
+    return { string("softmaxCE/") + (backward ? "bwd" : "fwd") + "/" + Dims({ V, T }), true, true, [=](DEVICEID_TYPE deviceId)
+    {
+        auto labels = OneHotMatrix(V, T, deviceId, 1, /*sparse=*/false);
+        auto input = RandomMatrix(V, T, deviceId, 2);
+        auto inputGradient = RandomMatrix(V, T, deviceId, 3);
+        auto crossEntropy = make_shared<Mat>(1, 1, deviceId);
+        auto logSumExp = make_shared<Mat>(1, T, deviceId);
+        auto gradient = make_shared<Mat>(1, 1, deviceId);
+        gradient->SetValue(1);
+        crossEntropy->AssignSoftmaxCrossEntropyOf(*labels, *input, *logSumExp);
+
+        const double n = (double) V * T;
+        BenchmarkInstance bm;
+        if (!backward)
+        {
+            bm.flops = 4 * n;
+            bm.bytes = sizeof(float) * 2 * n;
+            bm.run = [=]() { crossEntropy->AssignSoftmaxCrossEntropyOf(*labels, *input, *logSumExp); };
+            bm.sync = SyncOn(crossEntropy);
+        }
+        else
+        {
+            bm.flops = 4 * n;
+            bm.bytes = sizeof(float) * 4 * n;
+            bm.run = [=]() { Mat::AddSoftmaxCrossEntropyGradient(*gradient, *labels, *input, *logSumExp, *inputGradient); };
+            bm.sync = SyncOn(inputGradient);
+        }
+        return bm;
+    } };
+}
+
+// -----------------------------------------------------------------------
+// quantization (CPU only)
+// -----------------------------------------------------------------------
+
+static BenchmarkDefinition SymmetricQuantize(size_t n)
+{
+    return { "quantizer/symmetric16/" + to_string(n), true, false, [=](DEVICEID_TYPE)
+    {
+        auto input = make_shared<vector<float>>(n);
+        auto output = make_shared<vector<short>>(n);
+        mt19937 rng(1);
+        uniform_real_distribution<float> dist(-1, 1);
+        for (auto& v : *input)
+            v = dist(rng);
+        auto quantizer = make_shared<SymmetricQuantizer<float, short>>(0);
+        BenchmarkInstance bm;
+        bm.flops = 2.0 * n; // abs-max, scale
+        bm.bytes = (sizeof(float) + sizeof(short)) * (double) n;
+        bm.run = [=]()
+        {
+            ArrayRef<float> in(input->data(), n);
+            ArrayRef<short> out(output->data(), n);
+            quantizer->Quantize(in, out);
+        };
+        bm.sync = []() {};
+        return bm;
+    } };
+}
+
+static BenchmarkDefinition QuantizedGemm(size_t m, size_t n, size_t k, bool packedA)
+{
+    return { string("quantizer/gemmInt16/") + (packedA ? "packedA" : "plain") + "/" + Dims({ m, n, k }), true, false, [=](DEVICEID_TYPE)
+    {
+        auto a = make_shared<vector<short>>(m * k);
+        auto b = make_shared<vector<short>>(k * n);
+        auto c = make_shared<vector<int32_t>>(m * n);
+        mt19937 rng(1);
+        uniform_int_distribution<int> dist(-1000, 1000);
+        for (auto& v : *a)
+            v = (short) dist(rng);
+        for (auto& v : *b)
+            v = (short) dist(rng);
+        auto gemm = make_shared<QuantizedGemmInt16>();
+        if (packedA)
+            gemm->PackA(a->data(), (int) m, (int) k);
+        BenchmarkInstance bm;
+        bm.flops = 2.0 * m * n * k;
+        bm.bytes = sizeof(short) * (double) (m * k + k * n) + sizeof(int32_t) * (double) (m * n);
+        if (packedA)
+            bm.run = [=]() { gemm->MultiplyPackedA((int) m, (int) n, (int) k, b->data(), c->data()); };
+        else
+            bm.run = [=]() { gemm->Multiply((int) m, (int) n, (int) k, a->data(), b->data(), c->data()); };
+        bm.sync = []() {};
+        return bm;
+    } };
+}
+
+// -----------------------------------------------------------------------
+// the suite
+// -----------------------------------------------------------------------
+
+const vector<BenchmarkDefinition>& AllBenchmarks()
+{
+    static const vector<BenchmarkDefinition> benchmarks = []()
+    {
+        vector<BenchmarkDefinition> all;
+
+        // feed-forward layers (large minibatch), recurrent steps (few columns), and transposed products of the backward pass
+        all.push_back(Gemm(1024, 1024, 1024, false, false));
+        all.push_back(Gemm(2048, 256, 2048, false, false));
+        all.push_back(Gemm(4096, 32, 1024, false, false));
+        all.push_back(Gemm(2048, 1, 2048, false, false));
+        all.push_back(Gemm(1024, 256, 2048, true, false));
+        all.push_back(Gemm(2048, 2048, 256, false, true));
+
+        all.push_back(EmbeddingForward(512, 10000, 256));
+        all.push_back(EmbeddingGradient(512, 10000, 256));
+
+        all.push_back(TensorSum("sum", TensorShape(512, 256), TensorShape(512, 256)));
+        all.push_back(TensorSum("biasAdd", TensorShape(28, 28, 128, 32), TensorShape(1, 1, 128)));
+        all.push_back(TensorSigmoid(TensorShape(2048, 1024)));
+        all.push_back(TensorReduction(TensorShape(2048, 1024), TensorShape(2048)));
+        all.push_back(TensorReduction(TensorShape(56, 56, 64, 32), TensorShape(1, 1, 64)));
+
+        for (auto pass : { ConvolutionPass::Forward, ConvolutionPass::BackwardData, ConvolutionPass::BackwardKernel })
+        {
+            all.push_back(Convolution(ConvolutionEngineKind::Gemm,      "gemm",      true,  true,  pass, 28, 28, 64, 64, 32));
+            all.push_back(Convolution(ConvolutionEngineKind::Winograd,  "winograd",  true,  false, pass, 28, 28, 64, 64, 32));
+            all.push_back(Convolution(ConvolutionEngineKind::CuDnn,     "cudnn",     false, true,  pass, 28, 28, 64, 64, 32));
+            // the lookup-based reference implementation is slow, a smaller minibatch keeps the suite's run time down
+            all.push_back(Convolution(ConvolutionEngineKind::Reference, "reference", true,  true,  pass, 28, 28, 64, 64, 4));
+        }
+
+        for (auto pass : { BatchNormPass::TrainingForward, BatchNormPass::InferenceForward, BatchNormPass::Backward })
+        {
+            all.push_back(BatchNorm(BatchNormEngineKind::Cntk,  "cntk",  true,  true, pass, 28, 28, 64, 32));
+            all.push_back(BatchNorm(BatchNormEngineKind::CuDnn, "cudnn", false, true, pass, 28, 28, 64, 32));
+        }
+
+        all.push_back(RNNForward(L"lstm", "lstm", 1, 512, 512, 32, 64));
+        all.push_back(RNNForward(L"lstm", "lstm", 3, 512, 512, 32, 64));
+        all.push_back(RNNForward(L"gru", "gru", 1, 512, 512, 32, 64));
+
+        all.push_back(SoftmaxCrossEntropy(false, 10000, 256));
+        all.push_back(SoftmaxCrossEntropy(true, 10000, 256));
+
+        all.push_back(SymmetricQuantize(1 << 22));
+        all.push_back(QuantizedGemm(512, 256, 512, false));
+        all.push_back(QuantizedGemm(512, 256, 512, true));
+        return all;
+    }();
+    return benchmarks;
+}
+
+}}}}
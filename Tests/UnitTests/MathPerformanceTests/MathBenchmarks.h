@@ -0,0 +1,43 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmarks.h -- microbenchmarks of the Math library kernels
+//
+// A benchmark is one call of a Math library operation on fixed, randomly initialized operands. Each one
+// declares the floating point operations and the bytes of memory traffic a call needs at minimum, from which
+// the driver (MathPerformanceTests.cpp) derives GFLOP/s and GB/s. These nominal counts don't change between
+// builds, so comparing them across builds is the same as comparing the times.
+//
+
+#pragma once
+
+#include "Matrix.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Benchmarks {
+
+// a benchmark instantiated on a device, ready to run
+struct BenchmarkInstance
+{
+    double flops = 0;           // floating point (or integer multiply-add) operations per call
+    double bytes = 0;           // minimum memory traffic per call
+    std::function<void()> run;  // one call; may return before a GPU has finished
+    std::function<void()> sync; // waits until all work queued by run() is done
+};
+
+struct BenchmarkDefinition
+{
+    std::string name;       // "<group>/<variant>/<shape>", e.g. "gemm/NN/1024x1024x1024"
+    bool cpu, gpu;          // devices it runs on
+    // Creates the operands on deviceId; throws if the configuration is not supported there (e.g. cuDNN in a CPU-only build).
+    std::function<BenchmarkInstance(DEVICEID_TYPE deviceId)> create;
+};
+
+// all benchmarks, in the order they are run
+const std::vector<BenchmarkDefinition>& AllBenchmarks();
+
+}}}}
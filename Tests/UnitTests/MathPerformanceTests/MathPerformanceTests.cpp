@@ -2,358 +2,279 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
-// MathPerformanceTests.cpp : Defines the entry point for the console application.
+// MathPerformanceTests.cpp -- runs the Math library benchmarks (MathBenchmarks.cpp) and tracks regressions
 //
+// Usage: mathperformancetests [--device cpu|gpu|all] [--filter <substring>] [--minTime <seconds>]
+//                             [--json <file>] [--baseline <file> [--tolerance <fraction>]] [--list]
+//
+// --json writes one JSON object per benchmark and line:
+//     {"name":"gemm/NN/1024x1024x1024","device":"cpu","seconds":0.0123,"gflops":174.6,"gbps":1.02,"iterations":85}
+// A file written this way can be passed as --baseline to a later run, which then reports every benchmark that got
+// slower than the baseline by more than the tolerance (default 0.1, i.e. 10%), and exits with 1 if there is one.
+//
+// Each benchmark is warmed up with one call (which also allocates workspaces and picks algorithms), then timed as
+// the median of several samples of at least minTime/samples seconds each, so that a single preempted sample does
+// not show up as a regression.
+//
+
 #include "stdafx.h"
-//#define NOMINMAX
-//#include "Windows.h"
-#include "Matrix.h"
-#include "CPUMatrix.h"
-#include "TensorView.h"
-#include "Sequences.h"
+#include "MathBenchmarks.h"
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <vector>
-#include <algorithm>
 
 using namespace Microsoft::MSR::CNTK;
+using namespace Microsoft::MSR::CNTK::Benchmarks;
 using namespace std;
 
-template <class ElemType>
-void randomInitializeCPUMatrix(CPUMatrix<ElemType>& M, float min = -10, float max = 10)
-{
-    foreach_coord (i, j, M)
-    {
-        M(i, j) = (1.0 * rand() / RAND_MAX) * max + min;
-    }
-}
-
-template <class ElemType>
-void randomInitializeMatrix(Matrix<ElemType>& M, float min = -10, float max = 10)
+struct Options
 {
-    foreach_coord (i, j, M)
-    {
-        M(i, j) = (1.0 * rand() / RAND_MAX) * max + min;
-    }
-}
+    bool cpu = true;
+    bool gpu = false;
+    string filter;
+    double minTime = 1.0;
+    string jsonPath;
+    string baselinePath;
+    double tolerance = 0.1;
+    bool list = false;
+};
 
-template <class ElemType>
-void MultiplyAndWeightedAddTest(int n, int k, int m)
+struct Result
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << k << ") and B(" << k << "," << m << ")" << endl;
-    CPUMatrix<ElemType> A(n, k);
-    randomInitializeCPUMatrix<ElemType>(A);
-    CPUMatrix<ElemType> B(k, m);
-    randomInitializeCPUMatrix<ElemType>(B);
-    CPUMatrix<ElemType> C(n, m);
-    auto t_start = clock();
-    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(0.324, A, false, B, false, 0.632, C);
-    auto t_end = clock();
-    std::cout << "CPU Matrix in: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
-    std::cout << n << " " << k << " " << m << endl;
+    string name;
+    string device;
+    double seconds;
+    double gflops;
+    double gbps;
+    size_t iterations;
+};
 
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> AG((size_t) n, (size_t) k);
-    randomInitializeMatrix<ElemType>(AG);
-    Matrix<ElemType> BG((size_t) k, (size_t) m);
-    randomInitializeMatrix<ElemType>(BG);
-    Matrix<ElemType> CG((size_t) n, (size_t) m);
-    auto t_startG = clock();
-    Matrix<ElemType>::MultiplyAndWeightedAdd(0.324, AG, false, BG, false, 0.632, CG);
-    auto t_endG = clock();
-    std::cout << "Matrix in: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
-}
+static const size_t numSamples = 7;
 
-template <class ElemType>
-void AddMultiplyAndInplaceSigmoidTest(int n, int k, int m)
+static void Usage()
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << k << ") and B(" << k << "," << m << ")" << endl;
-    CPUMatrix<ElemType> A(n, k);
-    randomInitializeCPUMatrix<ElemType>(A);
-    CPUMatrix<ElemType> B(k, m);
-    randomInitializeCPUMatrix<ElemType>(B);
-    CPUMatrix<ElemType> D(n, m);
-    randomInitializeCPUMatrix<ElemType>(D);
-    CPUMatrix<ElemType> C(n, m);
-    auto t_start = clock();
-    C = A * B + D;
-    // C.InplaceSigmoid();
-    auto t_end = clock();
-    std::cout << "CPU Matrix in: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
-    std::cout << n << " " << k << " " << m << endl;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> AG((size_t) n, (size_t) k);
-    randomInitializeMatrix<ElemType>(AG);
-    Matrix<ElemType> BG((size_t) k, (size_t) m);
-    randomInitializeMatrix<ElemType>(BG);
-    Matrix<ElemType> DG((size_t) n, (size_t) m);
-    randomInitializeMatrix<ElemType>(DG);
-    Matrix<ElemType> CG((size_t) n, (size_t) m);
-    auto t_startG = clock();
-    CG = AG * BG + DG;
-    // CG.InplaceSigmoid();
-    auto t_endG = clock();
-    std::cout << "Matrix in: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
+    cerr << "Usage: mathperformancetests [--device cpu|gpu|all] [--filter <substring>] [--minTime <seconds>]" << endl
+         << "                            [--json <file>] [--baseline <file> [--tolerance <fraction>]] [--list]" << endl;
 }
 
-template <class ElemType>
-void SquareMultiplyAndAdd10TimesAvgTest(int n, int count)
+static bool ParseOptions(int argc, char* argv[], Options& options)
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << n << ") and B(" << n << "," << n << ")" << endl;
-
-    double cpu_avg = 0;
-    for (int i = 0; i < count; ++i)
+    for (int i = 1; i < argc; i++)
     {
-        CPUMatrix<ElemType> A(n, n);
-        randomInitializeCPUMatrix<ElemType>(A);
-        CPUMatrix<ElemType> B(n, n);
-        randomInitializeCPUMatrix<ElemType>(B);
-        CPUMatrix<ElemType> C(n, n);
-        auto t_start = clock();
-        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(0.324, A, false, B, false, 0.632, C);
-        auto t_end = clock();
-        double val = 1.0 * (t_end - t_start) / CLOCKS_PER_SEC;
-        if (i == 0)
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--list")
+            options.list = true;
+        else if (!hasValue)
+            return false;
+        else if (arg == "--device")
         {
-            cpu_avg = val;
+            const string device = argv[++i];
+            if (device != "cpu" && device != "gpu" && device != "all")
+                return false;
+            options.cpu = device != "gpu";
+            options.gpu = device != "cpu";
         }
+        else if (arg == "--filter")
+            options.filter = argv[++i];
+        else if (arg == "--minTime")
+            options.minTime = atof(argv[++i]);
+        else if (arg == "--json")
+            options.jsonPath = argv[++i];
+        else if (arg == "--baseline")
+            options.baselinePath = argv[++i];
+        else if (arg == "--tolerance")
+            options.tolerance = atof(argv[++i]);
         else
-        {
-            cpu_avg = cpu_avg * (i - 1) / i + val / i;
-        }
+            return false;
     }
+    return options.minTime > 0 && options.tolerance >= 0;
+}
 
-    cout << "Testing Matrix" << endl;
-    double m_avg = 0;
-    for (int i = 0; i < count; ++i)
+// seconds per call of one benchmark
+static double Measure(const BenchmarkInstance& bm, double minTime, size_t& iterations)
+{
+    typedef chrono::high_resolution_clock Clock;
+    auto timeCalls = [&bm](size_t calls)
     {
-        Matrix<ElemType> AG((size_t) n, (size_t) n);
-        randomInitializeMatrix<ElemType>(AG);
-        Matrix<ElemType> BG((size_t) n, (size_t) n);
-        randomInitializeMatrix<ElemType>(BG);
-        Matrix<ElemType> CG((size_t) n, (size_t) n);
-        auto t_startG = clock();
-        Matrix<ElemType>::MultiplyAndWeightedAdd(0.324, AG, false, BG, false, 0.632, CG);
-        auto t_endG = clock();
-        double val = 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC;
-        if (i == 0)
-        {
-            m_avg = val;
-        }
-        else
-        {
-            m_avg = m_avg * (i - 1) / i + val / i;
-        }
+        auto start = Clock::now();
+        for (size_t i = 0; i < calls; i++)
+            bm.run();
+        bm.sync();
+        return chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    timeCalls(1); // warm-up
+
+    // calibrate the number of calls per sample, doubling until a sample takes long enough
+    const double sampleTime = minTime / numSamples;
+    size_t calls = 1;
+    double seconds = timeCalls(calls);
+    while (seconds < sampleTime && calls < (1 << 24))
+    {
+        calls = seconds > 0 ? max(calls * 2, (size_t) (calls * 1.2 * sampleTime / seconds)) : calls * 2;
+        seconds = timeCalls(calls);
     }
 
-    cout << "Based on " << count << " runs:" << endl;
-    cout << "Average time for CPUMatrix is: " << cpu_avg << " seconds" << endl;
-    cout << "Average time for Matrix is: " << m_avg << " seconds" << endl;
-    cout << "CPUMatrix/Matrix ratio is: " << cpu_avg / m_avg << " seconds" << endl;
+    vector<double> samples{ seconds / calls };
+    while (samples.size() < numSamples)
+        samples.push_back(timeCalls(calls) / calls);
+    nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    iterations = calls * (samples.size() + 1);
+    return samples[samples.size() / 2];
 }
 
-// simple test suite for TensorView
-//  - this is meant for performance optimization
-//  - correctness is defined as same result between GPU and CPU
-template <class ElemType>
-struct TensorTest
+static string ToJson(const Result& r)
 {
-    // helper to create a randomly initialized tensor object
-    static TensorView<ElemType> CreateTensor(TensorShape shape, int randomSeed, DEVICEID_TYPE deviceId, bool isResult = false)
-    {
-        let numElements = shape.GetNumElements();
-
-        if (isResult)
-            cout << " ->";
-        cout << " [" << string(shape) << "]";
-        if (isResult)
-            cout << " \t// " << (deviceId < 0 ? "C" : "G") << "PU\n   " << flush;
-
-        // random init
-        mt19937 rng(randomSeed);
-        uniform_real_distribution<float> nd(-1, 1);
-        vector<ElemType> init(numElements);
-        generate(begin(init), end(init), [&] { return nd(rng); });
-
-        // create storage object (one-column matrix)
-        let sob = make_shared<Matrix<ElemType>>(numElements/*rows*/, 1/*cols*/, init.data(), deviceId);
-
-        // create TensorView
-        return TensorView<ElemType>(sob, shape);
-    }
+    char buf[1024];
+    sprintf(buf, "{\"name\":\"%s\",\"device\":\"%s\",\"seconds\":%.9g,\"gflops\":%.6g,\"gbps\":%.6g,\"iterations\":%d}",
+            r.name.c_str(), r.device.c_str(), r.seconds, r.gflops, r.gbps, (int) r.iterations);
+    return buf;
+}
 
-    // test bias gradient (reduction)
-    static TensorView<ElemType> BiasGradientTest(TensorShape layerShape, TensorShape biasShape, DEVICEID_TYPE deviceId)
+// The fields of one line as written by ToJson(). Not a general JSON parser: names never contain quotes.
+static bool FromJson(const string& line, Result& r)
+{
+    auto field = [&line](const char* key, string& value)
     {
-        int randomSeed = 1;
-        let  gradient = CreateTensor(layerShape, randomSeed++, deviceId);
-        auto bias = CreateTensor(biasShape, randomSeed++, deviceId, true);
-        //gradient.GetSOB().Print("incoming gradient", 0, 9, 0, 9);
-        //bias.GetSOB().Print("bias gradient", 0, 9, 0, 9);
-        bias.DoCopyOf(1, gradient, 1);
-        //bias.GetSOB().Print("updated bias gradient", 0, 9, 0, 9);
-        return bias;
-    }
+        const string pattern = string("\"") + key + "\":";
+        auto pos = line.find(pattern);
+        if (pos == string::npos)
+            return false;
+        pos += pattern.size();
+        if (line[pos] == '"')
+        {
+            auto end = line.find('"', pos + 1);
+            if (end == string::npos)
+                return false;
+            value = line.substr(pos + 1, end - pos - 1);
+        }
+        else
+            value = line.substr(pos, line.find_first_of(",}", pos) - pos);
+        return true;
+    };
+    string seconds;
+    if (!field("name", r.name) || !field("device", r.device) || !field("seconds", seconds))
+        return false;
+    r.seconds = atof(seconds.c_str());
+    return r.seconds > 0;
+}
 
-    // test broadcast summation gradient
-    static TensorView<ElemType> BroadcastingTest(TensorShape layerShape, TensorShape biasShape, DEVICEID_TYPE deviceId)
+static map<string, double> ReadBaseline(const string& path)
+{
+    ifstream file(path);
+    if (!file)
+        RuntimeError("Could not open baseline file '%s'.", path.c_str());
+    map<string, double> baseline;
+    string line;
+    for (size_t lineNo = 1; getline(file, line); lineNo++)
     {
-        int randomSeed = 1;
-        let  input  = CreateTensor(layerShape, randomSeed++, deviceId);
-        auto bias   = CreateTensor(biasShape,  randomSeed++, deviceId);
-        //input.GetSOB().Print("input data", 0, 9, 0, 9);
-        //bias.GetSOB().Print("bias", 0, 9, 0, 9);
-        auto result = CreateTensor(layerShape, randomSeed++, deviceId, true);
-        result.AssignSumOf(input, bias);
-        return result;
+        if (line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        Result r;
+        if (!FromJson(line, r))
+            RuntimeError("%s(%d): Not a benchmark result.", path.c_str(), (int) lineNo);
+        baseline[r.device + ":" + r.name] = r.seconds;
     }
+    return baseline;
+}
 
-    // run one test for both GPU and CPU and verify they are the same
-    template<typename FN>
-    static void OneTensorTest(const char* what, double tolerance, const FN& fn)
+static int Run(const Options& options)
+{
+    vector<pair<string, DEVICEID_TYPE>> devices;
+    if (options.cpu)
+        devices.push_back(make_pair("cpu", CPUDEVICE));
+    if (options.gpu)
+        devices.push_back(make_pair("gpu", 0));
+
+    map<string, double> baseline;
+    if (!options.baselinePath.empty())
+        baseline = ReadBaseline(options.baselinePath);
+
+    ofstream json;
+    if (!options.jsonPath.empty())
     {
-        cout << "===== Tensor test '" << what << "'\n   ";
-
-        // run on GPU and CPU
-        let resultGPU = fn(0);
-        let resultCPU = fn(-1);
-
-        // dump top corner of the result to get a feel for the error
-        resultGPU.GetSOB().Print("GPU result", 0, 7, 0, 9);
-        resultGPU.GetSOB().TransferToDeviceIfNotThere(-1, true, false, true);
-        resultCPU.GetSOB().Print("CPU result", 0, 7, 0, 9);
-
-        // compare
-        let isSame = resultGPU.GetSOB().IsEqualTo(resultCPU.GetSOB(), (ElemType)tolerance);
-        cout << (isSame ? " --> SUCCEEDED. =====\n" : " --> FAILED (GPU and CPU results differ). =====\n") << endl << flush;
-        if (!isSame)
-            sin(1.0);  // set breakpoint here
+        json.open(options.jsonPath);
+        if (!json)
+            RuntimeError("Could not open '%s' for writing.", options.jsonPath.c_str());
     }
 
-    // main entry point (misusing the constructor)
-    /*void*/ TensorTest()
+    size_t numRegressions = 0;
+    for (const auto& device : devices)
     {
-        // --- elementwise
-
-        // elementwise sum
-        OneTensorTest("elementwise addition", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
-        {
-            return BroadcastingTest(TensorShape{ 512, 256 }, TensorShape({ 512, 256 }), deviceId);
-        });
-
-        // --- broadcasting
-
-        // simple broadcasting
-        OneTensorTest("addition wth simple broadcasting", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
-        {
-            return BroadcastingTest(TensorShape{ 3, 2 }, TensorShape({ 3, 1 }), deviceId);
-        });
-        // typical bias for convolutional layer
-        OneTensorTest("bias addition (broadcasting)", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
-        {
-            return BroadcastingTest(TensorShape{ 28, 28, 128, 32 }, TensorShape({ 1, 1, 128 }), deviceId);
-        });
-        // BUGBUG: This test is strange--Print() shows different values with depth 128 instead of 64, but IsEqual() does not fail with 1e-3 tolerance.
-        //         Something fishy going on. Dimension overflow?
-        OneTensorTest("bias addition (broadcasting)", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
-        {
-            return BroadcastingTest(TensorShape{ 256, 256, 64, 32 }, TensorShape({ 1, 1, 64 }), deviceId);
-        });
-
-        // --- reduction
-
-        // typical bias gradient (reduction) for FF-DNN
-        OneTensorTest("bias gradient (reduction)", 1e-4, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
-        {
-            return BiasGradientTest(TensorShape{ 2048, 1024 }, TensorShape(2048), deviceId);
-        });
-        // typical bias gradient (reduction) for convolutional layer
-        OneTensorTest("bias gradient (reduction)", 1e-1, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
+        for (const auto& definition : AllBenchmarks())
         {
-            return BiasGradientTest(TensorShape{ 256, 256, 64, 32 }, TensorShape({ 1, 1, 64 }), deviceId);
-        });
+            if ((device.second == CPUDEVICE ? !definition.cpu : !definition.gpu) ||
+                definition.name.find(options.filter) == string::npos)
+                continue;
+            if (options.list)
+            {
+                cout << device.first << " " << definition.name << endl;
+                continue;
+            }
+
+            Result r;
+            r.name = definition.name;
+            r.device = device.first;
+            try
+            {
+                BenchmarkInstance bm = definition.create(device.second);
+                r.seconds = Measure(bm, options.minTime, r.iterations);
+                r.gflops = bm.flops / r.seconds * 1e-9;
+                r.gbps = bm.bytes / r.seconds * 1e-9;
+            }
+            catch (const exception& e)
+            {
+                fprintf(stderr, "%-4s %-56s skipped: %s\n", r.device.c_str(), r.name.c_str(), e.what());
+                continue;
+            }
+
+            string comparison;
+            auto iter = baseline.find(r.device + ":" + r.name);
+            if (iter != baseline.end())
+            {
+                const double change = r.seconds / iter->second - 1;
+                char buf[64];
+                sprintf(buf, "  %+6.1f%%", 100 * change);
+                comparison = buf;
+                if (change > options.tolerance)
+                {
+                    comparison += "  REGRESSION";
+                    numRegressions++;
+                }
+            }
+            printf("%-4s %-56s %12.3f us %10.2f GFLOP/s %9.2f GB/s%s\n",
+                   r.device.c_str(), r.name.c_str(), r.seconds * 1e6, r.gflops, r.gbps, comparison.c_str());
+            fflush(stdout);
+            if (json.is_open())
+                json << ToJson(r) << endl;
+        }
     }
-};
 
-template <class ElemType>
-void MandSTest(int count, int devId)
-{
-    ElemType* arr = new ElemType[count];
-    for (int i = 0; i < count; ++i)
-        arr[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data1 = new ElemType[1024 * 4096];
-    for (int i = 0; i < 1024 * 4096; ++i)
-        data1[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data2 = new ElemType[1024 * 4096];
-    for (int i = 0; i < 1024 * 4096; ++i)
-        data2[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data3 = new ElemType[1024];
-    for (int i = 0; i < 1024; ++i)
-        data3[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> A(1024, 4096, data1, true, devId);
-    Matrix<ElemType> B(4096, 1024, data2, true, devId);
-    Matrix<ElemType> V(1024, 1, data3, true, devId);
-    Matrix<ElemType> C(1024, 1024, devId);
+    if (!baseline.empty())
+        printf("%d benchmark(s) slower than the baseline by more than %.1f%%.\n", (int) numRegressions, 100 * options.tolerance);
+    return numRegressions == 0 ? 0 : 1;
+}
 
-    auto t_startG = clock();
-    for (int i = 0; i < count; ++i)
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
     {
-        // Matrix<ElemType>::MultiplyAndWeightedAdd(arr[i],A,false,B,false,3.2*arr[i],C);
-        C += (A * arr[i]) * (B * (arr[i] * 2.3));
+        Usage();
+        return 2;
     }
-    auto t_endG = clock();
-    double valM = 1.0 * (t_endG - t_startG) / (CLOCKS_PER_SEC * count);
-    cout << "Matrix C+=alpha*A*beta*B in: " << valM << " seconds" << endl;
-
-    cout << "Testing CPUMatrix" << endl;
-    CPUMatrix<ElemType> AC(1024, 4096, data1, true);
-    CPUMatrix<ElemType> BC(4096, 1024, data2, true);
-    CPUMatrix<ElemType> VC(1024, 1, data3, true);
-    CPUMatrix<ElemType> CC(1024, 1024);
-
-    auto t_startC = clock();
-    for (int i = 0; i < count; ++i)
+    try
     {
-        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(arr[i], AC, false, BC, false, 3.2 * arr[i], CC);
-        // CC+=(arr[i]*AC)*((arr[i]*2.3)*BC);
+        return Run(options);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return 2;
     }
-    auto t_endC = clock();
-    double valMC = 1.0 * (t_endC - t_startC) / (CLOCKS_PER_SEC * count);
-    cout << "CPUMatrix C+=alpha*A*beta*B in: " << valMC << " seconds" << endl;
-
-    delete[] arr;
-    delete[] data1;
-    delete[] data2;
-    delete[] data3;
-}
-
-int wmain()
-{
-    // MandSTest<float>(100, 2);
-
-    /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
-    SquareMultiplyAndAdd10TimesAvgTest<float>(4096,10);
-
-    cout<<endl<<"********************Matrix AddMultiplyAndInplaceSigmoid TEST********************"<<endl;    
-    AddMultiplyAndInplaceSigmoidTest<float>(11,10,12);    
-    AddMultiplyAndInplaceSigmoidTest<float>(110,100,120);    
-    AddMultiplyAndInplaceSigmoidTest<float>(1100,1000,1200);    
-    AddMultiplyAndInplaceSigmoidTest<float>(11000,10000,1200);
-
-    cout<<endl<<"********************Matrix MultiplyAndWeightedAdd TEST********************"<<endl;    
-    MultiplyAndWeightedAddTest<float>(11,10,12);    
-    MultiplyAndWeightedAddTest<float>(110,100,120);    
-    MultiplyAndWeightedAddTest<float>(1100,1000,1200);    
-    MultiplyAndWeightedAddTest<float>(11000,10000,12000);*/
-
-    return 0;
 }
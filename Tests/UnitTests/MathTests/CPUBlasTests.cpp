@@ -0,0 +1,100 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include <cstdlib>
+#include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUBlas.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(CPUBlasSuite)
+
+BOOST_FIXTURE_TEST_CASE(CPUBlasStatisticsRecordGemmShapes, RandomSeedFixture)
+{
+    CPUBlas::ResetStatistics();
+    CPUBlas::EnableStatistics(true);
+
+    CPUSingleMatrix a = CPUSingleMatrix::RandomUniform(3, 5, -1, 1, IncrementCounter());
+    CPUSingleMatrix b = CPUSingleMatrix::RandomUniform(5, 4, -1, 1, IncrementCounter());
+    CPUSingleMatrix c;
+    CPUSingleMatrix::MultiplyAndWeightedAdd(1, a, false, b, false, 0, c);
+    CPUSingleMatrix::MultiplyAndWeightedAdd(1, a, false, b, false, 1, c);
+    CPUDoubleMatrix at = CPUDoubleMatrix::RandomUniform(5, 3, -1, 1, IncrementCounter());
+    CPUDoubleMatrix bd = CPUDoubleMatrix::RandomUniform(5, 4, -1, 1, IncrementCounter());
+    CPUDoubleMatrix cd;
+    CPUDoubleMatrix::MultiplyAndWeightedAdd(1, at, true, bd, false, 0, cd);
+    c.SumOfAbsElements();
+
+    BOOST_CHECK_EQUAL(CPUBlas::GetNumCalls(CPUBlasOp::Gemm), 3);
+    BOOST_CHECK_EQUAL(CPUBlas::GetNumCalls(CPUBlasOp::Asum), 1);
+    BOOST_CHECK_EQUAL(CPUBlas::GetNumGemmCalls(3, 4, 5, false, false, sizeof(float)), 2);
+    BOOST_CHECK_EQUAL(CPUBlas::GetNumGemmCalls(3, 4, 5, true, false, sizeof(double)), 1);
+    BOOST_CHECK_EQUAL(CPUBlas::GetNumGemmCalls(3, 4, 5, false, false, sizeof(double)), 0);
+
+    FILE* f = tmpfile();
+    BOOST_REQUIRE(f != nullptr);
+    CPUBlas::PrintStatistics(f);
+    rewind(f);
+    std::string report;
+    for (int ch; (ch = fgetc(f)) != EOF;)
+        report += (char) ch;
+    fclose(f);
+    BOOST_CHECK(report.find("gemm") != std::string::npos);
+    BOOST_CHECK(report.find("GEMM shapes by total time (2 of 2)") != std::string::npos);
+
+    // nothing is recorded while disabled
+    CPUBlas::EnableStatistics(false);
+    CPUBlas::ResetStatistics();
+    CPUSingleMatrix::MultiplyAndWeightedAdd(1, a, false, b, false, 0, c);
+    BOOST_CHECK_EQUAL(CPUBlas::GetNumCalls(CPUBlasOp::Gemm), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUBlasRejectsLibraryWithoutCBlas, RandomSeedFixture)
+{
+#ifdef _WIN32
+    const std::wstring notCBlas = L"kernel32.dll";
+#else
+    const std::wstring notCBlas = L"libm.so.6";
+#endif
+    const std::wstring backend = CPUBlas::GetBackendName();
+    BOOST_CHECK_THROW(CPUBlas::LoadBackend(notCBlas), std::runtime_error);
+    BOOST_CHECK_THROW(CPUBlas::LoadBackend(L"no-such-blas-library"), std::runtime_error);
+    BOOST_CHECK(CPUBlas::GetBackendName() == backend);
+
+    // still usable
+    CPUSingleMatrix a(2, 2), c;
+    a.SetValue(2);
+    CPUSingleMatrix::MultiplyAndWeightedAdd(1, a, false, a, false, 0, c);
+    BOOST_CHECK_EQUAL(c(1, 0), 8);
+}
+
+// Set CNTK_TEST_CPU_BLAS_LIBRARY to the path of a CBLAS library (e.g. libopenblas.so.0) to check it against the linked one.
+BOOST_FIXTURE_TEST_CASE(CPUBlasLoadedLibraryMatchesLinked, RandomSeedFixture)
+{
+    const char* path = getenv("CNTK_TEST_CPU_BLAS_LIBRARY");
+    if (path == nullptr || *path == 0)
+        return;
+
+    CPUSingleMatrix a = CPUSingleMatrix::RandomUniform(37, 20, -1, 1, IncrementCounter());
+    CPUSingleMatrix b = CPUSingleMatrix::RandomUniform(37, 11, -1, 1, IncrementCounter());
+    CPUSingleMatrix expected, actual;
+    CPUSingleMatrix::MultiplyAndWeightedAdd(1, a, true, b, false, 0, expected);
+    const float expectedNorm = expected.FrobeniusNorm();
+
+    CPUBlas::LoadBackend(msra::strfun::utf16(path));
+    BOOST_TEST_MESSAGE("CPU BLAS backend: " << msra::strfun::utf8(CPUBlas::GetBackendName()));
+    CPUSingleMatrix::MultiplyAndWeightedAdd(1, a, true, b, false, 0, actual);
+    const float actualNorm = actual.FrobeniusNorm();
+    CPUBlas::LoadBackend(L"");
+
+    BOOST_CHECK(actual.IsEqualTo(expected, 1e-5f));
+    BOOST_CHECK_CLOSE(actualNorm, expectedNorm, 1e-3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
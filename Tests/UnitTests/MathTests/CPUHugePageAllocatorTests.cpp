@@ -0,0 +1,112 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUHugePageAllocator.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// turns huge pages on for a test, and drops the blocks it cached afterwards
+struct HugePagesFixture
+{
+    HugePagesFixture()
+    {
+        CPUHugePageAllocator::SetMode(CPUHugePageAllocator::Mode::transparent);
+    }
+    ~HugePagesFixture()
+    {
+        CPUHugePageAllocator::SetMode(CPUHugePageAllocator::Mode::none);
+        CPUHugePageAllocator::Trim();
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(CPUHugePageAllocatorSuite)
+
+BOOST_AUTO_TEST_CASE(CPUHugePageAllocatorSizeClass)
+{
+    const size_t page = CPUHugePageAllocator::s_pageSize;
+    BOOST_CHECK_EQUAL(CPUHugePageAllocator::SizeClass(1), page);
+    BOOST_CHECK_EQUAL(CPUHugePageAllocator::SizeClass(page), page);
+    BOOST_CHECK_EQUAL(CPUHugePageAllocator::SizeClass(page + 1), 2 * page);
+    BOOST_CHECK_EQUAL(CPUHugePageAllocator::SizeClass(5 * page), 5 * page);
+    // above 8 pages, a quarter of a power of two apart
+    BOOST_CHECK_EQUAL(CPUHugePageAllocator::SizeClass(16 * page + 1), 20 * page);
+}
+
+BOOST_AUTO_TEST_CASE(CPUHugePageAllocatorOff)
+{
+    BOOST_CHECK(CPUHugePageAllocator::GetMode() == CPUHugePageAllocator::Mode::none);
+    BOOST_CHECK(CPUHugePageAllocator::Alloc(4 * CPUHugePageAllocator::s_pageSize) == nullptr);
+
+    int onHeap = 0;
+    BOOST_CHECK(!CPUHugePageAllocator::Free(&onHeap));
+    BOOST_CHECK(!CPUHugePageAllocator::Free(nullptr));
+}
+
+#ifndef _WIN32
+
+BOOST_FIXTURE_TEST_CASE(CPUHugePageAllocatorReuse, HugePagesFixture)
+{
+    const size_t page = CPUHugePageAllocator::s_pageSize;
+    BOOST_CHECK(CPUHugePageAllocator::Alloc(page / 2) == nullptr); // below the threshold
+
+    const auto before = CPUHugePageAllocator::GetStatistics();
+    char* p = (char*) CPUHugePageAllocator::Alloc(3 * page);
+    BOOST_REQUIRE(p != nullptr);
+    BOOST_CHECK_EQUAL((size_t) p % page, 0);
+    BOOST_CHECK(std::all_of(p, p + 3 * page, [](char c) { return c == 0; }));
+    memset(p, 1, 3 * page);
+
+    int onHeap = 0;
+    BOOST_CHECK(!CPUHugePageAllocator::Free(&onHeap));
+    BOOST_CHECK(CPUHugePageAllocator::Free(p));
+
+    // same size class: the block comes back from the cache, zeroed again
+    char* q = (char*) CPUHugePageAllocator::Alloc(3 * page - 100);
+    BOOST_CHECK(q == p);
+    BOOST_CHECK(std::all_of(q, q + 3 * page - 100, [](char c) { return c == 0; }));
+
+    auto statistics = CPUHugePageAllocator::GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.numAllocations - before.numAllocations, 1);
+    BOOST_CHECK_EQUAL(statistics.numReuses - before.numReuses, 1);
+    BOOST_CHECK_EQUAL(statistics.bytesInUse - before.bytesInUse, 3 * page);
+
+    BOOST_CHECK(CPUHugePageAllocator::Free(q));
+    CPUHugePageAllocator::Trim();
+    statistics = CPUHugePageAllocator::GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.bytesCached, 0);
+    BOOST_CHECK_EQUAL(statistics.bytesInUse, before.bytesInUse);
+    BOOST_CHECK_EQUAL(statistics.numReleases - before.numReleases, 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUHugePageAllocatorMatrixResize, HugePagesFixture)
+{
+    const size_t numRows = 1024, numCols = 2 * CPUHugePageAllocator::s_pageSize / (numRows * sizeof(float));
+    const auto before = CPUHugePageAllocator::GetStatistics();
+    {
+        CPUSingleMatrix m(numRows, numCols);
+        m.SetValue(1);
+        // shrinking and growing back hands the same block out again instead of mapping a new one
+        m.Resize(numRows, numCols / 2, /*growOnly=*/false);
+        m.Resize(numRows, numCols, /*growOnly=*/false);
+        BOOST_CHECK(std::all_of(m.Data(), m.Data() + m.GetNumElements(), [](float v) { return v == 0; }));
+
+        CPUSingleMatrix small(10, 10); // from the heap
+        small.SetValue(2);
+        BOOST_CHECK_EQUAL(small(9, 9), 2);
+    }
+    const auto statistics = CPUHugePageAllocator::GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.bytesInUse, before.bytesInUse);
+    BOOST_CHECK_GE(statistics.numReuses - before.numReuses, 1);
+    BOOST_CHECK_LE(statistics.numAllocations - before.numAllocations, 2);
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
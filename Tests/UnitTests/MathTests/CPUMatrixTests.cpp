@@ -3,7 +3,9 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 #include "stdafx.h"
+#include <limits>
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUVectorizedTensorOps.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -985,6 +987,147 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixOneHot, RandomSeedFixture)
     BOOST_CHECK(dirty_m.IsEqualTo(dirtyExpect, 1e-6));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSoftmaxCrossEntropy, RandomSeedFixture)
+{
+    // odd sizes for the vector tails; the last column is a gap, with zero labels and NaN predictions
+    const size_t dim = 1001, numCols = 9, gap = numCols - 1;
+    SMatrix input = SMatrix::RandomUniform(dim, numCols, -5, 5, IncrementCounter());
+    SMatrix labels = SMatrix::RandomUniform(dim, numCols, 0, 1, IncrementCounter());
+    foreach_row (i, input)
+    {
+        input(i, gap) = std::numeric_limits<float>::quiet_NaN();
+        labels(i, gap) = 0;
+    }
+
+    // reference: log softmax, then the inner product with the labels
+    SMatrix logSoftmax;
+    logSoftmax.AssignLogSoftmaxOf(input, true);
+    double expectedCrossEntropy = 0;
+    for (size_t j = 0; j < gap; j++)
+        foreach_row (i, input)
+            expectedCrossEntropy -= labels(i, j) * logSoftmax(i, j);
+
+    SMatrix gradient(1, 1);
+    gradient(0, 0) = 0.5f;
+    for (auto isa : { CPUVectorISA::None, CPUVectorISA::AVX512 })
+    {
+        CPUVectorizedTensorOps::SetMaxISA(isa);
+
+        SMatrix crossEntropy, logSumExp;
+        crossEntropy.AssignSoftmaxCrossEntropyOf(labels, input, logSumExp);
+        BOOST_CHECK_EQUAL(logSumExp.GetNumRows(), 1);
+        BOOST_CHECK_EQUAL(logSumExp.GetNumCols(), numCols);
+        BOOST_CHECK_CLOSE(crossEntropy(0, 0), expectedCrossEntropy, 1e-3);
+
+        SMatrix inputGradient(dim, numCols), labelsGradient(dim, numCols);
+        inputGradient.SetValue(1);
+        labelsGradient.SetValue(0);
+        SMatrix::AddSoftmaxCrossEntropyGradient(gradient, labels, input, logSumExp, inputGradient);
+        SMatrix::AddSoftmaxCrossEntropyLabelGradient(gradient, input, logSumExp, labelsGradient);
+        size_t numMismatches = 0;
+        for (size_t j = 0; j < gap; j++)
+        {
+            foreach_row (i, input)
+            {
+                numMismatches += fabs(inputGradient(i, j) - (1 + 0.5f * (exp(logSoftmax(i, j)) - labels(i, j)))) > 1e-5f;
+                numMismatches += fabs(labelsGradient(i, j) + 0.5f * logSoftmax(i, j)) > 1e-4f;
+            }
+        }
+        BOOST_CHECK_EQUAL(numMismatches, 0);
+    }
+    CPUVectorizedTensorOps::SetMaxISA(CPUVectorISA::AVX512);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpContiguousInner, RandomSeedFixture)
+{
+    // [n x m x p] with a contiguous inner dimension, large enough for the outer loop to be distributed over the threads
+    const size_t n = 40, m = 30, p = 50;
+    DMatrix a = DMatrix::RandomUniform(n, m * p, -1, 1, IncrementCounter());
+    DMatrix bias = DMatrix::RandomUniform(n, p, -1, 1, IncrementCounter()); // [n x 1 x p], broadcast along m
+    DMatrix c = DMatrix::RandomUniform(n, m * p, -1, 1, IncrementCounter());
+    DMatrix expected(c);
+
+    const SmallVector<size_t> dims{ n, m, p };
+    const SmallVector<ptrdiff_t> dense{ 1, (ptrdiff_t) n, (ptrdiff_t) (n * m) };
+    const SmallVector<ptrdiff_t> broadcast{ 1, 0, (ptrdiff_t) n };
+    const SmallVector<size_t> noReduction;
+
+    // c = 0.5 c + 2 (a + bias)
+    c.TensorOp(0.5, a, bias, 2, ElementWiseOperator::opSum, ElementWiseOperator::opSum, array<size_t, 3>{ 0, 0, 0 },
+               dims, array<SmallVector<ptrdiff_t>, 3>{ dense, broadcast, dense }, noReduction, array<SmallVector<ptrdiff_t>, 3>());
+    for (size_t k = 0; k < p; k++)
+        for (size_t j = 0; j < m; j++)
+            for (size_t i = 0; i < n; i++)
+                expected(i, k * m + j) = 0.5 * expected(i, k * m + j) + 2 * (a(i, k * m + j) + bias(i, k));
+    BOOST_CHECK(c.IsEqualTo(expected, 1e-12));
+
+    // ternary: c = Clip(-|bias|, |bias|)(a)
+    DMatrix lower(n, p), upper(n, p);
+    for (size_t k = 0; k < p; k++)
+        for (size_t i = 0; i < n; i++)
+        {
+            upper(i, k) = fabs(bias(i, k));
+            lower(i, k) = -upper(i, k);
+        }
+    c.TensorOp(0, lower, upper, a, 1, ElementWiseOperator::opClip, ElementWiseOperator::opSum, array<size_t, 4>{ 0, 0, 0, 0 },
+               dims, array<SmallVector<ptrdiff_t>, 4>{ broadcast, broadcast, dense, dense }, noReduction, array<SmallVector<ptrdiff_t>, 4>());
+    for (size_t k = 0; k < p; k++)
+        for (size_t j = 0; j < m; j++)
+            for (size_t i = 0; i < n; i++)
+                expected(i, k * m + j) = std::min(std::max(a(i, k * m + j), lower(i, k)), upper(i, k));
+    BOOST_CHECK(c.IsEqualTo(expected, 1e-12));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixROIPooling, RandomSeedFixture)
+{
+    const size_t width = 8, height = 6, channels = 3, numImg = 2, numRois = 4, pooledWidth = 3, pooledHeight = 2;
+    const size_t imageSize = width * height * channels;
+    const size_t roiOutputSize = pooledWidth * pooledHeight * channels;
+    DMatrix images = DMatrix::RandomUniform(imageSize, numImg, -1, 1, IncrementCounter());
+
+    // (x, y, w, h) relative to the image; the first two ROIs are the same, so they choose the same maxima
+    const double rois[numRois][4] = { { 0.25, 0.0, 0.5, 0.5 }, { 0.25, 0.0, 0.5, 0.5 }, { 0, 0, 1, 1 }, { 0.5, 0.5, 0.5, 0.5 } };
+    DMatrix roiData(4 * numRois, numImg);
+    for (size_t n = 0; n < numImg; n++)
+        for (size_t r = 0; r < numRois; r++)
+            for (size_t i = 0; i < 4; i++)
+                roiData(r * 4 + i, n) = rois[r][i];
+
+    DMatrix output(roiOutputSize * numRois, numImg), argmax(roiOutputSize * numRois, numImg);
+    images.ROIPoolingForward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, roiData, output, argmax);
+
+    DMatrix pooledGrad = DMatrix::RandomUniform(roiOutputSize * numRois, numImg, -1, 1, IncrementCounter());
+    DMatrix expectedGrad(imageSize, numImg);
+    expectedGrad.SetValue(0);
+    for (size_t n = 0; n < numImg; n++)
+    {
+        for (size_t i = 0; i < roiOutputSize * numRois; i++)
+        {
+            // argmax is relative to the channel of the output location
+            size_t c = (i / (pooledWidth * pooledHeight)) % channels;
+            size_t inputIndex = c * width * height + (size_t) argmax(i, n);
+            BOOST_CHECK_EQUAL(output(i, n), images(inputIndex, n));
+            expectedGrad(inputIndex, n) += pooledGrad(i, n);
+        }
+        // the whole image is the third ROI, so its maximum is one of the outputs
+        for (size_t c = 0; c < channels; c++)
+        {
+            double maxval = -1;
+            for (size_t i = 0; i < width * height; i++)
+                maxval = std::max(maxval, images(c * width * height + i, n));
+            double maxOutput = -1;
+            for (size_t i = 0; i < pooledWidth * pooledHeight; i++)
+                maxOutput = std::max(maxOutput, output((2 * channels + c) * pooledWidth * pooledHeight + i, n));
+            BOOST_CHECK_EQUAL(maxOutput, maxval);
+        }
+    }
+
+    DMatrix grad(imageSize, numImg);
+    grad.SetValue(1); // overwritten
+    pooledGrad.ROIPoolingBackward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, roiData, grad, argmax);
+    BOOST_CHECK(grad.IsEqualTo(expectedGrad, 1e-12));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
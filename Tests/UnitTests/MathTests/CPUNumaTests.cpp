@@ -0,0 +1,54 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUNuma.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(CPUNumaSuite)
+
+BOOST_AUTO_TEST_CASE(CPUNumaParseList)
+{
+    BOOST_CHECK(CPUNuma::ParseList("0-3,8,10-11\n") == std::vector<int>({ 0, 1, 2, 3, 8, 10, 11 }));
+    BOOST_CHECK(CPUNuma::ParseList("5") == std::vector<int>({ 5 }));
+    BOOST_CHECK(CPUNuma::ParseList("").empty());
+    BOOST_CHECK_THROW(CPUNuma::ParseList("4-2"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(CPUNumaTopology)
+{
+    BOOST_CHECK_GE(CPUNuma::GetNumNodes(), 1);
+    BOOST_CHECK_LT(CPUNuma::GetCurrentNode(), CPUNuma::GetNumNodes());
+    BOOST_CHECK_THROW(CPUNuma::BindToNode(CPUNuma::GetNumNodes()), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(CPUNumaFirstTouchZero)
+{
+    // not a multiple of the page size, and not page-aligned
+    std::vector<char> buffer(3 * 4096 + 100, 1);
+    CPUNuma::FirstTouchZero(buffer.data() + 7, buffer.size() - 8);
+    BOOST_CHECK_EQUAL(buffer.front(), 1);
+    BOOST_CHECK_EQUAL(buffer.back(), 1);
+    BOOST_CHECK(std::all_of(buffer.begin() + 7, buffer.end() - 1, [](char c) { return c == 0; }));
+}
+
+BOOST_AUTO_TEST_CASE(CPUNumaModeMatricesStartAtZero)
+{
+    CPUNuma::EnableNumaMode(true);
+    // large enough to be zeroed by all threads
+    const size_t numRows = 1024, numCols = CPUNuma::s_firstTouchMinBytes / (numRows * sizeof(float)) + 3;
+    CPUSingleMatrix m(numRows, numCols);
+    CPUNuma::EnableNumaMode(false);
+
+    const float* data = m.Data();
+    BOOST_CHECK(std::all_of(data, data + m.GetNumElements(), [](float v) { return v == 0; }));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -0,0 +1,179 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Compares the CPU OptimizedRNNStack forward pass against a per-sequence evaluation of the same cuDNN parameter blob.
+//
+#include "stdafx.h"
+#include <random>
+#include <numeric>
+#include <cwchar>
+#include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/RNNCommon.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static double Sigmoid(double x)
+{
+    return 1 / (1 + exp(-x));
+}
+
+// Runs one sequence x [xDim x T] through the stack, one time step and one unit at a time. Returns [yDim x T].
+static std::vector<double> ReferenceRNNForward(const std::vector<float>& params, const std::vector<double>& x, size_t T, size_t xDim, const RnnAttributes& attributes)
+{
+    const size_t H = attributes.m_hiddenSize;
+    const size_t D = attributes.m_bidirectional ? 2 : 1;
+    const size_t G = attributes.m_recurrentOp == L"lstm" ? 4 : attributes.m_recurrentOp == L"gru" ? 3 : 1;
+
+    // all weight matrices first, then all biases
+    size_t biasOffset = 0;
+    for (size_t layer = 0; layer < attributes.m_numLayers; layer++)
+        biasOffset += D * G * H * ((layer == 0 ? xDim : D * H) + H);
+    size_t weightOffset = 0;
+
+    std::vector<double> in = x;
+    size_t inDim = xDim;
+    for (size_t layer = 0; layer < attributes.m_numLayers; layer++)
+    {
+        std::vector<double> out(D * H * T);
+        for (size_t d = 0; d < D; d++)
+        {
+            const float* W = params.data() + weightOffset; // W(gate g, unit u, input i) at (g * H + u) * inDim + i
+            const float* R = W + G * H * inDim;             // R(gate g, unit u, hidden v) at (g * H + u) * H + v
+            const float* bW = params.data() + biasOffset;
+            const float* bR = bW + G * H;
+            weightOffset += G * H * (inDim + H);
+            biasOffset += 2 * G * H;
+
+            std::vector<double> h(H, 0), c(H, 0);
+            for (size_t step = 0; step < T; step++)
+            {
+                const size_t t = d == 1 ? T - 1 - step : step;
+                std::vector<double> wx(G * H), rh(G * H);
+                for (size_t k = 0; k < G * H; k++)
+                {
+                    wx[k] = bW[k];
+                    rh[k] = bR[k];
+                    for (size_t i = 0; i < inDim; i++)
+                        wx[k] += W[k * inDim + i] * in[t * inDim + i];
+                    for (size_t v = 0; v < H; v++)
+                        rh[k] += R[k * H + v] * h[v];
+                }
+                for (size_t u = 0; u < H; u++)
+                {
+                    if (G == 4) // i, f, c', o
+                    {
+                        c[u] = Sigmoid(wx[H + u] + rh[H + u]) * c[u] + Sigmoid(wx[u] + rh[u]) * tanh(wx[2 * H + u] + rh[2 * H + u]);
+                        h[u] = Sigmoid(wx[3 * H + u] + rh[3 * H + u]) * tanh(c[u]);
+                    }
+                    else if (G == 3) // r, z, h'
+                    {
+                        double r = Sigmoid(wx[u] + rh[u]);
+                        double z = Sigmoid(wx[H + u] + rh[H + u]);
+                        double hh = tanh(wx[2 * H + u] + r * rh[2 * H + u]);
+                        h[u] = (1 - z) * hh + z * h[u];
+                    }
+                    else
+                        h[u] = attributes.m_recurrentOp == L"rnnReLU" ? std::max(0.0, wx[u] + rh[u]) : tanh(wx[u] + rh[u]);
+                }
+                for (size_t u = 0; u < H; u++)
+                    out[t * D * H + d * H + u] = h[u];
+            }
+        }
+        in = out;
+        inDim = D * H;
+    }
+    return in;
+}
+
+BOOST_AUTO_TEST_SUITE(CPURNNExecutorSuite)
+
+BOOST_AUTO_TEST_CASE(CPURNNForwardMatchesReference)
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+
+    const size_t xDim = 5, hiddenSize = 7;
+    // sorted by decreasing length, as OptimizedRNNStackNode packs them
+    const std::vector<size_t> sequenceLengths = { 6, 6, 4, 1 };
+    const size_t numFrames = sequenceLengths[0];
+    std::vector<size_t> numSequencesForFrame(numFrames, 0);
+    for (size_t t = 0; t < numFrames; t++)
+        for (size_t len : sequenceLengths)
+            numSequencesForFrame[t] += len > t ? 1 : 0;
+    const size_t numCols = std::accumulate(sequenceLengths.begin(), sequenceLengths.end(), (size_t)0);
+
+    for (const wchar_t* op : { L"lstm", L"gru", L"rnnTanh", L"rnnReLU" })
+    {
+        for (bool bidirectional : { false, true })
+        {
+            for (size_t numLayers : { 1, 3 })
+            {
+                RnnAttributes attributes(bidirectional, numLayers, hiddenSize, op, -1);
+                const size_t yDim = (bidirectional ? 2 : 1) * hiddenSize;
+                const auto numParameters = attributes.GetNumParameters(xDim);
+                std::vector<float> params(numParameters.first * numParameters.second);
+                for (auto& p : params)
+                    p = dist(rng);
+
+                // packed input: frame t is a block of numSequencesForFrame[t] columns
+                std::vector<std::vector<double>> sequences(sequenceLengths.size());
+                std::vector<float> packed(xDim * numCols);
+                for (size_t s = 0; s < sequences.size(); s++)
+                {
+                    sequences[s].resize(xDim * sequenceLengths[s]);
+                    for (auto& v : sequences[s])
+                        v = 4 * dist(rng);
+                }
+                for (size_t t = 0, col = 0; t < numFrames; t++)
+                    for (size_t s = 0; s < numSequencesForFrame[t]; s++, col++)
+                        for (size_t i = 0; i < xDim; i++)
+                            packed[col * xDim + i] = (float)sequences[s][t * xDim + i];
+
+                Matrix<float> paramW(numParameters.first, numParameters.second, params.data(), CPUDEVICE);
+                Matrix<float> inputX(xDim, numCols, packed.data(), CPUDEVICE);
+                Matrix<float> outputY(yDim, numCols, CPUDEVICE);
+                Matrix<float> reserve(CPUDEVICE), workspace(CPUDEVICE);
+                for (int pass = 0; pass < 2; pass++) // the second pass reuses the executor and workspace
+                {
+                    outputY.SetValue(std::numeric_limits<float>::quiet_NaN());
+                    outputY.RNNForward(inputX, paramW, xDim, yDim, numSequencesForFrame, attributes, reserve, workspace);
+
+                    std::unique_ptr<float[]> result(outputY.CopyToArray());
+                    double maxError = 0;
+                    for (size_t s = 0; s < sequences.size(); s++)
+                    {
+                        auto expected = ReferenceRNNForward(params, sequences[s], sequenceLengths[s], xDim, attributes);
+                        for (size_t t = 0; t < sequenceLengths[s]; t++)
+                        {
+                            size_t col = std::accumulate(numSequencesForFrame.begin(), numSequencesForFrame.begin() + t, (size_t)0) + s;
+                            for (size_t u = 0; u < yDim; u++)
+                            {
+                                double error = std::abs(result[col * yDim + u] - expected[t * yDim + u]);
+                                if (!(error <= maxError)) // also catches NaNs
+                                    maxError = error;
+                            }
+                        }
+                    }
+                    BOOST_CHECK_MESSAGE(maxError < 1e-5, "recurrentOp: " << std::string(op, op + wcslen(op)) << ", bidirectional: " << bidirectional
+                                                                         << ", numLayers: " << numLayers << ", max error: " << maxError);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CPURNNForwardRejectsWrongParameterCount)
+{
+    RnnAttributes attributes(false, 1, 4, L"lstm", -1);
+    const auto numParameters = attributes.GetNumParameters(3);
+    Matrix<float> paramW(numParameters.first, numParameters.second - 1, CPUDEVICE);
+    Matrix<float> inputX(3, 2, CPUDEVICE), outputY(4, 2, CPUDEVICE), reserve(CPUDEVICE), workspace(CPUDEVICE);
+    BOOST_CHECK_THROW(outputY.RNNForward(inputX, paramW, 3, 4, std::vector<size_t>{ 1, 1 }, attributes, reserve, workspace), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
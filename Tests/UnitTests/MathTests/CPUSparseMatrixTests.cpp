@@ -195,6 +195,187 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixOneHot, RandomSeedFixture)
     BOOST_CHECK(sm3(4, 3) == 1);
 }
 
+// random dense matrix with about the given fraction of nonzeros
+static DenseMatrix CreateSparseDense(size_t m, size_t n, double density, unsigned long seed)
+{
+    DenseMatrix dm(m, n);
+    dm.SetUniformRandomValue(-1, 1, seed);
+    DenseMatrix mask(m, n);
+    mask.SetUniformRandomValue(0, 1, seed + 1);
+    foreach_coord (row, col, dm)
+    {
+        if (mask(row, col) > density)
+            dm(row, col) = 0;
+    }
+    return dm;
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixSetValueFromDense, RandomSeedFixture)
+{
+    DenseMatrix dm = CreateSparseDense(300, 200, 0.1, IncrementCounter());
+
+    SparseMatrix smCSC(MatrixFormat::matrixFormatSparseCSC);
+    smCSC.SetValue(dm);
+    SparseMatrix smReference(MatrixFormat::matrixFormatSparseCSC, dm.GetNumRows(), dm.GetNumCols(), 0);
+    foreach_coord (row, col, dm)
+    {
+        if (dm(row, col) != 0)
+            smReference.SetValue(row, col, dm(row, col));
+    }
+    BOOST_CHECK_EQUAL(smCSC.NzCount(), smReference.NzCount());
+    BOOST_CHECK(smCSC.CopyColumnSliceToDense(0, dm.GetNumCols()).IsEqualTo(dm, 0));
+
+    SparseMatrix smCSR(MatrixFormat::matrixFormatSparseCSR);
+    smCSR.SetValue(dm);
+    BOOST_CHECK_EQUAL(smCSR.NzCount(), smReference.NzCount());
+    DenseMatrix dmFromCSR(dm.GetNumRows(), dm.GetNumCols());
+    dmFromCSR.SetValue(0);
+    SparseMatrix::ScaleAndAdd(1, smCSR, dmFromCSR);
+    BOOST_CHECK(dmFromCSR.IsEqualTo(dm, 0));
+}
+
+// Products large enough for the multithreaded paths: parallel over sparse columns, over blocks of the dense outer
+// dimension (outer = 64), and with per-thread buffers when that dimension is too small to be split (outer = 2).
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAddMultithreaded, RandomSeedFixture)
+{
+    const int numThreadsBefore = DenseMatrix::GetMaxNumThreads();
+    DenseMatrix::SetNumThreads(4);
+
+    const size_t k = 1000, n = 300;
+    const double alpha = 0.5, beta = 2;
+    for (size_t outer : { 2, 64 })
+    {
+        for (bool transposeA : { false, true })
+        {
+            for (bool transposeB : { false, true })
+            {
+                // dense * sparse = [outer x n]
+                DenseMatrix dense = CreateSparseDense(transposeA ? k : outer, transposeA ? outer : k, 1, IncrementCounter());
+                DenseMatrix sparseAsDense = CreateSparseDense(transposeB ? n : k, transposeB ? k : n, 0.25, IncrementCounter());
+                SparseMatrix sparse(MatrixFormat::matrixFormatSparseCSC);
+                sparse.SetValue(sparseAsDense);
+
+                DenseMatrix expected = CreateSparseDense(outer, n, 1, IncrementCounter());
+                DenseMatrix actual(expected);
+                DenseMatrix::MultiplyAndWeightedAdd(alpha, dense, transposeA, sparseAsDense, transposeB, beta, expected);
+                SparseMatrix::MultiplyAndWeightedAdd(alpha, dense, transposeA, sparse, transposeB, beta, actual);
+                BOOST_CHECK(actual.IsEqualTo(expected, c_epsilonFloatE4));
+
+                // sparse * dense = [n x outer], reusing the operands
+                DenseMatrix denseRhs = CreateSparseDense(transposeB ? outer : k, transposeB ? k : outer, 1, IncrementCounter());
+                DenseMatrix sparseLhsAsDense = CreateSparseDense(transposeA ? k : n, transposeA ? n : k, 0.25, IncrementCounter());
+                SparseMatrix sparseLhs(MatrixFormat::matrixFormatSparseCSC);
+                sparseLhs.SetValue(sparseLhsAsDense);
+
+                DenseMatrix expected2 = CreateSparseDense(n, outer, 1, IncrementCounter());
+                DenseMatrix actual2(expected2);
+                DenseMatrix::MultiplyAndWeightedAdd(alpha, sparseLhsAsDense, transposeA, denseRhs, transposeB, beta, expected2);
+                SparseMatrix::MultiplyAndWeightedAdd(alpha, sparseLhs, transposeA, denseRhs, transposeB, beta, actual2);
+                BOOST_CHECK(actual2.IsEqualTo(expected2, c_epsilonFloatE4));
+            }
+        }
+    }
+
+    DenseMatrix::SetNumThreads(numThreadsBefore);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixTimesDenseWithZeros, RandomSeedFixture)
+{
+    // pruned weights times activations of which half are zero, in one and in several threads
+    const int numThreadsBefore = DenseMatrix::GetMaxNumThreads();
+    const size_t m = 200, k = 300;
+    for (int numThreads : { 1, 4 })
+    {
+        DenseMatrix::SetNumThreads(numThreads);
+        for (size_t n : { 1, 2, 64 })
+        {
+            DenseMatrix weightsAsDense = CreateSparseDense(m, k, 0.1, IncrementCounter());
+            SparseMatrix weights(MatrixFormat::matrixFormatSparseCSC);
+            weights.SetValue(weightsAsDense);
+            DenseMatrix activations = CreateSparseDense(k, n + 1, 0.5, IncrementCounter());
+            DenseMatrix activationsSlice = activations.ColumnSlice(1, n);
+
+            DenseMatrix expected(m, n);
+            DenseMatrix actual(m, n);
+            DenseMatrix::MultiplyAndWeightedAdd(1, weightsAsDense, false, activationsSlice, false, 0, expected);
+            SparseMatrix::MultiplyAndWeightedAdd(1, weights, false, activationsSlice, false, 0, actual);
+            BOOST_CHECK(actual.IsEqualTo(expected, c_epsilonFloatE4));
+        }
+    }
+    DenseMatrix::SetNumThreads(numThreadsBefore);
+}
+
+static DenseMatrix BlockColToDense(const SparseMatrix& sm)
+{
+    DenseMatrix dm(sm.GetNumRows(), sm.GetNumCols());
+    dm.SetValue(0);
+    SparseMatrix::ScaleAndAdd(1, sm, dm);
+    return dm;
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixBlockColArithmetic, RandomSeedFixture)
+{
+    const size_t m = 5, n = 7;
+    DenseMatrix values = DenseMatrix::RandomUniform(m, 3, -1, 1, IncrementCounter());
+
+    // a has columns 1 and 4, b has columns 4, 6 and 0
+    const size_t aBlockIds[] = { 1, 4 };
+    const size_t bBlockIds[] = { 4, 6, 0 };
+    SparseMatrix a(MatrixFormat::matrixFormatSparseBlockCol);
+    a.SetMatrixFromSBCFormat(aBlockIds, values.Data(), 2, m, n);
+    SparseMatrix b(MatrixFormat::matrixFormatSparseBlockCol);
+    b.SetMatrixFromSBCFormat(bBlockIds, values.Data(), 3, m, n);
+    DenseMatrix da = BlockColToDense(a);
+    DenseMatrix db = BlockColToDense(b);
+
+    DenseMatrix expected(da);
+    DenseMatrix::Scale(2, expected);
+    DenseMatrix::ScaleAndAdd(-1, db, expected);
+    SparseMatrix c(MatrixFormat::matrixFormatSparseBlockCol);
+    SparseMatrix::ScaleAndAdd(2, a, -1, b, c);
+    BOOST_CHECK_EQUAL(c.GetBlockSize(), 4);
+    BOOST_CHECK_EQUAL(c.NzCount(), 4 * m);
+    BOOST_CHECK(BlockColToDense(c).IsEqualTo(expected, c_epsilonFloatE4));
+
+    // in place, as when accumulating gradients
+    SparseMatrix::ScaleAndAdd(2, a, -1, b, b);
+    BOOST_CHECK(BlockColToDense(b).IsEqualTo(expected, c_epsilonFloatE4));
+
+    BOOST_CHECK(abs(c.FrobeniusNorm() - expected.FrobeniusNorm()) < c_epsilonFloatE4);
+    BOOST_CHECK(abs(c.MatrixNormInf() - expected.MatrixNormInf()) < c_epsilonFloatE4);
+
+    SparseMatrix::Scale(0.5, c);
+    DenseMatrix::Scale(0.5, expected);
+    BOOST_CHECK(BlockColToDense(c).IsEqualTo(expected, c_epsilonFloatE4));
+
+    DenseMatrix weights = DenseMatrix::RandomUniform(m, n, -1, 1, IncrementCounter());
+    c.ElementMultiplyWith(weights);
+    expected.ElementMultiplyWith(weights);
+    BOOST_CHECK(BlockColToDense(c).IsEqualTo(expected, c_epsilonFloatE4));
+    BOOST_CHECK_EQUAL(c.GetBlockSize(), 4);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixBlockColRmsProp, RandomSeedFixture)
+{
+    const size_t m = 5, n = 7;
+    DenseMatrix values = DenseMatrix::RandomUniform(m, 2, -1, 1, IncrementCounter());
+    const size_t blockIds[] = { 2, 5 };
+
+    DenseMatrix smoothedDense, smoothedSparse;
+    for (int step = 0; step < 3; step++)
+    {
+        SparseMatrix gradient(MatrixFormat::matrixFormatSparseBlockCol);
+        gradient.SetMatrixFromSBCFormat(blockIds, values.Data(), 2, m, n);
+        DenseMatrix denseGradient = BlockColToDense(gradient);
+
+        double expected = smoothedDense.RmsProp(denseGradient, 0.99, 1.2, 10, 0.75, 0.1, true);
+        double actual = gradient.RmsProp(smoothedSparse, 0.99, 1.2, 10, 0.75, 0.1, true);
+        BOOST_CHECK(abs(actual - expected) < c_epsilonFloatE4);
+        BOOST_CHECK(BlockColToDense(gradient).IsEqualTo(denseGradient, c_epsilonFloatE4));
+        BOOST_CHECK(smoothedSparse.IsEqualTo(smoothedDense, c_epsilonFloatE4));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -0,0 +1,99 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Compares the vectorized CPU tensor kernels against the generic CPU loops.
+//
+#include "stdafx.h"
+#include <random>
+#include "TensorView.h"
+#include "../../../Source/Math/CPUVectorizedTensorOps.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// restores the instruction set cap when a test ends
+struct VectorizedTensorOpsFixture
+{
+    ~VectorizedTensorOpsFixture()
+    {
+        CPUVectorizedTensorOps::SetMaxISA(CPUVectorISA::AVX512);
+    }
+
+    static TensorView<float> CreateTensor(const TensorShape& shape, int seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> dist(-2.0f, 2.0f);
+        std::vector<float> init(shape.GetNumElements());
+        for (auto& v : init)
+            v = dist(rng);
+        auto sob = std::make_shared<Matrix<float>>(init.size(), 1, init.data(), CPUDEVICE);
+        return TensorView<float>(sob, shape);
+    }
+
+    // run fn once with the vectorized kernels disabled and once with the best instruction set, and compare
+    template <class FN>
+    static void Compare(const char* what, const TensorShape& outShape, float tolerance, const FN& fn)
+    {
+        if (CPUVectorizedTensorOps::GetSupportedISA() == CPUVectorISA::None)
+        {
+            BOOST_TEST_MESSAGE("Skipping '" << what << "': no vectorized CPU kernels on this machine.");
+            return;
+        }
+        CPUVectorizedTensorOps::SetMaxISA(CPUVectorISA::None);
+        auto expected = CreateTensor(outShape, 100);
+        fn(expected);
+        CPUVectorizedTensorOps::SetMaxISA(CPUVectorISA::AVX512);
+        auto actual = CreateTensor(outShape, 100);
+        fn(actual);
+        BOOST_CHECK_MESSAGE(actual.GetSOB().IsEqualTo(expected.GetSOB(), tolerance), what);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(CPUVectorizedTensorOpsSuite, VectorizedTensorOpsFixture)
+
+BOOST_AUTO_TEST_CASE(VectorizedElementwiseUnary)
+{
+    let a = CreateTensor(TensorShape(1027, 33), 1);
+    for (auto op : { opCopy, opNegate, opAbs, opSqr, opLinearRectifier })
+    {
+        Compare("unary, beta = 0", TensorShape(1027, 33), 0, [&](TensorView<float>& c) { c.DoUnaryOpOf(0, a, 0.5f, op, opSum); });
+        Compare("unary, beta = 1", TensorShape(1027, 33), 0, [&](TensorView<float>& c) { c.DoUnaryOpOf(1, a, 1, op, opSum); });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(VectorizedElementwiseBinaryWithBroadcasting)
+{
+    let a = CreateTensor(TensorShape(517, 40), 1);
+    let b = CreateTensor(TensorShape(517, 40), 2);
+    let bias = CreateTensor(TensorShape(517), 3);
+    let scalar = CreateTensor(TensorShape(1), 4);
+    for (auto op : { opSum, opDifference, opElementwiseProduct, opMax, opMin, opSqrOfDifference, opMaskNegative,
+                     opElementwiseProductWithLinearRectifierDerivativeFromOutput,
+                     opElementwiseProductWithSigmoidDerivativeFromOutput, opElementwiseProductWithTanhDerivativeFromOutput })
+    {
+        Compare("binary", TensorShape(517, 40), 0, [&](TensorView<float>& c) { c.DoBinaryOpOf(0, a, b, 1, op, opSum); });
+        Compare("binary, column broadcast", TensorShape(517, 40), 0, [&](TensorView<float>& c) { c.DoBinaryOpOf(0.5f, a, bias, 2, op, opSum); });
+        Compare("binary, scalar broadcast", TensorShape(517, 40), 0, [&](TensorView<float>& c) { c.DoBinaryOpOf(0, scalar, b, 1, op, opSum); });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(VectorizedReductions)
+{
+    let a = CreateTensor(TensorShape(2049, 300), 1);
+    // bias gradient: accumulates in double in the same order as the generic loop, hence exact
+    Compare("sum over columns", TensorShape(2049), 0, [&](TensorView<float>& c) { c.DoUnaryOpOf(1, a, 1, opCopy, opSum); });
+    Compare("max over columns", TensorShape(2049), 0, [&](TensorView<float>& c) { c.DoUnaryOpOf(0, a, 1, opCopy, opMax); });
+    Compare("min over columns", TensorShape(2049), 0, [&](TensorView<float>& c) { c.DoUnaryOpOf(0, a, 1, opCopy, opMin); });
+    // per-column reductions and full reductions sum in a different order
+    Compare("sum over rows", TensorShape(1, 300), 1e-4f, [&](TensorView<float>& c) { c.DoUnaryOpOf(0, a, 1, opCopy, opSum); });
+    Compare("log-sum over rows", TensorShape(1, 300), 1e-4f, [&](TensorView<float>& c) { c.DoUnaryOpOf(0, a, 1, opCopy, opLogSum); });
+    Compare("max over rows", TensorShape(1, 300), 0, [&](TensorView<float>& c) { c.DoUnaryOpOf(0, a, 1, opCopy, opMax); });
+    Compare("total sum", TensorShape(1), 1e-2f, [&](TensorView<float>& c) { c.DoUnaryOpOf(0, a, 1, opCopy, opSum); });
+    Compare("total log-sum", TensorShape(1), 1e-4f, [&](TensorView<float>& c) { c.DoUnaryOpOf(0, a, 1, opCopy, opLogSum); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+}}}
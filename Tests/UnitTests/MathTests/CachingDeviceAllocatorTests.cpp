@@ -0,0 +1,178 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CachingDeviceAllocator.h"
+#include <cstdlib>
+#include <map>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// a device with a fixed capacity, backed by host memory
+struct FakeDevice
+{
+    size_t capacity;
+    size_t used = 0;
+    size_t numMallocs = 0;
+    size_t numFrees = 0;
+    std::map<void*, size_t> blocks;
+
+    explicit FakeDevice(size_t capacity) : capacity(capacity) {}
+
+    std::unique_ptr<CachingDeviceAllocator> CreateAllocator()
+    {
+        return std::make_unique<CachingDeviceAllocator>(
+            [this](size_t numBytes) -> void*
+            {
+                if (used + numBytes > capacity)
+                    return nullptr;
+                void* p = malloc(numBytes);
+                blocks[p] = numBytes;
+                used += numBytes;
+                numMallocs++;
+                return p;
+            },
+            [this](void* p)
+            {
+                BOOST_REQUIRE(blocks.find(p) != blocks.end());
+                used -= blocks[p];
+                blocks.erase(p);
+                numFrees++;
+                free(p);
+            });
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(CachingDeviceAllocatorSuite)
+
+BOOST_AUTO_TEST_CASE(CachingDeviceAllocatorRoundSize)
+{
+    BOOST_CHECK_EQUAL(CachingDeviceAllocator::RoundSize(0), 512);
+    BOOST_CHECK_EQUAL(CachingDeviceAllocator::RoundSize(1), 512);
+    BOOST_CHECK_EQUAL(CachingDeviceAllocator::RoundSize(513), 1024);
+    BOOST_CHECK_EQUAL(CachingDeviceAllocator::RoundSize(1 << 20), 1 << 20);
+    // above 1 MB, 8 classes per power of two
+    BOOST_CHECK_EQUAL(CachingDeviceAllocator::RoundSize((1 << 20) + 1), (1 << 20) + (1 << 17));
+    BOOST_CHECK_EQUAL(CachingDeviceAllocator::RoundSize(3 << 20), 3 << 20);
+    BOOST_CHECK_EQUAL(CachingDeviceAllocator::RoundSize((100 << 20) + 5), 104 << 20);
+}
+
+BOOST_AUTO_TEST_CASE(CachingDeviceAllocatorReusePerStream)
+{
+    FakeDevice device(64 << 20);
+    auto allocator = device.CreateAllocator();
+    int stream1, stream2;
+
+    void* a = allocator->Allocate(10000, &stream1);
+    BOOST_REQUIRE(a != nullptr);
+    BOOST_CHECK(allocator->Free(a));
+    BOOST_CHECK(!allocator->Free(&stream1)); // not from this allocator
+
+    // a slightly smaller request on the same stream gets the cached block
+    void* b = allocator->Allocate(9000, &stream1);
+    BOOST_CHECK_EQUAL(b, a);
+    // other streams don't
+    void* c = allocator->Allocate(10000, &stream2);
+    BOOST_CHECK_NE(c, a);
+    BOOST_CHECK_EQUAL(device.numMallocs, 2);
+    BOOST_CHECK(allocator->Free(b));
+
+    // much smaller requests don't take a large block
+    void* d = allocator->Allocate(1000, &stream1);
+    BOOST_CHECK_NE(d, a);
+
+    DeviceMemoryStatistics s = allocator->GetStatistics();
+    BOOST_CHECK_EQUAL(s.numAllocations, 4);
+    BOOST_CHECK_EQUAL(s.numCacheHits, 1);
+    BOOST_CHECK_EQUAL(s.numRawAllocations, 3);
+    BOOST_CHECK_EQUAL(s.requestedBytes, 10000 + 1000);
+    BOOST_CHECK_EQUAL(s.allocatedBytes, 10240 + 1024);
+    BOOST_CHECK_EQUAL(s.FragmentedBytes(), 240 + 24);
+    BOOST_CHECK_EQUAL(s.cachedBytes, 10240);
+    BOOST_CHECK_EQUAL(s.reservedBytes, device.used);
+    BOOST_CHECK_EQUAL(s.peakAllocatedBytes, 2 * 10240);
+
+    allocator->EmptyCache();
+    BOOST_CHECK_EQUAL(device.numFrees, 1);
+    BOOST_CHECK_EQUAL(allocator->GetStatistics().cachedBytes, 0);
+    BOOST_CHECK(allocator->Free(c));
+    BOOST_CHECK(allocator->Free(d));
+    allocator->EmptyCache();
+    BOOST_CHECK(device.blocks.empty());
+    BOOST_CHECK_EQUAL(allocator->GetStatistics().reservedBytes, 0);
+}
+
+BOOST_AUTO_TEST_CASE(CachingDeviceAllocatorOutOfMemory)
+{
+    FakeDevice device(8 << 20);
+    auto allocator = device.CreateAllocator();
+    int stream;
+
+    // fill the device with cached blocks that are too small for the next request
+    void* a = allocator->Allocate(3 << 20, &stream);
+    void* b = allocator->Allocate(3 << 20, &stream);
+    BOOST_CHECK(allocator->Free(a));
+    BOOST_CHECK(allocator->Free(b));
+
+    // the cache is released to make room
+    void* c = allocator->Allocate(6 << 20, &stream);
+    BOOST_REQUIRE(c != nullptr);
+    BOOST_CHECK_EQUAL(device.numFrees, 2);
+    BOOST_CHECK_EQUAL(allocator->GetStatistics().cachedBytes, 0);
+
+    // and if that doesn't help either, the allocation fails
+    BOOST_CHECK(allocator->Allocate(4 << 20, &stream) == nullptr);
+    BOOST_CHECK(allocator->Free(c));
+    allocator->EmptyCache();
+}
+
+BOOST_AUTO_TEST_CASE(CachingDeviceAllocatorCapture)
+{
+    FakeDevice device(64 << 20);
+    auto allocator = device.CreateAllocator();
+    int stream;
+
+    void* weights = allocator->Allocate(10000, &stream);
+    void* input = allocator->Allocate(10000, &stream);
+    allocator->BeginCapture();
+    BOOST_CHECK(allocator->IsCapturing());
+    void* temp = allocator->Allocate(10000, &stream);
+    BOOST_CHECK(allocator->Free(temp));
+    const size_t captureId = allocator->EndCapture();
+    BOOST_CHECK(!allocator->IsCapturing());
+    BOOST_CHECK_THROW(allocator->EndCapture(), std::logic_error);
+
+    // blocks freed during the capture are kept for the graph
+    void* other = allocator->Allocate(10000, &stream);
+    BOOST_CHECK_NE(other, temp);
+    BOOST_CHECK(allocator->Free(other));
+    BOOST_CHECK(allocator->IsCaptureValid(captureId));
+    BOOST_CHECK_EQUAL(allocator->GetStatistics().allocatedBytes, 3 * 10240);
+
+    // blocks that were in use when the capture ended must stay
+    BOOST_CHECK(allocator->Free(input));
+    BOOST_CHECK(!allocator->IsCaptureValid(captureId));
+    allocator->ReleaseCapture(captureId);
+    BOOST_CHECK(!allocator->IsCaptureValid(captureId));
+    BOOST_CHECK_EQUAL(allocator->GetStatistics().allocatedBytes, 10240);
+    BOOST_CHECK_EQUAL(allocator->GetStatistics().cachedBytes, 3 * 10240);
+
+    // a released capture is forgotten; freeing its blocks affects later captures only
+    allocator->BeginCapture();
+    const size_t captureId2 = allocator->EndCapture();
+    BOOST_CHECK_NE(captureId2, captureId);
+    BOOST_CHECK(allocator->IsCaptureValid(captureId2));
+    allocator->ReleaseCapture(captureId2);
+    BOOST_CHECK_THROW(allocator->ReleaseCapture(captureId2), std::logic_error);
+    BOOST_CHECK(allocator->Free(weights));
+    allocator->EmptyCache();
+    BOOST_CHECK(device.blocks.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/ConvolutionAlgorithmCache.h"
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+struct TemporaryCacheFile
+{
+    std::wstring path;
+
+    TemporaryCacheFile()
+        : path((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cudnn-%%%%-%%%%.txt")).wstring())
+    {
+    }
+    ~TemporaryCacheFile()
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(ConvolutionAlgorithmCacheSuite)
+
+BOOST_AUTO_TEST_CASE(ConvolutionAlgorithmCachePersists)
+{
+    TemporaryCacheFile file;
+    {
+        ConvolutionAlgorithmCache cache(file.path);
+        BOOST_CHECK_EQUAL(cache.Size(), 0);
+        cache.Insert("GPU|forward|N=32", { 1, 1024 });
+        cache.Insert("GPU|backwardData|N=32", { 4, 0 });
+        cache.Insert("GPU|forward|N=32", { 6, 4096 }); // tuned again, e.g. by another process
+    }
+
+    ConvolutionAlgorithmCache cache(file.path);
+    BOOST_CHECK_EQUAL(cache.Size(), 2);
+    ConvolutionAlgorithmCache::Entry entry;
+    BOOST_REQUIRE(cache.Find("GPU|forward|N=32", entry));
+    BOOST_CHECK_EQUAL(entry.algorithm, 6);
+    BOOST_CHECK_EQUAL(entry.workspaceSize, 4096);
+    BOOST_REQUIRE(cache.Find("GPU|backwardData|N=32", entry));
+    BOOST_CHECK_EQUAL(entry.algorithm, 4);
+    BOOST_CHECK(!cache.Find("GPU|forward|N=64", entry));
+
+    BOOST_CHECK_THROW(cache.Insert("GPU\n", { 0, 0 }), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionAlgorithmCacheSkipsMalformedLines)
+{
+    TemporaryCacheFile file;
+    {
+        std::ofstream f(boost::filesystem::path(file.path).string(), std::ios::binary);
+        f << "2 512 key with spaces\r\n"
+          << "garbage\n"
+          << "3 \n"
+          << "5 100 cut short"; // no line break, still a complete entry
+    }
+
+    ConvolutionAlgorithmCache cache(file.path);
+    BOOST_CHECK_EQUAL(cache.Size(), 2);
+    ConvolutionAlgorithmCache::Entry entry;
+    BOOST_REQUIRE(cache.Find("key with spaces", entry));
+    BOOST_CHECK_EQUAL(entry.algorithm, 2);
+    BOOST_CHECK_EQUAL(entry.workspaceSize, 512);
+    BOOST_REQUIRE(cache.Find("cut short", entry));
+    BOOST_CHECK_EQUAL(entry.algorithm, 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
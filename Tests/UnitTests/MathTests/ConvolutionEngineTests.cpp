@@ -584,6 +584,186 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+// Compares Winograd engine against reference engine on CPU for both tile sizes, with and without padding,
+// including outputs that are not a multiple of the tile size and enough tiles for several blocks.
+BOOST_AUTO_TEST_CASE(WinogradConvolutionForward)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    for (size_t inW : {3, 4, 7, 16})
+    {
+        for (size_t inC : {1, 3, 16})
+        {
+            for (size_t mapCount : {1, 8})
+            {
+                for (bool autoPad : {false, true})
+                {
+                    auto g = std::make_shared<ConvolveGeometry>(TensorShape(inW, inW + 1, inC),
+                        TensorShape(3, 3, inC), TensorShape(mapCount), TensorShape(1, 1, inC),
+                        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                        TensorShape(0), TensorShape(0));
+                    auto refEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+                    auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Winograd);
+
+                    size_t n = 3;
+                    vec buf(g->InputShape().GetNumElements() * n);
+                    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                    SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+                    buf.resize(g->KernelShape().GetNumElements() * mapCount);
+                    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                    SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+                    SingleMatrix out(g->OutputShape().GetNumElements(), n, deviceId);
+                    SingleMatrix outRef(g->OutputShape().GetNumElements(), n, deviceId);
+                    SingleMatrix workspace(deviceId);
+                    SingleMatrix workspaceRef(deviceId);
+
+                    testEng->Forward(in, kernel, out, workspace);
+                    refEng->Forward(in, kernel, outRef, workspaceRef);
+
+                    // The transforms cancel terms of the order of the largest outputs, so rounding errors scale with those
+    // rather than with each output; that is also why the engine is not part of GetTestEngineConfigs().
+                    std::string emsg;
+                    float absErr = Err<float>::Rel * outRef.MatrixNormInf();
+                    BOOST_REQUIRE_MESSAGE(CheckEqual(out, outRef, emsg, Err<float>::Rel * 4, absErr),
+                                          "out are not equal, Geometry: " << (std::string)(*g) << ". " << emsg);
+                }
+            }
+        }
+    }
+}
+
+// Compares depthwise engine against reference engine on CPU for forward and both backward passes: depthwise
+// (one channel per group) and grouped convolutions, with channel multipliers, strides and padding.
+BOOST_AUTO_TEST_CASE(DepthwiseConvolution)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    for (size_t inC : {1, 4, 6})
+    {
+        for (size_t groupSize : {1, 2})
+        {
+            if (inC % groupSize != 0)
+                continue;
+            for (size_t multiplier : {1, 3})
+            {
+                for (size_t stride : {1, 2})
+                {
+                    for (bool autoPad : {false, true})
+                    {
+                        auto g = std::make_shared<ConvolveGeometry>(TensorShape(7, 6, inC),
+                            TensorShape(3, 3, groupSize), TensorShape(1, 1, multiplier), TensorShape(stride, stride, groupSize),
+                            ConvolveGeometry::BoolVec{true, true, false}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                            TensorShape(0), TensorShape(0));
+                        auto refEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+                        auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Depthwise);
+                        std::string msg = " are not equal, Geometry: " + (std::string)(*g) + ". ";
+
+                        size_t n = 3;
+                        size_t inSize = g->InputShape().GetNumElements();
+                        size_t outSize = g->OutputShape().GetNumElements();
+                        size_t kernelCount = g->KernelCount();
+                        BOOST_REQUIRE_EQUAL(kernelCount, inC / groupSize * multiplier);
+
+                        vec buf(inSize * n);
+                        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                        SingleMatrix in(inSize, n, buf.data(), deviceId, matrixFlagNormal);
+
+                        buf.resize(g->KernelShape().GetNumElements() * kernelCount);
+                        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                        SingleMatrix kernel(kernelCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+                        buf.resize(outSize * n);
+                        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                        SingleMatrix srcGrad(outSize, n, buf.data(), deviceId, matrixFlagNormal);
+
+                        SingleMatrix workspace(deviceId);
+                        std::string emsg;
+
+                        SingleMatrix out(outSize, n, deviceId);
+                        SingleMatrix outRef(outSize, n, deviceId);
+                        testEng->Forward(in, kernel, out, workspace);
+                        refEng->Forward(in, kernel, outRef, workspace);
+                        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outRef, emsg, Err<float>::Rel, Err<float>::Abs), "out" << msg << emsg);
+
+                        // Both engines add to the gradients.
+                        SingleMatrix grad(inSize, n, deviceId);
+                        grad.SetValue(1);
+                        SingleMatrix gradRef(grad.DeepClone(), deviceId);
+                        testEng->BackwardData(srcGrad, kernel, grad, true, workspace);
+                        refEng->BackwardData(srcGrad, kernel, gradRef, true, workspace);
+                        BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradRef, emsg, Err<float>::Rel, Err<float>::Abs), "grad" << msg << emsg);
+
+                        SingleMatrix kernelGrad(kernel.GetNumRows(), kernel.GetNumCols(), deviceId);
+                        kernelGrad.SetValue(1);
+                        SingleMatrix kernelGradRef(kernelGrad.DeepClone(), deviceId);
+                        testEng->BackwardKernel(srcGrad, in, kernelGrad, true, false, workspace);
+                        refEng->BackwardKernel(srcGrad, in, kernelGradRef, true, false, workspace);
+                        BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradRef, emsg, Err<float>::Rel, Err<float>::Abs), "kernelGrad" << msg << emsg);
+                    }
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MaxPoolingWithArgmax)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    for (auto layout : {ImageLayoutKind::CHW, ImageLayoutKind::HWC})
+    {
+        for (size_t stride : {1, 2, 3})
+        {
+            // In HWC the channels come first, also in the kernel and stride shapes.
+            bool hwc = layout == ImageLayoutKind::HWC;
+            auto g = hwc ? std::make_shared<ConvolveGeometry>(TensorShape(3, 7, 6), TensorShape(1, 3, 3), TensorShape(1), TensorShape(1, stride, stride),
+                                                              ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false, true, true}, TensorShape(0), TensorShape(0))
+                         : std::make_shared<ConvolveGeometry>(TensorShape(7, 6, 3), TensorShape(3, 3, 1), TensorShape(1), TensorShape(stride, stride, 1),
+                                                              ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false}, TensorShape(0), TensorShape(0));
+            auto eng = ConvEng::Create(g, deviceId, layout, 0, PoolKind::Max, ConvolutionEngineKind::Reference);
+            BOOST_REQUIRE(eng->SupportsPoolingArgmax());
+            std::string msg = " are not equal, Geometry: " + (std::string)(*g) + ". ";
+
+            size_t n = 4;
+            size_t inSize = g->InputShape().GetNumElements();
+            size_t outSize = g->OutputShape().GetNumElements();
+
+            // Few distinct values, so that windows have ties, which both paths must break the same way.
+            vec buf(inSize * n);
+            std::generate(begin(buf), end(buf), [&] { return std::round(nd(rng) * 2); });
+            SingleMatrix in(inSize, n, buf.data(), deviceId, matrixFlagNormal);
+
+            buf.resize(outSize * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix srcGrad(outSize, n, buf.data(), deviceId, matrixFlagNormal);
+
+            std::string emsg;
+            SingleMatrix out(outSize, n, deviceId);
+            SingleMatrix outRef(outSize, n, deviceId);
+            Matrix<short> argmax(deviceId);
+            argmax.Resize(outSize, n);
+            eng->ForwardPoolingWithArgmax(in, out, argmax);
+            eng->ForwardPooling(in, outRef);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outRef, emsg, Err<float>::Rel, Err<float>::Abs), "out" << msg << emsg);
+
+            SingleMatrix grad(inSize, n, deviceId);
+            grad.SetValue(1);
+            SingleMatrix gradRef(grad.DeepClone(), deviceId);
+            eng->BackwardPoolingWithArgmax(argmax, srcGrad, grad);
+            eng->BackwardPooling(outRef, srcGrad, in, gradRef);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradRef, emsg, Err<float>::Rel, Err<float>::Abs), "grad" << msg << emsg);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
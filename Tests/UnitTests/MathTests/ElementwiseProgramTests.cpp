@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Compares fused elementwise programs (TensorView::DoElementwiseProgramOf()) against the equivalent sequence of single tensor ops.
+//
+#include "stdafx.h"
+#include <random>
+#include "TensorView.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+struct ElementwiseProgramFixture
+{
+    static TensorView<float> CreateTensor(const TensorShape& shape, int seed, DEVICEID_TYPE deviceId = CPUDEVICE)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> dist(-2.0f, 2.0f);
+        std::vector<float> init(shape.GetNumElements());
+        for (auto& v : init)
+            v = dist(rng);
+        auto sob = std::make_shared<Matrix<float>>(init.size(), 1, init.data(), deviceId);
+        return TensorView<float>(sob, shape);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ElementwiseProgramSuite, ElementwiseProgramFixture)
+
+// an LSTM-style gate: c := beta * c + alpha * (Sigmoid(a + bias) .* Tanh(b)), with a broadcasting bias
+BOOST_AUTO_TEST_CASE(ElementwiseProgramMatchesSingleOps)
+{
+    const TensorShape shape(130, 17);
+    let a = CreateTensor(shape, 1);
+    let b = CreateTensor(shape, 2);
+    let bias = CreateTensor(TensorShape(130), 3);
+
+    ElementwiseProgram program(3);
+    size_t sum = program.Add(opSum, 0, 2);
+    size_t sigmoid = program.Add(opSigmoid, sum);
+    size_t tanh = program.Add(opTanh, 1);
+    program.Add(opElementwiseProduct, sigmoid, tanh);
+    BOOST_CHECK_EQUAL(program.GetNumRegisters(), 7);
+
+    for (float beta : { 0.0f, 0.5f })
+    {
+        auto expected = CreateTensor(shape, 4);
+        auto temp1 = CreateTensor(shape, 0);
+        auto temp2 = CreateTensor(shape, 0);
+        temp1.AssignSumOf(a, bias);
+        temp1.AssignSigmoidOf(temp1);
+        temp2.AssignTanhOf(b);
+        expected.DoBinaryOpOf(beta, temp1, temp2, 2.0f, opElementwiseProduct, opSum);
+
+        auto actual = CreateTensor(shape, 4);
+        actual.DoElementwiseProgramOf(beta, { a, b, bias }, program, 2.0f);
+        BOOST_CHECK(actual.GetSOB().IsEqualTo(expected.GetSOB(), 1e-6f));
+    }
+}
+
+// the gradient of Sigmoid(a) .* b w.r.t. a, computed from the recomputed output of the sigmoid
+BOOST_AUTO_TEST_CASE(ElementwiseProgramGradient)
+{
+    const TensorShape shape(64, 9);
+    let a = CreateTensor(shape, 1);
+    let b = CreateTensor(shape, 2);
+    let gradient = CreateTensor(shape, 3);
+
+    ElementwiseProgram program(3);
+    size_t sigmoid = program.Add(opSigmoid, 0);
+    size_t g = program.Add(opElementwiseProduct, 2, 1);
+    program.Add(opElementwiseProductWithSigmoidDerivativeFromOutput, g, sigmoid);
+
+    auto expected = CreateTensor(shape, 4);
+    auto temp1 = CreateTensor(shape, 0);
+    auto temp2 = CreateTensor(shape, 0);
+    temp1.AssignSigmoidOf(a);
+    temp2.AssignElementwiseProductOf(gradient, b);
+    expected.AddElementwiseProductWithSigmoidDerivativeFromOutputOf(temp2, temp1);
+
+    auto actual = CreateTensor(shape, 4);
+    actual.DoElementwiseProgramOf(1, { a, b, gradient }, program, 1);
+    BOOST_CHECK(actual.GetSOB().IsEqualTo(expected.GetSOB(), 1e-6f));
+}
+
+BOOST_AUTO_TEST_CASE(ElementwiseProgramValidation)
+{
+    ElementwiseProgram program(2);
+    BOOST_CHECK_THROW(program.Add(opSum, 0, 2), std::logic_error); // register 2 is not written yet
+    BOOST_CHECK_THROW(program.Add(opNone, 0), std::invalid_argument);
+    BOOST_CHECK_THROW(ElementwiseProgram(ElementwiseProgram::MaxInputs + 1), std::invalid_argument);
+
+    let a = CreateTensor(TensorShape(5), 1);
+    auto c = CreateTensor(TensorShape(5), 2);
+    program.Add(opSum, 0, 1);
+    BOOST_CHECK_THROW(c.DoElementwiseProgramOf(0, { a }, program, 1), std::invalid_argument); // program expects two inputs
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,73 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include <cmath>
+#include <limits>
+#include "../../../Source/Math/Float16.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(Float16Suite)
+
+BOOST_AUTO_TEST_CASE(Float16ExactValues)
+{
+    // values that are representable in fp16 survive the round trip
+    for (float f : { 0.0f, -0.0f, 1.0f, -2.5f, 0.099975586f, 1024.0f, 65504.0f, -65504.0f,
+                     6.1035156e-05f /*smallest normal*/, 5.9604645e-08f /*smallest subnormal*/, 3.0517578e-05f /*subnormal*/ })
+    {
+        BOOST_CHECK_EQUAL((float)Float16(f), f);
+        BOOST_CHECK_EQUAL(std::signbit((float)Float16(f)), std::signbit(f));
+    }
+
+    BOOST_CHECK_EQUAL(Float16(1.0f).m_bits, 0x3c00);
+    BOOST_CHECK_EQUAL(Float16(-2.0f).m_bits, 0xc000);
+    BOOST_CHECK_EQUAL(Float16(65504.0f).m_bits, 0x7bff);
+    BOOST_CHECK_EQUAL(Float16(5.9604645e-08f).m_bits, 0x0001);
+}
+
+BOOST_AUTO_TEST_CASE(Float16Rounding)
+{
+    // round to nearest, ties to even; 1 + 2^-11 is halfway between 1 and the next half, 1 + 2^-10
+    BOOST_CHECK_EQUAL(Float16(1.0f + std::ldexp(1.0f, -11)).m_bits, 0x3c00);
+    BOOST_CHECK_EQUAL(Float16(1.0f + 3 * std::ldexp(1.0f, -11)).m_bits, 0x3c02);
+    BOOST_CHECK_EQUAL(Float16(1.0f + std::ldexp(1.0f, -11) + std::ldexp(1.0f, -20)).m_bits, 0x3c01);
+    // rounding up into the next binade
+    BOOST_CHECK_EQUAL(Float16(2.0f - std::ldexp(1.0f, -12)).m_bits, 0x4000);
+    // subnormals: 2^-25 ties to 0, anything above rounds to the smallest subnormal
+    BOOST_CHECK_EQUAL(Float16(std::ldexp(1.0f, -25)).m_bits, 0x0000);
+    BOOST_CHECK_EQUAL(Float16(std::ldexp(1.0f, -25) * 1.0001f).m_bits, 0x0001);
+    BOOST_CHECK_EQUAL(Float16(std::ldexp(1.0f, -26)).m_bits, 0x0000);
+    // overflow: 65519 still rounds to the largest half, 65520 does not
+    BOOST_CHECK_EQUAL(Float16(65519.0f).m_bits, 0x7bff);
+    BOOST_CHECK_EQUAL(Float16(65520.0f).m_bits, 0x7c00);
+    BOOST_CHECK_EQUAL(Float16(-1e10f).m_bits, 0xfc00);
+}
+
+BOOST_AUTO_TEST_CASE(Float16SpecialValues)
+{
+    BOOST_CHECK_EQUAL(Float16(std::numeric_limits<float>::infinity()).m_bits, 0x7c00);
+    BOOST_CHECK_EQUAL(Float16(-std::numeric_limits<float>::infinity()).m_bits, 0xfc00);
+    BOOST_CHECK(std::isinf((float)Float16::FromBits(0x7c00)));
+    BOOST_CHECK(std::isnan((float)Float16(std::numeric_limits<float>::quiet_NaN())));
+    BOOST_CHECK(std::isnan((float)Float16::FromBits(0x7e00)));
+}
+
+BOOST_AUTO_TEST_CASE(Float16AllValuesRoundTrip)
+{
+    // every non-NaN half converts to float and back to itself
+    for (uint32_t bits = 0; bits < 0x10000; bits++)
+    {
+        if ((bits & 0x7c00) == 0x7c00 && (bits & 0x3ff))
+            continue;
+        Float16 h = Float16::FromBits((uint16_t)bits);
+        BOOST_REQUIRE_EQUAL(Float16((float)h).m_bits, bits);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -119,6 +119,26 @@ BOOST_FIXTURE_TEST_CASE(MatrixMultiplyAndPlusAndMinus, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixBatchMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    // 7 products (5 x 3)^T * (5 x 4), the right operand shared by all of them, against one MultiplyAndWeightedAdd() each
+    const size_t batchSize = 7;
+    SingleMatrix a = SingleMatrix::RandomUniform(5, 3 * batchSize, c_deviceIdZero, -1, 1, IncrementCounter());
+    SingleMatrix b = SingleMatrix::RandomUniform(5, 4, c_deviceIdZero, -1, 1, IncrementCounter());
+    SingleMatrix c = SingleMatrix::RandomUniform(3, 4 * batchSize, c_deviceIdZero, -1, 1, IncrementCounter());
+    SingleMatrix expected = c.DeepClone();
+    SingleMatrix::BatchMultiplyAndWeightedAdd(0.5f, a, true, b, false, 2.0f, c, batchSize, /*broadcastA=*/false, /*broadcastB=*/true);
+    for (size_t i = 0; i < batchSize; i++)
+    {
+        SingleMatrix expectedSlice = expected.ColumnSlice(i * 4, 4);
+        SingleMatrix::MultiplyAndWeightedAdd(0.5f, a.ColumnSlice(i * 3, 3), true, b, false, 2.0f, expectedSlice);
+    }
+    foreach_coord (i, j, c)
+    {
+        BOOST_CHECK(fabs(c(i, j) - expected(i, j)) < c_epsilonFloatE5);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixColumnwiseScaleAndWeightedAdd, RandomSeedFixture)
 {
     size_t m = 256;
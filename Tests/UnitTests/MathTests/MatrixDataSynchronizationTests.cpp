@@ -104,6 +104,44 @@ BOOST_FIXTURE_TEST_CASE(MatrixDataSynchronization_GravitatingTowardsPreferredDev
     BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixC.GetCurrentMatrixLocation());
 }
 
+// Requires GPU
+BOOST_FIXTURE_TEST_CASE(MatrixDataSynchronization_TransferAudit, RandomSeedFixture)
+{
+    SingleMatrix matrix(16, 8, c_deviceIdZero);
+    matrix.SetValue(1);
+
+    MatrixTransferAudit::SetMode(MatrixTransferAudit::Mode::Count);
+    MatrixTransferAudit::TakeStatistics();
+    const std::wstring nodeName = L"CRF";
+    {
+        MatrixTransferAudit::Scope scope(L"ForwardProp", nodeName);
+        matrix.TransferToDeviceIfNotThere(CPUDEVICE, true);
+        matrix.TransferToDeviceIfNotThere(CPUDEVICE, true); // already there
+        matrix.TransferToDeviceIfNotThere(c_deviceIdZero, true);
+    }
+    matrix.TransferToDeviceIfNotThere(CPUDEVICE, true);
+
+    auto statistics = MatrixTransferAudit::TakeStatistics();
+    BOOST_CHECK_EQUAL(statistics.size(), 3);
+    BOOST_CHECK_EQUAL(statistics[L"ForwardProp CRF: GPU0 -> CPU"].numTransfers, 1);
+    BOOST_CHECK_EQUAL(statistics[L"ForwardProp CRF: GPU0 -> CPU"].bytes, 16 * 8 * sizeof(float));
+    BOOST_CHECK_EQUAL(statistics[L"ForwardProp CRF: CPU -> GPU0"].numTransfers, 1);
+    BOOST_CHECK_EQUAL(statistics[L"(outside of nodes): GPU0 -> CPU"].numTransfers, 1);
+
+    // Fail mode throws within nodes only
+    MatrixTransferAudit::SetMode(MatrixTransferAudit::Mode::Fail);
+    {
+        MatrixTransferAudit::Scope scope(L"Backprop", nodeName);
+        BOOST_CHECK_THROW(matrix.TransferToDeviceIfNotThere(c_deviceIdZero, true), std::runtime_error);
+    }
+    BOOST_CHECK_EQUAL(CurrentDataLocation::CPU, matrix.GetCurrentMatrixLocation());
+    matrix.TransferToDeviceIfNotThere(c_deviceIdZero, true);
+    BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrix.GetCurrentMatrixLocation());
+
+    MatrixTransferAudit::SetMode(MatrixTransferAudit::Mode::Off);
+    MatrixTransferAudit::TakeStatistics();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
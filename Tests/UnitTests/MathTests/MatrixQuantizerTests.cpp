@@ -401,6 +401,103 @@ static void TestQuantization(int deviceId, size_t numRows, size_t numCols, float
     }
 }
 
+// Quantizes matrices of different dimensions as one batch and compares with quantizing them one by one,
+// and the summing unquantization of several quantized matrices with unquantizing and adding them one by one.
+template <typename ElemType>
+static void TestBatchQuantization(int deviceId, size_t numBits, int seed)
+{
+    const std::vector<std::pair<size_t, size_t>> dims = { { 25, 13 }, { 489, 1 }, { 1, 135 }, { 89, 23 } };
+    const ElemType threshold = 0;
+
+    std::unique_ptr<MatrixQuantizerImpl<ElemType>> quantizer(MatrixQuantizerImpl<ElemType>::Create(deviceId, false /*useAsync*/));
+
+    std::vector<std::unique_ptr<Matrix<ElemType>>> inMatrices, residues, batchResidues;
+    std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>> qMatrices;
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        inMatrices.emplace_back(new Matrix<ElemType>(Matrix<ElemType>::RandomUniform(dims[i].first, dims[i].second, deviceId, -0.5f, +0.5f, seed + (int) i)));
+        residues.emplace_back(new Matrix<ElemType>(Matrix<ElemType>::RandomUniform(dims[i].first, dims[i].second, deviceId, -0.05f, +0.05f, seed + 100 + (int) i)));
+        batchResidues.emplace_back(new Matrix<ElemType>(residues[i]->DeepClone()));
+
+        qMatrices.emplace_back(new QuantizedMatrix<ElemType>(dims[i].first, dims[i].second, numBits, CPUDEVICE));
+        quantizer->QuantizeAsync(*inMatrices[i], *residues[i], *qMatrices[i], *residues[i], false);
+        quantizer->WaitQuantizeAsyncDone();
+    }
+
+    std::vector<const Matrix<ElemType>*> inPtrs, inResiduePtrs;
+    std::vector<Matrix<ElemType>*> outResiduePtrs;
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        inPtrs.push_back(inMatrices[i].get());
+        inResiduePtrs.push_back(batchResidues[i].get());
+        outResiduePtrs.push_back(batchResidues[i].get());
+    }
+
+    QuantizedMatrixBatch<ElemType> qBatch(dims, numBits, CPUDEVICE);
+    quantizer->QuantizeBatchAsync(inPtrs, inResiduePtrs, qBatch, outResiduePtrs, false);
+    quantizer->WaitQuantizeAsyncDone();
+
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        BOOST_REQUIRE_EQUAL(qBatch.GetSize(i), qMatrices[i]->GetSize());
+        BOOST_CHECK(memcmp(qBatch.Buffer() + qBatch.GetOffset(i), qMatrices[i]->Buffer(), qMatrices[i]->GetSize()) == 0);
+        BOOST_CHECK(batchResidues[i]->IsEqualTo(*residues[i], threshold));
+    }
+
+    std::vector<std::unique_ptr<Matrix<ElemType>>> outMatrices, batchOutMatrices;
+    std::vector<Matrix<ElemType>*> batchOutPtrs;
+    for (size_t i = 0; i < dims.size(); ++i)
+    {
+        outMatrices.emplace_back(new Matrix<ElemType>(dims[i].first, dims[i].second, deviceId));
+        batchOutMatrices.emplace_back(new Matrix<ElemType>(dims[i].first, dims[i].second, deviceId));
+        batchOutPtrs.push_back(batchOutMatrices[i].get());
+
+        quantizer->UnquantizeAsync(*qMatrices[i], *outMatrices[i]);
+        quantizer->WaitUnquantizeAsyncDone();
+    }
+
+    quantizer->UnquantizeBatchAsync(qBatch, batchOutPtrs);
+    quantizer->WaitUnquantizeAsyncDone();
+
+    for (size_t i = 0; i < dims.size(); ++i)
+        BOOST_CHECK(batchOutMatrices[i]->IsEqualTo(*outMatrices[i], threshold));
+
+    // the matrices of the first dimensions, as received from several workers
+    const size_t numRows = dims[0].first;
+    const size_t numCols = dims[0].second;
+    std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>> received;
+    std::vector<QuantizedMatrix<ElemType>*> receivedPtrs;
+    Matrix<ElemType> expected(numRows, numCols, deviceId);
+    for (int k = 0; k < 3; ++k)
+    {
+        Matrix<ElemType> residue(numRows, numCols, deviceId);
+        Matrix<ElemType> gradient = Matrix<ElemType>::RandomUniform(numRows, numCols, deviceId, -1.0f, +1.0f, seed + 200 + k);
+        received.emplace_back(new QuantizedMatrix<ElemType>(numRows, numCols, numBits, CPUDEVICE));
+        receivedPtrs.push_back(received.back().get());
+        quantizer->QuantizeAsync(gradient, residue, *received.back(), residue, false);
+        quantizer->WaitQuantizeAsyncDone();
+
+        quantizer->UnquantizeAsync(*received.back(), expected, k > 0);
+        quantizer->WaitUnquantizeAsyncDone();
+    }
+
+    Matrix<ElemType> sum = Matrix<ElemType>::RandomUniform(numRows, numCols, deviceId, -1.0f, +1.0f, seed + 300);
+    quantizer->UnquantizeSumAsync(receivedPtrs, sum);
+    quantizer->WaitUnquantizeAsyncDone();
+    BOOST_CHECK(sum.IsEqualTo(expected, threshold));
+
+    // and added to what is there
+    Matrix<ElemType> sumAdded(sum.DeepClone());
+    quantizer->UnquantizeSumAsync(receivedPtrs, sumAdded, true);
+    quantizer->WaitUnquantizeAsyncDone();
+    for (int k = 0; k < 3; ++k)
+    {
+        quantizer->UnquantizeAsync(*received[k], sum, true);
+        quantizer->WaitUnquantizeAsyncDone();
+    }
+    BOOST_CHECK(sumAdded.IsEqualTo(sum, threshold));
+}
+
 BOOST_AUTO_TEST_SUITE(GPUMatrixSuite)
 
 BOOST_FIXTURE_TEST_CASE(GPUMatrix1BitQuantizeFloat, RandomSeedFixture)
@@ -435,6 +532,14 @@ BOOST_FIXTURE_TEST_CASE(GPUMatrix1BitQuantizeDouble, RandomSeedFixture)
     TestQuantization<double>(c_deviceIdZero, 100, 50, -0.5f, +0.5f, 2915, 5);
 }
 
+BOOST_FIXTURE_TEST_CASE(GPUMatrixQuantizeBatch, RandomSeedFixture)
+{
+    TestBatchQuantization<float>(c_deviceIdZero, 1, 3015);
+    TestBatchQuantization<float>(c_deviceIdZero, 4, 3115);
+    TestBatchQuantization<double>(c_deviceIdZero, 1, 3215);
+    TestBatchQuantization<double>(c_deviceIdZero, 8, 3315);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(CPUMatrixSuite);
@@ -471,6 +576,14 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrix1BitQuantizeDouble, RandomSeedFixture)
     TestQuantization<double>(CPUDEVICE, 100, 50, -0.5f, +0.5f, 2915, 5);
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixQuantizeBatch, RandomSeedFixture)
+{
+    TestBatchQuantization<float>(CPUDEVICE, 1, 3015);
+    TestBatchQuantization<float>(CPUDEVICE, 4, 3115);
+    TestBatchQuantization<double>(CPUDEVICE, 1, 3215);
+    TestBatchQuantization<double>(CPUDEVICE, 8, 3315);
+}
+
 /*
         Original test cases were using these parameter:
 
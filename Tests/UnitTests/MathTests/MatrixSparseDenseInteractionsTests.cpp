@@ -106,6 +106,41 @@ BOOST_FIXTURE_TEST_CASE(MatrixSparseTimesDense, RandomSeedFixture)
     BOOST_CHECK(mE.IsEqualTo(mC, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixSparseBlockColumnsCopyAndSet, RandomSeedFixture)
+{
+    // gradient of an embedding with sparse input: dense * sparse^T -> sparse block-column
+    Matrix<float> mAdense = Matrix<float>::RandomGaussian(dim3, dim2, c_deviceIdZero, 1.0f, 4.0f, IncrementCounter());
+    Matrix<float> mBdense(c_deviceIdZero);
+    mBdense.AssignTruncateBottomOf(Matrix<float>::RandomUniform(dim1, dim2, c_deviceIdZero, -300.0f, 0.1f, IncrementCounter()), 0);
+    Matrix<float> mBsparse(mBdense.DeepClone());
+    mBsparse.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+
+    Matrix<float> mC = Matrix<float>::Zeros(dim3, dim1, c_deviceIdZero);
+    Matrix<float>::MultiplyAndAdd(mAdense, false, mBdense, true, mC);
+
+    Matrix<float> mD = Matrix<float>::Zeros(dim3, dim1, c_deviceIdZero);
+    mD.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseBlockCol, false);
+    Matrix<float>::MultiplyAndAdd(mAdense, false, mBsparse, true, mD);
+
+    std::vector<size_t> columnIds;
+    std::vector<float> values;
+    size_t numColumns = mD.CopyBlockColumnsToCPU(columnIds, values);
+    BOOST_CHECK_EQUAL(numColumns, columnIds.size());
+    BOOST_CHECK_EQUAL(numColumns * dim3, values.size());
+    BOOST_CHECK(numColumns > 0 && numColumns < dim1);
+
+    // set the columns, scaled, in a new matrix and compare with the dense result
+    for (auto& value : values)
+        value *= 2;
+    Matrix<float> mE = Matrix<float>::Zeros(dim3, dim1, c_deviceIdZero);
+    mE.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseBlockCol, false);
+    mE.SetBlockColumnsFromCPU(columnIds.data(), values.data(), numColumns);
+
+    Matrix<float> mF = Matrix<float>::Zeros(dim3, dim1, c_deviceIdZero);
+    Matrix<float>::ScaleAndAdd(0.5f, mE, mF);
+    BOOST_CHECK(mF.IsEqualTo(mC, c_epsilonFloatE4));
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixDenseTimesSparse, RandomSeedFixture)
 {
     Matrix<float> mAdense(c_deviceIdZero);
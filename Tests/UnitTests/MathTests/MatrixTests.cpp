@@ -6,6 +6,8 @@
 #include "../../../Source/Math/Matrix.h"
 #include "../../../Source/Math/CPUMatrix.h"
 #include "../../../Source/Math/Helpers.h"
+#include "../../../Source/Math/ImageAugmentation.h"
+#include <numeric>
 
 #define IDX2C(i, j, ld) (((j) * (ld)) + (i)) // 0 based indexing
 
@@ -1132,6 +1134,98 @@ BOOST_FIXTURE_TEST_CASE(MatrixHasElement, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixAssignNormalizedBytesOf, RandomSeedFixture)
+{
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        const size_t crow = 2;
+        const size_t ccol = 3;
+        // Bytes above 127 must be read as unsigned.
+        unsigned char src[crow * ccol] = {0, 1, 127, 128, 254, 255};
+        Matrix<char> bytes(crow, ccol, reinterpret_cast<char*>(src), deviceId, matrixFlagNormal);
+
+        SingleMatrix m(deviceId);
+        m.AssignNormalizedBytesOf(bytes, 127.5f, 1.0f / 127.5f);
+        BOOST_CHECK_EQUAL(m.GetNumRows(), crow);
+        BOOST_CHECK_EQUAL(m.GetNumCols(), ccol);
+
+        std::unique_ptr<float[]> result(m.CopyToArray());
+        for (size_t i = 0; i < crow * ccol; i++)
+            BOOST_CHECK_CLOSE(result[i], (src[i] - 127.5f) / 127.5f, 0.0001f);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixAssignAugmentedImagesOf, RandomSeedFixture)
+{
+    const int w = 6, h = 6, c = 3;
+    const size_t numImages = 16, imageSize = w * h * c;
+    std::vector<unsigned char> src(imageSize * numImages);
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (unsigned char)((i * 7919) % 256);
+
+    ImageAugmentation augmentation = {};
+    augmentation.inW = augmentation.outW = w;
+    augmentation.inH = augmentation.outH = h;
+    augmentation.channels = c;
+    augmentation.sideRatioMin = augmentation.sideRatioMax = 1;
+    augmentation.mean = 127.5f;
+    augmentation.scale = 1.0f / 127.5f;
+    augmentation.seed = 7;
+
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        Matrix<char> bytes(imageSize, numImages, reinterpret_cast<char*>(src.data()), deviceId, matrixFlagNormal);
+        SingleMatrix normalized(deviceId);
+        normalized.AssignNormalizedBytesOf(bytes, augmentation.mean, augmentation.scale);
+
+        // a center crop of the whole image at its size is the normalization alone
+        SingleMatrix m(deviceId);
+        m.AssignAugmentedImagesOf(bytes, augmentation, 0);
+        BOOST_CHECK(m.IsEqualTo(normalized, 1e-5f));
+
+        // flipped or not, in both layouts
+        for (bool channelsInnermost : { false, true })
+        {
+            ImageAugmentation flip = augmentation;
+            flip.hFlip = true;
+            flip.channelsInnermost = channelsInnermost;
+            m.AssignAugmentedImagesOf(bytes, flip, 100);
+            std::unique_ptr<float[]> result(m.CopyToArray());
+            std::unique_ptr<float[]> expected(normalized.CopyToArray());
+            size_t numFlipped = 0;
+            for (size_t n = 0; n < numImages; n++)
+            {
+                const bool isFlipped = DrawImageAugmentationSample(flip, 100 + n).flip;
+                numFlipped += isFlipped;
+                for (int y = 0; y < h; y++)
+                    for (int x = 0; x < w; x++)
+                        for (int k = 0; k < c; k++)
+                            BOOST_CHECK_CLOSE(result[n * imageSize + ImageElementOffset(flip, w, h, x, y, k)],
+                                              expected[n * imageSize + ImageElementOffset(flip, w, h, isFlipped ? w - 1 - x : x, y, k)], 0.01f);
+            }
+            BOOST_CHECK(numFlipped > 0 && numFlipped < numImages);
+        }
+    }
+
+    // random crops scaled down, with color jitter: the same on the CPU and the GPU
+    ImageAugmentation jitter = augmentation;
+    jitter.outW = 4;
+    jitter.outH = 3;
+    jitter.sideRatioMin = 0.5f;
+    jitter.randomPosition = jitter.hFlip = true;
+    jitter.brightnessRadius = jitter.contrastRadius = jitter.saturationRadius = 0.4f;
+    Matrix<char> cpuBytes(imageSize, numImages, reinterpret_cast<char*>(src.data()), CPUDEVICE, matrixFlagNormal);
+    Matrix<char> gpuBytes(imageSize, numImages, reinterpret_cast<char*>(src.data()), c_deviceIdZero, matrixFlagNormal);
+    SingleMatrix cpuImages(CPUDEVICE), gpuImages(c_deviceIdZero);
+    cpuImages.AssignAugmentedImagesOf(cpuBytes, jitter, 12345);
+    gpuImages.AssignAugmentedImagesOf(gpuBytes, jitter, 12345);
+    BOOST_CHECK_EQUAL(cpuImages.GetNumRows(), 4 * 3 * c);
+    std::unique_ptr<float[]> cpuResult(cpuImages.CopyToArray());
+    std::unique_ptr<float[]> gpuResult(gpuImages.CopyToArray());
+    for (size_t i = 0; i < cpuImages.GetNumElements(); i++)
+        BOOST_CHECK_SMALL(cpuResult[i] - gpuResult[i], 1e-4f);
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixVectorMax, RandomSeedFixture)
 {
     // Matrices are stored as column-major so below is 3x2 matrix.
@@ -1163,6 +1257,125 @@ BOOST_FIXTURE_TEST_CASE(MatrixVectorMax, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixTopK, RandomSeedFixture)
+{
+    // Few distinct values, so that there are ties, which are ordered by index. k = 260 takes the sorting path on the GPU.
+    for (auto dims : { std::make_tuple(1000, 7, 5), std::make_tuple(300, 3, 260), std::make_tuple(64, 64, 1) })
+    {
+        const size_t rows = std::get<0>(dims), cols = std::get<1>(dims), k = std::get<2>(dims);
+        std::vector<float> src(rows * cols);
+        for (size_t i = 0; i < src.size(); i++)
+            src[i] = (float)((i * 7919) % 97) - 48.0f;
+
+        // expected: the first k of a stable sort of each column
+        std::vector<float> expectedVal(k * cols), expectedIdx(k * cols);
+        for (size_t j = 0; j < cols; j++)
+        {
+            std::vector<size_t> order(rows);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return src[j * rows + a] > src[j * rows + b]; });
+            for (size_t i = 0; i < k; i++)
+            {
+                expectedVal[j * k + i] = src[j * rows + order[i]];
+                expectedIdx[j * k + i] = (float)order[i];
+            }
+        }
+
+        for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+        {
+            Matrix<float> expVal(k, cols, expectedVal.data(), deviceId, matrixFlagNormal);
+            Matrix<float> expIdx(k, cols, expectedIdx.data(), deviceId, matrixFlagNormal);
+            Matrix<float> a(rows, cols, src.data(), deviceId, matrixFlagNormal);
+            Matrix<float> actualVal(deviceId);
+            Matrix<float> actualIdx(deviceId);
+
+            a.TopK(actualVal, actualIdx, k);
+            BOOST_CHECK(actualVal.IsEqualTo(expVal));
+            BOOST_CHECK(actualIdx.IsEqualTo(expIdx));
+
+            // along the rows of the transposed matrix
+            Matrix<float> transposed(deviceId);
+            transposed.AssignTransposeOf(a);
+            transposed.TopK(actualVal, actualIdx, k, /*isColWise =*/ false);
+            BOOST_CHECK(actualVal.Transpose().IsEqualTo(expVal));
+            BOOST_CHECK(actualIdx.Transpose().IsEqualTo(expIdx));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixRankWithinGroups, RandomSeedFixture)
+{
+    // groups of consecutive samples in descending order of gains, with ties in gains and scores; a group of 700 takes
+    // several tiles on the GPU, and a group with all gains 0 has no lambdas
+    const std::vector<size_t> groupSizes = { 1, 5, 700, 40, 3 };
+    std::vector<float> groupStarts(1, 0.0f), scores, gains;
+    for (size_t g = 0; g < groupSizes.size(); g++)
+    {
+        for (size_t i = 0; i < groupSizes[g]; i++)
+        {
+            gains.push_back(g == 4 ? 0.0f : (float)((groupSizes[g] - i) * 5 / groupSizes[g]));
+            scores.push_back((float)((scores.size() * 7919) % 53) / 10.0f - 2.5f);
+        }
+        groupStarts.push_back((float)scores.size());
+    }
+    const size_t n = scores.size(), numGroups = groupSizes.size();
+    const float sigma = 1.0f;
+
+    for (size_t truncation : { 0, 10 })
+    {
+        auto discount = [truncation](size_t rank) { return (truncation == 0 || rank < truncation) ? 1 / log(2.0 + rank) : 0.0; };
+
+        // expected: the lambdas of all pairs of each group, as LambdaRankNode used to compute them
+        std::vector<float> expectedRanks(n), expectedDCGs(numGroups), expectedIdealDCGs(numGroups), expectedGradient(n, 0.0f);
+        for (size_t g = 0; g < numGroups; g++)
+        {
+            const size_t begin = (size_t)groupStarts[g], end = (size_t)groupStarts[g + 1];
+            std::vector<size_t> order(end - begin);
+            std::iota(order.begin(), order.end(), begin);
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return scores[a] > scores[b] || (scores[a] == scores[b] && gains[a] < gains[b]); });
+            double dcg = 0, idealDCG = 0;
+            for (size_t r = 0; r < order.size(); r++)
+            {
+                expectedRanks[order[r]] = (float)r;
+                dcg += gains[order[r]] * discount(r);
+                idealDCG += gains[begin + r] * discount(r);
+            }
+            expectedDCGs[g] = (float)dcg;
+            expectedIdealDCGs[g] = (float)idealDCG;
+            for (size_t i = begin; i < end; i++)
+            {
+                for (size_t j = i + 1; j < end; j++)
+                {
+                    if (idealDCG == 0 || fabs(gains[i] - gains[j]) < 0.0000001)
+                        continue;
+                    const double deltaNDCG = fabs((gains[i] - gains[j]) * (discount((size_t)expectedRanks[j]) - discount((size_t)expectedRanks[i]))) / idealDCG;
+                    const double lambda = -sigma / (1 + exp(sigma * (scores[i] - scores[j]))) * deltaNDCG;
+                    expectedGradient[i] += (float)lambda;
+                    expectedGradient[j] -= (float)lambda;
+                }
+            }
+        }
+
+        for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+        {
+            Matrix<float> s(1, n, scores.data(), deviceId, matrixFlagNormal);
+            Matrix<float> gn(1, n, gains.data(), deviceId, matrixFlagNormal);
+            Matrix<float> starts(1, numGroups + 1, groupStarts.data(), deviceId, matrixFlagNormal);
+            Matrix<float> ranks(deviceId), dcgs(deviceId), idealDCGs(deviceId);
+            Matrix<float> gradient(1, n, deviceId);
+            gradient.SetValue(0.0f);
+
+            Matrix<float>::RankWithinGroups(s, gn, starts, truncation, ranks, dcgs, idealDCGs);
+            Matrix<float>::AddLambdaRankGradient(s, gn, ranks, starts, idealDCGs, sigma, truncation, gradient);
+
+            BOOST_CHECK(ranks.IsEqualTo(Matrix<float>(1, n, expectedRanks.data(), deviceId, matrixFlagNormal)));
+            BOOST_CHECK(dcgs.IsEqualTo(Matrix<float>(1, numGroups, expectedDCGs.data(), deviceId, matrixFlagNormal), 1e-4f));
+            BOOST_CHECK(idealDCGs.IsEqualTo(Matrix<float>(1, numGroups, expectedIdealDCGs.data(), deviceId, matrixFlagNormal), 1e-4f));
+            BOOST_CHECK(gradient.IsEqualTo(Matrix<float>(1, n, expectedGradient.data(), deviceId, matrixFlagNormal), 1e-4f));
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
 {
     float labels[] = {1.0f, 2.0f, 3.0f};
@@ -1186,6 +1399,123 @@ BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixAssignValuesFromDevice, RandomSeedFixture)
+{
+    for (auto sourceDeviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        for (auto targetDeviceId : {CPUDEVICE, c_deviceIdZero})
+        {
+            auto source = SingleMatrix::RandomUniform(7, 11, sourceDeviceId, -1.0f, 1.0f, IncrementCounter());
+            SingleMatrix target(targetDeviceId);
+            target.AssignValuesFromDevice(source);
+
+            BOOST_CHECK_EQUAL(target.GetDeviceId(), targetDeviceId);
+            BOOST_CHECK_EQUAL(source.GetDeviceId(), sourceDeviceId);
+            BOOST_CHECK_EQUAL(target.GetNumRows(), 7);
+            BOOST_CHECK_EQUAL(target.GetNumCols(), 11);
+
+            std::unique_ptr<float[]> sourceValues(source.CopyToArray());
+            std::unique_ptr<float[]> targetValues(target.CopyToArray());
+            for (size_t i = 0; i < source.GetNumElements(); i++)
+                BOOST_CHECK_EQUAL(targetValues[i], sourceValues[i]);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixGatherScatterColumnsOf, RandomSeedFixture)
+{
+    const size_t ccolIn = 5;
+    const float indices[] = { 3, -1, 0, 4, 0, 2 }; // a gap, and column 0 twice
+    const size_t ccolOut = _countof(indices);
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        for (size_t crow : {8, 7}) // in vectors of 4, and one at a time
+        {
+            SingleMatrix idx(1, ccolOut, const_cast<float*>(indices), deviceId, matrixFlagNormal);
+            auto a = SingleMatrix::RandomUniform(crow, ccolIn, deviceId, -1.0f, 1.0f, IncrementCounter());
+            auto b = SingleMatrix::RandomUniform(crow, ccolOut, deviceId, -1.0f, 1.0f, IncrementCounter());
+            std::unique_ptr<float[]> aValues(a.CopyToArray());
+            std::unique_ptr<float[]> bValues(b.CopyToArray());
+
+            // gather: gaps keep their values
+            SingleMatrix gathered(deviceId);
+            gathered.SetValue(b);
+            gathered.DoGatherColumnsOf(0.5f, idx, a, 2.0f);
+            std::unique_ptr<float[]> gatheredValues(gathered.CopyToArray());
+            for (size_t j = 0; j < ccolOut; j++)
+                for (size_t i = 0; i < crow; i++)
+                {
+                    float expected = indices[j] < 0 ? bValues[i + j * crow] : 0.5f * bValues[i + j * crow] + 2.0f * aValues[i + (size_t)indices[j] * crow];
+                    BOOST_CHECK_CLOSE(gatheredValues[i + j * crow], expected, 0.0001f);
+                }
+
+            // scatter: column 0 receives two columns
+            SingleMatrix scattered(deviceId);
+            scattered.SetValue(a);
+            scattered.DoScatterColumnsOf(1.0f, idx, b, 3.0f);
+            std::unique_ptr<float[]> scatteredValues(scattered.CopyToArray());
+            std::vector<float> expectedScatter(aValues.get(), aValues.get() + crow * ccolIn);
+            for (size_t j = 0; j < ccolOut; j++)
+                if (indices[j] >= 0)
+                    for (size_t i = 0; i < crow; i++)
+                        expectedScatter[i + (size_t)indices[j] * crow] += 3.0f * bValues[i + j * crow];
+            for (size_t i = 0; i < crow * ccolIn; i++)
+                BOOST_CHECK_CLOSE(scatteredValues[i], expectedScatter[i], 0.0001f);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixGatherRowsOf, RandomSeedFixture)
+{
+    const size_t crowIn = 4, ccol = 3;
+    const float indices[] = { 2, 0, -1, 3, 2 };
+    const size_t crowOut = _countof(indices);
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        SingleMatrix idx(crowOut, 1, const_cast<float*>(indices), deviceId, matrixFlagNormal);
+        auto a = SingleMatrix::RandomUniform(crowIn, ccol, deviceId, -1.0f, 1.0f, IncrementCounter());
+        SingleMatrix m(crowOut, ccol, deviceId);
+        m.SetValue(7.0f);
+        m.DoGatherRowsOf(0, idx, a, 1.0f);
+
+        std::unique_ptr<float[]> aValues(a.CopyToArray());
+        std::unique_ptr<float[]> values(m.CopyToArray());
+        for (size_t j = 0; j < ccol; j++)
+            for (size_t i = 0; i < crowOut; i++)
+                BOOST_CHECK_EQUAL(values[i + j * crowOut], indices[i] < 0 ? 7.0f : aValues[(size_t)indices[i] + j * crowIn]);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixAssignPackedIndicesOf, RandomSeedFixture)
+{
+    // 2 parallel sequences x 4 time steps: sequence 0 in s=0 for t in [0, 3) with a gap after it, sequence 1 in s=1 for
+    // t in [0, 4). They map to a target layout of 3 parallel sequences, where they begin at columns 2 and 4.
+    const size_t numParallelSequences = 2, numTimeSteps = 4, targetStride = 3;
+    std::vector<PackedSequenceRange> sequences(2);
+    sequences[0] = { /*s=*/0, /*tBegin=*/0, /*tEnd=*/3, /*targetColumn=*/2, /*targetLength=*/5 };
+    sequences[1] = { /*s=*/1, /*tBegin=*/0, /*tEnd=*/4, /*targetColumn=*/4, /*targetLength=*/2 };
+    const float timeIndices[] = { 4, 1, 0, 0, 2, 1, -1, 0 }; // column t * 2 + s; (s=0, t=3) is a gap
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        SingleMatrix indexMatrix(1, numParallelSequences * numTimeSteps, const_cast<float*>(timeIndices), deviceId, matrixFlagNormal);
+        SingleMatrix result(deviceId);
+        result.AssignPackedIndicesOf(&indexMatrix, numParallelSequences, numTimeSteps, sequences, targetStride);
+        std::unique_ptr<float[]> values(result.CopyToArray());
+        const float expected[] = { 2 + 4 * 3, 4 + 1 * 3, 2, 4, 2 + 2 * 3, 4 + 1 * 3, -1, 4 };
+        for (size_t j = 0; j < _countof(expected); j++)
+            BOOST_CHECK_EQUAL(values[j], expected[j]);
+
+        // without time indices, each column maps to its own time step: here unpacking into 4 time steps per sequence
+        sequences[1].targetLength = 4;
+        result.AssignPackedIndicesOf(nullptr, numParallelSequences, numTimeSteps, sequences, /*targetStride=*/1);
+        values.reset(result.CopyToArray());
+        const float expectedUnpack[] = { 2, 4, 3, 5, 4, 6, -1, 7 };
+        for (size_t j = 0; j < _countof(expectedUnpack); j++)
+            BOOST_CHECK_EQUAL(values[j], expectedUnpack[j]);
+        sequences[1].targetLength = 2;
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixScale, RandomSeedFixture)
 {
     const float low = -1.0f;
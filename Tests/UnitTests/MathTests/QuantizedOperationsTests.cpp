@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include "../../../Source/Math/QuantizedOperations.h"
 #include "../../../Source/Math/Helpers.h"
+#include "../../../Source/Math/Matrix.h"
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -50,6 +51,98 @@ BOOST_FIXTURE_TEST_CASE(MultiplyIntToShort, RandomSeedFixture)
         BOOST_CHECK_EQUAL(round(C_upd[i]), C_expected_upd[i]);
 }
 
+BOOST_FIXTURE_TEST_CASE(MultiplyWithAlphaBeta, RandomSeedFixture)
+{
+    // same product as above, C = 2 * A * B + 1 * C
+    int m = 5, n = 4, k = 3;
+    std::vector<float> A = {1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
+    std::vector<float> B = {16,17,18,19,20,21,22,23,24,25,26,27};
+    std::vector<float> C_expected = { 316, 367, 418, 469, 520, 370, 430, 490, 550, 610, 424, 493, 562, 631, 700, 478, 556, 634, 712, 790 };
+    std::vector<float> C(m*n, 1);
+
+    shared_ptr<QuantizerBase<float, short>> quantA(new SymmetricQuantizer<float, short>(1));
+    shared_ptr<QuantizerBase<float, short>> quantB(new SymmetricQuantizer<float, short>(2));
+    QuantizedMultiplier<float> mult(quantA, true, quantB, false);
+
+    mult.Multiply(m, n, k, A.data(), B.data(), C.data(), 2, 1);
+    for (size_t i = 0; i < m*n; i++)
+        BOOST_CHECK_EQUAL(round(C[i]), 2 * C_expected[i] + 1);
+}
+
+// Sizes that go through each of the 128/64/32/16/8-wide kernels and the scalar remainder,
+// with the one- and four-row code paths.
+BOOST_AUTO_TEST_CASE(QuantizedGemmInt16MatchesIntegerProduct)
+{
+    for (int m : { 1, 4, 7, 64 })
+        for (int k : { 3, 8, 2 * 128 + 64 + 32 + 16 + 8 + 3 })
+            for (int n : { 1, 5, 16 })
+            {
+                std::vector<short> A(m * k), B(k * n);
+                for (auto& v : A)
+                    v = (short)(rand() % 512 - 256);
+                for (auto& v : B)
+                    v = (short)(rand() % 512 - 256);
+                std::vector<int32_t> expected(m * n);
+                for (int i = 0; i < m; i++)
+                    for (int j = 0; j < n; j++)
+                    {
+                        int32_t dotProduct = 0;
+                        for (int l = 0; l < k; l++)
+                            dotProduct += A[i + l * m] * B[l + k * j];
+                        expected[i + j * m] = dotProduct;
+                    }
+
+                QuantizedGemmInt16 gemm;
+                gemm.SetNumThreads(2);
+                std::vector<int32_t> C(m * n);
+                gemm.Multiply(m, n, k, A.data(), B.data(), C.data());
+                BOOST_CHECK(C == expected);
+
+                // packed once, multiplied twice
+                gemm.PackA(A.data(), m, k);
+                BOOST_CHECK(gemm.IsAPacked(m, k));
+                for (int pass = 0; pass < 2; pass++)
+                {
+                    std::fill(C.begin(), C.end(), -1);
+                    gemm.MultiplyPackedA(m, n, k, B.data(), C.data());
+                    BOOST_CHECK(C == expected);
+                }
+            }
+}
+
+#ifndef CPUONLY
+// The 8-bit product on the GPU, with a constant A that is quantized once, against the float product. Odd k exercise
+// the padding to whole ints of 4 values, and sizes above 16 the tiling.
+BOOST_FIXTURE_TEST_CASE(QuantizedProductOnGPU, RandomSeedFixture)
+{
+    for (size_t m : { 3, 37 })
+        for (size_t k : { 5, 130 })
+            for (size_t n : { 1, 20 })
+            {
+                auto A = Matrix<float>::RandomUniform(m, k, c_deviceIdZero, -1, 1, IncrementCounter());
+                shared_ptr<QuantizerBase<float, short>> quantA(new SymmetricQuantizer<float, short>(1));
+                shared_ptr<QuantizerBase<float, short>> quantB(new SymmetricQuantizer<float, short>(1));
+                auto mult = make_shared<QuantizedMultiplier<float>>(quantA, true, quantB, false);
+
+                for (int pass = 0; pass < 2; pass++)
+                {
+                    auto B = Matrix<float>::RandomUniform(k, n, c_deviceIdZero, -2, 2, IncrementCounter());
+                    Matrix<float> expected(m, n, c_deviceIdZero);
+                    expected.SetValue(1);
+                    Matrix<float>::MultiplyAndWeightedAdd(2, A, false, B, false, 1, expected);
+
+                    Matrix<float> C(m, n, c_deviceIdZero);
+                    C.SetValue(1);
+                    Matrix<float>::MultiplyAndWeightedAdd(2, A, false, B, false, 1, C, mult);
+
+                    // each value is off by at most half a step of 1/127 of its largest magnitude
+                    Matrix<float> difference(c_deviceIdZero);
+                    difference.AssignDifferenceOf(C, expected);
+                    BOOST_CHECK_LT(difference.FrobeniusNorm(), 0.02 * expected.FrobeniusNorm());
+                }
+            }
+}
+#endif
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -85,6 +85,51 @@ BOOST_AUTO_TEST_CASE(BiasGradient2)
     });
 }
 
+BOOST_AUTO_TEST_CASE(ColumnReduction)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // reduction into consecutive outputs, with few of them and long columns (split into chunks)
+    tensorTester.OneTensorTest("column sum (reduction)", 1e-3, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 100, 30000 }, TensorShape(100), ElementWiseOperator::opSum, deviceId);
+    });
+    tensorTester.OneTensorTest("column max (reduction)", 1e-8, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 10000, 256 }, TensorShape(10000), ElementWiseOperator::opMax, deviceId);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(RowReduction)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // reduction over consecutive inputs, with short rows (a warp each) and long ones (a block each, split into chunks)
+    tensorTester.OneTensorTest("row sum (reduction)", 1e-4, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 100, 4096 }, TensorShape{ 1, 4096 }, ElementWiseOperator::opSum, deviceId);
+    });
+    tensorTester.OneTensorTest("row log sum (reduction)", 1e-4, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 50000, 4 }, TensorShape{ 1, 4 }, ElementWiseOperator::opLogSum, deviceId);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(FullReduction)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // reduction of all elements into a scalar
+    tensorTester.OneTensorTest("full sum (reduction)", 1e-2, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 1024, 1024 }, TensorShape(1), ElementWiseOperator::opSum, deviceId);
+    });
+    tensorTester.OneTensorTest("full min (reduction)", 1e-8, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 1024, 1024 }, TensorShape(1), ElementWiseOperator::opMin, deviceId);
+    });
+}
+
 BOOST_AUTO_TEST_CASE(ColumnSliceMultAndAdd)
 {
     ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
@@ -0,0 +1,65 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Common/Include/ThreadPool.h"
+#include <atomic>
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(ThreadPoolSuite)
+
+BOOST_AUTO_TEST_CASE(ThreadPoolRunsTasks)
+{
+    auto& pool = ThreadPool::Instance();
+    auto caller = std::this_thread::get_id();
+    auto result = pool.Async(std::launch::async, [caller]() { return std::this_thread::get_id() != caller ? 42 : 0; });
+    BOOST_CHECK_EQUAL(result.get(), 42);
+
+    // deferred tasks run on the waiting thread
+    auto deferred = pool.Async(std::launch::deferred, [caller]() { return std::this_thread::get_id() == caller; });
+    BOOST_CHECK(deferred.get());
+
+    auto failure = pool.Async(std::launch::async, []() -> int { throw std::runtime_error("task failed"); });
+    BOOST_CHECK_THROW(failure.get(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(ThreadPoolReusesThreads)
+{
+    auto& pool = ThreadPool::Instance();
+    pool.Async(std::launch::async, []() {}).wait();
+    const size_t numThreads = pool.NumThreads();
+    for (int i = 0; i < 100; i++)
+        pool.Async(std::launch::async, []() {}).wait();
+    BOOST_CHECK_EQUAL(pool.NumThreads(), numThreads);
+}
+
+BOOST_AUTO_TEST_CASE(ThreadPoolChainedTasks)
+{
+    // each task waits for the one after it, like chained prefetches; they only finish if all of them run at once
+    const int numTasks = 16;
+    std::vector<std::shared_future<int>> results(numTasks + 1);
+    std::promise<int> last;
+    results[numTasks] = last.get_future().share();
+    for (int i = numTasks - 1; i >= 0; i--)
+    {
+        auto next = results[i + 1];
+        results[i] = ThreadPool::Instance().Async(std::launch::async, [next]() { return next.get() + 1; }).share();
+    }
+    last.set_value(0);
+    BOOST_CHECK_EQUAL(results[0].get(), numTasks);
+}
+
+BOOST_AUTO_TEST_CASE(ThreadPoolAvailableCpus)
+{
+    BOOST_CHECK_GE(ThreadPool::Instance().NumAvailableCpus(), 1);
+    BOOST_CHECK_LE(ThreadPool::Instance().NumAvailableCpus(), (int) std::max(1u, std::thread::hardware_concurrency()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
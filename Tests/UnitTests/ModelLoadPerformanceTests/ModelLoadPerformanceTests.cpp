@@ -0,0 +1,232 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ModelLoadPerformanceTests.cpp -- loads models the way an evaluation service starts up, and breaks the time down into phases
+//
+// Usage: modelloadperformancetests [--device cpu|gpu] [--repeat <n>] [--noEval] [--profilerDir <dir>] <model>...
+//
+// Each model is loaded with Function::Load() (v2 and legacy models alike), then evaluated once on all-zero inputs,
+// which is when the v2 library builds and compiles the ComputationNetwork and allocates its matrices. The phases are the
+// events of the "Model Loading" section of the profiler (PerformanceProfiler.h), one line per load, in milliseconds:
+//     load         Function::Load()
+//     config       parsing the config and BrainScript (CNTKEval only)
+//     construct    constructing the Function graph from the model dictionary, or from a legacy network
+//     deserialize  reading the protobuf dictionary, or ComputationNetwork::Read() for a legacy model
+//     compile      ComputationNetwork::CompileNetwork(), at load for legacy models and at the first evaluation for all
+//     validate     node validation, part of compile
+//     allocate     ComputationNetwork::AllocateAllMatrices(), at the first evaluation
+//     memplan      MatrixPool::OptimizedMemoryAllocation(), part of allocate
+//     cudnn        creation of the cuDNN handle, once per process
+// 'eval' is the wall time of the first evaluation. Phases nest, so they do not add up to the total.
+// The first load of a model is the cold one; with --repeat, the later ones find the file in the page cache and cuDNN
+// initialized. The profiler writes its summary report of all loads to --profilerDir when the program exits.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "PerformanceProfiler.h"
+#include <chrono>
+#include <codecvt>
+#include <locale>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace CNTK;
+using namespace std;
+
+namespace Native = Microsoft::MSR::CNTK;
+
+struct Options
+{
+    bool gpu = false;
+    size_t repeat = 1;
+    bool eval = true;
+    wstring profilerDir = L"ModelLoadProfile";
+    vector<wstring> models;
+};
+
+struct Phase
+{
+    const char* name;
+    int eventId;
+};
+
+static const Phase phases[] = {
+    { "load", Native::profilerEvtLoadModel },
+    { "config", Native::profilerEvtLoadConfig },
+    { "construct", Native::profilerEvtLoadBuild },
+    { "deserialize", Native::profilerEvtLoadDeserialize },
+    { "compile", Native::profilerEvtLoadCompile },
+    { "validate", Native::profilerEvtLoadValidate },
+    { "allocate", Native::profilerEvtLoadAllocate },
+    { "memplan", Native::profilerEvtLoadMemoryPlan },
+    { "cudnn", Native::profilerEvtLoadCuDnnInit },
+};
+static const size_t numPhases = sizeof(phases) / sizeof(phases[0]);
+
+static void Usage()
+{
+    fprintf(stderr, "Usage: modelloadperformancetests [--device cpu|gpu] [--repeat <n>] [--noEval] [--profilerDir <dir>] <model>...\n");
+}
+
+static wstring ToWString(const string& s)
+{
+    return wstring_convert<codecvt_utf8<wchar_t>>().from_bytes(s);
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--noEval")
+            options.eval = false;
+        else if (arg.compare(0, 2, "--") != 0)
+            options.models.push_back(ToWString(arg));
+        else if (!hasValue)
+            return false;
+        else if (arg == "--device")
+        {
+            const string device = argv[++i];
+            if (device != "cpu" && device != "gpu")
+                return false;
+            options.gpu = device == "gpu";
+        }
+        else if (arg == "--repeat")
+            options.repeat = (size_t) atoi(argv[++i]);
+        else if (arg == "--profilerDir")
+            options.profilerDir = ToWString(argv[++i]);
+        else
+            return false;
+    }
+    return options.repeat > 0 && !options.models.empty();
+}
+
+// total seconds recorded so far for each phase
+static vector<double> PhaseTimes()
+{
+    vector<double> times(numPhases);
+    for (size_t i = 0; i < numPhases; i++)
+    {
+        int count;
+        Native::ProfilerGetFixedEventTime(phases[i].eventId, count, times[i]);
+    }
+    return times;
+}
+
+// a single sample of zeros (or a one-hot vector of index 0 for sparse inputs), nullptr if the shape is not known
+static ValuePtr ZeroValue(const Variable& argument, const DeviceDescriptor& device)
+{
+    const NDShape& shape = argument.Shape();
+    if (shape.HasInferredDimension() || shape.HasFreeDimension() || argument.DynamicAxes().empty())
+        return nullptr;
+
+    const bool isFloat = argument.GetDataType() == DataType::Float;
+    if (argument.IsSparse())
+    {
+        const vector<vector<size_t>> oneHot{ { 0 } };
+        return isFloat ? Value::Create<float>(shape, oneHot, device, /*readOnly =*/ true)
+                       : Value::Create<double>(shape, oneHot, device, /*readOnly =*/ true);
+    }
+    return isFloat ? Value::Create(shape, vector<vector<float>>{ vector<float>(shape.TotalSize()) }, device, /*readOnly =*/ true)
+                   : Value::Create(shape, vector<vector<double>>{ vector<double>(shape.TotalSize()) }, device, /*readOnly =*/ true);
+}
+
+// the first evaluation, which builds the network; false if the inputs cannot be made up
+static bool EvaluateOnce(const FunctionPtr& function, const DeviceDescriptor& device)
+{
+    unordered_map<Variable, ValuePtr> arguments;
+    for (const auto& argument : function->Arguments())
+    {
+        auto value = ZeroValue(argument, device);
+        if (!value)
+            return false;
+        arguments[argument] = value;
+    }
+
+    unordered_map<Variable, ValuePtr> outputs;
+    for (const auto& output : function->Outputs())
+        outputs[output] = nullptr;
+
+    function->Forward(arguments, outputs, device);
+    return true;
+}
+
+static int Run(const Options& options)
+{
+    const DeviceDescriptor device = options.gpu ? DeviceDescriptor::GPUDevice(0) : DeviceDescriptor::CPUDevice();
+
+    Internal::StartProfiler(options.profilerDir);
+    Internal::EnableProfiler();
+
+    printf("%-40s %10s", "model", "total");
+    for (size_t i = 0; i < numPhases; i++)
+        printf(" %11s", phases[i].name);
+    printf(" %10s\n", "eval");
+
+    int numFailed = 0;
+    for (const auto& model : options.models)
+    {
+        for (size_t r = 0; r < options.repeat; r++)
+        {
+            typedef chrono::high_resolution_clock Clock;
+            const vector<double> before = PhaseTimes();
+            auto start = Clock::now();
+            double evalSeconds = -1;
+            try
+            {
+                FunctionPtr function = Function::Load(model, device);
+                if (options.eval)
+                {
+                    auto evalStart = Clock::now();
+                    if (EvaluateOnce(function, device))
+                        evalSeconds = chrono::duration<double>(Clock::now() - evalStart).count();
+                    else
+                        fprintf(stderr, "%ls: not evaluated, an input has no fixed shape.\n", model.c_str());
+                }
+            }
+            catch (const exception& e)
+            {
+                fprintf(stderr, "%ls: skipped: %s\n", model.c_str(), e.what());
+                numFailed++;
+                break;
+            }
+            const double seconds = chrono::duration<double>(Clock::now() - start).count();
+            const vector<double> after = PhaseTimes();
+
+            printf("%-40ls %10.1f", model.c_str(), seconds * 1e3);
+            for (size_t i = 0; i < numPhases; i++)
+                printf(" %11.1f", (after[i] - before[i]) * 1e3);
+            if (evalSeconds >= 0)
+                printf(" %10.1f\n", evalSeconds * 1e3);
+            else
+                printf(" %10s\n", "-");
+            fflush(stdout);
+        }
+    }
+
+    Internal::StopProfiler();
+    return numFailed == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        Usage();
+        return 2;
+    }
+    try
+    {
+        return Run(options);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return 2;
+    }
+}
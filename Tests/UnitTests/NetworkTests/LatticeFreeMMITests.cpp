@@ -0,0 +1,140 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "SpecialPurposeNodes.h"
+#include <cmath>
+#include <functional>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// two states, two pdfs; the start state 0 is final too
+static const vector<string> s_graph =
+{
+    "0 0 1 1 0.5",
+    "0 1 2 2 1.0",
+    "1 1 2 2 0.2",
+    "1 0 1 1 0.7",
+    "1 0.1",
+    "0",
+};
+
+struct TestArc
+{
+    int from, to, pdf;
+    double logWeight;
+};
+static const TestArc s_arcs[] = { { 0, 0, 0, -0.5 }, { 0, 1, 1, -1.0 }, { 1, 1, 1, -0.2 }, { 1, 0, 0, -0.7 } };
+static const double s_logFinal[] = { 0.0, -0.1 };
+
+// adds up all paths of 'numFrames' arcs from state 0: the log total, and the posterior of each pdf at each frame
+static void BruteForce(const Matrix<float>& logLLs, size_t firstColumn, size_t numFrames, size_t numChannels,
+                       double& logTotal, vector<vector<double>>& posteriors)
+{
+    vector<int> path; // arc indices
+    vector<double> pathScores;
+    vector<vector<int>> paths;
+    std::function<void(int, double)> extend = [&](int state, double score)
+    {
+        if (path.size() == numFrames)
+        {
+            paths.push_back(path);
+            pathScores.push_back(score + s_logFinal[state]);
+            return;
+        }
+        const size_t col = firstColumn + path.size() * numChannels;
+        for (int k = 0; k < 4; k++)
+        {
+            if (s_arcs[k].from != state)
+                continue;
+            path.push_back(k);
+            extend(s_arcs[k].to, score + s_arcs[k].logWeight + logLLs(s_arcs[k].pdf, col));
+            path.pop_back();
+        }
+    };
+    extend(0, 0.0);
+
+    double total = 0;
+    for (double score : pathScores)
+        total += exp(score);
+    logTotal = log(total);
+    posteriors.assign(numFrames, vector<double>(2, 0.0));
+    for (size_t i = 0; i < paths.size(); i++)
+        for (size_t t = 0; t < numFrames; t++)
+            posteriors[t][s_arcs[paths[i][t]].pdf] += exp(pathScores[i]) / total;
+}
+
+BOOST_AUTO_TEST_SUITE(LatticeFreeMMITests)
+
+BOOST_AUTO_TEST_CASE(DenominatorGraphParse)
+{
+    msra::lattices::DenominatorGraph graph;
+    graph.Parse(s_graph);
+    BOOST_CHECK_EQUAL(graph.GetNumStates(), 2);
+    BOOST_CHECK_EQUAL(graph.GetNumArcs(), 4);
+    BOOST_CHECK_EQUAL(graph.GetNumPdfs(), 2);
+
+    BOOST_CHECK_THROW(graph.Parse({ "0 1 0 0 1.0", "1" }), std::exception); // epsilon arc
+    BOOST_CHECK_THROW(graph.Parse({ "0 1 1 1 1.0" }), std::exception);      // no final state
+}
+
+BOOST_AUTO_TEST_CASE(DenominatorGraphForwardBackward)
+{
+    msra::lattices::DenominatorGraph graph;
+    graph.Parse(s_graph);
+
+    // two parallel sequences: 3 frames in channel 0, and 2 frames in channel 1 followed by a gap
+    MBLayoutPtr pMBLayout = make_shared<MBLayout>(2, 3, L"X");
+    pMBLayout->AddSequence(0, 0, 0, 3);
+    pMBLayout->AddSequence(1, 1, 0, 2);
+    pMBLayout->AddGap(1, 2, 3);
+    vector<unsigned int> uttFirstColumns, uttFrames;
+    LatticeFreeMMINode<float>::GetUtterances(pMBLayout, uttFirstColumns, uttFrames);
+    BOOST_REQUIRE_EQUAL(uttFrames.size(), 2);
+    BOOST_CHECK_EQUAL(uttFirstColumns[0], 0);
+    BOOST_CHECK_EQUAL(uttFirstColumns[1], 1);
+    BOOST_CHECK_EQUAL(uttFrames[0], 3);
+    BOOST_CHECK_EQUAL(uttFrames[1], 2);
+
+    Matrix<float> logLLs(2, 6, CPUDEVICE);
+    const float values[] = { -0.3f, -1.2f, -2.0f, -0.1f, -0.6f, -0.9f, -1.5f, -0.4f, -0.8f, -0.8f, 0.0f, 0.0f };
+    for (size_t col = 0; col < 6; col++)
+        for (size_t pdf = 0; pdf < 2; pdf++)
+            logLLs(pdf, col) = values[col * 2 + pdf];
+
+    Matrix<float> posteriors(CPUDEVICE);
+    const double logTotal = graph.ForwardBackward(logLLs, uttFirstColumns, uttFrames, 2, posteriors);
+
+    double expectedLogTotal = 0;
+    for (size_t u = 0; u < 2; u++)
+    {
+        double uttLogTotal;
+        vector<vector<double>> expectedPosteriors;
+        BruteForce(logLLs, uttFirstColumns[u], uttFrames[u], 2, uttLogTotal, expectedPosteriors);
+        expectedLogTotal += uttLogTotal;
+        for (size_t t = 0; t < uttFrames[u]; t++)
+        {
+            const size_t col = uttFirstColumns[u] + t * 2;
+            BOOST_CHECK_CLOSE(posteriors(0, col) + posteriors(1, col), 1.0f, 1e-3);
+            for (size_t pdf = 0; pdf < 2; pdf++)
+                BOOST_CHECK_CLOSE(posteriors(pdf, col), (float) expectedPosteriors[t][pdf], 1e-2);
+        }
+    }
+    BOOST_CHECK_CLOSE(logTotal, expectedLogTotal, 1e-3);
+    // the gap
+    BOOST_CHECK_EQUAL(posteriors(0, 5), 0.0f);
+    BOOST_CHECK_EQUAL(posteriors(1, 5), 0.0f);
+
+    // double runs the same kernels on a copy
+    Matrix<double> logLLsDouble(CPUDEVICE);
+    logLLsDouble.CastAssignValuesOf(logLLs);
+    Matrix<double> posteriorsDouble(CPUDEVICE);
+    BOOST_CHECK_CLOSE(graph.ForwardBackward(logLLsDouble, uttFirstColumns, uttFrames, 2, posteriorsDouble), logTotal, 1e-4);
+    BOOST_CHECK_CLOSE(posteriorsDouble(1, 2), (double) posteriors(1, 2), 1e-4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
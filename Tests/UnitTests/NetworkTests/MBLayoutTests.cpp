@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Sequences.h"
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(MBLayoutTests)
+
+// two parallel sequences of 4 time steps, the first with a gap after 3
+static MBLayoutPtr CreateLayoutWithGap()
+{
+    auto layout = make_shared<MBLayout>(2, 4, L"");
+    layout->AddSequence(0, 0, 0, 3);
+    layout->AddGap(0, 3, 4);
+    layout->AddSequence(1, 1, 0, 4);
+    return layout;
+}
+
+BOOST_AUTO_TEST_CASE(MBLayoutColumnsValidityMask)
+{
+    auto layout = CreateLayoutWithGap();
+    const auto& mask = layout->GetColumnsValidityMask(CPUDEVICE);
+    BOOST_REQUIRE_EQUAL(mask.GetNumCols(), 8);
+    std::unique_ptr<char[]> values(mask.CopyToArray());
+    const char expected[] = { 1, 1, 1, 1, 1, 1, 0, 1 }; // column t * 2 + s
+    for (size_t j = 0; j < _countof(expected); j++)
+        BOOST_CHECK_EQUAL(values[j], expected[j]);
+
+    // created once, and shared by a copy of the layout
+    BOOST_CHECK_EQUAL(&layout->GetColumnsValidityMask(CPUDEVICE), &mask);
+    auto copy = make_shared<MBLayout>();
+    copy->CopyFrom(layout);
+    BOOST_CHECK_EQUAL(&copy->GetColumnsValidityMask(CPUDEVICE), &mask);
+
+    // a new minibatch invalidates it in the layout, not in the copy
+    layout->Init(1, 2);
+    layout->AddSequence(2, 0, 0, 1);
+    layout->AddGap(0, 1, 2);
+    std::unique_ptr<char[]> newValues(layout->GetColumnsValidityMask(CPUDEVICE).CopyToArray());
+    BOOST_CHECK_EQUAL(newValues[0], 1);
+    BOOST_CHECK_EQUAL(newValues[1], 0);
+    BOOST_CHECK_EQUAL(&copy->GetColumnsValidityMask(CPUDEVICE), &mask);
+}
+
+BOOST_AUTO_TEST_CASE(MBLayoutBoundaries)
+{
+    auto layout = CreateLayoutWithGap();
+    BOOST_CHECK(layout->IsGap(FrameRange(layout, 3).Sequence(0)));
+    BOOST_CHECK(!layout->IsGap(FrameRange(layout, 3).Sequence(1)));
+    BOOST_CHECK(layout->IsEnd(0, 2));
+    BOOST_CHECK(!layout->IsEnd(1, 2));
+    BOOST_CHECK(layout->IsBeyondStartOrEnd(FrameRange(layout, 0).Sequence(1).WithTimeOffset(-1)));
+    BOOST_CHECK(!layout->IsBeyondStartOrEnd(FrameRange(layout, 1).Sequence(1).WithTimeOffset(-1)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
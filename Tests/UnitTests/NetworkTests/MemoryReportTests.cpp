@@ -0,0 +1,131 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNode.h"
+#include "MatrixPool.h"
+#include "MemoryReport.h"
+#include <fstream>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(MemoryReportTests)
+
+BOOST_AUTO_TEST_CASE(MemoryReportOfSharedMatrices)
+{
+    // a and b do not overlap and share a buffer; c overlaps with both
+    shared_ptr<Matrix<float>> a, b, c;
+    MatrixPool pool;
+    pool.ResetStepCounter();
+    pool.RequestAllocate<float>(CPUDEVICE, &a, 100, true, false, L"A", "value");    // step 0
+    pool.RequestAllocate<float>(CPUDEVICE, &c, 10, false, false, L"C", "gradient"); // step 1
+    pool.RequestRelease<float>(&a);                                                 // step 2
+    pool.RequestAllocate<float>(CPUDEVICE, &b, 50, true, false, L"B", "value");     // step 3
+    pool.RequestRelease<float>(&b);                                                 // step 4
+    pool.OptimizedMemoryAllocation();
+    BOOST_CHECK(a == b);
+    BOOST_CHECK(a != c);
+
+    MemoryReport report;
+    pool.FillReport(report);
+    BOOST_REQUIRE_EQUAL(report.requests.size(), 3);
+    BOOST_CHECK_EQUAL(report.numBuffers, 2);
+    for (const auto& request : report.requests)
+    {
+        if (request.owner == L"C")
+            BOOST_CHECK(request.kind == "gradient" && !request.perSample && request.releaseStep == INT_MAX);
+        else
+            BOOST_CHECK(request.kind == "value" && request.perSample);
+    }
+
+    const std::wstring path = L"MemoryReportTests.jsonl";
+    report.Write(path);
+    std::ifstream file(msra::strfun::utf8(path));
+    std::string line, summary;
+    size_t numRequests = 0, numBuffers = 0, numSteps = 0;
+    while (std::getline(file, line))
+    {
+        numRequests += line.find("\"type\":\"request\"") != std::string::npos;
+        numBuffers += line.find("\"type\":\"buffer\"") != std::string::npos;
+        numSteps += line.find("\"type\":\"step\"") != std::string::npos;
+        if (line.find("\"type\":\"summary\"") != std::string::npos)
+            summary = line;
+    }
+    BOOST_CHECK_EQUAL(numRequests, 3);
+    BOOST_CHECK_EQUAL(numBuffers, 2);
+    BOOST_CHECK_EQUAL(numSteps, 5);
+    // A (400 bytes per sample) and C (40 bytes) are live together at steps 1 and 2; without sharing, B would add 200
+    BOOST_CHECK(summary.find("\"peakStep\":1,\"peakBytes\":40,\"peakBytesPerSample\":400") != std::string::npos);
+    BOOST_CHECK(summary.find("\"bytesPerSample\":400,\"unsharedBytes\":40,\"unsharedBytesPerSample\":600") != std::string::npos);
+}
+
+// a buffer that is shared by a request that scales with the minibatch and a fixed one is as large as the larger of them
+BOOST_AUTO_TEST_CASE(MemoryReportMaxSamples)
+{
+    shared_ptr<Matrix<float>> a, c, d;
+    MatrixPool pool;
+    pool.ResetStepCounter();
+    pool.RequestAllocate<float>(CPUDEVICE, &c, 10, false, false, L"C", "gradient"); // step 0
+    pool.RequestAllocate<float>(CPUDEVICE, &a, 100, true, false, L"A", "value");    // step 1
+    pool.RequestRelease<float>(&a);                                                 // step 2
+    pool.RequestAllocate<float>(CPUDEVICE, &d, 1000, false, false, L"D", "temp");   // step 3
+    pool.RequestRelease<float>(&d);                                                 // step 4
+    pool.OptimizedMemoryAllocation();
+    BOOST_CHECK(a == d);
+    BOOST_CHECK(a != c);
+
+    MemoryReport report;
+    pool.FillReport(report);
+    BOOST_CHECK(report.GetDevices() == std::set<int>{ CPUDEVICE });
+    // max(400 * samples, 4000) + 40 bytes
+    BOOST_CHECK_EQUAL(report.GetBufferBytes(CPUDEVICE, 1), 4040);
+    BOOST_CHECK_EQUAL(report.GetBufferBytes(CPUDEVICE, 20), 8040);
+    BOOST_CHECK_EQUAL(report.GetMaxSamples(CPUDEVICE, 8040), 20);
+    BOOST_CHECK_EQUAL(report.GetMaxSamples(CPUDEVICE, 8439), 20);
+    BOOST_CHECK_EQUAL(report.GetMaxSamples(CPUDEVICE, 4040), 10);
+    BOOST_CHECK_EQUAL(report.GetMaxSamples(CPUDEVICE, 4039), 0);
+    BOOST_CHECK_EQUAL(report.GetMaxSamples(CPUDEVICE, 8040, 40), 19);
+    // nothing on device 0 grows with the minibatch
+    BOOST_CHECK_EQUAL(report.GetBufferBytes(0, 20), 0);
+    BOOST_CHECK_EQUAL(report.GetMaxSamples(0, 100), SIZE_MAX);
+}
+
+// a value that is dropped after the forward pass and recomputed in the backward pass shares its buffer in between
+BOOST_AUTO_TEST_CASE(MatrixPoolRecomputation)
+{
+    shared_ptr<Matrix<float>> a, b, c, notPooled;
+    MatrixPool pool;
+    pool.ResetStepCounter();
+    pool.RequestAllocate<float>(CPUDEVICE, &a, 100, true, false, L"A", "value"); // step 0
+    pool.RequestRelease<float>(&a);                                              // step 1
+    pool.RequestAllocate<float>(CPUDEVICE, &b, 90, true, false, L"B", "value");  // step 2
+    pool.RequestRelease<float>(&b);                                              // step 3
+    pool.BeginRecomputation();
+    pool.RequestAllocate<float>(CPUDEVICE, &a, 100, true, false, L"A", "value"); // step 4
+    pool.RequestAllocate<float>(CPUDEVICE, &notPooled, 10, true, false);         // step 5
+    pool.EndRecomputation();
+    pool.RequestAllocate<float>(CPUDEVICE, &c, 80, true, false, L"C", "gradient"); // step 6
+    pool.RequestRelease<float>(&a);                                                // step 7
+    pool.RequestRelease<float>(&c);                                                // step 8
+    pool.OptimizedMemoryAllocation();
+    BOOST_CHECK(a == b);
+    BOOST_CHECK(a != c);
+    BOOST_CHECK(notPooled == nullptr);
+
+    MemoryReport report;
+    pool.FillReport(report);
+    BOOST_REQUIRE_EQUAL(report.requests.size(), 3);
+    for (const auto& request : report.requests)
+    {
+        if (request.owner == L"A")
+            BOOST_CHECK(request.allocStep == 0 && request.releaseStep == 1 && request.reallocSteps == (std::vector<std::pair<int, int>>{ { 4, 7 } }));
+        else
+            BOOST_CHECK(request.reallocSteps.empty());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -131,6 +131,49 @@ BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse)
         true);
 };
 
+// Same as above, with the chunks mapped into memory instead of read.
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_dense_memoryMap)
+{
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_dense_memoryMap_Output.txt",
+        "50x20_jagged_sequences_dense",
+        "reader",
+        508,  // epoch size
+        508,  // mb size
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"50x20_jagged_sequences_dense=[reader=[memoryMap=true]]" });
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse_memoryMap)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_sparse_memoryMap_Output.txt",
+        "50x20_jagged_sequences_sparse",
+        "reader",
+        564,  // epoch size
+        564,  // mb size
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true,
+        false,
+        true,
+        { L"50x20_jagged_sequences_sparse=[reader=[memoryMap=true]]" });
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
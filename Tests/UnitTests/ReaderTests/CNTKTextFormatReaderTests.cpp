@@ -16,6 +16,8 @@
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
 #include "TextParser.h"
+#include "IndexCache.h"
+#include "StreamingRandomizer.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -32,14 +34,16 @@ class CNTKTextFormatReaderTestRunner
 public:
     ChunkPtr m_chunk;
 
+    // A non-zero 'streamingChunkSize' reads the input as a stream, in chunks of about this size.
     CNTKTextFormatReaderTestRunner(const string& filename,
-        const vector<StreamDescriptor>& streams, unsigned int maxErrors) :
+        const vector<StreamDescriptor>& streams, unsigned int maxErrors, size_t streamingChunkSize = 0) :
         m_parser(std::make_shared<CorpusDescriptor>(true), wstring(filename.begin(), filename.end()), streams, true)
     {
         m_parser.SetMaxAllowedErrors(maxErrors);
         m_parser.SetTraceLevel(TextParser<ElemType>::TraceLevel::Info);
-        m_parser.SetChunkSize(SIZE_MAX);
+        m_parser.SetChunkSize(streamingChunkSize > 0 ? streamingChunkSize : SIZE_MAX);
         m_parser.SetNumRetries(0);
+        m_parser.SetStreaming(streamingChunkSize > 0, false);
         m_parser.Initialize();
     }
     // Retrieves a chunk of data.
@@ -47,6 +51,12 @@ public:
     {
         m_chunk = m_parser.GetChunk(0);
     }
+
+    // The parser as a streaming deserializer (not owned).
+    IStreamingDataDeserializerPtr GetStreamingDeserializer()
+    {
+        return IStreamingDataDeserializerPtr(&m_parser, [](IStreamingDataDeserializer*) {});
+    }
 };
 
 namespace Test {
@@ -879,6 +889,109 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReaderNoFirstMinibatchData)
         2);
 };
 
+// the index read from the cache, also after appending to the input, is the same as the one built by a full pass
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_IndexCache)
+{
+    const string path = "IndexCache_Input.txt";
+    const wstring wpath(path.begin(), path.end());
+    auto writeInput = [&path](const char* mode, const char* text)
+    {
+        FILE* f = fopen(path.c_str(), mode);
+        fputs(text, f);
+        fclose(f);
+    };
+    // (key, number of samples, file offset) of all sequences, and the number of chunks
+    auto buildIndex = [&wpath](bool cached)
+    {
+        auto file = shared_ptr<FILE>(fopenOrDie(wpath, L"rbS"), [](FILE* f) { fclose(f); });
+        Indexer indexer(file.get(), /*isPrimary=*/false, /*skipSequenceIds=*/false, '|', /*chunkSize=*/40);
+        if (cached)
+            indexer.EnableCache(wpath, L"");
+        indexer.Build(make_shared<CorpusDescriptor>(true));
+        vector<size_t> result;
+        for (const auto& chunk : indexer.GetIndex().m_chunks)
+            for (const auto& sequence : chunk.m_sequences)
+                result.insert(result.end(), { sequence.m_key.m_sequence, sequence.m_numberOfSamples, chunk.m_offset + sequence.OffsetInChunk() });
+        result.push_back(indexer.GetIndex().m_chunks.size());
+        return result;
+    };
+
+    writeInput("wb", "0 |a 1\n0 |a 2\n1 |a 3\n2 |a 4\n2 |a 5\n");
+    _wunlink(IndexCache(wpath, L"", "").GetCachePath().c_str());
+    auto expected = buildIndex(false);
+    BOOST_CHECK(buildIndex(true) == expected); // writes the cache
+    BOOST_CHECK(fexists(IndexCache(wpath, L"", "").GetCachePath()));
+    BOOST_CHECK(buildIndex(true) == expected); // reads it
+
+    // the appended data continues the last sequence of the cached index
+    writeInput("ab", "2 |a 6\n3 |a 7\n");
+    expected = buildIndex(false);
+    BOOST_CHECK(buildIndex(true) == expected);
+    BOOST_CHECK(buildIndex(true) == expected);
+    BOOST_CHECK_EQUAL(expected[7], 3); // sequence 2 has 3 samples
+
+    // a rewritten input is indexed again
+    writeInput("wb", "5 |a 1\n6 |a 2\n");
+    BOOST_CHECK(buildIndex(true) == buildIndex(false));
+    _wunlink(IndexCache(wpath, L"", "").GetCachePath().c_str());
+}
+
+// a streamed input yields all of its samples, in the input order without a randomization window
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Streaming)
+{
+    const string path = "Streaming_Input.txt";
+    FILE* f = fopen(path.c_str(), "wb");
+    fputs("0 |a 1\n0 |a 2\n1 |a 3\n2 |a 4\n2 |a 5\n2 |a 6\n3 |a 7", f); // no trailing newline
+    fclose(f);
+
+    vector<StreamDescriptor> streams(1);
+    streams[0].m_alias = "a";
+    streams[0].m_name = L"a";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = 1;
+
+    auto readAll = [&](size_t window)
+    {
+        CNTKTextFormatReaderTestRunner<float> testRunner(path, streams, 0, /*streamingChunkSize=*/16);
+        StreamingRandomizer randomizer(testRunner.GetStreamingDeserializer(), window);
+
+        EpochConfiguration config;
+        config.m_numberOfWorkers = 1;
+        config.m_workerRank = 0;
+        config.m_minibatchSizeInSamples = 2;
+        config.m_totalEpochSizeInSamples = requestDataSize;
+        config.m_epochIndex = 0;
+        randomizer.StartEpoch(config);
+
+        vector<float> values;
+        vector<uint32_t> sequenceLengths;
+        Sequences s;
+        do
+        {
+            s = randomizer.GetNextSequences(2, 2);
+            for (const auto& sequence : s.m_data.empty() ? vector<SequenceDataPtr>() : s.m_data[0])
+            {
+                auto data = reinterpret_cast<const float*>(sequence->GetDataBuffer());
+                values.insert(values.end(), data, data + sequence->m_numberOfSamples);
+                sequenceLengths.push_back(sequence->m_numberOfSamples);
+            }
+        } while (!s.m_endOfEpoch);
+        BOOST_CHECK(s.m_endOfSweep);
+        BOOST_CHECK(randomizer.GetNextSequences(2, 2).m_endOfEpoch); // the input is not read again
+        return make_pair(values, sequenceLengths);
+    };
+
+    auto ordered = readAll(0);
+    BOOST_CHECK(ordered.first == vector<float>({ 1, 2, 3, 4, 5, 6, 7 }));
+    BOOST_CHECK(ordered.second == vector<uint32_t>({ 2, 1, 3, 1 }));
+
+    auto randomized = readAll(4);
+    sort(randomized.first.begin(), randomized.first.end());
+    BOOST_CHECK(randomized.first == ordered.first);
+
+    boost::filesystem::remove(path);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
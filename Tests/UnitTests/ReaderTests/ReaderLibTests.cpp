@@ -9,11 +9,23 @@
 #include "NoRandomizer.h"
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
+#include "Bundler.h"
+#include "SequenceBucketer.h"
+#include "ChunkCache.h"
 #include "CorpusDescriptor.h"
 #include "FramePacker.h"
 #include "SequencePacker.h"
 #include "CudaMemoryProvider.h"
 #include "HeapMemoryProvider.h"
+#include "PinnedMemoryPool.h"
+#include "SpscRing.h"
+#include "AsyncFileReader.h"
+#include "AsyncWriteQueue.h"
+#include "RemoteFile.h"
+#include "StringToIdMap.h"
+#include "Indexer.h"
+#include <thread>
+#include <atomic>
 
 #pragma warning(push)
 // disable warning about possible mod 0 operation in uniform_int_distribution
@@ -63,6 +75,11 @@ public:
         result.push_back(data);
     }
 
+    size_t SizeInBytes() const override
+    {
+        return (m_chunkEnd - m_chunkBegin) * m_sequenceLength * sizeof(float);
+    }
+
     ~MockChunk() override {};
 };
 
@@ -173,6 +190,38 @@ void BlockRandomizerInstantiateTest(bool prefetch)
     auto randomizer = make_shared<BlockRandomizer>(0, SIZE_MAX, mockDeserializer, prefetch, false);
 }
 
+BOOST_AUTO_TEST_CASE(ChunkCacheEvictsLeastRecentlyUsed)
+{
+    vector<float> data(40);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(4, 10, data);
+
+    // Room for two chunks of 10 samples.
+    ChunkCache cache(mockDeserializer, 2 * 10 * sizeof(float));
+
+    auto chunk0 = cache.GetChunk(0);
+    cache.GetChunk(1);
+    BOOST_CHECK(cache.GetChunk(0) == chunk0);
+    cache.GetChunk(2); // evicts 1
+    BOOST_CHECK(cache.GetChunk(0) == chunk0);
+    cache.GetChunk(1); // evicts 2
+
+    auto statistics = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_hits, 2);
+    BOOST_CHECK_EQUAL(statistics.m_misses, 4);
+    BOOST_CHECK_EQUAL(statistics.m_evictions, 2);
+    BOOST_CHECK_EQUAL(statistics.m_numberOfChunks, 2);
+    BOOST_CHECK_EQUAL(statistics.m_sizeInBytes, 2 * 10 * sizeof(float));
+
+    // Without a limit everything is kept.
+    ChunkCache unlimited(mockDeserializer);
+    for (ChunkIdType i = 0; i < 4; ++i)
+        unlimited.GetChunk(i);
+    BOOST_CHECK(unlimited.GetChunk(3) == unlimited.GetChunk(3));
+    BOOST_CHECK_EQUAL(unlimited.GetStatistics().m_evictions, 0);
+    BOOST_CHECK_EQUAL(unlimited.GetStatistics().m_numberOfChunks, 4);
+}
+
 BOOST_AUTO_TEST_CASE(CheckSetCurrentCursorForRandomizers)
 {
     size_t chunkSizeInSamples = 10000;
@@ -279,6 +328,209 @@ BOOST_AUTO_TEST_CASE(RandRollbackToEarlierEpochBetweenSweeps)
     BOOST_CHECK_EQUAL_COLLECTIONS(thirdEpoch.begin(), thirdEpoch.end(), anotherThirdEpoch.begin(), anotherThirdEpoch.end());
 }
 
+BOOST_AUTO_TEST_CASE(RandDeepChunkPrefetch)
+{
+    size_t chunkSizeInSamples = 10000;
+    size_t sweepNumberOfSamples = 500000;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    auto expected = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false);
+    auto underTest = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false, 0, true, 8);
+
+    // Prefetching more chunks ahead of the window must not change the data, also across sweeps.
+    size_t epochSize = (size_t)(sweepNumberOfSamples / 1.5);
+    for (size_t epoch = 0; epoch < 3; ++epoch)
+    {
+        auto expectedEpoch = ReadFullEpoch(expected, epochSize, epoch);
+        auto actualEpoch = ReadFullEpoch(underTest, epochSize, epoch);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expectedEpoch.begin(), expectedEpoch.end(), actualEpoch.begin(), actualEpoch.end());
+    }
+
+    // Rolling back drops the prefetched chunks that are not needed anymore.
+    auto expectedEpoch = ReadFullEpoch(expected, epochSize, 1);
+    auto actualEpoch = ReadFullEpoch(underTest, epochSize, 1);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expectedEpoch.begin(), expectedEpoch.end(), actualEpoch.begin(), actualEpoch.end());
+
+    BOOST_CHECK(underTest->GetChunkLoadStallTime() >= 0);
+}
+
+BOOST_AUTO_TEST_CASE(RandShardedCorpus)
+{
+    size_t chunkSizeInSamples = 1000;
+    size_t sweepNumberOfSamples = 50000;
+    uint32_t maxSequenceLength = 100;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    // The values are consecutive over the chunks, so the chunk of a value is given by the chunk sizes.
+    vector<size_t> chunkEnds;
+    for (const auto& chunk : deserializer->Chunks())
+        chunkEnds.push_back((chunkEnds.empty() ? 0 : chunkEnds.back()) + chunk->SizeInSamples());
+    auto chunkOf = [&](float value) { return (size_t)(upper_bound(chunkEnds.begin(), chunkEnds.end(), (size_t)value) - chunkEnds.begin()); };
+
+    // Two workers, the shards move on every two sweeps.
+    const size_t numberOfWorkers = 2;
+    vector<shared_ptr<BlockRandomizer>> workers;
+    for (size_t rank = 0; rank < numberOfWorkers; ++rank)
+        workers.push_back(make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false, 0, true, 1, true, 2));
+
+    vector<vector<set<size_t>>> chunksPerSweep; // [sweep][rank]
+    for (size_t sweep = 0; sweep < 3; ++sweep)
+    {
+        vector<set<size_t>> chunks(numberOfWorkers);
+        vector<float> all;
+        for (size_t rank = 0; rank < numberOfWorkers; ++rank)
+        {
+            EpochConfiguration config;
+            config.m_numberOfWorkers = numberOfWorkers;
+            config.m_workerRank = rank;
+            config.m_minibatchSizeInSamples = 100;
+            config.m_totalEpochSizeInSamples = sweepNumberOfSamples;
+            config.m_epochIndex = sweep;
+            workers[rank]->StartEpoch(config);
+
+            Sequences sequences;
+            do
+            {
+                sequences = workers[rank]->GetNextSequences(100, 100);
+                for (const auto& s : sequences.m_data.empty() ? vector<SequenceDataPtr>() : sequences.m_data[0])
+                {
+                    const float* values = (const float*)s->GetDataBuffer();
+                    for (size_t i = 0; i < s->m_numberOfSamples; ++i)
+                    {
+                        all.push_back(values[i]);
+                        chunks[rank].insert(chunkOf(values[i]));
+                    }
+                }
+            } while (!sequences.m_endOfEpoch);
+        }
+
+        // Together the workers read the whole sweep, each sample once.
+        BOOST_CHECK_EQUAL(all.size(), sweepNumberOfSamples);
+        BOOST_CHECK(CheckFullSweep(sweepNumberOfSamples, all));
+
+        // Each worker has about half of the data, in a contiguous range of chunks.
+        for (size_t rank = 0; rank < numberOfWorkers; ++rank)
+        {
+            BOOST_CHECK(!chunks[rank].empty());
+            BOOST_CHECK_EQUAL(*chunks[rank].rbegin() - *chunks[rank].begin() + 1, chunks[rank].size());
+        }
+        chunksPerSweep.push_back(chunks);
+    }
+
+    // The shards stay with their worker for two sweeps, then move on.
+    for (size_t rank = 0; rank < numberOfWorkers; ++rank)
+    {
+        BOOST_CHECK(chunksPerSweep[0][rank] == chunksPerSweep[1][rank]);
+        BOOST_CHECK(chunksPerSweep[2][rank] == chunksPerSweep[0][(rank + 1) % numberOfWorkers]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SequenceBucketerReducesPadding)
+{
+    size_t chunkSizeInSamples = 10000;
+    size_t sweepNumberOfSamples = 500000;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    size_t minibatchSize = 2000;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    auto randomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false);
+    auto bucketer = make_shared<SequenceBucketer>(make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false), 16);
+
+    // Reads the sequences of an epoch in minibatches; returns their samples and the frames of the minibatches,
+    // if each of them was padded to its longest sequence.
+    auto readEpoch = [&](SequenceEnumeratorPtr enumerator, size_t epochIndex, size_t& numberOfFrames)
+    {
+        EpochConfiguration config;
+        config.m_numberOfWorkers = 1;
+        config.m_workerRank = 0;
+        config.m_minibatchSizeInSamples = minibatchSize;
+        config.m_totalEpochSizeInSamples = sweepNumberOfSamples / 2;
+        config.m_epochIndex = epochIndex;
+        enumerator->StartEpoch(config);
+
+        std::vector<std::vector<float>> sequences;
+        numberOfFrames = 0;
+        for (bool endOfEpoch = false; !endOfEpoch;)
+        {
+            auto minibatch = enumerator->GetNextSequences(minibatchSize, minibatchSize);
+            endOfEpoch = minibatch.m_endOfEpoch;
+            if (minibatch.m_data.empty())
+                continue;
+
+            size_t numberOfSamples = 0, longest = 0;
+            for (const auto& s : minibatch.m_data[0])
+            {
+                float* casted = (float*)s->GetDataBuffer();
+                sequences.push_back(std::vector<float>(casted, casted + s->m_numberOfSamples));
+                numberOfSamples += s->m_numberOfSamples;
+                longest = std::max(longest, (size_t)s->m_numberOfSamples);
+            }
+            BOOST_CHECK(numberOfSamples <= minibatchSize || minibatch.m_data[0].size() == 1);
+            numberOfFrames += longest * minibatch.m_data[0].size();
+        }
+        std::sort(sequences.begin(), sequences.end());
+        return sequences;
+    };
+
+    // Bucketing changes the order of the sequences, but not which sequences make up an epoch, and pads less.
+    for (size_t epoch = 0; epoch < 3; ++epoch)
+    {
+        size_t expectedFrames, actualFrames;
+        auto expected = readEpoch(randomizer, epoch, expectedFrames);
+        auto actual = readEpoch(bucketer, epoch, actualFrames);
+        BOOST_CHECK(expected == actual);
+        BOOST_CHECK_LT(actualFrames, expectedFrames);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BundlerParallelChunkLoading)
+{
+    size_t chunkSizeInSamples = 1000;
+    size_t sweepNumberOfSamples = 50000;
+    uint32_t maxSequenceLength = 30;
+    auto primary = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+    auto secondary = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+    std::vector<IDataDeserializerPtr> deserializers = { primary, secondary };
+
+    // Reads the sequences of all bundled chunks; both streams of a sequence have the same data.
+    auto readAll = [&](bool parallelChunkLoading)
+    {
+        ConfigParameters config;
+        config.Insert("parallelChunkLoading", parallelChunkLoading ? "true" : "false");
+        Bundler bundler(config, primary, deserializers, false);
+
+        std::vector<float> result;
+        for (const auto& chunkDescription : bundler.GetChunkDescriptions())
+        {
+            std::vector<SequenceDescription> sequences;
+            bundler.GetSequencesForChunk(chunkDescription->m_id, sequences);
+            auto chunk = bundler.GetChunk(chunkDescription->m_id);
+            for (const auto& sequence : sequences)
+            {
+                std::vector<SequenceDataPtr> data;
+                chunk->GetSequence(sequence.m_indexInChunk, data);
+                BOOST_REQUIRE_EQUAL(data.size(), 2);
+                BOOST_REQUIRE_EQUAL(data[0]->m_numberOfSamples, data[1]->m_numberOfSamples);
+
+                const float* first = (const float*)data[0]->GetDataBuffer();
+                const float* second = (const float*)data[1]->GetDataBuffer();
+                BOOST_CHECK(std::equal(first, first + data[0]->m_numberOfSamples, second));
+                result.insert(result.end(), first, first + data[0]->m_numberOfSamples);
+            }
+        }
+        return result;
+    };
+
+    auto expected = readAll(false);
+    auto actual = readAll(true);
+    BOOST_CHECK_EQUAL(expected.size(), sweepNumberOfSamples);
+    BOOST_CHECK(expected == actual);
+}
+
 BOOST_AUTO_TEST_CASE(RandRollbackToEarlierEpochInTheSweep)
 {
     size_t chunkSizeInSamples = 10000;
@@ -1030,6 +1282,194 @@ BOOST_AUTO_TEST_CASE(CorpusDescriptorFromFile)
     remove("test.tmp");
 }
 
+BOOST_AUTO_TEST_CASE(AsyncFileReaderReadsRanges)
+{
+    std::vector<char> data(1000003);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (char)(i * 7 + i / 251);
+    FILE* test = fopen("test.tmp", "wb");
+    fwrite(data.data(), sizeof(char), data.size(), test);
+    fclose(test);
+
+    for (bool directIO : { false, true })
+    {
+        // more reads than the queue depth, at unaligned offsets, waited for by several threads
+        AsyncFileReader reader(L"test.tmp", directIO, 4);
+        std::vector<AsyncFileReader::RequestPtr> reads;
+        std::vector<size_t> offsets;
+        for (size_t i = 0; i < 32; i++)
+        {
+            offsets.push_back(i * 31337 % 900000);
+            reads.push_back(reader.Read(offsets.back(), 1 + i * 3001));
+        }
+        reads.push_back(reader.Read(data.size() - 5, 5)); // up to the end of the file
+        offsets.push_back(data.size() - 5);
+
+        std::vector<int> mismatches(3, 0);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < mismatches.size(); t++)
+            threads.emplace_back([&, t]()
+            {
+                for (size_t i = t; i < reads.size(); i += mismatches.size())
+                    mismatches[t] += memcmp(reads[i]->Wait(), data.data() + offsets[i], reads[i]->Size()) != 0;
+            });
+        for (auto& thread : threads)
+            thread.join();
+        BOOST_CHECK_EQUAL(0, std::accumulate(mismatches.begin(), mismatches.end(), 0));
+
+        BOOST_CHECK_THROW(reader.Read(data.size() - 2, 10)->Wait(), std::runtime_error);
+    }
+
+    remove("test.tmp");
+}
+
+BOOST_AUTO_TEST_CASE(AsyncWriteQueueBoundsPendingWrites)
+{
+    for (size_t maxPending : { 0, 3 })
+    {
+        AsyncWriteQueue queue(maxPending);
+        std::atomic<int> inFlight(0), maxInFlight(0), written(0);
+        for (int i = 0; i < 20; i++)
+        {
+            queue.Push([&]()
+            {
+                int n = ++inFlight;
+                for (int m = maxInFlight; n > m && !maxInFlight.compare_exchange_weak(m, n);)
+                    ;
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                --inFlight;
+                ++written;
+            });
+            BOOST_CHECK(queue.NumPending() <= maxPending);
+        }
+        queue.Flush();
+        BOOST_CHECK_EQUAL(20, written.load());
+        BOOST_CHECK_EQUAL(0, queue.NumPending());
+        BOOST_CHECK(maxInFlight.load() <= (int)std::max<size_t>(maxPending, 1));
+    }
+
+    // an error of a background write is reported by Flush()
+    AsyncWriteQueue queue(2);
+    queue.Push([]() { RuntimeError("disk full"); });
+    BOOST_CHECK_THROW(queue.Flush(), std::runtime_error);
+    queue.Flush(); // reported once
+}
+
+BOOST_AUTO_TEST_CASE(RemoteFileUrls)
+{
+    BOOST_CHECK(RemoteFile::IsRemote(L"http://account.blob.core.windows.net/corpus/train.bin?sv=2017-04-17&sig=x"));
+    BOOST_CHECK(RemoteFile::IsRemote(L"https://bucket.s3.amazonaws.com/train.bin"));
+    BOOST_CHECK(!RemoteFile::IsRemote(L"/data/train.bin"));
+    BOOST_CHECK(!RemoteFile::IsRemote(L"C:\\data\\train.bin"));
+
+    // rejected before connecting
+    BOOST_CHECK_THROW(RemoteFile(L"https://bucket.s3.amazonaws.com/train.bin", L"."), std::runtime_error);
+    BOOST_CHECK_THROW(RemoteFile(L"http:///train.bin", L"."), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(StringToIdMapAddsAndFinds)
+{
+    BOOST_CHECK_EQUAL(Crc32c("123456789", 9), 0xE3069283u);
+    BOOST_CHECK_EQUAL(Crc32c("456789", 6, Crc32c("123", 3)), 0xE3069283u);
+
+    StringToIdMap map;
+    map.Reserve(10, 100);
+    const size_t numberOfKeys = 10000; // grows the table several times
+    for (size_t i = 0; i < numberOfKeys; ++i)
+        BOOST_REQUIRE_EQUAL(map.AddIfNotExists("utterance_" + std::to_string(i)), i);
+    BOOST_CHECK_EQUAL(map.Size(), numberOfKeys);
+
+    for (size_t i = 0; i < numberOfKeys; i += 7)
+    {
+        std::string key = "utterance_" + std::to_string(i);
+        BOOST_REQUIRE_EQUAL(map.AddIfNotExists(key), i);
+        BOOST_REQUIRE_EQUAL(map[key], i);
+        BOOST_REQUIRE_EQUAL(map[i], key);
+    }
+
+    size_t id;
+    BOOST_CHECK(!map.TryGet("utterance_", id));
+    BOOST_CHECK(!map.Contains("utterance_" + std::to_string(numberOfKeys)));
+    BOOST_CHECK(map.TryGet("utterance_42xyz", 12, id));
+    BOOST_CHECK_EQUAL(id, 42);
+    BOOST_CHECK_EQUAL(map.AddIfNotExists(""), numberOfKeys);
+    BOOST_CHECK_EQUAL(map[numberOfKeys], "");
+    BOOST_CHECK_THROW(map[numberOfKeys + 1], std::runtime_error);
+
+    WStringToIdMap wmap;
+    wmap.AddValue(L"a");
+    wmap.AddValue(L"b");
+    wmap.AddValue(L"a");
+    BOOST_CHECK_EQUAL(wmap.Size(), 2);
+    BOOST_CHECK(wmap[1] == L"b");
+}
+
+BOOST_AUTO_TEST_CASE(SequenceLocationsFindKeys)
+{
+    SequenceLocations locations;
+    std::pair<uint32_t, uint32_t> location;
+    BOOST_CHECK(!locations.TryGet(0, location));
+
+    const uint32_t numberOfKeys = 100000; // grows the table several times
+    for (uint32_t i = 0; i < numberOfKeys; ++i)
+        locations.Insert(size_t(i) * 3, i / 100, i % 100);
+    locations.Insert(3, 7, 7); // the first location is kept
+    BOOST_CHECK_EQUAL(locations.size(), numberOfKeys);
+
+    for (uint32_t i = 0; i < numberOfKeys; ++i)
+    {
+        BOOST_REQUIRE(locations.TryGet(size_t(i) * 3, location));
+        BOOST_REQUIRE_EQUAL(location.first, i / 100);
+        BOOST_REQUIRE_EQUAL(location.second, i % 100);
+        BOOST_REQUIRE(!locations.TryGet(size_t(i) * 3 + 1, location));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(PinnedMemoryPoolSizeClasses)
+{
+    BOOST_CHECK_EQUAL(PinnedMemoryPool::SizeClass(1), 4096);
+    BOOST_CHECK_EQUAL(PinnedMemoryPool::SizeClass(4096), 4096);
+    BOOST_CHECK_EQUAL(PinnedMemoryPool::SizeClass(4097), 5120);
+    BOOST_CHECK_EQUAL(PinnedMemoryPool::SizeClass(8192), 8192);
+    BOOST_CHECK_EQUAL(PinnedMemoryPool::SizeClass(8193), 10240);
+    BOOST_CHECK_EQUAL(PinnedMemoryPool::SizeClass(3000000), 3145728); // between 2 and 4 MiB in steps of 512 KiB
+
+    for (size_t size = 1; size < 100000000; size = size * 3 / 2 + 1)
+    {
+        const size_t sizeClass = PinnedMemoryPool::SizeClass(size);
+        BOOST_REQUIRE_GE(sizeClass, size);
+        BOOST_REQUIRE(sizeClass <= 4096 || sizeClass <= size + size / 4);
+        BOOST_REQUIRE_EQUAL(PinnedMemoryPool::SizeClass(sizeClass), sizeClass);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConfigParametersResolveSections)
+{
+    ConfigParameters config;
+    config.Parse("dim = 3\n"
+                 "input = [\n"
+                 "    features = [ dim = $dim$ ; format = \"dense\" ] # the features\n"
+                 "\n"
+                 "    # the labels\n"
+                 "    labels = [\n"
+                 "        dim = 10\n"
+                 "        alias = l#1\n"
+                 "    ]\n"
+                 "]\n");
+
+    ConfigParameters input = config("input");
+    BOOST_CHECK_EQUAL((size_t)2, input.size());
+
+    ConfigParameters features = input("features");
+    BOOST_CHECK_EQUAL(3, (int)features("dim"));
+    BOOST_CHECK_EQUAL("dense", (std::string)features("format"));
+
+    ConfigParameters labels = input("labels");
+    BOOST_CHECK_EQUAL(10, (int)labels(L"dim", 0));
+    BOOST_CHECK_EQUAL("l#1", (std::string)labels("alias")); // not a comment, as it is not preceded by white space
+    BOOST_CHECK(!labels.ExistsCurrent("format"));
+}
+
 BOOST_AUTO_TEST_CASE(CheckEpochBoundarySingleWorker)
 {
     size_t chunkSizeInSamples = 1000;
@@ -1076,6 +1516,55 @@ BOOST_AUTO_TEST_CASE(CheckEpochBoundarySingleWorker)
     test(underTestNo);
 }
 
+BOOST_AUTO_TEST_CASE(SpscRingKeepsOrder)
+{
+    SpscRing<size_t> ring(3);
+    BOOST_CHECK_EQUAL(ring.Capacity(), 3);
+
+    size_t item;
+    BOOST_CHECK(!ring.TryPop(item));
+    for (size_t i = 0; i < 3; ++i)
+        BOOST_CHECK(ring.TryPush(size_t(i)));
+    BOOST_CHECK(!ring.TryPush(size_t(3)));
+    BOOST_CHECK_EQUAL(ring.Size(), 3);
+
+    // The indices wrap around.
+    for (size_t i = 0; i < 10; ++i)
+    {
+        BOOST_CHECK(ring.TryPop(item));
+        BOOST_CHECK_EQUAL(item, i);
+        BOOST_CHECK(ring.TryPush(i + 3));
+    }
+    BOOST_CHECK_EQUAL(ring.Size(), 3);
+
+    ring.Close();
+    BOOST_CHECK(!ring.Pop(item));
+}
+
+BOOST_AUTO_TEST_CASE(SpscRingBetweenThreads)
+{
+    const size_t numberOfItems = 10000;
+    SpscRing<size_t> ring(2);
+    std::thread producer([&]()
+    {
+        for (size_t i = 0; i < numberOfItems; ++i)
+            BOOST_REQUIRE(ring.Push(size_t(i)));
+    });
+
+    size_t item;
+    for (size_t i = 0; i < numberOfItems; ++i)
+    {
+        BOOST_REQUIRE(ring.Pop(item));
+        BOOST_REQUIRE_EQUAL(item, i);
+    }
+    producer.join();
+
+    // Closing releases a thread that waits for an item.
+    std::thread consumer([&]() { BOOST_CHECK(!ring.Pop(item)); });
+    ring.Close();
+    consumer.join();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(PackerTests)
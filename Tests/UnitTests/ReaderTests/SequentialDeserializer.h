@@ -178,9 +178,15 @@ namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
             return std::make_shared<SequentialChunk>(*m_chunks[chunkId]);
         }
 
-        virtual bool GetSequenceDescription(const SequenceDescription&, SequenceDescription&) override
+        // The key of a sequence is its starting value, so that deserializers with the same corpus can be bundled.
+        virtual bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& result) override
         {
-            throw logic_error("Not implemented");
+            auto info = m_sequenceInfos.find(primary.m_key.m_sequence);
+            if (info == m_sequenceInfos.end())
+                return false;
+
+            result = SequenceDescription{ info->second.id, (uint32_t)info->second.size, (ChunkIdType)info->second.chunkId, primary.m_key };
+            return true;
         }
 
         virtual ChunkDescriptions GetChunkDescriptions() override
@@ -727,7 +727,7 @@ inline void CompareFunctions(const FunctionPtr& first, const FunctionPtr& second
 
                 NDArrayViewPtr firstFunctionInputValue = firstFunctionInput.IsConstant() ? Constant(firstFunctionInput).Value() : Parameter(firstFunctionInput).Value();
                 NDArrayViewPtr secondFunctionInputValue = secondFunctionInput.IsConstant() ? Constant(secondFunctionInput).Value() : Parameter(secondFunctionInput).Value();
-                if ((parameterCloningMethod == ParameterCloningMethod::Clone) &&
+                if (((parameterCloningMethod == ParameterCloningMethod::Clone) || (parameterCloningMethod == ParameterCloningMethod::CopyOnWrite)) &&
                     ((firstFunctionInput == secondFunctionInput) || (!Internal::AreEqual(*firstFunctionInputValue, *secondFunctionInputValue))))
                 {
                     throw std::runtime_error("CompareFunctions: The parameters of the functions are not equivalent per the specified cloning method");
@@ -5,6 +5,8 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Common.h"
+#include <thread>
+#include <atomic>
 
 using namespace CNTK;
 
@@ -644,6 +646,65 @@ void TestChangingParameterValues(size_t rank, const DeviceDescriptor& device)
     }
 }
 
+void TestCopyOnWriteCloning(const DeviceDescriptor& device)
+{
+    const size_t dim = 3;
+    auto input = InputVariable({ dim }, DataType::Float, L"input");
+    auto bottom = Parameter(NDArrayView::RandomUniform<float>({ dim }, -1.0, 1.0, 1, device), L"bottom");
+    auto top = Parameter(NDArrayView::RandomUniform<float>({ dim }, -1.0, 1.0, 2, device), L"top");
+    auto model = Plus(ElementTimes(input, bottom), top, L"model");
+
+    auto clone = model->Clone(ParameterCloningMethod::CopyOnWrite);
+    std::unordered_set<FunctionPtr> visitedFunctions;
+    CompareFunctions(model, clone, ParameterCloningMethod::CopyOnWrite, {}, visitedFunctions);
+
+    auto findParameter = [](const FunctionPtr& function, const std::wstring& name) -> Parameter
+    {
+        for (const auto& parameter : function->Parameters())
+            if (parameter.Name() == name)
+                return parameter;
+        throw std::runtime_error("CopyOnWriteCloning: The clone lacks a parameter.");
+    };
+    auto clonedBottom = findParameter(clone, L"bottom");
+    auto clonedTop = findParameter(clone, L"top");
+
+    auto evaluate = [&](const FunctionPtr& function)
+    {
+        std::vector<float> data = { 1, 2, 3 };
+        auto inputValue = Value::CreateBatch(NDShape({ dim }), data, device, /*readOnly =*/ true);
+        std::unordered_map<Variable, ValuePtr> outputs = { { function->Output(), nullptr } };
+        function->Forward({ { function->Arguments()[0], inputValue } }, outputs, device);
+        auto result = outputs.at(function->Output())->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+        return std::vector<float>(result->DataBuffer<float>(), result->DataBuffer<float>() + dim);
+    };
+
+    // The clone evaluates over the values of the model, without copies.
+    auto modelOutput = evaluate(model);
+    auto cloneOutput = evaluate(clone);
+    for (size_t i = 0; i < dim; i++)
+        FloatingPointCompare<float>(cloneOutput[i], modelOutput[i], "CopyOnWriteCloning: The clone's output does not match the model's.");
+    if ((clonedBottom.Value()->DataBuffer<float>() != bottom.Value()->DataBuffer<float>()) || (clonedTop.Value()->DataBuffer<float>() != top.Value()->DataBuffer<float>()))
+        ReportFailure("CopyOnWriteCloning: The clone's parameters do not share the values of the model's.");
+
+    // Fine-tuning the top of the clone copies only that parameter, and leaves the model as it was.
+    auto learner = SGDLearner({ clonedTop }, LearningRatePerSampleSchedule(0.5));
+    if (clonedTop.Value()->DataBuffer<float>() == top.Value()->DataBuffer<float>())
+        ReportFailure("CopyOnWriteCloning: A parameter handed to a learner still shares its value.");
+    if (clonedBottom.Value()->DataBuffer<float>() != bottom.Value()->DataBuffer<float>())
+        ReportFailure("CopyOnWriteCloning: A parameter not handed to a learner no longer shares its value.");
+
+    std::unordered_map<Parameter, NDArrayViewPtr> gradients = { { clonedTop, MakeSharedObject<NDArrayView>(1.0f, NDShape({ dim }), device) } };
+    learner->Update(gradients, 1);
+
+    auto updatedCloneOutput = evaluate(clone); // binds the clone's network, compiled over the shared value, to the copy
+    auto updatedModelOutput = evaluate(model);
+    for (size_t i = 0; i < dim; i++)
+    {
+        FloatingPointCompare<float>(updatedCloneOutput[i], modelOutput[i] - 0.5f, "CopyOnWriteCloning: The clone's output does not reflect the update.");
+        FloatingPointCompare<float>(updatedModelOutput[i], modelOutput[i], "CopyOnWriteCloning: The model's output changed with an update of the clone.");
+    }
+}
+
 void TestRecurrenceShapeInference()
 {
     auto testShapeInferenceInRecurrence = [](size_t inputRank, size_t outputRank) {
@@ -742,6 +803,177 @@ void TestFunctionOutputs(const DeviceDescriptor& device)
     }
 }
 
+void TestBatchingEvaluator(const DeviceDescriptor& device)
+{
+    const size_t dim = 3;
+    const size_t numThreads = 8;
+    const size_t numRequestsPerThread = 10;
+
+    auto input = InputVariable({ dim }, DataType::Float, L"input");
+    auto function = ElementTimes(Constant::Scalar(2.0f, device), input, L"doubled");
+    auto evaluator = CreateBatchingEvaluator(function, /*maxBatchSize =*/ 4, /*maxLatencyInMicroseconds =*/ 1000, device);
+
+    // Sequences of different lengths from many threads, each of which waits for its result.
+    std::atomic<size_t> numMismatches(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        threads.push_back(std::thread([&, t]()
+        {
+            for (size_t r = 0; r < numRequestsPerThread; r++)
+            {
+                size_t length = (t + r) % 5 + 1;
+                std::vector<float> data(dim * length);
+                for (size_t i = 0; i < data.size(); i++)
+                    data[i] = (float)(t * 1000 + r * 10 + i);
+
+                auto sequence = MakeSharedObject<NDArrayView>(NDShape({ dim, length }), data.data(), data.size(), DeviceDescriptor::CPUDevice());
+                auto outputs = evaluator->Evaluate({ { input, sequence } }).get();
+                auto output = outputs.at(function->Output())->Data();
+
+                if (output->Shape().TotalSize() != data.size())
+                {
+                    numMismatches++;
+                    continue;
+                }
+                const float* result = output->DataBuffer<float>();
+                for (size_t i = 0; i < data.size(); i++)
+                    if (result[i] != 2 * data[i])
+                        numMismatches++;
+            }
+        }));
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    if (numMismatches > 0)
+        ReportFailure("BatchingEvaluator: %d results do not match.", (int)numMismatches);
+
+    auto statistics = evaluator->Statistics();
+    size_t numBatchedRequests = 0;
+    for (size_t n = 0; n < statistics.batchSizeHistogram.size(); n++)
+        numBatchedRequests += n * statistics.batchSizeHistogram[n];
+    size_t numTimedRequests = 0;
+    for (auto count : statistics.latencyHistogram)
+        numTimedRequests += count;
+
+    if (statistics.numRequests != numThreads * numRequestsPerThread || numBatchedRequests != statistics.numRequests ||
+        numTimedRequests != statistics.numRequests || statistics.queueDepth != 0)
+        ReportFailure("BatchingEvaluator: Unexpected statistics.");
+
+    // A request without the value of the argument is rejected.
+    VerifyException([&]() { evaluator->Evaluate({}); }, "Was able to evaluate a request without arguments.");
+}
+
+void TestBeamSearchDecoder(const DeviceDescriptor& device)
+{
+    const size_t vocabularySize = 4;
+    const size_t startToken = 0;
+    const size_t endToken = 3;
+    const size_t maxLength = 3;
+
+    // The next token depends on the previous two: logP = log(softmax(A[:, previous] + B[:, state])), and the state is the previous token.
+    std::vector<float> a(vocabularySize * vocabularySize), b(vocabularySize * vocabularySize);
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        a[i] = (float)((i * 7) % 5) * 0.5f;
+        b[i] = (float)((i * 3) % 4) * 0.3f;
+    }
+    auto aConstant = Constant(MakeSharedObject<NDArrayView>(NDShape({ vocabularySize, vocabularySize }), a.data(), a.size(), DeviceDescriptor::CPUDevice())->DeepClone(device));
+    auto bConstant = Constant(MakeSharedObject<NDArrayView>(NDShape({ vocabularySize, vocabularySize }), b.data(), b.size(), DeviceDescriptor::CPUDevice())->DeepClone(device));
+    auto token = InputVariable({ vocabularySize }, DataType::Float, L"token");
+    auto state = InputVariable({ vocabularySize }, DataType::Float, L"state");
+    auto logP = Log(Softmax(Plus(Times(aConstant, token), Times(bConstant, state))), L"logP");
+    auto nextState = ElementTimes(Constant::Scalar(1.0f, device), token, L"nextState");
+    auto step = Combine({ logP, nextState });
+
+    // With as many beams as there are paths of two tokens, the best hypothesis is the best of all paths.
+    auto decoder = CreateBeamSearchDecoder(step, token, logP, { { nextState, state } }, startToken, endToken, /*beamWidth =*/ 16, device);
+    std::vector<float> initialState(vocabularySize, 0);
+    initialState[startToken] = 1;
+    auto hypotheses = decoder->Decode({ { state, MakeSharedObject<NDArrayView>(NDShape({ vocabularySize }), initialState.data(), initialState.size(), DeviceDescriptor::CPUDevice()) } }, maxLength);
+
+    auto logSoftmax = [&](size_t previous, size_t beforePrevious)
+    {
+        std::vector<double> z(vocabularySize);
+        double sum = 0;
+        for (size_t v = 0; v < vocabularySize; v++)
+            sum += exp(z[v] = a[previous * vocabularySize + v] + b[beforePrevious * vocabularySize + v]);
+        for (auto& x : z)
+            x -= log(sum);
+        return z;
+    };
+    double bestScore = -std::numeric_limits<double>::infinity();
+    std::vector<size_t> bestTokens;
+    for (size_t path = 0; path < vocabularySize * vocabularySize * vocabularySize; path++)
+    {
+        std::vector<size_t> tokens;
+        double score = 0;
+        size_t previous = startToken, beforePrevious = startToken;
+        for (size_t t = 0, p = path; t < maxLength && previous != endToken; t++, p /= vocabularySize)
+        {
+            size_t next = p % vocabularySize;
+            score += logSoftmax(previous, beforePrevious)[next];
+            tokens.push_back(next);
+            beforePrevious = previous;
+            previous = next;
+        }
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestTokens = tokens;
+        }
+    }
+
+    if (hypotheses.empty() || hypotheses[0].tokens != bestTokens || std::abs(hypotheses[0].score - bestScore) > 1e-4)
+        ReportFailure("BeamSearchDecoder: The best hypothesis does not match the best path (score %f).", bestScore);
+    for (size_t i = 1; i < hypotheses.size(); i++)
+        if (hypotheses[i].score > hypotheses[i - 1].score)
+            ReportFailure("BeamSearchDecoder: The hypotheses are not sorted by score.");
+
+    // The initial state must be given.
+    VerifyException([&]() { decoder->Decode({}, maxLength); }, "Was able to decode without the initial state.");
+}
+
+void TestCachedEvaluation(const DeviceDescriptor& device)
+{
+    const size_t dim = 3;
+    auto input = InputVariable({ dim }, DataType::Float, L"input");
+    auto shared = ElementTimes(Constant::Scalar(2.0f, device), input, L"shared");
+    auto features = Plus(shared, Constant::Scalar(1.0f, device), L"features");
+    auto scores = ElementTimes(shared, shared, L"scores");
+    auto function = Combine({ features->Output(), scores->Output() });
+
+    auto evaluate = [&](const ValuePtr& inputValue, const Variable& output)
+    {
+        std::unordered_map<Variable, ValuePtr> outputs = { { output, nullptr } };
+        function->EvaluateCached({ { input, inputValue } }, outputs, device);
+        auto result = outputs.at(output)->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+        return std::vector<float>(result->DataBuffer<float>(), result->DataBuffer<float>() + result->Shape().TotalSize());
+    };
+
+    // The features and then the scores of the same input, then of another input in the other order.
+    for (float offset : { 0.0f, 10.0f })
+    {
+        std::vector<float> data = { offset + 1, offset + 2, offset + 3, offset + 4, offset + 5, offset + 6 };
+        auto inputValue = Value::CreateBatch(NDShape({ dim }), data, device, /*readOnly =*/ true);
+        auto firstOutput = offset == 0 ? features->Output() : scores->Output();
+        auto secondOutput = offset == 0 ? scores->Output() : features->Output();
+        for (const auto& output : { firstOutput, secondOutput, firstOutput })
+        {
+            auto result = evaluate(inputValue, output);
+            if (result.size() != data.size())
+                ReportFailure("CachedEvaluation: The result has %d elements instead of %d.", (int)result.size(), (int)data.size());
+            for (size_t i = 0; i < data.size(); i++)
+            {
+                float expected = output == features->Output() ? 2 * data[i] + 1 : 4 * data[i] * data[i];
+                if (result[i] != expected)
+                    ReportFailure("CachedEvaluation: The result of '%S' for input %f is %f instead of %f.", output.Name().c_str(), data[i], result[i], expected);
+            }
+        }
+    }
+}
+
 void TestOutputVariableName(const DeviceDescriptor& device)
 {
     size_t inputDim = 10;
@@ -824,6 +1056,227 @@ void TestOutputVariableName(const DeviceDescriptor& device)
             static_cast<unsigned long>(output->Output().Shape().TotalSize()));
 }
 
+void TestScaledDotProductAttention(const DeviceDescriptor& device)
+{
+    const size_t numSequences = 5;
+    const size_t dim = 4;
+    const size_t valueDim = 3;
+    const float scale = 0.5f;
+    auto queryLengths = GenerateSequenceLengths(numSequences, 7);
+    auto keyLengths = GenerateSequenceLengths(numSequences, 9);
+    auto queries = GenerateSequences<float>(queryLengths, { dim });
+    auto keys = GenerateSequences<float>(keyLengths, { dim });
+    auto values = GenerateSequences<float>(keyLengths, { valueDim });
+
+    // the keys are on their own sequence axis, as in encoder/decoder attention
+    std::vector<Axis> keyAxes = { Axis::NewUniqueDynamicAxis(L"keyAxis"), Axis::DefaultBatchAxis() };
+    auto queryVar = InputVariable({ dim }, DataType::Float, L"query");
+    auto keysVar = InputVariable({ dim }, DataType::Float, L"keys", keyAxes);
+    auto valuesVar = InputVariable({ valueDim }, DataType::Float, /*needsGradient =*/ true, L"values", keyAxes);
+    auto attention = ScaledDotProductAttention(queryVar, keysVar, valuesVar, scale, L"attention");
+
+    std::unordered_map<Variable, ValuePtr> arguments = { { queryVar, Value::Create({ dim }, queries, device, true) },
+                                                         { keysVar, Value::Create({ dim }, keys, device, true) },
+                                                         { valuesVar, Value::Create({ valueDim }, values, device, true) } };
+    std::unordered_map<Variable, ValuePtr> outputs = { { attention->Output(), nullptr } };
+    auto backpropState = attention->Forward(arguments, outputs, device, { attention->Output() });
+
+    // the attention probabilities of each query frame
+    std::vector<std::vector<std::vector<double>>> probabilities(numSequences);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        for (size_t t = 0; t < queryLengths[i]; ++t)
+        {
+            std::vector<double> scores(keyLengths[i]);
+            double sum = 0;
+            for (size_t j = 0; j < keyLengths[i]; ++j)
+            {
+                double dot = 0;
+                for (size_t r = 0; r < dim; ++r)
+                    dot += keys[i][j * dim + r] * queries[i][t * dim + r];
+                scores[j] = exp(scale * dot);
+                sum += scores[j];
+            }
+            for (auto& score : scores)
+                score /= sum;
+            probabilities[i].push_back(std::move(scores));
+        }
+    }
+
+    auto automaticUnpackingOfPackedValuesDisabled = Internal::IsAutomaticUnpackingOfPackedValuesDisabled();
+    Internal::SetAutomaticUnpackingOfPackedValues(/*disable =*/ false);
+
+    auto outputValue = outputs.at(attention->Output());
+    auto output = outputValue->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+    size_t maxQueryLength = output->Shape()[1];
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        for (size_t t = 0; t < queryLengths[i]; ++t)
+        {
+            for (size_t r = 0; r < valueDim; ++r)
+            {
+                double expected = 0;
+                for (size_t j = 0; j < keyLengths[i]; ++j)
+                    expected += probabilities[i][t][j] * values[i][j * valueDim + r];
+                float actual = output->DataBuffer<float>()[((i * maxQueryLength) + t) * valueDim + r];
+                if (fabs(actual - expected) > 1e-4)
+                    ReportFailure("ScaledDotProductAttention: The output of sequence %d, frame %d is %f instead of %f.", (int)i, (int)t, actual, expected);
+            }
+        }
+    }
+
+    // With a gradient of ones, the gradient of a value frame is the sum of its probabilities over the query frames.
+    auto rootGradient = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(1.0f, outputValue->Shape(), device), outputValue->Mask());
+    std::unordered_map<Variable, ValuePtr> gradients = { { valuesVar, nullptr } };
+    attention->Backward(backpropState, { { attention->Output(), rootGradient } }, gradients);
+    auto valuesGradient = gradients.at(valuesVar)->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+    size_t maxKeyLength = valuesGradient->Shape()[1];
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        for (size_t j = 0; j < keyLengths[i]; ++j)
+        {
+            double expected = 0;
+            for (size_t t = 0; t < queryLengths[i]; ++t)
+                expected += probabilities[i][t][j];
+            for (size_t r = 0; r < valueDim; ++r)
+            {
+                float actual = valuesGradient->DataBuffer<float>()[((i * maxKeyLength) + j) * valueDim + r];
+                if (fabs(actual - expected) > 1e-4)
+                    ReportFailure("ScaledDotProductAttention: The gradient of value frame %d of sequence %d is %f instead of %f.", (int)j, (int)i, actual, expected);
+            }
+        }
+    }
+
+    Internal::SetAutomaticUnpackingOfPackedValues(/*disable =*/ automaticUnpackingOfPackedValuesDisabled);
+}
+
+void TestChainedPackedValues(const DeviceDescriptor& device)
+{
+    // Outputs of one Function are fed into the next; automatic unpacking is disabled by the test fixture, so any
+    // unpacking on the way fails.
+    NDShape sampleShape = { 3 };
+    auto sequenceLengths = std::vector<size_t>{ 4, 9, 6 };
+    auto inputVar = InputVariable(sampleShape, DataType::Float, L"input");
+    auto inputValue = Value::Create(sampleShape, GenerateSequences<float>(sequenceLengths, sampleShape), device, true);
+    auto first = Tanh(inputVar);
+
+    auto chainedVar = InputVariable(sampleShape, DataType::Float, L"chained");
+    auto second = Sigmoid(chainedVar);
+
+    // The first output is returned packed, and a clone of it stays packed when the first Function writes into it.
+    std::unordered_map<Variable, ValuePtr> firstOutputs = { { first->Output(), nullptr } };
+    first->Forward({ { inputVar, inputValue } }, firstOutputs, device);
+    auto firstOutputValue = firstOutputs.at(first->Output())->DeepClone();
+    firstOutputs = { { first->Output(), firstOutputValue } };
+    first->Forward({ { inputVar, inputValue } }, firstOutputs, device);
+
+    std::unordered_map<Variable, ValuePtr> secondOutputs = { { second->Output(), nullptr } };
+    std::unordered_map<Variable, ValuePtr> secondGradients = { { chainedVar, nullptr } };
+    second->Gradients({ { chainedVar, firstOutputValue } }, secondGradients, secondOutputs, device);
+
+    auto reference = Sigmoid(Tanh(inputVar));
+    std::unordered_map<Variable, ValuePtr> referenceOutputs = { { reference->Output(), nullptr } };
+    reference->Forward({ { inputVar, inputValue } }, referenceOutputs, device);
+
+    auto automaticUnpackingOfPackedValuesDisabled = Internal::IsAutomaticUnpackingOfPackedValuesDisabled();
+    Internal::SetAutomaticUnpackingOfPackedValues(/*disable =*/ false);
+
+    if (!Internal::AreEqual(*secondOutputs.at(second->Output()), *referenceOutputs.at(reference->Output()), 1e-5, 1e-6))
+        ReportFailure("The output of the chained Functions does not match the output of the composed Function.");
+
+    // The gradient w.r.t. the chained input is the derivative of the Sigmoid at the first output.
+    auto referenceOutputValue = referenceOutputs.at(reference->Output());
+    auto sigmoidValue = referenceOutputValue->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+    auto chainedGradient = secondGradients.at(chainedVar)->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+    auto mask = referenceOutputValue->Mask()->DeepClone(DeviceDescriptor::CPUDevice());
+    for (size_t i = 0; i < chainedGradient->Shape().TotalSize(); ++i)
+    {
+        if (mask->DataBuffer()[i / sampleShape.TotalSize()] == MaskKind::Invalid)
+            continue;
+
+        float sigmoid = sigmoidValue->DataBuffer<float>()[i];
+        float actual = chainedGradient->DataBuffer<float>()[i];
+        if (fabs(actual - sigmoid * (1 - sigmoid)) > 1e-5)
+            ReportFailure("The gradient of the chained input at %d is %f instead of %f.", (int)i, actual, sigmoid * (1 - sigmoid));
+    }
+
+    Internal::SetAutomaticUnpackingOfPackedValues(/*disable =*/ automaticUnpackingOfPackedValuesDisabled);
+}
+
+void TestSwitchingBetweenEvaluationPlans(const DeviceDescriptor& device)
+{
+    // A Function evaluated for other outputs in between keeps the network that its Forward call for backpropagation ran on.
+    const size_t inputDim = 5, hiddenDim = 4, numSamples = 3;
+    auto inputVar = InputVariable({ inputDim }, DataType::Float, L"input");
+    auto timesParam = Parameter(NDArrayView::RandomUniform<float>({ hiddenDim, inputDim }, -0.5, 0.5, 1, device), L"W");
+    auto hidden = Tanh(Times(timesParam, inputVar), L"hidden");
+    auto output = ReduceSum(Sigmoid(hidden), Axis(0), L"output");
+
+    std::vector<float> inputData(inputDim * numSamples);
+    for (size_t i = 0; i < inputData.size(); ++i)
+        inputData[i] = (float)i / inputData.size() - 0.5f;
+    auto inputValue = Value::CreateBatch(NDShape({ inputDim }), inputData, device);
+
+    auto evaluate = [&](const Variable& var) {
+        std::unordered_map<Variable, ValuePtr> outputs = { { var, nullptr } };
+        output->Forward({ { inputVar, inputValue } }, outputs, device);
+        return outputs.at(var)->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+    };
+
+    std::unordered_map<Variable, ValuePtr> trainingOutputs = { { output->Output(), nullptr } };
+    auto backpropState = output->Forward({ { inputVar, inputValue } }, trainingOutputs, device, { output->Output() });
+    auto outputShape = trainingOutputs.at(output->Output())->Shape();
+    auto trainingOutput = trainingOutputs.at(output->Output())->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+
+    auto hiddenValue = evaluate(hidden->Output());
+
+    auto rootGradient = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(1.0f, outputShape, device));
+    std::unordered_map<Variable, ValuePtr> gradients = { { timesParam, nullptr } };
+    output->Backward(backpropState, { { output->Output(), rootGradient } }, gradients);
+    auto timesParamGradient = gradients.at(timesParam)->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+
+    auto outputValue = evaluate(output->Output());
+    auto hiddenValueAgain = evaluate(hidden->Output());
+
+    auto W = timesParam.Value()->DeepClone(DeviceDescriptor::CPUDevice());
+    std::vector<double> expectedGradient(hiddenDim * inputDim, 0);
+    for (size_t s = 0; s < numSamples; ++s)
+    {
+        double expectedOutput = 0;
+        for (size_t r = 0; r < hiddenDim; ++r)
+        {
+            double z = 0;
+            for (size_t c = 0; c < inputDim; ++c)
+                z += W->DataBuffer<float>()[r + c * hiddenDim] * inputData[s * inputDim + c];
+
+            double h = tanh(z);
+            double sigmoid = 1 / (1 + exp(-h));
+            expectedOutput += sigmoid;
+            for (size_t c = 0; c < inputDim; ++c)
+                expectedGradient[r + c * hiddenDim] += sigmoid * (1 - sigmoid) * (1 - h * h) * inputData[s * inputDim + c];
+
+            for (auto& actual : { hiddenValue->DataBuffer<float>()[s * hiddenDim + r], hiddenValueAgain->DataBuffer<float>()[s * hiddenDim + r] })
+            {
+                if (fabs(actual - h) > 1e-5)
+                    ReportFailure("The hidden value %d of sample %d is %f instead of %f.", (int)r, (int)s, actual, h);
+            }
+        }
+
+        for (auto& actual : { trainingOutput->DataBuffer<float>()[s], outputValue->DataBuffer<float>()[s] })
+        {
+            if (fabs(actual - expectedOutput) > 1e-5)
+                ReportFailure("The output of sample %d is %f instead of %f.", (int)s, actual, expectedOutput);
+        }
+    }
+
+    for (size_t i = 0; i < expectedGradient.size(); ++i)
+    {
+        float actual = timesParamGradient->DataBuffer<float>()[i];
+        if (fabs(actual - expectedGradient[i]) > 1e-5)
+            ReportFailure("The gradient of parameter element %d is %f instead of %f.", (int)i, actual, expectedGradient[i]);
+    }
+}
+
 void CheckFindByNameResult(FunctionPtr actual, FunctionPtr expected)
 {
     if (actual == nullptr)
@@ -1096,12 +1549,90 @@ BOOST_AUTO_TEST_CASE(OutputVariableNameInCPU)
         TestOutputVariableName(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(CopyOnWriteCloning)
+{
+    if (ShouldRunOnCpu())
+        TestCopyOnWriteCloning(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(FunctionOutputs)
 {
     if (ShouldRunOnCpu())
         TestFunctionOutputs(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(BatchingEvaluatorInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestBatchingEvaluator(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(BatchingEvaluatorInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestBatchingEvaluator(DeviceDescriptor::GPUDevice(0));
+}
+
+BOOST_AUTO_TEST_CASE(BeamSearchDecoderInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestBeamSearchDecoder(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(BeamSearchDecoderInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestBeamSearchDecoder(DeviceDescriptor::GPUDevice(0));
+}
+
+BOOST_AUTO_TEST_CASE(CachedEvaluationInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestCachedEvaluation(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(CachedEvaluationInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestCachedEvaluation(DeviceDescriptor::GPUDevice(0));
+}
+
+BOOST_AUTO_TEST_CASE(ScaledDotProductAttentionInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestScaledDotProductAttention(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(ScaledDotProductAttentionInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestScaledDotProductAttention(DeviceDescriptor::GPUDevice(0));
+}
+
+BOOST_AUTO_TEST_CASE(ChainedPackedValuesInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestChainedPackedValues(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(ChainedPackedValuesInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestChainedPackedValues(DeviceDescriptor::GPUDevice(0));
+}
+
+BOOST_AUTO_TEST_CASE(SwitchingBetweenEvaluationPlansInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestSwitchingBetweenEvaluationPlans(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(SwitchingBetweenEvaluationPlansInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestSwitchingBetweenEvaluationPlans(DeviceDescriptor::GPUDevice(0));
+}
+
 BOOST_AUTO_TEST_CASE(TimesIndirectSparseGradType)
 {
     if (ShouldRunOnCpu())
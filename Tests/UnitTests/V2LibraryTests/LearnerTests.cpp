@@ -115,6 +115,105 @@ void TestRMSPropLearner(size_t numParameters, size_t numMinibatches, const Devic
     TestUpdate<ElementType>(learner, shape, numMinibatches, device);
 }
 
+template <typename ElementType>
+void TestLARSLearner(size_t numParameters, size_t numMinibatches, bool unitGainMomentum, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    AdditionalLearningOptions options;
+    options.l2RegularizationWeight = 0.001;
+    auto learner = LARSLearner(parameters, LearningRatePerMinibatchSchedule({ 3.0, 2.0, 1.0 }, numMinibatches), MomentumAsTimeConstantSchedule(100), unitGainMomentum, 0.01, options);
+    TestUpdate<ElementType>(learner, shape, numMinibatches, device);
+}
+
+template <typename ElementType>
+void TestLAMBLearner(size_t numParameters, size_t numMinibatches, bool unitGainMomentum, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto learner = LAMBLearner(parameters, LearningRatePerSampleSchedule({ 0.5 }), MomentumAsTimeConstantSchedule({ 10.0, 100.0, 1000.0 }), unitGainMomentum, MomentumPerSampleSchedule(0.99), 0.01);
+    TestUpdate<ElementType>(learner, shape, numMinibatches, device);
+}
+
+// The first step of a layer-wise adaptive learner (without momentum for LARS) changes each parameter w by
+// stepRatio * ||w||, whatever the scale of its gradient.
+template <typename ElementType>
+void TestLayerwiseAdaptiveStep(const function<LearnerPtr(const vector<Parameter>&)>& createLearner, double stepRatio,
+                               size_t numParameters, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto learner = createLearner(parameters);
+
+    auto seed = (unsigned long) rng();
+    vector<NDArrayViewPtr> oldValues;
+    unordered_map<Parameter, NDArrayViewPtr> gradientValues;
+    for (size_t k = 0; k < numParameters; k++)
+    {
+        const double scale = pow(10.0, (double) k);
+        oldValues.push_back(parameters[k].Value()->DeepClone(DeviceDescriptor::CPUDevice()));
+        gradientValues[parameters[k]] = NDArrayView::RandomUniform<ElementType>(shape, -scale, scale, seed + k, device);
+    }
+    learner->Update(gradientValues, 1);
+
+    for (size_t k = 0; k < numParameters; k++)
+    {
+        NDArrayViewPtr newValue = parameters[k].Value()->DeepClone(DeviceDescriptor::CPUDevice());
+        const ElementType* oldData = oldValues[k]->DataBuffer<ElementType>();
+        const ElementType* newData = newValue->DataBuffer<ElementType>();
+        double valueSquares = 0, stepSquares = 0;
+        for (size_t i = 0; i < shape.TotalSize(); i++)
+        {
+            valueSquares += (double) oldData[i] * oldData[i];
+            stepSquares += ((double) newData[i] - oldData[i]) * ((double) newData[i] - oldData[i]);
+        }
+        FloatingPointCompare<ElementType>((ElementType) (sqrt(stepSquares / valueSquares)), (ElementType) stepRatio,
+                                          "TestLayerwiseAdaptiveStep: the step is not scaled by the trust ratio");
+    }
+}
+
+// The multi-tensor update must update the parameters the same as the update of each parameter on its own.
+template <typename ElementType>
+void TestMultiTensorUpdate(const function<LearnerPtr(const vector<Parameter>&, const AdditionalLearningOptions&)>& createLearner,
+                           size_t numParameters, size_t numMinibatches, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    AdditionalLearningOptions options;
+    options.l2RegularizationWeight = 0.01;
+    options.gradientClippingThresholdPerSample = 0.5;
+    options.gradientClippingWithTruncation = false;
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto learner = createLearner(parameters, options);
+    options.multiTensorUpdate = true;
+    auto multiTensorParameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto multiTensorLearner = createLearner(multiTensorParameters, options);
+
+    auto seed = (unsigned long) rng();
+    for (size_t i = 0; i < numMinibatches; i++)
+    {
+        unordered_map<Parameter, NDArrayViewPtr> gradientValues, multiTensorGradientValues;
+        for (size_t k = 0; k < numParameters; k++)
+        {
+            auto gradientValue = NDArrayView::RandomUniform<ElementType>(shape, -1.0, 1.0, seed + i * numParameters + k, device);
+            gradientValues[parameters[k]] = gradientValue->DeepClone();
+            multiTensorGradientValues[multiTensorParameters[k]] = gradientValue;
+        }
+        learner->Update(gradientValues, 2);
+        multiTensorLearner->Update(multiTensorGradientValues, 2);
+    }
+
+    for (size_t k = 0; k < numParameters; k++)
+    {
+        NDArrayViewPtr value = parameters[k].Value()->DeepClone(DeviceDescriptor::CPUDevice());
+        NDArrayViewPtr multiTensorValue = multiTensorParameters[k].Value()->DeepClone(DeviceDescriptor::CPUDevice());
+        const ElementType* data = value->DataBuffer<ElementType>();
+        const ElementType* multiTensorData = multiTensorValue->DataBuffer<ElementType>();
+        const size_t size = value->Shape().TotalSize();
+        FloatingPointVectorCompare(vector<ElementType>(multiTensorData, multiTensorData + size), vector<ElementType>(data, data + size),
+                                   "TestMultiTensorUpdate: parameter values differ from the update of each parameter");
+    }
+}
+
 void TestTrainingParametersSchedule()
 {
     LearningRatePerSampleSchedule schedule1 = 0.5;
@@ -417,6 +516,71 @@ BOOST_AUTO_TEST_CASE(CreateAndUpdateAdamLearner)
     }
 }
 
+BOOST_AUTO_TEST_CASE(CreateAndUpdateLARSLearner)
+{
+    for (auto& device : devices)
+    {
+        for (auto& gain : unitGain)
+        {
+            TestLARSLearner<float>(numParameters, numMinibatches, gain, device);
+            TestLARSLearner<double>(numParameters, numMinibatches, gain, device);
+        }
+        auto lars = [](const vector<Parameter>& parameters)
+        {
+            return LARSLearner(parameters, LearningRatePerSampleSchedule(0.1), MomentumPerSampleSchedule(0.0), true, 0.01);
+        };
+        TestLayerwiseAdaptiveStep<float>(lars, 0.1 * 0.01, numParameters, device);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CreateAndUpdateLAMBLearner)
+{
+    for (auto& device : devices)
+    {
+        for (auto& gain : unitGain)
+        {
+            TestLAMBLearner<float>(numParameters, numMinibatches, gain, device);
+            TestLAMBLearner<double>(numParameters, numMinibatches, gain, device);
+        }
+        auto lamb = [](const vector<Parameter>& parameters)
+        {
+            return LAMBLearner(parameters, LearningRatePerSampleSchedule(0.1), MomentumPerSampleSchedule(0.9), true, MomentumPerSampleSchedule(0.99), 0.01);
+        };
+        TestLayerwiseAdaptiveStep<double>(lamb, 0.1, numParameters, device);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MultiTensorUpdate)
+{
+    for (auto& device : devices)
+    {
+        for (auto& gain : unitGain)
+        {
+            auto momentumSGD = [gain](const vector<Parameter>& parameters, const AdditionalLearningOptions& options)
+            {
+                return MomentumSGDLearner(parameters, LearningRatePerSampleSchedule(0.1), MomentumAsTimeConstantSchedule(100), gain, options);
+            };
+            auto nesterov = [gain](const vector<Parameter>& parameters, const AdditionalLearningOptions& options)
+            {
+                return NesterovLearner(parameters, LearningRatePerSampleSchedule(0.1), MomentumAsTimeConstantSchedule(100), gain, options);
+            };
+            auto adam = [gain](const vector<Parameter>& parameters, const AdditionalLearningOptions& options)
+            {
+                return AdamLearner(parameters, LearningRatePerSampleSchedule(0.1), MomentumAsTimeConstantSchedule(100), gain,
+                                   MomentumPerSampleSchedule(0.99), options);
+            };
+            TestMultiTensorUpdate<float>(momentumSGD, numParameters, numMinibatches, device);
+            TestMultiTensorUpdate<double>(nesterov, numParameters, numMinibatches, device);
+            TestMultiTensorUpdate<float>(adam, numParameters, numMinibatches, device);
+        }
+        auto sgd = [](const vector<Parameter>& parameters, const AdditionalLearningOptions& options)
+        {
+            return SGDLearner(parameters, LearningRatePerSampleSchedule(0.1), options);
+        };
+        TestMultiTensorUpdate<double>(sgd, numParameters, numMinibatches, device);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TestResettingLearningRate)
 {
     NDShape shape = { 1 };
@@ -440,6 +604,77 @@ BOOST_AUTO_TEST_CASE(TestResettingLearningRate)
     }
 }
 
+BOOST_AUTO_TEST_CASE(DynamicLossScaling)
+{
+    DeviceDescriptor device = DeviceDescriptor::CPUDevice();
+    auto weights = Parameter({ 2 }, DataType::Float, 1, device);
+    AdditionalLearningOptions options;
+    options.lossScale = 8;
+    options.dynamicLossScaling = true;
+    options.lossScaleGrowthInterval = 2;
+    auto learner = SGDLearner({ weights }, LearningRatePerSampleSchedule(0.5), options);
+    BOOST_TEST(learner->LossScale() == 8.0);
+
+    auto update = [&](std::vector<float> gradientValueVector)
+    {
+        auto gradientValue = MakeSharedObject<NDArrayView>(weights.Shape(), gradientValueVector);
+        std::unordered_map<Parameter, NDArrayViewPtr> gradients{ { weights, gradientValue } };
+        learner->Update(gradients, 1);
+        auto weightValues = weights.Value()->DataBuffer<float>();
+        return std::vector<float>(weightValues, weightValues + 2);
+    };
+
+    // the gradient is divided by the loss scale: 1 - 0.5 * 16 / 8
+    BOOST_TEST((update({ 16, 16 }) == std::vector<float>{ 0, 0 }));
+    BOOST_TEST(learner->LossScale() == 8.0);
+
+    // an overflow skips the update and halves the scale
+    BOOST_TEST((update({ std::numeric_limits<float>::infinity(), 1 }) == std::vector<float>{ 0, 0 }));
+    BOOST_TEST(learner->LossScale() == 4.0);
+
+    // two good minibatches in a row double it again
+    BOOST_TEST((update({ 8, -8 }) == std::vector<float>{ -1, 1 }));
+    BOOST_TEST(learner->LossScale() == 4.0);
+    update({ 0, 0 });
+    BOOST_TEST(learner->LossScale() == 8.0);
+}
+
+BOOST_AUTO_TEST_CASE(GradientAccumulation)
+{
+    DeviceDescriptor device = DeviceDescriptor::CPUDevice();
+    const size_t inputDim = 3;
+    std::vector<float> firstHalf = { 1, 2, 3, -1, 0, 2 };
+    std::vector<float> secondHalf = { 0.5f, -2, 1, 3, 1, -1 };
+    std::vector<float> whole(firstHalf);
+    whole.insert(whole.end(), secondHalf.begin(), secondHalf.end());
+
+    // trains a linear model to output zero on the given minibatches, and returns its weights
+    auto train = [&](size_t gradientAccumulationSteps, const std::vector<std::vector<float>>& minibatches)
+    {
+        auto input = InputVariable({ inputDim }, DataType::Float, L"features");
+        auto weights = Parameter({ 1, inputDim }, DataType::Float, 0.5, device);
+        auto output = Times(weights, input);
+        auto trainer = CreateTrainer(output, Square(output), { SGDLearner({ weights }, LearningRatePerSampleSchedule(0.01)) });
+        trainer->SetGradientAccumulationSteps(gradientAccumulationSteps);
+        for (const auto& minibatch : minibatches)
+        {
+            std::unordered_map<Variable, ValuePtr> arguments = { { input, Value::CreateBatch(input.Shape(), minibatch, device) } };
+            trainer->TrainMinibatch(arguments, device);
+        }
+        auto weightValues = weights.Value()->DataBuffer<float>();
+        return std::vector<float>(weightValues, weightValues + inputDim);
+    };
+
+    // no update before the last minibatch of an accumulation
+    BOOST_TEST((train(2, { firstHalf }) == std::vector<float>{ 0.5f, 0.5f, 0.5f }));
+
+    // two accumulated halves update like the whole minibatch, also in the second round
+    auto accumulated = train(2, { firstHalf, secondHalf, firstHalf, secondHalf });
+    auto expected = train(1, { whole, whole });
+    for (size_t i = 0; i < inputDim; i++)
+        BOOST_TEST(std::abs(accumulated[i] - expected[i]) < 1e-5f);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}
@@ -184,6 +184,118 @@ void TestSparseCSCArrayView(size_t numAxes, const DeviceDescriptor& device)
     BOOST_TEST(copiedDenseData == referenceDenseData, "The contents of the dense vector that the sparse NDArrayView is copied into do not match the expected values");
 }
 
+template <typename ElementType>
+void TestStridedSliceView(const DeviceDescriptor& device)
+{
+    // a [4 x 5] matrix with element (i, j) = 10 * i + j
+    NDShape viewShape({ 4, 5 });
+    std::vector<ElementType> data(viewShape.TotalSize());
+    for (size_t j = 0; j < 5; ++j)
+        for (size_t i = 0; i < 4; ++i)
+            data[j * 4 + i] = (ElementType)(10 * i + j);
+
+    auto cpuDataView = MakeSharedObject<NDArrayView>(viewShape, data);
+    auto dataView = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), viewShape, device);
+    dataView->CopyFrom(*cpuDataView);
+
+    // rows 1..2 of columns 1..3 are not contiguous in memory, but a view over the same data
+    auto sliceView = dataView->SliceView({ 1, 1 }, { 2, 3 });
+    BOOST_TEST(!sliceView->IsContiguous());
+    BOOST_TEST(dataView->IsContiguous());
+
+    auto verifySlice = [](const NDArrayViewPtr& slice, ElementType offset) {
+        auto cpuSlice = slice->DeepClone(DeviceDescriptor::CPUDevice());
+        BOOST_TEST(cpuSlice->IsContiguous());
+        auto buffer = cpuSlice->template DataBuffer<ElementType>();
+        for (size_t j = 0; j < 3; ++j)
+            for (size_t i = 0; i < 2; ++i)
+                BOOST_TEST(buffer[j * 2 + i] == (ElementType)(10 * (i + 1) + (j + 1)) + offset);
+    };
+    verifySlice(sliceView, 0);
+
+    // copying the slice out and back in leaves the original view unchanged
+    auto updatedSlice = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), sliceView->Shape(), DeviceDescriptor::CPUDevice());
+    updatedSlice->CopyFrom(*sliceView);
+    sliceView->CopyFrom(*updatedSlice->DeepClone(device));
+    std::vector<ElementType> copiedData(viewShape.TotalSize());
+    NDArrayView cpuCopy(viewShape, copiedData.data(), copiedData.size(), DeviceDescriptor::CPUDevice());
+    cpuCopy.CopyFrom(*dataView);
+    BOOST_TEST(copiedData == data);
+
+    // writes through the slice land in the original view, and only there
+    sliceView->SetValue((ElementType)-1);
+    cpuCopy.CopyFrom(*dataView);
+    for (size_t j = 0; j < 5; ++j)
+        for (size_t i = 0; i < 4; ++i)
+        {
+            bool isInSlice = (i >= 1) && (i < 3) && (j >= 1) && (j < 4);
+            BOOST_TEST(copiedData[j * 4 + i] == (isInSlice ? (ElementType)-1 : data[j * 4 + i]));
+        }
+
+    // asynchronous copies across devices
+    auto cloneFuture = cpuDataView->DeepCloneAsync(device);
+    auto asyncClone = cloneFuture.get();
+    verifySlice(asyncClone->SliceView({ 1, 1 }, { 2, 3 }), 0);
+
+    auto destination = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), viewShape, DeviceDescriptor::CPUDevice());
+    destination->CopyFromAsync(asyncClone).get();
+    BOOST_TEST(std::equal(data.begin(), data.end(), destination->template DataBuffer<ElementType>()));
+
+    // strided views have no buffer of their own
+    VerifyException([&sliceView]() {
+        sliceView->template DataBuffer<ElementType>();
+    }, "Was incorrectly able to get the DataBuffer of a NDArrayView that is not contiguous.");
+    VerifyException([&sliceView]() {
+        sliceView->AsShape({ 6 });
+    }, "Was incorrectly able to reshape a NDArrayView that is not contiguous.");
+}
+
+template <typename ElementType>
+void TestExternalBufferRelease()
+{
+    NDShape viewShape({ 3, 4 });
+    std::vector<ElementType> data(viewShape.TotalSize());
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (ElementType)i;
+
+    size_t numReleases = 0;
+    auto dataView = MakeSharedObject<NDArrayView>(viewShape, data.data(), data.size(), DeviceDescriptor::CPUDevice(), /*readOnly =*/ false, [&numReleases]() { numReleases++; });
+    BOOST_TEST(dataView->template DataBuffer<ElementType>() == data.data(), "The NDArrayView does not use the buffer it was created over");
+
+    // views over the same storage keep the buffer in use
+    auto aliasView = dataView->Alias(/*readOnly =*/ true);
+    auto sliceView = dataView->SliceView({ 0, 1 }, { 3, 2 });
+    auto reshapedView = dataView->AsShape({ 12 });
+    auto value = Value::CreateBatch(NDShape({ 3 }), dataView, DeviceDescriptor::CPUDevice());
+    dataView = nullptr;
+    BOOST_TEST(numReleases == 0);
+
+    sliceView->SetValue((ElementType)-1);
+    BOOST_TEST(data[3] == (ElementType)-1);
+    BOOST_TEST(reshapedView->template DataBuffer<ElementType>()[5] == (ElementType)-1);
+
+    aliasView = nullptr;
+    sliceView = nullptr;
+    reshapedView = nullptr;
+    BOOST_TEST(numReleases == 0);
+    value = nullptr;
+    BOOST_TEST(numReleases == 1, "The release callback was not called when the last view over the buffer went away");
+
+    // a copy owns its storage
+    auto cpuDataView = MakeSharedObject<NDArrayView>(viewShape, data.data(), data.size(), DeviceDescriptor::CPUDevice(), /*readOnly =*/ true, [&numReleases]() { numReleases++; });
+    auto clonedView = cpuDataView->DeepClone();
+    cpuDataView = nullptr;
+    BOOST_TEST(numReleases == 2);
+    BOOST_TEST(clonedView->template DataBuffer<ElementType>()[3] == (ElementType)-1);
+
+    // a buffer that is not aligned to the element type is rejected, and stays with the caller
+    VerifyException([&data, &numReleases]() {
+        auto misalignedBuffer = reinterpret_cast<ElementType*>(reinterpret_cast<char*>(data.data()) + 1);
+        NDArrayView misalignedView(NDShape({ 3, 3 }), misalignedBuffer, data.size() - 1, DeviceDescriptor::CPUDevice(), /*readOnly =*/ false, [&numReleases]() { numReleases++; });
+    }, "Was incorrectly able to create a NDArrayView over a misaligned buffer.");
+    BOOST_TEST(numReleases == 2);
+}
+
 BOOST_AUTO_TEST_SUITE(NDArrayViewSuite)
 
 BOOST_AUTO_TEST_CASE(CheckFloatNDArrayViewInCpu)
@@ -216,6 +328,30 @@ BOOST_AUTO_TEST_CASE(CheckCscArrayViewInCpu)
         TestSparseCSCArrayView<float>(2, DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(CheckStridedSliceViewInCpu)
+{
+    if (ShouldRunOnCpu())
+        TestStridedSliceView<float>(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(CheckExternalBufferReleaseInCpu)
+{
+    if (ShouldRunOnCpu())
+    {
+        TestExternalBufferRelease<float>();
+        TestExternalBufferRelease<double>();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CheckStridedSliceViewInGpu)
+{
+    if (ShouldRunOnGpu())
+    {
+        TestStridedSliceView<float>(DeviceDescriptor::GPUDevice(0));
+        TestStridedSliceView<double>(DeviceDescriptor::GPUDevice(0));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}
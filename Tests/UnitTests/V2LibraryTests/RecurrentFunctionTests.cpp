@@ -376,6 +376,32 @@ void TestSimpleRecurrence(size_t inputDim,
     }
 }
 
+void TestTruncatedPastValue(const DeviceDescriptor& device)
+{
+    // z(t) = x(t) + x(t - 2), over two sequences that are fed in chunks of three frames
+    auto inputVar = InputVariable({ 1 }, DataType::Float, L"input");
+    auto z = Plus(inputVar, PastValue(inputVar, 2));
+    auto forward = [&](const std::vector<std::vector<float>>& chunks, bool sequenceStarts)
+    {
+        auto inputValue = Value::Create(NDShape({ 1 }), chunks, std::vector<bool>(chunks.size(), sequenceStarts), device, true);
+        std::unordered_map<Variable, ValuePtr> outputs = { { z->Output(), nullptr } };
+        z->Forward({ { inputVar, inputValue } }, outputs, device);
+        std::vector<std::vector<float>> results;
+        outputs[z->Output()]->CopyVariableValueTo(z->Output(), results);
+        return results;
+    };
+
+    auto results = forward({ { 1, 2, 3 }, { 10, 20, 30 } }, true);
+    BOOST_CHECK(results == std::vector<std::vector<float>>({ { 1, 2, 4 }, { 10, 20, 40 } }));
+
+    // the first two frames of the continuations read the last two frames of the previous chunk
+    results = forward({ { 4, 5, 6 }, { 40, 50, 60 } }, false);
+    BOOST_CHECK(results == std::vector<std::vector<float>>({ { 6, 8, 10 }, { 60, 80, 100 } }));
+
+    results = forward({ { 7 }, { 70 } }, false);
+    BOOST_CHECK(results == std::vector<std::vector<float>>({ { 12 }, { 120 } }));
+}
+
 BOOST_AUTO_TEST_SUITE(RecurrentFunctionSuite)
 
 BOOST_AUTO_TEST_CASE(SimpleRecurrenceInCPU)
@@ -419,6 +445,12 @@ BOOST_AUTO_TEST_CASE(RecurrentNetworkCreationInGPU)
         TestRecurrentNetworkCreation<float>(DeviceDescriptor::GPUDevice(0), true);
 }
 
+BOOST_AUTO_TEST_CASE(TruncatedPastValueInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestTruncatedPastValue(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}
@@ -13,6 +13,7 @@
 #include <vector>
 #include <functional>
 #include <iostream>
+#include <sstream>
 
 using namespace CNTK;
 using namespace std;
@@ -185,6 +186,83 @@ void TestLargeValueSerialization(size_t numElements)
         BOOST_ERROR("TestLargeValueSerialization: original and deserialized values are not identical.");
 }
 
+void TestDictionaryWithBlobsSerialization()
+{
+    if ((_wunlink(tempFilePath.c_str()) != 0) && (errno != ENOENT))
+        BOOST_ERROR("Error deleting temporary test file 'serialization.tmp'.");
+
+    // Large NDArrayViews are written as blobs after the protobuf message, small ones into it.
+    auto device = DeviceDescriptor::CPUDevice();
+    Dictionary originalDict;
+    originalDict[L"small"] = *NDArrayView::RandomUniform<float>({ 10 }, -0.5, 0.5, 1, device);
+    originalDict[L"large"] = *NDArrayView::RandomUniform<float>({ 300, 200 }, -0.5, 0.5, 2, device);
+    originalDict[L"vector"] = std::vector<DictionaryValue>({ *NDArrayView::RandomUniform<double>({ 50000 }, -0.5, 0.5, 3, device), DictionaryValue(3.0), *NDArrayView::RandomUniform<float>({ 7, 50000 }, -0.5, 0.5, 4, device) });
+    Dictionary nestedDict;
+    nestedDict[L"large"] = *NDArrayView::RandomUniform<double>({ 20000 }, -0.5, 0.5, 5, device);
+    originalDict[L"nested"] = nestedDict;
+
+    {
+        fstream stream;
+        OpenStream(stream, tempFilePath, false);
+        stream << originalDict;
+        stream.flush();
+    }
+
+    Dictionary deserializedDict1;
+    {
+        fstream stream;
+        OpenStream(stream, tempFilePath, true);
+        stream >> deserializedDict1;
+    }
+
+    if (originalDict != deserializedDict1)
+        BOOST_ERROR("TestDictionaryWithBlobsSerialization: original and deserialized dictionaries are not identical.");
+
+    // The blobs are read in order, so that the same works with streams in memory.
+    std::stringstream buffer;
+    buffer << originalDict;
+    Dictionary deserializedDict2;
+    buffer >> deserializedDict2;
+
+    if (originalDict != deserializedDict2)
+        BOOST_ERROR("TestDictionaryWithBlobsSerialization: original and deserialized dictionaries are not identical.");
+
+    originalDict.Save(tempFilePath);
+    Dictionary deserializedDict3 = Dictionary::Load(tempFilePath);
+
+    if (originalDict != deserializedDict3)
+        BOOST_ERROR("TestDictionaryWithBlobsSerialization: original and deserialized dictionaries are not identical.");
+}
+
+void TestTensorBoardFileWriter(const DeviceDescriptor& device)
+{
+    auto writer = std::make_shared<Internal::TensorBoardFileWriter>(L"tensorboard.tmp", FunctionPtr());
+
+    // Nothing is written, so there is no file to flush.
+    BOOST_TEST(!writer->Flush());
+
+    auto parameter = Parameter({ 10, 20 }, DataType::Float, GlorotUniformInitializer(), device);
+    for (uint64_t step = 1; step <= 100; ++step)
+    {
+        writer->WriteValue(L"minibatch/loss", 1.0f / step, step);
+        if (step % 10 == 0)
+            writer->WriteHistogram(L"parameters/W", parameter.Value(), step);
+    }
+
+    // The writes are asynchronous, but Flush() and Close() wait for them.
+    BOOST_TEST(writer->Flush());
+    BOOST_TEST(writer->Close());
+    BOOST_TEST(!writer->Close());
+
+    // A sparse NDArrayView has no histogram.
+    auto sparse = MakeSharedObject<NDArrayView>(DataType::Float, StorageFormat::SparseCSC, NDShape({ 10, 20 }), device);
+    VerifyException([&writer, &sparse]() { writer->WriteHistogram(L"sparse", sparse, 1); }, "Was able to write the histogram of a sparse NDArrayView.");
+
+    // Writing again opens a new file.
+    writer->WriteValue(L"minibatch/loss", 0.0f, 101);
+    BOOST_TEST(writer->Flush());
+}
+
 template <typename ElementType>
 void TestLearnerSerialization(int numParameters, const DeviceDescriptor& device)
 {
@@ -335,7 +413,8 @@ void CheckEnumValuesNotModified() {
                   static_cast<size_t>(PrimitiveOpType::ToSequence) == 70 &&
                   static_cast<size_t>(PrimitiveOpType::ToSequenceLike) == 71 &&
                   static_cast<size_t>(PrimitiveOpType::UnpackSequence) == 72 &&
-                  static_cast<size_t>(PrimitiveOpType::Assign) == 73,
+                  static_cast<size_t>(PrimitiveOpType::Assign) == 73 &&
+                  static_cast<size_t>(PrimitiveOpType::ScaledDotProductAttention) == 74,
                   "PrimitiveOpType enum value was modified.");
 }
 
@@ -793,6 +872,49 @@ void TestLoadingDictionariesGeneratedFromPresentPastAndFutureProtos()
 }
 
 
+void TestCompressedLegacyModelSaving(const DeviceDescriptor& device)
+{
+    size_t inputDim = 784;
+    size_t numOutputClasses = 10;
+    auto features = InputVariable({ inputDim }, false /*isSparse*/, DataType::Float, L"features");
+    auto net = BuildFFClassifierNet(features, numOutputClasses, device, 1);
+
+    const size_t numSamples = 8;
+    std::vector<float> inputData(inputDim * numSamples);
+    for (size_t i = 0; i < inputData.size(); i++)
+        inputData[i] = (float)((i * 37) % 101) / 101;
+
+    auto evaluate = [&](const FunctionPtr& function)
+    {
+        auto input = Value::CreateBatch(NDShape({ inputDim }), inputData, device);
+        std::unordered_map<Variable, ValuePtr> outputs = { { function->Output(), nullptr } };
+        function->Forward({ { function->Arguments()[0], input } }, outputs, device);
+        auto result = outputs.at(function->Output())->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+        return std::vector<float>(result->DataBuffer<float>(), result->DataBuffer<float>() + result->Shape().TotalSize());
+    };
+
+    auto expected = evaluate(net);
+    float maxAbsExpected = 0;
+    for (auto value : expected)
+        maxAbsExpected = std::max(maxAbsExpected, std::abs(value));
+
+    // the tolerances are relative to the largest output
+    for (const auto& formatAndTolerance : std::vector<std::pair<std::wstring, float>>{ { L"float16", 0.01f }, { L"int8", 0.05f } })
+    {
+        const std::wstring modelFile = L"compressed.legacy.model." + formatAndTolerance.first;
+        Internal::SaveAsLegacyModel(net, modelFile, formatAndTolerance.first);
+        auto actual = evaluate(Function::Load(modelFile, device));
+
+        BOOST_TEST(actual.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); i++)
+            BOOST_TEST(std::abs(actual[i] - expected[i]) <= formatAndTolerance.second * maxAbsExpected);
+    }
+
+    VerifyException([&]() {
+        Internal::SaveAsLegacyModel(net, L"compressed.legacy.model.invalid", L"int4");
+    }, "Was able to save a model with an unknown parameter value format.");
+}
+
 void TestCheckpointingWithStatefulNodes(const DeviceDescriptor& device)
 {
     auto featureStreamName = L"features";
@@ -833,6 +955,46 @@ void TestCheckpointingWithStatefulNodes(const DeviceDescriptor& device)
     }
 }
 
+void TestAsyncCheckpointing(const DeviceDescriptor& device)
+{
+    auto featureStreamName = L"features";
+    auto labelsStreamName = L"labels";
+
+    size_t inputDim = 784;
+    size_t numOutputClasses = 10;
+    auto features = InputVariable({ inputDim }, false /*isSparse*/, DataType::Float, featureStreamName);
+    auto labels = InputVariable({ numOutputClasses }, DataType::Float, labelsStreamName);
+    auto net = BuildFFClassifierNet(features, numOutputClasses, device, 1);
+
+    auto trainer = BuildTrainer(net, labels);
+
+    const size_t minibatchSize = 50;
+    const size_t epochSize = 150;
+    auto minibatchSource = TextFormatMinibatchSource(L"Train-28x28_cntk_text.txt", { { featureStreamName, inputDim }, { labelsStreamName, numOutputClasses } },  epochSize, false);
+    auto minibatchData = minibatchSource->GetNextMinibatch(minibatchSize, device);
+    auto featureStreamInfo = minibatchSource->StreamInfo(features);
+    auto labelStreamInfo = minibatchSource->StreamInfo(labels);
+
+    trainer->TrainMinibatch({ { features, minibatchData[featureStreamInfo] }, { labels, minibatchData[labelStreamInfo] } }, device);
+
+    // the training right after each save changes the parameters while the checkpoint is being written
+    vector<double> expectedLoss;
+    for (int i = 0; i < epochSize / minibatchSize; i++)
+    {
+        trainer->SaveCheckpointAsync(L"async_checkpoint.model" + std::to_wstring(i));
+        trainer->TrainMinibatch({ { features, minibatchData[featureStreamInfo] }, { labels, minibatchData[labelStreamInfo] } }, device);
+        expectedLoss.push_back(trainer->PreviousMinibatchLossAverage());
+    }
+    trainer->WaitForCheckpoint();
+
+    for (int i = 0; i < epochSize / minibatchSize; i++)
+    {
+        trainer->RestoreFromCheckpoint(L"async_checkpoint.model" + std::to_wstring(i));
+        trainer->TrainMinibatch({ { features, minibatchData[featureStreamInfo] }, { labels, minibatchData[labelStreamInfo] } }, device);
+        double loss = trainer->PreviousMinibatchLossAverage();
+        FloatingPointCompare(loss, expectedLoss[i], "Post checkpoint restoration training loss does not match expectation");
+    }
+}
 
 void TestCheckpointingWithStatefulNodesAndExplicitSeeds(const DeviceDescriptor& device)
 {
@@ -971,6 +1133,22 @@ BOOST_AUTO_TEST_CASE(DictionarySerialization)
     TestDictionarySerialization(16);
 }
 
+BOOST_AUTO_TEST_CASE(DictionaryWithBlobsSerialization)
+{
+    TestDictionaryWithBlobsSerialization();
+}
+
+BOOST_AUTO_TEST_CASE(TensorBoardFileWriterInCPU)
+{
+    TestTensorBoardFileWriter(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(TensorBoardFileWriterInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestTensorBoardFileWriter(DeviceDescriptor::GPUDevice(0));
+}
+
 BOOST_AUTO_TEST_CASE(LoadingDictionariesGeneratedFromPresentPastAndFutureProtos)
 {
     TestLoadingDictionariesGeneratedFromPresentPastAndFutureProtos();
@@ -1017,11 +1195,21 @@ BOOST_AUTO_TEST_CASE(LegacyModelSavingInCPU)
     TestLegacyModelSaving(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(CompressedLegacyModelSavingInCPU)
+{
+    TestCompressedLegacyModelSaving(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(CheckpointingWithStatefulNodesInCPU)
 {
     TestCheckpointingWithStatefulNodes(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(AsyncCheckpointingInCPU)
+{
+    TestAsyncCheckpointing(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(LearnerSerializationInGPU)
 {
     if (ShouldRunOnGpu())
@@ -1076,12 +1264,24 @@ BOOST_AUTO_TEST_CASE(LegacyModelSavingInGPU)
         TestLegacyModelSaving(DeviceDescriptor::GPUDevice(0));
 }
 
+BOOST_AUTO_TEST_CASE(CompressedLegacyModelSavingInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestCompressedLegacyModelSaving(DeviceDescriptor::GPUDevice(0));
+}
+
 BOOST_AUTO_TEST_CASE(CheckpointingWithStatefulNodesInGPU)
 {
     if (ShouldRunOnGpu())
         TestCheckpointingWithStatefulNodes(DeviceDescriptor::GPUDevice(0));
 }
 
+BOOST_AUTO_TEST_CASE(AsyncCheckpointingInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestAsyncCheckpointing(DeviceDescriptor::GPUDevice(0));
+}
+
 
 BOOST_AUTO_TEST_CASE(CheckpointingWithStatefulNodesAndExplicitSeedsOnCPU)
 {
@@ -753,6 +753,13 @@ void CreateBatchTestDense(const DeviceDescriptor device, bool readOnly)
     vector<size_t> resultSeqLen(data[0].size()/sampleSize, 1);
     CheckValue(testValue, sampleShape, expectedResult, resultSeqLen);
 
+    // over a NDArrayView, the data is only copied if it is not on the device yet
+    auto batchView = MakeSharedObject<NDArrayView>(sampleShape.AppendShape({ resultSeqLen.size() }), batch2);
+    auto viewValue = Value::CreateBatch(sampleShape, batchView, device, readOnly);
+    CheckValue(viewValue, sampleShape, expectedResult, resultSeqLen);
+    if (device.Type() == DeviceKind::CPU)
+        BOOST_TEST(viewValue->Data()->template DataBuffer<ElementType>() == batch2.data(), "The Value does not share the buffer of the NDArrayView it was created over");
+
     vector<ElementType> wrongBatch(sampleSize * 2 - 1, 0);
     VerifyException([&sampleShape, &wrongBatch, &device, &readOnly]() {
         Value::CreateBatch(sampleShape, wrongBatch, device, readOnly);